@@ -63,6 +63,14 @@ AC_DEFUN([AX_INTEL_FEATURES],
         INTEL_FLAGS="$INTEL_FLAGS $INTEL_SSE4_2_FLAGS"
         AC_DEFINE(HAVE_SSE4_2,,[Support SSE4.2 (Streaming SIMD Extensions 4.2) instructions])
       fi
+
+      AX_CHECK_COMPILE_FLAG(-mavx2, ax_cv_support_avx2_ext=yes, [])
+      if test x"$ax_cv_support_avx2_ext" = x"yes"; then
+        INTEL_AVX2_FLAGS="-mavx2 -DINTEL_AVX2"
+        AC_SUBST(INTEL_AVX2_FLAGS)
+        INTEL_FLAGS="$INTEL_FLAGS $INTEL_AVX2_FLAGS"
+        AC_DEFINE(HAVE_AVX2,,[Support AVX2 (Advanced Vector Extensions 2) instructions])
+      fi
     ;;
   esac
 
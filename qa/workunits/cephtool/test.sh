@@ -1349,6 +1349,11 @@ function test_mon_osd_pool_set()
   check_response 'not change the size'
   set -e
   ceph osd pool get pool_erasure erasure_code_profile
+  ceph osd pool set pool_erasure ec_overwrites true
+  ceph osd pool get pool_erasure ec_overwrites | grep "ec_overwrites: true"
+  ceph osd pool set pool_erasure ec_overwrites 0
+  ceph osd pool get pool_erasure ec_overwrites | grep "ec_overwrites: false"
+  expect_false ceph osd pool set $TEST_POOL_GETSET ec_overwrites true
 
   auid=5555
   ceph osd pool set $TEST_POOL_GETSET auid $auid
@@ -41,6 +41,9 @@
 #      qa/workunits/erasure-code/bench.sh fplot jerasure |
 #      tee qa/workunits/erasure-code/bench.js
 #
+# The plugins compared by fplot are set with BENCH_PLUGINS, e.g.
+# BENCH_PLUGINS="jerasure_sse4 jerasure_avx2" on a CPU with AVX2.
+#
 set -e
 
 export PATH=/sbin:$PATH
@@ -52,6 +55,7 @@ export PATH=/sbin:$PATH
 : ${TOTAL_SIZE:=$((1024 * 1024))}
 : ${SIZE:=4096}
 : ${PARAMETERS:=--parameter jerasure-per-chunk-alignment=true}
+: ${BENCH_PLUGINS:=isa jerasure_generic jerasure_sse4}
 
 function bench_header() {
     echo -e "seconds\tKB\tplugin\tk\tm\twork.\titer.\tsize\teras.\tcommand."
@@ -115,8 +119,10 @@ function bench_run() {
     local jerasure_generic2technique_cauchy='cauchy_good'
     local jerasure_sse42technique_vandermonde='reed_sol_van'
     local jerasure_sse42technique_cauchy='cauchy_good'
+    local jerasure_avx22technique_vandermonde='reed_sol_van'
+    local jerasure_avx22technique_cauchy='cauchy_good'
     for technique in vandermonde cauchy ; do
-        for plugin in isa jerasure_generic jerasure_sse4 ; do
+        for plugin in $BENCH_PLUGINS ; do
             eval technique_parameter=\$${plugin}2technique_${technique}
             echo "serie encode_${technique}_${plugin}"
             for k in $ks ; do
@@ -131,7 +137,7 @@ function bench_run() {
         done
     done
     for technique in vandermonde cauchy ; do
-        for plugin in isa jerasure_generic jerasure_sse4 ; do
+        for plugin in $BENCH_PLUGINS ; do
             eval technique_parameter=\$${plugin}2technique_${technique}
             echo "serie decode_${technique}_${plugin}"
             for k in $ks ; do
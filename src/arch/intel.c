@@ -22,6 +22,8 @@ int ceph_arch_intel_sse41 = 0;
 int ceph_arch_intel_ssse3 = 0;
 int ceph_arch_intel_sse3 = 0;
 int ceph_arch_intel_sse2 = 0;
+int ceph_arch_intel_avx2 = 0;
+int ceph_arch_intel_avx512 = 0;
 
 #ifdef __x86_64__
 
@@ -43,6 +45,24 @@ static void do_cpuid(unsigned int *eax, unsigned int *ebx, unsigned int *ecx,
                 : "eax", "ebx", "ecx", "edx");
 }
 
+/* leaf 7 needs the subleaf in ecx */
+static void do_cpuid_count(unsigned int *eax, unsigned int *ebx,
+			   unsigned int *ecx, unsigned int *edx)
+{
+	asm("cpuid"
+	    : "+a" (*eax), "=b" (*ebx), "+c" (*ecx), "=d" (*edx));
+}
+
+/* which register states the kernel saves across context switches */
+static unsigned int do_xgetbv(void)
+{
+	unsigned int eax, edx;
+	asm(".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+	    : "=a" (eax), "=d" (edx)
+	    : "c" (0));
+	return eax;
+}
+
 /* http://en.wikipedia.org/wiki/CPUID#EAX.3D1:_Processor_Info_and_Feature_Bits */
 
 #define CPUID_PCLMUL	(1 << 1)
@@ -51,6 +71,17 @@ static void do_cpuid(unsigned int *eax, unsigned int *ebx, unsigned int *ecx,
 #define CPUID_SSSE3	(1 << 9)
 #define CPUID_SSE3	(1)
 #define CPUID_SSE2	(1 << 26)
+#define CPUID_OSXSAVE	(1 << 27)
+#define CPUID_AVX	(1 << 28)
+
+/* eax=7, ecx=0: ebx */
+#define CPUID_AVX2	(1 << 5)
+#define CPUID_AVX512F	(1 << 16)
+#define CPUID_AVX512BW	(1 << 30)
+
+/* XCR0: sse, avx (ymm) and the opmask/zmm states */
+#define XCR0_YMM	0x06
+#define XCR0_ZMM	0xe6
 
 int ceph_arch_intel_probe(void)
 {
@@ -76,6 +107,27 @@ int ceph_arch_intel_probe(void)
 	        ceph_arch_intel_sse2 = 1;
 	}
 
+	/* the wide registers are only usable if the OS saves them too */
+	if ((ecx & CPUID_OSXSAVE) != 0 && (ecx & CPUID_AVX) != 0) {
+		unsigned int xcr0 = do_xgetbv();
+		eax = 0;
+		do_cpuid(&eax, &ebx, &ecx, &edx);
+		if (eax >= 7) {
+			eax = 7;
+			ecx = 0;
+			do_cpuid_count(&eax, &ebx, &ecx, &edx);
+			if ((ebx & CPUID_AVX2) != 0 &&
+			    (xcr0 & XCR0_YMM) == XCR0_YMM) {
+				ceph_arch_intel_avx2 = 1;
+			}
+			if ((ebx & CPUID_AVX512F) != 0 &&
+			    (ebx & CPUID_AVX512BW) != 0 &&
+			    (xcr0 & XCR0_ZMM) == XCR0_ZMM) {
+				ceph_arch_intel_avx512 = 1;
+			}
+		}
+	}
+
 	return 0;
 }
 
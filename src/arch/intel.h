@@ -11,6 +11,8 @@ extern int ceph_arch_intel_sse41;  /* true if we have sse 4.1 features */
 extern int ceph_arch_intel_ssse3;  /* true if we have ssse 3 features */
 extern int ceph_arch_intel_sse3;   /* true if we have sse 3 features */
 extern int ceph_arch_intel_sse2;   /* true if we have sse 2 features */
+extern int ceph_arch_intel_avx2;   /* true if we have usable avx2 */
+extern int ceph_arch_intel_avx512; /* true if we have usable avx512 f+bw */
 extern int ceph_arch_intel_probe(void);
 
 #ifdef __cplusplus
@@ -295,6 +295,9 @@ Client::Client(Messenger *m, MonClient *mc)
 				  cct->_conf->client_oc_target_dirty,
 				  cct->_conf->client_oc_max_dirty_age,
 				  true);
+  if (objectcacher->set_policy(cct->_conf->client_oc_policy) < 0)
+    lderr(cct) << "unknown client_oc_policy '" << cct->_conf->client_oc_policy
+	       << "', using lru" << dendl;
   objecter_finisher.start();
   filer = new Filer(objecter, &objecter_finisher);
 }
@@ -493,6 +496,12 @@ int Client::init()
   plb.add_time_avg(l_c_reply, "reply", "Latency of receiving a reply on metadata request");
   plb.add_time_avg(l_c_lat, "lat", "Latency of processing a metadata request");
   plb.add_time_avg(l_c_wrlat, "wrlat", "Latency of a file data write operation");
+  plb.add_u64_counter(l_c_lookup_hit, "lookup_hit",
+		      "Lookups answered from a cached dentry");
+  plb.add_u64_counter(l_c_lookup_neg_hit, "lookup_neg_hit",
+		      "Lookups answered ENOENT from the cache");
+  plb.add_u64_counter(l_c_lookup_miss, "lookup_miss",
+		      "Lookups sent to the MDS");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -998,7 +1007,7 @@ void Client::update_dentry_lease(Dentry *dn, LeaseStat *dlease, utime_t from, Me
   utime_t dttl = from;
   dttl += (float)dlease->duration_ms / 1000.0;
   
-  assert(dn && dn->inode);
+  assert(dn);
 
   if (dlease->mask & CEPH_LOCK_DN) {
     if (dttl > dn->lease_ttl) {
@@ -1237,8 +1246,9 @@ Inode* Client::insert_trace(MetaRequest *request, MetaSession *session)
                           ((request->head.op == CEPH_MDS_OP_RENAME) ?
                                         request->old_dentry() : NULL));
     } else {
+      Dentry *dn = NULL;
       if (diri->dir && diri->dir->dentries.count(dname)) {
-	Dentry *dn = diri->dir->dentries[dname];
+	dn = diri->dir->dentries[dname];
 	if (dn->inode) {
 	  diri->dir->ordered_count++;
 	  if (diri->flags & I_DIR_ORDERED) {
@@ -1248,6 +1258,15 @@ Inode* Client::insert_trace(MetaRequest *request, MetaSession *session)
 	  unlink(dn, true, true);  // keep dir, dentry
 	}
       }
+      // keep the null dentry the mds leased us, so that lookups of a
+      // name that does not exist are answered locally while it lasts
+      if (dlease.duration_ms > 0 || diri->caps_issued_mask(CEPH_CAP_FILE_SHARED)) {
+	if (!dn) {
+	  Dir *dir = diri->open_dir();
+	  dn = link(dir, dname, NULL, NULL);
+	}
+	update_dentry_lease(dn, &dlease, request->sent_stamp, session);
+      }
     }
   } else if (reply->head.op == CEPH_MDS_OP_LOOKUPSNAP ||
 	     reply->head.op == CEPH_MDS_OP_MKSNAP) {
@@ -5401,6 +5420,7 @@ int Client::_lookup(Inode *dir, const string& dname, InodeRef *target,
 	if (!dn->inode && (dir->flags & I_COMPLETE)) {
 	  ldout(cct, 10) << "_lookup concluded ENOENT locally for "
 			 << *dir << " dn '" << dname << "'" << dendl;
+	  logger->inc(l_c_lookup_neg_hit);
 	  return -ENOENT;
 	}
       }
@@ -5412,17 +5432,21 @@ int Client::_lookup(Inode *dir, const string& dname, InodeRef *target,
     if (dir->caps_issued_mask(CEPH_CAP_FILE_SHARED) &&
 	(dir->flags & I_COMPLETE)) {
       ldout(cct, 10) << "_lookup concluded ENOENT locally for " << *dir << " dn '" << dname << "'" << dendl;
+      logger->inc(l_c_lookup_neg_hit);
       return -ENOENT;
     }
   }
 
+  logger->inc(l_c_lookup_miss);
   r = _do_lookup(dir, dname, target, uid, gid);
   goto done;
 
  hit_dn:
   if (dn->inode) {
+    logger->inc(l_c_lookup_hit);
     *target = dn->inode;
   } else {
+    logger->inc(l_c_lookup_neg_hit);
     r = -ENOENT;
   }
   touch_dn(dn);
@@ -6416,6 +6440,9 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
   req->set_filepath(path); 
   req->set_inode(diri.get());
   req->head.args.readdir.frag = fg;
+  // fewer, bigger chunks: every chunk is a round trip to the mds
+  req->head.args.readdir.max_entries = cct->_conf->client_readdir_max_entries;
+  req->head.args.readdir.max_bytes = cct->_conf->client_readdir_max_bytes;
   if (dirp->last_name.length()) {
     req->path2.set_path(dirp->last_name.c_str());
     req->readdir_start = dirp->last_name;
@@ -7118,6 +7145,7 @@ Fh *Client::_create_fh(Inode *in, int flags, int cmode)
   alignments.push_back(p);
   alignments.push_back(in->layout.fl_stripe_unit);
   f->readahead.set_alignments(alignments);
+  f->readahead.set_max_streams(conf->client_readahead_streams);
 
   return f;
 }
@@ -7358,22 +7386,26 @@ int Client::uninline_data(Inode *in, Context *onfinish)
 
 int Client::read(int fd, char *buf, loff_t size, loff_t offset)
 {
-  Mutex::Locker lock(client_lock);
-  tout(cct) << "read" << std::endl;
-  tout(cct) << fd << std::endl;
-  tout(cct) << size << std::endl;
-  tout(cct) << offset << std::endl;
+  bufferlist bl;
+  int r;
+  {
+    Mutex::Locker lock(client_lock);
+    tout(cct) << "read" << std::endl;
+    tout(cct) << fd << std::endl;
+    tout(cct) << size << std::endl;
+    tout(cct) << offset << std::endl;
 
-  Fh *f = get_filehandle(fd);
-  if (!f)
-    return -EBADF;
+    Fh *f = get_filehandle(fd);
+    if (!f)
+      return -EBADF;
 #if defined(__linux__) && defined(O_PATH)
-  if (f->flags & O_PATH)
-    return -EBADF;
+    if (f->flags & O_PATH)
+      return -EBADF;
 #endif
-  bufferlist bl;
-  int r = _read(f, offset, size, &bl);
-  ldout(cct, 3) << "read(" << fd << ", " << (void*)buf << ", " << size << ", " << offset << ") = " << r << dendl;
+    r = _read(f, offset, size, &bl);
+    ldout(cct, 3) << "read(" << fd << ", " << (void*)buf << ", " << size << ", " << offset << ") = " << r << dendl;
+  }
+  // copy out without client_lock, so that big reads do not hold up others
   if (r >= 0) {
     bl.copy(0, bl.length(), buf);
     r = bl.length();
@@ -7696,6 +7728,11 @@ void Client::sync_write_commit(InodeRef& in)
 
 int Client::write(int fd, const char *buf, loff_t size, loff_t offset) 
 {
+  // copy the data in before taking client_lock
+  bufferlist bl;
+  if (size > 0)
+    bl.append(buf, size);
+
   Mutex::Locker lock(client_lock);
   tout(cct) << "write" << std::endl;
   tout(cct) << fd << std::endl;
@@ -7709,7 +7746,7 @@ int Client::write(int fd, const char *buf, loff_t size, loff_t offset)
   if (fh->flags & O_PATH)
     return -EBADF;
 #endif
-  int r = _write(fh, offset, size, buf, NULL, 0);
+  int r = _write(fh, offset, bl);
   ldout(cct, 3) << "write(" << fd << ", \"...\", " << size << ", " << offset << ") = " << r << dendl;
   return r;
 }
@@ -7723,51 +7760,61 @@ int Client::pwritev(int fd, const struct iovec *iov, int iovcnt, int64_t offset)
 
 int Client::_preadv_pwritev(int fd, const struct iovec *iov, unsigned iovcnt, int64_t offset, bool write)
 {
-    Mutex::Locker lock(client_lock);
-    tout(cct) << fd << std::endl;
-    tout(cct) << offset << std::endl;
-
-    Fh *fh = get_filehandle(fd);
-    if (!fh)
-        return -EBADF;
-#if defined(__linux__) && defined(O_PATH)
-    if (fh->flags & O_PATH)
-        return -EBADF;
-#endif
     loff_t totallen = 0;
     for (unsigned i = 0; i < iovcnt; i++) {
         totallen += iov[i].iov_len;
     }
+    // the data is copied in and out without client_lock held
+    bufferlist bl;
     if (write) {
-        int w = _write(fh, offset, totallen, NULL, iov, iovcnt);
-        ldout(cct, 3) << "pwritev(" << fd << ", \"...\", " << totallen << ", " << offset << ") = " << w << dendl;
-        return w;
-    } else {
-        bufferlist bl;
-        int r = _read(fh, offset, totallen, &bl);
-        ldout(cct, 3) << "preadv(" << fd << ", " <<  offset << ") = " << r << dendl;
-        int bufoff = 0;
-        for (unsigned j = 0, resid = r; j < iovcnt && resid > 0; j++) {
-               /*
-                * This piece of code aims to handle the case that bufferlist does not have enough data 
-                * to fill in the iov 
-                */
-               if (resid < iov[j].iov_len) {
-                    bl.copy(bufoff, resid, (char *)iov[j].iov_base);
-                    break;
-               } else {
-                    bl.copy(bufoff, iov[j].iov_len, (char *)iov[j].iov_base);
-               }
-               resid -= iov[j].iov_len;
-               bufoff += iov[j].iov_len;
+        for (unsigned i = 0; i < iovcnt; i++) {
+            if (iov[i].iov_len > 0)
+                bl.append((char*)iov[i].iov_base, iov[i].iov_len);
+        }
+    }
+
+    int r;
+    {
+        Mutex::Locker lock(client_lock);
+        tout(cct) << fd << std::endl;
+        tout(cct) << offset << std::endl;
+
+        Fh *fh = get_filehandle(fd);
+        if (!fh)
+            return -EBADF;
+#if defined(__linux__) && defined(O_PATH)
+        if (fh->flags & O_PATH)
+            return -EBADF;
+#endif
+        if (write) {
+            int w = _write(fh, offset, bl);
+            ldout(cct, 3) << "pwritev(" << fd << ", \"...\", " << totallen << ", " << offset << ") = " << w << dendl;
+            return w;
         }
-        return r;  
+        r = _read(fh, offset, totallen, &bl);
+        ldout(cct, 3) << "preadv(" << fd << ", " <<  offset << ") = " << r << dendl;
+    }
+    int bufoff = 0;
+    for (unsigned j = 0, resid = r; j < iovcnt && resid > 0; j++) {
+           /*
+            * This piece of code aims to handle the case that bufferlist does not have enough data 
+            * to fill in the iov 
+            */
+           if (resid < iov[j].iov_len) {
+                bl.copy(bufoff, resid, (char *)iov[j].iov_base);
+                break;
+           } else {
+                bl.copy(bufoff, iov[j].iov_len, (char *)iov[j].iov_base);
+           }
+           resid -= iov[j].iov_len;
+           bufoff += iov[j].iov_len;
     }
+    return r;  
 }
 
-int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf,
-                  const struct iovec *iov, int iovcnt)
+int Client::_write(Fh *f, int64_t offset, bufferlist& bl)
 {
+  uint64_t size = bl.length();
   if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
     return -EFBIG;
 
@@ -7817,24 +7864,6 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf,
     assert(in->inline_version > 0);
   }
 
-  // copy into fresh buffer (since our write may be resub, async)
-  bufferlist bl;
-  bufferptr *bparr = NULL;
-  if (buf) {
-      bufferptr bp;
-      if (size > 0) bp = buffer::copy(buf, size);
-      bl.push_back( bp );
-  } else if (iov){
-      //iov case 
-      bparr = new bufferptr[iovcnt];
-      for (int i = 0; i < iovcnt; i++) {
-        if (iov[i].iov_len > 0) {
-            bparr[i] = buffer::copy((char*)iov[i].iov_base, iov[i].iov_len);
-        }
-        bl.push_back( bparr[i] );
-      }
-  }
-
   utime_t lat;
   uint64_t totalwritten;
   int have;
@@ -7981,7 +8010,6 @@ done:
   }
 
   put_cap_ref(in, CEPH_CAP_FILE_WR);
-  delete[] bparr; 
   return r;
 }
 
@@ -10611,6 +10639,16 @@ int Client::ll_commit_blocks(Inode *in,
 
 int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
 {
+  // copy the data in before taking client_lock
+  bufferlist bl;
+  if (len > 0)
+    bl.append(data, len);
+  return ll_write(fh, off, bl);
+}
+
+int Client::ll_write(Fh *fh, loff_t off, bufferlist& bl)
+{
+  loff_t len = bl.length();
   Mutex::Locker lock(client_lock);
   ldout(cct, 3) << "ll_write " << fh << " " << fh->inode->ino << " " << off <<
     "~" << len << dendl;
@@ -10619,7 +10657,7 @@ int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
   tout(cct) << off << std::endl;
   tout(cct) << len << std::endl;
 
-  int r = _write(fh, off, len, data, NULL, 0);
+  int r = _write(fh, off, bl);
   ldout(cct, 3) << "ll_write " << fh << " " << off << "~" << len << " = " << r
 		<< dendl;
   return r;
@@ -83,6 +83,9 @@ enum {
   l_c_reply,
   l_c_lat,
   l_c_wrlat,
+  l_c_lookup_hit,
+  l_c_lookup_neg_hit,
+  l_c_lookup_miss,
   l_c_last,
 };
 
@@ -729,8 +732,8 @@ private:
 
   loff_t _lseek(Fh *fh, loff_t offset, int whence);
   int _read(Fh *fh, int64_t offset, uint64_t size, bufferlist *bl);
-  int _write(Fh *fh, int64_t offset, uint64_t size, const char *buf,
-          const struct iovec *iov, int iovcnt);
+  /// bl must be our own copy of the data: the write may be resent, or async
+  int _write(Fh *fh, int64_t offset, bufferlist& bl);
   int _preadv_pwritev(int fd, const struct iovec *iov, unsigned iovcnt, int64_t offset, bool write);
   int _flush(Fh *fh);
   int _fsync(Fh *fh, bool syncdataonly);
@@ -1021,6 +1024,8 @@ public:
 
   int ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl);
   int ll_write(Fh *fh, loff_t off, loff_t len, const char *data);
+  /// as above, taking over a bufferlist the caller filled
+  int ll_write(Fh *fh, loff_t off, bufferlist& bl);
   loff_t ll_lseek(Fh *fh, loff_t offset, int whence);
   int ll_flush(Fh *fh);
   int ll_fsync(Fh *fh, bool syncdataonly);
@@ -15,6 +15,8 @@
 #define FUSE_USE_VERSION 30
 
 #include <sys/file.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <signal.h>
@@ -454,10 +456,22 @@ static void fuse_ll_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
   Fh *fh = reinterpret_cast<Fh*>(fi->fh);
   bufferlist bl;
   int r = cfuse->client->ll_read(fh, off, size, &bl);
-  if (r >= 0)
-    fuse_reply_buf(req, bl.c_str(), bl.length());
-  else
+  if (r < 0) {
     fuse_reply_err(req, -r);
+  } else if (bl.buffers().size() > 1 && bl.buffers().size() < IOV_MAX) {
+    // hand the pieces to fuse as they are, rather than flattening them
+    std::vector<struct iovec> iov(bl.buffers().size());
+    int n = 0;
+    for (std::list<bufferptr>::const_iterator p = bl.buffers().begin();
+	 p != bl.buffers().end();
+	 ++p, ++n) {
+      iov[n].iov_base = (void*)p->c_str();
+      iov[n].iov_len = p->length();
+    }
+    fuse_reply_iov(req, &iov[0], n);
+  } else {
+    fuse_reply_buf(req, bl.c_str(), bl.length());
+  }
 }
 
 static void fuse_ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
@@ -472,6 +486,37 @@ static void fuse_ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
     fuse_reply_err(req, -r);
 }
 
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(2, 9)
+static void fuse_ll_write_buf(fuse_req_t req, fuse_ino_t ino,
+			      struct fuse_bufvec *bufv, off_t off,
+			      struct fuse_file_info *fi)
+{
+  CephFuse::Handle *cfuse = (CephFuse::Handle *)fuse_req_userdata(req);
+  Fh *fh = reinterpret_cast<Fh*>(fi->fh);
+
+  // copy (or, with splice_read, move) the data straight into a buffer
+  // the client can keep, instead of into fuse's and then again into ours
+  size_t size = fuse_buf_size(bufv);
+  bufferptr bp = buffer::create(size);
+  struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+  dst.buf[0].mem = bp.c_str();
+  ssize_t n = fuse_buf_copy(&dst, bufv, (enum fuse_buf_copy_flags)0);
+  if (n < 0) {
+    fuse_reply_err(req, -n);
+    return;
+  }
+  bp.set_length(n);
+
+  bufferlist bl;
+  bl.push_back(bp);
+  int r = cfuse->client->ll_write(fh, off, bl);
+  if (r >= 0)
+    fuse_reply_write(req, r);
+  else
+    fuse_reply_err(req, -r);
+}
+#endif
+
 static void fuse_ll_flush(fuse_req_t req, fuse_ino_t ino,
 			  struct fuse_file_info *fi)
 {
@@ -857,7 +902,7 @@ const static struct fuse_lowlevel_ops fuse_ll_oper = {
  poll: 0,
 #endif
 #if FUSE_VERSION >= FUSE_MAKE_VERSION(2, 9)
- write_buf: 0,
+ write_buf: fuse_ll_write_buf,
  retrieve_reply: 0,
  forget_multi: 0,
  flock: fuse_ll_flock,
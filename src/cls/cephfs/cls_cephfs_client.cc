@@ -21,9 +21,8 @@
 #define XATTR_MAX_MTIME "scan_max_mtime"
 #define XATTR_MAX_SIZE "scan_max_size"
 
-int ClsCephFSClient::accumulate_inode_metadata(
-  librados::IoCtx &ctx,
-  inodeno_t inode_no,
+static void build_accumulate_op(
+  librados::ObjectReadOperation *op,
   const uint64_t obj_index,
   const uint64_t obj_size,
   const time_t mtime)
@@ -36,60 +35,95 @@ int ClsCephFSClient::accumulate_inode_metadata(
       XATTR_MAX_MTIME,
       XATTR_MAX_SIZE);
 
+  // Construct a librados operation invoking our class method
+  bufferlist inbl;
+  args.encode(inbl);
+  op->exec("cephfs", "accumulate_inode_metadata", inbl);
+}
+
+int ClsCephFSClient::accumulate_inode_metadata(
+  librados::IoCtx &ctx,
+  inodeno_t inode_no,
+  const uint64_t obj_index,
+  const uint64_t obj_size,
+  const time_t mtime)
+{
   // Generate 0th object name, where we will accumulate sizes/mtimes
   object_t zeroth_object = InodeStore::get_object_name(inode_no, frag_t(), "");
 
-  // Construct a librados operation invoking our class method
   librados::ObjectReadOperation op;
-  bufferlist inbl;
-  args.encode(inbl);
-  op.exec("cephfs", "accumulate_inode_metadata", inbl);
+  build_accumulate_op(&op, obj_index, obj_size, mtime);
 
   // Execute op
   bufferlist outbl;
   return ctx.operate(zeroth_object.name, &op, &outbl);
 }
 
+int ClsCephFSClient::aio_accumulate_inode_metadata(
+  librados::IoCtx &ctx,
+  librados::AioCompletion *c,
+  inodeno_t inode_no,
+  const uint64_t obj_index,
+  const uint64_t obj_size,
+  const time_t mtime)
+{
+  object_t zeroth_object = InodeStore::get_object_name(inode_no, frag_t(), "");
+
+  librados::ObjectReadOperation op;
+  build_accumulate_op(&op, obj_index, obj_size, mtime);
+  return ctx.aio_operate(zeroth_object.name, c, &op, NULL);
+}
+
 int ClsCephFSClient::fetch_inode_accumulate_result(
   librados::IoCtx &ctx,
   const std::string &oid,
   inode_backtrace_t *backtrace,
   ceph_file_layout *layout,
   AccumulateResult *result)
+{
+  std::map<std::string, bufferlist> attrs;
+  int r = ctx.getxattrs(oid, attrs);
+  if (r < 0) {
+    return r;
+  }
+  return decode_inode_accumulate_result(attrs, backtrace, layout, result);
+}
+
+int ClsCephFSClient::decode_inode_accumulate_result(
+  const std::map<std::string, bufferlist> &attrs,
+  inode_backtrace_t *backtrace,
+  ceph_file_layout *layout,
+  AccumulateResult *result)
 {
   assert(backtrace != NULL);
   assert(result != NULL);
 
-  librados::ObjectReadOperation op;
-
-  int scan_ceiling_r = 0;
-  bufferlist scan_ceiling_bl;
-  op.getxattr(XATTR_CEILING, &scan_ceiling_bl, &scan_ceiling_r);
-
-  int scan_max_size_r = 0;
-  bufferlist scan_max_size_bl;
-  op.getxattr(XATTR_MAX_SIZE, &scan_max_size_bl, &scan_max_size_r);
-
-  int scan_max_mtime_r = 0;
-  bufferlist scan_max_mtime_bl;
-  op.getxattr(XATTR_MAX_MTIME, &scan_max_mtime_bl, &scan_max_mtime_r);
+  // The scan xattrs must be there; parent and layout are optional
+  std::map<std::string, bufferlist>::const_iterator scan_ceiling =
+    attrs.find(XATTR_CEILING);
+  std::map<std::string, bufferlist>::const_iterator scan_max_size =
+    attrs.find(XATTR_MAX_SIZE);
+  std::map<std::string, bufferlist>::const_iterator scan_max_mtime =
+    attrs.find(XATTR_MAX_MTIME);
+  if (scan_ceiling == attrs.end() || scan_max_size == attrs.end() ||
+      scan_max_mtime == attrs.end()) {
+    return -ENODATA;
+  }
+  bufferlist scan_ceiling_bl = scan_ceiling->second;
+  bufferlist scan_max_size_bl = scan_max_size->second;
+  bufferlist scan_max_mtime_bl = scan_max_mtime->second;
 
-  int parent_r = 0;
   bufferlist parent_bl;
-  op.getxattr("parent", &parent_bl, &parent_r);
-  op.set_op_flags2(librados::OP_FAILOK);
+  std::map<std::string, bufferlist>::const_iterator p = attrs.find("parent");
+  if (p != attrs.end()) {
+    parent_bl = p->second;
+  }
 
-  int layout_r = 0;
   bufferlist layout_bl;
-  op.getxattr("layout", &layout_bl, &layout_r);
-  op.set_op_flags2(librados::OP_FAILOK);
-
-  bufferlist op_bl;
-  int r = ctx.operate(oid, &op, &op_bl);
-  if (r < 0) {
-    return r;
+  p = attrs.find("layout");
+  if (p != attrs.end()) {
+    layout_bl = p->second;
   }
-
   // Load scan_ceiling
   try {
     bufferlist::iterator scan_ceiling_bl_iter = scan_ceiling_bl.begin();
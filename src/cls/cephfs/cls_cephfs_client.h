@@ -16,11 +16,31 @@ class ClsCephFSClient
       const uint64_t obj_size,
       const time_t mtime);
 
+  /// accumulate_inode_metadata, completing c when done
+  static int aio_accumulate_inode_metadata(
+      librados::IoCtx &ctx,
+      librados::AioCompletion *c,
+      inodeno_t inode_no,
+      const uint64_t obj_index,
+      const uint64_t obj_size,
+      const time_t mtime);
+
   static int fetch_inode_accumulate_result(
       librados::IoCtx &ctx,
       const std::string &oid,
       inode_backtrace_t *backtrace,
       ceph_file_layout *layout,
       AccumulateResult *result);
+
+  /**
+   * What fetch_inode_accumulate_result gets out of the xattrs of a 0th
+   * object, for callers that read them (all of them, getxattrs) by
+   * themselves.
+   */
+  static int decode_inode_accumulate_result(
+      const std::map<std::string, bufferlist> &attrs,
+      inode_backtrace_t *backtrace,
+      ceph_file_layout *layout,
+      AccumulateResult *result);
 };
 
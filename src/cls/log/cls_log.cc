@@ -29,18 +29,6 @@ cls_method_handle_t h_log_info;
 static string log_index_prefix = "1_";
 
 
-static int write_log_entry(cls_method_context_t hctx, string& index, cls_log_entry& entry)
-{
-  bufferlist bl;
-  ::encode(entry, bl);
-
-  int ret = cls_cxx_map_set_val(hctx, index, &bl);
-  if (ret < 0)
-    return ret;
-
-  return 0;
-}
-
 static void get_index_time_prefix(utime_t& ts, string& index)
 {
   char buf[32];
@@ -113,8 +101,10 @@ static int cls_log_add(cls_method_context_t hctx, bufferlist *in, bufferlist *ou
   if (ret < 0)
     return ret;
 
+  map<string, bufferlist> vals;
+  unsigned seq = 0;
   for (list<cls_log_entry>::iterator iter = op.entries.begin();
-       iter != op.entries.end(); ++iter) {
+       iter != op.entries.end(); ++iter, ++seq) {
     cls_log_entry& entry = *iter;
 
     string index;
@@ -126,19 +116,28 @@ static int cls_log_add(cls_method_context_t hctx, bufferlist *in, bufferlist *ou
       header.max_time = timestamp;
 
     get_index(hctx, timestamp, index);
+    if (seq > 0) {
+      /* entries of one call share the op version and often the time;
+       * keep them apart, in order */
+      char buf[16];
+      snprintf(buf, sizeof(buf), "_%06u", seq);
+      index.append(buf);
+    }
 
-    CLS_LOG(0, "storing entry at %s", index.c_str());
+    CLS_LOG(20, "storing entry at %s", index.c_str());
 
     entry.id = index;
 
     if (index > header.max_marker)
       header.max_marker = index;
 
-    ret = write_log_entry(hctx, index, entry);
-    if (ret < 0)
-      return ret;
+    ::encode(entry, vals[index]);
   }
 
+  ret = cls_cxx_map_set_vals(hctx, &vals);
+  if (ret < 0)
+    return ret;
+
   ret = write_header(hctx, header);
   if (ret < 0)
     return ret;
@@ -260,7 +259,7 @@ static int cls_log_trim(cls_method_context_t hctx, bufferlist *in, bufferlist *o
   map<string, bufferlist>::iterator iter = keys.begin();
 
   size_t i;
-  bool removed = false;
+  set<string> to_remove;
   for (i = 0; i < max_entries && iter != keys.end(); ++i, ++iter) {
     const string& index = iter->first;
 
@@ -270,18 +269,19 @@ static int cls_log_trim(cls_method_context_t hctx, bufferlist *in, bufferlist *o
       break;
 
     CLS_LOG(20, "removing key: index=%s", index.c_str());
-
-    int rc = cls_cxx_map_remove_key(hctx, index);
-    if (rc < 0) {
-      CLS_LOG(1, "ERROR: cls_cxx_map_remove_key failed rc=%d", rc);
-      return -EINVAL;
-    }
-    removed = true;
+    to_remove.insert(to_remove.end(), index);
   }
 
-  if (!removed)
+  if (to_remove.empty())
     return -ENODATA;
 
+  // one omap op for the whole chunk rather than one per key
+  rc = cls_cxx_map_remove_keys(hctx, to_remove);
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: cls_cxx_map_remove_keys failed rc=%d", rc);
+    return -EINVAL;
+  }
+
   return 0;
 }
 
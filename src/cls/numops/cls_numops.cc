@@ -23,6 +23,7 @@
 #include <errno.h>
 #include <iostream>
 #include <map>
+#include <set>
 #include <string>
 #include <sstream>
 #include <cstdio>
@@ -36,6 +37,11 @@ CLS_NAME(numops)
 cls_handle_t h_class;
 cls_method_handle_t h_add;
 cls_method_handle_t h_mul;
+cls_method_handle_t h_add_many;
+cls_method_handle_t h_mul_many;
+cls_method_handle_t h_filter;
+
+#define FILTER_MAX_KEYS 1000
 
 static int add(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
@@ -147,6 +153,151 @@ static int mul(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
   return cls_cxx_map_set_val(hctx, key, &new_value);
 }
 
+static int parse_number(const std::string& str, double *value)
+{
+  char *end_ptr = 0;
+  *value = strtod(str.c_str(), &end_ptr);
+  if (end_ptr && *end_ptr != '\0')
+    return -EINVAL;
+  return 0;
+}
+
+static void format_number(double value, bufferlist *bl)
+{
+  std::stringstream stream;
+  stream << std::setprecision(DECIMAL_PRECISION) << value;
+  bl->append(stream.str());
+}
+
+/*
+ * add or multiply many keys in one call: the input is a map from key to
+ * operand, and either every key is updated or, if an operand or a stored
+ * value does not parse, none is.
+ */
+static int update_many(cls_method_context_t hctx, bufferlist *in,
+                       bool multiply)
+{
+  const char *name = multiply ? "mul_many" : "add_many";
+  std::map<std::string, std::string> operands;
+
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(operands, iter);
+  } catch (const buffer::error &err) {
+    CLS_LOG(20, "%s: invalid decode of input", name);
+    return -EINVAL;
+  }
+
+  std::set<std::string> keys;
+  for (std::map<std::string, std::string>::iterator it = operands.begin();
+       it != operands.end(); ++it) {
+    keys.insert(it->first);
+  }
+
+  std::map<std::string, bufferlist> stored;
+  int ret = cls_cxx_map_get_vals_by_keys(hctx, keys, &stored);
+  if (ret < 0 && ret != -ENOENT) {
+    CLS_ERR("%s: error reading omap: %d", name, ret);
+    return ret;
+  }
+
+  std::map<std::string, bufferlist> updated;
+  for (std::map<std::string, std::string>::iterator it = operands.begin();
+       it != operands.end(); ++it) {
+    double operand;
+    if (parse_number(it->second, &operand) < 0) {
+      CLS_ERR("%s: invalid input value: %s", name, it->second.c_str());
+      return -EINVAL;
+    }
+
+    double value = 0;
+    std::map<std::string, bufferlist>::iterator s = stored.find(it->first);
+    if (s != stored.end() && s->second.length() > 0) {
+      std::string stored_value(s->second.c_str(), s->second.length());
+      if (parse_number(stored_value, &value) < 0) {
+        CLS_ERR("%s: invalid stored value: %s", name, stored_value.c_str());
+        return -EBADMSG;
+      }
+    }
+
+    if (multiply)
+      value *= operand;
+    else
+      value += operand;
+    format_number(value, &updated[it->first]);
+  }
+
+  return cls_cxx_map_set_vals(hctx, &updated);
+}
+
+static int add_many(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  return update_many(hctx, in, false);
+}
+
+static int mul_many(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  return update_many(hctx, in, true);
+}
+
+/*
+ * return the values of up to max_keys keys after start_after that start
+ * with prefix and lie within [min, max], along with their sum, so that
+ * a caller can aggregate many counters without reading them all back.
+ * Values that do not parse are skipped.  The output ends with the last
+ * key looked at and whether there are more to look at.
+ */
+static int filter(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  std::string prefix, start_after;
+  uint64_t max_keys;
+  double min, max;
+
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(prefix, iter);
+    ::decode(start_after, iter);
+    ::decode(max_keys, iter);
+    ::decode(min, iter);
+    ::decode(max, iter);
+  } catch (const buffer::error &err) {
+    CLS_LOG(20, "filter: invalid decode of input");
+    return -EINVAL;
+  }
+
+  if (max_keys == 0 || max_keys > FILTER_MAX_KEYS)
+    max_keys = FILTER_MAX_KEYS;
+
+  std::map<std::string, bufferlist> vals;
+  int ret = cls_cxx_map_get_vals(hctx, start_after, prefix, max_keys + 1,
+                                 &vals);
+  if (ret < 0)
+    return ret;
+
+  bool truncated = vals.size() > max_keys;
+  std::map<std::string, double> matches;
+  double sum = 0;
+  std::string last_key = start_after;
+  uint64_t n = 0;
+  for (std::map<std::string, bufferlist>::iterator it = vals.begin();
+       it != vals.end() && n < max_keys; ++it, ++n) {
+    last_key = it->first;
+    double value;
+    std::string stored_value(it->second.c_str(), it->second.length());
+    if (parse_number(stored_value, &value) < 0 ||
+        value < min || value > max)
+      continue;
+    matches[it->first] = value;
+    sum += value;
+  }
+
+  ::encode(matches, *out);
+  ::encode(sum, *out);
+  ::encode(last_key, *out);
+  ::encode(truncated, *out);
+  return 0;
+}
+
 void __cls_init()
 {
   CLS_LOG(20, "loading cls_numops");
@@ -160,4 +311,16 @@ void __cls_init()
   cls_register_cxx_method(h_class, "mul",
                           CLS_METHOD_RD | CLS_METHOD_WR,
                           mul, &h_mul);
+
+  cls_register_cxx_method(h_class, "add_many",
+                          CLS_METHOD_RD | CLS_METHOD_WR,
+                          add_many, &h_add_many);
+
+  cls_register_cxx_method(h_class, "mul_many",
+                          CLS_METHOD_RD | CLS_METHOD_WR,
+                          mul_many, &h_mul_many);
+
+  cls_register_cxx_method(h_class, "filter",
+                          CLS_METHOD_RD,
+                          filter, &h_filter);
 }
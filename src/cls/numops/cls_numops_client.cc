@@ -75,6 +75,73 @@ namespace rados {
         return mul(ioctx, oid, key, 1 / value_to_divide);
       }
 
+      static int update_many(librados::IoCtx *ioctx,
+                             const std::string& oid,
+                             const char *method,
+                             const std::map<std::string, double>& values)
+      {
+        std::map<std::string, std::string> operands;
+        for (std::map<std::string, double>::const_iterator it = values.begin();
+             it != values.end(); ++it) {
+          std::stringstream stream;
+          stream << it->second;
+          operands[it->first] = stream.str();
+        }
+
+        bufferlist in, out;
+        ::encode(operands, in);
+
+        return ioctx->exec(oid, "numops", method, in, out);
+      }
+
+      int add_many(librados::IoCtx *ioctx,
+                   const std::string& oid,
+                   const std::map<std::string, double>& values_to_add)
+      {
+        return update_many(ioctx, oid, "add_many", values_to_add);
+      }
+
+      int mul_many(librados::IoCtx *ioctx,
+                   const std::string& oid,
+                   const std::map<std::string, double>& values_to_multiply)
+      {
+        return update_many(ioctx, oid, "mul_many", values_to_multiply);
+      }
+
+      int filter(librados::IoCtx *ioctx,
+                 const std::string& oid,
+                 const std::string& prefix,
+                 const std::string& start_after,
+                 uint64_t max_keys,
+                 double min, double max,
+                 std::map<std::string, double> *values,
+                 double *sum,
+                 std::string *last_key,
+                 bool *truncated)
+      {
+        bufferlist in, out;
+        ::encode(prefix, in);
+        ::encode(start_after, in);
+        ::encode(max_keys, in);
+        ::encode(min, in);
+        ::encode(max, in);
+
+        int r = ioctx->exec(oid, "numops", "filter", in, out);
+        if (r < 0)
+          return r;
+
+        try {
+          bufferlist::iterator iter = out.begin();
+          ::decode(*values, iter);
+          ::decode(*sum, iter);
+          ::decode(*last_key, iter);
+          ::decode(*truncated, iter);
+        } catch (const buffer::error &err) {
+          return -EBADMSG;
+        }
+        return 0;
+      }
+
     } // namespace numops
   } // namespace cls
 } // namespace rados
@@ -17,6 +17,9 @@
 
 #include "include/rados/librados.hpp"
 
+#include <map>
+#include <string>
+
 namespace rados {
   namespace cls {
     namespace numops {
@@ -41,6 +44,33 @@ namespace rados {
                      const std::string& key,
                      double value_to_divide);
 
+      /// add each value to its key, all in one update
+      extern int add_many(librados::IoCtx *ioctx,
+                          const std::string& oid,
+                          const std::map<std::string, double>& values_to_add);
+
+      /// multiply each key by its value, all in one update
+      extern int mul_many(librados::IoCtx *ioctx,
+                          const std::string& oid,
+                          const std::map<std::string, double>& values_to_multiply);
+
+      /**
+       * look at up to max_keys keys after start_after that start with
+       * prefix, and return those whose value is within [min, max] and
+       * the sum of those values.  last_key is where the next call should
+       * start; truncated says whether there are keys left to look at.
+       */
+      extern int filter(librados::IoCtx *ioctx,
+                        const std::string& oid,
+                        const std::string& prefix,
+                        const std::string& start_after,
+                        uint64_t max_keys,
+                        double min, double max,
+                        std::map<std::string, double> *values,
+                        double *sum,
+                        std::string *last_key,
+                        bool *truncated);
+
     } // namespace numops
   } // namespace cls
 } // namespace rados
@@ -421,6 +421,19 @@ namespace librbd {
 		      std::vector<parent_info> *parents,
 		      std::vector<uint8_t> *protection_statuses)
     {
+      return snapshot_list(ioctx, oid, ids, std::vector<bool>(ids.size()),
+			   names, sizes, parents, protection_statuses);
+    }
+
+    int snapshot_list(librados::IoCtx *ioctx, const std::string &oid,
+		      const std::vector<snapid_t> &ids,
+		      const std::vector<bool> &known,
+		      std::vector<string> *names,
+		      std::vector<uint64_t> *sizes,
+		      std::vector<parent_info> *parents,
+		      std::vector<uint8_t> *protection_statuses)
+    {
+      assert(known.size() == ids.size());
       names->clear();
       names->resize(ids.size());
       sizes->clear();
@@ -431,16 +444,17 @@ namespace librbd {
       protection_statuses->resize(ids.size());
 
       librados::ObjectReadOperation op;
-      for (vector<snapid_t>::const_iterator it = ids.begin();
-	   it != ids.end(); ++it) {
-	snapid_t snap_id = it->val;
+      for (size_t i = 0; i < ids.size(); ++i) {
+	snapid_t snap_id = ids[i].val;
 	bufferlist bl1, bl2, bl3, bl4;
-	::encode(snap_id, bl1);
-	op.exec("rbd", "get_snapshot_name", bl1);
-	::encode(snap_id, bl2);
-	op.exec("rbd", "get_size", bl2);
-	::encode(snap_id, bl3);
-	op.exec("rbd", "get_parent", bl3);
+	if (!known[i]) {
+	  ::encode(snap_id, bl1);
+	  op.exec("rbd", "get_snapshot_name", bl1);
+	  ::encode(snap_id, bl2);
+	  op.exec("rbd", "get_size", bl2);
+	  ::encode(snap_id, bl3);
+	  op.exec("rbd", "get_parent", bl3);
+	}
 	::encode(snap_id, bl4);
 	op.exec("rbd", "get_protection_status", bl4);
       }
@@ -453,17 +467,19 @@ namespace librbd {
       try {
 	bufferlist::iterator iter = outbl.begin();
 	for (size_t i = 0; i < ids.size(); ++i) {
-	  uint8_t order;
-	  // get_snapshot_name
-	  ::decode((*names)[i], iter);
-	  // get_size
-	  ::decode(order, iter);
-	  ::decode((*sizes)[i], iter);
-	  // get_parent
-	  ::decode((*parents)[i].spec.pool_id, iter);
-	  ::decode((*parents)[i].spec.image_id, iter);
-	  ::decode((*parents)[i].spec.snap_id, iter);
-	  ::decode((*parents)[i].overlap, iter);
+	  if (!known[i]) {
+	    uint8_t order;
+	    // get_snapshot_name
+	    ::decode((*names)[i], iter);
+	    // get_size
+	    ::decode(order, iter);
+	    ::decode((*sizes)[i], iter);
+	    // get_parent
+	    ::decode((*parents)[i].spec.pool_id, iter);
+	    ::decode((*parents)[i].spec.image_id, iter);
+	    ::decode((*parents)[i].spec.snap_id, iter);
+	    ::decode((*parents)[i].overlap, iter);
+	  }
 	  // get_protection_status
 	  ::decode((*protection_statuses)[i], iter);
 	}
@@ -78,6 +78,18 @@ namespace librbd {
 		      std::vector<uint64_t> *sizes,
 		      std::vector<parent_info> *parents,
 		      std::vector<uint8_t> *protection_statuses);
+    /**
+     * Like snapshot_list, but for the ids flagged in known only the
+     * protection status is fetched: the name, size and parent of a
+     * snapshot never change, so the caller can keep what it has.
+     */
+    int snapshot_list(librados::IoCtx *ioctx, const std::string &oid,
+		      const std::vector<snapid_t> &ids,
+		      const std::vector<bool> &known,
+		      std::vector<string> *names,
+		      std::vector<uint64_t> *sizes,
+		      std::vector<parent_info> *parents,
+		      std::vector<uint8_t> *protection_statuses);
     int copyup(librados::IoCtx *ioctx, const std::string &oid,
 	       bufferlist data);
     int get_protection_status(librados::IoCtx *ioctx, const std::string &oid,
@@ -30,6 +30,7 @@ cls_method_handle_t h_rgw_bucket_check_index;
 cls_method_handle_t h_rgw_bucket_rebuild_index;
 cls_method_handle_t h_rgw_bucket_prepare_op;
 cls_method_handle_t h_rgw_bucket_complete_op;
+cls_method_handle_t h_rgw_bucket_complete_ops;
 cls_method_handle_t h_rgw_bucket_link_olh;
 cls_method_handle_t h_rgw_bucket_unlink_instance_op;
 cls_method_handle_t h_rgw_bucket_read_olh_log;
@@ -137,10 +138,99 @@ static void bi_log_index_key(cls_method_context_t hctx, string& key, string& id,
   key.append(id);
 }
 
+/*
+ * index updates buffered across the ops of one call
+ *
+ * Reads see what earlier ops of the call wrote; everything goes out in
+ * one omap write (and one removal) at flush().  Keys fetched by
+ * prefetch() are answered without another omap read.
+ */
+struct index_batch {
+  map<string, bufferlist> vals;    // written, or prefetched
+  set<string> removed;             // removed, or known to be absent
+  map<string, bufferlist> dirty;   // to write out
+  set<string> to_remove;           // to remove
+
+  int prefetch(cls_method_context_t hctx, const set<string>& keys) {
+    if (keys.empty())
+      return 0;
+    int rc = cls_cxx_map_get_vals_by_keys(hctx, keys, &vals);
+    if (rc < 0)
+      return rc;
+    for (set<string>::const_iterator i = keys.begin(); i != keys.end(); ++i) {
+      if (!vals.count(*i))
+        removed.insert(*i);
+    }
+    return 0;
+  }
+
+  int get_val(cls_method_context_t hctx, const string& key, bufferlist *bl) {
+    if (removed.count(key))
+      return -ENOENT;
+    map<string, bufferlist>::iterator i = vals.find(key);
+    if (i != vals.end()) {
+      *bl = i->second;
+      return 0;
+    }
+    return cls_cxx_map_get_val(hctx, key, bl);
+  }
+
+  void set_val(const string& key, bufferlist& bl) {
+    vals[key] = bl;
+    dirty[key] = bl;
+    removed.erase(key);
+    to_remove.erase(key);
+  }
+
+  void remove_key(const string& key) {
+    vals.erase(key);
+    dirty.erase(key);
+    removed.insert(key);
+    to_remove.insert(key);
+  }
+
+  int flush(cls_method_context_t hctx) {
+    if (!to_remove.empty()) {
+      int rc = cls_cxx_map_remove_keys(hctx, to_remove);
+      if (rc < 0)
+        return rc;
+    }
+    if (!dirty.empty())
+      return cls_cxx_map_set_vals(hctx, &dirty);
+    return 0;
+  }
+};
+
+static int index_get_val(cls_method_context_t hctx, index_batch *batch, const string& key, bufferlist *bl)
+{
+  if (batch)
+    return batch->get_val(hctx, key, bl);
+  return cls_cxx_map_get_val(hctx, key, bl);
+}
+
+static int index_set_val(cls_method_context_t hctx, index_batch *batch, const string& key, bufferlist& bl)
+{
+  if (batch) {
+    batch->set_val(key, bl);
+    return 0;
+  }
+  return cls_cxx_map_set_val(hctx, key, &bl);
+}
+
+static int index_remove_key(cls_method_context_t hctx, index_batch *batch, const string& key)
+{
+  if (batch) {
+    batch->remove_key(key);
+    return 0;
+  }
+  return cls_cxx_map_remove_key(hctx, key);
+}
+
 static int log_index_operation(cls_method_context_t hctx, cls_rgw_obj_key& obj_key, RGWModifyOp op,
                                string& tag, utime_t& timestamp,
                                rgw_bucket_entry_ver& ver, RGWPendingState state, uint64_t index_ver,
-                               string& max_marker, uint16_t bilog_flags)
+                               string& max_marker, uint16_t bilog_flags,
+                               index_batch *batch = NULL)
 {
   bufferlist bl;
 
@@ -164,7 +254,7 @@ static int log_index_operation(cls_method_context_t hctx, cls_rgw_obj_key& obj_k
   if (entry.id > max_marker)
     max_marker = entry.id;
 
-  return cls_cxx_map_set_val(hctx, key, &bl);
+  return index_set_val(hctx, batch, key, bl);
 }
 
 /*
@@ -299,7 +389,8 @@ static void encode_olh_data_key(const cls_rgw_obj_key& key, string *index_key)
 }
 
 template <class T>
-static int read_index_entry(cls_method_context_t hctx, string& name, T *entry);
+static int read_index_entry(cls_method_context_t hctx, string& name, T *entry,
+                            index_batch *batch = NULL);
 
 static int encode_list_index_key(cls_method_context_t hctx, const cls_rgw_obj_key& key, string *index_key)
 {
@@ -627,7 +718,7 @@ int rgw_bucket_set_tag_timeout(cls_method_context_t hctx, bufferlist *in, buffer
 }
 
 static int read_key_entry(cls_method_context_t hctx, cls_rgw_obj_key& key, string *idx, struct rgw_bucket_dir_entry *entry,
-                          bool special_delete_marker_name = false);
+                          bool special_delete_marker_name = false, index_batch *batch = NULL);
 
 int rgw_bucket_prepare_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
@@ -722,10 +813,11 @@ static void log_entry(const char *func, const char *str, struct rgw_bucket_olh_e
 }
 
 template <class T>
-static int read_index_entry(cls_method_context_t hctx, string& name, T *entry)
+static int read_index_entry(cls_method_context_t hctx, string& name, T *entry,
+                            index_batch *batch)
 {
   bufferlist current_entry;
-  int rc = cls_cxx_map_get_val(hctx, name, &current_entry);
+  int rc = index_get_val(hctx, batch, name, &current_entry);
   if (rc < 0) {
     return rc;
   }
@@ -743,10 +835,10 @@ static int read_index_entry(cls_method_context_t hctx, string& name, T *entry)
 }
 
 static int read_key_entry(cls_method_context_t hctx, cls_rgw_obj_key& key, string *idx, struct rgw_bucket_dir_entry *entry,
-                          bool special_delete_marker_name)
+                          bool special_delete_marker_name, index_batch *batch)
 {
   encode_obj_index_key(key, idx);
-  int rc = read_index_entry(hctx, *idx, entry);
+  int rc = read_index_entry(hctx, *idx, entry, batch);
   if (rc < 0) {
     return rc;
   }
@@ -758,13 +850,13 @@ static int read_key_entry(cls_method_context_t hctx, cls_rgw_obj_key& key, strin
      */
     if (special_delete_marker_name) {
       encode_obj_versioned_data_key(key, idx, true);
-      rc = read_index_entry(hctx, *idx, entry);
+      rc = read_index_entry(hctx, *idx, entry, batch);
       if (rc == 0) {
         return 0;
       }
     }
     encode_obj_versioned_data_key(key, idx);
-    rc = read_index_entry(hctx, *idx, entry);
+    rc = read_index_entry(hctx, *idx, entry, batch);
     if (rc < 0) {
       *entry = rgw_bucket_dir_entry(); /* need to reset entry because we initialized it earlier */
       return rc;
@@ -774,34 +866,27 @@ static int read_key_entry(cls_method_context_t hctx, cls_rgw_obj_key& key, strin
   return 0;
 }
 
-int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+/*
+ * complete one pending index operation against header
+ *
+ * When batch is set, index reads and writes go through it (see
+ * rgw_bucket_complete_ops()); otherwise they hit the omap directly.
+ * *dirty tells whether header needs to be written back.
+ */
+static int complete_op(cls_method_context_t hctx, struct rgw_bucket_dir_header& header,
+                       rgw_cls_obj_complete_op& op, bool *dirty, index_batch *batch)
 {
-  // decode request
-  rgw_cls_obj_complete_op op;
-  bufferlist::iterator iter = in->begin();
-  try {
-    ::decode(op, iter);
-  } catch (buffer::error& err) {
-    CLS_LOG(1, "ERROR: rgw_bucket_complete_op(): failed to decode request\n");
-    return -EINVAL;
-  }
   CLS_LOG(1, "rgw_bucket_complete_op(): request: op=%d name=%s instance=%s ver=%lu:%llu tag=%s\n",
           op.op, op.key.name.c_str(), op.key.instance.c_str(),
           (unsigned long)op.ver.pool, (unsigned long long)op.ver.epoch,
           op.tag.c_str());
 
-  struct rgw_bucket_dir_header header;
-  int rc = read_bucket_header(hctx, &header);
-  if (rc < 0) {
-    CLS_LOG(1, "ERROR: rgw_bucket_complete_op(): failed to read header\n");
-    return -EINVAL;
-  }
-
+  *dirty = false;
   struct rgw_bucket_dir_entry entry;
   bool ondisk = true;
 
   string idx;
-  rc = read_key_entry(hctx, op.key, &idx, &entry);
+  int rc = read_key_entry(hctx, op.key, &idx, &entry, false, batch);
   if (rc == -ENOENT) {
     entry.key = op.key;
     entry.ver = op.ver;
@@ -840,7 +925,8 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
   if (cancel) {
     if (op.log_op) {
       rc = log_index_operation(hctx, op.key, op.op, op.tag, entry.meta.mtime, entry.ver,
-                               CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags);
+                               CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags,
+                               batch);
       if (rc < 0)
         return rc;
     }
@@ -848,7 +934,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     if (op.tag.size()) {
       bufferlist new_key_bl;
       ::encode(entry, new_key_bl);
-      return cls_cxx_map_set_val(hctx, idx, &new_key_bl);
+      return index_set_val(hctx, batch, idx, new_key_bl);
     } else {
       return 0;
     }
@@ -863,14 +949,14 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
   case CLS_RGW_OP_DEL:
     if (ondisk) {
       if (!entry.pending_map.size()) {
-	int ret = cls_cxx_map_remove_key(hctx, idx);
+	int ret = index_remove_key(hctx, batch, idx);
 	if (ret < 0)
 	  return ret;
       } else {
         entry.exists = false;
         bufferlist new_key_bl;
         ::encode(entry, new_key_bl);
-	int ret = cls_cxx_map_set_val(hctx, idx, &new_key_bl);
+	int ret = index_set_val(hctx, batch, idx, new_key_bl);
 	if (ret < 0)
 	  return ret;
       }
@@ -891,16 +977,19 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
       stats.total_size_rounded += get_rounded_size(meta.accounted_size);
       bufferlist new_key_bl;
       ::encode(entry, new_key_bl);
-      int ret = cls_cxx_map_set_val(hctx, idx, &new_key_bl);
+      int ret = index_set_val(hctx, batch, idx, new_key_bl);
       if (ret < 0)
 	return ret;
     }
     break;
   }
 
+  *dirty = true;
+
   if (op.log_op) {
     rc = log_index_operation(hctx, op.key, op.op, op.tag, entry.meta.mtime, entry.ver,
-                             CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags);
+                             CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags,
+                             batch);
     if (rc < 0)
       return rc;
   }
@@ -913,7 +1002,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
             remove_key.name.c_str(), remove_key.instance.c_str());
     struct rgw_bucket_dir_entry remove_entry;
     string k;
-    int ret = read_key_entry(hctx, remove_key, &k, &remove_entry);
+    int ret = read_key_entry(hctx, remove_key, &k, &remove_entry, false, batch);
     if (ret < 0) {
       CLS_LOG(1, "rgw_bucket_complete_op(): removing entries, read_index_entry name=%s instance=%s ret=%d\n",
             remove_key.name.c_str(), remove_key.instance.c_str(), ret);
@@ -925,21 +1014,114 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
 
     if (op.log_op) {
       rc = log_index_operation(hctx, remove_key, CLS_RGW_OP_DEL, op.tag, remove_entry.meta.mtime,
-                               remove_entry.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags);
+                               remove_entry.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags,
+                               batch);
       if (rc < 0)
         continue;
     }
 
-    ret = cls_cxx_map_remove_key(hctx, k);
+    ret = index_remove_key(hctx, batch, k);
     if (ret < 0) {
       CLS_LOG(1, "rgw_bucket_complete_op(): cls_cxx_map_remove_key, failed to remove entry, name=%s instance=%s read_index_entry ret=%d\n", remove_key.name.c_str(), remove_key.instance.c_str(), rc);
       continue;
     }
   }
 
+  return 0;
+}
+
+int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  // decode request
+  rgw_cls_obj_complete_op op;
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: rgw_bucket_complete_op(): failed to decode request\n");
+    return -EINVAL;
+  }
+
+  struct rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: rgw_bucket_complete_op(): failed to read header\n");
+    return -EINVAL;
+  }
+
+  bool dirty;
+  rc = complete_op(hctx, header, op, &dirty, NULL);
+  if (rc < 0 || !dirty)
+    return rc;
+
   return write_bucket_header(hctx, &header);
 }
 
+/*
+ * complete many pending operations on one index shard in one call
+ *
+ * The entries of all ops are fetched with a single omap read, index
+ * updates are buffered (so later ops see what earlier ones did) and
+ * written out together with the header at the end.  An op that fails
+ * is logged and skipped; complete_op() only fails before it touches
+ * the batch or the header.
+ */
+int rgw_bucket_complete_ops(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  // decode request
+  rgw_cls_obj_complete_ops op;
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: rgw_bucket_complete_ops(): failed to decode request\n");
+    return -EINVAL;
+  }
+
+  struct rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: rgw_bucket_complete_ops(): failed to read header\n");
+    return -EINVAL;
+  }
+
+  index_batch batch;
+  set<string> keys;
+  for (list<rgw_cls_obj_complete_op>::iterator i = op.ops.begin(); i != op.ops.end(); ++i) {
+    string idx;
+    encode_obj_index_key(i->key, &idx);
+    keys.insert(idx);
+    for (list<cls_rgw_obj_key>::iterator r = i->remove_objs.begin(); r != i->remove_objs.end(); ++r) {
+      encode_obj_index_key(*r, &idx);
+      keys.insert(idx);
+    }
+  }
+  rc = batch.prefetch(hctx, keys);
+  if (rc < 0)
+    return rc;
+
+  for (list<rgw_cls_obj_complete_op>::iterator i = op.ops.begin(); i != op.ops.end(); ++i) {
+    bool dirty;
+    rc = complete_op(hctx, header, *i, &dirty, &batch);
+    if (rc < 0) {
+      CLS_LOG(1, "rgw_bucket_complete_ops(): op on name=%s instance=%s failed, rc=%d\n",
+              i->key.name.c_str(), i->key.instance.c_str(), rc);
+      continue;
+    }
+    // as if the header was written out after each op: the bilog keys
+    // of the following ops must not collide with this one's
+    header.ver++;
+  }
+
+  rc = batch.flush(hctx);
+  if (rc < 0)
+    return rc;
+
+  bufferlist header_bl;
+  ::encode(header, header_bl);
+  return cls_cxx_map_write_header(hctx, &header_bl);
+}
+
 template <class T>
 static int write_entry(cls_method_context_t hctx, T& entry, const string& key)
 {
@@ -3068,6 +3250,7 @@ void __cls_init()
   cls_register_cxx_method(h_class, "bucket_rebuild_index", CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_rebuild_index, &h_rgw_bucket_rebuild_index);
   cls_register_cxx_method(h_class, "bucket_prepare_op", CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_prepare_op, &h_rgw_bucket_prepare_op);
   cls_register_cxx_method(h_class, "bucket_complete_op", CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_complete_op, &h_rgw_bucket_complete_op);
+  cls_register_cxx_method(h_class, "bucket_complete_ops", CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_complete_ops, &h_rgw_bucket_complete_ops);
   cls_register_cxx_method(h_class, "bucket_link_olh", CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_link_olh, &h_rgw_bucket_link_olh);
   cls_register_cxx_method(h_class, "bucket_unlink_instance", CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_unlink_instance, &h_rgw_bucket_unlink_instance_op);
   cls_register_cxx_method(h_class, "bucket_read_olh_log", CLS_METHOD_RD, rgw_bucket_read_olh_log, &h_rgw_bucket_read_olh_log);
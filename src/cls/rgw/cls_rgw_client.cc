@@ -177,6 +177,16 @@ void cls_rgw_bucket_complete_op(ObjectWriteOperation& o, RGWModifyOp op, string&
   o.exec("rgw", "bucket_complete_op", in);
 }
 
+void cls_rgw_bucket_complete_ops(ObjectWriteOperation& o,
+                                 list<rgw_cls_obj_complete_op>& ops)
+{
+  bufferlist in;
+  struct rgw_cls_obj_complete_ops call;
+  call.ops.swap(ops);
+  ::encode(call, in);
+  o.exec("rgw", "bucket_complete_ops", in);
+}
+
 static bool issue_bucket_list_op(librados::IoCtx& io_ctx,
     const string& oid, const cls_rgw_obj_key& start_obj, const string& filter_prefix,
     uint32_t num_entries, bool list_versions, BucketIndexAioManager *manager,
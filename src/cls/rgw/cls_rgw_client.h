@@ -314,6 +314,10 @@ void cls_rgw_bucket_complete_op(librados::ObjectWriteOperation& o, RGWModifyOp o
 				list<cls_rgw_obj_key> *remove_objs, bool log_op,
                                 uint16_t bilog_op);
 
+/* complete several pending operations on one index shard in one call */
+void cls_rgw_bucket_complete_ops(librados::ObjectWriteOperation& o,
+                                 list<rgw_cls_obj_complete_op>& ops);
+
 void cls_rgw_remove_obj(librados::ObjectWriteOperation& o, list<string>& keep_attr_prefixes);
 void cls_rgw_obj_check_attrs_prefix(librados::ObjectOperation& o, const string& prefix, bool fail_if_exist);
 
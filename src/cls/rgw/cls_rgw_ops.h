@@ -155,6 +155,27 @@ struct rgw_cls_obj_complete_op
 };
 WRITE_CLASS_ENCODER(rgw_cls_obj_complete_op)
 
+struct rgw_cls_obj_complete_ops
+{
+  list<rgw_cls_obj_complete_op> ops;
+
+  rgw_cls_obj_complete_ops() {}
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(ops, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    ::decode(ops, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<rgw_cls_obj_complete_ops*>& o);
+};
+WRITE_CLASS_ENCODER(rgw_cls_obj_complete_ops)
+
 struct rgw_cls_link_olh_op {
   cls_rgw_obj_key key;
   string olh_tag;
@@ -29,18 +29,6 @@ static string statelog_index_by_client_prefix = "1_";
 static string statelog_index_by_object_prefix = "2_";
 
 
-static int write_statelog_entry(cls_method_context_t hctx, const string& index, const cls_statelog_entry& entry)
-{
-  bufferlist bl;
-  ::encode(entry, bl);
-
-  int ret = cls_cxx_map_set_val(hctx, index, &bl);
-  if (ret < 0)
-    return ret;
-
-  return 0;
-}
-
 static void get_index_by_client(const string& client_id, const string& op_id, string& index)
 {
   index = statelog_index_by_client_prefix;
@@ -118,32 +106,31 @@ static int cls_statelog_add(cls_method_context_t hctx, bufferlist *in, bufferlis
     return -EINVAL;
   }
 
+  // both indexes of every entry go in with a single omap update
+  map<string, bufferlist> vals;
   for (list<cls_statelog_entry>::iterator iter = op.entries.begin();
        iter != op.entries.end(); ++iter) {
     cls_statelog_entry& entry = *iter;
 
+    bufferlist bl;
+    ::encode(entry, bl);
+
     string index_by_client;
 
     get_index_by_client(entry, index_by_client);
 
-    CLS_LOG(0, "storing entry by client/op at %s", index_by_client.c_str());
-
-    int ret = write_statelog_entry(hctx, index_by_client, entry);
-    if (ret < 0)
-      return ret;
+    CLS_LOG(20, "storing entry by client/op at %s", index_by_client.c_str());
+    vals[index_by_client] = bl;
 
     string index_by_obj;
 
     get_index_by_object(entry, index_by_obj);
 
-    CLS_LOG(0, "storing entry by object at %s", index_by_obj.c_str());
-    ret = write_statelog_entry(hctx, index_by_obj, entry);
-    if (ret < 0)
-      return ret;
-
+    CLS_LOG(20, "storing entry by object at %s", index_by_obj.c_str());
+    vals[index_by_obj] = bl;
   }
-  
-  return 0;
+
+  return cls_cxx_map_set_vals(hctx, &vals);
 }
 
 static int cls_statelog_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
@@ -9,6 +9,26 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "finisher(" << this << ") "
 
+void Finisher::init_lockless()
+{
+  lockless = cct->_conf->finisher_lockless_queue;
+  lockless_spin = cct->_conf->finisher_lockless_spin;
+}
+
+void Finisher::lockless_wake()
+{
+  // pairs with the store/recheck in lockless_thread_entry(): either the
+  // worker sees our item before it parks, or we see it parked.
+  if (!lockless_parked.load())
+    return;
+  Mutex::Locker l(finisher_lock);
+  if (lockless_parked.load()) {
+    // later producers in this batch needn't bother
+    lockless_parked = false;
+    finisher_cond.Signal();
+  }
+}
+
 void Finisher::start()
 {
   ldout(cct, 10) << __func__ << dendl;
@@ -31,7 +51,8 @@ void Finisher::stop()
 void Finisher::wait_for_empty()
 {
   finisher_lock.Lock();
-  while (!finisher_queue.empty() || finisher_running) {
+  while (!finisher_queue.empty() || finisher_running ||
+	 lockless_pending.load()) {
     ldout(cct, 10) << "wait_for_empty waiting" << dendl;
     finisher_empty_cond.Wait(finisher_lock);
   }
@@ -41,6 +62,9 @@ void Finisher::wait_for_empty()
 
 void *Finisher::finisher_thread_entry()
 {
+  if (lockless)
+    return lockless_thread_entry();
+
   finisher_lock.Lock();
   ldout(cct, 10) << "finisher_thread start" << dendl;
 
@@ -100,3 +124,58 @@ void *Finisher::finisher_thread_entry()
   return 0;
 }
 
+
+void *Finisher::lockless_thread_entry()
+{
+  ldout(cct, 10) << "finisher_thread start (lockless)" << dendl;
+
+  vector<pair<Context*,int> > ls;
+  while (true) {
+    // spin for a while before parking; under load the next batch is
+    // usually there by the time we've finished this one
+    int spins = 0;
+    while (!lockless_queue.pop_all(ls)) {
+      if (++spins < lockless_spin)
+	continue;
+      Mutex::Locker l(finisher_lock);
+      if (finisher_stop)
+	goto out;
+      lockless_parked = true;
+      if (!lockless_queue.empty()) {
+	lockless_parked = false;
+	continue;
+      }
+      ldout(cct, 10) << "finisher_thread sleeping" << dendl;
+      finisher_cond.Wait(finisher_lock);
+      lockless_parked = false;
+      spins = 0;
+    }
+
+    ldout(cct, 10) << "finisher_thread doing " << ls.size() << " contexts"
+		   << dendl;
+    for (vector<pair<Context*,int> >::iterator p = ls.begin();
+	 p != ls.end();
+	 ++p) {
+      p->first->complete(p->second);
+      if (logger)
+	logger->dec(l_finisher_queue_len);
+    }
+    uint64_t done = ls.size();
+    ls.clear();
+    if (lockless_pending.fetch_sub(done) == done) {
+      ldout(cct, 10) << "finisher_thread empty" << dendl;
+      Mutex::Locker l(finisher_lock);
+      finisher_empty_cond.Signal();
+    }
+  }
+
+ out:
+  // If we are exiting, we signal the thread waiting in stop(),
+  // otherwise it would never unblock
+  finisher_lock.Lock();
+  finisher_empty_cond.Signal();
+  ldout(cct, 10) << "finisher_thread stop" << dendl;
+  finisher_stop = false;
+  finisher_lock.Unlock();
+  return 0;
+}
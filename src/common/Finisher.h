@@ -15,10 +15,13 @@
 #ifndef CEPH_FINISHER_H
 #define CEPH_FINISHER_H
 
+#include <atomic>
+
 #include "include/atomic.h"
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/Thread.h"
+#include "common/MPSCQueue.h"
 #include "common/perf_counters.h"
 
 class CephContext;
@@ -54,8 +57,37 @@ class Finisher {
   /// Performance counter for the finisher's queue length.
   /// Only active for named finishers.
   PerfCounters *logger;
-  
+
+  /// True if contexts go through lockless_queue instead of the locked
+  /// queues above (finisher_lockless_queue).
+  bool lockless;
+  /// Times the idle worker polls lockless_queue before it parks.
+  int lockless_spin;
+  MPSCQueue<pair<Context*,int> > lockless_queue;
+  /// Set (under finisher_lock) while the worker sleeps on finisher_cond.
+  std::atomic<bool> lockless_parked;
+  /// Contexts queued but not yet completed, for wait_for_empty().
+  std::atomic<uint64_t> lockless_pending;
+
+  void init_lockless();
+  /// Wake the worker if it has parked.
+  void lockless_wake();
+  void lockless_queue_one(Context *c, int r) {
+    ++lockless_pending;
+    lockless_queue.push(make_pair(c, r));
+    if (logger)
+      logger->inc(l_finisher_queue_len);
+  }
+  template <typename C>
+  void lockless_queue_all(C& ls) {
+    for (typename C::iterator p = ls.begin(); p != ls.end(); ++p)
+      lockless_queue_one(*p, 0);
+    ls.clear();
+    lockless_wake();
+  }
+
   void *finisher_thread_entry();
+  void *lockless_thread_entry();
 
   struct FinisherThread : public Thread {
     Finisher *fin;    
@@ -66,6 +98,11 @@ class Finisher {
  public:
   /// Add a context to complete, optionally specifying a parameter for the complete function.
   void queue(Context *c, int r = 0) {
+    if (lockless) {
+      lockless_queue_one(c, r);
+      lockless_wake();
+      return;
+    }
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
       finisher_cond.Signal();
@@ -80,6 +117,10 @@ class Finisher {
     finisher_lock.Unlock();
   }
   void queue(vector<Context*>& ls) {
+    if (lockless) {
+      lockless_queue_all(ls);
+      return;
+    }
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
       finisher_cond.Signal();
@@ -91,6 +132,10 @@ class Finisher {
     ls.clear();
   }
   void queue(deque<Context*>& ls) {
+    if (lockless) {
+      lockless_queue_all(ls);
+      return;
+    }
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
       finisher_cond.Signal();
@@ -102,6 +147,10 @@ class Finisher {
     ls.clear();
   }
   void queue(list<Context*>& ls) {
+    if (lockless) {
+      lockless_queue_all(ls);
+      return;
+    }
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
       finisher_cond.Signal();
@@ -135,14 +184,21 @@ class Finisher {
     cct(cct_), finisher_lock("Finisher::finisher_lock"),
     finisher_stop(false), finisher_running(false),
     logger(0),
-    finisher_thread(this) {}
+    lockless(false), lockless_spin(0),
+    lockless_parked(false), lockless_pending(0),
+    finisher_thread(this) {
+    init_lockless();
+  }
 
   /// Construct a named Finisher that logs its queue length.
   Finisher(CephContext *cct_, string name) :
     cct(cct_), finisher_lock("Finisher::finisher_lock"),
     finisher_stop(false), finisher_running(false),
     logger(0),
+    lockless(false), lockless_spin(0),
+    lockless_parked(false), lockless_pending(0),
     finisher_thread(this) {
+    init_lockless();
     PerfCountersBuilder b(cct, string("finisher-") + name,
 			  l_finisher_first, l_finisher_last);
     b.add_u64(l_finisher_queue_len, "queue_len");
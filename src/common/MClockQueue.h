@@ -0,0 +1,363 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef MCLOCK_QUEUE_H
+#define MCLOCK_QUEUE_H
+
+#include "common/OpQueue.h"
+#include "common/Clock.h"
+
+#include <map>
+#include <vector>
+#include <list>
+#include <limits>
+#include <algorithm>
+
+/**
+ * dmClock-style scheduler over a fixed set of op classes
+ *
+ * Every item belongs to a class, chosen by the classifier passed in at
+ * construction.  Each class has a reservation (ops/sec it is guaranteed,
+ * 0 for none), a weight (its share of whatever is left once the
+ * reservations are met) and a limit (ops/sec above which it only runs
+ * when nothing else is eligible, 0 for none).  On enqueue an item is
+ * tagged from its predecessor in the same class:
+ *
+ *   R = max(prev R + 1/reservation, now)
+ *   P = max(prev P + 1/weight, now)
+ *   L = max(prev L + 1/limit, now)
+ *
+ * dequeue first serves the class whose head has the smallest R <= now
+ * (reservation phase).  Otherwise it serves the smallest P among the
+ * classes whose head has L <= now (weight phase).  A class served in
+ * the weight phase has its queued R tags pulled in by 1/reservation, so
+ * that this service does not count against its reservation.  If every
+ * class is over its limit the smallest P is served anyway: the caller
+ * only dequeues when it has a thread to run the item, and idling it
+ * would not help anyone.
+ *
+ * Rates are in ops per second of this queue; cost is not used.
+ * Items queued with enqueue_strict/enqueue_strict_front bypass the
+ * classes and are served first, in priority order, as with
+ * PrioritizedQueue.
+ */
+template <typename T, typename K>
+class MClockQueue : public OpQueue <T, K> {
+public:
+  struct ClassInfo {
+    double reservation;
+    double weight;
+    double limit;
+    ClassInfo(double r = 0, double w = 1, double l = 0)
+      : reservation(r), weight(w), limit(l) {}
+  };
+  typedef std::function<unsigned (const T&)> Classifier;
+
+private:
+  struct Entry {
+    K owner;
+    T item;
+    double r, p, l;
+    Entry(K o, T i, double r, double p, double l)
+      : owner(o), item(i), r(r), p(p), l(l) {}
+  };
+
+  struct Class {
+    ClassInfo info;
+    std::list<Entry> q;
+    double prev_r, prev_p, prev_l;
+    double r_shift;   ///< subtracted from stored R tags (weight phase credit)
+    uint64_t served_reservation, served_weight, served_over_limit;
+    Class()
+      : prev_r(0), prev_p(0), prev_l(0), r_shift(0),
+	served_reservation(0), served_weight(0), served_over_limit(0) {}
+    double head_r() const {
+      return q.front().r - r_shift;
+    }
+  };
+
+  typedef std::list<std::pair<K, T> > StrictList;
+  typedef std::map<unsigned, StrictList> StrictQueues;
+
+  Classifier classify;
+  std::vector<Class> classes;
+  StrictQueues high_queue;
+  unsigned size;
+
+  static double inf() {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  Class &get_class(const T &item) {
+    unsigned c = classify(item);
+    assert(c < classes.size());
+    return classes[c];
+  }
+
+  void tag(Class &c, double t, double *r, double *p, double *l) {
+    if (c.info.reservation > 0)
+      *r = std::max(c.prev_r - c.r_shift + 1.0 / c.info.reservation, t) +
+	c.r_shift;
+    else
+      *r = inf();
+    *p = std::max(c.prev_p + 1.0 / c.info.weight, t);
+    if (c.info.limit > 0)
+      *l = std::max(c.prev_l + 1.0 / c.info.limit, t);
+    else
+      *l = 0;
+  }
+
+  T pop(Class &c) {
+    T ret = c.q.front().item;
+    c.q.pop_front();
+    --size;
+    return ret;
+  }
+
+  static void filter_strict(StrictList *l, std::function<bool (T)> &f,
+			    std::list<T> *out) {
+    for (typename StrictList::iterator i = l->begin(); i != l->end(); ) {
+      if (f(i->second)) {
+	if (out)
+	  out->push_back(i->second);
+	l->erase(i++);
+      } else {
+	++i;
+      }
+    }
+  }
+
+protected:
+  /// current time in seconds; overridden by tests
+  virtual double now() const {
+    return (double)ceph_clock_now(NULL);
+  }
+
+public:
+  MClockQueue(const std::vector<ClassInfo> &info, Classifier c)
+    : classify(c), classes(info.size()), size(0) {
+    for (unsigned i = 0; i < info.size(); ++i) {
+      classes[i].info = info[i];
+      if (!(classes[i].info.weight > 0))
+	classes[i].info.weight = std::numeric_limits<double>::min();
+    }
+  }
+
+  unsigned length() const {
+    return size;
+  }
+
+  bool empty() const {
+    return size == 0;
+  }
+
+  void remove_by_filter(
+    std::function<bool (T)> f, std::list<T> *removed = 0) {
+    for (typename StrictQueues::reverse_iterator i = high_queue.rbegin();
+	 i != high_queue.rend();
+	 ++i) {
+      unsigned before = i->second.size();
+      filter_strict(&i->second, f, removed);
+      size -= before - i->second.size();
+    }
+    for (typename std::vector<Class>::iterator c = classes.begin();
+	 c != classes.end();
+	 ++c) {
+      for (typename std::list<Entry>::iterator i = c->q.begin();
+	   i != c->q.end(); ) {
+	if (f(i->item)) {
+	  if (removed)
+	    removed->push_back(i->item);
+	  c->q.erase(i++);
+	  --size;
+	} else {
+	  ++i;
+	}
+      }
+    }
+    for (typename StrictQueues::iterator i = high_queue.begin();
+	 i != high_queue.end(); ) {
+      if (i->second.empty())
+	high_queue.erase(i++);
+      else
+	++i;
+    }
+  }
+
+  void remove_by_class(K k, std::list<T> *out = 0) {
+    for (typename StrictQueues::reverse_iterator i = high_queue.rbegin();
+	 i != high_queue.rend();
+	 ++i) {
+      for (typename StrictList::iterator j = i->second.begin();
+	   j != i->second.end(); ) {
+	if (j->first == k) {
+	  if (out)
+	    out->push_back(j->second);
+	  i->second.erase(j++);
+	  --size;
+	} else {
+	  ++j;
+	}
+      }
+    }
+    for (typename std::vector<Class>::iterator c = classes.begin();
+	 c != classes.end();
+	 ++c) {
+      for (typename std::list<Entry>::iterator i = c->q.begin();
+	   i != c->q.end(); ) {
+	if (i->owner == k) {
+	  if (out)
+	    out->push_back(i->item);
+	  c->q.erase(i++);
+	  --size;
+	} else {
+	  ++i;
+	}
+      }
+    }
+    for (typename StrictQueues::iterator i = high_queue.begin();
+	 i != high_queue.end(); ) {
+      if (i->second.empty())
+	high_queue.erase(i++);
+      else
+	++i;
+    }
+  }
+
+  void enqueue_strict(K cl, unsigned priority, T item) {
+    high_queue[priority].push_back(std::make_pair(cl, item));
+    ++size;
+  }
+
+  void enqueue_strict_front(K cl, unsigned priority, T item) {
+    high_queue[priority].push_front(std::make_pair(cl, item));
+    ++size;
+  }
+
+  void enqueue(K cl, unsigned priority, unsigned cost, T item) {
+    Class &c = get_class(item);
+    double r, p, l;
+    tag(c, now(), &r, &p, &l);
+    c.prev_r = r;
+    c.prev_p = p;
+    c.prev_l = l;
+    c.q.push_back(Entry(cl, item, r, p, l));
+    ++size;
+  }
+
+  /// requeue an item that was dequeued but could not run; it keeps the
+  /// place (and tags) of the class head so it runs next for its class
+  void enqueue_front(K cl, unsigned priority, unsigned cost, T item) {
+    Class &c = get_class(item);
+    double r, p, l;
+    if (c.q.empty()) {
+      tag(c, now(), &r, &p, &l);
+      c.prev_r = r;
+      c.prev_p = p;
+      c.prev_l = l;
+    } else {
+      r = c.q.front().r;
+      p = c.q.front().p;
+      l = c.q.front().l;
+    }
+    c.q.push_front(Entry(cl, item, r, p, l));
+    ++size;
+  }
+
+  T dequeue() {
+    assert(!empty());
+
+    if (!high_queue.empty()) {
+      T ret = high_queue.rbegin()->second.front().second;
+      high_queue.rbegin()->second.pop_front();
+      if (high_queue.rbegin()->second.empty())
+	high_queue.erase(high_queue.rbegin()->first);
+      --size;
+      return ret;
+    }
+
+    double t = now();
+
+    // reservation phase
+    Class *best = NULL;
+    for (typename std::vector<Class>::iterator c = classes.begin();
+	 c != classes.end();
+	 ++c) {
+      if (c->q.empty() || c->head_r() > t)
+	continue;
+      if (!best || c->head_r() < best->head_r())
+	best = &*c;
+    }
+    if (best) {
+      best->served_reservation++;
+      return pop(*best);
+    }
+
+    // weight phase, among classes under their limit; failing that,
+    // among everyone
+    Class *over = NULL;
+    for (typename std::vector<Class>::iterator c = classes.begin();
+	 c != classes.end();
+	 ++c) {
+      if (c->q.empty())
+	continue;
+      if (c->q.front().l <= t) {
+	if (!best || c->q.front().p < best->q.front().p)
+	  best = &*c;
+      } else {
+	if (!over || c->q.front().p < over->q.front().p)
+	  over = &*c;
+      }
+    }
+    if (best) {
+      best->served_weight++;
+    } else {
+      assert(over);
+      best = over;
+      best->served_over_limit++;
+    }
+    if (best->info.reservation > 0)
+      best->r_shift += 1.0 / best->info.reservation;
+    return pop(*best);
+  }
+
+  void dump(ceph::Formatter *f) const {
+    f->dump_int("size", size);
+    f->open_array_section("high_queues");
+    for (typename StrictQueues::const_iterator p = high_queue.begin();
+	 p != high_queue.end();
+	 ++p) {
+      f->open_object_section("subqueue");
+      f->dump_int("priority", p->first);
+      f->dump_int("size", p->second.size());
+      f->close_section();
+    }
+    f->close_section();
+    f->open_array_section("classes");
+    for (unsigned i = 0; i < classes.size(); ++i) {
+      const Class &c = classes[i];
+      f->open_object_section("class");
+      f->dump_int("class", i);
+      f->dump_float("reservation", c.info.reservation);
+      f->dump_float("weight", c.info.weight);
+      f->dump_float("limit", c.info.limit);
+      f->dump_int("size", c.q.size());
+      f->dump_unsigned("served_reservation", c.served_reservation);
+      f->dump_unsigned("served_weight", c.served_weight);
+      f->dump_unsigned("served_over_limit", c.served_over_limit);
+      f->close_section();
+    }
+    f->close_section();
+  }
+};
+
+#endif
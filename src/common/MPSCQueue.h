@@ -0,0 +1,103 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MPSCQUEUE_H
+#define CEPH_MPSCQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+/**
+ * Unbounded multi-producer, single-consumer queue.
+ *
+ * push() never takes a lock: producers link a node onto a shared stack
+ * with a single compare-and-swap.  The consumer detaches everything
+ * queued so far with one exchange in pop_all(), which hands the items
+ * back in FIFO order.  There is no single-item pop, so the stack never
+ * sees ABA.  Only one thread may consume at a time; callers that have
+ * several must serialize pop_all() themselves.
+ */
+template <typename T>
+class MPSCQueue {
+  struct node {
+    T val;
+    node *next;
+    explicit node(const T& v) : val(v), next(NULL) {}
+  };
+  std::atomic<node*> head;
+
+  // no copying
+  MPSCQueue(const MPSCQueue& other);
+  MPSCQueue& operator=(const MPSCQueue& other);
+
+public:
+  MPSCQueue() : head(NULL) {}
+  ~MPSCQueue() {
+    node *n = head.exchange(NULL);
+    while (n) {
+      node *next = n->next;
+      delete n;
+      n = next;
+    }
+  }
+
+  /**
+   * add an item
+   *
+   * @returns true if the queue was empty before, i.e. this producer is
+   * the one that should wake the consumer
+   */
+  bool push(const T& v) {
+    node *n = new node(v);
+    node *h = head.load(std::memory_order_relaxed);
+    do {
+      n->next = h;
+    } while (!head.compare_exchange_weak(h, n));
+    return h == NULL;
+  }
+
+  /**
+   * take everything queued so far
+   *
+   * @param out container the items are push_back()ed to, oldest first
+   * @returns number of items taken
+   */
+  template <typename C>
+  size_t pop_all(C& out) {
+    node *n = head.exchange(NULL);
+    if (!n)
+      return 0;
+    // the stack is newest first
+    node *r = NULL;
+    while (n) {
+      node *next = n->next;
+      n->next = r;
+      r = n;
+      n = next;
+    }
+    size_t count = 0;
+    while (r) {
+      node *next = r->next;
+      out.push_back(r->val);
+      delete r;
+      r = next;
+      ++count;
+    }
+    return count;
+  }
+
+  bool empty() const {
+    return head.load() == NULL;
+  }
+};
+
+#endif
@@ -25,7 +25,7 @@ Mutex::Mutex(const std::string &n, bool r, bool ld,
 	     bool bt,
 	     CephContext *cct) :
   name(n), id(-1), recursive(r), lockdep(ld), backtrace(bt), nlock(0),
-  locked_by(0), cct(cct), logger(0)
+  locked_by(0), cct(cct), logger(0), lstat(0), lstat_start(0)
 {
   if (cct) {
     PerfCountersBuilder b(cct, string("mutex-") + name,
@@ -86,18 +86,33 @@ void Mutex::Lock(bool no_lockdep) {
 
   if (lockdep && g_lockdep && !no_lockdep) _will_lock();
 
-  if (logger && cct && cct->_conf->mutex_perf_counter) {
-    utime_t start;
+  bool perf = logger && cct && cct->_conf->mutex_perf_counter;
+  bool sample = g_lock_stats && lock_stats_sample();
+  uint64_t sample_now = 0;
+  if (perf || sample) {
     // instrumented mutex enabled
-    start = ceph_clock_now(cct);
-    if (TryLock()) {
-      goto out;
-    }
+    utime_t start;
+    if (perf)
+      start = ceph_clock_now(cct);
+    if (sample)
+      sample_now = lock_stats_now();
 
-    r = pthread_mutex_lock(&_m);
+    r = pthread_mutex_trylock(&_m);
+    bool contended = (r != 0);
+    if (contended) {
+      r = pthread_mutex_lock(&_m);
+      if (perf)
+	logger->tinc(l_mutex_wait,
+		     ceph_clock_now(cct) - start);
+    }
 
-    logger->tinc(l_mutex_wait,
-		 ceph_clock_now(cct) - start);
+    if (sample) {
+      if (!lstat)
+	lstat = lock_stats_get(name);
+      uint64_t wait_start = sample_now;
+      sample_now = contended ? lock_stats_now() : wait_start;
+      lstat->add_wait(sample_now - wait_start, contended);
+    }
   } else {
     r = pthread_mutex_lock(&_m);
   }
@@ -105,9 +120,8 @@ void Mutex::Lock(bool no_lockdep) {
   assert(r == 0);
   if (lockdep && g_lockdep) _locked();
   _post_lock();
-
-out:
-  ;
+  if (sample_now && nlock == 1)
+    lstat_start = sample_now;
 }
 
 void Mutex::Unlock() {
@@ -17,6 +17,7 @@
 
 #include "include/assert.h"
 #include "lockdep.h"
+#include "common/lock_stats.h"
 #include "common/ceph_context.h"
 
 #include <pthread.h>
@@ -44,6 +45,8 @@ private:
   pthread_t locked_by;
   CephContext *cct;
   PerfCounters *logger;
+  lock_stat_t *lstat;      ///< contention profile entry, set on first sample
+  uint64_t lstat_start;    ///< when a sampled acquisition got the lock
 
   // don't allow copying.
   void operator=(const Mutex &M);
@@ -100,6 +103,11 @@ public:
       locked_by = 0;
       assert(nlock == 0);
     }
+    if (lstat_start && nlock == 0) {
+      uint64_t start = lstat_start;
+      lstat_start = 0;
+      lstat->add_hold(lock_stats_now() - start);
+    }
   }
   void Unlock();
 
@@ -0,0 +1,56 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef OP_QUEUE_H
+#define OP_QUEUE_H
+
+#include "common/Formatter.h"
+
+#include <list>
+#include <functional>
+
+/**
+ * Abstract interface for the op schedulers the OSD can be configured
+ * with (see osd_op_queue).
+ *
+ * Items queued with enqueue_strict/enqueue_strict_front are served in
+ * strict priority order before anything queued with enqueue and
+ * enqueue_front.  K identifies the owner of an item (e.g. the client's
+ * entity_inst_t) for remove_by_class and per-owner fairness.
+ */
+template <typename T, typename K>
+class OpQueue {
+public:
+  virtual ~OpQueue() {}
+
+  virtual unsigned length() const = 0;
+  virtual bool empty() const = 0;
+
+  /// remove (and optionally return, in queue order) items matching f
+  virtual void remove_by_filter(
+    std::function<bool (T)> f, std::list<T> *removed = 0) = 0;
+  /// remove (and optionally return, in queue order) items owned by k
+  virtual void remove_by_class(K k, std::list<T> *out = 0) = 0;
+
+  virtual void enqueue_strict(K cl, unsigned priority, T item) = 0;
+  virtual void enqueue_strict_front(K cl, unsigned priority, T item) = 0;
+  virtual void enqueue(K cl, unsigned priority, unsigned cost, T item) = 0;
+  virtual void enqueue_front(K cl, unsigned priority, unsigned cost,
+			     T item) = 0;
+
+  /// dequeue the next item to run; the queue must not be empty
+  virtual T dequeue() = 0;
+
+  virtual void dump(ceph::Formatter *f) const = 0;
+};
+
+#endif
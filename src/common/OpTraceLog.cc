@@ -0,0 +1,122 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#include "common/OpTraceLog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include "common/Formatter.h"
+#include "common/ceph_context.h"
+#include "common/config.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "include/compat.h"
+
+#define dout_subsys ceph_subsys_optracker
+#undef dout_prefix
+#define dout_prefix *_dout << "optrace "
+
+OpTraceLog::OpTraceLog(CephContext *cct)
+  : cct(cct), lock("OpTraceLog::lock"), path(cct->_conf->op_trace_file),
+    fd(-1), failed(false)
+{
+  cct->_conf->add_observer(this);
+}
+
+OpTraceLog::~OpTraceLog()
+{
+  cct->_conf->remove_observer(this);
+  if (fd >= 0)
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+}
+
+bool OpTraceLog::is_sampled(uint64_t num, uint64_t tid) const
+{
+  uint64_t n = cct->_conf->op_trace_sample;
+  if (n == 0)
+    return false;
+  // mix both so that neither busy clients nor low tids cluster
+  uint64_t h = num * 0x9e3779b97f4a7c15ull ^ tid;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h % n == 0;
+}
+
+const char** OpTraceLog::get_tracked_conf_keys() const
+{
+  static const char *KEYS[] = {
+    "op_trace_file",
+    NULL
+  };
+  return KEYS;
+}
+
+void OpTraceLog::handle_conf_change(const md_config_t *conf,
+				    const std::set<std::string> &changed)
+{
+  if (!changed.count("op_trace_file"))
+    return;
+  Mutex::Locker l(lock);
+  // the next record opens the new file, even if the old one failed
+  if (fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    fd = -1;
+  }
+  path = conf->op_trace_file;
+  failed = false;
+}
+
+void OpTraceLog::write(const std::string &reqid, const char *role,
+		       const events_t &events)
+{
+  JSONFormatter f;
+  f.open_object_section("trace");
+  f.dump_string("reqid", reqid);
+  f.dump_string("entity", cct->_conf->name.to_str());
+  f.dump_string("role", role);
+  f.open_array_section("events");
+  for (events_t::const_iterator p = events.begin(); p != events.end(); ++p) {
+    f.open_array_section("event");
+    f.dump_string("name", p->first);
+    f.dump_float("time", (double)p->second);
+    f.close_section();
+  }
+  f.close_section();
+  f.close_section();
+  std::ostringstream ss;
+  f.flush(ss);
+  ss << "\n";
+  std::string line = ss.str();
+
+  Mutex::Locker l(lock);
+  if (fd < 0) {
+    if (failed || path.empty())
+      return;
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+      int r = -errno;
+      lderr(cct) << "cannot open " << path << ", not writing op traces: "
+		 << cpp_strerror(r) << dendl;
+      failed = true;
+      return;
+    }
+  }
+  // O_APPEND and one write per record keep the lines whole
+  int r = safe_write(fd, line.data(), line.size());
+  if (r < 0)
+    ldout(cct, 1) << "error writing op trace: " << cpp_strerror(r) << dendl;
+}
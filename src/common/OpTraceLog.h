@@ -0,0 +1,72 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_COMMON_OPTRACELOG_H
+#define CEPH_COMMON_OPTRACELOG_H
+
+#include "include/int_types.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/Mutex.h"
+#include "common/config_obs.h"
+#include "include/utime.h"
+
+class CephContext;
+
+/**
+ * Sampled per-request traces, one JSON object per line
+ *
+ * A request is identified by its osd_reqid_t, which the client, the
+ * primary and the replicas all know without anything extra on the
+ * wire, and whether it is sampled is a hash of the reqid: every daemon
+ * with the same op_trace_sample picks the same 1 in N requests, so the
+ * files written to op_trace_file on each host can be merged by reqid
+ * (see ceph-op-trace) into the full path of the request.  Requests
+ * that aren't sampled cost a hash and a compare.
+ *
+ * Each line looks like
+ *
+ *   {"reqid":"client.4123.0:17","entity":"osd.3","role":"primary",
+ *    "events":[["header_read",1444297128.123456],...]}
+ *
+ * The times are local clock readings, so comparing them across hosts
+ * is only as good as the clock sync between them.
+ */
+class OpTraceLog : public md_config_obs_t {
+public:
+  typedef std::vector<std::pair<const char*, utime_t> > events_t;
+
+  OpTraceLog(CephContext *cct);
+  ~OpTraceLog();
+
+  /// whether the request from entity num with tid is traced
+  bool is_sampled(uint64_t num, uint64_t tid) const;
+
+  /// append a record; the file is opened on the first one
+  void write(const std::string &reqid, const char *role,
+	     const events_t &events);
+
+  const char** get_tracked_conf_keys() const;
+  void handle_conf_change(const md_config_t *conf,
+			  const std::set<std::string> &changed);
+
+private:
+  CephContext *cct;
+  Mutex lock;
+  std::string path;  ///< op_trace_file
+  int fd;
+  bool failed;       ///< path could not be opened, until it changes
+};
+
+#endif
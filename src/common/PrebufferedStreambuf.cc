@@ -61,3 +61,13 @@ std::string PrebufferedStreambuf::get_str() const
     return std::string(m_buf, this->pptr() - m_buf);
   }  
 }
+
+void PrebufferedStreambuf::append_to(std::string &s) const
+{
+  if (m_overflow.size()) {
+    s.append(m_buf, m_buf_len);
+    s.append(&m_overflow[0], this->pptr() - &m_overflow[0]);
+  } else {
+    s.append(m_buf, this->pptr() - m_buf);
+  }
+}
@@ -37,6 +37,9 @@ public:
 
   /// return a string copy (inefficiently)
   std::string get_str() const;
+
+  /// append the contents to s
+  void append_to(std::string &s) const;
 };    
 
 #endif
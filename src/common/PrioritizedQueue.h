@@ -17,6 +17,7 @@
 
 #include "common/Mutex.h"
 #include "common/Formatter.h"
+#include "common/OpQueue.h"
 
 #include <map>
 #include <utility>
@@ -44,7 +45,7 @@
  * to provide fairness for different clients.
  */
 template <typename T, typename K>
-class PrioritizedQueue {
+class PrioritizedQueue : public OpQueue <T, K> {
   int64_t total_priority;
   int64_t max_tokens_per_subqueue;
   int64_t min_cost;
@@ -280,6 +281,11 @@ public:
     }
   }
 
+  void remove_by_filter(
+    std::function<bool (T)> f, std::list<T> *removed = 0) {
+    remove_by_filter<std::function<bool (T)> >(f, removed);
+  }
+
   void remove_by_class(K k, std::list<T> *out = 0) {
     for (typename SubQueues::iterator i = queue.begin();
 	 i != queue.end();
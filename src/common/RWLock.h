@@ -18,33 +18,142 @@
 #define CEPH_RWLock_Posix__H
 
 #include <pthread.h>
+#include <stdlib.h>
+#include <new>
 #include <string>
 #include <include/assert.h>
 #include "lockdep.h"
+#include "common/lock_stats.h"
 #include "include/atomic.h"
 
+/**
+ * With shards > 1 the lock is a big reader lock: each thread read locks
+ * only its own shard, so readers on different cores do not bounce a
+ * shared cache line, and a writer locks every shard in order.  Reads
+ * must be unlocked by the thread that took them, and the lock must be
+ * tracked (unlock tells readers from the writer by nwlock).
+ */
 class RWLock
 {
+  // one cache line to itself, wherever the array starts
+  struct reader_shard_t {
+    pthread_rwlock_t L;
+    atomic_t nrlock;
+    char pad[128 - sizeof(pthread_rwlock_t) - sizeof(atomic_t)];
+  };
+
   mutable pthread_rwlock_t L;
   std::string name;
   mutable int id;
   mutable atomic_t nrlock, nwlock;
   bool track;
+  unsigned num_shards;           ///< 0 unless sharded
+  reader_shard_t *shards;
+  mutable lock_stat_t *lstat;   ///< contention profile entry, set on first sample
+  mutable uint64_t lstat_wstart; ///< when a sampled writer got the lock
 
   std::string unique_name(const char* name) const;
 
+  reader_shard_t &_my_shard() const {
+    // threads are spread over the shards round robin, in the order they
+    // first read lock any sharded lock
+    static atomic_t next_thread;
+    static __thread int thread_index = -1;
+    if (thread_index < 0)
+      thread_index = next_thread.inc() & 0x7fffffff;
+    return shards[thread_index % num_shards];
+  }
+  pthread_rwlock_t *_rlock() const {
+    return num_shards ? &_my_shard().L : &L;
+  }
+  int _rdlock(bool try_only) const {
+    return try_only ? pthread_rwlock_tryrdlock(_rlock()) :
+      pthread_rwlock_rdlock(_rlock());
+  }
+  int _wrlock(bool try_only) const {
+    if (!num_shards)
+      return try_only ? pthread_rwlock_trywrlock(&L) :
+	pthread_rwlock_wrlock(&L);
+    for (unsigned i = 0; i < num_shards; i++) {
+      int r = try_only ? pthread_rwlock_trywrlock(&shards[i].L) :
+	pthread_rwlock_wrlock(&shards[i].L);
+      if (r) {
+	while (i-- > 0)
+	  pthread_rwlock_unlock(&shards[i].L);
+	return r;
+      }
+    }
+    return 0;
+  }
+  int _unlock(bool writer) const {
+    if (!num_shards)
+      return pthread_rwlock_unlock(&L);
+    if (!writer)
+      return pthread_rwlock_unlock(&_my_shard().L);
+    for (unsigned i = num_shards; i-- > 0; ) {
+      int r = pthread_rwlock_unlock(&shards[i].L);
+      if (r)
+	return r;
+    }
+    return 0;
+  }
+  atomic_t &_nrlock() const {
+    return num_shards ? _my_shard().nrlock : nrlock;
+  }
+
+  /// timed acquisition for the lock contention profiler
+  int _sampled_lock(bool write) const {
+    if (!lstat)
+      lstat = lock_stats_get(name);
+    uint64_t start = lock_stats_now();
+    int r = write ? _wrlock(true) : _rdlock(true);
+    bool contended = (r != 0);
+    uint64_t now = start;
+    if (contended) {
+      r = write ? _wrlock(false) : _rdlock(false);
+      now = lock_stats_now();
+    }
+    lstat->add_wait(now - start, contended);
+    if (write)
+      lstat_wstart = now;  // readers share the lock, so only writers are held-timed
+    return r;
+  }
+
 public:
   RWLock(const RWLock& other);
   const RWLock& operator=(const RWLock& other);
 
-  RWLock(const std::string &n, bool track_lock=true) : name(n), id(-1), nrlock(0), nwlock(0), track(track_lock) {
+  RWLock(const std::string &n, bool track_lock=true, unsigned reader_shards=0)
+    : name(n), id(-1), nrlock(0), nwlock(0), track(track_lock),
+      num_shards(reader_shards > 1 ? reader_shards : 0), shards(NULL),
+      lstat(0), lstat_wstart(0) {
     pthread_rwlock_init(&L, NULL);
+    if (num_shards) {
+      assert(track);
+      shards = static_cast<reader_shard_t*>(
+	malloc(sizeof(reader_shard_t) * num_shards));
+      assert(shards);
+      for (unsigned i = 0; i < num_shards; i++) {
+	new (&shards[i].nrlock) atomic_t(0);
+	pthread_rwlock_init(&shards[i].L, NULL);
+      }
+    }
     if (g_lockdep) id = lockdep_register(name.c_str());
   }
 
   bool is_locked() const {
     assert(track);
-    return (nrlock.read() > 0) || (nwlock.read() > 0);
+    if (nwlock.read() > 0)
+      return true;
+    if (!num_shards)
+      return nrlock.read() > 0;
+    // the caller's own shard first: that is where its read lock would be
+    if (_my_shard().nrlock.read() > 0)
+      return true;
+    for (unsigned i = 0; i < num_shards; i++)
+      if (shards[i].nrlock.read() > 0)
+	return true;
+    return false;
   }
 
   bool is_wlocked() const {
@@ -57,38 +166,55 @@ public:
     if (track)
       assert(!is_locked());
     pthread_rwlock_destroy(&L);
+    for (unsigned i = 0; i < num_shards; i++) {
+      pthread_rwlock_destroy(&shards[i].L);
+      shards[i].nrlock.~atomic_t();
+    }
+    free(shards);
     if (g_lockdep) {
       lockdep_unregister(id);
     }
   }
 
   void unlock(bool lockdep=true) const {
+    bool writer = false;
     if (track) {
       if (nwlock.read() > 0) {
-        nwlock.dec();
+	writer = true;
+	nwlock.dec();
       } else {
-        assert(nrlock.read() > 0);
-        nrlock.dec();
+	assert(_nrlock().read() > 0);
+	_nrlock().dec();
       }
     }
     if (lockdep && g_lockdep) id = lockdep_will_unlock(name.c_str(), id);
-    int r = pthread_rwlock_unlock(&L);
+    if (lstat_wstart) {
+      // only set while a sampled writer holds the lock
+      uint64_t start = lstat_wstart;
+      lstat_wstart = 0;
+      lstat->add_hold(lock_stats_now() - start);
+    }
+    int r = _unlock(writer);
     assert(r == 0);
   }
 
   // read
   void get_read() const {
     if (g_lockdep) id = lockdep_will_lock(name.c_str(), id);
-    int r = pthread_rwlock_rdlock(&L);
+    int r;
+    if (g_lock_stats && lock_stats_sample())
+      r = _sampled_lock(false);
+    else
+      r = _rdlock(false);
     assert(r == 0);
     if (g_lockdep) id = lockdep_locked(name.c_str(), id);
     if (track)
-      nrlock.inc();
+      _nrlock().inc();
   }
   bool try_get_read() const {
-    if (pthread_rwlock_tryrdlock(&L) == 0) {
+    if (_rdlock(true) == 0) {
       if (track)
-         nrlock.inc();
+         _nrlock().inc();
       if (g_lockdep) id = lockdep_locked(name.c_str(), id);
       return true;
     }
@@ -101,7 +227,11 @@ public:
   // write
   void get_write(bool lockdep=true) {
     if (lockdep && g_lockdep) id = lockdep_will_lock(name.c_str(), id);
-    int r = pthread_rwlock_wrlock(&L);
+    int r;
+    if (g_lock_stats && lock_stats_sample())
+      r = _sampled_lock(true);
+    else
+      r = _wrlock(false);
     assert(r == 0);
     if (g_lockdep) id = lockdep_locked(name.c_str(), id);
     if (track)
@@ -109,7 +239,7 @@ public:
 
   }
   bool try_get_write(bool lockdep=true) {
-    if (pthread_rwlock_trywrlock(&L) == 0) {
+    if (_wrlock(true) == 0) {
       if (lockdep && g_lockdep) id = lockdep_locked(name.c_str(), id);
       if (track)
          nwlock.inc();
@@ -11,12 +11,8 @@ Readahead::Readahead()
     m_readahead_max_bytes(NO_LIMIT),
     m_alignments(),
     m_lock("Readahead::m_lock"),
-    m_nr_consec_read(0),
-    m_consec_read_bytes(0),
-    m_last_pos(0),
-    m_readahead_pos(0),
-    m_readahead_trigger_pos(0),
-    m_readahead_size(0),
+    m_streams(1),
+    m_seq(0),
     m_pending(0),
     m_pending_lock("Readahead::m_pending_lock"),
     m_pending_cond() {
@@ -27,66 +23,78 @@ Readahead::~Readahead() {
 
 Readahead::extent_t Readahead::update(const vector<extent_t>& extents, uint64_t limit) {
   m_lock.Lock();
+  Stream *s = NULL;
   for (vector<extent_t>::const_iterator p = extents.begin(); p != extents.end(); ++p) {
-    _observe_read(p->first, p->second);
+    s = _observe_read(p->first, p->second);
   }
-  if (m_readahead_pos >= limit) {
+  if (!s || s->readahead_pos >= limit) {
     m_lock.Unlock();
     return extent_t(0, 0);
   }
-  pair<uint64_t, uint64_t> extent = _compute_readahead(limit);
+  pair<uint64_t, uint64_t> extent = _compute_readahead(s, limit);
   m_lock.Unlock();
   return extent;
 }
 
 Readahead::extent_t Readahead::update(uint64_t offset, uint64_t length, uint64_t limit) {
   m_lock.Lock();
-  _observe_read(offset, length);
-  if (m_readahead_pos >= limit) {
+  Stream *s = _observe_read(offset, length);
+  if (s->readahead_pos >= limit) {
     m_lock.Unlock();
     return extent_t(0, 0);
   }
-  extent_t extent = _compute_readahead(limit);
+  extent_t extent = _compute_readahead(s, limit);
   m_lock.Unlock();
   return extent;
 }
 
-void Readahead::_observe_read(uint64_t offset, uint64_t length) {
-  if (offset == m_last_pos) {
-    m_nr_consec_read++;
-    m_consec_read_bytes += length;
+Readahead::Stream *Readahead::_observe_read(uint64_t offset, uint64_t length) {
+  Stream *s = NULL;
+  for (vector<Stream>::iterator p = m_streams.begin(); p != m_streams.end(); ++p) {
+    if (p->last_pos == offset) {
+      s = &*p;
+      break;
+    }
+  }
+  if (s) {
+    s->nr_consec_read++;
+    s->consec_read_bytes += length;
   } else {
-    m_nr_consec_read = 0;
-    m_consec_read_bytes = 0;
-    m_readahead_trigger_pos = 0;
-    m_readahead_size = 0;
-    m_readahead_pos = 0;
+    // not sequential with any stream: restart the least recently used one
+    s = &m_streams[0];
+    for (vector<Stream>::iterator p = m_streams.begin(); p != m_streams.end(); ++p) {
+      if (p->last_used < s->last_used)
+	s = &*p;
+    }
+    *s = Stream();
   }
-  m_last_pos = offset + length;
+  s->last_pos = offset + length;
+  s->last_used = ++m_seq;
+  return s;
 }
 
-Readahead::extent_t Readahead::_compute_readahead(uint64_t limit) {
+Readahead::extent_t Readahead::_compute_readahead(Stream *s, uint64_t limit) {
   uint64_t readahead_offset = 0;
   uint64_t readahead_length = 0;
-  if (m_nr_consec_read >= m_trigger_requests) {
+  if (s->nr_consec_read >= m_trigger_requests) {
     // currently reading sequentially
-    if (m_last_pos >= m_readahead_trigger_pos) {
+    if (s->last_pos >= s->readahead_trigger_pos) {
       // need to read ahead
-      if (m_readahead_size == 0) {
+      if (s->readahead_size == 0) {
 	// initial readahead trigger
-	m_readahead_size = m_consec_read_bytes;
-	m_readahead_pos = m_last_pos;
+	s->readahead_size = s->consec_read_bytes;
+	s->readahead_pos = s->last_pos;
       } else {
 	// continuing readahead trigger
-	m_readahead_size *= 2;
-	if (m_last_pos > m_readahead_pos) {
-	  m_readahead_pos = m_last_pos;
+	s->readahead_size *= 2;
+	if (s->last_pos > s->readahead_pos) {
+	  s->readahead_pos = s->last_pos;
 	}
       }
-      m_readahead_size = MAX(m_readahead_size, m_readahead_min_bytes);
-      m_readahead_size = MIN(m_readahead_size, m_readahead_max_bytes);
-      readahead_offset = m_readahead_pos;
-      readahead_length = m_readahead_size;
+      s->readahead_size = MAX(s->readahead_size, m_readahead_min_bytes);
+      s->readahead_size = MIN(s->readahead_size, m_readahead_max_bytes);
+      readahead_offset = s->readahead_pos;
+      readahead_length = s->readahead_size;
 
       // Snap to the first alignment possible
       uint64_t readahead_end = readahead_offset + readahead_length;
@@ -108,15 +116,15 @@ Readahead::extent_t Readahead::_compute_readahead(uint64_t limit) {
 	  readahead_length = align_next - readahead_offset;
 	  break;
 	}
-	// Note that m_readahead_size should remain unadjusted.
+	// Note that s->readahead_size should remain unadjusted.
       }
 
-      if (m_readahead_pos + readahead_length > limit) {
-	readahead_length = limit - m_readahead_pos;
+      if (s->readahead_pos + readahead_length > limit) {
+	readahead_length = limit - s->readahead_pos;
       }
 
-      m_readahead_trigger_pos = m_readahead_pos + readahead_length / 2;
-      m_readahead_pos += readahead_length;
+      s->readahead_trigger_pos = s->readahead_pos + readahead_length / 2;
+      s->readahead_pos += readahead_length;
     }
   }
   return extent_t(readahead_offset, readahead_length);
@@ -171,3 +179,9 @@ void Readahead::set_alignments(const vector<uint64_t> &alignments) {
   m_alignments = alignments;
   m_lock.Unlock();
 }
+
+void Readahead::set_max_streams(unsigned max_streams) {
+  m_lock.Lock();
+  m_streams.assign(MAX(max_streams, 1u), Stream());
+  m_lock.Unlock();
+}
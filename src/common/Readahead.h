@@ -14,6 +14,10 @@
 
    Minimum and maximum readahead sizes may be violated by up to 50\% if alignment is enabled.
    Minimum readahead size may be violated if the end of the readahead target is reached.
+
+   Several interleaved sequential streams (e.g. a few threads or processes each reading
+   their own part of an image) can be tracked at once, see set_max_streams().  Each stream
+   has its own readahead window, which doubles every time the reader catches up with it.
  */
 class Readahead {
 public:
@@ -94,18 +98,53 @@ public:
    */
   void set_alignments(const std::vector<uint64_t> &alignments);
 
+  /**
+     Sets the number of sequential streams tracked at once (at least 1, the default).
+     A read that continues none of them restarts the least recently used one.
+     Resets all streams.
+   */
+  void set_max_streams(unsigned max_streams);
+
 private:
+  /// State of one sequential read stream
+  struct Stream {
+    /// Number of consecutive read requests in the stream
+    int nr_consec_read;
+
+    /// Number of bytes read in the stream
+    uint64_t consec_read_bytes;
+
+    /// Position of the read stream
+    uint64_t last_pos;
+
+    /// Position of the readahead stream
+    uint64_t readahead_pos;
+
+    /// When readahead is already triggered and the read stream crosses this point, readahead is continued
+    uint64_t readahead_trigger_pos;
+
+    /// Size of the next readahead request (barring changes due to alignment, etc.)
+    uint64_t readahead_size;
+
+    /// Value of m_seq when the stream was last read from
+    uint64_t last_used;
+
+    Stream()
+      : nr_consec_read(0), consec_read_bytes(0), last_pos(0), readahead_pos(0),
+	readahead_trigger_pos(0), readahead_size(0), last_used(0) {}
+  };
+
   /**
-     Records that a read request has been received.
+     Records that a read request has been received and returns its stream.
      m_lock must be held while calling.
    */
-  void _observe_read(uint64_t offset, uint64_t length);
+  Stream *_observe_read(uint64_t offset, uint64_t length);
 
   /**
-     Computes the next readahead request.
+     Computes the next readahead request of a stream.
      m_lock must be held while calling.
   */
-  extent_t _compute_readahead(uint64_t limit);
+  extent_t _compute_readahead(Stream *s, uint64_t limit);
 
   /// Number of sequential requests necessary to trigger readahead
   int m_trigger_requests;
@@ -122,23 +161,11 @@ private:
   /// Held while reading/modifying any state except m_pending
   Mutex m_lock;
 
-  /// Number of consecutive read requests in the current sequential stream
-  int m_nr_consec_read;
-
-  /// Number of bytes read in the current sequenial stream
-  uint64_t m_consec_read_bytes;
-
-  /// Position of the read stream
-  uint64_t m_last_pos;
-
-  /// Position of the readahead stream
-  uint64_t m_readahead_pos;
-
-  /// When readahead is already triggered and the read stream crosses this point, readahead is continued
-  uint64_t m_readahead_trigger_pos;
+  /// Tracked sequential streams
+  std::vector<Stream> m_streams;
 
-  /// Size of the next readahead request (barring changes due to alignment, etc.)
-  uint64_t m_readahead_size;
+  /// Number of reads observed, to find the least recently used stream
+  uint64_t m_seq;
 
   /// Number of pending readahead requests, as determined by inc_pending() and dec_pending()
   int m_pending;
@@ -33,6 +33,7 @@ Throttle::Throttle(CephContext *cct, const std::string& n, int64_t m, bool _use_
   : cct(cct), name(n), logger(NULL),
     max(m),
     lock("Throttle::lock"),
+    last_ticket(0),
     use_perf(_use_perf)
 {
   assert(m >= 0);
@@ -67,6 +68,10 @@ Throttle::~Throttle()
     delete cv;
     cond.pop_front();
   }
+  while (!queued.empty()) {
+    delete queued.front().on_get;
+    queued.pop_front();
+  }
 
   if (!use_perf)
     return;
@@ -124,6 +129,35 @@ bool Throttle::_wait(int64_t c)
   return waited;
 }
 
+void Throttle::_grant_queued(list<Context*>& ready)
+{
+  assert(lock.is_locked());
+  while (!queued.empty() && !_should_wait(queued.front().c)) {
+    int64_t c = queued.front().c;
+    ldout(cct, 10) << "get_or_queue " << c << " granted (" << count.read()
+		   << " -> " << (count.read() + c) << ")" << dendl;
+    count.add(c);
+    if (logger) {
+      logger->inc(l_throttle_get);
+      logger->inc(l_throttle_get_sum, c);
+      logger->set(l_throttle_val, count.read());
+    }
+    ready.push_back(queued.front().on_get);
+    queued.pop_front();
+  }
+}
+
+void Throttle::reset_max(int64_t m)
+{
+  list<Context*> ready;
+  {
+    Mutex::Locker l(lock);
+    _reset_max(m);
+    _grant_queued(ready);
+  }
+  finish_contexts(cct, ready);
+}
+
 bool Throttle::wait(int64_t m)
 {
   if (0 == max.read() && 0 == m) {
@@ -146,10 +180,8 @@ int64_t Throttle::take(int64_t c)
   }
   assert(c >= 0);
   ldout(cct, 10) << "take " << c << dendl;
-  {
-    Mutex::Locker l(lock);
-    count.add(c);
-  }
+  // take never waits nor wakes a waiter, so count alone will do
+  count.add(c);
   if (logger) {
     logger->inc(l_throttle_take);
     logger->inc(l_throttle_take_sum, c);
@@ -195,7 +227,7 @@ bool Throttle::get_or_fail(int64_t c)
 
   assert (c >= 0);
   Mutex::Locker l(lock);
-  if (_should_wait(c) || !cond.empty()) {
+  if (_should_wait(c) || !cond.empty() || !queued.empty()) {
     ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
     if (logger) {
       logger->inc(l_throttle_get_or_fail_fail);
@@ -214,6 +246,59 @@ bool Throttle::get_or_fail(int64_t c)
   }
 }
 
+uint64_t Throttle::get_or_queue(int64_t c, Context *on_get)
+{
+  if (0 == max.read()) {
+    delete on_get;
+    return 0;
+  }
+
+  assert(c >= 0);
+  Mutex::Locker l(lock);
+  if (_should_wait(c) || !cond.empty() || !queued.empty()) {
+    uint64_t ticket = ++last_ticket;
+    ldout(cct, 10) << "get_or_queue " << c << " queued, ticket " << ticket << dendl;
+    queued.push_back(queued_get_t(ticket, c, on_get));
+    if (logger)
+      logger->inc(l_throttle_get_or_fail_fail);
+    return ticket;
+  }
+  ldout(cct, 10) << "get_or_queue " << c << " success (" << count.read() << " -> " << (count.read() + c) << ")" << dendl;
+  count.add(c);
+  if (logger) {
+    logger->inc(l_throttle_get_or_fail_success);
+    logger->inc(l_throttle_get);
+    logger->inc(l_throttle_get_sum, c);
+    logger->set(l_throttle_val, count.read());
+  }
+  delete on_get;
+  return 0;
+}
+
+bool Throttle::cancel_queued(uint64_t ticket)
+{
+  list<Context*> ready;
+  bool found = false;
+  {
+    Mutex::Locker l(lock);
+    for (list<queued_get_t>::iterator p = queued.begin();
+	 p != queued.end(); ++p) {
+      if (p->ticket == ticket) {
+	ldout(cct, 10) << "cancel_queued " << p->c << " ticket " << ticket << dendl;
+	delete p->on_get;
+	queued.erase(p);
+	found = true;
+	break;
+      }
+    }
+    // whoever was behind us may fit now
+    if (found)
+      _grant_queued(ready);
+  }
+  finish_contexts(cct, ready);
+  return found;
+}
+
 int64_t Throttle::put(int64_t c)
 {
   if (0 == max.read()) {
@@ -222,19 +307,26 @@ int64_t Throttle::put(int64_t c)
 
   assert(c >= 0);
   ldout(cct, 10) << "put " << c << " (" << count.read() << " -> " << (count.read()-c) << ")" << dendl;
-  Mutex::Locker l(lock);
-  if (c) {
-    if (!cond.empty())
-      cond.front()->SignalOne();
-    assert(((int64_t)count.read()) >= c); //if count goes negative, we failed somewhere!
-    count.sub(c);
-    if (logger) {
-      logger->inc(l_throttle_put);
-      logger->inc(l_throttle_put_sum, c);
-      logger->set(l_throttle_val, count.read());
+  list<Context*> ready;
+  int64_t left;
+  {
+    Mutex::Locker l(lock);
+    if (c) {
+      if (!cond.empty())
+	cond.front()->SignalOne();
+      assert(((int64_t)count.read()) >= c); //if count goes negative, we failed somewhere!
+      count.sub(c);
+      if (logger) {
+	logger->inc(l_throttle_put);
+	logger->inc(l_throttle_put_sum, c);
+	logger->set(l_throttle_val, count.read());
+      }
+      _grant_queued(ready);
     }
+    left = count.read();
   }
-  return count.read();
+  finish_contexts(cct, ready);
+  return left;
 }
 
 SimpleThrottle::SimpleThrottle(uint64_t max, bool ignore_enoent)
@@ -29,6 +29,16 @@ class Throttle {
   ceph::atomic_t count, max;
   Mutex lock;
   list<Cond*> cond;
+  /// get_or_queue() callers waiting for slots, in arrival order
+  struct queued_get_t {
+    uint64_t ticket;
+    int64_t c;
+    Context *on_get;
+    queued_get_t(uint64_t t, int64_t c, Context *ctx)
+      : ticket(t), c(c), on_get(ctx) {}
+  };
+  list<queued_get_t> queued;
+  uint64_t last_ticket;
   const bool use_perf;
 
 public:
@@ -47,6 +57,8 @@ private:
   }
 
   bool _wait(int64_t c);
+  /// take slots for queued callers that now fit; caller completes them
+  void _grant_queued(list<Context*>& ready);
 
 public:
   /**
@@ -96,6 +108,27 @@ public:
    */
   bool get_or_fail(int64_t c = 1);
 
+  /**
+   * the asynchronous version of @p get(): take the slots now if we can,
+   * otherwise queue @p on_get, which is completed (from the thread that
+   * put() the slots back) once @p c slots have been taken on the
+   * caller's behalf.  Queued callers are served in order, and ahead of
+   * later get_or_fail() calls.
+   * @param c number of slots to get
+   * @param on_get callback; deleted if the slots are taken right away
+   * @returns 0 if it got the slots now, otherwise a ticket for
+   * @p cancel_queued()
+   */
+  uint64_t get_or_queue(int64_t c, Context *on_get);
+
+  /**
+   * remove a callback queued by @p get_or_queue()
+   * @param ticket as returned by @p get_or_queue()
+   * @returns true if it was still queued (and has been deleted), false
+   * if it has already been granted its slots, which the caller now owns
+   */
+  bool cancel_queued(uint64_t ticket);
+
   /**
    * put slots back to the stock
    * @param c number of slots to return
@@ -105,10 +138,7 @@ public:
   bool should_wait(int64_t c) const {
     return _should_wait(c);
   }
-  void reset_max(int64_t m) {
-    Mutex::Locker l(lock);
-    _reset_max(m);
-  }
+  void reset_max(int64_t m);
 };
 
 
@@ -216,8 +216,8 @@ bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector)
         ss << "slow request " << age << " seconds old, received at "
            << (*i)->get_initiated() << ": ";
         (*i)->_dump_op_descriptor_unlocked(ss);
-        ss << " currently "
-	   << ((*i)->current.size() ? (*i)->current : (*i)->state_string());
+        const char *current = (*i)->current;
+        ss << " currently " << (current ? current : (*i)->state_string());
         warning_vector.push_back(ss.str());
 
         // only those that have been shown will backoff
@@ -258,14 +258,14 @@ void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
   }
 }
 
-void OpTracker::mark_event(TrackedOp *op, const string &dest, utime_t time)
+void OpTracker::mark_event(TrackedOp *op, const char *dest, utime_t time)
 {
   if (!tracking_enabled)
     return;
   return _mark_event(op, dest, time);
 }
 
-void OpTracker::_mark_event(TrackedOp *op, const string &evt,
+void OpTracker::_mark_event(TrackedOp *op, const char *evt,
 			    utime_t time)
 {
   dout(5);
@@ -283,23 +283,114 @@ void OpTracker::RemoveOnDelete::operator()(TrackedOp *op) {
     delete op;
     return;
   }
-  op->mark_event("done");
+  utime_t now = ceph_clock_now(g_ceph_context);
+  op->_record_event(now, "done");
+  tracker->mark_event(op, "done", now);
+  op->_event_marked();
+  op->done_at = now;
   tracker->unregister_inflight_op(op);
   // Do not delete op, unregister_inflight_op took control
 }
 
-void TrackedOp::mark_event(const string &event)
+void TrackedOp::_record_event(utime_t stamp, const char *event)
+{
+  unsigned i = num_events.fetch_add(1);
+  if (i < INLINE_EVENTS) {
+    inline_events[i].stamp = stamp;
+    inline_events[i].name.store(event, std::memory_order_release);
+  } else {
+    Mutex::Locker l(lock);
+    overflow_events.push_back(make_pair(stamp, event));
+  }
+}
+
+const char *TrackedOp::intern_event_name(const string &event)
+{
+  Mutex::Locker l(lock);
+  event_names.push_back(event);
+  return event_names.back().c_str();
+}
+
+void TrackedOp::mark_event(const char *event)
 {
   if (!tracker->tracking_enabled)
     return;
 
   utime_t now = ceph_clock_now(g_ceph_context);
-  {
+  _record_event(now, event);
+  tracker->mark_event(this, event, now);
+  _event_marked();
+}
+
+void TrackedOp::mark_event(const string &event)
+{
+  if (!tracker->tracking_enabled)
+    return;
+  mark_event(intern_event_name(event));
+}
+
+const char *TrackedOp::last_event_name() const
+{
+  unsigned n = num_events.load(std::memory_order_acquire);
+  if (n > INLINE_EVENTS) {
     Mutex::Locker l(lock);
-    events.push_back(make_pair(now, event));
+    if (!overflow_events.empty())
+      return overflow_events.back().second;
+    n = INLINE_EVENTS;
+  }
+  // skip slots that have been claimed but not yet published
+  while (n > 0) {
+    const char *name = inline_events[--n].name.load(std::memory_order_acquire);
+    if (name)
+      return name;
+  }
+  return "";
+}
+
+void TrackedOp::dump_events(Formatter *f) const
+{
+  f->open_array_section("events");
+  unsigned n = num_events.load(std::memory_order_acquire);
+  for (unsigned i = 0; i < n && i < INLINE_EVENTS; ++i) {
+    const char *name = inline_events[i].name.load(std::memory_order_acquire);
+    if (!name)
+      continue;
+    f->open_object_section("event");
+    f->dump_stream("time") << inline_events[i].stamp;
+    f->dump_string("event", name);
+    f->close_section();
+  }
+  if (n > INLINE_EVENTS) {
+    Mutex::Locker l(lock);
+    for (list<pair<utime_t, const char*> >::const_iterator i =
+	   overflow_events.begin();
+	 i != overflow_events.end();
+	 ++i) {
+      f->open_object_section("event");
+      f->dump_stream("time") << i->first;
+      f->dump_string("event", i->second);
+      f->close_section();
+    }
+  }
+  f->close_section();
+}
+
+void TrackedOp::get_events(OpTraceLog::events_t *events) const
+{
+  unsigned n = num_events.load(std::memory_order_acquire);
+  for (unsigned i = 0; i < n && i < INLINE_EVENTS; ++i) {
+    const char *name = inline_events[i].name.load(std::memory_order_acquire);
+    if (name)
+      events->push_back(make_pair(name, inline_events[i].stamp));
+  }
+  if (n > INLINE_EVENTS) {
+    Mutex::Locker l(lock);
+    for (list<pair<utime_t, const char*> >::const_iterator i =
+	   overflow_events.begin();
+	 i != overflow_events.end();
+	 ++i)
+      events->push_back(make_pair(i->second, i->first));
   }
-  tracker->mark_event(this, event);
-  _event_marked();
 }
 
 void TrackedOp::dump(utime_t now, Formatter *f) const
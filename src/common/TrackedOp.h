@@ -15,9 +15,11 @@
 #define TRACKEDREQUEST_H_
 #include <sstream>
 #include <stdint.h>
+#include <atomic>
 #include <include/utime.h>
 #include "common/Mutex.h"
 #include "common/histogram.h"
+#include "common/OpTraceLog.h"
 #include "include/xlist.h"
 #include "msg/Message.h"
 #include "include/memory.h"
@@ -72,15 +74,18 @@ class OpTracker {
   OpHistory history;
   float complaint_time;
   int log_threshold;
-  void _mark_event(TrackedOp *op, const string &evt, utime_t now);
+  void _mark_event(TrackedOp *op, const char *evt, utime_t now);
 
 public:
   bool tracking_enabled;
   CephContext *cct;
+  /// where the ops picked by op_trace_sample are written when they finish
+  OpTraceLog trace_log;
   OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards) : seq(0), 
                                      num_optracker_shards(num_shards),
 				     complaint_time(0), log_threshold(0),
-				     tracking_enabled(tracking), cct(cct_) {
+				     tracking_enabled(tracking), cct(cct_),
+				     trace_log(cct_) {
 
     for (uint32_t i = 0; i < num_optracker_shards; i++) {
       char lock_name[32] = {0};
@@ -113,7 +118,7 @@ public:
    * @return True if there are any Ops to warn on, false otherwise.
    */
   bool check_ops_in_flight(std::vector<string> &warning_strings);
-  void mark_event(TrackedOp *op, const string &evt,
+  void mark_event(TrackedOp *op, const char *evt,
                           utime_t time = ceph_clock_now(g_ceph_context));
 
   void on_shutdown() {
@@ -141,28 +146,45 @@ private:
   friend class OpHistory;
   friend class OpTracker;
   xlist<TrackedOp*>::item xitem;
+
+  /// events recorded without taking the lock; the rest spill to overflow
+  static const unsigned INLINE_EVENTS = 16;
+  struct Event {
+    utime_t stamp;
+    std::atomic<const char*> name; ///< NULL until the event is published
+    Event() : name(NULL) {}
+  };
+  Event inline_events[INLINE_EVENTS];
+  std::atomic<unsigned> num_events;
+  list<pair<utime_t, const char*> > overflow_events; ///< protected by lock
+  list<string> event_names; ///< dynamic event names; protected by lock
+  utime_t done_at;
+
+  void _record_event(utime_t stamp, const char *event);
+
 protected:
   OpTracker *tracker; /// the tracker we are associated with
 
   utime_t initiated_at;
-  list<pair<utime_t, string> > events; /// list of events and their times
-  mutable Mutex lock; /// to protect the events list
-  string current; /// the current state the event is in
+  mutable Mutex lock; /// to protect overflow_events and event_names
+  std::atomic<const char*> current; /// the current state the event is in
   uint64_t seq; /// a unique value set by the OpTracker
 
   uint32_t warn_interval_multiplier; // limits output of a given op warning
 
   TrackedOp(OpTracker *_tracker, const utime_t& initiated) :
     xitem(this),
+    num_events(0),
     tracker(_tracker),
     initiated_at(initiated),
     lock("TrackedOp::lock"),
+    current(NULL),
     seq(0),
     warn_interval_multiplier(1)
   {
     tracker->register_inflight_op(&xitem);
     if (tracker->tracking_enabled)
-      events.push_back(make_pair(initiated_at, "initiated"));
+      _record_event(initiated_at, "initiated");
   }
 
   /// output any type-specific data you want to get when dump() is called
@@ -174,6 +196,13 @@ protected:
   /// called when the last non-OpTracker reference is dropped
   virtual void _unregistered() {};
 
+  /// copy a dynamic event name into storage that lives as long as the op
+  const char *intern_event_name(const string &event);
+  /// dump the recorded events as an "events" array
+  void dump_events(Formatter *f) const;
+  /// append the recorded events, oldest first
+  void get_events(OpTraceLog::events_t *events) const;
+
 public:
   virtual ~TrackedOp() {}
 
@@ -182,15 +211,24 @@ public:
   }
 
   double get_duration() const {
-    if (!events.empty() && events.rbegin()->second.compare("done") == 0)
-      return events.rbegin()->first - get_initiated();
+    if (done_at != utime_t())
+      return done_at - get_initiated();
     else
       return ceph_clock_now(NULL) - get_initiated();
   }
 
+  /**
+   * Record an event.  The const char* variant stores only the pointer, so
+   * the string must outlive the op (a literal, __func__, or the result of
+   * intern_event_name()); it takes no locks for the first INLINE_EVENTS
+   * events.  The string variant copies the name first.
+   */
+  void mark_event(const char *event);
   void mark_event(const string &event);
+  /// name of the most recently recorded event, or "" if there is none
+  const char *last_event_name() const;
   virtual const char *state_string() const {
-    return events.rbegin()->second.c_str();
+    return last_event_name();
   }
   void dump(utime_t now, Formatter *f) const;
 };
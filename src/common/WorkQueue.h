@@ -18,6 +18,7 @@
 #include "Mutex.h"
 #include "Cond.h"
 #include "Thread.h"
+#include "MPSCQueue.h"
 #include "common/config_obs.h"
 #include "common/HeartbeatMap.h"
 
@@ -98,14 +99,27 @@ public:
   template<class T>
   class BatchWorkQueue : public WorkQueue_ {
     ThreadPool *pool;
+    /// items from queue_lockless() not yet handed to _enqueue()
+    MPSCQueue<T*> inbox;
 
     virtual bool _enqueue(T *) = 0;
     virtual void _dequeue(T *) = 0;
     virtual void _dequeue(list<T*> *) = 0;
     virtual void _process_finish(const list<T*> &) {}
 
+    /// move the inbox into the queue proper; pool lock held
+    void _drain_inbox() {
+      if (inbox.empty())
+	return;
+      vector<T*> ls;
+      inbox.pop_all(ls);
+      for (typename vector<T*>::iterator p = ls.begin(); p != ls.end(); ++p)
+	_enqueue(*p);
+    }
+
     // virtual methods from WorkQueue_ below
     void *_void_dequeue() {
+      _drain_inbox();
       list<T*> *out(new list<T*>);
       _dequeue(out);
       if (!out->empty()) {
@@ -140,18 +154,32 @@ public:
 
     bool queue(T *item) {
       pool->_lock.Lock();
+      _drain_inbox();
       bool r = _enqueue(item);
       pool->_cond.SignalOne();
       pool->_lock.Unlock();
       return r;
     }
+    /** @brief Queue an item without taking the pool lock.
+     * The item is handed to _enqueue() later, under the pool lock, by
+     * whichever thread next dequeues; it must stay valid until then.
+     * Only the producer that finds the inbox empty wakes a worker. */
+    void queue_lockless(T *item) {
+      if (inbox.push(item)) {
+	pool->_lock.Lock();
+	pool->_cond.SignalOne();
+	pool->_lock.Unlock();
+      }
+    }
     void dequeue(T *item) {
       pool->_lock.Lock();
+      _drain_inbox();
       _dequeue(item);
       pool->_lock.Unlock();
     }
     void clear() {
       pool->_lock.Lock();
+      _drain_inbox();
       _clear();
       pool->_lock.Unlock();
     }
@@ -169,6 +197,9 @@ public:
       pool->_wake();
     }
     void drain() {
+      pool->_lock.Lock();
+      _drain_inbox();
+      pool->_lock.Unlock();
       pool->drain(this);
     }
 
@@ -109,6 +109,8 @@ AdminSocket::AdminSocket(CephContext *cct)
     m_sock_fd(-1),
     m_shutdown_rd_fd(-1),
     m_shutdown_wr_fd(-1),
+    m_queue_lock("AdminSocket::m_queue_lock"),
+    m_stopping(false),
     m_lock("AdminSocket::m_lock"),
     m_version_hook(NULL),
     m_help_hook(NULL),
@@ -122,9 +124,10 @@ AdminSocket::~AdminSocket()
 }
 
 /*
- * This thread listens on the UNIX domain socket for incoming connections.
- * It only handles one connection at a time at the moment. All I/O is nonblocking,
- * so that we can implement sensible timeouts. [TODO: make all I/O nonblocking]
+ * This thread listens on the UNIX domain socket for incoming connections
+ * and queues them for the workers, so that a slow client or a slow
+ * command doesn't hold up the others; with admin_socket_threads = 0 it
+ * serves them itself, one at a time.
  *
  * This thread also listens to m_shutdown_rd_fd. If there is any data sent to this
  * pipe, the thread terminates itself gracefully, allowing the
@@ -287,6 +290,51 @@ void* AdminSocket::entry()
 }
 
 
+void AdminSocket::worker_entry()
+{
+  m_queue_lock.Lock();
+  while (true) {
+    while (m_queue.empty() && !m_stopping)
+      m_queue_cond.Wait(m_queue_lock);
+    if (m_stopping)
+      break;
+    int fd = m_queue.front();
+    m_queue.pop_front();
+    m_queue_lock.Unlock();
+    handle_connection(fd);
+    m_queue_lock.Lock();
+  }
+  m_queue_lock.Unlock();
+}
+
+void AdminSocket::start_workers()
+{
+  m_stopping = false;
+  int n = m_cct->_conf->admin_socket_threads;
+  for (int i = 0; i < n; ++i) {
+    Worker *w = new Worker(this);
+    w->create();
+    m_workers.push_back(w);
+  }
+}
+
+void AdminSocket::stop_workers()
+{
+  m_queue_lock.Lock();
+  m_stopping = true;
+  m_queue_cond.SignalAll();
+  m_queue_lock.Unlock();
+  for (unsigned i = 0; i < m_workers.size(); ++i) {
+    m_workers[i]->join();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+  while (!m_queue.empty()) {
+    VOID_TEMP_FAILURE_RETRY(close(m_queue.front()));
+    m_queue.pop_front();
+  }
+}
+
 bool AdminSocket::do_accept()
 {
   struct sockaddr_un address;
@@ -302,6 +350,16 @@ bool AdminSocket::do_accept()
     return false;
   }
 
+  if (m_workers.empty())
+    return handle_connection(connection_fd);
+  Mutex::Locker l(m_queue_lock);
+  m_queue.push_back(connection_fd);
+  m_queue_cond.Signal();
+  return true;
+}
+
+bool AdminSocket::handle_connection(int connection_fd)
+{
   char cmd[1024];
   int pos = 0;
   string c;
@@ -353,6 +411,7 @@ bool AdminSocket::do_accept()
   cmdvec.push_back(cmd);
   if (!cmdmap_from_json(cmdvec, &cmdmap, errss)) {
     ldout(m_cct, 0) << "AdminSocket: " << errss.rdbuf() << dendl;
+    VOID_TEMP_FAILURE_RETRY(close(connection_fd));
     return false;
   }
   cmd_getval(m_cct, cmdmap, "format", format);
@@ -363,37 +422,55 @@ bool AdminSocket::do_accept()
 
   m_lock.Lock();
   map<string,AdminSocketHook*>::iterator p;
-  string match = c;
-  while (match.size()) {
-    p = m_hooks.find(match);
-    if (p != m_hooks.end())
-      break;
-    
-    // drop right-most word
-    size_t pos = match.rfind(' ');
-    if (pos == std::string::npos) {
-      match.clear();  // we fail
-      break;
-    } else {
-      match.resize(pos);
+  string match;
+  while (true) {
+    match = c;
+    while (match.size()) {
+      p = m_hooks.find(match);
+      if (p != m_hooks.end())
+	break;
+
+      // drop right-most word
+      size_t pos = match.rfind(' ');
+      if (pos == std::string::npos) {
+	match.clear();  // we fail
+	break;
+      } else {
+	match.resize(pos);
+      }
     }
+    if (p == m_hooks.end() || !m_in_hook.count(p->second))
+      break;
+    // the hook is busy; it may be gone once it is done, look again then
+    m_in_hook_cond.Wait(m_lock);
   }
 
   bufferlist out;
   if (p == m_hooks.end()) {
     lderr(m_cct) << "AdminSocket: request '" << c << "' not defined" << dendl;
+    m_lock.Unlock();
   } else {
+    AdminSocketHook *hook = p->second;
+    m_in_hook.insert(hook);
+    m_lock.Unlock();
+
     string args;
     if (match != c)
       args = c.substr(match.length() + 1);
-    bool success = p->second->call(match, cmdmap, format, out);
+    bool success = hook->call(match, cmdmap, format, out);
+
+    m_lock.Lock();
+    m_in_hook.erase(hook);
+    m_in_hook_cond.SignalAll();
+    m_lock.Unlock();
+
     if (!success) {
       ldout(m_cct, 0) << "AdminSocket: request '" << match << "' args '" << args
-		      << "' to " << p->second << " failed" << dendl;
+		      << "' to " << hook << " failed" << dendl;
       out.append("failed");
     } else {
       ldout(m_cct, 5) << "AdminSocket: request '" << match << "' '" << args
-		       << "' to " << p->second
+		       << "' to " << hook
 		       << " returned " << out.length() << " bytes" << dendl;
     }
     uint32_t len = htonl(out.length());
@@ -406,7 +483,6 @@ bool AdminSocket::do_accept()
 	rval = true;
     }
   }
-  m_lock.Unlock();
 
   VOID_TEMP_FAILURE_RETRY(close(connection_fd));
   return rval;
@@ -436,9 +512,13 @@ int AdminSocket::unregister_command(std::string command)
   m_lock.Lock();
   if (m_hooks.count(command)) {
     ldout(m_cct, 5) << "unregister_command " << command << dendl;
+    AdminSocketHook *hook = m_hooks[command];
     m_hooks.erase(command);
     m_descs.erase(command);
     m_help.erase(command);
+    // the caller is likely to delete the hook next
+    while (m_in_hook.count(hook))
+      m_in_hook_cond.Wait(m_lock);
     ret = 0;
   } else {
     ldout(m_cct, 5) << "unregister_command " << command << " ENOENT" << dendl;
@@ -476,6 +556,7 @@ public:
   HelpHook(AdminSocket *as) : m_as(as) {}
   bool call(string command, cmdmap_t &cmdmap, string format, bufferlist& out) {
     Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
+    Mutex::Locker l(m_as->m_lock);
     f->open_object_section("help");
     for (map<string,string>::iterator p = m_as->m_help.begin();
 	 p != m_as->m_help.end();
@@ -499,6 +580,7 @@ public:
   bool call(string command, cmdmap_t &cmdmap, string format, bufferlist& out) {
     int cmdnum = 0;
     JSONFormatter jf(false);
+    Mutex::Locker l(m_as->m_lock);
     jf.open_object_section("command_descriptions");
     for (map<string,string>::iterator p = m_as->m_descs.begin();
 	 p != m_as->m_descs.end();
@@ -557,6 +639,7 @@ bool AdminSocket::init(const std::string &path)
 		   m_getdescs_hook, "list available commands");
 
   create();
+  start_workers();
   add_cleanup_file(m_path.c_str());
   return true;
 }
@@ -578,6 +661,7 @@ void AdminSocket::shutdown()
     lderr(m_cct) << "AdminSocket::shutdown: error: " << err << dendl;
   }
 
+  stop_workers();
   VOID_TEMP_FAILURE_RETRY(close(m_sock_fd));
 
   unregister_command("version");
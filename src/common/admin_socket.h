@@ -16,10 +16,14 @@
 #define CEPH_COMMON_ADMIN_SOCKET_H
 
 #include "common/Thread.h"
+#include "common/Cond.h"
 #include "common/Mutex.h"
 
+#include <list>
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 #include "include/buffer.h"
 #include "common/cmdparse.h"
 
@@ -84,6 +88,21 @@ private:
 
   void *entry();
   bool do_accept();
+  bool handle_connection(int connection_fd);
+
+  /// serves the connections do_accept() queues, admin_socket_threads of them
+  class Worker : public Thread {
+    AdminSocket *m_asok;
+  public:
+    Worker(AdminSocket *asok) : m_asok(asok) {}
+    void *entry() {
+      m_asok->worker_entry();
+      return 0;
+    }
+  };
+  void worker_entry();
+  void start_workers();
+  void stop_workers();
 
   CephContext *m_cct;
   std::string m_path;
@@ -91,7 +110,20 @@ private:
   int m_shutdown_rd_fd;
   int m_shutdown_wr_fd;
 
-  Mutex m_lock;    // protects m_hooks, m_descs, m_help
+  Mutex m_queue_lock;   // protects m_queue, m_stopping
+  Cond m_queue_cond;
+  std::list<int> m_queue;
+  bool m_stopping;
+  std::vector<Worker*> m_workers;
+
+  Mutex m_lock;    // protects m_hooks, m_descs, m_help, m_in_hook
+  /**
+   * hooks being called.  Different hooks run concurrently, but each
+   * hook only serves one command at a time, as it always has, and
+   * unregister_command() waits for the hook to return.
+   */
+  std::set<AdminSocketHook*> m_in_hook;
+  Cond m_in_hook_cond;
   AdminSocketHook *m_version_hook, *m_help_hook, *m_getdescs_hook;
 
   std::map<std::string,AdminSocketHook*> m_hooks;
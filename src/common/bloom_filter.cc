@@ -135,3 +135,72 @@ void compressible_bloom_filter::generate_test_instances(list<compressible_bloom_
   ls.back()->compress(20);
   ls.back()->insert("boogggg");
 }
+
+
+void blocked_bloom_filter::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode((uint64_t)hash_count_, bl);
+  ::encode((uint64_t)insert_count_, bl);
+  ::encode((uint64_t)target_element_count_, bl);
+  ::encode((uint64_t)random_seed_, bl);
+  uint32_t n = block_count_ * block_words;
+  ::encode(n, bl);
+  for (unsigned i = 0; i < n; ++i)
+    ::encode(table_[i], bl);
+  ENCODE_FINISH(bl);
+}
+
+void blocked_bloom_filter::decode(bufferlist::iterator& p)
+{
+  DECODE_START(1, p);
+  uint64_t v;
+  ::decode(v, p);
+  hash_count_ = v;
+  ::decode(v, p);
+  insert_count_ = v;
+  ::decode(v, p);
+  target_element_count_ = v;
+  ::decode(v, p);
+  random_seed_ = v;
+  uint32_t n;
+  ::decode(n, p);
+  if (n % block_words)
+    throw buffer::malformed_input("blocked_bloom_filter table is not whole blocks");
+
+  free(table_);
+  block_count_ = n / block_words;
+  init();
+  for (unsigned i = 0; i < n; ++i)
+    ::decode(table_[i], p);
+
+  DECODE_FINISH(p);
+}
+
+void blocked_bloom_filter::dump(Formatter *f) const
+{
+  f->dump_unsigned("hash_count", hash_count_);
+  f->dump_unsigned("block_count", block_count_);
+  f->dump_unsigned("insert_count", insert_count_);
+  f->dump_unsigned("target_element_count", target_element_count_);
+  f->dump_unsigned("random_seed", random_seed_);
+
+  f->open_array_section("bit_table");
+  for (unsigned i = 0; i < block_count_ * block_words; ++i)
+    f->dump_unsigned("word", table_[i]);
+  f->close_section();
+}
+
+void blocked_bloom_filter::generate_test_instances(list<blocked_bloom_filter*>& ls)
+{
+  ls.push_back(new blocked_bloom_filter(10, .5, 1));
+  ls.push_back(new blocked_bloom_filter(10, .5, 1));
+  ls.back()->insert("foo");
+  ls.back()->insert("bar");
+  ls.push_back(new blocked_bloom_filter(200, .01, 1));
+  ls.back()->insert("foo");
+  ls.back()->insert("bar");
+  ls.back()->insert("baz");
+  ls.back()->insert("boof");
+  ls.back()->insert("boogggg");
+}
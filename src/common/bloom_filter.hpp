@@ -23,9 +23,12 @@
 #define COMMON_BLOOM_FILTER_HPP
 
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <new>
 #include <list>
 #include <string>
 #include <vector>
@@ -210,6 +213,19 @@ public:
     }
   }
 
+  /**
+   * insert n u32s
+   *
+   * The per probe division in compute_indices() costs more than the
+   * hashing here, so this is just a loop; blocked_bloom_filter is the
+   * one that gains from batches.
+   */
+  inline void insert_batch(const uint32_t *vals, std::size_t n)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+      insert(vals[i]);
+  }
+
   /**
    * check if a u32 is contained by set
    *
@@ -270,6 +286,25 @@ public:
     return contains(reinterpret_cast<const unsigned char*>(data),length);
   }
 
+  /**
+   * check n u32s
+   *
+   * @param result if not NULL, result[i] is set to contains(vals[i])
+   * @returns how many are (probably) in the set
+   */
+  inline std::size_t contains_batch(const uint32_t *vals, std::size_t n,
+				    bool *result) const
+  {
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      bool hit = contains(vals[i]);
+      found += hit;
+      if (result)
+	result[i] = hit;
+    }
+    return found;
+  }
+
   template<typename InputIterator>
   inline InputIterator contains_all(const InputIterator begin, const InputIterator end) const
   {
@@ -326,16 +361,8 @@ public:
   {
     if (!bit_table_)
       return 0.0;
-    size_t set = 0;
-    uint8_t *p = bit_table_;
-    size_t left = table_size_;
-    while (left-- > 0) {
-      uint8_t c = *p;
-      for (; c; ++set)
-	c &= c - 1;
-      ++p;
-    }
-    return (double)set / (double)(table_size_ << 3);
+    return (double)count_bits(bit_table_, table_size_) /
+      (double)(table_size_ << 3);
   }
 
   virtual inline double approx_unique_element_count() const {
@@ -361,6 +388,21 @@ public:
     return bit_table_;
   }
 
+  /// bits set in len bytes at p
+  static std::size_t count_bits(const unsigned char *p, std::size_t len)
+  {
+    std::size_t set = 0;
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+      uint64_t w;
+      memcpy(&w, p, sizeof(w));
+      set += __builtin_popcountll(w);
+      p += sizeof(w);
+    }
+    while (len-- > 0)
+      set += __builtin_popcount(*p++);
+    return set;
+  }
+
 protected:
 
   inline virtual void compute_indices(const bloom_type& hash, std::size_t& bit_index, std::size_t& bit) const
@@ -576,17 +618,16 @@ public:
       return false;
     }
 
+    // fold the table onto its first new_table_size bytes a stripe at a
+    // time: the inner loop has no wraparound test and vectorizes
     cell_type* tmp = new cell_type[new_table_size];
     std::copy(bit_table_, bit_table_ + (new_table_size), tmp);
-    cell_type* itr = bit_table_ + (new_table_size);
-    cell_type* end = bit_table_ + (original_table_size);
-    cell_type* itr_tmp = tmp;
-    cell_type* itr_end = tmp + (new_table_size);
-    while (end != itr)
-    {
-      *(itr_tmp++) |= (*itr++);
-      if (itr_tmp == itr_end)
-	itr_tmp = tmp;
+    for (std::size_t off = new_table_size; off < original_table_size;
+	 off += new_table_size) {
+      std::size_t len = std::min(new_table_size, original_table_size - off);
+      const cell_type* src = bit_table_ + off;
+      for (std::size_t i = 0; i < len; ++i)
+	tmp[i] |= src[i];
     }
 
     delete[] bit_table_;
@@ -626,6 +667,369 @@ public:
 };
 WRITE_CLASS_ENCODER(compressible_bloom_filter)
 
+
+/*
+ * A blocked bloom filter: each element sets and tests its bits in a
+ * single 64-byte, cache line aligned block, picked by its hash, so a
+ * lookup costs one cache miss instead of one per hash, and the bits
+ * are tested by comparing the block with a mask of the element's bits
+ * a word at a time.  The hashes are a 64-bit mix of the value (rather
+ * than the salted hash_ap() above, which is weak on consecutive
+ * integers), and each probe only takes a multiply to derive.
+ *
+ * The blocks fill unevenly, which costs some accuracy: the table is
+ * sized 10% larger than a bloom_filter for the same fpp to make up for
+ * it.  It can not be compressed, and it is not encoded the same way as
+ * bloom_filter.
+ */
+class blocked_bloom_filter
+{
+public:
+  static const std::size_t block_bytes = 64;
+  static const std::size_t block_words = block_bytes / sizeof(uint64_t);
+  static const std::size_t block_bits = block_bytes * bits_per_char;
+
+protected:
+
+  uint64_t*           table_;        ///< block_count_ blocks of block_words
+  std::size_t         hash_count_;   ///< bits set per element
+  std::size_t         block_count_;  ///< number of blocks
+  std::size_t         insert_count_;  ///< insertion count
+  std::size_t         target_element_count_;  ///< target number of unique insertions
+  std::size_t         random_seed_;  ///< random seed
+  uint64_t            seed_hash_;    ///< mixed into every element's hash
+
+  /// values hashed together by insert_batch() and contains_batch()
+  static const std::size_t batch_size = 16;
+
+public:
+
+  blocked_bloom_filter()
+    : table_(NULL),
+      hash_count_(0),
+      block_count_(0),
+      insert_count_(0),
+      target_element_count_(0),
+      random_seed_(0),
+      seed_hash_(0)
+  {}
+
+  blocked_bloom_filter(const std::size_t& predicted_inserted_element_count,
+		       const double& false_positive_probability,
+		       const std::size_t& random_seed)
+    : table_(NULL),
+      insert_count_(0),
+      target_element_count_(predicted_inserted_element_count),
+      random_seed_((random_seed) ? random_seed : 0xA5A5A5A5)
+  {
+    assert(false_positive_probability > 0.0);
+    find_optimal_parameters(predicted_inserted_element_count,
+			    false_positive_probability,
+			    &hash_count_, &block_count_);
+    init();
+  }
+
+  blocked_bloom_filter(const blocked_bloom_filter& filter)
+    : table_(NULL)
+  {
+    this->operator=(filter);
+  }
+
+  blocked_bloom_filter& operator = (const blocked_bloom_filter& filter)
+  {
+    if (this != &filter) {
+      hash_count_ = filter.hash_count_;
+      block_count_ = filter.block_count_;
+      insert_count_ = filter.insert_count_;
+      target_element_count_ = filter.target_element_count_;
+      random_seed_ = filter.random_seed_;
+      seed_hash_ = filter.seed_hash_;
+      free(table_);
+      table_ = alloc_table(block_count_);
+      if (table_)
+	memcpy(table_, filter.table_, block_count_ * block_bytes);
+    }
+    return *this;
+  }
+
+  ~blocked_bloom_filter()
+  {
+    free(table_);
+  }
+
+  inline bool operator!() const
+  {
+    return (0 == block_count_);
+  }
+
+  inline void clear()
+  {
+    if (table_)
+      memset(table_, 0, block_count_ * block_bytes);
+    insert_count_ = 0;
+  }
+
+  inline void insert(uint32_t val)
+  {
+    assert(table_);
+    insert_hash(hash_val(val));
+    ++insert_count_;
+  }
+
+  inline void insert(const unsigned char* key_begin, const std::size_t& length)
+  {
+    assert(table_);
+    insert_hash(hash_bytes(key_begin, length));
+    ++insert_count_;
+  }
+
+  inline void insert(const std::string& key)
+  {
+    insert(reinterpret_cast<const unsigned char*>(key.c_str()), key.size());
+  }
+
+  inline void insert(const char* data, const std::size_t& length)
+  {
+    insert(reinterpret_cast<const unsigned char*>(data), length);
+  }
+
+  /**
+   * insert n u32s
+   *
+   * All the hashes of a run of values are computed first and their
+   * blocks prefetched, so the cache misses overlap instead of being
+   * taken one after the other.
+   */
+  inline void insert_batch(const uint32_t *vals, std::size_t n)
+  {
+    assert(table_);
+    uint64_t hash[batch_size];
+    for (std::size_t b = 0; b < n; b += batch_size) {
+      std::size_t len = std::min(batch_size, n - b);
+      for (std::size_t j = 0; j < len; ++j)
+	hash[j] = hash_val(vals[b + j]);
+      for (std::size_t j = 0; j < len; ++j)
+	__builtin_prefetch(block(hash[j]), 1);
+      for (std::size_t j = 0; j < len; ++j)
+	insert_hash(hash[j]);
+    }
+    insert_count_ += n;
+  }
+
+  inline bool contains(uint32_t val) const
+  {
+    if (!table_)
+      return false;
+    return contains_hash(hash_val(val));
+  }
+
+  inline bool contains(const unsigned char* key_begin, const std::size_t length) const
+  {
+    if (!table_)
+      return false;
+    return contains_hash(hash_bytes(key_begin, length));
+  }
+
+  inline bool contains(const std::string& key) const
+  {
+    return contains(reinterpret_cast<const unsigned char*>(key.c_str()), key.size());
+  }
+
+  inline bool contains(const char* data, const std::size_t& length) const
+  {
+    return contains(reinterpret_cast<const unsigned char*>(data), length);
+  }
+
+  /**
+   * check n u32s, as insert_batch() does
+   *
+   * @param result if not NULL, result[i] is set to contains(vals[i])
+   * @returns how many are (probably) in the set
+   */
+  inline std::size_t contains_batch(const uint32_t *vals, std::size_t n,
+				    bool *result) const
+  {
+    if (!table_) {
+      if (result)
+	std::fill_n(result, n, false);
+      return 0;
+    }
+    std::size_t found = 0;
+    uint64_t hash[batch_size];
+    for (std::size_t b = 0; b < n; b += batch_size) {
+      std::size_t len = std::min(batch_size, n - b);
+      for (std::size_t j = 0; j < len; ++j)
+	hash[j] = hash_val(vals[b + j]);
+      for (std::size_t j = 0; j < len; ++j)
+	__builtin_prefetch(block(hash[j]));
+      for (std::size_t j = 0; j < len; ++j) {
+	bool hit = contains_hash(hash[j]);
+	found += hit;
+	if (result)
+	  result[b + j] = hit;
+      }
+    }
+    return found;
+  }
+
+  inline std::size_t size() const
+  {
+    return block_count_ * block_bits;
+  }
+
+  inline std::size_t element_count() const
+  {
+    return insert_count_;
+  }
+
+  inline bool is_full() const
+  {
+    return insert_count_ >= target_element_count_;
+  }
+
+  /// density of bits set, as bloom_filter::density()
+  inline double density() const
+  {
+    if (!table_)
+      return 0.0;
+    return (double)bloom_filter::count_bits(
+      reinterpret_cast<const unsigned char*>(table_),
+      block_count_ * block_bytes) / (double)size();
+  }
+
+  inline double approx_unique_element_count() const {
+    return (double)target_element_count_ * 2.0 * density();
+  }
+
+  /// as bloom_filter::effective_fpp(); a little optimistic for blocks
+  inline double effective_fpp() const
+  {
+    if (!block_count_)
+      return 1.0;
+    return std::pow(1.0 - std::exp(-1.0 * hash_count_ * insert_count_ / size()),
+		    1.0 * hash_count_);
+  }
+
+  inline std::size_t hash_count() const
+  {
+    return hash_count_;
+  }
+
+protected:
+
+  static uint64_t* alloc_table(std::size_t blocks)
+  {
+    if (!blocks)
+      return NULL;
+    void *p;
+    if (posix_memalign(&p, block_bytes, blocks * block_bytes))
+      throw std::bad_alloc();
+    return static_cast<uint64_t*>(p);
+  }
+
+  void init()
+  {
+    seed_hash_ = mix(random_seed_);
+    table_ = alloc_table(block_count_);
+    if (table_)
+      memset(table_, 0, block_count_ * block_bytes);
+  }
+
+  static void find_optimal_parameters(std::size_t target_insert_count,
+				      double target_fpp,
+				      std::size_t *hash_count,
+				      std::size_t *block_count)
+  {
+    // m = -n ln(p) / ln(2)^2, k = m/n ln(2), plus 10% for the blocks
+    double n = std::max<std::size_t>(target_insert_count, 1);
+    double m = -n * std::log(target_fpp) / (M_LN2 * M_LN2);
+    double k = std::floor(m / n * M_LN2 + 0.5);
+    *hash_count = std::max<std::size_t>(static_cast<std::size_t>(k), 1);
+    *block_count = std::max<std::size_t>(
+      static_cast<std::size_t>(std::ceil(m * 1.1 / block_bits)), 1);
+  }
+
+  /// the murmur3 64-bit finalizer
+  static inline uint64_t mix(uint64_t h)
+  {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  inline uint64_t hash_val(uint32_t val) const
+  {
+    return mix(val ^ seed_hash_);
+  }
+
+  inline uint64_t hash_bytes(const unsigned char* p, std::size_t len) const
+  {
+    uint64_t h = seed_hash_ ^ len;
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+      uint64_t w;
+      memcpy(&w, p, sizeof(w));
+      h = mix(h ^ w);
+      p += sizeof(w);
+    }
+    if (len) {
+      uint64_t w = 0;
+      memcpy(&w, p, len);
+      h = mix(h ^ w);
+    }
+    return h;
+  }
+
+  /// the low 32 bits of the hash pick the block, without a division
+  inline uint64_t* block(uint64_t hash) const
+  {
+    uint64_t b = ((hash & 0xffffffffULL) * block_count_) >> 32;
+    return table_ + b * block_words;
+  }
+
+  /// the element's bits in its block: each probe is the top bits of
+  /// the hash times a (Weyl) constant, applied once more per probe
+  inline void make_mask(uint64_t hash, uint64_t *mask) const
+  {
+    for (std::size_t w = 0; w < block_words; ++w)
+      mask[w] = 0;
+    for (std::size_t i = 0; i < hash_count_; ++i) {
+      hash *= 0x9e3779b97f4a7c15ULL;
+      unsigned bit = hash >> 55;  // 0..block_bits-1
+      mask[bit >> 6] |= 1ULL << (bit & 63);
+    }
+  }
+
+  inline void insert_hash(uint64_t hash)
+  {
+    uint64_t mask[block_words];
+    make_mask(hash, mask);
+    uint64_t *b = block(hash);
+    for (std::size_t w = 0; w < block_words; ++w)
+      b[w] |= mask[w];
+  }
+
+  inline bool contains_hash(uint64_t hash) const
+  {
+    uint64_t mask[block_words];
+    make_mask(hash, mask);
+    const uint64_t *b = block(hash);
+    uint64_t missing = 0;
+    for (std::size_t w = 0; w < block_words; ++w)
+      missing |= mask[w] & ~b[w];
+    return !missing;
+  }
+
+public:
+  void encode(bufferlist& bl) const;
+  void decode(bufferlist::iterator& bl);
+  void dump(Formatter *f) const;
+  static void generate_test_instances(std::list<blocked_bloom_filter*>& ls);
+};
+WRITE_CLASS_ENCODER(blocked_bloom_filter)
+
 #endif
 
 
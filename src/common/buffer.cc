@@ -21,7 +21,6 @@
 #include "common/strtol.h"
 #include "common/likely.h"
 #include "include/atomic.h"
-#include "common/RWLock.h"
 #include "include/types.h"
 #include "include/compat.h"
 #include "include/inline_memory.h"
@@ -86,6 +85,161 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     return buffer_c_str_accesses.read();
   }
 
+  /*
+   * per-thread state: the accounting shard this thread updates, and its
+   * cache of free data buffers.
+   */
+#define BUFFER_POOL_SHARDS 32
+#define BUFFER_CACHE_CLASSES 3
+
+  static const unsigned buffer_cache_class_size[BUFFER_CACHE_CLASSES] = {
+    4096, 65536, 4194304
+  };
+
+  static atomic_t buffer_cache_max;   // bytes per thread, 0 = disabled
+  static atomic64_t buffer_cache_bytes;
+  static atomic64_t buffer_cache_hits;
+  static atomic64_t buffer_cache_misses;
+  static atomic_t buffer_thread_seq;
+
+  struct buffer_thread_t {
+    unsigned shard;
+    size_t cached;
+    std::vector<char*> free[BUFFER_CACHE_CLASSES];
+
+    buffer_thread_t()
+      : shard(buffer_thread_seq.inc() % BUFFER_POOL_SHARDS), cached(0) {}
+    ~buffer_thread_t() {
+      for (int i = 0; i < BUFFER_CACHE_CLASSES; ++i)
+	for (unsigned j = 0; j < free[i].size(); ++j)
+	  ::free(free[i][j]);
+      buffer_cache_bytes.sub(cached);
+    }
+  };
+
+  static pthread_key_t buffer_thread_key;
+  static pthread_once_t buffer_thread_once = PTHREAD_ONCE_INIT;
+
+  static void buffer_thread_destroy(void *p) {
+    delete static_cast<buffer_thread_t*>(p);
+  }
+  static void buffer_thread_key_init() {
+    int r = pthread_key_create(&buffer_thread_key, buffer_thread_destroy);
+    assert(r == 0);
+  }
+  static buffer_thread_t *buffer_thread() {
+    pthread_once(&buffer_thread_once, buffer_thread_key_init);
+    buffer_thread_t *t =
+      static_cast<buffer_thread_t*>(pthread_getspecific(buffer_thread_key));
+    if (unlikely(!t)) {
+      t = new buffer_thread_t;
+      pthread_setspecific(buffer_thread_key, t);
+    }
+    return t;
+  }
+
+  /*
+   * memory accounting, by the subsystem that pins the buffers.  sharded
+   * to keep threads off each other's cache lines; a raw freed on another
+   * thread makes one shard go "negative", but the sums stay right.
+   */
+  static const char *buffer_pool_name[buffer::POOL_MAX] = {
+    "anon", "osd", "msgr", "objectcacher"
+  };
+
+  struct buffer_pool_shard_t {
+    atomic64_t bytes;
+    atomic64_t items;
+    char __pad[128 - 2 * sizeof(atomic64_t)];
+  };
+  static buffer_pool_shard_t buffer_pools[buffer::POOL_MAX][BUFFER_POOL_SHARDS];
+
+  static void buffer_pool_add(int pool, unsigned len) {
+    buffer_pool_shard_t &s = buffer_pools[pool][buffer_thread()->shard];
+    s.bytes.add(len);
+    s.items.inc();
+  }
+  static void buffer_pool_sub(int pool, unsigned len) {
+    buffer_pool_shard_t &s = buffer_pools[pool][buffer_thread()->shard];
+    s.bytes.sub(len);
+    s.items.dec();
+  }
+
+  const char *buffer::get_pool_name(int pool) {
+    assert(pool >= 0 && pool < POOL_MAX);
+    return buffer_pool_name[pool];
+  }
+  int64_t buffer::get_pool_bytes(int pool) {
+    assert(pool >= 0 && pool < POOL_MAX);
+    uint64_t total = 0;
+    for (int i = 0; i < BUFFER_POOL_SHARDS; ++i)
+      total += buffer_pools[pool][i].bytes.read();
+    return (int64_t)total;
+  }
+  int64_t buffer::get_pool_items(int pool) {
+    assert(pool >= 0 && pool < POOL_MAX);
+    uint64_t total = 0;
+    for (int i = 0; i < BUFFER_POOL_SHARDS; ++i)
+      total += buffer_pools[pool][i].items.read();
+    return (int64_t)total;
+  }
+
+  /*
+   * per-thread cache of page aligned data buffers in the size classes
+   * the OSD and messengers churn through.  a buffer goes back to the
+   * cache of whichever thread frees it.
+   */
+  static int buffer_cache_class(unsigned len, unsigned align) {
+    if (align > CEPH_PAGE_SIZE)
+      return -1;
+    for (int i = 0; i < BUFFER_CACHE_CLASSES; ++i)
+      if (len == buffer_cache_class_size[i])
+	return i;
+    return -1;
+  }
+
+  static char *buffer_cache_get(int c) {
+    if (!buffer_cache_max.read())
+      return NULL;
+    buffer_thread_t *t = buffer_thread();
+    if (t->free[c].empty()) {
+      buffer_cache_misses.inc();
+      return NULL;
+    }
+    char *p = t->free[c].back();
+    t->free[c].pop_back();
+    t->cached -= buffer_cache_class_size[c];
+    buffer_cache_bytes.sub(buffer_cache_class_size[c]);
+    buffer_cache_hits.inc();
+    return p;
+  }
+
+  static bool buffer_cache_put(int c, char *p) {
+    size_t max = buffer_cache_max.read();
+    if (!max)
+      return false;
+    buffer_thread_t *t = buffer_thread();
+    if (t->cached + buffer_cache_class_size[c] > max)
+      return false;
+    t->free[c].push_back(p);
+    t->cached += buffer_cache_class_size[c];
+    buffer_cache_bytes.add(buffer_cache_class_size[c]);
+    return true;
+  }
+
+  void buffer::set_thread_cache_size(size_t bytes) {
+    buffer_cache_max.set(bytes);
+  }
+  int64_t buffer::get_thread_cache_bytes() {
+    return buffer_cache_bytes.read();
+  }
+  int64_t buffer::get_thread_cache_hits() {
+    return buffer_cache_hits.read();
+  }
+  int64_t buffer::get_thread_cache_misses() {
+    return buffer_cache_misses.read();
+  }
+
   static atomic_t buffer_max_pipe_size;
   int update_max_pipe_size() {
 #ifdef CEPH_HAVE_SETPIPE_SZ
@@ -141,18 +295,50 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     unsigned len;
     atomic_t nref;
 
-    mutable RWLock crc_lock;
-    map<pair<size_t, size_t>, pair<uint32_t, uint32_t> > crc_map;
+    /*
+     * The crcs of the last few ranges hashed, each under a sequence
+     * count that is odd while the slot is written: readers retry or
+     * miss instead of taking a lock, and a writer that loses the race
+     * for a slot just doesn't cache.  An empty slot is the range 0~0
+     * with crc 0 from base 0, which is also what a hit on it yields.
+     */
+    struct crc_slot_t {
+      atomic64_t seq;
+      unsigned from, to;
+      uint32_t base, crc;
+      crc_slot_t() : from(0), to(0), base(0), crc(0) {}
+    };
+    static const unsigned CRC_SLOTS = 2;
+    crc_slot_t crc_slots[CRC_SLOTS];
+
+    atomic_t pool;  ///< buffer::POOL_* this is accounted to
 
     raw(unsigned l)
       : data(NULL), len(l), nref(0),
-	crc_lock("buffer::raw::crc_lock", false)
-    { }
+	pool(POOL_ANON)
+    {
+      buffer_pool_add(POOL_ANON, len);
+    }
     raw(char *c, unsigned l)
       : data(c), len(l), nref(0),
-	crc_lock("buffer::raw::crc_lock", false)
-    { }
-    virtual ~raw() {}
+	pool(POOL_ANON)
+    {
+      buffer_pool_add(POOL_ANON, len);
+    }
+    virtual ~raw() {
+      buffer_pool_sub(pool.read(), len);
+    }
+
+    void reassign_to_pool(int p) {
+      int old;
+      do {
+	old = pool.read();
+	if (old == p)
+	  return;
+      } while (!pool.compare_and_swap(old, p));
+      buffer_pool_sub(old, len);
+      buffer_pool_add(p, len);
+    }
 
     // no copying.
     raw(const raw &other);
@@ -187,32 +373,61 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     }
     bool get_crc(const pair<size_t, size_t> &fromto,
          pair<uint32_t, uint32_t> *crc) const {
-      crc_lock.get_read();
-      map<pair<size_t, size_t>, pair<uint32_t, uint32_t> >::const_iterator i =
-      crc_map.find(fromto);
-      if (i == crc_map.end()) {
-          crc_lock.unlock();
-          return false;
+      for (unsigned i = 0; i < CRC_SLOTS; ++i) {
+	const crc_slot_t &s = crc_slots[i];
+	uint64_t seq = s.seq.read();
+	if (seq & 1)
+	  continue;
+	unsigned from = s.from, to = s.to;
+	uint32_t base = s.base, value = s.crc;
+	if (s.seq.read() != seq)
+	  continue;
+	if (from == fromto.first && to == fromto.second) {
+	  *crc = make_pair(base, value);
+	  return true;
+	}
       }
-      *crc = i->second;
-      crc_lock.unlock();
-      return true;
+      return false;
     }
     void set_crc(const pair<size_t, size_t> &fromto,
          const pair<uint32_t, uint32_t> &crc) {
-      crc_lock.get_write();
-      crc_map[fromto] = crc;
-      crc_lock.unlock();
+      // the slot already holding the range, else an empty one, else
+      // one picked by the range
+      unsigned i = 0;
+      for (; i < CRC_SLOTS; ++i)
+	if (crc_slots[i].from == fromto.first &&
+	    crc_slots[i].to == fromto.second)
+	  break;
+      if (i == CRC_SLOTS)
+	for (i = 0; i < CRC_SLOTS; ++i)
+	  if (crc_slots[i].from == crc_slots[i].to)
+	    break;
+      if (i == CRC_SLOTS)
+	i = (fromto.first ^ fromto.second) % CRC_SLOTS;
+      crc_slot_t &s = crc_slots[i];
+      uint64_t seq = s.seq.read();
+      if ((seq & 1) || !s.seq.compare_and_swap(seq, seq + 1))
+	return;
+      s.from = fromto.first;
+      s.to = fromto.second;
+      s.base = crc.first;
+      s.crc = crc.second;
+      s.seq.compare_and_swap(seq + 1, seq + 2);
     }
     void invalidate_crc() {
-      // don't own the write lock when map is empty
-      crc_lock.get_read();
-      if (crc_map.size() != 0) {
-        crc_lock.unlock();
-        crc_lock.get_write();
-        crc_map.clear();
+      for (unsigned i = 0; i < CRC_SLOTS; ++i) {
+	crc_slot_t &s = crc_slots[i];
+	if (s.from == s.to && s.seq.read() % 2 == 0)
+	  continue;
+	// unlike set_crc this can't give up; writers hold a slot briefly
+	uint64_t seq;
+	do {
+	  seq = s.seq.read();
+	} while ((seq & 1) || !s.seq.compare_and_swap(seq, seq + 1));
+	s.from = s.to = 0;
+	s.base = s.crc = 0;
+	s.seq.compare_and_swap(seq + 1, seq + 2);
       }
-      crc_lock.unlock();
     }
   };
 
@@ -269,21 +484,31 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     raw_posix_aligned(unsigned l, unsigned _align) : raw(l) {
       align = _align;
       assert((align >= sizeof(void *)) && (align & (align - 1)) == 0);
+      data = 0;
+      int c = buffer_cache_class(len, align);
+      if (c >= 0) {
+	// cacheable sizes are always page aligned so any user can reuse them
+	align = CEPH_PAGE_SIZE;
+	data = buffer_cache_get(c);
+      }
+      if (!data) {
 #ifdef DARWIN
-      data = (char *) valloc (len);
+	data = (char *) valloc (len);
 #else
-      data = 0;
-      int r = ::posix_memalign((void**)(void*)&data, align, len);
-      if (r)
-	throw bad_alloc();
+	int r = ::posix_memalign((void**)(void*)&data, align, len);
+	if (r)
+	  throw bad_alloc();
 #endif /* DARWIN */
+      }
       if (!data)
 	throw bad_alloc();
       inc_total_alloc(len);
       bdout << "raw_posix_aligned " << this << " alloc " << (void *)data << " l=" << l << ", align=" << align << " total_alloc=" << buffer::get_total_alloc() << bendl;
     }
     ~raw_posix_aligned() {
-      ::free((void*)data);
+      int c = buffer_cache_class(len, align);
+      if (c < 0 || !buffer_cache_put(c, data))
+	::free((void*)data);
       dec_total_alloc(len);
       bdout << "raw_posix_aligned " << this << " free " << (void *)data << " " << buffer::get_total_alloc() << bendl;
     }
@@ -293,6 +518,50 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
   };
 #endif
 
+  /*
+   * raw header and data in a single allocation: the data comes first
+   * (it has the stricter alignment) and the raw lives in the tail.  used
+   * for the small buffers that make up most encodes, where the separate
+   * header allocation is as expensive as the data one.
+   */
+  class buffer::raw_combined : public buffer::raw {
+    unsigned align;
+  public:
+    raw_combined(char *dataptr, unsigned l, unsigned _align)
+      : raw(dataptr, l), align(_align) {
+      inc_total_alloc(len);
+      bdout << "raw_combined " << this << " alloc " << (void *)data << " l=" << l << ", align=" << align << " total_alloc=" << buffer::get_total_alloc() << bendl;
+    }
+    ~raw_combined() {
+      dec_total_alloc(len);
+      bdout << "raw_combined " << this << " free " << (void *)data << " " << buffer::get_total_alloc() << bendl;
+    }
+    raw* clone_empty() {
+      return create(len, align);
+    }
+
+    /// total bytes allocated for a raw_combined holding @p len bytes
+    static size_t alloc_size(unsigned len) {
+      return ROUND_UP_TO(len, sizeof(void *)) + sizeof(raw_combined);
+    }
+
+    static raw_combined *create(unsigned len, unsigned align) {
+      assert((align >= sizeof(void *)) && (align & (align - 1)) == 0);
+      size_t datalen = ROUND_UP_TO(len, sizeof(void *));
+      char *ptr = 0;
+      int r = ::posix_memalign((void**)(void*)&ptr, align,
+			       datalen + sizeof(raw_combined));
+      if (r || !ptr)
+	throw bad_alloc();
+      return new (ptr + datalen) raw_combined(ptr, len, align);
+    }
+
+    // the raw was placement-constructed inside the data allocation
+    static void operator delete(void *p) {
+      ::free((void *)((raw_combined *)p)->data);
+    }
+  };
+
 #ifdef __CYGWIN__
   class buffer::raw_hack_aligned : public buffer::raw {
     unsigned align;
@@ -580,11 +849,13 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
 
   class buffer::xio_mempool : public buffer::raw {
   public:
-    struct xio_reg_mem *mp;
-    xio_mempool(struct xio_reg_mem *_mp, unsigned l) :
-      raw((char*)mp->addr, l), mp(_mp)
+    struct xio_reg_mem mp;
+    xio_mempool(const struct xio_reg_mem& _mp, unsigned l) :
+      raw((char*)_mp.addr, l), mp(_mp)
     { }
-    ~xio_mempool() {}
+    ~xio_mempool() {
+      xio_mempool_free(&mp);
+    }
     raw* clone_empty() {
       return new buffer::raw_char(len);
     }
@@ -594,11 +865,19 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
   {
     buffer::xio_mempool *mb = dynamic_cast<buffer::xio_mempool*>(bp.get_raw());
     if (mb) {
-      return mb->mp;
+      return &mb->mp;
     }
     return NULL;
   }
 
+  buffer::raw* buffer::create_xio_mempool(unsigned len,
+					  struct ::xio_mempool *pool) {
+    struct xio_reg_mem mp;
+    if (xio_mempool_alloc(pool, len, &mp) != 0)
+      return NULL;
+    return new xio_mempool(mp, len);
+  }
+
   buffer::raw* buffer::create_msg(
       unsigned len, char *buf, XioDispatchHook* m_hook) {
     XioPool& pool = m_hook->get_pool();
@@ -610,11 +889,17 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
 #endif /* HAVE_XIO */
 
   buffer::raw* buffer::copy(const char *c, unsigned len) {
-    raw* r = new raw_char(len);
+    raw* r = create(len);
     memcpy(r->data, c, len);
     return r;
   }
   buffer::raw* buffer::create(unsigned len) {
+    // let the cached sizes (4K included) come from the thread cache
+    if (buffer_cache_max.read() && buffer_cache_class(len, sizeof(void *)) >= 0)
+      return create_aligned(len, sizeof(void *));
+    // small buffers get their raw header in the same allocation
+    if (len && len < CEPH_PAGE_SIZE * 2)
+      return raw_combined::create(len, sizeof(void *));
     return new raw_char(len);
   }
   buffer::raw* buffer::claim_char(unsigned len, char *buf) {
@@ -659,6 +944,12 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     return new raw_unshareable(len);
   }
 
+  void buffer::ptr::reassign_to_pool(int pool)
+  {
+    if (_raw)
+      _raw->reassign_to_pool(pool);
+  }
+
   buffer::ptr::ptr(raw *r) : _raw(r), _off(0), _len(r->len)   // no lock needed; this is an unref raw.
   {
     r->nref.inc();
@@ -1438,6 +1729,16 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     claim_append(bl, flags);
   }
 
+  void buffer::list::reassign_to_pool(int pool)
+  {
+    if (append_buffer.have_raw())
+      append_buffer.reassign_to_pool(pool);
+    for (std::list<ptr>::iterator p = _buffers.begin();
+	 p != _buffers.end();
+	 ++p)
+      p->reassign_to_pool(pool);
+  }
+
   void buffer::list::claim_append(list& bl, unsigned int flags)
   {
     // steal the other guy's buffers
@@ -1507,13 +1808,22 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     last_p.copy_in(len, src);
   }
 
+  buffer::raw* buffer::list::create_append_buffer(unsigned len)
+  {
+    // page aligned, with the raw header tucked into the tail of the last
+    // page so that the whole thing is a single n-page allocation.
+    unsigned alen = ROUND_UP_TO(raw_combined::alloc_size(len),
+				CEPH_BUFFER_APPEND_SIZE) - sizeof(raw_combined);
+    return raw_combined::create(alen, CEPH_BUFFER_APPEND_SIZE);
+  }
+
   void buffer::list::append(char c)
   {
     // put what we can into the existing append_buffer.
     unsigned gap = append_buffer.unused_tail_length();
     if (!gap) {
       // make a new append_buffer!
-      append_buffer = create_aligned(CEPH_BUFFER_APPEND_SIZE, CEPH_BUFFER_APPEND_SIZE);
+      append_buffer = create_append_buffer(1);
       append_buffer.set_length(0);   // unused, so far.
     }
     append(append_buffer, append_buffer.append(c) - 1, 1);	// add segment to the list
@@ -1536,12 +1846,31 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
         break;  // done!
       
       // make a new append_buffer!
-      unsigned alen = CEPH_BUFFER_APPEND_SIZE * (((len-1) / CEPH_BUFFER_APPEND_SIZE) + 1);
-      append_buffer = create_aligned(alen, CEPH_BUFFER_APPEND_SIZE);
+      append_buffer = create_append_buffer(len);
       append_buffer.set_length(0);   // unused, so far.
     }
   }
 
+  char *buffer::list::append_reserve(unsigned len)
+  {
+    if (!append_buffer.have_raw() ||
+	append_buffer.unused_tail_length() < len) {
+      // make a new append_buffer!
+      append_buffer = create_append_buffer(len);
+      append_buffer.set_length(0);   // unused, so far.
+    }
+    return append_buffer.c_str() + append_buffer.length();
+  }
+
+  void buffer::list::append_reserved(unsigned len)
+  {
+    assert(len <= append_buffer.unused_tail_length());
+    if (!len)
+      return;
+    append_buffer.set_length(append_buffer.length() + len);
+    append(append_buffer, append_buffer.length() - len, len);	// add segment to the list
+  }
+
   void buffer::list::append(const ptr& bp)
   {
     if (bp.length())
@@ -1968,6 +2297,80 @@ int buffer::list::write_fd(int fd) const
   return 0;
 }
 
+int buffer::list::write_fd(int fd, uint64_t offset) const
+{
+  if (can_zero_copy()) {
+    int64_t off = offset;
+    for (std::list<ptr>::const_iterator it = _buffers.begin();
+	 it != _buffers.end(); ++it) {
+      int r = it->zero_copy_to_fd(fd, &off);
+      if (r < 0)
+	return r;
+      off += it->length();
+    }
+    return 0;
+  }
+
+#ifdef HAVE_PWRITEV
+  // like write_fd(), but positioned, so there's no lseek
+  iovec iov[IOV_MAX];
+  int iovlen = 0;
+  ssize_t bytes = 0;
+
+  std::list<ptr>::const_iterator p = _buffers.begin();
+  while (p != _buffers.end()) {
+    if (p->length() > 0) {
+      iov[iovlen].iov_base = (void *)p->c_str();
+      iov[iovlen].iov_len = p->length();
+      bytes += p->length();
+      iovlen++;
+    }
+    ++p;
+
+    if (iovlen == IOV_MAX ||
+	(iovlen > 0 && p == _buffers.end())) {
+      iovec *start = iov;
+      int num = iovlen;
+      ssize_t wrote;
+    retry:
+      wrote = ::pwritev(fd, start, num, offset);
+      if (wrote < 0) {
+	int err = errno;
+	if (err == EINTR)
+	  goto retry;
+	return -err;
+      }
+      offset += wrote;
+      if (wrote < bytes) {
+	// partial write, recover!
+	while ((size_t)wrote >= start[0].iov_len) {
+	  wrote -= start[0].iov_len;
+	  bytes -= start[0].iov_len;
+	  start++;
+	  num--;
+	}
+	if (wrote > 0) {
+	  start[0].iov_len -= wrote;
+	  start[0].iov_base = (char *)start[0].iov_base + wrote;
+	  bytes -= wrote;
+	}
+	goto retry;
+      }
+      iovlen = 0;
+      bytes = 0;
+    }
+  }
+  return 0;
+#else
+  int64_t actual = ::lseek64(fd, offset, SEEK_SET);
+  if (actual < 0)
+    return -errno;
+  if (actual != (int64_t)offset)
+    return -EIO;
+  return write_fd(fd);
+#endif
+}
+
 void buffer::list::prepare_iov(std::vector<iovec> *piov) const
 {
   piov->resize(_buffers.size());
@@ -26,9 +26,11 @@
 #include "common/HeartbeatMap.h"
 #include "common/errno.h"
 #include "common/lockdep.h"
+#include "common/lock_stats.h"
 #include "common/Formatter.h"
 #include "log/Log.h"
 #include "auth/Crypto.h"
+#include "include/mempool.h"
 #include "include/str_list.h"
 #include "common/Mutex.h"
 #include "common/Cond.h"
@@ -75,12 +77,14 @@ private:
 
 } // anonymous namespace
 
-class CephContextServiceThread : public Thread
+class CephContextServiceThread : public Thread,
+				 public md_config_t::observer_notifier_t
 {
 public:
   CephContextServiceThread(CephContext *cct)
     : _lock("CephContextServiceThread::_lock"),
-      _reopen_logs(false), _exit_thread(false), _cct(cct)
+      _reopen_logs(false), _apply_observers(false), _exit_thread(false),
+      _cct(cct)
   {
   }
 
@@ -91,7 +95,9 @@ public:
     while (1) {
       Mutex::Locker l(_lock);
 
-      if (_cct->_conf->heartbeat_interval) {
+      if (_reopen_logs || _apply_observers || _exit_thread) {
+	// asked while we were busy
+      } else if (_cct->_conf->heartbeat_interval) {
         utime_t interval(_cct->_conf->heartbeat_interval, 0);
         _cond.WaitInterval(_cct, _lock, interval);
       } else
@@ -105,6 +111,13 @@ public:
         _cct->_log->reopen_log_file();
         _reopen_logs = false;
       }
+      if (_apply_observers) {
+	_apply_observers = false;
+	// observers take their own locks, and may take a while
+	_lock.Unlock();
+	_cct->_conf->flush_observers();
+	_lock.Lock();
+      }
       _cct->_heartbeat_map->check_touch_file();
 
       // refresh the perf coutners
@@ -120,6 +133,13 @@ public:
     _cond.Signal();
   }
 
+  void queue_observers()
+  {
+    Mutex::Locker l(_lock);
+    _apply_observers = true;
+    _cond.Signal();
+  }
+
   void exit_thread()
   {
     Mutex::Locker l(_lock);
@@ -131,6 +151,7 @@ private:
   Mutex _lock;
   Cond _cond;
   bool _reopen_logs;
+  bool _apply_observers;
   bool _exit_thread;
   CephContext *_cct;
 };
@@ -204,6 +225,9 @@ public:
   const char** get_tracked_conf_keys() const {
     static const char *KEYS[] = {
       "enable_experimental_unrecoverable_data_corrupting_features",
+      "buffer_thread_cache_size",
+      "mempool_budgets",
+      "lock_stats_sample",
       NULL
     };
     return KEYS;
@@ -211,6 +235,19 @@ public:
 
   void handle_conf_change(const md_config_t *conf,
                           const std::set <std::string> &changed) {
+    if (changed.count("buffer_thread_cache_size")) {
+      buffer::set_thread_cache_size(conf->buffer_thread_cache_size);
+    }
+    if (changed.count("mempool_budgets")) {
+      std::string err;
+      if (mempool::set_budgets(conf->mempool_budgets, &err) < 0)
+	lderr(cct) << "mempool_budgets: " << err << dendl;
+    }
+    if (changed.count("lock_stats_sample")) {
+      g_lock_stats = conf->lock_stats_sample > 0 ? conf->lock_stats_sample : 0;
+    }
+    if (!changed.count("enable_experimental_unrecoverable_data_corrupting_features"))
+      return;
     ceph_spin_lock(&cct->_feature_lock);
     get_str_set(conf->enable_experimental_unrecoverable_data_corrupting_features,
 		cct->_experimental_features);
@@ -291,6 +328,11 @@ void CephContext::do_command(std::string command, cmdmap_t& cmdmap,
     cmd_getval(this, cmdmap, "counter", counter);
     _perf_counters_collection->dump_formatted(f, false, logger, counter);
   }
+  else if (command == "perf dump_changed") {
+    std::string id;
+    cmd_getval(this, cmdmap, "id", id);
+    _perf_counters_collection->dump_changed(f, id);
+  }
   else if (command == "perfcounters_schema" || command == "2" ||
     command == "perf schema") {
     _perf_counters_collection->dump_formatted(f, true);
@@ -377,6 +419,28 @@ void CephContext::do_command(std::string command, cmdmap_t& cmdmap,
         f->dump_string("option", *p);
       }
       f->close_section(); // unknown
+    } else if (command == "dump_buffer_pools") {
+      f->open_object_section("pools");
+      for (int i = 0; i < buffer::POOL_MAX; ++i) {
+	f->open_object_section(buffer::get_pool_name(i));
+	f->dump_int("bytes", buffer::get_pool_bytes(i));
+	f->dump_int("items", buffer::get_pool_items(i));
+	f->close_section();
+      }
+      f->close_section(); // pools
+      f->open_object_section("thread_cache");
+      f->dump_int("bytes", buffer::get_thread_cache_bytes());
+      f->dump_int("hits", buffer::get_thread_cache_hits());
+      f->dump_int("misses", buffer::get_thread_cache_misses());
+      f->close_section(); // thread_cache
+    } else if (command == "dump_mempools") {
+      mempool::dump(f);
+    } else if (command == "dump_lock_stats") {
+      f->open_object_section("lock_stats");
+      lock_stats_dump(f);
+      f->close_section();
+    } else if (command == "reset_lock_stats") {
+      lock_stats_reset();
     } else if (command == "log flush") {
       _log->flush();
     }
@@ -441,6 +505,7 @@ CephContext::CephContext(uint32_t module_type_)
   _admin_socket->register_command("perfcounters_dump", "perfcounters_dump", _admin_hook, "");
   _admin_socket->register_command("1", "1", _admin_hook, "");
   _admin_socket->register_command("perf dump", "perf dump name=logger,type=CephString,req=false name=counter,type=CephString,req=false", _admin_hook, "dump perfcounters value");
+  _admin_socket->register_command("perf dump_changed", "perf dump_changed name=id,type=CephString,req=false", _admin_hook, "dump the perfcounters that changed since the last dump_changed with this id");
   _admin_socket->register_command("perfcounters_schema", "perfcounters_schema", _admin_hook, "");
   _admin_socket->register_command("2", "2", _admin_hook, "");
   _admin_socket->register_command("perf schema", "perf schema", _admin_hook, "dump perfcounters schema");
@@ -451,6 +516,10 @@ CephContext::CephContext(uint32_t module_type_)
   _admin_socket->register_command("config diff",
       "config diff", _admin_hook,
       "dump diff of current config and default config");
+  _admin_socket->register_command("dump_buffer_pools", "dump_buffer_pools", _admin_hook, "dump memory pinned by bufferlists, per subsystem");
+  _admin_socket->register_command("dump_mempools", "dump_mempools", _admin_hook, "dump memory accounted to each mempool, and to bufferlists");
+  _admin_socket->register_command("dump_lock_stats", "dump_lock_stats", _admin_hook, "dump sampled Mutex/RWLock contention per lock name (see lock_stats_sample)");
+  _admin_socket->register_command("reset_lock_stats", "reset_lock_stats", _admin_hook, "clear sampled lock contention stats");
   _admin_socket->register_command("log flush", "log flush", _admin_hook, "flush log entries to log file");
   _admin_socket->register_command("log dump", "log dump", _admin_hook, "dump recent log entries to log file");
   _admin_socket->register_command("log reopen", "log reopen", _admin_hook, "reopen log file");
@@ -475,6 +544,7 @@ CephContext::~CephContext()
 
   _admin_socket->unregister_command("perfcounters_dump");
   _admin_socket->unregister_command("perf dump");
+  _admin_socket->unregister_command("perf dump_changed");
   _admin_socket->unregister_command("1");
   _admin_socket->unregister_command("perfcounters_schema");
   _admin_socket->unregister_command("perf schema");
@@ -484,6 +554,10 @@ CephContext::~CephContext()
   _admin_socket->unregister_command("config set");
   _admin_socket->unregister_command("config get");
   _admin_socket->unregister_command("config diff");
+  _admin_socket->unregister_command("dump_buffer_pools");
+  _admin_socket->unregister_command("dump_mempools");
+  _admin_socket->unregister_command("dump_lock_stats");
+  _admin_socket->unregister_command("reset_lock_stats");
   _admin_socket->unregister_command("log flush");
   _admin_socket->unregister_command("log dump");
   _admin_socket->unregister_command("log reopen");
@@ -541,7 +615,10 @@ void CephContext::start_service_thread()
   }
   _service_thread = new CephContextServiceThread(this);
   _service_thread->create();
+  CephContextServiceThread *thread = _service_thread;
   ceph_spin_unlock(&_service_thread_lock);
+  if (_conf->config_observers_async)
+    _conf->set_observer_notifier(thread);
 
   // make logs flush on_exit()
   if (_conf->log_flush_on_exit)
@@ -576,6 +653,8 @@ void CephContext::join_service_thread()
   _service_thread = NULL;
   ceph_spin_unlock(&_service_thread_lock);
 
+  // anything still queued is applied here
+  _conf->set_observer_notifier(NULL);
   thread->exit_thread();
   thread->join();
   delete thread;
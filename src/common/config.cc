@@ -150,7 +150,9 @@ md_config_t::md_config_t()
 #undef OPTION
 #undef SUBSYS
 #undef DEFAULT_SUBSYS
-  lock("md_config_t", true, false)
+  lock("md_config_t", true, false),
+  obs_notifier(NULL),
+  obs_lock("md_config_t::obs_lock", true, false)
 {
   init_subsys();
 }
@@ -184,18 +186,67 @@ void md_config_t::add_observer(md_config_obs_t* observer_)
 
 void md_config_t::remove_observer(md_config_obs_t* observer_)
 {
-  Mutex::Locker l(lock);
-  bool found_obs = false;
-  for (obs_map_t::iterator o = observers.begin(); o != observers.end(); ) {
-    if (o->second == observer_) {
-      observers.erase(o++);
-      found_obs = true;
+  {
+    Mutex::Locker l(lock);
+    bool found_obs = false;
+    for (obs_map_t::iterator o = observers.begin(); o != observers.end(); ) {
+      if (o->second == observer_) {
+	observers.erase(o++);
+	found_obs = true;
+      }
+      else {
+	++o;
+      }
     }
-    else {
-      ++o;
+    assert(found_obs);
+    pending_obs.erase(observer_);
+  }
+  // wait out a call to it that may be in progress
+  Mutex::Locker l(obs_lock);
+}
+
+void md_config_t::set_observer_notifier(observer_notifier_t *n)
+{
+  {
+    Mutex::Locker l(lock);
+    obs_notifier = n;
+  }
+  if (!n)
+    flush_observers();
+}
+
+void md_config_t::kick_observers()
+{
+  observer_notifier_t *n;
+  {
+    Mutex::Locker l(lock);
+    if (pending_obs.empty())
+      return;
+    n = obs_notifier;
+  }
+  if (n)
+    n->queue_observers();
+  else
+    flush_observers();
+}
+
+void md_config_t::flush_observers()
+{
+  Mutex::Locker ol(obs_lock);
+  while (true) {
+    md_config_obs_t *obs;
+    std::set<std::string> keys;
+    {
+      Mutex::Locker l(lock);
+      if (pending_obs.empty())
+	break;
+      rev_obs_map_t::iterator p = pending_obs.begin();
+      obs = p->first;
+      keys.swap(p->second);
+      pending_obs.erase(p);
     }
+    obs->handle_conf_change(this, keys);
   }
-  assert(found_obs);
 }
 
 int md_config_t::parse_config_files(const char *conf_files,
@@ -562,8 +613,11 @@ int md_config_t::parse_injectargs(std::vector<const char*>& args,
 
 void md_config_t::apply_changes(std::ostream *oss)
 {
-  Mutex::Locker l(lock);
-  _apply_changes(oss);
+  {
+    Mutex::Locker l(lock);
+    _apply_changes(oss);
+  }
+  kick_observers();
 }
 
 bool md_config_t::_internal_field(const string& s)
@@ -575,15 +629,12 @@ bool md_config_t::_internal_field(const string& s)
 
 void md_config_t::_apply_changes(std::ostream *oss)
 {
-  /* Maps observers to the configuration options that they care about which
-   * have changed. */
-  typedef std::map < md_config_obs_t*, std::set <std::string> > rev_obs_map_t;
-
   expand_all_meta();
 
-  // create the reverse observer mapping, mapping observers to the set of
-  // changed keys that they'll get.
-  rev_obs_map_t robs;
+  // add to the reverse observer mapping, mapping observers to the set of
+  // changed keys that they'll get; the caller makes the calls once it
+  // drops the lock (kick_observers()).
+  rev_obs_map_t &robs = pending_obs;
   std::set <std::string> empty_set;
   char buf[128];
   char *bufptr = (char*)buf;
@@ -605,31 +656,30 @@ void md_config_t::_apply_changes(std::ostream *oss)
     }
   }
 
-  // Make any pending observer callbacks
-  for (rev_obs_map_t::const_iterator r = robs.begin(); r != robs.end(); ++r) {
-    md_config_obs_t *obs = r->first;
-    obs->handle_conf_change(this, r->second);
-  }
-
   changed.clear();
 }
 
 void md_config_t::call_all_observers()
 {
-  Mutex::Locker l(lock);
+  {
+    Mutex::Locker l(lock);
 
-  expand_all_meta();
+    expand_all_meta();
 
-  std::map<md_config_obs_t*,std::set<std::string> > obs;
-  for (obs_map_t::iterator r = observers.begin(); r != observers.end(); ++r)
-    obs[r->second].insert(r->first);
-  for (std::map<md_config_obs_t*,std::set<std::string> >::iterator p = obs.begin();
-       p != obs.end();
-       ++p)
-    p->first->handle_conf_change(this, p->second);
+    for (obs_map_t::iterator r = observers.begin(); r != observers.end(); ++r)
+      pending_obs[r->second].insert(r->first);
+  }
+  flush_observers();
 }
 
 int md_config_t::injectargs(const std::string& s, std::ostream *oss)
+{
+  int ret = _injectargs(s, oss);
+  kick_observers();
+  return ret;
+}
+
+int md_config_t::_injectargs(const std::string& s, std::ostream *oss)
 {
   int ret;
   Mutex::Locker l(lock);
@@ -63,8 +63,12 @@ extern const char *CEPH_CONF_FILE_DEFAULT;
  * There are two ways to read the ceph context-- the old way and the new way.
  * In the old way, code would simply read the public variables of the
  * configuration, without taking a lock. In the new way, code registers a
- * configuration obserever which receives callbacks when a value changes. These
- * callbacks take place under the md_config_t lock.
+ * configuration obserever which receives callbacks when a value changes.
+ * The callbacks are made without the md_config_t lock, one observer at a
+ * time and with all the keys it cares about that changed at once, so an
+ * observer that takes its own locks can't hold up the threads reading the
+ * config.  With an observer notifier set (see config_observers_async),
+ * they are made from another thread and apply_changes() doesn't wait.
  *
  * To prevent serious problems resulting from thread-safety issues, we disallow
  * changing std::string configuration values after
@@ -121,6 +125,20 @@ public:
   bool _internal_field(const string& k);
   void call_all_observers();
 
+  /// gets flush_observers() called soon, from a thread of its own
+  class observer_notifier_t {
+  public:
+    virtual void queue_observers() = 0;
+    virtual ~observer_notifier_t() {}
+  };
+  /**
+   * leave the observer calls apply_changes() and injectargs() queue to
+   * n, or make them right away again if n is NULL
+   */
+  void set_observer_notifier(observer_notifier_t *n);
+  /// make the queued observer calls
+  void flush_observers();
+
   // Called by the Ceph daemons to make configuration changes at runtime
   int injectargs(const std::string &s, std::ostream *oss);
 
@@ -243,10 +261,23 @@ public:
 
   /** A lock that protects the md_config_t internals. It is
    * recursive, for simplicity.
-   * It is best if this lock comes first in the lock hierarchy. We will
-   * hold this lock when calling configuration observers.  */
+   * It is best if this lock comes first in the lock hierarchy. It is
+   * not held while calling configuration observers.  */
   mutable Mutex lock;
 
+private:
+  typedef std::map<md_config_obs_t*, std::set<std::string> > rev_obs_map_t;
+
+  /// observer calls not made yet, and the keys for each; under lock
+  rev_obs_map_t pending_obs;
+  observer_notifier_t *obs_notifier;
+  /// held while calling observers, so remove_observer() can wait for them
+  Mutex obs_lock;
+
+  /// flush_observers(), or leave it to the notifier
+  void kick_observers();
+  int _injectargs(const std::string &s, std::ostream *oss);
+
   friend class test_md_config_t;
 };
 
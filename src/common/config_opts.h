@@ -26,6 +26,7 @@ OPTION(lockdep, OPT_BOOL, false)
 OPTION(lockdep_force_backtrace, OPT_BOOL, false) // always gather current backtrace at every lock
 OPTION(run_dir, OPT_STR, "/var/run/ceph")       // the "/var/run/ceph" dir, created on daemon startup
 OPTION(admin_socket, OPT_STR, "$run_dir/$cluster-$name.asok") // default changed by common_preinit()
+OPTION(admin_socket_threads, OPT_INT, 2) // threads serving admin socket requests (0 = the listening thread serves them)
 OPTION(crushtool, OPT_STR, "crushtool") // crushtool utility path
 
 OPTION(daemonize, OPT_BOOL, false) // default changed by common_preinit()
@@ -39,6 +40,7 @@ OPTION(restapi_log_level, OPT_STR, "") 	// default set by Python code
 OPTION(restapi_base_url, OPT_STR, "")	// "
 OPTION(fatal_signal_handlers, OPT_BOOL, true)
 OPTION(erasure_code_dir, OPT_STR, CEPH_PKGLIBDIR"/erasure-code") // default location for erasure-code plugins
+OPTION(erasure_code_decode_threads, OPT_INT, 1) // threads one large decode of many stripes may use (isa)
 
 OPTION(log_file, OPT_STR, "/var/log/ceph/$cluster-$name.log") // default changed by common_preinit()
 OPTION(log_max_new, OPT_INT, 1000) // default changed by common_preinit()
@@ -69,6 +71,9 @@ OPTION(mon_cluster_log_file_level, OPT_STR, "info")
 
 OPTION(enable_experimental_unrecoverable_data_corrupting_features, OPT_STR, "")
 
+OPTION(mempool_budgets, OPT_STR, "") // pool=bytes[,pool=bytes...]: what each mempool should stay under; see dump_mempools
+OPTION(buffer_thread_cache_size, OPT_U64, 0) // bytes of free 4K/64K/4M buffers each thread may keep for reuse (0 = off)
+
 OPTION(xio_trace_mempool, OPT_BOOL, false) // mempool allocation counters
 OPTION(xio_trace_msgcnt, OPT_BOOL, false) // incoming/outgoing msg counters
 OPTION(xio_trace_xcon, OPT_BOOL, false) // Xio message encode/decode trace
@@ -79,12 +84,14 @@ OPTION(xio_mp_max_256, OPT_INT, 8192) // max 256-byte chunks
 OPTION(xio_mp_max_1k, OPT_INT, 8192) // max 1K chunks
 OPTION(xio_mp_max_page, OPT_INT, 4096) // max 1K chunks
 OPTION(xio_mp_max_hint, OPT_INT, 4096) // max size-hint chunks
+OPTION(xio_mp_max_data, OPT_INT, 0) // max registered data chunks per slab (0 disables)
 OPTION(xio_portal_threads, OPT_INT, 2) // xio portal threads per messenger
 OPTION(xio_transport_type, OPT_STR, "rdma") // xio transport type: {rdma or tcp}
 OPTION(xio_max_send_inline, OPT_INT, 512) // xio maximum threshold to send inline
 
 OPTION(async_compressor_enabled, OPT_BOOL, false)
 OPTION(async_compressor_type, OPT_STR, "snappy")
+OPTION(compressor_zlib_level, OPT_INT, 5)  // 1 (fastest) to 9 (smallest)
 OPTION(async_compressor_threads, OPT_INT, 2)
 OPTION(async_compressor_thread_timeout, OPT_INT, 5)
 OPTION(async_compressor_thread_suicide_timeout, OPT_INT, 30)
@@ -140,9 +147,11 @@ OPTION(key, OPT_STR, "")
 OPTION(keyfile, OPT_STR, "")
 OPTION(keyring, OPT_STR, "/etc/ceph/$cluster.$name.keyring,/etc/ceph/$cluster.keyring,/etc/ceph/keyring,/etc/ceph/keyring.bin") // default changed by common_preinit() for mds and osd
 OPTION(heartbeat_interval, OPT_INT, 5)
+OPTION(config_observers_async, OPT_BOOL, false) // tell config observers about changes from the service thread; injectargs doesn't wait for them
 OPTION(heartbeat_file, OPT_STR, "")
 OPTION(heartbeat_inject_failure, OPT_INT, 0)    // force an unhealthy heartbeat for N seconds
 OPTION(perf, OPT_BOOL, true)       // enable internal perf counters
+OPTION(perf_counter_shards, OPT_INT, 0) // split counters/averages into N per-thread shards (>1), read at creation
 
 OPTION(ms_type, OPT_STR, "simple")   // messenger backend
 OPTION(ms_tcp_nodelay, OPT_BOOL, true)
@@ -182,6 +191,39 @@ OPTION(ms_async_set_affinity, OPT_BOOL, true)
 // If ms_async_affinity_cores is empty, all threads will be bind to current running
 // core
 OPTION(ms_async_affinity_cores, OPT_STR, "")
+// If true, outgoing connections are pinned to a worker chosen by hashing the
+// peer address, so reconnects to the same peer land on the same event loop.
+OPTION(ms_async_worker_pin_by_peer, OPT_BOOL, false)
+// When the pinned worker owns this many more connections than the least
+// loaded worker, new connections are steered to the least loaded one
+// instead (0 disables load balancing).
+OPTION(ms_async_worker_max_imbalance, OPT_INT, 8)
+// Number of page-aligned message data buffers each AsyncConnection keeps
+// for reuse once every other reference to them has been dropped (0 disables).
+OPTION(ms_async_rx_buffer_pool_size, OPT_INT, 0)
+// Coalesce already queued outgoing messages into one sendmsg(2) call up to
+// this many bytes (0 sends each message with its own syscall).
+OPTION(ms_async_send_batch_bytes, OPT_U64, 65536)
+// Event driver used by AsyncMessenger workers: "" picks the best one for the
+// platform (epoll, kqueue), "select" forces the portable fallback.
+OPTION(ms_async_event_driver, OPT_STR, "")
+// Poll the event driver without blocking for up to this many microseconds
+// before falling back to a blocking wait, and ask the kernel to busy poll
+// the socket receive queue (SO_BUSY_POLL) for as long. Trades CPU for lower
+// wakeup latency on fast NICs (0 disables).
+OPTION(ms_async_busy_poll_us, OPT_U64, 0)
+// Compress (snappy) message data segments of at least this many bytes on
+// AsyncMessenger connections where both ends support it (0 disables).
+OPTION(ms_async_compress_min_size, OPT_U64, 0)
+// Keep per-connection histograms of send queue, wire (until acked) and
+// dispatch latency, dumped with the "dump_peer_latency <msgr>" admin command.
+OPTION(ms_track_peer_latency, OPT_BOOL, false)
+// Every this many seconds, AsyncMessenger compares the wire latency p99 of
+// each peer against the median over all its peers and warns about peers
+// that are ms_peer_latency_warn_ratio times slower (0 disables the check).
+OPTION(ms_peer_latency_check_interval, OPT_INT, 60)
+OPTION(ms_peer_latency_warn_ratio, OPT_DOUBLE, 4)
+OPTION(ms_peer_latency_warn_min_samples, OPT_INT, 100) // per check interval
 
 OPTION(inject_early_sigterm, OPT_BOOL, false)
 
@@ -216,6 +258,7 @@ OPTION(mon_osd_prime_pg_temp_max_time, OPT_FLOAT, .5)  // max time to spend prim
 OPTION(mon_osd_pool_ec_fast_read, OPT_BOOL, false) // whether turn on fast read on the pool or not
 OPTION(mon_stat_smooth_intervals, OPT_INT, 2)  // smooth stats over last N PGMap maps
 OPTION(mon_lease, OPT_FLOAT, 5)       // lease interval
+OPTION(mon_read_max_staleness, OPT_FLOAT, 0)  // answer reads from committed state for this long after our lease lapsed (e.g., while an update is in flight); 0 to only read under a lease
 OPTION(mon_lease_renew_interval_factor, OPT_FLOAT, .6) // on leader, to renew the lease
 OPTION(mon_lease_ack_timeout_factor, OPT_FLOAT, 2.0) // on leader, if lease isn't acked by all peons
 OPTION(mon_accept_timeout_factor, OPT_FLOAT, 2.0)    // on leader, if paxos update isn't accepted
@@ -254,6 +297,8 @@ OPTION(mon_daemon_bytes, OPT_U64, 400ul << 20)  // mds, osd message memory cap (
 OPTION(mon_max_log_entries_per_event, OPT_INT, 4096)
 OPTION(mon_reweight_min_pgs_per_osd, OPT_U64, 10)   // min pgs per osd for reweight-by-pg command
 OPTION(mon_reweight_min_bytes_per_osd, OPT_U64, 100*1024*1024)   // min bytes per osd for reweight-by-utilization command
+OPTION(mon_reweight_balance_max_change, OPT_FLOAT, .05)  // most a reweight-balance round moves one reweight, relative
+OPTION(mon_reweight_balance_rounds, OPT_INT, 10)  // mapping rounds reweight-balance tries
 OPTION(mon_health_data_update_interval, OPT_FLOAT, 60.0)
 OPTION(mon_health_to_clog, OPT_BOOL, true)
 OPTION(mon_health_to_clog_interval, OPT_INT, 3600)
@@ -337,6 +382,10 @@ OPTION(client_trace, OPT_STR, "")
 OPTION(client_readahead_min, OPT_LONGLONG, 128*1024)  // readahead at _least_ this much.
 OPTION(client_readahead_max_bytes, OPT_LONGLONG, 0)  //8 * 1024*1024
 OPTION(client_readahead_max_periods, OPT_LONGLONG, 4)  // as multiple of file layout period (object size * num stripes)
+OPTION(client_readahead_streams, OPT_INT, 4)  // interleaved sequential streams tracked per open file
+OPTION(client_async_threads, OPT_INT, 16)  // libcephfs threads running ceph_*_async() calls, so we have that many requests in flight
+OPTION(client_readdir_max_entries, OPT_U32, 0)  // dentries to ask the mds for per readdir request; 0 for as many as fit
+OPTION(client_readdir_max_bytes, OPT_U32, 1 << 20)  // size of a readdir reply to ask for; 0 for the mds default
 OPTION(client_snapdir, OPT_STR, ".snap")
 OPTION(client_mountpoint, OPT_STR, "/")
 OPTION(client_mount_uid, OPT_INT, -1)
@@ -351,6 +400,7 @@ OPTION(client_oc_max_dirty, OPT_INT, 1024*1024* 100)    // MB * n  (dirty OR tx.
 OPTION(client_oc_target_dirty, OPT_INT, 1024*1024* 8) // target dirty (keep this smallish)
 OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before writeback
 OPTION(client_oc_max_objects, OPT_INT, 1000)      // max objects in cache
+OPTION(client_oc_policy, OPT_STR, "lru")      // clean data replacement: lru or 2q (scan resistant)
 OPTION(client_debug_force_sync_read, OPT_BOOL, false)     // always read synchronously (go to osds)
 OPTION(client_debug_inject_tick_delay, OPT_INT, 0) // delay the client tick for a number of seconds
 OPTION(client_max_inline_size, OPT_U64, 4096)
@@ -380,22 +430,39 @@ OPTION(objecter_inflight_op_bytes, OPT_U64, 1024*1024*100) // max in-flight data
 OPTION(objecter_inflight_ops, OPT_U64, 1024)               // max in-flight ios
 OPTION(objecter_completion_locks_per_session, OPT_U64, 32) // num of completion locks per each session, for serializing same object responses
 OPTION(objecter_inject_no_watch_ping, OPT_BOOL, false)   // suppress watch pings
+OPTION(objecter_rwlock_shards, OPT_INT, 8)    // op submission read locks one of these, map updates all
+OPTION(objecter_tid_batch, OPT_INT, 64)       // tids each submitting thread reserves at a time
+OPTION(objecter_batch_window, OPT_DOUBLE, .0005)  // how long ops of batching IoCtxs wait for company
+OPTION(objecter_batch_max_ops, OPT_INT, 16)   // and how many go in one MOSDOpBatch
 
 // Max number of deletes at once in a single Filer::purge call
 OPTION(filer_max_purge_ops, OPT_U32, 10)
+// With a latency target, the number of deletes in flight starts at
+// filer_max_purge_ops and adapts (up to filer_purge_ops_ceiling) to
+// keep their latency below it; 0 keeps it fixed
+OPTION(filer_purge_latency_target, OPT_DOUBLE, .1)
+OPTION(filer_purge_ops_ceiling, OPT_U32, 256)
+// Max number of stats in flight in one round of Filer::probe
+OPTION(filer_max_probe_ops, OPT_U32, 64)
 
 OPTION(journaler_allow_split_entries, OPT_BOOL, true)
 OPTION(journaler_write_head_interval, OPT_INT, 15)
 OPTION(journaler_prefetch_periods, OPT_INT, 10)   // * journal object size
+OPTION(journaler_replay_prefetch_periods, OPT_INT, 40)   // * journal object size, while read-only (replay)
 OPTION(journaler_prezero_periods, OPT_INT, 5)     // * journal object size
-OPTION(journaler_batch_interval, OPT_DOUBLE, .001)   // seconds.. max add latency we artificially incur
-OPTION(journaler_batch_max, OPT_U64, 0)  // max bytes we'll delay flushing; disable, for now....
+OPTION(journaler_batch_interval, OPT_DOUBLE, 0)   // seconds.. max add latency we artificially incur when idle; 0 to write at once
+OPTION(journaler_batch_max, OPT_U64, 1 << 20)  // max bytes we'll hold back behind an in-flight write; 0 to disable
 OPTION(mds_data, OPT_STR, "/var/lib/ceph/mds/$cluster-$id")
 OPTION(mds_max_file_size, OPT_U64, 1ULL << 40) // Used when creating new CephFS. Change with 'ceph mds set max_file_size <size>' afterwards
 OPTION(mds_cache_size, OPT_INT, 100000)
+OPTION(mds_cache_memory_limit, OPT_U64, 0) // bytes; trim to this as well as mds_cache_size; 0 to disable
+OPTION(mds_recall_max_caps, OPT_U32, 5000) // caps we ask one session to release per mds_recall_max_decay_rate; 0 for no limit
+OPTION(mds_recall_max_decay_rate, OPT_DOUBLE, 2.5) // half-life in seconds of the per session recall budget
 OPTION(mds_cache_mid, OPT_FLOAT, .7)
 OPTION(mds_max_file_recover, OPT_U32, 32)
 OPTION(mds_dir_max_commit_size, OPT_INT, 10) // MB
+OPTION(mds_dir_keys_per_op, OPT_INT, 16384)  // max dentries read per op when fetching a dirfrag; 0 to read it in one
+OPTION(mds_dir_prefetch_next_frag, OPT_BOOL, true)  // fetch the next frag of a fragmented dir while readdir reads this one
 OPTION(mds_decay_halflife, OPT_FLOAT, 5)
 OPTION(mds_beacon_interval, OPT_FLOAT, 4)
 OPTION(mds_beacon_grace, OPT_FLOAT, 15)
@@ -427,14 +494,14 @@ OPTION(mds_log_max_expiring, OPT_INT, 20)
 OPTION(mds_bal_sample_interval, OPT_FLOAT, 3.0)  // every 5 seconds
 OPTION(mds_bal_replicate_threshold, OPT_FLOAT, 8000)
 OPTION(mds_bal_unreplicate_threshold, OPT_FLOAT, 0)
-OPTION(mds_bal_frag, OPT_BOOL, false)
+OPTION(mds_bal_frag, OPT_BOOL, true)
 OPTION(mds_bal_split_size, OPT_INT, 10000)
 OPTION(mds_bal_split_rd, OPT_FLOAT, 25000)
 OPTION(mds_bal_split_wr, OPT_FLOAT, 10000)
 OPTION(mds_bal_split_bits, OPT_INT, 3)
 OPTION(mds_bal_merge_size, OPT_INT, 50)
-OPTION(mds_bal_merge_rd, OPT_FLOAT, 1000)
-OPTION(mds_bal_merge_wr, OPT_FLOAT, 1000)
+OPTION(mds_bal_merge_rd, OPT_FLOAT, 1000)  // and only merge frags cooler than these,
+OPTION(mds_bal_merge_wr, OPT_FLOAT, 1000)  // so that load splits do not flap
 OPTION(mds_bal_interval, OPT_INT, 10)           // seconds
 OPTION(mds_bal_fragment_interval, OPT_INT, 5)      // seconds
 OPTION(mds_bal_idle_threshold, OPT_FLOAT, 0)
@@ -449,6 +516,8 @@ OPTION(mds_bal_midchunk, OPT_FLOAT, .3)       // any sub bigger than this taken
 OPTION(mds_bal_minchunk, OPT_FLOAT, .001)     // never take anything smaller than this
 OPTION(mds_bal_target_removal_min, OPT_INT, 5) // min balance iterations before old target is removed
 OPTION(mds_bal_target_removal_max, OPT_INT, 10) // max balance iterations before old target is removed
+OPTION(mds_bal_migrate_cooldown, OPT_FLOAT, 60)  // don't move a subtree again for this long after it moved
+OPTION(mds_bal_dry_run, OPT_BOOL, false)  // only log the exports the balancer would do
 OPTION(mds_replay_interval, OPT_FLOAT, 1.0) // time to wait before starting replay again
 OPTION(mds_shutdown_check, OPT_INT, 0)
 OPTION(mds_thrash_exports, OPT_INT, 0)
@@ -499,6 +568,8 @@ OPTION(mds_mon_shutdown_timeout, OPT_DOUBLE, 5)
 
 // Maximum number of concurrent stray files to purge
 OPTION(mds_max_purge_files, OPT_U32, 64)
+// Max number of purged strays whose dentry removal goes in one journal event
+OPTION(mds_purge_journal_batch, OPT_U32, 16)
 // Maximum number of concurrent RADOS ops to issue in purging
 OPTION(mds_max_purge_ops, OPT_U32, 8192)
 // Maximum number of concurrent RADOS ops to issue in purging, scaled by PG count
@@ -532,9 +603,13 @@ OPTION(osd_agent_delay_time, OPT_FLOAT, 5.0)
 // osd ignore history.last_epoch_started in find_best_info
 OPTION(osd_find_best_info_ignore_history_les, OPT_BOOL, false)
 
-// decay atime and hist histograms after how many objects go by
+// decay the atime histogram after how many objects go by
 OPTION(osd_agent_hist_halflife, OPT_INT, 1000)
 
+// percent less an object's presence in a HitSet counts toward its
+// temperature than its presence in the next newer one
+OPTION(osd_agent_hit_set_temp_decay, OPT_INT, 50)
+
 // must be this amount over the threshold to enable,
 // this amount below the threshold to disable.
 OPTION(osd_agent_slop, OPT_FLOAT, .02)
@@ -554,6 +629,9 @@ OPTION(osd_pool_use_gmt_hitset, OPT_BOOL, true) // try to use gmt for hitset arc
 OPTION(osd_pool_default_crush_rule, OPT_INT, -1) // deprecated for osd_pool_default_crush_replicated_ruleset
 OPTION(osd_pool_default_crush_replicated_ruleset, OPT_INT, CEPH_DEFAULT_CRUSH_REPLICATED_RULESET)
 OPTION(osd_pool_erasure_code_stripe_width, OPT_U32, OSD_POOL_ERASURE_CODE_STRIPE_WIDTH) // in bytes
+OPTION(osd_ec_fast_read_extra_shards, OPT_U32, 0) // fast_read pools: shards to read beyond the minimum (0 = all available)
+OPTION(osd_ec_read_locality, OPT_BOOL, true) // degraded reads and recovery prefer shards close to the primary in the crush hierarchy
+OPTION(osd_ec_extent_cache_bytes, OPT_U64, 4 << 20) // per PG, recently written stripes kept for overwrites
 OPTION(osd_pool_default_size, OPT_INT, 3)
 OPTION(osd_pool_default_min_size, OPT_INT, 0)  // 0 means no specific default; ceph will use size-size/2
 OPTION(osd_pool_default_pg_num, OPT_INT, 8) // number of PGs for new pools. Configure in global or mon section of ceph.conf
@@ -597,25 +675,52 @@ OPTION(osd_tier_default_cache_hit_set_period, OPT_INT, 1200)
 OPTION(osd_tier_default_cache_hit_set_type, OPT_STR, "bloom")
 OPTION(osd_tier_default_cache_min_read_recency_for_promote, OPT_INT, 1) // number of recent HitSets the object must appear in to be promoted (on read)
 OPTION(osd_tier_default_cache_min_write_recency_for_promote, OPT_INT, 1) // number of recent HitSets the object must appear in to be promoted (on write)
+OPTION(osd_tier_promote_min_hit_sets, OPT_INT, 0) // in-memory HitSets (any age) an object must appear in to be promoted, on top of recency (0 = off)
+OPTION(osd_tier_promote_max_objects_sec, OPT_U64, 0) // per-osd optional promotion budget (0 = unlimited)
+OPTION(osd_tier_promote_max_bytes_sec, OPT_U64, 0)
 
 OPTION(osd_map_dedup, OPT_BOOL, true)
+OPTION(osd_map_mapping_threads, OPT_INT, 0)  // precompute every pg's mapping for each new map with this many threads; 0 to map pgs on demand
 OPTION(osd_map_max_advance, OPT_INT, 150) // make this < cache_size!
 OPTION(osd_map_cache_size, OPT_INT, 200)
 OPTION(osd_map_message_max, OPT_INT, 100)  // max maps per MOSDMap message
 OPTION(osd_map_share_max_epochs, OPT_INT, 100)  // cap on # of inc maps we send to peers, clients
+OPTION(osd_map_gossip_fanout, OPT_INT, 0)  // push new maps down a tree of up osds with this fanout; mons then only tell its root.  0 to share lazily
 OPTION(osd_inject_bad_map_crc_probability, OPT_FLOAT, 0)
 OPTION(osd_inject_failure_on_pg_removal, OPT_BOOL, false)
 OPTION(osd_op_threads, OPT_INT, 2)    // 0 == no threading
 OPTION(osd_peering_wq_batch_size, OPT_U64, 20)
 OPTION(osd_op_pq_max_tokens_per_priority, OPT_U64, 4194304)
 OPTION(osd_op_pq_min_cost, OPT_U64, 65536)
+OPTION(osd_op_queue, OPT_STR, "prioritized") // op scheduler: prioritized or mclock
+// mclock reservation (ops/sec), weight and limit (ops/sec, 0 for none) per op class
+OPTION(osd_op_queue_mclock_client_res, OPT_DOUBLE, 1000.0)
+OPTION(osd_op_queue_mclock_client_wgt, OPT_DOUBLE, 500.0)
+OPTION(osd_op_queue_mclock_client_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_recovery_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_recovery_wgt, OPT_DOUBLE, 10.0)
+OPTION(osd_op_queue_mclock_recovery_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_scrub_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_scrub_wgt, OPT_DOUBLE, 5.0)
+OPTION(osd_op_queue_mclock_scrub_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_snap_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_snap_wgt, OPT_DOUBLE, 5.0)
+OPTION(osd_op_queue_mclock_snap_lim, OPT_DOUBLE, 0.0)
 OPTION(osd_disk_threads, OPT_INT, 1)
 OPTION(osd_disk_thread_ioprio_class, OPT_STR, "") // rt realtime be best effort idle
 OPTION(osd_disk_thread_ioprio_priority, OPT_INT, -1) // 0-7
 OPTION(osd_recovery_threads, OPT_INT, 1)
+OPTION(osd_load_pgs_threads, OPT_INT, 4)  // threads reading pg state and logs at startup
+OPTION(osd_repop_batch_window_us, OPT_INT, 0)  // hold repops this long to send several to a replica at once (0 = off)
+OPTION(osd_repop_batch_max_ops, OPT_INT, 16)   // send a repop batch right away once it has this many ops
+OPTION(osd_replica_read_check_stable, OPT_BOOL, true) // replicas only serve balanced reads of objects committed on all shards
 OPTION(osd_recover_clone_overlap, OPT_BOOL, true)   // preserve clone_overlap during recovery/migration
 OPTION(osd_op_num_threads_per_shard, OPT_INT, 2)
+OPTION(osd_op_unlocked_reads, OPT_BOOL, false)  // drop the pg lock around the store read of plain replicated reads
+OPTION(osd_op_async_reads, OPT_BOOL, false)  // replicated pools serve client reads through ObjectStore::read_async
 OPTION(osd_op_num_shards, OPT_INT, 5)
+OPTION(osd_op_shard_steal, OPT_BOOL, false)  // idle op shard threads run ops queued on busier shards
+OPTION(osd_op_shard_steal_min_depth, OPT_INT, 2)  // only steal from shards with at least this many queued ops
 
 // Set to true for testing.  Users should NOT set this.
 // If set to true even after reading enough shards to
@@ -643,6 +748,8 @@ OPTION(osd_heartbeat_addr, OPT_ADDR, entity_addr_t())
 OPTION(osd_heartbeat_interval, OPT_INT, 6)       // (seconds) how often we ping peers
 OPTION(osd_heartbeat_grace, OPT_INT, 20)         // (seconds) how long before we decide a peer has failed
 OPTION(osd_heartbeat_min_peers, OPT_INT, 10)     // minimum number of peers
+OPTION(osd_heartbeat_max_peers, OPT_INT, 0)      // cap on peers taken from our pgs (0 = no cap)
+OPTION(osd_heartbeat_phi_threshold, OPT_DOUBLE, 0) // report a peer once phi accrual suspicion reaches this, before the grace (0 = off)
 OPTION(osd_heartbeat_use_min_delay_socket, OPT_BOOL, false) // prio the heartbeat tcp socket and set dscp as CS6 on it if true
 
 // max number of parallel snap trims/pg
@@ -662,6 +769,11 @@ OPTION(osd_preserve_trimmed_log, OPT_BOOL, false)
 OPTION(osd_auto_mark_unfound_lost, OPT_BOOL, false)
 OPTION(osd_recovery_delay_start, OPT_FLOAT, 0)
 OPTION(osd_recovery_max_active, OPT_INT, 3)
+OPTION(osd_recovery_delta_push, OPT_BOOL, false) // log dirty extents and push only those to replicas with an older copy
+OPTION(osd_recovery_min_active, OPT_INT, 1)
+OPTION(osd_recovery_target_client_p99, OPT_DOUBLE, 0) // seconds; adjust recovery concurrency (up to osd_recovery_max_active) to keep client p99 latency below this, 0 = fixed
+OPTION(osd_recovery_adjust_interval, OPT_DOUBLE, 5) // seconds between adjustments
+OPTION(osd_recovery_adjust_min_samples, OPT_INT, 100) // client ops needed in an interval to judge latency
 OPTION(osd_recovery_max_single_start, OPT_INT, 1)
 OPTION(osd_recovery_max_chunk, OPT_U64, 8<<20)  // max size of push chunk
 OPTION(osd_copyfrom_max_chunk, OPT_U64, 8<<20)   // max size of a COPYFROM chunk
@@ -681,8 +793,11 @@ OPTION(osd_scrub_chunk_max, OPT_INT, 25)
 OPTION(osd_scrub_sleep, OPT_FLOAT, 0)   // sleep between [deep]scrub ops
 OPTION(osd_scrub_auto_repair, OPT_BOOL, false)   // whether auto-repair inconsistencies upon deep-scrubbing
 OPTION(osd_scrub_auto_repair_num_errors, OPT_U32, 5)   // only auto-repair when number of errors is below this threshold
+OPTION(osd_repair_on_read_error, OPT_BOOL, false)   // recover an object from a replica when a client read of the primary copy fails with EIO
 OPTION(osd_deep_scrub_interval, OPT_FLOAT, 60*60*24*7) // once a week
 OPTION(osd_deep_scrub_stride, OPT_INT, 524288)
+OPTION(osd_deep_scrub_readahead_objects, OPT_INT, 2)   // objects ahead of the one being hashed to hint to the store
+OPTION(osd_deep_scrub_max_bytes_per_sec, OPT_U64, 0)   // osd-wide deep scrub read budget; 0 for no limit
 OPTION(osd_deep_scrub_update_digest_min_age, OPT_INT, 2*60*60)   // objects must be this old (seconds) before we update the whole-object digest on scrub
 OPTION(osd_scan_list_ping_tp_interval, OPT_U64, 100)
 OPTION(osd_class_dir, OPT_STR, CEPH_LIBDIR "/rados-classes") // where rados plugins are stored
@@ -699,6 +814,8 @@ OPTION(osd_pg_epoch_persisted_max_stale, OPT_U32, 150) // make this < map_cache_
 OPTION(osd_min_pg_log_entries, OPT_U32, 3000)  // number of entries to keep in the pg log when trimming it
 OPTION(osd_max_pg_log_entries, OPT_U32, 10000) // max entries, say when degraded, before we trim
 OPTION(osd_pg_log_trim_min, OPT_U32, 100)
+OPTION(osd_pg_log_append_only, OPT_BOOL, false) // append log entries to the pgmeta object data instead of one omap key each
+OPTION(osd_pg_log_compact_bytes, OPT_U64, 1<<20) // rewrite an append-only log from the start once this much (and more than is live) was trimmed
 OPTION(osd_op_complaint_time, OPT_FLOAT, 30) // how many seconds old makes an op complaint-worthy
 OPTION(osd_command_max_records, OPT_INT, 256)
 OPTION(osd_max_pg_blocked_by, OPT_U32, 16)    // max peer osds to report that are blocking our progress
@@ -721,11 +838,16 @@ OPTION(osd_enable_op_tracker, OPT_BOOL, true) // enable/disable OSD op tracking
 OPTION(osd_num_op_tracker_shard, OPT_U32, 32) // The number of shards for holding the ops
 OPTION(osd_op_history_size, OPT_U32, 20)    // Max number of completed ops to track
 OPTION(osd_op_history_duration, OPT_U32, 600) // Oldest completed op to track
+OPTION(op_trace_sample, OPT_U32, 0) // trace 1 in N requests by reqid, on clients and osds alike (0 = off)
+OPTION(op_trace_file, OPT_STR, "") // where sampled request traces go, one JSON line each; e.g. /var/log/ceph/$cluster-$name.optrace
 OPTION(osd_target_transaction_size, OPT_INT, 30)     // to adjust various transactions that batch smaller items
 OPTION(osd_failsafe_full_ratio, OPT_FLOAT, .97) // what % full makes an OSD "full" (failsafe)
 OPTION(osd_failsafe_nearfull_ratio, OPT_FLOAT, .90) // what % full makes an OSD near full (failsafe)
 
 OPTION(osd_pg_object_context_cache_count, OPT_INT, 64)
+OPTION(osd_object_context_cache_bytes, OPT_U64, 0) // if set, one cache of this size for all pgs replaces the per-pg count
+OPTION(osd_object_context_cache_shards, OPT_INT, 8)
+OPTION(osd_object_context_prefetch_attrs, OPT_BOOL, true) // read object info and snapset with one getattrs on a cache miss
 OPTION(osd_tracing, OPT_BOOL, false) // true if LTTng-UST tracepoints should be enabled
 
 // determines whether PGLog::check() compares written out log to stored log
@@ -736,8 +858,16 @@ OPTION(threadpool_default_timeout, OPT_INT, 60)
 // default wait time for an empty queue before pinging the hb timeout
 OPTION(threadpool_empty_queue_max_wait, OPT_INT, 2)
 
+// queue Finisher contexts without taking the finisher lock
+OPTION(finisher_lockless_queue, OPT_BOOL, false)
+// how many times an idle lockless finisher polls its queue before sleeping
+OPTION(finisher_lockless_spin, OPT_INT, 1000)
+
 OPTION(leveldb_write_buffer_size, OPT_U64, 8 *1024*1024) // leveldb write buffer size
 OPTION(leveldb_cache_size, OPT_U64, 128 *1024*1024) // leveldb cache size
+// if set, all leveldb instances in the process share one cache of this
+// size instead of each allocating leveldb_cache_size
+OPTION(leveldb_shared_cache_size, OPT_U64, 0)
 OPTION(leveldb_block_size, OPT_U64, 0) // leveldb block size
 OPTION(leveldb_bloom_size, OPT_INT, 0) // leveldb bloom bits per entry
 OPTION(leveldb_max_open_files, OPT_INT, 0) // leveldb max open files
@@ -745,6 +875,15 @@ OPTION(leveldb_compression, OPT_BOOL, true) // leveldb uses compression
 OPTION(leveldb_paranoid, OPT_BOOL, false) // leveldb paranoid flag
 OPTION(leveldb_log, OPT_STR, "/dev/null")  // enable leveldb log file
 OPTION(leveldb_compact_on_mount, OPT_BOOL, false)
+// compact a key range after a committed rmkeys_by_prefix/rm_range_keys
+// removed at least this many keys from it (0 to never)
+OPTION(leveldb_compact_on_range_delete, OPT_U64, 10000)
+// compact a prefix in the background once this many keys were deleted
+// from it (0 to never); checked every leveldb_compact_interval seconds,
+// and only when at most leveldb_compact_idle_txns were submitted since
+OPTION(leveldb_compact_deleted_keys, OPT_U64, 100000)
+OPTION(leveldb_compact_interval, OPT_FLOAT, 60)
+OPTION(leveldb_compact_idle_txns, OPT_U64, 600)
 
 OPTION(kinetic_host, OPT_STR, "") // hostname or ip address of a kinetic drive to use
 OPTION(kinetic_port, OPT_INT, 8123) // port number of the kinetic drive
@@ -755,10 +894,27 @@ OPTION(kinetic_use_ssl, OPT_BOOL, false) // whether to secure kinetic traffic wi
 
 // rocksdb options that will be used for keyvaluestore(if backend is rocksdb)
 OPTION(keyvaluestore_rocksdb_options, OPT_STR, "")
+// rocksdb column families for keyvaluestore, as "name[:options] ...";
+// keys whose prefix starts with name go to that family
+OPTION(keyvaluestore_rocksdb_column_families, OPT_STR, "")
 // rocksdb options that will be used for omap(if omap_backend is rocksdb)
 OPTION(filestore_rocksdb_options, OPT_STR, "")
+// rocksdb column families for omap (see keyvaluestore_rocksdb_column_families)
+OPTION(filestore_rocksdb_column_families, OPT_STR, "")
 // rocksdb options that will be used in monstore
 OPTION(mon_rocksdb_options, OPT_STR, "")
+// same as leveldb_compact_on_range_delete, for rocksdb
+OPTION(rocksdb_compact_on_range_delete, OPT_U64, 10000)
+// same as leveldb_compact_deleted_keys and friends, for rocksdb
+OPTION(rocksdb_compact_deleted_keys, OPT_U64, 100000)
+OPTION(rocksdb_compact_interval, OPT_FLOAT, 60)
+OPTION(rocksdb_compact_idle_txns, OPT_U64, 600)
+// if set, all rocksdb instances in the process share one block cache of
+// this size (overrides block_based_table_factory in the options strings)
+OPTION(rocksdb_shared_cache_size, OPT_U64, 0)
+OPTION(rocksdb_bloom_bits_per_key, OPT_INT, 0)  // 0 for no bloom filters
+// collect rocksdb tickers and histograms for perf counters and 'kv stats'
+OPTION(rocksdb_perf, OPT_BOOL, false)
 
 /**
  * osd_*_priority adjust the relative priority of client io, recovery io,
@@ -806,11 +962,17 @@ OPTION(osd_bench_duration, OPT_U32, 30) // duration of 'osd bench', capped at 30
 OPTION(memstore_device_bytes, OPT_U64, 1024*1024*1024)
 OPTION(memstore_page_set, OPT_BOOL, true)
 OPTION(memstore_page_size, OPT_U64, 64 << 10)
+OPTION(memstore_page_arena, OPT_BOOL, false) // carve pages out of large (huge page) mappings
+OPTION(memstore_page_arena_hugetlb, OPT_BOOL, true) // try MAP_HUGETLB before transparent huge pages
+OPTION(memstore_persist, OPT_BOOL, true) // save contents on umount, load them on mount
 
 OPTION(newstore_max_dir_size, OPT_U32, 1000000)
-OPTION(newstore_onode_map_size, OPT_U32, 1024)   // onodes per collection
+OPTION(newstore_onode_cache_size, OPT_U64, 256*1024*1024)  // bytes of onodes cached, store-wide
+OPTION(newstore_onode_cache_shards, OPT_INT, 16)
 OPTION(newstore_backend, OPT_STR, "rocksdb")
 OPTION(newstore_backend_options, OPT_STR, "")
+// kv column families, e.g. "L:compaction_style=kCompactionStyleUniversal"
+OPTION(newstore_backend_column_families, OPT_STR, "")
 OPTION(newstore_fail_eio, OPT_BOOL, true)
 OPTION(newstore_sync_io, OPT_BOOL, false)  // perform initial io synchronously
 OPTION(newstore_sync_transaction, OPT_BOOL, false)  // perform kv txn synchronously
@@ -830,9 +992,18 @@ OPTION(newstore_fid_prealloc, OPT_INT, 1024)
 OPTION(newstore_nid_prealloc, OPT_INT, 1024)
 OPTION(newstore_overlay_max_length, OPT_INT, 65536)
 OPTION(newstore_overlay_max, OPT_INT, 32)
+OPTION(newstore_inline_max, OPT_INT, 4096)  // keep objects up to this size in the onode itself (0 to disable)
+OPTION(newstore_compression, OPT_STR, "")  // compress whole-object writes with this compressor (snappy, zlib), empty to disable
+OPTION(newstore_compression_pools, OPT_STR, "")  // ids of the pools to compress, empty for all
+OPTION(newstore_compression_min_size, OPT_U32, 65536)  // don't compress objects smaller than this
+OPTION(newstore_compression_max_size, OPT_U32, 4*1024*1024)  // nor larger; each read decompresses the whole object
+OPTION(newstore_compression_required_ratio, OPT_DOUBLE, .875)  // store raw unless compressed/raw is at most this
 OPTION(newstore_open_by_handle, OPT_BOOL, true)
 OPTION(newstore_o_direct, OPT_BOOL, true)
 OPTION(newstore_db_path, OPT_STR, "")
+OPTION(newstore_block_path, OPT_STR, "")  // mkfs: store data on this device or file instead of fragment files
+OPTION(newstore_block_size, OPT_INT, 4096)  // mkfs: allocation unit on the block device
+OPTION(newstore_block_create_size, OPT_U64, 10ull*1024*1024*1024)  // mkfs: size of an empty block file
 OPTION(newstore_aio, OPT_BOOL, true)
 OPTION(newstore_aio_poll_ms, OPT_INT, 250)  // milliseconds
 OPTION(newstore_aio_max_queue_depth, OPT_INT, 4096)
@@ -858,8 +1029,14 @@ OPTION(filestore_wbthrottle_xfs_inodes_start_flusher, OPT_U64, 500)
 OPTION(filestore_wbthrottle_btrfs_inodes_hard_limit, OPT_U64, 5000)
 OPTION(filestore_wbthrottle_xfs_inodes_hard_limit, OPT_U64, 5000)
 
+// derive the byte and io limits from measured flush throughput
+OPTION(filestore_wbthrottle_adaptive, OPT_BOOL, false)
+OPTION(filestore_wbthrottle_adaptive_target, OPT_DOUBLE, 1.0) // seconds of flushing left dirty
+OPTION(filestore_wbthrottle_adaptive_max_depth, OPT_INT, 16) // max flushes in flight
+
 // Tests index failure paths
 OPTION(filestore_index_retry_probability, OPT_DOUBLE, 0)
+OPTION(filestore_index_path_cache_size, OPT_INT, 1024) // lookups cached per collection, 0 to disable
 
 // Allow object read error injection
 OPTION(filestore_debug_inject_read_err, OPT_BOOL, false)
@@ -886,6 +1063,9 @@ OPTION(filestore_sloppy_crc_block_size, OPT_INT, 65536)
 OPTION(filestore_max_alloc_hint_size, OPT_U64, 1ULL << 20) // bytes
 
 OPTION(filestore_max_sync_interval, OPT_DOUBLE, 5)    // seconds
+OPTION(filestore_sync_dirty_only, OPT_BOOL, false) // commit by fsyncing the files and dirs changed since the last commit, not syncfs
+OPTION(filestore_sync_dirty_threads, OPT_INT, 4) // threads fsyncing dirty files at commit
+OPTION(filestore_sync_dirty_max, OPT_INT, 20000) // above this many dirty files, commit with syncfs
 OPTION(filestore_min_sync_interval, OPT_DOUBLE, .01)  // seconds
 OPTION(filestore_btrfs_snap, OPT_BOOL, true)
 OPTION(filestore_btrfs_clone_range, OPT_BOOL, true)
@@ -894,6 +1074,7 @@ OPTION(filestore_fsync_flushes_journal_data, OPT_BOOL, false)
 OPTION(filestore_fiemap, OPT_BOOL, false)     // (try to) use fiemap
 OPTION(filestore_seek_data_hole, OPT_BOOL, false)     // (try to) use seek_data/hole
 OPTION(filestore_fadvise, OPT_BOOL, true)
+OPTION(filestore_coalesce_writes, OPT_BOOL, true) // merge a transaction's writes to one object
 
 // (try to) use extsize for alloc hint NOTE: extsize seems to trigger
 // data corruption in xfs prior to kernel 3.5.  filestore will
@@ -909,12 +1090,16 @@ OPTION(filestore_queue_max_bytes, OPT_INT, 100 << 20)
 OPTION(filestore_queue_committing_max_ops, OPT_INT, 500)        // this is ON TOP of filestore_queue_max_*
 OPTION(filestore_queue_committing_max_bytes, OPT_INT, 100 << 20) //  "
 OPTION(filestore_op_threads, OPT_INT, 2)
+OPTION(filestore_read_threads, OPT_INT, 0)   // threads serving read_async(); 0 reads in the caller
 OPTION(filestore_op_thread_timeout, OPT_INT, 60)
 OPTION(filestore_op_thread_suicide_timeout, OPT_INT, 180)
 OPTION(filestore_commit_timeout, OPT_FLOAT, 600)
 OPTION(filestore_fiemap_threshold, OPT_INT, 4096)
 OPTION(filestore_merge_threshold, OPT_INT, 10)
 OPTION(filestore_split_multiple, OPT_INT, 2)
+OPTION(filestore_split_background, OPT_BOOL, true) // queue directory splits for the split thread
+OPTION(filestore_split_background_rate, OPT_INT, 2000) // objects moved per second by background splits, 0 for no limit
+OPTION(filestore_split_background_interval, OPT_DOUBLE, 1) // seconds between scans for queued splits
 OPTION(filestore_update_to, OPT_INT, 1000)
 OPTION(filestore_blackhole, OPT_BOOL, false)     // drop any new transactions on the floor
 OPTION(filestore_fd_cache_size, OPT_INT, 128)    // FD lru size
@@ -927,6 +1112,10 @@ OPTION(filestore_debug_verify_split, OPT_BOOL, false)
 OPTION(journal_dio, OPT_BOOL, true)
 OPTION(journal_aio, OPT_BOOL, true)
 OPTION(journal_force_aio, OPT_BOOL, false)
+OPTION(journal_pmem, OPT_BOOL, false) // osd journal is a DAX mapped persistent memory region (see PMemJournal)
+OPTION(journal_pmem_msync, OPT_BOOL, false) // also msync() pmem journal writes, for journals not on real pmem
+OPTION(journal_aio_queues, OPT_INT, 1) // independent aio submit queues, each with its own completion thread
+OPTION(journal_aio_stripe_size, OPT_INT, 0) // split journal aios into pieces of at most this many bytes (0 = don't)
 
 OPTION(keyvaluestore_queue_max_ops, OPT_INT, 50)
 OPTION(keyvaluestore_queue_max_bytes, OPT_INT, 100 << 20)
@@ -935,8 +1124,9 @@ OPTION(keyvaluestore_op_threads, OPT_INT, 2)
 OPTION(keyvaluestore_op_thread_timeout, OPT_INT, 60)
 OPTION(keyvaluestore_op_thread_suicide_timeout, OPT_INT, 180)
 OPTION(keyvaluestore_default_strip_size, OPT_INT, 4096) // Only affect new object
-OPTION(keyvaluestore_max_expected_write_size, OPT_U64, 1ULL << 24) // bytes
+OPTION(keyvaluestore_max_expected_write_size, OPT_U64, 1ULL << 20) // bytes, largest strip size an alloc hint may pick
 OPTION(keyvaluestore_header_cache_size, OPT_INT, 4096)    // Header cache size
+OPTION(keyvaluestore_strip_cache_size, OPT_U64, 32 << 20) // bytes of recently written strips to keep, 0 to disable
 OPTION(keyvaluestore_backend, OPT_STR, "leveldb")
 OPTION(keyvaluestore_dump_file, OPT_STR, "")         // file onto which store transaction dumps
 
@@ -946,6 +1136,8 @@ OPTION(journal_block_align, OPT_BOOL, true)
 OPTION(journal_write_header_frequency, OPT_U64, 0)
 OPTION(journal_max_write_bytes, OPT_INT, 10 << 20)
 OPTION(journal_max_write_entries, OPT_INT, 100)
+OPTION(journal_group_commit_target_latency, OPT_DOUBLE, 0) // p99 journal commit latency to aim for, in seconds (0 = no group commit holds)
+OPTION(journal_group_commit_max_delay, OPT_DOUBLE, .002) // never hold a journal write longer than this
 OPTION(journal_queue_max_ops, OPT_INT, 300)
 OPTION(journal_queue_max_bytes, OPT_INT, 32 << 20)
 OPTION(journal_align_min_size, OPT_INT, 64 << 10)  // align data payloads >= this.
@@ -957,6 +1149,8 @@ OPTION(journal_discard, OPT_BOOL, false) //using ssd disk as journal, whether su
 OPTION(rados_mon_op_timeout, OPT_DOUBLE, 0) // how many seconds to wait for a response from the monitor before returning an error from a rados operation. 0 means on limit.
 OPTION(rados_osd_op_timeout, OPT_DOUBLE, 0) // how many seconds to wait for a response from osds before returning an error from a rados operation. 0 means no limit.
 OPTION(rados_tracing, OPT_BOOL, false) // true if LTTng-UST tracepoints should be enabled
+OPTION(rados_striper_max_inflight_ios, OPT_INT, 16) // most rados object ios one striped read or write has in flight
+OPTION(rados_striper_lock_lease, OPT_DOUBLE, 0) // seconds to keep the shared lock a striped read takes, for later reads to reuse; 0 unlocks after every read
 
 OPTION(rbd_op_threads, OPT_INT, 1)
 OPTION(rbd_op_thread_timeout, OPT_INT, 60)
@@ -968,6 +1162,7 @@ OPTION(rbd_cache_max_dirty, OPT_LONGLONG, 24<<20)    // dirty limit in bytes - s
 OPTION(rbd_cache_target_dirty, OPT_LONGLONG, 16<<20) // target dirty limit in bytes
 OPTION(rbd_cache_max_dirty_age, OPT_FLOAT, 1.0)      // seconds in cache before writeback starts
 OPTION(rbd_cache_max_dirty_object, OPT_INT, 0)       // dirty limit for objects - set to 0 for auto calculate from rbd_cache_size
+OPTION(rbd_cache_policy, OPT_STR, "lru") // clean data replacement: lru or 2q (scan resistant)
 OPTION(rbd_cache_block_writes_upfront, OPT_BOOL, false) // whether to block writes to the cache before the aio_write call completes (true), or block before the aio completion is called (false)
 OPTION(rbd_concurrent_management_ops, OPT_INT, 10) // how many operations can be in flight for a management operation like deleting or resizing an image
 OPTION(rbd_balance_snap_reads, OPT_BOOL, false)
@@ -977,12 +1172,18 @@ OPTION(rbd_localize_parent_reads, OPT_BOOL, true)
 OPTION(rbd_readahead_trigger_requests, OPT_INT, 10) // number of sequential requests necessary to trigger readahead
 OPTION(rbd_readahead_max_bytes, OPT_LONGLONG, 512 * 1024) // set to 0 to disable readahead
 OPTION(rbd_readahead_disable_after_bytes, OPT_LONGLONG, 50 * 1024 * 1024) // how many bytes are read in total before readahead is disabled
+OPTION(rbd_readahead_streams, OPT_INT, 4) // number of interleaved sequential streams readahead tracks
 OPTION(rbd_clone_copy_on_read, OPT_BOOL, false)
 OPTION(rbd_blacklist_on_break_lock, OPT_BOOL, true) // whether to blacklist clients whose lock was broken
 OPTION(rbd_blacklist_expire_seconds, OPT_INT, 0) // number of seconds to blacklist - set to 0 for OSD default
 OPTION(rbd_request_timed_out_seconds, OPT_INT, 30) // number of seconds before maint request times out
 OPTION(rbd_skip_partial_discard, OPT_BOOL, false) // when trying to discard a range inside an object, set to true to skip zeroing the range.
 OPTION(rbd_enable_alloc_hint, OPT_BOOL, true) // when writing a object, it will issue a hint to osd backend to indicate the expected size object need
+OPTION(rbd_write_log_path, OPT_STR, "") // directory on a local ssd for a persistent write-back log; empty disables it (needs the exclusive-lock feature)
+OPTION(rbd_write_log_size, OPT_U64, 256 << 20) // size of each image's write log, and of the data it may hold in memory until destaged
+OPTION(rbd_write_log_max_destage_ios, OPT_INT, 32) // how many log records may be in flight to the cluster at once
+OPTION(rbd_parent_cache_path, OPT_STR, "") // directory for a host-wide cache of objects read from parent images of clones; empty disables it
+OPTION(rbd_parent_cache_size, OPT_U64, 10ull << 30) // bytes the parent cache directory may hold
 OPTION(rbd_tracing, OPT_BOOL, false) // true if LTTng-UST tracepoints should be enabled
 
 /*
@@ -1015,6 +1216,8 @@ OPTION(nss_db_path, OPT_STR, "") // path to nss db
 
 
 OPTION(rgw_max_chunk_size, OPT_INT, 512 * 1024)
+OPTION(rgw_put_obj_min_window_size, OPT_INT, 16 * 1024 * 1024) // bytes of a put in flight to rados at first
+OPTION(rgw_put_obj_max_window_size, OPT_INT, 64 * 1024 * 1024) // the most the in-flight window may grow to
 OPTION(rgw_max_put_size, OPT_U64, 5ULL*1024*1024*1024)
 
 /**
@@ -1027,6 +1230,7 @@ OPTION(rgw_max_put_size, OPT_U64, 5ULL*1024*1024*1024)
  * (e.g. thousand) as it increases the cost for bucket listing.
  */
 OPTION(rgw_override_bucket_index_max_shards, OPT_U32, 0)
+OPTION(rgw_max_objs_per_shard, OPT_U64, 100000) // bucket stats flags index shards with more entries than this
 
 /**
  * Represents the maximum AIO pending requests for the bucket index object shards.
@@ -1043,6 +1247,9 @@ OPTION(rgw_data, OPT_STR, "/var/lib/ceph/radosgw/$cluster-$id")
 OPTION(rgw_enable_apis, OPT_STR, "s3, swift, swift_auth, admin")
 OPTION(rgw_cache_enabled, OPT_BOOL, true)   // rgw cache enabled
 OPTION(rgw_cache_lru_size, OPT_INT, 10000)   // num of entries in rgw cache
+OPTION(rgw_cache_max_bytes, OPT_U64, 0)   // bytes the rgw cache may hold, 0 for no limit
+OPTION(rgw_cache_shards, OPT_INT, 16)   // rgw cache is split by name into this many independently locked shards
+OPTION(rgw_cache_expiry_interval, OPT_U64, 900)   // seconds a cache entry is trusted without a notify, 0 for ever
 OPTION(rgw_socket_path, OPT_STR, "")   // path to unix domain socket, if not specified, rgw will not run as external fcgi
 OPTION(rgw_host, OPT_STR, "")  // host for radosgw, can be an IP, default is 0.0.0.0
 OPTION(rgw_port, OPT_STR, "")  // port to listen, format as "8080" "5000", if not specified, rgw will not run external fcgi
@@ -1063,6 +1270,7 @@ OPTION(rgw_keystone_admin_password, OPT_STR, "")  // keystone admin user passwor
 OPTION(rgw_keystone_admin_tenant, OPT_STR, "")  // keystone admin user tenant
 OPTION(rgw_keystone_accepted_roles, OPT_STR, "Member, admin")  // roles required to serve requests
 OPTION(rgw_keystone_token_cache_size, OPT_INT, 10000)  // max number of entries in keystone token cache
+OPTION(rgw_keystone_token_cache_shards, OPT_INT, 8)  // keystone token cache is split by token id into this many independently locked shards
 OPTION(rgw_keystone_revocation_interval, OPT_INT, 15 * 60)  // seconds between tokens revocation check
 OPTION(rgw_s3_auth_use_rados, OPT_BOOL, true)  // should we try to use the internal credentials for s3?
 OPTION(rgw_s3_auth_use_keystone, OPT_BOOL, false)  // should we try to use keystone for s3?
@@ -1092,6 +1300,8 @@ OPTION(rgw_enable_usage_log, OPT_BOOL, false) // enable logging bandwidth usage
 OPTION(rgw_ops_log_rados, OPT_BOOL, true) // whether ops log should go to rados
 OPTION(rgw_ops_log_socket_path, OPT_STR, "") // path to unix domain socket where ops log can go
 OPTION(rgw_ops_log_data_backlog, OPT_INT, 5 << 20) // max data backlog for ops log
+OPTION(rgw_ops_log_rados_batch_bytes, OPT_U64, 64 << 10) // batch this many bytes of ops log before writing to rados, 0 to write each entry
+OPTION(rgw_ops_log_flush_interval, OPT_INT, 30) // write out batched ops log every X seconds
 OPTION(rgw_usage_log_flush_threshold, OPT_INT, 1024) // threshold to flush pending log data
 OPTION(rgw_usage_log_tick_interval, OPT_INT, 30) // flush pending log data every X seconds
 OPTION(rgw_intent_log_object_name, OPT_STR, "%Y-%m-%d-%i-%n")  // man date to see codes (a subset are supported)
@@ -1102,12 +1312,15 @@ OPTION(rgw_gc_max_objs, OPT_INT, 32)
 OPTION(rgw_gc_obj_min_wait, OPT_INT, 2 * 3600)    // wait time before object may be handled by gc
 OPTION(rgw_gc_processor_max_time, OPT_INT, 3600)  // total run time for a single gc processor work
 OPTION(rgw_gc_processor_period, OPT_INT, 3600)  // gc processor cycle time
+OPTION(rgw_gc_max_concurrent_io, OPT_INT, 10)  // tail object removals a gc processor keeps in flight
+OPTION(rgw_gc_max_trim_chunk, OPT_INT, 16)  // chains removed from the gc log in one cls_rgw_gc_remove
 OPTION(rgw_s3_success_create_obj_status, OPT_INT, 0) // alternative success status response for create-obj (0 - default)
 OPTION(rgw_resolve_cname, OPT_BOOL, false)  // should rgw try to resolve hostname as a dns cname record
 OPTION(rgw_obj_stripe_size, OPT_INT, 4 << 20)
 OPTION(rgw_extended_http_attrs, OPT_STR, "") // list of extended attrs that can be set on objects (beyond the default)
 OPTION(rgw_exit_timeout_secs, OPT_INT, 120) // how many seconds to wait for process to go down before exiting unconditionally
 OPTION(rgw_get_obj_window_size, OPT_INT, 16 << 20) // window size in bytes for single get obj request
+OPTION(rgw_get_obj_max_window_size, OPT_INT, 64 << 20) // the most the window grows to when rados is the bottleneck
 OPTION(rgw_get_obj_max_req_size, OPT_INT, 4 << 20) // max length of a single get obj rados op
 OPTION(rgw_relaxed_s3_bucket_names, OPT_BOOL, false) // enable relaxed bucket name rules for US region buckets
 OPTION(rgw_defer_to_bucket_acls, OPT_STR, "") // if the user has bucket perms, use those before key perms (recurse and full_control)
@@ -1123,6 +1336,7 @@ OPTION(rgw_data_log_window, OPT_INT, 30) // data log entries window (in seconds)
 OPTION(rgw_data_log_changes_size, OPT_INT, 1000) // number of in-memory entries to hold for data changes log
 OPTION(rgw_data_log_num_shards, OPT_INT, 128) // number of objects to keep data changes log on
 OPTION(rgw_data_log_obj_prefix, OPT_STR, "data_log") //
+OPTION(rgw_log_list_max_entries, OPT_INT, 1000) // default and max entries returned by one mdlog/datalog list request
 OPTION(rgw_replica_log_obj_prefix, OPT_STR, "replica_log") //
 
 OPTION(rgw_bucket_quota_ttl, OPT_INT, 600) // time for cached bucket stats to be cached within rgw instance
@@ -1154,6 +1368,7 @@ OPTION(rgw_objexp_hints_num_shards, OPT_U32, 127) // maximum number of parts in
 OPTION(rgw_objexp_chunk_size, OPT_U32, 100) // maximum number of entries in a single operation when processing objexp data
 
 OPTION(mutex_perf_counter, OPT_BOOL, false) // enable/disable mutex perf counter
+OPTION(lock_stats_sample, OPT_INT, 0) // time 1 in N Mutex/RWLock acquisitions for dump_lock_stats; 0 = off
 OPTION(throttler_perf_counter, OPT_BOOL, true) // enable/disable throttler perf counter
 
 // This will be set to true when it is safe to start threads.
@@ -9,6 +9,7 @@
 #include "common/sctp_crc32.h"
 #include "common/crc32c_intel_baseline.h"
 #include "common/crc32c_intel_fast.h"
+#include "common/crc32c_intel_multi.h"
 #include "common/crc32c_aarch64.h"
 
 /*
@@ -45,3 +46,31 @@ ceph_crc32c_func_t ceph_choose_crc32(void)
  */
 ceph_crc32c_func_t ceph_crc32c_func = ceph_choose_crc32();
 
+static bool crc32c_multi = ceph_arch_intel_sse42 &&
+  ceph_crc32c_intel_multi_exists();
+
+void ceph_crc32c_multi(unsigned n, uint32_t *crcs,
+		       unsigned char const * const *data,
+		       unsigned const *lengths)
+{
+  unsigned i = 0;
+  if (crc32c_multi) {
+    for (; i + 3 <= n; i += 3) {
+      if (!data[i] || !data[i + 1] || !data[i + 2])
+	break;
+      unsigned len = lengths[i];
+      if (lengths[i + 1] < len)
+	len = lengths[i + 1];
+      if (lengths[i + 2] < len)
+	len = lengths[i + 2];
+      len &= ~7u;
+      unsigned char const *p[3] = { data[i], data[i + 1], data[i + 2] };
+      ceph_crc32c_intel_multi3(crcs + i, p, len);
+      for (unsigned j = 0; j < 3; ++j)
+	crcs[i + j] = ceph_crc32c(crcs[i + j], p[j], lengths[i + j] - len);
+    }
+  }
+  for (; i < n; ++i)
+    crcs[i] = ceph_crc32c(crcs[i], data[i], lengths[i]);
+}
+
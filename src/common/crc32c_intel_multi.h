@@ -0,0 +1,24 @@
+#ifndef CEPH_COMMON_CRC32C_INTEL_MULTI_H
+#define CEPH_COMMON_CRC32C_INTEL_MULTI_H
+
+#include "include/int_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* is the multi-buffer version compiled in */
+extern int ceph_crc32c_intel_multi_exists(void);
+
+/*
+ * advance three crcs over the first len & ~7 bytes of three buffers,
+ * and the data pointers past them; needs sse4.2
+ */
+extern void ceph_crc32c_intel_multi3(uint32_t *crcs, unsigned char const **data,
+				     unsigned len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
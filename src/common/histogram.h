@@ -105,6 +105,38 @@ public:
     return 0;
   }
 
+  /// total number of values in the histogram
+  uint64_t get_count() const {
+    uint64_t total = 0;
+    for (unsigned i=0; i<h.size(); ++i)
+      total += h[i];
+    return total;
+  }
+
+  /// get the value at a position in the histogram (e.g. a percentile).
+  ///
+  /// @param micro [in] position in the range [0..1000000]
+  /// @return upper bound of the bin holding that position, or -1 if
+  /// the histogram is empty
+  int32_t get_value_at_micro(uint64_t micro) const {
+    uint64_t total = get_count();
+    if (total == 0)
+      return -1;
+    uint64_t want = (total * micro + 999999) / 1000000;
+    if (want == 0)
+      want = 1;
+    uint64_t sum = 0;
+    unsigned i = 0;
+    for (; i<h.size(); ++i) {
+      sum += h[i];
+      if (sum >= want)
+	break;
+    }
+    if (i >= 31)
+      return 0x7fffffff;
+    return (1 << i) - 1;
+  }
+
   void add(const pow2_hist_t& o) {
     _expand_to(o.h.size());
     for (unsigned p = 0; p < o.h.size(); ++p)
@@ -104,15 +104,32 @@ string hobject_t::to_str() const
 
 void hobject_t::encode(bufferlist& bl) const
 {
-  ENCODE_START(4, 3, bl);
-  ::encode(key, bl);
-  ::encode(oid, bl);
-  ::encode(snap, bl);
-  ::encode(hash, bl);
-  ::encode(max, bl);
-  ::encode(nspace, bl);
-  ::encode(pool, bl);
-  ENCODE_FINISH(bl);
+  ::encode_bounded(*this, bl);
+}
+
+void hobject_t::bound_encode(size_t& s) const
+{
+  BOUND_ENCODE_START(s);
+  ::bound_encode(key, s);
+  ::bound_encode(oid, s);
+  ::bound_encode(snap, s);
+  ::bound_encode(hash, s);
+  ::bound_encode(max, s);
+  ::bound_encode(nspace, s);
+  ::bound_encode(pool, s);
+}
+
+void hobject_t::encode(bounded_encoder& p) const
+{
+  ENCODE_BOUNDED_START(4, 3, p);
+  ::encode(key, p);
+  ::encode(oid, p);
+  ::encode(snap, p);
+  ::encode(hash, p);
+  ::encode(max, p);
+  ::encode(nspace, p);
+  ::encode(pool, p);
+  ENCODE_BOUNDED_FINISH(p);
 }
 
 void hobject_t::decode(bufferlist::iterator& bl)
@@ -257,6 +257,8 @@ public:
   }
 
   void encode(bufferlist& bl) const;
+  void bound_encode(size_t& s) const;
+  void encode(bounded_encoder& p) const;
   void decode(bufferlist::iterator& bl);
   void decode(json_spirit::Value& v);
   void dump(Formatter *f) const;
@@ -300,7 +302,7 @@ public:
     }
   };
 };
-WRITE_CLASS_ENCODER(hobject_t)
+WRITE_CLASS_ENCODER_BOUNDED(hobject_t)
 
 namespace std {
   template<> struct hash<hobject_t> {
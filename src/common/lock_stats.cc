@@ -0,0 +1,162 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "common/lock_stats.h"
+#include "common/Formatter.h"
+#include "include/unordered_map.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <map>
+
+int g_lock_stats = 0;
+
+// plain pthread mutex: a Mutex here would profile itself
+static pthread_mutex_t lock_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ceph::unordered_map<std::string, lock_stat_t*> lock_stats;
+
+static unsigned bucket(uint64_t ns)
+{
+  uint64_t us = ns / 1000;
+  unsigned b = 0;
+  while (us && b < LOCK_STATS_BUCKETS - 1) {
+    us >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+void lock_stat_t::add_wait(uint64_t ns, bool was_contended)
+{
+  sampled.inc();
+  if (was_contended)
+    contended.inc();
+  wait_ns.add(ns);
+  wait_hist[bucket(ns)].inc();
+}
+
+void lock_stat_t::add_hold(uint64_t ns)
+{
+  held.inc();
+  hold_ns.add(ns);
+  hold_hist[bucket(ns)].inc();
+}
+
+void lock_stat_t::reset()
+{
+  sampled.set(0);
+  contended.set(0);
+  wait_ns.set(0);
+  held.set(0);
+  hold_ns.set(0);
+  for (unsigned i = 0; i < LOCK_STATS_BUCKETS; ++i) {
+    wait_hist[i].set(0);
+    hold_hist[i].set(0);
+  }
+}
+
+static void dump_hist(ceph::Formatter *f, const char *name,
+		      const ceph::atomic64_t *hist)
+{
+  // bucket i counts times in [2^(i-1), 2^i) usec, bucket 0 is < 1 usec
+  f->open_array_section(name);
+  for (unsigned i = 0; i < LOCK_STATS_BUCKETS; ++i) {
+    uint64_t v = hist[i].read();
+    if (!v)
+      continue;
+    f->open_object_section("bucket");
+    f->dump_unsigned("lt_usec",
+		     i == LOCK_STATS_BUCKETS - 1 ? 0 : (1ull << i));
+    f->dump_unsigned("count", v);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void lock_stat_t::dump(ceph::Formatter *f) const
+{
+  uint64_t s = sampled.read(), h = held.read();
+  f->dump_unsigned("sampled", s);
+  f->dump_unsigned("contended", contended.read());
+  f->dump_unsigned("wait_total_ns", wait_ns.read());
+  f->dump_unsigned("wait_avg_ns", s ? wait_ns.read() / s : 0);
+  f->dump_unsigned("held", h);
+  f->dump_unsigned("hold_total_ns", hold_ns.read());
+  f->dump_unsigned("hold_avg_ns", h ? hold_ns.read() / h : 0);
+  dump_hist(f, "wait_histogram", wait_hist);
+  dump_hist(f, "hold_histogram", hold_hist);
+}
+
+lock_stat_t *lock_stats_get(const std::string &name)
+{
+  pthread_mutex_lock(&lock_stats_mutex);
+  lock_stat_t *&s = lock_stats[name];
+  if (!s)
+    s = new lock_stat_t(name);
+  lock_stat_t *ret = s;
+  pthread_mutex_unlock(&lock_stats_mutex);
+  return ret;
+}
+
+bool lock_stats_sample()
+{
+  static __thread int countdown = 0;
+  if (--countdown > 0)
+    return false;
+  countdown = g_lock_stats;
+  return countdown > 0;
+}
+
+uint64_t lock_stats_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void lock_stats_dump(ceph::Formatter *f)
+{
+  // sort by name and skip locks that were never sampled
+  std::map<std::string, lock_stat_t*> sorted;
+  pthread_mutex_lock(&lock_stats_mutex);
+  for (ceph::unordered_map<std::string, lock_stat_t*>::iterator p =
+	 lock_stats.begin();
+       p != lock_stats.end();
+       ++p) {
+    if (p->second->sampled.read())
+      sorted[p->first] = p->second;
+  }
+  pthread_mutex_unlock(&lock_stats_mutex);
+
+  f->dump_int("sample_every", g_lock_stats);
+  f->open_array_section("locks");
+  for (std::map<std::string, lock_stat_t*>::iterator p = sorted.begin();
+       p != sorted.end();
+       ++p) {
+    f->open_object_section("lock");
+    f->dump_string("name", p->first);
+    p->second->dump(f);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void lock_stats_reset()
+{
+  pthread_mutex_lock(&lock_stats_mutex);
+  for (ceph::unordered_map<std::string, lock_stat_t*>::iterator p =
+	 lock_stats.begin();
+       p != lock_stats.end();
+       ++p)
+    p->second->reset();
+  pthread_mutex_unlock(&lock_stats_mutex);
+}
@@ -0,0 +1,63 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_LOCK_STATS_H
+#define CEPH_LOCK_STATS_H
+
+#include <string>
+#include "include/atomic.h"
+
+namespace ceph {
+  class Formatter;
+}
+
+/**
+ * Sampling lock contention profiler for Mutex and RWLock.
+ *
+ * When g_lock_stats is N > 0, one in N lock acquisitions (per thread)
+ * is timed: whether it had to wait, how long, and (for Mutex and RWLock
+ * write locks) how long the lock was then held.  Samples are aggregated
+ * per lock name, so all PG::_lock instances share one entry.  Set via
+ * the lock_stats_sample option, dumped with 'dump_lock_stats'.
+ */
+extern int g_lock_stats;
+
+#define LOCK_STATS_BUCKETS 24  ///< log2(usec) buckets; the last is open ended
+
+struct lock_stat_t {
+  std::string name;
+  ceph::atomic64_t sampled;     ///< timed acquisitions
+  ceph::atomic64_t contended;   ///< timed acquisitions that had to wait
+  ceph::atomic64_t wait_ns;     ///< total wait time of timed acquisitions
+  ceph::atomic64_t held;        ///< timed hold periods
+  ceph::atomic64_t hold_ns;     ///< total hold time of timed hold periods
+  ceph::atomic64_t wait_hist[LOCK_STATS_BUCKETS];
+  ceph::atomic64_t hold_hist[LOCK_STATS_BUCKETS];
+
+  explicit lock_stat_t(const std::string &n) : name(n) {}
+
+  void add_wait(uint64_t ns, bool was_contended);
+  void add_hold(uint64_t ns);
+  void reset();
+  void dump(ceph::Formatter *f) const;
+};
+
+/// get the shared entry for a lock name; entries are never freed
+extern lock_stat_t *lock_stats_get(const std::string &name);
+/// true if the calling thread should time this acquisition
+extern bool lock_stats_sample();
+/// monotonic clock in nanoseconds
+extern uint64_t lock_stats_now();
+extern void lock_stats_dump(ceph::Formatter *f);
+extern void lock_stats_reset();
+
+#endif
@@ -0,0 +1,134 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+
+#include "include/mempool.h"
+#include "include/buffer.h"
+#include "include/str_map.h"
+#include "common/Formatter.h"
+#include "common/strtol.h"
+
+static mempool::pool_t pools[mempool::num_pools];
+
+static const char *pool_names[mempool::num_pools] = {
+#define P(x) #x,
+  DEFINE_MEMORY_POOLS_HELPER(P)
+#undef P
+};
+
+int mempool::get_thread_shard()
+{
+  static ceph::atomic_t next_thread;
+  static __thread int thread_index = -1;
+  if (thread_index < 0)
+    thread_index = (next_thread.inc() & 0x7fffffff) % num_shards;
+  return thread_index;
+}
+
+mempool::pool_t& mempool::get_pool(pool_index_t ix)
+{
+  return pools[ix];
+}
+
+const char *mempool::get_pool_name(pool_index_t ix)
+{
+  return pool_names[ix];
+}
+
+mempool::pool_index_t mempool::get_pool_index(const std::string &name)
+{
+  for (int i = 0; i < num_pools; ++i)
+    if (name == pool_names[i])
+      return (pool_index_t)i;
+  return num_pools;
+}
+
+int64_t mempool::pool_t::allocated_bytes() const
+{
+  int64_t total = 0;
+  for (int i = 0; i < num_shards; ++i)
+    total += (int64_t)shard[i].bytes.read();
+  return total;
+}
+
+int64_t mempool::pool_t::allocated_items() const
+{
+  int64_t total = 0;
+  for (int i = 0; i < num_shards; ++i)
+    total += (int64_t)shard[i].items.read();
+  return total;
+}
+
+int mempool::set_budgets(const std::string &s, std::string *err)
+{
+  std::map<std::string, std::string> m;
+  int r = get_str_map(s, ",; \t", &m);
+  if (r < 0) {
+    *err = "cannot parse '" + s + "'";
+    return r;
+  }
+  uint64_t budgets[num_pools] = { 0 };
+  for (std::map<std::string, std::string>::iterator p = m.begin();
+       p != m.end();
+       ++p) {
+    pool_index_t ix = get_pool_index(p->first);
+    if (ix == num_pools) {
+      *err = "unknown pool '" + p->first + "'";
+      return -EINVAL;
+    }
+    std::string e;
+    budgets[ix] = strict_sistrtoll(p->second.c_str(), &e);
+    if (!e.empty()) {
+      *err = p->first + ": " + e;
+      return -EINVAL;
+    }
+  }
+  // pools left out lose their budget
+  for (int i = 0; i < num_pools; ++i)
+    pools[i].set_budget(budgets[i]);
+  return 0;
+}
+
+void mempool::dump(ceph::Formatter *f)
+{
+  int64_t total_bytes = 0, total_items = 0;
+  f->open_object_section("mempools");
+  for (int i = 0; i < num_pools; ++i) {
+    int64_t bytes = pools[i].allocated_bytes();
+    int64_t items = pools[i].allocated_items();
+    f->open_object_section(pool_names[i]);
+    f->dump_int("bytes", bytes);
+    f->dump_int("items", items);
+    f->dump_unsigned("budget", pools[i].get_budget());
+    f->dump_bool("over_budget", pools[i].over_budget());
+    f->close_section();
+    total_bytes += bytes;
+    total_items += items;
+  }
+  for (int i = 0; i < ceph::buffer::POOL_MAX; ++i) {
+    std::string name = std::string("buffer_") + ceph::buffer::get_pool_name(i);
+    int64_t bytes = ceph::buffer::get_pool_bytes(i);
+    int64_t items = ceph::buffer::get_pool_items(i);
+    f->open_object_section(name.c_str());
+    f->dump_int("bytes", bytes);
+    f->dump_int("items", items);
+    f->close_section();
+    total_bytes += bytes;
+    total_items += items;
+  }
+  f->open_object_section("total");
+  f->dump_int("bytes", total_bytes);
+  f->dump_int("items", total_items);
+  f->close_section();
+  f->close_section();
+}
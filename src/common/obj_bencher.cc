@@ -27,6 +27,7 @@
 #include <time.h>
 #include <sstream>
 #include <vector>
+#include <algorithm>
 
 
 const std::string BENCH_LASTRUN_METADATA = "benchmark_last_metadata";
@@ -236,6 +237,7 @@ int ObjBencher::aio_bench(
   data.min_latency = 9999.0; // this better be higher than initial latency!
   data.max_latency = 0;
   data.avg_latency = 0;
+  data.history.latency.clear();
   data.object_contents = contentsChars;
   lock.Unlock();
 
@@ -244,6 +246,13 @@ int ObjBencher::aio_bench(
 
   if (formatter)
     formatter->open_object_section("bench");
+  if (op_rate > 0) {
+    if (!formatter)
+      out(cout) << "Starting " << op_rate << " ops/sec, latency is counted "
+                << "from when each op was due" << std::endl;
+    else
+      formatter->dump_format("op_rate", "%f", op_rate);
+  }
 
   if (OP_WRITE == operation) {
     r = write_bench(secondsToRun, concurrentios, run_name_meta);
@@ -322,6 +331,57 @@ static T vec_stddev(vector<T>& v)
   return sqrt(stddev);
 }
 
+utime_t ObjBencher::next_op_start()
+{
+  utime_t now = ceph_clock_now(cct);
+  if (op_rate <= 0)
+    return now;
+
+  // In open loop ops are due at fixed intervals whatever the previous
+  // ones did.  An op that has to wait for a free slot still counts
+  // from when it was due, so a stall shows up in the latencies of
+  // everything it held back, not just in that of one op.
+  utime_t due = data.start_time;
+  due += (double)data.started / op_rate;
+  if (due > now)
+    (due - now).sleep();
+  return due;
+}
+
+static double sorted_percentile(const vector<double>& v, double p)
+{
+  if (v.empty())
+    return 0;
+  size_t i = (size_t)(p / 100 * v.size());
+  if (i >= v.size())
+    i = v.size() - 1;
+  return v[i];
+}
+
+void ObjBencher::report_latency_percentiles()
+{
+  static const double percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+  vector<double> sorted(data.history.latency);
+  std::sort(sorted.begin(), sorted.end());
+
+  if (formatter)
+    formatter->open_object_section("latency_percentiles");
+  for (unsigned i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+    double lat = sorted_percentile(sorted, percentiles[i]);
+    std::ostringstream name;
+    name << "p" << percentiles[i];
+    if (!formatter) {
+      std::string label = name.str() + " latency:";
+      out(cout) << std::left << setw(24) << label << std::right << lat
+                << std::endl;
+    } else {
+      formatter->dump_format(name.str().c_str(), "%f", lat);
+    }
+  }
+  if (formatter)
+    formatter->close_section();
+}
+
 int ObjBencher::fetch_bench_metadata(const std::string& metadata_file, size_t* object_size, int* num_objects, int* prevPid) {
   int r = 0;
   bufferlist object_data;
@@ -395,7 +455,7 @@ int ObjBencher::write_bench(int secondsToRun,
   data.start_time = ceph_clock_now(cct);
   lock.Unlock();
   for (int i = 0; i<concurrentios; ++i) {
-    start_times[i] = ceph_clock_now(cct);
+    start_times[i] = next_op_start();
     r = create_completion(i, _aio_cb, (void *)&lc);
     if (r < 0)
       goto ERR;
@@ -464,7 +524,7 @@ int ObjBencher::write_bench(int secondsToRun,
     timePassed = ceph_clock_now(cct) - data.start_time;
 
     //write new stuff to backend
-    start_times[slot] = ceph_clock_now(cct);
+    start_times[slot] = next_op_start();
     r = create_completion(slot, _aio_cb, &lc);
     if (r < 0)
       goto ERR;
@@ -546,6 +606,7 @@ int ObjBencher::write_bench(int secondsToRun,
     formatter->dump_format("max_latency:", "%f", data.max_latency);
     formatter->dump_format("min_latency", "%f", data.min_latency);
   }
+  report_latency_percentiles();
   //write object size/number data for read benchmarks
   ::encode(data.object_size, b_write);
   ::encode(data.finished, b_write);
@@ -615,7 +676,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
   //start initial reads
   for (int i = 0; i < concurrentios; ++i) {
     index[i] = i;
-    start_times[i] = ceph_clock_now(cct);
+    start_times[i] = next_op_start();
     create_completion(i, _aio_cb, (void *)&lc);
     r = aio_read(name[i], i, contents[i], data.object_size);
     if (r < 0) { //naughty, doesn't clean up heap -- oh, or handle the print thread!
@@ -657,6 +718,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
 
     // calculate latency here, so memcmp doesn't inflate it
     data.cur_latency = ceph_clock_now(cct) - start_times[slot];
+    data.history.latency.push_back(data.cur_latency);
 
     cur_contents = contents[slot];
     int current_index = index[slot];
@@ -694,7 +756,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
     release_completion(slot);
 
     //start new read and check data if requested
-    start_times[slot] = ceph_clock_now(cct);
+    start_times[slot] = next_op_start();
     create_completion(slot, _aio_cb, (void *)&lc);
     r = aio_read(newName, slot, contents[slot], data.object_size);
     if (r < 0) {
@@ -719,6 +781,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
       goto ERR;
     }
     data.cur_latency = ceph_clock_now(cct) - start_times[slot];
+    data.history.latency.push_back(data.cur_latency);
     total_latency += data.cur_latency;
     if (data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
@@ -776,6 +839,7 @@ int ObjBencher::seq_read_bench(int seconds_to_run, int num_objects, int concurre
     formatter->dump_format("max_latency", "%f", data.max_latency);
     formatter->dump_format("min_latency", "%f", data.min_latency);
   }
+  report_latency_percentiles();
 
   completions_done();
 
@@ -835,7 +899,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
   //start initial reads
   for (int i = 0; i < concurrentios; ++i) {
     index[i] = i;
-    start_times[i] = ceph_clock_now(g_ceph_context);
+    start_times[i] = next_op_start();
     create_completion(i, _aio_cb, (void *)&lc);
     r = aio_read(name[i], i, contents[i], data.object_size);
     if (r < 0) { //naughty, doesn't clean up heap -- oh, or handle the print thread!
@@ -877,6 +941,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
 
     // calculate latency here, so memcmp doesn't inflate it
     data.cur_latency = ceph_clock_now(cct) - start_times[slot];
+    data.history.latency.push_back(data.cur_latency);
 
     lock.Unlock();
 
@@ -917,7 +982,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
     cur_contents->invalidate_crc();
 
     //start new read and check data if requested
-    start_times[slot] = ceph_clock_now(g_ceph_context);
+    start_times[slot] = next_op_start();
     create_completion(slot, _aio_cb, (void *)&lc);
     r = aio_read(newName, slot, contents[slot], data.object_size);
     if (r < 0) {
@@ -943,6 +1008,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
       goto ERR;
     }
     data.cur_latency = ceph_clock_now(g_ceph_context) - start_times[slot];
+    data.history.latency.push_back(data.cur_latency);
     total_latency += data.cur_latency;
     if (data.cur_latency > data.max_latency) data.max_latency = data.cur_latency;
     if (data.cur_latency < data.min_latency) data.min_latency = data.cur_latency;
@@ -1000,6 +1066,7 @@ int ObjBencher::rand_read_bench(int seconds_to_run, int num_objects, int concurr
     formatter->dump_format("max_latency", "%f", data.max_latency);
     formatter->dump_format("min_latency", "%f", data.min_latency);
   }
+  report_latency_percentiles();
   completions_done();
 
   return 0;
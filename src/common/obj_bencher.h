@@ -60,6 +60,8 @@ typedef std::pair<std::string, std::string> Object;
 
 class ObjBencher {
   bool show_time;
+  /// ops to start per second; 0 starts one whenever a slot is free
+  double op_rate = 0;
   Formatter *formatter = NULL;
   ostream *outstream = NULL;
 public:
@@ -100,6 +102,10 @@ protected:
   virtual bool get_objects(std::list< std::pair<std::string, std::string> >* objects, int num) = 0;
   virtual void set_namespace(const std::string&) {}
 
+  /// when the next op starts, waiting for it if it is paced
+  utime_t next_op_start();
+  void report_latency_percentiles();
+
   ostream& out(ostream& os);
   ostream& out(ostream& os, utime_t& t);
 public:
@@ -113,6 +119,9 @@ public:
   void set_show_time(bool dt) {
     show_time = dt;
   }
+  void set_op_rate(double rate) {
+    op_rate = rate;
+  }
   void set_formatter(Formatter *f) {
     formatter = f;
   }
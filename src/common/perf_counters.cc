@@ -20,7 +20,9 @@
 #include "common/Formatter.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <map>
+#include <new>
 #include <sstream>
 #include <stdint.h>
 #include <string.h>
@@ -30,7 +32,9 @@ using std::ostringstream;
 
 PerfCountersCollection::PerfCountersCollection(CephContext *cct)
   : m_cct(cct),
-    m_lock("PerfCountersCollection")
+    m_lock("PerfCountersCollection"),
+    m_changed_lock("PerfCountersCollection::m_changed_lock"),
+    m_changed_seq(0)
 {
 }
 
@@ -118,23 +122,217 @@ void PerfCountersCollection::dump_formatted(
     const std::string &logger,
     const std::string &counter)
 {
-  Mutex::Locker lck(m_lock);
+  if (schema) {
+    Mutex::Locker lck(m_lock);
+    f->open_object_section("perfcounter_collection");
+    for (perf_counters_set_t::iterator l = m_loggers.begin();
+	 l != m_loggers.end(); ++l) {
+      // Optionally filter on logger name, pass through counter filter
+      if (logger.empty() || (*l)->get_name() == logger) {
+	(*l)->dump_formatted(f, schema, counter);
+      }
+    }
+    f->close_section();
+    return;
+  }
+
+  // copy under the lock, format after it
+  std::vector<perf_counters_snapshot_t> snaps;
+  snapshot(&snaps, logger, counter);
   f->open_object_section("perfcounter_collection");
-  
-  for (perf_counters_set_t::iterator l = m_loggers.begin();
+  for (std::vector<perf_counters_snapshot_t>::iterator p = snaps.begin();
+       p != snaps.end();
+       ++p)
+    p->dump(f);
+  f->close_section();
+}
+
+void PerfCountersCollection::snapshot(
+    std::vector<perf_counters_snapshot_t> *snaps,
+    const std::string &logger,
+    const std::string &counter) const
+{
+  Mutex::Locker lck(m_lock);
+  snaps->reserve(logger.empty() ? m_loggers.size() : 1);
+  for (perf_counters_set_t::const_iterator l = m_loggers.begin();
        l != m_loggers.end(); ++l) {
-    // Optionally filter on logger name, pass through counter filter
     if (logger.empty() || (*l)->get_name() == logger) {
-      (*l)->dump_formatted(f, schema, counter);
+      snaps->push_back(perf_counters_snapshot_t());
+      (*l)->snapshot(&snaps->back(), counter);
+    }
+  }
+}
+
+void PerfCountersCollection::dump_changed(Formatter *f, const std::string &id)
+{
+  std::vector<perf_counters_snapshot_t> cur, last;
+  snapshot(&cur);
+  {
+    Mutex::Locker l(m_changed_lock);
+    std::map<std::string, changed_state_t>::iterator p = m_changed.find(id);
+    if (p != m_changed.end())
+      last.swap(p->second.last);
+  }
+
+  std::map<std::string, const perf_counters_snapshot_t*> prev;
+  for (std::vector<perf_counters_snapshot_t>::iterator p = last.begin();
+       p != last.end();
+       ++p)
+    prev[p->name] = &*p;
+
+  f->open_object_section("perfcounter_collection");
+  for (std::vector<perf_counters_snapshot_t>::iterator p = cur.begin();
+       p != cur.end();
+       ++p) {
+    std::map<std::string, const perf_counters_snapshot_t*>::iterator q =
+      prev.find(p->name);
+    if (q == prev.end() || q->second->values.size() != p->values.size()) {
+      p->dump(f);
+      continue;
+    }
+    bool opened = false;
+    for (unsigned i = 0; i < p->values.size(); ++i) {
+      if (p->values[i] == q->second->values[i])
+	continue;
+      if (!opened) {
+	f->open_object_section(p->name.c_str());
+	opened = true;
+      }
+      p->values[i].dump(f);
     }
+    if (opened)
+      f->close_section();
   }
   f->close_section();
+
+  Mutex::Locker l(m_changed_lock);
+  changed_state_t &state = m_changed[id];
+  state.last.swap(cur);
+  state.used = ++m_changed_seq;
+  if (m_changed.size() > MAX_CHANGED_IDS) {
+    // forget the poller we heard from longest ago
+    std::map<std::string, changed_state_t>::iterator oldest = m_changed.begin();
+    for (std::map<std::string, changed_state_t>::iterator p = m_changed.begin();
+	 p != m_changed.end();
+	 ++p)
+      if (p->second.used < oldest->second.used)
+	oldest = p;
+    m_changed.erase(oldest);
+  }
 }
 
 // ---------------------------
 
 PerfCounters::~PerfCounters()
 {
+  for (std::vector<atomic64_t*>::iterator p = m_shards.begin();
+       p != m_shards.end();
+       ++p) {
+    for (unsigned i = 0; i < m_shard_len; ++i)
+      (*p)[i].~atomic64_t();
+    free(*p);
+  }
+}
+
+static unsigned perf_hist_bucket(uint64_t ns)
+{
+  uint64_t us = ns / 1000;
+  unsigned b = 0;
+  while (us && b < PERFCOUNTER_HIST_BUCKETS - 1) {
+    us >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+atomic64_t *PerfCounters::get_shard(const perf_counter_data_any_d &data) const
+{
+  // threads are spread over the shards round robin, in the order they
+  // first touch any sharded counter
+  static atomic_t next_thread;
+  static __thread int thread_index = -1;
+  if (thread_index < 0)
+    thread_index = next_thread.inc() & 0x7fffffff;
+  return m_shards[thread_index % m_shards.size()] + data.shard_off;
+}
+
+uint64_t PerfCounters::read_u64(const perf_counter_data_any_d &data) const
+{
+  if (data.shard_off < 0)
+    return data.u64.read();
+  uint64_t v = 0;
+  for (unsigned i = 0; i < m_shards.size(); ++i)
+    v += m_shards[i][data.shard_off].read();
+  return v;
+}
+
+pair<uint64_t,uint64_t> PerfCounters::read_avg(
+  const perf_counter_data_any_d &data) const
+{
+  if (data.shard_off < 0)
+    return data.read_avg();
+  uint64_t sum = 0, count = 0;
+  for (unsigned i = 0; i < m_shards.size(); ++i) {
+    const atomic64_t *a = m_shards[i] + data.shard_off;
+    uint64_t s, c;
+    do {
+      c = a[1].read();
+      s = a[0].read();
+    } while (a[2].read() != c);
+    sum += s;
+    count += c;
+  }
+  return make_pair(sum, count);
+}
+
+void PerfCounters::read_hist(const perf_counter_data_any_d &data,
+			     uint64_t *hist) const
+{
+  assert(data.type & PERFCOUNTER_HISTOGRAM);
+  assert(data.shard_off >= 0);
+  for (unsigned b = 0; b < PERFCOUNTER_HIST_BUCKETS; ++b)
+    hist[b] = 0;
+  for (unsigned i = 0; i < m_shards.size(); ++i) {
+    const atomic64_t *a = m_shards[i] + data.shard_off + 3;
+    for (unsigned b = 0; b < PERFCOUNTER_HIST_BUCKETS; ++b)
+      hist[b] += a[b].read();
+  }
+}
+
+void PerfCounters::init_shards(unsigned num_shards)
+{
+  if (num_shards < 1)
+    num_shards = 1;
+  unsigned len = 0;
+  for (perf_counter_data_vec_t::iterator d = m_data.begin();
+       d != m_data.end();
+       ++d) {
+    bool shard =
+      (d->type & PERFCOUNTER_HISTOGRAM) ||
+      (num_shards > 1 &&
+       (d->type & (PERFCOUNTER_COUNTER | PERFCOUNTER_LONGRUNAVG)));
+    if (!shard)
+      continue;
+    d->shard_off = len;
+    len += 3;
+    if (d->type & PERFCOUNTER_HISTOGRAM)
+      len += PERFCOUNTER_HIST_BUCKETS;
+  }
+  if (!len)
+    return;
+
+  // pad each shard to whole cache lines so shards never share one
+  const unsigned per_line = MAX(1, 64 / sizeof(atomic64_t));
+  m_shard_len = (len + per_line - 1) / per_line * per_line;
+  for (unsigned i = 0; i < num_shards; ++i) {
+    void *p;
+    int r = ::posix_memalign(&p, 64, m_shard_len * sizeof(atomic64_t));
+    assert(r == 0);
+    atomic64_t *a = (atomic64_t *)p;
+    for (unsigned j = 0; j < m_shard_len; ++j)
+      new (&a[j]) atomic64_t(0);
+    m_shards.push_back(a);
+  }
 }
 
 void PerfCounters::inc(int idx, uint64_t amt)
@@ -147,6 +345,17 @@ void PerfCounters::inc(int idx, uint64_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return;
+  if (data.shard_off >= 0) {
+    atomic64_t *a = get_shard(data);
+    if (data.type & PERFCOUNTER_LONGRUNAVG) {
+      a[1].inc();
+      a[0].add(amt);
+      a[2].inc();
+    } else {
+      a[0].add(amt);
+    }
+    return;
+  }
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
     data.avgcount.inc();
     data.u64.add(amt);
@@ -167,6 +376,10 @@ void PerfCounters::dec(int idx, uint64_t amt)
   assert(!(data.type & PERFCOUNTER_LONGRUNAVG));
   if (!(data.type & PERFCOUNTER_U64))
     return;
+  if (data.shard_off >= 0) {
+    get_shard(data)->sub(amt);
+    return;
+  }
   data.u64.sub(amt);
 }
 
@@ -180,6 +393,23 @@ void PerfCounters::set(int idx, uint64_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return;
+  if (data.shard_off >= 0) {
+    // the whole value moves into this thread's shard
+    atomic64_t *mine = get_shard(data);
+    for (unsigned i = 0; i < m_shards.size(); ++i) {
+      atomic64_t *a = m_shards[i] + data.shard_off;
+      if (a != mine)
+	a[0].set(0);
+    }
+    if (data.type & PERFCOUNTER_LONGRUNAVG) {
+      mine[1].inc();
+      mine[0].set(amt);
+      mine[2].inc();
+    } else {
+      mine[0].set(amt);
+    }
+    return;
+  }
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
     data.avgcount.inc();
     data.u64.set(amt);
@@ -199,7 +429,7 @@ uint64_t PerfCounters::get(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return 0;
-  return data.u64.read();
+  return read_u64(data);
 }
 
 void PerfCounters::tinc(int idx, utime_t amt)
@@ -212,6 +442,20 @@ void PerfCounters::tinc(int idx, utime_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return;
+  if (data.shard_off >= 0) {
+    atomic64_t *a = get_shard(data);
+    uint64_t ns = amt.to_nsec();
+    if (data.type & PERFCOUNTER_LONGRUNAVG) {
+      a[1].inc();
+      a[0].add(ns);
+      a[2].inc();
+    } else {
+      a[0].add(ns);
+    }
+    if (data.type & PERFCOUNTER_HISTOGRAM)
+      a[3 + perf_hist_bucket(ns)].inc();
+    return;
+  }
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
     data.avgcount.inc();
     data.u64.add(amt.to_nsec());
@@ -231,9 +475,19 @@ void PerfCounters::tset(int idx, utime_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return;
-  data.u64.set(amt.to_nsec());
   if (data.type & PERFCOUNTER_LONGRUNAVG)
     assert(0);
+  if (data.shard_off >= 0) {
+    atomic64_t *mine = get_shard(data);
+    for (unsigned i = 0; i < m_shards.size(); ++i) {
+      atomic64_t *a = m_shards[i] + data.shard_off;
+      if (a != mine)
+	a[0].set(0);
+    }
+    mine[0].set(amt.to_nsec());
+    return;
+  }
+  data.u64.set(amt.to_nsec());
 }
 
 utime_t PerfCounters::tget(int idx) const
@@ -246,7 +500,7 @@ utime_t PerfCounters::tget(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return utime_t();
-  uint64_t v = data.u64.read();
+  uint64_t v = read_u64(data);
   return utime_t(v / 1000000000ull, v % 1000000000ull);
 }
 
@@ -262,7 +516,7 @@ pair<uint64_t, uint64_t> PerfCounters::get_tavg_ms(int idx) const
     return make_pair(0, 0);
   if (!(data.type & PERFCOUNTER_LONGRUNAVG))
     return make_pair(0, 0);
-  pair<uint64_t,uint64_t> a = data.read_avg();
+  pair<uint64_t,uint64_t> a = read_avg(data);
   return make_pair(a.second, a.first / 1000000ull);
 }
 
@@ -273,6 +527,14 @@ void PerfCounters::reset()
 
   while (d != d_end) {
     d->reset();
+    if (d->shard_off >= 0 && d->type != PERFCOUNTER_U64) {
+      unsigned n = 3;
+      if (d->type & PERFCOUNTER_HISTOGRAM)
+	n += PERFCOUNTER_HIST_BUCKETS;
+      for (unsigned i = 0; i < m_shards.size(); ++i)
+	for (unsigned j = 0; j < n; ++j)
+	  m_shards[i][d->shard_off + j].set(0);
+    }
     ++d;
   }
 }
@@ -280,8 +542,14 @@ void PerfCounters::reset()
 void PerfCounters::dump_formatted(Formatter *f, bool schema,
     const std::string &counter)
 {
+  if (!schema) {
+    perf_counters_snapshot_t s;
+    snapshot(&s, counter);
+    s.dump(f);
+    return;
+  }
+
   f->open_object_section(m_name.c_str());
-  
   for (perf_counter_data_vec_t::const_iterator d = m_data.begin();
        d != m_data.end(); ++d) {
     if (!counter.empty() && counter != d->name) {
@@ -289,52 +557,96 @@ void PerfCounters::dump_formatted(Formatter *f, bool schema,
       continue;
     }
 
-    if (schema) {
-      f->open_object_section(d->name);
-      f->dump_int("type", d->type);
+    f->open_object_section(d->name);
+    f->dump_int("type", d->type);
 
-      if (d->description) {
-        f->dump_string("description", d->description);
-      } else {
-        f->dump_string("description", "");
-      }
+    if (d->description) {
+      f->dump_string("description", d->description);
+    } else {
+      f->dump_string("description", "");
+    }
+
+    if (d->nick != NULL) {
+      f->dump_string("nick", d->nick);
+    } else {
+      f->dump_string("nick", "");
+    }
+    f->close_section();
+  }
+  f->close_section();
+}
 
-      if (d->nick != NULL) {
-        f->dump_string("nick", d->nick);
-      } else {
-        f->dump_string("nick", "");
+void PerfCounters::snapshot(perf_counters_snapshot_t *s,
+			    const std::string &counter) const
+{
+  s->name = m_name;
+  s->values.clear();
+  s->values.reserve(counter.empty() ? m_data.size() : 1);
+  for (perf_counter_data_vec_t::const_iterator d = m_data.begin();
+       d != m_data.end(); ++d) {
+    if (!d->name || (!counter.empty() && counter != d->name))
+      continue;
+    s->values.push_back(perf_counters_snapshot_t::value_t());
+    perf_counters_snapshot_t::value_t &v = s->values.back();
+    v.name = d->name;
+    v.type = d->type;
+    if (d->type & PERFCOUNTER_LONGRUNAVG) {
+      pair<uint64_t,uint64_t> a = read_avg(*d);
+      v.u64 = a.first;
+      v.avgcount = a.second;
+      if (d->type & PERFCOUNTER_HISTOGRAM) {
+	v.hist.resize(PERFCOUNTER_HIST_BUCKETS);
+	read_hist(*d, &v.hist[0]);
       }
+    } else {
+      v.u64 = read_u64(*d);
+    }
+  }
+}
+
+void perf_counters_snapshot_t::value_t::dump(Formatter *f) const
+{
+  if (type & PERFCOUNTER_LONGRUNAVG) {
+    f->open_object_section(name.c_str());
+    if (type & PERFCOUNTER_U64) {
+      f->dump_unsigned("avgcount", avgcount);
+      f->dump_unsigned("sum", u64);
+    } else if (type & PERFCOUNTER_TIME) {
+      f->dump_unsigned("avgcount", avgcount);
+      f->dump_format_unquoted("sum", "%" PRId64 ".%09" PRId64,
+			      u64 / 1000000000ull,
+			      u64 % 1000000000ull);
+    } else {
+      assert(0);
+    }
+    if (type & PERFCOUNTER_HISTOGRAM) {
+      // bucket i counts times in [2^(i-1), 2^i) usec
+      f->open_array_section("histogram");
+      for (unsigned i = 0; i < hist.size(); ++i)
+	f->dump_unsigned("count", hist[i]);
       f->close_section();
+    }
+    f->close_section();
+  } else {
+    if (type & PERFCOUNTER_U64) {
+      f->dump_unsigned(name.c_str(), u64);
+    } else if (type & PERFCOUNTER_TIME) {
+      f->dump_format_unquoted(name.c_str(), "%" PRId64 ".%09" PRId64,
+			      u64 / 1000000000ull,
+			      u64 % 1000000000ull);
     } else {
-      if (d->type & PERFCOUNTER_LONGRUNAVG) {
-	f->open_object_section(d->name);
-	pair<uint64_t,uint64_t> a = d->read_avg();
-	if (d->type & PERFCOUNTER_U64) {
-	  f->dump_unsigned("avgcount", a.second);
-	  f->dump_unsigned("sum", a.first);
-	} else if (d->type & PERFCOUNTER_TIME) {
-	  f->dump_unsigned("avgcount", a.second);
-	  f->dump_format_unquoted("sum", "%" PRId64 ".%09" PRId64,
-				  a.first / 1000000000ull,
-				  a.first % 1000000000ull);
-	} else {
-	  assert(0);
-	}
-	f->close_section();
-      } else {
-	uint64_t v = d->u64.read();
-	if (d->type & PERFCOUNTER_U64) {
-	  f->dump_unsigned(d->name, v);
-	} else if (d->type & PERFCOUNTER_TIME) {
-	  f->dump_format_unquoted(d->name, "%" PRId64 ".%09" PRId64,
-				  v / 1000000000ull,
-				  v % 1000000000ull);
-	} else {
-	  assert(0);
-	}
-      }
+      assert(0);
     }
   }
+}
+
+void perf_counters_snapshot_t::dump(Formatter *f) const
+{
+  f->open_object_section(name.c_str());
+  for (std::vector<value_t>::const_iterator p = values.begin();
+       p != values.end();
+       ++p)
+    p->dump(f);
   f->close_section();
 }
 
@@ -350,7 +662,8 @@ PerfCounters::PerfCounters(CephContext *cct, const std::string &name,
     m_upper_bound(upper_bound),
     m_name(name.c_str()),
     m_lock_name(std::string("PerfCounters::") + name.c_str()),
-    m_lock(m_lock_name.c_str())
+    m_lock(m_lock_name.c_str()),
+    m_shard_len(0)
 {
   m_data.resize(upper_bound - lower_bound - 1);
 }
@@ -398,6 +711,13 @@ void PerfCountersBuilder::add_time_avg(int idx, const char *name,
   add_impl(idx, name, description, nick, PERFCOUNTER_TIME | PERFCOUNTER_LONGRUNAVG);
 }
 
+void PerfCountersBuilder::add_time_hist(int idx, const char *name,
+    const char *description, const char *nick)
+{
+  add_impl(idx, name, description, nick,
+	   PERFCOUNTER_TIME | PERFCOUNTER_LONGRUNAVG | PERFCOUNTER_HISTOGRAM);
+}
+
 void PerfCountersBuilder::add_impl(int idx, const char *name,
     const char *description, const char *nick, int ty)
 {
@@ -423,6 +743,7 @@ PerfCounters *PerfCountersBuilder::create_perf_counters()
     }
   }
   PerfCounters *ret = m_perf_counters;
+  ret->init_shards(ret->m_cct->_conf->perf_counter_shards);
   m_perf_counters = NULL;
   return ret;
 }
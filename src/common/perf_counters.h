@@ -22,6 +22,7 @@
 #include "include/utime.h"
 
 #include <stdint.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,43 @@ enum perfcounter_type_d
   PERFCOUNTER_U64 = 0x2,
   PERFCOUNTER_LONGRUNAVG = 0x4,
   PERFCOUNTER_COUNTER = 0x8,
+  PERFCOUNTER_HISTOGRAM = 0x10,
+};
+
+/// log2(usec) buckets of a PERFCOUNTER_HISTOGRAM; the last is open ended
+#define PERFCOUNTER_HIST_BUCKETS 24
+
+/**
+ * The values of one PerfCounters at a point in time
+ *
+ * Taking one only reads the counters, so it is quick and never holds up
+ * the threads updating them; formatting it, which is what takes time,
+ * needs no locks at all.
+ */
+struct perf_counters_snapshot_t {
+  struct value_t {
+    std::string name;
+    int type;
+    uint64_t u64;       ///< the value, or the sum of an average
+    uint64_t avgcount;
+    std::vector<uint64_t> hist;
+
+    value_t() : type(0), u64(0), avgcount(0) {}
+    bool operator==(const value_t &o) const {
+      return u64 == o.u64 && avgcount == o.avgcount && hist == o.hist &&
+	type == o.type && name == o.name;
+    }
+    bool operator!=(const value_t &o) const {
+      return !(*this == o);
+    }
+    void dump(ceph::Formatter *f) const;
+  };
+
+  std::string name;
+  std::vector<value_t> values;
+
+  /// as in perf dump: an object named name with a field per value
+  void dump(ceph::Formatter *f) const;
 };
 
 /*
@@ -61,6 +99,13 @@ enum perfcounter_type_d
  * For the time average, it returns the current value and
  * the "avgcount" member when read off. avgcount is incremented when you call
  * tinc. Calling tset on an average is an error and will assert out.
+ * A time histogram is a time average that also counts each tinc() in a
+ * log2(usec) bucket.
+ *
+ * With perf_counter_shards > 1, counters and averages are split into that
+ * many shards, each thread updating its own, and summed when read.  This
+ * keeps threads from bouncing the cache line of a hot counter between
+ * them.  Plain values (set/dec) are never sharded.
  */
 class PerfCounters
 {
@@ -97,6 +142,9 @@ public:
   void reset();
   void dump_formatted(ceph::Formatter *f, bool schema,
       const std::string &counter = "");
+  /// copy the current values, or just the one named counter
+  void snapshot(perf_counters_snapshot_t *s,
+		const std::string &counter = "") const;
   pair<uint64_t, uint64_t> get_tavg_ms(int idx) const;
 
   const std::string& get_name() const;
@@ -119,14 +167,16 @@ private:
 	type(PERFCOUNTER_NONE),
 	u64(0),
 	avgcount(0),
-	avgcount2(0)
+	avgcount2(0),
+	shard_off(-1)
     {}
     perf_counter_data_any_d(const perf_counter_data_any_d& other)
       : name(other.name),
         description(other.description),
         nick(other.nick),
 	type(other.type),
-	u64(other.u64.read()) {
+	u64(other.u64.read()),
+	shard_off(other.shard_off) {
       pair<uint64_t,uint64_t> a = other.read_avg();
       u64.set(a.first);
       avgcount.set(a.second);
@@ -140,6 +190,9 @@ private:
     atomic64_t u64;
     atomic64_t avgcount;
     atomic64_t avgcount2;
+    /// offset of <u64, avgcount, avgcount2[, histogram]> in each shard,
+    /// or -1 if the values above are used
+    int shard_off;
 
     void reset()
     {
@@ -155,6 +208,7 @@ private:
       description = other.description;
       nick = other.nick;
       type = other.type;
+      shard_off = other.shard_off;
       pair<uint64_t,uint64_t> a = other.read_avg();
       u64.set(a.first);
       avgcount.set(a.second);
@@ -174,6 +228,14 @@ private:
   };
   typedef std::vector<perf_counter_data_any_d> perf_counter_data_vec_t;
 
+  /// this thread's slot for a sharded counter
+  atomic64_t *get_shard(const perf_counter_data_any_d &data) const;
+  uint64_t read_u64(const perf_counter_data_any_d &data) const;
+  pair<uint64_t,uint64_t> read_avg(const perf_counter_data_any_d &data) const;
+  void read_hist(const perf_counter_data_any_d &data, uint64_t *hist) const;
+  /// lay out shards once all counters are added
+  void init_shards(unsigned num_shards);
+
   CephContext *m_cct;
   int m_lower_bound;
   int m_upper_bound;
@@ -185,6 +247,10 @@ private:
 
   perf_counter_data_vec_t m_data;
 
+  /// per-shard blocks of atomics, each starting on its own cache line
+  std::vector<atomic64_t*> m_shards;
+  unsigned m_shard_len;
+
   friend class PerfCountersBuilder;
 };
 
@@ -214,6 +280,16 @@ public:
       bool schema,
       const std::string &logger = "",
       const std::string &counter = "");
+  /**
+   * Like dump_formatted(), but leave out the counters that are the same
+   * as in the last dump_changed() for id, and the loggers with none
+   * left.  The first call for an id dumps everything.  Pollers that
+   * keep the previous values get the same picture for much less output.
+   */
+  void dump_changed(ceph::Formatter *f, const std::string &id);
+  void snapshot(std::vector<perf_counters_snapshot_t> *snaps,
+		const std::string &logger = "",
+		const std::string &counter = "") const;
 private:
   CephContext *m_cct;
 
@@ -222,6 +298,17 @@ private:
 
   perf_counters_set_t m_loggers;
 
+  /// the last values dump_changed() showed each id, and when
+  struct changed_state_t {
+    std::vector<perf_counters_snapshot_t> last;
+    uint64_t used;
+    changed_state_t() : used(0) {}
+  };
+  static const unsigned MAX_CHANGED_IDS = 16;
+  Mutex m_changed_lock;
+  std::map<std::string, changed_state_t> m_changed;
+  uint64_t m_changed_seq;
+
   friend class PerfCountersCollectionTest;
 };
 
@@ -249,6 +336,8 @@ public:
       const char *description=NULL, const char *nick = NULL);
   void add_time_avg(int key, const char *name,
       const char *description=NULL, const char *nick = NULL);
+  void add_time_hist(int key, const char *name,
+      const char *description=NULL, const char *nick = NULL);
   PerfCounters* create_perf_counters();
 private:
   PerfCountersBuilder(const PerfCountersBuilder &rhs);
@@ -37,6 +37,10 @@ class SimpleLRU {
   }
 
   void _add(K key, V value) {
+    typename map<K, typename list<pair<K, V> >::iterator, C>::iterator i =
+      contents.find(key);
+    if (i != contents.end())
+      lru.erase(i->second);
     lru.push_front(make_pair(key, value));
     contents[key] = lru.begin();
     trim_cache();
@@ -72,6 +76,13 @@ public:
     contents.erase(i);
   }
 
+  /// drop everything but the pinned entries
+  void clear() {
+    Mutex::Locker l(lock);
+    contents.clear();
+    lru.clear();
+  }
+
   void set_size(size_t new_size) {
     Mutex::Locker l(lock);
     max_size = new_size;
@@ -21,25 +21,98 @@
 #define dout_prefix *_dout << "compressor "
 
 AsyncCompressor::AsyncCompressor(CephContext *c):
-  compressor(Compressor::create(c->_conf->async_compressor_type)), cct(c),
+  compressor(Compressor::create(c, c->_conf->async_compressor_type)), cct(c),
   job_id(0),
   compress_tp(g_ceph_context, "AsyncCompressor::compressor_tp", cct->_conf->async_compressor_threads, "async_compressor_threads"),
-  job_lock("AsyncCompressor::job_lock"),
+  job_lock("AsyncCompressor::job_lock"), running(false),
   compress_wq(this, c->_conf->async_compressor_thread_timeout, c->_conf->async_compressor_thread_suicide_timeout, &compress_tp) {
+  assert(compressor);
 }
 
 void AsyncCompressor::init()
 {
   ldout(cct, 10) << __func__ << dendl;
   compress_tp.start();
+  Mutex::Locker l(job_lock);
+  running = true;
 }
 
 void AsyncCompressor::terminate()
 {
   ldout(cct, 10) << __func__ << dendl;
+  {
+    Mutex::Locker l(job_lock);
+    running = false;
+  }
+  // finish queued batches; nobody would complete them otherwise
+  compress_wq.drain();
   compress_tp.stop();
 }
 
+void AsyncCompressor::_queue_batch(bool compress, const vector<bufferlist*> &in,
+                                   const vector<bufferlist*> &out, Context *onfinish)
+{
+  assert(in.size() == out.size());
+  if (in.empty()) {
+    onfinish->complete(0);
+    return;
+  }
+  Batch *b = new Batch(in.size(), onfinish);
+  b->jobs.reserve(in.size());
+  for (unsigned i = 0; i < in.size(); ++i) {
+    b->jobs.push_back(Job(job_id.inc(), compress));
+    Job &j = b->jobs.back();
+    j.in = in[i];
+    j.out = out[i];
+    j.batch = b;
+  }
+  ldout(cct, 10) << __func__ << " " << (compress ? "compress" : "decompress")
+                 << " batch of " << in.size() << dendl;
+
+  bool inline_ = false;
+  {
+    Mutex::Locker l(job_lock);
+    inline_ = !running;
+  }
+  if (inline_) {
+    // b is gone once the last job is done
+    unsigned n = in.size();
+    Job *jobs = &b->jobs[0];
+    for (unsigned i = 0; i < n; ++i) {
+      jobs[i].status.set(WORKING);
+      _do_batch_job(&jobs[i]);
+    }
+    return;
+  }
+
+  // one hand-off for the lot: no job map, a single pool lock and wakeup
+  compress_wq.lock();
+  for (unsigned i = 0; i < b->jobs.size(); ++i)
+    compress_wq._enqueue(&b->jobs[i]);
+  compress_wq._wake();
+  compress_wq.unlock();
+}
+
+void AsyncCompressor::_do_batch_job(Job *job)
+{
+  Batch *b = job->batch;
+  int r;
+  if (job->is_compress)
+    r = compressor->compress(*job->in, *job->out);
+  else
+    r = compressor->decompress(*job->in, *job->out);
+  if (r) {
+    ldout(cct, 1) << __func__ << " job id=" << job->id << " failed" << dendl;
+    b->failed.set(1);
+  }
+  if (b->pending.dec() == 0) {
+    Context *c = b->onfinish;
+    int ret = b->failed.read() ? -EIO : 0;
+    delete b;
+    c->complete(ret);
+  }
+}
+
 uint64_t AsyncCompressor::async_compress(bufferlist &data)
 {
   uint64_t id = job_id.inc();
@@ -37,15 +37,29 @@ class AsyncCompressor {
     DONE,
     ERROR
   } status;
+  struct Batch;
   struct Job {
     uint64_t id;
     atomic_t status;
     bool is_compress;
     bufferlist data;
-    Job(uint64_t i, bool compress): id(i), status(WAIT), is_compress(compress) {}
-    Job(const Job &j): id(j.id), status(j.status.read()), is_compress(j.is_compress), data(j.data) {}
+    // batch jobs read *in and append to *out, both the caller's
+    bufferlist *in, *out;
+    Batch *batch;
+    Job(uint64_t i, bool compress): id(i), status(WAIT), is_compress(compress),
+                                    in(NULL), out(NULL), batch(NULL) {}
+    Job(const Job &j): id(j.id), status(j.status.read()), is_compress(j.is_compress), data(j.data),
+                       in(j.in), out(j.out), batch(j.batch) {}
+  };
+  /// jobs submitted together, completing one Context; never in jobs
+  struct Batch {
+    vector<Job> jobs;
+    atomic_t pending, failed;
+    Context *onfinish;
+    Batch(unsigned n, Context *c): pending(n), failed(0), onfinish(c) {}
   };
   Mutex job_lock;
+  bool running;  ///< protected by job_lock
   // only when job.status == DONE && with job_lock holding, we can insert/erase element in jobs
   // only when job.status == WAIT && with pool_lock holding, you can change its status and modify element's info later
   unordered_map<uint64_t, Job> jobs;
@@ -78,7 +92,7 @@ class AsyncCompressor {
         if (item->status.compare_and_swap(WAIT, WORKING)) {
           break;
         } else {
-          Mutex::Locker (async_compressor->job_lock);
+          Mutex::Locker l(async_compressor->job_lock);
           async_compressor->jobs.erase(item->id);
           item = NULL;
         }
@@ -87,6 +101,10 @@ class AsyncCompressor {
     }
     void _process(Job *item, ThreadPool::TPHandle &handle) {
       assert(item->status.read() == WORKING);
+      if (item->batch) {
+        async_compressor->_do_batch_job(item);
+        return;
+      }
       bufferlist out;
       int r;
       if (item->is_compress)
@@ -106,6 +124,9 @@ class AsyncCompressor {
   friend class CompressWQ;
   void _compress(bufferlist &in, bufferlist &out);
   void _decompress(bufferlist &in, bufferlist &out);
+  void _queue_batch(bool compress, const vector<bufferlist*> &in,
+                    const vector<bufferlist*> &out, Context *onfinish);
+  void _do_batch_job(Job *job);
 
  public:
   AsyncCompressor(CephContext *c);
@@ -123,6 +144,21 @@ class AsyncCompressor {
   uint64_t async_decompress(bufferlist &data);
   int get_compress_data(uint64_t compress_id, bufferlist &data, bool blocking, bool *finished);
   int get_decompress_data(uint64_t decompress_id, bufferlist &data, bool blocking, bool *finished);
+
+  /**
+   * compress each in[i], appending the result to out[i], on the worker
+   * threads; then complete onfinish with 0, or -EIO if any of them
+   * failed.  The bufferlists must stay put until then.  If the workers
+   * are stopped the batch is done inline, before this returns.
+   */
+  void async_compress(const vector<bufferlist*> &in,
+                      const vector<bufferlist*> &out, Context *onfinish) {
+    _queue_batch(true, in, out, onfinish);
+  }
+  void async_decompress(const vector<bufferlist*> &in,
+                        const vector<bufferlist*> &out, Context *onfinish) {
+    _queue_batch(false, in, out, onfinish);
+  }
 };
 
 #endif
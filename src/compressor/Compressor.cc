@@ -14,12 +14,24 @@
 
 #include "Compressor.h"
 #include "SnappyCompressor.h"
+#include "ZlibCompressor.h"
+#include "common/ceph_context.h"
+#include "common/config.h"
 
 
-Compressor* Compressor::create(const string &type)
+Compressor* Compressor::create(CephContext *cct, const string &type)
 {
   if (type == "snappy")
     return new SnappyCompressor();
+  if (type == "zlib")
+    return new ZlibCompressor(cct ? cct->_conf->compressor_zlib_level :
+			      Z_DEFAULT_COMPRESSION);
+  return NULL;
+}
 
-  assert(0);
+Compressor* Compressor::create(const string &type)
+{
+  Compressor *c = create(NULL, type);
+  assert(c);
+  return c;
 }
@@ -18,12 +18,19 @@
 #include "include/int_types.h"
 #include "include/Context.h"
 
+class CephContext;
+
 class Compressor {
  public:
   virtual ~Compressor() {}
+  /// the name create() knows it by
+  virtual const char *get_type() const = 0;
   virtual int compress(bufferlist &in, bufferlist &out) = 0;
   virtual int decompress(bufferlist &in, bufferlist &out) = 0;
 
+  /// snappy or zlib, tuned from cct's config if given; NULL if unknown
+  static Compressor *create(CephContext *cct, const string &type);
+  /// as above, with default tuning; type must be known
   static Compressor *create(const string &type);
 };
 
@@ -52,6 +52,7 @@ class BufferlistSource : public snappy::Source {
 class SnappyCompressor : public Compressor {
  public:
   virtual ~SnappyCompressor() {}
+  virtual const char *get_type() const { return "snappy"; }
   virtual int compress(bufferlist &src, bufferlist &dst) {
     BufferlistSource source(src);
     bufferptr ptr(snappy::MaxCompressedLength(src.length()));
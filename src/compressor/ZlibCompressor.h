@@ -0,0 +1,109 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software 
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_ZLIBCOMPRESSOR_H
+#define CEPH_ZLIBCOMPRESSOR_H
+
+#include <string.h>
+#include <zlib.h>
+#include "include/buffer.h"
+#include "Compressor.h"
+
+/**
+ * deflate, trading speed for ratio
+ *
+ * Streams the input and output a buffer at a time, so neither side
+ * needs to be contiguous.
+ */
+class ZlibCompressor : public Compressor {
+  int level;
+
+ public:
+  ZlibCompressor(int l = Z_DEFAULT_COMPRESSION) : level(l) {}
+  virtual ~ZlibCompressor() {}
+  virtual const char *get_type() const { return "zlib"; }
+
+  virtual int compress(bufferlist &src, bufferlist &dst) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit(&strm, level) != Z_OK)
+      return -1;
+    bufferptr out(deflateBound(&strm, src.length()));
+    strm.next_out = (Bytef *)out.c_str();
+    strm.avail_out = out.length();
+
+    list<bufferptr>::const_iterator p = src.buffers().begin();
+    int r;
+    do {
+      if (strm.avail_in == 0 && p != src.buffers().end()) {
+	strm.next_in = (Bytef *)p->c_str();
+	strm.avail_in = p->length();
+	++p;
+      }
+      bool last = (p == src.buffers().end());
+      r = deflate(&strm, last ? Z_FINISH : Z_NO_FLUSH);
+      if (r == Z_STREAM_ERROR)
+	break;
+      if (strm.avail_out == 0) {
+	dst.append(out);
+	out = bufferptr(out.length());
+	strm.next_out = (Bytef *)out.c_str();
+	strm.avail_out = out.length();
+      }
+    } while (r != Z_STREAM_END);
+    deflateEnd(&strm);
+    if (r != Z_STREAM_END)
+      return -1;
+    dst.append(out, 0, out.length() - strm.avail_out);
+    return 0;
+  }
+
+  virtual int decompress(bufferlist &src, bufferlist &dst) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit(&strm) != Z_OK)
+      return -1;
+    bufferptr out(MAX(src.length() * 4, 65536u));
+    strm.next_out = (Bytef *)out.c_str();
+    strm.avail_out = out.length();
+
+    list<bufferptr>::const_iterator p = src.buffers().begin();
+    int r;
+    do {
+      if (strm.avail_in == 0 && p != src.buffers().end()) {
+	strm.next_in = (Bytef *)p->c_str();
+	strm.avail_in = p->length();
+	++p;
+      }
+      r = inflate(&strm, Z_NO_FLUSH);
+      if (r == Z_NEED_DICT || r == Z_DATA_ERROR || r == Z_MEM_ERROR ||
+	  r == Z_STREAM_ERROR)
+	break;
+      if (r == Z_BUF_ERROR && strm.avail_in == 0 &&
+	  p == src.buffers().end())
+	break;  // truncated
+      if (strm.avail_out == 0) {
+	dst.append(out);
+	out = bufferptr(out.length());
+	strm.next_out = (Bytef *)out.c_str();
+	strm.avail_out = out.length();
+      }
+    } while (r != Z_STREAM_END);
+    inflateEnd(&strm);
+    if (r != Z_STREAM_END)
+      return -1;
+    dst.append(out, 0, out.length() - strm.avail_out);
+    return 0;
+  }
+};
+
+#endif
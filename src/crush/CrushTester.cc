@@ -9,6 +9,39 @@
 #include <stdlib.h>
 #include <boost/lexical_cast.hpp>
 #include <common/SubProcess.h>
+#include "common/Formatter.h"
+#include "common/Thread.h"
+
+// inputs per thread below which more threads do not pay
+#define MIN_X_PER_THREAD 1024
+
+class CrushTesterWorker : public Thread {
+  const CrushWrapper &crush;
+  int ruleno, nr;
+  const vector<__u32> &weight;
+  vector<int> xs;
+  vector<vector<int> > *out;
+  unsigned offset;
+
+public:
+  CrushTesterWorker(const CrushWrapper &c, int r, int n,
+		    const vector<__u32> &w, int begin, int end,
+		    vector<vector<int> > *o, unsigned off)
+    : crush(c), ruleno(r), nr(n), weight(w), out(o), offset(off) {
+    for (int x = begin; x < end; ++x)
+      xs.push_back(x);
+  }
+  void run() {
+    vector<vector<int> > result;
+    crush.do_rule_batch(ruleno, xs, result, nr, weight);
+    for (unsigned i = 0; i < result.size(); ++i)
+      (*out)[offset + i].swap(result[i]);
+  }
+  void *entry() {
+    run();
+    return NULL;
+  }
+};
 
 void CrushTester::set_device_weight(int dev, float f)
 {
@@ -150,6 +183,51 @@ void CrushTester::adjust_weights(vector<__u32>& weight)
   }
 }
 
+void CrushTester::get_device_weights(CrushWrapper& c, int max_devices,
+				     vector<__u32>& weight)
+{
+  weight.clear();
+  for (int o = 0; o < max_devices; o++) {
+    if (device_weight.count(o)) {
+      weight.push_back(device_weight[o]);
+    } else if (c.check_item_present(o)) {
+      weight.push_back(0x10000);
+    } else {
+      weight.push_back(0);
+    }
+  }
+}
+
+void CrushTester::map_range(const CrushWrapper& c, int ruleno,
+			    int begin, int end, int nr,
+			    const vector<__u32>& weight,
+			    vector<vector<int> >& out)
+{
+  out.clear();
+  if (end <= begin)
+    return;
+  out.resize(end - begin);
+  // the choose_tries profile is one set of counters in the map
+  int threads = output_choose_tries ? 1 : num_threads;
+  threads = MIN(threads, MAX(1, (end - begin) / MIN_X_PER_THREAD));
+  int per = (end - begin + threads - 1) / threads;
+  vector<CrushTesterWorker*> workers;
+  for (int x = begin; x < end; x += per)
+    workers.push_back(new CrushTesterWorker(c, ruleno, nr, weight,
+					    x, MIN(x + per, end),
+					    &out, x - begin));
+  if (workers.size() == 1) {
+    workers[0]->run();
+  } else {
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->create();
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->join();
+  }
+  for (unsigned i = 0; i < workers.size(); ++i)
+    delete workers[i];
+}
+
 bool CrushTester::check_valid_placement(int ruleno, vector<int> in, const vector<__u32>& weight)
 {
 
@@ -468,15 +546,7 @@ int CrushTester::test()
    * note device weight is set by crushtool
    * (likely due to a given a command line option)
    */
-  for (int o = 0; o < crush.get_max_devices(); o++) {
-    if (device_weight.count(o)) {
-      weight.push_back(device_weight[o]);
-    } else if (crush.check_item_present(o)) {
-      weight.push_back(0x10000);
-    } else {
-      weight.push_back(0);
-    }
-  }
+  get_device_weights(crush, crush.get_max_devices(), weight);
 
   if (output_utilization_all)
     err << "devices weights (hex): " << hex << weight << dec << std::endl;
@@ -586,6 +656,11 @@ int CrushTester::test()
         // create a vector to hold placement results temporarily 
         vector<int> temporary_per ( per.size() );
 
+        // map the whole batch at once
+        vector<vector<int> > batch_out;
+        if (use_crush)
+          map_range(crush, r, batch_min, batch_max + 1, nr, weight, batch_out);
+
         for (int x = batch_min; x <= batch_max; x++) {
           // create a vector to hold the results of a CRUSH placement or RNG simulation
           vector<int> out;
@@ -593,7 +668,7 @@ int CrushTester::test()
           if (use_crush) {
             if (output_mappings)
 	      err << "CRUSH"; // prepend CRUSH to placement output
-            crush.do_rule(r, x, out, nr, weight);
+            out.swap(batch_out[x - batch_min]);
           } else {
             if (output_mappings)
 	      err << "RNG"; // prepend RNG to placement output to denote simulation
@@ -701,3 +776,171 @@ int CrushTester::test()
 
   return 0;
 }
+
+int CrushTester::compare(CrushWrapper& other, const string& domain_type,
+			 Formatter *f, ostream& out)
+{
+  if (min_rule < 0 || max_rule < 0) {
+    min_rule = 0;
+    max_rule = crush.get_max_rules() - 1;
+  }
+  if (min_x < 0 || max_x < 0) {
+    min_x = 0;
+    max_x = 1023;
+  }
+  if (crush.get_type_id(domain_type) < 0) {
+    err << "unknown type '" << domain_type << "'" << std::endl;
+    return -EINVAL;
+  }
+
+  // devices may move between buckets, so each map has its own domains
+  int max_devices = MAX(crush.get_max_devices(), other.get_max_devices());
+  vector<__u32> weight, other_weight;
+  get_device_weights(crush, max_devices, weight);
+  get_device_weights(other, max_devices, other_weight);
+  map<string,int> domain_ids;
+  vector<string> domain_names;
+  vector<int> domain(max_devices, -1), other_domain(max_devices, -1);
+  for (int which = 0; which < 2; ++which) {
+    CrushWrapper &c = which ? other : crush;
+    vector<int> &dom = which ? other_domain : domain;
+    for (int o = 0; o < max_devices; ++o) {
+      if (!c.check_item_present(o))
+	continue;
+      map<string,string> loc = c.get_full_location(o);
+      map<string,string>::iterator p = loc.find(domain_type);
+      if (p == loc.end())
+	continue;
+      map<string,int>::iterator q = domain_ids.find(p->second);
+      if (q == domain_ids.end()) {
+	q = domain_ids.insert(make_pair(p->second,
+					(int)domain_names.size())).first;
+	domain_names.push_back(p->second);
+      }
+      dom[o] = q->second;
+    }
+  }
+
+  if (f)
+    f->open_array_section("compare");
+  for (int r = min_rule; r < crush.get_max_rules() && r <= max_rule; r++) {
+    if (!crush.rule_exists(r) || !other.rule_exists(r))
+      continue;
+    if (ruleset >= 0 &&
+	crush.get_rule_mask_ruleset(r) != ruleset)
+      continue;
+    int minr = min_rep, maxr = max_rep;
+    if (min_rep < 0 || max_rep < 0) {
+      minr = crush.get_rule_mask_min_size(r);
+      maxr = crush.get_rule_mask_max_size(r);
+    }
+    for (int nr = minr; nr <= maxr; nr++) {
+      vector<vector<int> > before, after;
+      map_range(crush, r, min_x, max_x + 1, nr, weight, before);
+      map_range(other, r, min_x, max_x + 1, nr, other_weight, after);
+
+      // [0] held before, [1] after, [2] arrived, [3] left
+      vector<vector<int> > dev(max_devices, vector<int>(4, 0));
+      vector<vector<int> > dom(domain_names.size(), vector<int>(4, 0));
+      int changed = 0, moved = 0;
+      for (unsigned i = 0; i < before.size(); ++i) {
+	const vector<int> &a = before[i], &b = after[i];
+	if (a != b)
+	  ++changed;
+	map<int,int> dom_delta;
+	for (unsigned j = 0; j < a.size(); ++j) {
+	  if (a[j] == CRUSH_ITEM_NONE || a[j] < 0 || a[j] >= max_devices)
+	    continue;
+	  dev[a[j]][0]++;
+	  if (domain[a[j]] >= 0) {
+	    dom[domain[a[j]]][0]++;
+	    dom_delta[domain[a[j]]]--;
+	  }
+	  if (std::find(b.begin(), b.end(), a[j]) == b.end()) {
+	    dev[a[j]][3]++;
+	    ++moved;
+	  }
+	}
+	for (unsigned j = 0; j < b.size(); ++j) {
+	  if (b[j] == CRUSH_ITEM_NONE || b[j] < 0 || b[j] >= max_devices)
+	    continue;
+	  dev[b[j]][1]++;
+	  if (other_domain[b[j]] >= 0) {
+	    dom[other_domain[b[j]]][1]++;
+	    dom_delta[other_domain[b[j]]]++;
+	  }
+	  if (std::find(a.begin(), a.end(), b[j]) == a.end())
+	    dev[b[j]][2]++;
+	}
+	for (map<int,int>::iterator p = dom_delta.begin();
+	     p != dom_delta.end();
+	     ++p) {
+	  if (p->second > 0)
+	    dom[p->first][2] += p->second;
+	  else
+	    dom[p->first][3] -= p->second;
+	}
+      }
+
+      if (!f) {
+	out << "rule " << r << " (" << crush.get_rule_name(r)
+	    << ") num_rep " << nr << ": " << changed << "/" << before.size()
+	    << " mappings changed, " << moved << " replicas moved" << std::endl;
+	if (output_utilization || output_utilization_all) {
+	  for (int o = 0; o < max_devices; ++o) {
+	    if (!output_utilization_all && !dev[o][0] && !dev[o][1])
+	      continue;
+	    out << "  device " << o << ":\t" << dev[o][0] << " -> " << dev[o][1]
+		<< "\t+" << dev[o][2] << " -" << dev[o][3] << std::endl;
+	  }
+	  for (unsigned d = 0; d < domain_names.size(); ++d)
+	    out << "  " << domain_type << " " << domain_names[d] << ":\t"
+		<< dom[d][0] << " -> " << dom[d][1]
+		<< "\t+" << dom[d][2] << " -" << dom[d][3] << std::endl;
+	}
+	continue;
+      }
+
+      f->open_object_section("rule");
+      f->dump_int("rule_id", r);
+      f->dump_string("rule_name", crush.get_rule_name(r));
+      f->dump_int("num_rep", nr);
+      f->dump_int("min_x", min_x);
+      f->dump_int("max_x", max_x);
+      f->dump_int("changed", changed);
+      f->dump_int("moved", moved);
+      f->open_array_section("devices");
+      for (int o = 0; o < max_devices; ++o) {
+	if (!dev[o][0] && !dev[o][1])
+	  continue;
+	f->open_object_section("device");
+	f->dump_int("id", o);
+	f->dump_int("before", dev[o][0]);
+	f->dump_int("after", dev[o][1]);
+	f->dump_int("in", dev[o][2]);
+	f->dump_int("out", dev[o][3]);
+	f->close_section();
+      }
+      f->close_section();
+      f->open_array_section("domains");
+      for (unsigned d = 0; d < domain_names.size(); ++d) {
+	f->open_object_section("domain");
+	f->dump_string("type", domain_type);
+	f->dump_string("name", domain_names[d]);
+	f->dump_int("before", dom[d][0]);
+	f->dump_int("after", dom[d][1]);
+	f->dump_int("in", dom[d][2]);
+	f->dump_int("out", dom[d][3]);
+	f->close_section();
+      }
+      f->close_section();
+      f->close_section();
+      f->flush(out);
+    }
+  }
+  if (f) {
+    f->close_section();
+    f->flush(out);
+  }
+  return 0;
+}
@@ -20,6 +20,7 @@ class CrushTester {
   int min_rep, max_rep;
 
   int num_batches;
+  int num_threads;
   bool use_crush;
 
   float mark_down_device_ratio;
@@ -43,6 +44,21 @@ class CrushTester {
  */
   void adjust_weights(vector<__u32>& weight);
 
+  /*
+   * the device weights to test c with: those given with
+   * set_device_weight(), else 1.0 for the devices in the map
+   */
+  void get_device_weights(CrushWrapper& c, int max_devices,
+			  vector<__u32>& weight);
+
+  /*
+   * map [begin, end) with c, split over num_threads threads; the
+   * mapper keeps no state in the map so they can share it
+   */
+  void map_range(const CrushWrapper& c, int ruleno, int begin, int end,
+		 int nr, const vector<__u32>& weight,
+		 vector<vector<int> >& out);
+
   /*
    * Get the maximum number of devices that could be selected to satisfy ruleno.
    */
@@ -173,6 +189,7 @@ public:
       min_x(-1), max_x(-1),
       min_rep(-1), max_rep(-1),
       num_batches(1),
+      num_threads(1),
       use_crush(true),
       mark_down_device_ratio(0.0),
       mark_down_bucket_ratio(1.0),
@@ -258,6 +275,13 @@ public:
     return num_batches;
   }
 
+  void set_threads(int n) {
+    num_threads = n < 1 ? 1 : n;
+  }
+  int get_threads() const {
+    return num_threads;
+  }
+
   void set_random_placement() {
     use_crush = false;
   }
@@ -348,6 +372,18 @@ public:
    */
   bool check_name_maps(unsigned max_id = 0) const;
   int test();
+
+  /**
+   * map the same inputs with crush and with other and report what moved
+   *
+   * For every rule (and numrep) in both maps, counts the inputs whose
+   * mapping changed and, per device and per bucket of type
+   * domain_type (the failure domain), the replicas that arrive and
+   * leave.  With a formatter each rule is dumped and flushed to out as
+   * soon as it is done, otherwise a summary line is printed per rule.
+   */
+  int compare(CrushWrapper& other, const string& domain_type,
+	      Formatter *f, ostream& out);
   int test_with_crushtool(const char *crushtool_cmd = "crushtool",
 			  int max_id = -1,
 			  int timeout = 0,
@@ -1376,6 +1376,7 @@ void CrushWrapper::decode_crush_bucket(crush_bucket** bptr, bufferlist::iterator
     for (unsigned j = 0; j < bucket->size; ++j) {
       ::decode(cbs->item_weights[j], blp);
     }
+    crush_calc_straw2(crush, cbs);
     break;
   }
 
@@ -50,7 +50,6 @@ inline static void decode(crush_rule_step &s, bufferlist::iterator &p)
 
 using namespace std;
 class CrushWrapper {
-  mutable Mutex mapper_lock;
 public:
   std::map<int32_t, string> type_map; /* bucket/device type names */
   std::map<int32_t, string> name_map; /* bucket/device names */
@@ -78,8 +77,7 @@ public:
   CrushWrapper(const CrushWrapper& other);
   const CrushWrapper& operator=(const CrushWrapper& other);
 
-  CrushWrapper() : mapper_lock("CrushWrapper::mapper_lock"),
-		   crush(0), have_rmaps(false) {
+  CrushWrapper() : crush(0), have_rmaps(false) {
     create();
   }
   ~CrushWrapper() {
@@ -1025,7 +1023,8 @@ public:
 
   void do_rule(int rule, int x, vector<int>& out, int maxout,
 	       const vector<__u32>& weight) const {
-    Mutex::Locker l(mapper_lock);
+    // the userspace mapper keeps no state in the map, so no lock is
+    // needed; the scratch space is on the stack
     int rawout[maxout];
     int scratch[maxout * 3];
     int numrep = crush_do_rule(crush, rule, x, rawout, maxout, &weight[0], weight.size(), scratch);
@@ -1036,6 +1035,26 @@ public:
       out[i] = rawout[i];
   }
 
+  /// do_rule() for each of xs
+  void do_rule_batch(int rule, const vector<int>& xs,
+		     vector<vector<int> >& out, int maxout,
+		     const vector<__u32>& weight) const {
+    out.resize(xs.size());
+    if (xs.empty())
+      return;
+    vector<int> rawout(xs.size() * maxout);
+    vector<int> lens(xs.size());
+    vector<int> scratch(maxout * 3);
+    crush_do_rule_batch(crush, rule, &xs[0], xs.size(), &rawout[0],
+			&lens[0], maxout, &weight[0], weight.size(),
+			&scratch[0]);
+    for (unsigned i = 0; i < xs.size(); ++i) {
+      int numrep = lens[i] < 0 ? 0 : lens[i];
+      out[i].assign(rawout.begin() + i * maxout,
+		    rawout.begin() + i * maxout + numrep);
+    }
+  }
+
   int read_from_file(const char *fn) {
     bufferlist bl;
     std::string error;
@@ -607,6 +607,39 @@ err:
         return NULL;
 }
 
+/*
+ * fill in item_recips from item_weights; without them (no 128-bit
+ * arithmetic, or no memory) straw2 mapping divides instead, with the
+ * same result
+ */
+void crush_calc_straw2(struct crush_map *map, struct crush_bucket_straw2 *bucket)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned i;
+	void *_realloc;
+
+	if (bucket->h.size == 0 ||
+	    (_realloc = realloc(bucket->item_recips,
+				sizeof(__u64)*bucket->h.size)) == NULL) {
+		free(bucket->item_recips);
+		bucket->item_recips = NULL;
+		return;
+	}
+	bucket->item_recips = _realloc;
+	for (i = 0; i < bucket->h.size; i++) {
+		__u32 w = bucket->item_weights[i];
+		unsigned __int128 d;
+
+		if (!w) {
+			bucket->item_recips[i] = 0;
+			continue;
+		}
+		d = (unsigned __int128)1 << crush_straw2_recip_shift(w);
+		bucket->item_recips[i] = (__u64)((d + w - 1) / w);
+	}
+#endif
+}
+
 struct crush_bucket_straw2 *
 crush_make_straw2_bucket(struct crush_map *map,
 			 int hash,
@@ -643,6 +676,7 @@ crush_make_straw2_bucket(struct crush_map *map,
 		bucket->h.weight += weights[i];
 		bucket->item_weights[i] = weights[i];
 	}
+	crush_calc_straw2(map, bucket);
 
 	return bucket;
 err:
@@ -892,6 +926,7 @@ int crush_add_straw2_bucket_item(struct crush_map *map,
 
 	bucket->h.weight += weight;
 	bucket->h.size++;
+	crush_calc_straw2(map, bucket);
 
 	return 0;
 }
@@ -1146,6 +1181,7 @@ int crush_remove_straw2_bucket_item(struct crush_map *map,
 	}
 	if (i == bucket->h.size)
 		return -ENOENT;
+	crush_calc_straw2(map, bucket);
 
 	void *_realloc = NULL;
 
@@ -1292,6 +1328,7 @@ int crush_adjust_straw2_bucket_item_weight(struct crush_map *map,
 	diff = weight - bucket->item_weights[idx];
 	bucket->item_weights[idx] = weight;
 	bucket->h.weight += diff;
+	crush_calc_straw2(map, bucket);
 
 	return diff;
 }
@@ -1436,11 +1473,14 @@ static int crush_reweight_straw2_bucket(struct crush_map *crush, struct crush_bu
 			bucket->item_weights[i] = c->weight;
 		}
 
-                if (crush_addition_is_unsafe(bucket->h.weight, bucket->item_weights[i]))
+                if (crush_addition_is_unsafe(bucket->h.weight, bucket->item_weights[i])) {
+                        crush_calc_straw2(crush, bucket);
                         return -ERANGE;
+                }
 
                 bucket->h.weight += bucket->item_weights[i];
 	}
+	crush_calc_straw2(crush, bucket);
 
 	return 0;
 }
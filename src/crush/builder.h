@@ -40,6 +40,8 @@ crush_make_straw_bucket(struct crush_map *map,
 			int hash, int type, int size,
 			int *items,
 			int *weights);
+extern void crush_calc_straw2(struct crush_map *map,
+			      struct crush_bucket_straw2 *bucket);
 
 extern int crush_addition_is_unsafe(__u32 a, __u32 b);
 extern int crush_multiplication_is_unsafe(__u32  a, __u32 b);
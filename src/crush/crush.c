@@ -78,6 +78,7 @@ void crush_destroy_bucket_straw(struct crush_bucket_straw *b)
 
 void crush_destroy_bucket_straw2(struct crush_bucket_straw2 *b)
 {
+	kfree(b->item_recips);
 	kfree(b->item_weights);
 	kfree(b->h.perm);
 	kfree(b->h.items);
@@ -171,8 +171,21 @@ struct crush_bucket_straw {
 struct crush_bucket_straw2 {
 	struct crush_bucket h;
 	__u32 *item_weights;   /* 16-bit fixed point */
+	__u64 *item_recips;    /* see crush_calc_straw2(); may be NULL */
 };
 
+/*
+ * straw2 divides a 49-bit value by each item weight w.  With
+ * l = ceil(log2 w) and item_recips[i] = ceil(2^(49+l) / w), the
+ * quotient is exactly (n * item_recips[i]) >> crush_straw2_recip_shift(w)
+ * (Granlund and Montgomery, "Division by invariant integers using
+ * multiplication", theorem 4.2).
+ */
+static inline int crush_straw2_recip_shift(__u32 w)
+{
+	return 49 + (w > 1 ? 32 - __builtin_clz(w - 1) : 0);
+}
+
 
 
 /*
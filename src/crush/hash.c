@@ -2,6 +2,9 @@
 # include <linux/crush/hash.h>
 #else
 # include "hash.h"
+# ifdef __SSE2__
+#  include <emmintrin.h>
+# endif
 #endif
 
 /*
@@ -140,6 +143,69 @@ __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d, __u32 e)
 	}
 }
 
+#if !defined(__KERNEL__) && defined(__SSE2__)
+/*
+ * crush_hashmix on four lanes at once; same arithmetic, so the same
+ * bits come out as from the scalar version
+ */
+#define crush_hashmix_sse2(a, b, c) do {				\
+		a = _mm_sub_epi32(a, b); a = _mm_sub_epi32(a, c);	\
+		a = _mm_xor_si128(a, _mm_srli_epi32(c, 13));		\
+		b = _mm_sub_epi32(b, c); b = _mm_sub_epi32(b, a);	\
+		b = _mm_xor_si128(b, _mm_slli_epi32(a, 8));		\
+		c = _mm_sub_epi32(c, a); c = _mm_sub_epi32(c, b);	\
+		c = _mm_xor_si128(c, _mm_srli_epi32(b, 13));		\
+		a = _mm_sub_epi32(a, b); a = _mm_sub_epi32(a, c);	\
+		a = _mm_xor_si128(a, _mm_srli_epi32(c, 12));		\
+		b = _mm_sub_epi32(b, c); b = _mm_sub_epi32(b, a);	\
+		b = _mm_xor_si128(b, _mm_slli_epi32(a, 16));		\
+		c = _mm_sub_epi32(c, a); c = _mm_sub_epi32(c, b);	\
+		c = _mm_xor_si128(c, _mm_srli_epi32(b, 5));		\
+		a = _mm_sub_epi32(a, b); a = _mm_sub_epi32(a, c);	\
+		a = _mm_xor_si128(a, _mm_srli_epi32(c, 3));		\
+		b = _mm_sub_epi32(b, c); b = _mm_sub_epi32(b, a);	\
+		b = _mm_xor_si128(b, _mm_slli_epi32(a, 10));		\
+		c = _mm_sub_epi32(c, a); c = _mm_sub_epi32(c, b);	\
+		c = _mm_xor_si128(c, _mm_srli_epi32(b, 15));		\
+	} while (0)
+
+static void crush_hash32_rjenkins1_3_sse2(__u32 a, const __u32 *b, __u32 c,
+					  __u32 *out)
+{
+	__m128i va = _mm_set1_epi32(a);
+	__m128i vb = _mm_loadu_si128((const __m128i *)b);
+	__m128i vc = _mm_set1_epi32(c);
+	__m128i hash = _mm_xor_si128(_mm_set1_epi32(crush_hash_seed ^ a ^ c),
+				     vb);
+	__m128i x = _mm_set1_epi32(231232);
+	__m128i y = _mm_set1_epi32(1232);
+	crush_hashmix_sse2(va, vb, hash);
+	crush_hashmix_sse2(vc, x, hash);
+	crush_hashmix_sse2(y, va, hash);
+	crush_hashmix_sse2(vb, x, hash);
+	crush_hashmix_sse2(y, vc, hash);
+	_mm_storeu_si128((__m128i *)out, hash);
+}
+#endif
+
+void crush_hash32_3_vec(int type, __u32 a, const __u32 *b, __u32 c,
+			__u32 *out, unsigned int n)
+{
+	unsigned int i = 0;
+
+	if (type != CRUSH_HASH_RJENKINS1) {
+		for (; i < n; i++)
+			out[i] = crush_hash32_3(type, a, b[i], c);
+		return;
+	}
+#if !defined(__KERNEL__) && defined(__SSE2__)
+	for (; i + 4 <= n; i += 4)
+		crush_hash32_rjenkins1_3_sse2(a, b + i, c, out + i);
+#endif
+	for (; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+
 const char *crush_hash_name(int type)
 {
 	switch (type) {
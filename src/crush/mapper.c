@@ -70,6 +70,50 @@ int crush_find_rule(const struct crush_map *map, int ruleset, int type, int size
  * Since this is expensive, we optimize for the r=0 case, which
  * captures the vast majority of calls.
  */
+#ifndef __KERNEL__
+/*
+ * The permutation only depends on @x, so the cache in the bucket is
+ * pure memoization.  Userspace does without it: the shuffle is redone
+ * on the stack, which leaves the map untouched and lets any number of
+ * threads map with it at once.
+ */
+static int bucket_perm_choose(struct crush_bucket *bucket,
+			      int x, int r)
+{
+	unsigned int pr = r % bucket->size;
+	unsigned int i, p, s;
+
+	/* optimize common r=0 case */
+	if (pr == 0) {
+		s = crush_hash32_3(bucket->hash, x, bucket->id, 0) %
+			bucket->size;
+		return bucket->items[s];
+	}
+
+	{
+		__u32 perm[bucket->size];
+
+		for (i = 0; i < bucket->size; i++)
+			perm[i] = i;
+		for (p = 0; p <= pr; p++) {
+			/* no point in swapping the final entry */
+			if (p < bucket->size - 1) {
+				i = crush_hash32_3(bucket->hash, x, bucket->id, p) %
+					(bucket->size - p);
+				if (i) {
+					unsigned int t = perm[p + i];
+					perm[p + i] = perm[p];
+					perm[p] = t;
+				}
+			}
+		}
+		s = perm[pr];
+	}
+	dprintk(" perm_choose %d sz=%d x=%d r=%d (%d) s=%d\n", bucket->id,
+		bucket->size, x, r, pr, s);
+	return bucket->items[s];
+}
+#else
 static int bucket_perm_choose(struct crush_bucket *bucket,
 			      int x, int r)
 {
@@ -128,6 +172,7 @@ out:
 		bucket->size, x, r, pr, s);
 	return bucket->items[s];
 }
+#endif
 
 /* uniform */
 static int bucket_uniform_choose(struct crush_bucket_uniform *bucket,
@@ -253,10 +298,19 @@ static __u64 crush_ln(unsigned int xin)
 
 	/* normalize input */
 	iexpon = 15;
+#ifndef __KERNEL__
+	/* x is in [1, 0x10000]: shift its top bit up to bit 15 at once */
+	if (!(x & 0x18000)) {
+		int shift = __builtin_clz(x) - 16;
+		x <<= shift;
+		iexpon -= shift;
+	}
+#else
 	while (!(x & 0x18000)) {
 		x <<= 1;
 		iexpon--;
 	}
+#endif
 
 	index1 = (x >> 8) << 1;
 	/* RH ~ 2^56/index1 */
@@ -294,6 +348,9 @@ static __u64 crush_ln(unsigned int xin)
  *
  */
 
+/* items hashed at a time by bucket_straw2_choose */
+#define CRUSH_STRAW2_HASH_CHUNK 32
+
 static int bucket_straw2_choose(struct crush_bucket_straw2 *bucket,
 				int x, int r)
 {
@@ -301,12 +358,24 @@ static int bucket_straw2_choose(struct crush_bucket_straw2 *bucket,
 	unsigned int u;
 	unsigned int w;
 	__s64 ln, draw, high_draw = 0;
+	__u32 hashes[CRUSH_STRAW2_HASH_CHUNK];
+	unsigned int chunk_start = 0, chunk_end = 0;
 
 	for (i = 0; i < bucket->h.size; i++) {
+		if (i == chunk_end) {
+			/* hash the next run of items in one go */
+			unsigned int n = bucket->h.size - i;
+			if (n > CRUSH_STRAW2_HASH_CHUNK)
+				n = CRUSH_STRAW2_HASH_CHUNK;
+			crush_hash32_3_vec(bucket->h.hash, x,
+					   (const __u32 *)bucket->h.items + i,
+					   r, hashes, n);
+			chunk_start = i;
+			chunk_end = i + n;
+		}
 		w = bucket->item_weights[i];
 		if (w) {
-			u = crush_hash32_3(bucket->h.hash, x,
-					   bucket->h.items[i], r);
+			u = hashes[i - chunk_start];
 			u &= 0xffff;
 
 			/*
@@ -327,6 +396,15 @@ static int bucket_straw2_choose(struct crush_bucket_straw2 *bucket,
 			 * weight means a larger (less negative) value
 			 * for draw.
 			 */
+#if defined(__SIZEOF_INT128__) && !defined(__KERNEL__)
+			if (bucket->item_recips) {
+				/* the same quotient, without dividing */
+				unsigned __int128 q =
+					(unsigned __int128)(__u64)(-ln) *
+					bucket->item_recips[i];
+				draw = -(__s64)(q >> crush_straw2_recip_shift(w));
+			} else
+#endif
 			draw = div64_s64(ln, w);
 		} else {
 			draw = S64_MIN;
@@ -982,3 +1060,33 @@ int crush_do_rule(const struct crush_map *map,
 	}
 	return result_len;
 }
+
+/**
+ * crush_do_rule_batch - map many inputs with the same rule
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @xs: the n inputs
+ * @n: number of inputs
+ * @results: n rows of result_max entries, row i for xs[i]
+ * @result_lens: length of each row
+ * @result_max: maximum result size
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @scratch: scratch vector for private use; must be >= 3 * result_max
+ *
+ * Gives the same mappings as calling crush_do_rule() on each input.
+ */
+void crush_do_rule_batch(const struct crush_map *map,
+			 int ruleno, const int *xs, int n,
+			 int *results, int *result_lens, int result_max,
+			 const __u32 *weight, int weight_max,
+			 int *scratch)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		result_lens[i] = crush_do_rule(map, ruleno, xs[i],
+					       results + i * result_max,
+					       result_max, weight, weight_max,
+					       scratch);
+}
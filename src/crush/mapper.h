@@ -16,5 +16,10 @@ extern int crush_do_rule(const struct crush_map *map,
 			 int x, int *result, int result_max,
 			 const __u32 *weights, int weight_max,
 			 int *scratch);
+extern void crush_do_rule_batch(const struct crush_map *map,
+				int ruleno, const int *xs, int n,
+				int *results, int *result_lens, int result_max,
+				const __u32 *weight, int weight_max,
+				int *scratch);
 
 #endif
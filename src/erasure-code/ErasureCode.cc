@@ -21,6 +21,7 @@
 #include <ostream>
 
 #include "common/strtol.h"
+#include "include/crc32c.h"
 #include "ErasureCode.h"
 
 const unsigned ErasureCode::SIMD_ALIGN = 32;
@@ -63,12 +64,33 @@ int ErasureCode::minimum_to_decode_with_cost(const set<int> &want_to_read,
                                              const map<int, int> &available,
                                              set<int> *minimum)
 {
-  set <int> available_chunks;
+  //
+  // Try the cheapest chunks first and allow more expensive ones only
+  // if they are not enough: when the costs are distances (same host,
+  // same rack, ...) a repair that can be done close by never reads
+  // from far away.
+  //
+  set<int> costs;
   for (map<int, int>::const_iterator i = available.begin();
        i != available.end();
        ++i)
-    available_chunks.insert(i->first);
-  return minimum_to_decode(want_to_read, available_chunks, minimum);
+    costs.insert(i->second);
+  int r = -EIO;
+  for (set<int>::iterator c = costs.begin(); c != costs.end(); ++c) {
+    set <int> available_chunks;
+    for (map<int, int>::const_iterator i = available.begin();
+	 i != available.end();
+	 ++i)
+      if (i->second <= *c)
+	available_chunks.insert(i->first);
+    minimum->clear();
+    r = minimum_to_decode(want_to_read, available_chunks, minimum);
+    if (r == 0)
+      break;
+  }
+  if (costs.empty())
+    r = minimum_to_decode(want_to_read, set<int>(), minimum);
+  return r;
 }
 
 int ErasureCode::encode_prepare(const bufferlist &raw,
@@ -131,6 +153,87 @@ int ErasureCode::encode_chunks(const set<int> &want_to_encode,
 {
   assert("ErasureCode::encode_chunks not implemented" == 0);
 }
+
+int ErasureCode::encode_stripes(const set<int> &want_to_encode,
+                                const bufferlist &in,
+                                unsigned int stripe_width,
+                                map<int, bufferlist> *encoded,
+                                map<int, uint32_t> *crcs)
+{
+  unsigned int k = get_data_chunk_count();
+  unsigned int m = get_chunk_count() - k;
+  if (!stripe_width || in.length() % stripe_width)
+    return -EINVAL;
+  unsigned int stripes = in.length() / stripe_width;
+  unsigned int blocksize = get_chunk_size(stripe_width);
+
+  if (blocksize * k != stripe_width || blocksize % SIMD_ALIGN) {
+    // stripes need padding or would not stay aligned back to back:
+    // one at a time
+    for (unsigned int s = 0; s < stripes; s++) {
+      bufferlist stripe;
+      stripe.substr_of(in, s * stripe_width, stripe_width);
+      map<int, bufferlist> chunks;
+      int err = encode(want_to_encode, stripe, &chunks);
+      if (err)
+        return err;
+      for (map<int, bufferlist>::iterator i = chunks.begin();
+           i != chunks.end();
+           ++i) {
+        if (crcs)
+          (*crcs)[i->first] = i->second.crc32c((*crcs)[i->first]);
+        (*encoded)[i->first].claim_append(i->second);
+      }
+    }
+    return 0;
+  }
+
+  // every chunk of every stripe goes straight to its place in one
+  // buffer per chunk index; each stripe is encoded and hashed right
+  // after it is copied in
+  set<int> all;
+  vector<bufferptr> out(k + m);
+  for (unsigned int i = 0; i < k + m; i++) {
+    all.insert(i);
+    out[i] = buffer::create_aligned(stripes * blocksize, SIMD_ALIGN);
+  }
+  bufferlist::const_iterator p = in.begin();
+  for (unsigned int s = 0; s < stripes; s++) {
+    map<int, bufferlist> chunks;
+    for (unsigned int i = 0; i < k + m; i++) {
+      int c = chunk_index(i);
+      if (i < k)
+        p.copy(blocksize, out[c].c_str() + s * blocksize);
+      chunks[c].push_back(bufferptr(out[c], s * blocksize, blocksize));
+    }
+    int err = encode_chunks(all, &chunks);
+    if (err)
+      return err;
+    if (crcs) {
+      // the chunks of a stripe are independent: hash them side by side
+      vector<uint32_t> c;
+      vector<unsigned char const *> d;
+      for (set<int>::const_iterator i = want_to_encode.begin();
+           i != want_to_encode.end();
+           ++i) {
+        c.push_back((*crcs)[*i]);
+        d.push_back((unsigned char*)out[*i].c_str() + s * blocksize);
+      }
+      vector<unsigned> l(c.size(), blocksize);
+      ceph_crc32c_multi(c.size(), &c[0], &d[0], &l[0]);
+      unsigned j = 0;
+      for (set<int>::const_iterator i = want_to_encode.begin();
+           i != want_to_encode.end();
+           ++i)
+        (*crcs)[*i] = c[j++];
+    }
+  }
+  for (set<int>::const_iterator i = want_to_encode.begin();
+       i != want_to_encode.end();
+       ++i)
+    (*encoded)[*i].push_back(out[*i]);
+  return 0;
+}
  
 int ErasureCode::decode(const set<int> &want_to_read,
                         const map<int, bufferlist> &chunks,
@@ -174,6 +277,40 @@ int ErasureCode::decode_chunks(const set<int> &want_to_read,
   assert("ErasureCode::decode_chunks not implemented" == 0);
 }
 
+int ErasureCode::decode_stripes(const set<int> &want_to_read,
+                                const map<int, bufferlist> &chunks,
+                                unsigned int chunk_size,
+                                map<int, bufferlist> *decoded)
+{
+  if (chunks.empty() || !chunk_size)
+    return -EINVAL;
+  unsigned int total = chunks.begin()->second.length();
+  if (total % chunk_size)
+    return -EINVAL;
+  for (map<int, bufferlist>::const_iterator i = chunks.begin();
+       i != chunks.end();
+       ++i)
+    if (i->second.length() != total)
+      return -EINVAL;
+
+  for (unsigned int off = 0; off < total; off += chunk_size) {
+    map<int, bufferlist> stripe;
+    for (map<int, bufferlist>::const_iterator i = chunks.begin();
+         i != chunks.end();
+         ++i)
+      stripe[i->first].substr_of(i->second, off, chunk_size);
+    map<int, bufferlist> out;
+    int err = decode(want_to_read, stripe, &out);
+    if (err)
+      return err;
+    for (set<int>::const_iterator i = want_to_read.begin();
+         i != want_to_read.end();
+         ++i)
+      (*decoded)[*i].claim_append(out[*i]);
+  }
+  return 0;
+}
+
 int ErasureCode::parse(const ErasureCodeProfile &profile,
 		       ostream *ss)
 {
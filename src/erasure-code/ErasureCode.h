@@ -70,6 +70,12 @@ namespace ceph {
     virtual int encode_chunks(const set<int> &want_to_encode,
                               map<int, bufferlist> *encoded);
 
+    virtual int encode_stripes(const set<int> &want_to_encode,
+                               const bufferlist &in,
+                               unsigned int stripe_width,
+                               map<int, bufferlist> *encoded,
+                               map<int, uint32_t> *crcs);
+
     virtual int decode(const set<int> &want_to_read,
                        const map<int, bufferlist> &chunks,
                        map<int, bufferlist> *decoded);
@@ -78,6 +84,11 @@ namespace ceph {
                               const map<int, bufferlist> &chunks,
                               map<int, bufferlist> *decoded);
 
+    virtual int decode_stripes(const set<int> &want_to_read,
+                               const map<int, bufferlist> &chunks,
+                               unsigned int chunk_size,
+                               map<int, bufferlist> *decoded);
+
     virtual const vector<int> &get_chunk_mapping() const;
 
     int to_mapping(const ErasureCodeProfile &profile,
@@ -359,6 +359,38 @@ namespace ceph {
     virtual int encode_chunks(const set<int> &want_to_encode,
                               map<int, bufferlist> *encoded) = 0;
 
+    /**
+     * Encode **in** as consecutive stripes of **stripe_width**
+     * bytes and store, for each chunk index in **want_to_encode**,
+     * the concatenation of that chunk of every stripe in
+     * **encoded**. The result is what calling **encode** on each
+     * stripe in turn and appending the chunks would give, but the
+     * implementation may work on many stripes at once.
+     *
+     * The length of **in** must be a multiple of **stripe_width**.
+     * The **encoded** map is expected to be a pointer to an empty
+     * map.
+     *
+     * If **crcs** is not NULL, the crc32c of every chunk in
+     * **want_to_encode** is accumulated into it, starting from the
+     * value it holds for that chunk index (0 if none), while the
+     * chunk is still hot in the cache.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] want_to_encode chunk indexes to be encoded
+     * @param [in] in data to be encoded
+     * @param [in] stripe_width size of one stripe in **in**
+     * @param [out] encoded map chunk indexes to chunk data
+     * @param [in,out] crcs map chunk indexes to running crc32c
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_stripes(const set<int> &want_to_encode,
+                               const bufferlist &in,
+                               unsigned int stripe_width,
+                               map<int, bufferlist> *encoded,
+                               map<int, uint32_t> *crcs) = 0;
+
     /**
      * Decode the **chunks** and store at least **want_to_read**
      * chunks in **decoded**.
@@ -396,6 +428,31 @@ namespace ceph {
                        const map<int, bufferlist> &chunks,
                        map<int, bufferlist> *decoded) = 0;
 
+    /**
+     * Decode runs of **chunk_size** chunks, one stripe after the
+     * other: every bufferlist in **chunks** holds the same number of
+     * consecutive chunks of **chunk_size** bytes, and for each chunk
+     * index in **want_to_read** the concatenation of that chunk of
+     * every stripe is stored in **decoded**. The result is what
+     * calling **decode** on each stripe in turn and appending the
+     * chunks would give, but the implementation may work on many
+     * stripes at once, and on several threads.
+     *
+     * The **decoded** map must be a pointer to an empty map.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] want_to_read chunk indexes to be decoded
+     * @param [in] chunks map chunk indexes to runs of chunk data
+     * @param [in] chunk_size size of one chunk of one stripe
+     * @param [out] decoded map chunk indexes to runs of chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int decode_stripes(const set<int> &want_to_read,
+                               const map<int, bufferlist> &chunks,
+                               unsigned int chunk_size,
+                               map<int, bufferlist> *decoded) = 0;
+
     virtual int decode_chunks(const set<int> &want_to_read,
                               const map<int, bufferlist> &chunks,
                               map<int, bufferlist> *decoded) = 0;
@@ -18,6 +18,9 @@
 #include <errno.h>
 // -----------------------------------------------------------------------------
 #include "common/debug.h"
+#include "common/config.h"
+#include "common/Thread.h"
+#include "include/crc32c.h"
 #include "ErasureCodeIsa.h"
 #include "xor_op.h"
 #include "crush/CrushWrapper.h"
@@ -41,6 +44,39 @@ _prefix(std::ostream* _dout)
 }
 // -----------------------------------------------------------------------------
 
+// data encoded per call by encode_stripes(), small enough for the
+// chunks to still be in cache when they are hashed
+#define ISA_ENCODE_GROUP_BYTES (256 * 1024)
+// bytes per chunk index below which decode_stripes() adds no thread
+#define ISA_DECODE_MIN_THREAD_BYTES (256 * 1024)
+
+class IsaDecodeWorker : public Thread {
+  ErasureCodeIsa *isa;
+  int *erasures;
+  vector<char*> data, coding;
+  int blocksize;
+
+public:
+  int r;
+
+  IsaDecodeWorker(ErasureCodeIsa *i, int *e, char **d, char **c,
+                  unsigned off, int len)
+    : isa(i), erasures(e), blocksize(len), r(0) {
+    for (int j = 0; j < isa->k; j++)
+      data.push_back(d[j] + off);
+    for (int j = 0; j < isa->m; j++)
+      coding.push_back(c[j] + off);
+  }
+  void run() {
+    r = isa->isa_decode(erasures, &data[0], &coding[0], blocksize);
+  }
+  void *entry() {
+    run();
+    return NULL;
+  }
+};
+// -----------------------------------------------------------------------------
+
 const std::string ErasureCodeIsaDefault::DEFAULT_K("7");
 const std::string ErasureCodeIsaDefault::DEFAULT_M("3");
 
@@ -140,6 +176,141 @@ int ErasureCodeIsa::decode_chunks(const set<int> &want_to_read,
 
 // -----------------------------------------------------------------------------
 
+int ErasureCodeIsa::encode_stripes(const set<int> &want_to_encode,
+                                   const bufferlist &in,
+                                   unsigned int stripe_width,
+                                   map<int, bufferlist> *encoded,
+                                   map<int, uint32_t> *crcs)
+{
+  if (!stripe_width || in.length() % stripe_width)
+    return -EINVAL;
+  unsigned int blocksize = get_chunk_size(stripe_width);
+  if (blocksize * k != stripe_width || blocksize % SIMD_ALIGN ||
+      !get_chunk_mapping().empty())
+    return ErasureCode::encode_stripes(want_to_encode, in, stripe_width,
+                                       encoded, crcs);
+
+  unsigned int stripes = in.length() / stripe_width;
+  unsigned int group = MAX(1u, ISA_ENCODE_GROUP_BYTES / stripe_width);
+  vector<bufferptr> out(k + m);
+  for (int i = 0; i < k + m; i++)
+    out[i] = buffer::create_aligned(stripes * blocksize, SIMD_ALIGN);
+  bufferlist::const_iterator p = in.begin();
+  for (unsigned int s = 0; s < stripes; s += group) {
+    unsigned int n = MIN(group, stripes - s);
+    for (unsigned int j = s; j < s + n; j++)
+      for (int i = 0; i < k; i++)
+        p.copy(blocksize, out[i].c_str() + j * blocksize);
+    char *chunks[k + m];
+    for (int i = 0; i < k + m; i++)
+      chunks[i] = out[i].c_str() + s * blocksize;
+    isa_encode(&chunks[0], &chunks[k], n * blocksize);
+    if (crcs) {
+      for (set<int>::const_iterator i = want_to_encode.begin();
+           i != want_to_encode.end();
+           ++i)
+        (*crcs)[*i] = ceph_crc32c((*crcs)[*i],
+                                  (unsigned char*)chunks[*i],
+                                  n * blocksize);
+    }
+  }
+  for (set<int>::const_iterator i = want_to_encode.begin();
+       i != want_to_encode.end();
+       ++i)
+    (*encoded)[*i].push_back(out[*i]);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+int ErasureCodeIsa::decode_stripes(const set<int> &want_to_read,
+                                   const map<int, bufferlist> &chunks,
+                                   unsigned int chunk_size,
+                                   map<int, bufferlist> *decoded)
+{
+  if (chunks.empty() || !chunk_size)
+    return -EINVAL;
+  unsigned int total = chunks.begin()->second.length();
+  if (total % chunk_size)
+    return -EINVAL;
+  bool have_all = true;
+  for (map<int, bufferlist>::const_iterator i = chunks.begin();
+       i != chunks.end();
+       ++i)
+    if (i->second.length() != total)
+      return -EINVAL;
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i)
+    if (!chunks.count(*i))
+      have_all = false;
+  if (have_all) {
+    for (set<int>::const_iterator i = want_to_read.begin();
+         i != want_to_read.end();
+         ++i)
+      (*decoded)[*i] = chunks.find(*i)->second;
+    return 0;
+  }
+  if (!get_chunk_mapping().empty() || total == 0)
+    return ErasureCode::decode_stripes(want_to_read, chunks, chunk_size,
+                                       decoded);
+
+  map<int, bufferlist> all;
+  int erasures[k + m + 1];
+  int erasures_count = 0;
+  char *data[k];
+  char *coding[m];
+  for (int i = 0; i < k + m; i++) {
+    map<int, bufferlist>::const_iterator c = chunks.find(i);
+    if (c == chunks.end()) {
+      all[i].push_back(buffer::create_aligned(total, SIMD_ALIGN));
+      erasures[erasures_count++] = i;
+    } else {
+      all[i] = c->second;
+      all[i].rebuild_aligned_size_and_memory(total, SIMD_ALIGN);
+    }
+    if (i < k)
+      data[i] = all[i].c_str();
+    else
+      coding[i - k] = all[i].c_str();
+  }
+  erasures[erasures_count] = -1;
+
+  // cut on stripe boundaries, one slice per thread
+  unsigned int stripes = total / chunk_size;
+  unsigned int threads = MAX(1, g_ceph_context->_conf->erasure_code_decode_threads);
+  threads = MIN(threads, MAX(1u, total / ISA_DECODE_MIN_THREAD_BYTES));
+  threads = MIN(threads, stripes);
+  unsigned int per = (stripes + threads - 1) / threads * chunk_size;
+  vector<IsaDecodeWorker*> workers;
+  for (unsigned int off = 0; off < total; off += per)
+    workers.push_back(new IsaDecodeWorker(this, erasures, data, coding, off,
+                                          MIN(per, total - off)));
+  if (workers.size() == 1) {
+    workers[0]->run();
+  } else {
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->create();
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->join();
+  }
+  int r = 0;
+  for (unsigned i = 0; i < workers.size(); ++i) {
+    if (workers[i]->r)
+      r = workers[i]->r;
+    delete workers[i];
+  }
+  if (r)
+    return r;
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i)
+    (*decoded)[*i] = all[*i];
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 void
 ErasureCodeIsaDefault::isa_encode(char **data,
                                   char **coding,
@@ -94,6 +94,19 @@ public:
                             const map<int, bufferlist> &chunks,
                             map<int, bufferlist> *decoded);
 
+  // the code works byte by byte, so these treat the chunks of many
+  // stripes laid end to end as one long chunk
+  virtual int encode_stripes(const set<int> &want_to_encode,
+                             const bufferlist &in,
+                             unsigned int stripe_width,
+                             map<int, bufferlist> *encoded,
+                             map<int, uint32_t> *crcs);
+
+  virtual int decode_stripes(const set<int> &want_to_read,
+                             const map<int, bufferlist> &chunks,
+                             unsigned int chunk_size,
+                             map<int, bufferlist> *decoded);
+
   virtual int init(ErasureCodeProfile &profile, ostream *ss);
 
   virtual void isa_encode(char **data,
@@ -294,6 +294,13 @@ ErasureCodeIsaTableCache::putDecodingTableToCache(std::string &signature,
   lru_list_t* decode_tbls_lru =
     getDecodingTablesLru(matrixtype);
 
+  // someone else (another thread decoding the same pattern) was first
+  if (decode_tbls_map->count(signature)) {
+    memcpy((*decode_tbls_map)[signature].second.c_str(), table,
+           k * (m + k)*32);
+    return;
+  }
+
   // evt. shrink the LRU queue/map
   if ((int) decode_tbls_lru->size() >= ErasureCodeIsaTableCache::decoding_tables_lru_length) {
     dout(12) << "[ shrink lru   ] = " << signature << dendl;
@@ -149,6 +149,167 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeJerasure::matrix_decode(int *matrix,
+				       int *erasures,
+				       char **data,
+				       char **coding,
+				       int blocksize)
+{
+  if (w != 8 && w != 16 && w != 32)
+    return -1;
+  int *erased = jerasure_erasures_to_erased(k, m, erasures);
+  if (erased == NULL)
+    return -1;
+
+  //
+  // As jerasure_matrix_decode with row_k_ones: the first coding chunk
+  // is the xor of the data, so a single lost data chunk is rebuilt
+  // from it and needs no decoding matrix.
+  //
+  int edd = 0, lastdrive = k;
+  for (int i = 0; i < k; i++) {
+    if (erased[i]) {
+      edd++;
+      lastdrive = i;
+    }
+  }
+  if (erased[k])
+    lastdrive = k;
+
+  ErasureCodeJerasureTableCache::DecodingTableRef table;
+  if (edd > 1 || (edd > 0 && erased[k])) {
+    string signature = ErasureCodeJerasureTableCache::signature(erasures);
+    table = decoding_tables.get(signature);
+    if (!table) {
+      table.reset(new ErasureCodeJerasureTableCache::DecodingTable);
+      table->dm_ids.resize(k);
+      table->matrix.resize(k * k);
+      if (jerasure_make_decoding_matrix(k, m, w, matrix, erased,
+					&table->matrix[0],
+					&table->dm_ids[0]) < 0) {
+	free(erased);
+	return -1;
+      }
+      decoding_tables.put(signature, table);
+    }
+  }
+
+  for (int i = 0; edd > 0 && i < lastdrive; i++) {
+    if (erased[i]) {
+      jerasure_matrix_dotprod(k, w, &table->matrix[i * k], &table->dm_ids[0],
+			      i, data, coding, blocksize);
+      edd--;
+    }
+  }
+  if (edd > 0) {
+    int ids[k];
+    for (int i = 0; i < k; i++)
+      ids[i] = (i < lastdrive) ? i : i + 1;
+    jerasure_matrix_dotprod(k, w, matrix, ids, lastdrive,
+			    data, coding, blocksize);
+  }
+  for (int i = 0; i < m; i++) {
+    if (erased[k + i])
+      jerasure_matrix_dotprod(k, w, matrix + (i * k), NULL, k + i,
+			      data, coding, blocksize);
+  }
+  free(erased);
+  return 0;
+}
+
+int ErasureCodeJerasure::schedule_decode(int *bitmatrix,
+					 int *erasures,
+					 char **data,
+					 char **coding,
+					 int blocksize,
+					 int packetsize)
+{
+  string signature = ErasureCodeJerasureTableCache::signature(erasures);
+  ErasureCodeJerasureTableCache::DecodingTableRef table =
+    decoding_tables.get(signature);
+  if (!table) {
+    int *erased = jerasure_erasures_to_erased(k, m, erasures);
+    if (erased == NULL)
+      return -1;
+    table.reset(new ErasureCodeJerasureTableCache::DecodingTable);
+    int kw = k * w;
+    bool data_lost = false;
+    for (int i = 0; i < k + m; i++) {
+      if (erased[i]) {
+	table->lost.push_back(i);
+	if (i < k)
+	  data_lost = true;
+      }
+    }
+
+    //
+    // decoding maps the surviving dm_ids to the data: it is the
+    // identity when only coding chunks are lost.
+    //
+    vector<int> decoding(kw * kw, 0);
+    table->dm_ids.resize(k);
+    if (data_lost) {
+      if (jerasure_make_decoding_bitmatrix(k, m, w, bitmatrix, erased,
+					   &decoding[0],
+					   &table->dm_ids[0]) < 0) {
+	free(erased);
+	return -1;
+      }
+    } else {
+      for (int i = 0; i < k; i++)
+	table->dm_ids[i] = i;
+      for (int i = 0; i < kw; i++)
+	decoding[i * kw + i] = 1;
+    }
+    free(erased);
+
+    //
+    // One block of w rows per lost chunk, from the survivors: a data
+    // chunk's rows are those of decoding, a coding chunk's are its
+    // encoding rows composed with decoding.
+    //
+    unsigned lost = table->lost.size();
+    vector<int> rows(lost * w * kw, 0);
+    for (unsigned l = 0; l < lost; l++) {
+      int chunk = table->lost[l];
+      for (int b = 0; b < w; b++) {
+	int *row = &rows[(l * w + b) * kw];
+	if (chunk < k) {
+	  memcpy(row, &decoding[(chunk * w + b) * kw], kw * sizeof(int));
+	} else {
+	  const int *encoding = bitmatrix + ((chunk - k) * w + b) * kw;
+	  for (int j = 0; j < kw; j++)
+	    if (encoding[j])
+	      for (int c = 0; c < kw; c++)
+		row[c] ^= decoding[j * kw + c];
+	}
+      }
+    }
+    table->schedule = jerasure_smart_bitmatrix_to_schedule(k, lost, w,
+							   &rows[0]);
+    if (table->schedule == NULL)
+      return -1;
+    decoding_tables.put(signature, table);
+  }
+
+  unsigned lost = table->lost.size();
+  char *ptrs[k + lost];
+  for (int i = 0; i < k; i++) {
+    int chunk = table->dm_ids[i];
+    ptrs[i] = chunk < k ? data[chunk] : coding[chunk - k];
+  }
+  for (unsigned l = 0; l < lost; l++) {
+    int chunk = table->lost[l];
+    ptrs[k + l] = chunk < k ? data[chunk] : coding[chunk - k];
+  }
+  for (int done = 0; done < blocksize; done += packetsize * w) {
+    jerasure_do_scheduled_operations(ptrs, table->schedule, packetsize);
+    for (unsigned i = 0; i < k + lost; i++)
+      ptrs[i] += packetsize * w;
+  }
+  return 0;
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
@@ -179,8 +340,7 @@ int ErasureCodeJerasureReedSolomonVandermonde::jerasure_decode(int *erasures,
                                                                 char **coding,
                                                                 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1,
-				erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
 }
 
 unsigned ErasureCodeJerasureReedSolomonVandermonde::get_alignment() const
@@ -232,7 +392,7 @@ int ErasureCodeJerasureReedSolomonRAID6::jerasure_decode(int *erasures,
 							 char **coding,
 							 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
 }
 
 unsigned ErasureCodeJerasureReedSolomonRAID6::get_alignment() const
@@ -284,8 +444,8 @@ int ErasureCodeJerasureCauchy::jerasure_decode(int *erasures,
 					       char **coding,
 					       int blocksize)
 {
-  return jerasure_schedule_decode_lazy(k, m, w, bitmatrix,
-				       erasures, data, coding, blocksize, packetsize, 1);
+  return schedule_decode(bitmatrix, erasures, data, coding,
+			 blocksize, packetsize);
 }
 
 unsigned ErasureCodeJerasureCauchy::get_alignment() const
@@ -364,8 +524,8 @@ int ErasureCodeJerasureLiberation::jerasure_decode(int *erasures,
                                                     char **coding,
                                                     int blocksize)
 {
-  return jerasure_schedule_decode_lazy(k, m, w, bitmatrix, erasures, data,
-				       coding, blocksize, packetsize, 1);
+  return schedule_decode(bitmatrix, erasures, data, coding,
+			 blocksize, packetsize);
 }
 
 unsigned ErasureCodeJerasureLiberation::get_alignment() const
@@ -19,6 +19,7 @@
 #define CEPH_ERASURE_CODE_JERASURE_H
 
 #include "erasure-code/ErasureCode.h"
+#include "ErasureCodeJerasureTableCache.h"
 
 #define DEFAULT_RULESET_ROOT "default"
 #define DEFAULT_RULESET_FAILURE_DOMAIN "host"
@@ -35,6 +36,7 @@ public:
   string ruleset_root;
   string ruleset_failure_domain;
   bool per_chunk_alignment;
+  ErasureCodeJerasureTableCache decoding_tables;
 
   ErasureCodeJerasure(const char *_technique) :
     k(0),
@@ -86,6 +88,14 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, ostream *ss);
+
+  /// jerasure_matrix_decode with row_k_ones, the decoding matrix cached
+  int matrix_decode(int *matrix, int *erasures,
+		    char **data, char **coding, int blocksize);
+  /// jerasure_schedule_decode_lazy, the decoding schedule cached
+  int schedule_decode(int *bitmatrix, int *erasures,
+		      char **data, char **coding,
+		      int blocksize, int packetsize);
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <sstream>
+
+#include "ErasureCodeJerasureTableCache.h"
+extern "C" {
+#include "jerasure.h"
+}
+
+ErasureCodeJerasureTableCache::DecodingTable::~DecodingTable()
+{
+  if (schedule)
+    jerasure_free_schedule(schedule);
+}
+
+std::string ErasureCodeJerasureTableCache::signature(const int *erasures)
+{
+  std::ostringstream s;
+  for (int i = 0; erasures[i] != -1; i++)
+    s << '+' << erasures[i];
+  return s.str();
+}
+
+ErasureCodeJerasureTableCache::DecodingTableRef
+ErasureCodeJerasureTableCache::get(const std::string &signature)
+{
+  Mutex::Locker l(lock);
+  lru_map_t::iterator p = tables.find(signature);
+  if (p == tables.end()) {
+    ++misses;
+    return DecodingTableRef();
+  }
+  ++hits;
+  lru.splice(lru.begin(), lru, p->second.first);
+  return p->second.second;
+}
+
+void ErasureCodeJerasureTableCache::put(const std::string &signature,
+					DecodingTableRef table)
+{
+  Mutex::Locker l(lock);
+  lru_map_t::iterator p = tables.find(signature);
+  if (p != tables.end()) {
+    // another thread built the same table meanwhile
+    lru.splice(lru.begin(), lru, p->second.first);
+    p->second.second = table;
+    return;
+  }
+  if (tables.size() >= decoding_tables_lru_length) {
+    tables.erase(lru.back());
+    lru.pop_back();
+  }
+  lru.push_front(signature);
+  tables[signature] = lru_entry_t(lru.begin(), table);
+}
+
+uint64_t ErasureCodeJerasureTableCache::get_hits()
+{
+  Mutex::Locker l(lock);
+  return hits;
+}
+
+uint64_t ErasureCodeJerasureTableCache::get_misses()
+{
+  Mutex::Locker l(lock);
+  return misses;
+}
+
+unsigned ErasureCodeJerasureTableCache::size()
+{
+  Mutex::Locker l(lock);
+  return tables.size();
+}
@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_ERASURE_CODE_JERASURE_TABLE_CACHE_H
+#define CEPH_ERASURE_CODE_JERASURE_TABLE_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/Mutex.h"
+#include "include/memory.h"
+
+/**
+ * Decoding tables of one jerasure codec, by erasure signature
+ *
+ * Building a decoding matrix (or, for the bitmatrix techniques, a
+ * decoding schedule) is a matrix inversion; jerasure does it again on
+ * every degraded read.  A failure only produces a handful of erasure
+ * patterns, so the tables are kept here and dropped least recently
+ * used first.  Tables are handed out by reference so that one that is
+ * evicted while a decode is using it stays valid until it is done.
+ */
+class ErasureCodeJerasureTableCache {
+public:
+  // enough for every pattern of up to 4 erasures out of 12 chunks
+  static const unsigned decoding_tables_lru_length = 2516;
+
+  struct DecodingTable {
+    /// surviving chunks the decode reads, k of them
+    std::vector<int> dm_ids;
+    /// matrix techniques: k x k decoding matrix (empty if not needed)
+    std::vector<int> matrix;
+    /// bitmatrix techniques: rebuilt chunks, in schedule order
+    std::vector<int> lost;
+    /// bitmatrix techniques: schedule from dm_ids to lost
+    int **schedule;
+
+    DecodingTable() : schedule(NULL) {}
+    ~DecodingTable();
+  };
+  typedef ceph::shared_ptr<DecodingTable> DecodingTableRef;
+
+private:
+  typedef std::list<std::string> lru_list_t;
+  typedef std::pair<lru_list_t::iterator, DecodingTableRef> lru_entry_t;
+  typedef std::map<std::string, lru_entry_t> lru_map_t;
+
+  Mutex lock;
+  lru_list_t lru;
+  lru_map_t tables;
+  uint64_t hits, misses;
+
+public:
+  ErasureCodeJerasureTableCache() :
+    lock("ErasureCodeJerasureTableCache::lock"),
+    hits(0), misses(0) {}
+
+  /// the signature of an erasures array terminated by -1
+  static std::string signature(const int *erasures);
+
+  /// NULL if there is no table for signature
+  DecodingTableRef get(const std::string &signature);
+  void put(const std::string &signature, DecodingTableRef table);
+
+  uint64_t get_hits();
+  uint64_t get_misses();
+  unsigned size();
+};
+
+#endif
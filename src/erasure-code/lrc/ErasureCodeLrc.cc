@@ -718,7 +718,9 @@ int ErasureCodeLrc::minimum_to_decode(const set<int> &want_to_read,
     }
   }
 
-  derr << __func__ << " not enough chunks in " << available_chunks
+  // not an error in itself: minimum_to_decode_with_cost asks with the
+  // cheapest chunks first
+  dout(10) << __func__ << " not enough chunks in " << available_chunks
        << " to read " << want_to_read << dendl;
   return -EIO;
 }
@@ -35,25 +35,32 @@ static ostream& _prefix(std::ostream* _dout)
   return *_dout << "ErasureCodePluginSelectShec: ";
 }
 
-static string get_variant() {
+/*
+ * The variants the CPU can run, best first.  A variant may not have
+ * been built (e.g. a compiler without -mavx2), in which case loading
+ * it fails with -EIO and the next one is used.
+ */
+static void get_variants(vector<string> *variants) {
   ceph_arch_probe();
 
-  if (ceph_arch_intel_pclmul &&
-      ceph_arch_intel_sse42 &&
-      ceph_arch_intel_sse41 &&
-      ceph_arch_intel_ssse3 &&
-      ceph_arch_intel_sse3 &&
-      ceph_arch_intel_sse2) {
-    return "sse4";
+  bool sse4 = ceph_arch_intel_pclmul &&
+    ceph_arch_intel_sse42 &&
+    ceph_arch_intel_sse41 &&
+    ceph_arch_intel_ssse3 &&
+    ceph_arch_intel_sse3 &&
+    ceph_arch_intel_sse2;
+  if (sse4 && ceph_arch_intel_avx2)
+    variants->push_back("avx2");
+  if (sse4) {
+    variants->push_back("sse4");
   } else if (ceph_arch_intel_ssse3 &&
 	     ceph_arch_intel_sse3 &&
 	     ceph_arch_intel_sse2) {
-    return "sse3";
+    variants->push_back("sse3");
   } else if (ceph_arch_neon) {
-    return "neon";
-  } else {
-    return "generic";
+    variants->push_back("neon");
   }
+  variants->push_back("generic");
 }
 
 class ErasureCodePluginSelectShec : public ErasureCodePlugin {
@@ -74,10 +81,16 @@ public:
 			     directory,
 			     profile, erasure_code, ss);
     } else {
-      string variant = get_variant();
-      dout(10) << variant << " plugin" << dendl;
-      ret = instance.factory(name + "_" + variant, directory,
-			     profile, erasure_code, ss);
+      vector<string> variants;
+      get_variants(&variants);
+      ret = -EIO;
+      for (vector<string>::iterator v = variants.begin();
+	   v != variants.end() && ret == -EIO;
+	   ++v) {
+	dout(10) << *v << " plugin" << dendl;
+	ret = instance.factory(name + "_" + *v, directory,
+			       profile, erasure_code, ss);
+      }
     }
     return ret;
   }
@@ -88,11 +101,16 @@ const char *__erasure_code_version() { return CEPH_GIT_NICE_VER; }
 int __erasure_code_init(char *plugin_name, char *directory)
 {
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
-  string variant = get_variant();
+  vector<string> variants;
+  get_variants(&variants);
   ErasureCodePlugin *plugin;
   stringstream ss;
-  int r = instance.load(plugin_name + string("_") + variant,
-			directory, &plugin, &ss);
+  int r = -EIO;
+  for (vector<string>::iterator v = variants.begin();
+       v != variants.end() && r == -EIO;
+       ++v)
+    r = instance.load(plugin_name + string("_") + *v,
+		      directory, &plugin, &ss);
   if (r) {
     derr << ss.str() << dendl;
     return r;
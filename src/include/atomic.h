@@ -53,15 +53,17 @@ namespace ceph {
       ceph_spin_unlock(&lock);
       return r;
     }
-    void add(T d) {
+    T add(T d) {
       ceph_spin_lock(&lock);
-      val += d;
+      T r = val += d;
       ceph_spin_unlock(&lock);
+      return r;
     }
-    void sub(T d) {
+    T sub(T d) {
       ceph_spin_lock(&lock);
-      val -= d;
+      T r = val -= d;
       ceph_spin_unlock(&lock);
+      return r;
     }
     T read() const {
       T ret;
@@ -62,6 +62,7 @@
 
 #if defined(HAVE_XIO)
 struct xio_reg_mem;
+struct xio_mempool;
 class XioDispatchHook;
 #endif
 
@@ -116,6 +117,27 @@ public:
   /// enable/disable tracking of buffer::ptr::c_str() calls
   static void track_c_str(bool b);
 
+  /// memory accounting pools, by the subsystem pinning the buffers
+  enum {
+    POOL_ANON = 0,       ///< not claimed by anyone
+    POOL_OSD,
+    POOL_MSGR,
+    POOL_OBJECTCACHER,
+    POOL_MAX
+  };
+  static const char *get_pool_name(int pool);
+  /// bytes of raw buffers currently accounted to @p pool
+  static int64_t get_pool_bytes(int pool);
+  /// number of raw buffers currently accounted to @p pool
+  static int64_t get_pool_items(int pool);
+
+  /// bytes of free 4K/64K/4M buffers each thread may cache (0 disables)
+  static void set_thread_cache_size(size_t bytes);
+  /// bytes currently held in all thread caches
+  static int64_t get_thread_cache_bytes();
+  static int64_t get_thread_cache_hits();
+  static int64_t get_thread_cache_misses();
+
 private:
  
   /* hack for memory utilization debugging. */
@@ -130,6 +152,7 @@ private:
   class raw_static;
   class raw_mmap_pages;
   class raw_posix_aligned;
+  class raw_combined;
   class raw_hack_aligned;
   class raw_char;
   class raw_pipe;
@@ -157,6 +180,7 @@ public:
 
 #if defined(HAVE_XIO)
   static raw* create_msg(unsigned len, char *buf, XioDispatchHook *m_hook);
+  static raw* create_xio_mempool(unsigned len, struct ::xio_mempool *pool);
 #endif
 
   /*
@@ -185,6 +209,8 @@ public:
     raw *clone();
     void swap(ptr& other);
     ptr& make_shareable();
+    /// account the underlying raw buffer to buffer::POOL_*
+    void reassign_to_pool(int pool);
 
     // misc
     bool at_buffer_head() const { return _off == 0; }
@@ -352,6 +378,8 @@ public:
   private:
     mutable iterator last_p;
     int zero_copy_to_fd(int fd) const;
+    /// a fresh append_buffer with room for at least @p len bytes
+    static raw* create_append_buffer(unsigned len);
 
   public:
     // cons/des
@@ -442,6 +470,9 @@ public:
 					 unsigned align_memory);
     void rebuild_page_aligned();
 
+    /// account all underlying raw buffers to buffer::POOL_*
+    void reassign_to_pool(int pool);
+
     // assignment-op with move semantics
     const static unsigned int CLAIM_DEFAULT = 0;
     const static unsigned int CLAIM_ALLOW_NONSHAREABLE = 1;
@@ -503,6 +534,12 @@ public:
     void append(const list& bl);
     void append(std::istream& in);
     void append_zero(unsigned len);
+
+    /// return space for at least @p len contiguous bytes at the tail,
+    /// to be written directly and then committed with append_reserved()
+    char *append_reserve(unsigned len);
+    /// append the first @p len bytes written to the append_reserve() space
+    void append_reserved(unsigned len);
     
     /*
      * get a char
@@ -530,6 +567,7 @@ public:
     int read_fd_zero_copy(int fd, size_t len);
     int write_file(const char *fn, int mode=0644);
     int write_fd(int fd) const;
+    int write_fd(int fd, uint64_t offset) const;
     int write_fd_zero_copy(int fd) const;
     void prepare_iov(std::vector<iovec> *piov) const;
     uint32_t crc32c(uint32_t crc) const;
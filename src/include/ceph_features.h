@@ -70,6 +70,12 @@
 #define CEPH_FEATURE_OSD_HITSET_GMT (1ULL<<54)
 #define CEPH_FEATURE_HAMMER_0_94_4 (1ULL<<55)
 #define CEPH_FEATURE_NEW_OSDOP_ENCODING   (1ULL<<56) /* New, v7 encoding */
+#define CEPH_FEATURE_MSG_COMPRESS (1ULL<<57)  /* async msgr compressed data */
+#define CEPH_FEATURE_OSD_REPOP_BATCH (1ULL<<58)  /* MOSDRepOpBatch */
+#define CEPH_FEATURE_OSD_DELTA_RECOVERY (1ULL<<59)  /* push clone_range from own head */
+// duplicated since it was introduced at the same time as DELTA_RECOVERY
+#define CEPH_FEATURE_OSD_HITSET_CUCKOO (1ULL<<59)  /* overlap w/ above */
+#define CEPH_FEATURE_OSD_OP_BATCH (1ULL<<60)  /* MOSDOpBatch */
 
 #define CEPH_FEATURE_RESERVED2 (1ULL<<61)  /* slow down, we are almost out... */
 #define CEPH_FEATURE_RESERVED  (1ULL<<62)  /* DO NOT USE THIS ... last bit! */
@@ -162,6 +168,10 @@ static inline unsigned long long ceph_sanitize_features(unsigned long long f) {
          CEPH_FEATURE_OSD_PROXY_WRITE_FEATURES |         \
 	 CEPH_FEATURE_OSD_HITSET_GMT |			 \
 	 CEPH_FEATURE_HAMMER_0_94_4 |		 \
+	 CEPH_FEATURE_OSD_REPOP_BATCH |		 \
+	 CEPH_FEATURE_OSD_DELTA_RECOVERY |	 \
+	 CEPH_FEATURE_OSD_HITSET_CUCKOO |	 \
+	 CEPH_FEATURE_OSD_OP_BATCH |		 \
 	 0ULL)
 
 #define CEPH_FEATURES_SUPPORTED_DEFAULT  CEPH_FEATURES_ALL
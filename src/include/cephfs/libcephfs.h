@@ -886,6 +886,76 @@ int ceph_fstat(struct ceph_mount_info *cmount, int fd, struct stat *stbuf);
 
 /** @} file */
 
+/**
+ * @defgroup libcephfs_h_async Asynchronous metadata operations.
+ *
+ * These queue the operation and return at once; up to
+ * client_async_threads of them are sent to the MDS at the same time,
+ * so a caller creating or removing many files is not bound by one
+ * round trip per file.  The callback runs in a libcephfs thread with
+ * the result the synchronous call would have returned.  It must not
+ * unmount or release the mount: ceph_unmount() waits for the queued
+ * operations to finish.
+ *
+ * @{
+ */
+
+/**
+ * Completion callback for the asynchronous operations.
+ *
+ * @param cmount the mount the operation ran on.
+ * @param r the result of the operation.
+ * @param arg the argument passed when queueing it.
+ */
+typedef void (*ceph_async_cb_t)(struct ceph_mount_info *cmount, int r,
+				void *arg);
+
+/**
+ * Create and open a file in the background, as ceph_open() with
+ * O_CREAT added to flags.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param path the path of the file to create.
+ * @param flags the flags to open the file with.
+ * @param mode the permissions to create the file with.
+ * @param cb called with the new file descriptor or a negative error code.
+ * @param arg passed to cb.
+ * @returns 0 if the operation was queued or a negative error code.
+ */
+int ceph_create_async(struct ceph_mount_info *cmount, const char *path,
+		      int flags, mode_t mode, ceph_async_cb_t cb, void *arg);
+
+/**
+ * Remove a file, link, or symbolic link in the background, as
+ * ceph_unlink().
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param path the path of the file or link to unlink.
+ * @param cb called with 0 or a negative error code.
+ * @param arg passed to cb.
+ * @returns 0 if the operation was queued or a negative error code.
+ */
+int ceph_unlink_async(struct ceph_mount_info *cmount, const char *path,
+		      ceph_async_cb_t cb, void *arg);
+
+/**
+ * Set a file's attributes in the background, as ceph_setattr().  attr
+ * is copied before the call returns.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param relpath the path of the file.
+ * @param attr the attributes to set.
+ * @param mask a mask of the attributes to set.
+ * @param cb called with 0 or a negative error code.
+ * @param arg passed to cb.
+ * @returns 0 if the operation was queued or a negative error code.
+ */
+int ceph_setattr_async(struct ceph_mount_info *cmount, const char *relpath,
+		       struct stat *attr, int mask, ceph_async_cb_t cb,
+		       void *arg);
+
+/** @} async */
+
 /**
  * @defgroup libcephfs_h_xattr Extended Attribute manipulation and handling.
  * Functions for creating and manipulating extended attributes on files.
@@ -14,6 +14,8 @@
 
 #include <map>
 
+#include "flat_map.h"
+
 template <class Key, class T, class Map>
 class compact_map_base {
 protected:
@@ -61,7 +63,7 @@ protected:
       --it;
       return *this;
     }
-    const std::pair<const Key,T>* operator->() {
+    const typename Map::value_type* operator->() {
       return it.operator->();
     }
   };
@@ -103,7 +105,7 @@ protected:
       --it;
       return *this;
     }
-    std::pair<const Key,T>* operator->() {
+    typename Map::value_type* operator->() {
       return it.operator->();
     }
     operator const_iterator_base<It>() const {
@@ -328,6 +330,31 @@ inline std::ostream& operator<<(std::ostream& out, const compact_map<Key, T>& m)
   return out;
 }
 
+/// a compact_map kept in a flat_map, for maps that stay small
+template <class Key, class T>
+class compact_flat_map : public compact_map_base<Key, T, flat_map<Key,T> > {
+public:
+  T& operator[](const Key& k) {
+    this->alloc_internal();
+    return (*(this->map))[k];
+  }
+};
+
+template <class Key, class T>
+inline std::ostream& operator<<(std::ostream& out, const compact_flat_map<Key, T>& m)
+{
+  out << "{";
+  for (typename compact_flat_map<Key, T>::const_iterator it = m.begin();
+       it != m.end();
+       ++it) {
+    if (it != m.begin())
+      out << ",";
+    out << it->first << "=" << it->second;
+  }
+  out << "}";
+  return out;
+}
+
 template <class Key, class T>
 class compact_multimap : public compact_map_base<Key, T, std::multimap<Key,T> > {
 };
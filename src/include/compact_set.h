@@ -14,6 +14,8 @@
 
 #include <set>
 
+#include "flat_map.h"
+
 template <class T, class Set>
 class compact_set_base {
 protected:
@@ -276,6 +278,11 @@ template <class T>
 class compact_set : public compact_set_base<T, std::set<T> > {
 };
 
+/// a compact_set kept in a flat_set, for sets that stay small
+template <class T>
+class compact_flat_set : public compact_set_base<T, flat_set<T> > {
+};
+
 template <class T>
 inline std::ostream& operator<<(std::ostream& out, const compact_set<T>& s)
 {
@@ -15,6 +15,9 @@
 /* posix_fallocate is supported */
 #cmakedefine HAVE_POSIX_FALLOCATE 
 
+/* pwritev(2) is supported */
+#cmakedefine HAVE_PWRITEV
+
 /* Define if darwin/osx */
 #cmakedefine DARWIN 
 
@@ -29,4 +29,20 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
 	return ceph_crc32c_func(crc, data, length);
 }
 
+/**
+ * calculate crc32c of several independent buffers
+ *
+ * Same as crcs[i] = ceph_crc32c(crcs[i], data[i], lengths[i]) for each
+ * i < n, but where the CPU allows the buffers are walked together so
+ * that their crcs are computed in parallel.
+ *
+ * @param n number of buffers
+ * @param crcs initial values in, crcs out
+ * @param data pointers to data buffers (NULL for zeros)
+ * @param lengths lengths of buffers
+ */
+extern void ceph_crc32c_multi(unsigned n, uint32_t *crcs,
+			      unsigned char const * const *data,
+			      unsigned const *lengths);
+
 #endif
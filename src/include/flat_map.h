@@ -0,0 +1,280 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_FLAT_MAP_H
+#define CEPH_FLAT_MAP_H
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "encoding.h"
+
+/*
+ * Sorted vectors with the parts of the std::map and std::set API that
+ * interval_set, compact_map and compact_set use.
+ *
+ * A std::map node costs three pointers and a color on top of the
+ * value, and walking one chases a pointer per element; here the
+ * values sit back to back, so lookups are a binary search over one
+ * allocation and iteration is a linear scan.  The price is that
+ * inserting or erasing in the middle moves the elements after it, and
+ * invalidates iterators past that point, which is fine for the small
+ * and mostly append-heavy sets (extents, intervals, snaps) these are
+ * meant for, and wrong for large sets that see random inserts.
+ *
+ * Unlike std::map the keys of a flat_map are not const: don't change
+ * them through an iterator.
+ */
+template <class Key, class T, class Compare = std::less<Key> >
+class flat_map {
+public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<Key, T> value_type;
+  typedef std::vector<value_type> vector_type;
+  typedef typename vector_type::iterator iterator;
+  typedef typename vector_type::const_iterator const_iterator;
+  typedef typename vector_type::reverse_iterator reverse_iterator;
+  typedef typename vector_type::const_reverse_iterator const_reverse_iterator;
+  typedef typename vector_type::size_type size_type;
+
+private:
+  vector_type v;
+  Compare cmp;
+
+  struct key_less {
+    const Compare &cmp;
+    key_less(const Compare &c) : cmp(c) {}
+    bool operator()(const value_type &a, const Key &b) const {
+      return cmp(a.first, b);
+    }
+    bool operator()(const Key &a, const value_type &b) const {
+      return cmp(a, b.first);
+    }
+  };
+
+public:
+  iterator begin() { return v.begin(); }
+  iterator end() { return v.end(); }
+  const_iterator begin() const { return v.begin(); }
+  const_iterator end() const { return v.end(); }
+  reverse_iterator rbegin() { return v.rbegin(); }
+  reverse_iterator rend() { return v.rend(); }
+  const_reverse_iterator rbegin() const { return v.rbegin(); }
+  const_reverse_iterator rend() const { return v.rend(); }
+
+  bool empty() const { return v.empty(); }
+  size_type size() const { return v.size(); }
+  void clear() { v.clear(); }
+  void reserve(size_type n) { v.reserve(n); }
+  void swap(flat_map &o) { v.swap(o.v); }
+
+  iterator lower_bound(const Key &k) {
+    return std::lower_bound(v.begin(), v.end(), k, key_less(cmp));
+  }
+  const_iterator lower_bound(const Key &k) const {
+    return std::lower_bound(v.begin(), v.end(), k, key_less(cmp));
+  }
+  iterator upper_bound(const Key &k) {
+    return std::upper_bound(v.begin(), v.end(), k, key_less(cmp));
+  }
+  const_iterator upper_bound(const Key &k) const {
+    return std::upper_bound(v.begin(), v.end(), k, key_less(cmp));
+  }
+  iterator find(const Key &k) {
+    iterator p = lower_bound(k);
+    if (p != v.end() && cmp(k, p->first))
+      return v.end();
+    return p;
+  }
+  const_iterator find(const Key &k) const {
+    const_iterator p = lower_bound(k);
+    if (p != v.end() && cmp(k, p->first))
+      return v.end();
+    return p;
+  }
+  size_type count(const Key &k) const {
+    return find(k) == v.end() ? 0 : 1;
+  }
+
+  std::pair<iterator, bool> insert(const value_type &val) {
+    iterator p = lower_bound(val.first);
+    if (p != v.end() && !cmp(val.first, p->first))
+      return std::make_pair(p, false);
+    return std::make_pair(v.insert(p, val), true);
+  }
+  T& operator[](const Key &k) {
+    iterator p = lower_bound(k);
+    if (p == v.end() || cmp(k, p->first))
+      p = v.insert(p, value_type(k, T()));
+    return p->second;
+  }
+
+  iterator erase(iterator p) {
+    return v.erase(p);
+  }
+  size_type erase(const Key &k) {
+    iterator p = find(k);
+    if (p == v.end())
+      return 0;
+    v.erase(p);
+    return 1;
+  }
+
+  bool operator==(const flat_map &o) const {
+    return v == o.v;
+  }
+  bool operator!=(const flat_map &o) const {
+    return v != o.v;
+  }
+};
+
+template <class T, class Compare = std::less<T> >
+class flat_set {
+public:
+  typedef T key_type;
+  typedef T value_type;
+  typedef std::vector<T> vector_type;
+  // elements must stay sorted: hand out const iterators only
+  typedef typename vector_type::const_iterator iterator;
+  typedef typename vector_type::const_iterator const_iterator;
+  typedef typename vector_type::const_reverse_iterator reverse_iterator;
+  typedef typename vector_type::const_reverse_iterator const_reverse_iterator;
+  typedef typename vector_type::size_type size_type;
+
+private:
+  vector_type v;
+  Compare cmp;
+
+public:
+  const_iterator begin() const { return v.begin(); }
+  const_iterator end() const { return v.end(); }
+  const_reverse_iterator rbegin() const { return v.rbegin(); }
+  const_reverse_iterator rend() const { return v.rend(); }
+
+  bool empty() const { return v.empty(); }
+  size_type size() const { return v.size(); }
+  void clear() { v.clear(); }
+  void reserve(size_type n) { v.reserve(n); }
+  void swap(flat_set &o) { v.swap(o.v); }
+
+  const_iterator lower_bound(const T &t) const {
+    return std::lower_bound(v.begin(), v.end(), t, cmp);
+  }
+  const_iterator upper_bound(const T &t) const {
+    return std::upper_bound(v.begin(), v.end(), t, cmp);
+  }
+  const_iterator find(const T &t) const {
+    const_iterator p = lower_bound(t);
+    if (p != v.end() && cmp(t, *p))
+      return v.end();
+    return p;
+  }
+  size_type count(const T &t) const {
+    return find(t) == v.end() ? 0 : 1;
+  }
+
+  std::pair<iterator, bool> insert(const T &t) {
+    typename vector_type::iterator p =
+      std::lower_bound(v.begin(), v.end(), t, cmp);
+    if (p != v.end() && !cmp(t, *p))
+      return std::make_pair(const_iterator(p), false);
+    return std::make_pair(const_iterator(v.insert(p, t)), true);
+  }
+
+  iterator erase(const_iterator p) {
+    return v.erase(v.begin() + (p - v.begin()));
+  }
+  size_type erase(const T &t) {
+    const_iterator p = find(t);
+    if (p == v.end())
+      return 0;
+    erase(p);
+    return 1;
+  }
+
+  bool operator==(const flat_set &o) const {
+    return v == o.v;
+  }
+  bool operator!=(const flat_set &o) const {
+    return v != o.v;
+  }
+};
+
+// same encoding as std::map and std::set
+
+template<class T, class U, class C>
+inline void encode(const flat_map<T,U,C>& m, bufferlist& bl)
+{
+  __u32 n = (__u32)(m.size());
+  encode(n, bl);
+  for (typename flat_map<T,U,C>::const_iterator p = m.begin(); p != m.end(); ++p) {
+    encode(p->first, bl);
+    encode(p->second, bl);
+  }
+}
+template<class T, class U, class C>
+inline void encode_nohead(const flat_map<T,U,C>& m, bufferlist& bl)
+{
+  for (typename flat_map<T,U,C>::const_iterator p = m.begin(); p != m.end(); ++p) {
+    encode(p->first, bl);
+    encode(p->second, bl);
+  }
+}
+template<class T, class U, class C>
+inline void decode_nohead(int n, flat_map<T,U,C>& m, bufferlist::iterator& p)
+{
+  m.clear();
+  m.reserve(n);
+  while (n--) {
+    T k;
+    decode(k, p);
+    decode(m[k], p);
+  }
+}
+template<class T, class U, class C>
+inline void decode(flat_map<T,U,C>& m, bufferlist::iterator& p)
+{
+  __u32 n;
+  decode(n, p);
+  decode_nohead(n, m, p);
+}
+
+template<class T, class C>
+inline void encode(const flat_set<T,C>& s, bufferlist& bl)
+{
+  __u32 n = (__u32)(s.size());
+  encode(n, bl);
+  for (typename flat_set<T,C>::const_iterator p = s.begin(); p != s.end(); ++p)
+    encode(*p, bl);
+}
+template<class T, class C>
+inline void decode_nohead(int n, flat_set<T,C>& s, bufferlist::iterator& p)
+{
+  s.clear();
+  s.reserve(n);
+  while (n--) {
+    T v;
+    decode(v, p);
+    s.insert(v);
+  }
+}
+template<class T, class C>
+inline void decode(flat_set<T,C>& s, bufferlist::iterator& p)
+{
+  __u32 n;
+  decode(n, p);
+  decode_nohead(n, s, p);
+}
+
+#endif
@@ -31,7 +31,14 @@ using namespace std;
 #endif
 
 
-template<typename T>
+/*
+ * A set of T kept as disjoint, non-adjacent intervals, in a map from
+ * interval start to length.  Map is std::map<T,T> by default; a
+ * flat_map<T,T> (include/flat_map.h) takes much less memory and is
+ * faster to search and walk for sets of a few hundred intervals or
+ * less, or that mostly grow at the end.
+ */
+template<typename T, typename Map = std::map<T,T> >
 class interval_set {
  public:
 
@@ -40,7 +47,7 @@ class interval_set {
   class iterator : public std::iterator <std::forward_iterator_tag, T>
   {
     public:
-        explicit iterator(typename std::map<T,T>::iterator iter)
+        explicit iterator(typename Map::iterator iter)
           : _iter(iter)
         { }
 
@@ -90,17 +97,17 @@ class interval_set {
                 return prev;
         }
 
-    friend class interval_set<T>::const_iterator;
+    friend class interval_set<T,Map>::const_iterator;
 
     protected:
-        typename map<T,T>::iterator _iter;
-    friend class interval_set<T>;
+        typename Map::iterator _iter;
+    friend class interval_set<T,Map>;
   };
 
   class const_iterator : public std::iterator <std::forward_iterator_tag, T>
   {
     public:
-        explicit const_iterator(typename std::map<T,T>::const_iterator iter)
+        explicit const_iterator(typename Map::const_iterator iter)
           : _iter(iter)
         { }
 
@@ -150,7 +157,7 @@ class interval_set {
         }
 
     protected:
-        typename map<T,T>::const_iterator _iter;
+        typename Map::const_iterator _iter;
   };
 
   interval_set() : _size(0) {}
@@ -160,34 +167,34 @@ class interval_set {
     return m.size();
   }
 
-  typename interval_set<T>::iterator begin() {
-    return typename interval_set<T>::iterator(m.begin());
+  typename interval_set<T,Map>::iterator begin() {
+    return typename interval_set<T,Map>::iterator(m.begin());
   }
 
-  typename interval_set<T>::iterator lower_bound(T start) {
-    return typename interval_set<T>::iterator(find_inc_m(start));
+  typename interval_set<T,Map>::iterator lower_bound(T start) {
+    return typename interval_set<T,Map>::iterator(find_inc_m(start));
   }
 
-  typename interval_set<T>::iterator end() {
-    return typename interval_set<T>::iterator(m.end());
+  typename interval_set<T,Map>::iterator end() {
+    return typename interval_set<T,Map>::iterator(m.end());
   }
 
-  typename interval_set<T>::const_iterator begin() const {
-    return typename interval_set<T>::const_iterator(m.begin());
+  typename interval_set<T,Map>::const_iterator begin() const {
+    return typename interval_set<T,Map>::const_iterator(m.begin());
   }
 
-  typename interval_set<T>::const_iterator lower_bound(T start) const {
-    return typename interval_set<T>::const_iterator(find_inc(start));
+  typename interval_set<T,Map>::const_iterator lower_bound(T start) const {
+    return typename interval_set<T,Map>::const_iterator(find_inc(start));
   }
 
-  typename interval_set<T>::const_iterator end() const {
-    return typename interval_set<T>::const_iterator(m.end());
+  typename interval_set<T,Map>::const_iterator end() const {
+    return typename interval_set<T,Map>::const_iterator(m.end());
   }
 
   // helpers
  private:
-  typename map<T,T>::const_iterator find_inc(T start) const {
-    typename map<T,T>::const_iterator p = m.lower_bound(start);  // p->first >= start
+  typename Map::const_iterator find_inc(T start) const {
+    typename Map::const_iterator p = m.lower_bound(start);  // p->first >= start
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might overlap?
@@ -197,8 +204,8 @@ class interval_set {
     return p;
   }
   
-  typename map<T,T>::iterator find_inc_m(T start) {
-    typename map<T,T>::iterator p = m.lower_bound(start);
+  typename Map::iterator find_inc_m(T start) {
+    typename Map::iterator p = m.lower_bound(start);
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might overlap?
@@ -208,8 +215,8 @@ class interval_set {
     return p;
   }
   
-  typename map<T,T>::const_iterator find_adj(T start) const {
-    typename map<T,T>::const_iterator p = m.lower_bound(start);
+  typename Map::const_iterator find_adj(T start) const {
+    typename Map::const_iterator p = m.lower_bound(start);
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might touch?
@@ -219,8 +226,8 @@ class interval_set {
     return p;
   }
   
-  typename map<T,T>::iterator find_adj_m(T start) {
-    typename map<T,T>::iterator p = m.lower_bound(start);
+  typename Map::iterator find_adj_m(T start) {
+    typename Map::iterator p = m.lower_bound(start);
     if (p != m.begin() &&
         (p == m.end() || p->first > start)) {
       p--;   // might touch?
@@ -248,7 +255,7 @@ class interval_set {
   void decode(bufferlist::iterator& bl) {
     ::decode(m, bl);
     _size = 0;
-    for (typename map<T,T>::const_iterator p = m.begin();
+    for (typename Map::const_iterator p = m.begin();
          p != m.end();
          p++)
       _size += p->second;
@@ -256,7 +263,7 @@ class interval_set {
   void decode_nohead(int n, bufferlist::iterator& bl) {
     ::decode_nohead(n, m, bl);
     _size = 0;
-    for (typename map<T,T>::const_iterator p = m.begin();
+    for (typename Map::const_iterator p = m.begin();
          p != m.end();
          p++)
       _size += p->second;
@@ -268,7 +275,7 @@ class interval_set {
   }
 
   bool contains(T i) const {
-    typename map<T,T>::const_iterator p = find_inc(i);
+    typename Map::const_iterator p = find_inc(i);
     if (p == m.end()) return false;
     if (p->first > i) return false;
     if (p->first+p->second <= i) return false;
@@ -276,7 +283,7 @@ class interval_set {
     return true;
   }
   bool contains(T start, T len) const {
-    typename map<T,T>::const_iterator p = find_inc(start);
+    typename Map::const_iterator p = find_inc(start);
     if (p == m.end()) return false;
     if (p->first > start) return false;
     if (p->first+p->second <= start) return false;
@@ -299,12 +306,12 @@ class interval_set {
   }
   T range_start() const {
     assert(!empty());
-    typename map<T,T>::const_iterator p = m.begin();
+    typename Map::const_iterator p = m.begin();
     return p->first;
   }
   T range_end() const {
     assert(!empty());
-    typename map<T,T>::const_iterator p = m.end();
+    typename Map::const_iterator p = m.end();
     p--;
     return p->first+p->second;
   }
@@ -312,20 +319,20 @@ class interval_set {
   // interval start after p (where p not in set)
   bool starts_after(T i) const {
     assert(!contains(i));
-    typename map<T,T>::const_iterator p = find_inc(i);
+    typename Map::const_iterator p = find_inc(i);
     if (p == m.end()) return false;
     return true;
   }
   T start_after(T i) const {
     assert(!contains(i));
-    typename map<T,T>::const_iterator p = find_inc(i);
+    typename Map::const_iterator p = find_inc(i);
     return p->first;
   }
 
   // interval end that contains start
   T end_after(T start) const {
     assert(contains(start));
-    typename map<T,T>::const_iterator p = find_inc(start);
+    typename Map::const_iterator p = find_inc(start);
     return p->first+p->second;
   }
   
@@ -337,7 +344,7 @@ class interval_set {
     //cout << "insert " << start << "~" << len << endl;
     assert(len > 0);
     _size += len;
-    typename map<T,T>::iterator p = find_adj_m(start);
+    typename Map::iterator p = find_adj_m(start);
     if (p == m.end()) {
       m[start] = len;                  // new interval
     } else {
@@ -351,7 +358,7 @@ class interval_set {
         assert(p->first + p->second == start);
         p->second += len;               // append to end
         
-        typename map<T,T>::iterator n = p;
+        typename Map::iterator n = p;
         n++;
         if (n != m.end() && 
             start+len == n->first) {   // combine with next, too!
@@ -360,8 +367,9 @@ class interval_set {
         }
       } else {
         if (start+len == p->first) {
-          m[start] = len + p->second;  // append to front 
-          m.erase(p);
+          T plen = p->second;
+          m.erase(p);                  // before m[] may move it
+          m[start] = len + plen;       // append to front
         } else {
           assert(p->first > start+len);
           m[start] = len;              // new interval
@@ -370,7 +378,7 @@ class interval_set {
     }
   }
 
-  void swap(interval_set<T>& other) {
+  void swap(interval_set<T,Map>& other) {
     m.swap(other.m);
     int64_t t = _size;
     _size = other._size;
@@ -388,7 +396,7 @@ class interval_set {
   }
 
   void erase(T start, T len) {
-    typename map<T,T>::iterator p = find_inc_m(start);
+    typename Map::iterator p = find_inc_m(start);
 
     _size -= len;
     assert(_size >= 0);
@@ -410,14 +418,14 @@ class interval_set {
 
 
   void subtract(const interval_set &a) {
-    for (typename map<T,T>::const_iterator p = a.m.begin();
+    for (typename Map::const_iterator p = a.m.begin();
          p != a.m.end();
          p++)
       erase(p->first, p->second);
   }
 
   void insert(const interval_set &a) {
-    for (typename map<T,T>::const_iterator p = a.m.begin();
+    for (typename Map::const_iterator p = a.m.begin();
          p != a.m.end();
          p++)
       insert(p->first, p->second);
@@ -429,8 +437,8 @@ class interval_set {
     assert(&b != this);
     clear();
 
-    typename map<T,T>::const_iterator pa = a.m.begin();
-    typename map<T,T>::const_iterator pb = b.m.begin();
+    typename Map::const_iterator pa = a.m.begin();
+    typename Map::const_iterator pb = b.m.begin();
     
     while (pa != a.m.end() && pb != b.m.end()) {
       // passing?
@@ -481,7 +489,7 @@ class interval_set {
   }
 
   bool subset_of(const interval_set &big) const {
-    for (typename map<T,T>::const_iterator i = m.begin();
+    for (typename Map::const_iterator i = m.begin();
          i != m.end();
          i++) 
       if (!big.contains(i->first, i->second)) return false;
@@ -495,7 +503,7 @@ class interval_set {
    */
   void span_of(const interval_set &other, T start, T len) {
     clear();
-    typename map<T,T>::const_iterator p = other.find_inc(start);
+    typename Map::const_iterator p = other.find_inc(start);
     if (p == other.m.end())
       return;
     if (p->first < start) {
@@ -526,15 +534,15 @@ class interval_set {
 private:
   // data
   int64_t _size;
-  map<T,T> m;   // map start -> len
+  Map m;   // map start -> len
 };
 
 
-template<class T>
-inline ostream& operator<<(ostream& out, const interval_set<T> &s) {
+template<class T, class Map>
+inline ostream& operator<<(ostream& out, const interval_set<T,Map> &s) {
   out << "[";
   const char *prequel = "";
-  for (typename interval_set<T>::const_iterator i = s.begin();
+  for (typename interval_set<T,Map>::const_iterator i = s.begin();
        i != s.end();
        ++i)
   {
@@ -545,13 +553,13 @@ inline ostream& operator<<(ostream& out, const interval_set<T> &s) {
   return out;
 }
 
-template<class T>
-inline void encode(const interval_set<T>& s, bufferlist& bl)
+template<class T, class Map>
+inline void encode(const interval_set<T,Map>& s, bufferlist& bl)
 {
   s.encode(bl);
 }
-template<class T>
-inline void decode(interval_set<T>& s, bufferlist::iterator& p)
+template<class T, class Map>
+inline void decode(interval_set<T,Map>& s, bufferlist::iterator& p)
 {
   s.decode(p);
 }
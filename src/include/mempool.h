@@ -0,0 +1,212 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_MEMPOOL_H
+#define CEPH_MEMPOOL_H
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <new>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/atomic.h"
+
+namespace ceph {
+  class Formatter;
+}
+
+/*
+ * Memory accounting by subsystem
+ *
+ * Each pool counts the bytes and items allocated through it, in shards
+ * picked by thread so that busy threads don't share cache lines; a
+ * free on another thread than the allocation only moves counts between
+ * shards.  Memory gets into a pool one of two ways:
+ *
+ *  - containers declared with the pool's allocator:
+ *
+ *      mempool::osd_pglog::unordered_map<hobject_t,pg_log_entry_t*> objects;
+ *      mempool::osdmap::vector<int> v;
+ *
+ *  - classes that put MEMPOOL_CLASS_HELPERS(pool) in their body, which
+ *    counts every instance created with new.
+ *
+ * A pool can be given a budget (mempool_budgets).  Nothing fails when a
+ * pool goes over it: the caches that own the memory check over_budget()
+ * and trim.  Bufferlist memory is accounted by buffer::POOL_* and shown
+ * alongside by dump().
+ */
+
+#define DEFINE_MEMORY_POOLS_HELPER(f)	\
+  f(osd_pglog)				\
+  f(osd_obc)				\
+  f(osdmap)				\
+  f(unittest)
+
+namespace mempool {
+
+#define P(x) mempool_##x,
+  enum pool_index_t {
+    DEFINE_MEMORY_POOLS_HELPER(P)
+    num_pools
+  };
+#undef P
+
+  static const int num_shards = 32;
+
+  /// this thread's shard: threads are spread round robin
+  int get_thread_shard();
+
+  struct shard_t {
+    ceph::atomic64_t bytes;
+    ceph::atomic64_t items;
+    char __pad[128 - 2 * sizeof(ceph::atomic64_t)];
+  };
+
+  class pool_t {
+    shard_t shard[num_shards];
+    ceph::atomic64_t budget;
+
+  public:
+    void adjust(int64_t bytes, int64_t items) {
+      shard_t &s = shard[get_thread_shard()];
+      s.bytes.add(bytes);
+      s.items.add(items);
+    }
+    int64_t allocated_bytes() const;
+    int64_t allocated_items() const;
+
+    /// bytes the pool is meant to stay under, 0 for no limit
+    void set_budget(uint64_t b) {
+      budget.set(b);
+    }
+    uint64_t get_budget() const {
+      return budget.read();
+    }
+    bool over_budget() const {
+      uint64_t b = budget.read();
+      return b && allocated_bytes() > (int64_t)b;
+    }
+  };
+
+  pool_t& get_pool(pool_index_t ix);
+  const char *get_pool_name(pool_index_t ix);
+  /// pool_index_t of name, or num_pools
+  pool_index_t get_pool_index(const std::string &name);
+
+  /// parse "pool=bytes[,pool=bytes...]" into the budgets, 0 or -EINVAL
+  int set_budgets(const std::string &s, std::string *err);
+
+  /// every pool, with the buffer::POOL_* byte counts
+  void dump(ceph::Formatter *f);
+
+  template<pool_index_t pool_ix, typename T>
+  class pool_allocator {
+  public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U> struct rebind {
+      typedef pool_allocator<pool_ix, U> other;
+    };
+
+    pool_allocator() {}
+    template<typename U>
+    pool_allocator(const pool_allocator<pool_ix, U>&) {}
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_t n, const void * = 0) {
+      size_t total = sizeof(T) * n;
+      get_pool(pool_ix).adjust(total, n);
+      return static_cast<pointer>(::operator new(total));
+    }
+    void deallocate(pointer p, size_t n) {
+      get_pool(pool_ix).adjust(-(int64_t)(sizeof(T) * n), -(int64_t)n);
+      ::operator delete(p);
+    }
+    size_t max_size() const {
+      return (size_t)-1 / sizeof(T);
+    }
+    template<typename U, typename... Args>
+    void construct(U *p, Args&&... args) {
+      ::new((void *)p) U(std::forward<Args>(args)...);
+    }
+    template<typename U>
+    void destroy(U *p) {
+      p->~U();
+    }
+
+    template<typename U>
+    bool operator==(const pool_allocator<pool_ix, U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const pool_allocator<pool_ix, U>&) const { return false; }
+  };
+
+#define P(x)								\
+  namespace x {								\
+    static const pool_index_t id = mempool_##x;				\
+    template<typename T>						\
+    using pool_allocator = mempool::pool_allocator<id, T>;		\
+    template<typename T>						\
+    using list = std::list<T, pool_allocator<T> >;			\
+    template<typename T>						\
+    using vector = std::vector<T, pool_allocator<T> >;			\
+    template<typename K, typename C = std::less<K> >			\
+    using set = std::set<K, C, pool_allocator<K> >;			\
+    template<typename K, typename V, typename C = std::less<K> >	\
+    using map = std::map<K, V, C,					\
+			 pool_allocator<std::pair<const K, V> > >;	\
+    template<typename K, typename V, typename H = std::hash<K>,	\
+	     typename E = std::equal_to<K> >				\
+    using unordered_map =						\
+      std::unordered_map<K, V, H, E,					\
+			 pool_allocator<std::pair<const K, V> > >;	\
+    template<typename K, typename V, typename H = std::hash<K>,	\
+	     typename E = std::equal_to<K> >				\
+    using unordered_multimap =						\
+      std::unordered_multimap<K, V, H, E,				\
+			      pool_allocator<std::pair<const K, V> > >;	\
+  }
+
+  DEFINE_MEMORY_POOLS_HELPER(P)
+
+#undef P
+
+}
+
+/*
+ * count the instances of a class created with new in a pool: put it in
+ * the class body.  instances built in place (members, make_shared,
+ * containers) are not counted.
+ */
+#define MEMPOOL_CLASS_HELPERS(pool)					\
+  static void *operator new(size_t size) {				\
+    mempool::get_pool(mempool::mempool_##pool).adjust(size, 1);	\
+    return ::operator new(size);					\
+  }									\
+  static void operator delete(void *p, size_t size) {			\
+    mempool::get_pool(mempool::mempool_##pool).adjust(-(int64_t)size, -1); \
+    ::operator delete(p);						\
+  }
+
+#endif
@@ -163,6 +163,9 @@ struct ceph_msg_header {
 	__le32 crc;       /* header crc32c */
 } __attribute__ ((packed));
 
+/* header reserved flags */
+#define CEPH_MSG_HEADER_DATA_COMPRESSED (1<<0) /* data segment is compressed */
+
 #define CEPH_MSG_PRIO_LOW     64
 #define CEPH_MSG_PRIO_DEFAULT 127
 #define CEPH_MSG_PRIO_HIGH    196
@@ -46,11 +46,17 @@ struct object_t {
   void encode(bufferlist &bl) const {
     ::encode(name, bl);
   }
+  void bound_encode(size_t &s) const {
+    ::bound_encode(name, s);
+  }
+  void encode(bounded_encoder &p) const {
+    ::encode(name, p);
+  }
   void decode(bufferlist::iterator &bl) {
     ::decode(name, bl);
   }
 };
-WRITE_CLASS_ENCODER(object_t)
+WRITE_CLASS_ENCODER_BOUNDED(object_t)
 
 inline bool operator==(const object_t& l, const object_t& r) {
   return l.name == r.name;
@@ -117,6 +123,8 @@ struct snapid_t {
 };
 
 inline void encode(snapid_t i, bufferlist &bl) { encode(i.val, bl); }
+inline void encode(snapid_t i, bounded_encoder &p) { encode(i.val, p); }
+inline void bound_encode(snapid_t i, size_t &s) { bound_encode(i.val, s); }
 inline void decode(snapid_t &i, bufferlist::iterator &p) { decode(i.val, p); }
 
 inline ostream& operator<<(ostream& out, snapid_t s) {
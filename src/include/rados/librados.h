@@ -886,6 +886,26 @@ CEPH_RADOS_API void rados_ioctx_set_namespace(rados_ioctx_t io,
 CEPH_RADOS_API int rados_nobjects_list_open(rados_ioctx_t io,
                                             rados_list_ctx_t *ctx);
 
+/**
+ * Start listing one slice of the objects in a pool
+ *
+ * The pool's placement groups are split into n slices of about the
+ * same size.  Listing each of slices 0 to n-1 once lists every object
+ * in the pool once, so the slices can be handed to separate threads or
+ * processes and listed in parallel.  The slice is then read with
+ * rados_nobjects_list_next() and closed with rados_nobjects_list_close()
+ * like any other listing.  Seeking within a slice is not supported.
+ *
+ * @param io the pool to list from
+ * @param n number of slices
+ * @param m the slice to list, 0 to n-1
+ * @param ctx the handle to store list context in
+ * @returns 0 on success, negative error code on failure
+ */
+CEPH_RADOS_API int rados_nobjects_list_open_slice(rados_ioctx_t io,
+                                                  unsigned n, unsigned m,
+                                                  rados_list_ctx_t *ctx);
+
 /**
  * Return hash position of iterator, rounded to the current PG
  *
@@ -2458,6 +2478,33 @@ CEPH_RADOS_API int rados_aio_write_op_operate(rados_write_op_t write_op,
                                               time_t *mtime,
 			                      int flags);
 
+/**
+ * Perform many write operations asynchronously, with one completion
+ *
+ * The operations are handed to the OSDs in one go, with the client
+ * locks taken once, and operations going to the same OSD are sent
+ * together where the OSD supports it.  The completion is complete when
+ * every operation is acked and safe when every one is safe.  Its return
+ * value is 0, or the first error any operation hit.
+ *
+ * @param write_ops operations to perform
+ * @param oids the object id for each operation
+ * @param num number of operations
+ * @param io the ioctx that the objects are in
+ * @param completion what to do when the operations have been attempted
+ * @param flags flags to apply to every operation (LIBRADOS_OPERATION_*)
+ * @param prvals where to store the result of each operation, or NULL;
+ *        must stay valid until the completion is safe
+ * @returns 0 on success, negative error code on failure
+ */
+CEPH_RADOS_API int rados_aio_write_op_operate_many(rados_write_op_t *write_ops,
+                                                   const char **oids,
+                                                   size_t num,
+                                                   rados_ioctx_t io,
+                                                   rados_completion_t completion,
+                                                   int flags,
+                                                   int *prvals);
+
 /**
  * Create a new rados_read_op_t write operation. This will store all
  * actions to be performed atomically. You must call
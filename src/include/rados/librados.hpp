@@ -791,6 +791,16 @@ namespace librados
     NObjectIterator nobjects_begin(uint32_t start_hash_position);
     NObjectIterator nobjects_begin(uint32_t start_hash_position,
                                    const bufferlist &filter);
+    /**
+     * Start enumerating slice m of n of a pool
+     *
+     * Enumerating slices 0 to n-1 visits every object once; see
+     * rados_nobjects_list_open_slice().  The enumeration ends at
+     * nobjects_end() when the slice is done.
+     */
+    NObjectIterator nobjects_begin_slice(unsigned n, unsigned m);
+    NObjectIterator nobjects_begin_slice(unsigned n, unsigned m,
+                                         const bufferlist &filter);
     /// Iterator indicating the end of a pool
     const NObjectIterator& nobjects_end() const;
 
@@ -824,6 +834,22 @@ namespace librados
 
     uint64_t get_last_version();
 
+    /**
+     * Asynchronously read from an object
+     *
+     * If pbl already holds len bytes when this is called, the reply
+     * is received directly into that memory rather than into a buffer
+     * the messenger allocates, which saves large reads a copy when the
+     * caller wants the data in a place of its own.  pbl must not be
+     * touched until the completion fires.
+     *
+     * @param oid the name of the object to read from
+     * @param c what to do when the read is complete
+     * @param pbl where to store the results
+     * @param len the number of bytes to read
+     * @param off the offset to start reading from in the object
+     * @returns 0 on success, negative error code on failure
+     */
     int aio_read(const std::string& oid, AioCompletion *c,
 		 bufferlist *pbl, size_t len, uint64_t off);
     /**
@@ -949,6 +975,27 @@ namespace librados
 		    std::vector<snap_t>& snaps);
     int aio_operate(const std::string& oid, AioCompletion *c,
 		    ObjectReadOperation *op, bufferlist *pbl);
+    /**
+     * Schedule many async write operations with one completion
+     *
+     * All the operations are handed to the OSDs in one go: the client
+     * locks are taken once, and operations going to the same OSD leave
+     * in as few messages as possible (see set_op_batching).  c is
+     * complete when every operation is acked and safe when every one is
+     * safe; its return value is 0, or the first error any of them hit.
+     *
+     * @param oids the objects to operate on
+     * @param ops the operation for each object, in the same order
+     * @param c what to do when the operations are complete
+     * @param flags flags to apply to every operation (OPERATION_*)
+     * @param prvals [out] the result of each operation, or NULL; it
+     *    must not be touched until c is safe
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_operate_many(const std::vector<std::string>& oids,
+			 const std::vector<ObjectWriteOperation*>& ops,
+			 AioCompletion *c, int flags,
+			 std::vector<int> *prvals);
 
     int aio_operate(const std::string& oid, AioCompletion *c,
 		    ObjectReadOperation *op, snap_t snapid, int flags,
@@ -992,6 +1039,20 @@ namespace librados
     int list_snaps(const std::string& o, snap_set_t *out_snaps);
     void set_notify_timeout(uint32_t timeout);
 
+    /**
+     * Let operations go in one message with others for the same OSD
+     *
+     * Operations (ObjectReadOperation and ObjectWriteOperation, sync or
+     * aio) wait up to objecter_batch_window seconds for others to the
+     * same OSD and are sent together, up to objecter_batch_max_ops at a
+     * time.  This trades a little latency for far fewer messages when
+     * an application issues many small independent operations.  Older
+     * OSDs get the operations one at a time, as usual.
+     *
+     * @param on true to batch, false (the default) not to
+     */
+    void set_op_batching(bool on);
+
     /// acknowledge a notify we received.
     void notify_ack(const std::string& o, ///< watched object
 		    uint64_t notify_id,   ///< notify id
@@ -389,12 +389,13 @@ static int omap_insert(cls_method_context_t hctx,
 
   int old_size_int = atoi(string(old_size.c_str(), old_size.length()).c_str());
 
-  CLS_LOG(20, "asserting size is less than %d (bound is %d)", assert_bound, bound);
-  if (old_size_int >= assert_bound) {
+  //a batch of keys must fit as a whole, so that the caller can split first
+  int new_size_int = old_size_int + omap.size() - (assert_bound - bound);
+  CLS_LOG(20, "asserting new size %d is at most %d", new_size_int, bound);
+  if (new_size_int > bound) {
     return -EKEYREJECTED;
   }
 
-  int new_size_int = old_size_int + omap.size() - (assert_bound - bound);
   CLS_LOG(20, "old size is %d, new size is %d", old_size_int, new_size_int);
   bufferlist new_size;
   stringstream s;
@@ -85,6 +85,14 @@ public:
    */
   virtual int set_many(const map<string, bufferlist> &in_map) = 0;
 
+  /**
+   * sets every key in in_map as set would, sending the keys that belong
+   * to the same place together. Not atomic: on error, some of the keys
+   * may have been set.
+   */
+  virtual int set_batch(const map<string, bufferlist> &in_map,
+      bool update_on_existing) = 0;
+
   /**
    * removes the key-value for key. returns an error if key does not exist
    */
@@ -134,6 +142,13 @@ public:
    */
   virtual int get_all_keys_and_values(map<string,bufferlist> *kv_map) = 0;
 
+  /**
+   * stores the keys and values with start <= key < end in kv_map. an
+   * empty end means no upper bound.
+   */
+  virtual int get_range(const string &start, const string &end,
+      map<string,bufferlist> *kv_map) = 0;
+
   /**
    * True if the structure meets its own requirements for consistency.
    */
@@ -1938,6 +1938,88 @@ int KvFlatBtreeAsync::set_many(const map<string, bufferlist> &in_map) {
   return err;
 }
 
+int KvFlatBtreeAsync::set_batch(const map<string, bufferlist> &in_map,
+    bool update_on_existing) {
+  if (verbose) cout << client_name << " is "
+      << (update_on_existing? "updating " : "setting ")
+      << in_map.size() << " keys" << std::endl;
+  int err = 0;
+
+  //group the keys by the object the index puts them in
+  map<string, pair<index_data, map<string, bufferlist> > > groups;
+  for (map<string, bufferlist>::const_iterator it = in_map.begin();
+      it != in_map.end(); ++it) {
+    index_data idata(it->first);
+    err = read_index(it->first, &idata, NULL, false);
+    if (err < 0) {
+      if (verbose) cout << "\t" << client_name
+	  << ": getting oid failed with code "
+	  << err << std::endl;
+      return err;
+    }
+    pair<index_data, map<string, bufferlist> > &g = groups[idata.obj];
+    if (g.second.empty()) {
+      g.first = idata;
+    }
+    g.second.insert(*it);
+  }
+
+  if ((((KeyValueStructure *)this)->*KvFlatBtreeAsync::interrupt)() == 1 ) {
+    if (verbose) cout << client_name << " IS SUICIDING!" << std::endl;
+    return -ESUICIDE;
+  }
+
+  vector<librados::AioCompletion*> aiocs;
+  for (map<string, pair<index_data, map<string, bufferlist> > >::iterator it =
+      groups.begin(); it != groups.end(); ++it) {
+    bufferlist inbl;
+    omap_set_args args;
+    args.bound = 2 * k;
+    args.exclusive = !update_on_existing;
+    args.omap = it->second.second;
+    args.encode(inbl);
+
+    librados::ObjectWriteOperation owo;
+    owo.exec("kvs", "omap_insert", inbl);
+    if (verbose) cout << "\t" << client_name << ": inserting "
+	<< args.omap.size() << " keys into object " << it->first << std::endl;
+    aiocs.push_back(rados.aio_create_completion());
+    io_ctx.aio_operate(it->first, aiocs.back(), &owo);
+  }
+
+  //the groups that failed go through set_op, which splits, rereads the
+  //index and reports -EEXIST for the right keys
+  err = 0;
+  int i = 0;
+  for (map<string, pair<index_data, map<string, bufferlist> > >::iterator it =
+      groups.begin(); it != groups.end(); ++it, ++i) {
+    aiocs[i]->wait_for_safe();
+    int r = aiocs[i]->get_return_value();
+    aiocs[i]->release();
+    if (r == 0) {
+      continue;
+    }
+    if (verbose) cout << "\t" << client_name << ": writing "
+	<< it->first << " failed with " << r << ", setting keys one by one"
+	<< std::endl;
+    for (map<string, bufferlist>::iterator kit = it->second.second.begin();
+	kit != it->second.second.end(); ++kit) {
+      index_data idata = it->second.first;
+      r = set_op(kit->first, kit->second, update_on_existing, idata);
+      if (r == -ESUICIDE) {
+	return r;
+      }
+      if (r < 0 && err == 0) {
+	err = r;
+      }
+    }
+  }
+
+  if (verbose) cout << "\t" << client_name << ": finished set_batch with "
+      << err << std::endl;
+  return err;
+}
+
 int KvFlatBtreeAsync::remove_all() {
   if (verbose) cout << client_name << ": removing all" << std::endl;
   int err = 0;
@@ -1992,8 +2074,8 @@ int KvFlatBtreeAsync::remove_all() {
   return 0;
 }
 
-int KvFlatBtreeAsync::get_all_keys(std::set<std::string> *keys) {
-  if (verbose) cout << client_name << ": getting all keys" << std::endl;
+int KvFlatBtreeAsync::read_index_range(const string &start,
+    const string &end, vector<index_data> *leaves) {
   int err = 0;
   librados::ObjectReadOperation oro;
   std::map<std::string,bufferlist> index_set;
@@ -2003,16 +2085,82 @@ int KvFlatBtreeAsync::get_all_keys(std::set<std::string> *keys) {
     if (verbose) cout << "getting keys failed with error " << err << std::endl;
     return err;
   }
+  leaves->clear();
   for (std::map<std::string,bufferlist>::iterator it = index_set.begin();
       it != index_set.end(); ++it){
-    librados::ObjectReadOperation sub;
-    std::set<std::string> ret;
-    sub.omap_get_keys("",LONG_MAX,&ret,&err);
     index_data idata;
     bufferlist::iterator b = it->second.begin();
     idata.decode(b);
-    io_ctx.operate(idata.obj, &sub, NULL);
-    keys->insert(ret.begin(), ret.end());
+    idata.kdata.parse(it->first);
+    //an object holds the keys after the previous entry, up to its own
+    if (start != "" && idata.kdata < key_data(start)) {
+      continue;
+    }
+    leaves->push_back(idata);
+    if (end != "" && !(idata.kdata < key_data(end))) {
+      break;
+    }
+  }
+  return err;
+}
+
+int KvFlatBtreeAsync::read_leaves(const vector<index_data> &leaves,
+    vector<std::set<string> > *keys,
+    vector<map<string, bufferlist> > *vals) {
+  assert((keys == NULL) != (vals == NULL));
+  if (keys) {
+    keys->clear();
+    keys->resize(leaves.size());
+  } else {
+    vals->clear();
+    vals->resize(leaves.size());
+  }
+  vector<librados::AioCompletion*> aiocs(leaves.size());
+  vector<int> errs(leaves.size(), 0);
+  for (unsigned i = 0; i < leaves.size(); i++) {
+    librados::ObjectReadOperation oro;
+    if (keys) {
+      oro.omap_get_keys("",LONG_MAX,&(*keys)[i],&errs[i]);
+    } else {
+      oro.omap_get_vals("",LONG_MAX,&(*vals)[i],&errs[i]);
+    }
+    aiocs[i] = rados.aio_create_completion();
+    io_ctx.aio_operate(leaves[i].obj, aiocs[i], &oro, NULL);
+  }
+  int err = 0;
+  for (unsigned i = 0; i < leaves.size(); i++) {
+    aiocs[i]->wait_for_complete();
+    int r = aiocs[i]->get_return_value();
+    aiocs[i]->release();
+    if (r == 0) {
+      r = errs[i];
+    }
+    if (r < 0 && err == 0) {
+      if (verbose) cout << client_name << ": reading " << leaves[i].obj
+	  << " failed with " << r << std::endl;
+      err = r;
+    }
+  }
+  return err;
+}
+
+int KvFlatBtreeAsync::get_all_keys(std::set<std::string> *keys) {
+  if (verbose) cout << client_name << ": getting all keys" << std::endl;
+  int err = 0;
+  vector<index_data> leaves;
+  vector<std::set<std::string> > rets;
+  do {
+    err = read_index_range("", "", &leaves);
+    if (err < 0) {
+      return err;
+    }
+    err = read_leaves(leaves, &rets, NULL);
+  } while (err == -ENOENT);
+  if (err < 0) {
+    return err;
+  }
+  for (unsigned i = 0; i < rets.size(); i++) {
+    keys->insert(rets[i].begin(), rets[i].end());
   }
   return err;
 }
@@ -2021,22 +2169,31 @@ int KvFlatBtreeAsync::get_all_keys_and_values(
     map<std::string,bufferlist> *kv_map) {
   if (verbose) cout << client_name << ": getting all keys and values"
       << std::endl;
+  return get_range("", "", kv_map);
+}
+
+int KvFlatBtreeAsync::get_range(const string &start, const string &end,
+    map<std::string,bufferlist> *kv_map) {
+  if (verbose) cout << client_name << ": getting keys from " << start
+      << " to " << end << std::endl;
   int err = 0;
-  librados::ObjectReadOperation first_read;
-  std::set<std::string> index_set;
-  first_read.omap_get_keys("",LONG_MAX,&index_set,&err);
-  io_ctx.operate(index_name, &first_read, NULL);
-  if (err < 0){
-    if (verbose) cout << "getting keys failed with error " << err << std::endl;
+  vector<index_data> leaves;
+  vector<map<std::string, bufferlist> > rets;
+  do {
+    err = read_index_range(start, end, &leaves);
+    if (err < 0) {
+      return err;
+    }
+    err = read_leaves(leaves, NULL, &rets);
+  } while (err == -ENOENT);
+  if (err < 0) {
     return err;
   }
-  for (std::set<std::string>::iterator it = index_set.begin();
-      it != index_set.end(); ++it){
-    librados::ObjectReadOperation sub;
-    map<std::string, bufferlist> ret;
-    sub.omap_get_vals("",LONG_MAX,&ret,&err);
-    io_ctx.operate(*it, &sub, NULL);
-    kv_map->insert(ret.begin(), ret.end());
+  for (unsigned i = 0; i < rets.size(); i++) {
+    map<std::string, bufferlist>::iterator first = rets[i].lower_bound(start);
+    map<std::string, bufferlist>::iterator last =
+	end == "" ? rets[i].end() : rets[i].lower_bound(end);
+    kv_map->insert(first, last);
   }
   return err;
 }
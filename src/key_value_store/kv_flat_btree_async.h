@@ -729,6 +729,24 @@ protected:
    */
   int get_op(const string &key, bufferlist * val, index_data &idata);
 
+  /**
+   * reads the index and finds the objects that may hold keys in
+   * [start, end), in key order. An empty start or end means no bound.
+   */
+  int read_index_range(const string &start, const string &end,
+      vector<index_data> *leaves);
+
+  /**
+   * reads the omaps of all of leaves at once. Exactly one of keys and vals
+   * is not NULL, and is resized to hold one entry per leaf.
+   *
+   * @return -ENOENT if one of the objects went away (i.e., it has been
+   * split or merged since the index was read), or another error.
+   */
+  int read_leaves(const vector<index_data> &leaves,
+      vector<std::set<string> > *keys,
+      vector<map<string, bufferlist> > *vals);
+
   /**
    * does the ObjectWriteOperation and splits, reads the index, and/or retries
    * until success.
@@ -892,9 +910,29 @@ KvFlatBtreeAsync(int k_val, string name, int cache, double cache_r,
    */
   int set_many(const map<string, bufferlist> &in_map);
 
+  /**
+   * Sets each key in in_map as set would, and unlike set_many is safe with
+   * other clients. Keys are grouped by the object the cached index says
+   * they belong to, and each group is written with one omap_insert; the
+   * groups are written in parallel. A group that the object rejects
+   * (because it would need a split, or the index was stale) is retried
+   * one key at a time through set. Not atomic.
+   */
+  int set_batch(const map<string, bufferlist> &in_map,
+      bool update_on_existing);
+
   int get_all_keys(std::set<string> *keys);
   int get_all_keys_and_values(map<string,bufferlist> *kv_map);
 
+  /**
+   * Reads the objects for the range in parallel. Takes no locks; if an
+   * object disappears under a split or merge, rereads the index and starts
+   * over, so the result is what each object held at some point during the
+   * call rather than a snapshot.
+   */
+  int get_range(const string &start, const string &end,
+      map<string,bufferlist> *kv_map);
+
 };
 
 #endif /* KVFLATBTREEASYNC_H_ */
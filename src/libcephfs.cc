@@ -21,6 +21,7 @@
 #include "client/Client.h"
 #include "include/cephfs/libcephfs.h"
 #include "common/Mutex.h"
+#include "common/WorkQueue.h"
 #include "common/ceph_argparse.h"
 #include "common/common_init.h"
 #include "common/config.h"
@@ -40,6 +41,8 @@ public:
       client(NULL),
       monclient(NULL),
       messenger(NULL),
+      async_tp(NULL),
+      async_wq(NULL),
       cct(cct_)
   {
   }
@@ -119,6 +122,11 @@ public:
       shutdown();
       return ret;
     } else {
+      async_tp = new ThreadPool(cct, "libcephfs::async_tp",
+				cct->_conf->client_async_threads,
+				"client_async_threads");
+      async_wq = new ContextWQ("libcephfs::async_wq", 0, async_tp);
+      async_tp->start();
       mounted = true;
       return 0;
     }
@@ -134,6 +142,15 @@ public:
 
   void shutdown()
   {
+    if (async_tp) {
+      // the queued operations need the mount
+      async_wq->drain();
+      async_tp->stop();
+      delete async_wq;
+      async_wq = NULL;
+      delete async_tp;
+      async_tp = NULL;
+    }
     if (mounted) {
       client->unmount();
       mounted = false;
@@ -223,6 +240,11 @@ public:
     return client;
   }
 
+  void queue_async(Context *c)
+  {
+    async_wq->queue(c);
+  }
+
   const char *get_cwd()
   {
     client->getcwd(cwd);
@@ -239,6 +261,9 @@ private:
   Client *client;
   MonClient *monclient;
   Messenger *messenger;
+  /// runs the ceph_*_async() operations, while mounted
+  ThreadPool *async_tp;
+  ContextWQ *async_wq;
   CephContext *cct;
   std::string cwd;
 };
@@ -610,6 +635,87 @@ extern "C" int ceph_setattr(struct ceph_mount_info *cmount, const char *relpath,
   return cmount->get_client()->setattr(relpath, attr, mask);
 }
 
+namespace {
+  struct C_AsyncOp : public Context {
+    struct ceph_mount_info *cmount;
+    ceph_async_cb_t cb;
+    void *arg;
+    C_AsyncOp(struct ceph_mount_info *cmount, ceph_async_cb_t cb, void *arg)
+      : cmount(cmount), cb(cb), arg(arg) {}
+    virtual int run() = 0;
+    void finish(int r) {
+      r = run();
+      cb(cmount, r, arg);
+    }
+  };
+
+  struct C_AsyncCreate : public C_AsyncOp {
+    std::string path;
+    int flags;
+    mode_t mode;
+    C_AsyncCreate(struct ceph_mount_info *cmount, const char *path, int flags,
+		  mode_t mode, ceph_async_cb_t cb, void *arg)
+      : C_AsyncOp(cmount, cb, arg), path(path), flags(flags), mode(mode) {}
+    int run() {
+      return cmount->get_client()->open(path.c_str(), flags | O_CREAT, mode);
+    }
+  };
+
+  struct C_AsyncUnlink : public C_AsyncOp {
+    std::string path;
+    C_AsyncUnlink(struct ceph_mount_info *cmount, const char *path,
+		  ceph_async_cb_t cb, void *arg)
+      : C_AsyncOp(cmount, cb, arg), path(path) {}
+    int run() {
+      return cmount->get_client()->unlink(path.c_str());
+    }
+  };
+
+  struct C_AsyncSetattr : public C_AsyncOp {
+    std::string path;
+    struct stat attr;
+    int mask;
+    C_AsyncSetattr(struct ceph_mount_info *cmount, const char *path,
+		   const struct stat *attr, int mask, ceph_async_cb_t cb,
+		   void *arg)
+      : C_AsyncOp(cmount, cb, arg), path(path), attr(*attr), mask(mask) {}
+    int run() {
+      return cmount->get_client()->setattr(path.c_str(), &attr, mask);
+    }
+  };
+}
+
+extern "C" int ceph_create_async(struct ceph_mount_info *cmount,
+				 const char *path, int flags, mode_t mode,
+				 ceph_async_cb_t cb, void *arg)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  cmount->queue_async(new C_AsyncCreate(cmount, path, flags, mode, cb, arg));
+  return 0;
+}
+
+extern "C" int ceph_unlink_async(struct ceph_mount_info *cmount,
+				 const char *path, ceph_async_cb_t cb,
+				 void *arg)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  cmount->queue_async(new C_AsyncUnlink(cmount, path, cb, arg));
+  return 0;
+}
+
+extern "C" int ceph_setattr_async(struct ceph_mount_info *cmount,
+				  const char *relpath, struct stat *attr,
+				  int mask, ceph_async_cb_t cb, void *arg)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  cmount->queue_async(new C_AsyncSetattr(cmount, relpath, attr, mask, cb,
+					 arg));
+  return 0;
+}
+
 // *xattr() calls supporting samba/vfs
 extern "C" int ceph_getxattr(struct ceph_mount_info *cmount, const char *path, const char *name, void *value, size_t size)
 {
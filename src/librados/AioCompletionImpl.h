@@ -42,6 +42,9 @@ struct librados::AioCompletionImpl {
   bool is_read;
   bufferlist bl;
   bufferlist *blp;
+  // C api: the caller's buffer, which bl is built on
+  char *out_buf;
+  size_t out_len;
 
   IoCtxImpl *io;
   ceph_tid_t aio_write_seq;
@@ -55,7 +58,7 @@ struct librados::AioCompletionImpl {
 			callback_safe(0),
 			callback_complete_arg(0),
 			callback_safe_arg(0),
-			is_read(false), blp(NULL),
+			is_read(false), blp(NULL), out_buf(NULL), out_len(0),
 			io(NULL), aio_write_seq(0), aio_write_list_item(this) { }
 
   int set_complete_callback(void *cb_arg, rados_callback_t cb) {
@@ -27,7 +27,8 @@
 
 librados::IoCtxImpl::IoCtxImpl() :
   ref_cnt(0), client(NULL), poolid(0), assert_ver(0), last_objver(0),
-  notify_timeout(30), aio_write_list_lock("librados::IoCtxImpl::aio_write_list_lock"),
+  notify_timeout(30), op_batching(false),
+  aio_write_list_lock("librados::IoCtxImpl::aio_write_list_lock"),
   aio_write_seq(0), cached_pool_names_lock("librados::IoCtxImpl::cached_pool_names_lock"),
   objecter(NULL)
 {
@@ -38,7 +39,7 @@ librados::IoCtxImpl::IoCtxImpl(RadosClient *c, Objecter *objecter,
   : ref_cnt(0), client(c), poolid(poolid), snap_seq(s),
     assert_ver(0), last_objver(0),
     notify_timeout(c->cct->_conf->client_notify_timeout),
-    oloc(poolid), aio_write_list_lock("librados::IoCtxImpl::aio_write_list_lock"),
+    oloc(poolid), op_batching(false), aio_write_list_lock("librados::IoCtxImpl::aio_write_list_lock"),
     aio_write_seq(0), cached_pool_names_lock("librados::IoCtxImpl::cached_pool_names_lock"),
     objecter(objecter)
 {
@@ -375,6 +376,12 @@ uint32_t librados::IoCtxImpl::nlist_seek(Objecter::NListContext *context,
   return objecter->list_nobjects_seek(context, pos);
 }
 
+void librados::IoCtxImpl::nlist_slice(Objecter::NListContext *context,
+				      unsigned n, unsigned m)
+{
+  objecter->list_nobjects_slice(context, n, m);
+}
+
 int librados::IoCtxImpl::list(Objecter::ListContext *context, int max_entries)
 {
   Cond cond;
@@ -518,6 +525,7 @@ int librados::IoCtxImpl::operate(const object_t& oid, ::ObjectOperation *o,
   Objecter::Op *objecter_op = objecter->prepare_mutate_op(oid, oloc,
 	                                                  *o, snapc, ut, flags,
 	                                                  NULL, oncommit, &ver);
+  objecter_op->batch = op_batching;
   objecter->op_submit(objecter_op);
 
   mylock.Lock();
@@ -553,6 +561,7 @@ int librados::IoCtxImpl::operate_read(const object_t& oid,
   Objecter::Op *objecter_op = objecter->prepare_read_op(oid, oloc,
 	                                      *o, snap_seq, pbl, flags,
 	                                      onack, &ver);
+  objecter_op->batch = op_batching;
   objecter->op_submit(objecter_op);
 
   mylock.Lock();
@@ -581,10 +590,76 @@ int librados::IoCtxImpl::aio_operate_read(const object_t &oid,
   Objecter::Op *objecter_op = objecter->prepare_read_op(oid, oloc,
 		 *o, snap_seq, pbl, flags,
 		 onack, &c->objver);
+  objecter_op->batch = op_batching;
   c->tid = objecter->op_submit(objecter_op);
   return 0;
 }
 
+namespace {
+  // one op of an aio_operate_many batch
+  struct C_aio_BatchSub : public Context {
+    Context *sub;
+    int *prval;
+    C_aio_BatchSub(Context *s, int *pr) : sub(s), prval(pr) {}
+    void finish(int r) {
+      if (prval)
+	*prval = r;
+      sub->complete(r);
+    }
+  };
+}
+
+int librados::IoCtxImpl::aio_operate_many(const vector<object_t>& oids,
+					  const vector< ::ObjectOperation*>& ops,
+					  AioCompletionImpl *c,
+					  const SnapContext& snap_context,
+					  int flags, int *prvals)
+{
+  utime_t ut = ceph_clock_now(client->cct);
+  /* can't write to a snapshot */
+  if (snap_seq != CEPH_NOSNAP)
+    return -EROFS;
+  if (oids.size() != ops.size())
+    return -EINVAL;
+
+  ldout(client->cct, 10) << __func__ << " " << ops.size() << " ops" << dendl;
+
+  Context *onack = new C_aio_Ack(c);
+  Context *oncommit = new C_aio_Safe(c);
+
+  c->io = this;
+  queue_aio_write(c);
+
+  if (ops.empty()) {
+    onack->complete(0);
+    oncommit->complete(0);
+    return 0;
+  }
+
+  // the whole batch completes c once; acks and commits of the single
+  // ops are gathered, each gather ending with the first error (if any)
+  C_GatherBuilder acks(client->cct, onack);
+  C_GatherBuilder commits(client->cct, oncommit);
+
+  vector<Objecter::Op*> objecter_ops;
+  objecter_ops.reserve(ops.size());
+  for (unsigned i = 0; i < ops.size(); ++i) {
+    int *prval = prvals ? &prvals[i] : NULL;
+    objecter_ops.push_back(objecter->prepare_mutate_op(oids[i], oloc,
+		 *ops[i], snap_context, ut, flags,
+		 new C_aio_BatchSub(acks.new_sub(), prval),
+		 new C_aio_BatchSub(commits.new_sub(), prval)));
+  }
+  acks.activate();
+  commits.activate();
+
+  vector<ceph_tid_t> tids;
+  objecter->op_submit_many(objecter_ops, &tids);
+  if (!tids.empty())
+    c->tid = tids.back();
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_operate(const object_t& oid,
 				     ::ObjectOperation *o, AioCompletionImpl *c,
 				     const SnapContext& snap_context, int flags)
@@ -600,8 +675,10 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   c->io = this;
   queue_aio_write(c);
 
-  c->tid = objecter->mutate(oid, oloc, *o, snap_context, ut, flags, onack, oncommit,
-		            &c->objver);
+  Objecter::Op *objecter_op = objecter->prepare_mutate_op(oid, oloc,
+		 *o, snap_context, ut, flags, onack, oncommit, &c->objver);
+  objecter_op->batch = op_batching;
+  c->tid = objecter->op_submit(objecter_op);
 
   return 0;
 }
@@ -636,9 +713,13 @@ int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 
   c->is_read = true;
   c->io = this;
+  // the messenger receives straight into buf; see C_aio_Ack for when
+  // it can not
   c->bl.clear();
   c->bl.push_back(buffer::create_static(len, buf));
   c->blp = &c->bl;
+  c->out_buf = buf;
+  c->out_len = len;
 
   c->tid = objecter->read(oid, oloc,
 		 off, len, snapid, &c->bl, 0,
@@ -1294,6 +1375,11 @@ void librados::IoCtxImpl::set_notify_timeout(uint32_t timeout)
   notify_timeout = timeout;
 }
 
+void librados::IoCtxImpl::set_op_batching(bool on)
+{
+  op_batching = on;
+}
+
 int librados::IoCtxImpl::cache_pin(const object_t& oid)
 {
   ::ObjectOperation wr;
@@ -1332,6 +1418,15 @@ void librados::IoCtxImpl::C_aio_Ack::finish(int r)
     c->rval = c->blp->length();
   }
 
+  // the rx buffer is not posted when the op can time out (#9582), and
+  // the reply then lands in a buffer of the messenger's own
+  if (r >= 0 && c->out_buf && c->bl.length() &&
+      c->bl.buffers().front().c_str() != c->out_buf) {
+    unsigned len = MIN(c->bl.length(), c->out_len);
+    c->bl.copy(0, len, c->out_buf);
+    c->rval = len;
+  }
+
   if (c->callback_complete) {
     c->io->client->finisher.queue(new C_AioComplete(c));
   }
@@ -39,6 +39,7 @@ struct librados::IoCtxImpl {
   version_t last_objver;
   uint32_t notify_timeout;
   object_locator_t oloc;
+  bool op_batching;
 
   Mutex aio_write_list_lock;
   ceph_tid_t aio_write_seq;
@@ -66,6 +67,7 @@ struct librados::IoCtxImpl {
     last_objver = rhs.last_objver;
     notify_timeout = rhs.notify_timeout;
     oloc = rhs.oloc;
+    op_batching = rhs.op_batching;
     objecter = rhs.objecter;
   }
 
@@ -113,6 +115,7 @@ struct librados::IoCtxImpl {
   // io
   int nlist(Objecter::NListContext *context, int max_entries);
   uint32_t nlist_seek(Objecter::NListContext *context, uint32_t pos);
+  void nlist_slice(Objecter::NListContext *context, unsigned n, unsigned m);
   int list(Objecter::ListContext *context, int max_entries);
   uint32_t list_seek(Objecter::ListContext *context, uint32_t pos);
   int create(const object_t& oid, bool exclusive);
@@ -149,6 +152,10 @@ struct librados::IoCtxImpl {
 		  int flags);
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl);
+  int aio_operate_many(const vector<object_t>& oids,
+		       const vector< ::ObjectOperation*>& ops,
+		       AioCompletionImpl *c, const SnapContext& snap_context,
+		       int flags, int *prvals);
 
   struct C_aio_Ack : public Context {
     librados::AioCompletionImpl *c;
@@ -215,6 +222,7 @@ struct librados::IoCtxImpl {
   void set_assert_version(uint64_t ver);
   void set_assert_src_version(const object_t& oid, uint64_t ver);
   void set_notify_timeout(uint32_t timeout);
+  void set_op_batching(bool on);
 
   int cache_pin(const object_t& oid);
   int cache_unpin(const object_t& oid);
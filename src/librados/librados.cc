@@ -1397,6 +1397,26 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
 				  snapc, 0);
 }
 
+int librados::IoCtx::aio_operate_many(const std::vector<std::string>& oids,
+				      const std::vector<ObjectWriteOperation*>& ops,
+				      AioCompletion *c, int flags,
+				      std::vector<int> *prvals)
+{
+  vector<object_t> objs(oids.begin(), oids.end());
+  vector< ::ObjectOperation*> oops;
+  oops.reserve(ops.size());
+  for (vector<ObjectWriteOperation*>::const_iterator p = ops.begin();
+       p != ops.end(); ++p)
+    oops.push_back((::ObjectOperation*)(*p)->impl);
+  if (prvals)
+    prvals->assign(ops.size(), 0);
+  return io_ctx_impl->aio_operate_many(objs, oops, c->pc,
+				       io_ctx_impl->snapc,
+				       translate_flags(flags),
+				       prvals && !prvals->empty() ?
+				         &(*prvals)[0] : NULL);
+}
+
 int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
 				 librados::ObjectReadOperation *o,
 				 bufferlist *pbl)
@@ -1622,6 +1642,31 @@ librados::NObjectIterator librados::IoCtx::nobjects_begin(
   return iter;
 }
 
+librados::NObjectIterator librados::IoCtx::nobjects_begin_slice(unsigned n,
+								unsigned m)
+{
+  bufferlist bl;
+  return nobjects_begin_slice(n, m, bl);
+}
+
+librados::NObjectIterator librados::IoCtx::nobjects_begin_slice(
+  unsigned n, unsigned m, const bufferlist &filter)
+{
+  rados_list_ctx_t listh;
+  int r = rados_nobjects_list_open_slice(io_ctx_impl, n, m, &listh);
+  if (r < 0) {
+    ostringstream oss;
+    oss << "rados returned " << cpp_strerror(r);
+    throw std::runtime_error(oss.str());
+  }
+  NObjectIterator iter((ObjListCtx*)listh);
+  if (filter.length() > 0) {
+    iter.set_filter(filter);
+  }
+  iter.get_next();
+  return iter;
+}
+
 const librados::NObjectIterator& librados::IoCtx::nobjects_end() const
 {
   return NObjectIterator::__EndObjectIterator;
@@ -1853,6 +1898,11 @@ void librados::IoCtx::set_notify_timeout(uint32_t timeout)
   io_ctx_impl->set_notify_timeout(timeout);
 }
 
+void librados::IoCtx::set_op_batching(bool on)
+{
+  io_ctx_impl->set_op_batching(on);
+}
+
 int librados::IoCtx::set_alloc_hint(const std::string& o,
                                     uint64_t expected_object_size,
                                     uint64_t expected_write_size)
@@ -3565,6 +3615,29 @@ extern "C" void rados_nobjects_list_close(rados_list_ctx_t h)
   tracepoint(librados, rados_nobjects_list_close_exit);
 }
 
+extern "C" int rados_nobjects_list_open_slice(rados_ioctx_t io,
+					     unsigned n, unsigned m,
+					     rados_list_ctx_t *listh)
+{
+  tracepoint(librados, rados_nobjects_list_open_slice_enter, io, n, m);
+  if (n == 0 || m >= n) {
+    tracepoint(librados, rados_nobjects_list_open_slice_exit, -EINVAL, NULL);
+    return -EINVAL;
+  }
+  librados::IoCtxImpl *ctx = (librados::IoCtxImpl *)io;
+
+  // PGNLS honours a single namespace as well, so slices always take
+  // the new path
+  Objecter::NListContext *h = new Objecter::NListContext;
+  h->pool_id = ctx->poolid;
+  h->pool_snap_seq = ctx->snap_seq;
+  h->nspace = ctx->oloc.nspace;
+  ctx->nlist_slice(h, n, m);
+  *listh = (void *)new librados::ObjListCtx(ctx, h);
+  tracepoint(librados, rados_nobjects_list_open_slice_exit, 0, *listh);
+  return 0;
+}
+
 extern "C" uint32_t rados_nobjects_list_seek(rados_list_ctx_t listctx,
 					    uint32_t pos)
 {
@@ -4492,6 +4565,31 @@ extern "C" int rados_aio_write_op_operate(rados_write_op_t write_op,
   return retval;
 }
 
+extern "C" int rados_aio_write_op_operate_many(rados_write_op_t *write_ops,
+					       const char **oids,
+					       size_t num,
+					       rados_ioctx_t io,
+					       rados_completion_t completion,
+					       int flags,
+					       int *prvals)
+{
+  tracepoint(librados, rados_aio_write_op_operate_many_enter, write_ops, oids, num, io, completion, flags);
+  librados::IoCtxImpl *ctx = (librados::IoCtxImpl *)io;
+  librados::AioCompletionImpl *c = (librados::AioCompletionImpl*)completion;
+  vector<object_t> objs;
+  vector< ::ObjectOperation*> oops;
+  objs.reserve(num);
+  oops.reserve(num);
+  for (size_t i = 0; i < num; ++i) {
+    objs.push_back(object_t(oids[i]));
+    oops.push_back((::ObjectOperation *)write_ops[i]);
+  }
+  int retval = ctx->aio_operate_many(objs, oops, c, ctx->snapc,
+				     translate_flags(flags), prvals);
+  tracepoint(librados, rados_aio_write_op_operate_many_exit, retval);
+  return retval;
+}
+
 extern "C" rados_read_op_t rados_create_read_op()
 {
   tracepoint(librados, rados_create_read_op_enter);
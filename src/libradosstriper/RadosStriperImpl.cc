@@ -181,6 +181,125 @@ void libradosstriper::RadosStriperImpl::WriteCompletionData::safe(int r) {
   if (m_safe) m_safe->finish(r);
 }
 
+///////////////////////// IoWindow /////////////////////////////
+
+libradosstriper::RadosStriperImpl::IoWindow::IoWindow
+(libradosstriper::RadosStriperImpl *striper,
+ MultiAioCompletionImpl *multiAioCompl,
+ size_t count) :
+  RefCountedObject(striper->cct()),
+  m_multiAioCompl(multiAioCompl),
+  m_lock("libradosstriper::RadosStriperImpl::IoWindow::m_lock"),
+  m_next(0), m_count(count), m_inflight(0),
+  m_max(MAX(striper->cct()->_conf->rados_striper_max_inflight_ios, 1)) {
+  m_multiAioCompl->get();
+}
+
+libradosstriper::RadosStriperImpl::IoWindow::~IoWindow() {
+  m_multiAioCompl->put();
+}
+
+void libradosstriper::RadosStriperImpl::IoWindow::fill() {
+  m_lock.Lock();
+  while (m_inflight < m_max && m_next < m_count) {
+    size_t i = m_next++;
+    m_inflight++;
+    // the completion of extent i may come back to release() before
+    // send() returns
+    m_lock.Unlock();
+    int r = send(i);
+    m_lock.Lock();
+    if (r < 0)
+      m_inflight--;
+  }
+  m_lock.Unlock();
+}
+
+void libradosstriper::RadosStriperImpl::IoWindow::release() {
+  m_lock.Lock();
+  assert(m_inflight > 0);
+  m_inflight--;
+  m_lock.Unlock();
+  fill();
+}
+
+libradosstriper::RadosStriperImpl::WriteWindow::WriteWindow
+(libradosstriper::RadosStriperImpl *striper,
+ MultiAioCompletionImpl *multiAioCompl,
+ std::vector<ObjectExtent> &extents,
+ std::vector<bufferlist> &bls) :
+  IoWindow(striper, multiAioCompl, extents.size()), m_striper(striper) {
+  m_extents.swap(extents);
+  m_bls.swap(bls);
+}
+
+static void rados_req_write_safe(rados_completion_t c, void *arg);
+static void rados_req_write_complete(rados_completion_t c, void *arg);
+
+int libradosstriper::RadosStriperImpl::WriteWindow::send(size_t i) {
+  ObjectExtent &p = m_extents[i];
+  // we need 2 references on data as both rados_req_write_safe and
+  // rados_req_write_complete will release one
+  get();
+  RadosWriteCompletionData *data =
+    new RadosWriteCompletionData(this, m_striper->cct(), 2);
+  librados::AioCompletion *rados_completion =
+    m_striper->m_radosCluster.aio_create_completion(data, rados_req_write_complete,
+						    rados_req_write_safe);
+  int r = m_striper->m_ioCtx.aio_write(p.oid.name, rados_completion, m_bls[i],
+				       p.length, p.offset);
+  rados_completion->release();
+  if (r < 0) {
+    m_multiAioCompl->complete_request(r);
+    m_multiAioCompl->safe_request(r);
+    data->put();
+    data->put();
+    put();
+  }
+  return r;
+}
+
+libradosstriper::RadosStriperImpl::ReadWindow::ReadWindow
+(libradosstriper::RadosStriperImpl *striper,
+ MultiAioCompletionImpl *multiAioCompl,
+ ReadCompletionData *cdata) :
+  IoWindow(striper, multiAioCompl, cdata->m_extents->size()),
+  m_striper(striper), m_cdata(cdata) {
+  m_cdata->get();
+}
+
+libradosstriper::RadosStriperImpl::ReadWindow::~ReadWindow() {
+  m_cdata->put();
+}
+
+static void rados_req_read_safe(rados_completion_t c, void *arg);
+static void rados_req_read_complete(rados_completion_t c, void *arg);
+
+int libradosstriper::RadosStriperImpl::ReadWindow::send(size_t i) {
+  ObjectExtent &p = (*m_cdata->m_extents)[i];
+  bufferlist *oid_bl = &((*m_cdata->m_resultbl)[i]);
+  // we need 2 references on data as both rados_req_read_safe and rados_req_read_complete
+  // will release one
+  get();
+  RadosReadCompletionData *data =
+    new RadosReadCompletionData(m_multiAioCompl, p.length, oid_bl,
+				m_striper->cct(), 2, this);
+  librados::AioCompletion *rados_completion =
+    m_striper->m_radosCluster.aio_create_completion(data, rados_req_read_complete,
+						    rados_req_read_safe);
+  int r = m_striper->m_ioCtx.aio_read(p.oid.name, rados_completion, oid_bl,
+				      p.length, p.offset);
+  rados_completion->release();
+  if (r < 0) {
+    m_multiAioCompl->complete_request(r);
+    m_multiAioCompl->safe_request(r);
+    data->put();
+    data->put();
+    put();
+  }
+  return r;
+}
+
 ///////////////////////// RadosExclusiveLock /////////////////////////////
 
 libradosstriper::RadosStriperImpl::RadosExclusiveLock::RadosExclusiveLock(librados::IoCtx* ioCtx,
@@ -204,7 +323,18 @@ libradosstriper::RadosStriperImpl::RadosExclusiveLock::~RadosExclusiveLock() {
 
 libradosstriper::RadosStriperImpl::RadosStriperImpl(librados::IoCtx& ioctx, librados::IoCtxImpl *ioctx_impl) :
   m_refCnt(0),lock("RadosStriper Refcont", false, false), m_radosCluster(ioctx), m_ioCtx(ioctx), m_ioCtxImpl(ioctx_impl),
-  m_layout(g_default_file_layout) {}
+  m_layout(g_default_file_layout),
+  m_leaseLock("libradosstriper::RadosStriperImpl::m_leaseLock") {}
+
+libradosstriper::RadosStriperImpl::~RadosStriperImpl()
+{
+  // let others remove or truncate our objects without waiting for the
+  // leases to run out
+  for (std::map<std::string, Lease>::iterator it = m_leases.begin();
+       it != m_leases.end();
+       ++it)
+    unlockObject(it->first, it->second.cookie);
+}
 
 ///////////////////////// layout /////////////////////////////
 
@@ -289,13 +419,18 @@ int libradosstriper::RadosStriperImpl::write(const std::string& soid,
 					     size_t len,
 					     uint64_t off) 
 {
-  // open the object. This will create it if needed, retrieve its layout
-  // and size and take a shared lock on it
-  ceph_file_layout layout;
-  std::string lockCookie;
-  int rc = createAndOpenStripedObject(soid, &layout, len+off, &lockCookie, true);
-  if (rc) return rc;
-  return write_in_open_object(soid, layout, lockCookie, bl, len, off);
+  // create a completion object
+  librados::AioCompletionImpl c;
+  // call asynchronous method
+  int rc = aio_write(soid, &c, bl, len, off);
+  if (!rc) {
+    // wait for completion and safety of data
+    c.wait_for_complete_and_cb();
+    c.wait_for_safe_and_cb();
+    // return result
+    rc = c.get_return_value();
+  }
+  return rc;
 }
 
 int libradosstriper::RadosStriperImpl::append(const std::string& soid,
@@ -347,9 +482,14 @@ int libradosstriper::RadosStriperImpl::aio_write(const std::string& soid,
 						 size_t len,
 						 uint64_t off)
 {
+  if (len > 0 && off + len <= m_layout.fl_stripe_unit)
+    return aio_write_small(soid, c, bl, len, off);
+  // open the object. This will create it if needed, retrieve its layout
+  // and size and take a shared lock on it
   ceph_file_layout layout;
+  uint64_t size = len+off;
   std::string lockCookie;
-  int rc = createAndOpenStripedObject(soid, &layout, len+off, &lockCookie, true);
+  int rc = openStripedObjectForWrite(soid, &layout, &size, &lockCookie, true);
   if (rc) return rc;
   return aio_write_in_open_object(soid, c, layout, lockCookie, bl, len, off);
 }
@@ -397,8 +537,13 @@ static void rados_req_read_safe(rados_completion_t c, void *arg)
   // data (0s) will be created on the fly by the rados_req_read_complete method
   if (rc == -ENOENT) rc = 0;
   libradosstriper::MultiAioCompletionImpl *multiAioComp = data->m_multiAioCompl;
+  libradosstriper::RadosStriperImpl::IoWindow *window = data->m_window;
   multiAioComp->safe_request(rc);
   data->put();
+  if (window) {
+    window->release();
+    window->put();
+  }
 }
 
 static void rados_req_read_complete(rados_completion_t c, void *arg)
@@ -470,7 +615,7 @@ int libradosstriper::RadosStriperImpl::aio_read(const std::string& soid,
   libradosstriper::MultiAioCompletionImpl *nc = new libradosstriper::MultiAioCompletionImpl;
   nc->set_complete_callback(cdata, striper_read_aio_req_complete);
   // go through the extents
-  int r = 0, i = 0;
+  int i = 0;
   for (vector<ObjectExtent>::iterator p = extents->begin(); p != extents->end(); ++p) {
     // create a buffer list describing where to place data read from current extend
     bufferlist *oid_bl = &((*resultbl)[i++]);
@@ -483,19 +628,14 @@ int libradosstriper::RadosStriperImpl::aio_read(const std::string& soid,
     }
     // read all extends of a given object in one go
     nc->add_request();
-    // we need 2 references on data as both rados_req_read_safe and rados_req_read_complete
-    // will release one
-    RadosReadCompletionData *data = new RadosReadCompletionData(nc, p->length, oid_bl, cct(), 2);
-    librados::AioCompletion *rados_completion =
-      m_radosCluster.aio_create_completion(data, rados_req_read_complete, rados_req_read_safe);
-    r = m_ioCtx.aio_read(p->oid.name, rados_completion, oid_bl, p->length, p->offset);
-    rados_completion->release();
-    if (r < 0)
-      break;
   }
   nc->finish_adding_requests();
+  // and send them, a window at a time
+  ReadWindow *window = new ReadWindow(this, nc, cdata);
+  window->fill();
+  window->put();
   nc->put();
-  return r;
+  return 0;
 }
 
 int libradosstriper::RadosStriperImpl::aio_read(const std::string& soid,
@@ -553,6 +693,8 @@ int libradosstriper::RadosStriperImpl::stat(const std::string& soid, uint64_t *p
 int libradosstriper::RadosStriperImpl::remove(const std::string& soid)
 {
   std::string firstObjOid = getObjectId(soid, 0);
+  // our own read lease would keep the exclusive lock away
+  dropLease(soid);
   try {
     // lock the object in exclusive mode. Will be released when leaving the scope
     RadosExclusiveLock lock(&m_ioCtx, firstObjOid);
@@ -611,6 +753,7 @@ int libradosstriper::RadosStriperImpl::trunc(const std::string& soid, uint64_t s
 {
   // lock the object in exclusive mode. Will be released when leaving the scope
   std::string firstObjOid = getObjectId(soid, 0);
+  dropLease(soid);
   try {
     RadosExclusiveLock lock(&m_ioCtx, firstObjOid);
     // load layout and size
@@ -650,9 +793,32 @@ int libradosstriper::RadosStriperImpl::closeForWrite(const std::string& soid,
 void libradosstriper::RadosStriperImpl::unlockObject(const std::string& soid,
 						     const std::string& lockCookie)
 {
-  // unlock the shared lock on the first rados object
+  // unlock the shared lock on the first rados object. Nobody waits
+  // for this: later operations on the object from this client are
+  // ordered after it anyway, and aio_flush covers it
+  if (lockCookie.empty())
+    return;
   std::string firstObjOid = getObjectId(soid, 0);
-  m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, lockCookie);
+  librados::ObjectWriteOperation op;
+  rados::cls::lock::unlock(&op, RADOS_LOCK_NAME, lockCookie);
+  librados::AioCompletion *rados_completion = m_radosCluster.aio_create_completion();
+  m_ioCtx.aio_operate(firstObjOid, rados_completion, &op);
+  rados_completion->release();
+}
+
+void libradosstriper::RadosStriperImpl::dropLease(const std::string& soid)
+{
+  std::string cookie;
+  {
+    Mutex::Locker l(m_leaseLock);
+    std::map<std::string, Lease>::iterator it = m_leases.find(soid);
+    if (it == m_leases.end())
+      return;
+    cookie = it->second.cookie;
+    m_leases.erase(it);
+  }
+  // the unlock is ordered before whatever we send to the object next
+  unlockObject(soid, cookie);
 }
 
 static void striper_write_req_complete(rados_striper_multi_completion_t c, void *arg)
@@ -731,18 +897,160 @@ int libradosstriper::RadosStriperImpl::aio_write_in_open_object(const std::strin
   return rc;
 }
 
-static void rados_req_write_safe(rados_completion_t c, void *arg)
+libradosstriper::RadosStriperImpl::SmallWriteData::SmallWriteData
+(libradosstriper::RadosStriperImpl *striper,
+ MultiAioCompletionImpl *multiAioCompl,
+ WriteCompletionData *cdata,
+ const std::string& soid,
+ const bufferlist& bl,
+ size_t len,
+ uint64_t off) :
+  RefCountedObject(striper->cct()),
+  m_striper(striper), m_multiAioCompl(multiAioCompl), m_cdata(cdata),
+  m_soid(soid), m_bl(bl), m_len(len), m_off(off), m_noSizeUpdate(false) {
+  m_multiAioCompl->get();
+  m_cdata->get();
+}
+
+libradosstriper::RadosStriperImpl::SmallWriteData::~SmallWriteData() {
+  m_cdata->put();
+  m_multiAioCompl->put();
+}
+
+static void rados_req_small_write_safe(rados_completion_t c, void *arg)
+{
+  libradosstriper::RadosStriperImpl::SmallWriteData *data =
+    reinterpret_cast<libradosstriper::RadosStriperImpl::SmallWriteData*>(arg);
+  data->m_striper->small_write_done(data, rados_aio_get_return_value(c));
+}
+
+int libradosstriper::RadosStriperImpl::aio_write_small(const std::string& soid,
+						       librados::AioCompletionImpl *c,
+						       const bufferlist& bl,
+						       size_t len,
+						       uint64_t off) {
+  // same completion chain as aio_write_in_open_object, with a single
+  // request. The lock cookie is that of the compound operation, or the
+  // one of the general path if we fall back to it
+  m_ioCtxImpl->get();
+  WriteCompletionData *cdata = new WriteCompletionData(this, soid, getUUID(), c, 2);
+  c->io = m_ioCtxImpl;
+  libradosstriper::MultiAioCompletionImpl *nc = new libradosstriper::MultiAioCompletionImpl;
+  nc->set_complete_callback(cdata, striper_write_aio_req_complete);
+  nc->set_safe_callback(cdata, striper_write_aio_req_safe);
+  nc->add_request();
+  nc->finish_adding_requests();
+  SmallWriteData *data = new SmallWriteData(this, nc, cdata, soid, bl, len, off);
+  int rc = send_small_write(data);
+  if (rc < 0)
+    small_write_done(data, rc);
+  nc->put();
+  return 0;
+}
+
+int libradosstriper::RadosStriperImpl::send_small_write(SmallWriteData *data) {
+  // the data lands at the same offset of the first object for any
+  // stripe unit that holds all of it; nothing else about the layout
+  // matters
+  uint64_t end = data->m_off + data->m_len;
+  librados::ObjectWriteOperation op;
+  op.assert_exists();
+  op.cmpxattr(XATTR_LAYOUT_STRIPE_UNIT, LIBRADOS_CMPXATTR_OP_LTE, end);
+  if (data->m_noSizeUpdate) {
+    op.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_LTE, end);
+  } else {
+    op.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_GT, end);
+    std::ostringstream oss;
+    oss << end;
+    bufferlist bl;
+    bl.append(oss.str());
+    op.setxattr(XATTR_SIZE, bl);
+  }
+  // an exclusive lock, from a remove or a truncation in progress,
+  // fails the whole operation
+  utime_t dur = utime_t();
+  rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, data->m_cdata->m_lockCookie,
+			 "Tag", "", dur, 0);
+  op.write(data->m_off, data->m_bl);
+  librados::AioCompletion *rados_completion =
+    m_radosCluster.aio_create_completion(data, NULL, rados_req_small_write_safe);
+  int rc = m_ioCtx.aio_operate(getObjectId(data->m_soid, 0), rados_completion, &op);
+  rados_completion->release();
+  return rc;
+}
+
+static void striper_small_write_fallback_complete(rados_striper_multi_completion_t c, void *arg)
 {
   libradosstriper::MultiAioCompletionImpl *comp =
+    reinterpret_cast<libradosstriper::MultiAioCompletionImpl*>(c);
+  libradosstriper::MultiAioCompletionImpl *orig =
     reinterpret_cast<libradosstriper::MultiAioCompletionImpl*>(arg);
-  comp->safe_request(rados_aio_get_return_value(c));
+  orig->complete_request(comp->rval);
 }
 
-static void rados_req_write_complete(rados_completion_t c, void *arg)
+static void striper_small_write_fallback_safe(rados_striper_multi_completion_t c, void *arg)
 {
   libradosstriper::MultiAioCompletionImpl *comp =
+    reinterpret_cast<libradosstriper::MultiAioCompletionImpl*>(c);
+  libradosstriper::MultiAioCompletionImpl *orig =
     reinterpret_cast<libradosstriper::MultiAioCompletionImpl*>(arg);
-  comp->complete_request(rados_aio_get_return_value(c));
+  orig->safe_request(comp->rval);
+}
+
+void libradosstriper::RadosStriperImpl::small_write_done(SmallWriteData *data, int rc) {
+  if (rc == -ECANCELED && !data->m_noSizeUpdate) {
+    // either the striped object is already big enough, or its stripe
+    // unit is too small. Try the former
+    data->m_noSizeUpdate = true;
+    rc = send_small_write(data);
+    if (rc >= 0)
+      return;
+  }
+  if (rc == -ECANCELED || rc == -ENOENT || rc == -ENODATA) {
+    // the object does not exist, has no layout or has a smaller stripe
+    // unit: go the general way, whose writes complete our request when
+    // they are done
+    ldout(cct(), 10) << "RadosStriperImpl::small_write_done : " << data->m_soid
+		     << " needs the general write path (" << rc << ")" << dendl;
+    ceph_file_layout layout;
+    uint64_t size = data->m_off + data->m_len;
+    std::string lockCookie;
+    rc = openStripedObjectForWrite(data->m_soid, &layout, &size, &lockCookie, true);
+    if (!rc) {
+      data->m_cdata->m_lockCookie = lockCookie;
+      libradosstriper::MultiAioCompletionImpl *fc = new libradosstriper::MultiAioCompletionImpl;
+      fc->set_complete_callback(data->m_multiAioCompl, striper_small_write_fallback_complete);
+      fc->set_safe_callback(data->m_multiAioCompl, striper_small_write_fallback_safe);
+      // our pending request keeps the original completion alive until then
+      internal_aio_write(data->m_soid, fc, data->m_bl, data->m_len, data->m_off, layout);
+      fc->put();
+      data->put();
+      return;
+    }
+    data->m_cdata->m_lockCookie.clear();
+  }
+  data->m_multiAioCompl->complete_request(rc);
+  data->m_multiAioCompl->safe_request(rc);
+  data->put();
+}
+
+static void rados_req_write_safe(rados_completion_t c, void *arg)
+{
+  libradosstriper::RadosStriperImpl::RadosWriteCompletionData *data =
+    reinterpret_cast<libradosstriper::RadosStriperImpl::RadosWriteCompletionData*>(arg);
+  libradosstriper::RadosStriperImpl::IoWindow *window = data->m_window;
+  window->m_multiAioCompl->safe_request(rados_aio_get_return_value(c));
+  data->put();
+  window->release();
+  window->put();
+}
+
+static void rados_req_write_complete(rados_completion_t c, void *arg)
+{
+  libradosstriper::RadosStriperImpl::RadosWriteCompletionData *data =
+    reinterpret_cast<libradosstriper::RadosStriperImpl::RadosWriteCompletionData*>(arg);
+  data->m_window->m_multiAioCompl->complete_request(rados_aio_get_return_value(c));
+  data->put();
 }
 
 int
@@ -758,10 +1066,11 @@ libradosstriper::RadosStriperImpl::internal_aio_write(const std::string& soid,
   std::string format = soid + RADOS_OBJECT_EXTENSION_FORMAT;
   Striper::file_to_extents(cct(), format.c_str(), &layout, off, len, 0, extents);
   // go through the extents
-  int r = 0;
+  vector<bufferlist> bls(extents.size());
+  int i = 0;
   for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
     // assemble pieces of a given object into a single buffer list
-    bufferlist oid_bl;
+    bufferlist &oid_bl = bls[i++];
     for (vector<pair<uint64_t,uint64_t> >::iterator q = p->buffer_extents.begin();
 	 q != p->buffer_extents.end();
 	 ++q) {
@@ -769,17 +1078,14 @@ libradosstriper::RadosStriperImpl::internal_aio_write(const std::string& soid,
       buffer_bl.substr_of(bl, q->first, q->second);
       oid_bl.append(buffer_bl);
     }    
-    // and write the object
     c->add_request();
-    librados::AioCompletion *rados_completion =
-      m_radosCluster.aio_create_completion(c, rados_req_write_complete, rados_req_write_safe);
-    r = m_ioCtx.aio_write(p->oid.name, rados_completion, oid_bl, p->length, p->offset);
-    rados_completion->release();
-    if (r < 0) 
-      break;
   }    
   c->finish_adding_requests();
-  return r;
+  // and write the objects, a window at a time
+  WriteWindow *window = new WriteWindow(this, c, extents, bls);
+  window->fill();
+  window->put();
+  return 0;
 }
 
 int libradosstriper::RadosStriperImpl::extract_uint32_attr
@@ -853,22 +1159,70 @@ int libradosstriper::RadosStriperImpl::openStripedObjectForRead(const std::strin
 								uint64_t *size,
 								std::string *lockCookie)
 {
+  std::string firstObjOid = getObjectId(soid, 0);
+  double lease = cct()->_conf->rados_striper_lock_lease;
+  utime_t now = ceph_clock_now(cct());
+  uint8_t flags = 0;
+  bool leased = false;
+  if (lease > 0) {
+    Mutex::Locker l(m_leaseLock);
+    std::map<std::string, Lease>::iterator it = m_leases.find(soid);
+    if (it != m_leases.end()) {
+      if ((double)(it->second.expires - now) > lease / 2) {
+	leased = true;
+      } else {
+	*lockCookie = it->second.cookie;
+	flags = LOCK_FLAG_RENEW;
+      }
+    }
+  }
+  if (leased) {
+    // the lease is ours for a while yet: no lock, and nothing to
+    // unlock once the read is done
+    lockCookie->clear();
+    int rc = internal_get_layout_and_size(firstObjOid, layout, size);
+    if (rc)
+      dropLease(soid);
+    return rc;
+  }
+
   // take a lock the first rados object, if it exists and gets its size
   // check, lock and size reading must be atomic and are thus done within a single operation
   librados::ObjectWriteOperation op;
   op.assert_exists();
-  *lockCookie = getUUID();
+  if (!flags)
+    *lockCookie = getUUID();
   utime_t dur = utime_t();
-  rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
-  std::string firstObjOid = getObjectId(soid, 0);
+  if (lease > 0)
+    dur.set_from_double(lease);
+  rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, flags);
   int rc = m_ioCtx.operate(firstObjOid, &op);
   if (rc) {
     // error case (including -ENOENT)
+    if (flags) {
+      Mutex::Locker l(m_leaseLock);
+      m_leases.erase(soid);
+    }
     return rc;
   }
+  std::string cookie = *lockCookie;
+  if (lease > 0) {
+    // the OSD started the lease after we sent the op, so it runs out
+    // there no sooner than here
+    Mutex::Locker l(m_leaseLock);
+    Lease &held = m_leases[soid];
+    held.cookie = cookie;
+    held.expires = now;
+    held.expires += lease;
+    lockCookie->clear();
+  }
   rc = internal_get_layout_and_size(firstObjOid, layout, size);
   if (rc) {
-    m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, *lockCookie);
+    if (lease > 0) {
+      Mutex::Locker l(m_leaseLock);
+      m_leases.erase(soid);
+    }
+    m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, cookie);
     lderr(cct()) << "RadosStriperImpl::openStripedObjectForRead : "
 		 << "could not load layout and size for "
 		 << soid << " : rc = " << rc << dendl;
@@ -882,56 +1236,60 @@ int libradosstriper::RadosStriperImpl::openStripedObjectForWrite(const std::stri
 								 std::string *lockCookie,
 								 bool isFileSizeAbsolute)
 {
-  // take a lock the first rados object, if it exists
-  // check and lock must be atomic and are thus done within a single operation
-  librados::ObjectWriteOperation op;
-  op.assert_exists();
-  *lockCookie = getUUID();
-  utime_t dur = utime_t();
-  rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
+  // get the layout and size first, so that the lock and the size
+  // update can go in a single operation.  The layout cannot change
+  // under us, and the atomic size update does not depend on having
+  // read the size while holding the lock
   std::string firstObjOid = getObjectId(soid, 0);
-  int rc = m_ioCtx.operate(firstObjOid, &op);
-  if (rc) {
-    if (rc == -ENOENT) {
-      // object does not exist, delegate to createEmptyStripedObject
-      int rc = createAndOpenStripedObject(soid, layout, *size, lockCookie, isFileSizeAbsolute);
-      // return original size
-      *size = 0;
-      return rc; 
-    } else {
-      return rc;
-    }
-  }
-  // all fine
+  uint64_t requestedSize = *size;
   uint64_t curSize;
-  rc = internal_get_layout_and_size(firstObjOid, layout, &curSize);
+  int rc = internal_get_layout_and_size(firstObjOid, layout, &curSize);
+  if (rc == -ENOENT) {
+    // object does not exist, delegate to createEmptyStripedObject
+    rc = createAndOpenStripedObject(soid, layout, *size, lockCookie, isFileSizeAbsolute);
+    // return original size
+    *size = 0;
+    return rc;
+  }
   if (rc) {
-    m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, *lockCookie);
     lderr(cct()) << "RadosStriperImpl::openStripedObjectForWrite : "
 		   << "could not load layout and size for "
 		   << soid << " : rc = " << rc << dendl;
     return rc;
   }
-  // atomically update object size, only if smaller than current one
   if (!isFileSizeAbsolute)
     *size += curSize;
-  librados::ObjectWriteOperation writeOp;
-  writeOp.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_GT, *size);
+  // take a lock the first rados object, if it still exists, and
+  // atomically update object size, only if smaller than current one
+  *lockCookie = getUUID();
+  utime_t dur = utime_t();
+  librados::ObjectWriteOperation op;
+  op.assert_exists();
+  rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
+  op.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_GT, *size);
   std::ostringstream oss;
   oss << *size;
   bufferlist bl;
   bl.append(oss.str());
-  writeOp.setxattr(XATTR_SIZE, bl);
-  rc = m_ioCtx.operate(firstObjOid, &writeOp);
+  op.setxattr(XATTR_SIZE, bl);
+  rc = m_ioCtx.operate(firstObjOid, &op);
+  if (-ECANCELED == rc) {
+    // objectsize is already bigger than size, just take the lock
+    librados::ObjectWriteOperation lockOp;
+    lockOp.assert_exists();
+    rados::cls::lock::lock(&lockOp, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
+    rc = m_ioCtx.operate(firstObjOid, &lockOp);
+  }
   // return current size
   *size = curSize;
-  // handle case where objectsize is already bigger than size
-  if (-ECANCELED == rc) 
-    rc = 0;
+  if (rc == -ENOENT) {
+    // removed in the mean time, start again
+    *size = requestedSize;
+    return openStripedObjectForWrite(soid, layout, size, lockCookie, isFileSizeAbsolute);
+  }
   if (rc) {
-    m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, *lockCookie);
     lderr(cct()) << "RadosStriperImpl::openStripedObjectForWrite : "
-		   << "could not set new size for "
+		   << "could not lock and set new size for "
 		   << soid << " : rc = " << rc << dendl;
   }
   return rc;
@@ -964,17 +1322,26 @@ int libradosstriper::RadosStriperImpl::createAndOpenStripedObject(const std::str
   bufferlist bl_stripe_count;
   bl_stripe_count.append(oss_stripe_count.str());
   writeOp.setxattr(XATTR_LAYOUT_STRIPE_COUNT, bl_stripe_count);
-  // size
+  // size. An object we create starts empty, so size is right whether
+  // or not it is absolute
   std::ostringstream oss_size;
-  oss_size << (isFileSizeAbsolute?size:0);
+  oss_size << size;
   bufferlist bl_size;
   bl_size.append(oss_size.str());
   writeOp.setxattr(XATTR_SIZE, bl_size);
+  // and the shared lock, so that a new object is open in a single operation
+  *lockCookie = getUUID();
+  utime_t dur = utime_t();
+  rados::cls::lock::lock(&writeOp, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
   // effectively change attributes
   std::string firstObjOid = getObjectId(soid, 0);
   int rc = m_ioCtx.operate(firstObjOid, &writeOp);
+  if (!rc) {
+    *layout = m_layout;
+    return 0;
+  }
   // in case of error (but no EEXIST which would mean the object existed), return
-  if (rc && -EEXIST != rc) return rc;
+  if (-EEXIST != rc) return rc;
   // Otherwise open the object
   uint64_t fileSize = size;
   return openStripedObjectForWrite(soid, layout, &fileSize, lockCookie, isFileSizeAbsolute);
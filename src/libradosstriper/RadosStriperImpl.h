@@ -15,6 +15,7 @@
 #ifndef CEPH_LIBRADOSSTRIPER_RADOSSTRIPERIMPL_H
 #define CEPH_LIBRADOSSTRIPER_RADOSSTRIPERIMPL_H
 
+#include <map>
 #include <string>
 
 #include "include/atomic.h"
@@ -103,21 +104,124 @@ struct libradosstriper::RadosStriperImpl {
    * struct handling the data needed to pass to the call back
    * function in asynchronous read operations of a Rados File
    */
+  struct IoWindow;
   struct RadosReadCompletionData : RefCountedObject {
     /// constructor
     RadosReadCompletionData(MultiAioCompletionImpl *multiAioCompl,
 			    uint64_t expectedBytes,
 			    bufferlist *bl,
 			    CephContext *context,
-			    int n = 1) :
+			    int n = 1,
+			    IoWindow *window = 0) :
       RefCountedObject(context, n),
-      m_multiAioCompl(multiAioCompl), m_expectedBytes(expectedBytes), m_bl(bl) {};
+      m_multiAioCompl(multiAioCompl), m_expectedBytes(expectedBytes), m_bl(bl),
+      m_window(window) {};
     /// the multi asynch io completion object to be used
     MultiAioCompletionImpl *m_multiAioCompl;
     /// the expected number of bytes
     uint64_t m_expectedBytes;
     /// the bufferlist object where data have been written
     bufferlist *m_bl;
+    /// the window this read has a slot in, if any
+    IoWindow *m_window;
+  };
+
+  /**
+   * struct bounding the number of rados ios a single striped io has
+   * in flight. Every extent is added to the multi asynch io completion
+   * up front, but only rados_striper_max_inflight_ios of them are sent
+   * at once; the others go as earlier ones are safe.
+   */
+  struct IoWindow : RefCountedObject {
+    /// constructor
+    IoWindow(libradosstriper::RadosStriperImpl *striper,
+	     MultiAioCompletionImpl *multiAioCompl,
+	     size_t count);
+    /// destructor
+    virtual ~IoWindow();
+    /// sends extents until the window is full or none is left
+    void fill();
+    /// an extent is safe, its slot goes to the next one
+    void release();
+    /**
+     * sends extent i. In case of error, completes the extent's
+     * requests in the multi asynch io completion with it
+     */
+    virtual int send(size_t i) = 0;
+    /// the multi asynch io completion object to be used
+    MultiAioCompletionImpl *m_multiAioCompl;
+    /// protects the counters below
+    Mutex m_lock;
+    /// next extent to send, and number of extents
+    size_t m_next, m_count;
+    /// extents sent and not yet safe, and the most allowed
+    unsigned m_inflight, m_max;
+  };
+
+  /// window over the extents of a striped write
+  struct WriteWindow : IoWindow {
+    WriteWindow(libradosstriper::RadosStriperImpl *striper,
+		MultiAioCompletionImpl *multiAioCompl,
+		std::vector<ObjectExtent> &extents,
+		std::vector<bufferlist> &bls);
+    int send(size_t i);
+    libradosstriper::RadosStriperImpl *m_striper;
+    /// extents to write and the data going to each
+    std::vector<ObjectExtent> m_extents;
+    std::vector<bufferlist> m_bls;
+  };
+
+  /// window over the extents of a striped read
+  struct ReadWindow : IoWindow {
+    ReadWindow(libradosstriper::RadosStriperImpl *striper,
+	       MultiAioCompletionImpl *multiAioCompl,
+	       ReadCompletionData *cdata);
+    ~ReadWindow();
+    int send(size_t i);
+    libradosstriper::RadosStriperImpl *m_striper;
+    /// owner of the extents and of the buffers they are read into
+    ReadCompletionData *m_cdata;
+  };
+
+  /**
+   * struct handling the data needed to pass to the call back
+   * function in asynchronous write operations of a Rados File
+   */
+  struct RadosWriteCompletionData : RefCountedObject {
+    /// constructor
+    RadosWriteCompletionData(IoWindow *window, CephContext *context, int n = 1) :
+      RefCountedObject(context, n), m_window(window) {};
+    /// the window this write has a slot in
+    IoWindow *m_window;
+  };
+
+  /**
+   * struct handling the data needed to pass to the call back
+   * function of a write within the first stripe unit, which is tried
+   * as a single compound operation on the first rados object
+   */
+  struct SmallWriteData : RefCountedObject {
+    /// constructor
+    SmallWriteData(libradosstriper::RadosStriperImpl *striper,
+		   MultiAioCompletionImpl *multiAioCompl,
+		   WriteCompletionData *cdata,
+		   const std::string& soid,
+		   const bufferlist& bl,
+		   size_t len,
+		   uint64_t off);
+    /// destructor
+    virtual ~SmallWriteData();
+    libradosstriper::RadosStriperImpl *m_striper;
+    /// the multi asynch io completion object holding our single request
+    MultiAioCompletionImpl *m_multiAioCompl;
+    /// the completion data of the whole write, for its lock cookie
+    WriteCompletionData *m_cdata;
+    std::string m_soid;
+    bufferlist m_bl;
+    size_t m_len;
+    uint64_t m_off;
+    /// true once the first try found the striped object big enough
+    bool m_noSizeUpdate;
   };
 
   /**
@@ -153,7 +257,7 @@ struct libradosstriper::RadosStriperImpl {
    */
   RadosStriperImpl(librados::IoCtx& ioctx, librados::IoCtxImpl *ioctx_impl);
   /// Destructor
-  ~RadosStriperImpl() {};
+  ~RadosStriperImpl();
 
   // configuration
   int setObjectLayoutStripeUnit(unsigned int stripe_unit);
@@ -216,6 +320,8 @@ struct libradosstriper::RadosStriperImpl {
 		    const std::string& lockCookie);
   void unlockObject(const std::string& soid,
 		    const std::string& lockCookie);
+  /// give up the read lease on soid, if we hold one
+  void dropLease(const std::string& soid);
 
   // internal versions of IO method
   int write_in_open_object(const std::string& soid,
@@ -231,6 +337,20 @@ struct libradosstriper::RadosStriperImpl {
 			       const bufferlist& bl,
 			       size_t len,
 			       uint64_t off);
+  /**
+   * writes data that falls within the first stripe unit with a single
+   * operation on the first rados object, checking the layout, taking
+   * the shared lock and updating the size as part of it.  Falls back
+   * to the general path if the object is missing or its stripe unit
+   * is too small
+   */
+  int aio_write_small(const std::string& soid,
+		      librados::AioCompletionImpl *c,
+		      const bufferlist& bl,
+		      size_t len,
+		      uint64_t off);
+  int send_small_write(SmallWriteData *data);
+  void small_write_done(SmallWriteData *data, int rc);
   int internal_aio_write(const std::string& soid,
 			 libradosstriper::MultiAioCompletionImpl *c,
 			 const bufferlist& bl,
@@ -333,6 +453,21 @@ struct libradosstriper::RadosStriperImpl {
 
   // Default layout
   ceph_file_layout m_layout;
+
+  /**
+   * Shared locks kept after reads when rados_striper_lock_lease is set.
+   * They are taken with the lease as duration, so the OSD drops them if
+   * we go away, and renewed in the lock op of the read that finds less
+   * than half of the lease left.  In between, reads of the object skip
+   * both the lock and the unlock: holding the lease keeps remove and
+   * trunc, which need the lock exclusive, away.
+   */
+  struct Lease {
+    std::string cookie;
+    utime_t expires;
+  };
+  Mutex m_leaseLock;
+  std::map<std::string, Lease> m_leases;
 };
 
 #endif
@@ -78,6 +78,8 @@ namespace librbd {
       ictx->perfcounter->tinc(l_librbd_discard_latency, elapsed); break;
     case AIO_TYPE_FLUSH:
       ictx->perfcounter->tinc(l_librbd_aio_flush_latency, elapsed); break;
+    case AIO_TYPE_DESTAGE:
+      ictx->perfcounter->tinc(l_librbd_write_log_destage_latency, elapsed); break;
     default:
       lderr(cct) << "completed invalid aio_type: " << aio_type << dendl;
       break;
@@ -26,6 +26,7 @@ namespace librbd {
     AIO_TYPE_WRITE,
     AIO_TYPE_DISCARD,
     AIO_TYPE_FLUSH,
+    AIO_TYPE_DESTAGE,
     AIO_TYPE_NONE,
   } aio_type_t;
 
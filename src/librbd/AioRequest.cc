@@ -11,6 +11,7 @@
 #include "librbd/ImageCtx.h"
 #include "librbd/ImageWatcher.h"
 #include "librbd/internal.h"
+#include "librbd/ParentCache.h"
 
 #include "librbd/AioRequest.h"
 #include "librbd/CopyupRequest.h"
@@ -41,6 +42,23 @@ namespace librbd {
     compute_parent_extents();
   }
 
+  AioRequest::AioRequest(ImageCtx *ictx, const std::string &oid,
+			 uint64_t objectno, uint64_t off, uint64_t len,
+			 librados::snap_t snap_id, uint64_t parent_overlap,
+			 Context *completion,
+			 bool hide_enoent)
+    : m_ictx(ictx), m_oid(oid), m_object_no(objectno), m_object_off(off),
+      m_object_len(len), m_snap_id(snap_id), m_completion(completion),
+      m_hide_enoent(hide_enoent) {
+    // without a parent there is nothing to map back into the image
+    if (parent_overlap > 0) {
+      Striper::extent_to_file(m_ictx->cct, &m_ictx->layout, m_object_no,
+                              0, m_ictx->layout.fl_object_size,
+                              m_parent_extents);
+      m_ictx->prune_parent_extents(m_parent_extents, parent_overlap);
+    }
+  }
+
   void AioRequest::complete(int r)
   {
     if (should_complete(r)) {
@@ -95,12 +113,27 @@ namespace librbd {
                    Context *completion, int op_flags)
     : AioRequest(ictx, oid, objectno, offset, len, snap_id, completion, false),
       m_buffer_extents(be), m_tried_parent(false), m_sparse(sparse),
-      m_op_flags(op_flags), m_parent_completion(NULL),
+      m_op_flags(op_flags), m_cache_fill(false), m_parent_completion(NULL),
       m_state(LIBRBD_AIO_READ_FLAT) {
 
     guard_read();
   }
 
+  AioRead::AioRead(ImageCtx *ictx, const std::string &oid,
+                   uint64_t objectno, uint64_t offset, uint64_t len,
+                   vector<pair<uint64_t,uint64_t> >& be,
+                   librados::snap_t snap_id, uint64_t parent_overlap,
+                   bool sparse, Context *completion, int op_flags)
+    : AioRequest(ictx, oid, objectno, offset, len, snap_id, parent_overlap,
+                 completion, false),
+      m_buffer_extents(be), m_tried_parent(false), m_sparse(sparse),
+      m_op_flags(op_flags), m_cache_fill(false), m_parent_completion(NULL),
+      m_state(LIBRBD_AIO_READ_FLAT) {
+    if (has_parent()) {
+      m_state = LIBRBD_AIO_READ_GUARD;
+    }
+  }
+
   AioRead::~AioRead()
   {
     if (m_parent_completion) {
@@ -126,6 +159,20 @@ namespace librbd {
                            << m_object_off << "~" << m_object_len
                            << " r = " << r << dendl;
 
+    if (m_cache_fill) {
+      m_cache_fill = false;
+      if (r >= 0) {
+	m_ictx->parent_cache->write(m_ictx->data_ctx.get_id(), m_ictx->id,
+				    m_snap_id, m_object_no, m_read_data);
+	bufferlist bl;
+	if (m_read_data.length() > m_object_off) {
+	  bl.substr_of(m_read_data, m_object_off,
+		       MIN(m_object_len, m_read_data.length() - m_object_off));
+	}
+	m_read_data.swap(bl);
+      }
+    }
+
     bool finished = true;
 
     switch (m_state) {
@@ -216,12 +263,27 @@ namespace librbd {
       return;
     }
 
+    // parent snapshots never change, so their objects can be shared
+    if (m_ictx->parent_cache != NULL && m_snap_id != CEPH_NOSNAP) {
+      if (m_ictx->parent_cache->read(m_ictx->data_ctx.get_id(), m_ictx->id,
+				     m_snap_id, m_object_no, m_object_off,
+				     m_object_len, &m_read_data)) {
+	m_ictx->perfcounter->inc(l_librbd_parent_cache_hit);
+	complete(0);
+	return;
+      }
+      m_ictx->perfcounter->inc(l_librbd_parent_cache_miss);
+      m_cache_fill = true;
+    }
+
     librados::AioCompletion *rados_completion =
       librados::Rados::aio_create_completion(this, rados_req_cb, NULL);
     int r;
     librados::ObjectReadOperation op;
     int flags = m_ictx->get_read_flags(m_snap_id);
-    if (m_sparse) {
+    if (m_cache_fill) {
+      op.read(0, m_ictx->layout.fl_object_size, &m_read_data, NULL);
+    } else if (m_sparse) {
       op.sparse_read(m_object_off, m_object_len, &m_ext_map, &m_read_data,
 		     NULL);
     } else {
@@ -288,6 +350,18 @@ namespace librbd {
     m_snaps.insert(m_snaps.end(), snapc.snaps.begin(), snapc.snaps.end());
   }
 
+  AbstractWrite::AbstractWrite(ImageCtx *ictx, const std::string &oid,
+                               uint64_t object_no, uint64_t object_off,
+                               uint64_t len, const ::SnapContext &snapc,
+                               uint64_t parent_overlap, Context *completion,
+                               bool hide_enoent)
+    : AioRequest(ictx, oid, object_no, object_off, len, CEPH_NOSNAP,
+                 parent_overlap, completion, hide_enoent),
+      m_state(LIBRBD_AIO_WRITE_FLAT), m_snap_seq(snapc.seq.val)
+  {
+    m_snaps.insert(m_snaps.end(), snapc.snaps.begin(), snapc.snaps.end());
+  }
+
   void AbstractWrite::guard_write()
   {
     if (has_parent()) {
@@ -505,6 +579,10 @@ namespace librbd {
     }
   }
 
+  bool AioWrite::overwrites_object() const {
+    return m_object_off == 0 && m_object_len == m_ictx->get_object_size();
+  }
+
   void AioWrite::add_write_ops(librados::ObjectWriteOperation *wr) {
     if (m_ictx->enable_alloc_hint && !m_ictx->object_map.object_may_exist(m_object_no))
       wr->set_alloc_hint(m_ictx->get_object_size(), m_ictx->get_object_size());
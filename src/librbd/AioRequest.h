@@ -31,9 +31,18 @@ namespace librbd {
                uint64_t objectno, uint64_t off, uint64_t len,
                librados::snap_t snap_id,
                Context *completion, bool hide_enoent);
+    /// parent_overlap as found by the caller, under snap_lock and parent_lock
+    AioRequest(ImageCtx *ictx, const std::string &oid,
+               uint64_t objectno, uint64_t off, uint64_t len,
+               librados::snap_t snap_id, uint64_t parent_overlap,
+               Context *completion, bool hide_enoent);
     virtual ~AioRequest() {}
 
     virtual void add_copyup_ops(librados::ObjectWriteOperation *wr) {};
+    /// whether this request replaces all of the object's data
+    virtual bool overwrites_object() const {
+      return false;
+    }
 
     void complete(int r);
 
@@ -63,6 +72,11 @@ namespace librbd {
 	    vector<pair<uint64_t,uint64_t> >& be,
 	    librados::snap_t snap_id, bool sparse,
 	    Context *completion, int op_flags);
+    AioRead(ImageCtx *ictx, const std::string &oid,
+	    uint64_t objectno, uint64_t offset, uint64_t len,
+	    vector<pair<uint64_t,uint64_t> >& be, librados::snap_t snap_id,
+	    uint64_t parent_overlap, bool sparse, Context *completion,
+	    int op_flags);
     virtual ~AioRead();
 
     virtual bool should_complete(int r);
@@ -82,6 +96,8 @@ namespace librbd {
     bool m_tried_parent;
     bool m_sparse;
     int m_op_flags;
+    /// reading the whole object to store it in the parent cache
+    bool m_cache_fill;
     ceph::bufferlist m_read_data;
     AioCompletion *m_parent_completion;
 
@@ -118,6 +134,10 @@ namespace librbd {
     AbstractWrite(ImageCtx *ictx, const std::string &oid, uint64_t object_no,
                   uint64_t object_off, uint64_t len, const ::SnapContext &snapc,
 		  Context *completion, bool hide_enoent);
+    AbstractWrite(ImageCtx *ictx, const std::string &oid, uint64_t object_no,
+                  uint64_t object_off, uint64_t len, const ::SnapContext &snapc,
+		  uint64_t parent_overlap, Context *completion,
+		  bool hide_enoent);
     virtual ~AbstractWrite() {}
 
     virtual void add_copyup_ops(librados::ObjectWriteOperation *wr)
@@ -202,11 +222,21 @@ namespace librbd {
 		      completion, false),
 	m_write_data(data), m_op_flags(0) {
     }
+    AioWrite(ImageCtx *ictx, const std::string &oid, uint64_t object_no,
+             uint64_t object_off, const ceph::bufferlist &data,
+             const ::SnapContext &snapc, uint64_t parent_overlap,
+             Context *completion)
+      : AbstractWrite(ictx, oid, object_no, object_off, data.length(), snapc,
+		      parent_overlap, completion, false),
+	m_write_data(data), m_op_flags(0) {
+    }
     virtual ~AioWrite() {}
 
     void set_op_flags(int op_flags) {
       m_op_flags = op_flags;
     }
+
+    virtual bool overwrites_object() const;
   protected:
     virtual void add_write_ops(librados::ObjectWriteOperation *wr);
 
@@ -6,6 +6,7 @@
 #include "librbd/ImageWatcher.h"
 #include "librbd/internal.h"
 #include "librbd/ObjectMap.h"
+#include "librbd/WriteLog.h"
 #include "common/dout.h"
 #include "common/errno.h"
 
@@ -76,6 +77,15 @@ bool AsyncResizeRequest::should_complete(int r) {
   switch (m_state) {
   case STATE_FLUSH:
     ldout(cct, 5) << "FLUSH" << dendl;
+    if (m_image_ctx.write_log != NULL) {
+      send_flush_write_log();
+    } else {
+      send_invalidate_cache();
+    }
+    break;
+
+  case STATE_FLUSH_WRITE_LOG:
+    ldout(cct, 5) << "FLUSH_WRITE_LOG" << dendl;
     send_invalidate_cache();
     break;
 
@@ -163,6 +173,18 @@ void AsyncResizeRequest::send_flush() {
   m_image_ctx.flush_async_operations(create_async_callback_context());
 }
 
+void AsyncResizeRequest::send_flush_write_log() {
+  assert(m_image_ctx.owner_lock.is_locked());
+  ldout(m_image_ctx.cct, 5) << this << " send_flush_write_log: "
+                            << " original_size=" << m_original_size
+                            << " new_size=" << m_new_size << dendl;
+  m_state = STATE_FLUSH_WRITE_LOG;
+
+  // logged writes to the objects we are about to remove would recreate
+  // them if they were destaged after the trim
+  m_image_ctx.write_log->flush(create_async_callback_context());
+}
+
 void AsyncResizeRequest::send_invalidate_cache() {
   assert(m_image_ctx.owner_lock.is_locked());
   ldout(m_image_ctx.cct, 5) << this << " send_invalidate_cache: "
@@ -46,12 +46,15 @@ private:
    *  | (grow)                                                          |
    *  |                                                                 |
    *  |                                                                 |
-   *  \----------> STATE_FLUSH -------------> STATE_INVALIDATE_CACHE    |
+   *  \----------> STATE_FLUSH -------------> STATE_FLUSH_WRITE_LOG     |
    *    (shrink)                                 |                      |
    *                                             |                      |
    *                      /----------------------/                      |
    *                      |                                             |
    *                      v                                             |
+   *              STATE_INVALIDATE_CACHE                                |
+   *                      |                                             |
+   *                      v                                             |
    *              STATE_TRIM_IMAGE --------> STATE_UPDATE_HEADER . . .  |
    *                                             |                   .  |
    *                                             |                   .  |
@@ -60,12 +63,14 @@ private:
    *
    * @endverbatim
    *
-   * The _OBJECT_MAP states are skipped if the object map isn't enabled.
+   * The _OBJECT_MAP states are skipped if the object map isn't enabled,
+   * and STATE_FLUSH_WRITE_LOG if the image has no write log.
    * The state machine will immediately transition to _FINISHED if there
    * are no objects to trim.
    */
   enum State {
     STATE_FLUSH,
+    STATE_FLUSH_WRITE_LOG,
     STATE_INVALIDATE_CACHE,
     STATE_TRIM_IMAGE,
     STATE_GROW_OBJECT_MAP,
@@ -86,6 +91,7 @@ private:
   virtual bool should_complete(int r);
 
   void send_flush();
+  void send_flush_write_log();
   void send_invalidate_cache();
   void send_trim_image();
   void send_grow_object_map();
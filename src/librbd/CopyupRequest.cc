@@ -67,6 +67,33 @@ private:
   size_t m_snap_id_idx;
 };
 
+// drop the zeros at the end of the parent data: reads past the end of
+// the child object return zeros anyway
+void trim_trailing_zeros(bufferlist *bl)
+{
+  uint64_t len = bl->length();
+  const std::list<bufferptr> &buffers = bl->buffers();
+  for (std::list<bufferptr>::const_reverse_iterator it = buffers.rbegin();
+       it != buffers.rend(); ++it) {
+    const char *p = it->c_str();
+    unsigned n = it->length();
+    while (n > 0 && p[n - 1] == 0) {
+      --n;
+    }
+    len -= it->length() - n;
+    if (n > 0) {
+      break;
+    }
+  }
+  if (len < bl->length()) {
+    bufferlist data;
+    if (len > 0) {
+      data.substr_of(*bl, 0, len);
+    }
+    bl->swap(data);
+  }
+}
+
 } // anonymous namespace
 
 
@@ -174,9 +201,37 @@ private:
     return false;
   }
 
+  bool CopyupRequest::can_skip_parent_read()
+  {
+    {
+      // without snapshots nothing will ever see the parent's data
+      RWLock::RLocker snap_locker(m_ictx->snap_lock);
+      if (!m_ictx->snapc.snaps.empty()) {
+	return false;
+      }
+    }
+
+    Mutex::Locker copyup_list_locker(m_ictx->copyup_list_lock);
+    for (size_t i = 0; i < m_pending_requests.size(); ++i) {
+      if (m_pending_requests[i]->overwrites_object()) {
+	return true;
+      }
+    }
+    return false;
+  }
+
   void CopyupRequest::send()
   {
     m_state = STATE_READ_FROM_PARENT;
+    if (can_skip_parent_read()) {
+      ldout(m_ictx->cct, 20) << __func__ << " " << this
+			     << ": oid " << m_oid
+			     << " is overwritten, not reading the parent"
+			     << dendl;
+      complete(0);
+      return;
+    }
+
     AioCompletion *comp = aio_create_completion_internal(
       create_callback_context(), rbd_ctx_cb);
 
@@ -222,6 +277,7 @@ private:
       ldout(cct, 20) << "READ_FROM_PARENT" << dendl;
       remove_from_list();
       if (r >= 0 || r == -ENOENT) {
+        trim_trailing_zeros(&m_copyup_data);
         return send_object_map();
       }
       break;
@@ -52,6 +52,8 @@ namespace librbd {
      * The _OBJECT_MAP state is skipped if the object map isn't enabled or if
      * an object map update isn't required. The _COPYUP state is skipped if
      * no data was read from the parent *and* there are no additional ops.
+     * The parent isn't read at all when one of the pending writes replaces
+     * the whole object and the image has no snapshots to preserve it for.
      */
     enum State {
       STATE_READ_FROM_PARENT,
@@ -79,6 +81,8 @@ namespace librbd {
 
     void remove_from_list();
 
+    bool can_skip_parent_read();
+
     bool send_object_map();
     bool send_copyup();
 
@@ -235,7 +235,11 @@ int DiffIterate::execute() {
   BitVector<2> object_diff_state;
   {
     RWLock::RLocker snap_locker(m_image_ctx.snap_lock);
-    if (m_whole_object && (m_image_ctx.features & RBD_FEATURE_FAST_DIFF) != 0) {
+    // an incremental diff can use the object maps to skip the objects
+    // that did not change, even when it needs the exact extents of the
+    // ones that did
+    if ((m_whole_object || from_snap_id != 0) &&
+        (m_image_ctx.features & RBD_FEATURE_FAST_DIFF) != 0) {
       r = diff_object_map(from_snap_id, end_snap_id, &object_diff_state);
       if (r < 0) {
         ldout(cct, 5) << "fast diff disabled" << dendl;
@@ -295,8 +299,11 @@ int DiffIterate::execute() {
          p != object_extents.end(); ++p) {
       ldout(cct, 20) << "object " << p->first << dendl;
 
-      if (fast_diff_enabled) {
-        const uint64_t object_no = p->second.front().objectno;
+      const uint64_t object_no = p->second.front().objectno;
+      if (fast_diff_enabled && !m_whole_object &&
+          object_diff_state[object_no] == OBJECT_DIFF_STATE_NONE) {
+        ldout(cct, 20) << "object " << p->first << " unchanged" << dendl;
+      } else if (fast_diff_enabled && m_whole_object) {
         if (object_diff_state[object_no] != OBJECT_DIFF_STATE_NONE) {
           bool updated = (object_diff_state[object_no] ==
                             OBJECT_DIFF_STATE_UPDATED);
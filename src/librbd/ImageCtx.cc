@@ -82,7 +82,7 @@ public:
       id(image_id), parent(NULL),
       stripe_unit(0), stripe_count(0), flags(0),
       object_cacher(NULL), writeback_handler(NULL), object_set(NULL),
-      readahead(),
+      write_log(NULL), parent_cache(NULL), readahead(),
       total_bytes_read(0), copyup_finisher(NULL),
       object_map(*this), aio_work_queue(NULL), op_work_queue(NULL)
   {
@@ -107,6 +107,7 @@ public:
 
   ImageCtx::~ImageCtx() {
     perf_stop();
+    assert(write_log == NULL);
     if (object_cacher) {
       delete object_cacher;
       object_cacher = NULL;
@@ -217,6 +218,9 @@ public:
       ldout(cct, 10) << " cache bytes " << cache_size
 	<< " -> about " << obj << " objects" << dendl;
       object_cacher->set_max_objects(obj);
+      if (object_cacher->set_policy(cache_policy) < 0)
+	lderr(cct) << "unknown rbd_cache_policy '" << cache_policy
+		   << "', using lru" << dendl;
 
       object_set = new ObjectCacher::ObjectSet(NULL, data_ctx.get_id(), 0);
       object_set->return_enoent = true;
@@ -230,6 +234,7 @@ public:
 
     readahead.set_trigger_requests(readahead_trigger_requests);
     readahead.set_max_readahead_size(readahead_max_bytes);
+    readahead.set_max_streams(readahead_streams);
 
     return 0;
   }
@@ -292,6 +297,12 @@ public:
     plb.add_u64_counter(l_librbd_resize, "resize", "Resizes");
     plb.add_u64_counter(l_librbd_readahead, "readahead", "Read ahead");
     plb.add_u64_counter(l_librbd_readahead_bytes, "readahead_bytes", "Data size in read ahead");
+    plb.add_time_avg(l_librbd_write_log_destage_latency, "write_log_destage_latency",
+                     "Latency of sending a write log record to the cluster");
+    plb.add_u64_counter(l_librbd_parent_cache_hit, "parent_cache_hit",
+                        "Parent object reads served by the shared cache");
+    plb.add_u64_counter(l_librbd_parent_cache_miss, "parent_cache_miss",
+                        "Parent object reads that missed the shared cache");
 
     perfcounter = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perfcounter);
@@ -628,6 +639,22 @@ public:
     }
   }
 
+  void ImageCtx::write_to_cache(const vector<ObjectExtent>& extents,
+				const bufferlist& bl, Context *onfinish,
+				int fadvise_flags) {
+    // the whole io goes in as one write; the extents' buffer extents
+    // index into bl
+    snap_lock.get_read();
+    ObjectCacher::OSDWrite *wr = object_cacher->prepare_write(snapc, bl,
+							      utime_t(), fadvise_flags);
+    snap_lock.put_read();
+    wr->extents = extents;
+    {
+      Mutex::Locker l(cache_lock);
+      object_cacher->writex(wr, object_set, onfinish);
+    }
+  }
+
   void ImageCtx::user_flushed() {
     if (object_cacher && cache_writethrough_until_flush) {
       md_lock.get_read();
@@ -844,6 +871,7 @@ public:
         "rbd_cache_max_dirty_age", false)(
         "rbd_cache_max_dirty_object", false)(
         "rbd_cache_block_writes_upfront", false)(
+        "rbd_cache_policy", false)(
         "rbd_concurrent_management_ops", false)(
         "rbd_balance_snap_reads", false)(
         "rbd_localize_snap_reads", false)(
@@ -852,10 +880,14 @@ public:
         "rbd_readahead_trigger_requests", false)(
         "rbd_readahead_max_bytes", false)(
         "rbd_readahead_disable_after_bytes", false)(
+        "rbd_readahead_streams", false)(
         "rbd_clone_copy_on_read", false)(
         "rbd_blacklist_on_break_lock", false)(
         "rbd_blacklist_expire_seconds", false)(
-        "rbd_request_timed_out_seconds", false);
+        "rbd_request_timed_out_seconds", false)(
+        "rbd_write_log_path", false)(
+        "rbd_write_log_size", false)(
+        "rbd_write_log_max_destage_ios", false);
 
     string start = METADATA_CONF_PREFIX;
     int r = 0, j = 0;
@@ -912,6 +944,7 @@ public:
     ASSIGN_OPTION(cache_max_dirty_age);
     ASSIGN_OPTION(cache_max_dirty_object);
     ASSIGN_OPTION(cache_block_writes_upfront);
+    ASSIGN_OPTION(cache_policy);
     ASSIGN_OPTION(concurrent_management_ops);
     ASSIGN_OPTION(balance_snap_reads);
     ASSIGN_OPTION(localize_snap_reads);
@@ -920,10 +953,14 @@ public:
     ASSIGN_OPTION(readahead_trigger_requests);
     ASSIGN_OPTION(readahead_max_bytes);
     ASSIGN_OPTION(readahead_disable_after_bytes);
+    ASSIGN_OPTION(readahead_streams);
     ASSIGN_OPTION(clone_copy_on_read);
     ASSIGN_OPTION(blacklist_on_break_lock);
     ASSIGN_OPTION(blacklist_expire_seconds);
     ASSIGN_OPTION(request_timed_out_seconds);
     ASSIGN_OPTION(enable_alloc_hint);
+    ASSIGN_OPTION(write_log_path);
+    ASSIGN_OPTION(write_log_size);
+    ASSIGN_OPTION(write_log_max_destage_ios);
   }
 }
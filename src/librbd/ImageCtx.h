@@ -42,6 +42,8 @@ namespace librbd {
   class AsyncResizeRequest;
   class CopyupRequest;
   class ImageWatcher;
+  class ParentCache;
+  class WriteLog;
 
   struct ImageCtx {
     CephContext *cct;
@@ -67,8 +69,10 @@ namespace librbd {
     std::string snap_name;
     IoCtx data_ctx, md_ctx;
     ImageWatcher *image_watcher;
-    int refresh_seq;    ///< sequence for refresh requests
-    int last_refresh;   ///< last completed refresh
+    // updated under refresh_lock, but ictx_check reads them without it so
+    // that the io path does not take a mutex shared by every io
+    atomic_t refresh_seq;    ///< sequence for refresh requests
+    atomic_t last_refresh;   ///< last completed refresh
 
     /**
      * Lock ordering:
@@ -89,7 +93,7 @@ namespace librbd {
     Mutex cache_lock; // used as client_lock for the ObjectCacher
     RWLock snap_lock; // protects snapshot-related member variables, features, and flags
     RWLock parent_lock; // protects parent_md and parent
-    Mutex refresh_lock; // protects refresh_seq and last_refresh
+    Mutex refresh_lock; // serializes updates of refresh_seq and last_refresh
     RWLock object_map_lock; // protects object map updates and object_map itself
     Mutex async_ops_lock; // protects async_ops and async_requests
     Mutex copyup_list_lock; // protects copyup_waiting_list
@@ -114,6 +118,9 @@ namespace librbd {
     ObjectCacher *object_cacher;
     LibrbdWriteback *writeback_handler;
     ObjectCacher::ObjectSet *object_set;
+    WriteLog *write_log;
+    /// shared cache of this image's objects, when it is opened as a parent
+    ParentCache *parent_cache;
 
     Readahead readahead;
     uint64_t total_bytes_read;
@@ -145,6 +152,7 @@ namespace librbd {
     double cache_max_dirty_age;
     uint32_t cache_max_dirty_object;
     bool cache_block_writes_upfront;
+    std::string cache_policy;
     uint32_t concurrent_management_ops;
     bool balance_snap_reads;
     bool localize_snap_reads;
@@ -153,11 +161,15 @@ namespace librbd {
     uint32_t readahead_trigger_requests;
     uint64_t readahead_max_bytes;
     uint64_t readahead_disable_after_bytes;
+    int readahead_streams;
     bool clone_copy_on_read;
     bool blacklist_on_break_lock;
     uint32_t blacklist_expire_seconds;
     uint32_t request_timed_out_seconds;
     bool enable_alloc_hint;
+    std::string write_log_path;
+    uint64_t write_log_size;
+    int write_log_max_destage_ios;
     static bool _filter_metadata_confs(const string &prefix, std::map<string, bool> &configs,
                                        map<string, bufferlist> &pairs, map<string, bufferlist> *res);
 
@@ -217,6 +229,9 @@ namespace librbd {
 			     int fadvise_flags);
     void write_to_cache(object_t o, const bufferlist& bl, size_t len,
 			uint64_t off, Context *onfinish, int fadvise_flags);
+    void write_to_cache(const vector<ObjectExtent>& extents,
+			const bufferlist& bl, Context *onfinish,
+			int fadvise_flags);
     void user_flushed();
     void flush_cache_aio(Context *onfinish);
     int flush_cache();
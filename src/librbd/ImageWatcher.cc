@@ -6,6 +6,7 @@
 #include "librbd/internal.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/TaskFinisher.h"
+#include "librbd/WriteLog.h"
 #include "cls/lock/cls_lock_client.h"
 #include "cls/lock/cls_lock_types.h"
 #include "include/encoding.h"
@@ -291,10 +292,38 @@ int ImageWatcher::get_lock_owner_info(entity_name_t *locker, std::string *cookie
 }
 
 int ImageWatcher::lock() {
-  int r = rados::cls::lock::lock(&m_image_ctx.md_ctx, m_image_ctx.header_oid,
-				 RBD_LOCK_NAME, LOCK_EXCLUSIVE,
-				 encode_lock_cookie(), WATCHER_LOCK_TAG, "",
-				 utime_t(), 0);
+  int r;
+  while (true) {
+    librados::ObjectWriteOperation op;
+    rados::cls::lock::lock(&op, RBD_LOCK_NAME, LOCK_EXCLUSIVE,
+			   encode_lock_cookie(), WATCHER_LOCK_TAG, "",
+			   utime_t(), 0);
+    // whoever takes the lock invalidates any write log but its own
+    if (m_image_ctx.write_log != NULL) {
+      bufferlist log_bl;
+      log_bl.append(m_image_ctx.write_log->get_uuid());
+      op.setxattr(WriteLog::XATTR, log_bl);
+    } else {
+      // without a log there is only something to remove if another
+      // client left one; the compare keeps that decision atomic
+      bufferlist log_bl;
+      r = m_image_ctx.md_ctx.getxattr(m_image_ctx.header_oid,
+				      WriteLog::XATTR, log_bl);
+      if (r < 0 && r != -ENODATA) {
+	return r;
+      }
+      op.cmpxattr(WriteLog::XATTR, CEPH_OSD_CMPXATTR_OP_EQ, log_bl);
+      if (log_bl.length() > 0) {
+	op.rmxattr(WriteLog::XATTR);
+      }
+    }
+    r = m_image_ctx.md_ctx.operate(m_image_ctx.header_oid, &op);
+    if (r != -ECANCELED) {
+      break;
+    }
+    ldout(m_image_ctx.cct, 10) << this << " write log claim changed, retrying"
+			       << dendl;
+  }
   if (r < 0) {
     return r;
   }
@@ -795,7 +824,7 @@ void ImageWatcher::handle_payload(const HeaderUpdatePayload &payload,
   ldout(m_image_ctx.cct, 10) << this << " image header updated" << dendl;
 
   Mutex::Locker lictx(m_image_ctx.refresh_lock);
-  ++m_image_ctx.refresh_seq;
+  m_image_ctx.refresh_seq.inc();
   m_image_ctx.perfcounter->inc(l_librbd_notify);
 }
 
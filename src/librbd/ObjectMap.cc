@@ -140,9 +140,15 @@ int ObjectMap::unlock()
 bool ObjectMap::object_may_exist(uint64_t object_no) const
 {
   // Fall back to default logic if object map is disabled or invalid
-  if (!m_image_ctx.test_features(RBD_FEATURE_OBJECT_MAP) ||
-      m_image_ctx.test_flags(RBD_FLAG_OBJECT_MAP_INVALID)) {
-    return true;
+  {
+    // this is on every object read: one snap_lock round for both tests
+    RWLock::RLocker snap_locker(m_image_ctx.snap_lock);
+    uint64_t flags = 0;
+    if ((m_image_ctx.features & RBD_FEATURE_OBJECT_MAP) == 0 ||
+        (m_image_ctx.get_flags(m_image_ctx.snap_id, &flags) == 0 &&
+         (flags & RBD_FLAG_OBJECT_MAP_INVALID) != 0)) {
+      return true;
+    }
   }
 
   RWLock::RLocker l(m_image_ctx.object_map_lock);
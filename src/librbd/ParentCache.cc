@@ -0,0 +1,305 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#include "librbd/ParentCache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "include/Context.h"
+#include "include/byteorder.h"
+#include "include/compat.h"
+#include "include/stringify.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::ParentCache: "
+
+namespace librbd {
+
+  namespace {
+
+  const uint64_t HEADER_MAGIC = 0x31636170646272ULL; // "rbdpac1"
+
+  struct header_t {
+    ceph_le64 magic;
+    ceph_le64 length;
+  } __attribute__ ((packed));
+
+  }
+
+  struct ParentCache::C_Write : public Context {
+    ParentCache *cache;
+    std::string name;
+    ceph::bufferlist bl;
+    C_Write(ParentCache *cache, const std::string &name,
+	    const ceph::bufferlist &bl)
+      : cache(cache), name(name), bl(bl) {}
+    virtual void finish(int r) {
+      cache->handle_write(name, bl);
+    }
+  };
+
+  ParentCache::ParentCache(CephContext *cct)
+    : m_cct(cct), m_path(cct->_conf->rbd_parent_cache_path),
+      m_max_bytes(cct->_conf->rbd_parent_cache_size), m_initialized(false),
+      m_lock("librbd::ParentCache::m_lock"), m_bytes(0), m_scanned(false),
+      m_finisher(cct, "librbd::parent_cache")
+  {
+  }
+
+  int ParentCache::init(const std::string &fsid)
+  {
+    Mutex::Locker l(m_lock);
+    if (m_initialized) {
+      return fsid == m_fsid ? 0 : -EINVAL;
+    }
+    if (m_path.empty() || fsid.empty()) {
+      return -EINVAL;
+    }
+
+    std::string path = m_path + "/" + fsid;
+    if ((::mkdir(m_path.c_str(), 0700) < 0 && errno != EEXIST) ||
+	(::mkdir(path.c_str(), 0700) < 0 && errno != EEXIST)) {
+      int r = -errno;
+      lderr(m_cct) << "cannot create " << path << ", not caching parent "
+		   << "images: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+    m_path = path;
+    m_fsid = fsid;
+    m_finisher.start();
+    m_initialized = true;
+    return 0;
+  }
+
+  ParentCache::~ParentCache()
+  {
+    if (enabled()) {
+      m_finisher.wait_for_empty();
+      m_finisher.stop();
+    }
+  }
+
+  std::string ParentCache::file_name(int64_t pool_id,
+				     const std::string &image_id,
+				     librados::snap_t snap_id,
+				     uint64_t object_no)
+  {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%lld.%s.%llx.%016llx", (long long)pool_id,
+	     image_id.c_str(), (unsigned long long)snap_id,
+	     (unsigned long long)object_no);
+    return buf;
+  }
+
+  bool ParentCache::read(int64_t pool_id, const std::string &image_id,
+			 librados::snap_t snap_id, uint64_t object_no,
+			 uint64_t off, uint64_t len, ceph::bufferlist *bl)
+  {
+    std::string name = file_name(pool_id, image_id, snap_id, object_no);
+    std::string path = m_path + "/" + name;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      // another process may have evicted it
+      forget(name);
+      return false;
+    }
+
+    struct stat st;
+    header_t h;
+    int r = ::fstat(fd, &st);
+    if (r < 0) {
+      r = -errno;
+    } else {
+      r = safe_pread_exact(fd, &h, sizeof(h), 0);
+    }
+    if (r == 0 && (h.magic != HEADER_MAGIC ||
+		   (uint64_t)st.st_size != sizeof(h) + h.length)) {
+      r = -EIO;
+    }
+    if (r == 0 && h.length > off) {
+      len = MIN(len, h.length - off);
+      ceph::bufferptr bp(len);
+      ssize_t n = safe_pread_exact(fd, bp.c_str(), len, sizeof(h) + off);
+      if (n < 0) {
+	r = n;
+      } else {
+	bl->push_back(bp);
+      }
+    }
+    if (r == 0) {
+      // let the other users of the directory see it is still wanted
+      ::futimens(fd, NULL);
+    }
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+
+    if (r < 0) {
+      // a short or foreign file: drop it so that it is read and stored
+      // again rather than served
+      lderr(m_cct) << "error reading " << path << ", evicting: "
+		   << cpp_strerror(r) << dendl;
+      ::unlink(path.c_str());
+      forget(name);
+      return false;
+    }
+    ldout(m_cct, 20) << "hit " << name << " " << off << "~" << len << dendl;
+    touch(name, st.st_size);
+    return true;
+  }
+
+  void ParentCache::write(int64_t pool_id, const std::string &image_id,
+			  librados::snap_t snap_id, uint64_t object_no,
+			  const ceph::bufferlist &bl)
+  {
+    std::string name = file_name(pool_id, image_id, snap_id, object_no);
+    m_finisher.queue(new C_Write(this, name, bl));
+  }
+
+  void ParentCache::flush()
+  {
+    m_finisher.wait_for_empty();
+  }
+
+  void ParentCache::touch(const std::string &name, uint64_t size)
+  {
+    Mutex::Locker l(m_lock);
+    std::map<std::string, std::pair<lru_t::iterator, uint64_t> >::iterator p =
+      m_files.find(name);
+    if (p != m_files.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, p->second.first);
+      m_bytes -= p->second.second;
+      p->second.second = size;
+    } else {
+      m_lru.push_front(name);
+      m_files[name] = std::make_pair(m_lru.begin(), size);
+    }
+    m_bytes += size;
+  }
+
+  void ParentCache::forget(const std::string &name)
+  {
+    Mutex::Locker l(m_lock);
+    std::map<std::string, std::pair<lru_t::iterator, uint64_t> >::iterator p =
+      m_files.find(name);
+    if (p != m_files.end()) {
+      m_bytes -= p->second.second;
+      m_lru.erase(p->second.first);
+      m_files.erase(p);
+    }
+  }
+
+  void ParentCache::handle_write(const std::string &name,
+				 ceph::bufferlist &bl)
+  {
+    std::string path = m_path + "/" + name;
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0) {
+      // a racing reader, here or in another process, got there first
+      return;
+    }
+
+    std::string tmp_path = path + ".tmp." + stringify(getpid());
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+      int r = -errno;
+      lderr(m_cct) << "cannot create " << tmp_path << ": " << cpp_strerror(r)
+		   << dendl;
+      return;
+    }
+    header_t h;
+    h.magic = HEADER_MAGIC;
+    h.length = bl.length();
+    int r = safe_write(fd, &h, sizeof(h));
+    if (r == 0) {
+      r = bl.write_fd(fd);
+    }
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    if (r == 0 && ::rename(tmp_path.c_str(), path.c_str()) < 0) {
+      r = -errno;
+    }
+    if (r < 0) {
+      lderr(m_cct) << "error writing " << path << ": " << cpp_strerror(r)
+		   << dendl;
+      ::unlink(tmp_path.c_str());
+      return;
+    }
+
+    ldout(m_cct, 20) << "stored " << name << " " << bl.length() << dendl;
+    touch(name, sizeof(h) + bl.length());
+    trim();
+  }
+
+  void ParentCache::scan()
+  {
+    assert(m_lock.is_locked());
+    DIR *dir = ::opendir(m_path.c_str());
+    if (dir == NULL) {
+      int r = -errno;
+      lderr(m_cct) << "cannot list " << m_path << ": " << cpp_strerror(r)
+		   << dendl;
+      return;
+    }
+
+    std::vector<std::pair<time_t, std::pair<std::string, uint64_t> > > files;
+    struct dirent *de;
+    while ((de = ::readdir(dir)) != NULL) {
+      std::string name(de->d_name);
+      if (name[0] == '.' || name.find(".tmp.") != std::string::npos) {
+	continue;
+      }
+      struct stat st;
+      if (::fstatat(dirfd(dir), de->d_name, &st, 0) < 0 ||
+	  !S_ISREG(st.st_mode)) {
+	continue;
+      }
+      files.push_back(std::make_pair(st.st_mtime,
+				     std::make_pair(name, st.st_size)));
+    }
+    ::closedir(dir);
+
+    // newest first, to match m_lru
+    std::sort(files.rbegin(), files.rend());
+    m_lru.clear();
+    m_files.clear();
+    m_bytes = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+      m_lru.push_back(files[i].second.first);
+      m_files[files[i].second.first] =
+	std::make_pair(--m_lru.end(), files[i].second.second);
+      m_bytes += files[i].second.second;
+    }
+  }
+
+  void ParentCache::trim()
+  {
+    Mutex::Locker l(m_lock);
+    if (m_scanned && m_bytes <= m_max_bytes) {
+      return;
+    }
+
+    // other processes add files too: look at what is really there
+    scan();
+    m_scanned = true;
+    while (m_bytes > m_max_bytes && !m_lru.empty()) {
+      std::string name = m_lru.back();
+      std::string path = m_path + "/" + name;
+      ldout(m_cct, 20) << "evicting " << name << dendl;
+      ::unlink(path.c_str());
+      m_bytes -= m_files[name].second;
+      m_files.erase(name);
+      m_lru.pop_back();
+    }
+  }
+
+}
@@ -0,0 +1,100 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_PARENTCACHE_H
+#define CEPH_LIBRBD_PARENTCACHE_H
+
+#include "include/int_types.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "common/Finisher.h"
+#include "common/Mutex.h"
+#include "include/buffer.h"
+#include "include/rados/librados.hpp"
+
+class CephContext;
+
+namespace librbd {
+
+  /**
+   * Host-wide, read-only cache of parent image objects
+   *
+   * A parent snapshot never changes, so whole objects read from one can
+   * be kept in files under rbd_parent_cache_path/<cluster fsid>, named
+   * by pool, image, snapshot and object number, and shared by every
+   * librbd instance on the host that opens a clone of that parent.  The
+   * directories and files are private to the user owning them.  Files
+   * are written to a temporary name and renamed into place, so readers
+   * only ever see complete objects; each starts with a header recording
+   * the object length, and a file that does not match it is evicted
+   * rather than served.  The directory is kept under
+   * rbd_parent_cache_size bytes by evicting the least recently read
+   * files; hits bump the file mtime so that the processes sharing the
+   * directory agree on the order.
+   *
+   * There is one per CephContext; see ImageCtx::parent_cache.
+   */
+  class ParentCache {
+  public:
+    ParentCache(CephContext *cct);
+    ~ParentCache();
+
+    /**
+     * create the cache directory for the cluster with the given fsid
+     *
+     * A CephContext only ever talks to one cluster, so later calls must
+     * pass the same fsid.
+     *
+     * @return 0 on success, negative error code otherwise
+     */
+    int init(const std::string &fsid);
+
+    bool enabled() const {
+      return m_initialized;
+    }
+
+    /// read off~len of a cached object into bl; false if it is not cached
+    bool read(int64_t pool_id, const std::string &image_id,
+	      librados::snap_t snap_id, uint64_t object_no, uint64_t off,
+	      uint64_t len, ceph::bufferlist *bl);
+    /// store a whole object in the background
+    void write(int64_t pool_id, const std::string &image_id,
+	       librados::snap_t snap_id, uint64_t object_no,
+	       const ceph::bufferlist &bl);
+    /// wait for queued writes to be stored
+    void flush();
+
+  private:
+    struct C_Write;
+
+    typedef std::list<std::string> lru_t;
+
+    CephContext *m_cct;
+    std::string m_path;
+    uint64_t m_max_bytes;
+    std::string m_fsid;
+    bool m_initialized;
+
+    Mutex m_lock;
+    /// files we know of, most recently read first, and their sizes
+    lru_t m_lru;
+    std::map<std::string, std::pair<lru_t::iterator, uint64_t> > m_files;
+    uint64_t m_bytes;
+    bool m_scanned;
+
+    Finisher m_finisher;
+
+    static std::string file_name(int64_t pool_id, const std::string &image_id,
+				 librados::snap_t snap_id, uint64_t object_no);
+    void touch(const std::string &name, uint64_t size);
+    void forget(const std::string &name);
+    void handle_write(const std::string &name, ceph::bufferlist &bl);
+    void scan();
+    void trim();
+  };
+
+}
+
+#endif
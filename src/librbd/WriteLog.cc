@@ -0,0 +1,678 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "include/Context.h"
+#include "include/crc32c.h"
+#include "include/stringify.h"
+#include "include/uuid.h"
+
+#include "librbd/AioCompletion.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/internal.h"
+#include "librbd/WriteLog.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::WriteLog: "
+
+#define WRITE_LOG_MAGIC 0x676f6c772d646272ull  // "rbd-wlog"
+#define RECORD_MAGIC 0x52574c47u
+
+namespace librbd {
+
+  const char *WriteLog::XATTR = "rbd.write_log";
+
+  struct WriteLog::C_Destaged : public Context {
+    WriteLog *log;
+    Record *rec;
+    C_Destaged(WriteLog *l, Record *r) : log(l), rec(r) {}
+    void finish(int r) {
+      log->handle_destaged(rec, r);
+    }
+  };
+
+  WriteLog::WriteLog(ImageCtx &image_ctx, const std::string &path,
+		     uint64_t size, int max_destage_ios)
+    : m_image_ctx(image_ctx), m_path(path),
+      m_size(MAX(size, HEADER_SIZE + (1 << 20))),
+      m_max_destage_ios(MAX(max_destage_ios, 1)), m_fd(-1),
+      m_lock("librbd::WriteLog::m_lock"), m_thread(this), m_stopping(false),
+      m_next_seq(1), m_destaging(0), m_destage_error(0),
+      m_head_pos(HEADER_SIZE), m_used(0),
+      m_disk_tail_pos(HEADER_SIZE), m_disk_tail_seq(1), m_freed(0),
+      m_dirty_seq(0)
+  {
+    // a record never takes more than a quarter of the log, so a large
+    // write cannot wait for space that is never freed
+    m_max_record = ((m_size - HEADER_SIZE) / 4) & ~((uint64_t)CEPH_PAGE_SIZE - 1);
+  }
+
+  WriteLog::~WriteLog() {
+    assert(m_appending.empty());
+    assert(m_pending.empty());
+    if (m_fd >= 0) {
+      VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+    }
+  }
+
+  int WriteLog::init() {
+    CephContext *cct = m_image_ctx.cct;
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (m_fd < 0) {
+      int r = -errno;
+      lderr(cct) << "failed to open " << m_path << ": " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    header_t h;
+    int r = read_header(&h);
+    if (r == 0) {
+      bufferlist bl;
+      r = m_image_ctx.md_ctx.getxattr(m_image_ctx.header_oid, XATTR, bl);
+      std::string owner;
+      if (r > 0) {
+	owner.assign(bl.c_str(), bl.length());
+      }
+      if (owner == h.uuid) {
+	r = replay(h);
+	if (r < 0) {
+	  return r;
+	}
+      } else {
+	ldout(cct, 1) << "discarding " << m_path << ": the image was locked "
+		      << "by another client since it was written" << dendl;
+      }
+      // the new log starts over at the front of the file, ahead of
+      // records left from before: number its records past anything
+      // there, so that replay cannot run on into the old ones
+      m_next_seq = MAX(m_next_seq, h.tail_seq +
+		       (h.size - HEADER_SIZE) / sizeof(record_header_t) + 1);
+    } else if (r != -ENOENT) {
+      return r;
+    }
+
+    if (::ftruncate(m_fd, m_size) < 0) {
+      r = -errno;
+      lderr(cct) << "failed to size " << m_path << ": " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    uuid_d uuid;
+    uuid.generate_random();
+    m_uuid = stringify(uuid);
+    m_head_pos = m_disk_tail_pos = HEADER_SIZE;
+    m_disk_tail_seq = m_next_seq;
+    r = write_header(m_disk_tail_pos, m_disk_tail_seq);
+    if (r == 0 && ::fdatasync(m_fd) < 0) {
+      r = -errno;
+    }
+    if (r < 0) {
+      lderr(cct) << "failed to write " << m_path << ": " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    ldout(cct, 5) << "using " << m_path << " (" << m_size << " bytes), uuid "
+		  << m_uuid << dendl;
+    m_thread.create();
+    return 0;
+  }
+
+  void WriteLog::shut_down() {
+    int r = flush();
+
+    m_lock.Lock();
+    m_stopping = true;
+    m_cond.Signal();
+    m_lock.Unlock();
+    m_thread.join();
+
+    if (!m_pending.empty()) {
+      // still on disk behind the tail, for the next open to replay
+      lderr(m_image_ctx.cct) << "leaving " << m_pending.size()
+			     << " records in " << m_path << ": "
+			     << cpp_strerror(r) << dendl;
+      for (std::list<Record*>::iterator p = m_pending.begin();
+	   p != m_pending.end(); ++p) {
+	delete *p;
+      }
+      m_pending.clear();
+    }
+  }
+
+  void WriteLog::append_write(uint64_t off, const char *buf, size_t len,
+			      int op_flags, Context *on_safe) {
+    CephContext *cct = m_image_ctx.cct;
+    ldout(cct, 20) << "append_write " << off << "~" << len << dendl;
+
+    if (len <= m_max_record) {
+      Record *rec = new Record(RECORD_WRITE, off, len, on_safe);
+      rec->op_flags = op_flags;
+      rec->data.push_back(buffer::copy(buf, len));
+      rec->data_crc = rec->data.crc32c(0);
+      queue_record(rec);
+      return;
+    }
+
+    C_GatherBuilder gather(cct, on_safe);
+    for (uint64_t pos = 0; pos < len; pos += m_max_record) {
+      uint64_t n = MIN(len - pos, m_max_record);
+      Record *rec = new Record(RECORD_WRITE, off + pos, n, gather.new_sub());
+      rec->op_flags = op_flags;
+      rec->data.push_back(buffer::copy(buf + pos, n));
+      rec->data_crc = rec->data.crc32c(0);
+      queue_record(rec);
+    }
+    gather.activate();
+  }
+
+  void WriteLog::append_discard(uint64_t off, uint64_t len, Context *on_safe) {
+    ldout(m_image_ctx.cct, 20) << "append_discard " << off << "~" << len
+			       << dendl;
+    queue_record(new Record(RECORD_DISCARD, off, len, on_safe));
+  }
+
+  void WriteLog::queue_record(Record *rec) {
+    Mutex::Locker l(m_lock);
+    rec->seq = m_next_seq++;
+    mark_dirty(rec->off, rec->len);
+    m_appending.push_back(rec);
+    m_cond.Signal();
+  }
+
+  bool WriteLog::is_dirty(
+      const std::vector<std::pair<uint64_t,uint64_t> > &extents) {
+    Mutex::Locker l(m_lock);
+    for (std::vector<std::pair<uint64_t,uint64_t> >::const_iterator p =
+	   extents.begin(); p != extents.end(); ++p) {
+      if (is_dirty(p->first, p->second)) {
+	return true;
+      }
+    }
+    return false;
+  }
+
+  bool WriteLog::wait_for_overlap(
+      const std::vector<std::pair<uint64_t,uint64_t> > &extents,
+      Context *on_finish) {
+    Mutex::Locker l(m_lock);
+
+    // wait for the newest record the extents overlap
+    uint64_t seq = 0;
+    for (std::list<Record*>::reverse_iterator r = m_appending.rbegin();
+	 r != m_appending.rend() && seq == 0; ++r) {
+      for (std::vector<std::pair<uint64_t,uint64_t> >::const_iterator p =
+	     extents.begin(); p != extents.end(); ++p) {
+	if ((*r)->off < p->first + p->second && p->first < (*r)->off + (*r)->len) {
+	  seq = (*r)->seq;
+	  break;
+	}
+      }
+    }
+    for (std::list<Record*>::reverse_iterator r = m_pending.rbegin();
+	 r != m_pending.rend() && seq == 0; ++r) {
+      if ((*r)->destaged) {
+	continue;
+      }
+      for (std::vector<std::pair<uint64_t,uint64_t> >::const_iterator p =
+	     extents.begin(); p != extents.end(); ++p) {
+	if ((*r)->off < p->first + p->second && p->first < (*r)->off + (*r)->len) {
+	  seq = (*r)->seq;
+	  break;
+	}
+      }
+    }
+    if (seq == 0) {
+      // only stale dirty extents
+      return false;
+    }
+
+    ldout(m_image_ctx.cct, 20) << "read waits for record " << seq << dendl;
+    m_waiters.push_back(std::make_pair(seq, on_finish));
+    if (m_destage_error < 0) {
+      // nothing is being destaged: have the log thread fail it
+      m_cond.Signal();
+    }
+    return true;
+  }
+
+  void WriteLog::flush(Context *on_finish) {
+    {
+      Mutex::Locker l(m_lock);
+      if (!m_pending.empty() || !m_appending.empty()) {
+	ldout(m_image_ctx.cct, 20) << "flush waits for record "
+				   << m_next_seq - 1 << dendl;
+	if (m_destage_error < 0) {
+	  ldout(m_image_ctx.cct, 5) << "retrying failed destage" << dendl;
+	  m_destage_error = 0;
+	}
+	m_waiters.push_back(std::make_pair(m_next_seq - 1, on_finish));
+	m_cond.Signal();
+	return;
+      }
+    }
+    on_finish->complete(0);
+  }
+
+  int WriteLog::flush() {
+    C_SaferCond ctx;
+    flush(&ctx);
+    return ctx.wait();
+  }
+
+  uint64_t WriteLog::get_tail_seq() const {
+    assert(m_lock.is_locked());
+    if (!m_pending.empty()) {
+      return m_pending.front()->seq;
+    }
+    if (!m_appending.empty()) {
+      return m_appending.front()->seq;
+    }
+    return m_next_seq;
+  }
+
+  void WriteLog::mark_dirty(uint64_t off, uint64_t len) {
+    assert(m_lock.is_locked());
+    uint64_t end = off + len;
+    std::map<uint64_t, uint64_t>::iterator p = m_dirty.upper_bound(off);
+    if (p != m_dirty.begin()) {
+      --p;
+      if (p->first + p->second < off) {
+	++p;
+      }
+    }
+    while (p != m_dirty.end() && p->first <= end) {
+      off = MIN(off, p->first);
+      end = MAX(end, p->first + p->second);
+      m_dirty.erase(p++);
+    }
+    m_dirty[off] = end - off;
+  }
+
+  bool WriteLog::is_dirty(uint64_t off, uint64_t len) const {
+    assert(m_lock.is_locked());
+    std::map<uint64_t, uint64_t>::const_iterator p =
+      m_dirty.lower_bound(off + len);
+    if (p == m_dirty.begin()) {
+      return false;
+    }
+    --p;
+    return p->first + p->second > off;
+  }
+
+  void WriteLog::rebuild_dirty() {
+    assert(m_lock.is_locked());
+    // extents only ever merge, so start over once every record they
+    // were built from is gone
+    m_dirty.clear();
+    for (std::list<Record*>::iterator p = m_pending.begin();
+	 p != m_pending.end(); ++p) {
+      if (!(*p)->destaged) {
+	mark_dirty((*p)->off, (*p)->len);
+      }
+    }
+    for (std::list<Record*>::iterator p = m_appending.begin();
+	 p != m_appending.end(); ++p) {
+      mark_dirty((*p)->off, (*p)->len);
+    }
+    m_dirty_seq = m_next_seq - 1;
+  }
+
+  int WriteLog::read_header(header_t *h) {
+    bufferptr bp(HEADER_SIZE);
+    int r = safe_pread_exact(m_fd, bp.c_str(), HEADER_SIZE, 0);
+    if (r < 0) {
+      // too short: a new file
+      return -ENOENT;
+    }
+    memcpy(h, bp.c_str(), sizeof(*h));
+    h->uuid[sizeof(h->uuid) - 1] = '\0';
+    if (h->magic != WRITE_LOG_MAGIC ||
+	h->crc != ceph_crc32c(0, (const unsigned char *)h,
+			      offsetof(header_t, crc)) ||
+	h->size <= HEADER_SIZE || h->tail_pos < HEADER_SIZE ||
+	h->tail_pos >= h->size) {
+      ldout(m_image_ctx.cct, 1) << m_path << " has no valid header" << dendl;
+      return -ENOENT;
+    }
+    return 0;
+  }
+
+  int WriteLog::write_header(uint64_t tail_pos, uint64_t tail_seq) {
+    header_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = WRITE_LOG_MAGIC;
+    h.size = m_size;
+    h.tail_pos = tail_pos;
+    h.tail_seq = tail_seq;
+    strncpy(h.uuid, m_uuid.c_str(), sizeof(h.uuid) - 1);
+    h.crc = ceph_crc32c(0, (const unsigned char *)&h, offsetof(header_t, crc));
+
+    bufferptr bp(HEADER_SIZE);
+    bp.zero();
+    memcpy(bp.c_str(), &h, sizeof(h));
+    return safe_pwrite(m_fd, bp.c_str(), HEADER_SIZE, 0);
+  }
+
+  int WriteLog::replay(const header_t &h) {
+    CephContext *cct = m_image_ctx.cct;
+    uint64_t pos = h.tail_pos;
+    uint64_t seq = h.tail_seq;
+    uint64_t scanned = 0;
+    uint64_t replayed = 0;
+    int r;
+    while (scanned < h.size - HEADER_SIZE) {
+      record_header_t rh;
+      if (h.size - pos < sizeof(rh)) {
+	scanned += h.size - pos;
+	pos = HEADER_SIZE;
+	continue;
+      }
+      r = safe_pread_exact(m_fd, &rh, sizeof(rh), pos);
+      if (r < 0 || rh.magic != RECORD_MAGIC || rh.seq != seq ||
+	  rh.header_crc != ceph_crc32c(0, (const unsigned char *)&rh,
+				       offsetof(record_header_t, header_crc))) {
+	break;
+      }
+      if (rh.type == RECORD_PAD) {
+	scanned += h.size - pos;
+	pos = HEADER_SIZE;
+	continue;
+      }
+
+      uint64_t data_len = 0;
+      if (rh.type == RECORD_WRITE) {
+	data_len = rh.len;
+	if (pos + sizeof(rh) + data_len > h.size) {
+	  break;
+	}
+	bufferptr bp(data_len);
+	r = safe_pread_exact(m_fd, bp.c_str(), data_len, pos + sizeof(rh));
+	if (r < 0 ||
+	    ceph_crc32c(0, (const unsigned char *)bp.c_str(), data_len) !=
+	      rh.data_crc) {
+	  break;
+	}
+	r = librbd::write(&m_image_ctx, rh.off, data_len, bp.c_str(), 0);
+      } else if (rh.type == RECORD_DISCARD) {
+	r = librbd::discard(&m_image_ctx, rh.off, rh.len);
+      } else {
+	break;
+      }
+      if (r < 0) {
+	lderr(cct) << "failed to replay record " << seq << " ("
+		   << rh.off << "~" << rh.len << "): " << cpp_strerror(r)
+		   << dendl;
+	return r;
+      }
+
+      pos += sizeof(rh) + data_len;
+      scanned += sizeof(rh) + data_len;
+      ++seq;
+      ++replayed;
+    }
+
+    ldout(cct, 1) << "replayed " << replayed << " records from " << m_path
+		  << dendl;
+    if (replayed > 0) {
+      r = librbd::flush(&m_image_ctx);
+      if (r < 0) {
+	return r;
+      }
+    }
+    m_next_seq = seq;
+    return 0;
+  }
+
+  int WriteLog::write_record(Record *rec) {
+    record_header_t rh;
+    uint64_t need = sizeof(rh) + rec->data.length();
+    uint64_t pad = rec->log_len - need;
+    if (pad >= sizeof(rh)) {
+      memset(&rh, 0, sizeof(rh));
+      rh.magic = RECORD_MAGIC;
+      rh.type = RECORD_PAD;
+      rh.seq = rec->seq;
+      rh.header_crc = ceph_crc32c(0, (const unsigned char *)&rh,
+				  offsetof(record_header_t, header_crc));
+      int r = safe_pwrite(m_fd, &rh, sizeof(rh), m_size - pad);
+      if (r < 0) {
+	return r;
+      }
+    }
+
+    memset(&rh, 0, sizeof(rh));
+    rh.magic = RECORD_MAGIC;
+    rh.type = rec->type;
+    rh.seq = rec->seq;
+    rh.off = rec->off;
+    rh.len = rec->len;
+    rh.data_crc = rec->data_crc;
+    rh.header_crc = ceph_crc32c(0, (const unsigned char *)&rh,
+				offsetof(record_header_t, header_crc));
+    bufferlist bl;
+    bl.append((const char *)&rh, sizeof(rh));
+    bl.append(rec->data);
+    return bl.write_fd(m_fd, rec->log_pos);
+  }
+
+  void WriteLog::log_thread_entry() {
+    CephContext *cct = m_image_ctx.cct;
+    const uint64_t space = m_size - HEADER_SIZE;
+
+    m_lock.Lock();
+    while (true) {
+      // everything queued that fits goes out with a single sync
+      std::list<Record*> batch, rejected;
+      while (!m_appending.empty()) {
+	Record *rec = m_appending.front();
+	uint64_t need = sizeof(record_header_t) + rec->data.length();
+	bool wrap = m_head_pos + need > m_size;
+	uint64_t pad = wrap ? m_size - m_head_pos : 0;
+	if (m_used + pad + need > space) {
+	  if (m_destage_error < 0) {
+	    // no space is freed until destaging works again
+	    m_appending.pop_front();
+	    rejected.push_back(rec);
+	    continue;
+	  }
+	  break;
+	}
+	if (wrap) {
+	  m_head_pos = HEADER_SIZE;
+	}
+	rec->log_pos = m_head_pos;
+	rec->log_len = pad + need;
+	m_head_pos += need;
+	m_used += pad + need;
+	m_appending.pop_front();
+	m_pending.push_back(rec);
+	batch.push_back(rec);
+      }
+
+      // destaged records free their space once the tail on disk moves
+      // past them
+      uint64_t tail_seq = get_tail_seq();
+      uint64_t tail_pos = m_pending.empty() ? m_head_pos :
+	m_pending.front()->log_pos;
+      bool move_tail = tail_seq != m_disk_tail_seq;
+      uint64_t freed = m_freed;
+      m_freed = 0;
+
+      // oldest first, up to the limit, and never past a record that
+      // overlaps one still in flight
+      std::list<Record*> destage_list;
+      std::vector<std::pair<uint64_t,uint64_t> > busy;
+      for (std::list<Record*>::iterator p = m_pending.begin();
+	   p != m_pending.end() && m_destage_error == 0 &&
+	     m_destaging + (int)destage_list.size() < m_max_destage_ios;
+	   ++p) {
+	Record *rec = *p;
+	if (rec->destaged) {
+	  continue;
+	}
+	if (rec->on_safe != NULL) {
+	  // not acknowledged, so not synced yet either
+	  break;
+	}
+	bool overlaps = false;
+	for (std::vector<std::pair<uint64_t,uint64_t> >::iterator b =
+	       busy.begin(); b != busy.end(); ++b) {
+	  if (rec->off < b->first + b->second && b->first < rec->off + rec->len) {
+	    overlaps = true;
+	    break;
+	  }
+	}
+	if (!rec->destaging && overlaps) {
+	  break;
+	}
+	busy.push_back(std::make_pair(rec->off, rec->len));
+	if (!rec->destaging) {
+	  rec->destaging = true;
+	  destage_list.push_back(rec);
+	}
+      }
+      m_destaging += destage_list.size();
+
+      std::list<Context*> finished, failed;
+      int destage_error = m_destage_error;
+      for (std::list<std::pair<uint64_t, Context*> >::iterator p =
+	     m_waiters.begin(); p != m_waiters.end(); ) {
+	if (p->first < tail_seq) {
+	  finished.push_back(p->second);
+	  m_waiters.erase(p++);
+	} else if (destage_error < 0) {
+	  failed.push_back(p->second);
+	  m_waiters.erase(p++);
+	} else {
+	  ++p;
+	}
+      }
+
+      if (batch.empty() && rejected.empty() && !move_tail &&
+	  destage_list.empty() && finished.empty() && failed.empty()) {
+	m_freed += freed;
+	if (m_stopping && m_appending.empty() &&
+	    (m_pending.empty() || (m_destage_error < 0 && m_destaging == 0))) {
+	  break;
+	}
+	m_cond.Wait(m_lock);
+	continue;
+      }
+      m_lock.Unlock();
+
+      int r = 0;
+      for (std::list<Record*>::iterator p = batch.begin();
+	   p != batch.end() && r == 0; ++p) {
+	r = write_record(*p);
+      }
+      if (r == 0 && move_tail) {
+	r = write_header(tail_pos, tail_seq);
+      }
+      if (r == 0 && (!batch.empty() || move_tail) && ::fdatasync(m_fd) < 0) {
+	r = -errno;
+      }
+      if (r < 0) {
+	lderr(cct) << "failed to write " << m_path << ": " << cpp_strerror(r)
+		   << dendl;
+      }
+
+      m_lock.Lock();
+      if (move_tail && r == 0) {
+	m_used -= freed;
+	m_disk_tail_pos = tail_pos;
+	m_disk_tail_seq = tail_seq;
+      } else {
+	m_freed += freed;
+      }
+      std::list<Context*> acks;
+      for (std::list<Record*>::iterator p = batch.begin(); p != batch.end();
+	   ++p) {
+	acks.push_back((*p)->on_safe);
+	(*p)->on_safe = NULL;
+      }
+      m_lock.Unlock();
+
+      // a write the log failed on still reaches RADOS; the error only
+      // tells the caller it may not have
+      for (std::list<Context*>::iterator p = acks.begin(); p != acks.end();
+	   ++p) {
+	(*p)->complete(r);
+      }
+      for (std::list<Record*>::iterator p = rejected.begin();
+	   p != rejected.end(); ++p) {
+	(*p)->on_safe->complete(destage_error);
+	delete *p;
+      }
+      for (std::list<Context*>::iterator p = finished.begin();
+	   p != finished.end(); ++p) {
+	(*p)->complete(0);
+      }
+      for (std::list<Context*>::iterator p = failed.begin();
+	   p != failed.end(); ++p) {
+	(*p)->complete(destage_error);
+      }
+      for (std::list<Record*>::iterator p = destage_list.begin();
+	   p != destage_list.end(); ++p) {
+	destage(*p);
+      }
+
+      m_lock.Lock();
+    }
+    m_lock.Unlock();
+  }
+
+  void WriteLog::destage(Record *rec) {
+    ldout(m_image_ctx.cct, 20) << "destage " << rec->seq << " " << rec->off
+			       << "~" << rec->len << dendl;
+    AioCompletion *c = aio_create_completion_internal(
+      new C_Destaged(this, rec), rbd_ctx_cb);
+    if (rec->type == RECORD_WRITE) {
+      aio_destage_write(&m_image_ctx, rec->off, rec->data, rec->op_flags, c);
+    } else {
+      aio_destage_discard(&m_image_ctx, rec->off, rec->len, c);
+    }
+  }
+
+  void WriteLog::handle_destaged(Record *rec, int r) {
+    Mutex::Locker l(m_lock);
+    --m_destaging;
+    rec->destaging = false;
+    if (r < 0) {
+      // keep it: its space is not freed and the tail stays in front of
+      // it, so it is destaged again or replayed
+      lderr(m_image_ctx.cct) << "failed to destage " << rec->seq << " "
+			     << rec->off << "~" << rec->len << ": "
+			     << cpp_strerror(r) << dendl;
+      if (m_destage_error == 0) {
+	m_destage_error = r;
+      }
+      m_cond.Signal();
+      return;
+    }
+
+    rec->destaged = true;
+    while (!m_pending.empty() && m_pending.front()->destaged) {
+      Record *front = m_pending.front();
+      m_pending.pop_front();
+      m_freed += front->log_len;
+      delete front;
+    }
+    if (get_tail_seq() > m_dirty_seq) {
+      rebuild_dirty();
+    }
+    m_cond.Signal();
+  }
+
+}
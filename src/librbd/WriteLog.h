@@ -0,0 +1,187 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_WRITELOG_H
+#define CEPH_LIBRBD_WRITELOG_H
+
+#include "include/int_types.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "include/buffer.h"
+
+class Context;
+
+namespace librbd {
+
+  struct ImageCtx;
+
+  /**
+   * Persistent write-back log on a local device
+   *
+   * Writes and discards to the image head are appended to a ring
+   * buffer in a local file and acknowledged once it is synced; one
+   * thread group-commits the appends and destages the records to
+   * RADOS in log order, never two overlapping records at once.  Reads
+   * that overlap a record not yet destaged wait for it, and whatever
+   * needs RADOS to be current (a flush to the cluster, snapshots,
+   * resize, releasing the exclusive lock, close) drains the log with
+   * flush().  A record that fails to destage stays in the log: destaging
+   * stops, waiters get the error, and the next flush() tries again; if
+   * it still fails at shut_down() the records are left for replay.
+   *
+   * A log is only good for as long as its owner holds the exclusive
+   * lock: ImageWatcher stores the uuid of the locker's log in the
+   * header xattr XATTR as part of taking the lock, so a log left behind
+   * by a crash is replayed at open only if nobody took the lock since.
+   */
+  class WriteLog {
+  public:
+    static const char *XATTR;
+
+    WriteLog(ImageCtx &image_ctx, const std::string &path, uint64_t size,
+	     int max_destage_ios);
+    ~WriteLog();
+
+    /// open the log, replaying what the last owner left
+    int init();
+    /// destage everything, then stop
+    void shut_down();
+
+    const std::string &get_uuid() const {
+      return m_uuid;
+    }
+
+    void append_write(uint64_t off, const char *buf, size_t len,
+		      int op_flags, Context *on_safe);
+    void append_discard(uint64_t off, uint64_t len, Context *on_safe);
+
+    /// whether any of extents may overlap a record not yet destaged
+    bool is_dirty(const std::vector<std::pair<uint64_t,uint64_t> > &extents);
+    /**
+     * queue on_finish until the records overlapping extents are
+     * destaged; false (and on_finish untouched) if there are none
+     */
+    bool wait_for_overlap(
+      const std::vector<std::pair<uint64_t,uint64_t> > &extents,
+      Context *on_finish);
+
+    /// destage everything appended so far, retrying failed records
+    void flush(Context *on_finish);
+    int flush();
+
+  private:
+    enum {
+      RECORD_WRITE = 1,
+      RECORD_DISCARD = 2,
+      RECORD_PAD = 3,
+    };
+
+    struct header_t {
+      uint64_t magic;
+      uint64_t size;
+      uint64_t tail_pos;
+      uint64_t tail_seq;
+      char uuid[40];
+      uint32_t crc;
+    } __attribute__((__packed__));
+
+    struct record_header_t {
+      uint32_t magic;
+      uint32_t type;
+      uint64_t seq;
+      uint64_t off;
+      uint64_t len;
+      uint32_t data_crc;
+      uint32_t header_crc;
+    } __attribute__((__packed__));
+
+    struct Record {
+      uint64_t seq;
+      uint32_t type;
+      uint64_t off, len;
+      int op_flags;
+      ceph::bufferlist data;
+      uint32_t data_crc;
+      /// where it went in the log, and the bytes it took (with padding)
+      uint64_t log_pos, log_len;
+      Context *on_safe;
+      bool destaging, destaged;
+
+      Record(uint32_t t, uint64_t o, uint64_t l, Context *c)
+	: seq(0), type(t), off(o), len(l), op_flags(0), data_crc(0),
+	  log_pos(0), log_len(0), on_safe(c), destaging(false),
+	  destaged(false) {}
+    };
+
+    struct C_Destaged;
+
+    class LogThread : public Thread {
+      WriteLog *m_log;
+    public:
+      LogThread(WriteLog *log) : m_log(log) {}
+      void *entry() {
+	m_log->log_thread_entry();
+	return 0;
+      }
+    };
+
+    static const uint64_t HEADER_SIZE = 4096;
+
+    ImageCtx &m_image_ctx;
+    std::string m_path;
+    uint64_t m_size;
+    uint64_t m_max_record;
+    int m_max_destage_ios;
+    int m_fd;
+    std::string m_uuid;
+
+    Mutex m_lock;
+    Cond m_cond;
+    LogThread m_thread;
+    bool m_stopping;
+
+    uint64_t m_next_seq;
+    /// records waiting to be written, and written but not yet destaged
+    std::list<Record*> m_appending, m_pending;
+    int m_destaging;
+    /// first destage error since the last flush(); stops destaging
+    int m_destage_error;
+
+    uint64_t m_head_pos;
+    /// log space from the tail on disk to the head
+    uint64_t m_used;
+    /// tail on disk, and the space the destaged records in front of it free
+    uint64_t m_disk_tail_pos, m_disk_tail_seq, m_freed;
+
+    /// image extents with records not destaged, merged; may be stale
+    std::map<uint64_t, uint64_t> m_dirty;
+    uint64_t m_dirty_seq;
+
+    /// contexts to complete once every record up to seq is destaged
+    std::list<std::pair<uint64_t, Context*> > m_waiters;
+
+    uint64_t get_tail_seq() const;
+    void mark_dirty(uint64_t off, uint64_t len);
+    bool is_dirty(uint64_t off, uint64_t len) const;
+    void rebuild_dirty();
+    void queue_record(Record *rec);
+
+    int read_header(header_t *h);
+    int write_header(uint64_t tail_pos, uint64_t tail_seq);
+    int replay(const header_t &h);
+    int write_record(Record *rec);
+
+    void log_thread_entry();
+    void destage(Record *rec);
+    void handle_destaged(Record *rec, int r);
+  };
+
+}
+
+#endif
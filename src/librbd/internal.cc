@@ -28,7 +28,9 @@
 #include "librbd/internal.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/parent_types.h"
+#include "librbd/ParentCache.h"
 #include "librbd/RebuildObjectMapRequest.h"
+#include "librbd/WriteLog.h"
 #include "include/util.h"
 
 #include <boost/bind.hpp>
@@ -359,9 +361,11 @@ int invoke_async_request(ImageCtx *ictx, const std::string& request_type,
   {
     if (ictx) {
       ictx->refresh_lock.Lock();
-      ldout(ictx->cct, 20) << "notify_change refresh_seq = " << ictx->refresh_seq
-			   << " last_refresh = " << ictx->last_refresh << dendl;
-      ++ictx->refresh_seq;
+      ldout(ictx->cct, 20) << "notify_change refresh_seq = "
+			   << ictx->refresh_seq.read()
+			   << " last_refresh = " << ictx->last_refresh.read()
+			   << dendl;
+      ictx->refresh_seq.inc();
       ictx->refresh_lock.Unlock();
     }
 
@@ -1679,6 +1683,17 @@ reprotect_and_return_err:
     else if (ictx->localize_parent_reads)
       ictx->parent->set_read_flag(librados::OPERATION_LOCALIZE_READS);
 
+    if (!ictx->cct->_conf->rbd_parent_cache_path.empty()) {
+      ParentCache *parent_cache;
+      ictx->cct->lookup_or_create_singleton_object<ParentCache>(
+	parent_cache, "librbd::parent_cache");
+      std::string fsid;
+      librados::Rados rados(ictx->md_ctx);
+      if (rados.cluster_fsid(&fsid) == 0 && parent_cache->init(fsid) == 0) {
+	ictx->parent->parent_cache = parent_cache;
+      }
+    }
+
     r = open_image(ictx->parent);
     if (r < 0) {
       lderr(ictx->cct) << "error opening parent image: " << cpp_strerror(r)
@@ -2108,9 +2123,8 @@ reprotect_and_return_err:
     CephContext *cct = ictx->cct;
     ldout(cct, 20) << "ictx_check " << ictx << dendl;
 
-    ictx->refresh_lock.Lock();
-    bool needs_refresh = ictx->last_refresh != ictx->refresh_seq;
-    ictx->refresh_lock.Unlock();
+    bool needs_refresh =
+      ictx->last_refresh.read() != ictx->refresh_seq.read();
 
     if (needs_refresh) {
       int r;
@@ -2177,7 +2191,7 @@ reprotect_and_return_err:
     ldout(cct, 20) << "ictx_refresh " << ictx << dendl;
 
     ictx->refresh_lock.Lock();
-    int refresh_seq = ictx->refresh_seq;
+    int refresh_seq = ictx->refresh_seq.read();
     ictx->refresh_lock.Unlock();
 
     ::SnapContext new_snapc;
@@ -2278,10 +2292,25 @@ reprotect_and_return_err:
               return r;
             }
 
+	    // only the protection status of a snapshot we already know can
+	    // have changed; with many snapshots, don't fetch the rest again
+	    vector<bool> known(new_snapc.snaps.size());
+	    for (size_t i = 0; i < new_snapc.snaps.size(); ++i) {
+	      known[i] = (ictx->snap_info.count(new_snapc.snaps[i]) != 0);
+	    }
 	    r = cls_client::snapshot_list(&(ictx->md_ctx), ictx->header_oid,
-					  new_snapc.snaps, &snap_names,
+					  new_snapc.snaps, known, &snap_names,
                                           &snap_sizes, &snap_parents,
                                           &snap_protection);
+	    for (size_t i = 0; r == 0 && i < new_snapc.snaps.size(); ++i) {
+	      if (known[i]) {
+		const SnapInfo &info = ictx->snap_info.find(
+		  new_snapc.snaps[i])->second;
+		snap_names[i] = info.name;
+		snap_sizes[i] = info.size;
+		snap_parents[i] = info.parent;
+	      }
+	    }
 	    // -ENOENT here means we raced with snapshot deletion
 	    if (r < 0 && r != -ENOENT) {
 	      lderr(ictx->cct) << "snapc = " << new_snapc << dendl;
@@ -2350,7 +2379,7 @@ reprotect_and_return_err:
     }
 
     ictx->refresh_lock.Lock();
-    ictx->last_refresh = refresh_seq;
+    ictx->last_refresh.set(refresh_seq);
     ictx->refresh_lock.Unlock();
 
     return 0;
@@ -2407,6 +2436,15 @@ reprotect_and_return_err:
       // the current version, so we have to invalidate that too.
       RWLock::WLocker md_locker(ictx->md_lock);
       ictx->flush_async_operations();
+      if (ictx->write_log) {
+	// logged writes destaged after the rollback would land on top of it
+	r = ictx->write_log->flush();
+	if (r < 0) {
+	  lderr(cct) << "failed to destage the write log: " << cpp_strerror(r)
+		     << dendl;
+	  return r;
+	}
+      }
       r = ictx->invalidate_cache();
       if (r < 0) {
 	return r;
@@ -2542,6 +2580,24 @@ reprotect_and_return_err:
     bufferlist *m_bl;
   };
 
+  struct CopyAllocatedCtx {
+    uint64_t period;
+    std::set<uint64_t> periods;
+
+    CopyAllocatedCtx(uint64_t p) : period(p) {}
+
+    static int diff_cb(uint64_t offset, size_t length, int exists, void *arg) {
+      CopyAllocatedCtx *ctx = reinterpret_cast<CopyAllocatedCtx *>(arg);
+      if (exists && length > 0) {
+	for (uint64_t p = offset / ctx->period;
+	     p <= (offset + length - 1) / ctx->period; ++p) {
+	  ctx->periods.insert(p);
+	}
+      }
+      return 0;
+    }
+  };
+
   int copy(ImageCtx *src, ImageCtx *dest, ProgressContext &prog_ctx)
   {
     src->snap_lock.get_read();
@@ -2573,13 +2629,27 @@ reprotect_and_return_err:
       }
     }
 
-    SimpleThrottle throttle(src->concurrent_management_ops, false);
     uint64_t period = src->get_stripe_period();
+
+    // only read the object sets that hold data, in the image or its parents
+    CopyAllocatedCtx allocated(period);
+    r = diff_iterate(src, NULL, 0, src_size, true, true,
+		     &CopyAllocatedCtx::diff_cb, &allocated);
+    bool sparse = (r == 0);
+    if (r < 0) {
+      ldout(cct, 5) << "cannot find allocated extents, copying everything: "
+		    << cpp_strerror(r) << dendl;
+    }
+
+    SimpleThrottle throttle(src->concurrent_management_ops, false);
     unsigned fadvise_flags = LIBRADOS_OP_FLAG_FADVISE_SEQUENTIAL | LIBRADOS_OP_FLAG_FADVISE_NOCACHE;
     for (uint64_t offset = 0; offset < src_size; offset += period) {
       if (throttle.pending_error()) {
         return throttle.wait_for_ret();
       }
+      if (sparse && allocated.periods.count(offset / period) == 0) {
+	continue;
+      }
 
       uint64_t len = min(period, src_size - offset);
       bufferlist *bl = new bufferlist();
@@ -2640,6 +2710,18 @@ reprotect_and_return_err:
 
     ictx->cancel_async_requests();
     ictx->flush_async_operations();
+    if (ictx->write_log) {
+      int r = ictx->write_log->flush();
+      if (r < 0) {
+	lderr(ictx->cct) << "failed to destage the write log: "
+			 << cpp_strerror(r) << dendl;
+	RWLock::WLocker l(ictx->owner_lock);
+	if (unlocking) {
+	  ictx->image_watcher->cancel_unlock();
+	}
+	return r;
+      }
+    }
     if (ictx->object_cacher) {
       // complete pending writes before we're set to a snapshot and
       // get -EROFS for writes
@@ -2669,6 +2751,50 @@ reprotect_and_return_err:
     return r;
   }
 
+  static int open_write_log(ImageCtx *ictx)
+  {
+    CephContext *cct = ictx->cct;
+    {
+      RWLock::RLocker owner_locker(ictx->owner_lock);
+      if (!ictx->image_watcher->is_lock_supported()) {
+	lderr(cct) << "the write log needs the exclusive-lock feature, "
+		   << "not using it" << dendl;
+	return 0;
+      }
+    }
+
+    string path = ictx->write_log_path + "/rbd_wlog." +
+      stringify(ictx->data_ctx.get_id()) + "." + ictx->id;
+    WriteLog *log = new WriteLog(*ictx, path, ictx->write_log_size,
+				 ictx->write_log_max_destage_ios);
+    int r = log->init();
+    if (r < 0) {
+      lderr(cct) << "failed to open write log " << path << ": "
+		 << cpp_strerror(r) << dendl;
+      delete log;
+      return r;
+    }
+
+    RWLock::WLocker owner_locker(ictx->owner_lock);
+    if (ictx->image_watcher->is_lock_owner()) {
+      // replaying took the lock before there was a log to claim it for
+      librados::ObjectWriteOperation op;
+      ictx->image_watcher->assert_header_locked(&op);
+      bufferlist bl;
+      bl.append(log->get_uuid());
+      op.setxattr(WriteLog::XATTR, bl);
+      r = ictx->md_ctx.operate(ictx->header_oid, &op);
+      if (r < 0) {
+	lderr(cct) << "failed to claim write log: " << cpp_strerror(r) << dendl;
+	log->shut_down();
+	delete log;
+	return r;
+      }
+    }
+    ictx->write_log = log;
+    return 0;
+  }
+
   int open_image(ImageCtx *ictx)
   {
     ldout(ictx->cct, 20) << "open_image: ictx = " << ictx
@@ -2699,6 +2825,13 @@ reprotect_and_return_err:
     if ((r = _snap_set(ictx, ictx->snap_name.c_str())) < 0)
       goto err_close;
 
+    if (!ictx->read_only && !ictx->write_log_path.empty() &&
+	ictx->snap_id == CEPH_NOSNAP) {
+      r = open_write_log(ictx);
+      if (r < 0)
+	goto err_close;
+    }
+
     return 0;
 
   err_close:
@@ -2723,6 +2856,12 @@ reprotect_and_return_err:
     ictx->flush_async_operations();
     ictx->readahead.wait_for_pending();
 
+    if (ictx->write_log) {
+      ictx->write_log->shut_down();
+      delete ictx->write_log;
+      ictx->write_log = NULL;
+    }
+
     int r;
     if (ictx->object_cacher) {
       r = ictx->shutdown_cache(); // implicitly flushes
@@ -3431,6 +3570,15 @@ reprotect_and_return_err:
     assert(ictx->owner_lock.is_locked());
     CephContext *cct = ictx->cct;
     int r;
+    if (ictx->write_log) {
+      // destage what is in the write log first
+      r = ictx->write_log->flush();
+      if (r < 0) {
+	lderr(cct) << "failed to destage the write log: " << cpp_strerror(r)
+		   << dendl;
+	return r;
+      }
+    }
     // flush any outstanding writes
     if (ictx->object_cacher) {
       r = ictx->flush_cache();
@@ -3463,6 +3611,85 @@ reprotect_and_return_err:
     return r;
   }
 
+  static void send_write(ImageCtx *ictx, uint64_t off, const bufferlist &bl,
+			 const ::SnapContext &snapc, uint64_t parent_overlap,
+			 AioCompletion *c, int op_flags)
+  {
+    CephContext *cct = ictx->cct;
+    vector<ObjectExtent> extents;
+    Striper::file_to_extents(cct, ictx->format_string, &ictx->layout, off,
+			     bl.length(), 0, extents);
+
+    if (ictx->object_cacher) {
+      // the cache takes the whole io in one go, under one cache_lock
+      c->add_request();
+      ictx->write_to_cache(extents, bl, new C_AioWrite(cct, c), op_flags);
+      return;
+    }
+
+    // file_to_extents already gives one extent per object, so each
+    // object gets a single write op however the stripes interleave
+    for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
+      ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
+		     << " from " << p->buffer_extents << dendl;
+      // assemble extent
+      bufferlist obl;
+      for (vector<pair<uint64_t,uint64_t> >::iterator q = p->buffer_extents.begin();
+	   q != p->buffer_extents.end();
+	   ++q) {
+	bufferlist sub;
+	sub.substr_of(bl, q->first, q->second);
+	obl.claim_append(sub);
+      }
+
+      C_AioWrite *req_comp = new C_AioWrite(cct, c);
+      AioWrite *req = new AioWrite(ictx, p->oid.name, p->objectno, p->offset,
+				   obl, snapc, parent_overlap, req_comp);
+      c->add_request();
+
+      req->set_op_flags(op_flags);
+      req->send();
+    }
+  }
+
+  static void send_discard(ImageCtx *ictx, uint64_t off, uint64_t len,
+			   const ::SnapContext &snapc, AioCompletion *c)
+  {
+    CephContext *cct = ictx->cct;
+    vector<ObjectExtent> extents;
+    Striper::file_to_extents(cct, ictx->format_string, &ictx->layout, off,
+			     len, 0, extents);
+
+    for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
+      ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
+		     << " from " << p->buffer_extents << dendl;
+      C_AioWrite *req_comp = new C_AioWrite(cct, c);
+      AbstractWrite *req;
+      c->add_request();
+
+      if (p->length == ictx->layout.fl_object_size) {
+	req = new AioRemove(ictx, p->oid.name, p->objectno, snapc, req_comp);
+      } else if (p->offset + p->length == ictx->layout.fl_object_size) {
+	req = new AioTruncate(ictx, p->oid.name, p->objectno, p->offset, snapc,
+                              req_comp);
+      } else {
+	if(ictx->cct->_conf->rbd_skip_partial_discard) {
+	  delete req_comp;
+	  continue;
+	}
+	req = new AioZero(ictx, p->oid.name, p->objectno, p->offset, p->length,
+			  snapc, req_comp);
+      }
+
+      req->send();
+    }
+
+    if (ictx->object_cacher) {
+      Mutex::Locker l(ictx->cache_lock);
+      ictx->object_cacher->discard_set(ictx->object_set, extents);
+    }
+  }
+
   void aio_write(ImageCtx *ictx, uint64_t off, size_t len, const char *buf,
 		 AioCompletion *c, int op_flags)
   {
@@ -3482,6 +3709,7 @@ reprotect_and_return_err:
 
     uint64_t clip_len = len;
     ::SnapContext snapc;
+    uint64_t parent_overlap = 0;
     {
       // prevent image size from changing between computing clip and recording
       // pending async operation
@@ -3498,6 +3726,11 @@ reprotect_and_return_err:
       }
 
       snapc = ictx->snapc;
+      // once for the whole io rather than once per object
+      RWLock::RLocker parent_locker(ictx->parent_lock);
+      if (ictx->get_parent_overlap(CEPH_NOSNAP, &parent_overlap) < 0) {
+	parent_overlap = 0;
+      }
       c->start_op(ictx, AIO_TYPE_WRITE);
     }
 
@@ -3509,36 +3742,14 @@ reprotect_and_return_err:
       return;
     }
 
-    // map
-    vector<ObjectExtent> extents;
-    if (len > 0) {
-      Striper::file_to_extents(ictx->cct, ictx->format_string,
-			       &ictx->layout, off, clip_len, 0, extents);
-    }
-
-    for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
-      ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
-		     << " from " << p->buffer_extents << dendl;
-      // assemble extent
+    if (clip_len > 0 && ictx->write_log) {
+      c->add_request();
+      ictx->write_log->append_write(off, buf, clip_len, op_flags,
+				    new C_AioWrite(cct, c));
+    } else if (clip_len > 0) {
       bufferlist bl;
-      for (vector<pair<uint64_t,uint64_t> >::iterator q = p->buffer_extents.begin();
-	   q != p->buffer_extents.end();
-	   ++q) {
-	bl.append(buf + q->first, q->second);
-      }
-
-      C_AioWrite *req_comp = new C_AioWrite(cct, c);
-      if (ictx->object_cacher) {
-	c->add_request();
-	ictx->write_to_cache(p->oid, bl, p->length, p->offset, req_comp, op_flags);
-      } else {
-	AioWrite *req = new AioWrite(ictx, p->oid.name, p->objectno, p->offset,
-				     bl, snapc, req_comp);
-	c->add_request();
-
-	req->set_op_flags(op_flags);
-	req->send();
-      }
+      bl.push_back(buffer::copy(buf, clip_len));
+      send_write(ictx, off, bl, snapc, parent_overlap, c, op_flags);
     }
 
     c->finish_adding_requests(ictx->cct);
@@ -3648,47 +3859,104 @@ reprotect_and_return_err:
       return;
     }
 
-    // map
-    vector<ObjectExtent> extents;
-    if (len > 0) {
-      Striper::file_to_extents(ictx->cct, ictx->format_string,
-			       &ictx->layout, off, clip_len, 0, extents);
+    if (clip_len > 0 && ictx->write_log) {
+      c->add_request();
+      ictx->write_log->append_discard(off, clip_len, new C_AioWrite(cct, c));
+    } else if (clip_len > 0) {
+      send_discard(ictx, off, clip_len, snapc, c);
     }
 
-    for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
-      ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
-		     << " from " << p->buffer_extents << dendl;
-      C_AioWrite *req_comp = new C_AioWrite(cct, c);
-      AbstractWrite *req;
-      c->add_request();
+    c->finish_adding_requests(ictx->cct);
+    c->put();
 
-      if (p->length == ictx->layout.fl_object_size) {
-	req = new AioRemove(ictx, p->oid.name, p->objectno, snapc, req_comp);
-      } else if (p->offset + p->length == ictx->layout.fl_object_size) {
-	req = new AioTruncate(ictx, p->oid.name, p->objectno, p->offset, snapc,
-                              req_comp);
-      } else {
-	if(ictx->cct->_conf->rbd_skip_partial_discard) {
-	  delete req_comp;
-	  continue;
-	}
-	req = new AioZero(ictx, p->oid.name, p->objectno, p->offset, p->length,
-			  snapc, req_comp);
-      }
+    ictx->perfcounter->inc(l_librbd_discard);
+    ictx->perfcounter->inc(l_librbd_discard_bytes, clip_len);
+  }
 
-      req->send();
+  void aio_destage_write(ImageCtx *ictx, uint64_t off, const bufferlist &bl,
+			 int op_flags, AioCompletion *c)
+  {
+    CephContext *cct = ictx->cct;
+    ldout(cct, 20) << "aio_destage_write " << ictx << " off = " << off
+		   << " len = " << bl.length() << dendl;
+
+    c->get();
+    c->init_time(ictx, AIO_TYPE_DESTAGE);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    if (ictx->image_watcher->is_lock_supported() &&
+	!ictx->image_watcher->is_lock_owner()) {
+      // the lock was taken away while we had writes logged
+      c->fail(cct, -ESHUTDOWN);
+      return;
     }
 
-    if (ictx->object_cacher) {
-      Mutex::Locker l(ictx->cache_lock);
-      ictx->object_cacher->discard_set(ictx->object_set, extents);
+    uint64_t clip_len = bl.length();
+    ::SnapContext snapc;
+    uint64_t parent_overlap = 0;
+    {
+      RWLock::RLocker snap_locker(ictx->snap_lock);
+      int r = clip_io(ictx, off, &clip_len);
+      if (r == -EINVAL) {
+	// the image shrank past it since it was logged
+	clip_len = 0;
+      } else if (r < 0) {
+	c->fail(cct, r);
+	return;
+      }
+      snapc = ictx->snapc;
+      RWLock::RLocker parent_locker(ictx->parent_lock);
+      if (ictx->get_parent_overlap(CEPH_NOSNAP, &parent_overlap) < 0) {
+	parent_overlap = 0;
+      }
     }
 
-    c->finish_adding_requests(ictx->cct);
+    if (clip_len == bl.length()) {
+      send_write(ictx, off, bl, snapc, parent_overlap, c, op_flags);
+    } else if (clip_len > 0) {
+      bufferlist sub;
+      sub.substr_of(bl, 0, clip_len);
+      send_write(ictx, off, sub, snapc, parent_overlap, c, op_flags);
+    }
+    c->finish_adding_requests(cct);
     c->put();
+  }
 
-    ictx->perfcounter->inc(l_librbd_discard);
-    ictx->perfcounter->inc(l_librbd_discard_bytes, clip_len);
+  void aio_destage_discard(ImageCtx *ictx, uint64_t off, uint64_t len,
+			   AioCompletion *c)
+  {
+    CephContext *cct = ictx->cct;
+    ldout(cct, 20) << "aio_destage_discard " << ictx << " off = " << off
+		   << " len = " << len << dendl;
+
+    c->get();
+    c->init_time(ictx, AIO_TYPE_DESTAGE);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    if (ictx->image_watcher->is_lock_supported() &&
+	!ictx->image_watcher->is_lock_owner()) {
+      c->fail(cct, -ESHUTDOWN);
+      return;
+    }
+
+    uint64_t clip_len = len;
+    ::SnapContext snapc;
+    {
+      RWLock::RLocker snap_locker(ictx->snap_lock);
+      int r = clip_io(ictx, off, &clip_len);
+      if (r == -EINVAL) {
+	// the image shrank past it since it was logged
+	clip_len = 0;
+      } else if (r < 0) {
+	c->fail(cct, r);
+	return;
+      }
+      snapc = ictx->snapc;
+    }
+
+    if (clip_len > 0) {
+      send_discard(ictx, off, clip_len, snapc, c);
+    }
+    c->finish_adding_requests(cct);
+    c->put();
   }
 
   void rbd_req_cb(completion_t cb, void *arg)
@@ -3765,12 +4033,44 @@ reprotect_and_return_err:
     }
   }
 
+  struct C_RetryRead : public Context {
+    ImageCtx *ictx;
+    vector<pair<uint64_t,uint64_t> > image_extents;
+    char *buf;
+    bufferlist *pbl;
+    AioCompletion *c;
+    int op_flags;
+    C_RetryRead(ImageCtx *ictx, const vector<pair<uint64_t,uint64_t> >& image_extents,
+		char *buf, bufferlist *pbl, AioCompletion *c, int op_flags)
+      : ictx(ictx), image_extents(image_extents), buf(buf), pbl(pbl), c(c),
+	op_flags(op_flags) {}
+    virtual void finish(int r) {
+      if (r < 0) {
+	// the logged writes could not be destaged
+	c->get();
+	c->fail(ictx->cct, r);
+	return;
+      }
+      aio_read(ictx, image_extents, buf, pbl, c, op_flags);
+    }
+  };
+
   void aio_read(ImageCtx *ictx, const vector<pair<uint64_t,uint64_t> >& image_extents,
 	        char *buf, bufferlist *pbl, AioCompletion *c, int op_flags)
   {
     CephContext *cct = ictx->cct;
     ldout(cct, 20) << "aio_read " << ictx << " completion " << c << " " << image_extents << dendl;
 
+    if (ictx->write_log && ictx->write_log->is_dirty(image_extents)) {
+      // let the logged writes reach RADOS first
+      Context *ctx = new C_RetryRead(ictx, image_extents, buf, pbl, c,
+				     op_flags);
+      if (ictx->write_log->wait_for_overlap(image_extents, ctx)) {
+	return;
+      }
+      delete ctx;
+    }
+
     c->get();
     int r = ictx_check(ictx);
     if (r < 0) {
@@ -3789,11 +4089,19 @@ reprotect_and_return_err:
     snap_t snap_id;
     map<object_t,vector<ObjectExtent> > object_extents;
     uint64_t buffer_ofs = 0;
+    uint64_t parent_overlap = 0;
     {
       // prevent image size from changing between computing clip and recording
       // pending async operation
       RWLock::RLocker snap_locker(ictx->snap_lock);
       snap_id = ictx->snap_id;
+      {
+	// once for the whole io rather than twice per object
+	RWLock::RLocker parent_locker(ictx->parent_lock);
+	if (ictx->get_parent_overlap(snap_id, &parent_overlap) < 0) {
+	  parent_overlap = 0;
+	}
+      }
 
       // map
       for (vector<pair<uint64_t,uint64_t> >::const_iterator p =
@@ -3830,8 +4138,8 @@ reprotect_and_return_err:
 
 	C_AioRead *req_comp = new C_AioRead(ictx->cct, c);
 	AioRead *req = new AioRead(ictx, q->oid.name, q->objectno, q->offset,
-                                   q->length, q->buffer_extents, snap_id, true,
-                                   req_comp, op_flags);
+                                   q->length, q->buffer_extents, snap_id,
+                                   parent_overlap, true, req_comp, op_flags);
 	req_comp->set_req(req);
 	c->add_request();
 
@@ -41,6 +41,11 @@ enum {
   l_librbd_readahead,
   l_librbd_readahead_bytes,
 
+  l_librbd_write_log_destage_latency,
+
+  l_librbd_parent_cache_hit,
+  l_librbd_parent_cache_miss,
+
   l_librbd_last,
 };
 
@@ -203,6 +208,11 @@ namespace librbd {
   void aio_read(ImageCtx *ictx, const vector<pair<uint64_t,uint64_t> >& image_extents,
 	        char *buf, bufferlist *pbl, AioCompletion *c, int op_flags);
   void aio_flush(ImageCtx *ictx, AioCompletion *c);
+  // send what the write log holds on to RADOS
+  void aio_destage_write(ImageCtx *ictx, uint64_t off, const bufferlist &bl,
+			 int op_flags, AioCompletion *c);
+  void aio_destage_discard(ImageCtx *ictx, uint64_t off, uint64_t len,
+			   AioCompletion *c);
   int flush(ImageCtx *ictx);
   int _flush(ImageCtx *ictx);
   int invalidate_cache(ImageCtx *ictx);
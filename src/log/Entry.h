@@ -48,6 +48,11 @@ struct Entry {
   std::string get_str() const {
     return m_streambuf.get_str();
   }
+
+  /// append the message to s, without an intermediate copy
+  void append_to(std::string &s) const {
+    m_streambuf.append_to(s);
+  }
 };
 
 }
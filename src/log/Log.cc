@@ -21,6 +21,8 @@
 
 #define PREALLOC 1000000
 
+#define MAX_WRITE_BATCH 65536
+
 namespace ceph {
 namespace log {
 
@@ -39,7 +41,8 @@ Log::Log(SubsystemMap *s)
     m_subs(s),
     m_queue_mutex_holder(0),
     m_flush_mutex_holder(0),
-    m_new(), m_recent(),
+    m_inbox(NULL), m_inbox_len(0),
+    m_recent(),
     m_fd(-1),
     m_syslog_log(-2), m_syslog_crash(-2),
     m_stderr_log(1), m_stderr_crash(-1),
@@ -75,6 +78,12 @@ Log::~Log()
   }
 
   assert(!is_started());
+  Entry *e = m_inbox.exchange(NULL);
+  while (e) {
+    Entry *next = e->m_next;
+    delete e;
+    e = next;
+  }
   if (m_fd >= 0)
     VOID_TEMP_FAILURE_RETRY(::close(m_fd));
 
@@ -151,20 +160,57 @@ void Log::set_stderr_level(int log, int crash)
 
 void Log::submit_entry(Entry *e)
 {
-  pthread_mutex_lock(&m_queue_mutex);
-  m_queue_mutex_holder = pthread_self();
-
   if (m_inject_segv)
     *(int *)(0) = 0xdead;
 
   // wait for flush to catch up
-  while (m_new.m_len > m_max_new)
-    pthread_cond_wait(&m_cond_loggers, &m_queue_mutex);
+  if (m_inbox_len.load(std::memory_order_relaxed) > m_max_new) {
+    pthread_mutex_lock(&m_queue_mutex);
+    m_queue_mutex_holder = pthread_self();
+    while (m_inbox_len.load() > m_max_new)
+      pthread_cond_wait(&m_cond_loggers, &m_queue_mutex);
+    m_queue_mutex_holder = 0;
+    pthread_mutex_unlock(&m_queue_mutex);
+  }
 
-  m_new.enqueue(e);
-  pthread_cond_signal(&m_cond_flusher);
-  m_queue_mutex_holder = 0;
-  pthread_mutex_unlock(&m_queue_mutex);
+  // lock-free push; only the first entry after a drain has to wake
+  // the flusher, which rechecks the inbox under the mutex before it
+  // sleeps
+  m_inbox_len++;
+  Entry *h = m_inbox.load(std::memory_order_relaxed);
+  do {
+    e->m_next = h;
+  } while (!m_inbox.compare_exchange_weak(h, e));
+  if (h == NULL) {
+    pthread_mutex_lock(&m_queue_mutex);
+    pthread_cond_signal(&m_cond_flusher);
+    pthread_mutex_unlock(&m_queue_mutex);
+  }
+}
+
+void Log::_drain_inbox(EntryQueue *q)
+{
+  Entry *e = m_inbox.exchange(NULL);
+  if (!e)
+    return;
+  // the inbox is newest first
+  Entry *r = NULL;
+  int n = 0;
+  while (e) {
+    Entry *next = e->m_next;
+    e->m_next = r;
+    r = e;
+    e = next;
+    ++n;
+  }
+  while (r) {
+    Entry *next = r->m_next;
+    r->m_next = NULL;
+    q->enqueue(r);
+    r = next;
+  }
+  m_inbox_len -= n;
+  pthread_cond_broadcast(&m_cond_loggers);
 }
 
 Entry *Log::create_entry(int level, int subsys)
@@ -191,8 +237,7 @@ void Log::flush()
   pthread_mutex_lock(&m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
   EntryQueue t;
-  t.swap(m_new);
-  pthread_cond_broadcast(&m_cond_loggers);
+  _drain_inbox(&t);
   m_queue_mutex_holder = 0;
   pthread_mutex_unlock(&m_queue_mutex);
   _flush(&t, &m_recent, false);
@@ -206,10 +251,18 @@ void Log::flush()
   pthread_mutex_unlock(&m_flush_mutex);
 }
 
+void Log::_write_fd(const char *s, size_t len)
+{
+  int r = safe_write(m_fd, s, len);
+  if (r < 0)
+    cerr << "problem writing to " << m_log_file << ": " << cpp_strerror(r) << std::endl;
+}
+
 void Log::_flush(EntryQueue *t, EntryQueue *requeue, bool crash)
 {
   Entry *e;
   char buf[80];
+  m_write_buf.clear();
   while ((e = t->dequeue()) != NULL) {
     unsigned sub = e->m_subsys;
 
@@ -227,30 +280,40 @@ void Log::_flush(EntryQueue *t, EntryQueue *requeue, bool crash)
       buflen += snprintf(buf + buflen, sizeof(buf)-buflen, " %lx %2d ",
 			(unsigned long)e->m_thread, e->m_prio);
 
-      // FIXME: this is slow
-      string s = e->get_str();
-
       if (do_fd) {
-	int r = safe_write(m_fd, buf, buflen);
-	if (r >= 0)
-	  r = safe_write(m_fd, s.data(), s.size());
-	if (r >= 0)
-	  r = write(m_fd, "\n", 1);
-	if (r < 0)
-	  cerr << "problem writing to " << m_log_file << ": " << cpp_strerror(r) << std::endl;
+	// batch up lines; one write per MAX_WRITE_BATCH bytes
+	m_write_buf.append(buf, buflen);
+	e->append_to(m_write_buf);
+	m_write_buf.push_back('\n');
+	if (m_write_buf.size() >= MAX_WRITE_BATCH) {
+	  _write_fd(m_write_buf.data(), m_write_buf.size());
+	  m_write_buf.clear();
+	}
       }
 
-      if (do_syslog) {
-	syslog(LOG_USER, "%s%s", buf, s.c_str());
-      }
+      if (do_syslog || do_stderr) {
+	string s = e->get_str();
 
-      if (do_stderr) {
-	cerr << buf << s << std::endl;
+	if (do_syslog) {
+	  syslog(LOG_USER, "%s%s", buf, s.c_str());
+	}
+
+	if (do_stderr) {
+	  cerr << buf << s << std::endl;
+	}
       }
     }
 
     requeue->enqueue(e);
   }
+  if (!m_write_buf.empty()) {
+    _write_fd(m_write_buf.data(), m_write_buf.size());
+    m_write_buf.clear();
+  }
+  if (m_write_buf.capacity() > 4 * MAX_WRITE_BATCH) {
+    // don't pin a big buffer left over from one huge entry
+    string().swap(m_write_buf);
+  }
 }
 
 void Log::_log_message(const char *s, bool crash)
@@ -280,7 +343,7 @@ void Log::dump_recent()
   m_queue_mutex_holder = pthread_self();
 
   EntryQueue t;
-  t.swap(m_new);
+  _drain_inbox(&t);
 
   m_queue_mutex_holder = 0;
   pthread_mutex_unlock(&m_queue_mutex);
@@ -341,7 +404,7 @@ void *Log::entry()
   pthread_mutex_lock(&m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
   while (!m_stop) {
-    if (!m_new.empty()) {
+    if (m_inbox.load() != NULL) {
       m_queue_mutex_holder = 0;
       pthread_mutex_unlock(&m_queue_mutex);
       flush();
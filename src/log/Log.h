@@ -7,6 +7,7 @@
 #include "common/Thread.h"
 
 #include <pthread.h>
+#include <atomic>
 
 #include "Entry.h"
 #include "EntryQueue.h"
@@ -29,11 +30,14 @@ class Log : private Thread
   pthread_t m_queue_mutex_holder;
   pthread_t m_flush_mutex_holder;
 
-  EntryQueue m_new;    ///< new entries
+  /// new entries, newest first; submit_entry() pushes here without locking
+  std::atomic<Entry*> m_inbox;
+  std::atomic<int> m_inbox_len;
   EntryQueue m_recent; ///< recent (less new) entries we've already written at low detail
 
   std::string m_log_file;
   int m_fd;
+  std::string m_write_buf;  ///< batches log file writes in _flush
 
   int m_syslog_log, m_syslog_crash;
   int m_stderr_log, m_stderr_crash;
@@ -46,7 +50,10 @@ class Log : private Thread
 
   void *entry();
 
+  /// move everything submitted so far onto q, oldest first (queue mutex)
+  void _drain_inbox(EntryQueue *q);
   void _flush(EntryQueue *q, EntryQueue *requeue, bool crash);
+  void _write_fd(const char *s, size_t len);
 
   void _log_message(const char *s, bool crash);
 
@@ -188,6 +188,66 @@ TEST(Log, ManyGather)
   log.stop();
 }
 
+struct ManyThreadsArg {
+  Log *log;
+  int id;
+};
+
+static void *many_threads_entry(void *p)
+{
+  ManyThreadsArg *a = (ManyThreadsArg *)p;
+  for (int i=0; i<many; i++) {
+    Entry *e = new Entry(ceph_clock_now(NULL), pthread_self(), 10, 1);
+    ostream os(&e->m_streambuf);
+    os << "thread " << a->id << " seq " << i;
+    a->log->submit_entry(e);
+  }
+  return NULL;
+}
+
+TEST(Log, ManyThreads)
+{
+  const int nthreads = 4;
+  SubsystemMap subs;
+  subs.add(1, "foo", 20, 1);
+  Log log(&subs);
+  log.set_max_new(100);  // make the submitters wait for the flusher
+  log.start();
+  log.set_log_file("/tmp/log_threads");
+  ::unlink("/tmp/log_threads");
+  log.reopen_log_file();
+
+  pthread_t threads[nthreads];
+  ManyThreadsArg args[nthreads];
+  for (int i=0; i<nthreads; i++) {
+    args[i].log = &log;
+    args[i].id = i;
+    pthread_create(&threads[i], NULL, many_threads_entry, &args[i]);
+  }
+  for (int i=0; i<nthreads; i++)
+    pthread_join(threads[i], NULL);
+  log.flush();
+  log.stop();
+
+  // every line made it, each thread's in the order it submitted them
+  FILE *f = fopen("/tmp/log_threads", "r");
+  ASSERT_TRUE(f != NULL);
+  int next[nthreads] = { 0 };
+  int lines = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    const char *p = strstr(line, "thread ");
+    ASSERT_TRUE(p != NULL);
+    int id, seq;
+    ASSERT_EQ(2, sscanf(p, "thread %d seq %d", &id, &seq));
+    ASSERT_EQ(next[id], seq);
+    next[id]++;
+    lines++;
+  }
+  fclose(f);
+  ASSERT_EQ(nthreads * many, lines);
+}
+
 void do_segv()
 {
   SubsystemMap subs;
@@ -1367,6 +1367,32 @@ void CDir::log_mark_dirty()
   mdlog->wait_for_safe(new C_Dir_Dirty(this, pv, mdlog->get_current_segment()));
 }
 
+/*
+ * Small is not enough: a frag split because it was hot is usually small,
+ * and merging it back while it is still hot would only have it split
+ * again.
+ */
+bool CDir::should_merge()
+{
+  if ((int)get_frag_size() >= g_conf->mds_bal_merge_size)
+    return false;
+  utime_t now = ceph_clock_now(g_ceph_context);
+  return pop_me.get(META_POP_IRD).get(now, cache->decayrate) <
+    g_conf->mds_bal_merge_rd &&
+    pop_me.get(META_POP_IWR).get(now, cache->decayrate) <
+    g_conf->mds_bal_merge_wr;
+}
+
+void CDir::dump_load(Formatter *f, utime_t now, const DecayRate& rate)
+{
+  f->dump_float("rd", pop_me.get(META_POP_IRD).get(now, rate));
+  f->dump_float("wr", pop_me.get(META_POP_IWR).get(now, rate));
+  f->dump_float("readdir", pop_me.get(META_POP_READDIR).get(now, rate));
+  f->dump_float("fetch", pop_me.get(META_POP_FETCH).get(now, rate));
+  f->dump_float("store", pop_me.get(META_POP_STORE).get(now, rate));
+  f->dump_float("meta_load", pop_me.meta_load(now, rate));
+}
+
 void CDir::mark_complete() {
   state_set(STATE_COMPLETE);
   remove_bloom();
@@ -1509,28 +1535,55 @@ class C_IO_Dir_OMAP_Fetched : public CDirIOContext {
   map<string, bufferlist> omap;
   bufferlist btbl;
   int ret1, ret2, ret3;
+  /// for the reads after the first: what this one got
+  bool more;
+  bufferlist more_hdrbl;
+  map<string, bufferlist> more_omap;
 
   C_IO_Dir_OMAP_Fetched(CDir *d, const string& w) : 
     CDirIOContext(d), want_dn(w),
-    ret1(0), ret2(0), ret3(0) {}
+    ret1(0), ret2(0), ret3(0), more(false) {}
   void finish(int r) {
     // check the correctness of backtrace
     if (r >= 0 && ret3 != -ECANCELED)
       dir->inode->verify_diri_backtrace(btbl, ret3);
     if (r >= 0) r = ret1;
     if (r >= 0) r = ret2;
+    uint64_t got = more ? more_omap.size() : omap.size();
+    if (r >= 0 && more) {
+      if (!more_hdrbl.contents_equal(hdrbl)) {
+	// we committed to it since the first read; start over
+	dir->_omap_fetch(want_dn);
+	return;
+      }
+      omap.insert(more_omap.begin(), more_omap.end());
+    }
+    uint64_t max = g_conf->mds_dir_keys_per_op;
+    if (r >= 0 && max > 0 && got == max) {
+      dir->_omap_fetch_more(hdrbl, omap, want_dn);
+      return;
+    }
     dir->_omap_fetched(hdrbl, omap, want_dn, r);
   }
 };
 
+/*
+ * Big dirfrags are read mds_dir_keys_per_op dentries at a time, so that
+ * one fetch does not turn into a single huge op (and reply) on the osd.
+ * Every read also gets the header, and since we write that whenever we
+ * commit the dirfrag, a changed one means the later reads may not match
+ * the first and we start over.
+ */
 void CDir::_omap_fetch(const string& want_dn)
 {
   C_IO_Dir_OMAP_Fetched *fin = new C_IO_Dir_OMAP_Fetched(this, want_dn);
   object_t oid = get_ondisk_object();
   object_locator_t oloc(cache->mds->mdsmap->get_metadata_pool());
   ObjectOperation rd;
+  uint64_t max = g_conf->mds_dir_keys_per_op;
   rd.omap_get_header(&fin->hdrbl, &fin->ret1);
-  rd.omap_get_vals("", "", (uint64_t)-1, &fin->omap, &fin->ret2);
+  rd.omap_get_vals("", "", max > 0 ? max : (uint64_t)-1, &fin->omap,
+		   &fin->ret2);
   // check the correctness of backtrace
   if (g_conf->mds_verify_backtrace > 0 && frag == frag_t()) {
     rd.getxattr("parent", &fin->btbl, &fin->ret3);
@@ -1543,6 +1596,26 @@ void CDir::_omap_fetch(const string& want_dn)
 			     new C_OnFinisher(fin, cache->mds->finisher));
 }
 
+void CDir::_omap_fetch_more(bufferlist& hdrbl, map<string, bufferlist>& omap,
+			    const string& want_dn)
+{
+  dout(10) << "_omap_fetch_more after " << omap.size() << " keys, from '"
+	   << omap.rbegin()->first << "'" << dendl;
+  C_IO_Dir_OMAP_Fetched *fin = new C_IO_Dir_OMAP_Fetched(this, want_dn);
+  fin->hdrbl.claim(hdrbl);
+  fin->omap.swap(omap);
+  fin->more = true;
+  fin->ret3 = -ECANCELED;
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pool());
+  ObjectOperation rd;
+  rd.omap_get_header(&fin->more_hdrbl, &fin->ret1);
+  rd.omap_get_vals(fin->omap.rbegin()->first, "",
+		   g_conf->mds_dir_keys_per_op, &fin->more_omap, &fin->ret2);
+  cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0,
+			     new C_OnFinisher(fin, cache->mds->finisher));
+}
+
 CDentry *CDir::_load_dentry(
     const std::string &key,
     const std::string &dname,
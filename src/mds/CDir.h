@@ -383,9 +383,8 @@ public:
   bool should_split() {
     return (int)get_frag_size() > g_conf->mds_bal_split_size;
   }
-  bool should_merge() {
-    return (int)get_frag_size() < g_conf->mds_bal_merge_size;
-  }
+  bool should_merge();
+  void dump_load(Formatter *f, utime_t now, const DecayRate& rate);
 
 private:
   void prepare_new_fragment(bool replay);
@@ -497,6 +496,8 @@ private:
   void fetch(MDSInternalContextBase *c, const std::string& want_dn, bool ignore_authpinnability=false);
 protected:
   void _omap_fetch(const std::string& want_dn);
+  void _omap_fetch_more(bufferlist& hdrbl, std::map<std::string, bufferlist>& omap,
+			const std::string& want_dn);
   CDentry *_load_dentry(
       const std::string &key,
       const std::string &dname,
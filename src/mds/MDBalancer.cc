@@ -595,6 +595,27 @@ void MDBalancer::prep_rebalance(int beat)
 
 
 
+bool MDBalancer::recently_migrated(CDir *dir)
+{
+  map<dirfrag_t, utime_t>::iterator p = last_migrated.find(dir->dirfrag());
+  if (p == last_migrated.end())
+    return false;
+  dout(10) << " " << *dir << " moved at " << p->second
+	   << ", leaving it be" << dendl;
+  return true;
+}
+
+void MDBalancer::export_dir(CDir *dir, mds_rank_t target)
+{
+  if (g_conf->mds_bal_dry_run) {
+    dout(0) << "dry run: would export " << *dir << " load "
+	    << dir->pop_auth_subtree.meta_load(rebalance_time, mds->mdcache->decayrate)
+	    << " to mds." << target << dendl;
+    return;
+  }
+  mds->mdcache->migrator->export_dir_nicely(dir, target);
+}
+
 void MDBalancer::try_rebalance()
 {
   if (!check_targets())
@@ -606,6 +627,18 @@ void MDBalancer::try_rebalance()
     return;
   }
 
+  // moving a subtree and then moving it again (often right back) before
+  // the load has had a chance to settle is how the balancer thrashes
+  utime_t cutoff = ceph_clock_now(g_ceph_context);
+  cutoff -= g_conf->mds_bal_migrate_cooldown;
+  for (map<dirfrag_t, utime_t>::iterator p = last_migrated.begin();
+       p != last_migrated.end(); ) {
+    if (p->second <= cutoff)
+      last_migrated.erase(p++);
+    else
+      ++p;
+  }
+
   // make a sorted list of my imports
   map<double,CDir*>    import_pop_map;
   multimap<mds_rank_t,CDir*>  import_from_map;
@@ -617,6 +650,7 @@ void MDBalancer::try_rebalance()
        ++it) {
     CDir *im = *it;
     if (im->get_inode()->is_stray()) continue;
+    if (recently_migrated(im)) continue;
 
     double pop = im->pop_auth_subtree.meta_load(rebalance_time, mds->mdcache->decayrate);
     if (g_conf->mds_bal_idle_threshold > 0 &&
@@ -626,7 +660,7 @@ void MDBalancer::try_rebalance()
       dout(0) << " exporting idle (" << pop << ") import " << *im
 	      << " back to mds." << im->inode->authority().first
 	      << dendl;
-      mds->mdcache->migrator->export_dir_nicely(im, im->inode->authority().first);
+      export_dir(im, im->inode->authority().first);
       continue;
     }
 
@@ -680,7 +714,7 @@ void MDBalancer::try_rebalance()
 	  dout(0) << "reexporting " << *dir
 		  << " pop " << pop
 		  << " back to mds." << target << dendl;
-	  mds->mdcache->migrator->export_dir_nicely(dir, target);
+	  export_dir(dir, target);
 	  have += pop;
 	  import_from_map.erase(plast);
 	  import_pop_map.erase(pop);
@@ -711,7 +745,7 @@ void MDBalancer::try_rebalance()
 		  << " back to mds." << imp->inode->authority()
 		  << dendl;
 	  have += pop;
-	  mds->mdcache->migrator->export_dir_nicely(imp, imp->inode->authority().first);
+	  export_dir(imp, imp->inode->authority().first);
 	}
 	if (amount-have < MIN_OFFLOAD) break;
       }
@@ -730,6 +764,7 @@ void MDBalancer::try_rebalance()
 	 pot != candidates.end();
 	 ++pot) {
       if ((*pot)->get_inode()->is_stray()) continue;
+      if (recently_migrated(*pot)) continue;
       find_exports(*pot, amount, exports, have, already_exporting);
       if (have > amount-MIN_OFFLOAD)
 	break;
@@ -744,7 +779,7 @@ void MDBalancer::try_rebalance()
 	       << " to mds." << target
 	       << " " << **it
 	       << dendl;
-      mds->mdcache->migrator->export_dir_nicely(*it, target);
+      export_dir(*it, target);
     }
   }
 
@@ -1094,6 +1129,7 @@ void MDBalancer::hit_dir(utime_t now, CDir *dir, int type, int who, double amoun
 void MDBalancer::subtract_export(CDir *dir, utime_t now)
 {
   dirfrag_load_vec_t subload = dir->pop_auth_subtree;
+  last_migrated[dir->dirfrag()] = now;
 
   while (true) {
     dir = dir->inode->get_parent_dir();
@@ -1108,6 +1144,7 @@ void MDBalancer::subtract_export(CDir *dir, utime_t now)
 void MDBalancer::add_import(CDir *dir, utime_t now)
 {
   dirfrag_load_vec_t subload = dir->pop_auth_subtree;
+  last_migrated[dir->dirfrag()] = now;
 
   while (true) {
     dir = dir->inode->get_parent_dir();
@@ -67,6 +67,12 @@ class MDBalancer {
   map<mds_rank_t, int> old_prev_targets;  // # iterations they _haven't_ been targets
   bool check_targets();
 
+  // subtrees that moved lately, and when; see mds_bal_migrate_cooldown.
+  // trimmed by try_rebalance
+  map<dirfrag_t, utime_t> last_migrated;
+  bool recently_migrated(CDir *dir);
+  void export_dir(CDir *dir, mds_rank_t target);
+
   double try_match(mds_rank_t ex, double& maxex,
                    mds_rank_t im, double& maxim);
   double get_maxim(mds_rank_t im) {
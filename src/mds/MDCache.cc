@@ -126,6 +126,8 @@ long g_num_dirs = 0;
 long g_num_dns = 0;
 long g_num_caps = 0;
 
+long g_num_dn_name_bytes = 0;
+
 set<int> SimpleLock::empty_gather_set;
 
 
@@ -6225,6 +6227,18 @@ bool MDCache::trim(int max, int count)
       max = 1;
   } else if (max < 0) {
     max = g_conf->mds_cache_size;
+    uint64_t limit = g_conf->mds_cache_memory_limit;
+    uint64_t bytes = limit ? get_cache_bytes() : 0;
+    if (bytes > limit && lru.lru_get_size() > 0) {
+      // shrink the dentry count in proportion to the overshoot
+      int fit = (double)lru.lru_get_size() * limit / bytes;
+      if (fit < 1)
+	fit = 1;
+      dout(7) << "trim cache is " << bytes << " bytes > limit " << limit
+	      << ", trimming to " << fit << " dentries" << dendl;
+      if (max <= 0 || fit < max)
+	max = fit;
+    }
     if (max <= 0)
       return false;
   }
@@ -7176,6 +7190,17 @@ void MDCache::trim_client_leases()
 }
 
 
+uint64_t MDCache::get_cache_bytes() const
+{
+  // the fixed size of each object (which includes all of its locks and
+  // lists) plus the dentry names; this leaves out the inode's maps and
+  // xattrs, so it is a lower bound
+  return (uint64_t)g_num_ino * sizeof(CInode) +
+    (uint64_t)g_num_dir * sizeof(CDir) +
+    (uint64_t)g_num_dn * sizeof(CDentry) + g_num_dn_name_bytes +
+    (uint64_t)g_num_cap * sizeof(Capability);
+}
+
 void MDCache::check_memory_usage()
 {
   static MemoryModel mm(g_ceph_context);
@@ -7203,11 +7228,19 @@ void MDCache::check_memory_usage()
   mds->mlogger->set(l_mdm_heap, last.get_heap());
   mds->mlogger->set(l_mdm_malloc, last.malloc);
 
-  if (num_inodes_with_caps > g_conf->mds_cache_size) {
-    float ratio = (float)g_conf->mds_cache_size * .9 / (float)num_inodes_with_caps;
-    if (ratio < 1.0)
-      mds->server->recall_client_state(ratio);
+  mds->mlogger->set(l_mdm_cache_bytes, get_cache_bytes());
+
+  float ratio = 1.0;
+  if (num_inodes_with_caps > g_conf->mds_cache_size)
+    ratio = (float)g_conf->mds_cache_size * .9 / (float)num_inodes_with_caps;
+  uint64_t limit = g_conf->mds_cache_memory_limit;
+  uint64_t bytes = get_cache_bytes();
+  if (limit && bytes > limit) {
+    // caps pin their inodes, so trim() alone cannot get us under the limit
+    ratio = MIN(ratio, (float)((double)limit * .9 / (double)bytes));
   }
+  if (ratio < 1.0)
+    mds->server->recall_client_state(ratio);
 
 }
 
@@ -633,6 +633,8 @@ public:
   // cache
   void set_cache_size(size_t max) { lru.lru_set_max(max); }
   size_t get_cache_size() { return lru.lru_get_size(); }
+  /// estimated bytes held by cached inodes, dirfrags, dentries and caps
+  uint64_t get_cache_bytes() const;
 
   // trimming
   bool trim(int max=-1, int count=-1);   // trim cache
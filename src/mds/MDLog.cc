@@ -74,6 +74,8 @@ void MDLog::create_logger()
   plb.add_u64(l_mdl_wrpos, "wrpos", "Journaler  write position");
   plb.add_u64(l_mdl_rdpos, "rdpos", "Journaler  read position");
   plb.add_u64(l_mdl_jlat, "jlat", "Journaler flush latency");
+  plb.add_u64_counter(l_mdl_evbatch, "evbatch",
+      "Batches of events appended by the submit thread");
 
   // logger
   logger = plb.create_perf_counters();
@@ -361,53 +363,63 @@ void MDLog::_submit_thread()
       continue;
     }
 
-    PendingEvent data = it->second.front();
-    it->second.pop_front();
+    // take everything queued for this segment at once, so that a burst
+    // of events is appended back to back and goes out in one flush
+    list<PendingEvent> batch;
+    batch.swap(it->second);
 
     submit_mutex.Unlock();
 
-    if (data.le) {
-      LogEvent *le = data.le;
-      LogSegment *ls = le->_segment;
-      // encode it, with event type
-      bufferlist bl;
-      le->encode_with_header(bl);
+    bool do_flush = false;
+    int appended = 0;
+    for (list<PendingEvent>::iterator p = batch.begin(); p != batch.end(); ++p) {
+      PendingEvent &data = *p;
+      if (data.le) {
+	LogEvent *le = data.le;
+	LogSegment *ls = le->_segment;
+	// encode it, with event type
+	bufferlist bl;
+	le->encode_with_header(bl);
 
-      uint64_t write_pos = journaler->get_write_pos();
+	uint64_t write_pos = journaler->get_write_pos();
 
-      le->set_start_off(write_pos);
-      if (le->get_type() == EVENT_SUBTREEMAP)
-	ls->offset = write_pos;
+	le->set_start_off(write_pos);
+	if (le->get_type() == EVENT_SUBTREEMAP)
+	  ls->offset = write_pos;
 
-      dout(5) << "_submit_thread " << write_pos << "~" << bl.length()
-	      << " : " << *le << dendl;
+	dout(5) << "_submit_thread " << write_pos << "~" << bl.length()
+		<< " : " << *le << dendl;
 
-      // journal it.
-      const uint64_t new_write_pos = journaler->append_entry(bl);  // bl is destroyed.
-      ls->end = new_write_pos;
+	// journal it.
+	const uint64_t new_write_pos = journaler->append_entry(bl);  // bl is destroyed.
+	ls->end = new_write_pos;
 
-      journaler->wait_for_flush(new C_MDL_Flushed(
-            this, new_write_pos, data.fin));
+	journaler->wait_for_flush(new C_MDL_Flushed(
+	      this, new_write_pos, data.fin));
 
-      if (data.flush)
-	journaler->flush();
-
-      if (logger)
-	logger->set(l_mdl_wrpos, ls->end);
+	if (logger)
+	  logger->set(l_mdl_wrpos, ls->end);
 
-      delete le;
-    } else {
-      journaler->wait_for_flush(new C_MDL_Flushed(
-            this, journaler->get_write_pos(), data.fin));
+	appended++;
+	delete le;
+      } else {
+	journaler->wait_for_flush(new C_MDL_Flushed(
+	      this, journaler->get_write_pos(), data.fin));
+      }
       if (data.flush)
-	journaler->flush();
+	do_flush = true;
     }
 
+    if (do_flush)
+      journaler->flush();
+    if (logger)
+      logger->inc(l_mdl_evbatch);
+
     submit_mutex.Lock();
-    if (data.flush)
+    if (do_flush)
       unflushed = 0;
-    else if (data.le)
-      unflushed++;
+    else
+      unflushed += appended;
   }
 
   submit_mutex.Unlock();
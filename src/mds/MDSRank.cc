@@ -2193,6 +2193,7 @@ bool MDSRank::command_dirfrag_ls(
   // NB using get_leaves_under instead of get_dirfrags to give
   // you the list of what dirfrags may exist, not which are in cache
   in->dirfragtree.get_leaves_under(frag_t(), frags);
+  utime_t now = ceph_clock_now(g_ceph_context);
   for (std::list<frag_t>::iterator i = frags.begin();
        i != frags.end(); ++i) {
     f->open_object_section("frag");
@@ -2201,6 +2202,20 @@ bool MDSRank::command_dirfrag_ls(
     std::ostringstream frag_str;
     frag_str << std::hex << i->value() << "/" << std::dec << i->bits();
     f->dump_string("str", frag_str.str());
+    // and, for those in cache, what the balancer goes by
+    CDir *dir = in->get_dirfrag(*i);
+    if (dir) {
+      f->dump_bool("auth", dir->is_auth());
+      f->dump_bool("complete", dir->is_complete());
+      f->dump_unsigned("size", dir->get_frag_size());
+      f->open_object_section("load");
+      dir->dump_load(f, now, mdcache->decayrate);
+      f->close_section();
+      if (dir->is_auth()) {
+	f->dump_bool("should_split", dir->should_split());
+	f->dump_bool("should_merge", dir->should_merge());
+      }
+    }
     f->close_section();
   }
   f->close_section();
@@ -2285,6 +2300,8 @@ void MDSRank::create_logger()
     mdm_plb.add_u64(l_mdm_heap, "heap", "Heap size");
     mdm_plb.add_u64(l_mdm_malloc, "malloc", "Malloc size");
     mdm_plb.add_u64(l_mdm_buf, "buf", "Buffer size");
+    mdm_plb.add_u64(l_mdm_cache_bytes, "cache_bytes",
+		    "Estimated bytes in the metadata cache");
     mlogger = mdm_plb.create_perf_counters();
     g_ceph_context->get_perfcounters_collection()->add(mlogger);
   }
@@ -85,6 +85,7 @@ enum {
   l_mdm_heap,
   l_mdm_malloc,
   l_mdm_buf,
+  l_mdm_cache_bytes,
   l_mdm_last,
 };
 
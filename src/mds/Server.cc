@@ -884,6 +884,13 @@ void Server::recall_client_state(float ratio)
 	   << ", caps per client " << min_caps_per_client << "-" << max_caps_per_client
 	   << dendl;
 
+  // each session may be asked for at most mds_recall_max_caps caps per
+  // decay period, so a client holding many caps is not told to drop
+  // most of them at once every tick
+  utime_t now = ceph_clock_now(g_ceph_context);
+  DecayRate recall_rate(g_conf->mds_recall_max_decay_rate);
+  double recall_max = g_conf->mds_recall_max_caps;
+
   set<Session*> sessions;
   mds->sessionmap.get_client_session_set(sessions);
   for (set<Session*>::const_iterator p = sessions.begin();
@@ -901,7 +908,19 @@ void Server::recall_client_state(float ratio)
 
     if (session->caps.size() > min_caps_per_client) {	
       int newlim = MIN((int)(session->caps.size() * ratio), max_caps_per_client);
+      if (recall_max > 0) {
+	double budget = recall_max - session->recall_caps.get(now, recall_rate);
+	if (budget < 1.0) {
+	  dout(10) << "  recall budget for " << session->info.inst
+		   << " used up, not recalling" << dendl;
+	  continue;
+	}
+	if ((double)session->caps.size() - newlim > budget)
+	  newlim = session->caps.size() - (int)budget;
+      }
       if (session->caps.size() > newlim) {
+	  session->recall_caps.hit(now, recall_rate,
+				   session->caps.size() - newlim);
           MClientSession *m = new MClientSession(CEPH_SESSION_RECALL_STATE);
           m->head.max_caps = newlim;
           mds->send_message_client(m, session);
@@ -3216,6 +3235,18 @@ void Server::handle_client_readdir(MDRequestRef& mdr)
   dout(10) << "handle_client_readdir on " << *dir << dendl;
   assert(dir->is_auth());
 
+  // the client will most likely go on to the next frag
+  if (g_conf->mds_dir_prefetch_next_frag && !fg.is_rightmost() &&
+      diri->is_auth()) {
+    frag_t nextfg = diri->dirfragtree[fg.next().value()];
+    CDir *next = diri->get_or_open_dirfrag(mdcache, nextfg);
+    if (next->is_auth() && !next->is_complete() &&
+	!next->state_test(CDir::STATE_FETCHING) && next->can_auth_pin()) {
+      dout(10) << " prefetching next frag " << *next << dendl;
+      next->fetch(NULL);
+    }
+  }
+
   if (!dir->is_complete()) {
     if (dir->is_frozen()) {
       dout(7) << "dir is frozen " << *dir << dendl;
@@ -354,6 +354,8 @@ void SessionMap::save(MDSInternalContextBase *onsave, version_t needv)
     loaded_legacy = false;  // only need to truncate once.
   }
 
+  dout(10) << __func__ << ": " << dirty_sessions.size() << " dirty, "
+	   << null_sessions.size() << " removed sessions" << dendl;
   dout(20) << " updating keys:" << dendl;
   map<string, bufferlist> to_set;
   for(std::set<entity_name_t>::iterator i = dirty_sessions.begin();
@@ -564,9 +566,7 @@ void SessionMap::remove_session(Session *s)
   s->trim_completed_requests(0);
   s->item_session_list.remove_myself();
   session_map.erase(s->info.inst.name);
-  if (dirty_sessions.count(s->info.inst.name)) {
-    dirty_sessions.erase(s->info.inst.name);
-  }
+  dirty_sessions.erase(s->info.inst.name);
   null_sessions.insert(s->info.inst.name);
   s->put();
 }
@@ -595,6 +595,9 @@ void SessionMap::_mark_dirty(Session *s)
   }
 
   dirty_sessions.insert(s->info.inst.name);
+  // a session removed and then readded before the save must not have its
+  // key removed by that save
+  null_sessions.erase(s->info.inst.name);
 }
 
 void SessionMap::mark_dirty(Session *s)
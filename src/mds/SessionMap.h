@@ -125,6 +125,7 @@ public:
   utime_t recalled_at;  // When was I asked to SESSION_RECALL?
   uint32_t recall_count;  // How many caps was I asked to SESSION_RECALL?
   uint32_t recall_release_count;  // How many caps have I actually revoked?
+  DecayCounter recall_caps;  // Caps asked back lately, bounds further recalls
 
   session_info_t info;                         ///< durable bits
 
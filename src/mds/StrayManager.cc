@@ -169,15 +169,20 @@ void StrayManager::purge(CDentry *dn, uint32_t op_allowance)
   gather.activate();
 }
 
-class C_PurgeStrayLogged : public StrayManagerContext {
-  CDentry *dn;
-  version_t pdv;
+class C_PurgeStraysLogged : public StrayManagerContext {
+  list<pair<CDentry*, version_t> > dns;
   LogSegment *ls;
 public:
-  C_PurgeStrayLogged(StrayManager *sm_, CDentry *d, version_t v, LogSegment *s) : 
-    StrayManagerContext(sm_), dn(d), pdv(v), ls(s) { }
+  C_PurgeStraysLogged(StrayManager *sm_, LogSegment *s) :
+    StrayManagerContext(sm_), ls(s) { }
+  void add(CDentry *dn, version_t pdv) {
+    dns.push_back(make_pair(dn, pdv));
+  }
   void finish(int r) {
-    sm->_purge_stray_logged(dn, pdv, ls);
+    for (list<pair<CDentry*, version_t> >::iterator p = dns.begin();
+	 p != dns.end();
+	 ++p)
+      sm->_purge_stray_logged(p->first, p->second, ls);
   }
 };
 
@@ -227,13 +232,50 @@ void StrayManager::_purge_stray_purged(
       assert(0 == "rogue reference to purging inode");
     }
 
+    // the dentry is journaled away with the next batch
+    purged.push_back(dn);
+
+    num_strays--;
+    logger->set(l_mdc_num_strays, num_strays);
+    logger->inc(l_mdc_strays_purged);
+  }
+
+  num_strays_purging--;
+  logger->set(l_mdc_num_strays_purging, num_strays_purging);
+
+  // Release resources
+  dout(10) << __func__ << ": decrementing op allowance "
+    << ops_allowance << " from " << ops_in_flight << " in flight" << dendl;
+  assert(ops_in_flight >= ops_allowance);
+  ops_in_flight -= ops_allowance;
+  logger->set(l_mdc_num_purge_ops, ops_in_flight);
+  files_purging -= 1;
+
+  // with a backlog, purges complete back to back: journal them together
+  if (!purged.empty() &&
+      (purged.size() >= g_conf->mds_purge_journal_batch ||
+       ready_for_purge.empty() || files_purging == 0))
+    _journal_purged();
+  _advance();
+}
+
+void StrayManager::_journal_purged()
+{
+  dout(10) << __func__ << " " << purged.size() << " dentries" << dendl;
+
+  EUpdate *le = new EUpdate(mds->mdlog, "purge_stray");
+  mds->mdlog->start_entry(le);
+  C_PurgeStraysLogged *fin = new C_PurgeStraysLogged(
+    this, mds->mdlog->get_current_segment());
+
+  for (list<CDentry*>::iterator p = purged.begin(); p != purged.end(); ++p) {
+    CDentry *dn = *p;
+    CInode *in = dn->get_projected_linkage()->get_inode();
+
     // kill dentry.
     version_t pdv = dn->pre_dirty();
     dn->push_projected_linkage(); // NULL
 
-    EUpdate *le = new EUpdate(mds->mdlog, "purge_stray");
-    mds->mdlog->start_entry(le);
-
     // update dirfrag fragstat, rstat
     CDir *dir = dn->get_dir();
     fnode_t *pf = dir->project_fnode();
@@ -249,25 +291,11 @@ void StrayManager::_purge_stray_purged(
     le->metablob.add_null_dentry(dl, dn, true);
     le->metablob.add_destroyed_inode(in->ino());
 
-    mds->mdlog->submit_entry(le, new C_PurgeStrayLogged(this, dn, pdv,
-          mds->mdlog->get_current_segment()));
-
-    num_strays--;
-    logger->set(l_mdc_num_strays, num_strays);
-    logger->inc(l_mdc_strays_purged);
+    fin->add(dn, pdv);
   }
+  purged.clear();
 
-  num_strays_purging--;
-  logger->set(l_mdc_num_strays_purging, num_strays_purging);
-
-  // Release resources
-  dout(10) << __func__ << ": decrementing op allowance "
-    << ops_allowance << " from " << ops_in_flight << " in flight" << dendl;
-  assert(ops_in_flight >= ops_allowance);
-  ops_in_flight -= ops_allowance;
-  logger->set(l_mdc_num_purge_ops, ops_in_flight);
-  files_purging -= 1;
-  _advance();
+  mds->mdlog->submit_entry(le, fin);
 }
 
 void StrayManager::_purge_stray_logged(CDentry *dn, version_t pdv, LogSegment *ls)
@@ -41,6 +41,9 @@ class StrayManager : public md_config_obs_t
   // No more refs, can purge these
   std::list<QueuedStray> ready_for_purge;
 
+  // Purged from RADOS, dentry removal not journaled yet
+  std::list<CDentry*> purged;
+
   // Global references for doing I/O
   MDSRank *mds;
   PerfCounters *logger;
@@ -74,6 +77,11 @@ class StrayManager : public md_config_obs_t
    */
   void _purge_stray_purged(CDentry *dn, uint32_t ops, bool only_head);
 
+  /**
+   * Journal the removal of the dentries in purged, in one EUpdate.
+   */
+  void _journal_purged();
+
   void _purge_stray_logged(CDentry *dn, version_t pdv, LogSegment *ls);
 
   /**
@@ -85,7 +93,7 @@ class StrayManager : public md_config_obs_t
   friend class StrayManagerIOContext;
   friend class StrayManagerContext;
 
-  friend class C_PurgeStrayLogged;
+  friend class C_PurgeStraysLogged;
   friend class C_TruncateStrayLogged;
   friend class C_IO_PurgeStrayPurged;
 
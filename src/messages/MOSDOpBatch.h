@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+
+#ifndef CEPH_MOSDOPBATCH_H
+#define CEPH_MOSDOPBATCH_H
+
+#include "msg/Message.h"
+#include "MOSDOp.h"
+
+/*
+ * Independent client ops for the same osd, sent together.  The osd
+ * dispatches each as if it had come on its own, and replies to each
+ * with its own MOSDOpReply.
+ */
+
+class MOSDOpBatch : public Message {
+
+  static const int HEAD_VERSION = 1;
+  static const int COMPAT_VERSION = 1;
+
+public:
+  vector<MOSDOp*> ops;  ///< in order; we hold a ref on each
+
+  virtual void decode_payload() {
+    bufferlist::iterator p = payload.begin();
+    __u32 n;
+    ::decode(n, p);
+    ops.reserve(n);
+    while (n--) {
+      Message *m = decode_message(NULL, 0, p);
+      if (!m || m->get_type() != CEPH_MSG_OSD_OP) {
+	if (m)
+	  m->put();
+	throw buffer::malformed_input("bad op in osd_op_batch");
+      }
+      ops.push_back(static_cast<MOSDOp*>(m));
+    }
+  }
+
+  virtual void encode_payload(uint64_t features) {
+    __u32 n = ops.size();
+    ::encode(n, payload);
+    for (vector<MOSDOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+      encode_message(*p, features, payload);
+  }
+
+  MOSDOpBatch()
+    : Message(MSG_OSD_OP_BATCH, HEAD_VERSION, COMPAT_VERSION) {}
+  /// takes over the refs in o
+  MOSDOpBatch(vector<MOSDOp*> &o)
+    : Message(MSG_OSD_OP_BATCH, HEAD_VERSION, COMPAT_VERSION) {
+    ops.swap(o);
+  }
+private:
+  ~MOSDOpBatch() {
+    for (vector<MOSDOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+      (*p)->put();
+  }
+
+public:
+  const char *get_type_name() const { return "osd_op_batch"; }
+  void print(ostream& out) const {
+    out << "osd_op_batch(" << ops.size() << " ops";
+    if (!ops.empty())
+      out << " tid " << ops.front()->get_tid() << ".." << ops.back()->get_tid();
+    out << ")";
+  }
+};
+
+
+#endif
@@ -25,7 +25,7 @@
 
 class MOSDRepOp : public Message {
 
-  static const int HEAD_VERSION = 1;
+  static const int HEAD_VERSION = 2;
   static const int COMPAT_VERSION = 1;
 
 public:
@@ -53,6 +53,8 @@ public:
   eversion_t pg_trim_rollback_to;   // primary->replica: trim rollback
                                     // info to here
 
+  eversion_t pg_committed_to; ///< primary->replica: committed on all shards up to here
+
   hobject_t new_temp_oid;      ///< new temp object that we must now start tracking
   hobject_t discard_temp_oid;  ///< previously used temp object that we can now stop tracking
 
@@ -83,6 +85,8 @@ public:
     ::decode(from, p);
     ::decode(updated_hit_set_history, p);
     ::decode(pg_trim_rollback_to, p);
+    if (header.version >= 2)
+      ::decode(pg_committed_to, p);
   }
 
   virtual void encode_payload(uint64_t features) {
@@ -101,6 +105,7 @@ public:
     ::encode(from, payload);
     ::encode(updated_hit_set_history, payload);
     ::encode(pg_trim_rollback_to, payload);
+    ::encode(pg_committed_to, payload);
   }
 
   MOSDRepOp()
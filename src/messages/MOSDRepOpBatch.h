@@ -0,0 +1,101 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+
+#ifndef CEPH_MOSDREPOPBATCH_H
+#define CEPH_MOSDREPOPBATCH_H
+
+#include "msg/Message.h"
+#include "osd/osd_types.h"
+#include "MOSDRepOp.h"
+
+/*
+ * Several repops for the same pg and replica, sent together.  The
+ * replica applies them in order, in one store submission, and acks
+ * each one as if it had come on its own.
+ */
+
+class MOSDRepOpBatch : public Message {
+
+  static const int HEAD_VERSION = 1;
+  static const int COMPAT_VERSION = 1;
+
+public:
+  epoch_t map_epoch;   ///< newest map_epoch of the ops
+  spg_t pgid;
+  vector<MOSDRepOp*> ops;  ///< in order; we hold a ref on each
+
+  int get_cost() const {
+    int cost = 0;
+    for (vector<MOSDRepOp*>::const_iterator p = ops.begin();
+	 p != ops.end();
+	 ++p)
+      cost += (*p)->get_cost();
+    return cost;
+  }
+
+  virtual void decode_payload() {
+    bufferlist::iterator p = payload.begin();
+    ::decode(map_epoch, p);
+    ::decode(pgid, p);
+    __u32 n;
+    ::decode(n, p);
+    ops.reserve(n);
+    while (n--) {
+      Message *m = decode_message(NULL, 0, p);
+      if (!m || m->get_type() != MSG_OSD_REPOP)
+	throw buffer::malformed_input("bad op in osd_repop_batch");
+      ops.push_back(static_cast<MOSDRepOp*>(m));
+    }
+  }
+
+  virtual void encode_payload(uint64_t features) {
+    ::encode(map_epoch, payload);
+    ::encode(pgid, payload);
+    __u32 n = ops.size();
+    ::encode(n, payload);
+    for (vector<MOSDRepOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+      encode_message(*p, features, payload);
+  }
+
+  MOSDRepOpBatch()
+    : Message(MSG_OSD_REPOP_BATCH, HEAD_VERSION, COMPAT_VERSION),
+      map_epoch(0) {}
+  /// takes over the refs in ops
+  MOSDRepOpBatch(spg_t p, vector<MOSDRepOp*> &o)
+    : Message(MSG_OSD_REPOP_BATCH, HEAD_VERSION, COMPAT_VERSION),
+      map_epoch(0),
+      pgid(p) {
+    ops.swap(o);
+    for (vector<MOSDRepOp*>::iterator i = ops.begin(); i != ops.end(); ++i)
+      if ((*i)->map_epoch > map_epoch)
+	map_epoch = (*i)->map_epoch;
+  }
+private:
+  ~MOSDRepOpBatch() {
+    for (vector<MOSDRepOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+      (*p)->put();
+  }
+
+public:
+  const char *get_type_name() const { return "osd_repop_batch"; }
+  void print(ostream& out) const {
+    out << "osd_repop_batch(" << pgid << " e" << map_epoch
+	<< " " << ops.size() << " ops";
+    if (!ops.empty())
+      out << " " << ops.front()->version << ".." << ops.back()->version;
+    out << ")";
+  }
+};
+
+
+#endif
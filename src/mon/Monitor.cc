@@ -297,7 +297,8 @@ void Monitor::do_admin_command(string command, cmdmap_t& cmdmap, string format,
   bool read_only = (command == "mon_status" ||
                     command == "mon metadata" ||
                     command == "quorum_status" ||
-                    command == "ops");
+                    command == "ops" ||
+                    command == "dump_kv_stats");
 
   (read_only ? audit_clog->debug() : audit_clog->info())
     << "from='admin socket' entity='admin socket' "
@@ -335,6 +336,13 @@ void Monitor::do_admin_command(string command, cmdmap_t& cmdmap, string format,
     if (f) {
       f->flush(ss);
     }
+  } else if (command == "dump_kv_stats") {
+    if (!f)
+      f.reset(Formatter::create("json-pretty"));
+    f->open_object_section("kv_stats");
+    store->get_statistics(f.get());
+    f->close_section();
+    f->flush(ss);
   } else {
     assert(0 == "bad AdminSocket command binding");
   }
@@ -597,6 +605,9 @@ int Monitor::preinit()
   }
 
   paxos->init_logger();
+  for (int i = 0; i < PAXOS_NUM; ++i) {
+    paxos_service[i]->init_logger();
+  }
 
   // verify cluster_uuid
   {
@@ -741,6 +752,10 @@ int Monitor::preinit()
                                      admin_hook,
                                      "show the ops currently in flight");
   assert(r == 0);
+  r = admin_socket->register_command("dump_kv_stats", "dump_kv_stats",
+                                     admin_hook,
+                                     "show key/value store statistics");
+  assert(r == 0);
   lock.Lock();
 
   // add ourselves as a conf observer
@@ -862,6 +877,7 @@ void Monitor::shutdown()
     admin_socket->unregister_command("sync_force");
     admin_socket->unregister_command("add_bootstrap_peer_hint");
     admin_socket->unregister_command("ops");
+    admin_socket->unregister_command("dump_kv_stats");
     delete admin_hook;
     admin_hook = NULL;
   }
@@ -903,7 +919,8 @@ void Monitor::shutdown()
 
 void Monitor::wait_for_paxos_write()
 {
-  if (paxos->is_writing() || paxos->is_writing_previous()) {
+  if (paxos->is_writing() || paxos->is_writing_previous() ||
+      paxos->is_writing_begin()) {
     dout(10) << __func__ << " flushing pending write" << dendl;
     lock.Unlock();
     store->flush();
@@ -4194,7 +4211,7 @@ void Monitor::handle_get_version(MonOpRequestRef op)
   }
 
   if (svc) {
-    if (!svc->is_readable()) {
+    if (!svc->is_readable(0, true)) {
       svc->wait_for_readable(op, new C_RetryMessage(this, op));
       goto out;
     }
@@ -26,8 +26,20 @@
 #include "include/assert.h"
 #include "common/Formatter.h"
 #include "common/Finisher.h"
+#include "common/Mutex.h"
+#include "common/perf_counters.h"
 #include "common/errno.h"
 
+enum {
+  l_mon_store_first = 46000,
+  l_mon_store_commit,
+  l_mon_store_commit_queued,
+  l_mon_store_commit_batch,
+  l_mon_store_commit_latency,
+  l_mon_store_queue_latency,
+  l_mon_store_last,
+};
+
 class MonitorDBStore
 {
   boost::scoped_ptr<KeyValueDB> db;
@@ -39,6 +51,10 @@ class MonitorDBStore
 
   Finisher io_work;
 
+  Mutex queue_lock;
+
+  PerfCounters *logger;
+
   bool is_open;
 
  public:
@@ -257,7 +273,30 @@ class MonitorDBStore
 
   int apply_transaction(MonitorDBStore::TransactionRef t) {
     KeyValueDB::Transaction dbt = db->get_transaction();
+    list<pair<string, pair<string,string> > > compact;
+    prepare_transaction(t, dbt, &compact);
+    return submit_transaction(dbt, &compact);
+  }
+
+ private:
+  /**
+   * transactions queued and not yet picked up by io_work, under
+   * queue_lock
+   *
+   * io_work commits whatever has piled up here while it was syncing the
+   * last batch as one batch, with one sync, and so writes from Paxos and
+   * the services that queue up behind a slow disk share a commit.
+   */
+  struct QueuedTransaction {
+    MonitorDBStore::TransactionRef t;
+    Context *oncommit;
+    utime_t queued;
+  };
+  list<QueuedTransaction> queued;
 
+  void prepare_transaction(MonitorDBStore::TransactionRef t,
+			   KeyValueDB::Transaction dbt,
+			   list<pair<string, pair<string,string> > > *compact) {
     if (do_dump) {
       if (!g_conf->mon_debug_dump_json) {
         bufferlist bl;
@@ -270,7 +309,6 @@ class MonitorDBStore
       }
     }
 
-    list<pair<string, pair<string,string> > > compact;
     for (list<Op>::const_iterator it = t->ops.begin();
 	 it != t->ops.end();
 	 ++it) {
@@ -283,7 +321,7 @@ class MonitorDBStore
 	dbt->rmkey(op.prefix, op.key);
 	break;
       case Transaction::OP_COMPACT:
-	compact.push_back(make_pair(op.prefix, make_pair(op.key, op.endkey)));
+	compact->push_back(make_pair(op.prefix, make_pair(op.key, op.endkey)));
 	break;
       default:
 	derr << __func__ << " unknown op type " << op.type << dendl;
@@ -291,15 +329,24 @@ class MonitorDBStore
 	break;
       }
     }
+  }
+
+  int submit_transaction(KeyValueDB::Transaction dbt,
+			 list<pair<string, pair<string,string> > > *compact) {
+    utime_t start = ceph_clock_now(NULL);
     int r = db->submit_transaction_sync(dbt);
+    if (logger) {
+      logger->inc(l_mon_store_commit);
+      logger->tinc(l_mon_store_commit_latency, ceph_clock_now(NULL) - start);
+    }
     if (r >= 0) {
-      while (!compact.empty()) {
-	if (compact.front().second.first == string() &&
-	    compact.front().second.second == string())
-	  db->compact_prefix_async(compact.front().first);
+      while (!compact->empty()) {
+	if (compact->front().second.first == string() &&
+	    compact->front().second.second == string())
+	  db->compact_prefix_async(compact->front().first);
 	else
-	  db->compact_range_async(compact.front().first, compact.front().second.first, compact.front().second.second);
-	compact.pop_front();
+	  db->compact_range_async(compact->front().first, compact->front().second.first, compact->front().second.second);
+	compact->pop_front();
       }
     } else {
       assert(0 == "failed to write to db");
@@ -307,19 +354,46 @@ class MonitorDBStore
     return r;
   }
 
+  /// commit everything queued so far as one batch; runs in io_work
+  void apply_queued() {
+    list<QueuedTransaction> batch;
+    {
+      Mutex::Locker l(queue_lock);
+      batch.swap(queued);
+    }
+    if (batch.empty())
+      return;
+
+    utime_t now = ceph_clock_now(NULL);
+    KeyValueDB::Transaction dbt = db->get_transaction();
+    list<pair<string, pair<string,string> > > compact;
+    for (list<QueuedTransaction>::iterator p = batch.begin();
+	 p != batch.end();
+	 ++p) {
+      if (logger)
+	logger->tinc(l_mon_store_queue_latency, now - p->queued);
+      prepare_transaction(p->t, dbt, &compact);
+    }
+    if (logger)
+      logger->inc(l_mon_store_commit_batch, batch.size());
+    int r = submit_transaction(dbt, &compact);
+    for (list<QueuedTransaction>::iterator p = batch.begin();
+	 p != batch.end();
+	 ++p)
+      p->oncommit->complete(r);
+  }
+
   struct C_DoTransaction : public Context {
     MonitorDBStore *store;
-    MonitorDBStore::TransactionRef t;
-    Context *oncommit;
-    C_DoTransaction(MonitorDBStore *s, MonitorDBStore::TransactionRef t,
-		    Context *f)
-      : store(s), t(t), oncommit(f)
+    C_DoTransaction(MonitorDBStore *s)
+      : store(s)
     {}
     void finish(int r) {
-      /* The store serializes writes.  Each transaction is handled
-       * sequentially by the io_work Finisher.  If a transaction takes longer
-       * to apply its state to permanent storage, then no other transaction
-       * will be handled meanwhile.
+      /* The store serializes writes.  Each batch of queued transactions
+       * is handled sequentially by the io_work Finisher.  If a batch takes
+       * longer to apply its state to permanent storage, then no other
+       * transaction will be handled meanwhile; those queued in the
+       * meantime make up the next batch.
        *
        * We will now randomly inject random delays.  We can safely sleep prior
        * to applying the transaction as it won't break the model.
@@ -334,20 +408,33 @@ class MonitorDBStore
           << " seconds" << dendl;
         delay.sleep();
       }
-      int ret = store->apply_transaction(t);
-      oncommit->complete(ret);
+      store->apply_queued();
     }
   };
 
+ public:
   /**
    * queue transaction
    *
-   * Queue a transaction to commit asynchronously.  Trigger a context
-   * on completion (without any locks held).
+   * Queue a transaction to commit asynchronously, possibly in the same
+   * sync as others queued around the same time; they are applied in the
+   * order they were queued.  Trigger a context on completion (without
+   * any locks held).
    */
   void queue_transaction(MonitorDBStore::TransactionRef t,
 			 Context *oncommit) {
-    io_work.queue(new C_DoTransaction(this, t, oncommit));
+    Mutex::Locker l(queue_lock);
+    QueuedTransaction q;
+    q.t = t;
+    q.oncommit = oncommit;
+    q.queued = ceph_clock_now(NULL);
+    queued.push_back(q);
+    if (logger)
+      logger->inc(l_mon_store_commit_queued);
+    // the first one queued since the last batch was picked up kicks off
+    // the next
+    if (queued.size() == 1)
+      io_work.queue(new C_DoTransaction(this));
   }
 
   /**
@@ -592,6 +679,7 @@ class MonitorDBStore
     int r = db->open(out);
     if (r < 0)
       return r;
+    create_logger();
     io_work.start();
     is_open = true;
     return 0;
@@ -605,6 +693,7 @@ class MonitorDBStore
     int r = db->create_and_open(out);
     if (r < 0)
       return r;
+    create_logger();
     io_work.start();
     is_open = true;
     return 0;
@@ -613,9 +702,31 @@ class MonitorDBStore
   void close() {
     // there should be no work queued!
     io_work.stop();
+    if (logger) {
+      g_ceph_context->get_perfcounters_collection()->remove(logger);
+      delete logger;
+      logger = NULL;
+    }
     is_open = false;
   }
 
+  void create_logger() {
+    PerfCountersBuilder pcb(g_ceph_context, "mon_store", l_mon_store_first,
+			    l_mon_store_last);
+    pcb.add_u64_counter(l_mon_store_commit, "commit",
+			"Syncs of the store");
+    pcb.add_u64_counter(l_mon_store_commit_queued, "commit_queued",
+			"Transactions queued to commit in the background");
+    pcb.add_u64_avg(l_mon_store_commit_batch, "commit_batch",
+		    "Queued transactions committed per sync");
+    pcb.add_time_hist(l_mon_store_commit_latency, "commit_latency",
+		      "Latency of a sync");
+    pcb.add_time_hist(l_mon_store_queue_latency, "queue_latency",
+		      "Time queued transactions wait for their sync to start");
+    logger = pcb.create_perf_counters();
+    g_ceph_context->get_perfcounters_collection()->add(logger);
+  }
+
   void compact() {
     db->compact();
   }
@@ -624,6 +735,10 @@ class MonitorDBStore
     db->compact_prefix(prefix);
   }
 
+  void get_statistics(Formatter *f) {
+    db->get_statistics(f);
+  }
+
   uint64_t get_estimated_size(map<string, uint64_t> &extras) {
     return db->get_estimated_size(extras);
   }
@@ -634,6 +749,8 @@ class MonitorDBStore
       dump_fd_binary(-1),
       dump_fmt(true),
       io_work(g_ceph_context, "monstore"),
+      queue_lock("MonitorDBStore::queue_lock"),
+      logger(NULL),
       is_open(false) {
     string::const_reverse_iterator rit;
     int pos = 0;
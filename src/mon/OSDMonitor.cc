@@ -76,6 +76,8 @@ OSDMonitor::OSDMonitor(CephContext *cct, Monitor *mn, Paxos *p, const string& se
  : PaxosService(mn, p, service_name),
    inc_osd_cache(g_conf->mon_osd_cache_size),
    full_osd_cache(g_conf->mon_osd_cache_size),
+   inc_osd_reencoded_cache(g_conf->mon_osd_cache_size),
+   full_osd_reencoded_cache(g_conf->mon_osd_cache_size),
    thrash_map(0), thrash_last_up_osd(-1),
    op_tracker(cct, true, 1)
 {}
@@ -1210,7 +1212,28 @@ void OSDMonitor::share_map_with_random_osd()
     return;
   }
 
-  MonSession *s = mon->session_map.get_random_osd_session(&osdmap);
+  MonSession *s = NULL;
+  if (g_conf->osd_map_gossip_fanout > 0) {
+    // the osds pass it on from the root of the gossip tree; whichever
+    // mon has the root's session tells it, the leader if nobody does
+    int root = osdmap.get_map_gossip_root();
+    for (multimap<int,MonSession*>::iterator p =
+	   mon->session_map.by_osd.find(root);
+	 p != mon->session_map.by_osd.end() && p->first == root;
+	 ++p) {
+      if (p->second->inst == osdmap.get_inst(root)) {
+	s = p->second;
+	break;
+      }
+    }
+    if (!s && !mon->is_leader()) {
+      dout(10) << __func__ << " no session with gossip root osd." << root
+	       << dendl;
+      return;
+    }
+  }
+  if (!s)
+    s = mon->session_map.get_random_osd_session(&osdmap);
   if (!s) {
     dout(10) << __func__ << " no up osd on our session map" << dendl;
     return;
@@ -1850,6 +1873,15 @@ bool OSDMonitor::preprocess_boot(MonOpRequestRef op)
     goto ignore;
   }
 
+  if ((osdmap.get_features(CEPH_ENTITY_TYPE_OSD, NULL) &
+       CEPH_FEATURE_OSD_HITSET_CUCKOO) &&
+      !(m->get_connection()->get_features() & CEPH_FEATURE_OSD_HITSET_CUCKOO)) {
+    dout(0) << __func__ << " osdmap requires cuckoo hit sets but osd at "
+            << m->get_orig_source_inst()
+            << " doesn't announce support -- ignore" << dendl;
+    goto ignore;
+  }
+
   if (osdmap.test_flag(CEPH_OSDMAP_SORTBITWISE) &&
       !(m->osd_features & CEPH_FEATURE_OSD_BITWISE_HOBJ_SORT)) {
     mon->clog->info() << "disallowing boot of OSD "
@@ -2345,25 +2377,28 @@ void OSDMonitor::send_latest(MonOpRequestRef op, epoch_t start)
 }
 
 
-MOSDMap *OSDMonitor::build_latest_full()
+MOSDMap *OSDMonitor::build_latest_full(uint64_t features)
 {
   MOSDMap *r = new MOSDMap(mon->monmap->fsid);
-  get_version_full(osdmap.get_epoch(), r->maps[osdmap.get_epoch()]);
+  get_version_full(osdmap.get_epoch(), features, r->maps[osdmap.get_epoch()]);
   r->oldest_map = get_first_committed();
   r->newest_map = osdmap.get_epoch();
+  r->encode_features = features;
   return r;
 }
 
-MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
+MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to,
+				       uint64_t features)
 {
   dout(10) << "build_incremental [" << from << ".." << to << "]" << dendl;
   MOSDMap *m = new MOSDMap(mon->monmap->fsid);
   m->oldest_map = get_first_committed();
   m->newest_map = osdmap.get_epoch();
+  m->encode_features = features;
 
   for (epoch_t e = to; e >= from && e > 0; e--) {
     bufferlist bl;
-    int err = get_version(e, bl);
+    int err = get_version(e, features, bl);
     if (err == 0) {
       assert(bl.length());
       // if (get_version(e, bl) > 0) {
@@ -2373,7 +2408,7 @@ MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
     } else {
       assert(err == -ENOENT);
       assert(!bl.length());
-      get_version_full(e, bl);
+      get_version_full(e, features, bl);
       if (bl.length() > 0) {
       //else if (get_version("full", e, bl) > 0) {
       dout(20) << "build_incremental   full " << e << " "
@@ -2417,10 +2452,16 @@ void OSDMonitor::send_incremental(epoch_t first,
     first = session->osd_epoch + 1;
   }
 
+  // replies may be routed through another mon; only what we send on the
+  // session's own connection can be encoded for the peer up front
+  uint64_t features = CEPH_FEATURES_ALL;
+  if (!req && session->con)
+    features = session->con->get_features();
+
   if (first < get_first_committed()) {
     first = get_first_committed();
     bufferlist bl;
-    int err = get_version_full(first, bl);
+    int err = get_version_full(first, features, bl);
     assert(err == 0);
     assert(bl.length());
 
@@ -2431,6 +2472,7 @@ void OSDMonitor::send_incremental(epoch_t first,
     m->oldest_map = first;
     m->newest_map = osdmap.get_epoch();
     m->maps[first] = bl;
+    m->encode_features = features;
 
     if (req) {
       mon->send_reply(req, m);
@@ -2445,7 +2487,7 @@ void OSDMonitor::send_incremental(epoch_t first,
 
   while (first <= osdmap.get_epoch()) {
     epoch_t last = MIN(first + g_conf->osd_map_message_max, osdmap.get_epoch());
-    MOSDMap *m = build_incremental(first, last);
+    MOSDMap *m = build_incremental(first, last, features);
 
     if (req) {
       // send some maps.  it may not be all of them, but it will get them
@@ -2487,6 +2529,42 @@ int OSDMonitor::get_version_full(version_t ver, bufferlist& bl)
     return ret;
 }
 
+/*
+ * Old clients get maps in an older encoding, which MOSDMap would redo
+ * for every message; when a lot of them reconnect at once they all want
+ * the same few epochs, so keep the reencoded maps around instead.
+ */
+int OSDMonitor::get_version(version_t ver, uint64_t features, bufferlist& bl)
+{
+  if (!MOSDMap::needs_reencode(features))
+    return get_version(ver, bl);
+  pair<version_t, uint64_t> key(ver, features);
+  if (inc_osd_reencoded_cache.lookup(key, &bl))
+    return 0;
+  int ret = get_version(ver, bl);
+  if (!ret) {
+    MOSDMap::reencode_incremental(bl, features);
+    inc_osd_reencoded_cache.add(key, bl);
+  }
+  return ret;
+}
+
+int OSDMonitor::get_version_full(version_t ver, uint64_t features,
+				 bufferlist& bl)
+{
+  if (!MOSDMap::needs_reencode(features))
+    return get_version_full(ver, bl);
+  pair<version_t, uint64_t> key(ver, features);
+  if (full_osd_reencoded_cache.lookup(key, &bl))
+    return 0;
+  int ret = get_version_full(ver, bl);
+  if (!ret) {
+    MOSDMap::reencode_full(bl, features);
+    full_osd_reencoded_cache.add(key, bl);
+  }
+  return ret;
+}
+
 epoch_t OSDMonitor::blacklist(const entity_addr_t& a, utime_t until)
 {
   dout(10) << "blacklist " << a << " until " << until << dendl;
@@ -2517,7 +2595,8 @@ void OSDMonitor::check_sub(Subscription *sub)
     if (sub->next >= 1)
       send_incremental(sub->next, sub->session, sub->incremental_onetime);
     else
-      sub->session->con->send_message(build_latest_full());
+      sub->session->con->send_message(
+	build_latest_full(sub->session->con->get_features()));
     if (sub->onetime)
       mon->session_map.remove_sub(sub);
     else
@@ -2878,7 +2957,7 @@ namespace {
     SIZE, MIN_SIZE, CRASH_REPLAY_INTERVAL,
     PG_NUM, PGP_NUM, CRUSH_RULESET, HASHPSPOOL,
     NODELETE, NOPGCHANGE, NOSIZECHANGE,
-    WRITE_FADVISE_DONTNEED, NOSCRUB, NODEEP_SCRUB,
+    WRITE_FADVISE_DONTNEED, NOSCRUB, NODEEP_SCRUB, EC_OVERWRITES,
     HIT_SET_TYPE, HIT_SET_PERIOD, HIT_SET_COUNT, HIT_SET_FPP,
     USE_GMT_HITSET, AUID, TARGET_MAX_OBJECTS, TARGET_MAX_BYTES,
     CACHE_TARGET_DIRTY_RATIO, CACHE_TARGET_DIRTY_HIGH_RATIO,
@@ -3345,6 +3424,7 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
       ("hashpspool", HASHPSPOOL)("nodelete", NODELETE)
       ("nopgchange", NOPGCHANGE)("nosizechange", NOSIZECHANGE)
       ("noscrub", NOSCRUB)("nodeep-scrub", NODEEP_SCRUB)
+      ("ec_overwrites", EC_OVERWRITES)
       ("write_fadvise_dontneed", WRITE_FADVISE_DONTNEED)
       ("hit_set_type", HIT_SET_TYPE)("hit_set_period", HIT_SET_PERIOD)
       ("hit_set_count", HIT_SET_COUNT)("hit_set_fpp", HIT_SET_FPP)
@@ -3449,6 +3529,7 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case WRITE_FADVISE_DONTNEED:
 	  case NOSCRUB:
 	  case NODEEP_SCRUB:
+	  case EC_OVERWRITES:
 	    for (i = ALL_CHOICES.begin(); i != ALL_CHOICES.end(); ++i) {
 	      if (i->second == *it)
 		break;
@@ -3470,13 +3551,14 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	    break;
 	  case HIT_SET_FPP:
 	    {
-	      if (p->hit_set_params.get_type() == HitSet::TYPE_BLOOM) {
+	      if (p->hit_set_params.get_type() == HitSet::TYPE_BLOOM ||
+		  p->hit_set_params.get_type() == HitSet::TYPE_CUCKOO) {
 		BloomHitSet::Params *bloomp =
 		  static_cast<BloomHitSet::Params*>(p->hit_set_params.impl.get());
 		f->dump_float("hit_set_fpp", bloomp->get_fpp());
 	      } else if(var != "all") {
 		f->close_section();
-		ss << "hit set is not of type Bloom; " <<
+		ss << "hit set is not of type Bloom or cuckoo; " <<
 		  "invalid to get a false positive rate!";
 		r = -EINVAL;
 		goto reply;
@@ -3574,12 +3656,13 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	    break;
 	  case HIT_SET_FPP:
 	    {
-	      if (p->hit_set_params.get_type() == HitSet::TYPE_BLOOM) {
+	      if (p->hit_set_params.get_type() == HitSet::TYPE_BLOOM ||
+		  p->hit_set_params.get_type() == HitSet::TYPE_CUCKOO) {
 		BloomHitSet::Params *bloomp =
 		  static_cast<BloomHitSet::Params*>(p->hit_set_params.impl.get());
 		ss << "hit_set_fpp: " << bloomp->get_fpp() << "\n";
 	      } else if(var != "all") {
-		ss << "hit set is not of type Bloom; " <<
+		ss << "hit set is not of type Bloom or cuckoo; " <<
 		  "invalid to get a false positive rate!";
 		r = -EINVAL;
 		goto reply;
@@ -3627,6 +3710,7 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case WRITE_FADVISE_DONTNEED:
 	  case NOSCRUB:
 	  case NODEEP_SCRUB:
+	  case EC_OVERWRITES:
 	    for (i = ALL_CHOICES.begin(); i != ALL_CHOICES.end(); ++i) {
 	      if (i->second == *it)
 		break;
@@ -4894,6 +4978,19 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       ss << "expecting value 'true', 'false', '0', or '1'";
       return -EINVAL;
     }
+  } else if (var == "ec_overwrites") {
+    if (!p.is_erasure()) {
+      ss << "ec_overwrites can only be set on an erasure coded pool";
+      return -EINVAL;
+    }
+    if (val == "true" || (interr.empty() && n == 1)) {
+      p.set_flag(pg_pool_t::FLAG_EC_OVERWRITES);
+    } else if (val == "false" || (interr.empty() && n == 0)) {
+      p.unset_flag(pg_pool_t::FLAG_EC_OVERWRITES);
+    } else {
+      ss << "expecting value 'true', 'false', '0', or '1'";
+      return -EINVAL;
+    }
   } else if (var == "hit_set_type") {
     if (val == "none")
       p.hit_set_params = HitSet::Params();
@@ -4905,6 +5002,15 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
 	BloomHitSet::Params *bsp = new BloomHitSet::Params;
 	bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
 	p.hit_set_params = HitSet::Params(bsp);
+      } else if (val == "cuckoo") {
+	// the mons and OSDs decode HitSet archives and params; clients
+	// without the feature get a bloom stand-in (see pg_pool_t::encode)
+	err = check_cluster_features(CEPH_FEATURE_OSD_HITSET_CUCKOO, ss);
+	if (err)
+	  return err;
+	CuckooHitSet::Params *csp = new CuckooHitSet::Params;
+	csp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
+	p.hit_set_params = HitSet::Params(csp);
       } else if (val == "explicit_hash")
 	p.hit_set_params = HitSet::Params(new ExplicitHashHitSet::Params);
       else if (val == "explicit_object")
@@ -4932,8 +5038,9 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       ss << "error parsing floating point value '" << val << "': " << floaterr;
       return -EINVAL;
     }
-    if (p.hit_set_params.get_type() != HitSet::TYPE_BLOOM) {
-      ss << "hit set is not of type Bloom; invalid to set a false positive rate!";
+    if (p.hit_set_params.get_type() != HitSet::TYPE_BLOOM &&
+	p.hit_set_params.get_type() != HitSet::TYPE_CUCKOO) {
+      ss << "hit set is not of type Bloom or cuckoo; invalid to set a false positive rate!";
       return -EINVAL;
     }
     BloomHitSet::Params *bloomp = static_cast<BloomHitSet::Params*>(p.hit_set_params.impl.get());
@@ -7135,11 +7242,22 @@ done:
       err = -EINVAL;
       goto reply;
     }
+    if (g_conf->osd_tier_default_cache_hit_set_type == "cuckoo") {
+      err = check_cluster_features(CEPH_FEATURE_OSD_HITSET_CUCKOO, ss);
+      if (err == -EAGAIN)
+	goto wait;
+      if (err)
+	goto reply;
+    }
     HitSet::Params hsp;
     if (g_conf->osd_tier_default_cache_hit_set_type == "bloom") {
       BloomHitSet::Params *bsp = new BloomHitSet::Params;
       bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
       hsp = HitSet::Params(bsp);
+    } else if (g_conf->osd_tier_default_cache_hit_set_type == "cuckoo") {
+      CuckooHitSet::Params *csp = new CuckooHitSet::Params;
+      csp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
+      hsp = HitSet::Params(csp);
     } else if (g_conf->osd_tier_default_cache_hit_set_type == "explicit_hash") {
       hsp = HitSet::Params(new ExplicitHashHitSet::Params);
     }
@@ -7261,6 +7379,70 @@ done:
 						get_last_committed() + 1));
       return true;
     }
+  } else if (prefix == "osd reweight-balance") {
+    string by;
+    cmd_getval(g_ceph_context, cmdmap, "by", by);
+    double max_change;
+    cmd_getval(g_ceph_context, cmdmap, "max_change", max_change,
+	       (double)g_conf->mon_reweight_balance_max_change);
+    if (max_change <= 0 || max_change > 1) {
+      ss << "max_change must be in (0, 1]";
+      err = -EINVAL;
+      goto reply;
+    }
+    set<int64_t> pools;
+    vector<string> poolnamevec;
+    cmd_getval(g_ceph_context, cmdmap, "pools", poolnamevec);
+    for (unsigned j = 0; j < poolnamevec.size(); j++) {
+      int64_t pool = osdmap.lookup_pg_pool_name(poolnamevec[j]);
+      if (pool < 0) {
+	ss << "pool '" << poolnamevec[j] << "' does not exist";
+	err = -ENOENT;
+	goto reply;
+      }
+      pools.insert(pool);
+    }
+    map<pg_t,uint64_t> pg_bytes;
+    if (by == "bytes") {
+      const PGMap &pgm = mon->pgmon()->pg_map;
+      for (ceph::unordered_map<pg_t,pg_stat_t>::const_iterator p =
+	     pgm.pg_stat.begin();
+	   p != pgm.pg_stat.end();
+	   ++p) {
+	if (p->second.stats.sum.num_bytes > 0)
+	  pg_bytes[p->first] = p->second.stats.sum.num_bytes;
+      }
+      if (pg_bytes.empty()) {
+	ss << "Refusing to reweight: no pg holds any data";
+	err = -EDOM;
+	goto reply;
+      }
+    }
+    map<int,__u32> new_weights;
+    double before, after;
+    osdmap.calc_balance_reweights(pools,
+				  by == "bytes" ? &pg_bytes : NULL,
+				  max_change,
+				  MAX(1, g_conf->mon_reweight_balance_rounds),
+				  &new_weights, &before, &after);
+    ss << "stddev " << before << " -> " << after << ", ";
+    if (new_weights.empty()) {
+      ss << "no change";
+      err = 0;
+      goto reply;
+    }
+    ss << "reweighted:";
+    for (map<int,__u32>::iterator p = new_weights.begin();
+	 p != new_weights.end();
+	 ++p) {
+      pending_inc.new_weight[p->first] = p->second;
+      char buf[128];
+      snprintf(buf, sizeof(buf), " osd.%d [%04f -> %04f]", p->first,
+	       osdmap.get_weightf(p->first),
+	       (float)p->second / (float)0x10000);
+      ss << buf;
+    }
+    goto update;
   } else if (prefix == "osd thrash") {
     int64_t num_epochs;
     cmd_getval(g_ceph_context, cmdmap, "num_epochs", num_epochs, int64_t(0));
@@ -139,6 +139,9 @@ private:
 
   SimpleLRU<version_t, bufferlist> inc_osd_cache;
   SimpleLRU<version_t, bufferlist> full_osd_cache;
+  // the same, reencoded for (epoch, features) of old clients
+  SimpleLRU<pair<version_t, uint64_t>, bufferlist> inc_osd_reencoded_cache;
+  SimpleLRU<pair<version_t, uint64_t>, bufferlist> full_osd_reencoded_cache;
 
   void check_failures(utime_t now);
   bool check_failure(utime_t now, int target_osd, failure_info_t& fi);
@@ -223,8 +226,9 @@ private:
   bool can_mark_in(int o);
 
   // ...
-  MOSDMap *build_latest_full();
-  MOSDMap *build_incremental(epoch_t first, epoch_t last);
+  MOSDMap *build_latest_full(uint64_t features = CEPH_FEATURES_ALL);
+  MOSDMap *build_incremental(epoch_t first, epoch_t last,
+			     uint64_t features = CEPH_FEATURES_ALL);
   void send_full(MonOpRequestRef op);
   void send_incremental(MonOpRequestRef op, epoch_t first);
   // @param req an optional op request, if the osdmaps are replies to it. so
@@ -425,6 +429,9 @@ private:
 
   int get_version(version_t ver, bufferlist& bl) override;
   int get_version_full(version_t ver, bufferlist& bl) override;
+  /// get a map encoded for peers with features
+  int get_version(version_t ver, uint64_t features, bufferlist& bl);
+  int get_version_full(version_t ver, uint64_t features, bufferlist& bl);
 
   epoch_t blacklist(const entity_addr_t& a, utime_t until);
 
@@ -1238,6 +1238,17 @@ void PGMap::cache_io_rate_summary(Formatter *f, ostream *out,
       have_output = true;
     }
   }
+  if (pos_delta.stats.sum.num_promote_throttled) {
+    int64_t throttled = pos_delta.stats.sum.num_promote_throttled / (double)delta_stamp;
+    if (f) {
+      f->dump_int("promote_throttled_per_sec", throttled);
+    } else {
+      if (have_output)
+	*out << ", ";
+      *out << pretty_si_t(throttled) << "op/s promote throttled";
+      have_output = true;
+    }
+  }
   if (pos_delta.stats.sum.num_flush_mode_low) {
     if (f) {
       f->dump_int("num_flush_mode_low", pos_delta.stats.sum.num_flush_mode_low);
@@ -801,20 +801,25 @@ bool PGMonitor::prepare_pg_stats(MonOpRequestRef op)
     pg_t pgid = p->first;
     ack->pg_stat[pgid] = make_pair(p->second.reported_seq, p->second.reported_epoch);
 
-    if (pg_map.pg_stat.count(pgid) &&
-        pg_map.pg_stat[pgid].get_version_pair() > p->second.get_version_pair()) {
-      dout(15) << " had " << pgid << " from " << pg_map.pg_stat[pgid].reported_epoch << ":"
-	       << pg_map.pg_stat[pgid].reported_seq << dendl;
+    // one lookup in each map per pg: big clusters send a lot of these
+    ceph::unordered_map<pg_t,pg_stat_t>::const_iterator cur =
+      pg_map.pg_stat.find(pgid);
+    if (cur != pg_map.pg_stat.end() &&
+        cur->second.get_version_pair() > p->second.get_version_pair()) {
+      dout(15) << " had " << pgid << " from " << cur->second.reported_epoch << ":"
+	       << cur->second.reported_seq << dendl;
       continue;
     }
-    if (pending_inc.pg_stat_updates.count(pgid) && 
-        pending_inc.pg_stat_updates[pgid].get_version_pair() > p->second.get_version_pair()) {
-      dout(15) << " had " << pgid << " from " << pending_inc.pg_stat_updates[pgid].reported_epoch << ":"
-	       << pending_inc.pg_stat_updates[pgid].reported_seq << " (pending)" << dendl;
+    map<pg_t,pg_stat_t>::iterator pending =
+      pending_inc.pg_stat_updates.find(pgid);
+    if (pending != pending_inc.pg_stat_updates.end() &&
+        pending->second.get_version_pair() > p->second.get_version_pair()) {
+      dout(15) << " had " << pgid << " from " << pending->second.reported_epoch << ":"
+	       << pending->second.reported_seq << " (pending)" << dendl;
       continue;
     }
 
-    if (pg_map.pg_stat.count(pgid) == 0) {
+    if (cur == pg_map.pg_stat.end()) {
       dout(15) << " got " << pgid << " reported at " << p->second.reported_epoch << ":"
 	       << p->second.reported_seq
 	       << " state " << pg_state_string(p->second.state)
@@ -825,10 +830,13 @@ bool PGMonitor::prepare_pg_stats(MonOpRequestRef op)
       
     dout(15) << " got " << pgid
 	     << " reported at " << p->second.reported_epoch << ":" << p->second.reported_seq
-	     << " state " << pg_state_string(pg_map.pg_stat[pgid].state)
+	     << " state " << pg_state_string(cur->second.state)
 	     << " -> " << pg_state_string(p->second.state)
 	     << dendl;
-    pending_inc.pg_stat_updates[pgid] = p->second;
+    if (pending != pending_inc.pg_stat_updates.end())
+      pending->second = p->second;
+    else
+      pending_inc.pg_stat_updates.insert(*p);
 
     /*
     // we don't care much about consistency, here; apply to live map.
@@ -597,6 +597,18 @@ void Paxos::collect_timeout()
 }
 
 
+struct C_BeginWritten : public Context {
+  Paxos *paxos;
+  version_t v, pn;
+  C_BeginWritten(Paxos *p, version_t v, version_t pn)
+    : paxos(p), v(v), pn(pn) {}
+  void finish(int r) {
+    assert(r >= 0);
+    Mutex::Locker l(paxos->mon->lock);
+    paxos->begin_finish(v, pn);
+  }
+};
+
 // leader
 void Paxos::begin(bufferlist& v)
 {
@@ -614,9 +626,8 @@ void Paxos::begin(bufferlist& v)
   // and no value, yet.
   assert(new_value.length() == 0);
 
-  // accept it ourselves
+  // we accept it ourselves once it is on disk; see begin_finish()
   accepted.clear();
-  accepted.insert(mon->rank);
   new_value = v;
 
   if (last_committed == 0) {
@@ -655,18 +666,16 @@ void Paxos::begin(bufferlist& v)
   logger->inc(l_paxos_begin);
   logger->inc(l_paxos_begin_keys, t->get_keys());
   logger->inc(l_paxos_begin_bytes, t->get_bytes());
-  utime_t start = ceph_clock_now(NULL);
-
-  get_store()->apply_transaction(t);
-
-  utime_t end = ceph_clock_now(NULL);
-  logger->tinc(l_paxos_begin_latency, end - start);
+  begin_start_stamp = ceph_clock_now(NULL);
 
-  assert(g_conf->paxos_kill_at != 3);
+  // write it in the background, while the peons write theirs; nothing
+  // commits until we have accepted it too.
+  begin_writing = true;
+  get_store()->queue_transaction(t, new C_BeginWritten(this, last_committed+1,
+						       accepted_pn));
 
   if (mon->get_quorum().size() == 1) {
     // we're alone, take it easy
-    commit_start();
     return;
   }
 
@@ -693,6 +702,44 @@ void Paxos::begin(bufferlist& v)
 			     accept_timeout_event);
 }
 
+// leader
+void Paxos::begin_finish(version_t v, version_t pn)
+{
+  begin_writing = false;
+  utime_t end = ceph_clock_now(NULL);
+  logger->tinc(l_paxos_begin_latency, end - begin_start_stamp);
+
+  if (!mon->is_leader() ||
+      !(is_updating() || is_updating_previous()) ||
+      v != last_committed + 1 || pn != accepted_pn) {
+    dout(10) << __func__ << " " << v << " pn " << pn
+	     << " is from an old round, ignoring" << dendl;
+    return;
+  }
+  dout(10) << __func__ << " " << v << dendl;
+
+  assert(g_conf->paxos_kill_at != 3);
+
+  accepted.insert(mon->rank);
+  if (accepted == mon->get_quorum()) {
+    dout(10) << " got majority, committing, done with update" << dendl;
+    commit_start();
+  }
+}
+
+struct C_AcceptWritten : public Context {
+  Paxos *paxos;
+  MonOpRequestRef op;
+  version_t v, pn;
+  C_AcceptWritten(Paxos *p, MonOpRequestRef o, version_t v, version_t pn)
+    : paxos(p), op(o), v(v), pn(pn) {}
+  void finish(int r) {
+    assert(r >= 0);
+    Mutex::Locker l(paxos->mon->lock);
+    paxos->handle_begin_finish(op, v, pn);
+  }
+};
+
 // peon
 void Paxos::handle_begin(MonOpRequestRef op)
 {
@@ -736,12 +783,30 @@ void Paxos::handle_begin(MonOpRequestRef op)
   *_dout << dendl;
 
   logger->inc(l_paxos_begin_bytes, t->get_bytes());
-  utime_t start = ceph_clock_now(NULL);
+  begin_start_stamp = ceph_clock_now(NULL);
 
-  get_store()->apply_transaction(t);
+  // write it in the background and accept once it is on disk, so that
+  // we keep dispatching in the meantime
+  begin_writing = true;
+  get_store()->queue_transaction(t, new C_AcceptWritten(this, op, v,
+							accepted_pn));
+}
 
+// peon
+void Paxos::handle_begin_finish(MonOpRequestRef op, version_t v, version_t pn)
+{
+  begin_writing = false;
   utime_t end = ceph_clock_now(NULL);
-  logger->tinc(l_paxos_begin_latency, end - start);
+  logger->tinc(l_paxos_begin_latency, end - begin_start_stamp);
+
+  if (mon->is_leader() || !is_updating() ||
+      v != last_committed + 1 || pn != accepted_pn) {
+    dout(10) << __func__ << " " << v << " pn " << pn
+	     << " is from an old round, ignoring" << dendl;
+    return;
+  }
+  op->mark_paxos_event("handle_begin_finish");
+  MMonPaxos *begin = static_cast<MMonPaxos*>(op->get_req());
 
   assert(g_conf->paxos_kill_at != 5);
 
@@ -953,6 +1018,7 @@ void Paxos::extend_lease()
 
   lease_expire = ceph_clock_now(g_ceph_context);
   lease_expire += g_conf->mon_lease;
+  last_lease_expire = lease_expire;
   acked_lease.clear();
   acked_lease.insert(mon->rank);
 
@@ -1087,6 +1153,7 @@ void Paxos::handle_lease(MonOpRequestRef op)
   // extend lease
   if (lease_expire < lease->lease_timestamp) {
     lease_expire = lease->lease_timestamp;
+    last_lease_expire = lease_expire;
 
     utime_t now = ceph_clock_now(g_ceph_context);
     if (lease_expire < now) {
@@ -1352,7 +1419,7 @@ void Paxos::restart()
   cancel_events();
   new_value.clear();
 
-  if (is_writing() || is_writing_previous()) {
+  if (is_writing() || is_writing_previous() || is_writing_begin()) {
     dout(10) << __func__ << " flushing" << dendl;
     mon->lock.Unlock();
     mon->store->flush();
@@ -1435,8 +1502,9 @@ void Paxos::dispatch(MonOpRequestRef op)
 
 // -- READ --
 
-bool Paxos::is_readable(version_t v)
+bool Paxos::is_readable(version_t v, bool stale_ok)
 {
+  utime_t now = ceph_clock_now(g_ceph_context);
   bool ret;
   if (v > last_committed)
     ret = false;
@@ -1446,10 +1514,13 @@ bool Paxos::is_readable(version_t v)
       (is_active() || is_updating() || is_writing()) &&
       last_committed > 0 &&           // must have a value
       (mon->get_quorum().size() == 1 ||  // alone, or
-       is_lease_valid()); // have lease
+       is_lease_valid() ||  // have lease, or
+       (stale_ok && g_conf->mon_read_max_staleness > 0 &&  // had one lately
+	now < last_lease_expire + g_conf->mon_read_max_staleness));
   dout(5) << __func__ << " = " << (int)ret
-	  << " - now=" << ceph_clock_now(g_ceph_context)
+	  << " - now=" << now
 	  << " lease_expire=" << lease_expire
+	  << (stale_ok ? " (stale ok)" : "")
 	  << " has v" << v << " lc " << last_committed
 	  << dendl;
   return ret;
@@ -311,6 +311,10 @@ public:
   /// @return 'true' if we are refreshing an update just committed
   bool is_refresh() const { return state == STATE_REFRESH; }
 
+  /// @return 'true' if we are still writing the value proposed, before
+  /// accepting it
+  bool is_writing_begin() const { return begin_writing; }
+
 private:
   /**
    * @defgroup Paxos_h_recovery_vars Common recovery-related member variables
@@ -398,6 +402,13 @@ private:
    * not be extended. 
    */
   utime_t lease_expire;
+  /**
+   * When the last lease we had ran, or would have run, out.
+   *
+   * Unlike lease_expire this is not cleared when an update cancels the
+   * lease, so that we know how stale our committed state may be.
+   */
+  utime_t last_lease_expire;
   /**
    * List of callbacks waiting for our state to change into STATE_ACTIVE.
    */
@@ -842,10 +853,10 @@ private:
    *
    * @pre We are the Leader
    * @pre We are on STATE_ACTIVE
-   * @post We commit, iif we are alone, or we send a message to each quorum 
-   *	   member
-   * @post We are on STATE_ACTIVE, iif we are alone, or on 
-   *	   STATE_UPDATING otherwise
+   * @post We send a message to each quorum member, unless we are alone,
+   *	   and start writing the value locally; we commit once that is
+   *	   done, if we are alone (see begin_finish())
+   * @post We are on STATE_UPDATING
    *
    * @param value The value being proposed to the quorum
    */
@@ -860,7 +871,8 @@ private:
    * @pre We are a Peon
    * @pre We are on STATE_ACTIVE
    * @post We are on STATE_UPDATING iif we accept the Leader's proposal
-   * @post We send a reply message to the Leader iif we accept its proposal
+   * @post We send a reply message to the Leader iif we accept its proposal,
+   *	   once it is written (see handle_begin_finish())
    *
    * @invariant The received message is an operation of type OP_BEGIN
    *
@@ -869,6 +881,15 @@ private:
    *
    */
   void handle_begin(MonOpRequestRef op);
+  /**
+   * Accept the Leader's proposal, now that we have written it.
+   *
+   * @pre We are a Peon
+   * @param op The begin we wrote
+   * @param v The version proposed
+   * @param pn The proposal number it was proposed under
+   */
+  void handle_begin_finish(MonOpRequestRef op, version_t v, version_t pn);
   /**
    * Handle an Accept message sent by a Peon.
    *
@@ -919,6 +940,29 @@ private:
   utime_t commit_start_stamp;
   friend struct C_Committed;
 
+  /**
+   * Whether the value being proposed is still being written locally, and
+   * when that started.
+   */
+  bool begin_writing;
+  utime_t begin_start_stamp;
+  friend struct C_BeginWritten;
+  friend struct C_AcceptWritten;
+
+  /**
+   * Accept our own proposal once it is on disk.
+   *
+   * The leader writes the value it proposes in the background, at the
+   * same time as the peons write theirs, instead of before it sends the
+   * begins out; it only counts itself as having accepted the value, and
+   * so commits, once that write is done.
+   *
+   * @pre We are the Leader
+   * @param v The version we proposed
+   * @param pn The proposal number we proposed it under
+   */
+  void begin_finish(version_t v, version_t pn);
+
   /**
    * Commit a value throughout the system.
    *
@@ -1106,7 +1150,8 @@ public:
 		   lease_timeout_event(0),
 		   accept_timeout_event(0),
 		   clock_drift_warned(0),
-		   trimming(false) { }
+		   trimming(false),
+		   begin_writing(false) { }
 
   const string get_name() const {
     return paxos_name;
@@ -1283,12 +1328,15 @@ public:
    *  @li the version @e v is higher that the last committed version
    *  @li we are not the Leader nor a Peon (election may be on-going)
    *  @li we do not have a committed value yet
-   *  @li we do not have a valid lease
+   *  @li we do not have a valid lease, and, if @e stale_ok, the last one
+   *	  lapsed more than mon_read_max_staleness ago
    *
    * @param seen The version we want to check if it is readable.
+   * @param stale_ok Whether the caller will answer from state that may be
+   *		     up to mon_read_max_staleness old.
    * @return 'true' if the version is readable; 'false' otherwise.
    */
-  bool is_readable(version_t seen=0);
+  bool is_readable(version_t seen=0, bool stale_ok=false);
   /**
    * Read version @e v and store its value in @e bl
    *
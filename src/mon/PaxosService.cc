@@ -68,8 +68,10 @@ bool PaxosService::dispatch(MonOpRequestRef op)
     return true;
   }
 
-  // make sure our map is readable and up to date
-  if (!is_readable(m->version)) {
+  // make sure our map is readable and up to date.  updates go on to the
+  // leader, which only prepares them once it is writeable, so stale state
+  // here only ever answers reads.
+  if (!is_readable(m->version, true)) {
     dout(10) << " waiting for paxos -> readable (v" << m->version << ")" << dendl;
     wait_for_readable(op, new C_RetryMessage(this, op), m->version);
     return true;
@@ -115,6 +117,24 @@ bool PaxosService::dispatch(MonOpRequestRef op)
   return true;
 }
 
+void PaxosService::init_logger()
+{
+  PerfCountersBuilder pcb(g_ceph_context, "paxos_service_" + service_name,
+			  l_paxos_service_first, l_paxos_service_last);
+  pcb.add_u64_counter(l_paxos_service_refresh, "refresh",
+		      "Committed values applied");
+  pcb.add_time_avg(l_paxos_service_refresh_latency, "refresh_latency",
+		   "Latency of applying a committed value");
+  pcb.add_u64_counter(l_paxos_service_propose, "propose",
+		      "Pending values proposed");
+  pcb.add_time_avg(l_paxos_service_encode_latency, "encode_latency",
+		   "Latency of encoding a pending value");
+  pcb.add_time_avg(l_paxos_service_commit_latency, "commit_latency",
+		   "Latency from proposing a pending value to its commit");
+  logger = pcb.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(logger);
+}
+
 void PaxosService::refresh(bool *need_bootstrap)
 {
   // update cached versions
@@ -130,7 +150,12 @@ void PaxosService::refresh(bool *need_bootstrap)
 
   dout(10) << __func__ << dendl;
 
+  utime_t start = ceph_clock_now(NULL);
   update_from_paxos(need_bootstrap);
+  if (logger) {
+    logger->inc(l_paxos_service_refresh);
+    logger->tinc(l_paxos_service_refresh_latency, ceph_clock_now(NULL) - start);
+  }
 }
 
 void PaxosService::post_refresh()
@@ -206,12 +231,19 @@ void PaxosService::propose_pending()
    */
   MonitorDBStore::TransactionRef t = paxos->get_pending_transaction();
 
+  utime_t start = ceph_clock_now(NULL);
   if (should_stash_full())
     encode_full(t);
 
   encode_pending(t);
   have_pending = false;
 
+  propose_stamp = ceph_clock_now(NULL);
+  if (logger) {
+    logger->inc(l_paxos_service_propose);
+    logger->tinc(l_paxos_service_encode_latency, propose_stamp - start);
+  }
+
   if (format_version > 0) {
     t->put(get_service_name(), "format_version", format_version);
   }
@@ -330,6 +362,12 @@ void PaxosService::shutdown()
   finish_contexts(g_ceph_context, waiting_for_finished_proposal, -EAGAIN);
 
   on_shutdown();
+
+  if (logger) {
+    g_ceph_context->get_perfcounters_collection()->remove(logger);
+    delete logger;
+    logger = NULL;
+  }
 }
 
 void PaxosService::maybe_trim()
@@ -26,6 +26,16 @@
 class Monitor;
 class Paxos;
 
+enum {
+  l_paxos_service_first = 45900,
+  l_paxos_service_refresh,
+  l_paxos_service_refresh_latency,
+  l_paxos_service_propose,
+  l_paxos_service_encode_latency,
+  l_paxos_service_commit_latency,
+  l_paxos_service_last,
+};
+
 /**
  * A Paxos Service is an abstraction that easily allows one to obtain an
  * association between a Monitor and a Paxos class, in order to implement any
@@ -72,6 +82,10 @@ class PaxosService {
    * runs out and fires.
    */
   Context *proposal_timer;
+  /**
+   * When we handed our pending value to Paxos, for the commit latency.
+   */
+  utime_t propose_stamp;
   /**
    * If the implementation class has anything pending to be proposed to Paxos,
    * then have_pending should be true; otherwise, false.
@@ -170,9 +184,12 @@ protected:
     C_Committed(PaxosService *p) : ps(p) { }
     void finish(int r) {
       ps->proposing = false;
-      if (r >= 0)
+      if (r >= 0) {
+	if (ps->logger)
+	  ps->logger->tinc(l_paxos_service_commit_latency,
+			   ceph_clock_now(NULL) - ps->propose_stamp);
 	ps->_active();
-      else if (r == -ECANCELED || r == -EAGAIN)
+      } else if (r == -ECANCELED || r == -EAGAIN)
 	return;
       else
 	assert(0 == "bad return value for C_Committed");
@@ -198,12 +215,19 @@ public:
       last_committed_name("last_committed"),
       first_committed_name("first_committed"),
       full_prefix_name("full"), full_latest_name("latest"),
-      cached_first_committed(0), cached_last_committed(0)
+      cached_first_committed(0), cached_last_committed(0),
+      logger(NULL)
   {
   }
 
   virtual ~PaxosService() {}
 
+  /**
+   * Register our perf counters, which time how long we take to apply
+   * committed values and to encode and commit our own.
+   */
+  void init_logger();
+
   /**
    * Get the service's name.
    *
@@ -522,6 +546,8 @@ public:
    * @}
    */
 
+  PerfCounters *logger;
+
   /**
    * Callback list to be used whenever we are running a proposal through
    * Paxos. These callbacks will be awaken whenever the said proposal
@@ -563,11 +589,12 @@ public:
    *  - we have committed our initial state (last_committed > 0)
    *
    * @param ver The version we want to check if is readable
+   * @param stale_ok see Paxos::is_readable()
    * @returns true if it is readable; false otherwise
    */
-  bool is_readable(version_t ver = 0) {
+  bool is_readable(version_t ver = 0, bool stale_ok = false) {
     if (ver > get_last_committed() ||
-	!paxos->is_readable(0) ||
+	!paxos->is_readable(0, stale_ok) ||
 	get_last_committed() == 0)
       return false;
     return true;
@@ -0,0 +1,96 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "Connection.h"
+#include "Message.h"
+#include "Messenger.h"
+#include "common/Formatter.h"
+
+static const char *latency_names[Connection::LAT_MAX] = {
+  "send_queue",
+  "wire",
+  "dispatch"
+};
+
+void Connection::note_send_queued(Message *m)
+{
+  if (!msgr->cct->_conf->ms_track_peer_latency)
+    return;
+  m->set_send_queue_stamp(ceph_clock_now(msgr->cct));
+}
+
+void Connection::note_send_written(Message *m)
+{
+  if (!msgr->cct->_conf->ms_track_peer_latency)
+    return;
+  utime_t now = ceph_clock_now(msgr->cct);
+  if (m->get_send_queue_stamp() != utime_t())
+    record_latency(LAT_SEND_QUEUE, now - m->get_send_queue_stamp());
+  m->set_send_stamp(now);
+}
+
+void Connection::note_send_acked(Message *m)
+{
+  if (!msgr->cct->_conf->ms_track_peer_latency ||
+      m->get_send_stamp() == utime_t())
+    return;
+  record_latency(LAT_WIRE, ceph_clock_now(msgr->cct) - m->get_send_stamp());
+}
+
+void Connection::note_dispatch(Message *m)
+{
+  if (!msgr->cct->_conf->ms_track_peer_latency ||
+      m->get_recv_stamp() == utime_t())
+    return;
+  record_latency(LAT_DISPATCH,
+		 ceph_clock_now(msgr->cct) - m->get_recv_stamp());
+}
+
+void Connection::record_latency(int which, utime_t lat)
+{
+  assert(which >= 0 && which < LAT_MAX);
+  uint64_t us = lat.to_nsec() / 1000;
+  if (us > 0x7fffffff)
+    us = 0x7fffffff;
+  Mutex::Locker l(latency_lock);
+  latency[which].add(us);
+}
+
+int32_t Connection::get_latency_at_micro(int which, uint64_t micro,
+					 uint64_t *count)
+{
+  assert(which >= 0 && which < LAT_MAX);
+  Mutex::Locker l(latency_lock);
+  if (count)
+    *count = latency[which].get_count();
+  return latency[which].get_value_at_micro(micro);
+}
+
+void Connection::decay_latency()
+{
+  Mutex::Locker l(latency_lock);
+  for (int i = 0; i < LAT_MAX; ++i)
+    latency[i].decay(1);
+}
+
+void Connection::dump_latency(Formatter *f)
+{
+  Mutex::Locker l(latency_lock);
+  for (int i = 0; i < LAT_MAX; ++i) {
+    f->open_object_section(latency_names[i]);
+    f->dump_unsigned("count", latency[i].get_count());
+    f->dump_int("p50_us", latency[i].get_value_at_micro(500000));
+    f->dump_int("p99_us", latency[i].get_value_at_micro(990000));
+    latency[i].dump(f);
+    f->close_section();
+  }
+}
@@ -26,6 +26,7 @@
 #include "include/buffer.h"
 
 #include "common/RefCountedObj.h"
+#include "common/histogram.h"
 
 #include "common/debug.h"
 #include "common/config.h"
@@ -37,6 +38,9 @@
 
 class Message;
 class Messenger;
+namespace ceph {
+  class Formatter;
+}
 
 struct Connection : public RefCountedObject {
   Mutex lock;
@@ -53,6 +57,16 @@ public:
   int rx_buffers_version;
   map<ceph_tid_t,pair<bufferlist,int> > rx_buffers;
 
+  /// per-peer latency histograms (usec), kept if ms_track_peer_latency
+  enum {
+    LAT_SEND_QUEUE = 0, ///< queued for send until written to the wire
+    LAT_WIRE,           ///< written until acked by the peer
+    LAT_DISPATCH,       ///< read off the wire until handed to a Dispatcher
+    LAT_MAX
+  };
+  Mutex latency_lock;
+  pow2_hist_t latency[LAT_MAX];
+
   friend class boost::intrusive_ptr<Connection>;
   friend class PipeConnection;
 
@@ -67,7 +81,8 @@ public:
       peer_type(-1),
       features(0),
       failed(false),
-      rx_buffers_version(0) {
+      rx_buffers_version(0),
+      latency_lock("Connection::latency_lock") {
   }
 
   virtual ~Connection() {
@@ -150,6 +165,18 @@ public:
    */
   virtual void mark_disposable() = 0;
 
+  /**
+   * Allocate a buffer that the transport can send without copying,
+   * e.g. memory already registered with an RDMA device.  Callers that
+   * produce reply data (like an OSD read) can fill it in place.
+   *
+   * @param len size of the buffer in bytes
+   * @return the buffer, or a bufferptr without a raw if this
+   * Connection has nothing better than ordinary memory to offer.
+   */
+  virtual bufferptr alloc_registered_buffer(unsigned len) {
+    return bufferptr();
+  }
 
   int get_peer_type() const { return peer_type; }
   void set_peer_type(int t) { peer_type = t; }
@@ -181,6 +208,23 @@ public:
   utime_t get_last_keepalive_ack() const {
     return last_keepalive_ack;
   }
+
+  /**
+   * Latency tracking hooks for the messenger implementations. Each
+   * is a no-op unless ms_track_peer_latency is enabled.
+   */
+  void note_send_queued(Message *m);
+  void note_send_written(Message *m);
+  void note_send_acked(Message *m);
+  void note_dispatch(Message *m);
+
+  void record_latency(int which, utime_t lat);
+  /// value at position micro (see pow2_hist_t), or -1 if no samples
+  int32_t get_latency_at_micro(int which, uint64_t micro,
+			       uint64_t *count = NULL);
+  /// halve all histograms so old samples age out
+  void decay_latency();
+  void dump_latency(Formatter *f);
 };
 
 typedef boost::intrusive_ptr<Connection> ConnectionRef;
@@ -66,6 +66,8 @@ using namespace std;
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDSubOpReply.h"
 #include "messages/MOSDRepOp.h"
+#include "messages/MOSDRepOpBatch.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDRepOpReply.h"
 #include "messages/MOSDMap.h"
 #include "messages/MMonGetOSDMap.h"
@@ -253,12 +255,13 @@ Message *decode_message(CephContext *cct, int crcflags,
 			ceph_msg_header& header,
 			ceph_msg_footer& footer,
 			bufferlist& front, bufferlist& middle,
-			bufferlist& data)
+			bufferlist& data, const msg_rx_crcs_t *rx_crcs)
 {
   // verify crc
   if (crcflags & MSG_CRC_HEADER) {
-    __u32 front_crc = front.crc32c(0);
-    __u32 middle_crc = middle.crc32c(0);
+    bool have = rx_crcs && rx_crcs->have_front;
+    __u32 front_crc = have ? rx_crcs->front_crc : front.crc32c(0);
+    __u32 middle_crc = have ? rx_crcs->middle_crc : middle.crc32c(0);
 
     if (front_crc != footer.front_crc) {
       if (cct) {
@@ -281,7 +284,8 @@ Message *decode_message(CephContext *cct, int crcflags,
   }
   if (crcflags & MSG_CRC_DATA) {
     if ((footer.flags & CEPH_MSG_FOOTER_NOCRC) == 0) {
-      __u32 data_crc = data.crc32c(0);
+      __u32 data_crc = rx_crcs && rx_crcs->have_data ?
+	rx_crcs->data_crc : data.crc32c(0);
       if (data_crc != footer.data_crc) {
 	if (cct) {
 	  ldout(cct, 0) << "bad crc in data " << data_crc << " != exp " << footer.data_crc << dendl;
@@ -437,6 +441,12 @@ Message *decode_message(CephContext *cct, int crcflags,
   case MSG_OSD_REPOPREPLY:
     m = new MOSDRepOpReply();
     break;
+  case MSG_OSD_REPOP_BATCH:
+    m = new MOSDRepOpBatch();
+    break;
+  case MSG_OSD_OP_BATCH:
+    m = new MOSDOpBatch();
+    break;
 
   case CEPH_MSG_OSD_MAP:
     m = new MOSDMap;
@@ -740,6 +750,11 @@ Message *decode_message(CephContext *cct, int crcflags,
     return 0;
   }
 
+  // whatever the message holds on to came off the wire
+  front.reassign_to_pool(buffer::POOL_MSGR);
+  middle.reassign_to_pool(buffer::POOL_MSGR);
+  data.reassign_to_pool(buffer::POOL_MSGR);
+
   m->set_header(header);
   m->set_footer(footer);
   m->set_payload(front);
@@ -116,6 +116,8 @@
 
 #define MSG_OSD_REPOP         112
 #define MSG_OSD_REPOPREPLY    113
+#define MSG_OSD_REPOP_BATCH   114
+#define MSG_OSD_OP_BATCH      115
 
 
 // *** MDS ***
@@ -218,6 +220,10 @@ protected:
   utime_t throttle_stamp;
   /* time at which message was fully read */
   utime_t recv_complete_stamp;
+  /* send_queue_stamp is set when the Message is queued on a Connection,
+   * send_stamp when it is written to the wire (peer latency tracking) */
+  utime_t send_queue_stamp;
+  utime_t send_stamp;
 
   ConnectionRef connection;
 
@@ -392,6 +398,10 @@ public:
   const utime_t& get_throttle_stamp() const { return throttle_stamp; }
   void set_recv_complete_stamp(utime_t t) { recv_complete_stamp = t; }
   const utime_t& get_recv_complete_stamp() const { return recv_complete_stamp; }
+  void set_send_queue_stamp(utime_t t) { send_queue_stamp = t; }
+  const utime_t& get_send_queue_stamp() const { return send_queue_stamp; }
+  void set_send_stamp(utime_t t) { send_stamp = t; }
+  const utime_t& get_send_stamp() const { return send_stamp; }
 
   void calc_header_crc() {
     header.crc = ceph_crc32c(0, (unsigned char*)&header,
@@ -460,10 +470,25 @@ public:
 };
 typedef boost::intrusive_ptr<Message> MessageRef;
 
+/**
+ * Segment crcs a messenger computed while the bytes came off the wire
+ * (and were still in cache), so decode_message() need not walk the
+ * buffers a second time.
+ */
+struct msg_rx_crcs_t {
+  bool have_front;  ///< front_crc and middle_crc are valid
+  bool have_data;   ///< data_crc is valid
+  __u32 front_crc, middle_crc, data_crc;
+  msg_rx_crcs_t()
+    : have_front(false), have_data(false),
+      front_crc(0), middle_crc(0), data_crc(0) {}
+};
+
 extern Message *decode_message(CephContext *cct, int crcflags,
 			       ceph_msg_header &header,
 			       ceph_msg_footer& footer, bufferlist& front,
-			       bufferlist& middle, bufferlist& data);
+			       bufferlist& middle, bufferlist& data,
+			       const msg_rx_crcs_t *rx_crcs = NULL);
 inline ostream& operator<<(ostream& out, Message& m) {
   m.print(out);
   if (m.get_header().version)
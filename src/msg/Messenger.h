@@ -547,6 +547,8 @@ public:
    * of one reference to it.
    */
   void ms_fast_dispatch(Message *m) {
+    if (m->get_connection())
+      m->get_connection()->note_dispatch(m);
     for (list<Dispatcher*>::iterator p = fast_dispatchers.begin();
 	 p != fast_dispatchers.end();
 	 ++p) {
@@ -577,6 +579,8 @@ public:
    */
   void ms_deliver_dispatch(Message *m) {
     m->set_dispatch_stamp(ceph_clock_now(cct));
+    if (m->get_connection())
+      m->get_connection()->note_dispatch(m);
     for (list<Dispatcher*>::iterator p = dispatchers.begin();
 	 p != dispatchers.end();
 	 ++p) {
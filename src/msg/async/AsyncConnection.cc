@@ -56,6 +56,35 @@ class C_time_wakeup : public EventCallback {
   }
 };
 
+class C_throttle_granted : public EventCallback {
+  AsyncConnectionRef conn;
+  uint64_t seq;
+  Throttle *throttle;
+  int64_t amount;
+
+ public:
+  C_throttle_granted(AsyncConnectionRef c, uint64_t s, Throttle *t, int64_t a)
+    : conn(c), seq(s), throttle(t), amount(a) {}
+  void do_request(int id) {
+    conn->throttle_granted_from(seq, throttle, amount);
+  }
+};
+
+/**
+ * Completed by Throttle::put() in whatever thread returns the slots, so
+ * just bounce over to the connection's event thread.
+ */
+class C_throttle_ready : public Context {
+  EventCenter *center;
+  EventCallbackRef granted;
+
+ public:
+  C_throttle_ready(EventCenter *c, EventCallbackRef g): center(c), granted(g) {}
+  void finish(int r) {
+    center->dispatch_event_external(granted);
+  }
+};
+
 class C_handle_read : public EventCallback {
   AsyncConnectionRef conn;
 
@@ -174,13 +203,67 @@ static void alloc_aligned_buffer(bufferlist& data, unsigned len, unsigned off)
   }
 }
 
+/*
+ * Like alloc_aligned_buffer, but the page-aligned middle part comes from
+ * the connection's pool when possible. A pooled buffer is only reused when
+ * the pool holds the last reference to it, i.e. the message (and whatever
+ * ObjectStore transaction it ended up in) has been released.
+ */
+void AsyncConnection::alloc_rx_data_buffer(bufferlist& data, unsigned len, unsigned off)
+{
+  unsigned max_pool = async_msgr->cct->_conf->ms_async_rx_buffer_pool_size;
+  if (!max_pool) {
+    alloc_aligned_buffer(data, len, off);
+    return;
+  }
+
+  unsigned left = len;
+  if (off & ~CEPH_PAGE_MASK) {
+    unsigned head = MIN(CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK), left);
+    data.push_back(buffer::create(head));
+    left -= head;
+  }
+  unsigned middle = left & CEPH_PAGE_MASK;
+  if (middle > 0) {
+    list<bufferptr>::iterator free_it = rx_buffer_pool.end();
+    list<bufferptr>::iterator it = rx_buffer_pool.begin();
+    for (; it != rx_buffer_pool.end(); ++it) {
+      if (it->raw_nref() != 1)
+        continue;
+      if (free_it == rx_buffer_pool.end())
+        free_it = it;
+      if (it->length() >= middle)
+        break;
+    }
+    if (it != rx_buffer_pool.end()) {
+      ldout(async_msgr->cct, 20) << __func__ << " reusing pooled rx buffer len "
+                                 << it->length() << " for " << middle << dendl;
+      data.push_back(bufferptr(*it, 0, middle));
+      // the raw buffer is overwritten in place, drop its cached crcs
+      data.invalidate_crc();
+    } else {
+      bufferptr bp = buffer::create_page_aligned(middle);
+      if (rx_buffer_pool.size() >= max_pool && free_it != rx_buffer_pool.end())
+        rx_buffer_pool.erase(free_it);
+      if (rx_buffer_pool.size() < max_pool)
+        rx_buffer_pool.push_back(bp);
+      data.push_back(bp);
+    }
+    left -= middle;
+  }
+  if (left)
+    data.push_back(buffer::create(left));
+}
+
 AsyncConnection::AsyncConnection(CephContext *cct, AsyncMessenger *m, EventCenter *c, PerfCounters *p)
   : Connection(cct, m), async_msgr(m), logger(p), global_seq(0), connect_seq(0), peer_global_seq(0),
     out_seq(0), ack_left(0), in_seq(0), state(STATE_NONE), state_after_send(0), sd(-1), port(-1),
     write_lock("AsyncConnection::write_lock"), can_write(NOWRITE),
     open_write(false), keepalive(false), lock("AsyncConnection::lock"), recv_buf(NULL),
     recv_max_prefetch(MIN(msgr->cct->_conf->ms_tcp_prefetch_max_size, TCP_PREFETCH_MIN_SIZE)),
-    recv_start(0), recv_end(0), got_bad_auth(false), authorizer(NULL), replacing(false),
+    recv_start(0), recv_end(0),
+    throttle_wait(NULL), throttle_wait_amount(0), throttle_wait_ticket(0), throttle_wait_seq(0),
+    throttle_granted(false), got_bad_auth(false), authorizer(NULL), replacing(false),
     is_reset_from_peer(false), once_ready(false), state_buffer(NULL), state_offset(0), net(cct), center(c)
 {
   read_handler.reset(new C_handle_read(this));
@@ -235,6 +318,7 @@ int AsyncConnection::do_sendmsg(struct msghdr &msg, int len, bool more)
 {
   while (len > 0) {
     int r = ::sendmsg(sd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+    logger->inc(l_msgr_send_syscalls);
 
     if (r == 0) {
       ldout(async_msgr->cct, 10) << __func__ << " sendmsg got r==0!" << dendl;
@@ -312,7 +396,8 @@ int AsyncConnection::_try_send(bufferlist &send_bl, bool send)
       size--;
     }
 
-    int r = do_sendmsg(msg, msglen, false);
+    // hint the kernel that the next chunk follows right away
+    int r = do_sendmsg(msg, msglen, left_pbrs > 0);
     if (r < 0)
       return r;
 
@@ -590,6 +675,8 @@ void AsyncConnection::process()
           front.clear();
           middle.clear();
           data.clear();
+          rx_crcs = msg_rx_crcs_t();
+          rx_crcs.have_front = rx_crcs.have_data = msgr->crcflags != 0;
           recv_stamp = ceph_clock_now(async_msgr->cct);
           current_header = header;
           state = STATE_OPEN_MESSAGE_THROTTLE_MESSAGE;
@@ -602,14 +689,10 @@ void AsyncConnection::process()
             ldout(async_msgr->cct, 10) << __func__ << " wants " << 1 << " message from policy throttler "
                                        << policy.throttler_messages->get_current() << "/"
                                        << policy.throttler_messages->get_max() << dendl;
-            if (!policy.throttler_messages->get_or_fail()) {
+            if (!_get_policy_throttle(policy.throttler_messages, 1)) {
               ldout(async_msgr->cct, 1) << __func__ << " wants 1 message from policy throttle "
                                         << policy.throttler_messages->get_current() << "/"
                                         << policy.throttler_messages->get_max() << " failed, just wait." << dendl;
-              // following thread pool deal with th full message queue isn't a
-              // short time, so we can wait a ms.
-              if (register_time_events.empty())
-                register_time_events.insert(center->create_time_event(1000, wakeup_handler));
               break;
             }
           }
@@ -626,14 +709,10 @@ void AsyncConnection::process()
               ldout(async_msgr->cct, 10) << __func__ << " wants " << message_size << " bytes from policy throttler "
                                          << policy.throttler_bytes->get_current() << "/"
                                          << policy.throttler_bytes->get_max() << dendl;
-              if (!policy.throttler_bytes->get_or_fail(message_size)) {
+              if (!_get_policy_throttle(policy.throttler_bytes, message_size)) {
                 ldout(async_msgr->cct, 10) << __func__ << " wants " << message_size << " bytes from policy throttler "
                                            << policy.throttler_bytes->get_current() << "/"
                                            << policy.throttler_bytes->get_max() << " failed, just wait." << dendl;
-                // following thread pool deal with th full message queue isn't a
-                // short time, so we can wait a ms.
-                if (register_time_events.empty())
-                  register_time_events.insert(center->create_time_event(1000, wakeup_handler));
                 break;
               }
             }
@@ -661,6 +740,8 @@ void AsyncConnection::process()
               break;
             }
 
+            if (rx_crcs.have_front)
+              rx_crcs.front_crc = ceph_crc32c(0, (unsigned char*)front.c_str(), front_len);
             ldout(async_msgr->cct, 20) << __func__ << " got front " << front.length() << dendl;
           }
           state = STATE_OPEN_MESSAGE_READ_MIDDLE;
@@ -683,6 +764,8 @@ void AsyncConnection::process()
             } else if (r > 0) {
               break;
             }
+            if (rx_crcs.have_front)
+              rx_crcs.middle_crc = ceph_crc32c(0, (unsigned char*)middle.c_str(), middle_len);
             ldout(async_msgr->cct, 20) << __func__ << " got middle " << middle.length() << dendl;
           }
 
@@ -695,6 +778,15 @@ void AsyncConnection::process()
           // read data
           uint64_t data_len = le32_to_cpu(current_header.data_len);
           int data_off = le32_to_cpu(current_header.data_off);
+          if (data_len && (current_header.reserved & CEPH_MSG_HEADER_DATA_COMPRESSED)) {
+            if (!has_feature(CEPH_FEATURE_MSG_COMPRESS)) {
+              ldout(async_msgr->cct, 0) << __func__ << " got compressed data without "
+                                        << "CEPH_FEATURE_MSG_COMPRESS" << dendl;
+              goto fail;
+            }
+            state = STATE_OPEN_MESSAGE_READ_COMPRESSED_DATA;
+            break;
+          }
           if (data_len) {
             // get a buffer
             map<ceph_tid_t,pair<bufferlist,int> >::iterator p = rx_buffers.find(current_header.tid);
@@ -709,7 +801,7 @@ void AsyncConnection::process()
               data_blp = data_buf.begin();
             } else {
               ldout(async_msgr->cct,20) << __func__ << " allocating new rx buffer at offset " << data_off << dendl;
-              alloc_aligned_buffer(data_buf, data_len, data_off);
+              alloc_rx_data_buffer(data_buf, data_len, data_off);
               data_blp = data_buf.begin();
             }
           }
@@ -732,6 +824,9 @@ void AsyncConnection::process()
               break;
             }
 
+            // crc the chunk while it is still hot in cache
+            if (rx_crcs.have_data)
+              rx_crcs.data_crc = ceph_crc32c(rx_crcs.data_crc, (unsigned char*)bp.c_str(), read);
             data_blp.advance(read);
             data.append(bp, 0, read);
             msg_left -= read;
@@ -743,6 +838,54 @@ void AsyncConnection::process()
           break;
         }
 
+      case STATE_OPEN_MESSAGE_READ_COMPRESSED_DATA:
+        {
+          // compressed data is sent as a le32 length followed by the payload
+          if (!data_buf.length()) {
+            r = read_until(sizeof(ceph_le32), state_buffer);
+            if (r < 0) {
+              ldout(async_msgr->cct, 1) << __func__ << " read compressed data length failed" << dendl;
+              goto fail;
+            } else if (r > 0) {
+              break;
+            }
+            uint32_t len = le32_to_cpu(*(ceph_le32*)state_buffer);
+            if (len < 8 || len > le32_to_cpu(current_header.data_len)) {
+              ldout(async_msgr->cct, 0) << __func__ << " bad compressed data length "
+                                        << len << dendl;
+              goto fail;
+            }
+            data_buf.push_back(buffer::create(len));
+          }
+          r = read_until(data_buf.length(), data_buf.c_str());
+          if (r < 0) {
+            ldout(async_msgr->cct, 1) << __func__ << " read compressed data failed" << dendl;
+            goto fail;
+          } else if (r > 0) {
+            break;
+          }
+
+          utime_t start = ceph_clock_now(async_msgr->cct);
+          bufferlist out;
+          r = async_msgr->compressor->decompress(data_buf, out);
+          uint64_t data_len = le32_to_cpu(current_header.data_len);
+          if (r < 0 || out.length() != data_len) {
+            ldout(async_msgr->cct, 0) << __func__ << " decompress data failed, got "
+                                      << out.length() << " expected " << data_len << dendl;
+            goto fail;
+          }
+          logger->tinc(l_msgr_decompress_lat, ceph_clock_now(async_msgr->cct) - start);
+          // keep the alignment the sender asked for
+          alloc_aligned_buffer(data, data_len, le32_to_cpu(current_header.data_off));
+          data.copy_in(0, data_len, out);
+          // the footer crc covers the uncompressed data
+          rx_crcs.have_data = false;
+          ldout(async_msgr->cct, 20) << __func__ << " got " << data_buf.length()
+                                     << " compressed bytes, " << data_len << " raw" << dendl;
+          state = STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH;
+          break;
+        }
+
       case STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH:
         {
           ceph_msg_footer footer;
@@ -782,7 +925,8 @@ void AsyncConnection::process()
 
           ldout(async_msgr->cct, 20) << __func__ << " got " << front.length() << " + " << middle.length()
                               << " + " << data.length() << " byte message" << dendl;
-          Message *message = decode_message(async_msgr->cct, async_msgr->crcflags, current_header, footer, front, middle, data);
+          Message *message = decode_message(async_msgr->cct, async_msgr->crcflags, current_header, footer,
+                                            front, middle, data, &rx_crcs);
           if (!message) {
             ldout(async_msgr->cct, 1) << __func__ << " decode message failed " << dendl;
             goto fail;
@@ -905,6 +1049,7 @@ void AsyncConnection::process()
 
  fail:
   // clean up state internal variables and states
+  _cancel_throttle_wait();
   if (state >= STATE_CONNECTING_SEND_CONNECT_MSG &&
       state <= STATE_CONNECTING_READY) {
     delete authorizer;
@@ -1105,7 +1250,7 @@ int AsyncConnection::_process_connection()
         }
         bufferlist bl;
 
-        connect_msg.features = policy.features_supported;
+        connect_msg.features = policy.features_supported | CEPH_FEATURE_MSG_COMPRESS;
         connect_msg.host_type = async_msgr->get_myinst().name.type();
         connect_msg.global_seq = global_seq;
         connect_msg.connect_seq = connect_seq;
@@ -1767,6 +1912,7 @@ int AsyncConnection::handle_connect_msg(ceph_msg_connect &connect, bufferlist &a
     // Clean up output buffer
     existing->outcoming_bl.clear();
     existing->requeue_sent();
+    existing->_cancel_throttle_wait();
 
     swap(existing->sd, sd);
     existing->can_write = NOWRITE;
@@ -1814,7 +1960,7 @@ int AsyncConnection::handle_connect_msg(ceph_msg_connect &connect, bufferlist &a
   }
 
   // send READY reply
-  reply.features = policy.features_supported;
+  reply.features = policy.features_supported | CEPH_FEATURE_MSG_COMPRESS;
   reply.global_seq = async_msgr->get_global_seq();
   reply.connect_seq = connect_seq;
   reply.flags = 0;
@@ -1946,6 +2092,7 @@ int AsyncConnection::send_message(Message *m)
   // we don't want to consider local message here, it's too lightweight which
   // may disturb users
   logger->inc(l_msgr_send_messages);
+  note_send_queued(m);
 
   bufferlist bl;
   uint64_t f = get_features();
@@ -2069,6 +2216,7 @@ void AsyncConnection::fault()
     return ;
   }
 
+  _cancel_throttle_wait();
   if (policy.lossy && !(state >= STATE_CONNECTING && state < STATE_CONNECTING_READY)) {
     ldout(async_msgr->cct, 1) << __func__ << " on lossy channel, failing" << dendl;
     center->dispatch_event_external(reset_handler);
@@ -2168,6 +2316,7 @@ void AsyncConnection::_stop()
     return ;
 
   ldout(async_msgr->cct, 1) << __func__ << dendl;
+  _cancel_throttle_wait();
   Mutex::Locker l(write_lock);
   if (sd >= 0)
     center->delete_file_event(sd, EVENT_READABLE|EVENT_WRITABLE);
@@ -2208,13 +2357,44 @@ void AsyncConnection::prepare_send_message(uint64_t features, Message *m, buffer
 
   bl.append(m->get_payload());
   bl.append(m->get_middle());
+
+  // header and footer crcs keep covering the uncompressed data, only the
+  // bytes on the wire change
+  ceph_msg_header &header = m->get_header();
+  header.reserved = (__u16)(header.reserved & ~CEPH_MSG_HEADER_DATA_COMPRESSED);
+  uint64_t min_size = async_msgr->cct->_conf->ms_async_compress_min_size;
+  if (min_size && (features & CEPH_FEATURE_MSG_COMPRESS) &&
+      m->get_data().length() >= min_size) {
+    utime_t start = ceph_clock_now(async_msgr->cct);
+    bufferlist compressed;
+    int r = async_msgr->compressor->compress(m->get_data(), compressed);
+    if (r == 0 && compressed.length() >= 8 &&
+        compressed.length() + sizeof(ceph_le32) < m->get_data().length()) {
+      logger->tinc(l_msgr_compress_lat, ceph_clock_now(async_msgr->cct) - start);
+      logger->inc(l_msgr_compress_raw_bytes, m->get_data().length());
+      logger->inc(l_msgr_compress_bytes, compressed.length());
+      header.reserved = (__u16)(header.reserved | CEPH_MSG_HEADER_DATA_COMPRESSED);
+      ceph_le32 len;
+      len = compressed.length();
+      bl.append((char*)&len, sizeof(len));
+      bl.claim_append(compressed);
+      return;
+    }
+  }
   bl.append(m->get_data());
 }
 
-int AsyncConnection::write_message(Message *m, bufferlist& bl)
+/*
+ * If "more" is true the caller has further messages queued behind this one,
+ * so the encoded message is only appended to outcoming_bl until the batch
+ * reaches ms_async_send_batch_bytes or IOV_MAX buffers. The caller must
+ * flush outcoming_bl once it runs out of messages.
+ */
+int AsyncConnection::write_message(Message *m, bufferlist& bl, bool more)
 {
   assert(can_write == CANWRITE);
   m->set_seq(out_seq.inc());
+  note_send_written(m);
 
   if (!policy.lossy) {
     // put on sent list
@@ -2245,13 +2425,19 @@ int AsyncConnection::write_message(Message *m, bufferlist& bl)
     }
   }
 
-  bufferlist complete_bl;
-  // send tag
-  char tag = CEPH_MSGR_TAG_MSG;
-  complete_bl.append(&tag, sizeof(tag));
+  // tag, header and footer are framed in one exactly sized buffer rather
+  // than pulling a fresh page-sized append buffer into every message
+  bool new_header = has_feature(CEPH_FEATURE_NOSRCADDR);
+  bool new_footer = has_feature(CEPH_FEATURE_MSG_AUTH);
+  unsigned header_len = new_header ? sizeof(header) : sizeof(ceph_msg_header_old);
+  unsigned footer_len = new_footer ? sizeof(footer) : sizeof(ceph_msg_footer_old);
+  bufferptr frame(1 + header_len + footer_len);
+  char *fp = frame.c_str();
 
-  if (has_feature(CEPH_FEATURE_NOSRCADDR)) {
-    complete_bl.append((char*)&header, sizeof(header));
+  // send tag
+  *fp = CEPH_MSGR_TAG_MSG;
+  if (new_header) {
+    memcpy(fp + 1, &header, sizeof(header));
   } else {
     ceph_msg_header_old oldheader;
     memcpy(&oldheader, &header, sizeof(header));
@@ -2261,7 +2447,7 @@ int AsyncConnection::write_message(Message *m, bufferlist& bl)
     oldheader.reserved = header.reserved;
     oldheader.crc = ceph_crc32c(0, (unsigned char*)&oldheader,
                                 sizeof(oldheader) - sizeof(oldheader.crc));
-    complete_bl.append((char*)&oldheader, sizeof(oldheader));
+    memcpy(fp + 1, &oldheader, sizeof(oldheader));
   }
 
   ldout(async_msgr->cct, 20) << __func__ << " sending message type=" << header.type
@@ -2270,12 +2456,10 @@ int AsyncConnection::write_message(Message *m, bufferlist& bl)
                              << " data=" << header.data_len
                              << " off " << header.data_off << dendl;
 
-  complete_bl.claim_append(bl);
-
   // send footer; if receiver doesn't support signatures, use the old footer format
   ceph_msg_footer_old old_footer;
-  if (has_feature(CEPH_FEATURE_MSG_AUTH)) {
-    complete_bl.append((char*)&footer, sizeof(footer));
+  if (new_footer) {
+    memcpy(fp + 1 + header_len, &footer, sizeof(footer));
   } else {
     if (msgr->crcflags & MSG_CRC_HEADER) {
       old_footer.front_crc = footer.front_crc;
@@ -2286,13 +2470,22 @@ int AsyncConnection::write_message(Message *m, bufferlist& bl)
     }
     old_footer.data_crc = msgr->crcflags & MSG_CRC_DATA ? footer.data_crc : 0;
     old_footer.flags = footer.flags;
-    complete_bl.append((char*)&old_footer, sizeof(old_footer));
+    memcpy(fp + 1 + header_len, &old_footer, sizeof(old_footer));
   }
 
+  bufferlist complete_bl;
+  complete_bl.append(frame, 0, 1 + header_len);
+  complete_bl.claim_append(bl);
+  complete_bl.append(frame, 1 + header_len, footer_len);
+
   logger->inc(l_msgr_send_bytes, complete_bl.length());
   ldout(async_msgr->cct, 20) << __func__ << " sending " << m->get_seq()
                              << " " << m << dendl;
-  int rc = _try_send(complete_bl);
+  uint64_t batch_bytes = async_msgr->cct->_conf->ms_async_send_batch_bytes;
+  bool send = !more || !batch_bytes ||
+              outcoming_bl.length() + complete_bl.length() >= batch_bytes ||
+              outcoming_bl.buffers().size() + complete_bl.buffers().size() >= IOV_MAX;
+  int rc = _try_send(complete_bl, send);
   if (rc < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " error sending " << m << ", "
                               << cpp_strerror(errno) << dendl;
@@ -2314,6 +2507,7 @@ void AsyncConnection::handle_ack(uint64_t seq)
   while (!sent.empty() && sent.front()->get_seq() <= seq) {
     Message* m = sent.front();
     sent.pop_front();
+    note_send_acked(m);
     ldout(async_msgr->cct, 10) << __func__ << " got ack seq "
                                << seq << " >= " << m->get_seq() << " on "
                                << m << " " << *m << dendl;
@@ -2387,7 +2581,7 @@ void AsyncConnection::handle_write()
       if (!data.length())
         prepare_send_message(get_features(), m, data);
 
-      r = write_message(m, data);
+      r = write_message(m, data, !out_q.empty());
       if (r < 0) {
         ldout(async_msgr->cct, 1) << __func__ << " send msg failed" << dendl;
         write_lock.Unlock();
@@ -2453,6 +2647,68 @@ void AsyncConnection::wakeup_from(uint64_t id)
   process();
 }
 
+/**
+ * Take @p c slots from the policy throttle @p t for the message being
+ * read. If they aren't available, queue for them and return false; the
+ * read state machine resumes from throttle_granted_from() once they are.
+ */
+bool AsyncConnection::_get_policy_throttle(Throttle *t, int64_t c)
+{
+  assert(lock.is_locked());
+  if (throttle_granted) {
+    assert(throttle_wait == t && throttle_wait_amount == c);
+    throttle_granted = false;
+    throttle_wait = NULL;
+    return true;
+  }
+  if (throttle_wait_ticket)
+    return false;  // still queued
+  if (t->get_or_fail(c))
+    return true;
+
+  ++throttle_wait_seq;
+  EventCallbackRef granted(new C_throttle_granted(this, throttle_wait_seq, t, c));
+  uint64_t ticket = t->get_or_queue(c, new C_throttle_ready(center, granted));
+  if (!ticket)
+    return true;  // freed up in the meantime
+  throttle_wait = t;
+  throttle_wait_amount = c;
+  throttle_wait_ticket = ticket;
+  return false;
+}
+
+void AsyncConnection::_cancel_throttle_wait()
+{
+  assert(lock.is_locked());
+  if (throttle_wait_ticket) {
+    // if the grant is already on its way, throttle_granted_from() sees
+    // the ticket is gone and gives the slots back
+    throttle_wait->cancel_queued(throttle_wait_ticket);
+    throttle_wait_ticket = 0;
+  } else if (throttle_granted) {
+    throttle_wait->put(throttle_wait_amount);
+    throttle_granted = false;
+  }
+  throttle_wait = NULL;
+}
+
+void AsyncConnection::throttle_granted_from(uint64_t seq, Throttle *t, int64_t c)
+{
+  lock.Lock();
+  if (!throttle_wait_ticket || seq != throttle_wait_seq) {
+    ldout(async_msgr->cct, 10) << __func__ << " stale grant of " << c
+                               << ", releasing" << dendl;
+    lock.Unlock();
+    t->put(c);
+    return;
+  }
+  ldout(async_msgr->cct, 10) << __func__ << " got " << c << " from policy throttle" << dendl;
+  throttle_wait_ticket = 0;
+  throttle_granted = true;
+  lock.Unlock();
+  process();
+}
+
 void AsyncConnection::local_deliver()
 {
   ldout(async_msgr->cct, 10) << __func__ << dendl;
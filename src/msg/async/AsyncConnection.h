@@ -45,6 +45,7 @@ class AsyncMessenger;
 class AsyncConnection : public Connection {
 
   int read_bulk(int fd, char *buf, int len);
+  void alloc_rx_data_buffer(bufferlist& data, unsigned len, unsigned off);
   int do_sendmsg(struct msghdr &msg, int len, bool more);
   int try_send(bufferlist &bl, bool send=true) {
     Mutex::Locker l(write_lock);
@@ -69,7 +70,7 @@ class AsyncConnection : public Connection {
   int randomize_out_seq();
   void handle_ack(uint64_t seq);
   void _send_keepalive_or_ack(bool ack=false, utime_t *t=NULL);
-  int write_message(Message *m, bufferlist& bl);
+  int write_message(Message *m, bufferlist& bl, bool more=false);
   int _reply_accept(char tag, ceph_msg_connect &connect, ceph_msg_connect_reply &reply,
                     bufferlist authorizer_reply) {
     bufferlist reply_bl;
@@ -156,6 +157,7 @@ class AsyncConnection : public Connection {
     STATE_OPEN_MESSAGE_READ_MIDDLE,
     STATE_OPEN_MESSAGE_READ_DATA_PREPARE,
     STATE_OPEN_MESSAGE_READ_DATA,
+    STATE_OPEN_MESSAGE_READ_COMPRESSED_DATA,
     STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH,
     STATE_OPEN_TAG_CLOSE,
     STATE_WAIT_SEND,
@@ -192,6 +194,7 @@ class AsyncConnection : public Connection {
                                         "STATE_OPEN_MESSAGE_READ_MIDDLE",
                                         "STATE_OPEN_MESSAGE_READ_DATA_PREPARE",
                                         "STATE_OPEN_MESSAGE_READ_DATA",
+                                        "STATE_OPEN_MESSAGE_READ_COMPRESSED_DATA",
                                         "STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH",
                                         "STATE_OPEN_TAG_CLOSE",
                                         "STATE_WAIT_SEND",
@@ -254,8 +257,21 @@ class AsyncConnection : public Connection {
   uint32_t recv_max_prefetch;
   uint32_t recv_start;
   uint32_t recv_end;
+  // page-aligned data buffers recycled once the message holding them is gone
+  list<bufferptr> rx_buffer_pool;
   set<uint64_t> register_time_events; // need to delete it if stop
 
+  // A policy throttle we are parked on with Throttle::get_or_queue(). Only
+  // this connection stops reading; the rest of the event loop carries on.
+  Throttle *throttle_wait;
+  int64_t throttle_wait_amount;
+  uint64_t throttle_wait_ticket;  // non-zero while queued
+  uint64_t throttle_wait_seq;     // tells a stale grant from the current one
+  bool throttle_granted;          // slots taken for us, not yet consumed
+
+  bool _get_policy_throttle(Throttle *t, int64_t c);
+  void _cancel_throttle_wait();
+
   // Tis section are temp variables used by state transition
 
   // Open state
@@ -266,6 +282,8 @@ class AsyncConnection : public Connection {
   bufferlist data_buf;
   bufferlist::iterator data_blp;
   bufferlist front, middle, data;
+  /// crcs of the message being read, computed as each segment arrives
+  msg_rx_crcs_t rx_crcs;
   ceph_msg_connect connect_msg;
   // Connecting state
   bool got_bad_auth;
@@ -296,6 +314,7 @@ class AsyncConnection : public Connection {
   void handle_write();
   void process();
   void wakeup_from(uint64_t id);
+  void throttle_granted_from(uint64_t seq, Throttle *t, int64_t c);
   void local_deliver();
   void stop() {
     lock.Lock();
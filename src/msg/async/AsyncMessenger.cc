@@ -27,6 +27,8 @@
 #include "common/config.h"
 #include "common/Timer.h"
 #include "common/errno.h"
+#include "common/admin_socket.h"
+#include "common/Formatter.h"
 #include "auth/Crypto.h"
 #include "include/Spinlock.h"
 
@@ -60,6 +62,31 @@ class C_processor_accept : public EventCallback {
   }
 };
 
+class C_peer_latency_check : public EventCallback {
+  AsyncMessenger *msgr;
+
+ public:
+  C_peer_latency_check(AsyncMessenger *m): msgr(m) {}
+  void do_request(int id) {
+    msgr->check_peer_latency();
+  }
+};
+
+class PeerLatencyHook : public AdminSocketHook {
+  AsyncMessenger *msgr;
+
+ public:
+  PeerLatencyHook(AsyncMessenger *m): msgr(m) {}
+  bool call(std::string command, cmdmap_t& cmdmap, std::string format,
+            bufferlist& out) {
+    Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
+    msgr->dump_peer_latency(f);
+    f->flush(out);
+    delete f;
+    return true;
+  }
+};
+
 
 /*******************
  * Processor
@@ -301,11 +328,15 @@ void *Worker::entry()
   while (!done) {
     ldout(cct, 20) << __func__ << " calling event process" << dendl;
 
+    perf_logger->set(l_msgr_external_backlog, center.get_external_backlog());
     int r = center.process_events(EventMaxWaitUs);
     if (r < 0) {
       ldout(cct, 20) << __func__ << " process events failed: "
           << cpp_strerror(errno) << dendl;
       // TODO do something?
+    } else if (r > 0) {
+      perf_logger->inc(l_msgr_loop_events, r);
+      perf_logger->tinc(l_msgr_loop_latency, center.get_last_process_latency());
     }
   }
 
@@ -361,6 +392,42 @@ void WorkerPool::start()
   }
 }
 
+Worker *WorkerPool::get_idle_worker()
+{
+  Worker *best = workers[(seq++)%workers.size()];
+  uint64_t best_load = best->get_load();
+  for (vector<Worker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    uint64_t load = (*it)->get_load();
+    if (load < best_load) {
+      best = *it;
+      best_load = load;
+    }
+  }
+  return best;
+}
+
+Worker *WorkerPool::get_worker(const entity_addr_t &addr)
+{
+  Worker *w;
+  if (cct->_conf->ms_async_worker_pin_by_peer) {
+    std::hash<entity_addr_t> h;
+    w = workers[h(addr) % workers.size()];
+  } else {
+    w = get_worker();
+  }
+
+  int max_imbalance = cct->_conf->ms_async_worker_max_imbalance;
+  if (max_imbalance > 0 && workers.size() > 1) {
+    Worker *idle = get_idle_worker();
+    if (w->get_load() > idle->get_load() + max_imbalance) {
+      ldout(cct, 10) << __func__ << " " << addr << " steered to less loaded worker"
+                     << dendl;
+      w = idle;
+    }
+  }
+  return w;
+}
+
 void WorkerPool::barrier()
 {
   ldout(cct, 10) << __func__ << " started." << dendl;
@@ -390,7 +457,11 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
     lock("AsyncMessenger::lock"),
     nonce(_nonce), need_addr(true), listen_sd(-1), did_bind(false),
     global_seq(0), deleted_lock("AsyncMessenger::deleted_lock"),
-    cluster_protocol(0), stopped(true)
+    cluster_protocol(0), stopped(true), mname(mname),
+    peer_latency_hook(NULL), latency_check_center(NULL),
+    latency_check_event(0),
+    latency_check_handler(new C_peer_latency_check(this)),
+    compressor(Compressor::create("snappy"))
 {
   ceph_spin_init(&global_seq_lock);
   cct->lookup_or_create_singleton_object<WorkerPool>(pool, WorkerPool::name);
@@ -398,6 +469,18 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
   local_connection = new AsyncConnection(cct, this, &w->center, w->get_perf_counter());
   local_features = features;
   init_local_connection();
+
+  peer_latency_hook = new PeerLatencyHook(this);
+  int r = cct->get_admin_socket()->register_command(
+    "dump_peer_latency " + mname, "dump_peer_latency " + mname,
+    peer_latency_hook, "dump per peer messenger latency histograms");
+  if (r < 0) {
+    // e.g. -EEXIST if several messengers share a name in this process
+    ldout(cct, 1) << __func__ << " not registering dump_peer_latency " << mname
+                  << ": " << cpp_strerror(r) << dendl;
+    delete peer_latency_hook;
+    peer_latency_hook = NULL;
+  }
 }
 
 /**
@@ -408,6 +491,11 @@ AsyncMessenger::~AsyncMessenger()
 {
   assert(!did_bind); // either we didn't bind or we shut down the Processor
   local_connection->mark_down();
+  if (peer_latency_hook) {
+    cct->get_admin_socket()->unregister_command("dump_peer_latency " + mname);
+    delete peer_latency_hook;
+  }
+  delete compressor;
 }
 
 void AsyncMessenger::ready()
@@ -417,6 +505,13 @@ void AsyncMessenger::ready()
   Mutex::Locker l(lock);
   Worker *w = pool->get_worker();
   processor.start(w);
+  if (cct->_conf->ms_track_peer_latency &&
+      cct->_conf->ms_peer_latency_check_interval > 0) {
+    latency_check_center = &w->center;
+    latency_check_event = latency_check_center->create_time_event(
+      cct->_conf->ms_peer_latency_check_interval * 1000000ull,
+      latency_check_handler);
+  }
 }
 
 int AsyncMessenger::shutdown()
@@ -427,6 +522,12 @@ int AsyncMessenger::shutdown()
   processor.stop();
   mark_down_all();
   local_connection->set_priv(NULL);
+  lock.Lock();
+  if (latency_check_center) {
+    latency_check_center->delete_time_event(latency_check_event);
+    latency_check_center = NULL;
+  }
+  lock.Unlock();
   pool->barrier();
   lock.Lock();
   stop_cond.Signal();
@@ -521,7 +622,8 @@ void AsyncMessenger::wait()
 AsyncConnectionRef AsyncMessenger::add_accept(int sd)
 {
   lock.Lock();
-  Worker *w = pool->get_worker();
+  Worker *w = cct->_conf->ms_async_worker_max_imbalance > 0 ?
+    pool->get_idle_worker() : pool->get_worker();
   AsyncConnectionRef conn = new AsyncConnection(cct, this, &w->center, w->get_perf_counter());
   conn->accept(sd);
   accepting_conns.insert(conn);
@@ -538,7 +640,7 @@ AsyncConnectionRef AsyncMessenger::create_connect(const entity_addr_t& addr, int
       << ", creating connection and registering" << dendl;
 
   // create connection
-  Worker *w = pool->get_worker();
+  Worker *w = pool->get_worker(addr);
   AsyncConnectionRef conn = new AsyncConnection(cct, this, &w->center, w->get_perf_counter());
   conn->connect(addr, type);
   assert(!conns.count(addr));
@@ -747,3 +849,71 @@ void AsyncMessenger::learned_addr(const entity_addr_t &peer_addr_for_me)
   }
   lock.Unlock();
 }
+
+void AsyncMessenger::check_peer_latency()
+{
+  const md_config_t *conf = cct->_conf;
+  Mutex::Locker l(lock);
+  if (!latency_check_center)
+    return;
+
+  vector<pair<int32_t, AsyncConnectionRef> > p99s;
+  {
+    Mutex::Locker l(deleted_lock);
+    for (ceph::unordered_map<entity_addr_t, AsyncConnectionRef>::iterator p = conns.begin();
+         p != conns.end(); ++p) {
+      if (deleted_conns.count(p->second))
+        continue;
+      uint64_t count = 0;
+      int32_t v = p->second->get_latency_at_micro(Connection::LAT_WIRE, 990000,
+                                                  &count);
+      if (count >= (uint64_t)conf->ms_peer_latency_warn_min_samples)
+        p99s.push_back(make_pair(v, p->second));
+      p->second->decay_latency();
+    }
+  }
+
+  slow_peers.clear();
+  // need a few peers for the median to mean anything
+  if (p99s.size() >= 3) {
+    vector<int32_t> sorted;
+    for (unsigned i = 0; i < p99s.size(); ++i)
+      sorted.push_back(p99s[i].first);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                     sorted.end());
+    int32_t median = sorted[sorted.size() / 2];
+    for (unsigned i = 0; i < p99s.size(); ++i) {
+      if (p99s[i].first > median * conf->ms_peer_latency_warn_ratio) {
+        const entity_addr_t& addr = p99s[i].second->get_peer_addr();
+        slow_peers.insert(addr);
+        lderr(cct) << __func__ << " slow peer " << addr << " ("
+                   << ceph_entity_type_name(p99s[i].second->get_peer_type())
+                   << "): wire latency p99 " << p99s[i].first
+                   << "us vs median " << median << "us over "
+                   << p99s.size() << " peers" << dendl;
+      }
+    }
+  }
+
+  latency_check_event = latency_check_center->create_time_event(
+    conf->ms_peer_latency_check_interval * 1000000ull, latency_check_handler);
+}
+
+void AsyncMessenger::dump_peer_latency(Formatter *f)
+{
+  Mutex::Locker l(lock);
+  f->open_object_section("peer_latency");
+  f->dump_bool("enabled", cct->_conf->ms_track_peer_latency);
+  f->open_array_section("peers");
+  for (ceph::unordered_map<entity_addr_t, AsyncConnectionRef>::iterator p = conns.begin();
+       p != conns.end(); ++p) {
+    f->open_object_section("peer");
+    f->dump_stream("addr") << p->first;
+    f->dump_string("type", ceph_entity_type_name(p->second->get_peer_type()));
+    f->dump_bool("slow", slow_peers.count(p->first));
+    p->second->dump_latency(f);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
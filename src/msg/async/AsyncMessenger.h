@@ -33,6 +33,7 @@ using namespace std;
 #include "common/Throttle.h"
 
 #include "msg/SimplePolicyMessenger.h"
+#include "compressor/Compressor.h"
 #include "include/assert.h"
 #include "AsyncConnection.h"
 #include "Event.h"
@@ -40,6 +41,7 @@ using namespace std;
 
 class AsyncMessenger;
 class WorkerPool;
+class AdminSocketHook;
 
 enum {
   l_msgr_first = 94000,
@@ -49,6 +51,14 @@ enum {
   l_msgr_send_bytes,
   l_msgr_created_connections,
   l_msgr_active_connections,
+  l_msgr_loop_events,
+  l_msgr_loop_latency,
+  l_msgr_external_backlog,
+  l_msgr_send_syscalls,
+  l_msgr_compress_raw_bytes,
+  l_msgr_compress_bytes,
+  l_msgr_compress_lat,
+  l_msgr_decompress_lat,
   l_msgr_last,
 };
 
@@ -76,8 +86,16 @@ class Worker : public Thread {
     plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages", "Network sent messages");
     plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes", "Network received bytes");
     plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network received bytes");
-    plb.add_u64_counter(l_msgr_created_connections, "msgr_active_connections", "Active connection number");
-    plb.add_u64_counter(l_msgr_active_connections, "msgr_created_connections", "Created connection number");
+    plb.add_u64_counter(l_msgr_created_connections, "msgr_created_connections", "Created connection number");
+    plb.add_u64(l_msgr_active_connections, "msgr_active_connections", "Active connection number");
+    plb.add_u64_counter(l_msgr_loop_events, "msgr_loop_events", "Events processed by event loop");
+    plb.add_time_avg(l_msgr_loop_latency, "msgr_loop_latency", "Time spent handling events per loop");
+    plb.add_u64(l_msgr_external_backlog, "msgr_external_backlog", "External events waiting for event loop");
+    plb.add_u64_counter(l_msgr_send_syscalls, "msgr_send_syscalls", "Network sendmsg calls");
+    plb.add_u64_counter(l_msgr_compress_raw_bytes, "msgr_compress_raw_bytes", "Message data bytes before compression");
+    plb.add_u64_counter(l_msgr_compress_bytes, "msgr_compress_bytes", "Message data bytes after compression");
+    plb.add_time_avg(l_msgr_compress_lat, "msgr_compress_lat", "Message data compression latency");
+    plb.add_time_avg(l_msgr_decompress_lat, "msgr_decompress_lat", "Message data decompression latency");
 
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
@@ -91,6 +109,7 @@ class Worker : public Thread {
   void *entry();
   void stop();
   PerfCounters *get_perf_counter() { return perf_logger; }
+  uint64_t get_load() { return perf_logger->get(l_msgr_active_connections); }
 };
 
 /**
@@ -145,6 +164,18 @@ class WorkerPool {
   Worker *get_worker() {
     return workers[(seq++)%workers.size()];
   }
+  /**
+   * Choose the worker for a connection to @p addr.
+   *
+   * With ms_async_worker_pin_by_peer the worker is picked by hashing the
+   * peer address; otherwise workers are picked round robin. Either way, if
+   * the chosen worker is more than ms_async_worker_max_imbalance
+   * connections busier than the least loaded worker, the connection goes to
+   * the least loaded worker instead.
+   */
+  Worker *get_worker(const entity_addr_t &addr);
+  /// least loaded worker, used for accepted connections
+  Worker *get_idle_worker();
   int get_cpuid(int id) {
     if (coreids.empty())
       return -1;
@@ -374,6 +405,17 @@ private:
   Cond  stop_cond;
   bool stopped;
 
+  /// logical name given at creation (e.g. "cluster"), used for admin commands
+  string mname;
+  /// "dump_peer_latency <mname>" admin socket command
+  AdminSocketHook *peer_latency_hook;
+  /// where the periodic slow peer check runs, NULL when not armed
+  EventCenter *latency_check_center;
+  uint64_t latency_check_event;
+  EventCallbackRef latency_check_handler;
+  /// peers flagged by the last slow peer check
+  set<entity_addr_t> slow_peers;
+
   AsyncConnectionRef _lookup_conn(const entity_addr_t& k) {
     assert(lock.is_locked());
     ceph::unordered_map<entity_addr_t, AsyncConnectionRef>::iterator p = conns.find(k);
@@ -406,6 +448,9 @@ public:
   ConnectionRef local_connection;
   uint64_t local_features;
 
+  /// compresses message data for peers with CEPH_FEATURE_MSG_COMPRESS
+  Compressor *compressor;
+
   /**
    * @defgroup AsyncMessenger internals
    * @{
@@ -478,6 +523,14 @@ public:
    */
   int get_proto_version(int peer_type, bool connect);
 
+  /**
+   * Compare the wire latency p99 of every peer against the median over
+   * all peers, warn about the outliers and age the histograms. Rearms
+   * itself every ms_peer_latency_check_interval seconds.
+   */
+  void check_peer_latency();
+  void dump_peer_latency(Formatter *f);
+
   /**
    * Fill in the address and peer type for the local connection, which
    * is used for delivering messages back to ourself.
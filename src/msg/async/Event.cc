@@ -24,10 +24,9 @@
 #else
 #ifdef HAVE_KQUEUE
 #include "EventKqueue.h"
-#else
-#include "EventSelect.h"
 #endif
 #endif
+#include "EventSelect.h"
 
 #define dout_subsys ceph_subsys_ms
 
@@ -66,15 +65,23 @@ int EventCenter::init(int n)
 {
   // can't init multi times
   assert(nevent == 0);
+  const string &type = cct->_conf->ms_async_event_driver;
+  if (type == "select") {
+    driver = new SelectDriver(cct);
+  } else {
+    if (type.length())
+      ldout(cct, 0) << __func__ << " unknown event driver " << type
+                    << ", using default" << dendl;
 #ifdef HAVE_EPOLL
-  driver = new EpollDriver(cct);
+    driver = new EpollDriver(cct);
 #else
 #ifdef HAVE_KQUEUE
-  driver = new KqueueDriver(cct);
+    driver = new KqueueDriver(cct);
 #else
-  driver = new SelectDriver(cct);
+    driver = new SelectDriver(cct);
 #endif
 #endif
+  }
 
   if (!driver) {
     lderr(cct) << __func__ << " failed to create event driver " << dendl;
@@ -366,7 +373,31 @@ int EventCenter::process_events(int timeout_microseconds)
   ldout(cct, 10) << __func__ << " wait second " << tv.tv_sec << " usec " << tv.tv_usec << dendl;
   vector<FiredFileEvent> fired_events;
   next_time = shortest;
-  numevents = driver->event_wait(fired_events, &tv);
+  numevents = 0;
+  bool need_wait = true;
+  uint64_t busy_poll_us = cct->_conf->ms_async_busy_poll_us;
+  if (busy_poll_us && (tv.tv_sec || tv.tv_usec)) {
+    // spin on the driver for a while before going to sleep, but never past
+    // the next time event
+    utime_t wait(tv);
+    utime_t busy(busy_poll_us / 1000000, (busy_poll_us % 1000000) * 1000);
+    utime_t poll_end = ceph_clock_now(cct);
+    poll_end += MIN(wait, busy);
+    struct timeval zero_tv;
+    do {
+      zero_tv.tv_sec = zero_tv.tv_usec = 0;
+      numevents = driver->event_wait(fired_events, &zero_tv);
+    } while (numevents == 0 && ceph_clock_now(cct) < poll_end);
+    if (wait > busy) {
+      wait -= busy;
+      wait.copy_to_timeval(&tv);
+    } else {
+      need_wait = false;
+    }
+  }
+  if (numevents == 0 && need_wait)
+    numevents = driver->event_wait(fired_events, &tv);
+  utime_t process_start = ceph_clock_now(cct);
   file_lock.Lock();
   for (int j = 0; j < numevents; j++) {
     int rfired = 0;
@@ -417,6 +448,7 @@ int EventCenter::process_events(int timeout_microseconds)
       cur_process.pop_front();
     }
   }
+  last_process_latency = ceph_clock_now(cct) - process_start;
   return numevents;
 }
 
@@ -114,6 +114,7 @@ class EventCenter {
   int notify_send_fd;
   NetHandler net;
   pthread_t owner;
+  utime_t last_process_latency; // time spent handling events in last loop
 
   int process_time_events();
   FileEvent *_get_file_event(int fd) {
@@ -143,6 +144,11 @@ class EventCenter {
   int init(int nevent);
   void set_owner(pthread_t p) { owner = p; }
   pthread_t get_owner() { return owner; }
+  utime_t get_last_process_latency() { return last_process_latency; }
+  uint64_t get_external_backlog() {
+    Mutex::Locker l(external_lock);
+    return external_events.size();
+  }
 
   // Used by internal thread
   int create_file_event(int fd, int mask, EventCallbackRef ctxt);
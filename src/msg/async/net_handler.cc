@@ -91,6 +91,17 @@ void NetHandler::set_socket_options(int sd)
     }
   }
 
+#ifdef SO_BUSY_POLL
+  if (cct->_conf->ms_async_busy_poll_us) {
+    int usecs = cct->_conf->ms_async_busy_poll_us;
+    int r = ::setsockopt(sd, SOL_SOCKET, SO_BUSY_POLL, (void*)&usecs, sizeof(usecs));
+    if (r < 0) {
+      r = -errno;
+      ldout(cct, 0) << "couldn't set SO_BUSY_POLL to " << usecs << ": " << cpp_strerror(r) << dendl;
+    }
+  }
+#endif
+
   // block ESIGPIPE
 #ifdef CEPH_USE_SO_NOSIGPIPE
   int val = 1;
@@ -120,6 +120,7 @@ void Pipe::handle_ack(uint64_t seq)
 	 sent.front()->get_seq() <= seq) {
     Message *m = sent.front();
     sent.pop_front();
+    connection_state->note_send_acked(m);
     lsubdout(msgr->cct, ms, 10) << "reader got ack seq "
 				<< seq << " >= " << m->get_seq() << " on " << m << " " << *m << dendl;
     m->put();
@@ -1765,6 +1766,7 @@ void Pipe::writer()
       Message *m = _get_next_outgoing();
       if (m) {
 	m->set_seq(++out_seq);
+	connection_state->note_send_written(m);
 	if (!policy.lossy) {
 	  // put on sent list
 	  sent.push_back(m); 
@@ -294,6 +294,7 @@ class DispatchQueue;
 
     void _send(Message *m) {
       assert(pipe_lock.is_locked());
+      connection_state->note_send_queued(m);
       out_q[m->get_priority()].push_back(m);
       cond.Signal();
     }
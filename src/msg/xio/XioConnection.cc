@@ -636,6 +636,19 @@ int XioConnection::_mark_disposable(uint32_t flags)
   return 0;
 }
 
+bufferptr XioConnection::alloc_registered_buffer(unsigned len)
+{
+  if (!xio_msgr_mpool)
+    return bufferptr();
+  buffer::raw *r = buffer::create_xio_mempool(len, xio_msgr_mpool);
+  if (!r) {
+    ldout(msgr->cct,4) << __func__ << " registered pool exhausted for "
+		       << len << " bytes" << dendl;
+    return bufferptr();
+  }
+  return bufferptr(r);
+}
+
 int XioConnection::CState::state_up_ready(uint32_t flags)
 {
   if (! (flags & CState::OP_FLAG_LOCKED))
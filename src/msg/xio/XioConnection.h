@@ -267,6 +267,7 @@ public:
   int _mark_down(uint32_t flags);
   virtual void mark_disposable();
   int _mark_disposable(uint32_t flags);
+  bufferptr alloc_registered_buffer(unsigned len);
 
   const entity_inst_t& get_peer() const { return peer; }
 
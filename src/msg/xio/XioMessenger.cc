@@ -33,6 +33,7 @@ atomic_t initialized;
 atomic_t XioMessenger::nInstances;
 
 struct xio_mempool *xio_msgr_noreg_mpool;
+struct xio_mempool *xio_msgr_mpool;
 
 static struct xio_session_ops xio_msgr_ops;
 
@@ -358,6 +359,21 @@ XioMessenger::XioMessenger(CephContext *cct, entity_name_t name,
 				       cct->_conf->xio_mp_max_page,
 				       XMSG_MEMPOOL_QUANTUM, 0);
 
+      /* and a registered one for data buffers filled in place (OSD
+       * reads), so replies go out without a copy */
+      if (cct->_conf->xio_mp_max_data > 0) {
+	xio_msgr_mpool =
+	  xio_mempool_create(-1 /* nodeid */, XIO_MEMPOOL_FLAG_REG_MR);
+	if (xio_msgr_mpool) {
+	  static const size_t data_slabs[] = { 4096, 65536, 1048576, 4194304 };
+	  for (unsigned i = 0;
+	       i < sizeof(data_slabs)/sizeof(data_slabs[0]); ++i)
+	    (void) xio_mempool_add_slab(xio_msgr_mpool, data_slabs[i],
+					0, cct->_conf->xio_mp_max_data,
+					16 /* grow in small steps */, 0);
+	}
+      }
+
       /* initialize ops singleton */
       xio_msgr_ops.on_session_event = on_session_event;
       xio_msgr_ops.on_new_session = on_new_session;
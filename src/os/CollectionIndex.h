@@ -176,6 +176,23 @@ protected:
   /// Call prior to removing directory
   virtual int prep_delete() { return 0; }
 
+  /// Dump index statistics (e.g. path cache hit rates)
+  virtual void dump_stats(Formatter *f) const {}
+
+  /// Number of directory splits left for split_pending()
+  virtual unsigned num_pending_splits() { return 0; }
+
+  /**
+   * Do one deferred directory split
+   *
+   * Caller must hold access_lock for write.
+   *
+   * @return Error Code, 0 for success
+   */
+  virtual int split_pending(
+    uint64_t *moved ///< [out] objects moved by the split
+    ) { return 0; }
+
   CollectionIndex(coll_t collection):
     access_lock_name ("CollectionIndex::access_lock::" + collection.to_str()), 
     access_lock(access_lock_name.c_str()) {}
@@ -709,6 +709,35 @@ int DBObjectMap::rm_keys(const ghobject_t &oid,
   return db->submit_transaction(t);
 }
 
+int DBObjectMap::rm_key_range(const ghobject_t &oid,
+			      const string &first,
+			      const string &last,
+			      const SequencerPosition *spos)
+{
+  set<string> to_clear;
+  {
+    MapHeaderLock hl(this, oid);
+    Header header = lookup_map_header(hl, oid);
+    if (!header)
+      return -ENOENT;
+    if (check_spos(oid, header, spos))
+      return 0;
+    if (!header->parent) {
+      // all keys are our own: drop the range without listing it
+      KeyValueDB::Transaction t = db->get_transaction();
+      t->rm_range_keys(user_prefix(header), first, last);
+      return db->submit_transaction(t);
+    }
+
+    // keys may still live in the parent; let rm_keys copy up around them
+    DBObjectMapIterator iter = _get_iterator(header);
+    for (iter->lower_bound(first); iter->valid() && iter->key() < last;
+	 iter->next())
+      to_clear.insert(iter->key());
+  }
+  return rm_keys(oid, to_clear, spos);
+}
+
 int DBObjectMap::clear_keys_header(const ghobject_t &oid,
 				   const SequencerPosition *spos)
 {
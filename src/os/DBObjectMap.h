@@ -151,6 +151,13 @@ public:
     const SequencerPosition *spos=0
     );
 
+  int rm_key_range(
+    const ghobject_t &oid,
+    const string &first,
+    const string &last,
+    const SequencerPosition *spos=0
+    );
+
   int get(
     const ghobject_t &oid,
     bufferlist *header,
@@ -212,6 +219,15 @@ public:
   /// Consistency check, debug, there must be no parallel writes
   bool check(std::ostream &out);
 
+  void dump_kv_stats(Formatter *f) {
+    db->get_statistics(f);
+  }
+  int compact_kv(const string& prefix,
+		 const string& start, const string& end) {
+    db->compact_keys(prefix, start, end);
+    return 0;
+  }
+
   /// Ensure that all previous operations are durable
   int sync(const ghobject_t *oid=0, const SequencerPosition *spos=0);
 
@@ -0,0 +1,153 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "acconfig.h"
+
+#include "os/FDCache.h"
+#include "common/perf_counters.h"
+
+void FDCache::Shard::remove(Entry *e)
+{
+  entries.erase(e->oid);
+  Entry *last = clock.back();
+  clock[e->slot] = last;
+  last->slot = e->slot;
+  clock.pop_back();
+  if (hand >= clock.size())
+    hand = 0;
+  delete e;
+}
+
+bool FDCache::Shard::evict_one(unsigned *pinned)
+{
+  // every unpinned entry reaches zero within MAX_USAGE + 1 turns
+  size_t steps = clock.size() * (MAX_USAGE + 1);
+  *pinned = 0;
+  for (size_t i = 0; i < steps && !clock.empty(); ++i) {
+    if (hand >= clock.size())
+      hand = 0;
+    Entry *e = clock[hand];
+    unsigned u = e->usage.load(std::memory_order_relaxed);
+    if (u > 0) {
+      e->usage.store(u - 1, std::memory_order_relaxed);
+    } else if (e->fd.use_count() > 1) {
+      ++*pinned;
+    } else {
+      remove(e);  // the hand now points at the entry moved into this slot
+      return true;
+    }
+    ++hand;
+  }
+  return false;
+}
+
+FDCache::FDCache(CephContext *cct)
+  : cct(cct),
+    registry_shards(cct->_conf->filestore_fd_cache_shards),
+    logger(NULL)
+{
+  assert(cct);
+  registry = new Shard[registry_shards];
+  set_size(cct->_conf->filestore_fd_cache_size);
+
+  PerfCountersBuilder b(cct, string("fdcache"),
+			l_fdcache_first, l_fdcache_last);
+  b.add_u64_counter(l_fdcache_hit, "hit", "Lookups that found a cached fd");
+  b.add_u64_counter(l_fdcache_miss, "miss", "Lookups that found no fd");
+  b.add_u64_counter(l_fdcache_add, "add", "Fds added");
+  b.add_u64_counter(l_fdcache_evict, "evict", "Fds evicted");
+  b.add_u64_counter(l_fdcache_pinned, "pinned", "In use fds skipped by eviction");
+  b.add_u64(l_fdcache_size, "size", "Cached fds");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+
+  cct->_conf->add_observer(this);
+}
+
+FDCache::~FDCache()
+{
+  cct->_conf->remove_observer(this);
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+  delete[] registry;
+}
+
+void FDCache::set_size(size_t size)
+{
+  size_t per_shard = MAX(size / registry_shards, 1);
+  for (int i = 0; i < registry_shards; ++i) {
+    RWLock::WLocker l(registry[i].lock);
+    registry[i].max_size = per_shard;
+  }
+}
+
+FDCache::FDRef FDCache::lookup(const ghobject_t &hoid)
+{
+  Shard &shard = get_shard(hoid);
+  RWLock::RLocker l(shard.lock);
+  ceph::unordered_map<ghobject_t, Entry*>::iterator p =
+    shard.entries.find(hoid);
+  if (p == shard.entries.end()) {
+    logger->inc(l_fdcache_miss);
+    return FDRef();
+  }
+  Entry *e = p->second;
+  if (e->usage.load(std::memory_order_relaxed) < MAX_USAGE)
+    e->usage.fetch_add(1, std::memory_order_relaxed);
+  logger->inc(l_fdcache_hit);
+  return e->fd;
+}
+
+FDCache::FDRef FDCache::add(const ghobject_t &hoid, int fd, bool *existed)
+{
+  Shard &shard = get_shard(hoid);
+  RWLock::WLocker l(shard.lock);
+  ceph::unordered_map<ghobject_t, Entry*>::iterator p =
+    shard.entries.find(hoid);
+  if (p != shard.entries.end()) {
+    *existed = true;
+    return p->second->fd;
+  }
+  *existed = false;
+
+  unsigned evicted = 0, pinned = 0;
+  while (shard.clock.size() >= shard.max_size &&
+	 shard.evict_one(&pinned))
+    ++evicted;
+
+  Entry *e = new Entry(hoid, new FD(fd), shard.clock.size());
+  shard.clock.push_back(e);
+  shard.entries[hoid] = e;
+
+  logger->inc(l_fdcache_add);
+  if (evicted) {
+    logger->inc(l_fdcache_evict, evicted);
+    logger->dec(l_fdcache_size, evicted);
+  }
+  if (pinned)
+    logger->inc(l_fdcache_pinned, pinned);
+  logger->inc(l_fdcache_size);
+  return e->fd;
+}
+
+void FDCache::clear(const ghobject_t &hoid)
+{
+  Shard &shard = get_shard(hoid);
+  RWLock::WLocker l(shard.lock);
+  ceph::unordered_map<ghobject_t, Entry*>::iterator p =
+    shard.entries.find(hoid);
+  if (p == shard.entries.end())
+    return;
+  shard.remove(p->second);
+  logger->dec(l_fdcache_size);
+}
+
+size_t FDCache::size()
+{
+  size_t n = 0;
+  for (int i = 0; i < registry_shards; ++i) {
+    RWLock::RLocker l(registry[i].lock);
+    n += registry[i].clock.size();
+  }
+  return n;
+}
@@ -18,15 +18,41 @@
 #include <memory>
 #include <errno.h>
 #include <cstdio>
+#include <vector>
+#include <atomic>
 #include "common/hobject.h"
-#include "common/Mutex.h"
-#include "common/Cond.h"
-#include "common/shared_cache.hpp"
+#include "common/RWLock.h"
+#include "common/ceph_context.h"
+#include "common/config.h"
 #include "include/compat.h"
 #include "include/intarith.h"
+#include "include/memory.h"
+#include "include/unordered_map.h"
+
+class PerfCounters;
+
+enum {
+  l_fdcache_first = 999190,
+  l_fdcache_hit,
+  l_fdcache_miss,
+  l_fdcache_add,
+  l_fdcache_evict,
+  l_fdcache_pinned,
+  l_fdcache_size,
+  l_fdcache_last
+};
 
 /**
  * FD Cache
+ *
+ * Sharded by object hash.  Lookups only take the shard lock for read
+ * and mark the entry used with an atomic, so hits on the same shard
+ * don't serialize on an LRU list.  Replacement is a generalized CLOCK:
+ * every hit adds to the entry's usage (up to MAX_USAGE), the hand takes
+ * one off per pass, and the entry it finds at zero is evicted.  Entries
+ * still referenced outside the cache (an op in flight, WBThrottle) are
+ * pinned and skipped; if everything is pinned the shard goes over size
+ * rather than block.
  */
 class FDCache : public md_config_obs_t {
 public:
@@ -48,45 +74,60 @@ public:
       VOID_TEMP_FAILURE_RETRY(::close(fd));
     }
   };
+  typedef ceph::shared_ptr<FD> FDRef;
+
+  static const unsigned MAX_USAGE = 3;
 
 private:
+  struct Entry {
+    ghobject_t oid;
+    FDRef fd;
+    std::atomic<unsigned> usage;
+    unsigned slot;          ///< index in Shard::clock
+    Entry(const ghobject_t &o, FD *f, unsigned s)
+      : oid(o), fd(f), usage(1), slot(s) {}
+  };
+
+  struct Shard {
+    RWLock lock;
+    ceph::unordered_map<ghobject_t, Entry*> entries;
+    vector<Entry*> clock;
+    unsigned hand;
+    size_t max_size;
+    Shard() : lock("FDCache::Shard::lock", false), hand(0), max_size(1) {}
+    ~Shard() {
+      for (vector<Entry*>::iterator p = clock.begin(); p != clock.end(); ++p)
+	delete *p;
+    }
+
+    /// drop e from the shard; caller holds the write lock
+    void remove(Entry *e);
+    /// evict one unpinned entry; false if there is none
+    bool evict_one(unsigned *pinned);
+  };
+
   CephContext *cct;
   const int registry_shards;
-  SharedLRU<ghobject_t, FD, ghobject_t::BitwiseComparator> *registry;
+  Shard *registry;
+  PerfCounters *logger;
 
-public:
-  FDCache(CephContext *cct) : cct(cct),
-  registry_shards(cct->_conf->filestore_fd_cache_shards) {
-    assert(cct);
-    cct->_conf->add_observer(this);
-    registry = new SharedLRU<ghobject_t, FD, ghobject_t::BitwiseComparator>[registry_shards];
-    for (int i = 0; i < registry_shards; ++i) {
-      registry[i].set_cct(cct);
-      registry[i].set_size(
-          MAX((cct->_conf->filestore_fd_cache_size / registry_shards), 1));
-    }
+  Shard &get_shard(const ghobject_t &hoid) {
+    return registry[hoid.hobj.get_hash() % registry_shards];
   }
-  ~FDCache() {
-    cct->_conf->remove_observer(this);
-    delete[] registry;
-  }
-  typedef ceph::shared_ptr<FD> FDRef;
+  void set_size(size_t size);
 
-  FDRef lookup(const ghobject_t &hoid) {
-    int registry_id = hoid.hobj.get_hash() % registry_shards;
-    return registry[registry_id].lookup(hoid);
-  }
+public:
+  FDCache(CephContext *cct);
+  ~FDCache();
 
-  FDRef add(const ghobject_t &hoid, int fd, bool *existed) {
-    int registry_id = hoid.hobj.get_hash() % registry_shards;
-    return registry[registry_id].add(hoid, new FD(fd), existed);
-  }
+  FDRef lookup(const ghobject_t &hoid);
+  FDRef add(const ghobject_t &hoid, int fd, bool *existed);
 
   /// clear cached fd for hoid, subsequent lookups will get an empty FD
-  void clear(const ghobject_t &hoid) {
-    int registry_id = hoid.hobj.get_hash() % registry_shards;
-    registry[registry_id].purge(hoid);
-  }
+  void clear(const ghobject_t &hoid);
+
+  /// number of cached fds
+  size_t size();
 
   /// md_config_obs_t
   const char** get_tracked_conf_keys() const {
@@ -98,11 +139,8 @@ public:
   }
   void handle_conf_change(const md_config_t *conf,
 			  const std::set<std::string> &changed) {
-    if (changed.count("filestore_fd_cache_size")) {
-      for (int i = 0; i < registry_shards; ++i)
-        registry[i].set_size(
-              MAX((conf->filestore_fd_cache_size / registry_shards), 1));
-    }
+    if (changed.count("filestore_fd_cache_size"))
+      set_size(conf->filestore_fd_cache_size);
   }
 
 };
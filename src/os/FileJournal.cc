@@ -100,14 +100,27 @@ int FileJournal::_open(bool forwrite, bool create)
 
 #ifdef HAVE_LIBAIO
   if (aio) {
-    aio_ctx = 0;
-    ret = io_setup(128, &aio_ctx);
-    if (ret < 0) {
-      ret = errno;
-      derr << "FileJournal::_open: unable to setup io_context " << cpp_strerror(ret) << dendl;
-      ret = -ret;
-      goto out_fd;
+    unsigned queues = MAX(g_conf->journal_aio_queues, 1);
+    for (unsigned i = 0; i < aio_ctxs.size(); ++i)
+      io_destroy(aio_ctxs[i]);
+    aio_ctxs.assign(queues, 0);
+    aio_queue_num.assign(queues, 0);
+    aio_next_queue = 0;
+    for (unsigned i = 0; i < queues; ++i) {
+      ret = io_setup(128, &aio_ctxs[i]);
+      if (ret < 0) {
+	ret = errno;
+	derr << "FileJournal::_open: unable to setup io_context " << cpp_strerror(ret) << dendl;
+	ret = -ret;
+	aio_ctxs.resize(i);
+	goto out_fd;
+      }
     }
+    // pieces must stay block aligned for O_DIRECT
+    aio_stripe = 0;
+    if (g_conf->journal_aio_stripe_size > 0)
+      aio_stripe = ROUND_UP_TO(g_conf->journal_aio_stripe_size,
+			       CEPH_MINIMUM_BLOCK_SIZE);
   }
 #endif
 
@@ -119,6 +132,9 @@ int FileJournal::_open(bool forwrite, bool create)
 	  << " bytes, block size " << block_size
 	  << " bytes, directio = " << directio
 	  << ", aio = " << aio
+#ifdef HAVE_LIBAIO
+	  << ", aio queues = " << aio_ctxs.size()
+#endif
 	  << dendl;
   return 0;
 
@@ -693,8 +709,13 @@ void FileJournal::start_writer()
   aio_stop = false;
   write_thread.create();
 #ifdef HAVE_LIBAIO
-  if (aio)
-    write_finish_thread.create();
+  if (aio) {
+    for (unsigned i = 0; i < aio_ctxs.size(); ++i) {
+      WriteFinisher *t = new WriteFinisher(this, i);
+      t->create();
+      write_finish_threads.push_back(t);
+    }
+  }
 #endif
 }
 
@@ -725,9 +746,13 @@ void FileJournal::stop_writer()
     aio_lock.Lock();
     aio_stop = true;
     aio_cond.Signal();
-    write_finish_cond.Signal();
+    write_finish_cond.SignalAll();
     aio_lock.Unlock();
-    write_finish_thread.join();
+    while (!write_finish_threads.empty()) {
+      write_finish_threads.back()->join();
+      delete write_finish_threads.back();
+      write_finish_threads.pop_back();
+    }
   }
 #endif
 }
@@ -872,7 +897,8 @@ int FileJournal::prepare_multi_write(bufferlist& bl, uint64_t& orig_ops, uint64_
   off64_t queue_pos = write_pos;
 
   int eleft = g_conf->journal_max_write_entries;
-  unsigned bmax = g_conf->journal_max_write_bytes;
+  unsigned conf_bmax = g_conf->journal_max_write_bytes;
+  unsigned bmax = group_commit.get_max_bytes(conf_bmax);
 
   if (full_state != FULL_NOTFULL)
     return -ENOSPC;
@@ -911,7 +937,9 @@ int FileJournal::prepare_multi_write(bufferlist& bl, uint64_t& orig_ops, uint64_
     }
     if (bmax) {
       if (bl.length() >= bmax) {
-	dout(20) << "prepare_multi_write hit max write size " << g_conf->journal_max_write_bytes << dendl;
+	dout(20) << "prepare_multi_write hit max write size " << bmax << dendl;
+	if (logger && (!conf_bmax || bmax < conf_bmax))
+	  logger->inc(l_os_j_gc_capped);
 	break;
       }
     }
@@ -957,8 +985,11 @@ void FileJournal::queue_completions_thru(uint64_t seq)
 	     << " queueing seq " << next.seq
 	     << " " << next.finish
 	     << " lat " << lat << dendl;
+    bool over = group_commit.note_commit(lat);
     if (logger) {
       logger->tinc(l_os_j_lat, lat);
+      if (over)
+	logger->inc(l_os_j_gc_over_target);
     }
     if (next.finish)
       finisher->queue(next.finish);
@@ -1102,6 +1133,7 @@ void FileJournal::do_write(bufferlist& bl)
 
   // Adjust write_pos
   align_bl(pos, bl);
+  uint64_t write_len = bl.length();
   write_pos += bl.length();
   if (write_pos >= header.max_size)
     write_pos = write_pos - header.max_size + get_top();
@@ -1200,6 +1232,7 @@ void FileJournal::do_write(bufferlist& bl)
 
   utime_t lat = ceph_clock_now(g_ceph_context) - from;    
   dout(20) << "do_write latency " << lat << dendl;
+  group_commit.note_write(write_len, lat);
 
   write_lock.Lock();    
 
@@ -1241,6 +1274,52 @@ void FileJournal::flush()
 }
 
 
+/**
+ * Hold the writer briefly so more entries can join the next write, if
+ * the group commit controller says the oldest queued entry will still
+ * commit within journal_group_commit_target_latency.
+ */
+void FileJournal::group_commit_hold()
+{
+  assert(writeq_lock.is_locked());
+  group_commit.set_target(g_conf->journal_group_commit_target_latency,
+			  g_conf->journal_group_commit_max_delay);
+  if (!group_commit.enabled() || write_stop || writeq.empty() ||
+      must_write_header)
+    return;
+
+  utime_t start = ceph_clock_now(g_ceph_context);
+  uint64_t queued = throttle_bytes.get_current();
+  if (logger)
+    logger->set(l_os_j_gc_est_lat,
+		(uint64_t)(group_commit.predict_tail(queued) * 1000000.0));
+  double hold = group_commit.get_hold(start - writeq.front().submitted,
+				      queued);
+  if (hold <= 0)
+    return;
+
+  unsigned emax = g_conf->journal_max_write_entries;
+  uint64_t bmax = group_commit.get_max_bytes(g_conf->journal_max_write_bytes);
+  utime_t until = start;
+  until += hold;
+  dout(20) << "group_commit_hold up to " << hold << " with "
+	   << writeq.size() << " entries " << queued << " bytes queued" << dendl;
+  write_holding = true;
+  while (!write_stop &&
+	 (!emax || writeq.size() < emax) &&
+	 (!bmax || throttle_bytes.get_current() < bmax)) {
+    utime_t now = ceph_clock_now(g_ceph_context);
+    if (now >= until)
+      break;
+    writeq_cond.WaitInterval(g_ceph_context, writeq_lock, until - now);
+  }
+  write_holding = false;
+  if (logger) {
+    logger->inc(l_os_j_gc_hold);
+    logger->tinc(l_os_j_gc_hold_lat, ceph_clock_now(g_ceph_context) - start);
+  }
+}
+
 void FileJournal::write_thread_entry()
 {
   dout(10) << "write_thread_entry start" << dendl;
@@ -1255,6 +1334,7 @@ void FileJournal::write_thread_entry()
 	dout(20) << "write_thread_entry woke up" << dendl;
 	continue;
       }
+      group_commit_hold();
     }
     
 #ifdef HAVE_LIBAIO
@@ -1264,18 +1344,22 @@ void FileJournal::write_thread_entry()
       // adaptively so that we submit larger aios once we have lots of
       // them in flight.
       //
-      // NOTE: our condition here is based on aio_num (protected by
+      // NOTE: our condition here is based on aio_writes (protected by
       // aio_lock) and throttle_bytes (part of the write queue).  when
-      // we sleep, we *only* wait for aio_num to change, and do not
+      // we sleep, we *only* wait for aio_writes to change, and do not
       // wake when more data is queued.  this is not strictly correct,
       // but should be fine given that we will have plenty of aios in
       // flight if we hit this limit to ensure we keep the device
       // saturated.
-      while (aio_num > 0) {
-	int exp = MIN(aio_num * 2, 24);
+      //
+      // with several submit queues, each queue gets that much room.
+      while (aio_writes > 0) {
+	int per_queue = aio_writes / (int)aio_ctxs.size();
+	int exp = MIN(per_queue * 2, 24);
 	long unsigned min_new = 1ull << exp;
 	long unsigned cur = throttle_bytes.get_current();
-	dout(20) << "write_thread_entry aio throttle: aio num " << aio_num << " bytes " << aio_bytes
+	dout(20) << "write_thread_entry aio throttle: aio num " << aio_num
+		 << " writes " << aio_writes << " bytes " << aio_bytes
 		 << " ... exp " << exp << " min_new " << min_new
 		 << " ... pending " << cur << dendl;
 	if (cur >= min_new)
@@ -1425,40 +1509,56 @@ int FileJournal::write_aio_bl(off64_t& pos, bufferlist& bl, uint64_t seq)
   align_bl(pos, bl);
 
   dout(20) << "write_aio_bl " << pos << "~" << bl.length() << " seq " << seq << dendl;
-  
+
+  aio_writes++;
+  uint64_t write_len = bl.length();
+  utime_t submitted = ceph_clock_now(g_ceph_context);
   while (bl.length() > 0) {
+    // cut at aio_stripe; align_bl left every segment block sized, so a
+    // cut inside a segment stays aligned too
+    unsigned want = bl.length();
+    if (aio_stripe && want > aio_stripe)
+      want = aio_stripe;
     int max = MIN(bl.buffers().size(), IOV_MAX-1);
     iovec *iov = new iovec[max];
     int n = 0;
     unsigned len = 0;
     for (std::list<buffer::ptr>::const_iterator p = bl.buffers().begin();
-	 n < max;
+	 n < max && len < want;
 	 ++p, ++n) {
       assert(p != bl.buffers().end());
       iov[n].iov_base = (void *)p->c_str();
-      iov[n].iov_len = p->length();
-      len += p->length();
+      iov[n].iov_len = MIN(p->length(), want - len);
+      len += iov[n].iov_len;
     }
 
     bufferlist tbl;
     bl.splice(0, len, &tbl);  // move bytes from bl -> tbl
 
-    aio_queue.push_back(aio_info(tbl, pos, bl.length() > 0 ? 0 : seq));
+    unsigned q = aio_next_queue;
+    aio_next_queue = (aio_next_queue + 1) % aio_ctxs.size();
+    bool last = bl.length() == 0;
+    aio_queue.push_back(aio_info(tbl, pos, last ? seq : 0, q, last));
     aio_info& aio = aio_queue.back();
     aio.iov = iov;
+    if (last) {
+      aio.write_len = write_len;
+      aio.submitted = submitted;
+    }
 
     io_prep_pwritev(&aio.iocb, fd, aio.iov, n, pos);
 
     dout(20) << "write_aio_bl .. " << aio.off << "~" << aio.len
-	     << " in " << n << dendl;
+	     << " in " << n << " on queue " << q << dendl;
 
     aio_num++;
     aio_bytes += aio.len;
+    aio_queue_num[q]++;
 
     iocb *piocb = &aio.iocb;
     int attempts = 10;
     do {
-      int r = io_submit(aio_ctx, 1, &piocb);
+      int r = io_submit(aio_ctxs[q], 1, &piocb);
       if (r < 0) {
 	derr << "io_submit to " << aio.off << "~" << aio.len
 	     << " got " << cpp_strerror(r) << dendl;
@@ -1473,30 +1573,31 @@ int FileJournal::write_aio_bl(off64_t& pos, bufferlist& bl, uint64_t seq)
     } while (true);
     pos += aio.len;
   }
-  write_finish_cond.Signal();
+  write_finish_cond.SignalAll();
   return 0;
 }
 #endif
 
-void FileJournal::write_finish_thread_entry()
+void FileJournal::write_finish_thread_entry(unsigned q)
 {
 #ifdef HAVE_LIBAIO
-  dout(10) << "write_finish_thread_entry enter" << dendl;
+  dout(10) << "write_finish_thread_entry " << q << " enter" << dendl;
   while (true) {
     {
       Mutex::Locker locker(aio_lock);
-      if (aio_queue.empty()) {
+      if (aio_queue_num[q] == 0) {
+	// the writer has already stopped, so nothing more will land here
 	if (aio_stop)
 	  break;
-	dout(20) << "write_finish_thread_entry sleeping" << dendl;
+	dout(20) << "write_finish_thread_entry " << q << " sleeping" << dendl;
 	write_finish_cond.Wait(aio_lock);
 	continue;
       }
     }
     
-    dout(20) << "write_finish_thread_entry waiting for aio(s)" << dendl;
+    dout(20) << "write_finish_thread_entry " << q << " waiting for aio(s)" << dendl;
     io_event event[16];
-    int r = io_getevents(aio_ctx, 1, 16, event, NULL);
+    int r = io_getevents(aio_ctxs[q], 1, 16, event, NULL);
     if (r < 0) {
       if (r == -EINTR) {
 	dout(0) << "io_getevents got " << cpp_strerror(r) << dendl;
@@ -1518,11 +1619,12 @@ void FileJournal::write_finish_thread_entry()
 	dout(10) << "write_finish_thread_entry aio " << ai->off
 		 << "~" << ai->len << " done" << dendl;
 	ai->done = true;
+	aio_queue_num[q]--;
       }
       check_aio_completion();
     }
   }
-  dout(10) << "write_finish_thread_entry exit" << dendl;
+  dout(10) << "write_finish_thread_entry " << q << " exit" << dendl;
 #endif
 }
 
@@ -1537,6 +1639,7 @@ void FileJournal::check_aio_completion()
 
   bool completed_something = false, signal = false;
   uint64_t new_journaled_seq = 0;
+  utime_t now = ceph_clock_now(g_ceph_context);
 
   list<aio_info>::iterator p = aio_queue.begin();
   while (p != aio_queue.end() && p->done) {
@@ -1548,6 +1651,10 @@ void FileJournal::check_aio_completion()
     }
     aio_num--;
     aio_bytes -= p->len;
+    if (p->last) {
+      aio_writes--;
+      group_commit.note_write(p->write_len, now - p->submitted);
+    }
     aio_queue.erase(p++);
     signal = true;
   }
@@ -1597,15 +1704,17 @@ void FileJournal::submit_entry(uint64_t seq, bufferlist& e, int alignment,
     logger->set(l_os_jq_bytes, throttle_bytes.get_current());
   }
 
+  utime_t now = ceph_clock_now(g_ceph_context);
+  group_commit.note_arrival(now);
   {
     Mutex::Locker l1(writeq_lock);  // ** lock **
     Mutex::Locker l2(completions_lock);  // ** lock **
     completions.push_back(
       completion_item(
-	seq, oncommit, ceph_clock_now(g_ceph_context), osd_op));
-    if (writeq.empty())
+	seq, oncommit, now, osd_op));
+    if (writeq.empty() || write_holding)
       writeq_cond.Signal();
-    writeq.push_back(write_item(seq, e, alignment, osd_op));
+    writeq.push_back(write_item(seq, e, alignment, osd_op, now));
   }
 }
 
@@ -20,6 +20,7 @@
 using std::deque;
 
 #include "Journal.h"
+#include "JournalGroupCommit.h"
 #include "common/Cond.h"
 #include "common/Mutex.h"
 #include "common/Thread.h"
@@ -52,8 +53,10 @@ public:
     bufferlist bl;
     int alignment;
     TrackedOpRef tracked_op;
-    write_item(uint64_t s, bufferlist& b, int al, TrackedOpRef opref) :
-      seq(s), alignment(al), tracked_op(opref) {
+    utime_t submitted;
+    write_item(uint64_t s, bufferlist& b, int al, TrackedOpRef opref,
+	       utime_t sub) :
+      seq(s), alignment(al), tracked_op(opref), submitted(sub) {
       bl.claim(b, buffer::list::CLAIM_ALLOW_NONSHAREABLE); // potential zero-copy
     }
     write_item() : seq(0), alignment(0) {}
@@ -67,6 +70,7 @@ public:
   Mutex writeq_lock;
   Cond writeq_cond;
   deque<write_item> writeq;
+  bool write_holding;  ///< writer is gathering a group commit
   bool writeq_empty();
   write_item &peek_write();
   void pop_write();
@@ -239,9 +243,14 @@ private:
     bool done;
     uint64_t off, len;    ///< these are for debug only
     uint64_t seq;         ///< seq number to complete on aio completion, if non-zero
-
-    aio_info(bufferlist& b, uint64_t o, uint64_t s)
-      : iov(NULL), done(false), off(o), len(b.length()), seq(s) {
+    unsigned queue;       ///< submit queue (aio_ctxs index) it went to
+    bool last;            ///< last piece of a write_aio_bl() call
+    uint64_t write_len;   ///< if last, bytes of the whole write
+    utime_t submitted;    ///< if last, when the write was submitted
+
+    aio_info(bufferlist& b, uint64_t o, uint64_t s, unsigned q, bool l)
+      : iov(NULL), done(false), off(o), len(b.length()), seq(s),
+	queue(q), last(l), write_len(0) {
       bl.claim(b);
       memset((void*)&iocb, 0, sizeof(iocb));
     }
@@ -252,10 +261,21 @@ private:
   Mutex aio_lock;
   Cond aio_cond;
   Cond write_finish_cond;
-  io_context_t aio_ctx;
+  /**
+   * Independent submit queues (journal_aio_queues), each with its own
+   * completion thread.  Writes are cut into journal_aio_stripe_size
+   * pieces spread round robin over the queues; aio_queue keeps them in
+   * journal order, so seqs still complete strictly in order no matter
+   * which queue finishes first.
+   */
+  vector<io_context_t> aio_ctxs;
+  vector<int> aio_queue_num;  ///< aios in flight per submit queue
+  unsigned aio_next_queue;
   list<aio_info> aio_queue;
   int aio_num, aio_bytes;
+  int aio_writes;             ///< write_aio_bl() calls not yet complete
   /// End protected by aio_lock
+  unsigned aio_stripe;        ///< max bytes per aio, 0 for no limit
 #endif
 
   uint64_t last_committed_seq;
@@ -309,12 +329,15 @@ private:
 
   void queue_completions_thru(uint64_t seq);
 
+  JournalGroupCommit group_commit;
+  void group_commit_hold();
+
   int check_for_full(uint64_t seq, off64_t pos, off64_t size);
   int prepare_multi_write(bufferlist& bl, uint64_t& orig_ops, uint64_t& orig_bytee);
   int prepare_single_write(bufferlist& bl, off64_t& queue_pos, uint64_t& orig_ops, uint64_t& orig_bytes);
   void do_write(bufferlist& bl);
 
-  void write_finish_thread_entry();
+  void write_finish_thread_entry(unsigned q);
   void check_aio_completion();
   void do_aio_write(bufferlist& bl);
   int write_aio_bl(off64_t& pos, bufferlist& bl, uint64_t seq);
@@ -345,13 +368,15 @@ private:
 
   class WriteFinisher : public Thread {
     FileJournal *journal;
+    unsigned queue;
   public:
-    WriteFinisher(FileJournal *fj) : journal(fj) {}
+    WriteFinisher(FileJournal *fj, unsigned q) : journal(fj), queue(q) {}
     void *entry() {
-      journal->write_finish_thread_entry();
+      journal->write_finish_thread_entry(queue);
       return 0;
     }
-  } write_finish_thread;
+  };
+  vector<WriteFinisher*> write_finish_threads;
 
   off64_t get_top() const {
     return ROUND_UP_TO(sizeof(header), block_size);
@@ -364,6 +389,7 @@ private:
     journaled_seq(0),
     plug_journal_completions(false),
     writeq_lock("FileJournal::writeq_lock", false, true, false, g_ceph_context),
+    write_holding(false),
     completions_lock(
       "FileJournal::completions_lock", false, true, false, g_ceph_context),
     fn(f),
@@ -375,8 +401,9 @@ private:
     discard(false),
 #ifdef HAVE_LIBAIO
     aio_lock("FileJournal::aio_lock"),
-    aio_ctx(0),
-    aio_num(0), aio_bytes(0),
+    aio_next_queue(0),
+    aio_num(0), aio_bytes(0), aio_writes(0),
+    aio_stripe(0),
 #endif
     last_committed_seq(0), 
     journaled_since_start(0),
@@ -388,8 +415,7 @@ private:
     write_lock("FileJournal::write_lock", false, true, false, g_ceph_context),
     write_stop(true),
     aio_stop(true),
-    write_thread(this),
-    write_finish_thread(this) {
+    write_thread(this) {
 
       if (aio && !directio) {
         derr << "FileJournal::_open_any: aio not supported without directio; disabling aio" << dendl;
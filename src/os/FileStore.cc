@@ -54,6 +54,7 @@
 #include "common/BackTrace.h"
 #include "include/types.h"
 #include "FileJournal.h"
+#include "PMemJournal.h"
 
 #include "osd/osd_types.h"
 #include "include/color.h"
@@ -126,6 +127,10 @@ static CompatSet get_fs_supported_compat_set() {
 
 int FileStore::peek_journal_fsid(uuid_d *fsid)
 {
+  if (g_conf->journal_pmem) {
+    PMemJournal j(*fsid, 0, 0, journalpath.c_str());
+    return j.peek_fsid(*fsid);
+  }
   // make sure we don't try to use aio or direct_io (and get annoying
   // error messages from failing to do so); performance implications
   // should be irrelevant for this use
@@ -199,6 +204,8 @@ int FileStore::lfn_truncate(coll_t cid, const ghobject_t& oid, off_t length)
   r = ::ftruncate(**fd, length);
   if (r < 0)
     r = -errno;
+  else
+    _mark_dirty(oid, fd, false);
   if (r >= 0 && m_filestore_sloppy_crc) {
     int rc = backend->_crc_update_truncate(**fd, length);
     assert(rc >= 0);
@@ -244,6 +251,13 @@ int FileStore::lfn_open(coll_t cid,
   if (create)
     flags |= O_CREAT;
 
+  // a cached fd needs neither the collection index nor its lock
+  if (!index && !replaying) {
+    *outfd = fdcache.lookup(oid);
+    if (*outfd)
+      return 0;
+  }
+
   Index index2;
   if (!index) {
     index = &index2;
@@ -263,7 +277,7 @@ int FileStore::lfn_open(coll_t cid,
   if (need_lock) {
     ((*index).index)->access_lock.get_write();
   }
-  if (!replaying) {
+  if (!replaying && index != &index2) {
     *outfd = fdcache.lookup(oid);
     if (*outfd) {
       if (need_lock) {
@@ -308,6 +322,7 @@ int FileStore::lfn_open(coll_t cid,
                      << "):" << cpp_strerror(-r) << dendl;
       goto fail;
     }
+    _mark_dirty_dir((*path)->path());
   }
 
   if (!replaying) {
@@ -319,6 +334,8 @@ int FileStore::lfn_open(coll_t cid,
   } else {
     *outfd = FDRef(new FDCache::FD(fd));
   }
+  if (create && !exist)
+    _mark_dirty(oid, *outfd, true);
 
   if (need_lock) {
     ((*index).index)->access_lock.put_write();
@@ -399,6 +416,7 @@ int FileStore::lfn_link(coll_t c, coll_t newcid, const ghobject_t& o, const ghob
     r = ::link(path_old->path(), path_new->path());
     if (r < 0)
       return -errno;
+    _mark_dirty_dir(path_new->path());
 
     r = index_new->created(newoid, path_new->path());
     if (r < 0) {
@@ -429,6 +447,7 @@ int FileStore::lfn_link(coll_t c, coll_t newcid, const ghobject_t& o, const ghob
     r = ::link(path_old->path(), path_new->path());
     if (r < 0)
       return -errno;
+    _mark_dirty_dir(path_new->path());
 
     // make sure old fd for unlinked/overwritten file is gone
     fdcache.clear(newoid);
@@ -464,6 +483,8 @@ int FileStore::lfn_unlink(coll_t cid, const ghobject_t& o,
       assert(!m_filestore_fail_eio || r != -EIO);
       return r;
     }
+    if (exist)
+      _mark_dirty_dir(path->path());
 
     if (!force_clear_omap) {
       struct stat st;
@@ -528,6 +549,10 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, osflagbit
   sync_entry_timeo_lock("sync_entry_timeo_lock"),
   timer(g_ceph_context, sync_entry_timeo_lock),
   stop(false), sync_thread(this),
+  split_lock("FileStore::split_lock"),
+  split_stop(false), split_thread(this),
+  dirty_lock("FileStore::dirty_lock"),
+  dirty_all(true), dirty_layout_seen(0),
   fdcache(g_ceph_context),
   wbthrottle(g_ceph_context),
   throttle_ops(g_ceph_context, "filestore_ops",g_conf->filestore_queue_max_ops),
@@ -536,6 +561,10 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, osflagbit
   op_tp(g_ceph_context, "FileStore::op_tp", g_conf->filestore_op_threads, "filestore_op_threads"),
   op_wq(this, g_conf->filestore_op_thread_timeout,
 	g_conf->filestore_op_thread_suicide_timeout, &op_tp),
+  read_tp(g_ceph_context, "FileStore::read_tp", g_conf->filestore_read_threads,
+	  "filestore_read_threads"),
+  read_wq(this, g_conf->filestore_op_thread_timeout,
+	  g_conf->filestore_op_thread_suicide_timeout, &read_tp),
   logger(NULL),
   read_error_lock("FileStore::read_error_lock"),
   m_filestore_commit_timeout(g_conf->filestore_commit_timeout),
@@ -560,6 +589,7 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, osflagbit
   m_filestore_do_dump(false),
   m_filestore_dump_fmt(true),
   m_filestore_sloppy_crc(g_conf->filestore_sloppy_crc),
+  m_filestore_sync_dirty_only(g_conf->filestore_sync_dirty_only),
   m_filestore_sloppy_crc_block_size(g_conf->filestore_sloppy_crc_block_size),
   m_filestore_max_alloc_hint_size(g_conf->filestore_max_alloc_hint_size),
   m_fs_type(0),
@@ -606,6 +636,18 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, osflagbit
   plb.add_time_avg(l_os_commit_lat, "commitcycle_latency", "Average latency of commit");
   plb.add_u64_counter(l_os_j_full, "journal_full", "Journal writes while full");
   plb.add_time_avg(l_os_queue_lat, "queue_transaction_latency_avg", "Store operation queue latency");
+  plb.add_u64_counter(l_os_j_gc_hold, "journal_gc_hold", "Journal writes held for group commit");
+  plb.add_time_avg(l_os_j_gc_hold_lat, "journal_gc_hold_latency", "Time journal writes were held for group commit");
+  plb.add_u64_counter(l_os_j_gc_capped, "journal_gc_capped", "Journal writes cut short to meet the latency target");
+  plb.add_u64_counter(l_os_j_gc_over_target, "journal_gc_over_target", "Journal commits over the latency target");
+  plb.add_u64(l_os_j_gc_est_lat, "journal_gc_est_latency", "Estimated tail latency of the next journal write (usec)");
+  plb.add_u64_avg(l_os_write_syscalls, "write_syscalls", "Write syscalls per transaction");
+  plb.add_u64_counter(l_os_write_coalesced, "write_coalesced", "Writes merged into an earlier write of the same transaction");
+  plb.add_u64_counter(l_os_index_split, "index_background_split", "Directory splits done in the background");
+  plb.add_time_avg(l_os_index_split_lat, "index_background_split_latency", "Time collections were locked by background splits");
+  plb.add_u64_counter(l_os_index_split_objs, "index_background_split_objects", "Objects moved by background splits");
+  plb.add_u64_avg(l_os_commit_dirty_files, "commitcycle_dirty_files", "Files and directories fsynced per commit");
+  plb.add_u64_counter(l_os_commit_syncfs, "commitcycle_syncfs", "Commits that fell back to syncfs");
 
   logger = plb.create_perf_counters();
 
@@ -688,8 +730,13 @@ void FileStore::new_journal()
 {
   if (journalpath.length()) {
     dout(10) << "open_journal at " << journalpath << dendl;
-    journal = new FileJournal(fsid, &finisher, &sync_cond, journalpath.c_str(),
-			      m_journal_dio, m_journal_aio, m_journal_force_aio);
+    if (g_conf->journal_pmem)
+      journal = new PMemJournal(fsid, &finisher, &sync_cond,
+				journalpath.c_str());
+    else
+      journal = new FileJournal(fsid, &finisher, &sync_cond,
+				journalpath.c_str(), m_journal_dio,
+				m_journal_aio, m_journal_force_aio);
     if (journal)
       journal->logger = logger;
   }
@@ -703,7 +750,11 @@ int FileStore::dump_journal(ostream& out)
   if (!journalpath.length())
     return -EINVAL;
 
-  FileJournal *journal = new FileJournal(fsid, &finisher, &sync_cond, journalpath.c_str(), m_journal_dio);
+  Journal *journal;
+  if (g_conf->journal_pmem)
+    journal = new PMemJournal(fsid, &finisher, &sync_cond, journalpath.c_str());
+  else
+    journal = new FileJournal(fsid, &finisher, &sync_cond, journalpath.c_str(), m_journal_dio);
   r = journal->dump(out);
   delete journal;
   return r;
@@ -1497,9 +1548,17 @@ int FileStore::mount()
       goto close_current_fd;
     }
 
-    if (superblock.omap_backend == "rocksdb")
+    if (superblock.omap_backend == "rocksdb") {
       omap_store->init(g_conf->filestore_rocksdb_options);
-    else
+      if (omap_store->set_column_families(
+	    g_conf->filestore_rocksdb_column_families) < 0) {
+	derr << "Error setting omap column families "
+	     << g_conf->filestore_rocksdb_column_families << dendl;
+	delete omap_store;
+	ret = -EINVAL;
+	goto close_current_fd;
+      }
+    } else
       omap_store->init();
 
     stringstream err;
@@ -1629,11 +1688,16 @@ int FileStore::mount()
   journal_start();
 
   op_tp.start();
+  if (g_conf->filestore_read_threads > 0)
+    read_tp.start();
   op_finisher.start();
   ondisk_finisher.start();
 
   timer.init();
 
+  split_stop = false;
+  split_thread.create();
+
   // upgrade?
   if (g_conf->filestore_update_to >= (int)get_target_version()) {
     int err = upgrade();
@@ -1713,8 +1777,19 @@ int FileStore::umount()
   sync_cond.Signal();
   lock.Unlock();
   sync_thread.join();
+  if (split_thread.is_started()) {
+    split_lock.Lock();
+    split_stop = true;
+    split_cond.Signal();
+    split_lock.Unlock();
+    split_thread.join();
+  }
   wbthrottle.stop();
   op_tp.stop();
+  if (g_conf->filestore_read_threads > 0) {
+    read_wq.drain();
+    read_tp.stop();
+  }
 
   journal_stop();
   if (!(generic_flags & SKIP_JOURNAL_REPLAY))
@@ -1742,6 +1817,13 @@ int FileStore::umount()
 
   force_sync = false;
 
+  {
+    Mutex::Locker l(dirty_lock);
+    dirty_fds.clear();
+    dirty_dirs.clear();
+    dirty_all = true;
+  }
+
   delete backend;
   backend = NULL;
 
@@ -2353,6 +2435,7 @@ unsigned FileStore::_do_transaction(
   Transaction::iterator i = t.begin();
   
   SequencerPosition spos(op_seq, trans_num, 0);
+  unsigned write_syscalls = 0;
   while (i.have_op()) {
     if (handle)
       handle->reset_tp_timeout();
@@ -2388,8 +2471,32 @@ unsigned FileStore::_do_transaction(
         bufferlist bl;
         i.decode_bl(bl);
         tracepoint(objectstore, write_enter, osr_name, off, len);
+        list<write_extent_t> extents;
+        extents.push_back(write_extent_t(off, len, bl));
+        // Take the writes to the same object that follow along, gluing
+        // contiguous ones together.  The replay guard is only checked for
+        // the first: nothing between them can move it, and the later ops
+        // have later positions.
+        const Transaction::Op *next;
+        while (g_conf->filestore_coalesce_writes && (next = i.peek_op()) &&
+               next->op == Transaction::OP_WRITE &&
+               next->cid == op->cid && next->oid == op->oid) {
+          op = i.decode_op();
+          spos.op++;
+          i.decode_bl(bl);
+          write_extent_t &last = extents.back();
+          if (op->off == last.offset + last.len &&
+              last.bl.length() == last.len) {
+            last.bl.claim_append(bl);
+            last.len += op->len;
+          } else {
+            extents.push_back(write_extent_t(op->off, op->len, bl));
+          }
+          logger->inc(l_os_write_coalesced);
+        }
         if (_check_replay_guard(cid, oid, spos) > 0)
-          r = _write(cid, oid, off, len, bl, fadvise_flags);
+          r = _write_extents(cid, oid, extents, fadvise_flags,
+                             &write_syscalls);
         tracepoint(objectstore, write_exit, r);
       }
       break;
@@ -2859,6 +2966,7 @@ unsigned FileStore::_do_transaction(
     spos.op++;
   }
 
+  logger->inc(l_os_write_syscalls, write_syscalls);
   _inject_failure();
 
   return 0;  // FIXME count errors
@@ -2913,6 +3021,69 @@ int FileStore::read(
   bufferlist& bl,
   uint32_t op_flags,
   bool allow_eio)
+{
+  return _read(cid, oid, offset, len, bl, NULL, op_flags, allow_eio);
+}
+
+int FileStore::read_into(
+  coll_t cid,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t len,
+  bufferptr& bp,
+  uint32_t op_flags,
+  bool allow_eio)
+{
+  assert(len > 0 && len <= bp.length());
+  bufferlist bl;
+  return _read(cid, oid, offset, len, bl, &bp, op_flags, allow_eio);
+}
+
+void FileStore::readahead(
+  coll_t cid,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t len)
+{
+#ifdef HAVE_POSIX_FADVISE
+  _kludge_temp_object_collection(cid, oid);
+  dout(15) << "readahead " << cid << "/" << oid << " " << offset << "~" << len << dendl;
+  FDRef fd;
+  int r = lfn_open(cid, oid, false, &fd);
+  if (r < 0)
+    return;
+  posix_fadvise(**fd, offset, len, POSIX_FADV_WILLNEED);
+  lfn_close(fd);
+#endif
+}
+
+void FileStore::read_async(
+  coll_t cid,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t len,
+  bufferlist *bl,
+  uint32_t op_flags,
+  Context *onfinish)
+{
+  if (g_conf->filestore_read_threads <= 0) {
+    ObjectStore::read_async(cid, oid, offset, len, bl, op_flags, onfinish);
+    return;
+  }
+  dout(15) << "read_async " << cid << "/" << oid << " " << offset << "~" << len
+	   << dendl;
+  read_wq.queue(new ReadOp(cid, oid, offset, len, bl, op_flags, onfinish));
+}
+
+int FileStore::_read(
+  coll_t cid,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t len,
+  bufferlist& bl,
+  bufferptr *dst,
+  uint32_t op_flags,
+  bool allow_eio)
 {
   int got;
   tracepoint(objectstore, read_enter, cid.c_str(), offset, len);
@@ -2943,7 +3114,11 @@ int FileStore::read(
     posix_fadvise(**fd, offset, len, POSIX_FADV_SEQUENTIAL);
 #endif
 
-  bufferptr bptr(len);  // prealloc space for entire read
+  bufferptr bptr;
+  if (dst)
+    bptr = bufferptr(*dst, 0, len);  // read in place into caller's buffer
+  else
+    bptr = bufferptr(len);  // prealloc space for entire read
   got = safe_pread(**fd, bptr.c_str(), len, offset);
   if (got < 0) {
     dout(10) << "FileStore::read(" << cid << "/" << oid << ") pread error: " << cpp_strerror(got) << dendl;
@@ -2965,9 +3140,12 @@ int FileStore::read(
     ostringstream ss;
     int errors = backend->_crc_verify_read(**fd, offset, got, bl, &ss);
     if (errors > 0) {
-      dout(0) << "FileStore::read " << cid << "/" << oid << " " << offset << "~"
-	      << got << " ... BAD CRC:\n" << ss.str() << dendl;
-      assert(0 == "bad crc on read");
+      derr << "FileStore::read " << cid << "/" << oid << " " << offset << "~"
+	   << got << " ... BAD CRC:\n" << ss.str() << dendl;
+      // a bad block is a media error as far as the caller is concerned
+      lfn_close(fd);
+      assert(allow_eio || !m_filestore_fail_eio);
+      return -EIO;
     }
   }
 
@@ -3134,6 +3312,132 @@ done:
   return r;
 }
 
+int FileStore::sparse_read(coll_t cid, const ghobject_t& oid,
+			   uint64_t offset, size_t len,
+			   map<uint64_t, uint64_t>& m, bufferlist& bl,
+			   uint32_t op_flags, bool allow_eio)
+{
+  _kludge_temp_object_collection(cid, oid);
+  dout(15) << "sparse_read " << cid << "/" << oid << " " << offset << "~"
+	   << len << dendl;
+
+  FDRef fd;
+  int r = lfn_open(cid, oid, false, &fd);
+  if (r < 0) {
+    dout(10) << "sparse_read couldn't open " << cid << "/" << oid << ": "
+	     << cpp_strerror(r) << dendl;
+    return r;
+  }
+
+  struct stat st;
+  r = ::fstat(**fd, &st);
+  if (r < 0) {
+    r = -errno;
+    lfn_close(fd);
+    return r;
+  }
+  uint64_t end = MIN(offset + len, (uint64_t)st.st_size);
+
+  // the extents, clipped to the object size
+  map<uint64_t, uint64_t> exomap;
+  if (offset < end) {
+    if (end - offset <= (uint64_t)m_filestore_fiemap_threshold) {
+      exomap[offset] = end - offset;
+    } else if (backend->has_seek_data_hole()) {
+      r = _do_seek_hole_data(**fd, offset, end - offset, &exomap);
+    } else if (backend->has_fiemap()) {
+      r = _do_fiemap(**fd, offset, end - offset, &exomap);
+    } else {
+      exomap[offset] = end - offset;
+    }
+  }
+  if (r < 0) {
+    lfn_close(fd);
+    assert(!m_filestore_fail_eio || r != -EIO);
+    return r;
+  }
+  uint64_t total = 0;
+  for (map<uint64_t, uint64_t>::iterator p = exomap.begin();
+       p != exomap.end();
+       ) {
+    if (p->first >= end) {
+      exomap.erase(p++);
+      continue;
+    }
+    if (p->first + p->second > end)
+      p->second = end - p->first;
+    total += p->second;
+    ++p;
+  }
+
+#ifdef HAVE_POSIX_FADVISE
+  if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_RANDOM)
+    posix_fadvise(**fd, offset, len, POSIX_FADV_RANDOM);
+  if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL)
+    posix_fadvise(**fd, offset, len, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  // one buffer for all the extents
+  bufferptr bptr(total);
+  uint64_t got = 0;
+  m.clear();
+  for (map<uint64_t, uint64_t>::iterator p = exomap.begin();
+       p != exomap.end();
+       ++p) {
+    r = safe_pread(**fd, bptr.c_str() + got, p->second, p->first);
+    if (r < 0) {
+      dout(10) << "sparse_read " << cid << "/" << oid << " pread error: "
+	       << cpp_strerror(r) << dendl;
+      lfn_close(fd);
+      assert(allow_eio || !m_filestore_fail_eio || r != -EIO);
+      return r;
+    }
+    if (r == 0)
+      break;
+    m[p->first] = r;
+    got += r;
+    if ((uint64_t)r < p->second)
+      break;  // truncated under us
+  }
+  bptr.set_length(got);
+  bl.push_back(bptr);
+
+#ifdef HAVE_POSIX_FADVISE
+  if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_DONTNEED)
+    posix_fadvise(**fd, offset, len, POSIX_FADV_DONTNEED);
+  if (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_RANDOM | CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL))
+    posix_fadvise(**fd, offset, len, POSIX_FADV_NORMAL);
+#endif
+
+  if (m_filestore_sloppy_crc && (!replaying || backend->can_checkpoint())) {
+    uint64_t pos = bl.length() - got;
+    for (map<uint64_t, uint64_t>::iterator p = m.begin(); p != m.end(); ++p) {
+      bufferlist t;
+      t.substr_of(bl, pos, p->second);
+      pos += p->second;
+      ostringstream ss;
+      int errors = backend->_crc_verify_read(**fd, p->first, p->second, t, &ss);
+      if (errors > 0) {
+	derr << "FileStore::sparse_read " << cid << "/" << oid << " "
+	     << p->first << "~" << p->second << " ... BAD CRC:\n"
+	     << ss.str() << dendl;
+	lfn_close(fd);
+	assert(allow_eio || !m_filestore_fail_eio);
+	return -EIO;
+      }
+    }
+  }
+
+  lfn_close(fd);
+
+  dout(10) << "sparse_read " << cid << "/" << oid << " " << offset << "~"
+	   << len << " = " << got << " in " << m.size() << " extents" << dendl;
+  if (g_conf->filestore_debug_inject_read_err &&
+      debug_data_eio(oid))
+    return -EIO;
+  return got;
+}
+
 
 int FileStore::_remove(coll_t cid, const ghobject_t& oid,
 		       const SequencerPosition &spos) 
@@ -3170,12 +3474,27 @@ int FileStore::_touch(coll_t cid, const ghobject_t& oid)
 
 int FileStore::_write(coll_t cid, const ghobject_t& oid,
                      uint64_t offset, size_t len,
-                     const bufferlist& bl, uint32_t fadvise_flags)
+                     const bufferlist& bl, uint32_t fadvise_flags,
+		     unsigned *syscalls)
+{
+  list<write_extent_t> extents;
+  bufferlist b(bl);
+  extents.push_back(write_extent_t(offset, len, b));
+  unsigned n = 0;
+  int r = _write_extents(cid, oid, extents, fadvise_flags, &n);
+  if (syscalls)
+    *syscalls += n;
+  return r;
+}
+
+int FileStore::_write_extents(coll_t cid, const ghobject_t& oid,
+			      list<write_extent_t>& extents,
+			      uint32_t fadvise_flags, unsigned *syscalls)
 {
-  dout(15) << "write " << cid << "/" << oid << " " << offset << "~" << len << dendl;
+  dout(15) << "write " << cid << "/" << oid << " " << extents.size()
+	   << " extents" << dendl;
   int r;
-
-  int64_t actual;
+  uint64_t total = 0;
 
   FDRef fd;
   r = lfn_open(cid, oid, true, &fd);
@@ -3185,41 +3504,41 @@ int FileStore::_write(coll_t cid, const ghobject_t& oid,
 	    << cpp_strerror(r) << dendl;
     goto out;
   }
-    
-  // seek
-  actual = ::lseek64(**fd, offset, SEEK_SET);
-  if (actual < 0) {
-    r = -errno;
-    dout(0) << "write lseek64 to " << offset << " failed: " << cpp_strerror(r) << dendl;
-    lfn_close(fd);
-    goto out;
-  }
-  if (actual != (int64_t)offset) {
-    dout(0) << "write lseek64 to " << offset << " gave bad offset " << actual << dendl;
-    r = -EIO;
-    lfn_close(fd);
-    goto out;
-  }
 
-  // write
-  r = bl.write_fd(**fd);
-  if (r == 0)
-    r = bl.length();
+  for (list<write_extent_t>::iterator p = extents.begin();
+       p != extents.end();
+       ++p) {
+    dout(15) << "write " << cid << "/" << oid << " " << p->offset << "~"
+	     << p->len << dendl;
+    // write
+    r = p->bl.write_fd(**fd, p->offset);
+    ++*syscalls;
+    if (r < 0) {
+      dout(0) << "write " << p->offset << "~" << p->len << " failed: "
+	      << cpp_strerror(r) << dendl;
+      break;
+    }
+    total += p->bl.length();
 
-  if (r >= 0 && m_filestore_sloppy_crc) {
-    int rc = backend->_crc_update_write(**fd, offset, len, bl);
-    assert(rc >= 0);
-  }
+    if (m_filestore_sloppy_crc) {
+      int rc = backend->_crc_update_write(**fd, p->offset, p->len, p->bl);
+      assert(rc >= 0);
+    }
 
-  // flush?
-  if (!replaying &&
-      g_conf->filestore_wbthrottle_enable)
-    wbthrottle.queue_wb(fd, oid, offset, len,
+    // flush?
+    if (!replaying &&
+	g_conf->filestore_wbthrottle_enable)
+      wbthrottle.queue_wb(fd, oid, p->offset, p->len,
 			  fadvise_flags & CEPH_OSD_OP_FLAG_FADVISE_DONTNEED);
+  }
+  if (r >= 0)
+    r = total;
+  _mark_dirty(oid, fd, false);
   lfn_close(fd);
 
  out:
-  dout(10) << "write " << cid << "/" << oid << " " << offset << "~" << len << " = " << r << dendl;
+  dout(10) << "write " << cid << "/" << oid << " " << extents.size()
+	   << " extents, " << total << " bytes = " << r << dendl;
   return r;
 }
 
@@ -3241,6 +3560,8 @@ int FileStore::_zero(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t
   ret = fallocate(**fd, FALLOC_FL_PUNCH_HOLE, offset, len);
   if (ret < 0)
     ret = -errno;
+  else
+    _mark_dirty(oid, fd, false);
   lfn_close(fd);
 
   if (ret >= 0 && m_filestore_sloppy_crc) {
@@ -3335,6 +3656,9 @@ int FileStore::_clone(coll_t cid, const ghobject_t& oldoid, const ghobject_t& ne
       goto out3;
   }
 
+  // lfn_open only marks the target dirty when it creates it
+  _mark_dirty(newoid, n, true);
+
   // clone is non-idempotent; record our work.
   _set_replay_guard(**n, spos, &newoid);
 
@@ -3551,6 +3875,8 @@ int FileStore::_clone_range(coll_t cid, const ghobject_t& oldoid, const ghobject
     r = -errno;
     goto out3;
   }
+  // the target may have existed already, so lfn_open did not mark it
+  _mark_dirty(newoid, n, true);
 
   // clone is non-idempotent; record our work.
   _set_replay_guard(**n, spos, &newoid);
@@ -3585,6 +3911,199 @@ private:
   int m_commit_timeo;
 };
 
+void FileStore::split_entry()
+{
+  Mutex::Locker l(split_lock);
+  while (!split_stop) {
+    vector<CollectionIndex*> ls;
+    index_manager.get_pending_splits(&ls);
+    for (vector<CollectionIndex*>::iterator p = ls.begin();
+	 p != ls.end() && !split_stop;
+	 ++p) {
+      split_lock.Unlock();
+      uint64_t m = 0;
+      utime_t start = ceph_clock_now(g_ceph_context);
+      int r;
+      {
+	RWLock::WLocker wl((*p)->access_lock);
+	r = (*p)->split_pending(&m);
+      }
+      utime_t lat = ceph_clock_now(g_ceph_context) - start;
+      if (r < 0) {
+	derr << __func__ << " split in " << (*p)->coll() << " failed: "
+	     << cpp_strerror(r) << dendl;
+	assert(!m_filestore_fail_eio || r != -EIO);
+      }
+      if (m) {
+	dout(10) << __func__ << " split in " << (*p)->coll() << " moved "
+		 << m << " objects in " << lat << dendl;
+	logger->inc(l_os_index_split);
+	logger->inc(l_os_index_split_objs, m);
+	logger->tinc(l_os_index_split_lat, lat);
+      }
+      split_lock.Lock();
+
+      // throttle: account for the moved objects before the next split
+      int rate = g_conf->filestore_split_background_rate;
+      if (m && rate > 0 && !split_stop) {
+	utime_t pause;
+	pause.set_from_double((double)m / rate);
+	split_cond.WaitInterval(g_ceph_context, split_lock, pause);
+      }
+    }
+    if (split_stop)
+      break;
+    if (ls.empty()) {
+      utime_t interval;
+      interval.set_from_double(g_conf->filestore_split_background_interval);
+      split_cond.WaitInterval(g_ceph_context, split_lock, interval);
+    }
+  }
+}
+
+void FileStore::_mark_dirty(const ghobject_t& oid, const FDRef& fd, bool meta)
+{
+  if (!m_filestore_sync_dirty_only)
+    return;
+  Mutex::Locker l(dirty_lock);
+  if (dirty_all)
+    return;
+  dirty_fd_t &d = dirty_fds[oid];
+  d.fd = fd;
+  d.meta = d.meta || meta;
+  if (dirty_fds.size() + dirty_dirs.size() >
+      (unsigned)g_conf->filestore_sync_dirty_max) {
+    dout(10) << __func__ << " " << dirty_fds.size() << " files dirty, "
+	     << "next commit will syncfs" << dendl;
+    dirty_fds.clear();
+    dirty_dirs.clear();
+    dirty_all = true;
+  }
+}
+
+bool FileStore::_is_dirty(const ghobject_t& oid)
+{
+  Mutex::Locker l(dirty_lock);
+  return dirty_fds.count(oid);
+}
+
+void FileStore::_mark_dirty_dir(const char *path)
+{
+  if (!m_filestore_sync_dirty_only)
+    return;
+  const char *end = strrchr(path, '/');
+  if (!end)
+    return;
+  Mutex::Locker l(dirty_lock);
+  if (dirty_all)
+    return;
+  dirty_dirs.insert(string(path, end - path));
+}
+
+void FileStore::_mark_dirty_all()
+{
+  if (!m_filestore_sync_dirty_only)
+    return;
+  Mutex::Locker l(dirty_lock);
+  dirty_fds.clear();
+  dirty_dirs.clear();
+  dirty_all = true;
+}
+
+bool FileStore::_take_dirty(vector<dirty_fd_t> *fds, vector<string> *dirs)
+{
+  Mutex::Locker l(dirty_lock);
+  uint64_t layout = LFNIndex::layout_changes.read();
+  bool all = dirty_all || layout != dirty_layout_seen;
+  if (!all) {
+    fds->reserve(dirty_fds.size());
+    for (ceph::unordered_map<ghobject_t, dirty_fd_t>::iterator p =
+	   dirty_fds.begin();
+	 p != dirty_fds.end();
+	 ++p)
+      fds->push_back(p->second);
+    dirs->assign(dirty_dirs.begin(), dirty_dirs.end());
+  }
+  dirty_fds.clear();
+  dirty_dirs.clear();
+  dirty_all = false;
+  dirty_layout_seen = layout;
+  return !all;
+}
+
+/// fsyncs every step'th file and directory of a commit
+struct SyncDirtyThread : public Thread {
+  const vector<pair<int, bool> > &fds;  ///< (fd, metadata changed)
+  const vector<string> &dirs;
+  unsigned first, step;
+  int r;
+  SyncDirtyThread(const vector<pair<int, bool> > &f, const vector<string> &d,
+		  unsigned first, unsigned step)
+    : fds(f), dirs(d), first(first), step(step), r(0) {}
+  void *entry() {
+    for (unsigned i = first; i < fds.size() + dirs.size(); i += step) {
+      int err;
+      if (i < fds.size()) {
+#ifdef HAVE_FDATASYNC
+	if (!fds[i].second)
+	  err = ::fdatasync(fds[i].first);
+	else
+#endif
+	  err = ::fsync(fds[i].first);
+      } else {
+	int fd = ::open(dirs[i - fds.size()].c_str(), O_RDONLY);
+	if (fd < 0) {
+	  if (errno == ENOENT)
+	    continue;  // removed since; its parent is dirty too
+	  err = fd;
+	} else {
+	  err = ::fsync(fd);
+	  VOID_TEMP_FAILURE_RETRY(::close(fd));
+	}
+      }
+      if (err < 0 && r == 0)
+	r = -errno;
+    }
+    return 0;
+  }
+};
+
+int FileStore::_sync_dirty(vector<dirty_fd_t> &dfds, vector<string> &dirs)
+{
+  vector<pair<int, bool> > fds;
+  fds.reserve(dfds.size());
+  for (vector<dirty_fd_t>::iterator p = dfds.begin(); p != dfds.end(); ++p)
+    fds.push_back(make_pair(**p->fd, p->meta));
+
+  unsigned jobs = fds.size() + dirs.size();
+  unsigned nthreads = MAX(g_conf->filestore_sync_dirty_threads, 1);
+  // not worth a thread for a handful of fsyncs
+  nthreads = MIN(nthreads, jobs / 16 + 1);
+  dout(15) << __func__ << " " << fds.size() << " files, " << dirs.size()
+	   << " dirs with " << nthreads << " threads" << dendl;
+
+  if (nthreads == 1) {
+    SyncDirtyThread t(fds, dirs, 0, 1);
+    t.entry();
+    return t.r;
+  }
+  vector<SyncDirtyThread*> threads;
+  for (unsigned i = 0; i < nthreads; ++i) {
+    threads.push_back(new SyncDirtyThread(fds, dirs, i, nthreads));
+    threads.back()->create();
+  }
+  int r = 0;
+  for (vector<SyncDirtyThread*>::iterator p = threads.begin();
+       p != threads.end();
+       ++p) {
+    (*p)->join();
+    if ((*p)->r < 0 && r == 0)
+      r = (*p)->r;
+    delete *p;
+  }
+  return r;
+}
+
 void FileStore::sync_entry()
 {
   lock.Lock();
@@ -3676,14 +4195,32 @@ void FileStore::sync_entry()
 	}
       } else
       {
+	// everything up to cp is applied and nothing else is running yet
+	vector<dirty_fd_t> sync_fds;
+	vector<string> sync_dirs;
+	bool dirty_only = m_filestore_sync_dirty_only &&
+	  _take_dirty(&sync_fds, &sync_dirs);
+
 	apply_manager.commit_started();
 	op_tp.unpause();
 
 	object_map->sync();
-	int err = backend->syncfs();
-	if (err < 0) {
-	  derr << "syncfs got " << cpp_strerror(err) << dendl;
-	  assert(0 == "syncfs returned error");
+	int err;
+	if (dirty_only) {
+	  err = _sync_dirty(sync_fds, sync_dirs);
+	  if (err < 0) {
+	    derr << "fsync of dirty files got " << cpp_strerror(err) << dendl;
+	    assert(0 == "fsync of dirty files returned error");
+	  }
+	  logger->inc(l_os_commit_dirty_files,
+		      sync_fds.size() + sync_dirs.size());
+	} else {
+	  err = backend->syncfs();
+	  if (err < 0) {
+	    derr << "syncfs got " << cpp_strerror(err) << dendl;
+	    assert(0 == "syncfs returned error");
+	  }
+	  logger->inc(l_os_commit_syncfs);
 	}
 
 	err = write_op_seq(op_fd, cp);
@@ -4230,6 +4767,7 @@ int FileStore::_setattrs(coll_t cid, const ghobject_t& oid, map<string,bufferptr
     }
   }
  out_close:
+  _mark_dirty(oid, fd, true);
   lfn_close(fd);
  out:
   dout(10) << "setattrs " << cid << "/" << oid << " = " << r << dendl;
@@ -4276,6 +4814,7 @@ int FileStore::_rmattr(coll_t cid, const ghobject_t& oid, const char *name,
     }
   }
  out_close:
+  _mark_dirty(oid, fd, true);
   lfn_close(fd);
  out:
   dout(10) << "rmattr " << cid << "/" << oid << " '" << name << "' = " << r << dendl;
@@ -4344,6 +4883,7 @@ int FileStore::_rmattrs(coll_t cid, const ghobject_t& oid,
   }
 
  out_close:
+  _mark_dirty(oid, fd, true);
   lfn_close(fd);
  out:
   dout(10) << "rmattrs " << cid << "/" << oid << " = " << r << dendl;
@@ -4422,6 +4962,7 @@ int FileStore::collection_getattrs(coll_t cid, map<string,bufferptr>& aset)
 int FileStore::_collection_setattr(coll_t c, const char *name,
 				  const void *value, size_t size)
 {
+  _mark_dirty_all();
   char fn[PATH_MAX];
   get_cdir(c, fn, sizeof(fn));
   dout(10) << "collection_setattr " << fn << " '" << name << "' len " << size << dendl;
@@ -4442,6 +4983,7 @@ int FileStore::_collection_setattr(coll_t c, const char *name,
 
 int FileStore::_collection_rmattr(coll_t c, const char *name)
 {
+  _mark_dirty_all();
   char fn[PATH_MAX];
   get_cdir(c, fn, sizeof(fn));
   dout(15) << "collection_rmattr " << fn << dendl;
@@ -4463,6 +5005,7 @@ int FileStore::_collection_rmattr(coll_t c, const char *name)
 
 int FileStore::_collection_setattrs(coll_t cid, map<string,bufferptr>& aset)
 {
+  _mark_dirty_all();
   char fn[PATH_MAX];
   get_cdir(cid, fn, sizeof(fn));
   dout(15) << "collection_setattrs " << fn << dendl;
@@ -4913,6 +5456,7 @@ int FileStore::_collection_hint_expected_num_objs(coll_t c, uint32_t pg_num,
     uint64_t expected_num_objs,
     const SequencerPosition &spos)
 {
+  _mark_dirty_all();
   dout(15) << __func__ << " collection: " << c << " pg number: "
      << pg_num << " expected number of objects: " << expected_num_objs << dendl;
 
@@ -4941,6 +5485,7 @@ int FileStore::_create_collection(
   coll_t c,
   const SequencerPosition &spos)
 {
+  _mark_dirty_all();
   char fn[PATH_MAX];
   get_cdir(c, fn, sizeof(fn));
   dout(15) << "create_collection " << fn << dendl;
@@ -4971,6 +5516,7 @@ int FileStore::_create_collection(
 
 int FileStore::_destroy_collection(coll_t c) 
 {
+  _mark_dirty_all();
   int r = 0;
   char fn[PATH_MAX];
   get_cdir(c, fn, sizeof(fn));
@@ -5230,17 +5776,21 @@ int FileStore::_omap_rmkeyrange(coll_t cid, const ghobject_t &hoid,
 				const string& first, const string& last,
 				const SequencerPosition &spos) {
   dout(15) << __func__ << " " << cid << "/" << hoid << " [" << first << "," << last << "]" << dendl;
-  set<string> keys;
+  Index index;
+  int r = get_index(cid, &index);
+  if (r < 0)
+    return r;
   {
-    ObjectMap::ObjectMapIterator iter = get_omap_iterator(cid, hoid);
-    if (!iter)
-      return -ENOENT;
-    for (iter->lower_bound(first); iter->valid() && iter->key() < last;
-	 iter->next()) {
-      keys.insert(iter->key());
-    }
+    assert(NULL != index.index);
+    RWLock::RLocker l((index.index)->access_lock);
+    r = lfn_find(hoid, index);
+    if (r < 0)
+      return r;
   }
-  return _omap_rmkeys(cid, hoid, keys, spos);
+  r = object_map->rm_key_range(hoid, first, last, &spos);
+  if (r < 0 && r != -ENOENT)
+    return r;
+  return 0;
 }
 
 int FileStore::_omap_setheader(coll_t cid, const ghobject_t &hoid,
@@ -5268,6 +5818,7 @@ int FileStore::_split_collection(coll_t cid,
 				 coll_t dest,
 				 const SequencerPosition &spos)
 {
+  _mark_dirty_all();
   int r;
   {
     dout(15) << __func__ << " " << cid << " bits: " << bits << dendl;
@@ -183,6 +183,46 @@ private:
     }
   } sync_thread;
 
+  // background directory splits
+  Mutex split_lock;
+  Cond split_cond;
+  bool split_stop;
+  void split_entry();
+  struct SplitThread : public Thread {
+    FileStore *fs;
+    SplitThread(FileStore *f) : fs(f) {}
+    void *entry() {
+      fs->split_entry();
+      return 0;
+    }
+  } split_thread;
+
+  /**
+   * Changes applied since the last commit, for filestore_sync_dirty_only:
+   * the commit then fsyncs just these files and directories instead of
+   * calling syncfs.  Anything not tracked here (collection operations,
+   * index splits and merges) sets dirty_all and the next commit falls
+   * back to syncfs.
+   */
+  struct dirty_fd_t {
+    FDRef fd;
+    bool meta;           ///< xattrs changed too: fsync, not fdatasync
+    dirty_fd_t() : meta(false) {}
+  };
+  Mutex dirty_lock;
+  ceph::unordered_map<ghobject_t, dirty_fd_t> dirty_fds;
+  set<string> dirty_dirs;
+  bool dirty_all;
+  uint64_t dirty_layout_seen;  ///< LFNIndex::layout_changes at the last commit
+
+  void _mark_dirty(const ghobject_t& oid, const FDRef& fd, bool meta);
+  /// the directory holding path gained or lost an entry
+  void _mark_dirty_dir(const char *path);
+  void _mark_dirty_all();
+  /// grab what the commit must sync; @return false to use syncfs instead
+  bool _take_dirty(vector<dirty_fd_t> *fds, vector<string> *dirs);
+  int _sync_dirty(vector<dirty_fd_t> &fds, vector<string> &dirs);
+
   // -- op workqueue --
   struct Op {
     utime_t start;
@@ -372,6 +412,59 @@ private:
     }
   } op_wq;
 
+  // reads queued by read_async(), served by read_tp
+  struct ReadOp {
+    coll_t cid;
+    ghobject_t oid;
+    uint64_t offset;
+    size_t len;
+    bufferlist *bl;
+    uint32_t op_flags;
+    Context *onfinish;
+    ReadOp(coll_t c, const ghobject_t& o, uint64_t off, size_t l,
+	   bufferlist *b, uint32_t f, Context *fin)
+      : cid(c), oid(o), offset(off), len(l), bl(b), op_flags(f),
+	onfinish(fin) {}
+  };
+  deque<ReadOp*> read_queue;
+  ThreadPool read_tp;
+  struct ReadWQ : public ThreadPool::WorkQueue<ReadOp> {
+    FileStore *store;
+    ReadWQ(FileStore *fs, time_t timeout, time_t suicide_timeout,
+	   ThreadPool *tp)
+      : ThreadPool::WorkQueue<ReadOp>("FileStore::ReadWQ", timeout,
+				      suicide_timeout, tp),
+	store(fs) {}
+
+    bool _enqueue(ReadOp *o) {
+      store->read_queue.push_back(o);
+      return true;
+    }
+    void _dequeue(ReadOp *o) {
+      assert(0);
+    }
+    bool _empty() {
+      return store->read_queue.empty();
+    }
+    ReadOp *_dequeue() {
+      if (store->read_queue.empty())
+	return NULL;
+      ReadOp *o = store->read_queue.front();
+      store->read_queue.pop_front();
+      return o;
+    }
+    void _process(ReadOp *o, ThreadPool::TPHandle &handle) {
+      int r = store->read(o->cid, o->oid, o->offset, o->len, *o->bl,
+			  o->op_flags);
+      o->onfinish->complete(r);
+      delete o;
+    }
+    using ThreadPool::WorkQueue<ReadOp>::_process;
+    void _clear() {
+      assert(store->read_queue.empty());
+    }
+  } read_wq;
+
   void _do_op(OpSequencer *o, ThreadPool::TPHandle &handle);
   void _finish_op(OpSequencer *o);
   Op *build_op(list<Transaction*>& tls,
@@ -412,6 +505,8 @@ public:
 
   int _detect_fs();
   int _sanity_check_fs();
+  /// the next commit fsyncs oid (filestore_sync_dirty_only)
+  bool _is_dirty(const ghobject_t& oid);
   
   bool test_mount_in_use();
   int read_op_seq(uint64_t *seq);
@@ -465,6 +560,19 @@ public:
   }
 
   void collect_metadata(map<string,string> *pm);
+  void dump_index_stats(Formatter *f) {
+    index_manager.dump_stats(f);
+  }
+  void dump_kv_stats(Formatter *f) {
+    if (object_map)
+      object_map->dump_kv_stats(f);
+  }
+  int compact_kv(const string& prefix,
+		 const string& start, const string& end) {
+    if (!object_map)
+      return -EOPNOTSUPP;
+    return object_map->compact_kv(prefix, start, end);
+  }
 
   int statfs(struct statfs *buf);
 
@@ -545,15 +653,62 @@ public:
     bufferlist& bl,
     uint32_t op_flags = 0,
     bool allow_eio = false);
+  int read_into(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferptr& bp,
+    uint32_t op_flags = 0,
+    bool allow_eio = false);
+  void readahead(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len);
+  void read_async(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferlist *bl,
+    uint32_t op_flags,
+    Context *onfinish);
+  int _read(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferlist& bl,
+    bufferptr *dst,
+    uint32_t op_flags,
+    bool allow_eio);
   int _do_fiemap(int fd, uint64_t offset, size_t len,
                  map<uint64_t, uint64_t> *m);
   int _do_seek_hole_data(int fd, uint64_t offset, size_t len,
                          map<uint64_t, uint64_t> *m);
   int fiemap(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len, bufferlist& bl);
+  int sparse_read(coll_t cid, const ghobject_t& oid, uint64_t offset,
+		  size_t len, map<uint64_t, uint64_t>& m, bufferlist& bl,
+		  uint32_t op_flags = 0, bool allow_eio = false);
 
   int _touch(coll_t cid, const ghobject_t& oid);
   int _write(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len,
-	      const bufferlist& bl, uint32_t fadvise_flags = 0);
+	      const bufferlist& bl, uint32_t fadvise_flags = 0,
+	      unsigned *syscalls = NULL);
+  struct write_extent_t {
+    uint64_t offset;
+    uint64_t len;
+    bufferlist bl;
+    write_extent_t(uint64_t o, uint64_t l, bufferlist& b)
+      : offset(o), len(l) {
+      bl.claim(b);
+    }
+  };
+  /// write each extent with one positioned writev, sharing one FDRef
+  int _write_extents(coll_t cid, const ghobject_t& oid,
+		     list<write_extent_t>& extents, uint32_t fadvise_flags,
+		     unsigned *syscalls);
   int _zero(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len);
   int _truncate(coll_t cid, const ghobject_t& oid, uint64_t size);
   int _clone(coll_t cid, const ghobject_t& oldoid, const ghobject_t& newoid,
@@ -722,6 +877,7 @@ private:
   JSONFormatter m_filestore_dump_fmt;
   atomic_t m_filestore_kill_at;
   bool m_filestore_sloppy_crc;
+  bool m_filestore_sync_dirty_only;
   int m_filestore_sloppy_crc_block_size;
   uint64_t m_filestore_max_alloc_hint_size;
   long m_fs_type;
@@ -324,6 +324,12 @@ int HashIndex::_created(const vector<string> &path,
     return r;
 
   if (must_split(info)) {
+    if (g_conf->filestore_split_background &&
+	info.objs <= split_threshold() * BACKGROUND_SPLIT_BACKSTOP) {
+      Mutex::Locker l(pending_lock);
+      pending_splits.insert(path);
+      return 0;
+    }
     int r = initiate_split(path, info);
     if (r < 0)
       return r;
@@ -333,6 +339,40 @@ int HashIndex::_created(const vector<string> &path,
   }
 }
 
+unsigned HashIndex::num_pending_splits() {
+  Mutex::Locker l(pending_lock);
+  return pending_splits.size();
+}
+
+int HashIndex::split_pending(uint64_t *moved) {
+  vector<string> path;
+  {
+    Mutex::Locker l(pending_lock);
+    if (pending_splits.empty())
+      return 0;
+    path = *pending_splits.begin();
+    pending_splits.erase(pending_splits.begin());
+  }
+  WRAP_RETRY(
+  // the directory may have been split, merged or moved away since
+  int exists;
+  r = path_exists(path, &exists);
+  if (r < 0 || !exists)
+    goto out;
+  subdir_info_s info;
+  r = get_info(path, &info);
+  if (r < 0 || !must_split(info))
+    goto out;
+  dout(10) << __func__ << " " << path << " has " << info.objs << " objects"
+	   << dendl;
+  *moved += info.objs;
+  r = initiate_split(path, info);
+  if (r < 0)
+    goto out;
+  r = complete_split(path, info);
+  );
+}
+
 int HashIndex::_remove(const vector<string> &path,
 		       const ghobject_t &oid,
 		       const string &mangled_name) {
@@ -634,7 +674,7 @@ bool HashIndex::must_merge(const subdir_info_s &info) {
 
 bool HashIndex::must_split(const subdir_info_s &info) {
   return (info.hash_level < (unsigned)MAX_HASH_LEVEL &&
-	  info.objs > ((unsigned)(abs(merge_threshold)) * 16 * split_multiplier));
+	  info.objs > split_threshold());
 			    
 }
 
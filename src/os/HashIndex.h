@@ -18,6 +18,7 @@
 #include "include/buffer.h"
 #include "include/encoding.h"
 #include "LFNIndex.h"
+#include "common/Mutex.h"
 
 extern string reverse_hexdigit_bits_string(string l);
 
@@ -46,6 +47,14 @@ extern string reverse_hexdigit_bits_string(string l);
  * Subdirectories are created when the number of objects in a directory
  * exceed (abs(merge_threshhold)) * 16 * split_multiplier.  The number of objects in a directory 
  * is encoded as subdir_info_s in an xattr on the directory.
+ *
+ * With filestore_split_background, _created only queues a directory
+ * that crossed the threshold, and FileStore's split thread does the
+ * split later through split_pending().  The queue is not persistent: a
+ * directory forgotten over a restart is queued again by its next
+ * create.  A directory BACKGROUND_SPLIT_BACKSTOP times over the
+ * threshold is still split inline, so it can't grow without bound if
+ * the background splits fall behind.
  */
 class HashIndex : public LFNIndex {
 private:
@@ -57,6 +66,8 @@ private:
   static const int PATH_HASH_LEN = 32;
   /// Max length of hashed path
   static const int MAX_HASH_LEVEL = (PATH_HASH_LEN/4);
+  /// Split inline past this many times the split threshold
+  static const unsigned BACKGROUND_SPLIT_BACKSTOP = 4;
 
   /**
    * Merges occur when the number of object drops below
@@ -67,6 +78,9 @@ private:
   int merge_threshold;
   int split_multiplier;
 
+  Mutex pending_lock;
+  set<vector<string> > pending_splits; ///< leaves waiting to be split
+
   /// Encodes current subdir state for determining when to split/merge.
   struct subdir_info_s {
     uint64_t objs;       ///< Objects in subdir.
@@ -142,7 +156,8 @@ public:
     double retry_probability=0) ///< [in] retry probability
     : LFNIndex(collection, base_path, index_version, retry_probability),
       merge_threshold(merge_at),
-      split_multiplier(split_multiple) {}
+      split_multiplier(split_multiple),
+      pending_lock("HashIndex::pending_lock") {}
 
   /// @see CollectionIndex
   uint32_t collection_version() { return index_version; }
@@ -160,6 +175,12 @@ public:
     CollectionIndex* dest
     );
 
+  /// @see CollectionIndex
+  unsigned num_pending_splits();
+
+  /// @see CollectionIndex
+  int split_pending(uint64_t *moved);
+
 protected:
   int _init();
 
@@ -235,6 +256,10 @@ private:
     const subdir_info_s &info ///< [in] Info to check
     ); /// @return True if info must be merged, False otherwise
 
+  unsigned split_threshold() const {
+    return (unsigned)(abs(merge_threshold)) * 16 * split_multiplier;
+  }
+
   /// Encapsulates logic for when to merge.
   bool must_split(
     const subdir_info_s &info ///< [in] Info to check
@@ -134,3 +134,29 @@ int IndexManager::get_index(coll_t c, const string& baseDir, Index *index) {
   }
   return 0;
 }
+
+void IndexManager::dump_stats(Formatter *f)
+{
+  Mutex::Locker l(lock);
+  f->open_array_section("collections");
+  for (ceph::unordered_map<coll_t, CollectionIndex* >::iterator it =
+	 col_indices.begin();
+       it != col_indices.end(); ++it) {
+    f->open_object_section("collection");
+    f->dump_stream("cid") << it->first;
+    it->second->dump_stats(f);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void IndexManager::get_pending_splits(vector<CollectionIndex*> *ls)
+{
+  Mutex::Locker l(lock);
+  for (ceph::unordered_map<coll_t, CollectionIndex* >::iterator it =
+	 col_indices.begin();
+       it != col_indices.end(); ++it) {
+    if (it->second->num_pending_splits())
+      ls->push_back(it->second);
+  }
+}
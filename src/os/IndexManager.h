@@ -91,6 +91,12 @@ public:
    * @return error code
    */
   int init_index(coll_t c, const char *path, uint32_t filestore_version);
+
+  /// dump the statistics of each open index
+  void dump_stats(Formatter *f);
+
+  /// get the open indexes that have splits queued
+  void get_pending_splits(vector<CollectionIndex*> *ls);
 };
 
 #endif
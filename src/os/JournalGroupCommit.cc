@@ -0,0 +1,142 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "JournalGroupCommit.h"
+
+#include <math.h>
+
+JournalGroupCommit::JournalGroupCommit()
+  : lock("JournalGroupCommit::lock"),
+    target(0), max_delay(0),
+    have_samples(false),
+    base_lat(0), lat_dev(0), per_byte(0),
+    last_arrival(0), arrival_gap(0),
+    window_commits(0), window_over(0),
+    factor(1.0)
+{
+}
+
+void JournalGroupCommit::set_target(double t, double d)
+{
+  Mutex::Locker l(lock);
+  target = t;
+  max_delay = d;
+}
+
+double JournalGroupCommit::get_hold(double oldest_age,
+				    uint64_t queued_bytes) const
+{
+  Mutex::Locker l(lock);
+  if (target <= 0 || max_delay <= 0 || !have_samples)
+    return 0;
+  double budget = target - oldest_age - _predict(queued_bytes) -
+    4 * lat_dev;
+  budget *= factor;
+  if (budget <= 0)
+    return 0;
+  // waiting only pays off if more work is likely to show up
+  if (arrival_gap <= 0 || arrival_gap > budget)
+    return 0;
+  return budget < max_delay ? budget : max_delay;
+}
+
+uint64_t JournalGroupCommit::get_max_bytes(uint64_t bmax) const
+{
+  Mutex::Locker l(lock);
+  if (target <= 0 || per_byte <= 0)
+    return bmax;
+  double room = target / 2 - base_lat;
+  uint64_t limit = room > 0 ? (uint64_t)(room / per_byte) : 0;
+  if (limit < MIN_WRITE)
+    limit = MIN_WRITE;
+  if (bmax && bmax < limit)
+    return bmax;
+  return limit;
+}
+
+void JournalGroupCommit::note_arrival(double now)
+{
+  Mutex::Locker l(lock);
+  if (last_arrival > 0 && now >= last_arrival) {
+    double gap = now - last_arrival;
+    if (arrival_gap <= 0)
+      arrival_gap = gap;
+    else
+      arrival_gap += (gap - arrival_gap) / 8;
+  }
+  last_arrival = now;
+}
+
+void JournalGroupCommit::note_write(uint64_t bytes, double lat)
+{
+  Mutex::Locker l(lock);
+  if (!have_samples) {
+    base_lat = lat;
+    lat_dev = lat / 2;
+    have_samples = true;
+    return;
+  }
+  double err = lat - _predict(bytes);
+  if (bytes <= SMALL_WRITE) {
+    base_lat += err / 8;
+    if (base_lat < 0)
+      base_lat = 0;
+  } else {
+    double excess = lat - base_lat;
+    if (excess > 0)
+      per_byte += (excess / bytes - per_byte) / 8;
+  }
+  lat_dev += (fabs(err) - lat_dev) / 4;
+}
+
+bool JournalGroupCommit::note_commit(double lat)
+{
+  Mutex::Locker l(lock);
+  if (target <= 0)
+    return false;
+  bool over = lat > target;
+  if (over)
+    ++window_over;
+  if (++window_commits >= WINDOW) {
+    // allow 1% of a window over the target
+    if (window_over * 100 > window_commits) {
+      factor /= 2;
+      if (factor < 1.0 / 16)
+	factor = 1.0 / 16;
+    } else if (window_over == 0) {
+      factor *= 1.25;
+      if (factor > 1.0)
+	factor = 1.0;
+    }
+    window_commits = 0;
+    window_over = 0;
+  }
+  return over;
+}
+
+double JournalGroupCommit::predict(uint64_t bytes) const
+{
+  Mutex::Locker l(lock);
+  return _predict(bytes);
+}
+
+double JournalGroupCommit::predict_tail(uint64_t bytes) const
+{
+  Mutex::Locker l(lock);
+  return _predict(bytes) + 4 * lat_dev;
+}
+
+double JournalGroupCommit::get_factor() const
+{
+  Mutex::Locker l(lock);
+  return factor;
+}
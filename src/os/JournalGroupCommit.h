@@ -0,0 +1,86 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_JOURNALGROUPCOMMIT_H
+#define CEPH_JOURNALGROUPCOMMIT_H
+
+#include <stdint.h>
+#include "common/Mutex.h"
+
+/**
+ * Latency targeted group commit for the journal writer.
+ *
+ * Learns the device write latency as base + per_byte * bytes (EWMAs of
+ * the completed journal writes, with a mean deviation like a TCP rtt
+ * estimator) and the gap between journal submissions.  From that it
+ * tells the writer
+ *
+ *  - how long it may keep gathering entries before writing, so that the
+ *    oldest queued entry still commits within the target, and only if
+ *    another entry is expected to arrive in that time;
+ *  - how many bytes a write may carry so it completes within half the
+ *    target, so heavy load doesn't build huge, slow batches.
+ *
+ * Every commit latency is checked against the target.  When more than
+ * 1% of a window of commits miss it, the hold budget is halved, and it
+ * recovers while the window stays clean.  All times are in seconds.
+ */
+class JournalGroupCommit {
+public:
+  static const unsigned WINDOW = 100;          ///< commits per p99 check
+  static const uint64_t SMALL_WRITE = 64 << 10; ///< feeds base latency
+  static const uint64_t MIN_WRITE = 64 << 10;   ///< floor of get_max_bytes
+
+  JournalGroupCommit();
+
+  /// target commit latency (0 disables the controller) and the hold cap
+  void set_target(double target, double max_delay);
+  bool enabled() const {
+    return target > 0;
+  }
+
+  /// seconds to keep gathering entries before writing; 0 to write now
+  double get_hold(double oldest_age, uint64_t queued_bytes) const;
+  /// cap for the size of the next write, given the configured cap bmax
+  uint64_t get_max_bytes(uint64_t bmax) const;
+
+  /// an entry was submitted at time now
+  void note_arrival(double now);
+  /// a journal write of bytes took lat
+  void note_write(uint64_t bytes, double lat);
+  /// an entry committed lat after it was submitted; true if over target
+  bool note_commit(double lat);
+
+  /// predicted latency of a write of bytes, 0 before the first sample
+  double predict(uint64_t bytes) const;
+  /// predict() plus the deviation margin, a rough p99
+  double predict_tail(uint64_t bytes) const;
+  double get_factor() const;
+
+private:
+  mutable Mutex lock;
+  double target, max_delay;
+  bool have_samples;
+  double base_lat;      ///< latency of a small write
+  double lat_dev;       ///< mean deviation of observed vs predicted
+  double per_byte;      ///< extra latency per byte of larger writes
+  double last_arrival;
+  double arrival_gap;   ///< mean time between submissions
+  unsigned window_commits, window_over;
+  double factor;        ///< scales the hold budget, in [1/16, 1]
+
+  double _predict(uint64_t bytes) const {
+    return base_lat + per_byte * bytes;
+  }
+};
+
+#endif
@@ -0,0 +1,112 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_OS_KVCOMPACTIONTRACKER_H
+#define CEPH_OS_KVCOMPACTIONTRACKER_H
+
+#include "include/int_types.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/Formatter.h"
+
+/**
+ * Keys deleted per prefix since the prefix was last compacted
+ *
+ * A deleted key leaves a tombstone that every iterator over the prefix
+ * steps over until a compaction drops it, so prefixes with heavy churn
+ * (omap of bucket indexes, pg logs) get slower to scan over time.  The
+ * stores add up what their committed transactions delete, and their
+ * compaction thread periodically picks the prefix with the most
+ * deletions once it is over a threshold and the store is idle.
+ *
+ * Omap keys have a prefix per object, so only the MAX_PREFIXES busiest
+ * prefixes are remembered: when there are more, those with the fewest
+ * deletions are forgotten until MAX_PREFIXES are left.
+ *
+ * Not locked: the stores use it under their compact_queue_lock.
+ */
+class KVCompactionTracker {
+  std::map<std::string, uint64_t> deleted;
+  uint64_t total;
+
+  typedef std::map<std::string, uint64_t>::iterator iterator;
+
+  static bool fewer_deleted(const iterator &a, const iterator &b) {
+    return a->second < b->second;
+  }
+
+  void trim() {
+    std::vector<iterator> v;
+    v.reserve(deleted.size());
+    for (iterator p = deleted.begin(); p != deleted.end(); ++p)
+      v.push_back(p);
+    size_t excess = deleted.size() - MAX_PREFIXES;
+    std::nth_element(v.begin(), v.begin() + excess, v.end(), fewer_deleted);
+    for (size_t i = 0; i < excess; ++i) {
+      total -= v[i]->second;
+      deleted.erase(v[i]);
+    }
+  }
+
+public:
+  static const unsigned MAX_PREFIXES = 1024;
+
+  KVCompactionTracker() : total(0) {}
+
+  void add(const std::map<std::string, uint64_t> &d) {
+    for (std::map<std::string, uint64_t>::const_iterator p = d.begin();
+	 p != d.end();
+	 ++p) {
+      deleted[p->first] += p->second;
+      total += p->second;
+    }
+    if (deleted.size() > MAX_PREFIXES)
+      trim();
+  }
+
+  /// the prefix has just been compacted
+  void clear(const std::string &prefix) {
+    std::map<std::string, uint64_t>::iterator p = deleted.find(prefix);
+    if (p != deleted.end()) {
+      total -= p->second;
+      deleted.erase(p);
+    }
+  }
+
+  /// the prefix with the most deletions, if it has at least min_deleted
+  bool pick(uint64_t min_deleted, std::string *prefix) const {
+    std::map<std::string, uint64_t>::const_iterator best = deleted.end();
+    for (std::map<std::string, uint64_t>::const_iterator p = deleted.begin();
+	 p != deleted.end();
+	 ++p)
+      if (best == deleted.end() || p->second > best->second)
+	best = p;
+    if (best == deleted.end() || best->second < min_deleted)
+      return false;
+    *prefix = best->first;
+    return true;
+  }
+
+  uint64_t get_total() const {
+    return total;
+  }
+
+  size_t size() const {
+    return deleted.size();
+  }
+
+  void dump(ceph::Formatter *f) const {
+    f->dump_unsigned("deleted_keys", total);
+    f->open_object_section("deleted_keys_by_prefix");
+    for (std::map<std::string, uint64_t>::const_iterator p = deleted.begin();
+	 p != deleted.end();
+	 ++p)
+      f->dump_unsigned(p->first.c_str(), p->second);
+    f->close_section();
+  }
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include "include/buffer.h"
 #include <set>
 #include <map>
+#include <vector>
 #include <string>
 #include "include/memory.h"
 #include <boost/scoped_ptr.hpp>
@@ -60,6 +61,13 @@ public:
       const string &prefix ///< [in] Prefix by which to remove keys
       ) = 0;
 
+    /// Removes keys in [start, end) under prefix
+    virtual void rm_range_keys(
+      const string &prefix,   ///< [in] Prefix of the keys
+      const string &start,    ///< [in] First key to remove
+      const string &end       ///< [in] Key to stop at (not removed)
+      ) = 0;
+
     virtual ~TransactionImpl() {}
   };
   typedef ceph::shared_ptr< TransactionImpl > Transaction;
@@ -80,6 +88,27 @@ public:
     return submit_transaction(t);
   }
 
+  /**
+   * Submit several transactions, applied in order
+   *
+   * Backends that can do so merge them into a single write so that
+   * the batch costs one log append (and, if sync, one flush) instead
+   * of one per transaction.
+   *
+   * @param tv transactions, in order
+   * @param sync whether the batch must be durable on return
+   */
+  virtual int submit_transactions(const vector<Transaction>& tv, bool sync) {
+    int r = 0;
+    for (unsigned i = 0; i < tv.size() && r == 0; ++i) {
+      if (sync && i + 1 == tv.size())
+	r = submit_transaction_sync(tv[i]);
+      else
+	r = submit_transaction(tv[i]);
+    }
+    return r;
+  }
+
   /// Retrieve Keys
   virtual int get(
     const string &prefix,        ///< [in] Prefix for key
@@ -179,7 +208,7 @@ public:
 
   Iterator get_iterator(const string &prefix) {
     return ceph::shared_ptr<IteratorImpl>(
-      new IteratorImpl(prefix, get_iterator())
+      new IteratorImpl(prefix, _get_prefix_iterator(prefix))
     );
   }
 
@@ -189,11 +218,14 @@ public:
 
   Iterator get_snapshot_iterator(const string &prefix) {
     return ceph::shared_ptr<IteratorImpl>(
-      new IteratorImpl(prefix, get_snapshot_iterator())
+      new IteratorImpl(prefix, _get_prefix_snapshot_iterator(prefix))
     );
   }
 
   virtual uint64_t get_estimated_size(map<string,uint64_t> &extra) = 0;
+
+  /// dump the engine's own statistics (cache, filters, compaction, ...)
+  virtual void get_statistics(Formatter *f) {}
   virtual int get_statfs(struct statfs *buf) {
     return -EOPNOTSUPP;
   }
@@ -211,10 +243,41 @@ public:
 			     const string& start, const string& end) {}
   virtual void compact_range_async(const string& prefix,
 				   const string& start, const string& end) {}
+  /// compact everything if prefix is empty, else prefix, or its [start, end)
+  void compact_keys(const string& prefix,
+		    const string& start, const string& end) {
+    if (prefix.empty())
+      compact();
+    else if (start.empty() && end.empty())
+      compact_prefix(prefix);
+    else
+      compact_range(prefix, start, end);
+  }
+
+  /**
+   * Keep keys whose prefix starts with one of the given names in a
+   * keyspace of their own, with its own tuning (e.g., rocksdb column
+   * families).  Must be called before open().
+   *
+   * @param spec whitespace separated "name[:options]" entries
+   * @returns 0, or -EOPNOTSUPP if the backend cannot do this
+   */
+  virtual int set_column_families(const string& spec) {
+    return spec.empty() ? 0 : -EOPNOTSUPP;
+  }
 
 protected:
   virtual WholeSpaceIterator _get_iterator() = 0;
   virtual WholeSpaceIterator _get_snapshot_iterator() = 0;
+
+  /// an iterator that covers at least the keys under prefix
+  virtual WholeSpaceIterator _get_prefix_iterator(const string &prefix) {
+    return _get_iterator();
+  }
+  virtual WholeSpaceIterator _get_prefix_snapshot_iterator(
+    const string &prefix) {
+    return _get_snapshot_iterator();
+  }
 };
 
 #endif
@@ -346,12 +346,17 @@ int KeyValueStore::BufferTransaction::get_buffer_keys(
           obj_it->second.find(make_pair(prefix, *it));
       if (i != obj_it->second.end()) {
         (*out)[*it].swap(i->second);
-      } else {
-        need_lookup.insert(*it);
+        continue;
+      }
+    }
+    if (prefix == OBJECT_STRIP_PREFIX && !invalidated.count(uid)) {
+      bufferlist bl;
+      if (store->strip_cache.lookup(uid, *it, &bl)) {
+        (*out)[*it].swap(bl);
+        continue;
       }
-    }else {
-      need_lookup.insert(*it);
     }
+    need_lookup.insert(*it);
   }
 
   if (!need_lookup.empty()) {
@@ -371,7 +376,15 @@ void KeyValueStore::BufferTransaction::set_buffer_keys(
      StripObjectMap::StripObjectHeaderRef strip_header,
      const string &prefix, map<string, bufferlist> &values)
 {
-  store->backend->set_keys(strip_header->header, prefix, values, t);
+  if (prefix == OBJECT_STRIP_PREFIX) {
+    // goes to the backend at submit, after any later writes to these strips
+    map<string, bufferlist> &dirty = dirty_strips[strip_header];
+    for (map<string, bufferlist>::iterator iter = values.begin();
+         iter != values.end(); ++iter)
+      dirty[iter->first] = iter->second;
+  } else {
+    store->backend->set_keys(strip_header->header, prefix, values, t);
+  }
 
   uniq_id uid = make_pair(strip_header->cid, strip_header->oid);
   map<pair<string, string>, bufferlist> &uid_buffers = buffers[uid];
@@ -385,6 +398,15 @@ int KeyValueStore::BufferTransaction::remove_buffer_keys(
      StripObjectMap::StripObjectHeaderRef strip_header, const string &prefix,
      const set<string> &keys)
 {
+  if (prefix == OBJECT_STRIP_PREFIX) {
+    map<StripObjectMap::StripObjectHeaderRef, map<string, bufferlist> >::iterator p =
+      dirty_strips.find(strip_header);
+    if (p != dirty_strips.end()) {
+      for (set<string>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter)
+        p->second.erase(*iter);
+    }
+  }
+
   uniq_id uid = make_pair(strip_header->cid, strip_header->oid);
   map< uniq_id, map<pair<string, string>, bufferlist> >::iterator obj_it = buffers.find(uid);
   set<string> buffered_keys;
@@ -424,6 +446,11 @@ int KeyValueStore::BufferTransaction::clear_buffer(
 {
   strip_header->deleted = true;
 
+  uniq_id uid = make_pair(strip_header->cid, strip_header->oid);
+  dirty_strips.erase(strip_header);
+  buffers.erase(uid);
+  invalidated.insert(uid);
+
   InvalidateCacheContext *c = new InvalidateCacheContext(store, strip_header->cid, strip_header->oid);
   finishes.push_back(c);
   return store->backend->clear(strip_header->header, t);
@@ -434,16 +461,32 @@ void KeyValueStore::BufferTransaction::clone_buffer(
     const coll_t &cid, const ghobject_t &oid)
 {
   // Remove target ahead to avoid dead lock
-  strip_headers.erase(make_pair(cid, oid));
+  uniq_id uid = make_pair(cid, oid);
+  StripHeaderMap::iterator p = strip_headers.find(uid);
+  if (p != strip_headers.end()) {
+    dirty_strips.erase(p->second);
+    strip_headers.erase(p);
+  }
 
   StripObjectMap::StripObjectHeaderRef new_target_header;
 
+  // the source's strips must be in place before it becomes the parent
+  flush_strips(old_header);
   store->backend->clone_wrap(old_header, cid, oid, t, &new_target_header);
 
   // FIXME: Lacking of lock for origin header(now become parent), it will
   // cause other operation can get the origin header while submitting
   // transactions
-  strip_headers[make_pair(cid, oid)] = new_target_header;
+  strip_headers[uid] = new_target_header;
+
+  // whatever the source has buffered, the clone now has too
+  map< uniq_id, map<pair<string, string>, bufferlist> >::iterator obj_it =
+    buffers.find(make_pair(old_header->cid, old_header->oid));
+  if (obj_it != buffers.end())
+    buffers[uid] = obj_it->second;
+  else
+    buffers.erase(uid);
+  invalidated.insert(uid);
 }
 
 void KeyValueStore::BufferTransaction::rename_buffer(
@@ -453,17 +496,48 @@ void KeyValueStore::BufferTransaction::rename_buffer(
   // FIXME: Lacking of lock for origin header, it will cause other operation
   // can get the origin header while submitting transactions
   StripObjectMap::StripObjectHeaderRef new_header;
+  flush_strips(old_header);
   store->backend->rename_wrap(old_header, cid, oid, t, &new_header);
 
+  // the data keys move along with the header
+  uniq_id old_uid = make_pair(old_header->cid, old_header->oid);
+  uniq_id uid = make_pair(cid, oid);
+  map< uniq_id, map<pair<string, string>, bufferlist> >::iterator obj_it =
+    buffers.find(old_uid);
+  if (obj_it != buffers.end()) {
+    buffers[uid].swap(obj_it->second);
+    buffers.erase(old_uid);
+  } else {
+    buffers.erase(uid);
+  }
+  invalidated.insert(old_uid);
+  invalidated.insert(uid);
+
   InvalidateCacheContext *c = new InvalidateCacheContext(store, old_header->cid, old_header->oid);
   finishes.push_back(c);
   strip_headers[make_pair(cid, oid)] = new_header;
 }
 
+void KeyValueStore::BufferTransaction::flush_strips(
+    StripObjectMap::StripObjectHeaderRef strip_header)
+{
+  map<StripObjectMap::StripObjectHeaderRef, map<string, bufferlist> >::iterator p =
+    dirty_strips.find(strip_header);
+  if (p == dirty_strips.end())
+    return;
+  if (!p->second.empty())
+    store->backend->set_keys(strip_header->header, OBJECT_STRIP_PREFIX,
+                             p->second, t);
+  dirty_strips.erase(p);
+}
+
 int KeyValueStore::BufferTransaction::submit_transaction()
 {
   int r = 0;
 
+  while (!dirty_strips.empty())
+    flush_strips(dirty_strips.begin()->first);
+
   for (StripHeaderMap::iterator header_iter = strip_headers.begin();
        header_iter != strip_headers.end(); ++header_iter) {
     StripObjectMap::StripObjectHeaderRef header = header_iter->second;
@@ -486,11 +560,115 @@ int KeyValueStore::BufferTransaction::submit_transaction()
     (*it)->complete(r);
   }
 
+  if (r == 0) {
+    // what is now on disk is what the next partial write will need
+    for (set<uniq_id, CollGhobjectPairBitwiseComparator>::iterator it = invalidated.begin();
+         it != invalidated.end(); ++it)
+      store->strip_cache.invalidate(*it);
+    for (map< uniq_id, map<pair<string, string>, bufferlist> >::iterator obj_it = buffers.begin();
+         obj_it != buffers.end(); ++obj_it) {
+      StripHeaderMap::iterator h = strip_headers.find(obj_it->first);
+      if (h == strip_headers.end() || h->second->deleted)
+        continue;
+      for (map<pair<string, string>, bufferlist>::iterator iter = obj_it->second.begin();
+           iter != obj_it->second.end(); ++iter) {
+        if (iter->first.first == OBJECT_STRIP_PREFIX)
+          store->strip_cache.update(obj_it->first, iter->first.second, iter->second);
+      }
+    }
+  }
+
 out:
   dout(5) << __func__ << " r = " << r << dendl;
   return r;
 }
 
+// ========= KeyValueStore::StripCache Implementation ============
+
+void KeyValueStore::StripCache::_erase(EntryMap::iterator p)
+{
+  bytes -= p->second.bytes;
+  lru.erase(p->second.lru_pos);
+  objects.erase(p);
+}
+
+void KeyValueStore::StripCache::_trim()
+{
+  while (bytes > max_bytes && !lru.empty()) {
+    EntryMap::iterator p = objects.find(lru.back());
+    assert(p != objects.end());
+    _erase(p);
+  }
+}
+
+void KeyValueStore::StripCache::set_max_bytes(uint64_t max)
+{
+  Mutex::Locker l(lock);
+  max_bytes = max;
+  _trim();
+}
+
+bool KeyValueStore::StripCache::lookup(const uniq_id &uid, const string &key,
+                                       bufferlist *out)
+{
+  Mutex::Locker l(lock);
+  EntryMap::iterator p = objects.find(uid);
+  if (p == objects.end())
+    return false;
+  map<string, bufferlist>::iterator s = p->second.strips.find(key);
+  if (s == p->second.strips.end())
+    return false;
+  // callers may modify the strip in place (e.g., _zero)
+  bufferptr bp(s->second.length());
+  s->second.copy(0, s->second.length(), bp.c_str());
+  out->push_back(bp);
+  lru.splice(lru.begin(), lru, p->second.lru_pos);
+  return true;
+}
+
+void KeyValueStore::StripCache::update(const uniq_id &uid, const string &key,
+                                       const bufferlist &bl)
+{
+  Mutex::Locker l(lock);
+  EntryMap::iterator p = objects.find(uid);
+  if (p == objects.end()) {
+    if (bl.length() == 0 || max_bytes == 0)
+      return;
+    p = objects.insert(make_pair(uid, Entry())).first;
+    lru.push_front(uid);
+    p->second.lru_pos = lru.begin();
+  } else {
+    lru.splice(lru.begin(), lru, p->second.lru_pos);
+  }
+
+  Entry &e = p->second;
+  map<string, bufferlist>::iterator s = e.strips.find(key);
+  if (s != e.strips.end()) {
+    e.bytes -= s->second.length();
+    bytes -= s->second.length();
+    e.strips.erase(s);
+  }
+  if (bl.length()) {
+    // a copy, so as not to pin the (possibly much larger) message buffer
+    bufferptr bp(bl.length());
+    bl.copy(0, bl.length(), bp.c_str());
+    e.strips[key].push_back(bp);
+    e.bytes += bl.length();
+    bytes += bl.length();
+  }
+  if (e.strips.empty())
+    _erase(p);
+  _trim();
+}
+
+void KeyValueStore::StripCache::invalidate(const uniq_id &uid)
+{
+  Mutex::Locker l(lock);
+  EntryMap::iterator p = objects.find(uid);
+  if (p != objects.end())
+    _erase(p);
+}
+
 // =========== KeyValueStore Intern Helper Implementation ==============
 
 ostream& operator<<(ostream& out, const KeyValueStore::OpSequencer& s)
@@ -534,6 +712,7 @@ KeyValueStore::KeyValueStore(const std::string &base,
   ondisk_finisher(g_ceph_context),
   collections_lock("KeyValueStore::collections_lock"),
   lock("KeyValueStore::lock"),
+  strip_cache(g_conf->keyvaluestore_strip_cache_size),
   throttle_ops(g_ceph_context, "keyvaluestore_ops", g_conf->keyvaluestore_queue_max_ops),
   throttle_bytes(g_ceph_context, "keyvaluestore_bytes", g_conf->keyvaluestore_queue_max_bytes),
   op_finisher(g_ceph_context),
@@ -949,9 +1128,17 @@ int KeyValueStore::mount()
 
     }
 
-    if (superblock.backend == "rocksdb")
+    if (superblock.backend == "rocksdb") {
       store->init(g_conf->keyvaluestore_rocksdb_options);
-    else
+      if (store->set_column_families(
+	    g_conf->keyvaluestore_rocksdb_column_families) < 0) {
+	derr << "KeyValueStore::mount error setting column families "
+	     << g_conf->keyvaluestore_rocksdb_column_families << dendl;
+	ret = -EINVAL;
+	delete store;
+	goto close_current_fd;
+      }
+    } else
       store->init();
     stringstream err;
     if (store->open(err)) {
@@ -1665,29 +1852,34 @@ int KeyValueStore::_generic_read(StripObjectMap::StripObjectHeaderRef header,
                                   extents);
   map<string, bufferlist> out;
   set<string> keys;
+  size_t hits = 0;
   pair<coll_t, ghobject_t> uid = make_pair(header->cid, header->oid);
+  bool use_cache = !bt || !bt->invalidated.count(uid);
+
+  map< pair<coll_t, ghobject_t>, map<pair<string, string>, bufferlist> >::iterator obj_it;
+  if (bt)
+    obj_it = bt->buffers.find(uid);
 
   for (vector<StripObjectMap::StripExtent>::iterator iter = extents.begin();
        iter != extents.end(); ++iter) {
-    bufferlist old;
+    if (!header->bits[iter->no])
+      continue;
     string key = strip_object_key(iter->no);
 
-    map< pair<coll_t, ghobject_t>, map<pair<string, string>, bufferlist> >::iterator obj_it;
-    if ( bt ){
-      obj_it = bt->buffers.find(uid);
-    }
-    if ( bt && obj_it != bt->buffers.end() && obj_it->second.count(make_pair(OBJECT_STRIP_PREFIX, key))) {
+    if (bt && obj_it != bt->buffers.end() && obj_it->second.count(make_pair(OBJECT_STRIP_PREFIX, key))) {
       // use strip_header buffer
-      assert(header->bits[iter->no]);
       out[key] = obj_it->second[make_pair(OBJECT_STRIP_PREFIX, key)];
-    }else if (header->bits[iter->no]) {
+      ++hits;
+    } else if (use_cache && strip_cache.lookup(uid, key, &out[key])) {
+      ++hits;
+    } else {
+      out.erase(key);
       keys.insert(key);
     }
   }
 
-
   int r = backend->get_values_with_header(header, OBJECT_STRIP_PREFIX, keys, &out);
-  r = check_get_rc(header->cid, header->oid, r, out.size() == keys.size());
+  r = check_get_rc(header->cid, header->oid, r, out.size() == keys.size() + hits);
   if (r < 0)
     return r;
 
@@ -2872,8 +3064,15 @@ int KeyValueStore::_set_alloc_hint(coll_t cid, const ghobject_t& oid,
   // Now only consider to change "strip_size" when the object is blank,
   // because set_alloc_hint is expected to be very lightweight<O(1)>
   if (blank) {
-    // header->strip_size = MIN(expected_write_size, m_keyvaluestore_max_expected_write_size);
-    // dout(20) << __func__ << " hint " << header->strip_size << " success" << dendl;
+    uint64_t strip_size = MIN(expected_write_size,
+                              m_keyvaluestore_max_expected_write_size);
+    if (strip_size > header->strip_size) {
+      header->strip_size = strip_size;
+      header->bits.resize(header->max_size/header->strip_size+1);
+      header->updated = true;
+      t.invalidated.insert(make_pair(cid, oid));
+      dout(20) << __func__ << " hint " << header->strip_size << " success" << dendl;
+    }
   }
 
   dout(10) << __func__ << "" << cid << "/" << oid << " object_size "
@@ -2889,6 +3088,8 @@ const char** KeyValueStore::get_tracked_conf_keys() const
     "keyvaluestore_queue_max_ops",
     "keyvaluestore_queue_max_bytes",
     "keyvaluestore_default_strip_size",
+    "keyvaluestore_max_expected_write_size",
+    "keyvaluestore_strip_cache_size",
     "keyvaluestore_dump_file",
     NULL
   };
@@ -2911,6 +3112,8 @@ void KeyValueStore::handle_conf_change(const struct md_config_t *conf,
     m_keyvaluestore_strip_size = conf->keyvaluestore_default_strip_size;
     default_strip_size = m_keyvaluestore_strip_size;
   }
+  if (changed.count("keyvaluestore_strip_cache_size"))
+    strip_cache.set_max_bytes(conf->keyvaluestore_strip_cache_size);
   if (changed.count("keyvaluestore_dump_file")) {
     if (conf->keyvaluestore_dump_file.length() &&
 	conf->keyvaluestore_dump_file != "-") {
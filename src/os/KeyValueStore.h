@@ -256,6 +256,13 @@ class KeyValueStore : public ObjectStore,
     map< uniq_id, map<pair<string, string>, bufferlist>,
 	 CollGhobjectPairBitwiseComparator> buffers;  // pair(prefix, key),to buffer updated data in one transaction
 
+    // Strips written but not yet added to "t"; several writes to one
+    // strip within the transaction end up as a single update
+    map<StripObjectMap::StripObjectHeaderRef, map<string, bufferlist> > dirty_strips;
+
+    // Objects whose strips in the store's strip cache are stale
+    set<uniq_id, CollGhobjectPairBitwiseComparator> invalidated;
+
     list<Context*> finishes;
 
     KeyValueStore *store;
@@ -285,6 +292,7 @@ class KeyValueStore : public ObjectStore,
                       const coll_t &cid, const ghobject_t &oid);
     void rename_buffer(StripObjectMap::StripObjectHeaderRef old_header,
                        const coll_t &cid, const ghobject_t &oid);
+    void flush_strips(StripObjectMap::StripObjectHeaderRef strip_header);
     int submit_transaction();
 
     BufferTransaction(KeyValueStore *store): store(store) {
@@ -303,6 +311,40 @@ class KeyValueStore : public ObjectStore,
     };
   };
 
+  // Recently written strips, kept across transactions so that partial
+  // writes and reads of them need not go back to the backend.  Only
+  // committed data gets in; remove, rename and clone invalidate.
+  class StripCache {
+    typedef BufferTransaction::uniq_id uniq_id;
+    struct Entry {
+      map<string, bufferlist> strips;  // strip key -> data
+      uint64_t bytes;
+      list<uniq_id>::iterator lru_pos;
+      Entry() : bytes(0) {}
+    };
+    typedef map<uniq_id, Entry,
+		BufferTransaction::CollGhobjectPairBitwiseComparator> EntryMap;
+
+    Mutex lock;
+    uint64_t max_bytes, bytes;
+    EntryMap objects;
+    list<uniq_id> lru;  // most recently used first
+
+    void _erase(EntryMap::iterator p);
+    void _trim();
+
+   public:
+    StripCache(uint64_t max)
+      : lock("KeyValueStore::StripCache::lock"), max_bytes(max), bytes(0) {}
+
+    void set_max_bytes(uint64_t max);
+    /// append a private copy of the strip to out, if cached
+    bool lookup(const uniq_id &uid, const string &key, bufferlist *out);
+    /// record committed strip data; an empty bl means it was removed
+    void update(const uniq_id &uid, const string &key, const bufferlist &bl);
+    void invalidate(const uniq_id &uid);
+  } strip_cache;
+
   // -- op workqueue --
   struct Op {
     utime_t start;
@@ -535,6 +577,17 @@ class KeyValueStore : public ObjectStore,
   bool get_allow_sharded_objects() {return false;}
 
   void collect_metadata(map<string,string> *pm);
+  void dump_kv_stats(Formatter *f) {
+    if (backend)
+      backend->db->get_statistics(f);
+  }
+  int compact_kv(const string& prefix,
+		 const string& start, const string& end) {
+    if (!backend)
+      return -EOPNOTSUPP;
+    backend->db->compact_keys(prefix, start, end);
+    return 0;
+  }
 
   int statfs(struct statfs *buf);
 
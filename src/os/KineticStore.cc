@@ -166,6 +166,22 @@ void KineticStore::KineticTransactionImpl::rmkeys_by_prefix(const string &prefix
   }
 }
 
+void KineticStore::KineticTransactionImpl::rm_range_keys(const string &prefix,
+							 const string &start,
+							 const string &end)
+{
+  dout(20) << "kinetic rm_range_keys " << prefix << " [" << start << ","
+	   << end << ")" << dendl;
+  KeyValueDB::Iterator it = db->get_iterator(prefix);
+  for (it->lower_bound(start);
+       it->valid() && it->key() < end;
+       it->next()) {
+    string key = combine_strings(prefix, it->key());
+    ops.push_back(KineticOp(KINETIC_OP_DELETE, key));
+    dout(30) << "kinetic rm key by range: " << key << dendl;
+  }
+}
+
 int KineticStore::get(
     const string &prefix,
     const std::set<string> &keys,
@@ -47,6 +47,8 @@ const string LFNIndex::FILENAME_COOKIE = "long";
 const int LFNIndex::FILENAME_PREFIX_LEN =  FILENAME_SHORT_LEN - FILENAME_HASH_LEN - 
 								FILENAME_COOKIE.size() - 
 								FILENAME_EXTRA;
+atomic64_t LFNIndex::layout_changes;
+
 void LFNIndex::maybe_inject_failure()
 {
   if (error_injection_enabled) {
@@ -77,6 +79,7 @@ struct FDCloser {
 
 int LFNIndex::init()
 {
+  clear_path_cache();
   return _init();
 }
 
@@ -91,6 +94,8 @@ int LFNIndex::created(const ghobject_t &oid, const char *path)
   r = lfn_created(path_comp, oid, short_name);
   if (r < 0)
     goto out;
+  // before _created: a split it triggers drops this again
+  path_cache_add(oid, path_comp, short_name, 1);
   r = _created(path_comp, oid, short_name);
   if (r < 0)
     goto out;
@@ -106,6 +111,8 @@ int LFNIndex::unlink(const ghobject_t &oid)
   if (r < 0) {
     goto out;
   }
+  if (path_cache_enabled)
+    path_cache.clear(oid);
   r = _remove(path, oid, short_name);
   if (r < 0) {
     goto out;
@@ -118,6 +125,16 @@ int LFNIndex::lookup(const ghobject_t &oid,
 		     int *exist)
 {
   WRAP_RETRY(
+  cached_path_t cached;
+  if (path_cache_enabled && path_cache.lookup(oid, &cached)) {
+    path_cache_hits.inc();
+    *exist = cached.exist;
+    *out_path = IndexedPath(
+      new Path(get_full_path(cached.path, cached.short_name), this));
+    r = 0;
+    goto out;
+  }
+  path_cache_misses.inc();
   vector<string> path;
   string short_name;
   r = _lookup(oid, &path, &short_name, exist);
@@ -138,13 +155,40 @@ int LFNIndex::lookup(const ghobject_t &oid,
   } else {
     *exist = 1;
   }
+  path_cache_add(oid, path, short_name, *exist);
   *out_path = IndexedPath(new Path(full_path, this));
   r = 0;
   );
 }
 
+void LFNIndex::path_cache_add(const ghobject_t &oid,
+			      const vector<string> &path,
+			      const string &short_name, int exist)
+{
+  if (!path_cache_enabled)
+    return;
+  if (!exist && lfn_is_hashed_filename(short_name))
+    return;
+  cached_path_t c;
+  c.path = path;
+  c.short_name = short_name;
+  c.exist = exist;
+  path_cache.add(oid, c);
+}
+
+void LFNIndex::dump_stats(Formatter *f) const
+{
+  f->open_object_section("path_cache");
+  f->dump_bool("enabled", path_cache_enabled);
+  f->dump_unsigned("hits", path_cache_hits.read());
+  f->dump_unsigned("misses", path_cache_misses.read());
+  f->dump_unsigned("resets", path_cache_resets.read());
+  f->close_section();
+}
+
 int LFNIndex::pre_hash_collection(uint32_t pg_num, uint64_t expected_num_objs)
 {
+  layout_changed();
   return _pre_hash_collection(pg_num, expected_num_objs);
 }
 
@@ -202,6 +246,7 @@ int LFNIndex::remove_objects(const vector<string> &dir,
 			     const map<string, ghobject_t> &to_remove,
 			     map<string, ghobject_t> *remaining)
 {
+  layout_changed();
   set<string> clean_chains;
   for (map<string, ghobject_t>::const_iterator to_clean = to_remove.begin();
        to_clean != to_remove.end();
@@ -265,6 +310,7 @@ int LFNIndex::remove_objects(const vector<string> &dir,
 int LFNIndex::move_objects(const vector<string> &from,
 			   const vector<string> &to)
 {
+  layout_changed();
   map<string, ghobject_t> to_move;
   int r;
   r = list_objects(from, 0, NULL, &to_move);
@@ -308,6 +354,8 @@ int LFNIndex::remove_object(const vector<string> &from,
 {
   string short_name;
   int r, exist;
+  if (path_cache_enabled)
+    path_cache.clear(oid);
   maybe_inject_failure();
   r = get_mangled_name(from, oid, &short_name, &exist);
   maybe_inject_failure();
@@ -330,6 +378,8 @@ int LFNIndex::move_subdir(
   string dir
   )
 {
+  from.layout_changed();
+  dest.layout_changed();
   vector<string> sub_path(path.begin(), path.end());
   sub_path.push_back(dir);
   string from_path(from.get_full_path_subdir(sub_path));
@@ -347,6 +397,8 @@ int LFNIndex::move_object(
   const pair<string, ghobject_t> &obj
   )
 {
+  from.layout_changed();
+  dest.layout_changed();
   string from_path(from.get_full_path(path, obj.first));
   string to_path;
   string to_name;
@@ -478,6 +530,8 @@ int LFNIndex::list_subdirs(const vector<string> &to_list,
 
 int LFNIndex::create_path(const vector<string> &to_create)
 {
+  // absent objects may now belong in the new directory
+  layout_changed();
   maybe_inject_failure();
   int r = ::mkdir(get_full_path_subdir(to_create).c_str(), 0777);
   maybe_inject_failure();
@@ -489,6 +543,7 @@ int LFNIndex::create_path(const vector<string> &to_create)
 
 int LFNIndex::remove_path(const vector<string> &to_remove)
 {
+  layout_changed();
   maybe_inject_failure();
   int r = ::rmdir(get_full_path_subdir(to_remove).c_str());
   maybe_inject_failure();
@@ -907,6 +962,8 @@ int LFNIndex::lfn_unlink(const vector<string> &path,
     if (r < 0)
       return -errno;
   } else {
+    // the last object of the chain takes the removed slot
+    layout_changed();
     string& rename_to = full_path;
     string rename_from = get_full_path(path, lfn_get_short_name(oid, i - 1));
     maybe_inject_failure();
@@ -28,6 +28,10 @@
 #include "common/ceph_crypto.h"
 
 #include "CollectionIndex.h"
+#include "common/simple_cache.hpp"
+#include "common/config.h"
+#include "global/global_context.h"
+#include "include/atomic.h"
 
 /** 
  * LFNIndex also encapsulates logic for manipulating
@@ -124,6 +128,28 @@ private:
   string lfn_attribute, lfn_alt_attribute;
   coll_t collection;
 
+  /// where lookup() found (or would create) an object
+  struct cached_path_t {
+    vector<string> path;
+    string short_name;
+    int exist;
+  };
+  /**
+   * Bounded cache of lookup() results, so that opens of recently used
+   * objects skip the directory walk, the lfn xattr reads and the stat.
+   * Anything that moves objects or changes the directory layout
+   * (split, merge, collection split, a collision chain renumbering in
+   * lfn_unlink) drops the whole cache.  Lookups of absent objects with
+   * hashed names aren't cached, since creating another object in the
+   * same chain would take their slot.
+   */
+  SimpleLRU<ghobject_t, cached_path_t, ghobject_t::BitwiseComparator> path_cache;
+  bool path_cache_enabled;
+  atomic64_t path_cache_hits, path_cache_misses, path_cache_resets;
+
+  void path_cache_add(const ghobject_t &oid, const vector<string> &path,
+		      const string &short_name, int exist);
+
 public:
   /// Constructor
   LFNIndex(
@@ -138,7 +164,9 @@ public:
       error_injection_on(_error_injection_probability != 0),
       error_injection_probability(_error_injection_probability),
       last_failure(0), current_failure(0),
-      collection(collection) {
+      collection(collection),
+      path_cache(g_conf->filestore_index_path_cache_size),
+      path_cache_enabled(g_conf->filestore_index_path_cache_size > 0) {
     if (index_version == HASH_INDEX_TAG) {
       lfn_attribute = LFN_ATTR;
     } else {
@@ -151,6 +179,30 @@ public:
 
   coll_t coll() const { return collection; }
 
+  /// forget all cached lookups
+  void clear_path_cache() {
+    if (path_cache_enabled) {
+      path_cache.clear();
+      path_cache_resets.inc();
+    }
+  }
+
+  /**
+   * Bumped whenever any index moves objects or creates or removes
+   * directories, changes a caller that fsyncs individual files and
+   * directories can't see (FileStore filestore_sync_dirty_only).
+   */
+  static atomic64_t layout_changes;
+
+  /// the directory layout changed: drop cached paths, bump layout_changes
+  void layout_changed() {
+    clear_path_cache();
+    layout_changes.inc();
+  }
+
+  /// @see CollectionIndex
+  void dump_stats(Formatter *f) const;
+
   /// Virtual destructor
   virtual ~LFNIndex() {}
 
@@ -208,6 +260,8 @@ public:
     ) {
     WRAP_RETRY(
       r = _split(match, bits, dest);
+      layout_changed();
+      static_cast<LFNIndex*>(dest)->layout_changed();
       goto out;
       );
   }
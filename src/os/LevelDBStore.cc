@@ -9,6 +9,7 @@
 #include <errno.h>
 using std::string;
 #include "common/perf_counters.h"
+#include "common/Mutex.h"
 
 int LevelDBStore::init(string option_str)
 {
@@ -16,6 +17,7 @@ int LevelDBStore::init(string option_str)
   // prior to calling open.
   options.write_buffer_size = g_conf->leveldb_write_buffer_size;
   options.cache_size = g_conf->leveldb_cache_size;
+  options.shared_cache_size = g_conf->leveldb_shared_cache_size;
   options.block_size = g_conf->leveldb_block_size;
   options.bloom_size = g_conf->leveldb_bloom_size;
   options.compression_enabled = g_conf->leveldb_compression;
@@ -25,6 +27,18 @@ int LevelDBStore::init(string option_str)
   return 0;
 }
 
+// one block cache for every instance in the process; never freed, as
+// instances may come and go at any time
+static leveldb::Cache *get_shared_cache(uint64_t size)
+{
+  static Mutex lock("LevelDBStore::shared_cache_lock");
+  static leveldb::Cache *cache = NULL;
+  Mutex::Locker l(lock);
+  if (!cache)
+    cache = leveldb::NewLRUCache(size);
+  return cache;
+}
+
 int LevelDBStore::do_open(ostream &out, bool create_if_missing)
 {
   leveldb::Options ldoptions;
@@ -33,7 +47,9 @@ int LevelDBStore::do_open(ostream &out, bool create_if_missing)
     ldoptions.write_buffer_size = options.write_buffer_size;
   if (options.max_open_files)
     ldoptions.max_open_files = options.max_open_files;
-  if (options.cache_size) {
+  if (options.shared_cache_size) {
+    ldoptions.block_cache = get_shared_cache(options.shared_cache_size);
+  } else if (options.cache_size) {
     leveldb::Cache *_db_cache = leveldb::NewLRUCache(options.cache_size);
     db_cache.reset(_db_cache);
     ldoptions.block_cache = db_cache.get();
@@ -84,6 +100,9 @@ int LevelDBStore::do_open(ostream &out, bool create_if_missing)
   plb.add_u64_counter(l_leveldb_compact_range, "leveldb_compact_range", "Compactions by range");
   plb.add_u64_counter(l_leveldb_compact_queue_merge, "leveldb_compact_queue_merge", "Mergings of ranges in compaction queue");
   plb.add_u64(l_leveldb_compact_queue_len, "leveldb_compact_queue_len", "Length of compaction queue");
+  plb.add_u64_counter(l_leveldb_compact_scheduled, "leveldb_compact_scheduled", "Background compactions of prefixes with many deleted keys");
+  plb.add_u64(l_leveldb_compact_running, "leveldb_compact_running", "Whether a queued compaction is running");
+  plb.add_u64(l_leveldb_compact_deleted_keys, "leveldb_compact_deleted_keys", "Deleted keys not yet compacted");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -140,7 +159,10 @@ int LevelDBStore::submit_transaction(KeyValueDB::Transaction t)
   utime_t lat = ceph_clock_now(g_ceph_context) - start;
   logger->inc(l_leveldb_txns);
   logger->tinc(l_leveldb_submit_latency, lat);
-  return s.ok() ? 0 : -1;
+  if (!s.ok())
+    return -1;
+  _queue_range_compactions(_t);
+  return 0;
 }
 
 int LevelDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
@@ -154,7 +176,30 @@ int LevelDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
   utime_t lat = ceph_clock_now(g_ceph_context) - start;
   logger->inc(l_leveldb_txns);
   logger->tinc(l_leveldb_submit_sync_latency, lat);
-  return s.ok() ? 0 : -1;
+  if (!s.ok())
+    return -1;
+  _queue_range_compactions(_t);
+  return 0;
+}
+
+void LevelDBStore::_queue_range_compactions(LevelDBTransactionImpl *t)
+{
+  // the deleted keys leave tombstones behind that every later scan of
+  // the range has to skip until a compaction drops them
+  for (list< pair<string,string> >::iterator p = t->compact_ranges.begin();
+       p != t->compact_ranges.end();
+       ++p)
+    compact_range_async(p->first, p->second);
+  t->compact_ranges.clear();
+
+  if (!t->deleted.empty()) {
+    Mutex::Locker l(compact_queue_lock);
+    compact_tracker.add(t->deleted);
+    logger->set(l_leveldb_compact_deleted_keys, compact_tracker.get_total());
+    if (g_conf->leveldb_compact_deleted_keys && !compact_thread.is_started())
+      compact_thread.create();
+    t->deleted.clear();
+  }
 }
 
 void LevelDBStore::LevelDBTransactionImpl::set(
@@ -175,17 +220,45 @@ void LevelDBStore::LevelDBTransactionImpl::rmkey(const string &prefix,
 {
   string key = combine_strings(prefix, k);
   bat.Delete(leveldb::Slice(key));
+  ++deleted[prefix];
 }
 
 void LevelDBStore::LevelDBTransactionImpl::rmkeys_by_prefix(const string &prefix)
 {
+  uint64_t n = 0;
   KeyValueDB::Iterator it = db->get_iterator(prefix);
   for (it->seek_to_first();
        it->valid();
        it->next()) {
     string key = combine_strings(prefix, it->key());
     bat.Delete(key);
+    ++n;
   }
+  if (g_conf->leveldb_compact_on_range_delete &&
+      n >= g_conf->leveldb_compact_on_range_delete)
+    compact_ranges.push_back(make_pair(prefix, past_prefix(prefix)));
+  else if (n)
+    deleted[prefix] += n;
+}
+
+void LevelDBStore::LevelDBTransactionImpl::rm_range_keys(const string &prefix,
+							 const string &start,
+							 const string &end)
+{
+  uint64_t n = 0;
+  KeyValueDB::Iterator it = db->get_iterator(prefix);
+  for (it->lower_bound(start);
+       it->valid() && it->key() < end;
+       it->next()) {
+    bat.Delete(combine_strings(prefix, it->key()));
+    ++n;
+  }
+  if (g_conf->leveldb_compact_on_range_delete &&
+      n >= g_conf->leveldb_compact_on_range_delete)
+    compact_ranges.push_back(make_pair(combine_strings(prefix, start),
+				       combine_strings(prefix, end)));
+  else if (n)
+    deleted[prefix] += n;
 }
 
 int LevelDBStore::get(
@@ -249,6 +322,8 @@ void LevelDBStore::compact()
 void LevelDBStore::compact_thread_entry()
 {
   compact_queue_lock.Lock();
+  utime_t last_tick = ceph_clock_now(g_ceph_context);
+  uint64_t last_txns = logger->get(l_leveldb_txns);
   while (!compact_queue_stop) {
     while (!compact_queue.empty()) {
       pair<string,string> range = compact_queue.front();
@@ -256,11 +331,41 @@ void LevelDBStore::compact_thread_entry()
       logger->set(l_leveldb_compact_queue_len, compact_queue.size());
       compact_queue_lock.Unlock();
       logger->inc(l_leveldb_compact_range);
+      logger->set(l_leveldb_compact_running, 1);
       compact_range(range.first, range.second);
+      logger->set(l_leveldb_compact_running, 0);
       compact_queue_lock.Lock();
       continue;
     }
-    compact_queue_cond.Wait(compact_queue_lock);
+    if (!g_conf->leveldb_compact_deleted_keys) {
+      compact_queue_cond.Wait(compact_queue_lock);
+      continue;
+    }
+
+    // every leveldb_compact_interval, if the store was idle, compact the
+    // prefix with the most deleted keys.  one at a time, so that
+    // foreground work coming back does not wait behind a long queue.
+    utime_t interval;
+    interval.set_from_double(g_conf->leveldb_compact_interval);
+    compact_queue_cond.WaitInterval(g_ceph_context, compact_queue_lock,
+				    interval);
+    utime_t now = ceph_clock_now(g_ceph_context);
+    if (compact_queue_stop || now - last_tick < interval)
+      continue;
+    uint64_t txns = logger->get(l_leveldb_txns);
+    string prefix;
+    if (compact_queue.empty() &&
+	txns - last_txns <= g_conf->leveldb_compact_idle_txns &&
+	compact_tracker.pick(g_conf->leveldb_compact_deleted_keys, &prefix)) {
+      lgeneric_dout(cct, 10) << __func__ << " compacting prefix " << prefix
+			     << dendl;
+      compact_tracker.clear(prefix);
+      logger->set(l_leveldb_compact_deleted_keys, compact_tracker.get_total());
+      logger->inc(l_leveldb_compact_scheduled);
+      compact_queue.push_back(make_pair(prefix, past_prefix(prefix)));
+    }
+    last_tick = now;
+    last_txns = txns;
   }
   compact_queue_lock.Unlock();
 }
@@ -304,3 +409,24 @@ void LevelDBStore::compact_range_async(const string& start, const string& end)
     compact_thread.create();
   }
 }
+
+void LevelDBStore::get_statistics(Formatter *f)
+{
+  f->open_object_section("leveldb");
+  f->dump_string("path", path);
+  if (options.shared_cache_size)
+    f->dump_unsigned("shared_cache_capacity", options.shared_cache_size);
+  string s;
+  if (db->GetProperty("leveldb.stats", &s))
+    f->dump_string("stats", s);
+  if (db->GetProperty("leveldb.approximate-memory-usage", &s))
+    f->dump_string("approximate_memory_usage", s);
+  {
+    Mutex::Locker l(compact_queue_lock);
+    f->open_object_section("compaction");
+    f->dump_unsigned("queue_len", compact_queue.size());
+    compact_tracker.dump(f);
+    f->close_section();
+  }
+  f->close_section();
+}
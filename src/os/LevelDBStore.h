@@ -6,6 +6,7 @@
 #include "include/types.h"
 #include "include/buffer.h"
 #include "KeyValueDB.h"
+#include "KVCompactionTracker.h"
 #include <set>
 #include <map>
 #include <string>
@@ -41,6 +42,9 @@ enum {
   l_leveldb_compact_range,
   l_leveldb_compact_queue_merge,
   l_leveldb_compact_queue_len,
+  l_leveldb_compact_scheduled,
+  l_leveldb_compact_running,
+  l_leveldb_compact_deleted_keys,
   l_leveldb_last,
 };
 
@@ -64,6 +68,8 @@ class LevelDBStore : public KeyValueDB {
   Cond compact_queue_cond;
   list< pair<string,string> > compact_queue;
   bool compact_queue_stop;
+  /// deletions not yet compacted, for the background scheduler
+  KVCompactionTracker compact_tracker;
   class CompactThread : public Thread {
     LevelDBStore *db;
   public:
@@ -120,6 +126,7 @@ public:
     uint64_t write_buffer_size; /// in-memory write buffer size
     int max_open_files; /// maximum number of files LevelDB can open at once
     uint64_t cache_size; /// size of extra decompressed cache to use
+    uint64_t shared_cache_size; /// size of a cache shared by all instances
     uint64_t block_size; /// user data per block
     int bloom_size; /// number of bits per entry to put in a bloom filter
     bool compression_enabled; /// whether to use libsnappy compression or not
@@ -135,6 +142,7 @@ public:
       write_buffer_size(0), //< 0 means default
       max_open_files(0), //< 0 means default
       cache_size(0), //< 0 means no cache (default)
+      shared_cache_size(0), //< 0 means not shared (default)
       block_size(0), //< 0 means default
       bloom_size(0), //< 0 means no bloom filter (default)
       compression_enabled(true), //< set to false for no compression
@@ -189,6 +197,15 @@ public:
     void rmkeys_by_prefix(
       const string &prefix
       );
+    void rm_range_keys(
+      const string &prefix,
+      const string &start,
+      const string &end);
+
+    /// removed ranges big enough to be worth compacting once committed
+    list< pair<string,string> > compact_ranges;
+    /// keys removed per prefix, other than in compact_ranges
+    map<string, uint64_t> deleted;
   };
 
   KeyValueDB::Transaction get_transaction() {
@@ -198,6 +215,7 @@ public:
 
   int submit_transaction(KeyValueDB::Transaction t);
   int submit_transaction_sync(KeyValueDB::Transaction t);
+  void _queue_range_compactions(LevelDBTransactionImpl *t);
   int get(
     const string &prefix,
     const std::set<string> &key,
@@ -308,6 +326,8 @@ public:
     return limit;
   }
 
+  void get_statistics(Formatter *f);
+
   virtual uint64_t get_estimated_size(map<string,uint64_t> &extra) {
     DIR *store_dir = opendir(path.c_str());
     if (!store_dir) {
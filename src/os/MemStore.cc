@@ -49,9 +49,17 @@ int MemStore::peek_journal_fsid(uuid_d *fsid)
 
 int MemStore::mount()
 {
-  int r = _load();
-  if (r < 0)
-    return r;
+  if (!page_arena && cct->_conf->memstore_page_set &&
+      cct->_conf->memstore_page_arena) {
+    page_arena.reset(new PageArena(cct->_conf->memstore_page_size,
+				   cct->_conf->memstore_page_arena_hugetlb));
+    dout(1) << __func__ << " allocating pages from an arena" << dendl;
+  }
+  if (cct->_conf->memstore_persist) {
+    int r = _load();
+    if (r < 0)
+      return r;
+  }
   finisher.start();
   return 0;
 }
@@ -59,7 +67,16 @@ int MemStore::mount()
 int MemStore::umount()
 {
   finisher.stop();
-  return _save();
+  if (cct->_conf->memstore_persist)
+    return _save();
+
+  // leave an empty store behind rather than stale contents
+  dout(10) << __func__ << " not saving contents" << dendl;
+  bufferlist bl;
+  set<coll_t> collections;
+  ::encode(collections, bl);
+  string fn = path + "/collections";
+  return bl.write_file(fn.c_str());
 }
 
 int MemStore::_save()
@@ -171,7 +188,7 @@ int MemStore::_load()
     int r = cbl.read_file(fn.c_str(), &err);
     if (r < 0)
       return r;
-    CollectionRef c(new Collection(cct));
+    CollectionRef c(new Collection(cct, page_arena.get()));
     bufferlist::iterator p = cbl.begin();
     c->decode(p);
     coll_map[*q] = c;
@@ -241,8 +258,13 @@ int MemStore::statfs(struct statfs *st)
   // Device size is a configured constant
   st->f_blocks = g_conf->memstore_device_bytes / st->f_bsize;
 
-  dout(10) << __func__ << ": used_bytes: " << used_bytes << "/" << g_conf->memstore_device_bytes << dendl;
-  st->f_bfree = st->f_bavail = MAX((long(st->f_blocks) - long(used_bytes / st->f_bsize)), 0);
+  // with an arena, count whole pages: that is what we actually hold
+  uint64_t used = _get_used_bytes();
+  dout(10) << __func__ << ": used_bytes: " << used << "/" << g_conf->memstore_device_bytes << dendl;
+  st->f_bfree = st->f_bavail = MAX((long(st->f_blocks) - long(used / st->f_bsize)), 0);
+  if (page_arena)
+    dout(20) << __func__ << ": arena mapped " << page_arena->get_mapped()
+	     << " huge " << page_arena->get_huge_mapped() << dendl;
 
   return 0;
 }
@@ -599,6 +621,20 @@ int MemStore::queue_transactions(Sequencer *osr,
     lock = std::unique_lock<std::mutex>((*seq)->mutex);
   }
 
+  // once the device is full, refuse anything that writes data, before
+  // applying any of it.  the osd should have stopped sending writes
+  // well before this (statfs reports no space left); removals still go
+  // through so that space can be freed.
+  if (_get_used_bytes() >= cct->_conf->memstore_device_bytes) {
+    for (list<Transaction*>::iterator p = tls.begin(); p != tls.end(); ++p) {
+      if ((*p)->get_data_length()) {
+	derr << __func__ << " out of space: used " << _get_used_bytes()
+	     << " of " << cct->_conf->memstore_device_bytes << dendl;
+	return -ENOSPC;
+      }
+    }
+  }
+
   for (list<Transaction*>::iterator p = tls.begin(); p != tls.end(); ++p) {
     // poke the TPHandle heartbeat just to exercise that code path
     if (handle)
@@ -1233,7 +1269,7 @@ int MemStore::_create_collection(coll_t cid)
   auto result = coll_map.insert(std::make_pair(cid, CollectionRef()));
   if (!result.second)
     return -EEXIST;
-  result.first->second.reset(new Collection(cct));
+  result.first->second.reset(new Collection(cct, page_arena.get()));
   return 0;
 }
 
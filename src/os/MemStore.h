@@ -16,6 +16,7 @@
 #ifndef CEPH_MEMSTORE_H
 #define CEPH_MEMSTORE_H
 
+#include <atomic>
 #include <mutex>
 #include <boost/intrusive_ptr.hpp>
 
@@ -130,7 +131,8 @@ public:
     static thread_local PageSet::page_vector tls_pages;
 #endif
 
-    PageSetObject(size_t page_size) : data(page_size), data_len(0) {}
+    PageSetObject(size_t page_size, PageArena *arena)
+      : data(page_size, arena), data_len(0) {}
 
     size_t get_size() const override { return data_len; }
 
@@ -159,6 +161,7 @@ public:
   struct Collection : public RefCountedObject {
     CephContext *cct;
     bool use_page_set;
+    PageArena *arena;  ///< page data comes from here, if set
     ceph::unordered_map<ghobject_t, ObjectRef> object_hash;  ///< for lookup
     map<ghobject_t, ObjectRef,ghobject_t::BitwiseComparator> object_map;        ///< for iteration
     map<string,bufferptr> xattr;
@@ -170,7 +173,7 @@ public:
 
     ObjectRef create_object() const {
       if (use_page_set)
-        return new PageSetObject(cct->_conf->memstore_page_size);
+        return new PageSetObject(cct->_conf->memstore_page_size, arena);
       return new BufferlistObject();
     }
 
@@ -237,8 +240,9 @@ public:
       return result;
     }
 
-    Collection(CephContext *cct)
+    Collection(CephContext *cct, PageArena *arena)
       : cct(cct), use_page_set(cct->_conf->memstore_page_set),
+        arena(arena),
         lock("MemStore::Collection::lock") {}
   };
   typedef Collection::Ref CollectionRef;
@@ -290,6 +294,9 @@ private:
   };
 
 
+  /// backs PageSetObject data; must outlive every collection
+  std::unique_ptr<PageArena> page_arena;
+
   ceph::unordered_map<coll_t, CollectionRef> coll_map;
   RWLock coll_lock;    ///< rwlock to protect coll_map
   Mutex apply_lock;    ///< serialize all updates
@@ -298,7 +305,11 @@ private:
 
   Finisher finisher;
 
-  uint64_t used_bytes;
+  std::atomic<uint64_t> used_bytes;
+
+  uint64_t _get_used_bytes() const {
+    return page_arena ? page_arena->get_used() : used_bytes.load();
+  }
 
   void _do_transaction(Transaction& t);
 
@@ -61,6 +61,14 @@ public:
     const SequencerPosition *spos=0     ///< [in] sequencer position
     ) = 0;
 
+  /// Clear all map keys in [first, last) from oid
+  virtual int rm_key_range(
+    const ghobject_t &oid,              ///< [in] object containing map
+    const string &first,                ///< [in] first key to clear
+    const string &last,                 ///< [in] key to stop at
+    const SequencerPosition *spos=0     ///< [in] sequencer position
+    ) = 0;
+
   /// Clear all omap keys and the header
   virtual int clear_keys_header(
     const ghobject_t &oid,              ///< [in] oid to clear
@@ -137,6 +145,14 @@ public:
 
   virtual bool check(std::ostream &out) { return true; }
 
+  /// dump statistics of the underlying key/value store
+  virtual void dump_kv_stats(Formatter *f) { }
+  /// compact the underlying key/value store
+  virtual int compact_kv(const string& prefix,
+			 const string& start, const string& end) {
+    return -EOPNOTSUPP;
+  }
+
   class ObjectMapIteratorImpl {
   public:
     virtual int seek_to_first() = 0;
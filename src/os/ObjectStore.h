@@ -69,6 +69,18 @@ enum {
   l_os_bytes,
   l_os_apply_lat,
   l_os_queue_lat,
+  l_os_j_gc_hold,
+  l_os_j_gc_hold_lat,
+  l_os_j_gc_capped,
+  l_os_j_gc_over_target,
+  l_os_j_gc_est_lat,
+  l_os_write_syscalls,
+  l_os_write_coalesced,
+  l_os_index_split,
+  l_os_index_split_lat,
+  l_os_index_split_objs,
+  l_os_commit_dirty_files,
+  l_os_commit_syncfs,
   l_os_last,
 };
 
@@ -438,6 +450,7 @@ public:
 
     __le32 coll_id;
     __le32 object_id;
+    uint32_t index_encoded_bytes;  ///< of coll_index + object_index; 0 if unknown
 
     bufferlist data_bl;
     bufferlist op_bl;
@@ -529,8 +542,10 @@ public:
       std::swap(object_index, other.object_index);
       std::swap(coll_id, other.coll_id);
       std::swap(object_id, other.object_id);
+      std::swap(index_encoded_bytes, other.index_encoded_bytes);
       op_bl.swap(other.op_bl);
       data_bl.swap(other.data_bl);
+      op_ptr.swap(other.op_ptr);
     }
 
     void _update_op(Op* op,
@@ -661,11 +676,25 @@ public:
 
       vector<__le32> om(other.object_index.size());
       map<ghobject_t, __le32, ghobject_t::BitwiseComparator>::iterator object_index_p;
+      bool same_ids = true;
       for (object_index_p = other.object_index.begin();
            object_index_p != other.object_index.end();
            ++object_index_p) {
         om[object_index_p->second] = _get_object_id(object_index_p->first);
-      }      
+        if (om[object_index_p->second] != object_index_p->second)
+          same_ids = false;
+      }
+      for (unsigned i = 0; same_ids && i < cm.size(); ++i)
+        if (cm[i] != i)
+          same_ids = false;
+
+      if (same_ids) {
+        // e.g., appending to an empty transaction: the ops are valid as
+        // they are, so share them instead of copying and rewriting
+        op_bl.append(other.op_bl);
+        data_bl.append(other.data_bl);
+        return;
+      }
 
       //the other.op_bl SHOULD NOT be changes during append operation,
       //we use additional bufferlist to avoid this problem
@@ -694,14 +723,17 @@ public:
         return 1 + 8 + 8 + 4 + 4 + 4 + 4 + 4 + tbl.length();
       else {
         //layout: data_bl + op_bl + coll_index + object_index + data
-        //TODO: maybe we need better way to get encoded bytes;
-        bufferlist bl;
-        ::encode(coll_index, bl);
-        ::encode(object_index, bl);
+        if (!index_encoded_bytes) {
+          // only recomputed after a new collection or object shows up
+          bufferlist bl;
+          ::encode(coll_index, bl);
+          ::encode(object_index, bl);
+          index_encoded_bytes = bl.length();
+        }
 
         return data_bl.length() +
           op_bl.length() +
-          bl.length() +
+          index_encoded_bytes +
           sizeof(data);
       }
     }
@@ -822,6 +854,12 @@ public:
 
         return op;
       }
+      /// the op decode_op() will return next, or NULL at the end
+      const Op* peek_op() const {
+        if (!ops)
+          return NULL;
+        return reinterpret_cast<const Op*>(op_buffer_p);
+      }
       string decode_string() {
         string s;
         ::decode(s, data_bl_p);
@@ -876,7 +914,10 @@ private:
         op_ptr = bufferptr(sizeof(Op) * OPS_PER_PTR);
       }
       bufferptr ptr(op_ptr, 0, sizeof(Op));
-      op_bl.append(ptr);
+      // grows op_bl's last bufferptr when it ends right here, so that
+      // ops built into one buffer stay a single contiguous array which
+      // iterator can walk without rebuilding
+      op_bl.append(ptr, 0, sizeof(Op));
 
       op_ptr.set_offset(op_ptr.offset() + sizeof(Op));
 
@@ -891,6 +932,7 @@ private:
 
       __le32 index_id = coll_id++;
       coll_index[coll] = index_id;
+      index_encoded_bytes = 0;
       return index_id;
     }
     __le32 _get_object_id(const ghobject_t& oid) {
@@ -900,10 +942,25 @@ private:
 
       __le32 index_id = object_id++;
       object_index[oid] = index_id;
+      index_encoded_bytes = 0;
       return index_id;
     }
 
 public:
+    /**
+     * Make room for the next n operations in a single buffer
+     *
+     * Builders that know how many ops they are about to add call this
+     * so that the op array ends up contiguous no matter how many ops
+     * there are, which makes iterating it free of copies.
+     */
+    void reserve_ops(unsigned n) {
+      if (use_tbl)
+        return;
+      if (op_ptr.length() - op_ptr.offset() < n * sizeof(Op))
+        op_ptr = bufferptr(sizeof(Op) * std::max<unsigned>(n, OPS_PER_PTR));
+    }
+
     /// Commence a global file system sync operation.
     void start_sync() {
       if (use_tbl) {
@@ -1528,13 +1585,15 @@ public:
       osr(NULL),
       use_tbl(false),
       coll_id(0),
-      object_id(0) { }
+      object_id(0),
+      index_encoded_bytes(0) { }
 
     Transaction(bufferlist::iterator &dp) :
       osr(NULL),
       use_tbl(false),
       coll_id(0),
-      object_id(0) {
+      object_id(0),
+      index_encoded_bytes(0) {
       decode(dp);
     }
 
@@ -1542,7 +1601,8 @@ public:
       osr(NULL),
       use_tbl(false),
       coll_id(0),
-      object_id(0) {
+      object_id(0),
+      index_encoded_bytes(0) {
       bufferlist::iterator dp = nbl.begin();
       decode(dp);
     }
@@ -1609,6 +1669,7 @@ public:
         use_tbl = false;
         coll_id = coll_index.size();
         object_id = object_index.size();
+        index_encoded_bytes = 0;
 	decoded = true;
       }
 
@@ -1771,6 +1832,17 @@ public:
 
   virtual void collect_metadata(map<string,string> *pm) { }
 
+  /// dump per-collection index statistics, if the backend has any
+  virtual void dump_index_stats(Formatter *f) { }
+
+  /// dump statistics of the key/value backend, if there is one
+  virtual void dump_kv_stats(Formatter *f) { }
+  /// compact the key/value backend (see KeyValueDB::compact_keys)
+  virtual int compact_kv(const string& prefix,
+			 const string& start, const string& end) {
+    return -EOPNOTSUPP;
+  }
+
   /**
    * check the journal uuid/fsid, without opening
    */
@@ -1867,6 +1939,85 @@ public:
     uint32_t op_flags = 0,
     bool allow_eio = false) = 0;
 
+  /**
+   * read_into -- read a byte range of data into a caller supplied buffer
+   *
+   * Same as read(), but the data lands in @p bp, which lets the caller
+   * provide memory the messenger has already registered with the
+   * transport.  Backends that cannot fill a buffer in place read into
+   * a bufferlist and copy.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be read
+   * @param len number of bytes to be read (must be > 0 and <= bp.length())
+   * @param bp output buffer
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @param allow_eio if false, assert on -EIO operation failure
+   * @returns number of bytes read on success, or negative error code on failure.
+   */
+  virtual int read_into(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferptr& bp,
+    uint32_t op_flags = 0,
+    bool allow_eio = false) {
+    assert(len > 0 && len <= bp.length());
+    bufferlist bl;
+    int r = read(cid, oid, offset, len, bl, op_flags, allow_eio);
+    if (r > 0)
+      bl.copy(0, r, bp.c_str());
+    return r;
+  }
+
+  /**
+   * readahead -- hint that a byte range will be read soon
+   *
+   * Lets the backend start fetching the range in the background.  It
+   * is only a hint: nothing is returned and the default does nothing.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte
+   * @param len number of bytes (0 for the rest of the object)
+   */
+  virtual void readahead(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len) {}
+
+  /**
+   * read_async -- read a byte range of data without waiting for it
+   *
+   * Queues the read and returns; @p onfinish is completed with what
+   * read() would have returned once the data is in @p bl, from a
+   * backend thread.  @p bl must stay valid until then.  The default
+   * does the read in the caller and completes @p onfinish before
+   * returning.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be read
+   * @param len number of bytes to be read
+   * @param bl output bufferlist
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @param onfinish completion, gets bytes read or negative error code
+   */
+  virtual void read_async(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    bufferlist *bl,
+    uint32_t op_flags,
+    Context *onfinish) {
+    int r = read(cid, oid, offset, len, *bl, op_flags);
+    onfinish->complete(r);
+  }
+
   /**
    * fiemap -- get extent map of data of an object
    *
@@ -1885,6 +2036,60 @@ public:
    */
   virtual int fiemap(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len, bufferlist& bl) = 0;
 
+  /**
+   * sparse_read -- read the data extents of a byte range
+   *
+   * fiemap() and read() in one call: @p m gets the extents of the range
+   * that hold data, clipped to the object size, and @p bl their contents
+   * back to back.  Backends that can find and read the extents without
+   * a round trip per extent override this.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be read
+   * @param len number of bytes to be read
+   * @param m output extent map (offset -> length)
+   * @param bl output data of the extents in m
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @param allow_eio if false, assert on -EIO operation failure
+   * @returns number of bytes read on success, or negative error code on failure.
+   */
+  virtual int sparse_read(
+    coll_t cid,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    map<uint64_t, uint64_t>& m,
+    bufferlist& bl,
+    uint32_t op_flags = 0,
+    bool allow_eio = false) {
+    bufferlist mbl;
+    int r = fiemap(cid, oid, offset, len, mbl);
+    if (r < 0)
+      return r;
+    map<uint64_t, uint64_t> extents;
+    bufferlist::iterator p = mbl.begin();
+    ::decode(extents, p);
+    m.clear();
+    int total = 0;
+    for (map<uint64_t, uint64_t>::iterator q = extents.begin();
+	 q != extents.end();
+	 ++q) {
+      bufferlist t;
+      r = read(cid, oid, q->first, q->second, t, op_flags, allow_eio);
+      if (r < 0)
+	return r;
+      if (r == 0)
+	break;
+      m[q->first] = r;
+      total += r;
+      bl.claim_append(t);
+      if (r < (int)q->second)
+	break;  // end of object
+    }
+    return total;
+  }
+
   /**
    * getattr -- get an xattr of an object
    *
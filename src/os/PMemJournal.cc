@@ -0,0 +1,543 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "acconfig.h"
+
+#include "PMemJournal.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "common/perf_counters.h"
+#include "include/crc32c.h"
+#include "include/compat.h"
+#include "include/page.h"
+#include "os/ObjectStore.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_PMEM_NT_STORES
+#endif
+
+#define dout_subsys ceph_subsys_journal
+#undef dout_prefix
+#define dout_prefix *_dout << "pmem journal "
+
+// ----------------------------------------------------------------------
+// cache line write back
+
+static const uintptr_t CACHE_LINE = 64;
+
+/// write back (and evict) the cache lines covering [p, p+len)
+static inline void pmem_flush(const void *p, size_t len)
+{
+#ifdef HAVE_PMEM_NT_STORES
+  uintptr_t line = (uintptr_t)p & ~(CACHE_LINE - 1);
+  uintptr_t end = (uintptr_t)p + len;
+  for (; line < end; line += CACHE_LINE)
+    _mm_clflush((const void *)line);
+#endif
+}
+
+/// order all earlier flushes and non-temporal stores
+static inline void pmem_drain()
+{
+#ifdef HAVE_PMEM_NT_STORES
+  _mm_sfence();
+#else
+  __sync_synchronize();
+#endif
+}
+
+/**
+ * copy into persistent memory, bypassing the cache where dst is 16 byte
+ * aligned and flushing the lines of the unaligned head and tail.
+ */
+static void pmem_copy(char *dst, const char *src, size_t len)
+{
+#ifdef HAVE_PMEM_NT_STORES
+  size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+  if (head > len)
+    head = len;
+  if (head) {
+    memcpy(dst, src, head);
+    pmem_flush(dst, head);
+    dst += head;
+    src += head;
+    len -= head;
+  }
+  while (len >= 16) {
+    _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+    dst += 16;
+    src += 16;
+    len -= 16;
+  }
+  if (len) {
+    memcpy(dst, src, len);
+    pmem_flush(dst, len);
+  }
+#else
+  memcpy(dst, src, len);
+#endif
+}
+
+// ----------------------------------------------------------------------
+
+PMemJournal::PMemJournal(uuid_d fsid, Finisher *fin, Cond *sync_cond,
+			 const char *f)
+  : Journal(fsid, fin, sync_cond),
+    fn(f), fd(-1), base(NULL), size(0),
+    use_msync(g_conf->journal_pmem_msync),
+    lock("PMemJournal::lock"),
+    header(NULL),
+    writeable(false),
+    write_pos(0), read_pos(0), last_read_seq(0),
+    last_committed_seq(0)
+{
+#ifndef HAVE_PMEM_NT_STORES
+  // no cache flush instructions to rely on here
+  use_msync = true;
+#endif
+}
+
+PMemJournal::~PMemJournal()
+{
+  assert(fd == -1);
+}
+
+uint32_t PMemJournal::header_crc(const entry_header_t &h)
+{
+  return ceph_crc32c(0, (const unsigned char *)&h,
+		     offsetof(entry_header_t, hcrc));
+}
+
+int PMemJournal::_open(bool create)
+{
+  assert(fd == -1);
+  fd = ::open(fn.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+  if (fd < 0) {
+    int r = -errno;
+    derr << "_open failed to open " << fn << ": " << cpp_strerror(r) << dendl;
+    fd = -1;
+    return r;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0) {
+    int r = -errno;
+    derr << "_open failed to stat " << fn << ": " << cpp_strerror(r) << dendl;
+    _close();
+    return r;
+  }
+  uint64_t want = (uint64_t)g_conf->osd_journal_size << 20;
+  if (S_ISREG(st.st_mode)) {
+    size = st.st_size;
+    if (create && size < want) {
+      if (::ftruncate(fd, want) < 0) {
+	int r = -errno;
+	derr << "_open failed to size " << fn << " to " << want << ": "
+	     << cpp_strerror(r) << dendl;
+	_close();
+	return r;
+      }
+      size = want;
+    }
+  } else {
+    // device dax: the size of the region has to be configured
+    size = want;
+  }
+  size -= size % CACHE_LINE;
+  if (size < get_top() + (1 << 20)) {
+    derr << "_open " << fn << " is too small (" << size << " bytes)" << dendl;
+    _close();
+    return -EINVAL;
+  }
+
+  void *p = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    int r = -errno;
+    derr << "_open failed to mmap " << fn << ": " << cpp_strerror(r) << dendl;
+    _close();
+    return r;
+  }
+  base = (char *)p;
+  header = (header_t *)base;
+  dout(1) << "_open " << fn << " fd " << fd << ": " << size << " bytes"
+	  << (use_msync ? ", msync" : "") << dendl;
+  return 0;
+}
+
+void PMemJournal::_close()
+{
+  if (base) {
+    ::munmap(base, size);
+    base = NULL;
+    header = NULL;
+  }
+  if (fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    fd = -1;
+  }
+}
+
+void PMemJournal::_persist(uint64_t off, uint64_t len)
+{
+  if (!use_msync)
+    return;
+  uint64_t page = CEPH_PAGE_SIZE;
+  uint64_t start = off & ~(page - 1);
+  if (::msync(base + start, off + len - start, MS_SYNC) < 0) {
+    int r = -errno;
+    derr << "msync failed: " << cpp_strerror(r) << dendl;
+    assert(0 == "msync failed");
+  }
+}
+
+int PMemJournal::check()
+{
+  int r = _open(false);
+  if (r < 0)
+    return r;
+  r = 0;
+  if (header->magic != PMEM_MAGIC) {
+    derr << "check: " << fn << " is not a pmem journal" << dendl;
+    r = -EINVAL;
+  } else if (memcmp(header->fsid, &fsid.uuid, sizeof(header->fsid))) {
+    derr << "check: ondisk fsid doesn't match expected " << fsid
+	 << ", invalid (someone else's?) journal" << dendl;
+    r = -EINVAL;
+  } else {
+    dout(1) << "check: header looks ok" << dendl;
+  }
+  _close();
+  return r;
+}
+
+int PMemJournal::create()
+{
+  dout(2) << "create " << fn << " fsid " << fsid << dendl;
+  int r = _open(true);
+  if (r < 0)
+    return r;
+
+  // clear the first entry slot so nothing stale is replayed
+  memset(base + get_top(), 0, sizeof(entry_header_t));
+  memset(base, 0, PMEM_HEADER_SIZE);
+  header->magic = PMEM_MAGIC;
+  memcpy(header->fsid, &fsid.uuid, sizeof(header->fsid));
+  header->size = size;
+  header->start = get_top();
+  header->start_seq = 1;
+  pmem_flush(base + get_top(), sizeof(entry_header_t));
+  pmem_flush(base, sizeof(header_t));
+  pmem_drain();
+  _persist(0, get_top() + sizeof(entry_header_t));
+
+  _close();
+  return 0;
+}
+
+int PMemJournal::peek_fsid(uuid_d& out)
+{
+  int r = _open(false);
+  if (r < 0)
+    return r;
+  if (header->magic == PMEM_MAGIC)
+    memcpy(&out.uuid, header->fsid, sizeof(header->fsid));
+  else
+    r = -EINVAL;
+  _close();
+  return r;
+}
+
+int PMemJournal::open(uint64_t fs_op_seq)
+{
+  dout(2) << "open " << fn << " fsid " << fsid << " fs_op_seq " << fs_op_seq
+	  << dendl;
+  int r = _open(false);
+  if (r < 0)
+    return r;
+  if (header->magic != PMEM_MAGIC ||
+      memcmp(header->fsid, &fsid.uuid, sizeof(header->fsid))) {
+    derr << "open " << fn << " is not our pmem journal" << dendl;
+    _close();
+    return -EINVAL;
+  }
+  if (header->size != size) {
+    derr << "open " << fn << " was created with " << header->size
+	 << " bytes, now " << size << dendl;
+    _close();
+    return -EINVAL;
+  }
+
+  Mutex::Locker l(lock);
+  read_pos = header->start;
+  last_read_seq = 0;
+  last_committed_seq = fs_op_seq;
+  journalq.clear();
+  writeable = false;
+  return 0;
+}
+
+void PMemJournal::close()
+{
+  dout(1) << "close " << fn << dendl;
+  {
+    Mutex::Locker l(lock);
+    writeable = false;
+    journalq.clear();
+  }
+  _close();
+}
+
+bool PMemJournal::_check_entry(uint64_t pos,
+			       const entry_header_t **out) const
+{
+  const entry_header_t *h = (const entry_header_t *)(base + pos);
+  if (h->magic != (PMEM_MAGIC ^ pos) || h->pos != pos ||
+      h->hcrc != header_crc(*h))
+    return false;
+  if (h->flags & entry_header_t::FLAG_WRAP) {
+    *out = h;
+    return true;
+  }
+  if (pos + entry_size(h->len) > size)
+    return false;
+  const unsigned char *payload = (const unsigned char *)(h + 1);
+  if (ceph_crc32c(0, payload, h->len) != h->crc)
+    return false;
+  *out = h;
+  return true;
+}
+
+bool PMemJournal::read_entry(bufferlist &bl, uint64_t &seq)
+{
+  Mutex::Locker l(lock);
+  while (true) {
+    if (read_pos + sizeof(entry_header_t) > size)
+      read_pos = get_top();
+    const entry_header_t *h;
+    if (!_check_entry(read_pos, &h)) {
+      dout(10) << "read_entry no valid entry at " << read_pos << dendl;
+      return false;
+    }
+    // stale entries from an earlier lap have older seqs
+    if (last_read_seq ? h->seq <= last_read_seq : h->seq < header->start_seq) {
+      dout(10) << "read_entry stale seq " << h->seq << " at " << read_pos
+	       << " after " << last_read_seq << dendl;
+      return false;
+    }
+    if (h->flags & entry_header_t::FLAG_WRAP) {
+      dout(20) << "read_entry wrap at " << read_pos << dendl;
+      read_pos = get_top();
+      continue;
+    }
+    bl.clear();
+    bl.append((const char *)(h + 1), h->len);
+    seq = h->seq;
+    last_read_seq = h->seq;
+    journalq.push_back(make_pair(h->seq, read_pos));
+    dout(20) << "read_entry seq " << seq << " at " << read_pos
+	     << " len " << h->len << dendl;
+    read_pos += entry_size(h->len);
+    return true;
+  }
+}
+
+int PMemJournal::make_writeable()
+{
+  Mutex::Locker l(lock);
+  write_pos = read_pos;
+  if (write_pos + sizeof(entry_header_t) > size)
+    write_pos = get_top();
+  writeable = true;
+  dout(10) << "make_writeable write_pos " << write_pos << dendl;
+  return 0;
+}
+
+uint64_t PMemJournal::_room() const
+{
+  // room for a new entry at write_pos, keeping one line so that a full
+  // journal never looks empty
+  uint64_t start = header->start;
+  if (write_pos >= start) {
+    uint64_t tail = size - write_pos;
+    if (start == get_top())
+      tail = tail > CACHE_LINE ? tail - CACHE_LINE : 0;
+    uint64_t wrapped = start - get_top();
+    if (wrapped > CACHE_LINE)
+      wrapped -= CACHE_LINE;
+    else
+      wrapped = 0;
+    // an entry that doesn't fit at the end is written at the top
+    return MAX(tail, wrapped);
+  }
+  return start - write_pos - CACHE_LINE;
+}
+
+bool PMemJournal::should_commit_now()
+{
+  Mutex::Locker l(lock);
+  if (!writeable)
+    return false;
+  uint64_t start = header->start;
+  uint64_t used = write_pos >= start ? write_pos - start :
+    (size - start) + (write_pos - get_top());
+  return used > (size - get_top()) / 2;
+}
+
+void PMemJournal::_write_entry_header(uint64_t pos, uint64_t seq,
+				      uint32_t len, uint32_t crc,
+				      uint32_t flags)
+{
+  entry_header_t h;
+  memset(&h, 0, sizeof(h));
+  h.magic = PMEM_MAGIC ^ pos;
+  h.seq = seq;
+  h.pos = pos;
+  h.len = len;
+  h.crc = crc;
+  h.flags = flags;
+  h.hcrc = header_crc(h);
+  pmem_copy(base + pos, (const char *)&h, sizeof(h));
+}
+
+void PMemJournal::submit_entry(uint64_t seq, bufferlist& e, int alignment,
+			       Context *oncommit, TrackedOpRef osd_op)
+{
+  utime_t start = ceph_clock_now(g_ceph_context);
+  assert(e.length() > 0);
+  uint64_t esize = entry_size(e.length());
+  if (esize > (size - get_top()) / 2) {
+    derr << "submit_entry seq " << seq << " len " << e.length()
+	 << " does not fit in journal of " << size << " bytes" << dendl;
+    assert(0 == "journal entry larger than half the journal");
+  }
+  if (osd_op)
+    osd_op->mark_event("commit_queued_for_journal_write");
+
+  Mutex::Locker l(lock);
+  assert(writeable);
+  bool signaled = false;
+  while (_room() < esize) {
+    dout(1) << "submit_entry seq " << seq << " journal full, waiting for trim"
+	    << dendl;
+    if (logger && !signaled)
+      logger->inc(l_os_j_full);
+    if (do_sync_cond && !signaled)
+      do_sync_cond->SloppySignal();
+    signaled = true;
+    room_cond.Wait(lock);
+  }
+  if (write_pos + esize > size) {
+    dout(20) << "submit_entry wrap at " << write_pos << dendl;
+    if (write_pos + sizeof(entry_header_t) <= size) {
+      _write_entry_header(write_pos, seq, 0, 0, entry_header_t::FLAG_WRAP);
+      _persist(write_pos, sizeof(entry_header_t));
+    }
+    write_pos = get_top();
+  }
+
+  // payload, then the header that makes it visible to replay
+  uint64_t pos = write_pos;
+  char *p = base + pos + sizeof(entry_header_t);
+  uint32_t crc = 0;
+  for (std::list<bufferptr>::const_iterator i = e.buffers().begin();
+       i != e.buffers().end();
+       ++i) {
+    pmem_copy(p, i->c_str(), i->length());
+    crc = ceph_crc32c(crc, (const unsigned char *)i->c_str(), i->length());
+    p += i->length();
+  }
+  _write_entry_header(pos, seq, e.length(), crc, 0);
+  pmem_drain();
+  _persist(pos, esize);
+
+  journalq.push_back(make_pair(seq, pos));
+  write_pos = pos + esize;
+  if (write_pos + sizeof(entry_header_t) > size)
+    write_pos = get_top();
+
+  utime_t lat = ceph_clock_now(g_ceph_context) - start;
+  dout(10) << "submit_entry seq " << seq << " at " << pos << " len "
+	   << e.length() << " lat " << lat << dendl;
+  if (logger) {
+    logger->inc(l_os_j_ops);
+    logger->inc(l_os_j_bytes, e.length());
+    logger->inc(l_os_j_wr);
+    logger->inc(l_os_j_wr_bytes, esize);
+    logger->tinc(l_os_j_lat, lat);
+  }
+  if (osd_op)
+    osd_op->mark_event("journaled_completion_queued");
+  if (oncommit)
+    finisher->queue(oncommit);
+}
+
+void PMemJournal::_update_start()
+{
+  if (!journalq.empty()) {
+    header->start = journalq.front().second;
+    header->start_seq = journalq.front().first;
+  } else {
+    header->start = write_pos;
+    header->start_seq = last_committed_seq + 1;
+  }
+  pmem_flush(header, sizeof(*header));
+  pmem_drain();
+  _persist(0, sizeof(*header));
+}
+
+void PMemJournal::committed_thru(uint64_t seq)
+{
+  Mutex::Locker l(lock);
+  if (seq <= last_committed_seq) {
+    dout(5) << "committed_thru " << seq << " <= last_committed_seq "
+	    << last_committed_seq << dendl;
+    return;
+  }
+  dout(5) << "committed_thru " << seq << dendl;
+  last_committed_seq = seq;
+  while (!journalq.empty() && journalq.front().first <= seq)
+    journalq.pop_front();
+  _update_start();
+  room_cond.Signal();
+}
+
+int PMemJournal::dump(ostream& out)
+{
+  int r = _open(false);
+  if (r < 0)
+    return r;
+  if (header->magic != PMEM_MAGIC) {
+    _close();
+    return -EINVAL;
+  }
+  out << "pmem journal " << fn << " size " << header->size
+      << " start " << header->start << " start_seq " << header->start_seq
+      << std::endl;
+  read_pos = header->start;
+  last_read_seq = 0;
+  bufferlist bl;
+  uint64_t seq = 0;
+  while (read_entry(bl, seq))
+    out << "  seq " << seq << " pos " << journalq.back().second
+	<< " len " << bl.length() << std::endl;
+  journalq.clear();
+  _close();
+  return 0;
+}
@@ -0,0 +1,136 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_PMEMJOURNAL_H
+#define CEPH_PMEMJOURNAL_H
+
+#include <deque>
+using std::deque;
+
+#include "Journal.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+
+/**
+ * Journal on byte addressable persistent memory.
+ *
+ * The journal file (a file on a DAX mounted filesystem or a device dax
+ * character device) is mmapped and entries are copied in with
+ * non-temporal stores and cache line flushes, then fenced.  There is no
+ * writer thread: submit_entry() makes the entry durable before it
+ * queues the commit callback.
+ *
+ * Layout: a PMEM_HEADER_SIZE header, then a circular log of entries,
+ * each a 64 byte entry_header_t followed by the payload, padded to a
+ * cache line.  An entry that doesn't fit before the end is preceded by
+ * a wrap marker and written at the top.  Entries carry a header crc and
+ * a payload crc, so replay stops at the first torn or stale entry.
+ * Trimming (committed_thru) only moves header.start.
+ *
+ * If journal_pmem_msync is set, every write is also msync()ed, so the
+ * journal stays durable on storage that is not really persistent
+ * memory (and can be tested on a plain file).
+ */
+class PMemJournal : public Journal {
+public:
+  static const uint64_t PMEM_HEADER_SIZE = 4096;
+  static const uint64_t PMEM_MAGIC = 0x6a6d702068706563ull; ///< "ceph pmj"
+
+  struct header_t {
+    uint64_t magic;
+    uint8_t fsid[16];
+    uint64_t size;       ///< bytes mapped, header included
+    uint64_t start;      ///< offset of the first live entry
+    uint64_t start_seq;  ///< seq expected at start
+  };
+
+  struct entry_header_t {
+    enum {
+      FLAG_WRAP = 1,     ///< continue at the top
+    };
+    uint64_t magic;      ///< PMEM_MAGIC ^ pos
+    uint64_t seq;
+    uint64_t pos;
+    uint32_t len;        ///< payload bytes
+    uint32_t crc;        ///< payload crc32c
+    uint32_t flags;
+    uint32_t hcrc;       ///< crc32c of the fields above
+    uint8_t pad[24];
+  } __attribute__((__packed__));
+
+private:
+  string fn;
+  int fd;
+  char *base;            ///< the mapping
+  uint64_t size;
+  bool use_msync;
+
+  Mutex lock;            ///< protects everything below
+  Cond room_cond;
+  header_t *header;      ///< in the mapping
+  bool writeable;
+  uint64_t write_pos;
+  uint64_t read_pos;
+  uint64_t last_read_seq;
+  uint64_t last_committed_seq;
+  deque<pair<uint64_t, uint64_t> > journalq; ///< (seq, pos) of live entries
+
+  uint64_t get_top() const {
+    return PMEM_HEADER_SIZE;
+  }
+  static uint64_t entry_size(uint64_t len) {
+    return ROUND_UP_TO(sizeof(entry_header_t) + len, 64);
+  }
+  static uint32_t header_crc(const entry_header_t &h);
+
+  int _open(bool create);
+  void _close();
+  uint64_t _room() const;
+  bool _check_entry(uint64_t pos, const entry_header_t **out) const;
+  void _write_entry_header(uint64_t pos, uint64_t seq, uint32_t len,
+			   uint32_t crc, uint32_t flags);
+  void _persist(uint64_t off, uint64_t len);
+  void _update_start();
+
+public:
+  PMemJournal(uuid_d fsid, Finisher *fin, Cond *sync_cond, const char *f);
+  ~PMemJournal();
+
+  int check();
+  int create();
+  int open(uint64_t fs_op_seq);
+  void close();
+  int peek_fsid(uuid_d& fsid);
+  int dump(ostream& out);
+
+  void flush() {}
+  void throttle() {}
+
+  bool is_writeable() {
+    Mutex::Locker l(lock);
+    return writeable;
+  }
+  int make_writeable();
+
+  void submit_entry(uint64_t seq, bufferlist& e, int alignment,
+		    Context *oncommit,
+		    TrackedOpRef osd_op = TrackedOpRef());
+  void commit_start(uint64_t seq) {}
+  void committed_thru(uint64_t seq);
+
+  bool read_entry(bufferlist &bl, uint64_t &seq);
+
+  /// ask for a commit once the journal is half full so it can be trimmed
+  bool should_commit_now();
+};
+
+#endif
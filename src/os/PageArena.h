@@ -0,0 +1,154 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.	See file COPYING.
+ *
+ */
+
+#ifndef CEPH_PAGEARENA_H
+#define CEPH_PAGEARENA_H
+
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "include/Spinlock.h"
+
+// Hands out page_size buffers carved from large anonymous mappings,
+// backed by huge pages when the system has them.  Memory is never
+// given back to the system while the arena lives; freed pages go to one
+// of several free lists, picked by thread, so that threads working on
+// different objects rarely meet on a lock.
+class PageArena {
+ public:
+  static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+ private:
+  static const unsigned NUM_STRIPES = 16;
+
+  struct Stripe {
+    Spinlock lock;
+    std::vector<char*> free;
+  };
+
+  const size_t page_size;
+  const size_t chunk_size;
+  const bool hugetlb;
+
+  Stripe stripes[NUM_STRIPES];
+
+  std::mutex chunk_mutex;  // protects chunks and carving from them
+  std::vector<std::pair<void*, size_t> > chunks;
+  char *chunk_pos, *chunk_end;
+
+  std::atomic<uint64_t> used;         // bytes in pages handed out
+  std::atomic<uint64_t> mapped;       // bytes mapped
+  std::atomic<uint64_t> huge_mapped;  // of which explicitly huge pages
+
+  Stripe &get_stripe() {
+    size_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return stripes[h % NUM_STRIPES];
+  }
+
+  // with chunk_mutex held
+  bool map_chunk() {
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (hugetlb) {
+      p = ::mmap(NULL, chunk_size, PROT_READ|PROT_WRITE,
+		 MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED)
+	huge_mapped += chunk_size;
+    }
+#endif
+    if (p == MAP_FAILED) {
+      p = ::mmap(NULL, chunk_size, PROT_READ|PROT_WRITE,
+		 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED)
+	return false;
+#ifdef MADV_HUGEPAGE
+      // no reserved huge pages; transparent ones will do
+      ::madvise(p, chunk_size, MADV_HUGEPAGE);
+#endif
+    }
+    chunks.push_back(std::make_pair(p, chunk_size));
+    chunk_pos = static_cast<char*>(p);
+    chunk_end = chunk_pos + chunk_size;
+    mapped += chunk_size;
+    return true;
+  }
+
+  char *pop(Stripe &s) {
+    std::lock_guard<Spinlock> l(s.lock);
+    if (s.free.empty())
+      return nullptr;
+    char *p = s.free.back();
+    s.free.pop_back();
+    return p;
+  }
+
+ public:
+  // page_size must be a power of two
+  PageArena(size_t page_size, bool hugetlb)
+    : page_size(page_size),
+      chunk_size((std::max<size_t>(page_size, size_t(HUGE_PAGE_SIZE)) +
+		  HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)),
+      hugetlb(hugetlb),
+      chunk_pos(nullptr), chunk_end(nullptr),
+      used(0), mapped(0), huge_mapped(0) {}
+  ~PageArena() {
+    for (auto &c : chunks)
+      ::munmap(c.first, c.second);
+  }
+
+  // disable copy
+  PageArena(const PageArena&) = delete;
+  const PageArena& operator=(const PageArena&) = delete;
+
+  size_t get_page_size() const { return page_size; }
+  uint64_t get_used() const { return used; }
+  uint64_t get_mapped() const { return mapped; }
+  uint64_t get_huge_mapped() const { return huge_mapped; }
+
+  // a page_size buffer, or nullptr if no memory could be mapped
+  char *alloc() {
+    char *p = pop(get_stripe());
+    if (!p) {
+      std::lock_guard<std::mutex> l(chunk_mutex);
+      if (chunk_pos == chunk_end) {
+	// reuse what other threads freed before growing
+	for (unsigned i = 0; i < NUM_STRIPES && !p; ++i)
+	  p = pop(stripes[i]);
+	if (!p && !map_chunk())
+	  return nullptr;
+      }
+      if (!p) {
+	p = chunk_pos;
+	chunk_pos += page_size;
+      }
+    }
+    used += page_size;
+    return p;
+  }
+
+  void free(char *p) {
+    Stripe &s = get_stripe();
+    {
+      std::lock_guard<Spinlock> l(s.lock);
+      s.free.push_back(p);
+    }
+    used -= page_size;
+  }
+};
+
+#endif // CEPH_PAGEARENA_H
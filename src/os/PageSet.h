@@ -25,10 +25,12 @@
 
 #include "include/encoding.h"
 #include "include/Spinlock.h"
+#include "PageArena.h"
 
 
 struct Page {
   char *const data;
+  PageArena *const arena; // data came from here, if set
   boost::intrusive::avl_set_member_hook<> hook;
   uint64_t offset;
 
@@ -62,11 +64,18 @@ struct Page {
     ::decode(offset, p);
   }
 
-  static Ref create(size_t page_size, uint64_t offset = 0) {
+  static Ref create(size_t page_size, uint64_t offset = 0,
+                    PageArena *arena = nullptr) {
+    if (arena && arena->get_page_size() == page_size) {
+      // keep the data pages dense in the arena; the Page goes on the heap
+      char *data = arena->alloc();
+      if (data)
+        return new (new char[sizeof(Page)]) Page(data, offset, arena);
+    }
     // allocate the Page and its data in a single buffer
     auto buffer = new char[page_size + sizeof(Page)];
     // place the Page structure at the end of the buffer
-    return new (buffer + page_size) Page(buffer, offset);
+    return new (buffer + page_size) Page(buffer, offset, nullptr);
   }
 
   // copy disabled
@@ -74,10 +83,17 @@ struct Page {
   const Page& operator=(const Page&) = delete;
 
  private: // private constructor, use create() instead
-  Page(char *data, uint64_t offset) : data(data), offset(offset), nrefs(1) {}
+  Page(char *data, uint64_t offset, PageArena *arena)
+    : data(data), arena(arena), offset(offset), nrefs(1) {}
 
   static void operator delete(void *p) {
-    delete[] reinterpret_cast<Page*>(p)->data;
+    Page *page = reinterpret_cast<Page*>(p);
+    if (page->arena) {
+      page->arena->free(page->data);
+      delete[] reinterpret_cast<char*>(p);
+    } else {
+      delete[] page->data;
+    }
   }
 };
 
@@ -99,6 +115,7 @@ class PageSet {
 
   page_set pages;
   uint64_t page_size;
+  PageArena *arena;
 
   typedef Spinlock lock_type;
   lock_type mutex;
@@ -126,9 +143,11 @@ class PageSet {
   }
 
  public:
-  PageSet(size_t page_size) : page_size(page_size) {}
+  PageSet(size_t page_size, PageArena *arena = nullptr)
+    : page_size(page_size), arena(arena) {}
   PageSet(PageSet &&rhs)
-    : pages(std::move(rhs.pages)), page_size(rhs.page_size) {}
+    : pages(std::move(rhs.pages)), page_size(rhs.page_size),
+      arena(rhs.arena) {}
   ~PageSet() {
     free_pages(pages.begin(), pages.end());
   }
@@ -158,7 +177,7 @@ class PageSet {
       typename page_set::insert_commit_data commit;
       auto insert = pages.insert_check(cur, page_offset, page_cmp(), commit);
       if (insert.second) {
-        auto page = Page::create(page_size, page_offset);
+        auto page = Page::create(page_size, page_offset, arena);
         cur = pages.insert_commit(*page, commit);
 
         // assume that the caller will write to the range [offset,length),
@@ -217,7 +236,7 @@ class PageSet {
     ::decode(count, p);
     auto cur = pages.end();
     for (unsigned i = 0; i < count; i++) {
-      auto page = Page::create(page_size);
+      auto page = Page::create(page_size, 0, arena);
       page->decode(p, page_size);
       cur = pages.insert_before(cur, *page);
     }
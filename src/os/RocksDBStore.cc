@@ -14,10 +14,13 @@
 #include "rocksdb/slice.h"
 #include "rocksdb/cache.h"
 #include "rocksdb/filter_policy.h"
+#include "rocksdb/statistics.h"
 #include "rocksdb/utilities/convenience.h"
 using std::string;
 #include "common/perf_counters.h"
+#include "common/Mutex.h"
 #include "include/str_map.h"
+#include "include/str_list.h"
 #include "KeyValueDB.h"
 #include "RocksDBStore.h"
 
@@ -94,6 +97,58 @@ int RocksDBStore::ParseOptionsFromString(const string opt_str, rocksdb::Options
   return 0;
 }
 
+// one block cache for every instance in the process, while any is open
+static std::shared_ptr<rocksdb::Cache> get_shared_block_cache(uint64_t size)
+{
+  static Mutex lock("RocksDBStore::shared_block_cache_lock");
+  static std::weak_ptr<rocksdb::Cache> cache;
+  Mutex::Locker l(lock);
+  std::shared_ptr<rocksdb::Cache> c = cache.lock();
+  if (!c) {
+    c = rocksdb::NewLRUCache(size);
+    cache = c;
+  }
+  return c;
+}
+
+int RocksDBStore::set_column_families(const string& spec)
+{
+  map<string, string> cfs;
+  list<string> entries;
+  get_str_list(spec, " \t\n", entries);
+  for (list<string>::iterator p = entries.begin(); p != entries.end(); ++p) {
+    size_t pos = p->find(':');
+    string name = p->substr(0, pos);
+    string opts = pos == string::npos ? string() : p->substr(pos + 1);
+    if (name.empty() || name == rocksdb::kDefaultColumnFamilyName ||
+	cfs.count(name)) {
+      derr << __func__ << " bad column family name '" << name << "'" << dendl;
+      return -EINVAL;
+    }
+    rocksdb::ColumnFamilyOptions cfo;
+    rocksdb::Status status = rocksdb::GetColumnFamilyOptionsFromString(
+      rocksdb::ColumnFamilyOptions(), opts, &cfo);
+    if (!status.ok()) {
+      derr << __func__ << " column family " << name << ": "
+	   << status.ToString() << dendl;
+      return -EINVAL;
+    }
+    cfs[name] = opts;
+  }
+  // a key must map to one family only
+  for (map<string, string>::iterator p = cfs.begin(); p != cfs.end(); ++p) {
+    map<string, string>::iterator q = p;
+    ++q;
+    if (q != cfs.end() && q->first.compare(0, p->first.length(), p->first) == 0) {
+      derr << __func__ << " column family names " << p->first << " and "
+	   << q->first << " overlap" << dendl;
+      return -EINVAL;
+    }
+  }
+  cf_options.swap(cfs);
+  return 0;
+}
+
 int RocksDBStore::init(string _options_str)
 {
   options_str = _options_str;
@@ -117,10 +172,107 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing)
   }
   opt.create_if_missing = create_if_missing;
 
-  status = rocksdb::DB::Open(opt, path, &db);
-  if (!status.ok()) {
-    derr << status.ToString() << dendl;
-    return -EINVAL;
+  if (g_conf->rocksdb_shared_cache_size || g_conf->rocksdb_bloom_bits_per_key > 0) {
+    rocksdb::BlockBasedTableOptions bbto;
+    if (g_conf->rocksdb_shared_cache_size) {
+      block_cache = get_shared_block_cache(g_conf->rocksdb_shared_cache_size);
+      bbto.block_cache = block_cache;
+    }
+    if (g_conf->rocksdb_bloom_bits_per_key > 0)
+      bbto.filter_policy.reset(
+	rocksdb::NewBloomFilterPolicy(g_conf->rocksdb_bloom_bits_per_key));
+    opt.table_factory.reset(rocksdb::NewBlockBasedTableFactory(bbto));
+  }
+  if (g_conf->rocksdb_perf) {
+    dbstats = rocksdb::CreateDBStatistics();
+    opt.statistics = dbstats;
+  }
+
+  // every existing column family has to be opened, configured or not
+  vector<string> existing;
+  status = rocksdb::DB::ListColumnFamilies(rocksdb::DBOptions(opt), path,
+					   &existing);
+  if (!status.ok())
+    existing.clear();  // no db yet
+  if (existing.size() <= 1 && cf_options.empty()) {
+    status = rocksdb::DB::Open(opt, path, &db);
+    if (!status.ok()) {
+      derr << status.ToString() << dendl;
+      return -EINVAL;
+    }
+  } else {
+    vector<rocksdb::ColumnFamilyDescriptor> cfds;
+    cfds.push_back(rocksdb::ColumnFamilyDescriptor(
+		     rocksdb::kDefaultColumnFamilyName,
+		     rocksdb::ColumnFamilyOptions(opt)));
+    for (vector<string>::iterator p = existing.begin();
+	 p != existing.end();
+	 ++p) {
+      if (*p == rocksdb::kDefaultColumnFamilyName)
+	continue;
+      rocksdb::ColumnFamilyOptions cfo(opt);
+      if (cf_options.count(*p)) {
+	rocksdb::GetColumnFamilyOptionsFromString(rocksdb::ColumnFamilyOptions(opt),
+						  cf_options[*p], &cfo);
+      } else {
+	derr << __func__ << " column family " << *p
+	     << " is not configured, opening it with default options" << dendl;
+      }
+      cfds.push_back(rocksdb::ColumnFamilyDescriptor(*p, cfo));
+    }
+    vector<rocksdb::ColumnFamilyHandle*> handles;
+    status = rocksdb::DB::Open(rocksdb::DBOptions(opt), path, cfds, &handles,
+			       &db);
+    if (!status.ok()) {
+      derr << status.ToString() << dendl;
+      return -EINVAL;
+    }
+    default_cf = handles[0];
+    for (unsigned i = 1; i < handles.size(); ++i) {
+      cf_handles[cfds[i].name] = handles[i];
+      cf_by_id[handles[i]->GetID()] = handles[i];
+    }
+
+    for (map<string, string>::iterator p = cf_options.begin();
+	 p != cf_options.end();
+	 ++p) {
+      if (cf_handles.count(p->first))
+	continue;
+      map<string, rocksdb::ColumnFamilyHandle*>::iterator q =
+	cf_handles.upper_bound(p->first);
+      bool overlaps = q != cf_handles.end() &&
+	q->first.compare(0, p->first.length(), p->first) == 0;
+      if (!overlaps && q != cf_handles.begin()) {
+	--q;
+	overlaps = p->first.compare(0, q->first.length(), q->first) == 0;
+      }
+      // don't hide keys that were written before the family existed
+      rocksdb::Iterator *it = db->NewIterator(rocksdb::ReadOptions(),
+					      default_cf);
+      it->Seek(p->first);
+      bool in_use = it->Valid() && it->key().starts_with(p->first);
+      delete it;
+      if (overlaps || in_use) {
+	derr << __func__ << " not creating column family " << p->first
+	     << (overlaps ? ": overlaps an existing one" :
+		 ": default column family already has its keys") << dendl;
+	continue;
+      }
+      rocksdb::ColumnFamilyOptions cfo(opt);
+      rocksdb::GetColumnFamilyOptionsFromString(rocksdb::ColumnFamilyOptions(opt),
+						p->second, &cfo);
+      rocksdb::ColumnFamilyHandle *h;
+      status = db->CreateColumnFamily(cfo, p->first, &h);
+      if (!status.ok()) {
+	derr << __func__ << " creating column family " << p->first << ": "
+	     << status.ToString() << dendl;
+	return -EINVAL;
+      }
+      cf_handles[p->first] = h;
+      cf_by_id[h->GetID()] = h;
+    }
+    lgeneric_dout(cct, 1) << __func__ << " column families "
+			  << cf_handles.size() << dendl;
   }
 
   PerfCountersBuilder plb(g_ceph_context, "rocksdb", l_rocksdb_first, l_rocksdb_last);
@@ -129,10 +281,26 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing)
   plb.add_time_avg(l_rocksdb_get_latency, "rocksdb_get_latency", "Get latency");
   plb.add_time_avg(l_rocksdb_submit_latency, "rocksdb_submit_latency", "Submit Latency");
   plb.add_time_avg(l_rocksdb_submit_sync_latency, "rocksdb_submit_sync_latency", "Submit Sync Latency");
+  plb.add_time_avg(l_rocksdb_submit_batch_latency, "rocksdb_submit_batch_latency", "Submit Batch Latency");
+  plb.add_u64_avg(l_rocksdb_submit_batch_txns, "rocksdb_submit_batch_txns", "Transactions per submitted batch");
   plb.add_u64_counter(l_rocksdb_compact, "rocksdb_compact", "Compactions");
   plb.add_u64_counter(l_rocksdb_compact_range, "rocksdb_compact_range", "Compactions by range");
   plb.add_u64_counter(l_rocksdb_compact_queue_merge, "rocksdb_compact_queue_merge", "Mergings of ranges in compaction queue");
   plb.add_u64(l_rocksdb_compact_queue_len, "rocksdb_compact_queue_len", "Length of compaction queue");
+  plb.add_u64_counter(l_rocksdb_compact_scheduled, "rocksdb_compact_scheduled", "Background compactions of prefixes with many deleted keys");
+  plb.add_u64(l_rocksdb_compact_running, "rocksdb_compact_running", "Whether a queued compaction is running");
+  plb.add_u64(l_rocksdb_compact_deleted_keys, "rocksdb_compact_deleted_keys", "Deleted keys not yet compacted");
+  plb.add_u64(l_rocksdb_block_cache_hit, "rocksdb_block_cache_hit", "Block cache hits");
+  plb.add_u64(l_rocksdb_block_cache_miss, "rocksdb_block_cache_miss", "Block cache misses");
+  plb.add_u64(l_rocksdb_block_cache_usage, "rocksdb_block_cache_usage", "Bytes in the shared block cache");
+  plb.add_u64(l_rocksdb_bloom_useful, "rocksdb_bloom_useful", "Reads avoided by bloom filters");
+  plb.add_u64(l_rocksdb_memtable_hit, "rocksdb_memtable_hit", "Gets served from a memtable");
+  plb.add_u64(l_rocksdb_get_hit_l0, "rocksdb_get_hit_l0", "Gets served from level 0");
+  plb.add_u64(l_rocksdb_get_hit_l1, "rocksdb_get_hit_l1", "Gets served from level 1");
+  plb.add_u64(l_rocksdb_get_hit_l2_and_up, "rocksdb_get_hit_l2_and_up", "Gets served from level 2 or deeper");
+  plb.add_u64(l_rocksdb_compact_read_bytes, "rocksdb_compact_read_bytes", "Bytes read by compaction");
+  plb.add_u64(l_rocksdb_compact_write_bytes, "rocksdb_compact_write_bytes", "Bytes written by compaction");
+  plb.add_u64(l_rocksdb_stall_micros, "rocksdb_stall_micros", "Microseconds writes were stalled");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -149,7 +317,21 @@ int RocksDBStore::_test_init(const string& dir)
   rocksdb::Options options;
   options.create_if_missing = true;
   rocksdb::DB *db;
-  rocksdb::Status status = rocksdb::DB::Open(options, dir, &db);
+  vector<string> names;
+  rocksdb::Status status = rocksdb::DB::ListColumnFamilies(options, dir,
+							   &names);
+  if (status.ok() && names.size() > 1) {
+    vector<rocksdb::ColumnFamilyDescriptor> cfds;
+    for (vector<string>::iterator p = names.begin(); p != names.end(); ++p)
+      cfds.push_back(rocksdb::ColumnFamilyDescriptor(
+		       *p, rocksdb::ColumnFamilyOptions()));
+    vector<rocksdb::ColumnFamilyHandle*> handles;
+    status = rocksdb::DB::Open(options, dir, cfds, &handles, &db);
+    for (unsigned i = 0; i < handles.size(); ++i)
+      delete handles[i];
+  } else {
+    status = rocksdb::DB::Open(options, dir, &db);
+  }
   delete db;
   return status.ok() ? 0 : -EIO;
 }
@@ -159,10 +341,44 @@ RocksDBStore::~RocksDBStore()
   close();
   delete logger;
 
+  // column family handles go before the db
+  for (map<string, rocksdb::ColumnFamilyHandle*>::iterator p = cf_handles.begin();
+       p != cf_handles.end();
+       ++p)
+    delete p->second;
+  delete default_cf;
   // Ensure db is destroyed before dependent db_cache and filterpolicy
   delete db;
 }
 
+rocksdb::ColumnFamilyHandle *RocksDBStore::get_cf(const string& prefix)
+{
+  if (!cf_handles.empty()) {
+    // names don't nest: the only candidate is the last name <= prefix
+    map<string, rocksdb::ColumnFamilyHandle*>::iterator p =
+      cf_handles.upper_bound(prefix);
+    if (p != cf_handles.begin()) {
+      --p;
+      if (prefix.compare(0, p->first.length(), p->first) == 0)
+	return p->second;
+    }
+  }
+  return db->DefaultColumnFamily();
+}
+
+rocksdb::ColumnFamilyHandle *RocksDBStore::get_cf_by_id(uint32_t id)
+{
+  map<uint32_t, rocksdb::ColumnFamilyHandle*>::iterator p = cf_by_id.find(id);
+  if (p == cf_by_id.end())
+    return db->DefaultColumnFamily();
+  return p->second;
+}
+
+rocksdb::ColumnFamilyHandle *RocksDBStore::get_cf_for_key(const string& raw_key)
+{
+  return get_cf(raw_key.substr(0, raw_key.find('\0')));
+}
+
 void RocksDBStore::close()
 {
   // stop compaction thread
@@ -191,7 +407,11 @@ int RocksDBStore::submit_transaction(KeyValueDB::Transaction t)
   utime_t lat = ceph_clock_now(g_ceph_context) - start;
   logger->inc(l_rocksdb_txns);
   logger->tinc(l_rocksdb_submit_latency, lat);
-  return s.ok() ? 0 : -1;
+  _update_stats(start);
+  if (!s.ok())
+    return -1;
+  _queue_range_compactions(_t);
+  return 0;
 }
 
 int RocksDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
@@ -206,8 +426,189 @@ int RocksDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
   utime_t lat = ceph_clock_now(g_ceph_context) - start;
   logger->inc(l_rocksdb_txns);
   logger->tinc(l_rocksdb_submit_sync_latency, lat);
-  return s.ok() ? 0 : -1;
+  _update_stats(start);
+  if (!s.ok())
+    return -1;
+  _queue_range_compactions(_t);
+  return 0;
 }
+
+void RocksDBStore::_queue_range_compactions(RocksDBTransactionImpl *t)
+{
+  // the deleted keys leave tombstones behind that every later scan of
+  // the range has to skip until a compaction drops them
+  for (list< pair<string,string> >::iterator p = t->compact_ranges.begin();
+       p != t->compact_ranges.end();
+       ++p)
+    compact_range_async(p->first, p->second);
+  t->compact_ranges.clear();
+
+  if (!t->deleted.empty()) {
+    Mutex::Locker l(compact_queue_lock);
+    compact_tracker.add(t->deleted);
+    logger->set(l_rocksdb_compact_deleted_keys, compact_tracker.get_total());
+    if (g_conf->rocksdb_compact_deleted_keys && !compact_thread.is_started())
+      compact_thread.create();
+    t->deleted.clear();
+  }
+}
+namespace {
+  // replays the updates of one WriteBatch into another
+  struct WriteBatchAppender : public rocksdb::WriteBatch::Handler {
+    RocksDBStore *store;
+    rocksdb::WriteBatch *dst;
+    WriteBatchAppender(RocksDBStore *s, rocksdb::WriteBatch *d)
+      : store(s), dst(d) {}
+    rocksdb::Status PutCF(uint32_t id, const rocksdb::Slice& key,
+			  const rocksdb::Slice& value) {
+      dst->Put(store->get_cf_by_id(id), key, value);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status MergeCF(uint32_t id, const rocksdb::Slice& key,
+			    const rocksdb::Slice& value) {
+      dst->Merge(store->get_cf_by_id(id), key, value);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status DeleteCF(uint32_t id, const rocksdb::Slice& key) {
+      dst->Delete(store->get_cf_by_id(id), key);
+      return rocksdb::Status::OK();
+    }
+  };
+
+  // Iterates over several column families as one keyspace.  Their key
+  // ranges never overlap, so there are no duplicates to resolve.
+  class MergedIterator : public rocksdb::Iterator {
+    vector<rocksdb::Iterator*> its;
+    rocksdb::Iterator *cur;
+    bool forward;
+
+    void find_smallest() {
+      cur = NULL;
+      for (unsigned i = 0; i < its.size(); ++i)
+	if (its[i]->Valid() && (!cur || its[i]->key().compare(cur->key()) < 0))
+	  cur = its[i];
+    }
+    void find_largest() {
+      cur = NULL;
+      for (unsigned i = 0; i < its.size(); ++i)
+	if (its[i]->Valid() && (!cur || its[i]->key().compare(cur->key()) > 0))
+	  cur = its[i];
+    }
+
+  public:
+    MergedIterator(const vector<rocksdb::Iterator*>& i)
+      : its(i), cur(NULL), forward(true) {}
+    ~MergedIterator() {
+      for (unsigned i = 0; i < its.size(); ++i)
+	delete its[i];
+    }
+
+    bool Valid() const {
+      return cur != NULL;
+    }
+    void SeekToFirst() {
+      for (unsigned i = 0; i < its.size(); ++i)
+	its[i]->SeekToFirst();
+      forward = true;
+      find_smallest();
+    }
+    void SeekToLast() {
+      for (unsigned i = 0; i < its.size(); ++i)
+	its[i]->SeekToLast();
+      forward = false;
+      find_largest();
+    }
+    void Seek(const rocksdb::Slice& target) {
+      for (unsigned i = 0; i < its.size(); ++i)
+	its[i]->Seek(target);
+      forward = true;
+      find_smallest();
+    }
+    void Next() {
+      assert(cur);
+      if (!forward) {
+	// the others sit before the current key; no one else has it
+	string k = cur->key().ToString();
+	for (unsigned i = 0; i < its.size(); ++i)
+	  if (its[i] != cur)
+	    its[i]->Seek(k);
+	forward = true;
+      }
+      cur->Next();
+      find_smallest();
+    }
+    void Prev() {
+      assert(cur);
+      if (forward) {
+	string k = cur->key().ToString();
+	for (unsigned i = 0; i < its.size(); ++i) {
+	  if (its[i] == cur)
+	    continue;
+	  its[i]->Seek(k);
+	  if (its[i]->Valid())
+	    its[i]->Prev();
+	  else
+	    its[i]->SeekToLast();
+	}
+	forward = false;
+      }
+      cur->Prev();
+      find_largest();
+    }
+    rocksdb::Slice key() const {
+      return cur->key();
+    }
+    rocksdb::Slice value() const {
+      return cur->value();
+    }
+    rocksdb::Status status() const {
+      for (unsigned i = 0; i < its.size(); ++i)
+	if (!its[i]->status().ok())
+	  return its[i]->status();
+      return rocksdb::Status::OK();
+    }
+  };
+}
+
+int RocksDBStore::submit_transactions(
+  const vector<KeyValueDB::Transaction>& tv,
+  bool sync)
+{
+  if (tv.empty())
+    return 0;
+  if (tv.size() == 1)
+    return sync ? submit_transaction_sync(tv[0]) : submit_transaction(tv[0]);
+
+  utime_t start = ceph_clock_now(g_ceph_context);
+  rocksdb::WriteBatch bat;
+  WriteBatchAppender appender(this, &bat);
+  for (vector<KeyValueDB::Transaction>::const_iterator p = tv.begin();
+       p != tv.end();
+       ++p) {
+    RocksDBTransactionImpl * _t =
+      static_cast<RocksDBTransactionImpl *>(p->get());
+    rocksdb::Status s = _t->bat->Iterate(&appender);
+    if (!s.ok())
+      return -1;
+  }
+  rocksdb::WriteOptions woptions;
+  woptions.sync = sync;
+  woptions.disableWAL = disableWAL;
+  rocksdb::Status s = db->Write(woptions, &bat);
+  utime_t lat = ceph_clock_now(g_ceph_context) - start;
+  logger->inc(l_rocksdb_txns, tv.size());
+  logger->tinc(l_rocksdb_submit_batch_latency, lat);
+  logger->inc(l_rocksdb_submit_batch_txns, tv.size());
+  _update_stats(start);
+  if (!s.ok())
+    return -1;
+  for (vector<KeyValueDB::Transaction>::const_iterator p = tv.begin();
+       p != tv.end();
+       ++p)
+    _queue_range_compactions(static_cast<RocksDBTransactionImpl *>(p->get()));
+  return 0;
+}
+
 int RocksDBStore::get_info_log_level(string info_log_level)
 {
   if (info_log_level == "debug") {
@@ -242,25 +643,56 @@ void RocksDBStore::RocksDBTransactionImpl::set(
   string key = combine_strings(prefix, k);
   //bufferlist::c_str() is non-constant, so we need to make a copy
   bufferlist val = to_set_bl;
-  bat->Delete(rocksdb::Slice(key));
-  bat->Put(rocksdb::Slice(key),
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf(prefix);
+  bat->Delete(cf, rocksdb::Slice(key));
+  bat->Put(cf, rocksdb::Slice(key),
 	  rocksdb::Slice(val.c_str(), val.length()));
 }
 
 void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const string &k)
 {
-  bat->Delete(combine_strings(prefix, k));
+  bat->Delete(db->get_cf(prefix), combine_strings(prefix, k));
+  ++deleted[prefix];
 }
 
 void RocksDBStore::RocksDBTransactionImpl::rmkeys_by_prefix(const string &prefix)
 {
+  uint64_t n = 0;
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf(prefix);
   KeyValueDB::Iterator it = db->get_iterator(prefix);
   for (it->seek_to_first();
        it->valid();
        it->next()) {
-    bat->Delete(combine_strings(prefix, it->key()));
+    bat->Delete(cf, combine_strings(prefix, it->key()));
+    ++n;
   }
+  if (g_conf->rocksdb_compact_on_range_delete &&
+      n >= g_conf->rocksdb_compact_on_range_delete)
+    compact_ranges.push_back(make_pair(prefix, past_prefix(prefix)));
+  else if (n)
+    deleted[prefix] += n;
+}
+
+void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
+							 const string &start,
+							 const string &end)
+{
+  uint64_t n = 0;
+  rocksdb::ColumnFamilyHandle *cf = db->get_cf(prefix);
+  KeyValueDB::Iterator it = db->get_iterator(prefix);
+  for (it->lower_bound(start);
+       it->valid() && it->key() < end;
+       it->next()) {
+    bat->Delete(cf, combine_strings(prefix, it->key()));
+    ++n;
+  }
+  if (g_conf->rocksdb_compact_on_range_delete &&
+      n >= g_conf->rocksdb_compact_on_range_delete)
+    compact_ranges.push_back(make_pair(combine_strings(prefix, start),
+				       combine_strings(prefix, end)));
+  else if (n)
+    deleted[prefix] += n;
 }
 
 int RocksDBStore::get(
@@ -282,9 +714,104 @@ int RocksDBStore::get(
   utime_t lat = ceph_clock_now(g_ceph_context) - start;
   logger->inc(l_rocksdb_gets);
   logger->tinc(l_rocksdb_get_latency, lat);
+  _update_stats(start);
   return 0;
 }
 
+void RocksDBStore::_update_stats(const utime_t& now)
+{
+  // the tickers are cheap to read, but not on every op
+  if ((uint32_t)now.sec() == stats_stamp.read())
+    return;
+  stats_stamp.set(now.sec());
+  if (block_cache)
+    logger->set(l_rocksdb_block_cache_usage, block_cache->GetUsage());
+  if (!dbstats)
+    return;
+  logger->set(l_rocksdb_block_cache_hit,
+	      dbstats->getTickerCount(rocksdb::BLOCK_CACHE_HIT));
+  logger->set(l_rocksdb_block_cache_miss,
+	      dbstats->getTickerCount(rocksdb::BLOCK_CACHE_MISS));
+  logger->set(l_rocksdb_bloom_useful,
+	      dbstats->getTickerCount(rocksdb::BLOOM_FILTER_USEFUL));
+  logger->set(l_rocksdb_memtable_hit,
+	      dbstats->getTickerCount(rocksdb::MEMTABLE_HIT));
+  logger->set(l_rocksdb_get_hit_l0,
+	      dbstats->getTickerCount(rocksdb::GET_HIT_L0));
+  logger->set(l_rocksdb_get_hit_l1,
+	      dbstats->getTickerCount(rocksdb::GET_HIT_L1));
+  logger->set(l_rocksdb_get_hit_l2_and_up,
+	      dbstats->getTickerCount(rocksdb::GET_HIT_L2_AND_UP));
+  logger->set(l_rocksdb_compact_read_bytes,
+	      dbstats->getTickerCount(rocksdb::COMPACT_READ_BYTES));
+  logger->set(l_rocksdb_compact_write_bytes,
+	      dbstats->getTickerCount(rocksdb::COMPACT_WRITE_BYTES));
+  logger->set(l_rocksdb_stall_micros,
+	      dbstats->getTickerCount(rocksdb::STALL_MICROS));
+}
+
+void RocksDBStore::get_statistics(Formatter *f)
+{
+  f->open_object_section("rocksdb");
+  f->dump_string("path", path);
+  if (block_cache) {
+    f->dump_unsigned("shared_cache_capacity", block_cache->GetCapacity());
+    f->dump_unsigned("shared_cache_usage", block_cache->GetUsage());
+  }
+  {
+    Mutex::Locker l(compact_queue_lock);
+    f->open_object_section("compaction");
+    f->dump_unsigned("queue_len", compact_queue.size());
+    compact_tracker.dump(f);
+    f->close_section();
+  }
+  if (dbstats) {
+    f->open_object_section("tickers");
+    for (vector<pair<rocksdb::Tickers, string> >::const_iterator p =
+	   rocksdb::TickersNameMap.begin();
+	 p != rocksdb::TickersNameMap.end();
+	 ++p)
+      f->dump_unsigned(p->second.c_str(), dbstats->getTickerCount(p->first));
+    f->close_section();
+    f->open_object_section("histograms");
+    for (vector<pair<rocksdb::Histograms, string> >::const_iterator p =
+	   rocksdb::HistogramsNameMap.begin();
+	 p != rocksdb::HistogramsNameMap.end();
+	 ++p) {
+      rocksdb::HistogramData d;
+      dbstats->histogramData(p->first, &d);
+      f->open_object_section(p->second.c_str());
+      f->dump_float("median", d.median);
+      f->dump_float("p95", d.percentile95);
+      f->dump_float("p99", d.percentile99);
+      f->dump_float("avg", d.average);
+      f->dump_float("stddev", d.standard_deviation);
+      f->close_section();
+    }
+    f->close_section();
+  }
+  string s;
+  f->open_object_section("column_families");
+  f->open_object_section(rocksdb::kDefaultColumnFamilyName.c_str());
+  if (db->GetProperty("rocksdb.estimate-num-keys", &s))
+    f->dump_string("estimate_num_keys", s);
+  if (db->GetProperty("rocksdb.stats", &s))
+    f->dump_string("stats", s);
+  f->close_section();
+  for (map<string, rocksdb::ColumnFamilyHandle*>::iterator p = cf_handles.begin();
+       p != cf_handles.end();
+       ++p) {
+    f->open_object_section(p->first.c_str());
+    if (db->GetProperty(p->second, "rocksdb.estimate-num-keys", &s))
+      f->dump_string("estimate_num_keys", s);
+    if (db->GetProperty(p->second, "rocksdb.stats", &s))
+      f->dump_string("stats", s);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
 string RocksDBStore::combine_strings(const string &prefix, const string &value)
 {
   string out = prefix;
@@ -318,12 +845,18 @@ void RocksDBStore::compact()
 {
   logger->inc(l_rocksdb_compact);
   db->CompactRange(NULL, NULL);
+  for (map<string, rocksdb::ColumnFamilyHandle*>::iterator p = cf_handles.begin();
+       p != cf_handles.end();
+       ++p)
+    db->CompactRange(p->second, NULL, NULL);
 }
 
 
 void RocksDBStore::compact_thread_entry()
 {
   compact_queue_lock.Lock();
+  utime_t last_tick = ceph_clock_now(g_ceph_context);
+  uint64_t last_txns = logger->get(l_rocksdb_txns);
   while (!compact_queue_stop) {
     while (!compact_queue.empty()) {
       pair<string,string> range = compact_queue.front();
@@ -331,11 +864,41 @@ void RocksDBStore::compact_thread_entry()
       logger->set(l_rocksdb_compact_queue_len, compact_queue.size());
       compact_queue_lock.Unlock();
       logger->inc(l_rocksdb_compact_range);
+      logger->set(l_rocksdb_compact_running, 1);
       compact_range(range.first, range.second);
+      logger->set(l_rocksdb_compact_running, 0);
       compact_queue_lock.Lock();
       continue;
     }
-    compact_queue_cond.Wait(compact_queue_lock);
+    if (!g_conf->rocksdb_compact_deleted_keys) {
+      compact_queue_cond.Wait(compact_queue_lock);
+      continue;
+    }
+
+    // every rocksdb_compact_interval, if the store was idle, compact the
+    // prefix with the most deleted keys.  one at a time, so that
+    // foreground work coming back does not wait behind a long queue.
+    utime_t interval;
+    interval.set_from_double(g_conf->rocksdb_compact_interval);
+    compact_queue_cond.WaitInterval(g_ceph_context, compact_queue_lock,
+				    interval);
+    utime_t now = ceph_clock_now(g_ceph_context);
+    if (compact_queue_stop || now - last_tick < interval)
+      continue;
+    uint64_t txns = logger->get(l_rocksdb_txns);
+    string prefix;
+    if (compact_queue.empty() &&
+	txns - last_txns <= g_conf->rocksdb_compact_idle_txns &&
+	compact_tracker.pick(g_conf->rocksdb_compact_deleted_keys, &prefix)) {
+      lgeneric_dout(cct, 10) << __func__ << " compacting prefix " << prefix
+			     << dendl;
+      compact_tracker.clear(prefix);
+      logger->set(l_rocksdb_compact_deleted_keys, compact_tracker.get_total());
+      logger->inc(l_rocksdb_compact_scheduled);
+      compact_queue.push_back(make_pair(prefix, past_prefix(prefix)));
+    }
+    last_tick = now;
+    last_txns = txns;
   }
   compact_queue_lock.Unlock();
 }
@@ -393,6 +956,18 @@ void RocksDBStore::compact_range(const string& start, const string& end)
     rocksdb::Slice cstart(start);
     rocksdb::Slice cend(end);
     db->CompactRange(&cstart, &cend);
+    if (cf_handles.empty())
+      return;
+    // plus any column family the range touches
+    rocksdb::ColumnFamilyHandle *first = get_cf_for_key(start);
+    if (first != db->DefaultColumnFamily())
+      db->CompactRange(first, &cstart, &cend);
+    for (map<string, rocksdb::ColumnFamilyHandle*>::iterator p =
+	   cf_handles.upper_bound(start);
+	 p != cf_handles.end() && p->first < end;
+	 ++p)
+      if (p->second != first)
+	db->CompactRange(p->second, &cstart, &cend);
 }
 RocksDBStore::RocksDBWholeSpaceIteratorImpl::~RocksDBWholeSpaceIteratorImpl()
 {
@@ -489,17 +1064,57 @@ string RocksDBStore::past_prefix(const string &prefix)
 }
 
 
+rocksdb::Iterator *RocksDBStore::new_iterator(const rocksdb::Snapshot *snapshot)
+{
+  rocksdb::ReadOptions options;
+  options.snapshot = snapshot;
+  if (cf_handles.empty())
+    return db->NewIterator(options);
+  vector<rocksdb::Iterator*> its;
+  its.push_back(db->NewIterator(options, db->DefaultColumnFamily()));
+  for (map<string, rocksdb::ColumnFamilyHandle*>::iterator p = cf_handles.begin();
+       p != cf_handles.end();
+       ++p)
+    its.push_back(db->NewIterator(options, p->second));
+  return new MergedIterator(its);
+}
+
 RocksDBStore::WholeSpaceIterator RocksDBStore::_get_iterator()
 {
+  return std::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
+    new RocksDBWholeSpaceIteratorImpl(new_iterator(NULL))
+  );
+}
+
+RocksDBStore::WholeSpaceIterator RocksDBStore::_get_snapshot_iterator()
+{
+  const rocksdb::Snapshot *snapshot;
+
+  snapshot = db->GetSnapshot();
+
+  return std::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
+    new RocksDBSnapshotIteratorImpl(db, snapshot,
+      new_iterator(snapshot))
+  );
+}
+
+RocksDBStore::WholeSpaceIterator RocksDBStore::_get_prefix_iterator(
+  const string &prefix)
+{
+  if (cf_handles.empty())
+    return _get_iterator();
   return std::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
     new RocksDBWholeSpaceIteratorImpl(
-      db->NewIterator(rocksdb::ReadOptions())
+      db->NewIterator(rocksdb::ReadOptions(), get_cf(prefix))
     )
   );
 }
 
-RocksDBStore::WholeSpaceIterator RocksDBStore::_get_snapshot_iterator()
+RocksDBStore::WholeSpaceIterator RocksDBStore::_get_prefix_snapshot_iterator(
+  const string &prefix)
 {
+  if (cf_handles.empty())
+    return _get_snapshot_iterator();
   const rocksdb::Snapshot *snapshot;
   rocksdb::ReadOptions options;
 
@@ -508,7 +1123,7 @@ RocksDBStore::WholeSpaceIterator RocksDBStore::_get_snapshot_iterator()
 
   return std::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
     new RocksDBSnapshotIteratorImpl(db, snapshot,
-      db->NewIterator(options))
+      db->NewIterator(options, get_cf(prefix)))
   );
 }
 
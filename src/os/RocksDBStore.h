@@ -6,6 +6,7 @@
 #include "include/types.h"
 #include "include/buffer.h"
 #include "KeyValueDB.h"
+#include "KVCompactionTracker.h"
 #include <set>
 #include <map>
 #include <string>
@@ -17,6 +18,7 @@
 #include "common/dout.h"
 #include "include/assert.h"
 #include "common/Formatter.h"
+#include "include/atomic.h"
 
 #include "common/ceph_context.h"
 class PerfCounters;
@@ -28,10 +30,26 @@ enum {
   l_rocksdb_get_latency,
   l_rocksdb_submit_latency,
   l_rocksdb_submit_sync_latency,
+  l_rocksdb_submit_batch_latency,
+  l_rocksdb_submit_batch_txns,
   l_rocksdb_compact,
   l_rocksdb_compact_range,
   l_rocksdb_compact_queue_merge,
   l_rocksdb_compact_queue_len,
+  l_rocksdb_compact_scheduled,
+  l_rocksdb_compact_running,
+  l_rocksdb_compact_deleted_keys,
+  l_rocksdb_block_cache_hit,
+  l_rocksdb_block_cache_miss,
+  l_rocksdb_block_cache_usage,
+  l_rocksdb_bloom_useful,
+  l_rocksdb_memtable_hit,
+  l_rocksdb_get_hit_l0,
+  l_rocksdb_get_hit_l1,
+  l_rocksdb_get_hit_l2_and_up,
+  l_rocksdb_compact_read_bytes,
+  l_rocksdb_compact_write_bytes,
+  l_rocksdb_stall_micros,
   l_rocksdb_last,
 };
 
@@ -43,6 +61,8 @@ namespace rocksdb{
   class Slice;
   class WriteBatch;
   class Iterator;
+  class ColumnFamilyHandle;
+  class Statistics;
   struct Options;
 }
 /**
@@ -56,11 +76,34 @@ class RocksDBStore : public KeyValueDB {
   string options_str;
   int do_open(ostream &out, bool create_if_missing);
 
+  /**
+   * column families
+   *
+   * Keys whose prefix starts with a column family's name are kept in
+   * that family instead of the default one.  Names never nest, so each
+   * key belongs to exactly one family and the families cover disjoint
+   * key ranges.
+   */
+  map<string, string> cf_options;   ///< configured: name -> rocksdb options
+  map<string, rocksdb::ColumnFamilyHandle*> cf_handles;  ///< open: name -> cf
+  map<uint32_t, rocksdb::ColumnFamilyHandle*> cf_by_id;
+  rocksdb::ColumnFamilyHandle *default_cf;  ///< only set with column families
+
+  rocksdb::ColumnFamilyHandle *get_cf_for_key(const string& raw_key);
+  rocksdb::Iterator *new_iterator(const rocksdb::Snapshot *snapshot);
+
+  std::shared_ptr<rocksdb::Statistics> dbstats;  ///< if rocksdb_perf
+  std::shared_ptr<rocksdb::Cache> block_cache;   ///< process-wide, if shared
+  atomic_t stats_stamp;  ///< second the perf counters were last refreshed
+  void _update_stats(const utime_t& now);
+
   // manage async compactions
   Mutex compact_queue_lock;
   Cond compact_queue_cond;
   list< pair<string,string> > compact_queue;
   bool compact_queue_stop;
+  /// deletions not yet compacted, for the background scheduler
+  KVCompactionTracker compact_tracker;
   class CompactThread : public Thread {
     RocksDBStore *db;
   public:
@@ -85,6 +128,9 @@ public:
 
   int tryInterpret(const string key, const string val, rocksdb::Options &opt);
   int ParseOptionsFromString(const string opt_str, rocksdb::Options &opt);
+  int set_column_families(const string& spec);
+  rocksdb::ColumnFamilyHandle *get_cf(const string& prefix);
+  rocksdb::ColumnFamilyHandle *get_cf_by_id(uint32_t id);
   static int _test_init(const string& dir);
   int init(string options_str);
   /// compact rocksdb for all keys with a given prefix
@@ -103,11 +149,14 @@ public:
   }
   int get_info_log_level(string info_log_level);
 
+  void get_statistics(Formatter *f);
+
   RocksDBStore(CephContext *c, const string &path) :
     cct(c),
     logger(NULL),
     path(path),
     db(NULL),
+    default_cf(NULL),
     compact_queue_lock("RocksDBStore::compact_thread_lock"),
     compact_queue_stop(false),
     compact_thread(this),
@@ -146,6 +195,15 @@ public:
     void rmkeys_by_prefix(
       const string &prefix
       );
+    void rm_range_keys(
+      const string &prefix,
+      const string &start,
+      const string &end);
+
+    /// removed ranges big enough to be worth compacting once committed
+    list< pair<string,string> > compact_ranges;
+    /// keys removed per prefix, other than in compact_ranges
+    map<string, uint64_t> deleted;
   };
 
   KeyValueDB::Transaction get_transaction() {
@@ -155,6 +213,9 @@ public:
 
   int submit_transaction(KeyValueDB::Transaction t);
   int submit_transaction_sync(KeyValueDB::Transaction t);
+  void _queue_range_compactions(RocksDBTransactionImpl *t);
+  int submit_transactions(const vector<KeyValueDB::Transaction>& tv,
+			  bool sync);
   int get(
     const string &prefix,
     const std::set<string> &key,
@@ -275,6 +336,10 @@ protected:
 
   WholeSpaceIterator _get_snapshot_iterator();
 
+  WholeSpaceIterator _get_prefix_iterator(const string &prefix);
+
+  WholeSpaceIterator _get_prefix_snapshot_iterator(const string &prefix);
+
 };
 
 #endif
@@ -8,6 +8,10 @@
 
 WBThrottle::WBThrottle(CephContext *cct) :
   cur_ios(0), cur_size(0),
+  adaptive(false), adaptive_target(0),
+  depth(1), max_depth(1),
+  min_lat(0), avg_lat(0), bw(0), iops(0),
+  sample_bytes(0), sample_ios(0), since_adjust(0),
   cct(cct),
   logger(NULL),
   stopping(true),
@@ -28,6 +32,10 @@ WBThrottle::WBThrottle(CephContext *cct) :
   b.add_u64(l_wbthrottle_ios_wb, "ios_wb", "Written operations");
   b.add_u64(l_wbthrottle_inodes_dirtied, "inodes_dirtied", "Entries waiting for write");
   b.add_u64(l_wbthrottle_inodes_wb, "inodes_wb", "Written entries");
+  b.add_time_avg(l_wbthrottle_flush_lat, "flush_latency", "Object flush latency");
+  b.add_u64(l_wbthrottle_depth, "flush_depth", "Flushes allowed in flight");
+  b.add_u64(l_wbthrottle_bw, "flush_bw", "Measured flush throughput (bytes/sec)");
+  b.add_u64(l_wbthrottle_bytes_limit, "bytes_start_flusher", "Dirty data that starts the flusher");
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
   for (unsigned i = l_wbthrottle_first + 1; i != l_wbthrottle_last; ++i)
@@ -78,6 +86,9 @@ const char** WBThrottle::get_tracked_conf_keys() const
     "filestore_wbthrottle_xfs_ios_hard_limit",
     "filestore_wbthrottle_xfs_inodes_start_flusher",
     "filestore_wbthrottle_xfs_inodes_hard_limit",
+    "filestore_wbthrottle_adaptive",
+    "filestore_wbthrottle_adaptive_target",
+    "filestore_wbthrottle_adaptive_max_depth",
     NULL
   };
   return KEYS;
@@ -115,9 +126,102 @@ void WBThrottle::set_from_conf()
   } else {
     assert(0 == "invalid value for fs");
   }
+  conf_size_limits = size_limits;
+  conf_io_limits = io_limits;
+
+  adaptive = cct->_conf->filestore_wbthrottle_adaptive;
+  adaptive_target = cct->_conf->filestore_wbthrottle_adaptive_target;
+  max_depth = MAX(cct->_conf->filestore_wbthrottle_adaptive_max_depth, 1);
+#ifndef HAVE_SYNC_FILE_RANGE
+  max_depth = 1;  // no way to start writeback without waiting for it
+#endif
+  if (!adaptive)
+    depth = 1;
+  else if (depth > max_depth)
+    depth = max_depth;
+  if (adaptive)
+    adapt_limits();
+  if (logger) {
+    logger->set(l_wbthrottle_depth, depth);
+    logger->set(l_wbthrottle_bytes_limit, size_limits.first);
+  }
   cond.Signal();
 }
 
+void WBThrottle::adapt_limits()
+{
+  assert(lock.is_locked());
+  if (bw <= 0 || adaptive_target <= 0)
+    return;
+  // dirty data the device can write back in about adaptive_target
+  // seconds; flushing starts there and writers block at twice that
+  uint64_t start = bw * adaptive_target;
+  uint64_t floor = 4 << 20;
+  if (start < floor)
+    start = floor;
+  if (start > conf_size_limits.second / 2)
+    start = conf_size_limits.second / 2;
+  size_limits.first = start;
+  size_limits.second = MIN(start * 2, conf_size_limits.second);
+
+  uint64_t ios = iops * adaptive_target;
+  if (ios < 16)
+    ios = 16;
+  if (ios > conf_io_limits.second / 2)
+    ios = conf_io_limits.second / 2;
+  io_limits.first = ios;
+  io_limits.second = MIN(ios * 2, conf_io_limits.second);
+}
+
+void WBThrottle::update_model(const Flush &f, utime_t now)
+{
+  assert(lock.is_locked());
+  double lat = now - f.start;
+  if (min_lat <= 0 || lat < min_lat)
+    min_lat = lat;
+  else
+    min_lat += (lat - min_lat) / 64;  // let it drift up if the device slows
+  if (avg_lat <= 0)
+    avg_lat = lat;
+  else
+    avg_lat += (lat - avg_lat) / 8;
+
+  sample_bytes += f.wb.size;
+  sample_ios += f.wb.ios;
+  if (last_sample == utime_t()) {
+    last_sample = f.start;
+  }
+  double dt = now - last_sample;
+  if (dt >= .1) {
+    double b = sample_bytes / dt, i = sample_ios / dt;
+    if (bw <= 0) {
+      bw = b;
+      iops = i;
+    } else {
+      bw += (b - bw) / 4;
+      iops += (i - iops) / 4;
+    }
+    sample_bytes = sample_ios = 0;
+    last_sample = now;
+    adapt_limits();
+    logger->set(l_wbthrottle_bw, bw);
+    logger->set(l_wbthrottle_bytes_limit, size_limits.first);
+  }
+
+  // once per depth completions: deeper while latency stays near the
+  // best seen (the device has idle capacity), shallower when it climbs
+  if (++since_adjust >= depth) {
+    since_adjust = 0;
+    if (avg_lat > 2 * min_lat) {
+      if (depth > 1)
+	--depth;
+    } else if (depth < max_depth) {
+      ++depth;
+    }
+    logger->set(l_wbthrottle_depth, depth);
+  }
+}
+
 void WBThrottle::handle_conf_change(const md_config_t *conf,
 				    const std::set<std::string> &changed)
 {
@@ -130,56 +234,94 @@ void WBThrottle::handle_conf_change(const md_config_t *conf,
   }
 }
 
-bool WBThrottle::get_next_should_flush(
-  boost::tuple<ghobject_t, FDRef, PendingWB> *next)
+void WBThrottle::pop_flush(Flush *f)
 {
   assert(lock.is_locked());
-  assert(next);
-  while (!stopping && !beyond_limit())
-         cond.Wait(lock);
-  if (stopping)
-    return false;
-  assert(!pending_wbs.empty());
   ghobject_t obj(pop_object());
-  
   ceph::unordered_map<ghobject_t, pair<PendingWB, FDRef> >::iterator i =
     pending_wbs.find(obj);
-  *next = boost::make_tuple(obj, i->second.second, i->second.first);
+  f->oid = obj;
+  f->fd = i->second.second;
+  f->wb = i->second.first;
   pending_wbs.erase(i);
-  return true;
-}
 
+  clearing.insert(f->oid);
+  cur_ios -= f->wb.ios;
+  logger->dec(l_wbthrottle_ios_dirtied, f->wb.ios);
+  logger->inc(l_wbthrottle_ios_wb, f->wb.ios);
+  cur_size -= f->wb.size;
+  logger->dec(l_wbthrottle_bytes_dirtied, f->wb.size);
+  logger->inc(l_wbthrottle_bytes_wb, f->wb.size);
+  logger->dec(l_wbthrottle_inodes_dirtied);
+  logger->inc(l_wbthrottle_inodes_wb);
+}
 
-void *WBThrottle::entry()
+void WBThrottle::start_flush(Flush &f)
 {
-  Mutex::Locker l(lock);
-  boost::tuple<ghobject_t, FDRef, PendingWB> wb;
-  while (get_next_should_flush(&wb)) {
-    clearing = wb.get<0>();
-    cur_ios -= wb.get<2>().ios;
-    logger->dec(l_wbthrottle_ios_dirtied, wb.get<2>().ios);
-    logger->inc(l_wbthrottle_ios_wb, wb.get<2>().ios);
-    cur_size -= wb.get<2>().size;
-    logger->dec(l_wbthrottle_bytes_dirtied, wb.get<2>().size);
-    logger->inc(l_wbthrottle_bytes_wb, wb.get<2>().size);
-    logger->dec(l_wbthrottle_inodes_dirtied);
-    logger->inc(l_wbthrottle_inodes_wb);
+  assert(lock.is_locked());
+  f.start = ceph_clock_now(cct);
+#ifdef HAVE_SYNC_FILE_RANGE
+  if (adaptive) {
     lock.Unlock();
+    ::sync_file_range(**f.fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    lock.Lock();
+  }
+#endif
+}
+
+void WBThrottle::finish_flush(Flush &f)
+{
+  assert(lock.is_locked());
+  lock.Unlock();
 #ifdef HAVE_FDATASYNC
-    ::fdatasync(**wb.get<1>());
+  ::fdatasync(**f.fd);
 #else
-    ::fsync(**wb.get<1>());
+  ::fsync(**f.fd);
 #endif
 #ifdef HAVE_POSIX_FADVISE
-    if (g_conf->filestore_fadvise && wb.get<2>().nocache) {
-      int fa_r = posix_fadvise(**wb.get<1>(), 0, 0, POSIX_FADV_DONTNEED);
-      assert(fa_r == 0);
-    }
+  if (g_conf->filestore_fadvise && f.wb.nocache) {
+    int fa_r = posix_fadvise(**f.fd, 0, 0, POSIX_FADV_DONTNEED);
+    assert(fa_r == 0);
+  }
 #endif
-    lock.Lock();
-    clearing = ghobject_t();
-    cond.Signal();
-    wb = boost::tuple<ghobject_t, FDRef, PendingWB>();
+  utime_t now = ceph_clock_now(cct);
+  lock.Lock();
+  logger->tinc(l_wbthrottle_flush_lat, now - f.start);
+  if (adaptive)
+    update_model(f, now);
+  clearing.erase(f.oid);
+  cond.SignalAll();
+}
+
+void *WBThrottle::entry()
+{
+  Mutex::Locker l(lock);
+  list<Flush> inflight;
+  while (true) {
+    if (inflight.empty()) {
+      // wait for the limits to be crossed
+      while (!stopping && !beyond_limit())
+	cond.Wait(lock);
+      if (stopping)
+	break;
+      assert(!pending_wbs.empty());
+      inflight.push_back(Flush());
+      pop_flush(&inflight.back());
+      start_flush(inflight.back());
+    }
+    // keep up to depth flushes going
+    while (inflight.size() < depth && !stopping && beyond_limit() &&
+	   !lru.empty()) {
+      inflight.push_back(Flush());
+      pop_flush(&inflight.back());
+      start_flush(inflight.back());
+    }
+    finish_flush(inflight.front());
+    inflight.pop_front();
+  }
+  while (!inflight.empty()) {
+    finish_flush(inflight.front());
+    inflight.pop_front();
   }
   return 0;
 }
@@ -241,7 +383,7 @@ void WBThrottle::clear()
 void WBThrottle::clear_object(const ghobject_t &hoid)
 {
   Mutex::Locker l(lock);
-  while (clearing == hoid)
+  while (clearing.count(hoid))
     cond.Wait(lock);
   ceph::unordered_map<ghobject_t, pair<PendingWB, FDRef> >::iterator i =
     pending_wbs.find(hoid);
@@ -262,7 +404,7 @@ void WBThrottle::clear_object(const ghobject_t &hoid)
 void WBThrottle::throttle()
 {
   Mutex::Locker l(lock);
-  while (!stopping && beyond_limit()) {
+  while (!stopping && (adaptive ? beyond_hard_limit() : beyond_limit())) {
     cond.Wait(lock);
   }
 }
@@ -23,6 +23,8 @@
 #include "common/hobject.h"
 #include "include/interval_set.h"
 #include "FDCache.h"
+#include "common/Mutex.h"
+#include "common/Cond.h"
 #include "common/Thread.h"
 #include "common/ceph_context.h"
 
@@ -35,6 +37,10 @@ enum {
   l_wbthrottle_ios_wb,
   l_wbthrottle_inodes_dirtied,
   l_wbthrottle_inodes_wb,
+  l_wbthrottle_flush_lat,
+  l_wbthrottle_depth,
+  l_wbthrottle_bw,
+  l_wbthrottle_bytes_limit,
   l_wbthrottle_last
 };
 
@@ -42,9 +48,19 @@ enum {
  * WBThrottle
  *
  * Tracks, throttles, and flushes outstanding IO
+ *
+ * In adaptive mode (filestore_wbthrottle_adaptive) the flusher keeps
+ * up to depth flushes in flight: it starts writeback on each object
+ * with sync_file_range(SYNC_FILE_RANGE_WRITE) and only then waits for
+ * the oldest with fdatasync, so the device sees a queue instead of
+ * one object at a time.  The measured flush latency and throughput set
+ * both the depth (grown while latency stays near the best seen,
+ * shrunk when it climbs) and the byte and io limits (about
+ * filestore_wbthrottle_adaptive_target seconds of flushing, capped by
+ * the configured hard limits).  Writers then block on the hard limits.
  */
 class WBThrottle : Thread, public md_config_obs_t {
-  ghobject_t clearing;
+  set<ghobject_t, ghobject_t::BitwiseComparator> clearing; ///< being flushed
   /* *_limits.first is the start_flusher limit and
    * *_limits.second is the hard limit
    */
@@ -61,6 +77,19 @@ class WBThrottle : Thread, public md_config_obs_t {
   uint64_t cur_ios;  /// Currently unflushed IOs
   uint64_t cur_size; /// Currently unflushed bytes
 
+  /// configured limits, the adaptive limits stay within these
+  pair<uint64_t, uint64_t> conf_size_limits, conf_io_limits;
+
+  bool adaptive;
+  double adaptive_target;
+  unsigned depth, max_depth;  ///< flushes allowed in flight
+  double min_lat;             ///< best recent flush latency
+  double avg_lat;
+  double bw, iops;            ///< measured flush throughput
+  utime_t last_sample;
+  uint64_t sample_bytes, sample_ios;
+  unsigned since_adjust;
+
   /**
    * PendingWB tracks the ios pending on an object.
    */
@@ -115,10 +144,21 @@ class WBThrottle : Thread, public md_config_obs_t {
 
   ceph::unordered_map<ghobject_t, pair<PendingWB, FDRef> > pending_wbs;
 
-  /// get next flush to perform
-  bool get_next_should_flush(
-    boost::tuple<ghobject_t, FDRef, PendingWB> *next ///< [out] next to flush
-    ); ///< @return false if we are shutting down
+  struct Flush {
+    ghobject_t oid;
+    FDRef fd;
+    PendingWB wb;
+    utime_t start;
+  };
+  /// take the next object off the lru and account for it
+  void pop_flush(Flush *f);
+  /// start writeback of f (drops lock)
+  void start_flush(Flush &f);
+  /// wait for f to be stable (drops lock)
+  void finish_flush(Flush &f);
+  /// feed a completed flush to the adaptive model
+  void update_model(const Flush &f, utime_t now);
+  void adapt_limits();
 public:
   enum FS {
     BTRFS,
@@ -137,6 +177,14 @@ private:
     else
       return true;
   }
+  bool beyond_hard_limit() const {
+    if (cur_ios < io_limits.second &&
+	pending_wbs.size() < fd_limits.second &&
+	cur_size < size_limits.second)
+      return false;
+    else
+      return true;
+  }
 
 public:
   WBThrottle(CephContext *cct);
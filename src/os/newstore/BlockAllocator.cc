@@ -0,0 +1,168 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+
+#include "BlockAllocator.h"
+#include "include/assert.h"
+#include "include/intarith.h"
+
+BlockAllocator::BlockAllocator()
+  : lock("NewStore::BlockAllocator::lock"),
+    size(0), block_size(0), num_free(0)
+{
+}
+
+void BlockAllocator::init(uint64_t s, uint64_t bs, uint64_t reserved)
+{
+  Mutex::Locker l(lock);
+  assert(bs > 0);
+  block_size = bs;
+  size = s - s % bs;
+  reserved = ROUND_UP_TO(reserved, bs);
+  free.clear();
+  num_free = 0;
+  if (reserved < size)
+    _insert_free(reserved, size - reserved);
+}
+
+void BlockAllocator::_insert_free(uint64_t off, uint64_t len)
+{
+  assert(len > 0);
+  std::map<uint64_t, uint64_t>::iterator n = free.lower_bound(off);
+  assert(n == free.end() || n->first >= off + len);
+  if (n != free.begin()) {
+    std::map<uint64_t, uint64_t>::iterator p = n;
+    --p;
+    assert(p->first + p->second <= off);
+    if (p->first + p->second == off) {
+      // merge with the one before
+      p->second += len;
+      if (n != free.end() && n->first == off + len) {
+	p->second += n->second;
+	free.erase(n);
+      }
+      num_free += len;
+      return;
+    }
+  }
+  num_free += len;
+  if (n != free.end() && n->first == off + len) {
+    len += n->second;
+    free.erase(n);
+  }
+  free[off] = len;
+}
+
+int BlockAllocator::mark_allocated(uint64_t off, uint64_t len)
+{
+  Mutex::Locker l(lock);
+  std::map<uint64_t, uint64_t>::iterator p = free.upper_bound(off);
+  if (p == free.begin())
+    return -ERANGE;
+  --p;
+  if (p->first + p->second < off + len)
+    return -ERANGE;  // not free: allocated twice
+  uint64_t start = p->first, end = p->first + p->second;
+  free.erase(p);
+  num_free -= end - start;
+  if (start < off) {
+    free[start] = off - start;
+    num_free += off - start;
+  }
+  if (off + len < end) {
+    free[off + len] = end - (off + len);
+    num_free += end - (off + len);
+  }
+  return 0;
+}
+
+int BlockAllocator::allocate(uint64_t want, uint64_t hint,
+			     uint64_t *off, uint64_t *len)
+{
+  Mutex::Locker l(lock);
+  want = ROUND_UP_TO(want, block_size);
+  if (free.empty() || want == 0)
+    return -ENOSPC;
+
+  // first the extent hint falls in or the next one; then the first
+  // extent anywhere big enough; then whatever is largest
+  std::map<uint64_t, uint64_t>::iterator p = free.upper_bound(hint);
+  if (p != free.begin()) {
+    std::map<uint64_t, uint64_t>::iterator q = p;
+    --q;
+    if (q->first + q->second > hint)
+      p = q;
+  }
+  if (p == free.end() || p->second < want) {
+    std::map<uint64_t, uint64_t>::iterator best = free.begin();
+    for (p = free.begin(); p != free.end(); ++p) {
+      if (p->second >= want)
+	break;
+      if (p->second > best->second)
+	best = p;
+    }
+    if (p == free.end())
+      p = best;
+  }
+
+  uint64_t start = p->first, flen = p->second;
+  uint64_t take_off = start;
+  if (hint > start && hint < start + flen &&
+      start + flen - hint >= want) {
+    take_off = ROUND_UP_TO(hint, block_size);  // continue right at the hint
+    if (take_off + want > start + flen)
+      take_off = start;
+  }
+  uint64_t take = MIN(want, start + flen - take_off);
+  free.erase(p);
+  if (start < take_off)
+    free[start] = take_off - start;
+  if (take_off + take < start + flen)
+    free[take_off + take] = start + flen - (take_off + take);
+  num_free -= take;
+  *off = take_off;
+  *len = take;
+  return 0;
+}
+
+void BlockAllocator::release(uint64_t off, uint64_t len)
+{
+  Mutex::Locker l(lock);
+  assert(off % block_size == 0);
+  assert(len % block_size == 0);
+  assert(off + len <= size);
+  _insert_free(off, len);
+}
+
+uint64_t BlockAllocator::get_free()
+{
+  Mutex::Locker l(lock);
+  return num_free;
+}
+
+unsigned BlockAllocator::get_num_free_extents()
+{
+  Mutex::Locker l(lock);
+  return free.size();
+}
+
+void BlockAllocator::dump(std::ostream& out)
+{
+  Mutex::Locker l(lock);
+  out << "free " << num_free << " of " << size << " in " << free.size()
+      << " extents:";
+  for (std::map<uint64_t, uint64_t>::iterator p = free.begin();
+       p != free.end();
+       ++p)
+    out << " 0x" << std::hex << p->first << "~" << p->second << std::dec;
+}
@@ -0,0 +1,72 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OS_NEWSTORE_BLOCKALLOCATOR_H
+#define CEPH_OS_NEWSTORE_BLOCKALLOCATOR_H
+
+#include <map>
+#include <ostream>
+#include "include/int_types.h"
+#include "common/Mutex.h"
+
+/**
+ * Free space of a block device, in units of block_size.
+ *
+ * Only the free extents are kept, merged, in memory.  The allocator
+ * does not persist anything itself: NewStore records every extent it
+ * maps into an onode under PREFIX_ALLOC in the same kv transaction, and
+ * at mount replays those records with mark_allocated().  Extents handed
+ * back with release() must no longer be referenced by anything that is
+ * committed or could be replayed.
+ */
+class BlockAllocator {
+  Mutex lock;
+  uint64_t size;        ///< usable bytes
+  uint64_t block_size;
+  std::map<uint64_t, uint64_t> free;  ///< offset -> length
+  uint64_t num_free;
+
+  void _insert_free(uint64_t off, uint64_t len);
+
+public:
+  BlockAllocator();
+
+  /// everything in [reserved, size) is free
+  void init(uint64_t size, uint64_t block_size, uint64_t reserved);
+  /// an extent that is in use according to the kv store
+  int mark_allocated(uint64_t off, uint64_t len);
+
+  /**
+   * allocate up to want bytes, rounded up to block_size
+   *
+   * Prefers the free extent at or after hint, so that consecutive
+   * allocations of an object stay contiguous.  May return less than
+   * asked for when free space is fragmented.
+   *
+   * @returns 0 or -ENOSPC
+   */
+  int allocate(uint64_t want, uint64_t hint, uint64_t *off, uint64_t *len);
+  void release(uint64_t off, uint64_t len);
+
+  uint64_t get_size() const {
+    return size;
+  }
+  uint64_t get_block_size() const {
+    return block_size;
+  }
+  uint64_t get_free();
+  unsigned get_num_free_extents();
+
+  void dump(std::ostream& out);
+};
+
+#endif
@@ -22,8 +22,12 @@
 #include "NewStore.h"
 #include "include/compat.h"
 #include "include/stringify.h"
+#include "include/str_list.h"
+#include "common/blkdev.h"
 #include "common/errno.h"
+#include "common/perf_counters.h"
 #include "common/safe_io.h"
+#include "common/strtol.h"
 
 #define dout_subsys ceph_subsys_newstore
 
@@ -50,6 +54,13 @@ const string PREFIX_OBJ = "O";  // object name -> onode
 const string PREFIX_OVERLAY = "V"; // u64 + offset -> value
 const string PREFIX_OMAP = "M"; // u64 + keyname -> value
 const string PREFIX_WAL = "L";  // write ahead log
+const string PREFIX_ALLOC = "A"; // device offset -> length (block mode)
+
+// leave the start of the block device alone (labels, partition tables)
+const uint64_t BLOCK_RESERVED = 8192;
+
+// cap on a single block_map extent
+const uint64_t BLOCK_MAX_EXTENT = 1ull << 30;
 
 
 /*
@@ -336,156 +347,309 @@ void get_wal_key(uint64_t seq, string *out)
   *out = buf;
 }
 
+void get_alloc_key(uint64_t offset, string *out)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)offset);
+  *out = buf;
+}
+
+static void set_alloc_key(KeyValueDB::Transaction t, const block_extent_t& e)
+{
+  string key;
+  get_alloc_key(e.offset, &key);
+  bufferlist bl;
+  ::encode(e.length, bl);
+  t->set(PREFIX_ALLOC, key, bl);
+}
+
 // Onode
 
 NewStore::Onode::Onode(const ghobject_t& o, const string& k)
   : nref(0),
     oid(o),
     key(k),
+    coll(NULL),
+    cache_list(0),
+    cache_bytes(0),
     dirty(false),
     exists(true),
     flush_lock("NewStore::Onode::flush_lock") {
 }
 
-// OnodeHashLRU
+// OnodeCache
 
 #undef dout_prefix
-#define dout_prefix *_dout << "newstore.lru(" << this << ") "
+#define dout_prefix *_dout << "newstore.onode_cache(" << this << ") "
+
+NewStore::OnodeCache::OnodeCache(unsigned num_shards, uint64_t max_bytes)
+  : logger(NULL)
+{
+  if (num_shards < 1)
+    num_shards = 1;
+  for (unsigned i = 0; i < num_shards; ++i)
+    shards.push_back(new Shard);
+  shard_max = max_bytes / num_shards;
+}
+
+NewStore::OnodeCache::~OnodeCache()
+{
+  clear();
+  for (vector<Shard*>::iterator p = shards.begin(); p != shards.end(); ++p)
+    delete *p;
+}
 
-void NewStore::OnodeHashLRU::_touch(OnodeRef o)
+void NewStore::OnodeCache::_link(Shard *s, Collection *c, OnodeRef o,
+				 bool again)
 {
-  lru_list_t::iterator p = lru.iterator_to(*o);
-  lru.erase(p);
-  lru.push_front(*o);
+  s->onode_map[o->oid] = o;
+  if (again) {
+    s->am.push_front(*o);
+    o->cache_list = LIST_AM;
+  } else {
+    s->a1in.push_front(*o);
+    o->cache_list = LIST_A1IN;
+    s->a1in_bytes += o->cache_bytes;
+  }
+  s->bytes += o->cache_bytes;
+  o->coll = c;
+  {
+    Mutex::Locker l(c->onode_lock);
+    c->onodes.push_back(*o);
+  }
+  if (logger) {
+    logger->inc(l_newstore_onodes);
+    logger->inc(l_newstore_onode_bytes, o->cache_bytes);
+  }
 }
 
-void NewStore::OnodeHashLRU::add(const ghobject_t& oid, OnodeRef o)
+void NewStore::OnodeCache::_unlink(Shard *s, Onode *o)
 {
-  Mutex::Locker l(lock);
-  dout(30) << __func__ << " " << oid << " " << o << dendl;
-  assert(onode_map.count(oid) == 0);
-  onode_map[oid] = o;
-  lru.push_back(*o);
+  switch (o->cache_list) {
+  case LIST_A1IN:
+    s->a1in.erase(s->a1in.iterator_to(*o));
+    s->a1in_bytes -= o->cache_bytes;
+    break;
+  case LIST_AM:
+    s->am.erase(s->am.iterator_to(*o));
+    break;
+  }
+  o->cache_list = LIST_NONE;
+  s->bytes -= o->cache_bytes;
+  if (o->coll) {
+    Mutex::Locker l(o->coll->onode_lock);
+    o->coll->onodes.erase(o->coll->onodes.iterator_to(*o));
+    o->coll = NULL;
+  }
+  if (logger) {
+    logger->dec(l_newstore_onodes);
+    logger->dec(l_newstore_onode_bytes, o->cache_bytes);
+  }
 }
 
-NewStore::OnodeRef NewStore::OnodeHashLRU::lookup(const ghobject_t& oid)
+void NewStore::OnodeCache::_trim(Shard *s)
 {
-  Mutex::Locker l(lock);
-  dout(30) << __func__ << dendl;
-  ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
-  if (p == onode_map.end()) {
+  // 2Q: keep a1in to a quarter of the budget, evict from am otherwise
+  uint64_t a1in_max = shard_max / 4;
+  lru_list_t::iterator p_in = s->a1in.end(), p_am = s->am.end();
+  bool in_done = false, am_done = false;
+  while (s->bytes > shard_max) {
+    in_done = in_done || p_in == s->a1in.begin();
+    am_done = am_done || p_am == s->am.begin();
+    if (in_done && am_done) {
+      dout(20) << __func__ << " everything is in use; " << s->bytes
+	       << " bytes over " << shard_max << dendl;
+      break;
+    }
+    bool from_in = !in_done && (s->a1in_bytes > a1in_max || am_done);
+    lru_list_t::iterator& p = from_in ? p_in : p_am;
+    --p;
+    Onode *o = &*p;
+    int refs = o->nref.read();
+    if (refs > 1) {
+      dout(30) << __func__ << "  " << o->oid << " has " << refs << " refs"
+	       << dendl;
+      if (logger)
+	logger->inc(l_newstore_onode_pinned);
+      continue;
+    }
+    dout(30) << __func__ << "  evict " << o->oid
+	     << (from_in ? " from a1in" : " from am") << dendl;
+    lru_list_t::iterator after = p;
+    ++after;
+    if (from_in) {
+      // remember it, so that a second look gets it into am
+      s->a1out.push_front(o->oid);
+      s->a1out_map[o->oid] = s->a1out.begin();
+      while (s->a1out_map.size() > s->onode_map.size() / 2 + 1) {
+	s->a1out_map.erase(s->a1out.back());
+	s->a1out.pop_back();
+      }
+    }
+    _unlink(s, o);
+    p = after;
+    o->get();  // paranoia
+    s->onode_map.erase(o->oid);
+    o->put();
+    if (logger)
+      logger->inc(l_newstore_onode_evict);
+  }
+}
+
+NewStore::OnodeRef NewStore::OnodeCache::lookup(Collection *c,
+						const ghobject_t& oid)
+{
+  Shard *s = get_shard(oid);
+  Mutex::Locker l(s->lock);
+  ceph::unordered_map<ghobject_t,OnodeRef>::iterator p =
+    s->onode_map.find(oid);
+  if (p == s->onode_map.end()) {
     dout(30) << __func__ << " " << oid << " miss" << dendl;
+    if (logger)
+      logger->inc(l_newstore_onode_miss);
+    return OnodeRef();
+  }
+  Onode *o = p->second.get();
+  if (o->coll != c) {
+    // left over from a collection that has been removed; the caller
+    // loads a fresh copy
+    dout(20) << __func__ << " " << oid << " cached for another collection"
+	     << dendl;
+    _unlink(s, o);
+    s->onode_map.erase(p);
+    if (logger)
+      logger->inc(l_newstore_onode_miss);
     return OnodeRef();
   }
-  dout(30) << __func__ << " " << oid << " hit " << p->second << dendl;
-  _touch(p->second);
+  dout(30) << __func__ << " " << oid << " hit " << o << dendl;
+  if (o->cache_list == LIST_AM) {
+    s->am.erase(s->am.iterator_to(*o));
+    s->am.push_front(*o);
+  }
+  // a hit in a1in leaves it where it is
+  if (logger)
+    logger->inc(l_newstore_onode_hit);
   return p->second;
 }
 
-void NewStore::OnodeHashLRU::clear()
+NewStore::OnodeRef NewStore::OnodeCache::add(Collection *c, OnodeRef o)
 {
-  Mutex::Locker l(lock);
-  dout(10) << __func__ << dendl;
-  lru.clear();
-  onode_map.clear();
+  Shard *s = get_shard(o->oid);
+  Mutex::Locker l(s->lock);
+  ceph::unordered_map<ghobject_t,OnodeRef>::iterator p =
+    s->onode_map.find(o->oid);
+  if (p != s->onode_map.end() && p->second->coll == c) {
+    dout(30) << __func__ << " " << o->oid << " raced, using " << p->second
+	     << dendl;
+    return p->second;
+  }
+  if (p != s->onode_map.end()) {
+    _unlink(s, p->second.get());
+    s->onode_map.erase(p);
+  }
+  bool again = false;
+  ceph::unordered_map<ghobject_t,list<ghobject_t>::iterator>::iterator g =
+    s->a1out_map.find(o->oid);
+  if (g != s->a1out_map.end()) {
+    s->a1out.erase(g->second);
+    s->a1out_map.erase(g);
+    again = true;
+    if (logger)
+      logger->inc(l_newstore_onode_ghost_hit);
+  }
+  dout(30) << __func__ << " " << o->oid << " " << o
+	   << (again ? " to am" : " to a1in") << dendl;
+  _link(s, c, o, again);
+  _trim(s);
+  return o;
 }
 
-void NewStore::OnodeHashLRU::remove(const ghobject_t& oid)
+void NewStore::OnodeCache::resize(OnodeRef o, uint32_t bytes)
 {
-  Mutex::Locker l(lock);
-  ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
-  if (p == onode_map.end()) {
-    dout(30) << __func__ << " " << oid << " miss" << dendl;
-    return;
+  Shard *s = get_shard(o->oid);
+  Mutex::Locker l(s->lock);
+  if (o->cache_list != LIST_NONE) {
+    s->bytes -= o->cache_bytes;
+    s->bytes += bytes;
+    if (o->cache_list == LIST_A1IN) {
+      s->a1in_bytes -= o->cache_bytes;
+      s->a1in_bytes += bytes;
+    }
+    if (logger) {
+      logger->dec(l_newstore_onode_bytes, o->cache_bytes);
+      logger->inc(l_newstore_onode_bytes, bytes);
+    }
   }
-  dout(30) << __func__ << " " << oid << " hit " << p->second << dendl;
-  lru_list_t::iterator pi = lru.iterator_to(*p->second);
-  lru.erase(pi);
-  onode_map.erase(p);
+  o->cache_bytes = bytes;
+  if (o->cache_list != LIST_NONE && s->bytes > shard_max)
+    _trim(s);
 }
 
-void NewStore::OnodeHashLRU::rename(const ghobject_t& old_oid,
-				    const ghobject_t& new_oid)
+void NewStore::OnodeCache::rename(Collection *c, const ghobject_t& old_oid,
+				  const ghobject_t& new_oid)
 {
-  Mutex::Locker l(lock);
   dout(30) << __func__ << " " << old_oid << " -> " << new_oid << dendl;
-  ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
-  po = onode_map.find(old_oid);
-  pn = onode_map.find(new_oid);
+  Shard *so = get_shard(old_oid);
+  Shard *sn = get_shard(new_oid);
+  // lock in address order
+  Shard *first = so < sn ? so : sn;
+  Shard *second = so < sn ? sn : so;
+  first->lock.Lock();
+  if (second != first)
+    second->lock.Lock();
 
-  assert(po != onode_map.end());
-  if (pn != onode_map.end()) {
-    lru_list_t::iterator p = lru.iterator_to(*pn->second);
-    lru.erase(p);
-    onode_map.erase(pn);
+  ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
+  po = so->onode_map.find(old_oid);
+  assert(po != so->onode_map.end());
+  OnodeRef o = po->second;
+  pn = sn->onode_map.find(new_oid);
+  if (pn != sn->onode_map.end()) {
+    _unlink(sn, pn->second.get());
+    sn->onode_map.erase(pn);
   }
-  onode_map.insert(make_pair(new_oid, po->second));
-  _touch(po->second);
-  onode_map.erase(po);
+  _unlink(so, o.get());
+  so->onode_map.erase(po);
+  o->oid = new_oid;
+  _link(sn, c, o, true);
+
+  if (second != first)
+    second->lock.Unlock();
+  first->lock.Unlock();
 }
 
-bool NewStore::OnodeHashLRU::get_next(
-  const ghobject_t& after,
-  pair<ghobject_t,OnodeRef> *next)
+void NewStore::OnodeCache::clear(Collection *c)
 {
-  Mutex::Locker l(lock);
-  dout(20) << __func__ << " after " << after << dendl;
-
-  if (after == ghobject_t()) {
-    if (lru.empty()) {
-      return false;
+  vector<OnodeRef> ls;
+  c->get_cached_onodes(&ls);
+  dout(10) << __func__ << " " << c->cid << " " << ls.size() << " onodes"
+	   << dendl;
+  for (vector<OnodeRef>::iterator p = ls.begin(); p != ls.end(); ++p) {
+    Shard *s = get_shard((*p)->oid);
+    Mutex::Locker l(s->lock);
+    ceph::unordered_map<ghobject_t,OnodeRef>::iterator q =
+      s->onode_map.find((*p)->oid);
+    if (q != s->onode_map.end() && q->second == *p) {
+      _unlink(s, p->get());
+      s->onode_map.erase(q);
     }
-    ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.begin();
-    assert(p != onode_map.end());
-    next->first = p->first;
-    next->second = p->second;
-    return true;
-  }
-
-  ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(after);
-  assert(p != onode_map.end()); // for now
-  lru_list_t::iterator pi = lru.iterator_to(*p->second);
-  ++pi;
-  if (pi == lru.end()) {
-    return false;
   }
-  next->first = pi->oid;
-  next->second = onode_map[pi->oid];
-  return true;
 }
 
-int NewStore::OnodeHashLRU::trim(int max)
+void NewStore::OnodeCache::clear()
 {
-  Mutex::Locker l(lock);
-  dout(20) << __func__ << " max " << max
-	   << " size " << onode_map.size() << dendl;
-  int trimmed = 0;
-  int num = onode_map.size() - max;
-  lru_list_t::iterator p = lru.end();
-  if (num)
-    --p;
-  while (num > 0) {
-    Onode *o = &*p;
-    int refs = o->nref.read();
-    if (refs > 1) {
-      dout(20) << __func__ << "  " << o->oid << " has " << refs
-	       << " refs; stopping with " << num << " left to trim" << dendl;
-      break;
-    }
-    dout(30) << __func__ << "  trim " << o->oid << dendl;
-    if (p != lru.begin()) {
-      lru.erase(p--);
-    } else {
-      lru.erase(p);
-      assert(num == 1);
-    }
-    o->get();  // paranoia
-    onode_map.erase(o->oid);
-    o->put();
-    --num;
-    ++trimmed;
+  dout(10) << __func__ << dendl;
+  for (vector<Shard*>::iterator p = shards.begin(); p != shards.end(); ++p) {
+    Shard *s = *p;
+    Mutex::Locker l(s->lock);
+    for (ceph::unordered_map<ghobject_t,OnodeRef>::iterator q =
+	   s->onode_map.begin();
+	 q != s->onode_map.end();
+	 ++q)
+      _unlink(s, q->second.get());
+    s->onode_map.clear();
+    s->a1out.clear();
+    s->a1out_map.clear();
   }
-  return trimmed;
 }
 
 // =======================================================
@@ -499,8 +663,16 @@ NewStore::Collection::Collection(NewStore *ns, coll_t c)
   : store(ns),
     cid(c),
     lock("NewStore::Collection::lock"),
-    onode_map()
+    onode_lock("NewStore::Collection::onode_lock")
+{
+}
+
+void NewStore::Collection::get_cached_onodes(vector<OnodeRef> *ls)
 {
+  Mutex::Locker l(onode_lock);
+  ls->reserve(onodes.size());
+  for (onode_list_t::iterator p = onodes.begin(); p != onodes.end(); ++p)
+    ls->push_back(OnodeRef(&*p));
 }
 
 NewStore::OnodeRef NewStore::Collection::get_onode(
@@ -518,7 +690,7 @@ NewStore::OnodeRef NewStore::Collection::get_onode(
     }
   }
 
-  OnodeRef o = onode_map.lookup(oid);
+  OnodeRef o = store->onode_cache.lookup(this, oid);
   if (o)
     return o;
 
@@ -546,9 +718,9 @@ NewStore::OnodeRef NewStore::Collection::get_onode(
     bufferlist::iterator p = v.begin();
     ::decode(on->onode, p);
   }
+  on->cache_bytes = sizeof(Onode) + key.length() + v.length();
   o.reset(on);
-  onode_map.add(oid, o);
-  return o;
+  return store->onode_cache.add(this, o);
 }
 
 
@@ -569,8 +741,12 @@ NewStore::NewStore(CephContext *cct, const string& path)
     fsid_fd(-1),
     frag_fd(-1),
     fset_fd(-1),
+    block_fd(-1),
     mounted(false),
+    compressor(NULL),
     coll_lock("NewStore::coll_lock"),
+    onode_cache(cct->_conf->newstore_onode_cache_shards,
+		cct->_conf->newstore_onode_cache_size),
     fid_lock("NewStore::fid_lock"),
     nid_lock("NewStore::nid_lock"),
     nid_max(0),
@@ -620,16 +796,69 @@ NewStore::~NewStore()
   assert(db == NULL);
   assert(fsid_fd < 0);
   assert(frag_fd < 0);
+  assert(block_fd < 0);
 }
 
 void NewStore::_init_logger()
 {
-  // XXX
+  PerfCountersBuilder b(cct, "newstore", l_newstore_first, l_newstore_last);
+  b.add_u64_counter(l_newstore_onode_hit, "onode_hit",
+		    "Onode cache lookups that hit");
+  b.add_u64_counter(l_newstore_onode_miss, "onode_miss",
+		    "Onode cache lookups that missed");
+  b.add_u64_counter(l_newstore_onode_ghost_hit, "onode_ghost_hit",
+		    "Misses on recently evicted onodes (promoted to am)");
+  b.add_u64_counter(l_newstore_onode_evict, "onode_evict",
+		    "Onodes evicted from the cache");
+  b.add_u64_counter(l_newstore_onode_pinned, "onode_pinned",
+		    "In use onodes skipped by eviction");
+  b.add_u64(l_newstore_onodes, "onodes", "Cached onodes");
+  b.add_u64(l_newstore_onode_bytes, "onode_bytes",
+	    "Bytes charged to the onode cache");
+  b.add_time_avg(l_newstore_state_prepare_lat, "state_prepare_lat",
+		 "Average prepare state latency");
+  b.add_time_avg(l_newstore_state_aio_wait_lat, "state_aio_wait_lat",
+		 "Average aio_wait state latency");
+  b.add_time_avg(l_newstore_state_io_done_lat, "state_io_done_lat",
+		 "Average wait for fsyncs and earlier ios in the sequencer");
+  b.add_time_avg(l_newstore_state_kv_queued_lat, "state_kv_queued_lat",
+		 "Average kv_queued state latency");
+  b.add_time_avg(l_newstore_state_kv_committing_lat,
+		 "state_kv_committing_lat",
+		 "Average kv_committing state latency");
+  b.add_time_avg(l_newstore_state_wal_queued_lat, "state_wal_queued_lat",
+		 "Average wal_queued state latency");
+  b.add_time_avg(l_newstore_state_wal_applying_lat, "state_wal_applying_lat",
+		 "Average wal_applying state latency");
+  b.add_time_avg(l_newstore_state_wal_aio_wait_lat, "state_wal_aio_wait_lat",
+		 "Average wal_aio_wait state latency");
+  b.add_time_avg(l_newstore_state_wal_cleanup_lat, "state_wal_cleanup_lat",
+		 "Average wal_cleanup state latency");
+  b.add_time_avg(l_newstore_state_finishing_lat, "state_finishing_lat",
+		 "Average finishing state latency");
+  b.add_time_avg(l_newstore_state_done_lat, "state_done_lat",
+		 "Average transaction latency, submit to done");
+  b.add_time_avg(l_newstore_kv_commit_lat, "kv_commit_lat",
+		 "Average kv_sync_thread commit round latency");
+  b.add_u64_avg(l_newstore_kv_commit_txcs, "kv_commit_txcs",
+		"Transactions committed per kv_sync_thread round");
+  b.add_u64_counter(l_newstore_compress_bytes, "compress_bytes",
+		    "Object bytes written compressed");
+  b.add_u64_counter(l_newstore_compressed_bytes, "compressed_bytes",
+		    "What those bytes took on disk");
+  b.add_u64_counter(l_newstore_compress_rejected, "compress_rejected",
+		    "Writes stored raw because they did not compress well");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+  onode_cache.logger = logger;
 }
 
 void NewStore::_shutdown_logger()
 {
-  // XXX
+  onode_cache.logger = NULL;
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+  logger = NULL;
 }
 
 int NewStore::peek_journal_fsid(uuid_d *fsid)
@@ -818,6 +1047,15 @@ int NewStore::_open_db()
     return -EIO;
   }
   db->init(g_conf->newstore_backend_options);
+  int r = db->set_column_families(g_conf->newstore_backend_column_families);
+  if (r < 0) {
+    derr << __func__ << " error setting column families "
+	 << g_conf->newstore_backend_column_families << ": "
+	 << cpp_strerror(r) << dendl;
+    delete db;
+    db = NULL;
+    return r;
+  }
   stringstream err;
   if (db->create_and_open(err)) {
     derr << __func__ << " erroring opening db: " << err.str() << dendl;
@@ -838,6 +1076,204 @@ void NewStore::_close_db()
   db = NULL;
 }
 
+static int get_block_file_size(int fd, uint64_t *size)
+{
+  struct stat st;
+  int r = ::fstat(fd, &st);
+  if (r < 0)
+    return -errno;
+  if (S_ISBLK(st.st_mode)) {
+    int64_t s;
+    r = get_block_device_size(fd, &s);
+    if (r < 0)
+      return r;
+    *size = s;
+  } else {
+    *size = st.st_size;
+  }
+  return 0;
+}
+
+int NewStore::_create_block()
+{
+  assert(block_fd < 0);
+  string block_path = g_conf->newstore_block_path;
+  uint64_t bs = g_conf->newstore_block_size;
+  if (bs < 512 || (bs & (bs - 1))) {
+    derr << __func__ << " newstore_block_size " << bs
+	 << " is not a power of two >= 512" << dendl;
+    return -EINVAL;
+  }
+  int r = ::symlinkat(block_path.c_str(), path_fd, "block");
+  if (r < 0 && errno != EEXIST) {
+    r = -errno;
+    derr << __func__ << " cannot link " << path << "/block to " << block_path
+	 << ": " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  block_fd = ::openat(path_fd, "block", O_RDWR | O_CREAT, 0644);
+  if (block_fd < 0) {
+    r = -errno;
+    derr << __func__ << " cannot open " << path << "/block: "
+	 << cpp_strerror(r) << dendl;
+    return r;
+  }
+  struct stat st;
+  r = ::fstat(block_fd, &st);
+  if (r < 0) {
+    r = -errno;
+    goto out_close;
+  }
+  if (S_ISREG(st.st_mode) && st.st_size == 0) {
+    dout(1) << __func__ << " sizing block file to "
+	    << g_conf->newstore_block_create_size << dendl;
+    r = ::ftruncate(block_fd, g_conf->newstore_block_create_size);
+    if (r < 0) {
+      r = -errno;
+      derr << __func__ << " cannot size block file: " << cpp_strerror(r)
+	   << dendl;
+      goto out_close;
+    }
+  }
+
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist bl;
+    ::encode(bs, bl);
+    t->set(PREFIX_SUPER, "block_size", bl);
+    db->submit_transaction_sync(t);
+  }
+  return 0;
+
+ out_close:
+  _close_block();
+  return r;
+}
+
+int NewStore::_open_block()
+{
+  assert(block_fd < 0);
+  block_fd = ::openat(path_fd, "block", O_RDWR);
+  if (block_fd < 0) {
+    int r = -errno;
+    if (r == -ENOENT) {
+      dout(10) << __func__ << " no " << path << "/block, using fragments"
+	       << dendl;
+      return 0;
+    }
+    derr << __func__ << " cannot open " << path << "/block: "
+	 << cpp_strerror(r) << dendl;
+    return r;
+  }
+
+  uint64_t bs = 0;
+  bufferlist bl;
+  db->get(PREFIX_SUPER, "block_size", &bl);
+  if (bl.length()) {
+    bufferlist::iterator p = bl.begin();
+    ::decode(bs, p);
+  }
+  if (!bs) {
+    derr << __func__ << " no block_size recorded in db" << dendl;
+    _close_block();
+    return -EIO;
+  }
+  uint64_t size;
+  int r = get_block_file_size(block_fd, &size);
+  if (r < 0) {
+    derr << __func__ << " cannot get size of " << path << "/block: "
+	 << cpp_strerror(r) << dendl;
+    _close_block();
+    return r;
+  }
+  alloc.init(size, bs, BLOCK_RESERVED);
+  r = _open_alloc();
+  if (r < 0) {
+    _close_block();
+    return r;
+  }
+  return 0;
+}
+
+int NewStore::_open_alloc()
+{
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_ALLOC);
+  unsigned count = 0;
+  for (it->lower_bound(string()); it->valid(); it->next()) {
+    unsigned long long offset;
+    if (sscanf(it->key().c_str(), "%llx", &offset) < 1) {
+      derr << __func__ << " bad alloc key " << it->key() << dendl;
+      return -EIO;
+    }
+    uint32_t length;
+    bufferlist bl = it->value();
+    bufferlist::iterator p = bl.begin();
+    try {
+      ::decode(length, p);
+    } catch (buffer::error& e) {
+      derr << __func__ << " failed to decode alloc " << it->key() << dendl;
+      return -EIO;
+    }
+    int r = alloc.mark_allocated(offset, length);
+    if (r < 0) {
+      derr << __func__ << " extent 0x" << std::hex << offset << "~" << length
+	   << std::dec << " overlaps another or is past the end of the device"
+	   << dendl;
+      return -EIO;
+    }
+    ++count;
+  }
+  dout(1) << __func__ << " block size " << alloc.get_size()
+	  << " block_size " << alloc.get_block_size()
+	  << " free " << alloc.get_free()
+	  << " in " << alloc.get_num_free_extents() << " extents, "
+	  << count << " allocated extents" << dendl;
+  return 0;
+}
+
+void NewStore::_close_block()
+{
+  if (block_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(block_fd));
+    block_fd = -1;
+  }
+}
+
+int NewStore::_open_compressor()
+{
+  const string& type = g_conf->newstore_compression;
+  if (type.empty())
+    return 0;
+  compression_pools.clear();
+  list<string> ls;
+  get_str_list(g_conf->newstore_compression_pools, ls);
+  for (list<string>::iterator p = ls.begin(); p != ls.end(); ++p) {
+    string err;
+    int64_t pool = strict_strtoll(p->c_str(), 10, &err);
+    if (!err.empty()) {
+      derr << __func__ << " bad pool id '" << *p
+	   << "' in newstore_compression_pools: " << err << dendl;
+      return -EINVAL;
+    }
+    compression_pools.insert(pool);
+  }
+  compressor = Compressor::create(cct, type);
+  if (!compressor) {
+    derr << __func__ << " unknown newstore_compression " << type << dendl;
+    return -EINVAL;
+  }
+  dout(1) << __func__ << " " << type << " for pools "
+	  << (compression_pools.empty() ? "(all)" : stringify(compression_pools))
+	  << dendl;
+  return 0;
+}
+
+void NewStore::_close_compressor()
+{
+  delete compressor;
+  compressor = NULL;
+}
+
 int NewStore::_aio_start()
 {
   if (g_conf->newstore_aio) {
@@ -936,10 +1372,19 @@ int NewStore::mkfs()
   if (r < 0)
     goto out_close_frag;
 
+  if (g_conf->newstore_block_path != "") {
+    r = _create_block();
+    if (r < 0)
+      goto out_close_db;
+    _close_block();
+  }
+
   // FIXME: superblock
 
   dout(10) << __func__ << " success" << dendl;
   r = 0;
+
+ out_close_db:
   _close_db();
 
  out_close_frag:
@@ -992,10 +1437,18 @@ int NewStore::mount()
   if (r < 0)
     goto out_db;
 
-  r = _aio_start();
+  r = _open_block();
   if (r < 0)
     goto out_db;
 
+  r = _open_compressor();
+  if (r < 0)
+    goto out_block;
+
+  r = _aio_start();
+  if (r < 0)
+    goto out_compressor;
+
   r = _wal_replay();
   if (r < 0)
     goto out_aio;
@@ -1010,6 +1463,10 @@ int NewStore::mount()
 
  out_aio:
   _aio_stop();
+ out_compressor:
+  _close_compressor();
+ out_block:
+  _close_block();
  out_db:
   _close_db();
  out_frag:
@@ -1046,8 +1503,11 @@ int NewStore::umount()
   dout(20) << __func__ << " closing" << dendl;
 
   mounted = false;
+  onode_cache.clear();
   if (fset_fd >= 0)
     VOID_TEMP_FAILURE_RETRY(::close(fset_fd));
+  _close_compressor();
+  _close_block();
   _close_db();
   _close_frag();
   _close_fsid();
@@ -1080,6 +1540,13 @@ int NewStore::statfs(struct statfs *buf)
     assert(!g_conf->newstore_fail_eio || r != -EIO);
     return r;
   }
+  if (block_fd >= 0) {
+    uint64_t bs = alloc.get_block_size();
+    buf->f_bsize = bs;
+    buf->f_blocks = alloc.get_size() / bs;
+    buf->f_bfree = alloc.get_free() / bs;
+    buf->f_bavail = buf->f_bfree;
+  }
   return 0;
 }
 
@@ -1116,17 +1583,18 @@ void NewStore::_reap_collections()
     CollectionRef c = *p;
     dout(10) << __func__ << " " << c->cid << dendl;
     {
-      pair<ghobject_t,OnodeRef> next;
-      while (c->onode_map.get_next(next.first, &next)) {
-	assert(!next.second->exists);
-	if (!next.second->flush_txns.empty()) {
-	  dout(10) << __func__ << " " << c->cid << " " << next.second->oid
-		   << " flush_txns " << next.second->flush_txns << dendl;
+      vector<OnodeRef> ls;
+      c->get_cached_onodes(&ls);
+      for (vector<OnodeRef>::iterator q = ls.begin(); q != ls.end(); ++q) {
+	assert(!(*q)->exists);
+	if (!(*q)->flush_txns.empty()) {
+	  dout(10) << __func__ << " " << c->cid << " " << (*q)->oid
+		   << " flush_txns " << (*q)->flush_txns << dendl;
 	  return;
 	}
       }
     }
-    c->onode_map.clear();
+    onode_cache.clear(c.get());
     dout(10) << __func__ << " " << c->cid << " done" << dendl;
   }
 
@@ -1236,6 +1704,24 @@ int NewStore::_do_read(
 
   o->flush();
 
+  if (o->onode.is_inline()) {
+    bufferlist t;
+    t.substr_of(o->onode.inline_data, offset, length);
+    bl.claim_append(t);
+    r = length;
+    goto out;
+  }
+
+  if (o->onode.is_compressed()) {
+    r = _do_read_compressed(o, offset, length, bl);
+    goto out;
+  }
+
+  if (block_fd >= 0) {
+    r = _do_read_block(o, offset, length, bl);
+    goto out;
+  }
+
   r = 0;
 
   // loop over overlays and data fragments.  overlays take precedence.
@@ -1352,6 +1838,99 @@ int NewStore::_do_read(
   return r;
 }
 
+int NewStore::_do_read_compressed(
+    OnodeRef o,
+    uint64_t offset,
+    size_t length,
+    bufferlist& bl)
+{
+  assert(o->onode.data_map.size() == 1);
+  fragment_t& f = o->onode.data_map.begin()->second;
+  int fd = _open_fid(f.fid, O_RDONLY);
+  if (fd < 0)
+    return fd;
+  bufferlist cbl;
+  int r = cbl.read_fd(fd, f.length);
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  if (r < 0)
+    return r;
+  if (cbl.length() < f.length) {
+    derr << __func__ << " short read " << cbl.length() << " < " << f.length
+	 << " from " << f.fid << dendl;
+    return -EIO;
+  }
+
+  bufferlist raw;
+  Compressor *c = Compressor::create(cct, o->onode.compression);
+  if (!c) {
+    derr << __func__ << " " << o->oid << " was stored with unknown compressor "
+	 << o->onode.compression << dendl;
+    return -EIO;
+  }
+  r = c->decompress(cbl, raw);
+  delete c;
+  if (r < 0 || raw.length() != o->onode.size) {
+    derr << __func__ << " failed to decompress " << f.fid << " (" << r
+	 << ", got " << raw.length() << " of " << o->onode.size << " bytes)"
+	 << dendl;
+    return -EIO;
+  }
+  dout(20) << __func__ << " " << offset << "~" << length << " of "
+	   << f.length << " compressed bytes in " << f.fid << dendl;
+  bufferlist t;
+  t.substr_of(raw, offset, length);
+  bl.claim_append(t);
+  return length;
+}
+
+int NewStore::_do_read_block(
+    OnodeRef o,
+    uint64_t offset,
+    size_t length,
+    bufferlist& bl)
+{
+  map<uint64_t,block_extent_t>& bm = o->onode.block_map;
+  map<uint64_t,block_extent_t>::iterator p = bm.lower_bound(offset);
+  if (p != bm.begin()) {
+    --p;
+    if (p->first + p->second.length <= offset)
+      ++p;
+  }
+  uint64_t end = offset + length;
+  while (offset < end) {
+    uint64_t x_len;
+    if (p == bm.end() || p->first >= end) {
+      x_len = end - offset;
+    } else if (p->first > offset) {
+      x_len = p->first - offset;
+    } else {
+      uint64_t x_off = offset - p->first;
+      x_len = MIN(end, p->first + p->second.length) - offset;
+      dout(30) << __func__ << " data " << p->first << " " << p->second
+	       << " use " << x_off << "~" << x_len << dendl;
+      bufferptr bp = buffer::create(x_len);
+      int r = safe_pread_exact(block_fd, bp.c_str(), x_len,
+			       p->second.offset + x_off);
+      if (r < 0) {
+	derr << __func__ << " read at 0x" << std::hex
+	     << p->second.offset + x_off << "~" << x_len << std::dec
+	     << ": " << cpp_strerror(r) << dendl;
+	return r;
+      }
+      bl.push_back(bp);
+      offset += x_len;
+      ++p;
+      continue;
+    }
+    dout(30) << __func__ << " zero " << offset << "~" << x_len << dendl;
+    bufferptr bp(x_len);
+    bp.zero();
+    bl.push_back(bp);
+    offset += x_len;
+  }
+  return bl.length();
+}
+
 int NewStore::fiemap(
   coll_t cid,
   const ghobject_t& oid,
@@ -1383,6 +1962,35 @@ int NewStore::fiemap(
   dout(20) << __func__ << " " << offset << "~" << len << " size "
 	   << o->onode.size << dendl;
 
+  if (o->onode.is_inline() || o->onode.is_compressed()) {
+    if (len)
+      m[offset] = len;
+    ::encode(m, bl);
+    return 0;
+  }
+
+  if (block_fd >= 0) {
+    uint64_t end = offset + len;
+    map<uint64_t,block_extent_t>& bm = o->onode.block_map;
+    map<uint64_t,block_extent_t>::iterator p = bm.lower_bound(offset);
+    if (p != bm.begin())
+      --p;
+    map<uint64_t,uint64_t>::iterator last = m.end();
+    for (; p != bm.end() && p->first < end; ++p) {
+      uint64_t x_start = MAX(p->first, offset);
+      uint64_t x_end = MIN(p->first + p->second.length, end);
+      if (x_start >= x_end)
+	continue;
+      if (last != m.end() && last->first + last->second == x_start)
+	last->second += x_end - x_start;
+      else
+	last = m.insert(make_pair(x_start, x_end - x_start)).first;
+    }
+    ::encode(m, bl);
+    dout(20) << __func__ << " " << offset << "~" << len << " = " << m << dendl;
+    return 0;
+  }
+
   map<uint64_t,fragment_t>::iterator fp, fend;
   map<uint64_t,overlay_t>::iterator op, oend;
 
@@ -2157,6 +2765,7 @@ void NewStore::_txc_state_proc(TransContext *txc)
 	     << " " << txc->get_state_name() << dendl;
     switch (txc->state) {
     case TransContext::STATE_PREPARE:
+      txc->log_state_latency(logger, l_newstore_state_prepare_lat);
       if (!txc->pending_aios.empty()) {
 	txc->state = TransContext::STATE_AIO_WAIT;
 	_txc_aio_submit(txc);
@@ -2165,6 +2774,8 @@ void NewStore::_txc_state_proc(TransContext *txc)
       // ** fall-thru **
 
     case TransContext::STATE_AIO_WAIT:
+      if (txc->state == TransContext::STATE_AIO_WAIT)
+	txc->log_state_latency(logger, l_newstore_state_aio_wait_lat);
       if (!txc->sync_items.empty()) {
 	txc->state = TransContext::STATE_FSYNC_WAIT;
 	if (!g_conf->newstore_sync_io) {
@@ -2178,6 +2789,7 @@ void NewStore::_txc_state_proc(TransContext *txc)
 
     case TransContext::STATE_IO_DONE:
       assert(txc->osr->qlock.is_locked());  // see _txc_finish_io
+      txc->log_state_latency(logger, l_newstore_state_io_done_lat);
       txc->state = TransContext::STATE_KV_QUEUED;
       if (!g_conf->newstore_sync_transaction) {
 	Mutex::Locker l(kv_lock);
@@ -2189,9 +2801,11 @@ void NewStore::_txc_state_proc(TransContext *txc)
 	return;
       }
       db->submit_transaction_sync(txc->t);
+      txc->state = TransContext::STATE_KV_COMMITTING;
       break;
 
-    case TransContext::STATE_KV_QUEUED:
+    case TransContext::STATE_KV_COMMITTING:
+      txc->log_state_latency(logger, l_newstore_state_kv_committing_lat);
       txc->state = TransContext::STATE_KV_DONE;
       _txc_finish_kv(txc);
       // ** fall-thru **
@@ -2210,6 +2824,7 @@ void NewStore::_txc_state_proc(TransContext *txc)
       break;
 
     case TransContext::STATE_WAL_APPLYING:
+      txc->log_state_latency(logger, l_newstore_state_wal_applying_lat);
       if (!txc->pending_aios.empty()) {
 	txc->state = TransContext::STATE_WAL_AIO_WAIT;
 	_txc_aio_submit(txc);
@@ -2218,10 +2833,13 @@ void NewStore::_txc_state_proc(TransContext *txc)
       // ** fall-thru **
 
     case TransContext::STATE_WAL_AIO_WAIT:
+      if (txc->state == TransContext::STATE_WAL_AIO_WAIT)
+	txc->log_state_latency(logger, l_newstore_state_wal_aio_wait_lat);
       _wal_finish(txc);
       return;
 
     case TransContext::STATE_WAL_CLEANUP:
+      txc->log_state_latency(logger, l_newstore_state_wal_cleanup_lat);
       txc->state = TransContext::STATE_FINISHING;
       // ** fall-thru **
 
@@ -2300,6 +2918,7 @@ int NewStore::_txc_finalize(OpSequencer *osr, TransContext *txc)
     bufferlist bl;
     ::encode((*p)->onode, bl);
     txc->t->set(PREFIX_OBJ, (*p)->key, bl);
+    onode_cache.resize(*p, sizeof(Onode) + (*p)->key.length() + bl.length());
 
     Mutex::Locker l((*p)->flush_lock);
     (*p)->flush_txns.insert(txc);
@@ -2401,6 +3020,9 @@ void NewStore::_txc_finish(TransContext *txc)
   throttle_wal_ops.put(txc->ops);
   throttle_wal_bytes.put(txc->bytes);
 
+  txc->log_state_latency(logger, l_newstore_state_finishing_lat);
+  logger->tinc(l_newstore_state_done_lat, txc->last_stamp - txc->start);
+
   OpSequencerRef osr = txc->osr;
   osr->qlock.Lock();
   txc->state = TransContext::STATE_DONE;
@@ -2421,8 +3043,13 @@ void NewStore::_osr_reap_done(OpSequencer *osr)
       break;
     }
 
-    if (txc->first_collection) {
-      txc->first_collection->onode_map.trim(g_conf->newstore_onode_map_size);
+    // nothing committed or queued before us refers to these extents
+    // any more: earlier wal writes in this sequencer have been applied.
+    for (vector<block_extent_t>::iterator p = txc->released.begin();
+	 p != txc->released.end();
+	 ++p) {
+      dout(30) << __func__ << "  release " << *p << dendl;
+      alloc.release(p->offset, p->length);
     }
 
     osr->q.pop_front();
@@ -2483,16 +3110,21 @@ void NewStore::_kv_sync_thread()
       utime_t start = ceph_clock_now(NULL);
       kv_lock.Unlock();
 
-      if (!g_conf->newstore_sync_submit_transaction) {
-	for (std::deque<TransContext *>::iterator it = kv_committing.begin();
-	     it != kv_committing.end();
-	     ++it) {
-	  db->submit_transaction((*it)->t);
-	}
+      // every queued txc plus the wal cleanup below go down as a single
+      // batch with one sync.  with newstore_sync_submit_transaction they
+      // were already submitted (unsynced) and only need the sync.
+      vector<KeyValueDB::Transaction> batch;
+      batch.reserve(kv_committing.size() + 1);
+      for (std::deque<TransContext *>::iterator it = kv_committing.begin();
+	   it != kv_committing.end();
+	   ++it) {
+	(*it)->log_state_latency(logger, l_newstore_state_kv_queued_lat);
+	(*it)->state = TransContext::STATE_KV_COMMITTING;
+	if (!g_conf->newstore_sync_submit_transaction)
+	  batch.push_back((*it)->t);
       }
 
-      // one transaction to force a sync.  clean up wal keys while we
-      // are at it.
+      // clean up wal keys while we are at it.
       KeyValueDB::Transaction txc_cleanup_sync = db->get_transaction();
       for (std::deque<TransContext *>::iterator it = wal_cleaning.begin();
 	    it != wal_cleaning.end();
@@ -2519,9 +3151,17 @@ void NewStore::_kv_sync_thread()
 	get_wal_key(wt.seq, &key);
 	txc_cleanup_sync->rmkey(PREFIX_WAL, key);
       }
-      db->submit_transaction_sync(txc_cleanup_sync);
+      batch.push_back(txc_cleanup_sync);
+      int r = db->submit_transactions(batch, true);
+      if (r < 0) {
+	derr << __func__ << " kv commit of " << batch.size()
+	     << " transactions failed: " << r << dendl;
+	assert(0 == "kv commit failed");
+      }
       utime_t finish = ceph_clock_now(NULL);
       utime_t dur = finish - start;
+      logger->tinc(l_newstore_kv_commit_lat, dur);
+      logger->inc(l_newstore_kv_commit_txcs, kv_committing.size());
       dout(20) << __func__ << " committed " << kv_committing.size()
 	       << " cleaned " << wal_cleaning.size()
 	       << " in " << dur << dendl;
@@ -2559,6 +3199,7 @@ int NewStore::_wal_apply(TransContext *txc)
 {
   wal_transaction_t& wt = *txc->wal_txn;
   dout(20) << __func__ << " txc " << txc << " seq " << wt.seq << dendl;
+  txc->log_state_latency(logger, l_newstore_state_wal_queued_lat);
   txc->state = TransContext::STATE_WAL_APPLYING;
 
   assert(txc->pending_aios.empty());
@@ -2586,6 +3227,7 @@ int NewStore::_do_wal_transaction(wal_transaction_t& wt,
 {
   vector<int> sync_fds;
   sync_fds.reserve(wt.ops.size());
+  bool sync_block = false;
 
   // read all the overlay data first for apply
   _do_read_all_overlays(wt);
@@ -2680,6 +3322,21 @@ int NewStore::_do_wal_transaction(wal_transaction_t& wt,
       }
       break;
 
+    case wal_op_t::OP_BWRITE:
+      {
+	dout(20) << __func__ << " bwrite 0x" << std::hex << p->offset << "~"
+		 << p->length << std::dec << dendl;
+	assert(block_fd >= 0);
+	int r = p->data.write_fd(block_fd, p->offset);
+	if (r < 0) {
+	  derr << __func__ << " write_fd on block got: "
+	       << cpp_strerror(r) << dendl;
+	  return r;
+	}
+	sync_block = true;
+      }
+      break;
+
     case wal_op_t::OP_REMOVE:
       dout(20) << __func__ << " remove " << p->fid << dendl;
       _remove_fid(p->fid);
@@ -2700,6 +3357,10 @@ int NewStore::_do_wal_transaction(wal_transaction_t& wt,
     assert(r == 0);
     VOID_TEMP_FAILURE_RETRY(::close(*p));
   }
+  if (sync_block) {
+    int r = ::fdatasync(block_fd);
+    assert(r == 0);
+  }
 
   return 0;
 }
@@ -3379,11 +4040,168 @@ void NewStore::_do_read_all_overlays(wal_transaction_t& wt)
   return;
 }
 
+bool NewStore::_can_inline(OnodeRef o, uint64_t end)
+{
+  uint64_t max = g_conf->newstore_inline_max;
+  if (MAX(end, o->onode.size) > max)
+    return false;
+  if (o->onode.is_inline())
+    return true;
+  // anything else must still be a hole
+  return o->onode.data_map.empty() &&
+    o->onode.block_map.empty() &&
+    o->onode.overlay_map.empty();
+}
+
+void NewStore::_do_write_inline(TransContext *txc,
+				OnodeRef o,
+				uint64_t offset, uint64_t length,
+				bufferlist& bl)
+{
+  bufferlist& d = o->onode.inline_data;
+  if (d.length() < o->onode.size)
+    d.append_zero(o->onode.size - d.length());
+  uint64_t old = d.length();
+  bufferlist n, t;
+  if (offset <= old) {
+    n.substr_of(d, 0, offset);
+  } else {
+    n = d;
+    n.append_zero(offset - old);
+  }
+  t.substr_of(bl, 0, length);
+  n.claim_append(t);
+  if (offset + length < old) {
+    t.substr_of(d, offset + length, old - (offset + length));
+    n.claim_append(t);
+  }
+  // copy, so we don't pin the (possibly much larger) message buffer
+  n.rebuild();
+  d.swap(n);
+  o->onode.size = d.length();
+  dout(20) << __func__ << " " << offset << "~" << length
+	   << ", inline size now " << o->onode.size << dendl;
+  txc->write_onode(o);
+}
+
+int NewStore::_do_inline_promote(TransContext *txc, OnodeRef o)
+{
+  dout(20) << __func__ << " moving " << o->onode.size << " inline bytes out"
+	   << dendl;
+  bufferlist bl;
+  bl.swap(o->onode.inline_data);
+  o->onode.size = 0;
+  return _do_write_data(txc, o, 0, bl.length(), bl, 0);
+}
+
+int NewStore::_do_write_compressed(TransContext *txc,
+				   CollectionRef& c,
+				   OnodeRef o,
+				   uint64_t offset, uint64_t length,
+				   bufferlist& bl)
+{
+  // only whole-object writes, to fragment files, of a size that is
+  // worth it and cheap enough to decompress on every read
+  if (!compressor || block_fd >= 0 ||
+      offset > 0 || length < o->onode.size ||
+      length < g_conf->newstore_compression_min_size ||
+      length > g_conf->newstore_compression_max_size)
+    return -EAGAIN;
+  if (!compression_pools.empty()) {
+    spg_t pgid;
+    if (!c->cid.is_pg(&pgid) || !compression_pools.count(pgid.pool()))
+      return -EAGAIN;
+  }
+
+  bufferlist cbl;
+  int r = compressor->compress(bl, cbl);
+  if (r < 0 ||
+      cbl.length() > length * g_conf->newstore_compression_required_ratio) {
+    dout(20) << __func__ << " " << length << " bytes compress to "
+	     << cbl.length() << ", storing raw" << dendl;
+    logger->inc(l_newstore_compress_rejected);
+    return -EAGAIN;
+  }
+
+  // drop whatever was there before
+  r = _do_truncate(txc, o, 0);
+  if (r < 0)
+    return r;
+  assert(o->onode.data_map.empty());
+  assert(o->onode.overlay_map.empty());
+
+  o->exists = true;
+  fragment_t &f = o->onode.data_map[0];
+  f.offset = 0;
+  f.length = cbl.length();
+  int fd = _create_fid(txc, &f.fid, O_RDWR);
+  if (fd < 0)
+    return fd;
+  r = cbl.write_fd(fd);
+  if (r < 0) {
+    derr << __func__ << " cbl.write_fd error: " << cpp_strerror(r) << dendl;
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    return r;
+  }
+  txc->sync_fd(fd);
+  o->onode.compression = g_conf->newstore_compression;
+  o->onode.size = length;
+  txc->write_onode(o);
+  logger->inc(l_newstore_compress_bytes, length);
+  logger->inc(l_newstore_compressed_bytes, cbl.length());
+  dout(20) << __func__ << " " << length << " bytes as " << cbl.length()
+	   << " " << o->onode.compression << " bytes in " << f.fid << dendl;
+  return 0;
+}
+
+int NewStore::_do_compressed_promote(TransContext *txc, OnodeRef o)
+{
+  dout(20) << __func__ << " decompressing " << o->onode.size << " bytes"
+	   << dendl;
+  bufferlist bl;
+  int r = _do_read(o, 0, o->onode.size, bl, 0);
+  if (r < 0)
+    return r;
+  r = _do_truncate(txc, o, 0);
+  if (r < 0)
+    return r;
+  return _do_write_data(txc, o, 0, bl.length(), bl, 0);
+}
+
 int NewStore::_do_write(TransContext *txc,
 			OnodeRef o,
 			uint64_t offset, uint64_t length,
 			bufferlist& bl,
 			uint32_t fadvise_flags)
+{
+  if (length > 0 && o->onode.is_compressed()) {
+    // nothing to keep if this replaces the whole object
+    int r;
+    if (offset == 0 && length >= o->onode.size)
+      r = _do_truncate(txc, o, 0);
+    else
+      r = _do_compressed_promote(txc, o);
+    if (r < 0)
+      return r;
+  }
+  if (length > 0 && _can_inline(o, offset + length)) {
+    o->exists = true;
+    _do_write_inline(txc, o, offset, length, bl);
+    return 0;
+  }
+  if (length > 0 && o->onode.is_inline()) {
+    int r = _do_inline_promote(txc, o);
+    if (r < 0)
+      return r;
+  }
+  return _do_write_data(txc, o, offset, length, bl, fadvise_flags);
+}
+
+int NewStore::_do_write_data(TransContext *txc,
+			     OnodeRef o,
+			     uint64_t offset, uint64_t length,
+			     bufferlist& bl,
+			     uint32_t fadvise_flags)
 {
   int fd = -1;
   int r = 0;
@@ -3400,6 +4218,11 @@ int NewStore::_do_write(TransContext *txc,
     goto out;
   }
 
+  if (block_fd >= 0) {
+    r = _do_write_block(txc, o, offset, length, bl);
+    goto out;
+  }
+
   if ((int)o->onode.overlay_map.size() < g_conf->newstore_overlay_max &&
       (int)length <= g_conf->newstore_overlay_max_length) {
     // write an overlay
@@ -3580,6 +4403,221 @@ int NewStore::_do_write(TransContext *txc,
   return r;
 }
 
+void NewStore::_block_sync(TransContext *txc)
+{
+  if (!txc->block_sync) {
+    txc->sync_fd(::dup(block_fd));
+    txc->block_sync = true;
+  }
+}
+
+void NewStore::_block_punch(TransContext *txc, OnodeRef o,
+			    uint64_t offset, uint64_t length)
+{
+  uint64_t end = offset + length;
+  map<uint64_t,block_extent_t>& bm = o->onode.block_map;
+  map<uint64_t,block_extent_t>::iterator p = bm.lower_bound(offset);
+  if (p != bm.begin()) {
+    --p;
+    if (p->first + p->second.length <= offset)
+      ++p;
+  }
+  while (p != bm.end() && p->first < end) {
+    uint64_t l_start = p->first;
+    block_extent_t e = p->second;
+    uint64_t l_end = l_start + e.length;
+    bm.erase(p++);
+    if (l_start < offset) {
+      // keep the head; same device offset, so this replaces its key
+      block_extent_t h(e.offset, offset - l_start);
+      bm[l_start] = h;
+      set_alloc_key(txc->t, h);
+    } else {
+      string key;
+      get_alloc_key(e.offset, &key);
+      txc->t->rmkey(PREFIX_ALLOC, key);
+    }
+    if (l_end > end) {
+      block_extent_t t(e.offset + (end - l_start), l_end - end);
+      bm[end] = t;
+      set_alloc_key(txc->t, t);
+    }
+    uint64_t x_start = MAX(l_start, offset);
+    uint64_t x_end = MIN(l_end, end);
+    block_extent_t r(e.offset + (x_start - l_start), x_end - x_start);
+    dout(20) << __func__ << " " << x_start << "~" << (x_end - x_start)
+	     << " was " << r << dendl;
+    txc->released.push_back(r);
+  }
+}
+
+void NewStore::_block_map_add(TransContext *txc, OnodeRef o,
+			      uint64_t offset, const block_extent_t& e)
+{
+  map<uint64_t,block_extent_t>& bm = o->onode.block_map;
+  map<uint64_t,block_extent_t>::iterator p = bm.lower_bound(offset);
+  if (p != bm.begin()) {
+    --p;
+    if (p->first + p->second.length == offset &&
+	p->second.end() == e.offset &&
+	(uint64_t)p->second.length + e.length <= BLOCK_MAX_EXTENT) {
+      p->second.length += e.length;
+      set_alloc_key(txc->t, p->second);
+      return;
+    }
+  }
+  bm[offset] = e;
+  set_alloc_key(txc->t, e);
+}
+
+bool NewStore::_block_lookup(OnodeRef o, uint64_t offset, uint64_t *dev_offset)
+{
+  map<uint64_t,block_extent_t>& bm = o->onode.block_map;
+  map<uint64_t,block_extent_t>::iterator p = bm.upper_bound(offset);
+  if (p == bm.begin())
+    return false;
+  --p;
+  if (p->first + p->second.length <= offset)
+    return false;
+  *dev_offset = p->second.offset + (offset - p->first);
+  return true;
+}
+
+int NewStore::_block_write_new(TransContext *txc, OnodeRef o,
+			       uint64_t offset, bufferlist& bl)
+{
+  uint64_t length = bl.length();
+  _block_punch(txc, o, offset, length);
+
+  // continue after whatever precedes us in the object
+  uint64_t hint = 0;
+  map<uint64_t,block_extent_t>::iterator p =
+    o->onode.block_map.lower_bound(offset);
+  if (p != o->onode.block_map.begin()) {
+    --p;
+    hint = p->second.end();
+  }
+
+  uint64_t done = 0;
+  while (done < length) {
+    uint64_t dev_off, got;
+    int r = alloc.allocate(MIN(length - done, BLOCK_MAX_EXTENT), hint,
+			   &dev_off, &got);
+    if (r < 0) {
+      derr << __func__ << " failed to allocate " << (length - done)
+	   << " bytes: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+    bufferlist t;
+    t.substr_of(bl, done, got);
+    dout(20) << __func__ << " " << (offset + done) << "~" << got
+	     << " to 0x" << std::hex << dev_off << std::dec << dendl;
+    r = t.write_fd(block_fd, dev_off);
+    if (r < 0) {
+      derr << __func__ << " write_fd on block got: " << cpp_strerror(r)
+	   << dendl;
+      alloc.release(dev_off, got);
+      return r;
+    }
+    _block_map_add(txc, o, offset + done, block_extent_t(dev_off, got));
+    hint = dev_off + got;
+    done += got;
+  }
+  _block_sync(txc);
+  return 0;
+}
+
+void NewStore::_block_zero(TransContext *txc, OnodeRef o,
+			   uint64_t offset, uint64_t length)
+{
+  uint64_t bs = alloc.get_block_size();
+  uint64_t end = offset + length;
+  uint64_t pos = offset;
+  while (pos < end) {
+    uint64_t b_start = pos - pos % bs;
+    if (pos == b_start && end - pos >= bs) {
+      uint64_t run = (end - pos) - (end - pos) % bs;
+      _block_punch(txc, o, pos, run);
+      pos += run;
+      continue;
+    }
+    uint64_t x_len = MIN(end, b_start + bs) - pos;
+    uint64_t dev_off;
+    if (_block_lookup(o, b_start, &dev_off)) {
+      wal_op_t *op = _get_wal_op(txc);
+      op->op = wal_op_t::OP_BWRITE;
+      op->offset = dev_off + (pos - b_start);
+      op->length = x_len;
+      bufferptr z(x_len);
+      z.zero();
+      op->data.append(z);
+      dout(20) << __func__ << " wal zero " << pos << "~" << x_len << dendl;
+    }
+    pos += x_len;
+  }
+}
+
+int NewStore::_do_write_block(TransContext *txc,
+			      OnodeRef o,
+			      uint64_t offset, uint64_t length,
+			      bufferlist& bl)
+{
+  uint64_t bs = alloc.get_block_size();
+  uint64_t end = offset + length;
+  uint64_t pos = offset;
+  int r;
+
+  dout(20) << __func__ << " " << offset << "~" << length << " have "
+	   << o->onode.size << " bytes in " << o->onode.block_map.size()
+	   << " extents" << dendl;
+
+  // whole blocks go to newly allocated space; partial blocks that are
+  // already mapped are overwritten in place by the wal.
+  while (pos < end) {
+    uint64_t b_start = pos - pos % bs;
+    if (pos == b_start && end - pos >= bs) {
+      uint64_t run = (end - pos) - (end - pos) % bs;
+      bufferlist t;
+      t.substr_of(bl, pos - offset, run);
+      r = _block_write_new(txc, o, pos, t);
+      if (r < 0)
+	return r;
+      pos += run;
+      continue;
+    }
+    uint64_t x_len = MIN(end, b_start + bs) - pos;
+    bufferlist t;
+    t.substr_of(bl, pos - offset, x_len);
+    uint64_t dev_off;
+    if (_block_lookup(o, b_start, &dev_off)) {
+      wal_op_t *op = _get_wal_op(txc);
+      op->op = wal_op_t::OP_BWRITE;
+      op->offset = dev_off + (pos - b_start);
+      op->length = x_len;
+      op->data.claim(t);
+      dout(20) << __func__ << " wal " << pos << "~" << x_len
+	       << " at 0x" << std::hex << op->offset << std::dec << dendl;
+    } else {
+      // fresh block; the rest of it must read back as zeros
+      bufferlist b;
+      if (pos > b_start)
+	b.append_zero(pos - b_start);
+      b.claim_append(t);
+      if (b.length() < bs)
+	b.append_zero(bs - b.length());
+      r = _block_write_new(txc, o, b_start, b);
+      if (r < 0)
+	return r;
+    }
+    pos += x_len;
+  }
+
+  if (end > o->onode.size)
+    o->onode.size = end;
+  txc->write_onode(o);
+  return 0;
+}
+
 int NewStore::_clean_fid_tail_fd(const fragment_t& f, int fd)
 {
   struct stat st;
@@ -3637,7 +4675,9 @@ int NewStore::_write(TransContext *txc,
   RWLock::WLocker l(c->lock);
   OnodeRef o = c->get_onode(oid, true);
   _assign_nid(txc, o);
-  int r = _do_write(txc, o, offset, length, bl, fadvise_flags);
+  int r = _do_write_compressed(txc, c, o, offset, length, bl);
+  if (r == -EAGAIN)
+    r = _do_write(txc, o, offset, length, bl, fadvise_flags);
   txc->write_onode(o);
 
   dout(10) << __func__ << " " << c->cid << " " << oid
@@ -3660,6 +4700,33 @@ int NewStore::_zero(TransContext *txc,
   OnodeRef o = c->get_onode(oid, true);
   _assign_nid(txc, o);
 
+  if (_can_inline(o, offset + length)) {
+    bufferlist z;
+    z.append_zero(length);
+    _do_write_inline(txc, o, offset, length, z);
+    goto out;
+  }
+  if (o->onode.is_inline()) {
+    r = _do_inline_promote(txc, o);
+    if (r < 0)
+      goto out;
+  }
+  if (o->onode.is_compressed()) {
+    r = _do_compressed_promote(txc, o);
+    if (r < 0)
+      goto out;
+  }
+
+  if (block_fd >= 0) {
+    // past the end is zero already
+    if (offset < o->onode.size)
+      _block_zero(txc, o, offset, MIN(length, o->onode.size - offset));
+    if (offset + length > o->onode.size)
+      o->onode.size = offset + length;
+    txc->write_onode(o);
+    goto out;
+  }
+
   // overlay
   if (_do_overlay_trim(txc, o, offset, length) > 0)
     txc->write_onode(o);
@@ -3718,6 +4785,48 @@ int NewStore::_zero(TransContext *txc,
 
 int NewStore::_do_truncate(TransContext *txc, OnodeRef o, uint64_t offset)
 {
+  if (o->onode.is_compressed()) {
+    if (offset == 0) {
+      // the fragment goes below; what is left is plain
+      o->onode.compression.clear();
+    } else {
+      int r = _do_compressed_promote(txc, o);
+      if (r < 0)
+	return r;
+    }
+  }
+
+  if (o->onode.is_inline()) {
+    if (offset <= (uint64_t)g_conf->newstore_inline_max) {
+      bufferlist& d = o->onode.inline_data;
+      if (offset < d.length()) {
+	bufferlist t;
+	t.substr_of(d, 0, offset);
+	d.swap(t);
+      } else {
+	d.append_zero(offset - d.length());
+      }
+      o->onode.size = offset;
+      txc->write_onode(o);
+      return 0;
+    }
+    int r = _do_inline_promote(txc, o);
+    if (r < 0)
+      return r;
+  }
+
+  if (block_fd >= 0) {
+    // drop the blocks past the new end and zero the rest of the last
+    // one, so that a later extension reads zeros
+    if (offset < o->onode.size) {
+      uint64_t bs = alloc.get_block_size();
+      _block_zero(txc, o, offset, ROUND_UP_TO(o->onode.size, bs) - offset);
+    }
+    o->onode.size = offset;
+    txc->write_onode(o);
+    return 0;
+  }
+
   // trim down fragments
   map<uint64_t,fragment_t>::iterator fp = o->onode.data_map.end();
   if (fp != o->onode.data_map.begin())
@@ -3853,6 +4962,18 @@ int NewStore::_do_remove(TransContext *txc,
     }
   }
   o->onode.data_map.clear();
+  for (map<uint64_t,block_extent_t>::iterator p = o->onode.block_map.begin();
+       p != o->onode.block_map.end();
+       ++p) {
+    dout(20) << __func__ << " will release " << p->second << dendl;
+    string akey;
+    get_alloc_key(p->second.offset, &akey);
+    txc->t->rmkey(PREFIX_ALLOC, akey);
+    txc->released.push_back(p->second);
+  }
+  o->onode.block_map.clear();
+  o->onode.inline_data.clear();
+  o->onode.compression.clear();
   o->onode.size = 0;
   if (o->onode.omap_head) {
     _do_omap_clear(txc, o->onode.omap_head);
@@ -3989,20 +5110,11 @@ int NewStore::_rmattrs(TransContext *txc,
 
 void NewStore::_do_omap_clear(TransContext *txc, uint64_t id)
 {
-  KeyValueDB::Iterator it = db->get_iterator(PREFIX_OMAP);
   string prefix, tail;
   get_omap_header(id, &prefix);
   get_omap_tail(id, &tail);
-  it->lower_bound(prefix);
-  while (it->valid()) {
-    if (it->key() >= tail) {
-      dout(30) << __func__ << "  stop at " << tail << dendl;
-      break;
-    }
-    txc->t->rmkey(PREFIX_OMAP, it->key());
-    dout(30) << __func__ << "  rm " << it->key() << dendl;
-    it->next();
-  }
+  dout(30) << __func__ << "  rm " << prefix << " to " << tail << dendl;
+  txc->t->rm_range_keys(PREFIX_OMAP, prefix, tail);
 }
 
 int NewStore::_omap_clear(TransContext *txc,
@@ -4129,7 +5241,6 @@ int NewStore::_omap_rmkey_range(TransContext *txc,
 {
   dout(15) << __func__ << " " << c->cid << " " << oid << dendl;
   int r = 0;
-  KeyValueDB::Iterator it;
   string key_first, key_last;
 
   RWLock::WLocker l(c->lock);
@@ -4142,19 +5253,10 @@ int NewStore::_omap_rmkey_range(TransContext *txc,
     r = 0;
     goto out;
   }
-  it = db->get_iterator(PREFIX_OMAP);
   get_omap_key(o->onode.omap_head, first, &key_first);
   get_omap_key(o->onode.omap_head, last, &key_last);
-  it->lower_bound(key_first);
-  while (it->valid()) {
-    if (it->key() >= key_last) {
-      dout(30) << __func__ << "  stop at " << key_last << dendl;
-      break;
-    }
-    txc->t->rmkey(PREFIX_OMAP, it->key());
-    dout(30) << __func__ << "  rm " << it->key() << dendl;
-    it->next();
-  }
+  dout(30) << __func__ << "  rm " << key_first << " to " << key_last << dendl;
+  txc->t->rm_range_keys(PREFIX_OMAP, key_first, key_last);
   r = 0;
 
  out:
@@ -4219,6 +5321,9 @@ int NewStore::_clone(TransContext *txc,
     goto out;
 
   // truncate any old data
+  if (block_fd >= 0 || newo->onode.is_inline() ||
+      newo->onode.is_compressed())
+    _do_truncate(txc, newo, 0);
   while (!newo->onode.data_map.empty()) {
     wal_op_t *op = _get_wal_op(txc);
     op->op = wal_op_t::OP_REMOVE;
@@ -4226,7 +5331,9 @@ int NewStore::_clone(TransContext *txc,
     newo->onode.data_map.erase(newo->onode.data_map.rbegin()->first);
   }
 
-  r = _do_write(txc, newo, 0, oldo->onode.size, bl, 0);
+  r = _do_write_compressed(txc, c, newo, 0, oldo->onode.size, bl);
+  if (r == -EAGAIN)
+    r = _do_write(txc, newo, 0, oldo->onode.size, bl, 0);
 
   newo->onode.attrs = oldo->onode.attrs;
 
@@ -4341,8 +5448,7 @@ int NewStore::_rename(TransContext *txc,
   get_object_key(old_oid, &old_key);
   get_object_key(new_oid, &new_key);
 
-  c->onode_map.rename(old_oid, new_oid);
-  oldo->oid = new_oid;
+  onode_cache.rename(c.get(), old_oid, new_oid);
   oldo->key = new_key;
 
   txc->t->rmkey(PREFIX_OBJ, old_key);
@@ -4399,9 +5505,10 @@ int NewStore::_remove_collection(TransContext *txc, coll_t cid,
       r = -ENOENT;
       goto out;
     }
-    pair<ghobject_t,OnodeRef> next;
-    while ((*c)->onode_map.get_next(next.first, &next)) {
-      if (next.second->exists) {
+    vector<OnodeRef> ls;
+    (*c)->get_cached_onodes(&ls);
+    for (vector<OnodeRef>::iterator p = ls.begin(); p != ls.end(); ++p) {
+      if ((*p)->exists) {
 	r = -ENOTEMPTY;
 	goto out;
       }
@@ -4428,8 +5535,8 @@ int NewStore::_split_collection(TransContext *txc,
   int r;
   RWLock::WLocker l(c->lock);
   RWLock::WLocker l2(d->lock);
-  c->onode_map.clear();
-  d->onode_map.clear();
+  onode_cache.clear(c.get());
+  onode_cache.clear(d.get());
   c->cnode.bits = bits;
   assert(d->cnode.bits == bits);
   r = 0;
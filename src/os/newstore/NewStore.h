@@ -25,20 +25,51 @@
 #include "common/Finisher.h"
 #include "common/RWLock.h"
 #include "common/WorkQueue.h"
+#include "compressor/Compressor.h"
 #include "os/ObjectStore.h"
 #include "os/fs/FS.h"
 #include "os/KeyValueDB.h"
 
 #include "newstore_types.h"
+#include "BlockAllocator.h"
 
 #include "boost/intrusive/list.hpp"
 
+enum {
+  l_newstore_first = 25500,
+  l_newstore_onode_hit,
+  l_newstore_onode_miss,
+  l_newstore_onode_ghost_hit,
+  l_newstore_onode_evict,
+  l_newstore_onode_pinned,
+  l_newstore_onodes,
+  l_newstore_onode_bytes,
+  l_newstore_state_prepare_lat,
+  l_newstore_state_aio_wait_lat,
+  l_newstore_state_io_done_lat,
+  l_newstore_state_kv_queued_lat,
+  l_newstore_state_kv_committing_lat,
+  l_newstore_state_wal_queued_lat,
+  l_newstore_state_wal_applying_lat,
+  l_newstore_state_wal_aio_wait_lat,
+  l_newstore_state_wal_cleanup_lat,
+  l_newstore_state_finishing_lat,
+  l_newstore_state_done_lat,
+  l_newstore_kv_commit_lat,
+  l_newstore_kv_commit_txcs,
+  l_newstore_compress_bytes,
+  l_newstore_compressed_bytes,
+  l_newstore_compress_rejected,
+  l_newstore_last
+};
+
 class NewStore : public ObjectStore {
   // -----------------------------------------------------
   // types
 public:
 
   class TransContext;
+  struct Collection;
 
   /// an in-memory object
   struct Onode {
@@ -48,6 +79,12 @@ public:
     string key;     ///< key under PREFIX_OBJ where we are stored
     boost::intrusive::list_member_hook<> lru_item;
 
+    // protected by the OnodeCache shard lock
+    Collection *coll;      ///< collection we are cached for, if any
+    boost::intrusive::list_member_hook<> coll_item;
+    uint8_t cache_list;    ///< which OnodeCache list we are on
+    uint32_t cache_bytes;  ///< what we count against the cache budget
+
     onode_t onode;  ///< metadata stored as value in kv store
     bool dirty;     // ???
     bool exists;
@@ -73,7 +110,27 @@ public:
   };
   typedef boost::intrusive_ptr<Onode> OnodeRef;
 
-  struct OnodeHashLRU {
+  /**
+   * Store-wide onode cache with a byte budget.
+   *
+   * Sharded by object hash; each shard has its own lock and an equal
+   * part of newstore_onode_cache_size.  Replacement is 2Q: a new onode
+   * goes on a FIFO (a1in) and only one that is asked for again after
+   * falling off it (its oid is remembered on the a1out ghost list) is
+   * promoted to the LRU (am).  A scrub or backfill that touches every
+   * object once only churns a1in.  Onodes referenced outside the cache
+   * are never evicted; the shard goes over budget instead.
+   *
+   * Onodes are also linked on their collection's list so a collection
+   * can find its own.  Lock order: shard lock, then
+   * Collection::onode_lock.
+   */
+  struct OnodeCache {
+    enum {
+      LIST_NONE = 0,
+      LIST_A1IN,
+      LIST_AM,
+    };
     typedef boost::intrusive::list<
       Onode,
       boost::intrusive::member_hook<
@@ -81,20 +138,45 @@ public:
 	boost::intrusive::list_member_hook<>,
 	&Onode::lru_item> > lru_list_t;
 
-    Mutex lock;
-    ceph::unordered_map<ghobject_t,OnodeRef> onode_map;  ///< forward lookups
-    lru_list_t lru;                                      ///< lru
-
-    OnodeHashLRU() : lock("NewStore::OnodeHashLRU::lock") {}
-
-    void add(const ghobject_t& oid, OnodeRef o);
-    void _touch(OnodeRef o);
-    OnodeRef lookup(const ghobject_t& o);
-    void remove(const ghobject_t& o);
-    void rename(const ghobject_t& old_oid, const ghobject_t& new_oid);
+    struct Shard {
+      Mutex lock;
+      ceph::unordered_map<ghobject_t,OnodeRef> onode_map;
+      lru_list_t a1in;     ///< seen once, oldest at the back
+      lru_list_t am;       ///< seen again, lru at the back
+      list<ghobject_t> a1out;  ///< recently pushed out of a1in
+      ceph::unordered_map<ghobject_t,list<ghobject_t>::iterator> a1out_map;
+      uint64_t bytes, a1in_bytes;
+
+      Shard()
+	: lock("NewStore::OnodeCache::Shard::lock"),
+	  bytes(0), a1in_bytes(0) {}
+    };
+
+    PerfCounters *logger;
+    vector<Shard*> shards;
+    uint64_t shard_max;  ///< byte budget per shard
+
+    OnodeCache(unsigned num_shards, uint64_t max_bytes);
+    ~OnodeCache();
+
+    Shard *get_shard(const ghobject_t& oid) {
+      // the low hash bits are shared by a pg; spread on the high ones
+      return shards[oid.hobj.get_bitwise_key_u32() % shards.size()];
+    }
+
+    OnodeRef lookup(Collection *c, const ghobject_t& oid);
+    /// @returns o, or the onode another thread added first
+    OnodeRef add(Collection *c, OnodeRef o);
+    void resize(OnodeRef o, uint32_t bytes);
+    void rename(Collection *c, const ghobject_t& old_oid,
+		const ghobject_t& new_oid);
+    void clear(Collection *c);  ///< drop all of c's onodes
     void clear();
-    bool get_next(const ghobject_t& after, pair<ghobject_t,OnodeRef> *next);
-    int trim(int max=-1);
+
+  private:
+    void _link(Shard *s, Collection *c, OnodeRef o, bool again);
+    void _unlink(Shard *s, Onode *o);
+    void _trim(Shard *s);
   };
 
   struct Collection {
@@ -103,11 +185,18 @@ public:
     cnode_t cnode;
     RWLock lock;
 
-    // cache onodes on a per-collection basis to avoid lock
-    // contention.
-    OnodeHashLRU onode_map;
+    typedef boost::intrusive::list<
+      Onode,
+      boost::intrusive::member_hook<
+        Onode,
+	boost::intrusive::list_member_hook<>,
+	&Onode::coll_item> > onode_list_t;
+    Mutex onode_lock;      ///< protects onodes
+    onode_list_t onodes;   ///< our onodes in the OnodeCache
 
     OnodeRef get_onode(const ghobject_t& oid, bool create);
+    /// cached onodes, for a quick scan of what the collection holds
+    void get_cached_onodes(vector<OnodeRef> *ls);
 
     Collection(NewStore *ns, coll_t c);
   };
@@ -195,6 +284,8 @@ public:
     Context *onreadable_sync;         ///< signal on readable
     list<Context*> oncommits;  ///< more commit completions
     list<CollectionRef> removed_collections; ///< colls we removed
+    vector<block_extent_t> released; ///< device extents to free when done
+    bool block_sync;           ///< block_fd is in sync_items
 
     boost::intrusive::list_member_hook<> wal_queue_item;
     wal_transaction_t *wal_txn; ///< wal transaction (if any)
@@ -210,6 +301,16 @@ public:
 
     CollectionRef first_collection;  ///< first referenced collection
 
+    utime_t start;       ///< when the txc was created
+    utime_t last_stamp;  ///< when the txc entered its current state
+
+    /// account the time spent in the state we are leaving
+    void log_state_latency(PerfCounters *logger, int idx) {
+      utime_t now = ceph_clock_now(NULL);
+      logger->tinc(idx, now - last_stamp);
+      last_stamp = now;
+    }
+
     TransContext(OpSequencer *o)
       : state(STATE_PREPARE),
 	osr(o),
@@ -218,10 +319,13 @@ public:
 	oncommit(NULL),
 	onreadable(NULL),
 	onreadable_sync(NULL),
+	block_sync(false),
 	wal_txn(NULL),
 	num_fsyncs_completed(0),
 	num_aio(0),
-	lock("NewStore::TransContext::lock") {
+	lock("NewStore::TransContext::lock"),
+	start(ceph_clock_now(NULL)),
+	last_stamp(start) {
       //cout << "txc new " << this << std::endl;
     }
     ~TransContext() {
@@ -466,11 +570,19 @@ private:
   int fsid_fd;  ///< open handle (locked) to $path/fsid
   int frag_fd;  ///< open handle to $path/fragments
   int fset_fd;  ///< open handle to $path/fragments/$cur_fid.fset
+  int block_fd; ///< open handle to $path/block, if we use a block device
+  BlockAllocator alloc;  ///< free space on the block device
   bool mounted;
 
+  /// for whole-object writes to the pools we compress, if enabled
+  Compressor *compressor;
+  set<int64_t> compression_pools;  ///< empty for all of them
+
   RWLock coll_lock;    ///< rwlock to protect coll_map
   ceph::unordered_map<coll_t, CollectionRef> coll_map;
 
+  OnodeCache onode_cache;
+
   Mutex fid_lock;
   fid_t fid_last;  ///< last allocated fid
   fid_t fid_max;   ///< max fid we can allocate before reserving more
@@ -502,7 +614,7 @@ private:
   deque<TransContext*> kv_queue, kv_committing;
   deque<TransContext*> wal_cleanup_queue, wal_cleaning;
 
-  Logger *logger;
+  PerfCounters *logger;
 
   Mutex reap_lock;
   Cond reap_cond;
@@ -527,6 +639,10 @@ private:
   void _close_frag();
   int _open_db();
   void _close_db();
+  int _create_block();
+  int _open_block();
+  int _open_alloc();
+  void _close_block();
   int _open_collections();
   void _close_collections();
 
@@ -542,6 +658,17 @@ private:
   int _recover_next_nid();
   void _assign_nid(TransContext *txc, OnodeRef o);
 
+  void _block_sync(TransContext *txc);
+  void _block_punch(TransContext *txc, OnodeRef o,
+		    uint64_t offset, uint64_t length);
+  void _block_map_add(TransContext *txc, OnodeRef o,
+		      uint64_t offset, const block_extent_t& e);
+  bool _block_lookup(OnodeRef o, uint64_t offset, uint64_t *dev_offset);
+  int _block_write_new(TransContext *txc, OnodeRef o,
+		       uint64_t offset, bufferlist& bl);
+  void _block_zero(TransContext *txc, OnodeRef o,
+		   uint64_t offset, uint64_t length);
+
   int _clean_fid_tail_fd(const fragment_t& f, int fd);
   int _clean_fid_tail(TransContext *txc, const fragment_t& f);
 
@@ -620,6 +747,18 @@ public:
 
   int statfs(struct statfs *buf);
 
+  void dump_kv_stats(Formatter *f) {
+    if (db)
+      db->get_statistics(f);
+  }
+  int compact_kv(const string& prefix,
+		 const string& start, const string& end) {
+    if (!db)
+      return -EOPNOTSUPP;
+    db->compact_keys(prefix, start, end);
+    return 0;
+  }
+
   bool exists(coll_t cid, const ghobject_t& oid);
   int stat(
     coll_t cid,
@@ -640,6 +779,16 @@ public:
     size_t len,
     bufferlist& bl,
     uint32_t op_flags = 0);
+  int _do_read_block(
+    OnodeRef o,
+    uint64_t offset,
+    size_t len,
+    bufferlist& bl);
+  int _do_read_compressed(
+    OnodeRef o,
+    uint64_t offset,
+    size_t len,
+    bufferlist& bl);
 
   int fiemap(coll_t cid, const ghobject_t& oid, uint64_t offset, size_t len, bufferlist& bl);
   int getattr(coll_t cid, const ghobject_t& oid, const char *name, bufferptr& value);
@@ -746,6 +895,30 @@ private:
 		uint64_t offset, uint64_t length,
 		bufferlist& bl,
 		uint32_t fadvise_flags);
+  int _do_write_data(TransContext *txc,
+		     OnodeRef o,
+		     uint64_t offset, uint64_t length,
+		     bufferlist& bl,
+		     uint32_t fadvise_flags);
+  bool _can_inline(OnodeRef o, uint64_t end);
+  void _do_write_inline(TransContext *txc,
+			OnodeRef o,
+			uint64_t offset, uint64_t length,
+			bufferlist& bl);
+  int _do_inline_promote(TransContext *txc, OnodeRef o);
+  int _open_compressor();
+  void _close_compressor();
+  /// compress a whole-object write; -EAGAIN to write it raw instead
+  int _do_write_compressed(TransContext *txc,
+			   CollectionRef& c,
+			   OnodeRef o,
+			   uint64_t offset, uint64_t length,
+			   bufferlist& bl);
+  int _do_compressed_promote(TransContext *txc, OnodeRef o);
+  int _do_write_block(TransContext *txc,
+		      OnodeRef o,
+		      uint64_t offset, uint64_t length,
+		      bufferlist& bl);
   int _touch(TransContext *txc,
 	     CollectionRef& c,
 	     const ghobject_t& oid);
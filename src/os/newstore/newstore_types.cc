@@ -98,6 +98,42 @@ ostream& operator<<(ostream& out, const fragment_t& f)
   return out;
 }
 
+// block_extent_t
+
+void block_extent_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(offset, bl);
+  ::encode(length, bl);
+  ENCODE_FINISH(bl);
+}
+
+void block_extent_t::decode(bufferlist::iterator& p)
+{
+  DECODE_START(1, p);
+  ::decode(offset, p);
+  ::decode(length, p);
+  DECODE_FINISH(p);
+}
+
+void block_extent_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("offset", offset);
+  f->dump_unsigned("length", length);
+}
+
+void block_extent_t::generate_test_instances(list<block_extent_t*>& o)
+{
+  o.push_back(new block_extent_t());
+  o.push_back(new block_extent_t(8192, 4096));
+}
+
+ostream& operator<<(ostream& out, const block_extent_t& e)
+{
+  out << "0x" << std::hex << e.offset << "~" << e.length << std::dec;
+  return out;
+}
+
 // overlay_t
 
 void overlay_t::encode(bufferlist& bl) const
@@ -142,7 +178,7 @@ ostream& operator<<(ostream& out, const overlay_t& o)
 
 void onode_t::encode(bufferlist& bl) const
 {
-  ENCODE_START(1, 1, bl);
+  ENCODE_START(4, 1, bl);
   ::encode(nid, bl);
   ::encode(size, bl);
   ::encode(attrs, bl);
@@ -153,12 +189,15 @@ void onode_t::encode(bufferlist& bl) const
   ::encode(omap_head, bl);
   ::encode(expected_object_size, bl);
   ::encode(expected_write_size, bl);
+  ::encode(block_map, bl);
+  ::encode(inline_data, bl);
+  ::encode(compression, bl);
   ENCODE_FINISH(bl);
 }
 
 void onode_t::decode(bufferlist::iterator& p)
 {
-  DECODE_START(1, p);
+  DECODE_START(4, p);
   ::decode(nid, p);
   ::decode(size, p);
   ::decode(attrs, p);
@@ -169,6 +208,12 @@ void onode_t::decode(bufferlist::iterator& p)
   ::decode(omap_head, p);
   ::decode(expected_object_size, p);
   ::decode(expected_write_size, p);
+  if (struct_v >= 2)
+    ::decode(block_map, p);
+  if (struct_v >= 3)
+    ::decode(inline_data, p);
+  if (struct_v >= 4)
+    ::decode(compression, p);
   DECODE_FINISH(p);
 }
 
@@ -193,6 +238,17 @@ void onode_t::dump(Formatter *f) const
     f->close_section();
   }
   f->close_section();
+  f->dump_unsigned("inline_data_len", inline_data.length());
+  f->dump_string("compression", compression);
+  f->open_array_section("block_map");
+  for (map<uint64_t, block_extent_t>::const_iterator p = block_map.begin();
+       p != block_map.end(); ++p) {
+    f->open_object_section("extent");
+    f->dump_unsigned("logical_offset", p->first);
+    p->second.dump(f);
+    f->close_section();
+  }
+  f->close_section();
   f->open_object_section("overlays");
   for (map<uint64_t, overlay_t>::const_iterator p = overlay_map.begin();
        p != overlay_map.end(); ++p) {
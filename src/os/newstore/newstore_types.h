@@ -90,6 +90,27 @@ WRITE_CLASS_ENCODER(fragment_t)
 
 ostream& operator<<(ostream& out, const fragment_t& o);
 
+/// extent on the block device (block data mode)
+struct block_extent_t {
+  uint64_t offset;   ///< device offset
+  uint32_t length;
+
+  block_extent_t() : offset(0), length(0) {}
+  block_extent_t(uint64_t o, uint32_t l) : offset(o), length(l) {}
+
+  uint64_t end() const {
+    return offset + length;
+  }
+
+  void encode(bufferlist& bl) const;
+  void decode(bufferlist::iterator& p);
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<block_extent_t*>& o);
+};
+WRITE_CLASS_ENCODER(block_extent_t)
+
+ostream& operator<<(ostream& out, const block_extent_t& e);
+
 struct overlay_t {
   uint64_t key;          ///< key (offset of start of original k/v pair)
   uint32_t value_offset; ///< offset in associated value for this extent
@@ -115,6 +136,9 @@ struct onode_t {
   uint64_t size;                       ///< object size
   map<string, bufferptr> attrs;        ///< attrs
   map<uint64_t, fragment_t> data_map;  ///< data (offset to fragment mapping)
+  map<uint64_t, block_extent_t> block_map; ///< data on the block device
+  bufferlist inline_data;              ///< all of the data, if small
+  string compression;                  ///< data_map holds this compressor's output
   map<uint64_t,overlay_t> overlay_map; ///< overlay data (stored in db)
   set<uint64_t> shared_overlays;       ///< overlay keys that are shared
   uint32_t last_overlay_key;           ///< key for next overlay
@@ -131,6 +155,16 @@ struct onode_t {
       expected_object_size(0),
       expected_write_size(0) {}
 
+  /// data lives in inline_data; nothing in fragments, blocks or overlays
+  bool is_inline() const {
+    return size > 0 && inline_data.length() == size;
+  }
+
+  /// the single fragment holds the whole object, compressed; no overlays
+  bool is_compressed() const {
+    return !compression.empty();
+  }
+
   void encode(bufferlist& bl) const;
   void decode(bufferlist::iterator& p);
   void dump(Formatter *f) const;
@@ -146,6 +180,7 @@ struct wal_op_t {
     OP_TRUNCATE = 3,
     OP_ZERO = 4,
     OP_REMOVE = 5,
+    OP_BWRITE = 6,   ///< write data at offset of the block device
   } type_t;
   __u8 op;
   fid_t fid;
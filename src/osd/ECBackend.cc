@@ -22,6 +22,7 @@
 #include "messages/MOSDPGPush.h"
 #include "messages/MOSDPGPushReply.h"
 #include "ReplicatedPG.h"
+#include "common/errno.h"
 
 class ReplicatedPG;
 
@@ -131,6 +132,9 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
     lhs << " client_op=";
     rhs.client_op->get_req()->print(lhs);
   }
+  if (!rhs.started)
+    lhs << " waiting" << (rhs.rmw_reads_pending ? " for reads" : "")
+	<< (rhs.rmw_read_error ? " (read failed)" : "");
   lhs << " pending_commit=" << rhs.pending_commit
       << " pending_apply=" << rhs.pending_apply
       << ")";
@@ -177,6 +181,8 @@ ECBackend::ECBackend(
   : PGBackend(pg, store, coll),
     cct(cct),
     ec_impl(ec_impl),
+    extent_cache_bytes(0),
+    read_cost_epoch(0),
     sinfo(ec_impl->get_data_chunk_count(), stripe_width) {
   assert((ec_impl->get_data_chunk_count() *
 	  ec_impl->get_chunk_size(stripe_width)) == stripe_width);
@@ -1101,15 +1107,14 @@ void ECBackend::handle_sub_read_reply(
 	dout(20) << __func__ << " minimum_to_decode failed" << dendl;
         if (rop.in_progress.empty()) {
 	  // If we don't have enough copies and we haven't sent reads for all shards
-	  // we can send the rest of the reads, if any.
-	  if (!rop.do_redundant_reads) {
-	    int r = objects_remaining_read_async(iter->first, rop);
-	    if (r == 0) {
-	      // We added to in_progress and not incrementing is_complete
-	      continue;
-	    }
-	    // Couldn't read any additional shards so handle as completed with errors
+	  // we can send the rest of the reads, if any.  A fast read may have
+	  // been limited to a few extra shards, so it gets the same chance.
+	  int r = objects_remaining_read_async(iter->first, rop);
+	  if (r == 0) {
+	    // We added to in_progress and not incrementing is_complete
+	    continue;
 	  }
+	  // Couldn't read any additional shards so handle as completed with errors
 	  if (rop.complete[iter->first].errors.empty()) {
 	    dout(20) << __func__ << " simply not enough copies err=" << err << dendl;
 	  } else {
@@ -1149,6 +1154,29 @@ void ECBackend::handle_sub_read_reply(
 
 void ECBackend::complete_read_op(ReadOp &rop, RecoveryMessages *m)
 {
+  // the first shards to answer were enough; forget the others, their
+  // replies are dropped when they come in
+  if (rop.do_redundant_reads) {
+    PerfCounters *logger = get_parent()->get_logger();
+    logger->inc(l_osd_ec_fast_read);
+    if (!rop.in_progress.empty()) {
+      logger->inc(l_osd_ec_fast_read_early);
+      logger->inc(l_osd_ec_fast_read_discarded, rop.in_progress.size());
+    }
+  }
+  for (set<pg_shard_t>::iterator i = rop.in_progress.begin();
+       i != rop.in_progress.end();
+       ++i) {
+    map<pg_shard_t, set<ceph_tid_t> >::iterator siter =
+      shard_to_read_map.find(*i);
+    if (siter == shard_to_read_map.end())
+      continue;
+    siter->second.erase(rop.tid);
+    if (siter->second.empty())
+      shard_to_read_map.erase(siter);
+  }
+  rop.in_progress.clear();
+
   map<hobject_t, read_request_t, hobject_t::BitwiseComparator>::iterator reqiter =
     rop.to_read.begin();
   map<hobject_t, read_result_t, hobject_t::BitwiseComparator>::iterator resiter =
@@ -1261,6 +1289,19 @@ void ECBackend::check_recovery_sources(const OSDMapRef osdmap)
     assert(j != tid_to_read_map.end());
     filter_read_op(osdmap, j->second);
   }
+
+  // overwrites blocked on a failed stripe read retry with the new map
+  bool retry = false;
+  for (list<Op*>::iterator i = writing.begin(); i != writing.end(); ++i) {
+    Op *op = *i;
+    if (op->rmw_read_error && !op->rmw_reads_pending) {
+      dout(10) << __func__ << ": retrying reads for " << *op << dendl;
+      op->rmw_read_error = 0;
+      retry = true;
+    }
+  }
+  if (retry)
+    try_start_writes();
 }
 
 void ECBackend::on_change()
@@ -1268,6 +1309,8 @@ void ECBackend::on_change()
   dout(10) << __func__ << dendl;
   writing.clear();
   tid_to_op_map.clear();
+  objects_in_flight.clear();
+  extent_cache_clear();
   for (map<ceph_tid_t, ReadOp>::iterator i = tid_to_read_map.begin();
        i != tid_to_read_map.end();
        ++i) {
@@ -1401,31 +1444,255 @@ void ECBackend::submit_transaction(
 	ref));
   }
 
-  for (vector<pg_log_entry_t>::iterator i = op->log_entries.begin();
-       i != op->log_entries.end();
+  dout(10) << __func__ << ": op " << *op << " queued" << dendl;
+  writing.push_back(op);
+  try_start_writes();
+}
+
+struct C_OverwriteReadComplete : public Context {
+  ECBackend *ec;
+  ceph_tid_t tid;
+  C_OverwriteReadComplete(ECBackend *ec, ceph_tid_t tid) : ec(ec), tid(tid) {}
+  void finish(int r) {
+    ec->overwrite_read_complete(tid, r);
+  }
+};
+
+bool ECBackend::prepare_overwrites(Op *op)
+{
+  map<hobject_t, set<uint64_t>, hobject_t::BitwiseComparator> need;
+  op->t->get_overwrite_reads(op->unstable_hash_infos, sinfo, &need);
+
+  // runs of stripes neither the op nor the cache has, by object
+  map<hobject_t, list<pair<uint64_t, uint64_t> >, hobject_t::BitwiseComparator> missing;
+  const uint64_t sw = sinfo.get_stripe_width();
+  for (map<hobject_t, set<uint64_t>, hobject_t::BitwiseComparator>::iterator i =
+	 need.begin();
+       i != need.end();
        ++i) {
-    MustPrependHashInfo vis;
-    i->mod_desc.visit(&vis);
-    if (vis.must_prepend_hash_info()) {
-      dout(10) << __func__ << ": stashing HashInfo for "
-	       << i->soid << " for entry " << *i << dendl;
-      assert(op->unstable_hash_infos.count(i->soid));
-      ObjectModDesc desc;
-      map<string, boost::optional<bufferlist> > old_attrs;
-      bufferlist old_hinfo;
-      ::encode(*(op->unstable_hash_infos[i->soid]), old_hinfo);
-      old_attrs[ECUtil::get_hinfo_key()] = old_hinfo;
-      desc.setattrs(old_attrs);
-      i->mod_desc.swap(desc);
-      i->mod_desc.claim_append(desc);
-      assert(i->mod_desc.can_rollback());
+    ECTransaction::stripe_map_t &have = op->rmw_stripes[i->first];
+    map<hobject_t, CachedObject, hobject_t::BitwiseComparator>::iterator c =
+      extent_cache.find(i->first);
+    for (set<uint64_t>::iterator j = i->second.begin();
+	 j != i->second.end();
+	 ++j) {
+      if (have.count(*j))
+	continue;
+      if (c != extent_cache.end()) {
+	ECTransaction::stripe_map_t::iterator k = c->second.stripes.find(*j);
+	if (k != c->second.stripes.end()) {
+	  have[*j] = k->second;
+	  continue;
+	}
+      }
+      list<pair<uint64_t, uint64_t> > &runs = missing[i->first];
+      if (!runs.empty() && runs.back().first + runs.back().second == *j)
+	runs.back().second += sw;
+      else
+	runs.push_back(make_pair(*j, sw));
     }
   }
+  if (missing.empty())
+    return true;
 
-  dout(10) << __func__ << ": op " << *op << " starting" << dendl;
-  start_write(op);
-  writing.push_back(op);
-  dout(10) << "onreadable_sync: " << op->on_local_applied_sync << dendl;
+  // the shards only have those stripes right once all writes to them
+  // are applied
+  for (map<hobject_t, list<pair<uint64_t, uint64_t> >, hobject_t::BitwiseComparator>::iterator i =
+	 missing.begin();
+       i != missing.end();
+       ++i) {
+    if (objects_in_flight.count(i->first)) {
+      dout(20) << __func__ << ": " << *op << " waiting for writes to "
+	       << i->first << dendl;
+      return false;
+    }
+  }
+
+  for (map<hobject_t, list<pair<uint64_t, uint64_t> >, hobject_t::BitwiseComparator>::iterator i =
+	 missing.begin();
+       i != missing.end();
+       ++i) {
+    dout(10) << __func__ << ": " << *op << " reading " << i->first
+	     << " " << i->second << dendl;
+    list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
+	      pair<bufferlist*, Context*> > > to_read;
+    for (list<pair<uint64_t, uint64_t> >::iterator j = i->second.begin();
+	 j != i->second.end();
+	 ++j) {
+      to_read.push_back(
+	make_pair(
+	  boost::make_tuple(j->first, j->second, 0),
+	  make_pair(&(op->rmw_reads[i->first][j->first]),
+		    (Context*)new C_NoopContext)));
+    }
+    ++op->rmw_reads_pending;
+    objects_read_async(
+      i->first,
+      to_read,
+      new C_OverwriteReadComplete(this, op->tid));
+  }
+  return false;
+}
+
+void ECBackend::overwrite_read_complete(ceph_tid_t tid, int r)
+{
+  map<ceph_tid_t, Op>::iterator i = tid_to_op_map.find(tid);
+  if (i == tid_to_op_map.end()) {
+    dout(10) << __func__ << ": tid " << tid << " gone (interval change)"
+	     << dendl;
+    return;
+  }
+  Op *op = &(i->second);
+  if (r < 0) {
+    // objects_read_async already tried every other shard; the stripes
+    // cannot be reconstructed from this acting set
+    get_parent()->clog_error() << __func__ << ": " << op->hoid
+			       << " failed to read the stripes to overwrite: "
+			       << cpp_strerror(r)
+			       << ", write blocked until the next map\n";
+    op->rmw_read_error = r;
+  }
+  assert(op->rmw_reads_pending > 0);
+  if (--op->rmw_reads_pending)
+    return;
+  if (op->rmw_read_error) {
+    // anything read successfully in this round is read again on retry
+    op->rmw_reads.clear();
+    return;
+  }
+
+  const uint64_t sw = sinfo.get_stripe_width();
+  for (ECTransaction::object_stripes_t::iterator j = op->rmw_reads.begin();
+       j != op->rmw_reads.end();
+       ++j) {
+    ECTransaction::stripe_map_t &have = op->rmw_stripes[j->first];
+    for (ECTransaction::stripe_map_t::iterator k = j->second.begin();
+	 k != j->second.end();
+	 ++k) {
+      assert(k->second.length() % sw == 0);
+      for (uint64_t off = 0; off < k->second.length(); off += sw)
+	have[k->first + off].substr_of(k->second, off, sw);
+    }
+  }
+  op->rmw_reads.clear();
+  try_start_writes();
+}
+
+void ECBackend::try_start_writes()
+{
+  for (list<Op*>::iterator i = writing.begin(); i != writing.end(); ++i) {
+    Op *op = *i;
+    if (op->started)
+      continue;
+    if (op->rmw_reads_pending || op->rmw_read_error ||
+	!prepare_overwrites(op))
+      break;
+    start_write(op);
+  }
+}
+
+void ECBackend::extent_cache_update(
+  const ECTransaction::object_stripes_t &written,
+  const set<hobject_t, hobject_t::BitwiseComparator> &invalidated)
+{
+  for (set<hobject_t, hobject_t::BitwiseComparator>::const_iterator i =
+	 invalidated.begin();
+       i != invalidated.end();
+       ++i)
+    extent_cache_remove(*i);
+
+  for (ECTransaction::object_stripes_t::const_iterator i = written.begin();
+       i != written.end();
+       ++i) {
+    if (i->second.empty())
+      continue;
+    map<hobject_t, CachedObject, hobject_t::BitwiseComparator>::iterator c =
+      extent_cache.find(i->first);
+    if (c == extent_cache.end()) {
+      c = extent_cache.insert(make_pair(i->first, CachedObject())).first;
+      extent_cache_lru.push_front(i->first);
+    } else {
+      extent_cache_lru.erase(c->second.lru_pos);
+      extent_cache_lru.push_front(i->first);
+    }
+    c->second.lru_pos = extent_cache_lru.begin();
+    for (ECTransaction::stripe_map_t::const_iterator j = i->second.begin();
+	 j != i->second.end();
+	 ++j) {
+      // copy: the stripe may point into a much larger client message
+      bufferptr bp(j->second.length());
+      j->second.copy(0, j->second.length(), bp.c_str());
+      bufferlist &bl = c->second.stripes[j->first];
+      extent_cache_bytes -= bl.length();
+      bl.clear();
+      bl.append(bp);
+      extent_cache_bytes += bl.length();
+    }
+  }
+  extent_cache_trim();
+}
+
+void ECBackend::extent_cache_remove(const hobject_t &hoid)
+{
+  map<hobject_t, CachedObject, hobject_t::BitwiseComparator>::iterator c =
+    extent_cache.find(hoid);
+  if (c == extent_cache.end())
+    return;
+  for (ECTransaction::stripe_map_t::iterator j = c->second.stripes.begin();
+       j != c->second.stripes.end();
+       ++j)
+    extent_cache_bytes -= j->second.length();
+  extent_cache_lru.erase(c->second.lru_pos);
+  extent_cache.erase(c);
+}
+
+void ECBackend::extent_cache_trim()
+{
+  // stripes of objects still being written are what lets the next
+  // overwrite go ahead without waiting for them; keep those
+  list<hobject_t>::iterator p = extent_cache_lru.end();
+  while (extent_cache_bytes > cct->_conf->osd_ec_extent_cache_bytes &&
+	 p != extent_cache_lru.begin()) {
+    --p;
+    if (objects_in_flight.count(*p))
+      continue;
+    hobject_t hoid = *p++;
+    extent_cache_remove(hoid);
+  }
+}
+
+void ECBackend::extent_cache_clear()
+{
+  extent_cache.clear();
+  extent_cache_lru.clear();
+  extent_cache_bytes = 0;
+}
+
+int ECBackend::get_read_cost(int osd)
+{
+  OSDMapRef osdmap = get_osdmap();
+  int whoami = get_parent()->whoami_shard().osd;
+  if (read_cost_epoch != osdmap->get_epoch()) {
+    read_cost_epoch = osdmap->get_epoch();
+    read_cost.clear();
+    map<string, string> loc = osdmap->crush->get_full_location(whoami);
+    read_cost_loc = multimap<string, string>(loc.begin(), loc.end());
+  }
+  map<int, int>::iterator p = read_cost.find(osd);
+  if (p != read_cost.end())
+    return p->second;
+
+  // the type id of the closest bucket we share: 0 for ourself, then
+  // host, rack, ... in the order of the crush types
+  int cost = 0;
+  if (osd != whoami) {
+    cost = osdmap->crush->get_common_ancestor_distance(cct, osd,
+						       read_cost_loc);
+    if (cost < 0)
+      cost = osdmap->crush->get_num_type_names();
+  }
+  read_cost[osd] = cost;
+  return cost;
 }
 
 int ECBackend::get_min_avail_to_read_shards(
@@ -1495,13 +1762,36 @@ int ECBackend::get_min_avail_to_read_shards(
   }
 
   set<int> need;
-  int r = ec_impl->minimum_to_decode(want, have, &need);
+  int r;
+  if (cct->_conf->osd_ec_read_locality &&
+      !includes(have.begin(), have.end(), want.begin(), want.end())) {
+    // something has to be rebuilt: let the plugin prefer nearby shards
+    map<int, int> costs;
+    for (set<int>::iterator i = have.begin(); i != have.end(); ++i)
+      costs[*i] = get_read_cost(shards[shard_id_t(*i)].osd);
+    dout(20) << __func__ << ": read costs " << costs << dendl;
+    r = ec_impl->minimum_to_decode_with_cost(want, costs, &need);
+  } else {
+    r = ec_impl->minimum_to_decode(want, have, &need);
+  }
   if (r < 0)
     return r;
 
   if (do_redundant_reads) {
+    unsigned extra = cct->_conf->osd_ec_fast_read_extra_shards;
+    if (extra == 0) {
       need.swap(have);
-  } 
+    } else {
+      // whichever answer first decode; the extra reads only need to
+      // cover a slow shard or two
+      for (set<int>::iterator i = have.begin();
+	   i != have.end() && extra > 0;
+	   ++i) {
+	if (need.insert(*i).second)
+	  --extra;
+      }
+    }
+  }
 
   if (!to_read)
     return 0;
@@ -1756,8 +2046,20 @@ void ECBackend::check_op(Op *op)
     // done!
     assert(writing.front() == op);
     dout(10) << __func__ << " Completing " << *op << dendl;
+    for (map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator>::iterator i =
+	   op->unstable_hash_infos.begin();
+	 i != op->unstable_hash_infos.end();
+	 ++i) {
+      map<hobject_t, unsigned, hobject_t::BitwiseComparator>::iterator j =
+	objects_in_flight.find(i->first);
+      assert(j != objects_in_flight.end());
+      if (--j->second == 0)
+	objects_in_flight.erase(j);
+    }
     writing.pop_front();
     tid_to_op_map.erase(op->tid);
+    // overwrites may have been waiting for this one to land
+    try_start_writes();
   }
   for (map<ceph_tid_t, Op>::iterator i = tid_to_op_map.begin();
        i != tid_to_op_map.end();
@@ -1767,6 +2069,35 @@ void ECBackend::check_op(Op *op)
 }
 
 void ECBackend::start_write(Op *op) {
+  dout(10) << __func__ << ": " << *op << dendl;
+  op->started = true;
+  for (map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator>::iterator i =
+	 op->unstable_hash_infos.begin();
+       i != op->unstable_hash_infos.end();
+       ++i)
+    ++objects_in_flight[i->first];
+
+  // only now are the hash infos up to date with the ops before this one
+  for (vector<pg_log_entry_t>::iterator i = op->log_entries.begin();
+       i != op->log_entries.end();
+       ++i) {
+    MustPrependHashInfo vis;
+    i->mod_desc.visit(&vis);
+    if (vis.must_prepend_hash_info()) {
+      dout(10) << __func__ << ": stashing HashInfo for "
+	       << i->soid << " for entry " << *i << dendl;
+      assert(op->unstable_hash_infos.count(i->soid));
+      ObjectModDesc desc;
+      map<string, boost::optional<bufferlist> > old_attrs;
+      bufferlist old_hinfo;
+      ::encode(*(op->unstable_hash_infos[i->soid]), old_hinfo);
+      old_attrs[ECUtil::get_hinfo_key()] = old_hinfo;
+      desc.setattrs(old_attrs);
+      i->mod_desc.swap(desc);
+      i->mod_desc.claim_append(desc);
+      assert(i->mod_desc.can_rollback());
+    }
+  }
   map<shard_id_t, ObjectStore::Transaction> trans;
   for (set<pg_shard_t>::const_iterator i =
 	 get_parent()->get_actingbackfill_shards().begin();
@@ -1778,14 +2109,21 @@ void ECBackend::start_write(Op *op) {
   ObjectStore::Transaction empty;
   empty.set_use_tbl(parent->transaction_use_tbl());
 
+  ECTransaction::object_stripes_t written;
+  set<hobject_t, hobject_t::BitwiseComparator> invalidated;
   op->t->generate_transactions(
     op->unstable_hash_infos,
     ec_impl,
     get_parent()->get_info().pgid.pgid,
     sinfo,
+    op->rmw_stripes,
     &trans,
     &(op->temp_added),
-    &(op->temp_cleared));
+    &(op->temp_cleared),
+    &written,
+    &invalidated);
+  op->rmw_stripes.clear();
+  extent_cache_update(written, invalidated);
 
   dout(10) << "onreadable_sync: " << op->on_local_applied_sync << dendl;
 
@@ -368,6 +368,17 @@ public:
     set<pg_shard_t> pending_apply;
 
     map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> unstable_hash_infos;
+
+    /// overwrites: the stripes they touch, as they were before this op
+    ECTransaction::object_stripes_t rmw_stripes;
+    /// stripes being read into rmw_stripes, by object and extent offset
+    ECTransaction::object_stripes_t rmw_reads;
+    unsigned rmw_reads_pending;
+    /// error from the last round of rmw_reads, retried on the next map
+    int rmw_read_error;
+    bool started;
+
+    Op() : rmw_reads_pending(0), rmw_read_error(0), started(false) {}
     ~Op() {
       delete t;
       delete on_local_applied_sync;
@@ -399,6 +410,42 @@ public:
   map<ceph_tid_t, Op> tid_to_op_map; /// lists below point into here
   list<Op*> writing;
 
+  /**
+   * Overwrites
+   *
+   * An overwrite must see the stripes it touches as left by every op
+   * before it, which are not necessarily applied on the shards yet.  Ops
+   * therefore start in order, each once what it needs is available:
+   * the stripes come from the extent cache if an earlier op wrote them,
+   * and are otherwise read, but only once no write to the object is in
+   * flight.  The reads for one op overlap the writes of those before it.
+   *
+   * The extent cache keeps the logical contents of recently written
+   * stripes, so that small sequential writes don't keep reading back
+   * the stripe (and parity) they just wrote.
+   */
+  struct CachedObject {
+    ECTransaction::stripe_map_t stripes;
+    list<hobject_t>::iterator lru_pos;
+  };
+  map<hobject_t, CachedObject, hobject_t::BitwiseComparator> extent_cache;
+  list<hobject_t> extent_cache_lru;  ///< most recently written first
+  uint64_t extent_cache_bytes;
+  /// started writes not yet complete on all shards, by object
+  map<hobject_t, unsigned, hobject_t::BitwiseComparator> objects_in_flight;
+
+  void extent_cache_update(
+    const ECTransaction::object_stripes_t &written,
+    const set<hobject_t, hobject_t::BitwiseComparator> &invalidated);
+  void extent_cache_remove(const hobject_t &hoid);
+  void extent_cache_trim();
+  void extent_cache_clear();
+
+  friend struct C_OverwriteReadComplete;
+  bool prepare_overwrites(Op *op);
+  void overwrite_read_complete(ceph_tid_t tid, int r);
+  void try_start_writes();
+
   CephContext *cct;
   ErasureCodeInterfaceRef ec_impl;
 
@@ -470,6 +517,12 @@ public:
     ErasureCodeInterfaceRef ec_impl,
     uint64_t stripe_width);
 
+  /// crush distance from us to each osd, valid for read_cost_epoch
+  epoch_t read_cost_epoch;
+  map<int, int> read_cost;
+  multimap<string, string> read_cost_loc;
+  int get_read_cost(int osd);
+
   /// Returns to_read replicas sufficient to reconstruct want
   int get_min_avail_to_read_shards(
     const hobject_t &hoid,     ///< [in] object
@@ -28,6 +28,9 @@ struct AppendObjectsGenerator: public boost::static_visitor<void> {
   void operator()(const ECTransaction::AppendOp &op) {
     out->insert(op.oid);
   }
+  void operator()(const ECTransaction::OverwriteOp &op) {
+    out->insert(op.oid);
+  }
   void operator()(const ECTransaction::TouchOp &op) {
     out->insert(op.oid);
   }
@@ -42,6 +45,9 @@ struct AppendObjectsGenerator: public boost::static_visitor<void> {
   void operator()(const ECTransaction::StashOp &op) {
     out->insert(op.oid);
   }
+  void operator()(const ECTransaction::CopyStashOp &op) {
+    out->insert(op.oid);
+  }
   void operator()(const ECTransaction::RemoveOp &op) {
     out->insert(op.oid);
   }
@@ -57,37 +63,129 @@ void ECTransaction::get_append_objects(
   reverse_visit(gen);
 }
 
+/*
+ * An overwrite needs the stripes it touches as they are on disk, up to
+ * the current end of the object.  Stripes past the end are zeros, and
+ * once an op in the transaction has replaced the object's contents
+ * (remove, stash, rename or clone onto it) the disk no longer matters.
+ */
+struct OverwriteReadsGenerator: public boost::static_visitor<void> {
+  map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos;
+  const ECUtil::stripe_info_t &sinfo;
+  map<hobject_t, set<uint64_t>, hobject_t::BitwiseComparator> *out;
+  set<hobject_t, hobject_t::BitwiseComparator> replaced;
+  OverwriteReadsGenerator(
+    map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos,
+    const ECUtil::stripe_info_t &sinfo,
+    map<hobject_t, set<uint64_t>, hobject_t::BitwiseComparator> *out)
+    : hash_infos(hash_infos), sinfo(sinfo), out(out) {}
+  void operator()(const ECTransaction::OverwriteOp &op) {
+    if (replaced.count(op.oid))
+      return;
+    assert(hash_infos.count(op.oid));
+    uint64_t size = sinfo.aligned_chunk_offset_to_logical_offset(
+      hash_infos[op.oid]->get_total_chunk_size());
+    uint64_t end = MIN(
+      size,
+      sinfo.logical_to_next_stripe_offset(op.off + op.bl.length()));
+    for (uint64_t off = sinfo.logical_to_prev_stripe_offset(op.off);
+	 off < end;
+	 off += sinfo.get_stripe_width())
+      (*out)[op.oid].insert(off);
+  }
+  void operator()(const ECTransaction::CloneOp &op) {
+    replaced.insert(op.target);
+  }
+  void operator()(const ECTransaction::RenameOp &op) {
+    replaced.insert(op.source);
+    replaced.insert(op.destination);
+  }
+  void operator()(const ECTransaction::StashOp &op) {
+    replaced.insert(op.oid);
+  }
+  void operator()(const ECTransaction::RemoveOp &op) {
+    replaced.insert(op.oid);
+  }
+  template <typename T>
+  void operator()(const T &op) {}
+};
+void ECTransaction::get_overwrite_reads(
+  map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos,
+  const ECUtil::stripe_info_t &sinfo,
+  map<hobject_t, set<uint64_t>, hobject_t::BitwiseComparator> *out) const
+{
+  OverwriteReadsGenerator gen(hash_infos, sinfo, out);
+  visit(gen);
+}
+
 struct TransGenerator : public boost::static_visitor<void> {
   map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos;
 
   ErasureCodeInterfaceRef &ecimpl;
   const pg_t pgid;
   const ECUtil::stripe_info_t sinfo;
+  const ECTransaction::object_stripes_t &old_stripes;
   map<shard_id_t, ObjectStore::Transaction> *trans;
   set<int> want;
   set<hobject_t, hobject_t::BitwiseComparator> *temp_added;
   set<hobject_t, hobject_t::BitwiseComparator> *temp_removed;
+  ECTransaction::object_stripes_t *written;
+  set<hobject_t, hobject_t::BitwiseComparator> *invalidated;
+  set<hobject_t, hobject_t::BitwiseComparator> replaced;
   stringstream *out;
   TransGenerator(
     map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos,
     ErasureCodeInterfaceRef &ecimpl,
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
+    const ECTransaction::object_stripes_t &old_stripes,
     map<shard_id_t, ObjectStore::Transaction> *trans,
     set<hobject_t, hobject_t::BitwiseComparator> *temp_added,
     set<hobject_t, hobject_t::BitwiseComparator> *temp_removed,
+    ECTransaction::object_stripes_t *written,
+    set<hobject_t, hobject_t::BitwiseComparator> *invalidated,
     stringstream *out)
     : hash_infos(hash_infos),
       ecimpl(ecimpl), pgid(pgid),
       sinfo(sinfo),
+      old_stripes(old_stripes),
       trans(trans),
       temp_added(temp_added), temp_removed(temp_removed),
+      written(written), invalidated(invalidated),
       out(out) {
     for (unsigned i = 0; i < ecimpl->get_chunk_count(); ++i) {
       want.insert(i);
     }
   }
 
+  /// the object's contents no longer match what is on disk
+  void replace(const hobject_t &hoid) {
+    written->erase(hoid);
+    invalidated->insert(hoid);
+    replaced.insert(hoid);
+  }
+  void record_written(const hobject_t &hoid, uint64_t off, bufferlist &bl) {
+    ECTransaction::stripe_map_t &stripes = (*written)[hoid];
+    for (uint64_t pos = 0; pos < bl.length(); pos += sinfo.get_stripe_width())
+      stripes[off + pos].substr_of(bl, pos, sinfo.get_stripe_width());
+  }
+  /// the stripe at off as it is before the op being generated
+  bufferlist get_stripe(const hobject_t &hoid, uint64_t off) {
+    ECTransaction::object_stripes_t::iterator i = written->find(hoid);
+    if (i != written->end()) {
+      ECTransaction::stripe_map_t::iterator j = i->second.find(off);
+      if (j != i->second.end())
+	return j->second;
+    }
+    assert(!replaced.count(hoid));
+    ECTransaction::object_stripes_t::const_iterator k = old_stripes.find(hoid);
+    assert(k != old_stripes.end());
+    ECTransaction::stripe_map_t::const_iterator l = k->second.find(off);
+    assert(l != k->second.end());
+    assert(l->second.length() == sinfo.get_stripe_width());
+    return l->second;
+  }
+
   coll_t get_coll_ct(shard_id_t shard, const hobject_t &hoid) {
     if (hoid.is_temp()) {
       temp_removed->erase(hoid);
@@ -145,12 +243,16 @@ struct TransGenerator : public boost::static_visitor<void> {
 	sinfo.get_stripe_width() -
 	((offset + bl.length()) % sinfo.get_stripe_width()));
     assert(bl.length() - op.bl.length() < sinfo.get_stripe_width());
+    map<int, uint32_t> crcs;
+    hinfo->get_chunk_hashes(&crcs);
     int r = ECUtil::encode(
-      sinfo, ecimpl, bl, want, &buffers);
+      sinfo, ecimpl, bl, want, &buffers, &crcs);
+    record_written(op.oid, offset, bl);
 
     hinfo->append(
       sinfo.aligned_logical_offset_to_chunk_offset(op.off),
-      buffers);
+      buffers.begin()->second.length(),
+      crcs);
     bufferlist hbuf;
     ::encode(
       *hinfo,
@@ -177,10 +279,113 @@ struct TransGenerator : public boost::static_visitor<void> {
 	hbuf);
     }
   }
+  void operator()(const ECTransaction::OverwriteOp &op) {
+    const uint64_t sw = sinfo.get_stripe_width();
+    assert(op.bl.length());
+    assert(hash_infos.count(op.oid));
+    ECUtil::HashInfoRef hinfo = hash_infos[op.oid];
+    uint64_t size = sinfo.aligned_chunk_offset_to_logical_offset(
+      hinfo->get_total_chunk_size());
+
+    // [start, end) covers the write, and the gap to it if it starts
+    // past the end of the object
+    uint64_t start = MIN(sinfo.logical_to_prev_stripe_offset(op.off), size);
+    uint64_t end = sinfo.logical_to_next_stripe_offset(
+      op.off + op.bl.length());
+
+    bufferlist old_bl;
+    for (uint64_t off = start; off < MIN(end, size); off += sw)
+      old_bl.append(get_stripe(op.oid, off));
+
+    bufferlist bl;
+    uint64_t head = op.off - start;
+    if (head <= old_bl.length()) {
+      bl.substr_of(old_bl, 0, head);
+    } else {
+      bl = old_bl;
+      bl.append_zero(head - old_bl.length());
+    }
+    bl.append(op.bl);
+    if (bl.length() < old_bl.length()) {
+      bufferlist tail;
+      tail.substr_of(old_bl, bl.length(), old_bl.length() - bl.length());
+      bl.append(tail);
+    }
+    if (bl.length() < end - start)
+      bl.append_zero(end - start - bl.length());
+    assert(bl.length() == end - start);
+
+    map<int, bufferlist> buffers;
+    int r = ECUtil::encode(sinfo, ecimpl, bl, want, &buffers);
+    assert(r == 0);
+
+    // stripes that existed change in place, the rest is appended
+    uint64_t overwrite_chunk_len =
+      sinfo.aligned_logical_offset_to_chunk_offset(old_bl.length());
+    if (old_bl.length()) {
+      map<int, bufferlist> old_buffers, new_buffers;
+      r = ECUtil::encode(sinfo, ecimpl, old_bl, want, &old_buffers);
+      assert(r == 0);
+      for (map<int, bufferlist>::iterator i = buffers.begin();
+	   i != buffers.end();
+	   ++i)
+	new_buffers[i->first].substr_of(i->second, 0, overwrite_chunk_len);
+      hinfo->overwrite(
+	sinfo.aligned_logical_offset_to_chunk_offset(start),
+	old_buffers,
+	new_buffers);
+    }
+    if (bl.length() > old_bl.length()) {
+      map<int, bufferlist> to_append;
+      for (map<int, bufferlist>::iterator i = buffers.begin();
+	   i != buffers.end();
+	   ++i)
+	to_append[i->first].substr_of(
+	  i->second,
+	  overwrite_chunk_len,
+	  i->second.length() - overwrite_chunk_len);
+      hinfo->append(
+	sinfo.aligned_logical_offset_to_chunk_offset(start + old_bl.length()),
+	to_append);
+    }
+    record_written(op.oid, start, bl);
+
+    bufferlist hbuf;
+    ::encode(*hinfo, hbuf);
+    for (map<shard_id_t, ObjectStore::Transaction>::iterator i = trans->begin();
+	 i != trans->end();
+	 ++i) {
+      assert(buffers.count(i->first));
+      bufferlist &enc_bl = buffers[i->first];
+      i->second.write(
+	get_coll_ct(i->first, op.oid),
+	ghobject_t(op.oid, ghobject_t::NO_GEN, i->first),
+	sinfo.aligned_logical_offset_to_chunk_offset(start),
+	enc_bl.length(),
+	enc_bl,
+	op.fadvise_flags);
+      i->second.setattr(
+	get_coll_ct(i->first, op.oid),
+	ghobject_t(op.oid, ghobject_t::NO_GEN, i->first),
+	ECUtil::get_hinfo_key(),
+	hbuf);
+    }
+  }
+  void operator()(const ECTransaction::CopyStashOp &op) {
+    for (map<shard_id_t, ObjectStore::Transaction>::iterator i = trans->begin();
+	 i != trans->end();
+	 ++i) {
+      i->second.clone(
+	get_coll(i->first),
+	ghobject_t(op.oid, ghobject_t::NO_GEN, i->first),
+	ghobject_t(op.oid, op.version, i->first));
+    }
+  }
   void operator()(const ECTransaction::CloneOp &op) {
     assert(hash_infos.count(op.source));
     assert(hash_infos.count(op.target));
     *(hash_infos[op.target]) = *(hash_infos[op.source]);
+    replace(op.target);
     for (map<shard_id_t, ObjectStore::Transaction>::iterator i = trans->begin();
 	 i != trans->end();
 	 ++i) {
@@ -195,6 +400,8 @@ struct TransGenerator : public boost::static_visitor<void> {
     assert(hash_infos.count(op.destination));
     *(hash_infos[op.destination]) = *(hash_infos[op.source]);
     hash_infos[op.source]->clear();
+    replace(op.source);
+    replace(op.destination);
     for (map<shard_id_t, ObjectStore::Transaction>::iterator i = trans->begin();
 	 i != trans->end();
 	 ++i) {
@@ -208,6 +415,7 @@ struct TransGenerator : public boost::static_visitor<void> {
   void operator()(const ECTransaction::StashOp &op) {
     assert(hash_infos.count(op.oid));
     hash_infos[op.oid]->clear();
+    replace(op.oid);
     for (map<shard_id_t, ObjectStore::Transaction>::iterator i = trans->begin();
 	 i != trans->end();
 	 ++i) {
@@ -222,6 +430,7 @@ struct TransGenerator : public boost::static_visitor<void> {
   void operator()(const ECTransaction::RemoveOp &op) {
     assert(hash_infos.count(op.oid));
     hash_infos[op.oid]->clear();
+    replace(op.oid);
     for (map<shard_id_t, ObjectStore::Transaction>::iterator i = trans->begin();
 	 i != trans->end();
 	 ++i) {
@@ -277,9 +486,12 @@ void ECTransaction::generate_transactions(
   ErasureCodeInterfaceRef &ecimpl,
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
+  const object_stripes_t &old_stripes,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
   set<hobject_t, hobject_t::BitwiseComparator> *temp_added,
   set<hobject_t, hobject_t::BitwiseComparator> *temp_removed,
+  object_stripes_t *written,
+  set<hobject_t, hobject_t::BitwiseComparator> *invalidated,
   stringstream *out) const
 {
   TransGenerator gen(
@@ -287,9 +499,12 @@ void ECTransaction::generate_transactions(
     ecimpl,
     pgid,
     sinfo,
+    old_stripes,
     transactions,
     temp_added,
     temp_removed,
+    written,
+    invalidated,
     out);
   visit(gen);
 }
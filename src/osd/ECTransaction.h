@@ -32,6 +32,16 @@ public:
     AppendOp(const hobject_t &oid, uint64_t off, bufferlist &bl, uint32_t flags)
       : oid(oid), off(off), bl(bl), fadvise_flags(flags) {}
   };
+  /// write over existing stripes (read-modify-write) and/or past the end
+  struct OverwriteOp {
+    hobject_t oid;
+    uint64_t off;
+    bufferlist bl;
+    uint32_t fadvise_flags;
+    OverwriteOp(const hobject_t &oid, uint64_t off, bufferlist &bl,
+		uint32_t flags)
+      : oid(oid), off(off), bl(bl), fadvise_flags(flags) {}
+  };
   struct CloneOp {
     hobject_t source;
     hobject_t target;
@@ -50,6 +60,12 @@ public:
     StashOp(const hobject_t &oid, version_t version)
       : oid(oid), version(version) {}
   };
+  struct CopyStashOp {
+    hobject_t oid;
+    version_t version;
+    CopyStashOp(const hobject_t &oid, version_t version)
+      : oid(oid), version(version) {}
+  };
   struct TouchOp {
     hobject_t oid;
     TouchOp(const hobject_t &oid) : oid(oid) {}
@@ -88,9 +104,11 @@ public:
   struct NoOp {};
   typedef boost::variant<
     AppendOp,
+    OverwriteOp,
     CloneOp,
     RenameOp,
     StashOp,
+    CopyStashOp,
     TouchOp,
     RemoveOp,
     SetAttrsOp,
@@ -121,11 +139,31 @@ public:
     assert(len == bl.length());
     ops.push_back(AppendOp(hoid, off, bl, fadvise_flags));
   }
+  /// any offset; the backend reads whatever stripes it needs first
+  void write(
+    const hobject_t &hoid,
+    uint64_t off,
+    uint64_t len,
+    bufferlist &bl,
+    uint32_t fadvise_flags) {
+    if (len == 0) {
+      touch(hoid);
+      return;
+    }
+    written += len;
+    assert(len == bl.length());
+    ops.push_back(OverwriteOp(hoid, off, bl, fadvise_flags));
+  }
   void stash(
     const hobject_t &hoid,
     version_t former_version) {
     ops.push_back(StashOp(hoid, former_version));
   }
+  void stash_copy(
+    const hobject_t &hoid,
+    version_t former_version) {
+    ops.push_back(CopyStashOp(hoid, former_version));
+  }
   void remove(
     const hobject_t &hoid) {
     ops.push_back(RemoveOp(hoid));
@@ -195,14 +233,39 @@ public:
   }
   void get_append_objects(
      set<hobject_t, hobject_t::BitwiseComparator> *out) const;
+
+  /// logical, stripe aligned data of an object, by offset
+  typedef map<uint64_t, bufferlist> stripe_map_t;
+  typedef map<hobject_t, stripe_map_t, hobject_t::BitwiseComparator>
+    object_stripes_t;
+
+  /**
+   * Stripes that must be read before the overwrites can be generated
+   *
+   * @param hash_infos current hash infos, for the object sizes
+   * @param out stripe offsets to read, by object
+   */
+  void get_overwrite_reads(
+    map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos,
+    const ECUtil::stripe_info_t &sinfo,
+    map<hobject_t, set<uint64_t>, hobject_t::BitwiseComparator> *out) const;
+
+  /**
+   * @param old_stripes stripes named by get_overwrite_reads, as they are
+   * @param written stripes this transaction wrote, as they will be
+   * @param invalidated objects whose other stripes it may have changed
+   */
   void generate_transactions(
     map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> &hash_infos,
     ErasureCodeInterfaceRef &ecimpl,
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
+    const object_stripes_t &old_stripes,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
     set<hobject_t, hobject_t::BitwiseComparator> *temp_added,
     set<hobject_t, hobject_t::BitwiseComparator> *temp_removed,
+    object_stripes_t *written,
+    set<hobject_t, hobject_t::BitwiseComparator> *invalidated,
     stringstream *out = 0) const;
 };
 
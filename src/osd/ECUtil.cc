@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include "include/encoding.h"
+#include "include/crc32c.h"
 #include "ECUtil.h"
 
 int ECUtil::decode(
@@ -26,19 +27,27 @@ int ECUtil::decode(
   if (total_data_size == 0)
     return 0;
 
+  // the data chunks, in the order decode_concat() would give them
+  const vector<int> &mapping = ec_impl->get_chunk_mapping();
+  vector<int> order;
+  set<int> want;
+  for (unsigned i = 0; i < ec_impl->get_data_chunk_count(); ++i) {
+    order.push_back(mapping.size() > i ? mapping[i] : i);
+    want.insert(order.back());
+  }
+  map<int, bufferlist> decoded;
+  int r = ec_impl->decode_stripes(want, to_decode, sinfo.get_chunk_size(),
+				  &decoded);
+  assert(r == 0);
   for (uint64_t i = 0; i < total_data_size; i += sinfo.get_chunk_size()) {
-    map<int, bufferlist> chunks;
-    for (map<int, bufferlist>::iterator j = to_decode.begin();
-	 j != to_decode.end();
-	 ++j) {
-      chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
+    for (unsigned j = 0; j < order.size(); ++j) {
+      bufferlist bl;
+      bl.substr_of(decoded[order[j]], i, sinfo.get_chunk_size());
+      out->claim_append(bl);
     }
-    bufferlist bl;
-    int r = ec_impl->decode_concat(chunks, &bl);
-    assert(bl.length() == sinfo.get_stripe_width());
-    assert(r == 0);
-    out->claim_append(bl);
   }
+  assert(out->length() ==
+	 total_data_size / sinfo.get_chunk_size() * sinfo.get_stripe_width());
   return 0;
 }
 
@@ -70,23 +79,15 @@ int ECUtil::decode(
     need.insert(i->first);
   }
 
-  for (uint64_t i = 0; i < total_data_size; i += sinfo.get_chunk_size()) {
-    map<int, bufferlist> chunks;
-    for (map<int, bufferlist>::iterator j = to_decode.begin();
-	 j != to_decode.end();
-	 ++j) {
-      chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
-    }
-    map<int, bufferlist> out_bls;
-    int r = ec_impl->decode(need, chunks, &out_bls);
-    assert(r == 0);
-    for (map<int, bufferlist*>::iterator j = out.begin();
-	 j != out.end();
-	 ++j) {
-      assert(out_bls.count(j->first));
-      assert(out_bls[j->first].length() == sinfo.get_chunk_size());
-      j->second->claim_append(out_bls[j->first]);
-    }
+  map<int, bufferlist> out_bls;
+  int r = ec_impl->decode_stripes(need, to_decode, sinfo.get_chunk_size(),
+				  &out_bls);
+  assert(r == 0);
+  for (map<int, bufferlist*>::iterator j = out.begin();
+       j != out.end();
+       ++j) {
+    assert(out_bls.count(j->first));
+    j->second->claim_append(out_bls[j->first]);
   }
   for (map<int, bufferlist*>::iterator i = out.begin();
        i != out.end();
@@ -101,7 +102,8 @@ int ECUtil::encode(
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const set<int> &want,
-  map<int, bufferlist> *out) {
+  map<int, bufferlist> *out,
+  map<int, uint32_t> *crcs) {
 
   uint64_t logical_size = in.length();
 
@@ -112,19 +114,9 @@ int ECUtil::encode(
   if (logical_size == 0)
     return 0;
 
-  for (uint64_t i = 0; i < logical_size; i += sinfo.get_stripe_width()) {
-    map<int, bufferlist> encoded;
-    bufferlist buf;
-    buf.substr_of(in, i, sinfo.get_stripe_width());
-    int r = ec_impl->encode(want, buf, &encoded);
-    assert(r == 0);
-    for (map<int, bufferlist>::iterator i = encoded.begin();
-	 i != encoded.end();
-	 ++i) {
-      assert(i->second.length() == sinfo.get_chunk_size());
-      (*out)[i->first].claim_append(i->second);
-    }
-  }
+  int r = ec_impl->encode_stripes(
+    want, in, sinfo.get_stripe_width(), out, crcs);
+  assert(r == 0);
 
   for (map<int, bufferlist>::iterator i = out->begin();
        i != out->end();
@@ -153,6 +145,36 @@ void ECUtil::HashInfo::decode(bufferlist::iterator &bl)
   DECODE_FINISH(bl);
 }
 
+void ECUtil::HashInfo::overwrite(
+  uint64_t off,
+  map<int, bufferlist> &old_chunks,
+  map<int, bufferlist> &new_chunks)
+{
+  assert(old_chunks.size() == cumulative_shard_hashes.size());
+  assert(new_chunks.size() == cumulative_shard_hashes.size());
+  uint64_t len = old_chunks.begin()->second.length();
+  assert(off + len <= total_chunk_size);
+  // crc32c is linear: the hash of the new shard is the old one xor the
+  // crc (from 0) of old^new, zero-extended to the end of the shard
+  bufferptr delta(len);
+  for (map<int, bufferlist>::iterator i = old_chunks.begin();
+       i != old_chunks.end();
+       ++i) {
+    assert((unsigned)i->first < cumulative_shard_hashes.size());
+    bufferlist &n = new_chunks[i->first];
+    assert(i->second.length() == len);
+    assert(n.length() == len);
+    const char *o = i->second.c_str();
+    const char *p = n.c_str();
+    char *d = delta.c_str();
+    for (uint64_t j = 0; j < len; ++j)
+      d[j] = o[j] ^ p[j];
+    uint32_t crc = ceph_crc32c(0, (unsigned char*)d, len);
+    crc = ceph_crc32c(crc, NULL, total_chunk_size - off - len);
+    cumulative_shard_hashes[i->first] ^= crc;
+  }
+}
+
 void ECUtil::HashInfo::dump(Formatter *f) const
 {
   f->dump_unsigned("total_chunk_size", total_chunk_size);
@@ -97,12 +97,14 @@ int decode(
   map<int, bufferlist> &to_decode,
   map<int, bufferlist*> &out);
 
+/// if crcs is set, the crc32c of each output chunk is folded into it
 int encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const set<int> &want,
-  map<int, bufferlist> *out);
+  map<int, bufferlist> *out,
+  map<int, uint32_t> *crcs = 0);
 
 class HashInfo {
   uint64_t total_chunk_size;
@@ -126,6 +128,28 @@ public:
     }
     total_chunk_size += size_to_append;
   }
+  /// append size_to_append per shard, already hashed into new_hashes
+  void append(uint64_t old_size, uint64_t size_to_append,
+	      const map<int, uint32_t> &new_hashes) {
+    assert(new_hashes.size() == cumulative_shard_hashes.size());
+    assert(old_size == total_chunk_size);
+    for (map<int, uint32_t>::const_iterator i = new_hashes.begin();
+	 i != new_hashes.end();
+	 ++i) {
+      assert((unsigned)i->first < cumulative_shard_hashes.size());
+      cumulative_shard_hashes[i->first] = i->second;
+    }
+    total_chunk_size += size_to_append;
+  }
+  /// seed for encode() to continue the shard hashes from
+  void get_chunk_hashes(map<int, uint32_t> *out) const {
+    for (unsigned i = 0; i < cumulative_shard_hashes.size(); ++i)
+      (*out)[i] = cumulative_shard_hashes[i];
+  }
+  /// replace old_chunks at chunk offset off with new_chunks
+  void overwrite(uint64_t off,
+		 map<int, bufferlist> &old_chunks,
+		 map<int, bufferlist> &new_chunks);
   void clear() {
     total_chunk_size = 0;
     cumulative_shard_hashes = vector<uint32_t>(
@@ -28,6 +28,10 @@ HitSet::HitSet(const HitSet::Params& params)
     }
     break;
 
+  case TYPE_CUCKOO:
+    impl.reset(new CuckooHitSet(static_cast<CuckooHitSet::Params*>(params.impl.get())));
+    break;
+
   case TYPE_EXPLICIT_HASH:
     impl.reset(new ExplicitHashHitSet(static_cast<ExplicitHashHitSet::Params*>(params.impl.get())));
     break;
@@ -70,6 +74,9 @@ void HitSet::decode(bufferlist::iterator &bl)
   case TYPE_BLOOM:
     impl.reset(new BloomHitSet);
     break;
+  case TYPE_CUCKOO:
+    impl.reset(new CuckooHitSet);
+    break;
   case TYPE_NONE:
     impl.reset(NULL);
     break;
@@ -104,6 +111,10 @@ void HitSet::generate_test_instances(list<HitSet*>& o)
   o.back()->insert(hobject_t());
   o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
   o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  o.push_back(new HitSet(new CuckooHitSet(10, .01, 1)));
+  o.back()->insert(hobject_t());
+  o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+  o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
 }
 
 HitSet::Params::Params(const Params& o)
@@ -157,6 +168,9 @@ bool HitSet::Params::create_impl(impl_type_t type)
   case TYPE_BLOOM:
     impl.reset(new BloomHitSet::Params);
     break;
+  case TYPE_CUCKOO:
+    impl.reset(new CuckooHitSet::Params);
+    break;
   case TYPE_NONE:
     impl.reset(NULL);
     break;
@@ -202,6 +216,8 @@ void HitSet::Params::generate_test_instances(list<HitSet::Params*>& o)
   loop_hitset_params(ExplicitHashHitSet);
   o.push_back(new Params(new ExplicitObjectHitSet::Params));
   loop_hitset_params(ExplicitObjectHitSet);
+  o.push_back(new Params(new CuckooHitSet::Params));
+  loop_hitset_params(CuckooHitSet);
 }
 
 ostream& operator<<(ostream& out, const HitSet::Params& p) {
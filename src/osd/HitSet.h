@@ -37,7 +37,8 @@ public:
     TYPE_NONE = 0,
     TYPE_EXPLICIT_HASH = 1,
     TYPE_EXPLICIT_OBJECT = 2,
-    TYPE_BLOOM = 3
+    TYPE_BLOOM = 3,
+    TYPE_CUCKOO = 4
   } impl_type_t;
 
   static const char *get_type_name(impl_type_t t) {
@@ -46,6 +47,7 @@ public:
     case TYPE_EXPLICIT_HASH: return "explicit_hash";
     case TYPE_EXPLICIT_OBJECT: return "explicit_object";
     case TYPE_BLOOM: return "bloom";
+    case TYPE_CUCKOO: return "cuckoo";
     default: return "???";
     }
   }
@@ -69,6 +71,14 @@ public:
     virtual void dump(Formatter *f) const = 0;
     virtual Impl* clone() const = 0;
     virtual void seal() {}
+    /// hits recorded for o; types that do not count say 0 or 1
+    virtual unsigned get_count(const hobject_t& o) const {
+      return contains(o) ? 1 : 0;
+    }
+    /// forget o; false if this type cannot
+    virtual bool remove(const hobject_t& o) {
+      return false;
+    }
     virtual ~Impl() {}
   };
 
@@ -147,6 +157,15 @@ public:
     return impl->contains(o);
   }
 
+  /// how many times o was inserted (approximately, and only if the type counts)
+  unsigned get_count(const hobject_t& o) const {
+    return impl->get_count(o);
+  }
+  /// remove o from the set, if the type supports it
+  bool remove(const hobject_t& o) {
+    return impl->remove(o);
+  }
+
   unsigned insert_count() const {
     return impl->insert_count();
   }
@@ -474,4 +493,278 @@ public:
 };
 WRITE_CLASS_ENCODER(BloomHitSet)
 
+/**
+ * use a cuckoo filter with hit counts to track hits to the set
+ *
+ * Each object hash maps to a fingerprint and two candidate buckets of
+ * four 16-bit slots.  A slot holds the fingerprint in its low fp_bits
+ * and a saturating hit count in the rest, so the set can tell how
+ * often an object was hit and can forget one, neither of which a bloom
+ * filter can do.  A bucket is one 64-bit word, and a lookup compares
+ * its four fingerprints at once (SWAR) before looking at any slot.
+ *
+ * fp_bits follows from the false positive rate (2 buckets * 4 slots
+ * / 2^fp_bits), and the table is sized for target_size objects at
+ * under 90% load.  Count bits make a slot bigger than what a bloom
+ * filter spends per object at high false positive rates; the filter
+ * comes out ahead below a rate of roughly 0.1%.
+ */
+class CuckooHitSet : public HitSet::Impl {
+  static const unsigned SLOTS = 4;
+  static const unsigned MAX_KICKS = 500;
+  static const uint64_t LANE_LOW = 0x0001000100010001ull;
+  static const uint64_t LANE_HIGH = 0x8000800080008000ull;
+
+  uint32_t fp_bits;     ///< fingerprint bits per slot; the rest count hits
+  uint64_t seed;
+  uint64_t target_size;
+  uint64_t count;       ///< inserts
+  uint64_t unique;      ///< fingerprints stored
+  uint16_t stash;       ///< a slot evicted from a full table, or 0
+  uint64_t stash_bucket;
+  bool overflowed;      ///< a slot was lost for lack of room
+  std::vector<uint64_t> buckets;
+
+  uint16_t fp_mask() const {
+    return (1u << fp_bits) - 1;
+  }
+  unsigned max_count() const {
+    return (1u << (16 - fp_bits)) - 1;
+  }
+  uint16_t get_slot(uint64_t b, unsigned s) const {
+    return buckets[b] >> (16 * s);
+  }
+  void set_slot(uint64_t b, unsigned s, uint16_t v) {
+    buckets[b] &= ~(0xffffull << (16 * s));
+    buckets[b] |= (uint64_t)v << (16 * s);
+  }
+
+  uint64_t alt_bucket(uint64_t b, uint16_t fp) const {
+    return (b ^ ((uint64_t)fp * 0x5bd1e995)) & (buckets.size() - 1);
+  }
+  void locate(const hobject_t& o, uint16_t *fp, uint64_t *b1,
+	      uint64_t *b2) const {
+    uint64_t h = (((uint64_t)o.get_hash() << 32) | o.get_hash()) ^ seed;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    *fp = (h >> 32) & fp_mask();
+    if (*fp == 0)
+      *fp = 1;  // 0 marks an empty slot
+    *b1 = h & (buckets.size() - 1);
+    *b2 = alt_bucket(*b1, *fp);
+  }
+
+  /// the slot of bucket b holding fingerprint fp (0: a free slot), or -1
+  int find_slot(uint64_t b, uint16_t fp) const {
+    uint64_t x = (buckets[b] & ((uint64_t)fp_mask() * LANE_LOW)) ^
+      ((uint64_t)fp * LANE_LOW);
+    // is any 16-bit lane of x zero?
+    if (!((x - LANE_LOW) & ~x & LANE_HIGH))
+      return -1;
+    for (unsigned s = 0; s < SLOTS; ++s)
+      if ((get_slot(b, s) & fp_mask()) == fp)
+	return s;
+    return -1;
+  }
+  bool place(uint64_t b, uint16_t v) {
+    int s = find_slot(b, 0);
+    if (s < 0)
+      return false;
+    set_slot(b, s, v);
+    return true;
+  }
+  bool bump(uint64_t b, uint16_t fp) {
+    int s = find_slot(b, fp);
+    if (s < 0)
+      return false;
+    uint16_t v = get_slot(b, s);
+    if ((unsigned)(v >> fp_bits) < max_count())
+      set_slot(b, s, v + (1 << fp_bits));
+    return true;
+  }
+  bool stash_matches(uint16_t fp, uint64_t b1, uint64_t b2) const {
+    return stash && (stash & fp_mask()) == fp &&
+      (stash_bucket == b1 || stash_bucket == b2);
+  }
+
+  void init(unsigned target, double fpp) {
+    fp_bits = 4;
+    while (fp_bits < 14 && (double)(2 * SLOTS) / (double)(1u << fp_bits) > fpp)
+      ++fp_bits;
+    uint64_t n = 1;
+    while ((double)n * SLOTS * .9 < (double)target)
+      n <<= 1;
+    buckets.assign(n, 0);
+  }
+
+public:
+  class Params : public BloomHitSet::Params {
+  public:
+    // sized, and adjusted per period, the same way as a bloom filter
+    virtual HitSet::impl_type_t get_type() const {
+      return HitSet::TYPE_CUCKOO;
+    }
+    virtual HitSet::Impl *get_new_impl() const {
+      return new CuckooHitSet;
+    }
+    Params() {}
+    Params(double fpp, uint64_t t, uint64_t s)
+      : BloomHitSet::Params(fpp, t, s) {}
+    static void generate_test_instances(list<Params*>& o) {
+      o.push_back(new Params);
+      o.push_back(new Params(.001, 300, 99));
+    }
+  };
+
+  CuckooHitSet()
+    : fp_bits(8), seed(0), target_size(0), count(0), unique(0),
+      stash(0), stash_bucket(0), overflowed(false), buckets(1, 0) {}
+  CuckooHitSet(unsigned inserts, double fpp, uint64_t s)
+    : seed(s), target_size(inserts), count(0), unique(0),
+      stash(0), stash_bucket(0), overflowed(false) {
+    init(inserts, fpp);
+  }
+  CuckooHitSet(const CuckooHitSet::Params *p)
+    : seed(p->seed), target_size(p->target_size), count(0), unique(0),
+      stash(0), stash_bucket(0), overflowed(false) {
+    init(p->target_size, p->get_fpp());
+  }
+
+  HitSet::Impl *clone() const {
+    return new CuckooHitSet(*this);
+  }
+
+  HitSet::impl_type_t get_type() const {
+    return HitSet::TYPE_CUCKOO;
+  }
+  bool is_full() const {
+    return overflowed || stash || (target_size && unique >= target_size);
+  }
+
+  void insert(const hobject_t& o) {
+    ++count;
+    uint16_t fp;
+    uint64_t b1, b2;
+    locate(o, &fp, &b1, &b2);
+    if (bump(b1, fp) || bump(b2, fp))
+      return;
+    if (stash_matches(fp, b1, b2)) {
+      if ((unsigned)(stash >> fp_bits) < max_count())
+	stash += 1 << fp_bits;
+      return;
+    }
+    ++unique;
+    uint16_t v = fp | (1 << fp_bits);
+    if (place(b1, v) || place(b2, v))
+      return;
+    // kick slots along their alternate buckets until one fits
+    uint64_t b = (count & 1) ? b1 : b2;
+    for (unsigned n = 0; n < MAX_KICKS; ++n) {
+      unsigned s = (count + n) % SLOTS;
+      uint16_t victim = get_slot(b, s);
+      set_slot(b, s, v);
+      v = victim;
+      b = alt_bucket(b, v & fp_mask());
+      if (place(b, v))
+	return;
+    }
+    if (stash) {
+      overflowed = true;  // forgets the old stash; a false negative
+      --unique;
+    }
+    stash = v;
+    stash_bucket = b;
+  }
+  bool contains(const hobject_t& o) const {
+    return get_count(o) > 0;
+  }
+  unsigned get_count(const hobject_t& o) const {
+    uint16_t fp;
+    uint64_t b1, b2;
+    locate(o, &fp, &b1, &b2);
+    int s = find_slot(b1, fp);
+    if (s >= 0)
+      return get_slot(b1, s) >> fp_bits;
+    s = find_slot(b2, fp);
+    if (s >= 0)
+      return get_slot(b2, s) >> fp_bits;
+    if (stash_matches(fp, b1, b2))
+      return stash >> fp_bits;
+    return 0;
+  }
+  bool remove(const hobject_t& o) {
+    uint16_t fp;
+    uint64_t b1, b2;
+    locate(o, &fp, &b1, &b2);
+    int s = find_slot(b1, fp);
+    if (s >= 0) {
+      set_slot(b1, s, 0);
+    } else if ((s = find_slot(b2, fp)) >= 0) {
+      set_slot(b2, s, 0);
+    } else if (stash_matches(fp, b1, b2)) {
+      stash = 0;
+    } else {
+      return false;
+    }
+    --unique;
+    return true;
+  }
+  unsigned insert_count() const {
+    return count;
+  }
+  unsigned approx_unique_insert_count() const {
+    return unique;
+  }
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(fp_bits, bl);
+    ::encode(seed, bl);
+    ::encode(target_size, bl);
+    ::encode(count, bl);
+    ::encode(unique, bl);
+    ::encode(stash, bl);
+    ::encode(stash_bucket, bl);
+    ::encode(overflowed, bl);
+    ::encode(buckets, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    ::decode(fp_bits, bl);
+    ::decode(seed, bl);
+    ::decode(target_size, bl);
+    ::decode(count, bl);
+    ::decode(unique, bl);
+    ::decode(stash, bl);
+    ::decode(stash_bucket, bl);
+    ::decode(overflowed, bl);
+    ::decode(buckets, bl);
+    DECODE_FINISH(bl);
+    if (buckets.empty())
+      buckets.resize(1, 0);
+  }
+  void dump(Formatter *f) const {
+    f->open_object_section("cuckoo_filter");
+    f->dump_unsigned("fingerprint_bits", fp_bits);
+    f->dump_unsigned("num_buckets", buckets.size());
+    f->dump_unsigned("target_size", target_size);
+    f->dump_unsigned("insert_count", count);
+    f->dump_unsigned("unique_count", unique);
+    f->dump_bool("overflowed", overflowed);
+    f->close_section();
+  }
+  static void generate_test_instances(list<CuckooHitSet*>& o) {
+    o.push_back(new CuckooHitSet);
+    o.push_back(new CuckooHitSet(10, .01, 1));
+    o.back()->insert(hobject_t());
+    o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+    o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  }
+};
+WRITE_CLASS_ENCODER(CuckooHitSet)
+
 #endif
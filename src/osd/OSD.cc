@@ -63,6 +63,8 @@
 #include "messages/MOSDOp.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDRepOp.h"
+#include "messages/MOSDRepOpBatch.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDRepOpReply.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDSubOpReply.h"
@@ -166,6 +168,33 @@ void PGQueueable::RunVis::operator()(PGScrub &op) {
   return pg->scrub(op.epoch_queued, handle);
 }
 
+PGQueueable::op_class_t PGQueueable::get_op_class() const
+{
+  if (boost::get<PGSnapTrim>(&qvariant))
+    return OP_CLASS_SNAPTRIM;
+  if (boost::get<PGScrub>(&qvariant))
+    return OP_CLASS_SCRUB;
+  const OpRequestRef *op = boost::get<OpRequestRef>(&qvariant);
+  assert(op);
+  switch ((*op)->get_req()->get_type()) {
+  case MSG_OSD_PG_PUSH:
+  case MSG_OSD_PG_PULL:
+  case MSG_OSD_PG_PUSH_REPLY:
+  case MSG_OSD_PG_SCAN:
+  case MSG_OSD_PG_BACKFILL:
+    return OP_CLASS_RECOVERY;
+  case MSG_OSD_REP_SCRUB:
+    return OP_CLASS_SCRUB;
+  default:
+    return OP_CLASS_CLIENT;
+  }
+}
+
+static unsigned classify_op(const pair<PGRef, PGQueueable> &item)
+{
+  return item.second.get_op_class();
+}
+
 //Initial features in new superblock.
 //Features here are also automatically upgraded
 CompatSet OSD::get_osd_initial_compat_set() {
@@ -221,6 +250,8 @@ OSDService::OSDService(OSD *osd) :
   peer_map_epoch_lock("OSDService::peer_map_epoch_lock"),
   sched_scrub_lock("OSDService::sched_scrub_lock"), scrubs_pending(0),
   scrubs_active(0),
+  scrub_io_lock("OSDService::scrub_io_lock"),
+  promote_lock("OSDService::promote_lock"),
   agent_lock("OSD::agent_lock"),
   agent_valid_iterator(false),
   agent_ops(0),
@@ -237,6 +268,13 @@ OSDService::OSDService(OSD *osd) :
   next_notif_id(0),
   backfill_request_lock("OSD::backfill_request_lock"),
   backfill_request_timer(cct, backfill_request_lock, false),
+  repop_batch_lock("OSD::repop_batch_lock"),
+  repop_batch_timer(cct, repop_batch_lock, false),
+  snap_sleep_lock("OSDService::snap_sleep_lock"),
+  snap_sleep_timer(cct, snap_sleep_lock, false),
+  obc_cache(cct->_conf->osd_object_context_cache_shards,
+	    cct->_conf->osd_object_context_cache_bytes),
+  recovery_throttle(cct->_conf->osd_recovery_max_active),
   last_tid(0),
   tid_lock("OSDService::tid_lock"),
   reserver_finisher(cct),
@@ -471,6 +509,14 @@ void OSDService::shutdown()
     Mutex::Locker l(backfill_request_lock);
     backfill_request_timer.shutdown();
   }
+  {
+    Mutex::Locker l(repop_batch_lock);
+    repop_batch_timer.shutdown();
+  }
+  {
+    Mutex::Locker l(snap_sleep_lock);
+    snap_sleep_timer.shutdown();
+  }
   osdmap = OSDMapRef();
   next_osdmap = OSDMapRef();
 }
@@ -482,6 +528,8 @@ void OSDService::init()
   objecter->set_client_incarnation(0);
   watch_timer.init();
   agent_timer.init();
+  repop_batch_timer.init();
+  snap_sleep_timer.init();
 
   agent_thread.create();
 }
@@ -988,6 +1036,91 @@ void OSDService::dec_scrubs_active()
   sched_scrub_lock.Unlock();
 }
 
+struct C_QueueSnapTrim : public Context {
+  OSDService *osd;
+  PGRef pg;
+  epoch_t epoch;
+  C_QueueSnapTrim(OSDService *osd, PG *pg, epoch_t e)
+    : osd(osd), pg(pg), epoch(e) {}
+  void finish(int r) {
+    if (!osd->is_stopping())
+      osd->_queue_for_snap_trim(pg.get(), epoch);
+  }
+};
+
+void OSDService::queue_for_snap_trim(PG *pg)
+{
+  epoch_t e = pg->get_osdmap()->get_epoch();
+  double sleep = cct->_conf->osd_snap_trim_sleep;
+  if (sleep > 0) {
+    // wait on the timer rather than in an op thread; the trimmer
+    // drops the event if the pg reset in the meantime
+    Mutex::Locker l(snap_sleep_lock);
+    snap_sleep_timer.add_event_after(sleep, new C_QueueSnapTrim(this, pg, e));
+  } else {
+    _queue_for_snap_trim(pg, e);
+  }
+}
+
+void OSDService::charge_scrub_io(uint64_t bytes)
+{
+  uint64_t rate = cct->_conf->osd_deep_scrub_max_bytes_per_sec;
+  if (!rate)
+    return;
+  utime_t now = ceph_clock_now(cct);
+  Mutex::Locker l(scrub_io_lock);
+  // an idle budget does not bank credit for a later burst
+  if (scrub_io_next < now)
+    scrub_io_next = now;
+  scrub_io_next += (double)bytes / (double)rate;
+}
+
+double OSDService::get_scrub_io_delay()
+{
+  if (!cct->_conf->osd_deep_scrub_max_bytes_per_sec)
+    return 0;
+  utime_t now = ceph_clock_now(cct);
+  Mutex::Locker l(scrub_io_lock);
+  if (scrub_io_next <= now)
+    return 0;
+  return (double)(scrub_io_next - now);
+}
+
+bool OSDService::promote_throttle()
+{
+  uint64_t max_objects = cct->_conf->osd_tier_promote_max_objects_sec;
+  uint64_t max_bytes = cct->_conf->osd_tier_promote_max_bytes_sec;
+  if (!max_objects && !max_bytes)
+    return false;
+  utime_t now = ceph_clock_now(cct);
+  // up to a second's worth of promotions may go through in a burst
+  utime_t limit = now;
+  limit += 1.0;
+  Mutex::Locker l(promote_lock);
+  if (max_bytes && promote_bytes_next > limit)
+    return true;
+  if (max_objects) {
+    if (promote_objects_next > limit)
+      return true;
+    if (promote_objects_next < now)
+      promote_objects_next = now;
+    promote_objects_next += 1.0 / (double)max_objects;
+  }
+  return false;
+}
+
+void OSDService::promote_finish(uint64_t bytes)
+{
+  uint64_t max_bytes = cct->_conf->osd_tier_promote_max_bytes_sec;
+  if (!max_bytes)
+    return;
+  utime_t now = ceph_clock_now(cct);
+  Mutex::Locker l(promote_lock);
+  if (promote_bytes_next < now)
+    promote_bytes_next = now;
+  promote_bytes_next += (double)bytes / (double)max_bytes;
+}
+
 void OSDService::retrieve_epochs(epoch_t *_boot_epoch, epoch_t *_up_epoch,
                                  epoch_t *_bind_epoch) const
 {
@@ -1224,6 +1357,7 @@ OSDMapRef OSDService::try_get_map(epoch_t epoch)
 
 bool OSDService::queue_for_recovery(PG *pg)
 {
+  pg->recovery_redundancy = pg->get_recovery_redundancy();
   bool b = recovery_wq.queue(pg);
   if (b)
     dout(10) << "queue_for_recovery queued " << *pg << dendl;
@@ -1754,6 +1888,29 @@ bool OSD::asok_command(string command, cmdmap_t& cmdmap, string format,
     f->close_section();
   } else if (command == "get_latest_osdmap") {
     get_latest_osdmap();
+  } else if (command == "dump_index_stats") {
+    f->open_object_section("index_stats");
+    store->dump_index_stats(f);
+    f->close_section();
+  } else if (command == "dump_kv_stats") {
+    f->open_object_section("kv_stats");
+    store->dump_kv_stats(f);
+    f->close_section();
+  } else if (command == "compact_range") {
+    string prefix, start, end;
+    cmd_getval(cct, cmdmap, "prefix", prefix);
+    cmd_getval(cct, cmdmap, "start", start);
+    cmd_getval(cct, cmdmap, "end", end);
+    dout(1) << "compacting kv store prefix '" << prefix << "' ["
+	    << start << ", " << end << ")" << dendl;
+    utime_t begin = ceph_clock_now(cct);
+    int r = store->compact_kv(prefix, start, end);
+    utime_t elapsed = ceph_clock_now(cct) - begin;
+    dout(1) << "finished compaction in " << elapsed << ": " << r << dendl;
+    f->open_object_section("compact_range");
+    f->dump_int("result", r);
+    f->dump_float("elapsed", (double)elapsed);
+    f->close_section();
   } else {
     assert(0 == "broken asok registration");
   }
@@ -2028,6 +2185,26 @@ void OSD::final_init()
 				     "force osd to update the latest map from "
 				     "the mon");
   assert(r == 0);
+  r = admin_socket->register_command("dump_index_stats", "dump_index_stats",
+				     asok_hook,
+				     "show object store index statistics, "
+				     "such as path cache hit rates, per collection");
+  assert(r == 0);
+  r = admin_socket->register_command("dump_kv_stats", "dump_kv_stats",
+				     asok_hook,
+				     "show key/value backend statistics, "
+				     "such as block cache and bloom filter hits");
+  assert(r == 0);
+  r = admin_socket->register_command("compact_range",
+				     "compact_range "
+				     "name=prefix,type=CephString,req=false "
+				     "name=start,type=CephString,req=false "
+				     "name=end,type=CephString,req=false",
+				     asok_hook,
+				     "compact the key/value backend: all of it, "
+				     "one prefix, or the keys of a prefix in "
+				     "[start, end)");
+  assert(r == 0);
 
   test_ops_hook = new TestOpsSocketHook(&(this->service), this->store);
   // Note: pools are CephString instead of CephPoolname because
@@ -2122,7 +2299,7 @@ void OSD::create_logger()
       "Client operations total write size", "wr");       // client op in bytes (writes)
   osd_plb.add_u64_counter(l_osd_op_outb,  "op_out_bytes",
       "Client operations total read size", "rd");      // client op out bytes (reads)
-  osd_plb.add_time_avg(l_osd_op_lat,   "op_latency", 
+  osd_plb.add_time_hist(l_osd_op_lat,   "op_latency", 
       "Latency of client operations (including queue time)", "lat");       // client op latency
   osd_plb.add_time_avg(l_osd_op_process_lat, "op_process_latency", 
       "Latency of client operations (excluding queue time)");   // client op process latency
@@ -2131,7 +2308,7 @@ void OSD::create_logger()
       "Client read operations");        // client reads
   osd_plb.add_u64_counter(l_osd_op_r_outb, "op_r_out_bytes", 
       "Client data read");   // client read out bytes
-  osd_plb.add_time_avg(l_osd_op_r_lat,  "op_r_latency", 
+  osd_plb.add_time_hist(l_osd_op_r_lat,  "op_r_latency", 
       "Latency of read operation (including queue time)");    // client read latency
   osd_plb.add_time_avg(l_osd_op_r_process_lat, "op_r_process_latency", 
       "Latency of read operation (excluding queue time)");   // client read process latency
@@ -2141,7 +2318,7 @@ void OSD::create_logger()
       "Client data written");    // client write in bytes
   osd_plb.add_time_avg(l_osd_op_w_rlat, "op_w_rlat", 
       "Client write operation readable/applied latency");   // client write readable/applied latency
-  osd_plb.add_time_avg(l_osd_op_w_lat,  "op_w_latency", 
+  osd_plb.add_time_hist(l_osd_op_w_lat,  "op_w_latency", 
       "Latency of write operation (including queue time)");    // client write latency
   osd_plb.add_time_avg(l_osd_op_w_process_lat, "op_w_process_latency", 
       "Latency of write operation (excluding queue time)");   // client write process latency
@@ -2153,7 +2330,7 @@ void OSD::create_logger()
       "Client read-modify-write operations read out ");  // client rmw out bytes
   osd_plb.add_time_avg(l_osd_op_rw_rlat,"op_rw_rlat", 
       "Client read-modify-write operation readable/applied latency");  // client rmw readable/applied latency
-  osd_plb.add_time_avg(l_osd_op_rw_lat, "op_rw_latency", 
+  osd_plb.add_time_hist(l_osd_op_rw_lat, "op_rw_latency", 
       "Latency of read-modify-write operation (including queue time)");   // client rmw latency
   osd_plb.add_time_avg(l_osd_op_rw_process_lat, "op_rw_process_latency", 
       "Latency of read-modify-write operation (excluding queue time)");   // client rmw process latency
@@ -2213,6 +2390,7 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_tier_delay, "tier_delay", "Tier delays (agent waiting)");
   osd_plb.add_u64_counter(l_osd_tier_proxy_read, "tier_proxy_read", "Tier proxy reads");
   osd_plb.add_u64_counter(l_osd_tier_proxy_write, "tier_proxy_write", "Tier proxy writes");
+  osd_plb.add_u64_counter(l_osd_tier_promote_throttled, "tier_promote_throttled", "Tier promotions skipped for the promotion budget");
 
   osd_plb.add_u64_counter(l_osd_agent_wake, "agent_wake", "Tiering agent wake up");
   osd_plb.add_u64_counter(l_osd_agent_skip, "agent_skip", "Objects skipped by agent");
@@ -2223,10 +2401,17 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_object_ctx_cache_total, "object_ctx_cache_total", "Object context cache lookups");
 
   osd_plb.add_u64_counter(l_osd_op_cache_hit, "op_cache_hit");
+  osd_plb.add_u64_counter(l_osd_op_wq_steal, "op_wq_steal", "Ops run by a thread from another op queue shard");
   osd_plb.add_time_avg(l_osd_tier_flush_lat, "osd_tier_flush_lat", "Object flush latency");
   osd_plb.add_time_avg(l_osd_tier_promote_lat, "osd_tier_promote_lat", "Object promote latency");
   osd_plb.add_time_avg(l_osd_tier_r_lat, "osd_tier_r_lat", "Object proxy read latency");
 
+  osd_plb.add_u64_counter(l_osd_ec_fast_read, "ec_fast_read", "EC fast reads");
+  osd_plb.add_u64_counter(l_osd_ec_fast_read_early, "ec_fast_read_early", "EC fast reads completed before all shards replied");
+  osd_plb.add_u64_counter(l_osd_ec_fast_read_discarded, "ec_fast_read_discarded", "Shard reads discarded by EC fast reads");
+
+  osd_plb.add_u64(l_osd_recovery_limit, "recovery_limit", "Recovery ops allowed at once");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -2292,6 +2477,11 @@ int OSD::shutdown()
   cct->_conf->apply_changes(NULL);
 
   service.start_shutdown();
+  {
+    // pending snap trims hold pg refs
+    Mutex::Locker l(service.snap_sleep_lock);
+    service.snap_sleep_timer.cancel_all_events();
+  }
 
   clear_waiting_sessions();
 
@@ -2327,6 +2517,9 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("dump_watchers");
   cct->get_admin_socket()->unregister_command("dump_reservations");
   cct->get_admin_socket()->unregister_command("get_latest_osdmap");
+  cct->get_admin_socket()->unregister_command("dump_index_stats");
+  cct->get_admin_socket()->unregister_command("dump_kv_stats");
+  cct->get_admin_socket()->unregister_command("compact_range");
   delete asok_hook;
   asok_hook = NULL;
 
@@ -2820,6 +3013,38 @@ PG *OSD::_lookup_lock_pg_with_map_lock_held(spg_t pgid)
   return pg;
 }
 
+/*
+ * Reads pg state and logs for load_pgs() on a few threads.  Each pg
+ * only touches its own state and the store while doing so.
+ */
+struct PGStateLoader : public Thread {
+  ObjectStore *store;
+  vector<pair<PG*, bufferlist> > &pgs;
+  Mutex &lock;
+  unsigned &next;   ///< next pg to read, protected by lock
+
+  PGStateLoader(ObjectStore *store, vector<pair<PG*, bufferlist> > &pgs,
+		Mutex &lock, unsigned &next)
+    : store(store), pgs(pgs), lock(lock), next(next) {}
+
+  void *entry() {
+    while (true) {
+      unsigned i;
+      {
+	Mutex::Locker l(lock);
+	if (next == pgs.size())
+	  break;
+	i = next++;
+      }
+      PG *pg = pgs[i].first;
+      pg->lock();
+      pg->read_state(store, pgs[i].second);
+      pg->unlock();
+    }
+    return 0;
+  }
+};
+
 void OSD::load_pgs()
 {
   assert(osd_lock.is_locked());
@@ -2828,6 +3053,7 @@ void OSD::load_pgs()
     RWLock::RLocker l(pg_map_lock);
     assert(pg_map.empty());
   }
+  utime_t start = ceph_clock_now(cct);
 
   vector<coll_t> ls;
   int r = store->list_collections(ls);
@@ -2837,6 +3063,9 @@ void OSD::load_pgs()
 
   bool has_upgraded = false;
 
+  // open the pgs first; their state and logs are read afterwards, in
+  // parallel
+  vector<pair<PG*, bufferlist> > pgs;
   for (vector<coll_t>::iterator it = ls.begin();
        it != ls.end();
        ++it) {
@@ -2892,9 +3121,46 @@ void OSD::load_pgs()
       pg = _open_lock_pg(osdmap, pgid);
     }
     // there can be no waiters here, so we don't call wake_pg_waiters
+    pg->unlock();
+    pgs.push_back(make_pair(pg, bufferlist()));
+    pgs.back().second.claim(bl);
+  }
+  utime_t opened = ceph_clock_now(cct);
+
+  // read pg state, log
+  unsigned num_threads = MIN((unsigned)MAX(cct->_conf->osd_load_pgs_threads, 1),
+			     pgs.size());
+  if (num_threads > 1) {
+    Mutex lock("OSD::load_pgs::lock");
+    unsigned next = 0;
+    list<PGStateLoader*> loaders;
+    for (unsigned i = 0; i < num_threads; ++i) {
+      loaders.push_back(new PGStateLoader(store, pgs, lock, next));
+      loaders.back()->create();
+    }
+    for (list<PGStateLoader*>::iterator p = loaders.begin();
+	 p != loaders.end();
+	 ++p) {
+      (*p)->join();
+      delete *p;
+    }
+  } else {
+    for (vector<pair<PG*, bufferlist> >::iterator p = pgs.begin();
+	 p != pgs.end();
+	 ++p) {
+      p->first->lock();
+      p->first->read_state(store, p->second);
+      p->first->unlock();
+    }
+  }
+  utime_t read = ceph_clock_now(cct);
 
-    // read pg state, log
-    pg->read_state(store, bl);
+  for (vector<pair<PG*, bufferlist> >::iterator p = pgs.begin();
+       p != pgs.end();
+       ++p) {
+    PG *pg = p->first;
+    spg_t pgid = pg->info.pgid;
+    pg->lock();
 
     if (pg->must_upgrade()) {
       if (!pg->can_upgrade()) {
@@ -2934,6 +3200,7 @@ void OSD::load_pgs()
     dout(10) << "load_pgs loaded " << *pg << " " << pg->pg_log.get_log() << dendl;
     pg->unlock();
   }
+  utime_t initialized = ceph_clock_now(cct);
   {
     RWLock::RLocker l(pg_map_lock);
     dout(0) << "load_pgs opened " << pg_map.size() << " pgs" << dendl;
@@ -2953,6 +3220,12 @@ void OSD::load_pgs()
   }
   
   build_past_intervals_parallel();
+  utime_t end = ceph_clock_now(cct);
+  dout(0) << "load_pgs took " << (end - start) << " s: open "
+	  << (opened - start) << ", read state " << (read - opened)
+	  << " (" << num_threads << " threads), init "
+	  << (initialized - read) << ", past intervals "
+	  << (end - initialized) << dendl;
 }
 
 
@@ -3552,6 +3825,7 @@ void OSD::maybe_update_heartbeat_peers()
   heartbeat_epoch = osdmap->get_epoch();
 
   // build heartbeat from set
+  set<int> pg_peers;
   if (is_active()) {
     RWLock::RLocker l(pg_map_lock);
     for (ceph::unordered_map<spg_t, PG*>::iterator i = pg_map.begin();
@@ -3564,16 +3838,35 @@ void OSD::maybe_update_heartbeat_peers()
 	   p != pg->heartbeat_peers.end();
 	   ++p)
 	if (osdmap->is_up(*p))
-	  _add_heartbeat_peer(*p);
+	  pg_peers.insert(*p);
       for (set<int>::iterator p = pg->probe_targets.begin();
 	   p != pg->probe_targets.end();
 	   ++p)
 	if (osdmap->is_up(*p))
-	  _add_heartbeat_peer(*p);
+	  pg_peers.insert(*p);
       pg->heartbeat_peer_lock.Unlock();
     }
   }
 
+  // with many pgs nearly every osd is a peer; keep a pseudo-random subset
+  // that stays the same from one epoch to the next.  the peers we drop
+  // still watch each other and get watched by their other peers.
+  int max_peers = cct->_conf->osd_heartbeat_max_peers;
+  if (max_peers > 0 && (int)pg_peers.size() > max_peers) {
+    vector<pair<uint32_t,int> > ranked;
+    for (set<int>::iterator p = pg_peers.begin(); p != pg_peers.end(); ++p)
+      ranked.push_back(make_pair(crush_hash32_2(CRUSH_HASH_RJENKINS1,
+						whoami, *p), *p));
+    sort(ranked.begin(), ranked.end());
+    dout(10) << " capping " << pg_peers.size() << " pg peers to "
+	     << max_peers << dendl;
+    pg_peers.clear();
+    for (int i = 0; i < max_peers; ++i)
+      pg_peers.insert(ranked[i].second);
+  }
+  for (set<int>::iterator p = pg_peers.begin(); p != pg_peers.end(); ++p)
+    _add_heartbeat_peer(*p);
+
   // include next and previous up osds to ensure we have a fully-connected set
   set<int> want, extras;
   int next = osdmap->get_next_up_osd_after(whoami);
@@ -3736,6 +4029,7 @@ void OSD::handle_osd_ping(MOSDPing *m)
 		   << " last_rx_front " << i->second.last_rx_front
 		   << dendl;
 	  i->second.last_rx_back = m->stamp;
+	  i->second.back_detector.add(ceph_clock_now(cct));
 	  // if there is no front con, set both stamps.
 	  if (i->second.con_front == NULL)
 	    i->second.last_rx_front = m->stamp;
@@ -3747,6 +4041,7 @@ void OSD::handle_osd_ping(MOSDPing *m)
 		   << " last_rx_front " << i->second.last_rx_front << " -> " << m->stamp
 		   << dendl;
 	  i->second.last_rx_front = m->stamp;
+	  i->second.front_detector.add(ceph_clock_now(cct));
 	}
       }
 
@@ -3821,6 +4116,7 @@ void OSD::heartbeat_check()
   // check for incoming heartbeats (move me elsewhere?)
   utime_t cutoff = now;
   cutoff -= cct->_conf->osd_heartbeat_grace;
+  double phi_threshold = cct->_conf->osd_heartbeat_phi_threshold;
   for (map<int,HeartbeatInfo>::iterator p = heartbeat_peers.begin();
        p != heartbeat_peers.end();
        ++p) {
@@ -3846,6 +4142,14 @@ void OSD::heartbeat_check()
 	// fail
 	failure_queue[p->first] = MIN(p->second.last_rx_back, p->second.last_rx_front);
       }
+    } else if (phi_threshold > 0 &&
+	       p->second.get_phi(now) >= phi_threshold) {
+      // replies were regular enough that this silence is already telling
+      derr << "heartbeat_check: osd." << p->first << " replies overdue, phi "
+	   << p->second.get_phi(now) << " >= " << phi_threshold
+	   << " since back " << p->second.last_rx_back
+	   << " front " << p->second.last_rx_front << dendl;
+      failure_queue[p->first] = MIN(p->second.last_rx_back, p->second.last_rx_front);
     }
   }
 }
@@ -3970,6 +4274,20 @@ void OSD::tick()
 
   logger->set(l_osd_buf, buffer::get_total_alloc());
 
+  if (service.recovery_throttle.adjust(
+	ceph_clock_now(cct),
+	cct->_conf->osd_recovery_adjust_interval,
+	cct->_conf->osd_recovery_target_client_p99,
+	cct->_conf->osd_recovery_min_active,
+	cct->_conf->osd_recovery_max_active,
+	cct->_conf->osd_recovery_adjust_min_samples)) {
+    dout(10) << "tick client p99 " << service.recovery_throttle.get_last_p99()
+	     << " recovery limit " << service.recovery_throttle.get_limit()
+	     << dendl;
+    recovery_wq.wake();
+  }
+  logger->set(l_osd_recovery_limit, service.recovery_throttle.get_limit());
+
   if (is_active() || is_waiting_for_healthy()) {
     map_lock.get_read();
 
@@ -4360,6 +4678,9 @@ void OSD::ms_handle_connect(Connection *con)
       send_alive();
       service.send_pg_temp();
       send_failures();
+      pg_stat_queue_lock.Lock();
+      last_pg_stats_full = utime_t();
+      pg_stat_queue_lock.Unlock();
       send_pg_stats(ceph_clock_now(cct));
 
       monc->sub_want("osd_pg_creates", 0, CEPH_SUBSCRIBE_ONETIME);
@@ -4740,16 +5061,22 @@ void OSD::send_pg_stats(const utime_t &now)
   pg_stat_queue_lock.Lock();
 
   if (osd_stat_updated || !pg_stat_queue.empty()) {
-    last_pg_stats_sent = now;
-    osd_stat_updated = false;
-
-    dout(10) << "send_pg_stats - " << pg_stat_queue.size() << " pgs updated" << dendl;
+    // a pg stays queued until the mon acks it, but there is no point in
+    // sending the same version again while the mon still has the last
+    // copy in flight; only a new session, or the rare message the mon
+    // drops without an ack, needs everything resent.
+    bool full = now - last_pg_stats_full >
+      cct->_conf->osd_mon_report_interval_max;
+    if (full)
+      last_pg_stats_full = now;
+
+    dout(10) << "send_pg_stats - " << pg_stat_queue.size() << " pgs updated"
+	     << (full ? ", resending all" : "") << dendl;
 
     utime_t had_for(now);
     had_for -= had_map_since;
 
     MPGStats *m = new MPGStats(monc->get_fsid(), osdmap->get_epoch(), had_for);
-    m->set_tid(++pg_stat_tid);
     m->osd_stat = cur_stat;
 
     xlist<PG*>::iterator p = pg_stat_queue.begin();
@@ -4762,8 +5089,13 @@ void OSD::send_pg_stats(const utime_t &now)
 	continue;
       }
       pg->pg_stats_publish_lock.Lock();
-      if (pg->pg_stats_publish_valid) {
+      if (pg->pg_stats_publish_valid && !full &&
+	  pg->pg_stats_sent == pg->pg_stats_publish.get_version_pair()) {
+	dout(30) << " already sent " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch << ":"
+		 << pg->pg_stats_publish.reported_seq << dendl;
+      } else if (pg->pg_stats_publish_valid) {
 	m->pg_stat[pg->info.pgid.pgid] = pg->pg_stats_publish;
+	pg->pg_stats_sent = pg->pg_stats_publish.get_version_pair();
 	dout(25) << " sending " << pg->info.pgid << " " << pg->pg_stats_publish.reported_epoch << ":"
 		 << pg->pg_stats_publish.reported_seq << dendl;
       } else {
@@ -4773,11 +5105,19 @@ void OSD::send_pg_stats(const utime_t &now)
       pg->pg_stats_publish_lock.Unlock();
     }
 
-    if (!outstanding_pg_stats) {
-      outstanding_pg_stats = true;
-      last_pg_stats_ack = ceph_clock_now(cct);
+    if (m->pg_stat.empty() && !osd_stat_updated) {
+      dout(20) << "send_pg_stats - nothing new to send" << dendl;
+      m->put();
+    } else {
+      m->set_tid(++pg_stat_tid);
+      last_pg_stats_sent = now;
+      osd_stat_updated = false;
+      if (!outstanding_pg_stats) {
+	outstanding_pg_stats = true;
+	last_pg_stats_ack = ceph_clock_now(cct);
+      }
+      monc->send_mon_message(m);
     }
-    monc->send_mon_message(m);
   }
 
   pg_stat_queue_lock.Unlock();
@@ -5566,12 +5906,53 @@ void OSD::session_notify_pg_cleared(
   clear_session_waiting_on_pg(session, pgid);
 }
 
+void OSD::split_op_batch(MOSDOpBatch *m)
+{
+  dout(20) << __func__ << " " << *m << dendl;
+  // each op takes its share of the batch's throttle budget with it
+  Throttle *bytes = m->get_byte_throttler();
+  uint64_t held = m->get_payload().length() + m->get_middle().length() +
+    m->get_data().length();
+  m->set_byte_throttler(NULL);
+  Throttle *msgs = m->get_message_throttler();
+  m->set_message_throttler(NULL);
+  for (vector<MOSDOp*>::iterator p = m->ops.begin(); p != m->ops.end(); ++p) {
+    MOSDOp *op = *p;
+    // the batch came over an authenticated connection; its ops did not
+    op->set_src(m->get_source());
+    op->set_connection(m->get_connection());
+    op->set_recv_stamp(m->get_recv_stamp());
+    op->set_throttle_stamp(m->get_throttle_stamp());
+    op->set_recv_complete_stamp(m->get_recv_complete_stamp());
+    if (bytes) {
+      uint64_t len = op->get_payload().length() + op->get_middle().length() +
+	op->get_data().length();
+      assert(len <= held);
+      held -= len;
+      op->set_byte_throttler(bytes);
+    }
+    if (msgs && *p == m->ops.back())
+      op->set_message_throttler(msgs);
+  }
+  if (bytes && held)
+    bytes->put(held);
+  vector<MOSDOp*> ops;
+  ops.swap(m->ops);
+  m->put();
+  for (vector<MOSDOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+    ms_fast_dispatch(*p);
+}
+
 void OSD::ms_fast_dispatch(Message *m)
 {
   if (service.is_stopping()) {
     m->put();
     return;
   }
+  if (m->get_type() == MSG_OSD_OP_BATCH) {
+    split_op_batch(static_cast<MOSDOpBatch*>(m));
+    return;
+  }
   OpRequestRef op = op_tracker.create_request<OpRequest>(m);
   {
 #ifdef WITH_LTTNG
@@ -5730,6 +6111,8 @@ epoch_t op_required_epoch(OpRequestRef op)
     return replica_op_required_epoch<MOSDSubOp, MSG_OSD_SUBOP>(op);
   case MSG_OSD_REPOP:
     return replica_op_required_epoch<MOSDRepOp, MSG_OSD_REPOP>(op);
+  case MSG_OSD_REPOP_BATCH:
+    return replica_op_required_epoch<MOSDRepOpBatch, MSG_OSD_REPOP_BATCH>(op);
   case MSG_OSD_SUBOPREPLY:
     return replica_op_required_epoch<MOSDSubOpReply, MSG_OSD_SUBOPREPLY>(
       op);
@@ -5840,6 +6223,9 @@ bool OSD::dispatch_op_fast(OpRequestRef& op, OSDMapRef& osdmap)
   case MSG_OSD_REPOP:
     handle_replica_op<MOSDRepOp, MSG_OSD_REPOP>(op, osdmap);
     break;
+  case MSG_OSD_REPOP_BATCH:
+    handle_replica_op<MOSDRepOpBatch, MSG_OSD_REPOP_BATCH>(op, osdmap);
+    break;
   case MSG_OSD_SUBOPREPLY:
     handle_replica_op<MOSDSubOpReply, MSG_OSD_SUBOPREPLY>(op, osdmap);
     break;
@@ -6280,6 +6666,8 @@ void OSD::handle_osd_map(MOSDMap *m)
       bufferlist& bl = p->second;
       
       o->decode(bl);
+      if (cct->_conf->osd_map_mapping_threads > 0)
+	o->build_mapping(cct->_conf->osd_map_mapping_threads);
 
       ghobject_t fulloid = get_osdmap_pobject_name(e);
       t.write(coll_t::meta(), fulloid, 0, bl.length(), bl);
@@ -6300,9 +6688,16 @@ void OSD::handle_osd_map(MOSDMap *m)
 
       OSDMap *o = new OSDMap;
       if (e > 1) {
-	bufferlist obl;
-	get_map_bl(e - 1, obl);
-	o->decode(obl);
+	// build on the previous epoch in memory (usually cached: we just
+	// added it or it is our current map), sharing what does not change
+	OSDMapRef prev = service.try_get_map(e - 1);
+	if (prev) {
+	  o->cow_copy_from(*prev);
+	} else {
+	  bufferlist obl;
+	  get_map_bl(e - 1, obl);
+	  o->decode(obl);
+	}
       }
 
       OSDMap::Incremental inc;
@@ -6337,6 +6732,8 @@ void OSD::handle_osd_map(MOSDMap *m)
 	break;
       }
       got_full_map(e);
+      if (cct->_conf->osd_map_mapping_threads > 0)
+	o->build_mapping(cct->_conf->osd_map_mapping_threads);
 
       ghobject_t fulloid = get_osdmap_pobject_name(e);
       t.write(coll_t::meta(), fulloid, 0, fbl.length(), fbl);
@@ -6532,6 +6929,7 @@ void OSD::handle_osd_map(MOSDMap *m)
     peering_wq.drain();
   } else {
     activate_map();
+    gossip_map(start - 1, m->get_source().is_mon());
   }
 
   if (m->newest_map && m->newest_map > last) {
@@ -6552,6 +6950,42 @@ void OSD::handle_osd_map(MOSDMap *m)
   m->put();
 }
 
+/*
+ * Pass maps we have just learned about on down the gossip tree, so
+ * that the mons only have to tell one osd about each epoch instead of
+ * every osd having to ask for it.  Each osd forwards an epoch at most
+ * once, when it first gets it; an osd the tree misses (a peer that is
+ * down, or a map it has not seen yet) still catches up the lazy way,
+ * from the epochs on the messages it gets.
+ */
+void OSD::gossip_map(epoch_t since, bool from_mon)
+{
+  int fanout = cct->_conf->osd_map_gossip_fanout;
+  if (fanout <= 0 || !osdmap->is_up(whoami))
+    return;
+
+  vector<int> peers;
+  osdmap->get_map_gossip_peers(whoami, fanout, &peers);
+  int root = osdmap->get_map_gossip_root();
+  if (from_mon && root >= 0 && root != whoami) {
+    // the mons aim for root, but may not have a session with it
+    peers.push_back(root);
+  }
+
+  for (vector<int>::iterator p = peers.begin(); p != peers.end(); ++p) {
+    epoch_t pe = service.get_peer_epoch(*p);
+    if (pe >= osdmap->get_epoch())
+      continue;
+    ConnectionRef con = service.get_con_osd_cluster(*p, osdmap->get_epoch());
+    if (!con)
+      continue;
+    dout(20) << "gossip_map " << MAX(pe, since) << " -> "
+	     << osdmap->get_epoch() << " to osd." << *p << dendl;
+    service.note_peer_epoch(*p, osdmap->get_epoch());
+    service.send_incremental_map(MAX(pe, since), con.get(), osdmap);
+  }
+}
+
 void OSD::check_osdmap_features(ObjectStore *fs)
 {
   // adjust required feature bits?
@@ -7882,9 +8316,10 @@ void OSD::check_replay_queue()
 
 bool OSD::_recover_now()
 {
-  if (recovery_ops_active >= cct->_conf->osd_recovery_max_active) {
+  int max_active = service.recovery_throttle.get_limit();
+  if (recovery_ops_active >= max_active) {
     dout(15) << "_recover_now active " << recovery_ops_active
-	     << " >= max " << cct->_conf->osd_recovery_max_active << dendl;
+	     << " >= max " << max_active << dendl;
     return false;
   }
   if (ceph_clock_now(cct) < defer_recovery_until) {
@@ -7906,14 +8341,15 @@ void OSD::do_recovery(PG *pg, ThreadPool::TPHandle &handle)
 
   // see how many we should try to start.  note that this is a bit racy.
   recovery_wq.lock();
-  int max = MIN(cct->_conf->osd_recovery_max_active - recovery_ops_active,
+  int max_active = service.recovery_throttle.get_limit();
+  int max = MIN(max_active - recovery_ops_active,
       cct->_conf->osd_recovery_max_single_start);
   if (max > 0) {
-    dout(10) << "do_recovery can start " << max << " (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active
+    dout(10) << "do_recovery can start " << max << " (" << recovery_ops_active << "/" << max_active
 	     << " rops)" << dendl;
     recovery_ops_active += max;  // take them now, return them if we don't use them.
   } else {
-    dout(10) << "do_recovery can start 0 (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active
+    dout(10) << "do_recovery can start 0 (" << recovery_ops_active << "/" << max_active
 	     << " rops)" << dendl;
   }
   recovery_wq.unlock();
@@ -7982,7 +8418,7 @@ void OSD::start_recovery_op(PG *pg, const hobject_t& soid)
 {
   recovery_wq.lock();
   dout(10) << "start_recovery_op " << *pg << " " << soid
-	   << " (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active << " rops)"
+	   << " (" << recovery_ops_active << "/" << service.recovery_throttle.get_limit() << " rops)"
 	   << dendl;
   assert(recovery_ops_active >= 0);
   recovery_ops_active++;
@@ -8001,7 +8437,7 @@ void OSD::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
   recovery_wq.lock();
   dout(10) << "finish_recovery_op " << *pg << " " << soid
 	   << " dequeue=" << dequeue
-	   << " (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active << " rops)"
+	   << " (" << recovery_ops_active << "/" << service.recovery_throttle.get_limit() << " rops)"
 	   << dendl;
 
   // adjust count
@@ -8250,19 +8686,33 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb )
   ShardData* sdata = shard_list[shard_index];
   assert(NULL != sdata);
   sdata->sdata_op_ordering_lock.Lock();
-  if (sdata->pqueue.empty()) {
+  if (sdata->pqueue->empty()) {
     sdata->sdata_op_ordering_lock.Unlock();
-    osd->cct->get_heartbeat_map()->reset_timeout(hb, 4, 0);
-    sdata->sdata_lock.Lock();
-    sdata->sdata_cond.WaitInterval(osd->cct, sdata->sdata_lock, utime_t(2, 0));
-    sdata->sdata_lock.Unlock();
-    sdata->sdata_op_ordering_lock.Lock();
-    if(sdata->pqueue.empty()) {
-      sdata->sdata_op_ordering_lock.Unlock();
-      return;
+    ShardData *victim = steal ? _get_steal_victim(shard_index) : NULL;
+    if (victim) {
+      // The op is dequeued and ordered through the victim's
+      // pg_for_processing exactly as its own threads would, so per-PG
+      // ordering is kept; the PG lock serializes us with them.
+      victim->stolen++;
+      sdata->steals.inc();
+      if (osd->logger)
+	osd->logger->inc(l_osd_op_wq_steal);
+      sdata = victim;
+    } else {
+      osd->cct->get_heartbeat_map()->reset_timeout(hb, 4, 0);
+      sdata->sdata_lock.Lock();
+      sdata->sdata_cond.WaitInterval(osd->cct, sdata->sdata_lock,
+				     utime_t(steal ? 0 : 2,
+					     steal ? 100*1000*1000 : 0));
+      sdata->sdata_lock.Unlock();
+      sdata->sdata_op_ordering_lock.Lock();
+      if(sdata->pqueue->empty()) {
+	sdata->sdata_op_ordering_lock.Unlock();
+	return;
+      }
     }
   }
-  pair<PGRef, PGQueueable> item = sdata->pqueue.dequeue();
+  pair<PGRef, PGQueueable> item = sdata->pqueue->dequeue();
   sdata->pg_for_processing[&*(item.first)].push_back(item.second);
   sdata->sdata_op_ordering_lock.Unlock();
   ThreadPool::TPHandle tp_handle(osd->cct, hb, timeout_interval, 
@@ -8322,6 +8772,54 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb )
   (item.first)->unlock();
 }
 
+OSD::ShardedOpWQ::OpQueueT *OSD::ShardedOpWQ::create_queue(CephContext *cct)
+{
+  const md_config_t *conf = cct->_conf;
+  if (conf->osd_op_queue == "mclock") {
+    typedef MClockQueue< pair<PGRef, PGQueueable>, entity_inst_t> MQ;
+    vector<MQ::ClassInfo> info(PGQueueable::OP_CLASS_MAX);
+    info[PGQueueable::OP_CLASS_CLIENT] = MQ::ClassInfo(
+      conf->osd_op_queue_mclock_client_res,
+      conf->osd_op_queue_mclock_client_wgt,
+      conf->osd_op_queue_mclock_client_lim);
+    info[PGQueueable::OP_CLASS_RECOVERY] = MQ::ClassInfo(
+      conf->osd_op_queue_mclock_recovery_res,
+      conf->osd_op_queue_mclock_recovery_wgt,
+      conf->osd_op_queue_mclock_recovery_lim);
+    info[PGQueueable::OP_CLASS_SCRUB] = MQ::ClassInfo(
+      conf->osd_op_queue_mclock_scrub_res,
+      conf->osd_op_queue_mclock_scrub_wgt,
+      conf->osd_op_queue_mclock_scrub_lim);
+    info[PGQueueable::OP_CLASS_SNAPTRIM] = MQ::ClassInfo(
+      conf->osd_op_queue_mclock_snap_res,
+      conf->osd_op_queue_mclock_snap_wgt,
+      conf->osd_op_queue_mclock_snap_lim);
+    return new MQ(info, classify_op);
+  }
+  if (conf->osd_op_queue != "prioritized")
+    lgeneric_derr(cct) << "unknown osd_op_queue '" << conf->osd_op_queue
+	       << "', using prioritized" << dendl;
+  return new PrioritizedQueue< pair<PGRef, PGQueueable>, entity_inst_t>(
+    conf->osd_op_pq_max_tokens_per_priority,
+    conf->osd_op_pq_min_cost);
+}
+
+OSD::ShardedOpWQ::ShardData *OSD::ShardedOpWQ::_get_steal_victim(
+  uint32_t shard_index)
+{
+  for (uint32_t i = 1; i < num_shards; ++i) {
+    ShardData *victim = shard_list[(shard_index + i) % num_shards];
+    assert(NULL != victim);
+    // never block behind a shard that is busy enqueueing or dequeueing
+    if (!victim->sdata_op_ordering_lock.TryLock())
+      continue;
+    if (victim->pqueue->length() >= steal_min_depth)
+      return victim;
+    victim->sdata_op_ordering_lock.Unlock();
+  }
+  return NULL;
+}
+
 void OSD::ShardedOpWQ::_enqueue(pair<PGRef, PGQueueable> item) {
 
   uint32_t shard_index = (((item.first)->get_pgid().ps())% shard_list.size());
@@ -8333,10 +8831,10 @@ void OSD::ShardedOpWQ::_enqueue(pair<PGRef, PGQueueable> item) {
   sdata->sdata_op_ordering_lock.Lock();
  
   if (priority >= CEPH_MSG_PRIO_LOW)
-    sdata->pqueue.enqueue_strict(
+    sdata->pqueue->enqueue_strict(
       item.second.get_owner(), priority, item);
   else
-    sdata->pqueue.enqueue(
+    sdata->pqueue->enqueue(
       item.second.get_owner(),
       priority, cost, item);
   sdata->sdata_op_ordering_lock.Unlock();
@@ -8362,11 +8860,11 @@ void OSD::ShardedOpWQ::_enqueue_front(pair<PGRef, PGQueueable> item) {
   unsigned priority = item.second.get_priority();
   unsigned cost = item.second.get_cost();
   if (priority >= CEPH_MSG_PRIO_LOW)
-    sdata->pqueue.enqueue_strict_front(
+    sdata->pqueue->enqueue_strict_front(
       item.second.get_owner(),
       priority, item);
   else
-    sdata->pqueue.enqueue_front(
+    sdata->pqueue->enqueue_front(
       item.second.get_owner(),
       priority, cost, item);
 
@@ -8519,6 +9017,8 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_op_history_size", "osd_op_history_duration",
     "osd_map_cache_size",
     "osd_map_max_advance",
+    "osd_object_context_cache_bytes",
+    "osd_pg_object_context_cache_count",
     "osd_pg_epoch_persisted_max_stale",
     "osd_disk_thread_ioprio_class",
     "osd_disk_thread_ioprio_priority",
@@ -8562,6 +9062,16 @@ void OSD::handle_conf_change(const struct md_config_t *conf,
     service.map_bl_cache.set_size(cct->_conf->osd_map_cache_size);
     service.map_bl_inc_cache.set_size(cct->_conf->osd_map_cache_size);
   }
+  if (changed.count("osd_object_context_cache_bytes") ||
+      changed.count("osd_pg_object_context_cache_count")) {
+    service.obc_cache.set_max_bytes(
+      cct->_conf->osd_object_context_cache_bytes);
+    RWLock::RLocker l(pg_map_lock);
+    for (ceph::unordered_map<spg_t, PG*>::iterator p = pg_map.begin();
+	 p != pg_map.end();
+	 ++p)
+      p->second->on_obc_cache_change();
+  }
   if (changed.count("clog_to_monitors") ||
       changed.count("clog_to_syslog") ||
       changed.count("clog_to_syslog_level") ||
@@ -8801,6 +9311,24 @@ int OSD::init_op_flags(OpRequestRef& op)
   return 0;
 }
 
+PG *OSD::RecoveryWQ::_dequeue() {
+  if (osd->recovery_queue.empty())
+    return NULL;
+
+  if (!osd->_recover_now())
+    return NULL;
+
+  // the PG closest to blocking IO first, FIFO among equals
+  xlist<PG*>::iterator p = osd->recovery_queue.begin();
+  PG *pg = *p;
+  for (++p; !p.end(); ++p) {
+    if ((*p)->recovery_redundancy < pg->recovery_redundancy)
+      pg = *p;
+  }
+  pg->recovery_item.remove_myself();
+  return pg;
+}
+
 bool OSD::RecoveryWQ::_enqueue(PG *pg) {
   if (!pg->recovery_item.is_on_list()) {
     pg->get("RecoveryWQ");
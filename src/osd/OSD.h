@@ -49,10 +49,14 @@ using namespace std;
 #include "include/unordered_set.h"
 
 #include "Watch.h"
+#include "ObjectContextCache.h"
+#include "PhiAccrual.h"
+#include "RecoveryThrottle.h"
 #include "common/shared_cache.hpp"
 #include "common/simple_cache.hpp"
 #include "common/sharedptr_registry.hpp"
 #include "common/PrioritizedQueue.h"
+#include "common/MClockQueue.h"
 #include "messages/MOSDOp.h"
 
 #define CEPH_OSD_PROTOCOL    10 /* cluster internal */
@@ -136,6 +140,7 @@ enum {
   l_osd_tier_delay,
   l_osd_tier_proxy_read,
   l_osd_tier_proxy_write,
+  l_osd_tier_promote_throttled,
 
   l_osd_agent_wake,
   l_osd_agent_skip,
@@ -146,10 +151,17 @@ enum {
   l_osd_object_ctx_cache_total,
 
   l_osd_op_cache_hit,
+  l_osd_op_wq_steal,
   l_osd_tier_flush_lat,
   l_osd_tier_promote_lat,
   l_osd_tier_r_lat,
 
+  l_osd_ec_fast_read,
+  l_osd_ec_fast_read_early,
+  l_osd_ec_fast_read_discarded,
+
+  l_osd_recovery_limit,
+
   l_osd_last,
 };
 
@@ -197,6 +209,7 @@ class OSDMap;
 class MLog;
 class MClass;
 class MOSDPGMissing;
+class MOSDOpBatch;
 class Objecter;
 
 class Watch;
@@ -382,6 +395,16 @@ public:
   int get_cost() const { return cost; }
   utime_t get_start_time() const { return start_time; }
   entity_inst_t get_owner() const { return owner; }
+
+  /// scheduling class, for op queues that tell them apart (osd_op_queue)
+  enum op_class_t {
+    OP_CLASS_CLIENT = 0,
+    OP_CLASS_RECOVERY,
+    OP_CLASS_SCRUB,
+    OP_CLASS_SNAPTRIM,
+    OP_CLASS_MAX
+  };
+  op_class_t get_op_class() const;
 };
 
 class OSDService {
@@ -636,6 +659,25 @@ public:
   void dec_scrubs_pending();
   void dec_scrubs_active();
 
+  // -- deep scrub read budget --
+  Mutex scrub_io_lock;
+  utime_t scrub_io_next;  ///< when what was read so far is paid for
+
+  /// account bytes read by a deep scrub against osd_deep_scrub_max_bytes_per_sec
+  void charge_scrub_io(uint64_t bytes);
+  /// seconds a deep scrub should wait before reading its next chunk
+  double get_scrub_io_delay();
+
+  // -- cache tier promotion budget --
+  Mutex promote_lock;
+  utime_t promote_objects_next;  ///< when the promotions so far are paid for
+  utime_t promote_bytes_next;    ///< when the bytes promoted so far are paid for
+
+  /// true if an optional promotion should be skipped to stay in budget
+  bool promote_throttle();
+  /// account a finished promotion of bytes
+  void promote_finish(uint64_t bytes);
+
   void reply_op_error(OpRequestRef op, int err);
   void reply_op_error(OpRequestRef op, int err, eversion_t v, version_t uv);
   void handle_misdirected_op(PG *pg, OpRequestRef op);
@@ -783,6 +825,20 @@ public:
   Mutex backfill_request_lock;
   SafeTimer backfill_request_timer;
 
+  // -- Replication batching (flushes repop batches) --
+  Mutex repop_batch_lock;
+  SafeTimer repop_batch_timer;
+
+  // -- Snap trim pacing (osd_snap_trim_sleep) --
+  Mutex snap_sleep_lock;
+  SafeTimer snap_sleep_timer;
+
+  // -- Object contexts kept alive across PGs --
+  ObjectContextCache obc_cache;
+
+  // -- Recovery concurrency, adjusted to client latency --
+  RecoveryThrottle recovery_throttle;
+
   // -- tids --
   // for ops i issue
   ceph_tid_t last_tid;
@@ -812,17 +868,18 @@ public:
 
   void queue_for_peering(PG *pg);
   bool queue_for_recovery(PG *pg);
-  void queue_for_snap_trim(PG *pg) {
+  void _queue_for_snap_trim(PG *pg, epoch_t e) {
     op_wq.queue(
       make_pair(
 	pg,
 	PGQueueable(
-	  PGSnapTrim(pg->get_osdmap()->get_epoch()),
+	  PGSnapTrim(e),
 	  cct->_conf->osd_snap_trim_cost,
 	  cct->_conf->osd_snap_trim_priority,
 	  ceph_clock_now(cct),
 	  entity_inst_t())));
   }
+  void queue_for_snap_trim(PG *pg);
   void queue_for_scrub(PG *pg) {
     op_wq.queue(
       make_pair(
@@ -1472,6 +1529,8 @@ private:
     utime_t last_rx_front;  ///< last time we got a ping reply on the front side
     utime_t last_rx_back;   ///< last time we got a ping reply on the back side
     epoch_t epoch;      ///< most recent epoch we wanted this peer
+    PhiAccrualDetector front_detector;  ///< arrivals of front replies
+    PhiAccrualDetector back_detector;   ///< arrivals of back replies
 
     bool is_unhealthy(utime_t cutoff) {
       return
@@ -1485,6 +1544,10 @@ private:
     bool is_healthy(utime_t cutoff) {
       return last_rx_front > cutoff && last_rx_back > cutoff;
     }
+    /// how strongly the reply streams suggest the peer is gone
+    double get_phi(utime_t now) const {
+      return MAX(front_detector.phi(now), back_detector.phi(now));
+    }
 
   };
   /// state attached to outgoing heartbeat connections
@@ -1594,28 +1657,46 @@ private:
   friend class PGQueueable;
   class ShardedOpWQ: public ShardedThreadPool::ShardedWQ < pair <PGRef, PGQueueable> > {
 
+    typedef OpQueue< pair<PGRef, PGQueueable>, entity_inst_t> OpQueueT;
+
     struct ShardData {
       Mutex sdata_lock;
       Cond sdata_cond;
       Mutex sdata_op_ordering_lock;
       map<PG*, list<PGQueueable> > pg_for_processing;
-      PrioritizedQueue< pair<PGRef, PGQueueable>, entity_inst_t> pqueue;
+      OpQueueT *pqueue;
+      uint64_t stolen;         ///< ops taken from this shard by other shards' threads (ordering lock)
+      atomic64_t steals;       ///< ops this shard's threads took from other shards
       ShardData(
-	string lock_name, string ordering_lock,
-	uint64_t max_tok_per_prio, uint64_t min_cost)
+	string lock_name, string ordering_lock, OpQueueT *q)
 	: sdata_lock(lock_name.c_str()),
 	  sdata_op_ordering_lock(ordering_lock.c_str()),
-	  pqueue(max_tok_per_prio, min_cost) {}
+	  pqueue(q),
+	  stolen(0) {}
+      ~ShardData() {
+	delete pqueue;
+      }
     };
+
+    /// build the scheduler selected by osd_op_queue
+    static OpQueueT *create_queue(CephContext *cct);
     
     vector<ShardData*> shard_list;
     OSD *osd;
     uint32_t num_shards;
+    bool steal;                ///< idle threads may take ops queued on other shards
+    unsigned steal_min_depth;  ///< minimum queue depth before a shard is stolen from
+
+    /// find a shard other than @a shard_index worth stealing from; returns
+    /// with its ordering lock held, or NULL
+    ShardData *_get_steal_victim(uint32_t shard_index);
 
   public:
     ShardedOpWQ(uint32_t pnum_shards, OSD *o, time_t ti, time_t si, ShardedThreadPool* tp):
       ShardedThreadPool::ShardedWQ < pair <PGRef, PGQueueable> >(ti, si, tp),
-      osd(o), num_shards(pnum_shards) {
+      osd(o), num_shards(pnum_shards),
+      steal(o->cct->_conf->osd_op_shard_steal && pnum_shards > 1),
+      steal_min_depth(MAX(1, o->cct->_conf->osd_op_shard_steal_min_depth)) {
       for(uint32_t i = 0; i < num_shards; i++) {
 	char lock_name[32] = {0};
 	snprintf(lock_name, sizeof(lock_name), "%s.%d", "OSD:ShardedOpWQ:", i);
@@ -1624,9 +1705,7 @@ private:
 	  order_lock, sizeof(order_lock), "%s.%d",
 	  "OSD:ShardedOpWQ:order:", i);
 	ShardData* one_shard = new ShardData(
-	  lock_name, order_lock,
-	  osd->cct->_conf->osd_op_pq_max_tokens_per_priority, 
-	  osd->cct->_conf->osd_op_pq_min_cost);
+	  lock_name, order_lock, create_queue(osd->cct));
 	shard_list.push_back(one_shard);
       }
     }
@@ -1660,7 +1739,11 @@ private:
 	assert (NULL != sdata);
 	sdata->sdata_op_ordering_lock.Lock();
 	f->open_object_section(lock_name);
-	sdata->pqueue.dump(f);
+	f->dump_unsigned("queue_depth", sdata->pqueue->length());
+	f->dump_unsigned("pgs_in_progress", sdata->pg_for_processing.size());
+	f->dump_unsigned("stolen", sdata->stolen);
+	f->dump_unsigned("steals", sdata->steals.read());
+	sdata->pqueue->dump(f);
 	f->close_section();
 	sdata->sdata_op_ordering_lock.Unlock();
       }
@@ -1681,7 +1764,7 @@ private:
       sdata = shard_list[shard_index];
       assert(sdata != NULL);
       sdata->sdata_op_ordering_lock.Lock();
-      sdata->pqueue.remove_by_filter(Pred(pg));
+      sdata->pqueue->remove_by_filter(Pred(pg));
       sdata->pg_for_processing.erase(pg);
       sdata->sdata_op_ordering_lock.Unlock();
     }
@@ -1695,7 +1778,7 @@ private:
       assert(dequeued);
       list<pair<PGRef, PGQueueable> > _dequeued;
       sdata->sdata_op_ordering_lock.Lock();
-      sdata->pqueue.remove_by_filter(Pred(pg), &_dequeued);
+      sdata->pqueue->remove_by_filter(Pred(pg), &_dequeued);
       for (list<pair<PGRef, PGQueueable> >::iterator i = _dequeued.begin();
 	   i != _dequeued.end(); ++i) {
 	boost::optional<OpRequestRef> mop = i->second.maybe_get_op();
@@ -1722,7 +1805,7 @@ private:
       ShardData* sdata = shard_list[shard_index];
       assert(NULL != sdata);
       Mutex::Locker l(sdata->sdata_op_ordering_lock);
-      return sdata->pqueue.empty();
+      return sdata->pqueue->empty();
     }
   } op_shardedwq;
 
@@ -1824,6 +1907,7 @@ private:
   void advance_map();
   void consume_map();
   void activate_map();
+  void gossip_map(epoch_t since, bool from_mon);
 
   // osd map cache (past osd maps)
   OSDMapRef get_map(epoch_t e) {
@@ -2030,6 +2114,8 @@ protected:
   xlist<PG*> pg_stat_queue;
   bool osd_stat_updated;
   uint64_t pg_stat_tid, pg_stat_tid_flushed;
+  /// when we last sent every queued pg, not just those changed since
+  utime_t last_pg_stats_full;
 
   void send_pg_stats(const utime_t &now);
   void handle_pg_stats_ack(class MPGStatsAck *ack);
@@ -2192,17 +2278,7 @@ protected:
       if (pg->recovery_item.remove_myself())
 	pg->put("RecoveryWQ");
     }
-    PG *_dequeue() {
-      if (osd->recovery_queue.empty())
-	return NULL;
-      
-      if (!osd->_recover_now())
-	return NULL;
-
-      PG *pg = osd->recovery_queue.front();
-      osd->recovery_queue.pop_front();
-      return pg;
-    }
+    PG *_dequeue();
     void _queue_front(PG *pg) {
       if (!pg->recovery_item.is_on_list()) {
 	pg->get("RecoveryWQ");
@@ -2280,8 +2356,10 @@ protected:
   bool ms_can_fast_dispatch(Message *m) const {
     switch (m->get_type()) {
     case CEPH_MSG_OSD_OP:
+    case MSG_OSD_OP_BATCH:
     case MSG_OSD_SUBOP:
     case MSG_OSD_REPOP:
+    case MSG_OSD_REPOP_BATCH:
     case MSG_OSD_SUBOPREPLY:
     case MSG_OSD_REPOPREPLY:
     case MSG_OSD_PG_PUSH:
@@ -2300,6 +2378,7 @@ protected:
     }
   }
   void ms_fast_dispatch(Message *m);
+  void split_op_batch(MOSDOpBatch *m);
   void ms_fast_preprocess(Message *m);
   bool ms_dispatch(Message *m);
   bool ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool force_new);
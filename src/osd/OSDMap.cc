@@ -923,6 +923,9 @@ void OSDMap::set_max_osd(int m)
   }
   osd_info.resize(m);
   osd_xinfo.resize(m);
+  cow(osd_addrs);
+  cow(osd_uuid);
+  cow(osd_primary_affinity);
   osd_addrs->client_addr.resize(m);
   osd_addrs->cluster_addr.resize(m);
   osd_addrs->hb_back_addr.resize(m);
@@ -967,6 +970,38 @@ unsigned OSDMap::get_num_up_osds() const
   return n;
 }
 
+int OSDMap::get_map_gossip_root() const
+{
+  unsigned n = get_num_up_osds();
+  if (n == 0)
+    return -1;
+  unsigned r = epoch % n;
+  for (int i=0; i<max_osd; i++)
+    if (is_up(i) && r-- == 0)
+      return i;
+  return -1;
+}
+
+void OSDMap::get_map_gossip_peers(int osd, unsigned fanout,
+				  vector<int> *peers) const
+{
+  peers->clear();
+  vector<int> up;
+  up.reserve(max_osd);
+  for (int i=0; i<max_osd; i++)
+    if (is_up(i))
+      up.push_back(i);
+  vector<int>::iterator p = std::find(up.begin(), up.end(), osd);
+  if (p == up.end() || fanout == 0)
+    return;
+
+  // position in the ring of up osds starting at the root
+  uint64_t n = up.size();
+  uint64_t pos = ((p - up.begin()) + n - epoch % n) % n;
+  for (uint64_t c = pos * fanout + 1; c <= pos * fanout + fanout && c < n; ++c)
+    peers->push_back(up[(c + epoch % n) % n]);
+}
+
 unsigned OSDMap::get_num_in_osds() const
 {
   unsigned n = 0;
@@ -1054,6 +1089,10 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
 	p->second.is_tier()) {
       features |= CEPH_FEATURE_OSD_CACHEPOOL;
     }
+    if (p->second.hit_set_params.get_type() == HitSet::TYPE_CUCKOO &&
+	entity_type != CEPH_ENTITY_TYPE_CLIENT) { // clients get bloom params
+      features |= CEPH_FEATURE_OSD_HITSET_CUCKOO;
+    }
     int ruleid = crush->find_rule(p->second.get_crush_ruleset(),
 				  p->second.get_type(),
 				  p->second.get_size());
@@ -1080,7 +1119,7 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
   }
   mask |= CEPH_FEATURE_OSDHASHPSPOOL | CEPH_FEATURE_OSD_CACHEPOOL;
   if (entity_type != CEPH_ENTITY_TYPE_CLIENT)
-    mask |= CEPH_FEATURE_OSD_ERASURE_CODES;
+    mask |= CEPH_FEATURE_OSD_ERASURE_CODES | CEPH_FEATURE_OSD_HITSET_CUCKOO;
 
   if (osd_primary_affinity) {
     for (int i = 0; i < max_osd; ++i) {
@@ -1263,6 +1302,7 @@ void OSDMap::remove_down_temps(CephContext *cct,
 int OSDMap::apply_incremental(const Incremental &inc)
 {
   new_blacklist_entries = false;
+  mapping.reset();
   if (inc.epoch == 1)
     fsid = inc.fsid;
   else if (inc.fsid != fsid)
@@ -1345,6 +1385,10 @@ int OSDMap::apply_incremental(const Incremental &inc)
   }
   
   // up/down
+  if (!inc.new_state.empty() || !inc.new_uuid.empty())
+    cow(osd_uuid);
+  if (!inc.new_up_client.empty() || !inc.new_up_cluster.empty())
+    cow(osd_addrs);
   for (map<int32_t,uint8_t>::const_iterator i = inc.new_state.begin();
        i != inc.new_state.end();
        ++i) {
@@ -1405,6 +1449,10 @@ int OSDMap::apply_incremental(const Incremental &inc)
     (*osd_uuid)[p->first] = p->second;
 
   // pg rebuild
+  if (!inc.new_pg_temp.empty())
+    cow(pg_temp);
+  if (!inc.new_primary_temp.empty())
+    cow(primary_temp);
   for (map<pg_t, vector<int> >::const_iterator p = inc.new_pg_temp.begin(); p != inc.new_pg_temp.end(); ++p) {
     if (p->second.empty())
       pg_temp->erase(p->first);
@@ -1688,6 +1736,9 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_primary,
                                    vector<int> *acting, int *acting_primary) const
 {
+  if (mapping && mapping->get_epoch() == epoch &&
+      mapping->get(pg, up, up_primary, acting, acting_primary))
+    return;
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool) {
     if (up)
@@ -1726,6 +1777,118 @@ void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_prim
     *acting_primary = _acting_primary;
 }
 
+void OSDMap::build_mapping(unsigned num_threads)
+{
+  mapping.reset();
+  OSDMapMapping *m = new OSDMapMapping;
+  m->update(*this, num_threads);
+  mapping.reset(m);
+}
+
+void OSDMap::calc_balance_reweights(const set<int64_t>& only_pools,
+				    const map<pg_t,uint64_t> *pg_bytes,
+				    double max_change, unsigned rounds,
+				    map<int,__u32> *new_weights,
+				    double *before, double *after) const
+{
+  // a private copy to try weights on; it must not use our table
+  OSDMap tmp(*this);
+  tmp.mapping.reset();
+
+  // the osds the pools map to at first are the ones to balance
+  vector<bool> used(max_osd, false);
+  double cw_sum = 0;
+
+  vector<__u32> best = osd_weight;
+  double best_dev = -1;
+  if (before)
+    *before = 0;
+  for (unsigned round = 0; round <= rounds; ++round) {
+    vector<double> load(max_osd, 0);
+    double total = 0;
+    for (map<int64_t,pg_pool_t>::const_iterator p = pools.begin();
+	 p != pools.end();
+	 ++p) {
+      if (!only_pools.empty() && only_pools.count(p->first) == 0)
+	continue;
+      for (unsigned ps = 0; ps < p->second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p->first, -1);
+	double w = 1;
+	if (pg_bytes) {
+	  map<pg_t,uint64_t>::const_iterator q = pg_bytes->find(pgid);
+	  w = q == pg_bytes->end() ? 0 : q->second;
+	}
+	vector<int> up;
+	int up_primary;
+	tmp._pg_to_up_acting_osds(pgid, &up, &up_primary, NULL, NULL);
+	for (unsigned i = 0; i < up.size(); ++i) {
+	  if (up[i] >= 0 && up[i] < max_osd)
+	    load[up[i]] += w;
+	}
+      }
+    }
+    if (round == 0) {
+      for (int i = 0; i < max_osd; ++i) {
+	if (load[i] > 0 && crush->get_item_weightf(i) > 0) {
+	  used[i] = true;
+	  cw_sum += crush->get_item_weightf(i);
+	}
+      }
+    }
+    for (int i = 0; i < max_osd; ++i)
+      if (used[i])
+	total += load[i];
+    if (total == 0 || cw_sum == 0)
+      break;
+
+    // how far each osd is from its share
+    vector<double> ratio(max_osd, 0);
+    double dev = 0;
+    int num = 0;
+    for (int i = 0; i < max_osd; ++i) {
+      if (!used[i])
+	continue;
+      double share = total * crush->get_item_weightf(i) / cw_sum;
+      ratio[i] = load[i] / share;
+      dev += (ratio[i] - 1) * (ratio[i] - 1);
+      ++num;
+    }
+    dev = num ? sqrt(dev / num) : 0;
+    if (round == 0 && before)
+      *before = dev;
+    if (best_dev < 0 || dev < best_dev) {
+      best_dev = dev;
+      best = tmp.osd_weight;
+    }
+    if (round == rounds)
+      break;
+
+    bool changed = false;
+    for (int i = 0; i < max_osd; ++i) {
+      if (!used[i])
+	continue;
+      double w = tmp.osd_weight[i];
+      double nw = ratio[i] > 0 ? w / ratio[i] : w * (1 + max_change);
+      nw = MAX(nw, w * (1 - max_change));
+      nw = MIN(nw, w * (1 + max_change));
+      nw = MIN(nw, (double)CEPH_OSD_IN);
+      __u32 v = MAX(1u, (__u32)nw);
+      if (v != tmp.osd_weight[i]) {
+	tmp.osd_weight[i] = v;
+	changed = true;
+      }
+    }
+    if (!changed)
+      break;
+  }
+
+  if (after)
+    *after = best_dev < 0 ? 0 : best_dev;
+  for (int i = 0; i < max_osd; ++i)
+    if (best[i] != osd_weight[i])
+      (*new_weights)[i] = best[i];
+}
+
 int OSDMap::calc_pg_rank(int osd, const vector<int>& acting, int nrep)
 {
   if (!nrep)
@@ -2090,6 +2253,15 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
 
 void OSDMap::decode(bufferlist::iterator& bl)
 {
+  // we may share these with another map (cow_copy_from); decode into
+  // our own
+  osd_addrs.reset(new addrs_s);
+  pg_temp.reset(new map<pg_t,vector<int32_t> >);
+  primary_temp.reset(new map<pg_t,int32_t>);
+  osd_uuid.reset(new vector<uuid_d>);
+  crush.reset(new CrushWrapper);
+  mapping.reset();
+
   /**
    * Older encodings of the OSDMap had a single struct_v which
    * covered the whole encoding, and was prior to our modern
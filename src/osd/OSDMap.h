@@ -42,9 +42,11 @@
 #include <set>
 #include <map>
 #include "include/memory.h"
+#include "include/mempool.h"
 using namespace std;
 
 #include "include/unordered_set.h"
+#include "OSDMapMapping.h"
 
 /*
  * we track up to two intervals during which the osd was alive and
@@ -113,6 +115,8 @@ ostream& operator<<(ostream& out, const osd_xinfo_t& xi);
 class OSDMap {
 
 public:
+  MEMPOOL_CLASS_HELPERS(osdmap);
+
   class Incremental {
   public:
     /// feature bits we were encoded with.  the subsequent OSDMap
@@ -250,8 +254,18 @@ private:
   mutable bool crc_defined;
   mutable uint32_t crc;
 
+  /// every pg's mappings in this epoch, if build_mapping() was called
+  ceph::shared_ptr<const OSDMapMapping> mapping;
+
   void _calc_up_osd_features();
 
+  /// make *p our own before changing it, if another map shares it
+  template <typename T>
+  static void cow(ceph::shared_ptr<T> &p) {
+    if (p && !p.unique())
+      p.reset(new T(*p));
+  }
+
  public:
   bool have_crc() const { return crc_defined; }
   uint32_t get_crc() const { return crc; }
@@ -260,6 +274,7 @@ private:
 
   friend class OSDMonitor;
   friend class PGMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -299,6 +314,16 @@ public:
     // allocate a new CrushWrapper, though.
   }
 
+  /**
+   * Copy o, sharing its crush map, addrs, uuids, temps and primary
+   * affinities with it.  apply_incremental() copies only the ones the
+   * incremental changes, so building the next epoch costs about the
+   * size of the change.
+   */
+  void cow_copy_from(const OSDMap& o) {
+    *this = o;
+  }
+
   // map info
   const uuid_d& get_fsid() const { return fsid; }
   void set_fsid(uuid_d& f) { fsid = f; }
@@ -383,6 +408,8 @@ public:
     if (!osd_primary_affinity)
       osd_primary_affinity.reset(new vector<__u32>(max_osd,
 						   CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
+    else
+      cow(osd_primary_affinity);
     (*osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
@@ -530,6 +557,16 @@ public:
     return -1;
   }
 
+  /**
+   * map gossip tree
+   *
+   * The up osds, in id order starting at a root that moves with the
+   * epoch, form a tree in which each osd forwards this map to the
+   * fanout osds below it; see osd_map_gossip_fanout.
+   */
+  int get_map_gossip_root() const;
+  void get_map_gossip_peers(int osd, unsigned fanout, vector<int> *peers) const;
+
   int get_next_up_osd_after(int n) const {
     for (int i = n + 1; i != n; ++i) {
       if (i >= get_max_osd())
@@ -683,6 +720,36 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+
+  /**
+   * Precompute the mappings of every pg, so that the calls above are
+   * table lookups.  Only for a map that will not change any more (the
+   * table is dropped when an incremental is applied or a map decoded
+   * over this one).
+   */
+  void build_mapping(unsigned num_threads);
+  const OSDMapMapping *get_mapping() const {
+    return mapping.get();
+  }
+
+  /**
+   * Search for reweights that even out the load of the osds
+   *
+   * Each round maps the pgs of pools (all if empty) with the reweights
+   * found so far and compares what every in osd holds (pg copies, or
+   * bytes if pg_bytes is given) with the share its crush weight
+   * entitles it to, then moves its reweight towards that share by at
+   * most max_change.  The round with the smallest spread wins.
+   *
+   * @param new_weights [out] reweights that differ from this map's
+   * @param before [out] stddev of load/share before, if not NULL
+   * @param after [out] and with new_weights applied, if not NULL
+   */
+  void calc_balance_reweights(const set<int64_t>& pools,
+			      const map<pg_t,uint64_t> *pg_bytes,
+			      double max_change, unsigned rounds,
+			      map<int,__u32> *new_weights,
+			      double *before, double *after) const;
   bool pg_is_ec(pg_t pg) const {
     map<int64_t, pg_pool_t>::const_iterator i = pools.find(pg.pool());
     assert(i != pools.end());
@@ -0,0 +1,233 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <algorithm>
+
+#include "OSDMapMapping.h"
+#include "OSDMap.h"
+#include "common/Thread.h"
+
+// pgs per unit of work handed to a thread
+#define PGS_PER_JOB 1024
+
+class OSDMapMappingWorker : public Thread {
+  OSDMapMapping *mapping;
+  const OSDMap &map;
+  std::vector<OSDMapMapping::Job> jobs;
+
+public:
+  OSDMapMappingWorker(OSDMapMapping *m, const OSDMap &o)
+    : mapping(m), map(o) {}
+  void add(const OSDMapMapping::Job &job) {
+    jobs.push_back(job);
+  }
+  void run() {
+    for (unsigned i = 0; i < jobs.size(); ++i)
+      mapping->_update_range(map, jobs[i]);
+  }
+  void *entry() {
+    run();
+    return NULL;
+  }
+};
+
+void OSDMapMapping::_update_range(const OSDMap& map, const Job& job)
+{
+  PoolMapping &pm = pools.find(job.pool)->second;
+  std::vector<int> up, acting;
+  int up_primary, acting_primary;
+  for (unsigned ps = job.begin; ps < job.end; ++ps) {
+    map.pg_to_up_acting_osds(pg_t(ps, job.pool, -1),
+			     &up, &up_primary, &acting, &acting_primary);
+    assert(up.size() <= pm.width && acting.size() <= pm.width);
+    int32_t *row = pm.row(ps);
+    row[0] = up_primary;
+    row[1] = acting_primary;
+    row[2] = up.size();
+    row[3] = acting.size();
+    for (unsigned i = 0; i < up.size(); ++i)
+      row[4 + i] = up[i];
+    for (unsigned i = 0; i < acting.size(); ++i)
+      row[4 + pm.width + i] = acting[i];
+  }
+}
+
+void OSDMapMapping::update(const OSDMap& map, unsigned num_threads)
+{
+  epoch = map.get_epoch();
+  pools.clear();
+
+  // size every table first; the workers only fill in rows
+  const std::map<int64_t,pg_pool_t>& mpools = map.get_pools();
+  for (std::map<int64_t,pg_pool_t>::const_iterator p = mpools.begin();
+       p != mpools.end();
+       ++p) {
+    PoolMapping &pm = pools[p->first];
+    pm.width = p->second.get_size();
+    pm.pg_num = p->second.get_pg_num();
+    pm.positional = !p->second.can_shift_osds();
+  }
+  for (std::map<pg_t,vector<int32_t> >::const_iterator p = map.pg_temp->begin();
+       p != map.pg_temp->end();
+       ++p) {
+    std::map<int64_t, PoolMapping>::iterator q = pools.find(p->first.pool());
+    if (q != pools.end() && p->second.size() > q->second.width)
+      q->second.width = p->second.size();
+  }
+
+  if (num_threads < 1)
+    num_threads = 1;
+  std::vector<OSDMapMappingWorker*> workers;
+  for (unsigned i = 0; i < num_threads; ++i)
+    workers.push_back(new OSDMapMappingWorker(this, map));
+  unsigned next = 0;
+  for (std::map<int64_t, PoolMapping>::iterator p = pools.begin();
+       p != pools.end();
+       ++p) {
+    p->second.table.resize(p->second.pg_num * p->second.row_size());
+    for (unsigned ps = 0; ps < p->second.pg_num; ps += PGS_PER_JOB) {
+      workers[next++ % num_threads]->add(
+	Job(p->first, ps, MIN(ps + PGS_PER_JOB, p->second.pg_num)));
+    }
+  }
+
+  if (num_threads == 1) {
+    workers[0]->run();
+  } else {
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->create();
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->join();
+  }
+  for (unsigned i = 0; i < workers.size(); ++i)
+    delete workers[i];
+}
+
+bool OSDMapMapping::get(pg_t pgid,
+			std::vector<int> *up, int *up_primary,
+			std::vector<int> *acting, int *acting_primary) const
+{
+  std::map<int64_t, PoolMapping>::const_iterator p = pools.find(pgid.pool());
+  if (p == pools.end() || pgid.ps() >= p->second.pg_num)
+    return false;
+  const PoolMapping &pm = p->second;
+  const int32_t *row = pm.row(pgid.ps());
+  if (up_primary)
+    *up_primary = row[0];
+  if (acting_primary)
+    *acting_primary = row[1];
+  if (up)
+    up->assign(row + 4, row + 4 + row[2]);
+  if (acting)
+    acting->assign(row + 4 + pm.width, row + 4 + pm.width + row[3]);
+  return true;
+}
+
+void OSDMapMapping::get_changed(const OSDMapMapping& other,
+				std::set<pg_t> *changed) const
+{
+  for (std::map<int64_t, PoolMapping>::const_iterator p = pools.begin();
+       p != pools.end();
+       ++p) {
+    for (unsigned ps = 0; ps < p->second.pg_num; ++ps) {
+      pg_t pgid(ps, p->first, -1);
+      std::vector<int> up, acting, oup, oacting;
+      int up_primary, acting_primary, oup_primary, oacting_primary;
+      get(pgid, &up, &up_primary, &acting, &acting_primary);
+      if (!other.get(pgid, &oup, &oup_primary, &oacting, &oacting_primary) ||
+	  up != oup || up_primary != oup_primary ||
+	  acting != oacting || acting_primary != oacting_primary)
+	changed->insert(pgid);
+    }
+  }
+}
+
+uint64_t OSDMapMapping::get_num_pgs() const
+{
+  uint64_t n = 0;
+  for (std::map<int64_t, PoolMapping>::const_iterator p = pools.begin();
+       p != pools.end();
+       ++p)
+    n += p->second.pg_num;
+  return n;
+}
+
+void OSDMapMapping::count_pgs(int64_t pool, int max_osd,
+			      std::vector<unsigned> *count,
+			      std::vector<unsigned> *first,
+			      std::vector<unsigned> *primary) const
+{
+  count->resize(max_osd);
+  first->resize(max_osd);
+  primary->resize(max_osd);
+  for (std::map<int64_t, PoolMapping>::const_iterator p = pools.begin();
+       p != pools.end();
+       ++p) {
+    if (pool >= 0 && p->first != pool)
+      continue;
+    const PoolMapping &pm = p->second;
+    for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+      const int32_t *row = pm.row(ps);
+      const int32_t *acting = row + 4 + pm.width;
+      for (int i = 0; i < row[3]; ++i)
+	if (acting[i] >= 0 && acting[i] < max_osd)
+	  (*count)[acting[i]]++;
+      if (row[3] > 0 && acting[0] >= 0 && acting[0] < max_osd)
+	(*first)[acting[0]]++;
+      if (row[1] >= 0 && row[1] < max_osd)
+	(*primary)[row[1]]++;
+    }
+  }
+}
+
+void OSDMapMapping::count_moved(const OSDMapMapping& other, int64_t pool,
+				uint64_t *moved_pgs,
+				uint64_t *moved_copies) const
+{
+  *moved_pgs = 0;
+  *moved_copies = 0;
+  for (std::map<int64_t, PoolMapping>::const_iterator p = pools.begin();
+       p != pools.end();
+       ++p) {
+    if (pool >= 0 && p->first != pool)
+      continue;
+    std::map<int64_t, PoolMapping>::const_iterator q =
+      other.pools.find(p->first);
+    if (q == other.pools.end())
+      continue;
+    const PoolMapping &pm = p->second, &om = q->second;
+    unsigned pg_num = MIN(pm.pg_num, om.pg_num);
+    for (unsigned ps = 0; ps < pg_num; ++ps) {
+      const int32_t *row = pm.row(ps), *orow = om.row(ps);
+      const int32_t *acting = row + 4 + pm.width;
+      const int32_t *oacting = orow + 4 + om.width;
+      unsigned moved = 0;
+      for (int i = 0; i < row[3]; ++i) {
+	if (acting[i] < 0)
+	  continue;
+	bool had;
+	if (pm.positional) {
+	  had = i < orow[3] && oacting[i] == acting[i];
+	} else {
+	  had = std::find(oacting, oacting + orow[3], acting[i]) !=
+	    oacting + orow[3];
+	}
+	if (!had)
+	  ++moved;
+      }
+      if (moved || row[3] != orow[3] ||
+	  !std::equal(acting, acting + row[3], oacting))
+	++*moved_pgs;
+      *moved_copies += moved;
+    }
+  }
+}
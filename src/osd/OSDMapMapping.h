@@ -0,0 +1,110 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSDMAPMAPPING_H
+#define CEPH_OSDMAPMAPPING_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "include/mempool.h"
+#include "osd_types.h"
+
+class OSDMap;
+
+/**
+ * The up and acting sets of every pg in one OSDMap epoch
+ *
+ * Filled in once (CRUSH, temps and primary affinity for each pg, split
+ * over a few threads) so that lookups are an index into a per-pool
+ * table.  Each pg gets one fixed-width row:
+ *
+ *   up_primary, acting_primary, up.size(), acting.size(),
+ *   up[0..width), acting[0..width)
+ *
+ * width being the largest set the pool can map to.
+ */
+class OSDMapMapping {
+  struct PoolMapping {
+    unsigned width;
+    unsigned pg_num;
+    /// whether a shard moving between positions moves data (erasure)
+    bool positional;
+    mempool::osdmap::vector<int32_t> table;
+
+    PoolMapping() : width(0), pg_num(0), positional(false) {}
+    unsigned row_size() const {
+      return 4 + 2 * width;
+    }
+    int32_t *row(unsigned ps) {
+      return &table[ps * row_size()];
+    }
+    const int32_t *row(unsigned ps) const {
+      return &table[ps * row_size()];
+    }
+  };
+
+  epoch_t epoch;
+  std::map<int64_t, PoolMapping> pools;
+
+  struct Job {
+    int64_t pool;
+    unsigned begin, end;
+    Job(int64_t p, unsigned b, unsigned e) : pool(p), begin(b), end(e) {}
+  };
+  void _update_range(const OSDMap& map, const Job& job);
+  friend class OSDMapMappingWorker;
+
+public:
+  OSDMapMapping() : epoch(0) {}
+
+  epoch_t get_epoch() const {
+    return epoch;
+  }
+
+  /// map every pg of map with num_threads threads (inline if <= 1)
+  void update(const OSDMap& map, unsigned num_threads);
+
+  /// false if pgid is not in the table (unknown pool, or a raw pg)
+  bool get(pg_t pgid,
+	   std::vector<int> *up, int *up_primary,
+	   std::vector<int> *acting, int *acting_primary) const;
+
+  /// the pgs of this epoch whose up or acting set differ in other
+  void get_changed(const OSDMapMapping& other,
+		   std::set<pg_t> *changed) const;
+
+  uint64_t get_num_pgs() const;
+
+  /**
+   * per osd, the pg copies in acting sets, the pgs it comes first in
+   * and those it is primary for, in one pool or all of them (pool < 0).
+   * The vectors are resized to max_osd and added to.
+   */
+  void count_pgs(int64_t pool, int max_osd,
+		 std::vector<unsigned> *count,
+		 std::vector<unsigned> *first,
+		 std::vector<unsigned> *primary) const;
+
+  /**
+   * the pgs of pool (or of all pools if pool < 0) whose acting set
+   * differs from other's, and the pg copies that would have to move:
+   * osds in the new acting set that did not have the pg, or for an
+   * erasure pool not in that position.  pgs missing from other
+   * (new pools, splits) are not counted.
+   */
+  void count_moved(const OSDMapMapping& other, int64_t pool,
+		   uint64_t *moved_pgs, uint64_t *moved_copies) const;
+};
+
+#endif
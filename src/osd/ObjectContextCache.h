@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_OBJECTCONTEXTCACHE_H
+#define CEPH_OSD_OBJECTCONTEXTCACHE_H
+
+#include <functional>
+#include <vector>
+
+#include "common/Mutex.h"
+#include "include/unordered_map.h"
+#include "osd_types.h"
+
+/**
+ * OSD-wide cache of object contexts
+ *
+ * Each PG still finds its object contexts through its own SharedLRU;
+ * this only decides which of them stay alive once nobody uses them,
+ * across all PGs, within a byte budget.  Eviction is CLOCK: a hit sets
+ * the entry's referenced bit, and the hand clears bits until it finds
+ * an entry that was not used since its last pass.
+ *
+ * The cache is split into shards (by context address) with a share of
+ * the budget each, so that PGs on different threads rarely contend.
+ */
+class ObjectContextCache {
+  struct Entry {
+    const void *owner;  ///< the PG the context belongs to
+    ObjectContextRef obc;
+    uint64_t bytes;
+    bool referenced;
+    Entry() : owner(0), bytes(0), referenced(false) {}
+  };
+
+  struct Shard {
+    Mutex lock;
+    std::vector<Entry> ring;
+    std::vector<unsigned> free_slots;
+    ceph::unordered_map<ObjectContext*, unsigned> slot_of;
+    unsigned hand;
+    uint64_t bytes;
+    Shard() : lock("ObjectContextCache::Shard::lock"), hand(0), bytes(0) {}
+
+    void drop(unsigned slot, std::vector<ObjectContextRef> *to_release) {
+      Entry &e = ring[slot];
+      slot_of.erase(e.obc.get());
+      to_release->push_back(e.obc);
+      e.obc.reset();
+      e.owner = 0;
+      bytes -= e.bytes;
+      e.bytes = 0;
+      free_slots.push_back(slot);
+    }
+
+    void trim(uint64_t max, std::vector<ObjectContextRef> *to_release) {
+      // two sweeps clear every referenced bit, so this terminates
+      for (unsigned n = 2 * ring.size(); n > 0 && bytes > max; --n) {
+	if (hand >= ring.size())
+	  hand = 0;
+	Entry &e = ring[hand];
+	if (e.obc) {
+	  if (e.referenced)
+	    e.referenced = false;
+	  else
+	    drop(hand, to_release);
+	}
+	++hand;
+      }
+    }
+  };
+
+  std::vector<Shard*> shards;
+  uint64_t max_bytes;  ///< per shard
+
+  Shard &get_shard(ObjectContext *obc) {
+    return *shards[std::hash<ObjectContext*>()(obc) % shards.size()];
+  }
+
+public:
+  ObjectContextCache(unsigned num_shards, uint64_t max)
+    : max_bytes(0) {
+    if (num_shards == 0)
+      num_shards = 1;
+    for (unsigned i = 0; i < num_shards; ++i)
+      shards.push_back(new Shard);
+    set_max_bytes(max);
+  }
+  ~ObjectContextCache() {
+    for (unsigned i = 0; i < shards.size(); ++i)
+      delete shards[i];
+  }
+
+  bool enabled() const {
+    return max_bytes > 0;
+  }
+
+  void set_max_bytes(uint64_t max) {
+    max_bytes = max / shards.size();
+    if (max && !max_bytes)
+      max_bytes = 1;
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      std::vector<ObjectContextRef> to_release;
+      Mutex::Locker l(shards[i]->lock);
+      shards[i]->trim(max_bytes, &to_release);
+    }
+  }
+
+  uint64_t get_bytes() {
+    uint64_t r = 0;
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      Mutex::Locker l(shards[i]->lock);
+      r += shards[i]->bytes;
+    }
+    return r;
+  }
+
+  /// keep obc (owned by owner) cached; bytes is its current footprint
+  void touch(const void *owner, const ObjectContextRef &obc, uint64_t bytes) {
+    if (!enabled())
+      return;
+    // contexts we evict go after the shard lock is dropped: their
+    // destructors call back into their PGs
+    std::vector<ObjectContextRef> to_release;
+    Shard &s = get_shard(obc.get());
+    Mutex::Locker l(s.lock);
+    ceph::unordered_map<ObjectContext*, unsigned>::iterator p =
+      s.slot_of.find(obc.get());
+    if (p != s.slot_of.end()) {
+      Entry &e = s.ring[p->second];
+      e.referenced = true;
+      s.bytes += bytes;
+      s.bytes -= e.bytes;
+      e.bytes = bytes;
+    } else {
+      unsigned slot;
+      if (s.free_slots.empty()) {
+	slot = s.ring.size();
+	s.ring.push_back(Entry());
+      } else {
+	slot = s.free_slots.back();
+	s.free_slots.pop_back();
+      }
+      Entry &e = s.ring[slot];
+      e.owner = owner;
+      e.obc = obc;
+      e.bytes = bytes;
+      e.referenced = false;
+      s.slot_of[obc.get()] = slot;
+      s.bytes += bytes;
+    }
+    s.trim(max_bytes, &to_release);
+  }
+
+  /// forget everything owner has cached
+  void clear(const void *owner) {
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      std::vector<ObjectContextRef> to_release;
+      Mutex::Locker l(shards[i]->lock);
+      Shard &s = *shards[i];
+      for (unsigned slot = 0; slot < s.ring.size(); ++slot) {
+	if (s.ring[slot].obc && s.ring[slot].owner == owner)
+	  s.drop(slot, &to_release);
+      }
+    }
+  }
+};
+
+#endif
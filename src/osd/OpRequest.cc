@@ -10,7 +10,9 @@
 #include "messages/MOSDOp.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDRepOp.h"
+#include "messages/MOSDECSubOpWrite.h"
 #include "include/assert.h"
+#include "include/stringify.h"
 #include "osd/osd_types.h"
 
 #ifdef WITH_LTTNG
@@ -26,7 +28,7 @@
 OpRequest::OpRequest(Message *req, OpTracker *tracker) :
   TrackedOp(tracker, req->get_recv_stamp()),
   rmw_flags(0), request(req),
-  hit_flag_points(0), latest_flag_point(0),
+  hit_flag_points(0), latest_flag_point(0), traced(false),
   send_map_update(false), sent_epoch(0),
   hitset_inserted(false) {
   if (req->get_priority() < tracker->cct->_conf->osd_client_op_priority) {
@@ -39,7 +41,11 @@ OpRequest::OpRequest(Message *req, OpTracker *tracker) :
     reqid = static_cast<MOSDSubOp*>(req)->reqid;
   } else if (req->get_type() == MSG_OSD_REPOP) {
     reqid = static_cast<MOSDRepOp*>(req)->reqid;
+  } else if (req->get_type() == MSG_OSD_EC_WRITE) {
+    reqid = static_cast<MOSDECSubOpWrite*>(req)->op.reqid;
   }
+  if (reqid.name != entity_name_t())
+    traced = tracker->trace_log.is_sampled(reqid.name.num(), reqid.tid);
   tracker->mark_event(this, "header_read", request->get_recv_stamp());
   tracker->mark_event(this, "throttled", request->get_throttle_stamp());
   tracker->mark_event(this, "all_read", request->get_recv_complete_stamp());
@@ -58,19 +64,7 @@ void OpRequest::_dump(utime_t now, Formatter *f) const
     f->dump_unsigned("tid", m->get_tid());
     f->close_section(); // client_info
   }
-  {
-    f->open_array_section("events");
-    Mutex::Locker l(lock);
-    for (list<pair<utime_t, string> >::const_iterator i = events.begin();
-	 i != events.end();
-	 ++i) {
-      f->open_object_section("event");
-      f->dump_stream("time") << i->first;
-      f->dump_string("event", i->second);
-      f->close_section();
-    }
-    f->close_section();
-  }
+  dump_events(f);
 }
 
 void OpRequest::_dump_op_descriptor_unlocked(ostream& stream) const
@@ -79,10 +73,36 @@ void OpRequest::_dump_op_descriptor_unlocked(ostream& stream) const
 }
 
 void OpRequest::_unregistered() {
+  if (traced)
+    write_trace();
   request->clear_data();
   request->clear_payload();
 }
 
+void OpRequest::write_trace()
+{
+  OpTraceLog::events_t events;
+  events.push_back(make_pair("header_read", request->get_recv_stamp()));
+  events.push_back(make_pair("throttled", request->get_throttle_stamp()));
+  events.push_back(make_pair("all_read", request->get_recv_complete_stamp()));
+  events.push_back(make_pair("dispatched", request->get_dispatch_stamp()));
+  if (tracker->tracking_enabled)
+    get_events(&events);
+  else
+    events.push_back(make_pair("done", ceph_clock_now(tracker->cct)));
+
+  const char *role =
+    request->get_type() == CEPH_MSG_OSD_OP ? "primary" : "replica";
+  for (OpTraceLog::events_t::iterator p = events.begin();
+       p != events.end();
+       ++p) {
+    tracepoint(oprequest, trace_event, reqid.name._type,
+	       reqid.name._num, reqid.tid, reqid.inc, role, p->first,
+	       p->second.sec(), p->second.nsec());
+  }
+  tracker->trace_log.write(stringify(reqid), role, events);
+}
+
 bool OpRequest::check_rmw(int flag) {
   return rmw_flags & flag;
 }
@@ -132,7 +152,7 @@ void OpRequest::set_promote() { set_rmw_flags(CEPH_OSD_RMW_FLAG_FORCE_PROMOTE);
 void OpRequest::set_skip_handle_cache() { set_rmw_flags(CEPH_OSD_RMW_FLAG_SKIP_HANDLE_CACHE); }
 void OpRequest::set_skip_promote() { set_rmw_flags(CEPH_OSD_RMW_FLAG_SKIP_PROMOTE); }
 
-void OpRequest::mark_flag_point(uint8_t flag, const string& s) {
+void OpRequest::mark_flag_point(uint8_t flag, const char *s) {
 #ifdef WITH_LTTNG
   uint8_t old_flags = hit_flag_points;
 #endif
@@ -142,5 +162,5 @@ void OpRequest::mark_flag_point(uint8_t flag, const string& s) {
   latest_flag_point = flag;
   tracepoint(oprequest, mark_flag_point, reqid.name._type,
 	     reqid.name._num, reqid.tid, reqid.inc, rmw_flags,
-	     flag, s.c_str(), old_flags, hit_flag_points);
+	     flag, s, old_flags, hit_flag_points);
 }
@@ -96,12 +96,15 @@ private:
   static const uint8_t flag_started =     1 << 3;
   static const uint8_t flag_sub_op_sent = 1 << 4;
   static const uint8_t flag_commit_sent = 1 << 5;
+  /// picked by op_trace_sample: write our events out when we finish
+  bool traced;
 
   OpRequest(Message *req, OpTracker *tracker);
 
 protected:
   void _dump_op_descriptor_unlocked(ostream& stream) const;
   void _unregistered();
+  void write_trace();
 
 public:
   ~OpRequest() {
@@ -111,6 +114,7 @@ public:
   epoch_t sent_epoch;
   bool hitset_inserted;
   Message *get_req() const { return request; }
+  bool is_traced() const { return traced; }
   bool been_queued_for_pg() { return hit_flag_points & flag_queued_for_pg; }
   bool been_reached_pg() { return hit_flag_points & flag_reached_pg; }
   bool been_delayed() { return hit_flag_points & flag_delayed; }
@@ -143,14 +147,14 @@ public:
   void mark_reached_pg() {
     mark_flag_point(flag_reached_pg, "reached_pg");
   }
-  void mark_delayed(const string& s) {
+  void mark_delayed(const char *s) {
     mark_flag_point(flag_delayed, s);
   }
   void mark_started() {
     mark_flag_point(flag_started, "started");
   }
   void mark_sub_op_sent(const string& s) {
-    mark_flag_point(flag_sub_op_sent, s);
+    mark_flag_point(flag_sub_op_sent, intern_event_name(s));
   }
   void mark_commit_sent() {
     mark_flag_point(flag_commit_sent, "commit_sent");
@@ -171,7 +175,7 @@ public:
 
 private:
   void set_rmw_flags(int flags);
-  void mark_flag_point(uint8_t flag, const string& s);
+  void mark_flag_point(uint8_t flag, const char *s);
 };
 
 typedef OpRequest::Ref OpRequestRef;
@@ -40,6 +40,7 @@
 
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDRepOp.h"
+#include "messages/MOSDRepOpBatch.h"
 #include "messages/MOSDSubOpReply.h"
 #include "messages/MOSDRepOpReply.h"
 #include "common/BackTrace.h"
@@ -197,7 +198,7 @@ PG::PG(OSDService *o, OSDMapRef curmap,
   coll(p), pg_log(cct),
   pgmeta_oid(p.make_pgmeta_oid()),
   missing_loc(this),
-  recovery_item(this), stat_queue_item(this),
+  recovery_item(this), stat_queue_item(this), recovery_redundancy(0),
   snap_trim_queued(false),
   scrub_queued(false),
   recovery_ops_active(0),
@@ -2100,6 +2101,24 @@ unsigned PG::get_backfill_priority()
   return 1;
 }
 
+int PG::get_recovery_redundancy() const
+{
+  int complete = 0;
+  for (set<pg_shard_t>::const_iterator i = actingset.begin();
+       i != actingset.end();
+       ++i) {
+    if (*i == pg_whoami) {
+      if (pg_log.get_missing().num_missing() == 0)
+	++complete;
+      continue;
+    }
+    map<pg_shard_t, pg_missing_t>::const_iterator m = peer_missing.find(*i);
+    if (m != peer_missing.end() && m->second.num_missing() == 0)
+      ++complete;
+  }
+  return complete - (int)pool.info.min_size;
+}
+
 void PG::finish_recovery(list<Context*>& tfin)
 {
   dout(10) << "finish_recovery" << dendl;
@@ -3683,6 +3702,14 @@ int PG::build_scrub_map_chunk(
 
 
   get_pgbackend()->be_scan_list(map, ls, deep, seed, handle);
+  if (deep) {
+    uint64_t bytes = 0;
+    for (vector<hobject_t>::iterator p = ls.begin(); p != ls.end(); ++p) {
+      if (map.objects.count(*p))
+	bytes += map.objects[*p].size;
+    }
+    osd->charge_scrub_io(bytes);
+  }
   _scan_rollback_obs(rollback_obs, handle);
   _scan_snaps(map);
 
@@ -3800,14 +3827,19 @@ void PG::replica_scrub(
  */
 void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
 {
-  if (g_conf->osd_scrub_sleep > 0 &&
+  double delay = g_conf->osd_scrub_sleep;
+  if (scrubber.deep)
+    delay = MAX(delay, osd->get_scrub_io_delay());
+  if (delay > 0 &&
       (scrubber.state == PG::Scrubber::NEW_CHUNK ||
        scrubber.state == PG::Scrubber::INACTIVE)) {
     dout(20) << __func__ << " state is INACTIVE|NEW_CHUNK, sleeping" << dendl;
     unlock();
     utime_t t;
-    t.set_from_double(g_conf->osd_scrub_sleep);
+    t.set_from_double(delay);
+    handle.suspend_tp_timeout();
     t.sleep();
+    handle.reset_tp_timeout();
     lock();
     dout(20) << __func__ << " slept for " << t << dendl;
   }
@@ -5191,6 +5223,8 @@ bool PG::can_discard_request(OpRequestRef& op)
     return can_discard_replica_op<MOSDSubOp, MSG_OSD_SUBOP>(op);
   case MSG_OSD_REPOP:
     return can_discard_replica_op<MOSDRepOp, MSG_OSD_REPOP>(op);
+  case MSG_OSD_REPOP_BATCH:
+    return can_discard_replica_op<MOSDRepOpBatch, MSG_OSD_REPOP_BATCH>(op);
   case MSG_OSD_PG_PUSH:
     return can_discard_replica_op<MOSDPGPush, MSG_OSD_PG_PUSH>(op);
   case MSG_OSD_PG_PULL:
@@ -5239,6 +5273,11 @@ bool PG::op_must_wait_for_map(epoch_t cur_epoch, OpRequestRef& op)
       cur_epoch,
       static_cast<MOSDRepOp*>(op->get_req())->map_epoch);
 
+  case MSG_OSD_REPOP_BATCH:
+    return !have_same_or_newer_map(
+      cur_epoch,
+      static_cast<MOSDRepOpBatch*>(op->get_req())->map_epoch);
+
   case MSG_OSD_SUBOPREPLY:
     return !have_same_or_newer_map(
       cur_epoch,
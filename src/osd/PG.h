@@ -437,6 +437,7 @@ public:
   /* You should not use these items without taking their respective queue locks
    * (if they have one) */
   xlist<PG*>::item recovery_item, stat_queue_item;
+  int recovery_redundancy;  ///< get_recovery_redundancy() when queued
   bool snap_trim_queued;
   bool scrub_queued;
 
@@ -797,6 +798,8 @@ protected:
   Mutex pg_stats_publish_lock;
   bool pg_stats_publish_valid;
   pg_stat_t pg_stats_publish;
+  /// version of pg_stats_publish last sent to the mon; see OSD::send_pg_stats
+  pair<epoch_t, version_t> pg_stats_sent;
 
   // for ordering writes
   ceph::shared_ptr<ObjectStore::Sequencer> osr;
@@ -835,6 +838,8 @@ public:
   unsigned get_recovery_priority();
   /// get backfill reservation priority
   unsigned get_backfill_priority();
+  /// complete shards beyond those needed to serve IO; lower recovers first
+  int get_recovery_redundancy() const;
 
   void mark_clean();  ///< mark an active pg clean
 
@@ -2323,6 +2328,8 @@ public:
   virtual void on_activate() = 0;
   virtual void on_flushed() = 0;
   virtual void on_shutdown() = 0;
+  /// osd_object_context_cache_bytes or the per-pg count changed
+  virtual void on_obc_cache_change() = 0;
   virtual void check_blacklisted_watchers() = 0;
   virtual void get_watchers(std::list<obj_watch_item_t>&) = 0;
 
@@ -316,12 +316,28 @@ void PGBackend::be_scan_list(
 {
   dout(10) << __func__ << " scanning " << ls.size() << " objects"
            << (deep ? " deeply" : "") << dendl;
+  // while one object is hashed the store fetches the next few
+  unsigned ahead = 0;
+  if (deep && g_conf->osd_deep_scrub_readahead_objects > 0)
+    ahead = g_conf->osd_deep_scrub_readahead_objects;
+  for (unsigned j = 0; j < ahead && j < ls.size(); ++j)
+    store->readahead(
+      coll,
+      ghobject_t(
+	ls[j], ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+      0, 0);
   int i = 0;
   for (vector<hobject_t>::const_iterator p = ls.begin();
        p != ls.end();
        ++p, i++) {
     handle.reset_tp_timeout();
     hobject_t poid = *p;
+    if (ahead && i + ahead < ls.size())
+      store->readahead(
+	coll,
+	ghobject_t(
+	  ls[i + ahead], ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+	0, 0);
 
     struct stat st;
     int r = store->stat(
@@ -190,9 +190,19 @@
      virtual void update_stats(
        const pg_stat_t &stat) = 0;
 
+     /// primary: version up to which every shard has committed
+     virtual eversion_t get_min_last_complete_ondisk() const = 0;
+     /// replica: versions up to here may be served to balanced reads
+     virtual void update_replica_read_stable(
+       eversion_t stable) = 0;
+
      virtual void schedule_recovery_work(
        GenContext<ThreadPool::TPHandle&> *c) = 0;
 
+     /// run c with the pg locked after delay seconds, unless the pg resets
+     /// (used to send out batched repops)
+     virtual void schedule_repop_batch_flush(double delay, Context *c) = 0;
+
      virtual pg_shard_t whoami_shard() const = 0;
      int whoami() const {
        return whoami_shard().osd;
@@ -433,6 +443,11 @@
        uint64_t off,
        uint64_t len
        ) { assert(0); }
+     /// keep a copy of hoid as former_version, to roll back to
+     virtual void stash_copy(
+       const hobject_t &hoid,   ///< [in] obj to copy
+       version_t former_version ///< [in] former object version
+       ) { assert(0); }
 
      /// Supported on all backends
 
@@ -541,6 +556,31 @@
      uint32_t op_flags,
      bufferlist *bl) = 0;
 
+   /// like objects_read_sync, but into caller supplied memory (len > 0)
+   virtual int objects_read_sync_into(
+     const hobject_t &hoid,
+     uint64_t off,
+     uint64_t len,
+     uint32_t op_flags,
+     bufferptr &bp) {
+     bufferlist bl;
+     int r = objects_read_sync(hoid, off, len, op_flags, &bl);
+     if (r > 0)
+       bl.copy(0, r, bp.c_str());
+     return r;
+   }
+
+   /// the data extents of off~len and their contents, see ObjectStore::sparse_read
+   virtual int objects_sparse_read(
+     const hobject_t &hoid,
+     uint64_t off,
+     uint64_t len,
+     uint32_t op_flags,
+     map<uint64_t, uint64_t> *m,
+     bufferlist *bl) {
+     return -EOPNOTSUPP;
+   }
+
    virtual void objects_read_async(
      const hobject_t &hoid,
      const list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
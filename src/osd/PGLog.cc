@@ -150,6 +150,8 @@ void PGLog::clear() {
   missing.clear();
   log.clear();
   log_keys_debug.clear();
+  // whatever is on disk no longer matches; rewrite it on the next write
+  extents.clear();
   undirty();
 }
 
@@ -374,8 +376,7 @@ void PGLog::_merge_object_divergent_entries(
 	   << " last_divergent_update: " << last_divergent_update
 	   << dendl;
 
-  ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-    log.objects.find(hoid);
+  IndexedLog::objects_t::const_iterator objiter = log.objects.find(hoid);
   if (objiter != log.objects.end() &&
       objiter->second->version >= first_divergent_update) {
     /// Case 1)
@@ -741,6 +742,23 @@ void PGLog::write_log(
   map<string,bufferlist> *km,
   const coll_t& coll, const ghobject_t &log_oid)
 {
+  bool append_only = cct && cct->_conf->osd_pg_log_append_only;
+  if (append_only != extents.in_data) {
+    dout(5) << "write_log converting log to "
+	    << (append_only ? "append-only data" : "omap keys") << dendl;
+    if (extents.in_data) {
+      t.truncate(coll, log_oid, 0);
+      set<string> keys;
+      keys.insert("log_data_extent");
+      t.omap_rmkeys(coll, log_oid, keys);
+      extents.clear();
+    }
+    // nothing of the old format is worth keeping track of
+    trimmed.clear();
+    log_keys_debug.clear();
+    mark_dirty_to(eversion_t::max());
+    mark_dirty_from(eversion_t());
+  }
   if (is_dirty()) {
     dout(5) << "write_log with: "
 	     << "dirty_to: " << dirty_to
@@ -759,7 +777,8 @@ void PGLog::write_log(
       trimmed,
       dirty_divergent_priors,
       !touched_log,
-      (pg_log_debug ? &log_keys_debug : 0));
+      (pg_log_debug ? &log_keys_debug : 0),
+      (append_only ? &extents : 0));
     undirty();
   } else {
     dout(10) << "log is not dirty" << dendl;
@@ -792,9 +811,29 @@ void PGLog::_write_log(
   const set<eversion_t> &trimmed,
   bool dirty_divergent_priors,
   bool touch_log,
-  set<string> *log_keys_debug
+  set<string> *log_keys_debug,
+  LogExtents *extents
   )
 {
+  if (extents) {
+    if (touch_log)
+      t.touch(coll, log_oid);
+    if (!extents->in_data && dirty_to != eversion_t()) {
+      // drop the entries kept as omap keys so far
+      t.omap_rmkeyrange(
+	coll, log_oid,
+	eversion_t().get_key_name(), dirty_to.get_key_name());
+    }
+    _write_log_extents(t, km, log, coll, log_oid, dirty_to,
+		       MIN(dirty_from, writeout_from), trimmed,
+		       log_keys_debug, extents);
+    if (dirty_divergent_priors)
+      ::encode(divergent_priors, (*km)["divergent_priors"]);
+    ::encode(log.can_rollback_to, (*km)["can_rollback_to"]);
+    ::encode(log.rollback_info_trimmed_to, (*km)["rollback_info_trimmed_to"]);
+    return;
+  }
+
   set<string> to_remove;
   for (set<eversion_t>::const_iterator i = trimmed.begin();
        i != trimmed.end();
@@ -863,6 +902,86 @@ void PGLog::_write_log(
     t.omap_rmkeys(coll, log_oid, to_remove);
 }
 
+void PGLog::_write_log_extents(
+  ObjectStore::Transaction& t,
+  map<string,bufferlist> *km,
+  pg_log_t &log,
+  const coll_t& coll, const ghobject_t &log_oid,
+  eversion_t dirty_to,
+  eversion_t from,
+  const set<eversion_t> &trimmed,
+  set<string> *log_keys_debug,
+  LogExtents *extents)
+{
+  // entries before 'from' are on disk as they are; anything at or after
+  // it has to be (re)appended.  entries are only ever added in front by
+  // merge_log, which marks dirty_to; that needs a full rewrite.
+  bool rewrite = !extents->in_data || dirty_to != eversion_t();
+  if (!rewrite) {
+    for (set<eversion_t>::const_iterator i = trimmed.begin();
+	 i != trimmed.end();
+	 ++i)
+      extents->offsets.erase(*i);
+    uint64_t start = extents->offsets.empty() ?
+      extents->end : extents->offsets.begin()->second;
+    if (start >= extents->compact_bytes &&
+	start >= extents->end - start) {
+      generic_dout(10) << "write_log compacting, " << start
+		       << " trimmed bytes, " << (extents->end - start)
+		       << " live" << dendl;
+      rewrite = true;
+    }
+  }
+
+  if (rewrite) {
+    t.truncate(coll, log_oid, 0);
+    extents->offsets.clear();
+    extents->in_data = true;
+    extents->end = 0;
+    from = eversion_t();
+  } else {
+    // cut off the divergent tail
+    map<eversion_t, uint64_t>::iterator p = extents->offsets.lower_bound(from);
+    if (p != extents->offsets.end()) {
+      extents->end = p->second;
+      extents->offsets.erase(p, extents->offsets.end());
+      t.truncate(coll, log_oid, extents->end);
+    }
+  }
+
+  list<pg_log_entry_t>::iterator p = log.log.end();
+  while (p != log.log.begin()) {
+    --p;
+    if (p->version < from) {
+      ++p;
+      break;
+    }
+  }
+  bufferlist bl;
+  for (; p != log.log.end(); ++p) {
+    extents->offsets[p->version] = extents->end + bl.length();
+    p->encode_with_checksum(bl);
+  }
+  if (bl.length()) {
+    t.write(coll, log_oid, extents->end, bl.length(), bl);
+    extents->end += bl.length();
+  }
+  extents->start = extents->offsets.empty() ?
+    extents->end : extents->offsets.begin()->second;
+
+  bufferlist& ebl = (*km)["log_data_extent"];
+  ::encode(extents->start, ebl);
+  ::encode(extents->end, ebl);
+
+  if (log_keys_debug) {
+    log_keys_debug->clear();
+    for (map<eversion_t, uint64_t>::iterator i = extents->offsets.begin();
+	 i != extents->offsets.end();
+	 ++i)
+      log_keys_debug->insert(i->first.get_key_name());
+  }
+}
+
 void PGLog::read_log(ObjectStore *store, coll_t pg_coll,
 		     coll_t log_coll,
 		    ghobject_t log_oid,
@@ -871,15 +990,16 @@ void PGLog::read_log(ObjectStore *store, coll_t pg_coll,
 		    IndexedLog &log,
 		    pg_missing_t &missing,
 		    ostringstream &oss,
-		    set<string> *log_keys_debug)
+		    set<string> *log_keys_debug,
+		    LogExtents *extents)
 {
   dout(20) << "read_log coll " << pg_coll << " log_oid " << log_oid << dendl;
 
-  // legacy?
   struct stat st;
   int r = store->stat(log_coll, log_oid, &st);
   assert(r == 0);
-  assert(st.st_size == 0);
+  bool in_data = false;
+  uint64_t start = 0, end = 0;
 
   log.tail = info.log_tail;
   // will get overridden below if it had been recorded
@@ -904,6 +1024,10 @@ void PGLog::read_log(ObjectStore *store, coll_t pg_coll,
 	bufferlist bl = p->value();
 	bufferlist::iterator bp = bl.begin();
 	::decode(log.rollback_info_trimmed_to, bp);
+      } else if (p->key() == "log_data_extent") {
+	::decode(start, bp);
+	::decode(end, bp);
+	in_data = true;
       } else {
 	pg_log_entry_t e;
 	e.decode_with_checksum(bp);
@@ -920,6 +1044,43 @@ void PGLog::read_log(ObjectStore *store, coll_t pg_coll,
       }
     }
   }
+  if (in_data) {
+    // append-only log: one sequential read
+    dout(10) << "read_log entries in data [" << start << "," << end << ")"
+	     << dendl;
+    assert(st.st_size == (off_t)end);
+    if (extents) {
+      extents->clear();
+      extents->in_data = true;
+      extents->start = start;
+      extents->end = end;
+    }
+    bufferlist bl;
+    if (end > start) {
+      r = store->read(log_coll, log_oid, start, end - start, bl);
+      assert(r == (int)(end - start));
+    }
+    bufferlist::iterator bp = bl.begin();
+    while (!bp.end()) {
+      uint64_t off = start + bp.get_off();
+      pg_log_entry_t e;
+      e.decode_with_checksum(bp);
+      dout(20) << "read_log " << e << dendl;
+      if (!log.log.empty()) {
+	pg_log_entry_t last_e(log.log.back());
+	assert(last_e.version.version < e.version.version);
+	assert(last_e.version.epoch <= e.version.epoch);
+      }
+      log.log.push_back(e);
+      if (extents)
+	extents->offsets[e.version] = off;
+      if (log_keys_debug)
+	log_keys_debug->insert(e.get_key_name());
+    }
+  } else {
+    // legacy?
+    assert(st.st_size == 0);
+  }
   log.head = info.last_update;
   log.index();
 
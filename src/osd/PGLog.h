@@ -22,6 +22,7 @@
 #include "osd_types.h"
 #include "os/ObjectStore.h"
 #include "common/ceph_context.h"
+#include "include/mempool.h"
 #include <list>
 using namespace std;
 
@@ -55,9 +56,12 @@ struct PGLog {
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
-    ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
+    typedef mempool::osd_pglog::unordered_map<hobject_t,pg_log_entry_t*> objects_t;
+    typedef mempool::osd_pglog::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops_t;
+    typedef mempool::osd_pglog::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops_t;
+    objects_t objects;  // ptrs into log.  be careful!
+    caller_ops_t caller_ops;
+    extra_caller_ops_t extra_caller_ops;
 
     // recovery pointers
     list<pg_log_entry_t>::iterator complete_to;  // not inclusive of referenced item
@@ -132,7 +136,7 @@ struct PGLog {
       version_t *user_version) const {
       assert(replay_version);
       assert(user_version);
-      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>::const_iterator p;
+      caller_ops_t::const_iterator p;
       p = caller_ops.find(r);
       if (p != caller_ops.end()) {
 	*replay_version = p->second->version;
@@ -242,8 +246,7 @@ struct PGLog {
 	     e.extra_reqids.begin();
 	   j != e.extra_reqids.end();
 	   ++j) {
-	for (ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*>::iterator k =
-	       extra_caller_ops.find(j->first);
+	for (extra_caller_ops_t::iterator k = extra_caller_ops.find(j->first);
 	     k != extra_caller_ops.end() && k->first == j->first;
 	     ++k) {
 	  if (k->second == &e) {
@@ -308,6 +311,29 @@ protected:
   eversion_t dirty_from;       ///< must clear/writeout all keys >= dirty_from
   eversion_t writeout_from;    ///< must writout keys >= writeout_from
   set<eversion_t> trimmed;     ///< must clear keys in trimmed
+
+  /**
+   * Where the entries live when the log is append-only
+   * (osd_pg_log_append_only): one after the other in the log object's
+   * data, in [start, end).  Trimming moves start forward, rewinding a
+   * divergent tail truncates, and once the dead prefix outgrows the live
+   * part the whole log is rewritten from offset 0.
+   */
+  struct LogExtents {
+    bool in_data;       ///< entries are in the object data, not omap
+    uint64_t start;     ///< offset of the oldest live entry
+    uint64_t end;       ///< end of the last entry (and of the data)
+    uint64_t compact_bytes; ///< min dead prefix worth rewriting for
+    map<eversion_t, uint64_t> offsets; ///< entry version -> offset
+    LogExtents() : in_data(false), start(0), end(0), compact_bytes(0) {}
+    void clear() {
+      in_data = false;
+      start = end = 0;
+      offsets.clear();
+    }
+  };
+  LogExtents extents;
+
   CephContext *cct;
   bool pg_log_debug;
   /// Log is clean on [dirty_to, dirty_from)
@@ -379,7 +405,9 @@ public:
     writeout_from(eversion_t::max()), 
     cct(cct), 
     pg_log_debug(!(cct && !(cct->_conf->osd_debug_pg_log_writeout))),
-    touched_log(false), dirty_divergent_priors(false) {}
+    touched_log(false), dirty_divergent_priors(false) {
+    extents.compact_bytes = cct ? cct->_conf->osd_pg_log_compact_bytes : 0;
+  }
 
 
   void reset_backfill();
@@ -668,16 +696,28 @@ public:
     const set<eversion_t> &trimmed,
     bool dirty_divergent_priors,
     bool touch_log,
-    set<string> *log_keys_debug
+    set<string> *log_keys_debug,
+    LogExtents *extents = 0 ///< append to the object data if set
     );
 
+  static void _write_log_extents(
+    ObjectStore::Transaction& t,
+    map<string,bufferlist>* km,
+    pg_log_t &log,
+    const coll_t& coll, const ghobject_t &log_oid,
+    eversion_t dirty_to,
+    eversion_t from,
+    const set<eversion_t> &trimmed,
+    set<string> *log_keys_debug,
+    LogExtents *extents);
+
   void read_log(ObjectStore *store, coll_t pg_coll,
 		coll_t log_coll, ghobject_t log_oid,
 		const pg_info_t &info, ostringstream &oss) {
     return read_log(
       store, pg_coll, log_coll, log_oid, info, divergent_priors,
       log, missing, oss,
-      (pg_log_debug ? &log_keys_debug : 0));
+      (pg_log_debug ? &log_keys_debug : 0), &extents);
   }
 
   static void read_log(ObjectStore *store, coll_t pg_coll,
@@ -685,7 +725,8 @@ public:
     const pg_info_t &info, map<eversion_t, hobject_t> &divergent_priors,
     IndexedLog &log,
     pg_missing_t &missing, ostringstream &oss,
-    set<string> *log_keys_debug = 0
+    set<string> *log_keys_debug = 0,
+    LogExtents *extents = 0 ///< filled in if the log is append-only
     );
 };
   
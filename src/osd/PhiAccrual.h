@@ -0,0 +1,93 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_PHIACCRUAL_H
+#define CEPH_OSD_PHIACCRUAL_H
+
+#include <math.h>
+
+#include "include/utime.h"
+
+/**
+ * Phi accrual failure detector for one heartbeat stream
+ *
+ * Keeps the mean and variance of the last WINDOW intervals between
+ * heartbeats, and turns the time since the last one into phi =
+ * -log10(P(an interval this long)), taking intervals to be normally
+ * distributed.  phi 1 means a 10% chance that the peer is merely late,
+ * phi 3 a 0.1% chance, and so on; the threshold is a confidence level
+ * rather than a timeout, and follows whatever interval and jitter the
+ * stream actually has.
+ */
+class PhiAccrualDetector {
+public:
+  static const unsigned WINDOW = 64;
+  static const unsigned MIN_SAMPLES = 8;
+
+private:
+  double intervals[WINDOW];
+  unsigned num, next;
+  double sum, sum_sq;
+  utime_t last;
+
+public:
+  PhiAccrualDetector() : num(0), next(0), sum(0), sum_sq(0) {}
+
+  utime_t get_last() const {
+    return last;
+  }
+  unsigned get_num_samples() const {
+    return num;
+  }
+  double get_mean() const {
+    return num ? sum / num : 0;
+  }
+
+  /// a heartbeat arrived at now
+  void add(utime_t now) {
+    if (last != utime_t() && now > last) {
+      double i = now - last;
+      if (num == WINDOW) {
+	sum -= intervals[next];
+	sum_sq -= intervals[next] * intervals[next];
+      } else {
+	++num;
+      }
+      intervals[next] = i;
+      next = (next + 1) % WINDOW;
+      sum += i;
+      sum_sq += i * i;
+    }
+    last = now;
+  }
+
+  /// suspicion level at now; 0 until MIN_SAMPLES intervals were seen
+  double phi(utime_t now) const {
+    if (num < MIN_SAMPLES || now <= last)
+      return 0;
+    double mean = sum / num;
+    double var = sum_sq / num - mean * mean;
+    // perfectly regular streams would otherwise make any delay fatal
+    double sd = var > 0 ? sqrt(var) : 0;
+    if (sd < mean / 10)
+      sd = mean / 10;
+    if (sd <= 0)
+      return 0;
+    double t = now - last;
+    double p = 0.5 * erfc((t - mean) / (sd * M_SQRT2));
+    if (p < 1e-300)
+      p = 1e-300;
+    return -log10(p);
+  }
+};
+
+#endif
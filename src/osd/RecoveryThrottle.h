@@ -0,0 +1,130 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_RECOVERYTHROTTLE_H
+#define CEPH_OSD_RECOVERYTHROTTLE_H
+
+#include "include/atomic.h"
+#include "include/utime.h"
+
+/**
+ * Recovery concurrency driven by client latency
+ *
+ * Client op latencies go into a log2 histogram (microseconds) with
+ * one atomic counter per bucket, so recording costs an increment.
+ * Every adjustment interval the 99th percentile of what came in since
+ * the last one is compared with the target: above it, the number of
+ * recovery ops allowed is halved; comfortably below it, the limit
+ * grows by one.  The limit stays within [min, max], max being
+ * osd_recovery_max_active.
+ *
+ * With no target, the limit is simply max.
+ */
+class RecoveryThrottle {
+public:
+  static const unsigned NUM_BUCKETS = 32;
+
+private:
+  atomic_t buckets[NUM_BUCKETS];
+  unsigned last[NUM_BUCKETS];
+  atomic_t limit;
+  utime_t last_adjust;
+  double last_p99;
+
+  static unsigned bucket_of(double latency) {
+    uint64_t us = latency > 0 ? (uint64_t)(latency * 1000000.0) : 0;
+    unsigned b = 0;
+    while (us > 1 && b < NUM_BUCKETS - 1) {
+      us >>= 1;
+      ++b;
+    }
+    return b;
+  }
+
+public:
+  RecoveryThrottle(int initial) : limit(initial), last_p99(0) {
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+      last[i] = 0;
+  }
+
+  void record_client_latency(double latency) {
+    buckets[bucket_of(latency)].inc();
+  }
+
+  int get_limit() const {
+    return limit.read();
+  }
+
+  /// p99 (upper bound of its bucket, seconds) at the last adjustment
+  double get_last_p99() const {
+    return last_p99;
+  }
+
+  /**
+   * Recompute the limit if interval has passed since the last time
+   *
+   * Single caller (the OSD tick).  Returns true if it was recomputed.
+   */
+  bool adjust(utime_t now, double interval, double target,
+	      int min_active, int max_active, unsigned min_samples) {
+    if (min_active < 1)
+      min_active = 1;
+    if (max_active < min_active)
+      max_active = min_active;
+    if (target <= 0) {
+      limit.set(max_active);
+      return false;
+    }
+    if (last_adjust != utime_t() && (double)(now - last_adjust) < interval)
+      return false;
+    last_adjust = now;
+
+    // what came in since the last adjustment
+    unsigned delta[NUM_BUCKETS];
+    uint64_t total = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+      unsigned v = buckets[i].read();
+      delta[i] = v - last[i];
+      last[i] = v;
+      total += delta[i];
+    }
+
+    int cur = limit.read();
+    if (total < min_samples) {
+      // too little client load to tell; recovery may go faster
+      last_p99 = 0;
+      cur = cur + 1;
+    } else {
+      uint64_t rank = total - total / 100;
+      uint64_t seen = 0;
+      unsigned b = 0;
+      for (; b < NUM_BUCKETS; ++b) {
+	seen += delta[b];
+	if (seen >= rank)
+	  break;
+      }
+      last_p99 = (double)(1ull << (b + 1)) / 1000000.0;
+      if (last_p99 > target)
+	cur = cur / 2;
+      else if (last_p99 * 2 <= target)
+	cur = cur + 1;
+    }
+    if (cur < min_active)
+      cur = min_active;
+    if (cur > max_active)
+      cur = max_active;
+    limit.set(cur);
+    return true;
+  }
+};
+
+#endif
@@ -12,10 +12,12 @@
  *
  */
 #include "common/errno.h"
+#include "include/atomic.h"
 #include "ReplicatedBackend.h"
 #include "messages/MOSDOp.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDRepOp.h"
+#include "messages/MOSDRepOpBatch.h"
 #include "messages/MOSDSubOpReply.h"
 #include "messages/MOSDRepOpReply.h"
 #include "messages/MOSDPGPush.h"
@@ -32,7 +34,8 @@ static ostream& _prefix(std::ostream *_dout, ReplicatedBackend *pgb) {
 
 static void log_subop_stats(
   PerfCounters *logger,
-  OpRequestRef op, int subop)
+  OpRequestRef op, int subop,
+  Message *req = NULL)  ///< the sub op, if op->get_req() is a batch
 {
   utime_t now = ceph_clock_now(g_ceph_context);
   utime_t latency = now;
@@ -44,7 +47,7 @@ static void log_subop_stats(
   logger->inc(subop);
 
   if (subop != l_osd_sop_pull) {
-    uint64_t inb = op->get_req()->get_data().length();
+    uint64_t inb = (req ? req : op->get_req())->get_data().length();
     logger->inc(l_osd_sop_inb, inb);
     if (subop == l_osd_sop_w) {
       logger->inc(l_osd_sop_w_inb, inb);
@@ -65,7 +68,13 @@ ReplicatedBackend::ReplicatedBackend(
   ObjectStore *store,
   CephContext *cct) :
   PGBackend(pg, store, coll),
-  cct(cct) {}
+  cct(cct),
+  repop_batch_flush_scheduled(false) {}
+
+ReplicatedBackend::~ReplicatedBackend()
+{
+  clear_repop_batches();
+}
 
 void ReplicatedBackend::run_recovery_op(
   PGBackend::RecoveryHandle *_h,
@@ -192,7 +201,8 @@ bool ReplicatedBackend::handle_message(
     break;
   }
 
-  case MSG_OSD_REPOP: {
+  case MSG_OSD_REPOP:
+  case MSG_OSD_REPOP_BATCH: {
     sub_op_modify(op);
     return true;
   }
@@ -245,6 +255,8 @@ void ReplicatedBackend::on_change()
     if (i->second.on_applied)
       delete i->second.on_applied;
   }
+  // the ops they belong to are gone; replicas would drop them anyway
+  clear_repop_batches();
   clear_recovery_state();
 }
 
@@ -259,7 +271,31 @@ int ReplicatedBackend::objects_read_sync(
   uint32_t op_flags,
   bufferlist *bl)
 {
-  return store->read(coll, ghobject_t(hoid), off, len, *bl, op_flags);
+  return store->read(coll, ghobject_t(hoid), off, len, *bl, op_flags,
+		     cct->_conf->osd_repair_on_read_error);
+}
+
+int ReplicatedBackend::objects_read_sync_into(
+  const hobject_t &hoid,
+  uint64_t off,
+  uint64_t len,
+  uint32_t op_flags,
+  bufferptr &bp)
+{
+  return store->read_into(coll, ghobject_t(hoid), off, len, bp, op_flags,
+			  cct->_conf->osd_repair_on_read_error);
+}
+
+int ReplicatedBackend::objects_sparse_read(
+  const hobject_t &hoid,
+  uint64_t off,
+  uint64_t len,
+  uint32_t op_flags,
+  map<uint64_t, uint64_t> *m,
+  bufferlist *bl)
+{
+  return store->sparse_read(coll, ghobject_t(hoid), off, len, *m, *bl,
+			    op_flags, cct->_conf->osd_repair_on_read_error);
 }
 
 struct AsyncReadCallback : public GenContext<ThreadPool::TPHandle&> {
@@ -274,6 +310,65 @@ struct AsyncReadCallback : public GenContext<ThreadPool::TPHandle&> {
     delete c;
   }
 };
+/**
+ * The extents of one objects_read_async() call
+ *
+ * The store fills in our own bufferlists from its threads; only once
+ * the last extent is in do we go back to the pg (blessed, so nothing
+ * is touched if the pg was reset meanwhile) to hand the data to the
+ * caller and run its callbacks in order.
+ */
+struct AsyncReadState : public GenContext<ThreadPool::TPHandle&> {
+  struct Extent {
+    bufferlist bl;
+    int r;
+    bufferlist *out;
+    Context *c;
+    Extent() : r(0), out(NULL), c(NULL) {}
+  };
+  vector<Extent> extents;
+  Context *on_complete;
+  atomic_t pending;
+  PGBackend::Listener *parent;
+  GenContext<ThreadPool::TPHandle&> *blessed;
+
+  AsyncReadState(unsigned n, Context *c, PGBackend::Listener *p)
+    : extents(n), on_complete(c), pending(n), parent(p), blessed(NULL) {}
+  ~AsyncReadState() {
+    for (unsigned i = 0; i < extents.size(); ++i)
+      delete extents[i].c;
+    delete on_complete;
+  }
+  void extent_done(unsigned i, int r) {
+    extents[i].r = r;
+    if (pending.dec() == 0)
+      parent->schedule_recovery_work(blessed);
+  }
+  void finish(ThreadPool::TPHandle&) {
+    int r = 0;
+    for (unsigned i = 0; i < extents.size(); ++i) {
+      extents[i].out->claim_append(extents[i].bl);
+      if (extents[i].c) {
+	extents[i].c->complete(extents[i].r);
+	extents[i].c = NULL;
+      }
+      if (extents[i].r < 0 && r == 0)
+	r = extents[i].r;
+    }
+    on_complete->complete(r);
+    on_complete = NULL;
+  }
+};
+
+struct C_AsyncReadExtent : public Context {
+  AsyncReadState *state;
+  unsigned i;
+  C_AsyncReadExtent(AsyncReadState *s, unsigned i) : state(s), i(i) {}
+  void finish(int r) {
+    state->extent_done(i, r);
+  }
+};
+
 void ReplicatedBackend::objects_read_async(
   const hobject_t &hoid,
   const list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
@@ -284,26 +379,36 @@ void ReplicatedBackend::objects_read_async(
   // There is no fast read implementation for replication backend yet
   assert(!fast_read);
 
-  int r = 0;
+  if (to_read.empty()) {
+    get_parent()->schedule_recovery_work(
+      get_parent()->bless_gencontext(
+	new AsyncReadCallback(0, on_complete)));
+    return;
+  }
+
+  AsyncReadState *state = new AsyncReadState(to_read.size(), on_complete,
+					     get_parent());
+  state->blessed = get_parent()->bless_gencontext(state);
+  unsigned n = 0;
   for (list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
 		 pair<bufferlist*, Context*> > >::const_iterator i =
 	   to_read.begin();
-       i != to_read.end() && r >= 0;
-       ++i) {
-    int _r = store->read(coll, ghobject_t(hoid), i->first.get<0>(),
-			 i->first.get<1>(), *(i->second.first),
-			 i->first.get<2>());
-    if (i->second.second) {
-      get_parent()->schedule_recovery_work(
-	get_parent()->bless_gencontext(
-	  new AsyncReadCallback(_r, i->second.second)));
-    }
-    if (_r < 0)
-      r = _r;
+       i != to_read.end();
+       ++i, ++n) {
+    state->extents[n].out = i->second.first;
+    state->extents[n].c = i->second.second;
+  }
+  // the last completion may free state; do not touch it after the loop
+  n = 0;
+  for (list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
+		 pair<bufferlist*, Context*> > >::const_iterator i =
+	   to_read.begin();
+       i != to_read.end();
+       ++i, ++n) {
+    store->read_async(coll, ghobject_t(hoid), i->first.get<0>(),
+		      i->first.get<1>(), &state->extents[n].bl,
+		      i->first.get<2>(), new C_AsyncReadExtent(state, n));
   }
-  get_parent()->schedule_recovery_work(
-    get_parent()->bless_gencontext(
-      new AsyncReadCallback(r, on_complete)));
 }
 
 
@@ -1050,6 +1155,9 @@ void ReplicatedBackend::issue_op(
     if (op->op)
       op->op->mark_sub_op_sent(ss.str());
   }
+  uint64_t min_features = parent->min_peer_features();
+  bool batch = cct->_conf->osd_repop_batch_window_us > 0 &&
+    (min_features & CEPH_FEATURE_OSD_REPOP_BATCH);
   for (set<pg_shard_t>::const_iterator i =
 	 parent->get_actingbackfill_shards().begin();
        i != parent->get_actingbackfill_shards().end();
@@ -1059,7 +1167,6 @@ void ReplicatedBackend::issue_op(
     const pg_info_t &pinfo = parent->get_shard_info().find(peer)->second;
 
     Message *wr;
-    uint64_t min_features = parent->min_peer_features();
     if (!(min_features & CEPH_FEATURE_OSD_REPOP)) {
       dout(20) << "Talking to old version of OSD, doesn't support RepOp, fall back to SubOp" << dendl;
       wr = generate_subop<MOSDSubOp, MSG_OSD_SUBOP>(
@@ -1093,30 +1200,108 @@ void ReplicatedBackend::issue_op(
 	    op_t,
 	    peer,
 	    pinfo);
+      static_cast<MOSDRepOp*>(wr)->pg_committed_to =
+	parent->get_min_last_complete_ondisk();
+      if (batch) {
+	queue_repop(peer, static_cast<MOSDRepOp*>(wr));
+	continue;
+      }
     }
 
+    // don't overtake repops still held back (batching was just disabled)
+    if (!repop_batches.empty())
+      send_repop_batch(peer);
     get_parent()->send_message_osd_cluster(
       peer.osd, wr, get_osdmap()->get_epoch());
   }
 }
 
+void ReplicatedBackend::queue_repop(pg_shard_t peer, MOSDRepOp *m)
+{
+  vector<MOSDRepOp*> &ops = repop_batches[peer];
+  ops.push_back(m);
+  if ((int)ops.size() >= cct->_conf->osd_repop_batch_max_ops) {
+    send_repop_batch(peer);
+    return;
+  }
+  if (!repop_batch_flush_scheduled) {
+    repop_batch_flush_scheduled = true;
+    parent->schedule_repop_batch_flush(
+      (double)cct->_conf->osd_repop_batch_window_us / 1000000.0,
+      new C_FlushRepopBatches(this));
+  }
+}
+
+void ReplicatedBackend::send_repop_batch(pg_shard_t peer)
+{
+  map<pg_shard_t, vector<MOSDRepOp*> >::iterator p = repop_batches.find(peer);
+  if (p == repop_batches.end())
+    return;
+  Message *m;
+  if (p->second.size() == 1) {
+    m = p->second.front();
+  } else {
+    m = new MOSDRepOpBatch(spg_t(get_info().pgid.pgid, peer.shard), p->second);
+  }
+  dout(20) << __func__ << " to " << peer << " " << *m << dendl;
+  repop_batches.erase(p);
+  get_parent()->send_message_osd_cluster(
+    peer.osd, m, get_osdmap()->get_epoch());
+}
+
+void ReplicatedBackend::flush_repop_batches()
+{
+  while (!repop_batches.empty())
+    send_repop_batch(repop_batches.begin()->first);
+}
+
+void ReplicatedBackend::clear_repop_batches()
+{
+  for (map<pg_shard_t, vector<MOSDRepOp*> >::iterator p = repop_batches.begin();
+       p != repop_batches.end();
+       ++p) {
+    for (vector<MOSDRepOp*>::iterator q = p->second.begin();
+	 q != p->second.end();
+	 ++q)
+      (*q)->put();
+  }
+  repop_batches.clear();
+  repop_batch_flush_scheduled = false;
+}
+
 // sub op modify
 void ReplicatedBackend::sub_op_modify(OpRequestRef op) {
   Message *m = op->get_req();
   int msg_type = m->get_type();
+  list<ObjectStore::Transaction*> tls;
   if (msg_type == MSG_OSD_SUBOP) {
-    sub_op_modify_impl<MOSDSubOp, MSG_OSD_SUBOP>(op);
+    sub_op_modify_impl<MOSDSubOp, MSG_OSD_SUBOP>(
+      op, static_cast<MOSDSubOp*>(m), tls);
   } else if (msg_type == MSG_OSD_REPOP) {
-    sub_op_modify_impl<MOSDRepOp, MSG_OSD_REPOP>(op);
+    MOSDRepOp *r = static_cast<MOSDRepOp*>(m);
+    sub_op_modify_impl<MOSDRepOp, MSG_OSD_REPOP>(op, r, tls);
+    parent->update_replica_read_stable(r->pg_committed_to);
+  } else if (msg_type == MSG_OSD_REPOP_BATCH) {
+    // apply the batch in order, as one submission
+    MOSDRepOpBatch *b = static_cast<MOSDRepOpBatch*>(m);
+    dout(10) << "sub_op_modify " << *b << dendl;
+    for (vector<MOSDRepOp*>::iterator p = b->ops.begin();
+	 p != b->ops.end();
+	 ++p) {
+      sub_op_modify_impl<MOSDRepOp, MSG_OSD_REPOP>(op, *p, tls);
+      parent->update_replica_read_stable((*p)->pg_committed_to);
+    }
   } else {
     assert(0);
   }
+  parent->queue_transactions(tls, op);
+  // op is cleaned up by oncommit/onapply when both are executed
 }
 
 template<typename T, int MSGTYPE>
-void ReplicatedBackend::sub_op_modify_impl(OpRequestRef op)
+void ReplicatedBackend::sub_op_modify_impl(
+  OpRequestRef op, T *m, list<ObjectStore::Transaction*> &tls)
 {
-  T *m = static_cast<T *>(op->get_req());
   int msg_type = m->get_type();
   assert(MSGTYPE == msg_type);
   assert(msg_type == MSG_OSD_SUBOP || msg_type == MSG_OSD_REPOP);
@@ -1136,12 +1321,14 @@ void ReplicatedBackend::sub_op_modify_impl(OpRequestRef op)
   // we better not be missing this.
   assert(!parent->get_log().get_missing().is_missing(soid));
 
-  int ackerosd = m->get_source().num();
+  // a batched repop carries no source of its own
+  int ackerosd = op->get_req()->get_source().num();
 
   op->mark_started();
 
   RepModifyRef rm(new RepModify);
   rm->op = op;
+  rm->req = m;
   rm->ackerosd = ackerosd;
   rm->last_complete = get_info().last_complete;
   rm->epoch_started = get_osdmap()->get_epoch();
@@ -1199,11 +1386,8 @@ void ReplicatedBackend::sub_op_modify_impl(OpRequestRef op)
   rm->localt.register_on_applied(
     parent->bless_context(
       new C_OSD_RepModifyApply(this, rm)));
-  list<ObjectStore::Transaction*> tls;
   tls.push_back(&(rm->localt));
   tls.push_back(&(rm->opt));
-  parent->queue_transactions(tls, op);
-  // op is cleaned up by oncommit/onapply when both are executed
 }
 
 void ReplicatedBackend::sub_op_modify_applied(RepModifyRef rm)
@@ -1212,8 +1396,8 @@ void ReplicatedBackend::sub_op_modify_applied(RepModifyRef rm)
   rm->applied = true;
 
   dout(10) << "sub_op_modify_applied on " << rm << " op "
-	   << *rm->op->get_req() << dendl;
-  Message *m = rm->op->get_req();
+	   << *rm->req << dendl;
+  Message *m = rm->req;
 
   Message *ack = NULL;
   eversion_t version;
@@ -1253,14 +1437,14 @@ void ReplicatedBackend::sub_op_modify_commit(RepModifyRef rm)
   rm->committed = true;
 
   // send commit.
-  dout(10) << "sub_op_modify_commit on op " << *rm->op->get_req()
+  dout(10) << "sub_op_modify_commit on op " << *rm->req
 	   << ", sending commit to osd." << rm->ackerosd
 	   << dendl;
 
   assert(get_osdmap()->is_up(rm->ackerosd));
   get_parent()->update_last_complete_ondisk(rm->last_complete);
 
-  Message *m = rm->op->get_req();
+  Message *m = rm->req;
   Message *commit = NULL;
   if (m->get_type() == MSG_OSD_SUBOP) {
     // doesn't have CLIENT SUBOP feature ,use Subop
@@ -1286,7 +1470,7 @@ void ReplicatedBackend::sub_op_modify_commit(RepModifyRef rm)
   get_parent()->send_message_osd_cluster(
     rm->ackerosd, commit, get_osdmap()->get_epoch());
 
-  log_subop_stats(get_parent()->get_logger(), rm->op, l_osd_sop_w);
+  log_subop_stats(get_parent()->get_logger(), rm->op, l_osd_sop_w, rm->req);
 }
 
 
@@ -1353,6 +1537,67 @@ void ReplicatedBackend::calc_head_subsets(
 	   << "  clone_subsets " << clone_subsets << dendl;
 }
 
+/*
+ * If the peer has an older version of head and every log entry since
+ * then recorded its dirty extents, the peer can clone the rest from its
+ * own copy: clone_subsets[head] tells it to (see submit_push_data).
+ */
+bool ReplicatedBackend::calc_delta_subsets(
+  ObjectContextRef obc, const hobject_t& head, pg_shard_t peer,
+  interval_set<uint64_t>& data_subset,
+  map<hobject_t, interval_set<uint64_t>, hobject_t::BitwiseComparator>& clone_subsets)
+{
+  if (!cct->_conf->osd_recovery_delta_push ||
+      !(get_parent()->min_peer_features() & CEPH_FEATURE_OSD_DELTA_RECOVERY))
+    return false;
+
+  map<pg_shard_t, pg_missing_t>::const_iterator pm =
+    get_parent()->get_shard_missing().find(peer);
+  if (pm == get_parent()->get_shard_missing().end())
+    return false;
+  map<hobject_t, pg_missing_t::item, hobject_t::ComparatorWithDefault>::const_iterator mi =
+    pm->second.missing.find(head);
+  if (mi == pm->second.missing.end())
+    return false;
+  eversion_t have = mi->second.have;
+  const pg_log_t &log = get_parent()->get_log().get_log();
+  if (have == eversion_t() || have < log.tail)
+    return false;
+
+  interval_set<uint64_t> dirty;
+  for (list<pg_log_entry_t>::const_reverse_iterator p = log.log.rbegin();
+       p != log.log.rend() && p->version > have;
+       ++p) {
+    if (p->soid != head)
+      continue;
+    if (!p->is_modify() || !p->has_dirty_extents) {
+      dout(20) << __func__ << " " << head << " entry " << p->version
+	       << " has no dirty extents" << dendl;
+      return false;
+    }
+    dirty.union_of(p->dirty_extents);
+  }
+
+  interval_set<uint64_t> unchanged;
+  uint64_t size = obc->obs.oi.size;
+  if (size)
+    unchanged.insert(0, size);
+  data_subset = unchanged;
+  data_subset.intersection_of(dirty);
+  unchanged.subtract(data_subset);
+  if (unchanged.num_intervals() > cct->_conf->osd_recover_clone_overlap_limit) {
+    dout(10) << __func__ << " " << head << " too many holes" << dendl;
+    return false;
+  }
+  clone_subsets.clear();
+  if (!unchanged.empty())
+    clone_subsets[head] = unchanged;
+  dout(10) << __func__ << " " << head << " peer " << peer << " has " << have
+	   << "  data_subset " << data_subset
+	   << "  clone_subsets " << clone_subsets << dendl;
+  return true;
+}
+
 void ReplicatedBackend::calc_clone_subsets(
   SnapSet& snapset, const hobject_t& soid,
   const pg_missing_t& missing,
@@ -1594,6 +1839,15 @@ void ReplicatedBackend::prep_push_to_replica(
       ssc->snapset, soid, get_parent()->get_shard_missing().find(peer)->second,
       get_parent()->get_shard_info().find(peer)->second.last_backfill,
       data_subset, clone_subsets);
+
+    // or on what the replica has of it already?
+    interval_set<uint64_t> delta_data;
+    map<hobject_t, interval_set<uint64_t>, hobject_t::BitwiseComparator> delta_clone;
+    if (calc_delta_subsets(obc, soid, peer, delta_data, delta_clone) &&
+	delta_data.size() < data_subset.size()) {
+      data_subset.swap(delta_data);
+      clone_subsets.swap(delta_clone);
+    }
   }
 
   prep_push(obc, soid, peer, oi.version, data_subset, clone_subsets, pop, cache_dont_need);
@@ -1694,8 +1948,12 @@ void ReplicatedBackend::submit_push_data(
   map<string, bufferlist> &omap_entries,
   ObjectStore::Transaction *t)
 {
+  // the unchanged part comes from our own copy, so keep it until the end
+  map<hobject_t, interval_set<uint64_t>, hobject_t::BitwiseComparator>::const_iterator self =
+    recovery_info.clone_subset.find(recovery_info.soid);
+  bool delta = self != recovery_info.clone_subset.end();
   hobject_t target_oid;
-  if (first && complete) {
+  if (first && complete && !delta) {
     target_oid = recovery_info.soid;
   } else {
     target_oid = get_parent()->get_temp_recovery_object(recovery_info.version,
@@ -1712,6 +1970,17 @@ void ReplicatedBackend::submit_push_data(
     t->touch(coll, ghobject_t(target_oid));
     t->truncate(coll, ghobject_t(target_oid), recovery_info.size);
     t->omap_setheader(coll, ghobject_t(target_oid), omap_header);
+    if (delta) {
+      for (interval_set<uint64_t>::const_iterator q = self->second.begin();
+	   q != self->second.end();
+	   ++q) {
+	dout(15) << " clone_range " << recovery_info.soid << " "
+		 << q.get_start() << "~" << q.get_len() << dendl;
+	t->clone_range(coll, ghobject_t(recovery_info.soid),
+		       ghobject_t(target_oid),
+		       q.get_start(), q.get_len(), q.get_start());
+      }
+    }
   }
   uint64_t off = 0;
   uint32_t fadvise_flags = CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL;
@@ -1733,7 +2002,7 @@ void ReplicatedBackend::submit_push_data(
     t->setattrs(coll, ghobject_t(target_oid), attrs);
 
   if (complete) {
-    if (!first) {
+    if (!first || delta) {
       dout(10) << __func__ << ": Removing oid "
 	       << target_oid << " from the temp collection" << dendl;
       clear_temp_obj(target_oid);
@@ -1753,6 +2022,8 @@ void ReplicatedBackend::submit_push_complete(ObjectRecoveryInfo &recovery_info,
 	 recovery_info.clone_subset.begin();
        p != recovery_info.clone_subset.end();
        ++p) {
+    if (p->first == recovery_info.soid)
+      continue;  // done in submit_push_data
     for (interval_set<uint64_t>::const_iterator q = p->second.begin();
 	 q != p->second.end();
 	 ++q) {
@@ -21,6 +21,7 @@
 #include "../include/memory.h"
 
 struct C_ReplicatedBackend_OnPullComplete;
+class MOSDRepOp;
 class ReplicatedBackend : public PGBackend {
   struct RPGHandle : public PGBackend::RecoveryHandle {
     map<pg_shard_t, vector<PushOp> > pushes;
@@ -35,6 +36,7 @@ public:
     coll_t coll,
     ObjectStore *store,
     CephContext *cct);
+  ~ReplicatedBackend();
 
   /// @see PGBackend::open_recovery_op
   RPGHandle *_open_recovery_op() {
@@ -155,6 +157,21 @@ public:
     uint32_t op_flags,
     bufferlist *bl);
 
+  int objects_read_sync_into(
+    const hobject_t &hoid,
+    uint64_t off,
+    uint64_t len,
+    uint32_t op_flags,
+    bufferptr &bp);
+
+  int objects_sparse_read(
+    const hobject_t &hoid,
+    uint64_t off,
+    uint64_t len,
+    uint32_t op_flags,
+    map<uint64_t, uint64_t> *m,
+    bufferlist *bl);
+
   void objects_read_async(
     const hobject_t &hoid,
     const list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
@@ -311,6 +328,10 @@ private:
 			 const hobject_t &last_backfill,
 			 interval_set<uint64_t>& data_subset,
 			 map<hobject_t, interval_set<uint64_t>, hobject_t::BitwiseComparator>& clone_subsets);
+  bool calc_delta_subsets(ObjectContextRef obc, const hobject_t& head,
+			  pg_shard_t peer,
+			  interval_set<uint64_t>& data_subset,
+			  map<hobject_t, interval_set<uint64_t>, hobject_t::BitwiseComparator>& clone_subsets);
   ObjectRecoveryInfo recalc_subsets(
     const ObjectRecoveryInfo& recovery_info,
     SnapSetContext *ssc
@@ -394,10 +415,29 @@ private:
   void sub_op_modify_reply(OpRequestRef op);
   void sub_op_modify(OpRequestRef op);
   template<typename T, int MSGTYPE>
-  void sub_op_modify_impl(OpRequestRef op);
+  void sub_op_modify_impl(OpRequestRef op, T *m,
+			  list<ObjectStore::Transaction*> &tls);
+
+  /// repops held back per replica, to go out as one MOSDRepOpBatch
+  map<pg_shard_t, vector<MOSDRepOp*> > repop_batches;
+  bool repop_batch_flush_scheduled;
+
+  struct C_FlushRepopBatches : public Context {
+    ReplicatedBackend *pg;
+    C_FlushRepopBatches(ReplicatedBackend *pg) : pg(pg) {}
+    void finish(int r) {
+      pg->repop_batch_flush_scheduled = false;
+      pg->flush_repop_batches();
+    }
+  };
+  void queue_repop(pg_shard_t peer, MOSDRepOp *m);
+  void send_repop_batch(pg_shard_t peer);
+  void flush_repop_batches();
+  void clear_repop_batches();
 
   struct RepModify {
     OpRequestRef op;
+    Message *req;  ///< the repop; inside op's message if it came batched
     bool applied, committed;
     int ackerosd;
     eversion_t last_complete;
@@ -407,7 +447,7 @@ private:
 
     ObjectStore::Transaction opt, localt;
     
-    RepModify() : applied(false), committed(false), ackerosd(-1),
+    RepModify() : req(NULL), applied(false), committed(false), ackerosd(-1),
 		  epoch_started(0), bytes_written(0) {}
   };
   typedef ceph::shared_ptr<RepModify> RepModifyRef;
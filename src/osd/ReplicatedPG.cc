@@ -120,9 +120,13 @@ void ReplicatedPG::OpContext::finish_read(ReplicatedPG *pg)
   assert(inflightreads > 0);
   --inflightreads;
   if (async_reads_complete()) {
-    assert(pg->in_progress_async_reads.size());
-    assert(pg->in_progress_async_reads.front().second == this);
-    pg->in_progress_async_reads.pop_front();
+    // replicated reads may come back out of order
+    list<pair<OpRequestRef, OpContext*> >::iterator p =
+      pg->in_progress_async_reads.begin();
+    while (p != pg->in_progress_async_reads.end() && p->second != this)
+      ++p;
+    assert(p != pg->in_progress_async_reads.end());
+    pg->in_progress_async_reads.erase(p);
     pg->complete_read_ctx(async_read_result, this);
   }
 }
@@ -334,6 +338,12 @@ void ReplicatedPG::schedule_recovery_work(
   osd->recovery_gen_wq.queue(c);
 }
 
+void ReplicatedPG::schedule_repop_batch_flush(double delay, Context *c)
+{
+  Mutex::Locker l(osd->repop_batch_lock);
+  osd->repop_batch_timer.add_event_after(delay, bless_context(c));
+}
+
 void ReplicatedPG::send_message_osd_cluster(
   int peer, Message *m, epoch_t from_epoch)
 {
@@ -397,6 +407,45 @@ void ReplicatedPG::maybe_kick_recovery(
   }
 }
 
+/*
+ * A read of our copy failed (bad block checksum in the store, or a
+ * whole-object digest mismatch).  If the PG is clean the replicas have
+ * the object too: treat ours as missing, pull it back and retry op
+ * once it is here.  Returns false if op should just get the error.
+ */
+bool ReplicatedPG::repair_object_on_read(ObjectContextRef obc, OpRequestRef op)
+{
+  const hobject_t &soid = obc->obs.oi.soid;
+  if (!cct->_conf->osd_repair_on_read_error ||
+      pool.info.ec_pool() ||
+      !is_primary() ||
+      !is_clean() ||
+      actingbackfill.size() < 2 ||
+      is_missing_object(soid))
+    return false;
+
+  eversion_t v = obc->obs.oi.version;
+  osd->clog->error() << info.pgid << " read error on " << soid
+		     << ", recovering it from osd.{" << actingbackfill << "}";
+  pg_log.missing_add(soid, v, eversion_t());
+  pg_log.set_last_requested(0);
+  missing_loc.add_missing(soid, v, eversion_t());
+  for (set<pg_shard_t>::iterator i = actingbackfill.begin();
+       i != actingbackfill.end();
+       ++i) {
+    if (*i != pg_whoami)
+      missing_loc.add_location(soid, *i);
+  }
+  wait_for_unreadable_object(soid, op);
+  queue_peering_event(
+    CephPeeringEvtRef(
+      new CephPeeringEvt(
+	get_osdmap()->get_epoch(),
+	get_osdmap()->get_epoch(),
+	DoRecovery())));
+  return true;
+}
+
 void ReplicatedPG::wait_for_unreadable_object(
   const hobject_t& soid, OpRequestRef op)
 {
@@ -486,6 +535,30 @@ void ReplicatedPG::block_write_on_degraded_snap(
   wait_for_degraded_object(snap, op);
 }
 
+/*
+ * A replica may only answer a read if whatever it has for the object
+ * is committed on every shard; otherwise the primary could still roll
+ * it back (or a client could read a write that is never acked).  The
+ * primary tells us how far that holds with each repop.
+ */
+bool ReplicatedPG::can_serve_replica_read(const hobject_t &soid)
+{
+  if (!cct->_conf->osd_replica_read_check_stable)
+    return true;
+  hobject_t head = soid.get_head();
+  if (pg_log.get_missing().is_missing(head))
+    return false;
+  eversion_t v = pg_log.get_tail();
+  PGLog::IndexedLog::objects_t::const_iterator p =
+    pg_log.get_log().objects.find(head);
+  if (p != pg_log.get_log().objects.end())
+    v = p->second->version;
+  dout(20) << __func__ << " " << soid << " last written " << v
+	   << ", stable " << replica_read_stable
+	   << ", applied " << last_update_applied << dendl;
+  return v <= replica_read_stable && v <= last_update_applied;
+}
+
 bool ReplicatedPG::maybe_await_blocked_snapset(
   const hobject_t &hoid,
   OpRequestRef op)
@@ -1326,7 +1399,8 @@ ReplicatedPG::ReplicatedPG(OSDService *o, OSDMapRef curmap,
   pgbackend(
     PGBackend::build_pg_backend(
       _pool.info, curmap, this, coll_t(p), o->store, cct)),
-  object_contexts(o->cct, g_conf->osd_pg_object_context_cache_count),
+  object_contexts(o->cct, o->obc_cache.enabled() ? 0 :
+		  g_conf->osd_pg_object_context_cache_count),
   snapset_contexts_lock("ReplicatedPG::snapset_contexts"),
   backfills_in_flight(hobject_t::Comparator(true)),
   pending_backfill_updates(hobject_t::Comparator(true)),
@@ -1699,6 +1773,14 @@ void ReplicatedPG::do_op(OpRequestRef& op)
 		m->get_object_locator().get_pool(),
 		m->get_object_locator().nspace);
 
+  // balanced/localized read on a replica?
+  if (!is_primary() && !can_serve_replica_read(oid)) {
+    dout(20) << __func__ << ": " << oid << " may have writes in flight, "
+	     << "bouncing to primary" << dendl;
+    osd->reply_op_error(op, -EAGAIN);
+    return;
+  }
+
   // io blocked on obc?
   if (!m->has_flag(CEPH_OSD_FLAG_FLUSH) &&
       maybe_await_blocked_snapset(oid, op)) {
@@ -2223,52 +2305,45 @@ bool ReplicatedPG::maybe_promote(ObjectContextRef obc,
   dout(20) << __func__ << " missing_oid " << missing_oid
 	   << "  in_hit_set " << in_hit_set << dendl;
 
-  switch (recency) {
-  case 0:
-    promote_object(obc, missing_oid, oloc, promote_op, promote_obc);
-    break;
-  case 1:
-    // Check if in the current hit set
-    if (in_hit_set) {
-      promote_object(obc, missing_oid, oloc, promote_op, promote_obc);
-    } else {
-      // not promoting
-      return false;
-    }
-    break;
-  default:
-    if (in_hit_set) {
-      promote_object(obc, missing_oid, oloc, promote_op);
-    } else {
-      // Check if in other hit sets
-      map<time_t,HitSetRef>::iterator itor;
-      bool in_other_hit_sets = false;
-      unsigned max_in_memory_read = pool.info.min_read_recency_for_promote > 0 ? pool.info.min_read_recency_for_promote - 1 : 0;
-      unsigned max_in_memory_write = pool.info.min_write_recency_for_promote > 0 ? pool.info.min_write_recency_for_promote - 1 : 0;
-      unsigned max_in_memory = MAX(max_in_memory_read, max_in_memory_write);
-      for (itor = agent_state->hit_set_map.begin(); itor != agent_state->hit_set_map.end() && max_in_memory--; ++itor) {
-        if (obc.get()) {
-          if (obc->obs.oi.soid != hobject_t() && itor->second->contains(obc->obs.oi.soid)) {
-            in_other_hit_sets = true;
-            break;
-          }
-        } else {
-          if (missing_oid != hobject_t() && itor->second->contains(missing_oid)) {
-            in_other_hit_sets = true;
-            break;
-          }
-        }
-      }
-      if (in_other_hit_sets) {
-        promote_object(obc, missing_oid, oloc, promote_op);
-      } else {
-	// not promoting
-        return false;
-      }
-    }
-    break;
+  const hobject_t& soid = obc.get() ? obc->obs.oi.soid : missing_oid;
+
+  // recency: the object is in the current HitSet or in one of the
+  // recency - 1 newest archived ones.  frequency: it is in at least
+  // osd_tier_promote_min_hit_sets of all the HitSets we have in memory,
+  // which keeps one-off scans from being promoted at all.
+  unsigned min_hits = cct->_conf->osd_tier_promote_min_hit_sets;
+  unsigned window = recency > 1 ? recency - 1 : 0;
+  bool recent = recency == 0 || in_hit_set;
+  unsigned hits = in_hit_set ? 1 : 0;
+  if (agent_state && soid != hobject_t()) {
+    unsigned n = 0;
+    for (map<time_t,HitSetRef>::reverse_iterator p =
+	   agent_state->hit_set_map.rbegin();
+	 p != agent_state->hit_set_map.rend() &&
+	   !(recent && hits >= min_hits) &&
+	   (recent || n < window);
+	 ++p, ++n) {
+      if (p->second->contains(soid)) {
+	++hits;
+	if (n < window)
+	  recent = true;
+      }
+    }
+  }
+  if (!recent || hits < min_hits) {
+    dout(20) << __func__ << " " << soid << " not promoting, recent " << recent
+	     << " hits " << hits << "/" << min_hits << dendl;
+    return false;
+  }
+
+  if (osd->promote_throttle()) {
+    dout(10) << __func__ << " " << soid << " promotion throttled" << dendl;
+    osd->logger->inc(l_osd_tier_promote_throttled);
+    info.stats.stats.sum.num_promote_throttled++;
+    return false;
   }
 
+  promote_object(obc, missing_oid, oloc, promote_op, promote_obc);
   return true;
 }
 
@@ -2707,6 +2782,26 @@ void ReplicatedPG::promote_object(ObjectContextRef obc,
   info.stats.stats.sum.num_promote++;
 }
 
+bool ReplicatedPG::can_read_unlocked(OpContext *ctx)
+{
+  if (!cct->_conf->osd_op_unlocked_reads || cct->_conf->osd_op_async_reads)
+    return false;
+  OpRequestRef op = ctx->op;
+  if (op->may_write() || op->may_cache() || !op->may_read())
+    return false;
+  // ec reads are async already
+  if (pool.info.require_rollback())
+    return false;
+  if (!ctx->src_obc.empty())
+    return false;
+  // anything else may look at or change pg state between the ops
+  for (vector<OSDOp>::iterator p = ctx->ops.begin(); p != ctx->ops.end(); ++p) {
+    if (p->op.op != CEPH_OSD_OP_READ && p->op.op != CEPH_OSD_OP_SYNC_READ)
+      return false;
+  }
+  return true;
+}
+
 void ReplicatedPG::execute_ctx(OpContext *ctx)
 {
   dout(10) << __func__ << " " << ctx << dendl;
@@ -2770,6 +2865,8 @@ void ReplicatedPG::execute_ctx(OpContext *ctx)
     p->second->ondisk_read_lock();
   }
 
+  ctx->unlocked_read = can_read_unlocked(ctx);
+
   {
 #ifdef WITH_LTTNG
     osd_reqid_t reqid = ctx->op->get_reqid();
@@ -2802,9 +2899,16 @@ void ReplicatedPG::execute_ctx(OpContext *ctx)
     return;
   }
 
-  if (result == -EAGAIN) {
+  if (result == -EAGAIN || ctx->reset_during_read) {
     // clean up after the ctx
-    close_op_ctx(ctx, result);
+    close_op_ctx(ctx, -EAGAIN);
+    return;
+  }
+
+  if (result == -EIO && !op->may_write() &&
+      repair_object_on_read(obc, op)) {
+    // op waits for the object to be recovered
+    close_op_ctx(ctx, -EAGAIN);
     return;
   }
 
@@ -2923,6 +3027,7 @@ void ReplicatedPG::log_op_stats(OpContext *ctx)
   osd->logger->inc(l_osd_op_inb, inb);
   osd->logger->tinc(l_osd_op_lat, latency);
   osd->logger->tinc(l_osd_op_process_lat, process_latency);
+  osd->recovery_throttle.record_client_latency(latency);
 
   if (op->may_read() && op->may_write()) {
     osd->logger->inc(l_osd_op_rw);
@@ -3393,14 +3498,6 @@ ReplicatedPG::RepGather *ReplicatedPG::trim_object(const hobject_t &coid)
 
 void ReplicatedPG::snap_trimmer(epoch_t queued)
 {
-  if (g_conf->osd_snap_trim_sleep > 0) {
-    unlock();
-    utime_t t;
-    t.set_from_double(g_conf->osd_snap_trim_sleep);
-    t.sleep();
-    lock();
-    dout(20) << __func__ << " slept for " << t << dendl;
-  }
   if (deleting || pg_has_reset_since(queued)) {
     return;
   }
@@ -3992,7 +4089,8 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	  // read size was trimmed to zero and it is expected to do nothing
 	  // a read operation of 0 bytes does *not* do nothing, this is why
 	  // the trimmed_read boolean is needed
-	} else if (pool.info.require_rollback()) {
+	} else if (pool.info.require_rollback() ||
+		   cct->_conf->osd_op_async_reads) {
 	  async = true;
 	  boost::optional<uint32_t> maybe_crc;
 	  // If there is a data digest and it is possible we are reading
@@ -4010,8 +4108,42 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 				soid, op.flags))));
 	  dout(10) << " async_read noted for " << soid << dendl;
 	} else {
-	  int r = pgbackend->objects_read_sync(
-	    soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
+	  // if the client connection can hand us memory that is already
+	  // registered with the transport, read straight into it so the
+	  // reply goes out without another copy.
+	  bufferptr rbp;
+	  if (op.extent.length > 0 && ctx->op &&
+	      ctx->op->get_req()->get_connection())
+	    rbp = ctx->op->get_req()->get_connection()->alloc_registered_buffer(
+	      op.extent.length);
+	  int r;
+	  // the obc read lock keeps writers off this object; everything
+	  // else in the pg may go on while we wait for the store
+	  epoch_t reset_epoch = get_last_peering_reset();
+	  if (ctx->unlocked_read)
+	    unlock();
+	  if (rbp.have_raw()) {
+	    r = pgbackend->objects_read_sync_into(
+	      soid, op.extent.offset, op.extent.length, op.flags, rbp);
+	    if (r > 0) {
+	      rbp.set_length(r);
+	      osd_op.outdata.push_back(rbp);
+	    }
+	  } else {
+	    r = pgbackend->objects_read_sync(
+	      soid, op.extent.offset, op.extent.length, op.flags,
+	      &osd_op.outdata);
+	  }
+	  if (ctx->unlocked_read) {
+	    lock();
+	    if (pg_has_reset_since(reset_epoch)) {
+	      dout(10) << " pg reset during unlocked read of " << soid
+		       << ", dropping op" << dendl;
+	      ctx->reset_during_read = true;
+	      result = -EAGAIN;
+	      break;
+	    }
+	  }
 	  if (r >= 0)
 	    op.extent.length = r;
 	  else {
@@ -4029,7 +4161,7 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 				 << " full-object read crc 0x" << crc
 				 << " != expected 0x" << oi.data_digest
 				 << std::dec << " on " << soid;
-	      // FIXME fall back to replica or something?
+	      // see repair_object_on_read()
 	      result = -EIO;
 	    }
 	  }
@@ -4095,55 +4227,65 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	// read into a buffer
 	bufferlist bl;
         uint32_t total_read = 0;
-	int r = osd->store->fiemap(coll, ghobject_t(soid, ghobject_t::NO_GEN,
-						    info.pgid.shard),
-				   op.extent.offset, op.extent.length, bl);
-	if (r < 0)  {
-	  result = r;
-          break;
-	}
-        map<uint64_t, uint64_t> m;
-        bufferlist::iterator iter = bl.begin();
-        ::decode(m, iter);
-        map<uint64_t, uint64_t>::iterator miter;
-        bufferlist data_bl;
-	uint64_t last = op.extent.offset;
-        for (miter = m.begin(); miter != m.end(); ++miter) {
-	  // verify hole?
-	  if (cct->_conf->osd_verify_sparse_read_holes &&
-	      last < miter->first) {
-	    bufferlist t;
-	    uint64_t len = miter->first - last;
-	    r = pgbackend->objects_read_sync(soid, last, len, op.flags, &t);
-	    if (!t.is_zero()) {
-	      osd->clog->error() << coll << " " << soid << " sparse-read found data in hole "
-				<< last << "~" << len << "\n";
-	    }
+	map<uint64_t, uint64_t> m;
+	bufferlist data_bl;
+	int r;
+	if (!cct->_conf->osd_verify_sparse_read_holes &&
+	    (r = pgbackend->objects_sparse_read(
+	      soid, op.extent.offset, op.extent.length, op.flags,
+	      &m, &data_bl)) != -EOPNOTSUPP) {
+	  // the store found and read the extents in one go
+	  if (r >= 0)
+	    total_read = r;
+	} else {
+	  r = osd->store->fiemap(coll, ghobject_t(soid, ghobject_t::NO_GEN,
+						      info.pgid.shard),
+				     op.extent.offset, op.extent.length, bl);
+	  if (r < 0)  {
+	    result = r;
+	    break;
 	  }
+	  bufferlist::iterator iter = bl.begin();
+	  ::decode(m, iter);
+	  map<uint64_t, uint64_t>::iterator miter;
+	  uint64_t last = op.extent.offset;
+	  for (miter = m.begin(); miter != m.end(); ++miter) {
+	    // verify hole?
+	    if (cct->_conf->osd_verify_sparse_read_holes &&
+		last < miter->first) {
+	      bufferlist t;
+	      uint64_t len = miter->first - last;
+	      r = pgbackend->objects_read_sync(soid, last, len, op.flags, &t);
+	      if (!t.is_zero()) {
+		osd->clog->error() << coll << " " << soid << " sparse-read found data in hole "
+				  << last << "~" << len << "\n";
+	      }
+	    }
 
-          bufferlist tmpbl;
-	  r = pgbackend->objects_read_sync(soid, miter->first, miter->second, op.flags, &tmpbl);
-          if (r < 0)
-            break;
+	    bufferlist tmpbl;
+	    r = pgbackend->objects_read_sync(soid, miter->first, miter->second, op.flags, &tmpbl);
+	    if (r < 0)
+	      break;
 
-          if (r < (int)miter->second) /* this is usually happen when we get extent that exceeds the actual file size */
-            miter->second = r;
-          total_read += r;
-          dout(10) << "sparse-read " << miter->first << "@" << miter->second << dendl;
-	  data_bl.claim_append(tmpbl);
-	  last = miter->first + r;
-        }
+	    if (r < (int)miter->second) /* this is usually happen when we get extent that exceeds the actual file size */
+	      miter->second = r;
+	    total_read += r;
+	    dout(10) << "sparse-read " << miter->first << "@" << miter->second << dendl;
+	    data_bl.claim_append(tmpbl);
+	    last = miter->first + r;
+	  }
 
-	// verify trailing hole?
-	if (cct->_conf->osd_verify_sparse_read_holes) {
-	  uint64_t end = MIN(op.extent.offset + op.extent.length, oi.size);
-	  if (last < end) {
-	    bufferlist t;
-	    uint64_t len = end - last;
-	    r = pgbackend->objects_read_sync(soid, last, len, op.flags, &t);
-	    if (!t.is_zero()) {
-	      osd->clog->error() << coll << " " << soid << " sparse-read found data in hole "
-				<< last << "~" << len << "\n";
+	  // verify trailing hole?
+	  if (cct->_conf->osd_verify_sparse_read_holes) {
+	    uint64_t end = MIN(op.extent.offset + op.extent.length, oi.size);
+	    if (last < end) {
+	      bufferlist t;
+	      uint64_t len = end - last;
+	      r = pgbackend->objects_read_sync(soid, last, len, op.flags, &t);
+	      if (!t.is_zero()) {
+		osd->clog->error() << coll << " " << soid << " sparse-read found data in hole "
+				  << last << "~" << len << "\n";
+	      }
 	    }
 	  }
 	}
@@ -4163,7 +4305,7 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	      << " full-object read crc 0x" << crc
 	      << " != expected 0x" << oi.data_digest
 	      << std::dec << " on " << soid;
-	    // FIXME fall back to replica or something?
+	    // see repair_object_on_read()
 	    result = -EIO;
 	    break;
 	  }
@@ -4739,18 +4881,30 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	if (pool.info.has_flag(pg_pool_t::FLAG_WRITE_FADVISE_DONTNEED))
 	  op.flags = op.flags | CEPH_OSD_OP_FLAG_FADVISE_DONTNEED;
 
-	if (pool.info.requires_aligned_append() &&
+	// anything but an aligned append needs the backend to read, modify
+	// and write whole stripes
+	bool ec_overwrite = pool.info.require_rollback() &&
+	  pool.info.has_flag(pg_pool_t::FLAG_EC_OVERWRITES) &&
+	  (op.extent.offset != (obs.exists ? oi.size : 0) ||
+	   op.extent.offset % pool.info.required_alignment() != 0);
+
+	if (!ec_overwrite && pool.info.requires_aligned_append() &&
 	    (op.extent.offset % pool.info.required_alignment() != 0)) {
 	  result = -EOPNOTSUPP;
 	  break;
 	}
 
 	if (!obs.exists) {
-	  if (pool.info.require_rollback() && op.extent.offset) {
+	  if (!ec_overwrite && pool.info.require_rollback() &&
+	      op.extent.offset) {
 	    result = -EOPNOTSUPP;
 	    break;
 	  }
 	  ctx->mod_desc.create();
+	} else if (ec_overwrite) {
+	  // roll back to a copy of the object as it was
+	  if (ctx->mod_desc.rmobject(ctx->at_version.version))
+	    t->stash_copy(soid, ctx->at_version.version);
 	} else if (op.extent.offset == oi.size) {
 	  ctx->mod_desc.append(oi.size);
 	} else {
@@ -4794,7 +4948,7 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	result = check_offset_and_length(op.extent.offset, op.extent.length, cct->_conf->osd_max_object_size);
 	if (result < 0)
 	  break;
-	if (pool.info.require_rollback()) {
+	if (pool.info.require_rollback() && !ec_overwrite) {
 	  t->append(soid, op.extent.offset, op.extent.length, osd_op.indata, op.flags);
 	} else {
 	  t->write(soid, op.extent.offset, op.extent.length, osd_op.indata, op.flags);
@@ -4878,7 +5032,8 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 
     case CEPH_OSD_OP_ZERO:
       tracepoint(osd, do_osd_op_pre_zero, soid.oid.name.c_str(), soid.snap.val, op.extent.offset, op.extent.length);
-      if (pool.info.require_rollback()) {
+      if (pool.info.require_rollback() &&
+	  !pool.info.has_flag(pg_pool_t::FLAG_EC_OVERWRITES)) {
 	result = -EOPNOTSUPP;
 	break;
       }
@@ -4888,7 +5043,23 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	if (result < 0)
 	  break;
 	assert(op.extent.length);
-	if (obs.exists && !oi.is_whiteout()) {
+	if (obs.exists && !oi.is_whiteout() &&
+	    pool.info.require_rollback()) {
+	  // zero only what exists, as an overwrite; zero never extends
+	  if (op.extent.offset < oi.size) {
+	    uint64_t len = MIN(op.extent.length, oi.size - op.extent.offset);
+	    if (ctx->mod_desc.rmobject(ctx->at_version.version))
+	      t->stash_copy(soid, ctx->at_version.version);
+	    bufferlist zeros;
+	    zeros.append_zero(len);
+	    t->write(soid, op.extent.offset, len, zeros);
+	    interval_set<uint64_t> ch;
+	    ch.insert(op.extent.offset, len);
+	    ctx->modified_ranges.union_of(ch);
+	    ctx->delta_stats.num_wr++;
+	    oi.clear_data_digest();
+	  }
+	} else if (obs.exists && !oi.is_whiteout()) {
 	  ctx->mod_desc.mark_unrollbackable();
 	  t->zero(soid, op.extent.offset, op.extent.length);
 	  interval_set<uint64_t> ch;
@@ -5730,7 +5901,8 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
   fail:
     osd_op.rval = result;
     tracepoint(osd, do_osd_op_post, soid.oid.name.c_str(), soid.snap.val, op.op, ceph_osd_op_name(op.op), op.flags, result);
-    if (result < 0 && (op.flags & CEPH_OSD_OP_FLAG_FAILOK))
+    if (result < 0 && (op.flags & CEPH_OSD_OP_FLAG_FAILOK) &&
+	!ctx->reset_during_read)
       result = 0;
 
     if (result < 0)
@@ -6290,6 +6462,16 @@ void ReplicatedPG::do_osd_op_effects(OpContext *ctx, const ConnectionRef& conn)
       dout(10) << "notify_ack " << make_pair(p->watch_cookie.get(), p->notify_id) << dendl;
     else
       dout(10) << "notify_ack " << make_pair("NULL", p->notify_id) << dendl;
+    if (p->watch_cookie) {
+      // one lookup, not a scan of what may be thousands of watchers
+      map<pair<uint64_t, entity_name_t>, WatchRef>::iterator i =
+	ctx->obc->watchers.find(make_pair(p->watch_cookie.get(), entity));
+      if (i != ctx->obc->watchers.end()) {
+	dout(10) << "acking notify on watch " << i->first << dendl;
+	i->second->notify_ack(p->notify_id, p->reply_bl);
+      }
+      continue;
+    }
     for (map<pair<uint64_t, entity_name_t>, WatchRef>::iterator i =
 	   ctx->obc->watchers.begin();
 	 i != ctx->obc->watchers.end();
@@ -6369,6 +6551,9 @@ int ReplicatedPG::prepare_transaction(OpContext *ctx)
     }
   }
 
+  // before make_writeable trims modified_ranges to the clone overlap
+  record_dirty_extents(ctx);
+
   // clone, if necessary
   if (soid.snap == CEPH_NOSNAP)
     make_writeable(ctx);
@@ -6380,6 +6565,51 @@ int ReplicatedPG::prepare_transaction(OpContext *ctx)
   return result;
 }
 
+void ReplicatedPG::record_dirty_extents(OpContext *ctx)
+{
+  ctx->has_dirty_extents = false;
+  ctx->dirty_extents.clear();
+  if (!cct->_conf->osd_recovery_delta_push ||
+      pool.info.require_rollback() ||
+      !ctx->obs->exists || !ctx->new_obs.exists)
+    return;
+
+  // only ops whose data changes all land in modified_ranges
+  for (vector<OSDOp>::const_iterator p = ctx->ops.begin();
+       p != ctx->ops.end();
+       ++p) {
+    const ceph_osd_op &op = p->op;
+    if (!ceph_osd_op_mode_modify(op.op))
+      continue;
+    switch (op.op) {
+    case CEPH_OSD_OP_WRITE:
+      // trimtrunc truncates without recording it
+      if (op.extent.truncate_seq)
+	return;
+      break;
+    case CEPH_OSD_OP_ZERO:
+    case CEPH_OSD_OP_TRUNCATE:
+    case CEPH_OSD_OP_SETXATTR:
+    case CEPH_OSD_OP_RMXATTR:
+    case CEPH_OSD_OP_SETALLOCHINT:
+      break;
+    default:
+      return;
+    }
+  }
+
+  ctx->has_dirty_extents = true;
+  ctx->dirty_extents = ctx->modified_ranges;
+  // anything past the old end may hold zeros the base copy does not
+  uint64_t old_size = ctx->obs->oi.size;
+  uint64_t new_size = ctx->new_obs.oi.size;
+  if (new_size > old_size) {
+    interval_set<uint64_t> grown;
+    grown.insert(old_size, new_size - old_size);
+    ctx->dirty_extents.union_of(grown);
+  }
+}
+
 void ReplicatedPG::finish_ctx(OpContext *ctx, int log_op_type, bool maintain_ssc,
 			      bool scrub_ok)
 {
@@ -6551,6 +6781,11 @@ void ReplicatedPG::finish_ctx(OpContext *ctx, int log_op_type, bool maintain_ssc
   }
 
   ctx->log.back().mod_desc.claim(ctx->mod_desc);
+  if (ctx->has_dirty_extents) {
+    ctx->log.back().has_dirty_extents = true;
+    ctx->log.back().dirty_extents.swap(ctx->dirty_extents);
+    ctx->has_dirty_extents = false;
+  }
   if (!ctx->extra_reqids.empty()) {
     dout(20) << __func__ << "  extra_reqids " << ctx->extra_reqids << dendl;
     ctx->log.back().extra_reqids.swap(ctx->extra_reqids);
@@ -7491,6 +7726,7 @@ void ReplicatedPG::finish_promote(int r, CopyResults *results,
   simple_repop_submit(repop);
 
   osd->logger->inc(l_osd_tier_promote);
+  osd->promote_finish(results->object_size);
 
   if (agent_state &&
       agent_state->is_idle())
@@ -8527,6 +8763,7 @@ ObjectContextRef ReplicatedPG::get_object_context(const hobject_t& soid,
       pg_log.get_log().objects.find(soid)->second->op ==
       pg_log_entry_t::LOST_REVERT));
   ObjectContextRef obc = object_contexts.lookup(soid);
+  map<string, bufferlist> prefetched;
   osd->logger->inc(l_osd_object_ctx_cache_total);
   if (obc) {
     osd->logger->inc(l_osd_object_ctx_cache_hit);
@@ -8539,7 +8776,20 @@ ObjectContextRef ReplicatedPG::get_object_context(const hobject_t& soid,
     if (attrs) {
       assert(attrs->count(OI_ATTR));
       bv = attrs->find(OI_ATTR)->second;
-    } else {
+    } else if (soid.has_snapset() &&
+	       cct->_conf->osd_object_context_prefetch_attrs) {
+      // object info and snapset (and, for rollback pools, the
+      // attr_cache) with one read
+      int r = pgbackend->objects_get_attrs(soid, &prefetched);
+      map<string, bufferlist>::iterator p = prefetched.find(OI_ATTR);
+      if (r == 0 && p != prefetched.end() && prefetched.count(SS_ATTR)) {
+	bv = p->second;
+	attrs = &prefetched;
+      } else {
+	prefetched.clear();
+      }
+    }
+    if (!attrs) {
       int r = pgbackend->objects_get_attr(soid, OI_ATTR, &bv);
       if (r < 0) {
 	if (!can_create) {
@@ -8562,6 +8812,7 @@ ObjectContextRef ReplicatedPG::get_object_context(const hobject_t& soid,
 		 << " oi: " << obc->obs.oi
 		 << " ssc: " << obc->ssc
 		 << " snapset: " << obc->ssc->snapset << dendl;
+	cache_object_context(obc);
 	return obc;
       }
     }
@@ -8591,6 +8842,10 @@ ObjectContextRef ReplicatedPG::get_object_context(const hobject_t& soid,
 	  &obc->attr_cache);
 	assert(r == 0);
       }
+      for (map<string, bufferlist>::iterator i = obc->attr_cache.begin();
+	   i != obc->attr_cache.end();
+	   ++i)
+	i->second.reassign_to_pool(buffer::POOL_OSD);
     }
 
     dout(10) << __func__ << ": creating obc from disk: " << obc
@@ -8602,9 +8857,35 @@ ObjectContextRef ReplicatedPG::get_object_context(const hobject_t& soid,
 	   << " oi: " << obc->obs.oi
 	   << " ssc: " << obc->ssc
 	   << " snapset: " << obc->ssc->snapset << dendl;
+  cache_object_context(obc);
   return obc;
 }
 
+void ReplicatedPG::on_obc_cache_change()
+{
+  // the per-pg LRU keeps its own references only when there is no
+  // OSD-wide cache; SharedLRU locks itself, so no pg lock is needed
+  object_contexts.set_size(osd->obc_cache.enabled() ? 0 :
+			   g_conf->osd_pg_object_context_cache_count);
+}
+
+void ReplicatedPG::cache_object_context(const ObjectContextRef &obc)
+{
+  if (!osd->obc_cache.enabled())
+    return;
+  // rough: the context, its object_info and whatever attrs or snapset
+  // it holds on to
+  uint64_t bytes = sizeof(ObjectContext) + obc->obs.oi.soid.oid.name.size();
+  for (map<string, bufferlist>::const_iterator i = obc->attr_cache.begin();
+       i != obc->attr_cache.end();
+       ++i)
+    bytes += i->first.size() + i->second.length();
+  if (obc->ssc)
+    bytes += sizeof(SnapSetContext) +
+      obc->ssc->snapset.clones.size() * 4 * sizeof(snapid_t);
+  osd->obc_cache.touch(this, obc, bytes);
+}
+
 void ReplicatedPG::context_registry_on_change()
 {
   pair<hobject_t, ObjectContextRef> i;
@@ -9566,6 +9847,7 @@ void ReplicatedPG::on_shutdown()
   pgbackend->on_change();
 
   context_registry_on_change();
+  osd->obc_cache.clear(this);
   object_contexts.clear();
 
   osd->remote_reserver.cancel_reservation(info.pgid);
@@ -9659,6 +9941,9 @@ void ReplicatedPG::on_change(ObjectStore::Transaction *t)
   cancel_flush_ops(is_primary());
   cancel_proxy_ops(is_primary());
 
+  // the new primary will tell us again
+  replica_read_stable = eversion_t();
+
   // requeue object waiters
   if (is_primary()) {
     requeue_object_waiters(waiting_for_unreadable_object);
@@ -9725,6 +10010,7 @@ void ReplicatedPG::on_change(ObjectStore::Transaction *t)
   // we don't want to cache object_contexts through the interval change
   // NOTE: we actually assert that all currently live references are dead
   // by the time the flush for the next interval completes.
+  osd->obc_cache.clear(this);
   object_contexts.clear();
 
   // should have been cleared above by finishing all of the degraded objects
@@ -11069,7 +11355,9 @@ void ReplicatedPG::hit_set_create()
   HitSet::Params params(pool.info.hit_set_params);
 
   dout(20) << __func__ << " " << params << dendl;
-  if (pool.info.hit_set_params.get_type() == HitSet::TYPE_BLOOM) {
+  if (pool.info.hit_set_params.get_type() == HitSet::TYPE_BLOOM ||
+      pool.info.hit_set_params.get_type() == HitSet::TYPE_CUCKOO) {
+    // CuckooHitSet::Params is a BloomHitSet::Params
     BloomHitSet::Params *p =
       static_cast<BloomHitSet::Params*>(params.impl.get());
 
@@ -11206,6 +11494,9 @@ void ReplicatedPG::hit_set_persist()
 
   if (agent_state) {
     agent_state->add_hit_set(new_hset.begin, hit_set);
+    // every temperature just dropped one HitSet's worth; age out what we
+    // saw under the old weights
+    agent_state->temp_hist.decay();
     uint32_t size = agent_state->hit_set_map.size();
     if (size >= pool.info.hit_set_count) {
       size = pool.info.hit_set_count > 0 ? pool.info.hit_set_count - 1: 0;
@@ -11497,10 +11788,9 @@ bool ReplicatedPG::agent_work(int start_max, int agent_flush_quota)
   }
 
   if (++agent_state->hist_age > g_conf->osd_agent_hist_halflife) {
-    dout(20) << __func__ << " resetting atime and temp histograms" << dendl;
+    dout(20) << __func__ << " resetting atime histogram" << dendl;
     agent_state->hist_age = 0;
     agent_state->atime_hist.decay();
-    agent_state->temp_hist.decay();
   }
 
   // Total objects operated on so far
@@ -11708,7 +11998,7 @@ bool ReplicatedPG::agent_maybe_evict(ObjectContextRef& obc)
     // is this object old and/or cold enough?
     int atime = -1, temp = 0;
     if (hit_set)
-      agent_estimate_atime_temp(soid, &atime, NULL /*FIXME &temp*/);
+      agent_estimate_atime_temp(soid, &atime, &temp);
 
     uint64_t atime_upper = 0, atime_lower = 0;
     if (atime < 0 && obc->obs.oi.mtime != utime_t()) {
@@ -11731,12 +12021,11 @@ bool ReplicatedPG::agent_maybe_evict(ObjectContextRef& obc)
 						 &atime_upper);
     }
 
-    unsigned temp_upper = 0, temp_lower = 0;
-    /*
-    // FIXME: bound atime based on creation time?
-    agent_state->temp_hist.add(atime);
-    agent_state->temp_hist.get_position_micro(temp, &temp_lower, &temp_upper);
-    */
+    uint64_t temp_upper = 0, temp_lower = 0;
+    if (hit_set) {
+      agent_state->temp_hist.add(temp);
+      agent_state->temp_hist.get_position_micro(temp, &temp_lower, &temp_upper);
+    }
 
     dout(20) << __func__
 	     << " atime " << atime
@@ -11754,10 +12043,14 @@ bool ReplicatedPG::agent_maybe_evict(ObjectContextRef& obc)
     delete f;
     *_dout << dendl;
 
-    // FIXME: ignore temperature for now.
-
-    if (1000000 - atime_upper >= agent_state->evict_effort)
+    if (hit_set) {
+      // only what is among the coldest evict_effort of the objects we
+      // have seen lately goes; objects in no HitSet at all go first
+      if (temp_lower >= agent_state->evict_effort)
+	return false;
+    } else if (1000000 - atime_upper >= agent_state->evict_effort) {
       return false;
+    }
   }
 
   if (!obc->get_write(OpRequestRef())) {
@@ -12047,10 +12340,16 @@ void ReplicatedPG::agent_estimate_atime_temp(const hobject_t& oid,
   *atime = -1;
   if (temp)
     *temp = 0;
+  // a hit in the current HitSet is worth 1000000; each older HitSet is
+  // worth osd_agent_hit_set_temp_decay percent less than the next newer
+  int keep = 100 - cct->_conf->osd_agent_hit_set_temp_decay;
+  if (keep < 0)
+    keep = 0;
+  int weight = 1000000;
   if (hit_set->contains(oid)) {
     *atime = 0;
     if (temp)
-      ++(*temp);
+      *temp += weight;
     else
       return;
   }
@@ -12059,11 +12358,12 @@ void ReplicatedPG::agent_estimate_atime_temp(const hobject_t& oid,
 	 agent_state->hit_set_map.rbegin();
        p != agent_state->hit_set_map.rend();
        ++p) {
+    weight = (int64_t)weight * keep / 100;
     if (p->second->contains(oid)) {
       if (*atime < 0)
 	*atime = now - p->first;
       if (temp)
-	++(*temp);
+	*temp += weight;
       else
 	return;
     }
@@ -12659,26 +12959,34 @@ boost::statechart::result ReplicatedPG::TrimmingObjects::react(const SnapTrim&)
     }
   }
 
-  while (repops.size() < g_conf->osd_pg_max_concurrent_snap_trims) {
-    // Get next
-    hobject_t old_pos = pos;
-    int r = pg->snap_mapper.get_next_object_to_trim(snap_to_trim, &pos);
-    if (r != 0 && r != -ENOENT) {
-      derr << __func__ << ": get_next returned " << cpp_strerror(r) << dendl;
-      assert(0);
-    } else if (r == -ENOENT) {
-      // Done!
-      dout(10) << "TrimmingObjects: got ENOENT" << dendl;
-      post_event(SnapTrim());
-      return transit< WaitingOnReplicas >();
-    }
+  unsigned max = g_conf->osd_pg_max_concurrent_snap_trims;
+  if (repops.size() >= max)
+    return discard_event();
 
+  // fill the window with one pass over the snap mapper
+  vector<hobject_t> to_trim;
+  int r = pg->snap_mapper.get_next_objects_to_trim(
+    snap_to_trim, max - repops.size(), &to_trim);
+  if (r != 0 && r != -ENOENT) {
+    derr << __func__ << ": get_next returned " << cpp_strerror(r) << dendl;
+    assert(0);
+  } else if (r == -ENOENT) {
+    // Done!
+    dout(10) << "TrimmingObjects: got ENOENT" << dendl;
+    post_event(SnapTrim());
+    return transit< WaitingOnReplicas >();
+  }
+
+  for (vector<hobject_t>::iterator p = to_trim.begin();
+       p != to_trim.end();
+       ++p) {
+    pos = *p;
     dout(10) << "TrimmingObjects react trimming " << pos << dendl;
     RepGather *repop = pg->trim_object(pos);
     if (!repop) {
+      // the rest are picked up again next time
       dout(10) << __func__ << " could not get write lock on obj "
 	       << pos << dendl;
-      pos = old_pos;
       return discard_event();
     }
     assert(repop);
@@ -429,8 +429,18 @@ public:
     info.stats = stat;
   }
 
+  eversion_t get_min_last_complete_ondisk() const {
+    return min_last_complete_ondisk;
+  }
+  void update_replica_read_stable(
+    eversion_t stable) {
+    if (stable > replica_read_stable)
+      replica_read_stable = stable;
+  }
+
   void schedule_recovery_work(
     GenContext<ThreadPool::TPHandle&> *c);
+  void schedule_repop_batch_flush(double delay, Context *c);
 
   pg_shard_t whoami_shard() const {
     return pg_whoami;
@@ -600,6 +610,15 @@ public:
 
     bool release_snapset_obc;
 
+    /// for the log entry: what recovery may push instead of the object
+    bool has_dirty_extents;
+    interval_set<uint64_t> dirty_extents;
+
+    /// object store reads may run with the pg lock dropped
+    bool unlocked_read;
+    /// the pg was reset while the lock was dropped; the op is dead
+    bool reset_during_read;
+
     OpContext(OpRequestRef _op, osd_reqid_t _reqid, vector<OSDOp>& _ops,
 	      ObjectContextRef& obc,
 	      ReplicatedPG *_pg) :
@@ -621,7 +640,10 @@ public:
       inflightreads(0),
       lock_to_release(NONE),
       on_finish(NULL),
-      release_snapset_obc(false) {
+      release_snapset_obc(false),
+      has_dirty_extents(false),
+      unlocked_read(false),
+      reset_during_read(false) {
       if (obc->ssc) {
 	new_snapset = obc->ssc->snapset;
 	snapset = &obc->ssc->snapset;
@@ -643,7 +665,10 @@ public:
       inflightreads(0),
       lock_to_release(NONE),
       on_finish(NULL),
-      release_snapset_obc(false) { }
+      release_snapset_obc(false),
+      has_dirty_extents(false),
+      unlocked_read(false),
+      reset_during_read(false) { }
     void reset_obs(ObjectContextRef obc) {
       new_obs = ObjectState(obc->obs.oi, obc->obs.exists);
       if (obc->ssc) {
@@ -942,7 +967,7 @@ protected:
   ///
   /// @param oid [in] object name
   /// @param atime [out] seconds since last access (lower bound)
-  /// @param temperature [out] relative temperature (# hitset bins we appear in)
+  /// @param temperature [out] relative temperature (hitset bins we appear in, newer ones weighing more)
   void agent_estimate_atime_temp(const hobject_t& oid,
 				 int *atime, int *temperature);
 
@@ -1133,6 +1158,9 @@ protected:
   hobject_t last_backfill_started;
   bool new_backfill;
 
+  /// replica: committed on every shard up to here, as of the last repop
+  eversion_t replica_read_stable;
+
   int prep_object_replica_pushes(const hobject_t& soid, eversion_t v,
 				 PGBackend::RecoveryHandle *h);
 
@@ -1156,6 +1184,9 @@ protected:
     const hobject_t& head, const hobject_t& coid,
     object_info_t *poi);
   void execute_ctx(OpContext *ctx);
+  /// may the store reads of ctx run with the pg lock dropped?
+  bool can_read_unlocked(OpContext *ctx);
+  void record_dirty_extents(OpContext *ctx);
   void finish_ctx(OpContext *ctx, int log_op_type, bool maintain_ssc=true,
 		  bool scrub_ok=false);
   void reply_ctx(OpContext *ctx, int err);
@@ -1593,6 +1624,7 @@ public:
       !missing_loc.readable_with_acting(oid, actingset);
   }
   void maybe_kick_recovery(const hobject_t &soid);
+  bool repair_object_on_read(ObjectContextRef obc, OpRequestRef op);
   void wait_for_unreadable_object(const hobject_t& oid, OpRequestRef op);
   void wait_for_all_missing(OpRequestRef op);
 
@@ -1606,6 +1638,8 @@ public:
   void block_write_on_degraded_snap(const hobject_t& oid, OpRequestRef op);
 
   bool maybe_await_blocked_snapset(const hobject_t &soid, OpRequestRef op);
+  void cache_object_context(const ObjectContextRef &obc);
+  bool can_serve_replica_read(const hobject_t &soid);
   void wait_for_blocked_object(const hobject_t& soid, OpRequestRef op);
   void kick_object_context_blocked(ObjectContextRef obc);
 
@@ -1624,6 +1658,7 @@ public:
   void on_flushed();
   void on_removal(ObjectStore::Transaction *t);
   void on_shutdown();
+  void on_obc_cache_change();
 
   // attr cache handling
   void replace_cached_attrs(
@@ -244,33 +244,49 @@ int SnapMapper::get_next_object_to_trim(
   snapid_t snap,
   hobject_t *hoid)
 {
+  vector<hobject_t> out;
+  int r = get_next_objects_to_trim(snap, 1, &out);
+  if (r == 0 && hoid)
+    *hoid = out[0];
+  return r;
+}
+
+int SnapMapper::get_next_objects_to_trim(
+  snapid_t snap,
+  unsigned max,
+  vector<hobject_t> *out)
+{
+  assert(out);
+  assert(out->empty());
   for (set<string>::iterator i = prefixes.begin();
-       i != prefixes.end();
+       i != prefixes.end() && out->size() < max;
        ++i) {
-    string list_after(get_prefix(snap) + *i);
+    string prefix(get_prefix(snap) + *i);
+    string list_after(prefix);
 
-    pair<string, bufferlist> next;
-    int r = backend.get_next(list_after, &next);
-    if (r < 0) {
-      break; // Done
-    }
+    while (out->size() < max) {
+      pair<string, bufferlist> next;
+      int r = backend.get_next(list_after, &next);
+      if (r < 0) {
+	break; // Done
+      }
 
-    if (next.first.substr(0, list_after.size()) !=
-	list_after) {
-      continue; // Done with this prefix
-    }
+      if (next.first.substr(0, prefix.size()) !=
+	  prefix) {
+	break; // Done with this prefix
+      }
 
-    assert(is_mapping(next.first));
+      assert(is_mapping(next.first));
 
-    pair<snapid_t, hobject_t> next_decoded(from_raw(next));
-    assert(next_decoded.first == snap);
-    assert(check(next_decoded.second));
+      pair<snapid_t, hobject_t> next_decoded(from_raw(next));
+      assert(next_decoded.first == snap);
+      assert(check(next_decoded.second));
 
-    if (hoid)
-      *hoid = next_decoded.second;
-    return 0;
+      out->push_back(next_decoded.second);
+      list_after = next.first;
+    }
   }
-  return -ENOENT;
+  return out->empty() ? -ENOENT : 0;
 }
 
 
@@ -216,6 +216,13 @@ public:
     hobject_t *hoid             ///< [out] next hoid to trim
     );  ///< @return error, -ENOENT if no more objects
 
+  /// Returns up to max objects with snap as a snap, in one pass
+  int get_next_objects_to_trim(
+    snapid_t snap,              ///< [in] snap to check
+    unsigned max,               ///< [in] max number to get
+    vector<hobject_t> *out      ///< [out] next objects to trim (must be empty)
+    );  ///< @return error, -ENOENT if no more objects
+
   /// Remove mapping for oid
   int remove_oid(
     const hobject_t &oid,    ///< [in] oid to remove
@@ -104,16 +104,24 @@ void Notify::do_timeout()
   _watchers.swap(watchers);
   lock.Unlock();
 
+  // the watchers are normally all on one object, hence one pg: take
+  // each pg lock once rather than once per watcher
+  boost::intrusive_ptr<ReplicatedPG> pg;
   for (set<WatchRef>::iterator i = _watchers.begin();
        i != _watchers.end();
        ++i) {
-    boost::intrusive_ptr<ReplicatedPG> pg((*i)->get_pg());
-    pg->lock();
+    if ((*i)->get_pg() != pg) {
+      if (pg)
+	pg->unlock();
+      pg = (*i)->get_pg();
+      pg->lock();
+    }
     if (!(*i)->is_discarded()) {
       (*i)->cancel_notify(self.lock());
     }
-    pg->unlock();
   }
+  if (pg)
+    pg->unlock();
 }
 
 void Notify::register_cb()
@@ -216,8 +224,10 @@ void Notify::discard()
 void Notify::init()
 {
   Mutex::Locker l(lock);
-  register_cb();
   maybe_complete_notify();
+  // nobody to wait for: no timeout to arm and then cancel
+  if (!complete)
+    register_cb();
 }
 
 #define dout_subsys ceph_subsys_osd
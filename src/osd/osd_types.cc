@@ -1156,6 +1156,24 @@ uint32_t pg_pool_t::get_random_pg_position(pg_t pg, uint32_t seed) const
   return r;
 }
 
+/*
+ * Peers without cuckoo HitSet support fail to decode its params.  They
+ * are sized like a bloom filter's, so those peers get the bloom filter
+ * the OSDs would have used instead.
+ */
+static void encode_hit_set_params(const HitSet::Params& p, bufferlist& bl,
+				  uint64_t features)
+{
+  if (p.get_type() == HitSet::TYPE_CUCKOO &&
+      (features & CEPH_FEATURE_OSD_HITSET_CUCKOO) == 0) {
+    const BloomHitSet::Params *bp =
+      static_cast<const BloomHitSet::Params*>(p.impl.get());
+    ::encode(HitSet::Params(new BloomHitSet::Params(*bp)), bl);
+    return;
+  }
+  ::encode(p, bl);
+}
+
 void pg_pool_t::encode(bufferlist& bl, uint64_t features) const
 {
   if ((features & CEPH_FEATURE_PGPOOL3) == 0) {
@@ -1244,7 +1262,7 @@ void pg_pool_t::encode(bufferlist& bl, uint64_t features) const
     ::encode(read_tier, bl);
     ::encode(write_tier, bl);
     ::encode(properties, bl);
-    ::encode(hit_set_params, bl);
+    encode_hit_set_params(hit_set_params, bl, features);
     ::encode(hit_set_period, bl);
     ::encode(hit_set_count, bl);
     ::encode(stripe_width, bl);
@@ -1287,7 +1305,7 @@ void pg_pool_t::encode(bufferlist& bl, uint64_t features) const
   ::encode(read_tier, bl);
   ::encode(write_tier, bl);
   ::encode(properties, bl);
-  ::encode(hit_set_params, bl);
+  encode_hit_set_params(hit_set_params, bl, features);
   ::encode(hit_set_period, bl);
   ::encode(hit_set_count, bl);
   ::encode(stripe_width, bl);
@@ -1594,11 +1612,12 @@ void object_stat_sum_t::dump(Formatter *f) const
   f->dump_int("num_evict_mode_some", num_evict_mode_some);
   f->dump_int("num_evict_mode_full", num_evict_mode_full);
   f->dump_int("num_objects_pinned", num_objects_pinned);
+  f->dump_int("num_promote_throttled", num_promote_throttled);
 }
 
 void object_stat_sum_t::encode(bufferlist& bl) const
 {
-  ENCODE_START(14, 3, bl);
+  ENCODE_START(15, 3, bl);
   ::encode(num_bytes, bl);
   ::encode(num_objects, bl);
   ::encode(num_object_clones, bl);
@@ -1632,12 +1651,13 @@ void object_stat_sum_t::encode(bufferlist& bl) const
   ::encode(num_evict_mode_some, bl);
   ::encode(num_evict_mode_full, bl);
   ::encode(num_objects_pinned, bl);
+  ::encode(num_promote_throttled, bl);
   ENCODE_FINISH(bl);
 }
 
 void object_stat_sum_t::decode(bufferlist::iterator& bl)
 {
-  DECODE_START_LEGACY_COMPAT_LEN(14, 3, 3, bl);
+  DECODE_START_LEGACY_COMPAT_LEN(15, 3, 3, bl);
   ::decode(num_bytes, bl);
   if (struct_v < 3) {
     uint64_t num_kb;
@@ -1730,6 +1750,11 @@ void object_stat_sum_t::decode(bufferlist::iterator& bl)
   } else {
     num_objects_pinned = 0;
   }
+  if (struct_v >= 15) {
+    ::decode(num_promote_throttled, bl);
+  } else {
+    num_promote_throttled = 0;
+  }
   DECODE_FINISH(bl);
 }
 
@@ -1767,6 +1792,7 @@ void object_stat_sum_t::generate_test_instances(list<object_stat_sum_t*>& o)
   a.num_evict_mode_some = 1;
   a.num_evict_mode_full = 0;
   a.num_objects_pinned = 20;
+  a.num_promote_throttled = 21;
   o.push_back(new object_stat_sum_t(a));
 }
 
@@ -1805,6 +1831,7 @@ void object_stat_sum_t::add(const object_stat_sum_t& o)
   num_evict_mode_some += o.num_evict_mode_some;
   num_evict_mode_full += o.num_evict_mode_full;
   num_objects_pinned += o.num_objects_pinned;
+  num_promote_throttled += o.num_promote_throttled;
 }
 
 void object_stat_sum_t::sub(const object_stat_sum_t& o)
@@ -1842,6 +1869,7 @@ void object_stat_sum_t::sub(const object_stat_sum_t& o)
   num_evict_mode_some -= o.num_evict_mode_some;
   num_evict_mode_full -= o.num_evict_mode_full;
   num_objects_pinned -= o.num_objects_pinned;
+  num_promote_throttled -= o.num_promote_throttled;
 }
 
 bool operator==(const object_stat_sum_t& l, const object_stat_sum_t& r)
@@ -1879,7 +1907,8 @@ bool operator==(const object_stat_sum_t& l, const object_stat_sum_t& r)
     l.num_flush_mode_low == r.num_flush_mode_low &&
     l.num_evict_mode_some == r.num_evict_mode_some &&
     l.num_evict_mode_full == r.num_evict_mode_full &&
-    l.num_objects_pinned == r.num_objects_pinned;
+    l.num_objects_pinned == r.num_objects_pinned &&
+    l.num_promote_throttled == r.num_promote_throttled;
 }
 
 // -- object_stat_collection_t --
@@ -3140,7 +3169,7 @@ void pg_log_entry_t::decode_with_checksum(bufferlist::iterator& p)
 
 void pg_log_entry_t::encode(bufferlist &bl) const
 {
-  ENCODE_START(10, 4, bl);
+  ENCODE_START(11, 4, bl);
   ::encode(op, bl);
   ::encode(soid, bl);
   ::encode(version, bl);
@@ -3165,12 +3194,14 @@ void pg_log_entry_t::encode(bufferlist &bl) const
   ::encode(user_version, bl);
   ::encode(mod_desc, bl);
   ::encode(extra_reqids, bl);
+  ::encode(has_dirty_extents, bl);
+  ::encode(dirty_extents, bl);
   ENCODE_FINISH(bl);
 }
 
 void pg_log_entry_t::decode(bufferlist::iterator &bl)
 {
-  DECODE_START_LEGACY_COMPAT_LEN(10, 4, 4, bl);
+  DECODE_START_LEGACY_COMPAT_LEN(11, 4, 4, bl);
   ::decode(op, bl);
   if (struct_v < 2) {
     sobject_t old_soid;
@@ -3219,6 +3250,12 @@ void pg_log_entry_t::decode(bufferlist::iterator &bl)
     mod_desc.mark_unrollbackable();
   if (struct_v >= 10)
     ::decode(extra_reqids, bl);
+  if (struct_v >= 11) {
+    ::decode(has_dirty_extents, bl);
+    ::decode(dirty_extents, bl);
+  } else {
+    has_dirty_extents = false;
+  }
 
   DECODE_FINISH(bl);
 }
@@ -3242,6 +3279,8 @@ void pg_log_entry_t::dump(Formatter *f) const
   }
   f->close_section();
   f->dump_stream("mtime") << mtime;
+  if (has_dirty_extents)
+    f->dump_stream("dirty_extents") << dirty_extents;
   if (snaps.length() > 0) {
     vector<snapid_t> v;
     bufferlist c = snaps;
@@ -3270,6 +3309,9 @@ void pg_log_entry_t::generate_test_instances(list<pg_log_entry_t*>& o)
   o.push_back(new pg_log_entry_t(MODIFY, oid, eversion_t(1,2), eversion_t(3,4),
 				 1, osd_reqid_t(entity_name_t::CLIENT(777), 8, 999),
 				 utime_t(8,9)));
+  o.push_back(new pg_log_entry_t(*o.back()));
+  o.back()->has_dirty_extents = true;
+  o.back()->dirty_extents.insert(4096, 4096);
 }
 
 ostream& operator<<(ostream& out, const pg_log_entry_t& e)
@@ -32,6 +32,7 @@
 #include "include/CompatSet.h"
 #include "common/histogram.h"
 #include "include/interval_set.h"
+#include "include/mempool.h"
 #include "common/Formatter.h"
 #include "common/bloom_filter.hpp"
 #include "common/hobject.h"
@@ -699,6 +700,13 @@ public:
     ::encode(version, bl);
     ::encode(epoch, bl);
   }
+  void bound_encode(size_t &s) const {
+    s += sizeof(ceph_le64) + sizeof(ceph_le32);
+  }
+  void encode(bounded_encoder &p) const {
+    ::encode(version, p);
+    ::encode(epoch, p);
+  }
   void decode(bufferlist::iterator &bl) {
     ::decode(version, bl);
     ::decode(epoch, bl);
@@ -708,7 +716,7 @@ public:
     decode(p);
   }
 };
-WRITE_CLASS_ENCODER(eversion_t)
+WRITE_CLASS_ENCODER_BOUNDED(eversion_t)
 
 inline bool operator==(const eversion_t& l, const eversion_t& r) {
   return (l.epoch == r.epoch) && (l.version == r.version);
@@ -924,6 +932,7 @@ struct pg_pool_t {
     FLAG_WRITE_FADVISE_DONTNEED = 1<<7, // write mode with LIBRADOS_OP_FLAG_FADVISE_DONTNEED
     FLAG_NOSCRUB = 1<<8, // block periodic scrub
     FLAG_NODEEP_SCRUB = 1<<9, // block periodic deep-scrub
+    FLAG_EC_OVERWRITES = 1<<10, // allow partial-stripe overwrites on an ec pool
   };
 
   static const char *get_flag_name(int f) {
@@ -938,6 +947,7 @@ struct pg_pool_t {
     case FLAG_WRITE_FADVISE_DONTNEED: return "write_fadvise_dontneed";
     case FLAG_NOSCRUB: return "noscrub";
     case FLAG_NODEEP_SCRUB: return "nodeep-scrub";
+    case FLAG_EC_OVERWRITES: return "ec_overwrites";
     default: return "???";
     }
   }
@@ -976,6 +986,8 @@ struct pg_pool_t {
       return FLAG_NOSCRUB;
     if (name == "nodeep-scrub")
       return FLAG_NODEEP_SCRUB;
+    if (name == "ec_overwrites")
+      return FLAG_EC_OVERWRITES;
     return 0;
   }
 
@@ -1359,6 +1371,7 @@ struct object_stat_sum_t {
   int32_t num_evict_mode_some;  // 1 when in evict some mode, otherwise 0
   int32_t num_evict_mode_full;  // 1 when in evict full mode, otherwise 0
   int64_t num_objects_pinned;
+  int64_t num_promote_throttled;  ///< promotions skipped for the osd's budget
 
   object_stat_sum_t()
     : num_bytes(0),
@@ -1384,7 +1397,8 @@ struct object_stat_sum_t {
       num_promote(0),
       num_flush_mode_high(0), num_flush_mode_low(0),
       num_evict_mode_some(0), num_evict_mode_full(0),
-      num_objects_pinned(0)
+      num_objects_pinned(0),
+      num_promote_throttled(0)
   {}
 
   void floor(int64_t f) {
@@ -1422,6 +1436,7 @@ struct object_stat_sum_t {
     FLOOR(num_evict_mode_some);
     FLOOR(num_evict_mode_full);
     FLOOR(num_objects_pinned);
+    FLOOR(num_promote_throttled);
 #undef FLOOR
   }
 
@@ -1467,6 +1482,7 @@ struct object_stat_sum_t {
     SPLIT(num_evict_mode_some);
     SPLIT(num_evict_mode_full);
     SPLIT(num_objects_pinned);
+    SPLIT(num_promote_throttled);
 #undef SPLIT
   }
 
@@ -2259,8 +2275,11 @@ public:
    * message buffer
    */
   void trim_bl() {
-    if (bl.length() > 0)
+    if (bl.length() > 0) {
       bl.rebuild();
+      // this copy lives on in the in-memory pg log
+      bl.reassign_to_pool(buffer::POOL_OSD);
+    }
   }
   void encode(bufferlist &bl) const;
   void decode(bufferlist::iterator &bl);
@@ -2331,9 +2350,14 @@ struct pg_log_entry_t {
 
   vector<pair<osd_reqid_t, version_t> > extra_reqids;
 
+  /// if set, the entry changed no data outside dirty_extents (and no omap)
+  bool has_dirty_extents;
+  interval_set<uint64_t> dirty_extents;
+
   pg_log_entry_t()
     : op(0), user_version(0),
-      invalid_hash(false), invalid_pool(false), offset(0) {}
+      invalid_hash(false), invalid_pool(false), offset(0),
+      has_dirty_extents(false) {}
   pg_log_entry_t(int _op, const hobject_t& _soid, 
 		 const eversion_t& v, const eversion_t& pv,
 		 version_t uv,
@@ -2341,7 +2365,7 @@ struct pg_log_entry_t {
     : op(_op), soid(_soid), version(v),
       prior_version(pv), user_version(uv),
       reqid(rid), mtime(mt), invalid_hash(false), invalid_pool(false),
-      offset(0) {}
+      offset(0), has_dirty_extents(false) {}
       
   bool is_clone() const { return op == CLONE; }
   bool is_modify() const { return op == MODIFY; }
@@ -3185,6 +3209,8 @@ struct ObjectContext;
 typedef ceph::shared_ptr<ObjectContext> ObjectContextRef;
 
 struct ObjectContext {
+  MEMPOOL_CLASS_HELPERS(osd_obc);
+
   ObjectState obs;
 
   SnapSetContext *ssc;  // may be null
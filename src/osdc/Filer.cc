@@ -226,18 +226,26 @@ bool Filer::_probed(Probe *probe, const object_t& oid, uint64_t size, utime_t mt
 
   if (!probe->found_size || (probe->probing_off && probe->pmtime)) {
     // keep probing!
-    ldout(cct, 10) << "_probed probing further" << dendl;
-
     uint64_t period = (uint64_t)probe->layout.fl_stripe_count * (uint64_t)probe->layout.fl_object_size;
+
+    // a big file takes many rounds: double the periods probed per
+    // round, as far as filer_max_probe_ops allows
+    uint64_t max_periods = cct->_conf->filer_max_probe_ops / probe->layout.fl_stripe_count;
+    if (max_periods < 1)
+      max_periods = 1;
+    probe->probing_periods = MIN(probe->probing_periods * 2, max_periods);
+    ldout(cct, 10) << "_probed probing further, " << probe->probing_periods
+		   << " periods" << dendl;
+
     if (probe->fwd) {
       probe->probing_off += probe->probing_len;
       assert(probe->probing_off % period == 0);
-      probe->probing_len = period;
+      probe->probing_len = probe->probing_periods * period;
     } else {
-      // previous period.
+      // previous period(s).
       assert(probe->probing_off % period == 0);
-      probe->probing_len = period;
-      probe->probing_off -= period;
+      probe->probing_len = MIN(probe->probing_periods * period, probe->probing_off);
+      probe->probing_off -= probe->probing_len;
     }
     _probe(probe);
     assert(!probe->lock.is_locked_by_me());
@@ -265,11 +273,15 @@ struct PurgeRange {
   int flags;
   Context *oncommit;
   int uncommitted;
+  int max_in_flight;   // current window
+  int acked;           // completions since the window last grew
+  utime_t last_backoff;
   PurgeRange(inodeno_t i, ceph_file_layout& l, const SnapContext& sc,
-	     uint64_t fo, uint64_t no, utime_t t, int fl, Context *fin) :
+	     uint64_t fo, uint64_t no, utime_t t, int fl, Context *fin,
+	     int max) :
 	  lock("Filer::PurgeRange"), ino(i), layout(l), snapc(sc),
 	  first(fo), num(no), mtime(t), flags(fl), oncommit(fin),
-	  uncommitted(0) {}
+	  uncommitted(0), max_in_flight(max), acked(0) {}
 };
 
 int Filer::purge_range(inodeno_t ino,
@@ -293,7 +305,8 @@ int Filer::purge_range(inodeno_t ino,
   }
 
   PurgeRange *pr = new PurgeRange(ino, *layout, snapc, first_obj,
-				  num_obj, mtime, flags, oncommit);
+				  num_obj, mtime, flags, oncommit,
+				  MAX(1, (int)cct->_conf->filer_max_purge_ops));
 
   _do_purge_range(pr, 0);
   return 0;
@@ -302,18 +315,39 @@ int Filer::purge_range(inodeno_t ino,
 struct C_PurgeRange : public Context {
   Filer *filer;
   PurgeRange *pr;
-  C_PurgeRange(Filer *f, PurgeRange *p) : filer(f), pr(p) {}
+  utime_t issued;
+  C_PurgeRange(Filer *f, PurgeRange *p, utime_t i) : filer(f), pr(p), issued(i) {}
   void finish(int r) {
-    filer->_do_purge_range(pr, 1);
+    filer->_do_purge_range(pr, 1, issued);
   }
 };
 
-void Filer::_do_purge_range(PurgeRange *pr, int fin)
+void Filer::_do_purge_range(PurgeRange *pr, int fin, utime_t issued)
 {
+  utime_t now = ceph_clock_now(cct);
   pr->lock.Lock();
   pr->uncommitted -= fin;
+
+  // additive increase, multiplicative decrease on the delete latency;
+  // only deletes issued after the last back off can cause another
+  double target = cct->_conf->filer_purge_latency_target;
+  if (fin && target > 0) {
+    if ((double)(now - issued) > target) {
+      if (issued > pr->last_backoff && pr->max_in_flight > 1) {
+	pr->max_in_flight /= 2;
+	pr->acked = 0;
+	pr->last_backoff = now;
+      }
+    } else if (++pr->acked >= pr->max_in_flight &&
+	       pr->max_in_flight < (int)cct->_conf->filer_purge_ops_ceiling) {
+      pr->max_in_flight++;
+      pr->acked = 0;
+    }
+  }
+
   ldout(cct, 10) << "_do_purge_range " << pr->ino << " objects " << pr->first << "~" << pr->num
-	   << " uncommitted " << pr->uncommitted << dendl;
+	   << " uncommitted " << pr->uncommitted
+	   << " max_in_flight " << pr->max_in_flight << dendl;
 
   if (pr->num == 0 && pr->uncommitted == 0) {
     pr->oncommit->complete(0);
@@ -324,7 +358,7 @@ void Filer::_do_purge_range(PurgeRange *pr, int fin)
 
   std::vector<object_t> remove_oids;
 
-  int max = cct->_conf->filer_max_purge_ops - pr->uncommitted;
+  int max = pr->max_in_flight - pr->uncommitted;
   while (pr->num > 0 && max > 0) {
     remove_oids.push_back(file_object_t(pr->ino, pr->first));
     pr->uncommitted++;
@@ -342,7 +376,7 @@ void Filer::_do_purge_range(PurgeRange *pr, int fin)
     const object_locator_t oloc = osdmap->file_to_object_locator(pr->layout);
     objecter->put_osdmap_read();
     objecter->remove(oid, oloc, pr->snapc, pr->mtime, pr->flags, NULL,
-		     new C_OnFinisher(new C_PurgeRange(this, pr), finisher));
+		     new C_OnFinisher(new C_PurgeRange(this, pr, now), finisher));
   }
 }
 
@@ -63,6 +63,7 @@ class Filer {
     
     vector<ObjectExtent> probing;
     uint64_t probing_off, probing_len;
+    uint64_t probing_periods;  // periods per round after the first
     
     map<object_t, uint64_t> known_size;
     utime_t max_mtime;
@@ -76,7 +77,7 @@ class Filer {
 	  uint64_t f, uint64_t *e, utime_t *m, int fl, bool fw, Context *c) : 
       lock("Filer::Probe"), ino(i), layout(l), snapid(sn),
       psize(e), pmtime(m), flags(fl), fwd(fw), onfinish(c),
-      probing_off(f), probing_len(0),
+      probing_off(f), probing_len(0), probing_periods(1),
       err(0), found_size(false) {}
   };
   
@@ -273,7 +274,8 @@ class Filer {
 		  utime_t mtime,
 		  int flags,
 		  Context *oncommit);
-  void _do_purge_range(struct PurgeRange *pr, int fin);
+  void _do_purge_range(struct PurgeRange *pr, int fin,
+		       utime_t issued=utime_t());
 
   /*
    * probe 
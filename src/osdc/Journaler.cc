@@ -32,6 +32,7 @@ void Journaler::set_readonly()
 
   ldout(cct, 1) << "set_readonly" << dendl;
   readonly = true;
+  _set_fetch_len();
 }
 
 void Journaler::set_writeable()
@@ -40,6 +41,7 @@ void Journaler::set_writeable()
 
   ldout(cct, 1) << "set_writeable" << dendl;
   readonly = false;
+  _set_fetch_len();
 }
 
 void Journaler::create(ceph_file_layout *l, stream_format_t const sf)
@@ -75,9 +77,18 @@ void Journaler::_set_layout(ceph_file_layout const *l)
   last_written.layout = layout;
   last_committed.layout = layout;
 
+  _set_fetch_len();
+}
+
+void Journaler::_set_fetch_len()
+{
   // prefetch intelligently.
   // (watch out, this is big if you use big objects or weird striping)
-  uint64_t periods = cct->_conf->journaler_prefetch_periods;
+  // a read-only journaler is replaying (or standby-replaying) the whole
+  // journal, and nothing else is competing for its memory yet, so it
+  // reads further ahead.
+  uint64_t periods = readonly ? cct->_conf->journaler_replay_prefetch_periods :
+    cct->_conf->journaler_prefetch_periods;
   if (periods < 2)
     periods = 2;  // we need at least 2 periods to make progress.
   fetch_len = layout.fl_stripe_count * layout.fl_object_size * periods;
@@ -511,6 +522,12 @@ void Journaler::_finish_flush(int r, uint64_t start, utime_t stamp)
     finish_contexts(cct, waitfor_safe.begin()->second);
     waitfor_safe.erase(waitfor_safe.begin());
   }
+
+  // send what queued up behind the writes that just committed
+  if (flush_deferred && pending_safe.empty()) {
+    flush_deferred = false;
+    _do_flush();
+  }
 }
 
 
@@ -684,9 +701,18 @@ void Journaler::_flush(C_OnFinisher *onsafe)
     if (onsafe) {
       onsafe->complete(0);
     }
+  } else if (!pending_safe.empty() &&
+	     write_buf.length() < cct->_conf->journaler_batch_max) {
+    // group commit: a write is already in flight, so let this one pick
+    // up whatever else is appended before that commits
+    ldout(cct, 20) << "flush deferring flush behind " << pending_safe.size()
+		   << " in flight" << dendl;
+    flush_deferred = true;
+    _wait_for_flush(onsafe);
   } else {
     // maybe buffer
-    if (write_buf.length() < cct->_conf->journaler_batch_max) {
+    if (cct->_conf->journaler_batch_interval > 0 &&
+	write_buf.length() < cct->_conf->journaler_batch_max) {
       // delay!  schedule an event.
       ldout(cct, 20) << "flush delaying flush" << dendl;
       if (delay_flush_event) {
@@ -242,6 +242,8 @@ private:
     delay_flush_event = NULL;
     _do_flush();
   }
+  /// a flush was asked for while a write was in flight; do it when that commits
+  bool flush_deferred;
 
   // my state
   static const int STATE_UNDEF = 0;
@@ -266,6 +268,7 @@ private:
 
   void _reread_head(Context *onfinish);
   void _set_layout(ceph_file_layout const *l);
+  void _set_fetch_len();
   list<Context*> waitfor_recover;
   void _read_head(Context *on_finish, bufferlist *bl);
   void _finish_read_head(int r, bufferlist& bl);
@@ -382,7 +385,7 @@ public:
     stream_format(-1), journal_stream(-1),
     magic(mag),
     objecter(obj), filer(objecter, f), logger(l), logger_key_lat(lkey),
-    timer(tim), delay_flush_event(0),
+    timer(tim), delay_flush_event(0), flush_deferred(false),
     state(STATE_UNDEF), error(0),
     prezeroing_pos(0), prezero_pos(0), write_pos(0), flush_pos(0), safe_pos(0),
     waiting_for_zero(false),
@@ -406,6 +409,7 @@ public:
 
     readonly = true;
     delay_flush_event = NULL;
+    flush_deferred = false;
     state = STATE_UNDEF;
     error = 0;
     prezeroing_pos = 0;
@@ -12,6 +12,7 @@
 #include "include/assert.h"
 
 #define MAX_FLUSH_UNDER_LOCK 20  ///< max bh's we start writeback on while holding the lock
+#define MAX_BH_POOL 1024  ///< max freed bh's we keep around for reuse
 
 /*** ObjectCacher::BufferHead ***/
 
@@ -30,11 +31,12 @@ ObjectCacher::BufferHead *ObjectCacher::Object::split(BufferHead *left, loff_t o
   ldout(oc->cct, 20) << "split " << *left << " at " << off << dendl;
   
   // split off right
-  ObjectCacher::BufferHead *right = new BufferHead(this);
+  ObjectCacher::BufferHead *right = oc->new_bh(this);
 
   //inherit and if later access, this auto clean.
   right->set_dontneed(left->get_dontneed());
   right->set_nocache(left->get_nocache());
+  right->set_hot(left->is_hot());
 
   right->last_write_tid = left->last_write_tid;
   right->last_read_tid = left->last_read_tid;
@@ -114,7 +116,7 @@ void ObjectCacher::Object::merge_left(BufferHead *left, BufferHead *right)
                                          p->second );
   
   // hose right
-  delete right;
+  oc->delete_bh(right);
 
   ldout(oc->cct, 10) << "merge_left result " << *left << dendl;
 }
@@ -224,7 +226,7 @@ int ObjectCacher::Object::map_read(OSDRead *rd,
       // at end?
       if (p == data.end()) {
         // rest is a miss.
-        BufferHead *n = new BufferHead(this);
+        BufferHead *n = oc->new_bh(this);
         n->set_start(cur);
         n->set_length(left);
         oc->bh_add(this, n);
@@ -270,7 +272,7 @@ int ObjectCacher::Object::map_read(OSDRead *rd,
       } else if (p->first > cur) {
         // gap.. miss
         loff_t next = p->first;
-        BufferHead *n = new BufferHead(this);
+        BufferHead *n = oc->new_bh(this);
 	loff_t len = MIN(next - cur, left);
         n->set_start(cur);
 	n->set_length(len);
@@ -357,7 +359,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::map_write(OSDWrite *wr)
       // at end ?
       if (p == data.end()) {
         if (final == NULL) {
-          final = new BufferHead(this);
+          final = oc->new_bh(this);
           final->set_start( cur );
           final->set_length( max );
           oc->bh_add(this, final);
@@ -428,7 +430,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::map_write(OSDWrite *wr)
           final->set_length(final->length() + glen);
 	  oc->bh_stat_add(final);
         } else {
-          final = new BufferHead(this);
+          final = oc->new_bh(this);
           final->set_start( cur );
           final->set_length( glen );
           oc->bh_add(this, final);
@@ -468,7 +470,7 @@ void ObjectCacher::Object::truncate(loff_t s)
     assert(bh->start() >= s);
     assert(bh->waitfor_read.empty());
     oc->bh_remove(this, bh);
-    delete bh;
+    oc->delete_bh(bh);
   }
 }
 
@@ -508,7 +510,7 @@ void ObjectCacher::Object::discard(loff_t off, loff_t len)
     ldout(oc->cct, 10) << "discard " << *this << " bh " << *bh << dendl;
     assert(bh->waitfor_read.empty());
     oc->bh_remove(this, bh);
-    delete bh;
+    oc->delete_bh(bh);
   }
 }
 
@@ -532,10 +534,10 @@ ObjectCacher::ObjectCacher(CephContext *cct_, string name, WritebackHandler& wb,
     max_size(max_bytes), max_objects(max_objects),
     block_writes_upfront(block_writes_upfront),
     flush_set_callback(flush_callback), flush_set_callback_arg(flush_callback_arg),
-    last_read_tid(0),
+    last_read_tid(0), policy(POLICY_LRU), stat_ghost(0),
     flusher_stop(false), flusher_thread(this), finisher(cct),
     stat_clean(0), stat_zero(0), stat_dirty(0), stat_rx(0), stat_tx(0), stat_missing(0),
-    stat_error(0), stat_dirty_waiting(0), reads_outstanding(0)
+    stat_error(0), stat_dirty_waiting(0), stat_nr_bh(0), stat_hot(0), reads_outstanding(0)
 {
   this->max_dirty_age.set_from_double(max_dirty_age);
   perf_start();
@@ -552,9 +554,13 @@ ObjectCacher::~ObjectCacher()
       ++i)
     assert(i->empty());
   assert(bh_lru_rest.lru_get_size() == 0);
+  assert(bh_lru_hot.lru_get_size() == 0);
   assert(bh_lru_dirty.lru_get_size() == 0);
   assert(ob_lru.lru_get_size() == 0);
   assert(dirty_or_tx_bh.empty());
+  assert(stat_nr_bh == 0);
+  for (vector<void*>::iterator p = bh_pool.begin(); p != bh_pool.end(); ++p)
+    ::operator delete(*p);
 }
 
 void ObjectCacher::perf_start()
@@ -574,6 +580,8 @@ void ObjectCacher::perf_start()
   plb.add_u64_counter(l_objectcacher_write_ops_blocked, "write_ops_blocked", "Write operations, delayed due to dirty limits");
   plb.add_u64_counter(l_objectcacher_write_bytes_blocked, "write_bytes_blocked", "Write data blocked on dirty limit");
   plb.add_time(l_objectcacher_write_time_blocked, "write_time_blocked", "Time spent blocking a write due to dirty limits");
+  plb.add_u64_counter(l_objectcacher_cache_ghost_hits, "cache_ghost_hits", "Misses on recently evicted data");
+  plb.add_u64_counter(l_objectcacher_cache_promoted, "cache_promoted", "Data moved to the hot list");
 
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
@@ -732,7 +740,7 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 	    // current iterator will be invalidated by bh_remove()
 	    ++p;
 	    bh_remove(ob, bh);
-	    delete bh;
+	    delete_bh(bh);
 	  }
 	}
       }
@@ -796,7 +804,7 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 	if (trust_enoent) {
 	  ldout(cct, 10) << "bh_read_finish removing " << *bh << dendl;
 	  bh_remove(ob, bh);
-	  delete bh;
+	  delete_bh(bh);
 	} else {
 	  ldout(cct, 10) << "skipping unstrusted -ENOENT and will retry for "
 			 << *bh << dendl;
@@ -811,6 +819,7 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 	bh->bl.substr_of(bl,
 			 oldpos-bh->start(),
 			 bh->length());
+	bh->bl.reassign_to_pool(buffer::POOL_OBJECTCACHER);
 	mark_clean(bh);
       }
 
@@ -921,7 +930,7 @@ void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid, loff_t start,
 	// ok!  mark bh clean and error-free
 	mark_clean(bh);
 	if (bh->get_nocache())
-	  bh_lru_rest.lru_bottouch(bh);
+	  bh_lru_bottouch(bh);
 	hit.push_back(bh);
 	ldout(cct, 10) << "bh_write_commit clean " << *bh << dendl;
       } else {
@@ -965,7 +974,7 @@ void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid, loff_t start,
   }
 }
 
-void ObjectCacher::flush(loff_t amount)
+bool ObjectCacher::flush(loff_t amount, int max_bhs)
 {
   assert(lock.is_locked());
   utime_t cutoff = ceph_clock_now(cct);
@@ -978,14 +987,18 @@ void ObjectCacher::flush(loff_t amount)
    * can call lru_dirty.lru_get_next_expire() again.
    */
   loff_t did = 0;
+  int n = 0;
   while (amount == 0 || did < amount) {
     BufferHead *bh = static_cast<BufferHead*>(bh_lru_dirty.lru_get_next_expire());
     if (!bh) break;
     if (bh->last_write > cutoff) break;
+    if (max_bhs && n++ == max_bhs)
+      return false;
 
     did += bh->length();
     bh_write(bh);
-  }    
+  }
+  return true;
 }
 
 
@@ -993,11 +1006,24 @@ void ObjectCacher::trim()
 {
   assert(lock.is_locked());
   ldout(cct, 10) << "trim  start: bytes: max " << max_size << "  clean " << get_stat_clean()
+		 << " overhead " << get_stat_overhead()
 		 << ", objects: max " << max_objects << " current " << ob_lru.lru_get_size()
 		 << dendl;
 
-  while (get_stat_clean() > 0 && (uint64_t) get_stat_clean() > max_size) {
-    BufferHead *bh = static_cast<BufferHead*>(bh_lru_rest.lru_expire());
+  while (get_stat_clean() > 0 &&
+	 (uint64_t) get_stat_clean() + get_stat_overhead() > max_size) {
+    BufferHead *bh = NULL;
+    // 2q: the probation lru gets a quarter of the cache, the hot lru the rest
+    if (policy == POLICY_2Q &&
+	get_stat_clean() + get_stat_zero() - stat_hot < (loff_t)(max_size / 4))
+      bh = static_cast<BufferHead*>(bh_lru_hot.lru_expire());
+    if (!bh) {
+      bh = static_cast<BufferHead*>(bh_lru_rest.lru_expire());
+      if (bh && policy == POLICY_2Q)
+	ghost_add(bh);
+    }
+    if (!bh)
+      bh = static_cast<BufferHead*>(bh_lru_hot.lru_expire());
     if (!bh)
       break;
 
@@ -1006,7 +1032,7 @@ void ObjectCacher::trim()
 
     Object *ob = bh->ob;
     bh_remove(ob, bh);
-    delete bh;
+    delete_bh(bh);
 
     if (ob->complete) {
       ldout(cct, 10) << "trim clearing complete on " << *ob << dendl;
@@ -1175,7 +1201,7 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 	  }
 
 	  bh_remove(o, bh_it->second);
-	  delete bh_it->second;
+	  delete_bh(bh_it->second);
 	} else {
 	  bh_it->second->set_nocache(nocache);
 	  bh_read(bh_it->second, rd->fadvise_flags);
@@ -1209,7 +1235,7 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 
       for (map<loff_t, BufferHead*>::iterator bh_it = hits.begin();
            bh_it != hits.end();  ++bh_it)
-	touch_bh(bh_it->second); //bump in lru, so we don't lose it when later read
+	touch_bh(bh_it->second, external_call); //bump in lru, so we don't lose it when later read
 
     } else {
       assert(!hits.empty());
@@ -1225,15 +1251,15 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
         bytes_in_cache += bh->length();
 
 	if (bh->get_nocache() && bh->is_clean())
-	  bh_lru_rest.lru_bottouch(bh);
+	  bh_lru_bottouch(bh);
 	else
-	  touch_bh(bh);
+	  touch_bh(bh, external_call);
 	//must be after touch_bh because touch_bh set dontneed false
 	if (dontneed &&
 	    ((loff_t)ex_it->offset <= bh->start() && (bh->end() <= (loff_t)(ex_it->offset + ex_it->length)))) {
 	  bh->set_dontneed(true); //if dirty
 	  if (bh->is_clean())
-	    bh_lru_rest.lru_bottouch(bh);
+	    bh_lru_bottouch(bh);
 	}
       }
 
@@ -1413,6 +1439,7 @@ int ObjectCacher::writex(OSDWrite *wr, ObjectSet *oset, Context *onfreespace)
       if (bhoff)
 	newbl.substr_of(bh->bl, 0, bhoff);
       newbl.claim_append(frag);
+      newbl.reassign_to_pool(buffer::POOL_OBJECTCACHER);
       bh->bl.swap(newbl);
 
       opos += f_it->second;
@@ -1554,7 +1581,14 @@ void ObjectCacher::flusher_entry()
 		     << " dirty_waiting > target "
 		     << target_dirty
 		     << ", flushing some dirty bhs" << dendl;
-      flush(actual - target_dirty);
+      if (!flush(actual - target_dirty, MAX_FLUSH_UNDER_LOCK)) {
+	// back off the lock to avoid starving readers and writers
+	lock.Unlock();
+        writeback_handler.put_client_lock();
+        writeback_handler.get_client_lock();
+	lock.Lock();
+	continue;
+      }
     } else {
       // check tail of lru for old dirty items
       utime_t cutoff = ceph_clock_now(cct);
@@ -1732,31 +1766,22 @@ bool ObjectCacher::flush_set(ObjectSet *oset, Context *onfinish)
 
   // we'll need to wait for all objects to flush!
   C_GatherBuilder gather(cct);
-  set<Object*> waitfor_commit;
-
-  set<BufferHead*>::iterator next, it;
-  next = it = dirty_or_tx_bh.begin();
-  while (it != dirty_or_tx_bh.end()) {
-    ++next;
-    BufferHead *bh = *it;
-    waitfor_commit.insert(bh->ob);
-
-    if (bh->is_dirty())
-      bh_write(bh);
-
-    it = next;
-  }
 
-  for (set<Object*>::iterator i = waitfor_commit.begin();
-       i != waitfor_commit.end(); ++i) {
+  // only this set's objects: an fsync of one file must not write back
+  // (and wait for) everything dirty in the cache
+  for (xlist<Object*>::iterator i = oset->objects.begin(); !i.end(); ++i) {
     Object *ob = *i;
+    if (ob->dirty_or_tx == 0)
+      continue;
 
-    // we'll need to gather...
-    ldout(cct, 10) << "flush_set " << oset << " will wait for ack tid "
-             << ob->last_write_tid
-             << " on " << *ob
-             << dendl;
-    ob->waitfor_commit[ob->last_write_tid].push_back(gather.new_sub());
+    if (!flush(ob, 0, 0)) {
+      // we'll need to gather...
+      ldout(cct, 10) << "flush_set " << oset << " will wait for ack tid "
+	       << ob->last_write_tid
+	       << " on " << *ob
+	       << dendl;
+      ob->waitfor_commit[ob->last_write_tid].push_back(gather.new_sub());
+    }
   }
 
   return _flush_set_finish(&gather, onfinish);
@@ -2063,6 +2088,8 @@ void ObjectCacher::verify_stats() const
 void ObjectCacher::bh_stat_add(BufferHead *bh)
 {
   assert(lock.is_locked());
+  if (bh->is_hot() && !bh->is_dirty())
+    stat_hot += bh->length();
   switch (bh->get_state()) {
   case BufferHead::STATE_MISSING:
     stat_missing += bh->length();
@@ -2099,6 +2126,8 @@ void ObjectCacher::bh_stat_add(BufferHead *bh)
 void ObjectCacher::bh_stat_sub(BufferHead *bh)
 {
   assert(lock.is_locked());
+  if (bh->is_hot() && !bh->is_dirty())
+    stat_hot -= bh->length();
   switch (bh->get_state()) {
   case BufferHead::STATE_MISSING:
     stat_missing -= bh->length();
@@ -2136,14 +2165,11 @@ void ObjectCacher::bh_set_state(BufferHead *bh, int s)
   int state = bh->get_state();
   // move between lru lists?
   if (s == BufferHead::STATE_DIRTY && state != BufferHead::STATE_DIRTY) {
-    bh_lru_rest.lru_remove(bh);
+    bh_lru_remove(bh);
     bh_lru_dirty.lru_insert_top(bh);
   } else if (s != BufferHead::STATE_DIRTY && state == BufferHead::STATE_DIRTY) {
     bh_lru_dirty.lru_remove(bh);
-    if (bh->get_dontneed())
-      bh_lru_rest.lru_insert_bot(bh);
-    else
-      bh_lru_rest.lru_insert_top(bh);
+    bh_lru_insert(bh);
   }
 
   if ((s == BufferHead::STATE_TX ||
@@ -2168,6 +2194,125 @@ void ObjectCacher::bh_set_state(BufferHead *bh, int s)
   bh_stat_add(bh);
 }
 
+ObjectCacher::BufferHead *ObjectCacher::new_bh(Object *ob)
+{
+  assert(lock.is_locked());
+  void *p;
+  if (bh_pool.empty()) {
+    p = ::operator new(sizeof(BufferHead));
+  } else {
+    p = bh_pool.back();
+    bh_pool.pop_back();
+  }
+  ++stat_nr_bh;
+  return new (p) BufferHead(ob);
+}
+
+void ObjectCacher::delete_bh(BufferHead *bh)
+{
+  assert(lock.is_locked());
+  assert(stat_nr_bh > 0);
+  --stat_nr_bh;
+  bh->~BufferHead();
+  if (bh_pool.size() < MAX_BH_POOL)
+    bh_pool.push_back(bh);
+  else
+    ::operator delete(bh);
+}
+
+void ObjectCacher::bh_lru_insert(BufferHead *bh)
+{
+  assert(!bh->is_dirty());
+  if (bh->get_dontneed()) {
+    bh->set_hot(false);
+    bh_lru_rest.lru_insert_bot(bh);
+  } else if (bh->is_hot()) {
+    bh_lru_hot.lru_insert_top(bh);
+  } else {
+    bh_lru_rest.lru_insert_top(bh);
+  }
+}
+
+void ObjectCacher::bh_lru_remove(BufferHead *bh)
+{
+  if (bh->is_hot())
+    bh_lru_hot.lru_remove(bh);
+  else
+    bh_lru_rest.lru_remove(bh);
+}
+
+void ObjectCacher::bh_lru_bottouch(BufferHead *bh)
+{
+  assert(lock.is_locked());
+  if (bh->is_hot()) {
+    // not wanted after all; first in line for eviction
+    bh_stat_sub(bh);
+    bh_lru_hot.lru_remove(bh);
+    bh->set_hot(false);
+    bh_stat_add(bh);
+    bh_lru_rest.lru_insert_bot(bh);
+  } else {
+    bh_lru_rest.lru_bottouch(bh);
+  }
+}
+
+void ObjectCacher::bh_promote(BufferHead *bh)
+{
+  assert(lock.is_locked());
+  assert(!bh->is_dirty() && !bh->is_hot());
+  ldout(cct, 20) << "bh_promote " << *bh << dendl;
+  bh_stat_sub(bh);
+  bh_lru_rest.lru_remove(bh);
+  bh->set_hot(true);
+  bh_lru_hot.lru_insert_top(bh);
+  bh_stat_add(bh);
+  perfcounter->inc(l_objectcacher_cache_promoted);
+}
+
+void ObjectCacher::ghost_add(BufferHead *bh)
+{
+  ghost_key_t key(bh->ob->get_soid(), bh->start());
+  if (ghost_map.count(key))
+    return;
+  ghost_lru.push_front(key);
+  ghost_map[key] = make_pair(ghost_lru.begin(), bh->length());
+  stat_ghost += bh->length();
+  // remember about half a cache worth of evicted data
+  while (stat_ghost > (loff_t)(max_size / 2)) {
+    map<ghost_key_t, pair<list<ghost_key_t>::iterator, loff_t> >::iterator p =
+      ghost_map.find(ghost_lru.back());
+    assert(p != ghost_map.end());
+    stat_ghost -= p->second.second;
+    ghost_map.erase(p);
+    ghost_lru.pop_back();
+  }
+}
+
+bool ObjectCacher::ghost_remove(BufferHead *bh)
+{
+  if (ghost_map.empty())
+    return false;
+  map<ghost_key_t, pair<list<ghost_key_t>::iterator, loff_t> >::iterator p =
+    ghost_map.find(ghost_key_t(bh->ob->get_soid(), bh->start()));
+  if (p == ghost_map.end())
+    return false;
+  stat_ghost -= p->second.second;
+  ghost_lru.erase(p->second.first);
+  ghost_map.erase(p);
+  return true;
+}
+
+int ObjectCacher::set_policy(const string& name)
+{
+  if (name == "lru")
+    policy = POLICY_LRU;
+  else if (name == "2q")
+    policy = POLICY_2Q;
+  else
+    return -EINVAL;
+  return 0;
+}
+
 void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
 {
   assert(lock.is_locked());
@@ -2177,10 +2322,12 @@ void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
     bh_lru_dirty.lru_insert_top(bh);
     dirty_or_tx_bh.insert(bh);
   } else {
-    if (bh->get_dontneed())
-      bh_lru_rest.lru_insert_bot(bh);
-    else
-      bh_lru_rest.lru_insert_top(bh);
+    if (policy == POLICY_2Q && !bh->is_hot() && ghost_remove(bh)) {
+      ldout(cct, 20) << "bh_add ghost hit " << *bh << dendl;
+      perfcounter->inc(l_objectcacher_cache_ghost_hits);
+      bh->set_hot(true);
+    }
+    bh_lru_insert(bh);
   }
 
   if (bh->is_tx()) {
@@ -2198,7 +2345,7 @@ void ObjectCacher::bh_remove(Object *ob, BufferHead *bh)
     bh_lru_dirty.lru_remove(bh);
     dirty_or_tx_bh.erase(bh);
   } else {
-    bh_lru_rest.lru_remove(bh);
+    bh_lru_remove(bh);
   }
 
   if (bh->is_tx()) {
@@ -37,6 +37,9 @@ enum {
   l_objectcacher_write_bytes_blocked, // total number of write bytes we delayed due to dirty limits
   l_objectcacher_write_time_blocked, // total time in seconds spent blocking a write due to dirty limits
 
+  l_objectcacher_cache_ghost_hits, // misses on recently evicted data (2q)
+  l_objectcacher_cache_promoted, // bhs moved to the hot lru (2q)
+
   l_objectcacher_last,
 };
 
@@ -103,6 +106,7 @@ class ObjectCacher {
     } ex;
     bool dontneed; //indicate bh don't need by anyone
     bool nocache; //indicate bh don't need by this caller
+    bool hot; //read again since it was cached; on bh_lru_hot when clean
 
   public:
     Object *ob;
@@ -121,6 +125,7 @@ class ObjectCacher {
       ref(0),
       dontneed(false),
       nocache(false),
+      hot(false),
       ob(o),
       last_write_tid(0),
       last_read_tid(0),
@@ -178,6 +183,13 @@ class ObjectCacher {
     bool get_nocache() {
       return nocache;
     }
+
+    void set_hot(bool v) {
+      hot = v;
+    }
+    bool is_hot() const {
+      return hot;
+    }
   };
 
   // ******* Object *********
@@ -370,6 +382,23 @@ class ObjectCacher {
 
   set<BufferHead*>    dirty_or_tx_bh;
   LRU   bh_lru_dirty, bh_lru_rest;
+  LRU   bh_lru_hot;   // 2q: clean bhs hit again since they were cached
+
+  // replacement policy for clean bhs
+  enum {
+    POLICY_LRU,
+    POLICY_2Q,
+  };
+  int policy;
+
+  // 2q: recently evicted extents, so that a miss on one goes straight
+  // to the hot lru
+  typedef pair<sobject_t, loff_t> ghost_key_t;
+  list<ghost_key_t> ghost_lru;
+  map<ghost_key_t, pair<list<ghost_key_t>::iterator, loff_t> > ghost_map;
+  loff_t stat_ghost;
+  void ghost_add(BufferHead *bh);
+  bool ghost_remove(BufferHead *bh);
   LRU   ob_lru;
 
   Cond flusher_cond;
@@ -412,6 +441,12 @@ class ObjectCacher {
   loff_t stat_missing;
   loff_t stat_error;
   loff_t stat_dirty_waiting;   // bytes that writers are waiting on to write
+  uint64_t stat_nr_bh;         // BufferHeads allocated
+  loff_t stat_hot;             // bytes on bh_lru_hot
+
+  // freed BufferHeads, kept for reuse so that small random io doesn't
+  // go to the heap for every split and merge
+  vector<void*> bh_pool;
 
   void verify_stats() const;
 
@@ -423,10 +458,25 @@ class ObjectCacher {
   loff_t get_stat_dirty_waiting() { return stat_dirty_waiting; }
   loff_t get_stat_clean() { return stat_clean; }
   loff_t get_stat_zero() { return stat_zero; }
+  /// bytes of Object and BufferHead metadata, charged against max_size
+  uint64_t get_stat_overhead() {
+    return stat_nr_bh * sizeof(BufferHead) +
+      ob_lru.lru_get_size() * sizeof(Object);
+  }
 
-  void touch_bh(BufferHead *bh) {
+  void bh_lru_insert(BufferHead *bh);
+  void bh_lru_remove(BufferHead *bh);
+  void bh_lru_bottouch(BufferHead *bh);
+  void bh_promote(BufferHead *bh);
+
+  /// promote: this is a new access to the bh by a reader
+  void touch_bh(BufferHead *bh, bool promote=false) {
     if (bh->is_dirty())
       bh_lru_dirty.lru_touch(bh);
+    else if (bh->is_hot())
+      bh_lru_hot.lru_touch(bh);
+    else if (promote && policy == POLICY_2Q)
+      bh_promote(bh);
     else
       bh_lru_rest.lru_touch(bh);
 
@@ -459,6 +509,8 @@ class ObjectCacher {
     //bh->set_dirty_stamp(ceph_clock_now(g_ceph_context));
   }
 
+  BufferHead *new_bh(Object *ob);
+  void delete_bh(BufferHead *bh);
   void bh_add(Object *ob, BufferHead *bh);
   void bh_remove(Object *ob, BufferHead *bh);
 
@@ -467,7 +519,9 @@ class ObjectCacher {
   void bh_write(BufferHead *bh);
 
   void trim();
-  void flush(loff_t amount=0);
+  /// start writeback on up to amount bytes (and max_bhs bh's) of
+  /// expired dirty data; false if it stopped early on max_bhs
+  bool flush(loff_t amount=0, int max_bhs=0);
 
   /**
    * flush a range of buffers
@@ -659,6 +713,9 @@ public:
   void set_max_dirty_age(double a) {
     max_dirty_age.set_from_double(a);
   }
+  /// "lru" or "2q"
+  int set_policy(const string& name);
+
   void set_max_objects(int64_t v) {
     max_objects = v;
   }
@@ -23,6 +23,7 @@
 
 #include "messages/MPing.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDMap.h"
 
@@ -48,6 +49,7 @@
 #include "common/perf_counters.h"
 #include "common/Finisher.h"
 #include "include/str_list.h"
+#include "include/stringify.h"
 #include "common/errno.h"
 
 
@@ -62,6 +64,11 @@ enum {
   l_osdc_op_laggy,
   l_osdc_op_send,
   l_osdc_op_send_bytes,
+  l_osdc_op_batch,
+  l_osdc_op_batched,
+  l_osdc_op_send_lat,
+  l_osdc_op_ack_lat,
+  l_osdc_op_commit_lat,
   l_osdc_op_resend,
   l_osdc_op_ack,
   l_osdc_op_commit,
@@ -196,6 +203,15 @@ void Objecter::init()
     pcb.add_u64(l_osdc_op_laggy, "op_laggy", "Laggy operations");
     pcb.add_u64_counter(l_osdc_op_send, "op_send", "Sent operations");
     pcb.add_u64_counter(l_osdc_op_send_bytes, "op_send_bytes", "Sent data");
+    pcb.add_u64_counter(l_osdc_op_batch, "op_batch", "Sent op batches");
+    pcb.add_u64_counter(l_osdc_op_batched, "op_batched",
+        "Operations sent in batches");
+    pcb.add_time_hist(l_osdc_op_send_lat, "op_send_latency",
+        "Latency from submit to send");
+    pcb.add_time_hist(l_osdc_op_ack_lat, "op_ack_latency",
+        "Latency from send to ack");
+    pcb.add_time_hist(l_osdc_op_commit_lat, "op_commit_latency",
+        "Latency from send to commit");
     pcb.add_u64_counter(l_osdc_op_resend, "op_resend", "Resent operations");
     pcb.add_u64_counter(l_osdc_op_ack, "op_ack", "Commit callbacks");
     pcb.add_u64_counter(l_osdc_op_commit, "op_commit", "Operation commits");
@@ -287,6 +303,15 @@ void Objecter::init()
     lderr(cct) << "error registering admin socket command: "
 	       << cpp_strerror(ret) << dendl;
   }
+  ret = admin_socket->register_command("dump_osd_latency",
+				       "dump_osd_latency",
+				       m_request_state_hook,
+				       "show osd request latency histograms, "
+				       "by osd and by op type");
+  if (ret < 0 && ret != -EEXIST) {
+    lderr(cct) << "error registering admin socket command: "
+	       << cpp_strerror(ret) << dendl;
+  }
 
   timer_lock.Lock();
   timer.init();
@@ -410,6 +435,7 @@ void Objecter::shutdown()
   if (m_request_state_hook) {
     AdminSocket* admin_socket = cct->get_admin_socket();
     admin_socket->unregister_command("objecter_requests");
+    admin_socket->unregister_command("dump_osd_latency");
     delete m_request_state_hook;
     m_request_state_hook = NULL;
   }
@@ -1584,6 +1610,10 @@ int Objecter::_get_session(int osd, OSDSession **session, RWLock::Context& lc)
   }
   OSDSession *s = new OSDSession(cct, osd);
   osd_sessions[osd] = s;
+  OpLatency *&latency = osd_latency[osd];
+  if (!latency)
+    latency = new OpLatency;
+  s->latency = latency;
   s->con = messenger->get_connection(osdmap->get_inst(osd));
   logger->inc(l_osdc_osd_session_open);
   logger->inc(l_osdc_osd_sessions, osd_sessions.size());
@@ -1636,6 +1666,7 @@ void Objecter::close_session(OSDSession *s)
     logger->inc(l_osdc_osd_session_close);
   }
   s->lock.get_write();
+  _drop_batch(s);
 
   std::list<LingerOp*> homeless_lingers;
   std::list<CommandOp*> homeless_commands;
@@ -1831,6 +1862,8 @@ void Objecter::_kick_requests(OSDSession *session, map<uint64_t, LingerOp *>& lr
 {
   assert(rwlock.is_wlocked());
 
+  _drop_batch(session);
+
   // resend ops
   map<ceph_tid_t,Op*> resend;  // resend in tid order
   for (map<ceph_tid_t, Op*>::iterator p = session->ops.begin(); p != session->ops.end();) {
@@ -2035,6 +2068,32 @@ public:
   }
 };
 
+uint64_t Objecter::_next_instance_id()
+{
+  static atomic64_t last_instance_id;
+  return last_instance_id.inc();
+}
+
+ceph_tid_t Objecter::_alloc_tid()
+{
+  if (tid_batch == 1)
+    return last_tid.inc();
+  // each thread takes tids from a range of its own, so that concurrent
+  // submitters do not all bounce last_tid; a thread's own ops still get
+  // increasing tids
+  struct tid_range_t {
+    uint64_t instance_id;
+    ceph_tid_t next, end;
+  };
+  static __thread tid_range_t range;
+  if (range.instance_id != instance_id || range.next == range.end) {
+    range.end = last_tid.add(tid_batch) + 1;
+    range.next = range.end - tid_batch;
+    range.instance_id = instance_id;
+  }
+  return range.next++;
+}
+
 ceph_tid_t Objecter::op_submit(Op *op, int *ctx_budget)
 {
   RWLock::RLocker rl(rwlock);
@@ -2042,7 +2101,37 @@ ceph_tid_t Objecter::op_submit(Op *op, int *ctx_budget)
   return _op_submit_with_budget(op, lc, ctx_budget);
 }
 
-ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget)
+void Objecter::op_submit_many(vector<Op*>& ops, vector<ceph_tid_t> *tids)
+{
+  set<OSDSession*> batched;
+  {
+    RWLock::RLocker rl(rwlock);
+    RWLock::Context lc(rwlock, RWLock::Context::TakenForRead);
+    ldout(cct, 10) << __func__ << " " << ops.size() << " ops" << dendl;
+    if (tids)
+      tids->reserve(tids->size() + ops.size());
+    for (vector<Op*>::iterator p = ops.begin(); p != ops.end(); ++p) {
+      (*p)->batch = true;
+      ceph_tid_t tid = _op_submit_with_budget(*p, lc, NULL, &batched);
+      if (tids)
+	tids->push_back(tid);
+    }
+  }
+  ops.clear();
+
+  // the tail of each session's batch goes now rather than when the
+  // window closes: nothing else is coming
+  for (set<OSDSession*>::iterator p = batched.begin(); p != batched.end(); ++p) {
+    {
+      RWLock::WLocker wl((*p)->lock);
+      _flush_batch(*p);
+    }
+    (*p)->put();
+  }
+}
+
+ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget,
+					    set<OSDSession*> *batched)
 {
   assert(initialized.read());
 
@@ -2063,13 +2152,13 @@ ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ct
 
   if (osd_timeout > 0) {
     if (op->tid == 0)
-      op->tid = last_tid.inc();
+      op->tid = _alloc_tid();
     op->ontimeout = new C_CancelOp(op->tid, this);
     Mutex::Locker l(timer_lock);
     timer.add_event_after(osd_timeout, op->ontimeout);
   }
 
-  return _op_submit(op, lc);
+  return _op_submit(op, lc, batched);
 }
 
 void Objecter::_send_op_account(Op *op)
@@ -2150,7 +2239,8 @@ void Objecter::_send_op_account(Op *op)
   }
 }
 
-ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc)
+ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc,
+			       set<OSDSession*> *batched)
 {
   assert(rwlock.is_locked());
 
@@ -2159,6 +2249,7 @@ ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc)
   // pick target
   assert(op->session == NULL);
   OSDSession *s = NULL;
+  op->submit_stamp = ceph_clock_now(cct);
 
   bool const check_for_latest_map = _calc_target(&op->target, &op->last_force_resend) == RECALC_OP_TARGET_POOL_DNE;
 
@@ -2224,11 +2315,13 @@ ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc)
 
   s->lock.get_write();
   if (op->tid == 0)
-    op->tid = last_tid.inc();
+    op->tid = _alloc_tid();
   _session_op_assign(s, op);
 
   if (need_send) {
-    _send_op(op, m);
+    _send_op(op, m, true);
+    if (batched && !s->batch.empty() && batched->insert(s).second)
+      s->get();
   }
 
   // Last chance to touch Op here, after giving up session lock it can be
@@ -2910,7 +3003,7 @@ MOSDOp *Objecter::_prepare_osd_op(Op *op)
   return m;
 }
 
-void Objecter::_send_op(Op *op, MOSDOp *m)
+void Objecter::_send_op(Op *op, MOSDOp *m, bool may_batch)
 {
   assert(rwlock.is_locked());
   assert(op->session->lock.is_locked());
@@ -2939,12 +3032,89 @@ void Objecter::_send_op(Op *op, MOSDOp *m)
   }
 
   op->incarnation = op->session->incarnation;
+  if (op->attempts == 1) {
+    utime_t lat = op->stamp - op->submit_stamp;
+    logger->tinc(l_osdc_op_send_lat, lat);
+    _account_latency(op, &OpLatency::submit_to_send, lat);
+  }
 
   m->set_tid(op->tid);
 
+  if (may_batch && op->batch && _batch_op(op->session, m))
+    return;
   op->session->con->send_message(m);
 }
 
+struct Objecter::C_FlushBatch : public Context {
+  Objecter *objecter;
+  OSDSession *s;
+  C_FlushBatch(Objecter *o, OSDSession *s) : objecter(o), s(s) {
+    s->get();
+  }
+  ~C_FlushBatch() {
+    s->put();
+  }
+  void finish(int r) {
+    objecter->flush_batch(s);
+  }
+};
+
+bool Objecter::_batch_op(OSDSession *s, MOSDOp *m)
+{
+  assert(s->lock.is_wlocked());
+
+  double window = cct->_conf->objecter_batch_window;
+  unsigned max_ops = cct->_conf->objecter_batch_max_ops;
+  if (window <= 0 || max_ops < 2 || !s->con ||
+      !s->con->has_feature(CEPH_FEATURE_OSD_OP_BATCH))
+    return false;
+
+  ldout(cct, 20) << __func__ << " " << m->get_tid() << " to osd." << s->osd
+		 << dendl;
+  s->batch.push_back(m);
+  if (s->batch.size() >= max_ops) {
+    _flush_batch(s);
+  } else if (!s->batch_flush_scheduled) {
+    s->batch_flush_scheduled = true;
+    Mutex::Locker l(timer_lock);
+    timer.add_event_after(window, new C_FlushBatch(this, s));
+  }
+  return true;
+}
+
+void Objecter::_flush_batch(OSDSession *s)
+{
+  assert(s->lock.is_wlocked());
+
+  if (s->batch.empty())
+    return;
+  ldout(cct, 15) << __func__ << " " << s->batch.size() << " ops to osd."
+		 << s->osd << dendl;
+  if (s->batch.size() == 1) {
+    s->con->send_message(s->batch.front());
+    s->batch.clear();
+    return;
+  }
+  logger->inc(l_osdc_op_batch);
+  logger->inc(l_osdc_op_batched, s->batch.size());
+  s->con->send_message(new MOSDOpBatch(s->batch));
+}
+
+void Objecter::_drop_batch(OSDSession *s)
+{
+  // the ops are still in s->ops, whoever resends those resends these
+  for (vector<MOSDOp*>::iterator p = s->batch.begin(); p != s->batch.end(); ++p)
+    (*p)->put();
+  s->batch.clear();
+}
+
+void Objecter::flush_batch(OSDSession *s)
+{
+  RWLock::WLocker wl(s->lock);
+  s->batch_flush_scheduled = false;
+  _flush_batch(s);
+}
+
 int Objecter::calc_op_budget(Op *op)
 {
   int op_budget = 0;
@@ -2997,6 +3167,21 @@ void Objecter::unregister_op(Op *op)
 }
 
 /* This function DOES put the passed message before returning */
+void Objecter::_trace_reply(Op *op, MOSDOpReply *m, const char *event)
+{
+  osd_reqid_t reqid = op->reqid;
+  if (reqid.name == entity_name_t())
+    reqid = osd_reqid_t(messenger->get_myname(), client_inc.read(), op->tid);
+  if (!trace_log.is_sampled(reqid.name.num(), reqid.tid))
+    return;
+  OpTraceLog::events_t events;
+  events.push_back(make_pair("submit", op->submit_stamp));
+  events.push_back(make_pair("sent", op->stamp));
+  events.push_back(make_pair("reply_received", m->get_recv_stamp()));
+  events.push_back(make_pair(event, ceph_clock_now(cct)));
+  trace_log.write(stringify(reqid), "client", events);
+}
+
 void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 {
   ldout(cct, 10) << "in handle_osd_op_reply" << dendl;
@@ -3090,6 +3275,28 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
     return;
   }
 
+  if (rc == -EAGAIN && op->target.used_replica) {
+    // the replica cannot vouch for the object yet; ask the primary
+    ldout(cct, 7) << " got -EAGAIN from replica, resending to primary"
+		  << dendl;
+    if (op->onack)
+      num_unacked.dec();
+    if (op->oncommit || op->oncommit_sync)
+      num_uncommitted.dec();
+    _session_op_remove(s, op);
+    s->lock.unlock();
+    put_session(s);
+
+    op->tid = 0;
+    op->target.flags &= ~(CEPH_OSD_FLAG_BALANCE_READS |
+			  CEPH_OSD_FLAG_LOCALIZE_READS);
+    op->target.osd = op->target.acting_primary;
+    op->target.used_replica = false;
+    _op_submit(op, lc);
+    m->put();
+    return;
+  }
+
   if (rc == -EAGAIN) {
     ldout(cct, 7) << " got -EAGAIN, resubmitting" << dendl;
 
@@ -3156,6 +3363,10 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
   }
 
   // ack|commit -> ack
+  utime_t lat = ceph_clock_now(cct) - op->stamp;
+  if (op->onack || ((m->is_ondisk() || rc) &&
+		    (op->oncommit || op->oncommit_sync)))
+    _trace_reply(op, m, m->is_ondisk() || rc ? "commit" : "ack");
   if (op->onack) {
     ldout(cct, 15) << "handle_osd_op_reply ack" << dendl;
     op->replay_version = m->get_replay_version();
@@ -3163,8 +3374,14 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
     op->onack = 0;  // only do callback once
     num_unacked.dec();
     logger->inc(l_osdc_op_ack);
+    logger->tinc(l_osdc_op_ack_lat, lat);
+    _account_latency(op, &OpLatency::send_to_ack, lat);
   }
   if (m->is_ondisk() || rc) {
+    if (op->oncommit || op->oncommit_sync) {
+      logger->tinc(l_osdc_op_commit_lat, lat);
+      _account_latency(op, &OpLatency::send_to_commit, lat);
+    }
     if (op->oncommit) {
       ldout(cct, 15) << "handle_osd_op_reply safe" << dendl;
       oncommit = op->oncommit;
@@ -3229,6 +3446,55 @@ uint32_t Objecter::list_nobjects_seek(NListContext *list_context,
   return list_context->current_pg;
 }
 
+void Objecter::list_nobjects_slice(NListContext *list_context,
+				   unsigned n, unsigned m)
+{
+  assert(n > 0 && m < n);
+  RWLock::RLocker rl(rwlock);
+  const pg_pool_t *pool = osdmap->get_pg_pool(list_context->pool_id);
+  int pg_num = pool ? pool->get_pg_num() : 0;
+  int start = (uint64_t)pg_num * m / n;
+  int end = (uint64_t)pg_num * (m + 1) / n;
+  ldout(cct, 10) << __func__ << " " << list_context << " slice " << m
+		 << "/" << n << " pgs [" << start << "," << end << ")" << dendl;
+
+  list_context->list.clear();
+  list_context->sliced = true;
+  list_context->pending_pgs.clear();
+  for (int pg = start + 1; pg < end; ++pg)
+    list_context->pending_pgs.push_back(pg);
+  list_context->current_pg = start;
+  list_context->cookie = collection_list_handle_t();
+  list_context->current_pg_epoch = 0;
+  list_context->starting_pg_num = pg_num;
+  list_context->sort_bitwise = osdmap->test_flag(CEPH_OSDMAP_SORTBITWISE);
+  list_context->at_end_of_pg = false;
+  // more slices than pgs leaves some slices empty
+  list_context->at_end_of_pool = start >= end;
+}
+
+void Objecter::_nlist_slice_split(NListContext *list_context, int pg_num)
+{
+  // the pgs already listed took their objects with them; the rest of
+  // our pgs, and whatever split off them, still need listing
+  set<int> pgs;
+  list<int> old(list_context->pending_pgs);
+  old.push_front(list_context->current_pg);
+  for (list<int>::iterator p = old.begin(); p != old.end(); ++p) {
+    pgs.insert(*p);
+    set<pg_t> children;
+    if (pg_t(*p, list_context->pool_id).is_split(list_context->starting_pg_num,
+						  pg_num, &children)) {
+      for (set<pg_t>::iterator q = children.begin(); q != children.end(); ++q)
+	pgs.insert(q->ps());
+    }
+  }
+  ldout(cct, 10) << " slice now " << pgs.size() << " pgs" << dendl;
+  set<int>::iterator p = pgs.begin();
+  list_context->current_pg = *p;
+  list_context->pending_pgs.assign(++p, pgs.end());
+}
+
 void Objecter::list_nobjects(NListContext *list_context, Context *onfinish)
 {
   ldout(cct, 10) << "list_objects" << dendl;
@@ -3242,10 +3508,18 @@ void Objecter::list_nobjects(NListContext *list_context, Context *onfinish)
 
   if (list_context->at_end_of_pg) {
     list_context->at_end_of_pg = false;
-    ++list_context->current_pg;
     list_context->current_pg_epoch = 0;
     list_context->cookie = collection_list_handle_t();
-    if (list_context->current_pg >= list_context->starting_pg_num) {
+    if (list_context->sliced) {
+      if (list_context->pending_pgs.empty()) {
+	list_context->at_end_of_pool = true;
+	ldout(cct, 20) << " no more pgs; reached end of slice" << dendl;
+      } else {
+	list_context->current_pg = list_context->pending_pgs.front();
+	list_context->pending_pgs.pop_front();
+	ldout(cct, 20) << " move to next pg " << list_context->current_pg << dendl;
+      }
+    } else if (++list_context->current_pg >= list_context->starting_pg_num) {
       list_context->at_end_of_pool = true;
       ldout(cct, 20) << " no more pgs; reached end of pool" << dendl;
     } else {
@@ -3277,9 +3551,15 @@ void Objecter::list_nobjects(NListContext *list_context, Context *onfinish)
     list_context->sort_bitwise = osdmap->test_flag(CEPH_OSDMAP_SORTBITWISE);
   }
   if (list_context->starting_pg_num != pg_num) {
-    // start reading from the beginning; the pgs have changed
-    ldout(cct, 10) << " pg_num changed; restarting with " << pg_num << dendl;
-    list_context->current_pg = 0;
+    if (list_context->sliced) {
+      ldout(cct, 10) << " pg_num changed; restarting this pg with " << pg_num
+		     << dendl;
+      _nlist_slice_split(list_context, pg_num);
+    } else {
+      // start reading from the beginning; the pgs have changed
+      ldout(cct, 10) << " pg_num changed; restarting with " << pg_num << dendl;
+      list_context->current_pg = 0;
+    }
     list_context->cookie = collection_list_handle_t();
     list_context->current_pg_epoch = 0;
     list_context->starting_pg_num = pg_num;
@@ -4385,7 +4665,10 @@ bool Objecter::RequestStateHook::call(std::string command, cmdmap_t& cmdmap,
 {
   Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
   RWLock::RLocker rl(m_objecter->rwlock);
-  m_objecter->dump_requests(f);
+  if (command == "dump_osd_latency")
+    m_objecter->dump_osd_latency(f);
+  else
+    m_objecter->dump_requests(f);
   f->flush(out);
   delete f;
   return true;
@@ -4646,6 +4929,7 @@ Objecter::OSDSession::~OSDSession()
   assert(ops.empty());
   assert(linger_ops.empty());
   assert(command_ops.empty());
+  assert(batch.empty());
 
   for (int i = 0; i < num_locks; i++) {
     delete completion_locks[i];
@@ -4653,10 +4937,98 @@ Objecter::OSDSession::~OSDSession()
   delete[] completion_locks;
 }
 
+void Objecter::LatencyHist::add(utime_t lat)
+{
+  uint64_t ns = lat.to_nsec();
+  uint64_t us = ns / 1000;
+  unsigned b = 0;
+  while (us && b < PERFCOUNTER_HIST_BUCKETS - 1) {
+    us >>= 1;
+    ++b;
+  }
+  buckets[b].inc();
+  sum_ns.add(ns);
+  count.inc();
+}
+
+void Objecter::LatencyHist::dump(Formatter *f) const
+{
+  uint64_t n = count.read();
+  f->dump_unsigned("count", n);
+  f->dump_unsigned("avg_us", n ? sum_ns.read() / n / 1000 : 0);
+  // bucket i counts times in [2^(i-1), 2^i) usec
+  f->open_array_section("histogram");
+  for (unsigned i = 0; i < PERFCOUNTER_HIST_BUCKETS; ++i)
+    f->dump_unsigned("count", buckets[i].read());
+  f->close_section();
+}
+
+void Objecter::OpLatency::dump(Formatter *f) const
+{
+  f->open_object_section("submit_to_send");
+  submit_to_send.dump(f);
+  f->close_section();
+  f->open_object_section("send_to_ack");
+  send_to_ack.dump(f);
+  f->close_section();
+  f->open_object_section("send_to_commit");
+  send_to_commit.dump(f);
+  f->close_section();
+}
+
+int Objecter::latency_type(const Op *op)
+{
+  int rw = op->target.flags & (CEPH_OSD_FLAG_READ|CEPH_OSD_FLAG_WRITE);
+  if (rw == (CEPH_OSD_FLAG_READ|CEPH_OSD_FLAG_WRITE))
+    return LAT_RMW;
+  if (rw == CEPH_OSD_FLAG_WRITE)
+    return LAT_WRITE;
+  return LAT_READ;
+}
+
+void Objecter::_account_latency(Op *op, LatencyHist OpLatency::*which,
+				utime_t lat)
+{
+  if (op->session && op->session->latency)
+    (op->session->latency->*which).add(lat);
+  (type_latency[latency_type(op)].*which).add(lat);
+}
+
+void Objecter::dump_osd_latency(Formatter *f)
+{
+  assert(rwlock.is_locked());
+
+  f->open_object_section("osd_latency");
+  f->open_array_section("osds");
+  for (map<int, OpLatency*>::const_iterator p = osd_latency.begin();
+       p != osd_latency.end();
+       ++p) {
+    f->open_object_section("osd");
+    f->dump_int("osd", p->first);
+    p->second->dump(f);
+    f->close_section();
+  }
+  f->close_section();
+  static const char *type_names[LAT_NUM_TYPES] = { "read", "write", "rmw" };
+  f->open_object_section("op_types");
+  for (int i = 0; i < LAT_NUM_TYPES; ++i) {
+    f->open_object_section(type_names[i]);
+    type_latency[i].dump(f);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
 Objecter::~Objecter()
 {
   delete osdmap;
 
+  for (map<int, OpLatency*>::iterator p = osd_latency.begin();
+       p != osd_latency.end();
+       ++p)
+    delete p->second;
+
   assert(homeless_session->get_nref() == 1);
   assert(num_homeless_ops.read() == 0);
   homeless_session->put();
@@ -24,6 +24,8 @@
 #include "common/admin_socket.h"
 #include "common/Timer.h"
 #include "common/RWLock.h"
+#include "common/perf_counters.h"
+#include "common/OpTraceLog.h"
 #include "include/rados/rados_types.hpp"
 
 #include <list>
@@ -1090,6 +1092,10 @@ public:
 
 private:
   atomic64_t last_tid;
+  /// tids handed to a thread at once by _alloc_tid, 1 for one at a time
+  unsigned tid_batch;
+  /// tells this objecter's thread local tid ranges from another's
+  uint64_t instance_id;
   atomic_t inflight_ops;
   atomic_t client_inc;
   uint64_t max_linger_id;
@@ -1103,6 +1109,9 @@ public:
   void maybe_request_map();
 private:
 
+  static uint64_t _next_instance_id();
+  ceph_tid_t _alloc_tid();
+
   void _maybe_request_map();
 
   version_t last_seen_osdmap_version;
@@ -1113,6 +1122,28 @@ private:
   SafeTimer timer;
 
   PerfCounters *logger;
+
+  /// log2(usec) buckets, as in a PERFCOUNTER_HISTOGRAM; updated lockless
+  struct LatencyHist {
+    atomic64_t count, sum_ns;
+    atomic64_t buckets[PERFCOUNTER_HIST_BUCKETS];
+    void add(utime_t lat);
+    void dump(Formatter *f) const;
+  };
+  /// where the time of the ops to one osd, or of one type, went
+  struct OpLatency {
+    LatencyHist submit_to_send, send_to_ack, send_to_commit;
+    void dump(Formatter *f) const;
+  };
+  enum {
+    LAT_READ,
+    LAT_WRITE,
+    LAT_RMW,
+    LAT_NUM_TYPES
+  };
+  /// by osd; entries outlive the sessions, under rwlock
+  map<int, OpLatency*> osd_latency;
+  OpLatency type_latency[LAT_NUM_TYPES];
   
   class C_Tick : public Context {
     Objecter *ob;
@@ -1220,6 +1251,7 @@ public:
     epoch_t *reply_epoch;
 
     utime_t stamp;
+    utime_t submit_stamp;  ///< when op_submit first saw it
 
     epoch_t map_dne_bound;
 
@@ -1239,6 +1271,9 @@ public:
 
     osd_reqid_t reqid; // explicitly setting reqid
 
+    /// may go out in an MOSDOpBatch with other ops for the same osd
+    bool batch;
+
     Op(const object_t& o, const object_locator_t& ol, vector<OSDOp>& op,
        int f, Context *ac, Context *co, version_t *ov, int *offset = NULL) :
       session(NULL), incarnation(0),
@@ -1261,7 +1296,8 @@ public:
       should_resend(true),
       ctx_budgeted(false),
       data_offset(offset),
-      last_force_resend(0) {
+      last_force_resend(0),
+      batch(false) {
       ops.swap(op);
       
       /* initialize out_* to match op vector */
@@ -1355,6 +1391,11 @@ public:
     bool at_end_of_pg;
     bool sort_bitwise;
 
+    // listing a slice of the pool: the pgs to list after current_pg,
+    // in place of every pg up to starting_pg_num
+    bool sliced;
+    std::list<int> pending_pgs;
+
     int64_t pool_id;
     int pool_snap_seq;
     int max_entries;
@@ -1377,6 +1418,7 @@ public:
 		    at_end_of_pool(false),
 		    at_end_of_pg(false),
 		    sort_bitwise(false),
+		    sliced(false),
 		    pool_id(0),
 		    pool_snap_seq(0),
                     max_entries(0),
@@ -1718,11 +1760,20 @@ public:
     int num_locks;
     ConnectionRef con;
 
+    /// ops waiting for the batch window to close, in order, under lock
+    vector<MOSDOp*> batch;
+    bool batch_flush_scheduled;
+
+    /// Objecter::osd_latency[osd], NULL for the homeless session
+    OpLatency *latency;
+
     OSDSession(CephContext *cct, int o) :
       lock("OSDSession"),
       osd(o),
       incarnation(0),
-      con(NULL)
+      con(NULL),
+      batch_flush_scheduled(false),
+      latency(NULL)
     {
       num_locks = cct->_conf->objecter_completion_locks_per_session;
       completion_locks = new Mutex *[num_locks];
@@ -1779,8 +1830,14 @@ public:
   double mon_timeout, osd_timeout;
 
   MOSDOp *_prepare_osd_op(Op *op);
-  void _send_op(Op *op, MOSDOp *m = NULL);
+  void _send_op(Op *op, MOSDOp *m = NULL, bool may_batch = false);
   void _send_op_account(Op *op);
+  bool _batch_op(OSDSession *s, MOSDOp *m);
+  void _flush_batch(OSDSession *s);
+  void _drop_batch(OSDSession *s);
+  void flush_batch(OSDSession *s);
+  struct C_FlushBatch;
+  friend struct C_FlushBatch;
   void _cancel_linger_op(Op *op);
   void finish_op(OSDSession *session, ceph_tid_t tid);
   void _finish_op(Op *op, int r);
@@ -1864,6 +1921,7 @@ private:
   
   void _nlist_reply(NListContext *list_context, int r, Context *final_finish,
 		   epoch_t reply_epoch);
+  void _nlist_slice_split(NListContext *list_context, int pg_num);
   void _list_reply(ListContext *list_context, int r, Context *final_finish,
 		   epoch_t reply_epoch);
 
@@ -1912,13 +1970,17 @@ private:
     messenger(m), monc(mc), finisher(fin),
     osdmap(new OSDMap),
     initialized(0),
-    last_tid(0), client_inc(-1), max_linger_id(0),
+    last_tid(0),
+    tid_batch(MAX(cct_->_conf->objecter_tid_batch, 1)),
+    instance_id(_next_instance_id()),
+    client_inc(-1), max_linger_id(0),
     num_unacked(0), num_uncommitted(0),
     global_op_flags(0),
     keep_balanced_budget(false), honor_osdmap_full(true),
     last_seen_osdmap_version(0),
     last_seen_pgmap_version(0),
-    rwlock("Objecter::rwlock"),
+    rwlock("Objecter::rwlock", true,
+	   MAX(cct_->_conf->objecter_rwlock_shards, 0)),
     timer_lock("Objecter::timer_lock"),
     timer(cct, timer_lock, false),
     logger(NULL), tick_event(NULL),
@@ -1931,7 +1993,8 @@ private:
     osd_timeout(osd_timeout),
     op_throttle_bytes(cct, "objecter_bytes", cct->_conf->objecter_inflight_op_bytes),
     op_throttle_ops(cct, "objecter_ops", cct->_conf->objecter_inflight_ops),
-    epoch_barrier(0)
+    epoch_barrier(0),
+    trace_log(cct_)
   { }
   ~Objecter();
 
@@ -2001,13 +2064,26 @@ private:
 private:
 
   // low-level
-  ceph_tid_t _op_submit(Op *op, RWLock::Context& lc);
-  ceph_tid_t _op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget = NULL);
+  ceph_tid_t _op_submit(Op *op, RWLock::Context& lc,
+			set<OSDSession*> *batched = NULL);
+  ceph_tid_t _op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget = NULL,
+				    set<OSDSession*> *batched = NULL);
   inline void unregister_op(Op *op);
 
   // public interface
 public:
   ceph_tid_t op_submit(Op *op, int *ctx_budget = NULL);
+  /**
+   * submit several ops at once
+   *
+   * The ops are sent under a single hold of rwlock, and those going to
+   * the same osd leave in as few messages as objecter_batch_max_ops
+   * allows, without waiting out objecter_batch_window.
+   *
+   * @param ops ops from the prepare_*_op helpers, consumed
+   * @param tids [out] the tid of each op, in order (may be NULL)
+   */
+  void op_submit_many(vector<Op*>& ops, vector<ceph_tid_t> *tids);
   bool is_active() {
     RWLock::RLocker l(rwlock);
     return !((!inflight_ops.read()) && linger_ops.empty() && poolstat_ops.empty() && statfs_ops.empty());
@@ -2030,6 +2106,16 @@ public:
   void dump_pool_stat_ops(Formatter *fmt) const;
   void dump_statfs_ops(Formatter *fmt) const;
 
+  /**
+   * Output latency histograms, by osd and by op type
+   */
+  void dump_osd_latency(Formatter *fmt);
+private:
+  static int latency_type(const Op *op);
+  /// which is &OpLatency::submit_to_send etc
+  void _account_latency(Op *op, LatencyHist OpLatency::*which, utime_t lat);
+public:
+
   int get_client_incarnation() const { return client_inc.read(); }
   void set_client_incarnation(int inc) { client_inc.set(inc); }
 
@@ -2518,6 +2604,16 @@ public:
 
   void list_nobjects(NListContext *p, Context *onfinish);
   uint32_t list_nobjects_seek(NListContext *p, uint32_t pos);
+  /**
+   * restrict a listing to slice m of n
+   *
+   * The slices split the pool's pgs into n runs of about the same
+   * size, so that n listings, one per slice, together list every
+   * object once and can go on in parallel.  A slice that is listed
+   * while its pgs split goes on with the children of the pgs it has
+   * left.
+   */
+  void list_nobjects_slice(NListContext *p, unsigned n, unsigned m);
   void list_objects(ListContext *p, Context *onfinish);
   uint32_t list_objects_seek(ListContext *p, uint32_t pos);
 
@@ -2655,6 +2751,10 @@ public:
 
 private:
   epoch_t epoch_barrier;
+
+  /// client side of the requests picked by op_trace_sample
+  OpTraceLog trace_log;
+  void _trace_reply(Op *op, MOSDOpReply *m, const char *event);
 public:
   void set_epoch_barrier(epoch_t epoch);
 };
@@ -32,10 +32,54 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
 			    vector<ObjectExtent>& extents,
 			    uint64_t buffer_offset)
 {
-  map<object_t,vector<ObjectExtent> > object_extents;
-  file_to_extents(cct, object_format, layout, offset, len, trunc_size,
-		  object_extents, buffer_offset);
-  assimilate_extents(object_extents, extents);
+  __u32 object_size = layout->fl_object_size;
+  if (layout->fl_stripe_count != 1) {
+    map<object_t,vector<ObjectExtent> > object_extents;
+    file_to_extents(cct, object_format, layout, offset, len, trunc_size,
+		    object_extents, buffer_offset);
+    assimilate_extents(object_extents, extents);
+    return;
+  }
+
+  /*
+   * no striping: the range covers consecutive objects, one extent
+   * each, so they can go straight into the result without being
+   * collected by object first.
+   */
+  ldout(cct, 10) << "file_to_extents " << offset << "~" << len
+		 << " format " << object_format
+		 << dendl;
+  assert(len > 0);
+  assert(object_size > 0);
+
+  char buf[strlen(object_format) + 32];
+  object_locator_t oloc = OSDMap::file_to_object_locator(*layout);
+  extents.reserve(extents.size() +
+		  (offset % object_size + len - 1) / object_size + 1);
+
+  uint64_t cur = offset;
+  uint64_t left = len;
+  while (left > 0) {
+    uint64_t objectno = cur / object_size;
+    uint64_t x_offset = cur % object_size;
+    uint64_t x_len = MIN(left, object_size - x_offset);
+
+    snprintf(buf, sizeof(buf), object_format, (long long unsigned)objectno);
+    extents.push_back(ObjectExtent());
+    ObjectExtent *ex = &extents.back();
+    ex->oid = buf;
+    ex->objectno = objectno;
+    ex->oloc = oloc;
+    ex->offset = x_offset;
+    ex->length = x_len;
+    ex->truncate_size = object_truncate_size(cct, layout, objectno, trunc_size);
+    ex->buffer_extents.push_back(make_pair(cur - offset + buffer_offset, x_len));
+
+    ldout(cct, 15) << "file_to_extents  " << *ex << " in " << ex->oloc << dendl;
+
+    left -= x_len;
+    cur += x_len;
+  }
 }
 
 void Striper::file_to_extents(CephContext *cct, const char *object_format,
@@ -67,6 +111,17 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
   ldout(cct, 20) << " su " << su << " sc " << stripe_count << " os " << object_size
 		 << " stripes_per_object " << stripes_per_object << dendl;
 
+  char buf[strlen(object_format) + 32];
+  object_locator_t oloc = OSDMap::file_to_object_locator(*layout);
+
+  // the object last seen at each position of the object set; walking a
+  // stripe comes back to the same objects, and this saves formatting
+  // their names and looking them up again
+  vector<pair<uint64_t, vector<ObjectExtent>*> > column;
+  if (len > su && stripe_count > 1)
+    column.resize(MIN((uint64_t)stripe_count, len / su + 1),
+		  make_pair((uint64_t)-1, (vector<ObjectExtent>*)NULL));
+
   uint64_t cur = offset;
   uint64_t left = len;
   while (left > 0) {
@@ -77,11 +132,6 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
     uint64_t objectsetno = stripeno / stripes_per_object;       // which object set
     uint64_t objectno = objectsetno * stripe_count + stripepos;  // object id
 
-    // find oid, extent
-    char buf[strlen(object_format) + 32];
-    snprintf(buf, sizeof(buf), object_format, (long long unsigned)objectno);
-    object_t oid = buf;
-
     // map range into object
     uint64_t block_start = (stripeno % stripes_per_object) * su;
     uint64_t block_off = cur % su;
@@ -102,14 +152,30 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
 		   << " " << x_offset << "~" << x_len
 		   << dendl;
 
+    // find oid, extent
+    vector<ObjectExtent> *exv;
+    pair<uint64_t, vector<ObjectExtent>*> *col = NULL;
+    if (!column.empty())
+      col = &column[stripepos % column.size()];
+    if (col && col->first == objectno) {
+      exv = col->second;
+    } else {
+      snprintf(buf, sizeof(buf), object_format, (long long unsigned)objectno);
+      exv = &object_extents[object_t(buf)];
+      if (col)
+	*col = make_pair(objectno, exv);
+    }
+
     ObjectExtent *ex = 0;
-    vector<ObjectExtent>& exv = object_extents[oid];
-    if (exv.empty() || exv.back().offset + exv.back().length != x_offset) {
-      exv.resize(exv.size() + 1);
-      ex = &exv.back();
-      ex->oid = oid;
+    if (exv->empty() || exv->back().offset + exv->back().length != x_offset) {
+      exv->resize(exv->size() + 1);
+      ex = &exv->back();
+      if (exv->size() > 1)
+	ex->oid = exv->front().oid;
+      else
+	ex->oid = buf;
       ex->objectno = objectno;
-      ex->oloc = OSDMap::file_to_object_locator(*layout);
+      ex->oloc = oloc;
 
       ex->offset = x_offset;
       ex->length = x_len;
@@ -118,7 +184,7 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
       ldout(cct, 20) << " added new " << *ex << dendl;
     } else {
       // add to extent
-      ex = &exv.back();
+      ex = &exv->back();
       ldout(cct, 20) << " adding in to " << *ex << dendl;
       ex->length += x_len;
     }
@@ -135,12 +201,24 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
 void Striper::assimilate_extents(map<object_t,vector<ObjectExtent> >& object_extents,
 				 vector<ObjectExtent>& extents)
 {
-  // make final list
+  // make final list; the per-object lists are consumed, so take their
+  // names and buffer extents rather than copying them
+  size_t n = 0;
+  for (map<object_t, vector<ObjectExtent> >::iterator it = object_extents.begin();
+       it != object_extents.end();
+       ++it)
+    n += it->second.size();
+  extents.reserve(extents.size() + n);
   for (map<object_t, vector<ObjectExtent> >::iterator it = object_extents.begin();
        it != object_extents.end();
        ++it) {
     for (vector<ObjectExtent>::iterator p = it->second.begin(); p != it->second.end(); ++p) {
-      extents.push_back(*p);
+      extents.push_back(ObjectExtent(object_t(), p->objectno, p->offset,
+				     p->length, p->truncate_size));
+      ObjectExtent &ex = extents.back();
+      ex.oid.name.swap(p->oid.name);
+      ex.oloc = p->oloc;
+      ex.buffer_extents.swap(p->buffer_extents);
     }
   }
 }
@@ -51,6 +51,7 @@ class CephContext;
       file_to_extents(cct, buf, layout, offset, len, trunc_size, extents);
     }
 
+    /// append object_extents to extents; leaves object_extents' lists hollowed out
     static void assimilate_extents(map<object_t,vector<ObjectExtent> >& object_extents,
 				   vector<ObjectExtent>& extents);
 
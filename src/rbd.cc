@@ -1117,33 +1117,70 @@ static int do_bench_write(librbd::Image& image, uint64_t io_size,
   return 0;
 }
 
+/**
+ * Finds the periods (object sets) of an image that hold data, so that
+ * export does not read the rest.  Uses the object map when fast-diff is
+ * enabled, and one listsnaps per object otherwise.
+ */
+struct AllocatedPeriods {
+  uint64_t period;
+  std::set<uint64_t> periods;
+
+  AllocatedPeriods(uint64_t p) : period(p) {}
+
+  static int diff_cb(uint64_t offset, size_t length, int exists, void *arg) {
+    AllocatedPeriods *ap = reinterpret_cast<AllocatedPeriods *>(arg);
+    if (exists && length > 0) {
+      for (uint64_t p = offset / ap->period;
+	   p <= (offset + length - 1) / ap->period; ++p) {
+	ap->periods.insert(p);
+      }
+    }
+    return 0;
+  }
+
+  int find(librbd::Image &image, uint64_t size) {
+    int r = image.diff_iterate2(NULL, 0, size, true, true, &diff_cb, this);
+    if (r < 0) {
+      cerr << "rbd: cannot tell which parts of the image hold data, "
+	   << "reading all of it: " << cpp_strerror(r) << std::endl;
+    }
+    return r;
+  }
+};
+
 class C_Export : public Context
 {
 public:
-  C_Export(SimpleThrottle &simple_throttle, librbd::Image &image,
-                   uint64_t offset, uint64_t length, int fd)
-    : m_aio_completion(
-        new librbd::RBD::AioCompletion(this, &aio_context_callback)),
-      m_throttle(simple_throttle), m_image(image), m_offset(offset),
-      m_length(length), m_fd(fd)
+  C_Export(OrderedThrottle &ordered_throttle, librbd::Image &image,
+	   uint64_t offset, uint64_t length, bool hole, int fd)
+    : m_throttle(ordered_throttle), m_image(image), m_offset(offset),
+      m_length(length), m_hole(hole), m_fd(fd)
   {
   }
 
   void send()
   {
-    m_throttle.start_op();
+    C_OrderedThrottle *ctx = m_throttle.start_op(this);
+    if (m_hole) {
+      ctx->complete(0);
+      return;
+    }
 
+    librbd::RBD::AioCompletion *aio_completion =
+      new librbd::RBD::AioCompletion(ctx, &aio_context_callback);
     int op_flags = LIBRADOS_OP_FLAG_FADVISE_SEQUENTIAL |
 		   LIBRADOS_OP_FLAG_FADVISE_NOCACHE;
     int r = m_image.aio_read2(m_offset, m_length, m_bufferlist,
-                              m_aio_completion, op_flags);
+                              aio_completion, op_flags);
     if (r < 0) {
       cerr << "rbd: error requesting read from source image" << std::endl;
-      m_aio_completion->release();
-      m_throttle.end_op(r);
+      aio_completion->release();
+      ctx->complete(r);
     }
   }
 
+  // called in order, from the thread issuing the reads
   virtual void finish(int r)
   {
     BOOST_SCOPE_EXIT((&m_throttle) (&r))
@@ -1157,7 +1194,13 @@ public:
       return;
     }
 
-    assert(m_bufferlist.length() == static_cast<size_t>(r));
+    if (m_hole) {
+      if (m_fd != STDOUT_FILENO) {
+	return;
+      }
+      m_bufferlist.append_zero(m_length);
+    }
+    assert(m_bufferlist.length() == m_length);
     if (m_fd != STDOUT_FILENO) {
       if (m_bufferlist.is_zero()) {
         return;
@@ -1180,12 +1223,12 @@ public:
   }
 
 private:
-  librbd::RBD::AioCompletion *m_aio_completion;
-  SimpleThrottle &m_throttle;
+  OrderedThrottle &m_throttle;
   librbd::Image &m_image;
   bufferlist m_bufferlist;
   uint64_t m_offset;
   uint64_t m_length;
+  bool m_hole;
   int m_fd;
 };
 
@@ -1197,13 +1240,11 @@ static int do_export(librbd::Image& image, const char *path)
     return r;
 
   int fd;
-  int max_concurrent_ops;
+  int max_concurrent_ops = max(g_conf->rbd_concurrent_management_ops, 1);
   bool to_stdout = (strcmp(path, "-") == 0);
   if (to_stdout) {
     fd = STDOUT_FILENO;
-    max_concurrent_ops = 1;
   } else {
-    max_concurrent_ops = max(g_conf->rbd_concurrent_management_ops, 1);
     fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
     if (fd < 0) {
       return -errno;
@@ -1213,15 +1254,20 @@ static int do_export(librbd::Image& image, const char *path)
 
   MyProgressContext pc("Exporting image");
 
-  SimpleThrottle throttle(max_concurrent_ops, false);
   uint64_t period = image.get_stripe_count() * (1ull << info.order);
+  AllocatedPeriods allocated(period);
+  bool sparse = (allocated.find(image, info.size) == 0);
+
+  // the writes happen in image order, so the output may be a stream
+  OrderedThrottle throttle(max_concurrent_ops, false);
   for (uint64_t offset = 0; offset < info.size; offset += period) {
     if (throttle.pending_error()) {
       break;
     }
 
     uint64_t length = min(period, info.size - offset);
-    C_Export *ctx = new C_Export(throttle, image, offset, length, fd);
+    bool hole = sparse && allocated.periods.count(offset / period) == 0;
+    C_Export *ctx = new C_Export(throttle, image, offset, length, hole, fd);
     ctx->send();
 
     pc.update_progress(offset, info.size);
@@ -1652,7 +1698,28 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
   }
 
   // loop body handles 0 return, as we may have a block to flush
-  while ((readlen = ::read(fd, p + blklen, reqlen)) >= 0) {
+  while (true) {
+    if (!from_stdin && blklen == 0) {
+      // don't read the holes of a sparse source file
+      off64_t data = lseek64(fd, image_pos, SEEK_DATA);
+      if (data < 0 && errno == ENXIO) {
+	image_pos = size;
+	break;
+      }
+      if (data > (off64_t)image_pos) {
+	image_pos = data - data % imgblklen;
+	if (lseek64(fd, image_pos, SEEK_SET) != (off64_t)image_pos) {
+	  r = -errno;
+	  cerr << "rbd: error seeking in " << path << std::endl;
+	  goto done;
+	}
+      }
+    }
+    readlen = ::read(fd, p + blklen, reqlen);
+    if (readlen < 0) {
+      break;
+    }
+
     if (throttle->pending_error()) {
       break;
     }
@@ -229,19 +229,26 @@ void UnknownAction::dump(Formatter *f) const {
 }
 
 void ActionEntry::encode(bufferlist &bl) const {
-  ENCODE_START(1, 1, bl);
+  ENCODE_START(2, 1, bl);
   boost::apply_visitor(EncodeVisitor(bl), action);
+  ::encode(start_time, bl);
   ENCODE_FINISH(bl);
 }
 
 void ActionEntry::decode(bufferlist::iterator &it) {
-  DECODE_START(1, it);
+  DECODE_START(2, it);
   decode(struct_v, it);
+  if (struct_v >= 2) {
+    ::decode(start_time, it);
+  } else {
+    start_time = 0;
+  }
   DECODE_FINISH(it);
 }
 
 void ActionEntry::decode_unversioned(bufferlist::iterator &it) {
   decode(0, it);
+  start_time = 0;
 }
 
 void ActionEntry::decode(__u8 version, bufferlist::iterator &it) {
@@ -281,6 +288,7 @@ void ActionEntry::decode(__u8 version, bufferlist::iterator &it) {
 
 void ActionEntry::dump(Formatter *f) const {
   boost::apply_visitor(DumpVisitor(f), action);
+  f->dump_unsigned("start_time", start_time);
 }
 
 void ActionEntry::generate_test_instances(std::list<ActionEntry *> &o) {
@@ -311,6 +319,8 @@ void ActionEntry::generate_test_instances(std::list<ActionEntry *> &o) {
                                               true)));
   o.push_back(new ActionEntry(CloseImageAction()));
   o.push_back(new ActionEntry(CloseImageAction(1, 123456789, dependencies, 3)));
+  o.push_back(new ActionEntry(AioWriteAction(1, 123456789, dependencies, 3, 4,
+                                             5), 987654321));
 }
 
 } // namespace action
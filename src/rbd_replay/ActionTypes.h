@@ -26,6 +26,13 @@ typedef uint32_t action_id_t;
 
 static const std::string BANNER("rbd-replay-trace");
 
+/**
+ * Banner of a trace whose ActionEntries are grouped into snappy
+ * compressed blocks, each encoded as the uint32_t uncompressed and
+ * compressed lengths followed by the compressed bytes.
+ */
+static const std::string COMPRESSED_BANNER("rbd-replay-ztrace");
+
 /**
  * Dependencies link actions to earlier actions or completions.
  * If an action has a dependency \c d then it waits until \c d.time_delta
@@ -246,10 +253,13 @@ typedef boost::variant<StartThreadAction,
 class ActionEntry {
 public:
   Action action;
+  /// Nanoseconds into the trace the action started at; 0 if unknown.
+  uint64_t start_time;
 
-  ActionEntry() : action(UnknownAction()) {
+  ActionEntry() : action(UnknownAction()), start_time(0) {
   }
-  ActionEntry(const Action &action) : action(action) {
+  ActionEntry(const Action &action, uint64_t start_time = 0)
+    : action(action), start_time(start_time) {
   }
 
   void encode(bufferlist &bl) const;
@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "rbd_replay/BufferReader.h"
+#include "compressor/Compressor.h"
 #include "include/assert.h"
 #include "include/intarith.h"
 
@@ -9,25 +10,112 @@ namespace rbd_replay {
 
 BufferReader::BufferReader(int fd, size_t min_bytes, size_t max_bytes)
   : m_fd(fd), m_min_bytes(min_bytes), m_max_bytes(max_bytes),
-    m_bl_it(m_bl.begin()) {
+    m_bl_it(m_bl.begin()), m_eof(false) {
   assert(m_min_bytes <= m_max_bytes);
 }
 
+BufferReader::~BufferReader() {
+}
+
 int BufferReader::fetch(bufferlist::iterator **it) {
-  if (m_bl_it.get_remaining() < m_min_bytes) {
-    ssize_t bytes_to_read = ROUND_UP_TO(m_max_bytes - m_bl_it.get_remaining(),
-                                        CEPH_BUFFER_APPEND_SIZE);
-    while (bytes_to_read > 0) {
-      int r = m_bl.read_fd(m_fd, CEPH_BUFFER_APPEND_SIZE);
+  if (m_bl_it.get_remaining() < m_min_bytes &&
+      (!m_eof || m_raw.length() > 0)) {
+    // keep only what has not been decoded yet
+    bufferlist bl;
+    m_bl_it.copy(m_bl_it.get_remaining(), bl);
+    size_t bytes = m_max_bytes - bl.length();
+    int r = m_compressor ? read_blocks(&bl, bytes) : read(&bl, bytes);
+    m_bl.swap(bl);
+    m_bl_it = m_bl.begin();
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  *it = &m_bl_it;
+  return 0;
+}
+
+void BufferReader::set_compressed() {
+  assert(!m_compressor);
+  m_bl_it.copy(m_bl_it.get_remaining(), m_raw);
+  m_bl.clear();
+  m_bl_it = m_bl.begin();
+  m_compressor.reset(Compressor::create("snappy"));
+}
+
+int BufferReader::read(bufferlist *bl, size_t bytes) {
+  ssize_t bytes_to_read = ROUND_UP_TO(bytes, CEPH_BUFFER_APPEND_SIZE);
+  while (bytes_to_read > 0) {
+    int r = bl->read_fd(m_fd, CEPH_BUFFER_APPEND_SIZE);
+    if (r < 0) {
+      return r;
+    } else if (r == 0) {
+      m_eof = true;
+      break;
+    }
+    assert(r <= bytes_to_read);
+    bytes_to_read -= r;
+  }
+  return 0;
+}
+
+int BufferReader::read_blocks(bufferlist *bl, size_t bytes) {
+  uint32_t header_len = sizeof(uint32_t) * 2;
+  size_t target = bl->length() + bytes;
+  while (bl->length() < target) {
+    if (m_raw.length() < header_len && !m_eof) {
+      int r = read(&m_raw, m_max_bytes);
+      if (r < 0) {
+        return r;
+      }
+    }
+    if (m_raw.length() == 0) {
+      break;
+    }
+
+    uint32_t raw_len, compressed_len;
+    try {
+      bufferlist::iterator p = m_raw.begin();
+      ::decode(raw_len, p);
+      ::decode(compressed_len, p);
+    } catch (const buffer::error &err) {
+      return -EINVAL;
+    }
+    while (m_raw.length() < header_len + compressed_len && !m_eof) {
+      int r = read(&m_raw, header_len + compressed_len - m_raw.length());
       if (r < 0) {
         return r;
       }
-      assert(r <= bytes_to_read);
-      bytes_to_read -= r;
     }
+    if (m_raw.length() < header_len + compressed_len) {
+      // truncated trace
+      return -EINVAL;
+    }
+
+    bufferlist compressed;
+    m_raw.splice(0, header_len);
+    m_raw.splice(0, compressed_len, &compressed);
+    bufferlist block;
+    int r = m_compressor->decompress(compressed, block);
+    if (r < 0 || block.length() != raw_len) {
+      return -EINVAL;
+    }
+    bl->claim_append(block);
   }
+  return 0;
+}
 
-  *it = &m_bl_it;
+int encode_compressed_block(bufferlist &bl, bufferlist *out) {
+  boost::scoped_ptr<Compressor> compressor(Compressor::create("snappy"));
+  bufferlist compressed;
+  int r = compressor->compress(bl, compressed);
+  if (r < 0) {
+    return r;
+  }
+  ::encode(static_cast<uint32_t>(bl.length()), *out);
+  ::encode(static_cast<uint32_t>(compressed.length()), *out);
+  out->claim_append(compressed);
   return 0;
 }
 
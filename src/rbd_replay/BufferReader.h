@@ -6,9 +6,17 @@
 
 #include "include/int_types.h"
 #include "include/buffer.h"
+#include "include/encoding.h"
+#include <boost/scoped_ptr.hpp>
+
+class Compressor;
 
 namespace rbd_replay {
 
+/**
+ * Reads a trace a piece at a time, keeping between min_bytes and
+ * max_bytes of it in memory and dropping what has been decoded.
+ */
 class BufferReader {
 public:
   static const size_t DEFAULT_MIN_BYTES = 1<<20;
@@ -16,9 +24,17 @@ public:
 
   BufferReader(int fd, size_t min_bytes = DEFAULT_MIN_BYTES,
                size_t max_bytes = DEFAULT_MAX_BYTES);
+  ~BufferReader();
 
   int fetch(bufferlist::iterator **it);
 
+  /**
+   * Treats everything after what has been fetched so far as compressed
+   * blocks (see action::COMPRESSED_BANNER), and decompresses them as
+   * they are fetched.
+   */
+  void set_compressed();
+
 private:
   int m_fd;
   size_t m_min_bytes;
@@ -26,8 +42,21 @@ private:
   bufferlist m_bl;
   bufferlist::iterator m_bl_it;
 
+  boost::scoped_ptr<Compressor> m_compressor;
+  /// compressed bytes read from m_fd but not decompressed yet
+  bufferlist m_raw;
+  bool m_eof;
+
+  int read(bufferlist *bl, size_t bytes);
+  int read_blocks(bufferlist *bl, size_t bytes);
 };
 
+/**
+ * Appends bl to out as one block of a compressed trace.
+ * @return 0 on success, or a negative error code
+ */
+int encode_compressed_block(bufferlist &bl, bufferlist *out);
+
 } // namespace rbd_replay
 
 #endif // CEPH_RBD_REPLAY_BUFFER_READER_H
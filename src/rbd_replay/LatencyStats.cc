@@ -0,0 +1,82 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "LatencyStats.hpp"
+#include "common/Formatter.h"
+#include <algorithm>
+
+
+using namespace rbd_replay;
+
+LatencyStats::LatencyStats()
+  : m_ops(0), m_bytes(0), m_sum_ns(0), m_max_ns(0), m_buckets(1, 0) {
+}
+
+void LatencyStats::add(uint64_t bytes, uint64_t latency_ns) {
+  ++m_ops;
+  m_bytes += bytes;
+  m_sum_ns += latency_ns;
+  m_max_ns = std::max(m_max_ns, latency_ns);
+
+  uint64_t us = latency_ns / 1000;
+  size_t bucket = 0;
+  while (us > 0) {
+    us >>= 1;
+    ++bucket;
+  }
+  if (bucket >= m_buckets.size()) {
+    m_buckets.resize(bucket + 1, 0);
+  }
+  ++m_buckets[bucket];
+}
+
+uint64_t LatencyStats::percentile(double p) const {
+  if (m_ops == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(p / 100 * m_ops);
+  if (rank >= m_ops) {
+    rank = m_ops - 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < m_buckets.size(); ++i) {
+    seen += m_buckets[i];
+    if (seen > rank) {
+      return std::min((1ull << i) * 1000, (unsigned long long)m_max_ns);
+    }
+  }
+  return m_max_ns;
+}
+
+void LatencyStats::dump(ceph::Formatter *f, double seconds) const {
+  f->dump_unsigned("ops", m_ops);
+  f->dump_unsigned("bytes", m_bytes);
+  if (seconds > 0) {
+    f->dump_float("ops_per_sec", m_ops / seconds);
+    f->dump_float("bytes_per_sec", m_bytes / seconds);
+  }
+  f->open_object_section("latency_us");
+  f->dump_float("avg", m_ops ? m_sum_ns / 1000.0 / m_ops : 0);
+  f->dump_float("p50", percentile(50) / 1000.0);
+  f->dump_float("p95", percentile(95) / 1000.0);
+  f->dump_float("p99", percentile(99) / 1000.0);
+  f->dump_float("max", m_max_ns / 1000.0);
+  f->close_section();
+  f->open_array_section("histogram");
+  for (size_t i = 0; i < m_buckets.size(); ++i) {
+    f->open_object_section("bucket");
+    f->dump_unsigned("below_us", 1ull << i);
+    f->dump_unsigned("count", m_buckets[i]);
+    f->close_section();
+  }
+  f->close_section();
+}
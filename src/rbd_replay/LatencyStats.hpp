@@ -0,0 +1,63 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef _INCLUDED_RBD_REPLAY_LATENCYSTATS_HPP
+#define _INCLUDED_RBD_REPLAY_LATENCYSTATS_HPP
+
+#include "include/int_types.h"
+#include <vector>
+
+namespace ceph { class Formatter; }
+
+namespace rbd_replay {
+
+/**
+   Latency distribution of a stream of I/Os.
+   Latencies are counted in power-of-two buckets of microseconds, so
+   percentiles are only exact to within a factor of two; the mean and
+   maximum are exact.
+ */
+class LatencyStats {
+public:
+  LatencyStats();
+
+  void add(uint64_t bytes, uint64_t latency_ns);
+
+  uint64_t ops() const {
+    return m_ops;
+  }
+
+  uint64_t bytes() const {
+    return m_bytes;
+  }
+
+  /// Upper bound of the bucket holding the p'th percentile, in nanoseconds.
+  uint64_t percentile(double p) const;
+
+  /**
+     Dumps counts, throughput and latencies.
+     @param seconds wall time the I/Os were issued over, for the rates
+   */
+  void dump(ceph::Formatter *f, double seconds) const;
+
+private:
+  uint64_t m_ops;
+  uint64_t m_bytes;
+  uint64_t m_sum_ns;
+  uint64_t m_max_ns;
+  /// Bucket i counts latencies below 2^i microseconds.
+  std::vector<uint64_t> m_buckets;
+};
+
+}
+
+#endif
@@ -29,9 +29,28 @@ PendingIO::PendingIO(action_id_t id,
 		     ActionCtx &worker)
   : m_id(id),
     m_completion(new librbd::RBD::AioCompletion(this, rbd_replay_pending_io_callback)),
-    m_worker(worker) {
+    m_worker(worker),
+    m_is_io(false),
+    m_imagectx_id(0),
+    m_write(false),
+    m_length(0) {
     }
 
+PendingIO::PendingIO(action_id_t id,
+		     ActionCtx &worker,
+		     imagectx_id_t imagectx_id,
+		     bool write,
+		     uint64_t length)
+  : m_id(id),
+    m_completion(new librbd::RBD::AioCompletion(this, rbd_replay_pending_io_callback)),
+    m_worker(worker),
+    m_is_io(true),
+    m_imagectx_id(imagectx_id),
+    m_write(write),
+    m_length(length),
+    m_start_time(boost::get_system_time()) {
+}
+
 PendingIO::~PendingIO() {
   m_completion->release();
 }
@@ -16,6 +16,7 @@
 #define _INCLUDED_RBD_REPLAY_PENDINGIO_HPP
 
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/thread_time.hpp>
 #include "actions.hpp"
 
 /// Do not call outside of rbd_replay::PendingIO.
@@ -34,12 +35,39 @@ public:
   PendingIO(action_id_t id,
             ActionCtx &worker);
 
+  /// A read or write of length bytes, timed for the latency report.
+  PendingIO(action_id_t id,
+            ActionCtx &worker,
+            imagectx_id_t imagectx_id,
+            bool write,
+            uint64_t length);
+
   ~PendingIO();
 
   action_id_t id() const {
     return m_id;
   }
 
+  bool is_io() const {
+    return m_is_io;
+  }
+
+  imagectx_id_t imagectx_id() const {
+    return m_imagectx_id;
+  }
+
+  bool is_write() const {
+    return m_write;
+  }
+
+  uint64_t length() const {
+    return m_length;
+  }
+
+  const boost::system_time &start_time() const {
+    return m_start_time;
+  }
+
   ceph::bufferlist &bufferlist() {
     return m_bl;
   }
@@ -57,6 +85,11 @@ private:
   ceph::bufferlist m_bl;
   librbd::RBD::AioCompletion *m_completion;
   ActionCtx &m_worker;
+  bool m_is_io;
+  imagectx_id_t m_imagectx_id;
+  bool m_write;
+  uint64_t m_length;
+  boost::system_time m_start_time;
 };
 
 }
@@ -14,6 +14,7 @@
 
 #include "Replayer.hpp"
 #include "common/errno.h"
+#include "common/Formatter.h"
 #include "rbd_replay/ActionTypes.h"
 #include "rbd_replay/BufferReader.h"
 #include <boost/foreach.hpp>
@@ -29,6 +30,20 @@ using namespace rbd_replay;
 
 namespace {
 
+bool has_banner(bufferlist::iterator *it, const std::string &expected) {
+  if (it->get_remaining() < expected.size()) {
+    return false;
+  }
+
+  std::string banner;
+  it->copy(expected.size(), banner);
+  if (banner != expected) {
+    it->seek(0);
+    return false;
+  }
+  return true;
+}
+
 bool is_versioned_replay(BufferReader &buffer_reader) {
   bufferlist::iterator *it;
   int r = buffer_reader.fetch(&it);
@@ -36,17 +51,11 @@ bool is_versioned_replay(BufferReader &buffer_reader) {
     return false;
   }
 
-  if (it->get_remaining() < action::BANNER.size()) {
-    return false;
-  }
-
-  std::string banner;
-  it->copy(action::BANNER.size(), banner);
-  bool versioned = (banner == action::BANNER);
-  if (!versioned) {
-    it->seek(0);
+  if (has_banner(it, action::COMPRESSED_BANNER)) {
+    buffer_reader.set_compressed();
+    return true;
   }
-  return versioned;
+  return has_banner(it, action::BANNER);
 }
 
 } // anonymous namespace
@@ -87,7 +96,7 @@ void Worker::run() {
   while (!m_done) {
     Action::ptr action;
     m_buffer.pop_back(&action);
-    m_replayer.wait_for_actions(action->predecessors());
+    m_replayer.wait_for_actions(action->predecessors(), action->start_time());
     action->perform(*this);
     m_replayer.set_action_complete(action->id());
   }
@@ -112,6 +121,9 @@ void Worker::run() {
 
 void Worker::remove_pending(PendingIO::ptr io) {
   assert(io);
+  if (io->is_io()) {
+    m_replayer.record_io(*io);
+  }
   m_replayer.set_action_complete(io->id());
   boost::mutex::scoped_lock lock(m_pending_ios_mutex);
   size_t num_erased = m_pending_ios.erase(io->id());
@@ -127,9 +139,10 @@ librbd::Image* Worker::get_image(imagectx_id_t imagectx_id) {
 }
 
 
-void Worker::put_image(imagectx_id_t imagectx_id, librbd::Image* image) {
+void Worker::put_image(imagectx_id_t imagectx_id, librbd::Image* image,
+                       const string &name) {
   assert(image);
-  m_replayer.put_image(imagectx_id, image);
+  m_replayer.put_image(imagectx_id, image, name);
 }
 
 
@@ -163,7 +176,8 @@ rbd_loc Worker::map_image_name(string image_name, string snap_name) const {
 Replayer::Replayer(int num_action_trackers)
   : m_rbd(NULL), m_ioctx(0),  
     m_pool_name("rbd"), m_latency_multiplier(1.0), 
-    m_readonly(false), m_dump_perf_counters(false),
+    m_readonly(false), m_dump_perf_counters(false), m_open_loop(false),
+    m_trace_start(0),
     m_num_action_trackers(num_action_trackers),
     m_action_trackers(new action_tracker_d[m_num_action_trackers]) {
   assertf(num_action_trackers > 0, "num_action_trackers = %d", num_action_trackers);
@@ -214,6 +228,8 @@ void Replayer::run(const std::string& replay_file) {
 
       BufferReader buffer_reader(fd);
       bool versioned = is_versioned_replay(buffer_reader);
+      boost::system_time run_start(boost::get_system_time());
+      bool warned_open_loop = false;
       while (true) {
         action::ActionEntry action_entry;
         try {
@@ -224,6 +240,9 @@ void Replayer::run(const std::string& replay_file) {
                       << std::endl;
             exit(-r);
           }
+          if (it->get_remaining() == 0) {
+            break;
+          }
 
           if (versioned) {
             action_entry.decode(*it);
@@ -241,6 +260,17 @@ void Replayer::run(const std::string& replay_file) {
 	  continue;
 	}
 
+	if (m_trace_start == 0 && action->start_time() != 0) {
+	  // workers only see these once the action is queued to them
+	  m_trace_start = action->start_time();
+	  m_replay_start = boost::get_system_time();
+	} else if (m_open_loop && action->start_time() == 0 &&
+		   !warned_open_loop) {
+	  std::cerr << "Trace has no start times, replaying closed loop; "
+		    << "rerun rbd-replay-prep to record them" << std::endl;
+	  warned_open_loop = true;
+	}
+
 	if (action->is_start_thread()) {
 	  Worker *worker = new Worker(*this);
 	  workers[action->thread_id()] = worker;
@@ -256,6 +286,11 @@ void Replayer::run(const std::string& replay_file) {
 	w.second->join();
 	delete w.second;
       }
+      if (!m_latency_report.empty()) {
+	double seconds =
+	  (boost::get_system_time() - run_start).total_microseconds() / 1000000.0;
+	write_latency_report(seconds);
+      }
       clear_images();
       delete m_rbd;
       m_rbd = NULL;
@@ -274,8 +309,13 @@ librbd::Image* Replayer::get_image(imagectx_id_t imagectx_id) {
   return m_images[imagectx_id];
 }
 
-void Replayer::put_image(imagectx_id_t imagectx_id, librbd::Image *image) {
+void Replayer::put_image(imagectx_id_t imagectx_id, librbd::Image *image,
+                         const string &name) {
   assert(image);
+  {
+    boost::mutex::scoped_lock lock(m_stats_mutex);
+    m_image_names[imagectx_id] = name;
+  }
   boost::unique_lock<boost::shared_mutex> lock(m_images_mutex);
   assert(m_images.count(imagectx_id) == 0);
   m_images[imagectx_id] = image;
@@ -314,8 +354,13 @@ bool Replayer::is_action_complete(action_id_t id) {
   return tracker.actions.count(id) > 0;
 }
 
-void Replayer::wait_for_actions(const action::Dependencies &deps) {
+void Replayer::wait_for_actions(const action::Dependencies &deps,
+                                uint64_t start_time) {
   boost::posix_time::ptime release_time(boost::posix_time::neg_infin);
+  bool open_loop = m_open_loop && start_time != 0 && m_trace_start != 0;
+  if (open_loop) {
+    release_time = scheduled_time(start_time);
+  }
   BOOST_FOREACH(const action::Dependency &dep, deps) {
     dout(DEPGRAPH_LEVEL) << "Waiting for " << dep.id << dendl;
     boost::system_time start_time(boost::get_system_time());
@@ -334,6 +379,10 @@ void Replayer::wait_for_actions(const action::Dependencies &deps) {
     boost::system_time end_time(boost::get_system_time());
     long long micros = (end_time - start_time).total_microseconds();
     dout(DEPGRAPH_LEVEL) << "Finished waiting for " << dep.id << " after " << micros << " microseconds" << dendl;
+    if (open_loop) {
+      // the schedule already has the trace's delays in it
+      continue;
+    }
     // Apparently the nanoseconds constructor is optional:
     // http://www.boost.org/doc/libs/1_46_0/doc/html/date_time/details.html#compile_options
     boost::system_time sub_release_time(action_completed_time + boost::posix_time::microseconds(dep.time_delta * m_latency_multiplier / 1000));
@@ -344,6 +393,77 @@ void Replayer::wait_for_actions(const action::Dependencies &deps) {
   if (release_time > boost::get_system_time()) {
     dout(SLEEP_LEVEL) << "Sleeping for " << (release_time - boost::get_system_time()).total_microseconds() << " microseconds" << dendl;
     boost::this_thread::sleep(release_time);
+  } else if (open_loop) {
+    long long lag = (boost::get_system_time() - release_time).total_microseconds();
+    boost::mutex::scoped_lock lock(m_stats_mutex);
+    m_schedule_lag.add(0, lag * 1000);
+    return;
+  }
+  if (open_loop) {
+    boost::mutex::scoped_lock lock(m_stats_mutex);
+    m_schedule_lag.add(0, 0);
+  }
+}
+
+boost::system_time Replayer::scheduled_time(uint64_t start_time) const {
+  if (start_time <= m_trace_start) {
+    return m_replay_start;
+  }
+  uint64_t micros = (start_time - m_trace_start) * m_latency_multiplier / 1000;
+  return m_replay_start + boost::posix_time::microseconds(micros);
+}
+
+void Replayer::record_io(const PendingIO &io) {
+  if (io.is_write() && m_readonly) {
+    // never sent
+    return;
+  }
+  boost::posix_time::time_duration latency(boost::get_system_time() - io.start_time());
+  boost::mutex::scoped_lock lock(m_stats_mutex);
+  image_stats_d &stats = m_image_stats[m_image_names[io.imagectx_id()]];
+  LatencyStats &s = io.is_write() ? stats.write : stats.read;
+  s.add(io.length(), latency.total_microseconds() * 1000);
+}
+
+void Replayer::write_latency_report(double seconds) {
+  boost::mutex::scoped_lock lock(m_stats_mutex);
+  ceph::JSONFormatter f(true);
+  f.open_object_section("replay");
+  f.dump_float("elapsed_sec", seconds);
+  f.dump_float("latency_multiplier", m_latency_multiplier);
+  f.dump_bool("open_loop", m_open_loop && m_trace_start != 0);
+  if (m_open_loop && m_trace_start != 0) {
+    f.open_object_section("schedule_lag");
+    m_schedule_lag.dump(&f, 0);
+    f.close_section();
+  }
+  f.open_array_section("images");
+  for (map<string, image_stats_d>::iterator it = m_image_stats.begin();
+       it != m_image_stats.end(); ++it) {
+    f.open_object_section("image");
+    f.dump_string("name", it->first);
+    f.open_object_section("read");
+    it->second.read.dump(&f, seconds);
+    f.close_section();
+    f.open_object_section("write");
+    it->second.write.dump(&f, seconds);
+    f.close_section();
+    f.close_section();
+  }
+  f.close_section();
+  f.close_section();
+
+  if (m_latency_report == "-") {
+    f.flush(cout);
+    cout << std::endl;
+    return;
+  }
+  ofstream out(m_latency_report.c_str());
+  f.flush(out);
+  out << std::endl;
+  if (!out) {
+    cerr << "Failed to write latency report to " << m_latency_report
+         << std::endl;
   }
 }
 
@@ -20,6 +20,7 @@
 #include "rbd_replay/ActionTypes.h"
 #include "BoundedBuffer.hpp"
 #include "ImageNameMap.hpp"
+#include "LatencyStats.hpp"
 #include "PendingIO.hpp"
 
 namespace rbd_replay {
@@ -48,7 +49,8 @@ public:
 
   librbd::Image* get_image(imagectx_id_t imagectx_id);
 
-  void put_image(imagectx_id_t imagectx_id, librbd::Image* image);
+  void put_image(imagectx_id_t imagectx_id, librbd::Image* image,
+                 const std::string &name);
 
   void erase_image(imagectx_id_t imagectx_id);
 
@@ -93,7 +95,8 @@ public:
 
   librbd::Image* get_image(imagectx_id_t imagectx_id);
 
-  void put_image(imagectx_id_t imagectx_id, librbd::Image *image);
+  void put_image(imagectx_id_t imagectx_id, librbd::Image *image,
+                 const std::string &name);
 
   void erase_image(imagectx_id_t imagectx_id);
 
@@ -101,7 +104,18 @@ public:
 
   bool is_action_complete(action_id_t id);
 
-  void wait_for_actions(const action::Dependencies &deps);
+  /**
+     Waits until an action may be performed.
+     Normally that is the longest time_delta after any of its
+     dependencies completed.  In open loop mode it is the time the action
+     started at in the trace, scaled by the latency multiplier, or when
+     its dependencies completed if that is later.
+     @param start_time nanoseconds into the trace the action started at
+   */
+  void wait_for_actions(const action::Dependencies &deps, uint64_t start_time);
+
+  /// Accounts a completed read or write to the latency report.
+  void record_io(const PendingIO &io);
 
   std::string pool_name() const;
 
@@ -121,6 +135,21 @@ public:
     m_dump_perf_counters = dump_perf_counters;
   }
 
+  /**
+     Releases actions at their original start times instead of relative
+     to when their dependencies complete, so that a slower cluster does
+     not stretch the inter-arrival times of independent I/Os.
+     Needs a trace with start times; rbd-replay-prep writes them.
+   */
+  void set_open_loop(bool open_loop) {
+    m_open_loop = open_loop;
+  }
+
+  /// Writes a JSON latency and throughput report to path ("-" for stdout).
+  void set_latency_report(const std::string &path) {
+    m_latency_report = path;
+  }
+
   const ImageNameMap &image_name_map() const {
     return m_image_name_map;
   }
@@ -133,10 +162,19 @@ private:
     boost::condition condition;
   };
 
+  struct image_stats_d {
+    LatencyStats read;
+    LatencyStats write;
+  };
+
   void clear_images();
 
   action_tracker_d &tracker_for(action_id_t id);
 
+  boost::system_time scheduled_time(uint64_t start_time) const;
+
+  void write_latency_report(double seconds);
+
   /// Disallow copying
   Replayer(const Replayer& rhs);
   /// Disallow assignment
@@ -149,6 +187,19 @@ private:
   bool m_readonly;
   ImageNameMap m_image_name_map;
   bool m_dump_perf_counters;
+  bool m_open_loop;
+  std::string m_latency_report;
+
+  /// Trace time of the first action, and the time it was replayed at.
+  uint64_t m_trace_start;
+  boost::system_time m_replay_start;
+
+  /// Keyed by image name, so that reopening an image adds to its numbers.
+  std::map<std::string, image_stats_d> m_image_stats;
+  std::map<imagectx_id_t, std::string> m_image_names;
+  /// How late open loop actions were released, waiting on dependencies included.
+  LatencyStats m_schedule_lag;
+  boost::mutex m_stats_mutex;
 
   std::map<imagectx_id_t, librbd::Image*> m_images;
   boost::shared_mutex m_images_mutex;
@@ -77,7 +77,12 @@ std::ostream& rbd_replay::operator<<(std::ostream& o, const Action& a) {
 }
 
 Action::ptr Action::construct(const action::ActionEntry &action_entry) {
-  return boost::apply_visitor(ConstructVisitor(), action_entry.action);
+  Action::ptr action = boost::apply_visitor(ConstructVisitor(),
+                                           action_entry.action);
+  if (action) {
+    action->m_start_time = action_entry.start_time;
+  }
+  return action;
 }
 
 void StartThreadAction::perform(ActionCtx &ctx) {
@@ -94,7 +99,8 @@ void AioReadAction::perform(ActionCtx &worker) {
   dout(ACTION_LEVEL) << "Performing " << *this << dendl;
   librbd::Image *image = worker.get_image(m_action.imagectx_id);
   assert(image);
-  PendingIO::ptr io(new PendingIO(pending_io_id(), worker));
+  PendingIO::ptr io(new PendingIO(pending_io_id(), worker, m_action.imagectx_id,
+                                  false, m_action.length));
   worker.add_pending(io);
   int r = image->aio_read(m_action.offset, m_action.length, io->bufferlist(), &io->completion());
   assertf(r >= 0, "id = %d, r = %d", id(), r);
@@ -103,7 +109,8 @@ void AioReadAction::perform(ActionCtx &worker) {
 void ReadAction::perform(ActionCtx &worker) {
   dout(ACTION_LEVEL) << "Performing " << *this << dendl;
   librbd::Image *image = worker.get_image(m_action.imagectx_id);
-  PendingIO::ptr io(new PendingIO(pending_io_id(), worker));
+  PendingIO::ptr io(new PendingIO(pending_io_id(), worker, m_action.imagectx_id,
+                                  false, m_action.length));
   worker.add_pending(io);
   ssize_t r = image->read(m_action.offset, m_action.length, io->bufferlist());
   assertf(r >= 0, "id = %d, r = %d", id(), r);
@@ -115,7 +122,8 @@ void AioWriteAction::perform(ActionCtx &worker) {
   static const std::string fake_data(create_fake_data());
   dout(ACTION_LEVEL) << "Performing " << *this << dendl;
   librbd::Image *image = worker.get_image(m_action.imagectx_id);
-  PendingIO::ptr io(new PendingIO(pending_io_id(), worker));
+  PendingIO::ptr io(new PendingIO(pending_io_id(), worker, m_action.imagectx_id,
+                                  true, m_action.length));
   uint64_t remaining = m_action.length;
   while (remaining > 0) {
     uint64_t n = std::min(remaining, (uint64_t)fake_data.length());
@@ -134,7 +142,8 @@ void AioWriteAction::perform(ActionCtx &worker) {
 void WriteAction::perform(ActionCtx &worker) {
   dout(ACTION_LEVEL) << "Performing " << *this << dendl;
   librbd::Image *image = worker.get_image(m_action.imagectx_id);
-  PendingIO::ptr io(new PendingIO(pending_io_id(), worker));
+  PendingIO::ptr io(new PendingIO(pending_io_id(), worker, m_action.imagectx_id,
+                                  true, m_action.length));
   worker.add_pending(io);
   io->bufferlist().append_zero(m_action.length);
   if (!worker.readonly()) {
@@ -165,7 +174,7 @@ void OpenImageAction::perform(ActionCtx &worker) {
 	 << ": (" << -r << ") " << strerror(-r) << std::endl;
     exit(1);
   }
-  worker.put_image(m_action.imagectx_id, image);
+  worker.put_image(m_action.imagectx_id, image, name.str());
   worker.remove_pending(io);
 }
 
@@ -45,21 +45,23 @@ public:
 
   /**
      Returns the image with the given ID.
-     The image must have been previously tracked with put_image(imagectx_id_t,librbd::Image*).
+     The image must have been previously tracked with put_image(imagectx_id_t,librbd::Image*,const std::string&).
    */
   virtual librbd::Image* get_image(imagectx_id_t imagectx_id) = 0;
 
   /**
      Tracks an image.
-     put_image(imagectx_id_t,librbd::Image*) must not have been called previously with the same ID,
+     put_image(imagectx_id_t,librbd::Image*,const std::string&) must not have been called previously with the same ID,
      and the image must not be NULL.
+     @param name name the image was opened under, for reporting
    */
-  virtual void put_image(imagectx_id_t imagectx_id, librbd::Image* image) = 0;
+  virtual void put_image(imagectx_id_t imagectx_id, librbd::Image* image,
+                         const std::string &name) = 0;
 
   /**
      Stops tracking an Image and release it.
      This deletes the C++ object, not the image itself.
-     The image must have been previously tracked with put_image(imagectx_id_t,librbd::Image*).
+     The image must have been previously tracked with put_image(imagectx_id_t,librbd::Image*,const std::string&).
    */
   virtual void erase_image(imagectx_id_t imagectx_id) = 0;
 
@@ -116,9 +118,21 @@ public:
   virtual thread_id_t thread_id() const = 0;
   virtual const action::Dependencies& predecessors() const = 0;
 
+  /// Nanoseconds into the trace the action started at, or 0 if unknown.
+  uint64_t start_time() const {
+    return m_start_time;
+  }
+
   virtual std::ostream& dump(std::ostream& o) const = 0;
 
   static ptr construct(const action::ActionEntry &action_entry);
+
+protected:
+  Action() : m_start_time(0) {
+  }
+
+private:
+  uint64_t m_start_time;
 };
 
 template <typename ActionType>
@@ -70,7 +70,7 @@ ostream& operator<<(ostream& out, IO::ptr io) {
 void StartThreadIO::encode(bufferlist &bl) const {
   action::Action action((action::StartThreadAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()))));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void StartThreadIO::write_debug(std::ostream& out) const {
@@ -80,7 +80,7 @@ void StartThreadIO::write_debug(std::ostream& out) const {
 void StopThreadIO::encode(bufferlist &bl) const {
   action::Action action((action::StopThreadAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()))));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void StopThreadIO::write_debug(std::ostream& out) const {
@@ -91,7 +91,7 @@ void ReadIO::encode(bufferlist &bl) const {
   action::Action action((action::ReadAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()),
     m_imagectx, m_offset, m_length)));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void ReadIO::write_debug(std::ostream& out) const {
@@ -103,7 +103,7 @@ void WriteIO::encode(bufferlist &bl) const {
   action::Action action((action::WriteAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()),
     m_imagectx, m_offset, m_length)));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void WriteIO::write_debug(std::ostream& out) const {
@@ -115,7 +115,7 @@ void AioReadIO::encode(bufferlist &bl) const {
   action::Action action((action::AioReadAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()),
     m_imagectx, m_offset, m_length)));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void AioReadIO::write_debug(std::ostream& out) const {
@@ -127,7 +127,7 @@ void AioWriteIO::encode(bufferlist &bl) const {
   action::Action action((action::AioWriteAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()),
     m_imagectx, m_offset, m_length)));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void AioWriteIO::write_debug(std::ostream& out) const {
@@ -139,7 +139,7 @@ void OpenImageIO::encode(bufferlist &bl) const {
   action::Action action((action::OpenImageAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()),
     m_imagectx, m_name, m_snap_name, m_readonly)));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void OpenImageIO::write_debug(std::ostream& out) const {
@@ -151,7 +151,7 @@ void CloseImageIO::encode(bufferlist &bl) const {
   action::Action action((action::CloseImageAction(
     ionum(), thread_id(), convert_dependencies(start_time(), dependencies()),
     m_imagectx)));
-  ::encode(action, bl);
+  ::encode(action::ActionEntry(action, start_time()), bl);
 }
 
 void CloseImageIO::write_debug(std::ostream& out) const {
@@ -29,6 +29,7 @@
 #include <set>
 #include <boost/thread/thread.hpp>
 #include <boost/scope_exit.hpp>
+#include "BufferReader.h"
 #include "ios.hpp"
 
 using namespace std;
@@ -122,7 +123,7 @@ private:
 static void usage(string prog) {
   std::stringstream str;
   str << "Usage: " << prog << " ";
-  std::cout << str.str() << "[ --window <seconds> ] [ --anonymize ] [ --verbose ]" << std::endl
+  std::cout << str.str() << "[ --window <seconds> ] [ --anonymize ] [ --no-compress ] [ --verbose ]" << std::endl
             << std::string(str.str().size(), ' ') << "<trace-input> <replay-output>" << endl;
 }
 
@@ -138,6 +139,7 @@ public:
     : m_window(1000000000ULL), // 1 billion nanoseconds, i.e., one second
       m_io_count(0),
       m_anonymize(false),
+      m_compress(true),
       m_verbose(false) {
   }
 
@@ -157,6 +159,8 @@ public:
 	m_window = (uint64_t)(1e9 * atof(arg.c_str() + sizeof("--window=")));
       } else if (arg == "--anonymize") {
 	m_anonymize = true;
+      } else if (arg == "--no-compress") {
+	m_compress = false;
       } else if (arg == "--verbose") {
         m_verbose = true;
       } else if (arg == "-h" || arg == "--help") {
@@ -227,6 +231,7 @@ public:
       IO::ptrs ptrs;
       process_event(ts, evt, &ptrs);
       serialize_events(fd, ptrs);
+      release_dependencies();
 
       int r = bt_iter_next(bt_itr);
       ASSERT_EXIT(r == 0, "Error advancing event iterator");
@@ -235,12 +240,34 @@ public:
     bt_ctf_iter_destroy(itr);
 
     insert_thread_stops(fd);
+    flush_block(fd);
   }
 
 private:
+  /// Actions are written, and compressed, this many bytes at a time.
+  static const size_t BLOCK_BYTES = 1 << 20;
+
   void write_banner(int fd) {
     bufferlist bl;
-    bl.append(rbd_replay::action::BANNER);
+    bl.append(m_compress ? rbd_replay::action::COMPRESSED_BANNER :
+                           rbd_replay::action::BANNER);
+    int r = bl.write_fd(fd);
+    ASSERT_EXIT(r >= 0, "Error writing to output file: " << cpp_strerror(r));
+  }
+
+  void flush_block(int fd) {
+    if (m_block.length() == 0) {
+      return;
+    }
+    bufferlist bl;
+    if (m_compress) {
+      int r = encode_compressed_block(m_block, &bl);
+      ASSERT_EXIT(r >= 0, "Error compressing output");
+    } else {
+      bl.claim_append(m_block);
+    }
+    m_block.clear();
+
     int r = bl.write_fd(fd);
     ASSERT_EXIT(r >= 0, "Error writing to output file: " << cpp_strerror(r));
   }
@@ -249,11 +276,10 @@ private:
     for (IO::ptrs::const_iterator it = ptrs.begin(); it != ptrs.end(); ++it) {
       IO::ptr io(*it);
 
-      bufferlist bl;
-      io->encode(bl);
-
-      int r = bl.write_fd(fd);
-      ASSERT_EXIT(r >= 0, "Error writing to output file: " << cpp_strerror(r));
+      io->encode(m_block);
+      if (m_block.length() >= BLOCK_BYTES) {
+        flush_block(fd);
+      }
 
       if (m_verbose) {
         io->write_debug(std::cout);
@@ -468,6 +494,22 @@ private:
       }
     }
     m_recent_completions.insert(io);
+    m_completed_ios.push_back(io);
+  }
+
+  /**
+     Drops the dependencies of the IOs completed since the last call.
+     They are only needed to encode the IO and to prune
+     m_recent_completions when it completes; kept any longer, each IO
+     pins every IO that ever came before it.
+     Must be called after the IOs have been serialized.
+   */
+  void release_dependencies() {
+    for (IO::ptrs::iterator it = m_completed_ios.begin();
+         it != m_completed_ios.end(); ++it) {
+      (*it)->dependencies().clear();
+    }
+    m_completed_ios.clear();
   }
 
   pair<string, string> map_image_snap(string image_name, string snap_name) {
@@ -507,6 +549,7 @@ private:
   map<thread_id_t, Thread::ptr> m_threads;
   uint32_t m_io_count;
   io_set_t m_recent_completions;
+  IO::ptrs m_completed_ios;
   set<imagectx_id_t> m_open_images;
 
   // keyed by completion
@@ -516,6 +559,9 @@ private:
   bool m_anonymize;
   map<string, AnonymizedImage> m_anonymized_images;
 
+  bool m_compress;
+  bufferlist m_block;
+
   bool m_verbose;
 };
 
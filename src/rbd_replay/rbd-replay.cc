@@ -39,6 +39,13 @@ static void usage(const char* program) {
   cout << "Options:" << std::endl;
   cout << "  -p, --pool-name <pool>          Name of the pool to use.  Default: rbd" << std::endl;
   cout << "  --latency-multiplier <float>    Multiplies inter-request latencies.  Default: 1" << std::endl;
+  cout << "  --speed <float>                 Replays this many times faster than the trace;" << std::endl;
+  cout << "                                  the same as a latency multiplier of 1/speed." << std::endl;
+  cout << "  --open-loop                     Issues requests at their times in the trace" << std::endl;
+  cout << "                                  rather than relative to when the requests they" << std::endl;
+  cout << "                                  depend on complete." << std::endl;
+  cout << "  --latency-report <file>         Write per-image throughput and latency" << std::endl;
+  cout << "                                  histograms as JSON to file, or - for stdout." << std::endl;
   cout << "  --read-only                     Only perform non-destructive operations." << std::endl;
   cout << "  --map-image <rule>              Add a rule to map image names in the trace to" << std::endl;
   cout << "                                  image names in the replay cluster." << std::endl;
@@ -65,6 +72,9 @@ int main(int argc, const char **argv) {
   std::vector<const char*>::iterator i;
   string pool_name = "rbd";
   float latency_multiplier = 1;
+  float speed = 0;
+  bool open_loop = false;
+  string latency_report;
   bool readonly = false;
   ImageNameMap image_name_map;
   std::string val;
@@ -81,6 +91,21 @@ int main(int argc, const char **argv) {
 	cerr << err.str() << std::endl;
 	return 1;
       }
+    } else if (ceph_argparse_witharg(args, i, &speed, err, "--speed",
+				     (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << err.str() << std::endl;
+	return 1;
+      }
+      if (speed <= 0) {
+	cerr << "--speed must be positive" << std::endl;
+	return 1;
+      }
+    } else if (ceph_argparse_flag(args, i, "--open-loop", (char*)NULL)) {
+      open_loop = true;
+    } else if (ceph_argparse_witharg(args, i, &val, "--latency-report",
+				     (char*)NULL)) {
+      latency_report = val;
     } else if (ceph_argparse_flag(args, i, "--read-only", (char*)NULL)) {
       readonly = true;
     } else if (ceph_argparse_witharg(args, i, &val, "--map-image", (char*)NULL)) {
@@ -118,7 +143,12 @@ int main(int argc, const char **argv) {
 
   unsigned int nthreads = boost::thread::hardware_concurrency();
   Replayer replayer(2 * nthreads + 1);
+  if (speed > 0) {
+    latency_multiplier = 1 / speed;
+  }
   replayer.set_latency_multiplier(latency_multiplier);
+  replayer.set_open_loop(open_loop);
+  replayer.set_latency_report(latency_report);
   replayer.set_pool_name(pool_name);
   replayer.set_readonly(readonly);
   replayer.set_image_name_map(image_name_map);
@@ -658,6 +658,22 @@ static void dump_bucket_usage(map<RGWObjCategory, RGWStorageStats>& stats, Forma
   formatter->close_section();
 }
 
+void dump_bucket_index_shards(CephContext *cct, map<string, uint64_t>& shard_entries, Formatter *formatter)
+{
+  uint64_t max_entries = cct->_conf->rgw_max_objs_per_shard;
+
+  formatter->open_array_section("index_shards");
+  for (map<string, uint64_t>::iterator iter = shard_entries.begin();
+       iter != shard_entries.end(); ++iter) {
+    formatter->open_object_section("shard");
+    formatter->dump_string("oid", iter->first);
+    formatter->dump_unsigned("num_entries", iter->second);
+    formatter->dump_bool("over_limit", max_entries && iter->second > max_entries);
+    formatter->close_section();
+  }
+  formatter->close_section();
+}
+
 static void dump_index_check(map<RGWObjCategory, RGWStorageStats> existing_stats,
         map<RGWObjCategory, RGWStorageStats> calculated_stats,
         Formatter *formatter)
@@ -1017,7 +1033,8 @@ static int bucket_stats(RGWRados *store, std::string&  bucket_name, Formatter *f
 
   string bucket_ver, master_ver;
   string max_marker;
-  int ret = store->get_bucket_stats(bucket, &bucket_ver, &master_ver, stats, &max_marker);
+  map<string, uint64_t> shard_entries;
+  int ret = store->get_bucket_stats(bucket, &bucket_ver, &master_ver, stats, &max_marker, &shard_entries);
   if (ret < 0) {
     cerr << "error getting bucket stats ret=" << ret << std::endl;
     return ret;
@@ -1037,6 +1054,7 @@ static int bucket_stats(RGWRados *store, std::string&  bucket_name, Formatter *f
   formatter->dump_stream("mtime") << ut;
   formatter->dump_string("max_marker", max_marker);
   dump_bucket_usage(stats, formatter);
+  dump_bucket_index_shards(store->ctx(), shard_entries, formatter);
   encode_json("bucket_quota", bucket_info.quota, formatter);
   formatter->close_section();
 
@@ -124,6 +124,7 @@ extern int rgw_bucket_set_attrs(RGWRados *store, RGWBucketInfo& bucket_info,
                                 RGWObjVersionTracker *objv_tracker);
 
 extern void check_bad_user_bucket_mapping(RGWRados *store, const string& user_id, bool fix);
+extern void dump_bucket_index_shards(CephContext *cct, map<string, uint64_t>& shard_entries, Formatter *formatter);
 
 struct RGWBucketAdminOpState {
   std::string uid;
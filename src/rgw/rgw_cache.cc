@@ -5,20 +5,68 @@
 
 #include <errno.h>
 
+#include "include/ceph_hash.h"
+
 #define dout_subsys ceph_subsys_rgw
 
 using namespace std;
 
+ObjectCache::~ObjectCache()
+{
+  for (vector<Shard *>::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+    delete *iter;
+  }
+}
+
+void ObjectCache::set_ctx(CephContext *_cct)
+{
+  cct = _cct;
+
+  unsigned num_shards = MAX(cct->_conf->rgw_cache_shards, 1);
+  for (unsigned i = 0; i < num_shards; i++) {
+    shards.push_back(new Shard);
+  }
+  lru_max = MAX(cct->_conf->rgw_cache_lru_size / num_shards, 1);
+  lru_window = lru_max / 2;
+  max_bytes = cct->_conf->rgw_cache_max_bytes / num_shards;
+  expiry = utime_t(cct->_conf->rgw_cache_expiry_interval, 0);
+}
+
+ObjectCache::Shard *ObjectCache::get_shard(const string& name)
+{
+  unsigned hash = ceph_str_hash_linux(name.c_str(), name.size());
+  return shards[hash % shards.size()];
+}
+
+void ObjectCache::lock_all()
+{
+  for (vector<Shard *>::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+    (*iter)->lock.get_write();
+  }
+}
+
+void ObjectCache::unlock_all()
+{
+  for (vector<Shard *>::reverse_iterator iter = shards.rbegin(); iter != shards.rend(); ++iter) {
+    (*iter)->lock.unlock();
+  }
+}
+
 int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
 {
-  RWLock::RLocker l(lock);
+  if (shards.empty()) {
+    return -ENOENT;
+  }
+
+  Shard *shard = get_shard(name);
+  RWLock::RLocker l(shard->lock);
 
   if (!enabled) {
     return -ENOENT;
   }
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(name);
+  if (iter == shard->cache_map.end()) {
     ldout(cct, 10) << "cache get: name=" << name << " : miss" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
     return -ENOENT;
@@ -26,14 +74,21 @@ int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cac
 
   ObjectCacheEntry *entry = &iter->second;
 
-  if (lru_counter - entry->lru_promotion_ts > lru_window) {
-    ldout(cct, 20) << "cache get: touching lru, lru_counter=" << lru_counter << " promotion_ts=" << entry->lru_promotion_ts << dendl;
-    lock.unlock();
-    lock.get_write(); /* promote lock to writer */
+  /* in case the notify that should have dropped it got lost */
+  if (!expiry.is_zero() && entry->update_time + expiry < ceph_clock_now(cct)) {
+    ldout(cct, 10) << "cache get: name=" << name << " : expiry miss" << dendl;
+    if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    return -ENOENT;
+  }
+
+  if (shard->lru_counter - entry->lru_promotion_ts > lru_window) {
+    ldout(cct, 20) << "cache get: touching lru, lru_counter=" << shard->lru_counter << " promotion_ts=" << entry->lru_promotion_ts << dendl;
+    shard->lock.unlock();
+    shard->lock.get_write(); /* promote lock to writer */
 
     /* need to redo this because entry might have dropped off the cache */
-    iter = cache_map.find(name);
-    if (iter == cache_map.end()) {
+    iter = shard->cache_map.find(name);
+    if (iter == shard->cache_map.end()) {
       ldout(cct, 10) << "lost race! cache get: name=" << name << " : miss" << dendl;
       if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
       return -ENOENT;
@@ -41,13 +96,14 @@ int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cac
 
     entry = &iter->second;
     /* check again, we might have lost a race here */
-    if (lru_counter - entry->lru_promotion_ts > lru_window) {
-      touch_lru(name, *entry, iter->second.lru_iter);
+    if (shard->lru_counter - entry->lru_promotion_ts > lru_window) {
+      touch_lru(shard, name, *entry, iter->second.lru_iter);
     }
   }
 
   ObjectCacheInfo& src = iter->second.info;
-  if ((src.flags & mask) != mask) {
+  /* a cached ENOENT answers every mask */
+  if (src.status >= 0 && (src.flags & mask) != mask) {
     ldout(cct, 10) << "cache get: name=" << name << " : type miss (requested=" << mask << ", cached=" << src.flags << ")" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
     return -ENOENT;
@@ -66,32 +122,49 @@ int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cac
 
 bool ObjectCache::chain_cache_entry(list<rgw_cache_entry_info *>& cache_info_entries, RGWChainedCache::Entry *chained_entry)
 {
-  RWLock::WLocker l(lock);
-
-  if (!enabled) {
+  if (shards.empty()) {
     return false;
   }
 
   list<rgw_cache_entry_info *>::iterator citer;
 
+  /* the entries may live in different shards: take their locks in order */
+  set<Shard *> locked;
+  for (citer = cache_info_entries.begin(); citer != cache_info_entries.end(); ++citer) {
+    locked.insert(get_shard((*citer)->cache_locator));
+  }
+  vector<Shard *> ordered;
+  for (vector<Shard *>::iterator siter = shards.begin(); siter != shards.end(); ++siter) {
+    if (locked.count(*siter)) {
+      (*siter)->lock.get_write();
+      ordered.push_back(*siter);
+    }
+  }
+
+  bool ret = false;
   list<ObjectCacheEntry *> cache_entry_list;
 
+  if (!enabled) {
+    goto done;
+  }
+
   /* first verify that all entries are still valid */
   for (citer = cache_info_entries.begin(); citer != cache_info_entries.end(); ++citer) {
     rgw_cache_entry_info *cache_info = *citer;
+    Shard *shard = get_shard(cache_info->cache_locator);
 
     ldout(cct, 10) << "chain_cache_entry: cache_locator=" << cache_info->cache_locator << dendl;
-    map<string, ObjectCacheEntry>::iterator iter = cache_map.find(cache_info->cache_locator);
-    if (iter == cache_map.end()) {
+    map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(cache_info->cache_locator);
+    if (iter == shard->cache_map.end()) {
       ldout(cct, 20) << "chain_cache_entry: couldn't find cachce locator" << dendl;
-      return false;
+      goto done;
     }
 
     ObjectCacheEntry *entry = &iter->second;
 
     if (entry->gen != cache_info->gen) {
       ldout(cct, 20) << "chain_cache_entry: entry.gen (" << entry->gen << ") != cache_info.gen (" << cache_info->gen << ")" << dendl;
-      return false;
+      goto done;
     }
 
     cache_entry_list.push_back(entry);
@@ -100,32 +173,52 @@ bool ObjectCache::chain_cache_entry(list<rgw_cache_entry_info *>& cache_info_ent
 
   chained_entry->cache->chain_cb(chained_entry->key, chained_entry->data);
 
-  list<ObjectCacheEntry *>::iterator liter;
-
-  for (liter = cache_entry_list.begin(); liter != cache_entry_list.end(); ++liter) {
+  for (list<ObjectCacheEntry *>::iterator liter = cache_entry_list.begin(); liter != cache_entry_list.end(); ++liter) {
     ObjectCacheEntry *entry = *liter;
 
     entry->chained_entries.push_back(make_pair(chained_entry->cache, chained_entry->key));
   }
+  ret = true;
 
-  return true;
+done:
+  for (vector<Shard *>::reverse_iterator siter = ordered.rbegin(); siter != ordered.rend(); ++siter) {
+    (*siter)->lock.unlock();
+  }
+  return ret;
+}
+
+void ObjectCache::update_size(Shard *shard, ObjectCacheEntry& entry)
+{
+  ObjectCacheInfo& info = entry.info;
+  uint64_t size = info.data.length();
+  for (map<string, bufferlist>::iterator iter = info.xattrs.begin(); iter != info.xattrs.end(); ++iter) {
+    size += iter->first.size() + iter->second.length();
+  }
+  shard->bytes += size;
+  shard->bytes -= entry.size;
+  entry.size = size;
 }
 
 void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info *cache_info)
 {
-  RWLock::WLocker l(lock);
+  if (shards.empty()) {
+    return;
+  }
+
+  Shard *shard = get_shard(name);
+  RWLock::WLocker l(shard->lock);
 
   if (!enabled) {
     return;
   }
 
   ldout(cct, 10) << "cache put: name=" << name << dendl;
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(name);
+  if (iter == shard->cache_map.end()) {
     ObjectCacheEntry entry;
-    entry.lru_iter = lru.end();
-    cache_map.insert(pair<string, ObjectCacheEntry>(name, entry));
-    iter = cache_map.find(name);
+    entry.lru_iter = shard->lru.end();
+    shard->cache_map.insert(pair<string, ObjectCacheEntry>(name, entry));
+    iter = shard->cache_map.find(name);
   }
   ObjectCacheEntry& entry = iter->second;
   ObjectCacheInfo& target = entry.info;
@@ -138,8 +231,7 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
 
   entry.chained_entries.clear();
   entry.gen++;
-
-  touch_lru(name, entry, entry.lru_iter);
+  entry.update_time = ceph_clock_now(cct);
 
   target.status = info.status;
 
@@ -147,6 +239,8 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
     target.flags = 0;
     target.xattrs.clear();
     target.data.clear();
+    update_size(shard, entry);
+    touch_lru(shard, name, entry, entry.lru_iter);
     return;
   }
 
@@ -185,18 +279,27 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
 
   if (info.flags & CACHE_FLAG_OBJV)
     target.version = info.version;
+
+  /* the entry is sized now, so the trim in touch_lru() sees its bytes */
+  update_size(shard, entry);
+  touch_lru(shard, name, entry, entry.lru_iter);
 }
 
 void ObjectCache::remove(string& name)
 {
-  RWLock::WLocker l(lock);
+  if (shards.empty()) {
+    return;
+  }
+
+  Shard *shard = get_shard(name);
+  RWLock::WLocker l(shard->lock);
 
   if (!enabled) {
     return;
   }
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end())
+  map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(name);
+  if (iter == shard->cache_map.end())
     return;
 
   ldout(cct, 10) << "removing " << name << " from cache" << dendl;
@@ -208,14 +311,16 @@ void ObjectCache::remove(string& name)
     chained_cache->invalidate(iiter->second);
   }
 
-  remove_lru(name, iter->second.lru_iter);
-  cache_map.erase(iter);
+  remove_lru(shard, name, iter->second.lru_iter);
+  shard->bytes -= entry.size;
+  shard->cache_map.erase(iter);
 }
 
-void ObjectCache::touch_lru(string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter)
+void ObjectCache::touch_lru(Shard *shard, string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter)
 {
-  while (lru_size > (size_t)cct->_conf->rgw_cache_lru_size) {
-    list<string>::iterator iter = lru.begin();
+  while (shard->lru_size > lru_max ||
+         (max_bytes && shard->bytes > max_bytes && shard->lru_size > 0)) {
+    list<string>::iterator iter = shard->lru.begin();
     if ((*iter).compare(name) == 0) {
       /*
        * if the entry we're touching happens to be at the lru end, don't remove it,
@@ -223,75 +328,84 @@ void ObjectCache::touch_lru(string& name, ObjectCacheEntry& entry, std::list<str
        */
       break;
     }
-    map<string, ObjectCacheEntry>::iterator map_iter = cache_map.find(*iter);
+    map<string, ObjectCacheEntry>::iterator map_iter = shard->cache_map.find(*iter);
     ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
-    if (map_iter != cache_map.end())
-      cache_map.erase(map_iter);
-    lru.pop_front();
-    lru_size--;
+    if (map_iter != shard->cache_map.end()) {
+      shard->bytes -= map_iter->second.size;
+      shard->cache_map.erase(map_iter);
+    }
+    shard->lru.pop_front();
+    shard->lru_size--;
   }
 
-  if (lru_iter == lru.end()) {
-    lru.push_back(name);
-    lru_size++;
+  if (lru_iter == shard->lru.end()) {
+    shard->lru.push_back(name);
+    shard->lru_size++;
     lru_iter--;
     ldout(cct, 10) << "adding " << name << " to cache LRU end" << dendl;
   } else {
     ldout(cct, 10) << "moving " << name << " to cache LRU end" << dendl;
-    lru.erase(lru_iter);
-    lru.push_back(name);
-    lru_iter = lru.end();
+    shard->lru.erase(lru_iter);
+    shard->lru.push_back(name);
+    lru_iter = shard->lru.end();
     --lru_iter;
   }
 
-  lru_counter++;
-  entry.lru_promotion_ts = lru_counter;
+  shard->lru_counter++;
+  entry.lru_promotion_ts = shard->lru_counter;
 }
 
-void ObjectCache::remove_lru(string& name, std::list<string>::iterator& lru_iter)
+void ObjectCache::remove_lru(Shard *shard, string& name, std::list<string>::iterator& lru_iter)
 {
-  if (lru_iter == lru.end())
+  if (lru_iter == shard->lru.end())
     return;
 
-  lru.erase(lru_iter);
-  lru_size--;
-  lru_iter = lru.end();
+  shard->lru.erase(lru_iter);
+  shard->lru_size--;
+  lru_iter = shard->lru.end();
 }
 
 void ObjectCache::set_enabled(bool status)
 {
-  RWLock::WLocker l(lock);
+  lock_all();
 
   enabled = status;
 
   if (!enabled) {
     do_invalidate_all();
   }
+
+  unlock_all();
 }
 
 void ObjectCache::invalidate_all()
 {
-  RWLock::WLocker l(lock);
+  lock_all();
 
   do_invalidate_all();
+
+  unlock_all();
 }
 
 void ObjectCache::do_invalidate_all()
 {
-  cache_map.clear();
-  lru.clear();
-
-  lru_size = 0;
-  lru_counter = 0;
-  lru_window = 0;
+  for (vector<Shard *>::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+    Shard *shard = *iter;
+    shard->cache_map.clear();
+    shard->lru.clear();
+
+    shard->lru_size = 0;
+    shard->lru_counter = 0;
+    shard->bytes = 0;
+  }
 
+  Mutex::Locker l(chained_lock);
   for (list<RGWChainedCache *>::iterator iter = chained_cache.begin(); iter != chained_cache.end(); ++iter) {
     (*iter)->invalidate_all();
   }
 }
 
 void ObjectCache::chain_cache(RGWChainedCache *cache) {
-  RWLock::WLocker l(lock);
+  Mutex::Locker l(chained_lock);
   chained_cache.push_back(cache);
 }
-
@@ -10,6 +10,7 @@
 #include "include/types.h"
 #include "include/utime.h"
 #include "include/assert.h"
+#include "common/Mutex.h"
 #include "common/RWLock.h"
 
 enum {
@@ -132,37 +133,59 @@ struct ObjectCacheEntry {
   std::list<string>::iterator lru_iter;
   uint64_t lru_promotion_ts;
   uint64_t gen;
+  uint64_t size; /* bytes charged to the shard */
+  utime_t update_time;
   std::list<pair<RGWChainedCache *, string> > chained_entries;
 
-  ObjectCacheEntry() : lru_promotion_ts(0), gen(0) {}
+  ObjectCacheEntry() : lru_promotion_ts(0), gen(0), size(0) {}
 };
 
+/*
+ * The cache is split into rgw_cache_shards shards by name, each with its
+ * own map, lru and lock, and each holding its share of rgw_cache_lru_size
+ * entries and rgw_cache_max_bytes bytes.  Lock ordering is shards in index
+ * order, then the chained caches.  enabled is written with every shard
+ * locked, so holding any shard lock is enough to read it.
+ */
 class ObjectCache {
-  std::map<string, ObjectCacheEntry> cache_map;
-  std::list<string> lru;
-  unsigned long lru_size;
-  unsigned long lru_counter;
+  struct Shard {
+    std::map<string, ObjectCacheEntry> cache_map;
+    std::list<string> lru;
+    unsigned long lru_size;
+    unsigned long lru_counter;
+    uint64_t bytes;
+    RWLock lock;
+
+    Shard() : lru_size(0), lru_counter(0), bytes(0), lock("ObjectCache::Shard") {}
+  };
+
+  vector<Shard *> shards;
+  unsigned long lru_max;
   unsigned long lru_window;
-  RWLock lock;
+  uint64_t max_bytes;
+  utime_t expiry;
   CephContext *cct;
 
+  Mutex chained_lock;
   list<RGWChainedCache *> chained_cache;
 
   bool enabled;
 
-  void touch_lru(string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter);
-  void remove_lru(string& name, std::list<string>::iterator& lru_iter);
+  Shard *get_shard(const string& name);
+  void touch_lru(Shard *shard, string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter);
+  void remove_lru(Shard *shard, string& name, std::list<string>::iterator& lru_iter);
+  void update_size(Shard *shard, ObjectCacheEntry& entry);
 
+  void lock_all();
+  void unlock_all();
   void do_invalidate_all();
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), lock("ObjectCache"), cct(NULL), enabled(false) { }
+  ObjectCache() : lru_max(0), lru_window(0), max_bytes(0), cct(NULL), chained_lock("ObjectCache::chained_lock"), enabled(false) { }
+  ~ObjectCache();
   int get(std::string& name, ObjectCacheInfo& bl, uint32_t mask, rgw_cache_entry_info *cache_info);
   void put(std::string& name, ObjectCacheInfo& bl, rgw_cache_entry_info *cache_info);
   void remove(std::string& name);
-  void set_ctx(CephContext *_cct) {
-    cct = _cct;
-    lru_window = cct->_conf->rgw_cache_lru_size / 2;
-  }
+  void set_ctx(CephContext *_cct);
   bool chain_cache_entry(list<rgw_cache_entry_info *>& cache_info_entries, RGWChainedCache::Entry *chained_entry);
 
   void set_enabled(bool status);
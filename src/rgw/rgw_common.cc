@@ -51,6 +51,10 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_keystone_token_cache_hit, "keystone_token_cache_hit", "Keystone token cache hits");
   plb.add_u64_counter(l_rgw_keystone_token_cache_miss, "keystone_token_cache_miss", "Keystone token cache miss");
 
+  plb.add_u64_counter(l_rgw_gc_tail_removed, "gc_tail_removed", "Tail objects released by gc");
+  plb.add_u64_counter(l_rgw_gc_tail_failed, "gc_tail_failed", "Tail objects gc failed to release");
+  plb.add_u64_counter(l_rgw_gc_tags_trimmed, "gc_tags_trimmed", "Chains trimmed from the gc log");
+
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
   return 0;
@@ -7,6 +7,7 @@
 #include "cls/refcount/cls_refcount_client.h"
 #include "cls/lock/cls_lock_client.h"
 #include "auth/Crypto.h"
+#include "common/errno.h"
 
 #include <list>
 
@@ -128,11 +129,122 @@ int RGWGC::list(int *index, string& marker, uint32_t max, bool expired_only, std
   return 0;
 }
 
+/*
+ * Keeps up to rgw_gc_max_concurrent_io tail object removals of one gc
+ * shard in flight.  A tag is trimmed from the shard once every removal of
+ * its chain came back fine, rgw_gc_max_trim_chunk tags at a time.
+ */
+class RGWGCIOManager {
+  CephContext *cct;
+  RGWGC *gc;
+  int index;
+
+  struct IO {
+    librados::AioCompletion *c;
+    string oid;
+    string tag;
+  };
+  std::list<IO> ios;
+  /* tag -> removals not yet complete (plus one until the chain is all
+   * sent), and whether they all succeeded so far */
+  map<string, pair<int, bool> > tags;
+  std::list<string> remove_tags;
+  size_t max_aio;
+  size_t max_trim;
+
+  void put_tag(const string& tag, bool ok) {
+    map<string, pair<int, bool> >::iterator iter = tags.find(tag);
+    assert(iter != tags.end());
+    if (!ok)
+      iter->second.second = false;
+    if (--iter->second.first > 0)
+      return;
+    if (iter->second.second) {
+      remove_tags.push_back(tag);
+      if (remove_tags.size() >= max_trim)
+        flush_remove_tags();
+    }
+    tags.erase(iter);
+  }
+
+  void handle_next_completion() {
+    IO& io = ios.front();
+    io.c->wait_for_complete();
+    int ret = io.c->get_return_value();
+    io.c->release();
+    if (ret == -ENOENT)
+      ret = 0;
+    if (ret < 0) {
+      dout(0) << "failed to remove " << io.oid << ": " << cpp_strerror(ret) << dendl;
+      if (perfcounter) perfcounter->inc(l_rgw_gc_tail_failed);
+    } else {
+      if (perfcounter) perfcounter->inc(l_rgw_gc_tail_removed);
+    }
+    string tag = io.tag;
+    ios.pop_front();
+    put_tag(tag, ret >= 0);
+  }
+
+public:
+  RGWGCIOManager(CephContext *_cct, RGWGC *_gc, int _index)
+    : cct(_cct), gc(_gc), index(_index),
+      max_aio(MAX(cct->_conf->rgw_gc_max_concurrent_io, 1)),
+      max_trim(MAX(cct->_conf->rgw_gc_max_trim_chunk, 1)) {}
+
+  void begin_tag(const string& tag) {
+    pair<int, bool>& t = tags[tag];
+    t.first++;
+    t.second = true;
+  }
+
+  void end_tag(const string& tag, bool ok) {
+    put_tag(tag, ok);
+  }
+
+  void schedule_io(IoCtx& ctx, const string& oid, const string& tag) {
+    while (ios.size() >= max_aio)
+      handle_next_completion();
+
+    ObjectWriteOperation op;
+    cls_refcount_put(op, tag, true);
+    IO io;
+    io.c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+    io.oid = oid;
+    io.tag = tag;
+    int ret = ctx.aio_operate(oid, io.c, &op);
+    if (ret < 0) {
+      dout(0) << "failed to remove " << oid << ": " << cpp_strerror(ret) << dendl;
+      io.c->release();
+      tags[tag].second = false;
+      return;
+    }
+    tags[tag].first++;
+    ios.push_back(io);
+  }
+
+  void drain() {
+    while (!ios.empty())
+      handle_next_completion();
+    flush_remove_tags();
+  }
+
+  void flush_remove_tags() {
+    if (remove_tags.empty())
+      return;
+    int ret = gc->remove(index, remove_tags);
+    if (ret < 0) {
+      dout(0) << "failed to remove tags on " << index << ": " << cpp_strerror(ret) << dendl;
+    } else if (perfcounter) {
+      perfcounter->inc(l_rgw_gc_tags_trimmed, remove_tags.size());
+    }
+    remove_tags.clear();
+  }
+};
+
 int RGWGC::process(int index, int max_secs)
 {
   rados::cls::lock::Lock l(gc_index_lock_name);
   utime_t end = ceph_clock_now(g_ceph_context);
-  std::list<string> remove_tags;
 
   /* max_secs should be greater than zero. We don't want a zero max_secs
    * to be translated as no timeout, since we'd then need to break the
@@ -155,7 +267,9 @@ int RGWGC::process(int index, int max_secs)
 
   string marker;
   bool truncated;
-  IoCtx *ctx = new IoCtx;
+  /* removals may still be in flight when the chain moves to another pool */
+  map<string, IoCtx> ctxs;
+  RGWGCIOManager io_manager(cct, this, index);
   do {
     int max = 100;
     std::list<cls_rgw_gc_obj_info> entries;
@@ -167,7 +281,6 @@ int RGWGC::process(int index, int max_secs)
     if (ret < 0)
       goto done;
 
-    string last_pool;
     std::list<cls_rgw_gc_obj_info>::iterator iter;
     for (iter = entries.begin(); iter != entries.end(); ++iter) {
       bool remove_tag;
@@ -180,55 +293,43 @@ int RGWGC::process(int index, int max_secs)
         goto done;
 
       remove_tag = true;
+      io_manager.begin_tag(info.tag);
       for (liter = chain.objs.begin(); liter != chain.objs.end(); ++liter) {
         cls_rgw_obj& obj = *liter;
 
-        if (obj.pool != last_pool) {
-          delete ctx;
-          ctx = new IoCtx;
-	  ret = store->get_rados_handle()->ioctx_create(obj.pool.c_str(), *ctx);
-	  if (ret < 0) {
-	    dout(0) << "ERROR: failed to create ioctx pool=" << obj.pool << dendl;
-	    continue;
-	  }
-          last_pool = obj.pool;
+        map<string, IoCtx>::iterator citer = ctxs.find(obj.pool);
+        if (citer == ctxs.end()) {
+          IoCtx ctx;
+          ret = store->get_rados_handle()->ioctx_create(obj.pool.c_str(), ctx);
+          if (ret < 0) {
+            dout(0) << "ERROR: failed to create ioctx pool=" << obj.pool << dendl;
+            remove_tag = false;
+            continue;
+          }
+          citer = ctxs.insert(make_pair(obj.pool, ctx)).first;
         }
+        IoCtx& ctx = citer->second;
 
-        ctx->locator_set_key(obj.loc);
+        ctx.locator_set_key(obj.loc);
         rgw_obj key_obj;
         key_obj.set_obj(obj.key.name);
         key_obj.set_instance(obj.key.instance);
 
 	dout(0) << "gc::process: removing " << obj.pool << ":" << key_obj.get_object() << dendl;
-	ObjectWriteOperation op;
-	cls_refcount_put(op, info.tag, true);
-        ret = ctx->operate(key_obj.get_object(), &op);
-	if (ret == -ENOENT)
-	  ret = 0;
-        if (ret < 0) {
-          remove_tag = false;
-          dout(0) << "failed to remove " << obj.pool << ":" << key_obj.get_object() << "@" << obj.loc << dendl;
-        }
+        io_manager.schedule_io(ctx, key_obj.get_object(), info.tag);
 
-        if (going_down()) // leave early, even if tag isn't removed, it's ok
+        if (going_down()) { // leave early, even if tag isn't removed, it's ok
+          io_manager.end_tag(info.tag, false);
           goto done;
-      }
-      if (remove_tag) {
-        remove_tags.push_back(info.tag);
-#define MAX_REMOVE_CHUNK 16
-        if (remove_tags.size() > MAX_REMOVE_CHUNK) {
-          RGWGC::remove(index, remove_tags);
-          remove_tags.clear();
         }
       }
+      io_manager.end_tag(info.tag, remove_tag);
     }
   } while (truncated);
 
 done:
-  if (!remove_tags.empty())
-    RGWGC::remove(index, remove_tags);
+  io_manager.drain();
   l.unlock(&store->gc_pool_ctx, obj_names[index]);
-  delete ctx;
   return 0;
 }
 
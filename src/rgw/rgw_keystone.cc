@@ -8,6 +8,7 @@
 #include "common/ceph_json.h"
 #include "include/types.h"
 #include "include/str_list.h"
+#include "include/ceph_hash.h"
 
 #include "rgw_common.h"
 #include "rgw_keystone.h"
@@ -42,8 +43,36 @@ int KeystoneToken::parse(CephContext *cct, bufferlist& bl)
   return 0;
 }
 
+RGWKeystoneTokenCache::RGWKeystoneTokenCache(CephContext *_cct, int _max,
+					     int _shards)
+  : cct(_cct)
+{
+  if (_shards < 1)
+    _shards = 1;
+  size_t per_shard = (MAX(_max, 1) + _shards - 1) / _shards;
+  for (int i = 0; i < _shards; ++i)
+    shards.push_back(new Shard(per_shard));
+}
+
+RGWKeystoneTokenCache::~RGWKeystoneTokenCache()
+{
+  for (vector<Shard *>::iterator iter = shards.begin(); iter != shards.end(); ++iter)
+    delete *iter;
+}
+
+RGWKeystoneTokenCache::Shard *RGWKeystoneTokenCache::get_shard(const string& token_id)
+{
+  unsigned hash = ceph_str_hash_linux(token_id.c_str(), token_id.size());
+  return shards[hash % shards.size()];
+}
+
 bool RGWKeystoneTokenCache::find(const string& token_id, KeystoneToken& token)
 {
+  Shard *shard = get_shard(token_id);
+  Mutex& lock = shard->lock;
+  map<string, token_entry>& tokens = shard->tokens;
+  list<string>& tokens_lru = shard->tokens_lru;
+
   lock.Lock();
   map<string, token_entry>::iterator iter = tokens.find(token_id);
   if (iter == tokens.end()) {
@@ -74,6 +103,11 @@ bool RGWKeystoneTokenCache::find(const string& token_id, KeystoneToken& token)
 
 void RGWKeystoneTokenCache::add(const string& token_id, KeystoneToken& token)
 {
+  Shard *shard = get_shard(token_id);
+  Mutex& lock = shard->lock;
+  map<string, token_entry>& tokens = shard->tokens;
+  list<string>& tokens_lru = shard->tokens_lru;
+
   lock.Lock();
   map<string, token_entry>::iterator iter = tokens.find(token_id);
   if (iter != tokens.end()) {
@@ -86,7 +120,7 @@ void RGWKeystoneTokenCache::add(const string& token_id, KeystoneToken& token)
   entry.token = token;
   entry.lru_iter = tokens_lru.begin();
 
-  while (tokens_lru.size() > max) {
+  while (tokens_lru.size() > shard->max) {
     list<string>::reverse_iterator riter = tokens_lru.rbegin();
     iter = tokens.find(*riter);
     assert(iter != tokens.end());
@@ -99,13 +133,14 @@ void RGWKeystoneTokenCache::add(const string& token_id, KeystoneToken& token)
 
 void RGWKeystoneTokenCache::invalidate(const string& token_id)
 {
-  Mutex::Locker l(lock);
-  map<string, token_entry>::iterator iter = tokens.find(token_id);
-  if (iter == tokens.end())
+  Shard *shard = get_shard(token_id);
+  Mutex::Locker l(shard->lock);
+  map<string, token_entry>::iterator iter = shard->tokens.find(token_id);
+  if (iter == shard->tokens.end())
     return;
 
   ldout(cct, 20) << "invalidating revoked token id=" << token_id << dendl;
   token_entry& e = iter->second;
-  tokens_lru.erase(e.lru_iter);
-  tokens.erase(iter);
+  shard->tokens_lru.erase(e.lru_iter);
+  shard->tokens.erase(iter);
 }
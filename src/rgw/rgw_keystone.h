@@ -87,18 +87,29 @@ struct token_entry {
   list<string>::iterator lru_iter;
 };
 
+/*
+ * Split into shards by token id, each with its own lock, LRU and an
+ * equal share of the entries, so that concurrent requests carrying
+ * different tokens don't serialize on one mutex.
+ */
 class RGWKeystoneTokenCache {
   CephContext *cct;
 
-  map<string, token_entry> tokens;
-  list<string> tokens_lru;
+  struct Shard {
+    map<string, token_entry> tokens;
+    list<string> tokens_lru;
+    Mutex lock;
+    size_t max;
 
-  Mutex lock;
+    Shard(size_t _max) : lock("RGWKeystoneTokenCache::Shard"), max(_max) {}
+  };
+  vector<Shard *> shards;
 
-  size_t max;
+  Shard *get_shard(const string& token_id);
 
 public:
-  RGWKeystoneTokenCache(CephContext *_cct, int _max) : cct(_cct), lock("RGWKeystoneTokenCache"), max(_max) {}
+  RGWKeystoneTokenCache(CephContext *_cct, int _max, int _shards);
+  ~RGWKeystoneTokenCache();
 
   bool find(const string& token_id, KeystoneToken& token);
   void add(const string& token_id, KeystoneToken& token);
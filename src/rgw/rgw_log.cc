@@ -167,6 +167,103 @@ void rgw_log_usage_finalize()
   usage_logger = NULL;
 }
 
+/* ops logger: batches the encoded entries of each rados log object */
+class OpsLogger {
+  CephContext *cct;
+  RGWRados *store;
+  map<string, bufferlist> pending;
+  Mutex lock;
+  uint64_t pending_bytes;
+  Mutex timer_lock;
+  SafeTimer timer;
+
+  class C_OpsLogTimeout : public Context {
+    OpsLogger *logger;
+  public:
+    C_OpsLogTimeout(OpsLogger *_l) : logger(_l) {}
+    void finish(int r) {
+      logger->flush();
+      logger->set_timer();
+    }
+  };
+
+  void set_timer() {
+    timer.add_event_after(cct->_conf->rgw_ops_log_flush_interval, new C_OpsLogTimeout(this));
+  }
+
+  int append(const string& oid, bufferlist& bl) {
+    rgw_obj obj(store->zone.log_pool, oid);
+
+    int ret = store->append_async(obj, bl.length(), bl);
+    if (ret == -ENOENT) {
+      ret = store->create_pool(store->zone.log_pool);
+      if (ret < 0)
+        return ret;
+      // retry
+      ret = store->append_async(obj, bl.length(), bl);
+    }
+    return ret;
+  }
+public:
+
+  OpsLogger(CephContext *_cct, RGWRados *_store) : cct(_cct), store(_store), lock("OpsLogger"), pending_bytes(0), timer_lock("OpsLogger::timer_lock"), timer(cct, timer_lock) {
+    timer.init();
+    Mutex::Locker l(timer_lock);
+    set_timer();
+  }
+
+  ~OpsLogger() {
+    Mutex::Locker l(timer_lock);
+    flush();
+    timer.cancel_all_events();
+    timer.shutdown();
+  }
+
+  int insert(const string& oid, bufferlist& bl) {
+    uint64_t max_bytes = cct->_conf->rgw_ops_log_rados_batch_bytes;
+    if (!max_bytes)
+      return append(oid, bl);
+
+    lock.Lock();
+    pending[oid].append(bl);
+    pending_bytes += bl.length();
+    bool need_flush = (pending_bytes >= max_bytes);
+    lock.Unlock();
+    if (need_flush) {
+      Mutex::Locker l(timer_lock);
+      flush();
+    }
+    return 0;
+  }
+
+  void flush() {
+    map<string, bufferlist> old_pending;
+    lock.Lock();
+    old_pending.swap(pending);
+    pending_bytes = 0;
+    lock.Unlock();
+
+    for (map<string, bufferlist>::iterator iter = old_pending.begin(); iter != old_pending.end(); ++iter) {
+      int ret = append(iter->first, iter->second);
+      if (ret < 0)
+        ldout(cct, 0) << "ERROR: failed to write ops log to " << iter->first << " ret=" << ret << dendl;
+    }
+  }
+};
+
+static OpsLogger *ops_logger = NULL;
+
+void rgw_log_ops_init(CephContext *cct, RGWRados *store)
+{
+  ops_logger = new OpsLogger(cct, store);
+}
+
+void rgw_log_ops_finalize()
+{
+  delete ops_logger;
+  ops_logger = NULL;
+}
+
 static void log_usage(struct req_state *s, const string& op_name)
 {
   if (s->system_request) /* don't log system user operations */
@@ -225,7 +322,7 @@ void rgw_format_ops_log_entry(struct rgw_log_entry& entry, Formatter *formatter)
   formatter->close_section();
 }
 
-void OpsLogSocket::formatter_to_bl(bufferlist& bl)
+void OpsLogSocket::formatter_to_bl(Formatter *formatter, bufferlist& bl)
 {
   stringstream ss;
   formatter->flush(ss);
@@ -239,25 +336,24 @@ void OpsLogSocket::init_connection(bufferlist& bl)
   bl.append("[");
 }
 
-OpsLogSocket::OpsLogSocket(CephContext *cct, uint64_t _backlog) : OutputDataSocket(cct, _backlog), lock("OpsLogSocket")
+OpsLogSocket::OpsLogSocket(CephContext *cct, uint64_t _backlog) : OutputDataSocket(cct, _backlog)
 {
-  formatter = new JSONFormatter;
   delim.append(",\n");
 }
 
 OpsLogSocket::~OpsLogSocket()
 {
-  delete formatter;
 }
 
 void OpsLogSocket::log(struct rgw_log_entry& entry)
 {
   bufferlist bl;
 
-  lock.Lock();
-  rgw_format_ops_log_entry(entry, formatter);
-  formatter_to_bl(bl);
-  lock.Unlock();
+  /* a formatter of our own, so that request threads don't queue up on a
+   * shared one */
+  JSONFormatter formatter;
+  rgw_format_ops_log_entry(entry, &formatter);
+  formatter_to_bl(&formatter, bl);
 
   append_output(bl);
 }
@@ -349,22 +445,13 @@ int rgw_log_op(RGWRados *store, struct req_state *s, const string& op_name, OpsL
     string oid = render_log_object_name(s->cct->_conf->rgw_log_object_name, &bdt,
 				        s->bucket.bucket_id, entry.bucket);
 
-    rgw_obj obj(store->zone.log_pool, oid);
-
-    ret = store->append_async(obj, bl.length(), bl);
-    if (ret == -ENOENT) {
-      ret = store->create_pool(store->zone.log_pool);
-      if (ret < 0)
-        goto done;
-      // retry
-      ret = store->append_async(obj, bl.length(), bl);
-    }
+    if (ops_logger)
+      ret = ops_logger->insert(oid, bl);
   }
 
   if (olog) {
     olog->log(entry);
   }
-done:
   if (ret < 0)
     ldout(s->cct, 0) << "ERROR: failed to log entry" << dendl;
 
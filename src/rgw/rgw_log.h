@@ -102,10 +102,7 @@ struct rgw_log_entry {
 WRITE_CLASS_ENCODER(rgw_log_entry)
 
 class OpsLogSocket : public OutputDataSocket {
-  Formatter *formatter;
-  Mutex lock;
-
-  void formatter_to_bl(bufferlist& bl);
+  void formatter_to_bl(Formatter *formatter, bufferlist& bl);
 
 protected:
   void init_connection(bufferlist& bl);
@@ -120,6 +117,8 @@ public:
 int rgw_log_op(RGWRados *store, struct req_state *s, const string& op_name, OpsLogSocket *olog);
 void rgw_log_usage_init(CephContext *cct, RGWRados *store);
 void rgw_log_usage_finalize();
+void rgw_log_ops_init(CephContext *cct, RGWRados *store);
+void rgw_log_ops_finalize();
 void rgw_format_ops_log_entry(struct rgw_log_entry& entry, Formatter *formatter);
 
 #endif
@@ -1095,6 +1095,7 @@ int main(int argc, const char **argv)
   rgw_user_init(store);
   rgw_bucket_init(store->meta_mgr);
   rgw_log_usage_init(g_ceph_context, store);
+  rgw_log_ops_init(g_ceph_context, store);
 
   RGWREST rest;
 
@@ -1248,6 +1249,7 @@ int main(int argc, const char **argv)
     swift_finalize();
   }
 
+  rgw_log_ops_finalize();
   rgw_log_usage_finalize();
 
   delete olog;
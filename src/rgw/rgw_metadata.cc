@@ -121,14 +121,22 @@ int RGWMetadataLog::list_entries(void *handle,
     return 0;
   }
 
+  string next_marker;
   int ret = store->time_log_list(ctx->cur_oid, ctx->from_time, ctx->end_time,
 				 max_entries, entries, ctx->marker,
-				 last_marker, truncated);
+				 &next_marker, truncated);
   if ((ret < 0) && (ret != -ENOENT))
     return ret;
 
-  if (ret == -ENOENT)
+  if (ret == -ENOENT) {
     *truncated = false;
+    return 0;
+  }
+
+  /* the next call continues where this one stopped */
+  ctx->marker = next_marker;
+  if (last_marker)
+    *last_marker = next_marker;
 
   return 0;
 }
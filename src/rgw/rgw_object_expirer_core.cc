@@ -118,11 +118,14 @@ void RGWObjectExpirer::garbage_chunk(list<cls_timeindex_entry>& entries,      /*
 
 void RGWObjectExpirer::trim_chunk(const string& shard,
                                const utime_t& from,
-                               const utime_t& to)
+                               const utime_t& to,
+                               const string& from_marker,
+                               const string& to_marker)
 {
-  ldout(store->ctx(), 20) << "trying to trim removal hints to  " << to << dendl;
+  ldout(store->ctx(), 20) << "trying to trim removal hints to=" << to
+                          << ", to_marker=" << to_marker << dendl;
 
-  int ret = store->objexp_hint_trim(shard, from, to);
+  int ret = store->objexp_hint_trim(shard, from, to, from_marker, to_marker);
   if (ret < 0) {
     ldout(store->ctx(), 0) << "ERROR during trim: " << ret << dendl;
   }
@@ -130,10 +133,12 @@ void RGWObjectExpirer::trim_chunk(const string& shard,
   return;
 }
 
-void RGWObjectExpirer::process_single_shard(const string& shard,
-                                         const utime_t& last_run,
-                                         const utime_t& round_start)
+/* returns the number of hints handled */
+int RGWObjectExpirer::process_single_shard(const string& shard,
+                                        const utime_t& last_run,
+                                        const utime_t& round_start)
 {
+  int handled = 0;
   string marker;
   string out_marker;
   bool truncated = false;
@@ -153,7 +158,11 @@ void RGWObjectExpirer::process_single_shard(const string& shard,
   int ret = l.lock_exclusive(&store->objexp_pool_ctx, shard);
   if (ret == -EBUSY) { /* already locked by another processor */
     dout(5) << __func__ << "(): failed to acquire lock on " << shard << dendl;
-    return;
+    return 0;
+  }
+  if (ret < 0) {
+    ldout(cct, 0) << __func__ << "(): failed to lock " << shard << ": " << cpp_strerror(ret) << dendl;
+    return 0;
   }
   do {
     list<cls_timeindex_entry> entries;
@@ -162,14 +171,17 @@ void RGWObjectExpirer::process_single_shard(const string& shard,
                                       &out_marker, &truncated);
     if (ret < 0) {
       ldout(cct, 10) << "cannot get removal hints from shard: " << shard << dendl;
-      continue;
+      break;
     }
 
     bool need_trim;
     garbage_chunk(entries, need_trim);
+    handled += entries.size();
 
+    /* only what this chunk covered: the hints past out_marker are still
+     * to be processed */
     if (need_trim) {
-      trim_chunk(shard, last_run, round_start);
+      trim_chunk(shard, last_run, round_start, marker, out_marker);
     }
 
     utime_t now = ceph_clock_now(g_ceph_context);
@@ -181,7 +193,7 @@ void RGWObjectExpirer::process_single_shard(const string& shard,
   } while (truncated);
 
   l.unlock(&store->objexp_pool_ctx, shard);
-  return;
+  return handled;
 }
 
 void RGWObjectExpirer::inspect_all_shards(const utime_t& last_run, const utime_t& round_start)
@@ -190,16 +202,29 @@ void RGWObjectExpirer::inspect_all_shards(const utime_t& last_run, const utime_t
 
   CephContext *cct = store->ctx();
   int num_shards = cct->_conf->rgw_objexp_hints_num_shards;
+  if (num_shards <= 0)
+    return;
+
+  /* start somewhere else than the other expirers, so that each of them
+   * gets to lock shards of its own instead of queueing on the same ones */
+  unsigned start;
+  int ret = get_random_bytes((char *)&start, sizeof(start));
+  if (ret < 0)
+    start = 0;
 
+  int handled = 0;
   for (int i = 0; i < num_shards; i++) {
     string shard;
-    store->objexp_get_shard(i, shard);
+    store->objexp_get_shard((i + start) % num_shards, shard);
 
     ldout(store->ctx(), 20) << "proceeding shard = " << shard << dendl;
 
-    process_single_shard(shard, last_run, round_start);
+    handled += process_single_shard(shard, last_run, round_start);
   }
 
+  utime_t took = ceph_clock_now(cct) - round_start;
+  ldout(cct, 2) << "object expiration: handled " << handled << " hints up to "
+                << round_start << " in " << took << "s" << dendl;
   return;
 }
 
@@ -3246,6 +3246,15 @@ void RGWCompleteMultipart::execute()
   int total_parts = 0;
   int handled_parts = 0;
   int max_parts = 1000;
+  if (!is_v2_upload_id(upload_id) ||
+      parts->parts.begin()->first != 1 ||
+      parts->parts.rbegin()->first != (int)parts->parts.size()) {
+    /* the parts of old uploads are not sorted in the omap, and gaps in the
+     * part numbers make list_multipart_parts() treat them as unsorted too;
+     * every page would then read and decode all of them again, so take
+     * them all at once */
+    max_parts = parts->parts.size();
+  }
   int marker = 0;
   bool truncated;
 
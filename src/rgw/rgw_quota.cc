@@ -193,9 +193,16 @@ int RGWQuotaCache<T>::get_stats(const string& user, rgw_bucket& bucket, RGWStora
       }
     }
 
-    if (can_use_cached_stats(quota, qs.stats) && qs.expiration > ceph_clock_now(store->ctx())) {
-      stats = qs.stats;
-      return 0;
+    if (can_use_cached_stats(quota, qs.stats)) {
+      /* once expired, the refresh started above (or still in flight) will
+       * replace these; rather than stall the request on reading the stats
+       * again, keep using them for up to another ttl until it does */
+      utime_t stale_expiration = qs.expiration;
+      stale_expiration += store->ctx()->_conf->rgw_bucket_quota_ttl;
+      if (stale_expiration > now) {
+        stats = qs.stats;
+        return 0;
+      }
     }
   }
 
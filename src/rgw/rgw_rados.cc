@@ -76,6 +76,18 @@ static string log_lock_name = "rgw_log_lock";
 
 static RGWObjCategory main_category = RGW_OBJ_CATEGORY_MAIN;
 
+/*
+ * hash a bufferlist piece by piece; c_str() would rebuild an upload
+ * chunk assembled from many frontend reads into one contiguous copy
+ */
+static void hash_bufferlist(MD5 *hash, bufferlist& bl)
+{
+  for (std::list<bufferptr>::const_iterator p = bl.buffers().begin();
+       p != bl.buffers().end(); ++p) {
+    hash->Update((const byte *)p->c_str(), p->length());
+  }
+}
+
 #define RGW_USAGE_OBJ_PREFIX "usage."
 
 #define RGW_DEFAULT_ZONE_ROOT_POOL ".rgw.root"
@@ -966,8 +978,17 @@ int RGWPutObjProcessor_Aio::handle_obj_data(rgw_obj& obj, bufferlist& bl, off_t
                                      bl,
                                      ((ofs != 0) ? ofs : -1),
                                      exclusive, phandle);
+  if (r < 0)
+    return r;
 
-  return r;
+  /* account for it now, so that the window sees every byte in flight */
+  struct put_obj_aio_info info;
+  info.handle = *phandle;
+  info.size = bl.length();
+  pending.push_back(info);
+  pending_size += info.size;
+
+  return 0;
 }
 
 struct put_obj_aio_info RGWPutObjProcessor_Aio::pop_pending()
@@ -975,6 +996,7 @@ struct put_obj_aio_info RGWPutObjProcessor_Aio::pop_pending()
   struct put_obj_aio_info info;
   info = pending.front();
   pending.pop_front();
+  pending_size -= info.size;
   return info;
 }
 
@@ -1012,12 +1034,14 @@ int RGWPutObjProcessor_Aio::throttle_data(void *handle, bool need_to_wait)
 {
   bool _wait = need_to_wait;
 
-  if (handle) {
-    struct put_obj_aio_info info;
-    info.handle = handle;
-    pending.push_back(info);
+  /* handle was queued by handle_obj_data() */
+  CephContext *cct = store->ctx();
+  uint64_t max_window_size = (uint64_t)cct->_conf->rgw_put_obj_max_window_size;
+  if (!window_size) {
+    window_size = MIN((uint64_t)cct->_conf->rgw_put_obj_min_window_size,
+                      max_window_size);
   }
-  size_t orig_size = pending.size();
+  uint64_t orig_size = pending_size;
 
   /* first drain complete IOs */
   while (pending_has_completed()) {
@@ -1029,12 +1053,17 @@ int RGWPutObjProcessor_Aio::throttle_data(void *handle, bool need_to_wait)
   }
 
   /* resize window in case messages are draining too fast */
-  if (orig_size - pending.size() >= max_chunks) {
-    max_chunks++;
+  if (orig_size - pending_size >= window_size) {
+    window_size = MIN(window_size * 2, max_window_size);
   }
 
   /* now throttle. Note that need_to_wait should only affect the first IO operation */
-  if (pending.size() > max_chunks || _wait) {
+  if (_wait) {
+    int r = wait_pending_front();
+    if (r < 0)
+      return r;
+  }
+  while (pending_size > window_size) {
     int r = wait_pending_front();
     if (r < 0)
       return r;
@@ -1089,7 +1118,7 @@ int RGWPutObjProcessor_Atomic::handle_data(bufferlist& bl, off_t ofs, MD5 *hash,
     first_chunk.claim(bl);
     obj_len = (uint64_t)first_chunk.length();
     if (hash) {
-      hash->Update((const byte *)first_chunk.c_str(), obj_len);
+      hash_bufferlist(hash, first_chunk);
     }
     int r = prepare_next_part(obj_len);
     if (r < 0) {
@@ -1106,7 +1135,7 @@ int RGWPutObjProcessor_Atomic::handle_data(bufferlist& bl, off_t ofs, MD5 *hash,
   int ret = write_data(bl, write_ofs, phandle, exclusive);
   if (ret >= 0) { /* we might return, need to clear bl as it was already sent */
     if (hash) {
-      hash->Update((const byte *)bl.c_str(), bl.length());
+      hash_bufferlist(hash, bl);
     }
     bl.clear();
   }
@@ -1115,7 +1144,7 @@ int RGWPutObjProcessor_Atomic::handle_data(bufferlist& bl, off_t ofs, MD5 *hash,
 
 void RGWPutObjProcessor_Atomic::complete_hash(MD5 *hash)
 {
-  hash->Update((const byte *)pending_data_bl.c_str(), pending_data_bl.length());
+  hash_bufferlist(hash, pending_data_bl);
 }
 
 
@@ -6371,7 +6400,17 @@ int RGWRados::get_obj_iterate_cb(RGWObjectCtx *ctx, RGWObjState *astate,
 
   get_obj_bucket_and_oid_loc(obj, bucket, oid, key);
 
-  d->throttle.get(len);
+  if (d->throttle.get(len)) {
+    /* the window was full of reads still in flight: the client keeps up
+     * with us, so rados latency is what holds us back; read further ahead */
+    int64_t max_window = cct->_conf->rgw_get_obj_max_window_size;
+    int64_t window = d->throttle.get_max();
+    if (window < max_window) {
+      window = MIN(window * 2, max_window);
+      ldout(cct, 20) << "get_obj_iterate_cb: growing read window to " << window << dendl;
+      d->throttle.reset_max(window);
+    }
+  }
   if (d->is_cancelled()) {
     return d->get_err_code();
   }
@@ -7294,7 +7333,8 @@ int RGWRados::raw_obj_stat(rgw_obj& obj, uint64_t *psize, time_t *pmtime, uint64
 }
 
 int RGWRados::get_bucket_stats(rgw_bucket& bucket, string *bucket_ver, string *master_ver,
-    map<RGWObjCategory, RGWStorageStats>& stats, string *max_marker)
+    map<RGWObjCategory, RGWStorageStats>& stats, string *max_marker,
+    map<string, uint64_t> *shard_entries)
 {
   map<string, rgw_bucket_dir_header> headers;
   map<int, string> bucket_instance_ids;
@@ -7317,6 +7357,13 @@ int RGWRados::get_bucket_stats(rgw_bucket& bucket, string *bucket_ver, string *m
     snprintf(buf, sizeof(buf), "%lu", (unsigned long)iter->second.master_ver);
     master_ver_mgr.add(viter->first, string(buf));
     marker_mgr.add(viter->first, iter->second.max_marker);
+    if (shard_entries) {
+      uint64_t& entries = (*shard_entries)[iter->first];
+      map<uint8_t, rgw_bucket_category_stats>::iterator siter;
+      for (siter = iter->second.stats.begin(); siter != iter->second.stats.end(); ++siter) {
+        entries += siter->second.num_entries;
+      }
+    }
   }
   ver_mgr.to_string(bucket_ver);
   master_ver_mgr.to_string(master_ver);
@@ -8268,23 +8315,31 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, rgw_obj_key& start, const stri
   if (r < 0)
     return r;
 
+  // Entries hash evenly over the shards, so each one only needs to give us
+  // its share of the page (and some slack); a shard that runs out before
+  // the page is full is asked for more on its own below.
+  uint32_t shard_entries = num_entries;
+  if (oids.size() > 1) {
+    shard_entries = MIN(num_entries, num_entries * 2 / oids.size() + 1);
+  }
+
   cls_rgw_obj_key start_key(start.name, start.instance);
-  r = CLSRGWIssueBucketList(index_ctx, start_key, prefix, num_entries, list_versions,
+  r = CLSRGWIssueBucketList(index_ctx, start_key, prefix, shard_entries, list_versions,
                             oids, list_results, cct->_conf->rgw_bucket_index_max_aio)();
   if (r < 0)
     return r;
 
   // Create a list of iterators that are used to iterate each shard
-  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vcurrents(list_results.size());
-  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vends(list_results.size());
-  vector<string> vnames(list_results.size());
+  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vcurrents;
+  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vends;
+  vector<int> vshards;
+  vector<string> vnames;
   map<int, struct rgw_cls_list_ret>::iterator iter = list_results.begin();
-  *is_truncated = false;
   for (; iter != list_results.end(); ++iter) {
     vcurrents.push_back(iter->second.dir.m.begin());
     vends.push_back(iter->second.dir.m.end());
+    vshards.push_back(iter->first);
     vnames.push_back(oids[iter->first]);
-    *is_truncated = (*is_truncated || iter->second.is_truncated);
   }
 
   // Create a map to track the next candidate entry from each shard, if the entry
@@ -8300,6 +8355,7 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, rgw_obj_key& start, const stri
   map<string, bufferlist> updates;
   uint32_t count = 0;
   while (count < num_entries && !candidates.empty()) {
+    r = 0;
     // Select the next one
     int pos = candidates.begin()->second;
     const string& name = vcurrents[pos]->first;
@@ -8337,9 +8393,27 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, rgw_obj_key& start, const stri
 
     // Refresh the candidates map
     candidates.erase(candidates.begin());
+    cls_rgw_obj_key last_key = dirent.key;
     ++vcurrents[pos];
+    struct rgw_cls_list_ret& shard_result = list_results[vshards[pos]];
+    if (vcurrents[pos] == vends[pos] && shard_result.is_truncated && count < num_entries) {
+      // this shard may hold the next entries of the page: fetch more from it alone
+      map<int, string> shard_oid;
+      shard_oid[vshards[pos]] = vnames[pos];
+      map<int, struct rgw_cls_list_ret> more;
+      int ret = CLSRGWIssueBucketList(index_ctx, last_key, prefix, shard_entries, list_versions,
+                                      shard_oid, more, 1)();
+      if (ret < 0)
+        return ret;
+      shard_result = more[vshards[pos]];
+      vcurrents[pos] = shard_result.dir.m.begin();
+      vends[pos] = shard_result.dir.m.end();
+    }
     if (vcurrents[pos] != vends[pos]) {
       candidates[vcurrents[pos]->first] = pos;
+    } else if (shard_result.is_truncated) {
+      // nothing from the other shards may go past what this one still holds
+      break;
     }
   }
 
@@ -8357,8 +8431,9 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, rgw_obj_key& start, const stri
   }
 
   // Check if all the returned entries are consumed or not
+  *is_truncated = false;
   for (size_t i = 0; i < vcurrents.size(); ++i) {
-    if (vcurrents[i] != vends[i])
+    if (vcurrents[i] != vends[i] || list_results[vshards[i]].is_truncated)
       *is_truncated = true;
   }
   if (!m.empty())
@@ -2047,7 +2047,8 @@ public:
 
   int decode_policy(bufferlist& bl, ACLOwner *owner);
   int get_bucket_stats(rgw_bucket& bucket, string *bucket_ver, string *master_ver,
-      map<RGWObjCategory, RGWStorageStats>& stats, string *max_marker);
+      map<RGWObjCategory, RGWStorageStats>& stats, string *max_marker,
+      map<string, uint64_t> *shard_entries = NULL);
   int get_bucket_stats_async(rgw_bucket& bucket, RGWGetBucketStats_CB *cb);
   int get_user_stats(const string& user, RGWStorageStats& stats);
   int get_user_stats_async(const string& user, RGWGetUserStats_CB *cb);
@@ -2325,24 +2326,31 @@ public:
 template <class T>
 class RGWChainedCacheImpl : public RGWChainedCache {
   RWLock lock;
+  CephContext *cct;
+  utime_t expiry;
 
-  map<string, T> entries;
+  map<string, pair<T, utime_t> > entries;
 
 public:
-  RGWChainedCacheImpl() : lock("RGWChainedCacheImpl::lock") {}
+  RGWChainedCacheImpl() : lock("RGWChainedCacheImpl::lock"), cct(NULL) {}
 
   void init(RGWRados *store) {
+    cct = store->ctx();
+    expiry = utime_t(cct->_conf->rgw_cache_expiry_interval, 0);
     store->register_chained_cache(this);
   }
 
   bool find(const string& key, T *entry) {
     RWLock::RLocker rl(lock);
-    typename map<string, T>::iterator iter = entries.find(key);
+    typename map<string, pair<T, utime_t> >::iterator iter = entries.find(key);
     if (iter == entries.end()) {
       return false;
     }
+    if (!expiry.is_zero() && iter->second.second + expiry < ceph_clock_now(cct)) {
+      return false;
+    }
 
-    *entry = iter->second;
+    *entry = iter->second.first;
     return true;
   }
 
@@ -2356,7 +2364,7 @@ public:
   void chain_cb(const string& key, void *data) {
     T *entry = static_cast<T *>(data);
     RWLock::WLocker wl(lock);
-    entries[key] = *entry;
+    entries[key] = make_pair(*entry, ceph_clock_now(cct));
   }
 
   void invalidate(const string& key) {
@@ -2403,12 +2411,15 @@ public:
 
 struct put_obj_aio_info {
   void *handle;
+  uint64_t size;
 };
 
 class RGWPutObjProcessor_Aio : public RGWPutObjProcessor
 {
   list<struct put_obj_aio_info> pending;
-  size_t max_chunks;
+  /* bytes in flight, and how many we let be in flight before waiting */
+  uint64_t pending_size;
+  uint64_t window_size;
 
   struct put_obj_aio_info pop_pending();
   int wait_pending_front();
@@ -2431,7 +2442,7 @@ protected:
 public:
   int throttle_data(void *handle, bool need_to_wait);
 
-  RGWPutObjProcessor_Aio(RGWObjectCtx& obj_ctx, RGWBucketInfo& bucket_info) : RGWPutObjProcessor(obj_ctx, bucket_info), max_chunks(RGW_MAX_PENDING_CHUNKS), obj_len(0) {}
+  RGWPutObjProcessor_Aio(RGWObjectCtx& obj_ctx, RGWBucketInfo& bucket_info) : RGWPutObjProcessor(obj_ctx, bucket_info), pending_size(0), window_size(0), obj_len(0) {}
   virtual ~RGWPutObjProcessor_Aio();
 };
 
@@ -613,6 +613,25 @@ void dump_continue(struct req_state *s)
   s->cio->send_100_continue();
 }
 
+/* write ofs~len of bl piece by piece, without first making it contiguous */
+int dump_body(struct req_state *s, bufferlist& bl, off_t ofs, off_t len)
+{
+  for (list<bufferptr>::const_iterator p = bl.buffers().begin();
+       p != bl.buffers().end() && len > 0; ++p) {
+    if (ofs >= (off_t)p->length()) {
+      ofs -= p->length();
+      continue;
+    }
+    off_t n = MIN(len, (off_t)p->length() - ofs);
+    int r = s->cio->write(p->c_str() + ofs, n);
+    if (r < 0)
+      return r;
+    ofs = 0;
+    len -= n;
+  }
+  return 0;
+}
+
 void dump_range(struct req_state *s, uint64_t ofs, uint64_t end, uint64_t total)
 {
   char range_buf[128];
@@ -20,9 +20,25 @@
 #include "rgw_client_io.h"
 #include "common/errno.h"
 
-#define LOG_CLASS_LIST_MAX_ENTRIES (1000)
 #define dout_subsys ceph_subsys_rgw
 
+static int parse_max_entries(struct req_state *s, const string& in, unsigned *out) {
+  unsigned max_entries = s->cct->_conf->rgw_log_list_max_entries;
+
+  if (!in.empty()) {
+    string err;
+    unsigned requested = (unsigned)strict_strtol(in.c_str(), 10, &err);
+    if (!err.empty()) {
+      dout(5) << "Error parsing max-entries " << in << dendl;
+      return -EINVAL;
+    }
+    if (requested < max_entries)
+      max_entries = requested;
+  }
+  *out = max_entries;
+  return 0;
+}
+
 static int parse_date_str(string& in, utime_t& out) {
   uint64_t epoch = 0;
   uint64_t nsec = 0;
@@ -47,7 +63,7 @@ void RGWOp_MDLog_List::execute() {
   utime_t  ut_st, 
            ut_et;
   void    *handle;
-  unsigned shard_id, max_entries = LOG_CLASS_LIST_MAX_ENTRIES;
+  unsigned shard_id, max_entries;
 
   shard_id = (unsigned)strict_strtol(shard.c_str(), 10, &err);
   if (!err.empty()) {
@@ -66,28 +82,26 @@ void RGWOp_MDLog_List::execute() {
     return;
   }
 
-  if (!max_entries_str.empty()) {
-    max_entries = (unsigned)strict_strtol(max_entries_str.c_str(), 10, &err);
-    if (!err.empty()) {
-      dout(5) << "Error parsing max-entries " << max_entries_str << dendl;
-      http_ret = -EINVAL;
-      return;
-    }
-  } 
-  
+  if (parse_max_entries(s, max_entries_str, &max_entries) < 0) {
+    http_ret = -EINVAL;
+    return;
+  }
+
   RGWMetadataLog *meta_log = store->meta_mgr->get_log();
 
   meta_log->init_list_entries(shard_id, ut_st, ut_et, marker, &handle);
 
+  /* cls_log hands out at most 1000 entries per call; fill the page here
+   * rather than making the client come back for each of them */
   do {
-    http_ret = meta_log->list_entries(handle, max_entries, entries,
-				      &last_marker, &truncated);
+    list<cls_log_entry> page;
+    http_ret = meta_log->list_entries(handle, max_entries - entries.size(),
+				      page, &last_marker, &truncated);
     if (http_ret < 0) 
       break;
 
-    if (!max_entries_str.empty()) 
-      max_entries -= entries.size();
-  } while (truncated && (max_entries > 0));
+    entries.splice(entries.end(), page);
+  } while (truncated && entries.size() < max_entries);
 
   meta_log->complete_list_entries(handle);
 }
@@ -306,11 +320,9 @@ void RGWOp_BILog_List::execute() {
 
   bool truncated;
   unsigned count = 0;
-  string err;
 
-  max_entries = (unsigned)strict_strtol(max_entries_str.c_str(), 10, &err);
-  if (!err.empty())
-    max_entries = LOG_CLASS_LIST_MAX_ENTRIES;
+  if (parse_max_entries(s, max_entries_str, &max_entries) < 0)
+    max_entries = s->cct->_conf->rgw_log_list_max_entries;
 
   send_response();
   do {
@@ -468,7 +480,7 @@ void RGWOp_DATALog_List::execute() {
            err;
   utime_t  ut_st, 
            ut_et;
-  unsigned shard_id, max_entries = LOG_CLASS_LIST_MAX_ENTRIES;
+  unsigned shard_id, max_entries;
 
   shard_id = (unsigned)strict_strtol(shard.c_str(), 10, &err);
   if (!err.empty()) {
@@ -487,27 +499,23 @@ void RGWOp_DATALog_List::execute() {
     return;
   }
 
-  if (!max_entries_str.empty()) {
-    max_entries = (unsigned)strict_strtol(max_entries_str.c_str(), 10, &err);
-    if (!err.empty()) {
-      dout(5) << "Error parsing max-entries " << max_entries_str << dendl;
-      http_ret = -EINVAL;
-      return;
-    }
-  } 
-  
+  if (parse_max_entries(s, max_entries_str, &max_entries) < 0) {
+    http_ret = -EINVAL;
+    return;
+  }
+
   do {
     // Note that last_marker is updated to be the marker of the last
-    // entry listed
+    // entry listed; list_entries() appends to entries
     http_ret = store->data_log->list_entries(shard_id, ut_st, ut_et, 
-					     max_entries, entries, marker,
+					     max_entries - entries.size(),
+					     entries, marker,
 					     &last_marker, &truncated);
     if (http_ret < 0) 
       break;
 
-    if (!max_entries_str.empty()) 
-      max_entries -= entries.size();
-  } while (truncated && (max_entries > 0));
+    marker = last_marker;
+  } while (truncated && entries.size() < max_entries);
 }
 
 void RGWOp_DATALog_List::send_response() {
@@ -185,7 +185,7 @@ done:
 
 send_data:
   if (get_data && !ret) {
-    int r = s->cio->write(bl.c_str() + bl_ofs, bl_len);
+    int r = dump_body(s, bl, bl_ofs, bl_len);
     if (r < 0)
       return r;
   }
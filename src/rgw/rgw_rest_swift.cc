@@ -898,7 +898,7 @@ int RGWGetObj_ObjStore_SWIFT::send_response_data(bufferlist& bl, off_t bl_ofs, o
 
 send_data:
   if (get_data && !ret) {
-    int r = s->cio->write(bl.c_str() + bl_ofs, bl_len);
+    int r = dump_body(s, bl, bl_ofs, bl_len);
     if (r < 0)
       return r;
   }
@@ -711,7 +711,8 @@ void RGWSwift::init()
 
 void RGWSwift::init_keystone()
 {
-  keystone_token_cache = new RGWKeystoneTokenCache(cct, cct->_conf->rgw_keystone_token_cache_size);
+  keystone_token_cache = new RGWKeystoneTokenCache(cct, cct->_conf->rgw_keystone_token_cache_size,
+						  cct->_conf->rgw_keystone_token_cache_shards);
 
   keystone_revoke_thread = new KeystoneRevokeThread(cct, this);
   keystone_revoke_thread->create();
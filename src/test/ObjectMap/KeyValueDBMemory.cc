@@ -213,6 +213,18 @@ int KeyValueDBMemory::rmkeys_by_prefix(const string &prefix) {
   return 0;
 }
 
+int KeyValueDBMemory::rm_range_keys(const string &prefix,
+				    const string &start,
+				    const string &end) {
+  map<std::pair<string,string>,bufferlist>::iterator i;
+  i = db.lower_bound(make_pair(prefix, start));
+  while (i != db.end() &&
+	 i->first.first == prefix &&
+	 i->first.second < end)
+    db.erase(i++);
+  return 0;
+}
+
 KeyValueDB::WholeSpaceIterator KeyValueDBMemory::_get_iterator() {
   return ceph::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
     new WholeSpaceMemIterator(this)
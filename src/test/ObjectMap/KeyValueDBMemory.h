@@ -56,6 +56,12 @@ public:
     const string &prefix
     );
 
+  int rm_range_keys(
+    const string &prefix,
+    const string &start,
+    const string &end
+    );
+
   class TransactionImpl_ : public TransactionImpl {
   public:
     list<Context *> on_commit;
@@ -110,6 +116,24 @@ public:
       on_commit.push_back(new RmKeysByPrefixOp(db, prefix));
     }
 
+    struct RmRangeKeysOp : public Context {
+      KeyValueDBMemory *db;
+      string prefix, start, end;
+      RmRangeKeysOp(KeyValueDBMemory *db,
+		    const string &prefix,
+		    const string &start,
+		    const string &end)
+	: db(db), prefix(prefix), start(start), end(end) {}
+      void finish(int r) {
+	db->rm_range_keys(prefix, start, end);
+      }
+    };
+    void rm_range_keys(const string &prefix,
+		       const string &start,
+		       const string &end) {
+      on_commit.push_back(new RmRangeKeysOp(db, prefix, start, end));
+    }
+
     int complete() {
       for (list<Context *>::iterator i = on_commit.begin();
 	   i != on_commit.end();
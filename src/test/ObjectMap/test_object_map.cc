@@ -745,6 +745,37 @@ TEST_F(ObjectMapTest, OddEvenClone) {
   db->clear(hoid2);
 }
 
+TEST_F(ObjectMapTest, RmKeyRange) {
+  ghobject_t hoid(hobject_t(sobject_t("foo", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("foo2", CEPH_NOSNAP)));
+
+  for (unsigned i = 0; i < 100; ++i) {
+    tester.set_key(hoid, "foo" + num_str(i), "bar" + num_str(i));
+  }
+
+  // no parent
+  ASSERT_EQ(0, db->rm_key_range(hoid, "foo" + num_str(10),
+				"foo" + num_str(20)));
+  db->clone(hoid, hoid2);
+  // keys still in the parent have to be copied up around the range
+  ASSERT_EQ(0, db->rm_key_range(hoid2, "foo" + num_str(30),
+				"foo" + num_str(40)));
+
+  for (unsigned i = 0; i < 100; ++i) {
+    string result;
+    int r = tester.get_key(hoid, "foo" + num_str(i), &result);
+    int r2 = tester.get_key(hoid2, "foo" + num_str(i), &result);
+    ASSERT_EQ(i >= 10 && i < 20 ? 0 : 1, r);
+    ASSERT_EQ((i >= 10 && i < 20) || (i >= 30 && i < 40) ? 0 : 1, r2);
+  }
+
+  ASSERT_EQ(-ENOENT, db->rm_key_range(
+	      ghobject_t(hobject_t(sobject_t("nope", CEPH_NOSNAP))), "a", "b"));
+
+  db->clear(hoid);
+  db->clear(hoid2);
+}
+
 TEST_F(ObjectMapTest, RandomTest) {
   tester.def_init();
   for (unsigned i = 0; i < 5000; ++i) {
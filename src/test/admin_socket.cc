@@ -18,6 +18,7 @@
 #include "common/Cond.h"
 #include "common/admin_socket.h"
 #include "common/admin_socket_client.h"
+#include "common/Thread.h"
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
 #include "global/global_context.h"
@@ -254,6 +255,79 @@ TEST(AdminSocketClient, Ping) {
   }
 }
 
+class WaitingHook : public AdminSocketHook {
+public:
+  Mutex _lock;
+  Cond _cond;
+  bool _entered, _released;
+
+  WaitingHook() : _lock("WaitingHook::_lock"), _entered(false),
+		  _released(false) {}
+
+  bool call(std::string command, cmdmap_t& cmdmap, std::string format, bufferlist& result) {
+    Mutex::Locker l(_lock);
+    _entered = true;
+    _cond.SignalAll();
+    while (!_released)
+      _cond.Wait(_lock);
+    result.append("released");
+    return true;
+  }
+};
+
+class RequestThread : public Thread {
+public:
+  std::string path, request, result, err;
+  RequestThread(const std::string &p, const std::string &r)
+    : path(p), request(r) {}
+  void *entry() {
+    AdminSocketClient client(path);
+    err = client.do_request(request, &result);
+    return NULL;
+  }
+};
+
+TEST(AdminSocket, Concurrent) {
+  std::unique_ptr<AdminSocket>
+      asokc(new AdminSocket(g_ceph_context));
+  AdminSocketTest asoct(asokc.get());
+  ASSERT_EQ(true, asoct.shutdown());
+  ASSERT_EQ(true, asoct.init(get_rand_socket_path()));
+  WaitingHook *waiting = new WaitingHook();
+  MyTest *test = new MyTest();
+  ASSERT_EQ(0, asoct.m_asokc->register_command("wait", "wait", waiting, ""));
+  ASSERT_EQ(0, asoct.m_asokc->register_command("test", "test", test, ""));
+
+  RequestThread t(get_rand_socket_path(), "{\"prefix\":\"wait\"}");
+  t.create();
+  {
+    Mutex::Locker l(waiting->_lock);
+    while (!waiting->_entered)
+      waiting->_cond.Wait(waiting->_lock);
+  }
+
+  // another hook is served while the first is busy
+  AdminSocketClient client(get_rand_socket_path());
+  string result;
+  ASSERT_EQ("", client.do_request("{\"prefix\":\"test\"}", &result));
+  ASSERT_EQ("test|", result);
+
+  {
+    Mutex::Locker l(waiting->_lock);
+    waiting->_released = true;
+    waiting->_cond.SignalAll();
+  }
+  t.join();
+  ASSERT_EQ("", t.err);
+  ASSERT_EQ("released", t.result);
+
+  ASSERT_EQ(0, asoct.m_asokc->unregister_command("wait"));
+  ASSERT_EQ(0, asoct.m_asokc->unregister_command("test"));
+  delete waiting;
+  delete test;
+  ASSERT_EQ(true, asoct.shutdown());
+}
+
 TEST(AdminSocket, bind_and_listen) {
   string path = get_rand_socket_path();
   std::unique_ptr<AdminSocket>
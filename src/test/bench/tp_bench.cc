@@ -103,6 +103,47 @@ public:
   PassAlong(ThreadPool *tp, Queueable *_next) :
     ThreadPool::WorkQueue<unsigned>("TestQueue", 100, 100, tp), next(_next) {}
 };
+class BatchPassAlong : public ThreadPool::BatchWorkQueue<unsigned> {
+  Queueable *next;
+  list<unsigned*> q;
+  bool _enqueue(unsigned *item) {
+    q.push_back(item);
+    return true;
+  }
+  void _dequeue(unsigned *item) { assert(0); }
+  void _dequeue(list<unsigned*> *out) {
+    out->swap(q);
+  }
+  using ThreadPool::BatchWorkQueue<unsigned>::_process;
+  void _process(const list<unsigned*> &items) {
+    for (list<unsigned*>::const_iterator i = items.begin();
+	 i != items.end();
+	 ++i)
+      next->queue(*i);
+  }
+  void _clear() { q.clear(); }
+  bool _empty() { return q.empty(); }
+public:
+  BatchPassAlong(ThreadPool *tp, Queueable *_next) :
+    ThreadPool::BatchWorkQueue<unsigned>("TestBatchQueue", 100, 100, tp),
+    next(_next) {}
+};
+class BatchWQWrapper : public Queueable {
+  boost::scoped_ptr<ThreadPool> tp;
+  boost::scoped_ptr<BatchPassAlong> wq;
+  bool lockless;
+public:
+  BatchWQWrapper(ThreadPool *tp, Queueable *next, bool lockless) :
+    tp(tp), wq(new BatchPassAlong(tp, next)), lockless(lockless) {}
+  void queue(unsigned *item) {
+    if (lockless)
+      wq->queue_lockless(item);
+    else
+      wq->queue(item);
+  }
+  void start() { tp->start(); }
+  void stop() { tp->stop(); }
+};
 
 int main(int argc, char **argv)
 {
@@ -116,7 +157,8 @@ int main(int argc, char **argv)
     ("num-items", po::value<unsigned>()->default_value(3000000),
      "num items")
     ("layers", po::value<string>()->default_value(""),
-     "layer desc")
+     "layer desc: q = WorkQueue, b/B = BatchWorkQueue with locked/lockless "
+     "enqueue, f/F = Finisher with locked/lockless queue")
     ;
 
   vector<string> ceph_option_strings;
@@ -179,7 +221,17 @@ int main(int argc, char **argv)
 	  new PassAlong(tp, wqs.back()),
 	  tp
 	  ));
-    } else if (*i == 'f') {
+    } else if (*i == 'b' || *i == 'B') {
+      ThreadPool *tp =
+	new ThreadPool(
+	  g_ceph_context, ss.str(), vm["num-threads"].as<unsigned>(), 0);
+      wqs.push_back(
+	new BatchWQWrapper(tp, wqs.back(), *i == 'B'));
+    } else if (*i == 'f' || *i == 'F') {
+      // the queue flavour is picked up when the Finisher is built
+      g_ceph_context->_conf->set_val("finisher_lockless_queue",
+				     *i == 'F' ? "true" : "false");
+      g_ceph_context->_conf->apply_changes(NULL);
       wqs.push_back(
 	new FinisherWrapper(
 	  g_ceph_context, wqs.back()));
@@ -8,6 +8,7 @@
 #include "common/config.h"
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
+#include "include/str_list.h"
 
 struct T : public Thread {
   int num;
@@ -28,19 +29,10 @@ struct T : public Thread {
   }
 };
 
-int main(int argc, const char **argv)
+static int run(int threads, int num)
 {
-  int threads = atoi(argv[1]);
-  int num = atoi(argv[2]);
-
   cout << threads << " threads, " << num << " lines per thread" << std::endl;
 
-  vector<const char*> args;
-  argv_to_vec(argc, argv, args);
-  env_to_vec(args);
-
-  global_init(NULL, args, CEPH_ENTITY_TYPE_OSD, CODE_ENVIRONMENT_UTILITY, 0);
-
   utime_t start = ceph_clock_now(NULL);
 
   list<T*> ls;
@@ -73,6 +65,38 @@ int main(int argc, const char **argv)
   utime_t end = ceph_clock_now(NULL);
   utime_t dur = end - start;
 
-  cout << dur << std::endl;
+  cout << dur << "  " << (uint64_t)((double)threads * num / (double)dur)
+       << " entries/sec" << std::endl;
+  return 0;
+}
+
+static void usage()
+{
+  cout << "usage: ceph_bench_log <threads>[,<threads>...] <lines per thread> [ceph options]\n"
+       << "  e.g. ceph_bench_log 1,2,4,8,16 100000 --log-file /tmp/bench.log"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc < 3) {
+    usage();
+    return 1;
+  }
+  list<string> ls;
+  get_str_list(argv[1], ",", ls);
+  int num = atoi(argv[2]);
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_OSD, CODE_ENVIRONMENT_UTILITY, 0);
+
+  for (list<string>::iterator p = ls.begin(); p != ls.end(); ++p) {
+    int r = run(atoi(p->c_str()), num);
+    if (r < 0)
+      return r;
+  }
   return 0;
 }
@@ -54,6 +54,9 @@ TEST(Buffer, constructors) {
     EXPECT_EQ(len, ptr.length());
     if (ceph_buffer_track)
       EXPECT_EQ(len, (unsigned)buffer::get_total_alloc());
+    ::memset(ptr.c_str(), 'X', len);
+    bufferptr clone = ptr.clone();
+    EXPECT_EQ(0, ::memcmp(clone.c_str(), ptr.c_str(), len));
   }
   //
   // buffer::claim_char
@@ -330,6 +333,66 @@ TEST_F(TestRawPipe, buffer_list_write_fd_zero_copy) {
 // +-----------+                | raw |
 //                              +-----+
 //
+TEST(Buffer, pools) {
+  int64_t osd_bytes = buffer::get_pool_bytes(buffer::POOL_OSD);
+  int64_t osd_items = buffer::get_pool_items(buffer::POOL_OSD);
+  int64_t anon_bytes = buffer::get_pool_bytes(buffer::POOL_ANON);
+  {
+    bufferlist bl;
+    bl.append(bufferptr(100));
+    EXPECT_EQ(anon_bytes + 100, buffer::get_pool_bytes(buffer::POOL_ANON));
+    bl.reassign_to_pool(buffer::POOL_OSD);
+    EXPECT_EQ(osd_bytes + 100, buffer::get_pool_bytes(buffer::POOL_OSD));
+    EXPECT_EQ(osd_items + 1, buffer::get_pool_items(buffer::POOL_OSD));
+    EXPECT_EQ(anon_bytes, buffer::get_pool_bytes(buffer::POOL_ANON));
+    // reassigning to the same pool is a no-op
+    bl.reassign_to_pool(buffer::POOL_OSD);
+    EXPECT_EQ(osd_bytes + 100, buffer::get_pool_bytes(buffer::POOL_OSD));
+  }
+  EXPECT_EQ(osd_bytes, buffer::get_pool_bytes(buffer::POOL_OSD));
+  EXPECT_EQ(osd_items, buffer::get_pool_items(buffer::POOL_OSD));
+  EXPECT_EQ(anon_bytes, buffer::get_pool_bytes(buffer::POOL_ANON));
+  EXPECT_STREQ("osd", buffer::get_pool_name(buffer::POOL_OSD));
+}
+
+TEST(Buffer, thread_cache) {
+  buffer::set_thread_cache_size(1 << 20);
+  unsigned len = 65536;
+  char *p;
+  {
+    bufferptr ptr(buffer::create_aligned(len, sizeof(void *)));
+    EXPECT_TRUE(ptr.is_page_aligned());
+    p = ptr.c_str();
+  }
+  EXPECT_EQ((int64_t)len, buffer::get_thread_cache_bytes());
+  int64_t hits = buffer::get_thread_cache_hits();
+  {
+    bufferptr ptr(buffer::create_page_aligned(len));
+    EXPECT_EQ(p, ptr.c_str());
+    EXPECT_EQ(hits + 1, buffer::get_thread_cache_hits());
+    EXPECT_EQ(0, buffer::get_thread_cache_bytes());
+  }
+  {
+    // sizes outside the classes are not cached
+    bufferptr ptr(buffer::create_page_aligned(len + CEPH_PAGE_SIZE));
+  }
+  EXPECT_EQ((int64_t)len, buffer::get_thread_cache_bytes());
+
+  // 4K buffers from plain create() are cached too
+  {
+    bufferptr ptr(buffer::create(4096));
+    p = ptr.c_str();
+  }
+  EXPECT_EQ((int64_t)len + 4096, buffer::get_thread_cache_bytes());
+  hits = buffer::get_thread_cache_hits();
+  {
+    bufferptr ptr(buffer::create(4096));
+    EXPECT_EQ(p, ptr.c_str());
+    EXPECT_EQ(hits + 1, buffer::get_thread_cache_hits());
+  }
+  buffer::set_thread_cache_size(0);
+}
+
 TEST(BufferPtr, constructors) {
   unsigned len = 17;
   //
@@ -1878,6 +1941,29 @@ TEST(BufferList, append) {
   }
 }
 
+TEST(BufferList, append_small) {
+  // many small appends into fresh bufferlists, as when building messages
+  for (int s=1; s<=8; s*=2) {
+    bufferlist bl;
+    std::string expected;
+    for (int j=0; j<32; j += s) {
+      uint64_t v = 0x0807060504030201ull * (j + 1);
+      bl.append((char *)&v, s);
+      expected.append((char *)&v, s);
+    }
+    EXPECT_EQ(32u, bl.length());
+    EXPECT_EQ(expected, std::string(bl.c_str(), bl.length()));
+    // consecutive appends share one append buffer
+    EXPECT_EQ(1u, bl.buffers().size());
+  }
+  {
+    bufferptr bp("foobarbaz", 9);
+    EXPECT_EQ(9u, bp.length());
+    EXPECT_EQ(0, memcmp(bp.c_str(), "foobarbaz", 9));
+    EXPECT_EQ(bp.length(), bp.raw_length());
+  }
+}
+
 TEST(BufferList, append_zero) {
   bufferlist bl;
   bl.append('A');
@@ -2083,6 +2169,27 @@ TEST(BufferList, write_fd) {
   ::unlink(FILENAME);
 }
 
+TEST(BufferList, write_fd_offset) {
+  ::unlink(FILENAME);
+  int fd = ::open(FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0600);
+  bufferlist bl;
+  for (unsigned i = 0; i < IOV_MAX * 2; i++) {
+    bufferptr ptr("A", 1);
+    bl.push_back(ptr);
+  }
+  uint64_t offset = 200;
+  EXPECT_EQ(0, bl.write_fd(fd, offset));
+  struct stat st;
+  memset(&st, 0, sizeof(st));
+  ::fstat(fd, &st);
+  EXPECT_EQ(IOV_MAX * 2 + offset, (uint64_t)st.st_size);
+  char buf[2];
+  EXPECT_EQ(1, ::pread(fd, buf, 1, offset + IOV_MAX * 2 - 1));
+  EXPECT_EQ('A', buf[0]);
+  ::close(fd);
+  ::unlink(FILENAME);
+}
+
 TEST(BufferList, crc32c) {
   bufferlist bl;
   __u32 crc = 0;
@@ -79,6 +79,14 @@
      --show-mappings       show mappings
      --show-bad-mappings   show bad mappings
      --show-choose-tries   show choose tries histogram
+     -i mapfn --compare mapfn2
+                           map the same inputs with both maps and report
+                           what moves (takes the --test range options)
+        [--compare-domain type]
+                           total moves per bucket of type (default host)
+        [--format json|json-pretty]
+                           dump moves per device and bucket
+     --threads n           map with n threads (--test, --compare)
      --output-name name
                            prepend the data file(s) generated during the
                            testing routine with name
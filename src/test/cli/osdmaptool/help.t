@@ -5,9 +5,18 @@
      --import-crush <file>   replace osdmap's crush map with <file>
      --test-map-pgs [--pool <poolid>] map all pgs
      --test-map-pgs-dump [--pool <poolid>] map all pgs
+     --mapping-threads <n>   precompute all pg mappings with n threads first
+     --test-map-pgs-diff <file> list pgs whose mapping differs in osdmap <file>
+     --test-map-pgs-inc <file> [--pool <poolid>] count the pgs that incremental
+                             <file> would move
+     --format <json|json-pretty|xml> report --test-map-pgs* as per osd, per host
+                             and per pool distributions
      --mark-up-in            mark osds up and in (but do not persist)
      --clear-temp            clear pg_temp and primary_temp
      --test-random           do random placements
      --test-map-pg <pgid>    map a pgid to osds
      --test-map-object <objectname> [--pool <poolid>] map an object to osds
+     --balance <file> [--pool <poolid>] [--balance-max-change <f>] [--balance-rounds <n>]
+                             even out pgs per osd with reweights, write
+                             them to <file> as an incremental
   [1]
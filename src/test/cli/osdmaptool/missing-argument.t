@@ -5,6 +5,8 @@
      --import-crush <file>   replace osdmap's crush map with <file>
      --test-map-pgs [--pool <poolid>] map all pgs
      --test-map-pgs-dump [--pool <poolid>] map all pgs
+     --mapping-threads <n>   precompute all pg mappings with n threads first
+     --test-map-pgs-diff <file> list pgs whose mapping differs in osdmap <file>
      --mark-up-in            mark osds up and in (but do not persist)
      --clear-temp            clear pg_temp and primary_temp
      --test-random           do random placements
@@ -189,6 +189,67 @@ TEST(cls_rgw, test_log_add_same_time)
   delete rop;
 }
 
+TEST(cls_rgw, test_log_add_batch_same_time)
+{
+  librados::Rados rados;
+  librados::IoCtx ioctx;
+  string pool_name = get_temp_pool_name();
+
+  /* create pool */
+  ASSERT_EQ("", create_one_pool_pp(pool_name, rados));
+  ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), ioctx));
+
+  string oid = "obj";
+  ASSERT_EQ(0, ioctx.create(oid, true));
+
+  /* one add call carrying all the entries, with the same time */
+  utime_t start_time = ceph_clock_now(g_ceph_context);
+  list<cls_log_entry> add;
+  for (int i = 0; i < 10; i++) {
+    cls_log_entry e;
+    e.section = "global";
+    e.name = get_name(i);
+    e.timestamp = start_time;
+    ::encode(i, e.data);
+    add.push_back(e);
+  }
+  librados::ObjectWriteOperation *op = new_op();
+  cls_log_add(*op, add);
+  ASSERT_EQ(0, ioctx.operate(oid, op));
+  delete op;
+
+  librados::ObjectReadOperation *rop = new_rop();
+  list<cls_log_entry> entries;
+  bool truncated;
+  string marker;
+  utime_t to_time = get_time(start_time, 1, true);
+  cls_log_list(*rop, start_time, to_time, marker, 0, entries, &marker, &truncated);
+  bufferlist obl;
+  ASSERT_EQ(0, ioctx.operate(oid, rop, &obl));
+
+  /* none overwrote another, and they list in the order they were added */
+  ASSERT_EQ(10, (int)entries.size());
+  ASSERT_EQ(0, (int)truncated);
+  int i = 0;
+  for (list<cls_log_entry>::iterator iter = entries.begin();
+       iter != entries.end(); ++iter, ++i) {
+    int num;
+    ASSERT_EQ(0, read_bl(iter->data, &num));
+    ASSERT_EQ(i, num);
+    check_entry(*iter, start_time, i, false);
+  }
+
+  /* and they all trim */
+  ASSERT_EQ(0, cls_log_trim(ioctx, oid, start_time, to_time, "", ""));
+  reset_rop(&rop);
+  marker.clear();
+  cls_log_list(*rop, start_time, to_time, marker, 0, entries, &marker, &truncated);
+  ASSERT_EQ(0, ioctx.operate(oid, rop, &obl));
+  ASSERT_EQ(0, (int)entries.size());
+
+  delete rop;
+}
+
 TEST(cls_rgw, test_log_add_different_time)
 {
   librados::Rados rados;
@@ -412,3 +412,99 @@ TEST(ClsNumOps, Div) {
 
   ASSERT_EQ(0, destroy_one_pool_pp(pool_name, cluster));
 }
+
+TEST(ClsNumOps, AddMany) {
+  Rados cluster;
+  std::string pool_name = get_temp_pool_name();
+  ASSERT_EQ("", create_one_pool_pp(pool_name, cluster));
+  IoCtx ioctx;
+  cluster.ioctx_create(pool_name.c_str(), ioctx);
+
+  // update several keys, new and existing, in one call
+
+  std::map<std::string, bufferlist> omap;
+  omap["b"].append("10");
+  ASSERT_EQ(0, ioctx.omap_set("myobject", omap));
+
+  std::map<std::string, double> values;
+  values["a"] = 1;
+  values["b"] = 2.5;
+  values["c"] = -3;
+  ASSERT_EQ(0, rados::cls::numops::add_many(&ioctx, "myobject", values));
+
+  values.clear();
+  values["a"] = 4;
+  values["b"] = 2;
+  ASSERT_EQ(0, rados::cls::numops::mul_many(&ioctx, "myobject", values));
+
+  omap.clear();
+  ASSERT_EQ(0, ioctx.omap_get_vals("myobject", "", 10, &omap));
+  ASSERT_EQ(3u, omap.size());
+  EXPECT_EQ("4", std::string(omap["a"].c_str(), omap["a"].length()));
+  EXPECT_EQ("25", std::string(omap["b"].c_str(), omap["b"].length()));
+  EXPECT_EQ("-3", std::string(omap["c"].c_str(), omap["c"].length()));
+
+  // a non-numeric stored value fails the whole call
+
+  omap.clear();
+  omap["c"].append("some-non-numeric-text");
+  ASSERT_EQ(0, ioctx.omap_set("myobject", omap));
+
+  values.clear();
+  values["a"] = 1;
+  values["c"] = 1;
+  ASSERT_EQ(-EBADMSG, rados::cls::numops::add_many(&ioctx, "myobject", values));
+
+  omap.clear();
+  ASSERT_EQ(0, ioctx.omap_get_vals("myobject", "", 10, &omap));
+  EXPECT_EQ("4", std::string(omap["a"].c_str(), omap["a"].length()));
+
+  ASSERT_EQ(0, destroy_one_pool_pp(pool_name, cluster));
+}
+
+TEST(ClsNumOps, Filter) {
+  Rados cluster;
+  std::string pool_name = get_temp_pool_name();
+  ASSERT_EQ("", create_one_pool_pp(pool_name, cluster));
+  IoCtx ioctx;
+  cluster.ioctx_create(pool_name.c_str(), ioctx);
+
+  std::map<std::string, double> values;
+  for (int i = 0; i < 10; ++i) {
+    std::stringstream key;
+    key << "user." << i;
+    values[key.str()] = i;
+  }
+  values["other"] = 5;
+  ASSERT_EQ(0, rados::cls::numops::add_many(&ioctx, "myobject", values));
+
+  std::map<std::string, double> matches;
+  double sum;
+  std::string last_key;
+  bool truncated;
+  ASSERT_EQ(0, rados::cls::numops::filter(&ioctx, "myobject", "user.", "", 0,
+                                          3, 6, &matches, &sum, &last_key,
+                                          &truncated));
+  ASSERT_EQ(4u, matches.size());
+  EXPECT_EQ(3, matches["user.3"]);
+  EXPECT_EQ(18, sum);
+  EXPECT_FALSE(truncated);
+
+  // page through with a small max_keys
+
+  std::string start_after;
+  double total = 0;
+  int calls = 0;
+  do {
+    ASSERT_EQ(0, rados::cls::numops::filter(&ioctx, "myobject", "user.",
+                                            start_after, 4, 0, 100, &matches,
+                                            &sum, &last_key, &truncated));
+    total += sum;
+    start_after = last_key;
+    ++calls;
+  } while (truncated);
+  EXPECT_EQ(45, total);
+  EXPECT_EQ(3, calls);
+
+  ASSERT_EQ(0, destroy_one_pool_pp(pool_name, cluster));
+}
@@ -846,6 +846,45 @@ TEST_F(TestClsRbd, snapshots)
   ioctx.close();
 }
 
+TEST_F(TestClsRbd, snapshot_list_known)
+{
+  librados::IoCtx ioctx;
+  ASSERT_EQ(0, _rados.ioctx_create(_pool_name.c_str(), ioctx));
+
+  string oid = get_temp_image_name();
+  ASSERT_EQ(0, create_image(&ioctx, oid, 10, 22, RBD_FEATURE_LAYERING, oid));
+  ASSERT_EQ(0, snapshot_add(&ioctx, oid, 1, "snap1"));
+  ASSERT_EQ(0, set_size(&ioctx, oid, 20));
+  ASSERT_EQ(0, snapshot_add(&ioctx, oid, 2, "snap2"));
+  ASSERT_EQ(0, set_protection_status(&ioctx, oid, 1,
+				     RBD_PROTECTION_STATUS_PROTECTED));
+
+  SnapContext snapc;
+  ASSERT_EQ(0, get_snapcontext(&ioctx, oid, &snapc));
+  ASSERT_EQ(2u, snapc.snaps.size());
+  ASSERT_EQ(2u, snapc.snaps[0]);
+  ASSERT_EQ(1u, snapc.snaps[1]);
+
+  vector<string> snap_names;
+  vector<uint64_t> snap_sizes;
+  vector<parent_info> parents;
+  vector<uint8_t> protection_status;
+  vector<bool> known(2);
+  known[1] = true;
+  ASSERT_EQ(0, snapshot_list(&ioctx, oid, snapc.snaps, known, &snap_names,
+			     &snap_sizes, &parents, &protection_status));
+  ASSERT_EQ(2u, snap_names.size());
+  ASSERT_EQ("snap2", snap_names[0]);
+  ASSERT_EQ(20u, snap_sizes[0]);
+  ASSERT_EQ(RBD_PROTECTION_STATUS_UNPROTECTED, protection_status[0]);
+  // only the protection status of a known snapshot is filled in
+  ASSERT_EQ("", snap_names[1]);
+  ASSERT_EQ(0u, snap_sizes[1]);
+  ASSERT_EQ(RBD_PROTECTION_STATUS_PROTECTED, protection_status[1]);
+
+  ioctx.close();
+}
+
 TEST_F(TestClsRbd, snapid_race)
 {
   librados::IoCtx ioctx;
@@ -267,6 +267,63 @@ TEST(cls_rgw, index_remove_object)
   test_stats(ioctx, bucket_oid, 0, NUM_OBJS - 1, total_size);
 }
 
+TEST(cls_rgw, index_complete_many)
+{
+  string bucket_oid = str_int("bucket", 4);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  uint64_t obj_size = 1024;
+
+  list<rgw_cls_obj_complete_op> ops;
+  for (int i = 0; i < NUM_OBJS; i++) {
+    string obj = str_int("obj", i);
+    string tag = str_int("tag", i);
+    string loc = str_int("loc", i);
+
+    index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+
+    rgw_cls_obj_complete_op c;
+    c.op = CLS_RGW_OP_ADD;
+    c.key = cls_rgw_obj_key(obj, string());
+    c.tag = tag;
+    c.ver.pool = ioctx.get_id();
+    c.ver.epoch = 1;
+    c.meta.category = 0;
+    c.meta.size = c.meta.accounted_size = obj_size;
+    c.log_op = true;
+    ops.push_back(c);
+  }
+
+  /* a second writer of obj-0, which must see the first one's entry */
+  string obj = str_int("obj", 0);
+  string tag = str_int("tag", NUM_OBJS);
+  string loc = str_int("loc", 0);
+  index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+  rgw_cls_obj_complete_op c = ops.front();
+  c.tag = tag;
+  c.ver.epoch = 2;
+  c.meta.size = c.meta.accounted_size = obj_size * 2;
+  ops.push_back(c);
+
+  /* and one that fails: unknown tag */
+  c.tag = "no-such-tag";
+  c.ver.epoch = 3;
+  ops.push_back(c);
+
+  test_stats(ioctx, bucket_oid, 0, 0, 0);
+
+  op = mgr.write_op();
+  cls_rgw_bucket_complete_ops(*op, ops);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  test_stats(ioctx, bucket_oid, 0, NUM_OBJS, obj_size * (NUM_OBJS + 1));
+}
+
 TEST(cls_rgw, index_suggest)
 {
   string bucket_oid = str_int("bucket", 3);
@@ -128,3 +128,35 @@ TEST(Readahead, alignment) {
   ASSERT_RA(1400, 300, r.update(1290, 10, Readahead::NO_LIMIT)); // internal readahead size 320
   ASSERT_RA(0, 0, r.update(1300, 10, Readahead::NO_LIMIT));
 }
+
+TEST(Readahead, interleaved_streams) {
+  Readahead r;
+  r.set_trigger_requests(2);
+  r.set_max_streams(2);
+  ASSERT_RA(0, 0, r.update(1000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1030, 20, r.update(1020, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(5030, 20, r.update(5020, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1050, 40, r.update(1030, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(5050, 40, r.update(5030, 10, Readahead::NO_LIMIT));
+
+  // a third stream restarts the least recently used one
+  ASSERT_RA(0, 0, r.update(9000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5040, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5050, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(5090, 80, r.update(5060, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1040, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1050, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1070, 20, r.update(1060, 10, Readahead::NO_LIMIT));
+}
+
+TEST(Readahead, single_stream_restarts) {
+  Readahead r;
+  r.set_trigger_requests(2);
+  ASSERT_RA(0, 0, r.update(1000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1020, 10, Readahead::NO_LIMIT));
+}
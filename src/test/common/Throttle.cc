@@ -167,6 +167,55 @@ TEST_F(ThrottleTest, get_or_fail) {
   }
 }
 
+class C_CountGets : public Context {
+public:
+  int *count;
+  explicit C_CountGets(int *c) : count(c) {}
+  void finish(int r) {
+    ++(*count);
+  }
+};
+
+TEST_F(ThrottleTest, get_or_queue) {
+  int64_t throttle_max = 10;
+  Throttle throttle(g_ceph_context, "throttle", throttle_max);
+  int granted = 0;
+
+  // an immediate grant returns 0 and does not call back
+  ASSERT_EQ(throttle.get_or_queue(throttle_max, new C_CountGets(&granted)), 0u);
+  ASSERT_EQ(granted, 0);
+  ASSERT_EQ(throttle.get_current(), throttle_max);
+
+  // queued waiters are granted in order as slots are returned
+  uint64_t t1 = throttle.get_or_queue(5, new C_CountGets(&granted));
+  uint64_t t2 = throttle.get_or_queue(5, new C_CountGets(&granted));
+  ASSERT_NE(t1, 0u);
+  ASSERT_NE(t2, 0u);
+  ASSERT_NE(t1, t2);
+
+  // nobody jumps the queue
+  ASSERT_FALSE(throttle.get_or_fail(1));
+
+  throttle.put(5);
+  ASSERT_EQ(granted, 1);
+  ASSERT_EQ(throttle.get_current(), throttle_max);
+  ASSERT_FALSE(throttle.cancel_queued(t1));
+
+  // a cancelled waiter is never granted
+  ASSERT_TRUE(throttle.cancel_queued(t2));
+  throttle.put(5);
+  ASSERT_EQ(granted, 1);
+  ASSERT_EQ(throttle.get_current(), 5);
+
+  // raising max wakes up waiters
+  uint64_t t3 = throttle.get_or_queue(throttle_max, new C_CountGets(&granted));
+  ASSERT_NE(t3, 0u);
+  throttle.reset_max(throttle_max * 2);
+  ASSERT_EQ(granted, 2);
+  ASSERT_EQ(throttle.get_current(), 15);
+  throttle.put(15);
+}
+
 TEST_F(ThrottleTest, wait) {
   int64_t throttle_max = 10;
   Throttle throttle(g_ceph_context, "throttle");
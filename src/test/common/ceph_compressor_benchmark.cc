@@ -0,0 +1,123 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Compresses and decompresses corpus files with each compressor and
+ * reports throughput and ratio, to pick one for a workload.
+ *
+ *   ceph_compressor_benchmark [--type snappy,zlib] [--iterations N]
+ *                             [--compressor_zlib_level L] file...
+ */
+
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/ceph_argparse.h"
+#include "common/Clock.h"
+#include "common/config.h"
+#include "common/errno.h"
+#include "compressor/Compressor.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "include/str_list.h"
+
+static double mbps(uint64_t bytes, utime_t t)
+{
+  if (t == utime_t())
+    return 0;
+  return (double)bytes / (1024 * 1024) / (double)t;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  long long iterations = 10;
+  std::string types = "snappy,zlib";
+  std::ostringstream err;
+  vector<string> files;
+  for (vector<const char*>::iterator i = args.begin(); i != args.end();) {
+    if (ceph_argparse_witharg(args, i, &iterations, err, "--iterations", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else if (ceph_argparse_witharg(args, i, &types, "--type", (char*)NULL)) {
+    } else {
+      files.push_back(*i);
+      ++i;
+    }
+  }
+  if (files.empty() || iterations < 1) {
+    cerr << "usage: " << argv[0] << " [--type snappy,zlib] [--iterations N] "
+	 << "file..." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  list<string> type_list;
+  get_str_list(types, type_list);
+  cout << "type\tfile\tbytes\tratio\tcompress MB/s\tdecompress MB/s"
+       << std::endl;
+  for (list<string>::iterator t = type_list.begin(); t != type_list.end(); ++t) {
+    boost::scoped_ptr<Compressor> c(Compressor::create(g_ceph_context, *t));
+    if (!c) {
+      cerr << "unknown compressor " << *t << std::endl;
+      return EXIT_FAILURE;
+    }
+    for (vector<string>::iterator f = files.begin(); f != files.end(); ++f) {
+      bufferlist raw;
+      std::string error;
+      int r = raw.read_file(f->c_str(), &error);
+      if (r < 0) {
+	cerr << "can't read " << *f << ": " << error << std::endl;
+	return EXIT_FAILURE;
+      }
+
+      bufferlist compressed, out;
+      utime_t start = ceph_clock_now(g_ceph_context);
+      for (long long n = 0; n < iterations; ++n) {
+	compressed.clear();
+	if (c->compress(raw, compressed) < 0) {
+	  cerr << *t << " failed to compress " << *f << std::endl;
+	  return EXIT_FAILURE;
+	}
+      }
+      utime_t ctime = ceph_clock_now(g_ceph_context) - start;
+
+      start = ceph_clock_now(g_ceph_context);
+      for (long long n = 0; n < iterations; ++n) {
+	out.clear();
+	if (c->decompress(compressed, out) < 0) {
+	  cerr << *t << " failed to decompress " << *f << std::endl;
+	  return EXIT_FAILURE;
+	}
+      }
+      utime_t dtime = ceph_clock_now(g_ceph_context) - start;
+      if (!out.contents_equal(raw)) {
+	cerr << *t << " did not round trip " << *f << std::endl;
+	return EXIT_FAILURE;
+      }
+
+      cout << *t << "\t" << *f << "\t" << raw.length() << "\t"
+	   << (raw.length() ? (double)compressed.length() / raw.length() : 1.0)
+	   << "\t" << mbps(raw.length() * iterations, ctime)
+	   << "\t" << mbps(raw.length() * iterations, dtime) << std::endl;
+    }
+  }
+  return 0;
+}
@@ -118,6 +118,23 @@ TEST(Histogram, Decay) {
   ASSERT_EQ(4u, h.h.size());
 }
 
+TEST(Histogram, ValueAt) {
+  pow2_hist_t h;
+  ASSERT_EQ(0u, h.get_count());
+  ASSERT_EQ(-1, h.get_value_at_micro(500000));
+
+  for (int i = 0; i < 98; ++i)
+    h.add(10);     // bin 4: 8..15
+  h.add(100);      // bin 7: 64..127
+  h.add(1000);     // bin 10: 512..1023
+  ASSERT_EQ(100u, h.get_count());
+  ASSERT_EQ(15, h.get_value_at_micro(0));
+  ASSERT_EQ(15, h.get_value_at_micro(500000));
+  ASSERT_EQ(15, h.get_value_at_micro(980000));
+  ASSERT_EQ(127, h.get_value_at_micro(990000));
+  ASSERT_EQ(1023, h.get_value_at_micro(1000000));
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ; make -j4 &&
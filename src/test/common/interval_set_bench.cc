@@ -0,0 +1,134 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Times interval_set insert, erase and intersection_of over sets of a
+ * few sizes, with std::map and with flat_map underneath.
+ *
+ *   ceph_bench_interval_set [--iterations N] [--seed S]
+ */
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <sstream>
+
+#include "common/ceph_argparse.h"
+#include "common/config.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "include/flat_map.h"
+#include "include/interval_set.h"
+
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+    ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+}
+
+// ascending intervals of 4k..64k with gaps
+static void make_extents(unsigned n, vector<pair<uint64_t,uint64_t> > *ex)
+{
+  ex->clear();
+  uint64_t off = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    uint64_t len = 4096 * (1 + rand() % 16);
+    ex->push_back(make_pair(off, len));
+    off += len + 4096 * (1 + rand() % 4);
+  }
+}
+
+template <typename S>
+static void run(const char *name, unsigned n, long long iterations,
+		long long seed)
+{
+  vector<pair<uint64_t,uint64_t> > seq, rnd, other;
+  srand(seed);
+  make_extents(n, &seq);
+  rnd = seq;
+  for (unsigned i = n; i > 1; --i)
+    std::swap(rnd[i - 1], rnd[rand() % i]);
+  make_extents(n, &other);
+  for (unsigned i = 0; i < other.size(); ++i)
+    other[i].first += 2048;
+
+  const char *ops[] = { "insert_seq", "insert_rand", "erase", "intersect" };
+  for (int op = 0; op < 4; ++op) {
+    S a, b;
+    for (unsigned i = 0; i < n; ++i)
+      b.insert(other[i].first, other[i].second);
+    double elapsed = 0;
+    uint64_t check = 0;
+    for (long long it = 0; it < iterations; ++it) {
+      a.clear();
+      double start = 0;
+      if (op <= 1)
+	start = cpu_seconds();
+      const vector<pair<uint64_t,uint64_t> > &ex = op == 1 ? rnd : seq;
+      for (unsigned i = 0; i < n; ++i)
+	a.insert(ex[i].first, ex[i].second);
+      if (op == 2) {
+	start = cpu_seconds();
+	for (unsigned i = 0; i < n; ++i)
+	  a.erase(rnd[i].first, rnd[i].second);
+      } else if (op == 3) {
+	start = cpu_seconds();
+	S c;
+	c.intersection_of(a, b);
+	check += c.size();
+      }
+      elapsed += cpu_seconds() - start;
+      check += a.size();
+    }
+    cout << name << "\t" << n << "\t" << ops[op] << "\t"
+	 << (uint64_t)(elapsed * 1000000000.0 / iterations / n) << "\t"
+	 << check << std::endl;
+  }
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  long long iterations = 1000;
+  long long seed = 1;
+  std::ostringstream err;
+  for (vector<const char*>::iterator i = args.begin(); i != args.end();) {
+    if (ceph_argparse_witharg(args, i, &iterations, err, "--iterations", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &seed, err, "--seed", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // ns/interval: per interval inserted or erased, per interval of the
+  // first set for intersect; the last column only keeps the work alive
+  cout << "map\tintervals\top\tns/interval\tcheck" << std::endl;
+  const unsigned sizes[] = { 16, 256, 4096 };
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    run<interval_set<uint64_t> >("std::map", sizes[s], iterations, seed);
+    run<interval_set<uint64_t, flat_map<uint64_t,uint64_t> > >(
+      "flat_map", sizes[s], iterations, seed);
+  }
+  return 0;
+}
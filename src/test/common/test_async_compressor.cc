@@ -19,6 +19,7 @@
 #include <boost/random/binomial_distribution.hpp>
 #include <gtest/gtest.h>
 #include "common/ceph_argparse.h"
+#include "common/Cond.h"
 #include "compressor/AsyncCompressor.h"
 #include "global/global_init.h"
 
@@ -94,6 +95,52 @@ TEST_F(AsyncCompressorTest, DecompressInjectTest) {
   ASSERT_EQ(-EIO, async_compressor->get_decompress_data(id, decompress_data, true, &finished));
 }
 
+TEST_F(AsyncCompressorTest, BatchTest) {
+  vector<bufferlist> raw(8), compressed(8), decompressed(8);
+  vector<bufferlist*> in, out;
+  for (unsigned i = 0; i < raw.size(); ++i) {
+    generate_random_data(raw[i], (i + 1) << 16);
+    in.push_back(&raw[i]);
+    out.push_back(&compressed[i]);
+  }
+  C_SaferCond compressed_cond;
+  async_compressor->async_compress(in, out, &compressed_cond);
+  ASSERT_EQ(0, compressed_cond.wait());
+
+  in.clear();
+  out.clear();
+  for (unsigned i = 0; i < raw.size(); ++i) {
+    in.push_back(&compressed[i]);
+    out.push_back(&decompressed[i]);
+  }
+  C_SaferCond decompressed_cond;
+  async_compressor->async_decompress(in, out, &decompressed_cond);
+  ASSERT_EQ(0, decompressed_cond.wait());
+  for (unsigned i = 0; i < raw.size(); ++i)
+    ASSERT_TRUE(raw[i].contents_equal(decompressed[i]));
+
+  // a bad one fails the batch
+  compressed[3].clear();
+  compressed[3].append("not compressed at all");
+  for (unsigned i = 0; i < raw.size(); ++i)
+    decompressed[i].clear();
+  C_SaferCond failed_cond;
+  async_compressor->async_decompress(in, out, &failed_cond);
+  ASSERT_EQ(-EIO, failed_cond.wait());
+
+  // stopped workers do it inline
+  async_compressor->terminate();
+  for (unsigned i = 0; i < raw.size(); ++i)
+    decompressed[i].clear();
+  in.resize(3);
+  out.resize(3);
+  C_SaferCond inline_cond;
+  async_compressor->async_decompress(in, out, &inline_cond);
+  ASSERT_EQ(0, inline_cond.wait());
+  ASSERT_TRUE(raw[2].contents_equal(decompressed[2]));
+  async_compressor->init();
+}
+
 class SyntheticWorkload {
   set<pair<uint64_t, uint64_t> > compress_jobs, decompress_jobs;
   AsyncCompressor *async_compressor;
@@ -13,6 +13,7 @@
 
 #include "include/stringify.h"
 #include "common/bloom_filter.hpp"
+#include "common/Clock.h"
 
 TEST(BloomFilter, Basic) {
   bloom_filter bf(10, .1, 1);
@@ -303,3 +304,207 @@ TEST(BloomFilter, Assignement) {
   ASSERT_EQ(2U, bf1.element_count());
   ASSERT_EQ(1U, bf2.element_count());
 }
+
+TEST(BloomFilter, Batch) {
+  std::vector<uint32_t> vals;
+  for (int i = 0; i < 1000; ++i)
+    vals.push_back(i * 732);
+
+  bloom_filter a(500, .01, 1), b(500, .01, 1);
+  for (int i = 0; i < 500; ++i)
+    a.insert(vals[i]);
+  b.insert_batch(&vals[0], 500);
+  ASSERT_EQ(500U, b.element_count());
+  ASSERT_TRUE(std::equal(a.table(), a.table() + a.size() / 8, b.table()));
+
+  compressible_bloom_filter c(500, .01, 1);
+  c.insert_batch(&vals[0], 500);
+  c.compress(.5);
+
+  blocked_bloom_filter d(500, .01, 1);
+  d.insert_batch(&vals[0], 500);
+
+  bool r[1000];
+  size_t n = b.contains_batch(&vals[0], vals.size(), r);
+  size_t cn = c.contains_batch(&vals[0], vals.size(), NULL);
+  size_t dn = d.contains_batch(&vals[0], vals.size(), NULL);
+  size_t want = 0, cwant = 0, dwant = 0;
+  for (unsigned i = 0; i < vals.size(); ++i) {
+    ASSERT_EQ(b.contains(vals[i]), r[i]);
+    want += r[i];
+    cwant += c.contains(vals[i]);
+    dwant += d.contains(vals[i]);
+  }
+  ASSERT_EQ(want, n);
+  ASSERT_EQ(cwant, cn);
+  ASSERT_EQ(dwant, dn);
+  ASSERT_LE(500U, n);
+  ASSERT_LE(500U, cn);
+  ASSERT_LE(500U, dn);
+}
+
+TEST(BloomFilter, CompressFold) {
+  for (int div = 2; div < 10; div++) {
+    compressible_bloom_filter bf(1000, .01, 1);
+    for (int n = 0; n < 500; n++)
+      bf.insert(n * 732);
+    size_t before = bf.size() / 8;
+    std::vector<unsigned char> want(bf.table(), bf.table() + before);
+
+    ASSERT_TRUE(bf.compress(1.0 / div));
+    size_t after = bf.size() / 8;
+    for (size_t i = after; i < before; ++i)
+      want[i % after] |= want[i];
+    want.resize(after);
+    ASSERT_TRUE(std::equal(want.begin(), want.end(), bf.table()));
+    for (int n = 0; n < 500; n++)
+      ASSERT_TRUE(bf.contains(n * 732));
+  }
+}
+
+TEST(BlockedBloomFilter, Basic) {
+  blocked_bloom_filter bf(10, .1, 1);
+  bf.insert("foo");
+  bf.insert("bar");
+
+  ASSERT_TRUE(bf.contains("foo"));
+  ASSERT_TRUE(bf.contains("bar"));
+
+  ASSERT_EQ(2U, bf.element_count());
+
+  bufferlist bl;
+  ::encode(bf, bl);
+  blocked_bloom_filter bf2;
+  bufferlist::iterator p = bl.begin();
+  ::decode(bf2, p);
+  ASSERT_TRUE(bf2.contains("foo"));
+  ASSERT_TRUE(bf2.contains("bar"));
+  ASSERT_EQ(2U, bf2.element_count());
+  ASSERT_EQ(bf.density(), bf2.density());
+
+  blocked_bloom_filter bf3;
+  bf3 = bf2;
+  bf2.clear();
+  ASSERT_FALSE(bf2.contains("foo"));
+  ASSERT_TRUE(bf3.contains("foo"));
+}
+
+TEST(BlockedBloomFilter, Empty) {
+  blocked_bloom_filter bf;
+  for (int i=0; i<100; ++i) {
+    ASSERT_FALSE(bf.contains(i));
+    ASSERT_FALSE(bf.contains(stringify(i)));
+  }
+}
+
+TEST(BlockedBloomFilter, Sweep) {
+  std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+  std::cout.precision(5);
+  std::cout << "# max\tfpp\tactual\tactual_int\tsize\tB/insert\tdensity" << std::endl;
+  for (int ex = 3; ex < 14; ex += 2) {
+    for (float fpp = .001; fpp < .5; fpp *= 4.0) {
+      int max = 2 << ex;
+      blocked_bloom_filter bf(max, fpp, 1), bfi(max, fpp, 1);
+      for (int n = 0; n < max; n++) {
+	bf.insert("ok" + stringify(n));
+	bfi.insert(n);  // consecutive ints are fine here
+      }
+      for (int n = 0; n < max; n++) {
+	ASSERT_TRUE(bf.contains("ok" + stringify(n)));
+	ASSERT_TRUE(bfi.contains(n));
+      }
+
+      int test = max * 100;
+      int hit = 0, hiti = 0;
+      for (int n = 0; n < test; n++) {
+	if (bf.contains("asdf" + stringify(n)))
+	  hit++;
+	if (bfi.contains(100000 + n))
+	  hiti++;
+      }
+      double actual = (double)hit / (double)test;
+      double actual_int = (double)hiti / (double)test;
+
+      bufferlist bl;
+      ::encode(bf, bl);
+      double byte_per_insert = (double)bl.length() / (double)max;
+
+      std::cout << max << "\t" << fpp << "\t" << actual << "\t" << actual_int
+		<< "\t" << bl.length() << "\t" << byte_per_insert
+		<< "\t" << bf.density() << std::endl;
+      ASSERT_TRUE(actual < fpp * 2);
+      ASSERT_TRUE(actual_int < fpp * 2);
+    }
+  }
+}
+
+// not a pass/fail test: compare insert and lookup rates and the
+// resulting fpp of the three filters over the same values
+TEST(BloomFilter, Speed) {
+  std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+  std::cout.precision(5);
+  const int max = 1 << 20;
+  const double fpp = .01;
+  std::vector<uint32_t> in, out;
+  for (int i = 0; i < max; ++i) {
+    // bloom_filter wants well mixed values
+    in.push_back(i * 2654435761u);
+    out.push_back((max + i) * 2654435761u);
+  }
+
+  std::cout << "# filter\tinsert/s\tcontains/s\tbatch ins/s\tbatch con/s\tfpp\tsize" << std::endl;
+  for (int which = 0; which < 3; ++which) {
+    bloom_filter bf(max, fpp, 1), bfb(max, fpp, 1);
+    compressible_bloom_filter cbf(max, fpp, 1), cbfb(max, fpp, 1);
+    blocked_bloom_filter kbf(max, fpp, 1), kbfb(max, fpp, 1);
+    const char *name[] = { "bloom", "compressible", "blocked" };
+
+    utime_t start = ceph_clock_now(NULL);
+    for (int i = 0; i < max; ++i) {
+      switch (which) {
+      case 0: bf.insert(in[i]); break;
+      case 1: cbf.insert(in[i]); break;
+      case 2: kbf.insert(in[i]); break;
+      }
+    }
+    double insert_t = ceph_clock_now(NULL) - start;
+
+    start = ceph_clock_now(NULL);
+    int hit = 0;
+    for (int i = 0; i < max; ++i) {
+      switch (which) {
+      case 0: hit += bf.contains(out[i]); break;
+      case 1: hit += cbf.contains(out[i]); break;
+      case 2: hit += kbf.contains(out[i]); break;
+      }
+    }
+    double contains_t = ceph_clock_now(NULL) - start;
+
+    start = ceph_clock_now(NULL);
+    switch (which) {
+    case 0: bfb.insert_batch(&in[0], max); break;
+    case 1: cbfb.insert_batch(&in[0], max); break;
+    case 2: kbfb.insert_batch(&in[0], max); break;
+    }
+    double batch_insert_t = ceph_clock_now(NULL) - start;
+
+    start = ceph_clock_now(NULL);
+    size_t bhit = 0;
+    switch (which) {
+    case 0: bhit = bfb.contains_batch(&out[0], max, NULL); break;
+    case 1: bhit = cbfb.contains_batch(&out[0], max, NULL); break;
+    case 2: bhit = kbfb.contains_batch(&out[0], max, NULL); break;
+    }
+    double batch_contains_t = ceph_clock_now(NULL) - start;
+    ASSERT_EQ((size_t)hit, bhit);
+
+    size_t size = which == 2 ? kbf.size() : bf.size();
+    std::cout << name[which]
+	      << "\t" << (int)(max / insert_t)
+	      << "\t" << (int)(max / contains_t)
+	      << "\t" << (int)(max / batch_insert_t)
+	      << "\t" << (int)(max / batch_contains_t)
+	      << "\t" << (double)hit / max
+	      << "\t" << size / 8 << std::endl;
+  }
+}
@@ -0,0 +1,103 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <boost/scoped_ptr.hpp>
+#include <gtest/gtest.h>
+#include "common/ceph_argparse.h"
+#include "compressor/Compressor.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+
+class CompressorTest : public ::testing::TestWithParam<const char*> {
+ public:
+  boost::scoped_ptr<Compressor> compressor;
+
+  virtual void SetUp() {
+    compressor.reset(Compressor::create(g_ceph_context, GetParam()));
+    ASSERT_TRUE(compressor.get() != NULL);
+    ASSERT_EQ(string(GetParam()), compressor->get_type());
+  }
+
+  // compressible text, in pieces of assorted sizes
+  void generate(bufferlist &bl, unsigned len) {
+    unsigned n = 0;
+    while (bl.length() < len) {
+      string s;
+      for (unsigned i = 0; i < n % 5000 + 1; ++i)
+	s += stringify(n + i) + " ";
+      bl.append(s);
+      ++n;
+    }
+  }
+};
+
+TEST_P(CompressorTest, RoundTrip) {
+  unsigned sizes[] = { 100, 65536, 1 << 22 };
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    bufferlist raw, compressed, out;
+    generate(raw, sizes[i]);
+    ASSERT_EQ(0, compressor->compress(raw, compressed));
+    if (raw.length() > 1000)
+      ASSERT_LT(compressed.length(), raw.length());
+    ASSERT_EQ(0, compressor->decompress(compressed, out));
+    ASSERT_TRUE(raw.contents_equal(out));
+  }
+}
+
+TEST_P(CompressorTest, Fragmented) {
+  bufferlist raw, compressed, out;
+  generate(raw, 100000);
+  ASSERT_EQ(0, compressor->compress(raw, compressed));
+  // hand decompress() its input in small pieces
+  bufferlist split;
+  for (unsigned off = 0; off < compressed.length(); off += 7) {
+    bufferlist t;
+    t.substr_of(compressed, off, MIN(7u, compressed.length() - off));
+    t.rebuild();
+    split.claim_append(t);
+  }
+  ASSERT_EQ(0, compressor->decompress(split, out));
+  ASSERT_TRUE(raw.contents_equal(out));
+}
+
+TEST_P(CompressorTest, Corrupt) {
+  bufferlist raw, compressed, out;
+  generate(raw, 100000);
+  ASSERT_EQ(0, compressor->compress(raw, compressed));
+  bufferlist truncated;
+  truncated.substr_of(compressed, 0, compressed.length() / 2);
+  int r = compressor->decompress(truncated, out);
+  ASSERT_TRUE(r < 0 || !raw.contents_equal(out));
+}
+
+INSTANTIATE_TEST_CASE_P(
+  Compressor,
+  CompressorTest,
+  ::testing::Values(
+    "snappy",
+    "zlib"));
+
+TEST(Compressor, Unknown) {
+  ASSERT_TRUE(Compressor::create(g_ceph_context, "nope") == NULL);
+}
+
+int main(int argc, char **argv) {
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
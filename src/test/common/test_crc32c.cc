@@ -263,3 +263,31 @@ TEST(Crc32c, RangeNull) {
     ASSERT_EQ(crc, *check);
   }
 }
+
+TEST(Crc32c, Multi) {
+  const unsigned n = 7;
+  const unsigned max_len = 1000;
+  unsigned char *b[n];
+  for (unsigned i = 0; i < n; i++) {
+    b[i] = (unsigned char *)malloc(max_len);
+    for (unsigned j = 0; j < max_len; j++)
+      b[i][j] = rand();
+  }
+  // unequal, unaligned and null buffers, some in groups of three
+  for (unsigned len = 0; len < max_len; len += 37) {
+    uint32_t crcs[n], expected[n];
+    unsigned char const *data[n];
+    unsigned lengths[n];
+    for (unsigned i = 0; i < n; i++) {
+      crcs[i] = expected[i] = i * 12345;
+      data[i] = (i == 5) ? NULL : b[i] + i % 3;
+      lengths[i] = len - (len ? i % 3 : 0);
+      expected[i] = ceph_crc32c(expected[i], data[i], lengths[i]);
+    }
+    ceph_crc32c_multi(n, crcs, data, lengths);
+    for (unsigned i = 0; i < n; i++)
+      ASSERT_EQ(expected[i], crcs[i]);
+  }
+  for (unsigned i = 0; i < n; i++)
+    free(b[i]);
+}
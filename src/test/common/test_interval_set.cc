@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include "include/compact_map.h"
+#include "include/compact_set.h"
+#include "include/flat_map.h"
+#include "include/interval_set.h"
+
+template <typename S>
+class IntervalSetTest : public ::testing::Test {};
+
+typedef ::testing::Types<
+  interval_set<uint64_t>,
+  interval_set<uint64_t, flat_map<uint64_t,uint64_t> > > IntervalSetTypes;
+TYPED_TEST_CASE(IntervalSetTest, IntervalSetTypes);
+
+TYPED_TEST(IntervalSetTest, InsertErase) {
+  TypeParam s;
+  s.insert(10, 10);
+  s.insert(30, 10);
+  s.insert(20, 5);        // joins the first
+  s.insert(25, 5);        // joins both
+  ASSERT_EQ(1, s.num_intervals());
+  ASSERT_EQ(30, s.size());
+  s.insert(5, 5);         // front
+  ASSERT_EQ(1, s.num_intervals());
+  ASSERT_EQ(5u, s.range_start());
+  ASSERT_EQ(40u, s.range_end());
+  s.erase(15, 10);
+  ASSERT_EQ(2, s.num_intervals());
+  ASSERT_TRUE(s.contains(5, 10));
+  ASSERT_FALSE(s.contains(15));
+  ASSERT_TRUE(s.contains(25, 15));
+  ASSERT_EQ(25u, s.start_after(20));
+  s.erase(5, 10);
+  s.erase(25, 15);
+  ASSERT_TRUE(s.empty());
+  ASSERT_EQ(0, s.size());
+}
+
+TYPED_TEST(IntervalSetTest, SetOps) {
+  TypeParam a, b, i, u;
+  for (uint64_t x = 0; x < 100; x += 10)
+    a.insert(x, 5);
+  for (uint64_t x = 3; x < 100; x += 20)
+    b.insert(x, 10);
+  i.intersection_of(a, b);
+  for (uint64_t x = 0; x < 100; x++)
+    ASSERT_EQ(a.contains(x) && b.contains(x), i.contains(x));
+  u.union_of(a, b);
+  for (uint64_t x = 0; x < 100; x++)
+    ASSERT_EQ(a.contains(x) || b.contains(x), u.contains(x));
+  ASSERT_TRUE(i.subset_of(a));
+  ASSERT_TRUE(a.subset_of(u));
+  u.subtract(a);
+  for (uint64_t x = 0; x < 100; x++)
+    ASSERT_EQ(b.contains(x) && !a.contains(x), u.contains(x));
+
+  TypeParam span;
+  span.span_of(a, 2, 6);
+  ASSERT_EQ(2, span.num_intervals());
+  ASSERT_TRUE(span.contains(2, 3));
+  ASSERT_TRUE(span.contains(10, 3));
+}
+
+TYPED_TEST(IntervalSetTest, Encode) {
+  TypeParam a, b;
+  a.insert(1, 2);
+  a.insert(100, 5);
+  bufferlist bl;
+  ::encode(a, bl);
+  bufferlist::iterator p = bl.begin();
+  ::decode(b, p);
+  ASSERT_TRUE(a == b);
+  ASSERT_EQ(7, b.size());
+
+  // same bytes whatever the container
+  interval_set<uint64_t> m;
+  p = bl.begin();
+  ::decode(m, p);
+  ASSERT_EQ(2, m.num_intervals());
+  bufferlist bl2;
+  ::encode(m, bl2);
+  ASSERT_TRUE(bl.contents_equal(bl2));
+}
+
+TEST(FlatMap, Basic) {
+  flat_map<int, int> m;
+  m[3] = 30;
+  m[1] = 10;
+  m[2] = 20;
+  ASSERT_EQ(3u, m.size());
+  ASSERT_EQ(1, m.begin()->first);
+  ASSERT_TRUE(m.insert(std::make_pair(4, 40)).second);
+  ASSERT_FALSE(m.insert(std::make_pair(4, 41)).second);
+  ASSERT_EQ(40, m[4]);
+  ASSERT_EQ(1u, m.erase(2));
+  ASSERT_EQ(0u, m.erase(2));
+  ASSERT_TRUE(m.find(2) == m.end());
+  ASSERT_EQ(3, m.lower_bound(2)->first);
+  ASSERT_EQ(4, m.upper_bound(3)->first);
+
+  flat_set<int> s;
+  s.insert(5);
+  s.insert(1);
+  ASSERT_FALSE(s.insert(5).second);
+  ASSERT_EQ(1, *s.begin());
+  ASSERT_EQ(1u, s.count(5));
+}
+
+TEST(CompactFlat, Basic) {
+  compact_flat_map<int, int> m;
+  ASSERT_TRUE(m.empty());
+  m[2] = 20;
+  m[1] = 10;
+  ASSERT_EQ(2u, m.size());
+  ASSERT_EQ(1, m.begin()->first);
+  ASSERT_EQ(20, m.find(2)->second);
+  m.erase(1);
+  m.erase(2);
+  ASSERT_TRUE(m.empty());
+
+  compact_flat_set<int> s;
+  s.insert(3);
+  s.insert(2);
+  ASSERT_EQ(2, *s.begin());
+  bufferlist bl;
+  ::encode(s, bl);
+  compact_set<int> t;
+  bufferlist::iterator p = bl.begin();
+  ::decode(t, p);
+  ASSERT_EQ(2u, t.size());
+}
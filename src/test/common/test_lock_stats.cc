@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "common/lock_stats.h"
+#include "common/Mutex.h"
+#include "common/RWLock.h"
+#include "common/Thread.h"
+
+#include <unistd.h>
+
+class LockHolder : public Thread {
+public:
+  Mutex &lock;
+  bool locked;
+  LockHolder(Mutex &l) : lock(l), locked(false) {}
+  void *entry() {
+    lock.Lock();
+    locked = true;
+    usleep(100000);
+    lock.Unlock();
+    return NULL;
+  }
+};
+
+TEST(LockStats, Mutex) {
+  g_lock_stats = 1;
+  Mutex m("LockStats::Mutex::m");
+  for (int i = 0; i < 10; ++i) {
+    m.Lock();
+    m.Unlock();
+  }
+  lock_stat_t *s = lock_stats_get("LockStats::Mutex::m");
+  EXPECT_EQ(10u, s->sampled.read());
+  EXPECT_EQ(10u, s->held.read());
+  EXPECT_EQ(0u, s->contended.read());
+
+  LockHolder t(m);
+  t.create();
+  while (!t.locked)
+    usleep(1000);
+  m.Lock();
+  m.Unlock();
+  t.join();
+  EXPECT_EQ(1u, s->contended.read());
+  EXPECT_LE(10000000u, s->wait_ns.read());  // waited (most of) 100ms
+
+  lock_stats_reset();
+  EXPECT_EQ(0u, s->sampled.read());
+  g_lock_stats = 0;
+}
+
+TEST(LockStats, Sampling) {
+  g_lock_stats = 4;
+  Mutex m("LockStats::Sampling::m");
+  for (int i = 0; i < 40; ++i) {
+    m.Lock();
+    m.Unlock();
+  }
+  EXPECT_EQ(10u, lock_stats_get("LockStats::Sampling::m")->sampled.read());
+
+  g_lock_stats = 0;
+  for (int i = 0; i < 40; ++i) {
+    m.Lock();
+    m.Unlock();
+  }
+  EXPECT_EQ(10u, lock_stats_get("LockStats::Sampling::m")->sampled.read());
+}
+
+TEST(LockStats, RWLock) {
+  g_lock_stats = 1;
+  RWLock l("LockStats::RWLock::l");
+  l.get_read();
+  l.get_read();
+  l.unlock();
+  l.unlock();
+  l.get_write();
+  l.unlock();
+  lock_stat_t *s = lock_stats_get("LockStats::RWLock::l");
+  EXPECT_EQ(3u, s->sampled.read());
+  EXPECT_EQ(1u, s->held.read());  // only writers are hold-timed
+  g_lock_stats = 0;
+}
@@ -0,0 +1,135 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "common/MClockQueue.h"
+
+#include <vector>
+
+using std::vector;
+using std::list;
+
+// items are class * 1000 + sequence
+typedef unsigned Item;
+typedef int Klass;
+
+static unsigned item_class(const Item &i)
+{
+  return i / 1000;
+}
+
+class TestQueue : public MClockQueue<Item, Klass> {
+public:
+  double t;
+  TestQueue(const vector<ClassInfo> &info)
+    : MClockQueue<Item, Klass>(info, item_class), t(100) {}
+protected:
+  double now() const {
+    return t;
+  }
+};
+
+typedef TestQueue::ClassInfo CI;
+
+TEST(MClockQueue, strict_and_fifo) {
+  vector<CI> info(1, CI(0, 1, 0));
+  TestQueue q(info);
+  EXPECT_TRUE(q.empty());
+  for (unsigned i = 0; i < 10; ++i)
+    q.enqueue(Klass(1), 0, 0, Item(i));
+  q.enqueue_strict(Klass(1), 10, Item(100));
+  q.enqueue_strict(Klass(1), 20, Item(200));
+  q.enqueue_front(Klass(1), 0, 0, Item(50));
+  EXPECT_EQ(13u, q.length());
+
+  EXPECT_EQ(200u, q.dequeue());
+  EXPECT_EQ(100u, q.dequeue());
+  EXPECT_EQ(50u, q.dequeue());
+  for (unsigned i = 0; i < 10; ++i)
+    EXPECT_EQ(i, q.dequeue());
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(MClockQueue, weight) {
+  vector<CI> info;
+  info.push_back(CI(0, 1, 0));
+  info.push_back(CI(0, 3, 0));
+  TestQueue q(info);
+  for (unsigned i = 0; i < 400; ++i) {
+    q.enqueue(Klass(1), 0, 0, Item(i));
+    q.enqueue(Klass(1), 0, 0, Item(1000 + i));
+  }
+  unsigned served[2] = {0, 0};
+  for (unsigned i = 0; i < 400; ++i)
+    served[item_class(q.dequeue())]++;
+  EXPECT_NEAR(100, served[0], 1);
+  EXPECT_NEAR(300, served[1], 1);
+}
+
+TEST(MClockQueue, reservation) {
+  vector<CI> info;
+  info.push_back(CI(1, 0.001, 0));  // 1 op/sec reserved, next to no weight
+  info.push_back(CI(0, 1000, 0));
+  TestQueue q(info);
+  for (unsigned i = 0; i < 10; ++i) {
+    q.enqueue(Klass(1), 0, 0, Item(i));
+    q.enqueue(Klass(1), 0, 0, Item(1000 + i));
+  }
+  // one reserved op now, the next in a second
+  EXPECT_EQ(0u, item_class(q.dequeue()));
+  EXPECT_EQ(1u, item_class(q.dequeue()));
+  EXPECT_EQ(1u, item_class(q.dequeue()));
+  q.t = 101;
+  EXPECT_EQ(0u, item_class(q.dequeue()));
+  EXPECT_EQ(1u, item_class(q.dequeue()));
+  q.t = 102;
+  EXPECT_EQ(0u, item_class(q.dequeue()));
+  EXPECT_EQ(1u, item_class(q.dequeue()));
+}
+
+TEST(MClockQueue, limit) {
+  vector<CI> info;
+  info.push_back(CI(0, 1000, 1));  // heavily weighted, but 1 op/sec
+  info.push_back(CI(0, 1, 0));
+  TestQueue q(info);
+  for (unsigned i = 0; i < 3; ++i) {
+    q.enqueue(Klass(1), 0, 0, Item(i));
+    q.enqueue(Klass(1), 0, 0, Item(1000 + i));
+  }
+  EXPECT_EQ(0u, q.dequeue());
+  for (unsigned i = 0; i < 3; ++i)
+    EXPECT_EQ(1000 + i, q.dequeue());
+  // nothing else left: the limit does not idle the queue
+  for (unsigned i = 1; i < 3; ++i)
+    EXPECT_EQ(i, q.dequeue());
+  EXPECT_TRUE(q.empty());
+}
+
+struct Odd {
+  bool operator()(Item i) const {
+    return i % 2;
+  }
+};
+
+TEST(MClockQueue, remove) {
+  vector<CI> info(2, CI(0, 1, 0));
+  TestQueue q(info);
+  for (unsigned i = 0; i < 10; ++i) {
+    q.enqueue(Klass(i % 3), 0, 0, Item(i));
+    q.enqueue_strict(Klass(i % 3), 0, Item(1000 + i));
+  }
+  list<Item> removed;
+  q.remove_by_filter(Odd(), &removed);
+  EXPECT_EQ(10u, removed.size());
+  EXPECT_EQ(10u, q.length());
+  for (list<Item>::iterator i = removed.begin(); i != removed.end(); ++i)
+    EXPECT_TRUE(*i % 2);
+
+  removed.clear();
+  q.remove_by_class(Klass(0), &removed);
+  // even items with i % 3 == 0: 0 and 6, once in each queue
+  EXPECT_EQ(4u, removed.size());
+  EXPECT_EQ(6u, q.length());
+  while (!q.empty())
+    EXPECT_NE(0, (int)(q.dequeue() % 1000) % 3);
+}
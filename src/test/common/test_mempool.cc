@@ -0,0 +1,108 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "common/Formatter.h"
+#include "include/mempool.h"
+
+static int64_t bytes()
+{
+  return mempool::get_pool(mempool::mempool_unittest).allocated_bytes();
+}
+
+static int64_t items()
+{
+  return mempool::get_pool(mempool::mempool_unittest).allocated_items();
+}
+
+TEST(Mempool, Containers) {
+  int64_t b = bytes(), i = items();
+  {
+    mempool::unittest::vector<uint64_t> v;
+    v.reserve(100);
+    ASSERT_EQ(b + 800, bytes());
+    ASSERT_EQ(i + 100, items());
+    mempool::unittest::map<int, int> m;
+    for (int j = 0; j < 10; ++j)
+      m[j] = j;
+    ASSERT_EQ(i + 110, items());
+    mempool::unittest::list<int> l(5);
+    mempool::unittest::unordered_map<int, int> u;
+    u[1] = 1;
+    ASSERT_LT(b + 800, bytes());
+  }
+  ASSERT_EQ(b, bytes());
+  ASSERT_EQ(i, items());
+}
+
+struct Obj {
+  MEMPOOL_CLASS_HELPERS(unittest);
+  char buf[100];
+};
+
+TEST(Mempool, Class) {
+  int64_t b = bytes(), i = items();
+  Obj *o = new Obj;
+  ASSERT_EQ(b + (int64_t)sizeof(Obj), bytes());
+  ASSERT_EQ(i + 1, items());
+  delete o;
+  ASSERT_EQ(b, bytes());
+  ASSERT_EQ(i, items());
+}
+
+TEST(Mempool, Threads) {
+  int64_t b = bytes();
+  // free on other threads than the allocation
+  std::vector<Obj*> objs(1000);
+  std::thread a([&]() {
+      for (size_t j = 0; j < objs.size(); ++j)
+	objs[j] = new Obj;
+    });
+  a.join();
+  std::thread d([&]() {
+      for (size_t j = 0; j < objs.size(); ++j)
+	delete objs[j];
+    });
+  d.join();
+  ASSERT_EQ(b, bytes());
+}
+
+TEST(Mempool, Budgets) {
+  std::string err;
+  mempool::pool_t &p = mempool::get_pool(mempool::mempool_unittest);
+  ASSERT_EQ(0, mempool::set_budgets("unittest=1K, osdmap=10M", &err));
+  ASSERT_EQ(1024u, p.get_budget());
+  ASSERT_EQ(10u << 20,
+	    mempool::get_pool(mempool::mempool_osdmap).get_budget());
+  ASSERT_FALSE(p.over_budget());
+  {
+    mempool::unittest::vector<char> v(2048);
+    ASSERT_TRUE(p.over_budget());
+  }
+  ASSERT_FALSE(p.over_budget());
+  ASSERT_EQ(-EINVAL, mempool::set_budgets("nosuchpool=1", &err));
+  ASSERT_EQ(-EINVAL, mempool::set_budgets("unittest=lots", &err));
+  ASSERT_EQ(0, mempool::set_budgets("", &err));
+  ASSERT_EQ(0u, p.get_budget());
+  ASSERT_EQ(0u, mempool::get_pool(mempool::mempool_osdmap).get_budget());
+}
+
+TEST(Mempool, Dump) {
+  ceph::JSONFormatter f;
+  mempool::dump(&f);
+  std::ostringstream ss;
+  f.flush(ss);
+  ASSERT_NE(std::string::npos, ss.str().find("\"osd_pglog\""));
+  ASSERT_NE(std::string::npos, ss.str().find("\"buffer_anon\""));
+  ASSERT_NE(std::string::npos, ss.str().find("\"total\""));
+}
@@ -0,0 +1,91 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "common/RWLock.h"
+#include "common/Thread.h"
+
+class Reader : public Thread {
+public:
+  RWLock &lock;
+  bool got;
+  Reader(RWLock &l) : lock(l), got(false) {}
+  void *entry() {
+    got = lock.try_get_read();
+    if (got)
+      lock.unlock();
+    return NULL;
+  }
+};
+
+class Counter : public Thread {
+public:
+  RWLock &lock;
+  int *value;
+  Counter(RWLock &l, int *v) : lock(l), value(v) {}
+  void *entry() {
+    for (int i = 0; i < 10000; ++i) {
+      if (i % 10) {
+	RWLock::RLocker l(lock);
+	EXPECT_TRUE(lock.is_locked());
+      } else {
+	RWLock::WLocker l(lock);
+	++*value;
+      }
+    }
+    return NULL;
+  }
+};
+
+TEST(RWLock, Sharded) {
+  RWLock l("RWLock::Sharded::l", true, 4);
+  EXPECT_FALSE(l.is_locked());
+
+  l.get_read();
+  EXPECT_TRUE(l.is_locked());
+  EXPECT_FALSE(l.is_wlocked());
+  EXPECT_FALSE(l.try_get_write());
+  // readers on other shards get in
+  for (int i = 0; i < 8; ++i) {
+    Reader r(l);
+    r.create();
+    r.join();
+    EXPECT_TRUE(r.got);
+  }
+  l.unlock();
+  EXPECT_FALSE(l.is_locked());
+
+  l.get_write();
+  EXPECT_TRUE(l.is_wlocked());
+  for (int i = 0; i < 8; ++i) {
+    Reader r(l);
+    r.create();
+    r.join();
+    EXPECT_FALSE(r.got);
+  }
+  l.unlock();
+  EXPECT_FALSE(l.is_locked());
+
+  RWLock::Context lc(l, RWLock::Context::Untaken);
+  lc.get_read();
+  lc.promote();
+  EXPECT_TRUE(l.is_wlocked());
+  lc.unlock();
+  EXPECT_FALSE(l.is_locked());
+}
+
+TEST(RWLock, ShardedWriters) {
+  RWLock l("RWLock::ShardedWriters::l", true, 4);
+  int value = 0;
+  Counter *threads[8];
+  for (int i = 0; i < 8; ++i) {
+    threads[i] = new Counter(l, &value);
+    threads[i]->create();
+  }
+  for (int i = 0; i < 8; ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  EXPECT_EQ(8 * 1000, value);
+  EXPECT_FALSE(l.is_locked());
+}
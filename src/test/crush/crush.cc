@@ -17,6 +17,7 @@
 #include "global/global_context.h"
 
 #include "crush/CrushWrapper.h"
+#include "crush/CrushTester.h"
 #include "osd/osd_types.h"
 
 #include <set>
@@ -510,6 +511,156 @@ TEST(CRUSH, straw2_stddev)
   }
 }
 
+TEST(CRUSH, straw2_batch) {
+  // more items than straw2 hashes in one chunk, and not a multiple of
+  // the vector width; do_rule_batch must agree with do_rule
+  const int n = 53;
+  CrushWrapper *c = new CrushWrapper;
+  c->set_type_name(1, "root");
+  c->set_type_name(0, "osd");
+  int items[n], weights[n];
+  for (int i = 0; i < n; ++i) {
+    items[i] = i;
+    weights[i] = (i % 7) ? 0x10000 * (1 + i % 3) : 0;
+  }
+  c->set_max_devices(n);
+  int root;
+  crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+				      CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+				      1, n, items, weights);
+  crush_add_bucket(c->get_crush_map(), 0, b, &root);
+  c->set_item_name(root, "root");
+  int ruleset = c->add_simple_ruleset("rule", "root", "osd",
+				       "firstn", pg_pool_t::TYPE_REPLICATED);
+
+  vector<__u32> reweight(n, 0x10000);
+  vector<int> xs;
+  for (int x = 0; x < 1000; ++x)
+    xs.push_back(x);
+  vector<vector<int> > batch;
+  c->do_rule_batch(ruleset, xs, batch, 3, reweight);
+  ASSERT_EQ(xs.size(), batch.size());
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    vector<int> out;
+    c->do_rule(ruleset, xs[i], out, 3, reweight);
+    ASSERT_EQ(out, batch[i]);
+    ASSERT_EQ(3u, out.size());
+    for (unsigned j = 0; j < out.size(); ++j)
+      ASSERT_NE(0, weights[out[j]]);
+  }
+  delete c;
+}
+
+TEST(CRUSH, straw2_recips) {
+  // the precomputed reciprocals must pick exactly what dividing does
+  const int n = 20;
+  CrushWrapper *c = new CrushWrapper;
+  c->set_type_name(1, "root");
+  c->set_type_name(0, "osd");
+  int items[n], weights[n];
+  for (int i = 0; i < n; ++i) {
+    items[i] = i;
+    weights[i] = 0x10000 * (1 + i % 4) + 0x1234 * i + 1;
+  }
+  c->set_max_devices(n);
+  int root;
+  crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+				      CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+				      1, n, items, weights);
+  crush_add_bucket(c->get_crush_map(), 0, b, &root);
+  c->set_item_name(root, "root");
+  int ruleset = c->add_simple_ruleset("rule", "root", "osd",
+				       "firstn", pg_pool_t::TYPE_REPLICATED);
+
+  vector<__u32> reweight(n, 0x10000);
+  vector<vector<int> > with(10000);
+  for (int x = 0; x < 10000; ++x)
+    c->do_rule(ruleset, x, with[x], 3, reweight);
+
+  crush_bucket_straw2 *sb = (crush_bucket_straw2 *)b;
+  free(sb->item_recips);
+  sb->item_recips = NULL;
+  for (int x = 0; x < 10000; ++x) {
+    vector<int> out;
+    c->do_rule(ruleset, x, out, 3, reweight);
+    ASSERT_EQ(with[x], out);
+  }
+  delete c;
+}
+
+TEST(CRUSH, tester_threads) {
+  CrushWrapper *c = build_indep_map(g_ceph_context, 2, 3, 3);
+  ostringstream one, many;
+  {
+    CrushTester t(*c, one);
+    t.set_num_rep(3);
+    t.set_min_x(0);
+    t.set_max_x(9999);
+    t.set_output_mappings(true);
+    ASSERT_EQ(0, t.test());
+  }
+  {
+    CrushTester t(*c, many);
+    t.set_num_rep(3);
+    t.set_min_x(0);
+    t.set_max_x(9999);
+    t.set_output_mappings(true);
+    t.set_threads(4);
+    ASSERT_EQ(0, t.test());
+  }
+  ASSERT_EQ(one.str(), many.str());
+  delete c;
+}
+
+TEST(CRUSH, tester_compare) {
+  CrushWrapper *c = build_indep_map(g_ceph_context, 2, 3, 3);
+  CrushWrapper *d = build_indep_map(g_ceph_context, 2, 3, 3);
+  {
+    ostringstream out;
+    CrushTester t(*c, cerr);
+    t.set_num_rep(3);
+    t.set_max_x(4095);
+    t.set_min_x(0);
+    t.set_threads(4);
+    ASSERT_EQ(0, t.compare(*d, "host", NULL, out));
+    ASSERT_NE(string::npos,
+	      out.str().find("0/4096 mappings changed, 0 replicas moved"));
+  }
+
+  // emptying osd.0 moves at least what it held
+  d->adjust_item_weightf(g_ceph_context, 0, 0);
+  vector<__u32> weight(c->get_max_devices(), 0x10000);
+  int held = 0;
+  for (int x = 0; x < 4096; ++x) {
+    vector<int> out;
+    c->do_rule(0, x, out, 3, weight);
+    if (std::find(out.begin(), out.end(), 0) != out.end())
+      ++held;
+  }
+  ASSERT_LT(0, held);
+  {
+    ostringstream out;
+    CrushTester t(*c, cerr);
+    t.set_num_rep(3);
+    t.set_max_x(4095);
+    t.set_min_x(0);
+    ASSERT_EQ(0, t.compare(*d, "host", NULL, out));
+    size_t pos = out.str().find(" mappings changed, ");
+    ASSERT_NE(string::npos, pos);
+    int moved = atoi(out.str().c_str() + pos + strlen(" mappings changed, "));
+    ASSERT_LE(held, moved);
+
+    ostringstream js;
+    Formatter *f = Formatter::create("json");
+    ASSERT_EQ(0, t.compare(*d, "host", f, js));
+    delete f;
+    ASSERT_NE(string::npos, js.str().find("\"domains\""));
+    ASSERT_NE(string::npos, js.str().find("\"host-0-0\""));
+  }
+  delete c;
+  delete d;
+}
+
 TEST(CRUSH, straw2_reweight) {
   // when we adjust the weight of an item in a straw2 bucket,
   // we should *only* see movement from or to that item, never
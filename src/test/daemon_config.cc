@@ -19,6 +19,7 @@
 #include "test/unit.h"
 
 #include <errno.h>
+#include <set>
 #include <sstream>
 #include <string>
 #include <string.h>
@@ -379,6 +380,70 @@ TEST(DaemonConfig, InvalidFloats) {
   }
 }
 
+class CountingObserver : public md_config_obs_t {
+public:
+  int calls;
+  std::set<std::string> keys;
+  bool locked;
+  CountingObserver() : calls(0), locked(false) {}
+  const char **get_tracked_conf_keys() const {
+    static const char *k[] = { "num_client", "num_osd", NULL };
+    return k;
+  }
+  void handle_conf_change(const md_config_t *conf,
+			  const std::set<std::string> &changed) {
+    ++calls;
+    keys.insert(changed.begin(), changed.end());
+    locked = conf->lock.is_locked();
+  }
+};
+
+class CountingNotifier : public md_config_t::observer_notifier_t {
+public:
+  int queued;
+  CountingNotifier() : queued(0) {}
+  void queue_observers() {
+    ++queued;
+  }
+};
+
+TEST(DaemonConfig, Observers) {
+  md_config_t *conf = g_ceph_context->_conf;
+  CountingObserver obs;
+  conf->add_observer(&obs);
+
+  // called right away, once for both keys, without the config lock
+  ASSERT_EQ(0, conf->set_val("num_client", "2"));
+  ASSERT_EQ(0, conf->set_val("num_osd", "3"));
+  conf->apply_changes(NULL);
+  ASSERT_EQ(1, obs.calls);
+  ASSERT_EQ(2u, obs.keys.size());
+  ASSERT_FALSE(obs.locked);
+
+  // with a notifier, changes wait for flush_observers() and are batched
+  CountingNotifier n;
+  conf->set_observer_notifier(&n);
+  obs.keys.clear();
+  ASSERT_EQ(0, conf->set_val("num_client", "4"));
+  conf->apply_changes(NULL);
+  std::ostringstream ss;
+  ASSERT_EQ(0, conf->injectargs("--num_osd 5", &ss));
+  ASSERT_EQ(1, obs.calls);
+  ASSERT_EQ(2, n.queued);
+  conf->flush_observers();
+  ASSERT_EQ(2, obs.calls);
+  ASSERT_EQ(2u, obs.keys.size());
+
+  // clearing the notifier makes what is still queued
+  ASSERT_EQ(0, conf->set_val("num_client", "1"));
+  conf->apply_changes(NULL);
+  ASSERT_EQ(2, obs.calls);
+  conf->set_observer_notifier(NULL);
+  ASSERT_EQ(3, obs.calls);
+
+  conf->remove_observer(&obs);
+}
+
 /*
  * Local Variables:
  * compile-command: "cd .. ; make unittest_daemon_config && ./unittest_daemon_config"
@@ -223,3 +223,75 @@ TEST(EncodingException, Macros) {
     }
   }
 }
+
+// the same fields encoded through the bufferlist and the bounded path
+struct bounded_sample_t {
+  uint64_t a;
+  uint32_t b;
+  bool c;
+  std::string d;
+
+  bounded_sample_t() : a(0), b(0), c(false) {}
+
+  void encode_bl(bufferlist& bl) const {
+    ENCODE_START(2, 1, bl);
+    ::encode(a, bl);
+    ::encode(b, bl);
+    ::encode(c, bl);
+    ::encode(d, bl);
+    ENCODE_FINISH(bl);
+  }
+  void bound_encode(size_t& s) const {
+    BOUND_ENCODE_START(s);
+    ::bound_encode(a, s);
+    ::bound_encode(b, s);
+    ::bound_encode(c, s);
+    ::bound_encode(d, s);
+  }
+  void encode(bounded_encoder& p) const {
+    ENCODE_BOUNDED_START(2, 1, p);
+    ::encode(a, p);
+    ::encode(b, p);
+    ::encode(c, p);
+    ::encode(d, p);
+    ENCODE_BOUNDED_FINISH(p);
+  }
+  void decode(bufferlist::iterator& p) {
+    DECODE_START(2, p);
+    ::decode(a, p);
+    ::decode(b, p);
+    ::decode(c, p);
+    ::decode(d, p);
+    DECODE_FINISH(p);
+  }
+};
+WRITE_CLASS_ENCODER_BOUNDED(bounded_sample_t)
+
+TEST(EncodingBounded, SameAsBufferlist) {
+  bounded_sample_t s;
+  s.a = 0x0102030405060708ull;
+  s.b = 42;
+  s.c = true;
+  s.d = "foo";
+
+  bufferlist expected, actual;
+  s.encode_bl(expected);
+  ::encode(s, actual);
+  ASSERT_TRUE(expected.contents_equal(actual));
+
+  // several in a row share the tail buffer
+  for (int i = 0; i < 100; ++i) {
+    s.d = string(i, 'x');
+    s.encode_bl(expected);
+    ::encode(s, actual);
+  }
+  ASSERT_TRUE(expected.contents_equal(actual));
+
+  bounded_sample_t t;
+  bufferlist::iterator p = actual.begin();
+  ::decode(t, p);
+  ASSERT_EQ(0x0102030405060708ull, t.a);
+  ASSERT_EQ(42u, t.b);
+  ASSERT_TRUE(t.c);
+  ASSERT_EQ("foo", t.d);
+}
@@ -13,6 +13,7 @@ TYPE(BitVector<2>)
 #include "common/bloom_filter.hpp"
 TYPE(bloom_filter)
 TYPE(compressible_bloom_filter)
+TYPE(blocked_bloom_filter)
 
 #include "common/snap_types.h"
 TYPE(SnapContext)
@@ -102,6 +103,7 @@ TYPE(ECSubReadReply)
 TYPE_NONDETERMINISTIC(ExplicitHashHitSet)
 TYPE_NONDETERMINISTIC(ExplicitObjectHitSet)
 TYPE(BloomHitSet)
+TYPE(CuckooHitSet)
 TYPE_NONDETERMINISTIC(HitSet)   // because some subclasses are
 TYPE(HitSet::Params)
 
@@ -271,6 +273,7 @@ TYPE(rgw_bucket_olh_log_entry)
 #include "cls/rgw/cls_rgw_ops.h"
 TYPE(rgw_cls_obj_prepare_op)
 TYPE(rgw_cls_obj_complete_op)
+TYPE(rgw_cls_obj_complete_ops)
 TYPE(rgw_cls_list_op)
 TYPE(rgw_cls_list_ret)
 TYPE(cls_rgw_gc_defer_entry_op)
@@ -367,6 +367,71 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, stripes)
+{
+  ErasureCodeIsaDefault Isa(tcache);
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  Isa.init(profile, &cerr);
+
+  // enough stripes for several encode groups and decode threads
+  unsigned stripe_width = Isa.get_alignment() * 4 * 128;
+  unsigned chunk_size = Isa.get_chunk_size(stripe_width);
+  const unsigned stripes = 200;
+  bufferlist in;
+  for (unsigned i = 0; i < stripes * stripe_width; i++)
+    in.append((char)(i * 29 + i / 7));
+  set<int> all;
+  for (unsigned i = 0; i < Isa.get_chunk_count(); i++)
+    all.insert(i);
+
+  map<int, bufferlist> expected;
+  map<int, uint32_t> expected_crcs;
+  for (unsigned s = 0; s < stripes; s++) {
+    bufferlist stripe;
+    stripe.substr_of(in, s * stripe_width, stripe_width);
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, Isa.encode(all, stripe, &encoded));
+    for (map<int, bufferlist>::iterator i = encoded.begin();
+	 i != encoded.end();
+	 ++i) {
+      expected_crcs[i->first] = i->second.crc32c(expected_crcs[i->first]);
+      expected[i->first].claim_append(i->second);
+    }
+  }
+
+  map<int, bufferlist> encoded;
+  map<int, uint32_t> crcs;
+  EXPECT_EQ(0, Isa.encode_stripes(all, in, stripe_width, &encoded, &crcs));
+  for (map<int, bufferlist>::iterator i = expected.begin();
+       i != expected.end();
+       ++i) {
+    EXPECT_TRUE(i->second.contents_equal(encoded[i->first]));
+    EXPECT_EQ(expected_crcs[i->first], crcs[i->first]);
+  }
+
+  // the same decoded chunks, on one thread or several, through the
+  // xor and the matrix paths
+  int lost[][2] = { { 1, -1 }, { 0, 5 }, { 2, 3 } };
+  for (unsigned threads = 1; threads <= 4; threads += 3) {
+    g_conf->set_val("erasure_code_decode_threads", stringify(threads));
+    g_conf->apply_changes(NULL);
+    for (unsigned l = 0; l < 3; l++) {
+      map<int, bufferlist> chunks = encoded;
+      for (unsigned j = 0; j < 2; j++)
+	if (lost[l][j] >= 0)
+	  chunks.erase(lost[l][j]);
+      map<int, bufferlist> decoded;
+      EXPECT_EQ(0, Isa.decode_stripes(all, chunks, chunk_size, &decoded));
+      for (set<int>::iterator i = all.begin(); i != all.end(); ++i)
+	EXPECT_TRUE(expected[*i].contents_equal(decoded[*i]));
+    }
+  }
+  g_conf->set_val("erasure_code_decode_threads", "1");
+  g_conf->apply_changes(NULL);
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache);
@@ -129,6 +129,50 @@ TYPED_TEST(ErasureCodeTest, encode_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, decode_cache)
+{
+  TypeParam jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "2";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  jerasure.init(profile, &cerr);
+
+  bufferptr in_ptr(buffer::create_page_aligned(LARGE_ENOUGH));
+  for (unsigned i = 0; i < LARGE_ENOUGH; i++)
+    in_ptr[i] = i * 7 + 3;
+  bufferlist in;
+  in.push_front(in_ptr);
+  int want_to_encode[] = { 0, 1, 2, 3 };
+  set<int> all(want_to_encode, want_to_encode + 4);
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, jerasure.encode(all, in, &encoded));
+
+  // every pattern of one or two erasures, twice: the second round
+  // only uses cached tables and must decode the same
+  uint64_t misses = 0;
+  for (int round = 0; round < 2; round++) {
+    for (int a = 0; a < 4; a++) {
+      for (int b = a; b < 4; b++) {
+	map<int, bufferlist> degraded = encoded;
+	degraded.erase(a);
+	degraded.erase(b);
+	map<int, bufferlist> decoded;
+	EXPECT_EQ(0, jerasure.decode(all, degraded, &decoded));
+	EXPECT_EQ(4u, decoded.size());
+	for (int i = 0; i < 4; i++)
+	  EXPECT_TRUE(decoded[i].contents_equal(encoded[i]))
+	    << "chunk " << i << " erasures " << a << "," << b;
+      }
+    }
+    if (round == 0)
+      misses = jerasure.decoding_tables.get_misses();
+  }
+  EXPECT_EQ(misses, jerasure.decoding_tables.get_misses());
+  EXPECT_LT(0u, jerasure.decoding_tables.get_hits());
+  EXPECT_EQ(misses, (uint64_t)jerasure.decoding_tables.size());
+}
+
 TYPED_TEST(ErasureCodeTest, minimum_to_decode)
 {
   TypeParam jerasure;
@@ -277,6 +321,60 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+TEST(ErasureCodeTest, encode_stripes)
+{
+  ErasureCodeJerasureReedSolomonVandermonde jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["w"] = "8";
+  jerasure.init(profile, &cerr);
+
+  // stripes that stay aligned back to back, and stripes that need padding
+  unsigned stripe_widths[] = { jerasure.get_alignment() * 4 * 4,
+			       jerasure.get_alignment() * 4 + 1 };
+  for (unsigned w = 0; w < 2; w++) {
+    unsigned stripe_width = stripe_widths[w];
+    const unsigned stripes = 5;
+    bufferlist in;
+    for (unsigned i = 0; i < stripes * stripe_width; i++)
+      in.append((char)(i * 13));
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < jerasure.get_chunk_count(); i++)
+      want_to_encode.insert(i);
+
+    map<int, bufferlist> expected;
+    map<int, uint32_t> expected_crcs;
+    for (unsigned s = 0; s < stripes; s++) {
+      bufferlist stripe;
+      stripe.substr_of(in, s * stripe_width, stripe_width);
+      map<int, bufferlist> encoded;
+      EXPECT_EQ(0, jerasure.encode(want_to_encode, stripe, &encoded));
+      for (map<int, bufferlist>::iterator i = encoded.begin();
+	   i != encoded.end();
+	   ++i) {
+	expected_crcs[i->first] = i->second.crc32c(
+	  expected_crcs.count(i->first) ? expected_crcs[i->first] : -1);
+	expected[i->first].claim_append(i->second);
+      }
+    }
+
+    map<int, bufferlist> encoded;
+    map<int, uint32_t> crcs;
+    for (unsigned i = 0; i < jerasure.get_chunk_count(); i++)
+      crcs[i] = -1;
+    EXPECT_EQ(0, jerasure.encode_stripes(want_to_encode, in, stripe_width,
+					 &encoded, &crcs));
+    EXPECT_EQ(expected.size(), encoded.size());
+    for (map<int, bufferlist>::iterator i = expected.begin();
+	 i != expected.end();
+	 ++i) {
+      EXPECT_TRUE(i->second.contents_equal(encoded[i->first]));
+      EXPECT_EQ(expected_crcs[i->first], crcs[i->first]);
+    }
+  }
+}
+
 TEST(ErasureCodeTest, create_ruleset)
 {
   CrushWrapper *c = new CrushWrapper;
@@ -597,6 +597,69 @@ TEST(ErasureCodeLrc, minimum_to_decode)
   }
 }
 
+TEST(ErasureCodeLrc, minimum_to_decode_with_cost)
+{
+  ErasureCodeLrc lrc(g_conf->erasure_code_dir);
+  ErasureCodeProfile profile;
+  profile["mapping"] =
+    "__DDD__DD_";
+  const char *description_string =
+    "[ "
+    "  [ \"_cDDD_cDD_\", \"\" ],"
+    "  [ \"c_DDD_____\", \"\" ],"
+    "  [ \"_____cDDD_\", \"\" ],"
+    "  [ \"_____DDDDc\", \"\" ],"
+    "]";
+  profile["layers"] = description_string;
+  EXPECT_EQ(0, lrc.init(profile, &cerr));
+  // chunk 2 is lost
+  set<int> want_to_read;
+  want_to_read.insert(2);
+  // the local group c_DDD_____ is close, the rest is far
+  {
+    map<int, int> available;
+    for (int i = 0; i < (int)lrc.get_chunk_count(); i++)
+      if (i != 2)
+	available[i] = (i == 0 || i == 3 || i == 4) ? 1 : 3;
+    set<int> minimum;
+    EXPECT_EQ(0, lrc.minimum_to_decode_with_cost(want_to_read, available,
+						 &minimum));
+    set<int> expected_minimum;
+    expected_minimum.insert(0);
+    expected_minimum.insert(3);
+    expected_minimum.insert(4);
+    EXPECT_EQ(expected_minimum, minimum);
+  }
+  // the local parity chunk is far: repair with the global layer
+  // rather than reading it
+  {
+    map<int, int> available;
+    for (int i = 0; i < (int)lrc.get_chunk_count(); i++)
+      if (i != 2)
+	available[i] = i == 0 ? 3 : 1;
+    set<int> minimum;
+    EXPECT_EQ(0, lrc.minimum_to_decode_with_cost(want_to_read, available,
+						 &minimum));
+    set<int> expected_minimum;
+    expected_minimum.insert(1);
+    expected_minimum.insert(3);
+    expected_minimum.insert(4);
+    expected_minimum.insert(6);
+    expected_minimum.insert(7);
+    expected_minimum.insert(8);
+    EXPECT_EQ(expected_minimum, minimum);
+  }
+  // not enough chunks at any cost
+  {
+    map<int, int> available;
+    available[1] = 1;
+    available[3] = 1;
+    set<int> minimum;
+    EXPECT_EQ(-EIO, lrc.minimum_to_decode_with_cost(want_to_read, available,
+						    &minimum));
+  }
+}
+
 TEST(ErasureCodeLrc, encode_decode)
 {
   ErasureCodeLrc lrc(g_conf->erasure_code_dir);
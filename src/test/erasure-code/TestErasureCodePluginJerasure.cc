@@ -72,6 +72,7 @@ TEST(ErasureCodePlugin, select)
   int arch_intel_ssse3  = ceph_arch_intel_ssse3;
   int arch_intel_sse3   = ceph_arch_intel_sse3;
   int arch_intel_sse2   = ceph_arch_intel_sse2;
+  int arch_intel_avx2   = ceph_arch_intel_avx2;
   int arch_neon		= ceph_arch_neon;
 
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
@@ -81,7 +82,7 @@ TEST(ErasureCodePlugin, select)
   profile["jerasure-name"] = "test_jerasure";
   profile["technique"] = "reed_sol_van";
 
-  // all features are available, load the SSE4 plugin
+  // all features are available, load the AVX2 plugin
   {
     ceph_arch_intel_pclmul = 1;
     ceph_arch_intel_sse42  = 1;
@@ -89,6 +90,25 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 1;
     ceph_arch_intel_sse3   = 1;
     ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 1;
+    ceph_arch_neon	   = 0;
+
+    ErasureCodeInterfaceRef erasure_code;
+    int avx2_side_effect = -666;
+    EXPECT_EQ(avx2_side_effect, instance.factory("jerasure",
+						 g_conf->erasure_code_dir,
+						 profile,
+                                                 &erasure_code, &cerr));
+  }
+  // avx2 is missing, load the SSE4 plugin
+  {
+    ceph_arch_intel_pclmul = 1;
+    ceph_arch_intel_sse42  = 1;
+    ceph_arch_intel_sse41  = 1;
+    ceph_arch_intel_ssse3  = 1;
+    ceph_arch_intel_sse3   = 1;
+    ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 0;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -106,6 +126,7 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 1;
     ceph_arch_intel_sse3   = 1;
     ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 0;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -123,6 +144,7 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 1;
     ceph_arch_intel_sse3   = 0;
     ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 0;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -140,6 +162,7 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 0;
     ceph_arch_intel_sse3   = 0;
     ceph_arch_intel_sse2   = 0;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 1;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -158,6 +181,7 @@ TEST(ErasureCodePlugin, select)
   ceph_arch_intel_ssse3  = arch_intel_ssse3;
   ceph_arch_intel_sse3   = arch_intel_sse3;
   ceph_arch_intel_sse2   = arch_intel_sse2;
+  ceph_arch_intel_avx2   = arch_intel_avx2;
   ceph_arch_neon	 = arch_neon;
 }
 
@@ -170,6 +194,7 @@ TEST(ErasureCodePlugin, sse)
     ceph_arch_intel_sse2;
   bool sse3 = ceph_arch_intel_ssse3 && ceph_arch_intel_sse3 &&
     ceph_arch_intel_sse2;
+  bool avx2 = sse4 && ceph_arch_intel_avx2;
   vector<string> sse_variants;
   sse_variants.push_back("generic");
   if (!sse3)
@@ -180,6 +205,10 @@ TEST(ErasureCodePlugin, sse)
     cerr << "SKIP sse4 plugin testing because CPU does not support it\n";
   else
     sse_variants.push_back("sse4");
+  if (!avx2)
+    cerr << "SKIP avx2 plugin testing because CPU does not support it\n";
+  else
+    sse_variants.push_back("avx2");
 
 #define LARGE_ENOUGH 2048
   bufferptr in_ptr(buffer::create_page_aligned(LARGE_ENOUGH));
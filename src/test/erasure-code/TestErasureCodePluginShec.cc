@@ -67,6 +67,7 @@ TEST(ErasureCodePlugin, select)
   int arch_intel_ssse3  = ceph_arch_intel_ssse3;
   int arch_intel_sse3   = ceph_arch_intel_sse3;
   int arch_intel_sse2   = ceph_arch_intel_sse2;
+  int arch_intel_avx2   = ceph_arch_intel_avx2;
   int arch_neon		= ceph_arch_neon;
 
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
@@ -76,7 +77,7 @@ TEST(ErasureCodePlugin, select)
   profile["shec-name"] = "test_shec";
   profile["technique"] = "multiple";
 
-  // all features are available, load the SSE4 plugin
+  // all features are available, load the AVX2 plugin
   {
     ceph_arch_intel_pclmul = 1;
     ceph_arch_intel_sse42  = 1;
@@ -84,6 +85,25 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 1;
     ceph_arch_intel_sse3   = 1;
     ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 1;
+    ceph_arch_neon	   = 0;
+
+    ErasureCodeInterfaceRef erasure_code;
+    int avx2_side_effect = -666;
+    EXPECT_EQ(avx2_side_effect, instance.factory("shec",
+						 g_conf->erasure_code_dir,
+						 profile,
+                                                 &erasure_code, &cerr));
+  }
+  // avx2 is missing, load the SSE4 plugin
+  {
+    ceph_arch_intel_pclmul = 1;
+    ceph_arch_intel_sse42  = 1;
+    ceph_arch_intel_sse41  = 1;
+    ceph_arch_intel_ssse3  = 1;
+    ceph_arch_intel_sse3   = 1;
+    ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 0;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -101,6 +121,7 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 1;
     ceph_arch_intel_sse3   = 1;
     ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 0;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -118,6 +139,7 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 1;
     ceph_arch_intel_sse3   = 0;
     ceph_arch_intel_sse2   = 1;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 0;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -135,6 +157,7 @@ TEST(ErasureCodePlugin, select)
     ceph_arch_intel_ssse3  = 0;
     ceph_arch_intel_sse3   = 0;
     ceph_arch_intel_sse2   = 0;
+    ceph_arch_intel_avx2   = 0;
     ceph_arch_neon	   = 1;
 
     ErasureCodeInterfaceRef erasure_code;
@@ -153,6 +176,7 @@ TEST(ErasureCodePlugin, select)
   ceph_arch_intel_ssse3  = arch_intel_ssse3;
   ceph_arch_intel_sse3   = arch_intel_sse3;
   ceph_arch_intel_sse2   = arch_intel_sse2;
+  ceph_arch_intel_avx2   = arch_intel_avx2;
   ceph_arch_neon	 = arch_neon;
 }
 
@@ -165,6 +189,7 @@ TEST(ErasureCodePlugin, sse)
     ceph_arch_intel_sse2;
   bool sse3 = ceph_arch_intel_ssse3 && ceph_arch_intel_sse3 &&
     ceph_arch_intel_sse2;
+  bool avx2 = sse4 && ceph_arch_intel_avx2;
   vector<string> sse_variants;
   sse_variants.push_back("generic");
   if (!sse3)
@@ -175,6 +200,10 @@ TEST(ErasureCodePlugin, sse)
     cerr << "SKIP sse4 plugin testing because CPU does not support it\n";
   else
     sse_variants.push_back("sse4");
+  if (!avx2)
+    cerr << "SKIP avx2 plugin testing because CPU does not support it\n";
+  else
+    sse_variants.push_back("avx2");
 
 #define LARGE_ENOUGH 2048
   bufferptr in_ptr(buffer::create_page_aligned(LARGE_ENOUGH));
@@ -0,0 +1,614 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+/*
+ * Erasure coded pool data path, from the primary's point of view,
+ * against MemStore: the ECTransaction is generated into one
+ * ObjectStore::Transaction per shard (ECUtil::encode and the HashInfo
+ * crcs included), each goes through the wire encoding a sub write
+ * would, and is applied to the shard's collection.  Reads, degraded
+ * reads and recovery read the shards back, check their crc against
+ * the HashInfo as a sub read does, and decode.
+ *
+ * Every workload prints one line per stage: operations, wall and cpu
+ * seconds, mean and 99th percentile latency.
+ */
+
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <boost/scoped_ptr.hpp>
+#include <boost/program_options/option.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/ceph_argparse.h"
+#include "common/config.h"
+#include "common/Clock.h"
+#include "common/errno.h"
+#include "include/utime.h"
+#include "include/stringify.h"
+#include "erasure-code/ErasureCodePlugin.h"
+#include "os/MemStore.h"
+#include "osd/ECUtil.h"
+#include "osd/ECTransaction.h"
+
+namespace po = boost::program_options;
+
+static double cpu_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+struct Stage {
+  double wall, cpu;
+  vector<double> latencies;
+  Stage() : wall(0), cpu(0) {}
+};
+
+/// adds the time between construction and destruction to a stage
+class StageTimer {
+  Stage &stage;
+  utime_t start;
+  double cpu_start;
+public:
+  StageTimer(Stage &s) : stage(s), start(ceph_clock_now(g_ceph_context)),
+			 cpu_start(cpu_now()) {}
+  ~StageTimer() {
+    double wall = ceph_clock_now(g_ceph_context) - start;
+    stage.wall += wall;
+    stage.cpu += cpu_now() - cpu_start;
+    stage.latencies.push_back(wall);
+  }
+};
+
+class ECBackendBench {
+  ErasureCodeInterfaceRef ec_impl;
+  boost::scoped_ptr<ECUtil::stripe_info_t> sinfo;
+  boost::scoped_ptr<ObjectStore> store;
+  ObjectStore::Sequencer osr;
+  pg_t pgid;
+  map<hobject_t, ECUtil::HashInfoRef, hobject_t::BitwiseComparator> hash_infos;
+  vector<hobject_t> objects;
+  map<hobject_t, bufferlist, hobject_t::BitwiseComparator> contents;
+  unsigned chunk_count;
+
+  typedef map<string, Stage> stages_t;
+  void report(const string &workload, vector<string> &order, stages_t &stages,
+	      uint64_t bytes);
+
+  coll_t coll(int shard) {
+    return coll_t(spg_t(pgid, shard_id_t(shard)));
+  }
+  ghobject_t ghobj(const hobject_t &hoid, int shard) {
+    return ghobject_t(hoid, ghobject_t::NO_GEN, shard_id_t(shard));
+  }
+  /// read shards and check them as a sub read does, false on mismatch
+  bool read_shards(const hobject_t &hoid, const set<int> &shards,
+		   map<int, bufferlist> *out, stages_t &stages);
+
+public:
+  string plugin;
+  ErasureCodeProfile profile;
+  string path;
+  unsigned num_objects;
+  unsigned size;
+  unsigned appends;
+  vector<int> erased;
+
+  ECBackendBench() : osr("ec-backend-bench"), pgid(0, 1, -1),
+		     chunk_count(0), num_objects(0), size(0), appends(0) {}
+  int setup(ostream &out);
+  void teardown();
+  int append();
+  int read(bool degraded);
+  int recovery();
+};
+
+int ECBackendBench::setup(ostream &out)
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  stringstream messages;
+  int r = instance.factory(plugin, g_conf->erasure_code_dir, profile,
+			   &ec_impl, &messages);
+  if (r) {
+    out << "plugin " << plugin << " " << profile << ": " << messages.str()
+	<< std::endl;
+    return r;
+  }
+  chunk_count = ec_impl->get_chunk_count();
+  unsigned k = ec_impl->get_data_chunk_count();
+  uint64_t stripe_width = k *
+    ec_impl->get_chunk_size(g_conf->osd_pool_erasure_code_stripe_width);
+  sinfo.reset(new ECUtil::stripe_info_t(k, stripe_width));
+  for (unsigned i = 0; i < erased.size(); i++) {
+    if (erased[i] < 0 || (unsigned)erased[i] >= chunk_count) {
+      out << "--erased " << erased[i] << " is not a chunk of " << profile
+	  << std::endl;
+      return -EINVAL;
+    }
+  }
+  if (erased.size() > chunk_count - k) {
+    out << erased.size() << " erasures are more than " << profile
+	<< " can decode" << std::endl;
+    return -EINVAL;
+  }
+
+  ::mkdir(path.c_str(), 0755);
+  store.reset(new MemStore(g_ceph_context, path));
+  r = store->mkfs();
+  if (r < 0)
+    return r;
+  r = store->mount();
+  if (r < 0)
+    return r;
+  ObjectStore::Transaction t;
+  for (unsigned i = 0; i < chunk_count; i++)
+    t.create_collection(coll(i), 0);
+  store->apply_transaction(&osr, t);
+
+  hash_infos.clear();
+  objects.clear();
+  contents.clear();
+  for (unsigned i = 0; i < num_objects; i++)
+    objects.push_back(hobject_t(sobject_t(object_t("object" + stringify(i)),
+					  CEPH_NOSNAP)));
+  cout << "# " << plugin << " " << profile
+       << " stripe_width " << stripe_width << std::endl;
+  return 0;
+}
+
+void ECBackendBench::teardown()
+{
+  if (store) {
+    store->umount();
+    store.reset();
+  }
+  ec_impl.reset();
+}
+
+void ECBackendBench::report(const string &workload, vector<string> &order,
+			    stages_t &stages, uint64_t bytes)
+{
+  for (vector<string>::iterator i = order.begin(); i != order.end(); ++i) {
+    Stage &s = stages[*i];
+    vector<double> &lat = s.latencies;
+    if (lat.empty())
+      continue;
+    sort(lat.begin(), lat.end());
+    double mean = s.wall / lat.size();
+    double p99 = lat[MIN(lat.size() - 1, lat.size() * 99 / 100)];
+    cout << workload << "\t" << *i
+	 << "\t" << lat.size()
+	 << "\t" << s.wall
+	 << "\t" << s.cpu
+	 << "\t" << (uint64_t)(mean * 1000000)
+	 << "\t" << (uint64_t)(p99 * 1000000);
+    if (*i == workload && s.wall > 0)
+      cout << "\t" << (bytes / s.wall / (1024 * 1024));
+    cout << std::endl;
+  }
+}
+
+int ECBackendBench::append()
+{
+  stages_t stages;
+  vector<string> order;
+  order.push_back("append");
+  order.push_back("encode");
+  order.push_back("crc");
+  order.push_back("generate");
+  order.push_back("wire");
+  order.push_back("store");
+
+  set<int> want;
+  for (unsigned i = 0; i < chunk_count; i++)
+    want.insert(i);
+  uint64_t bytes = 0;
+  for (unsigned a = 0; a < appends; a++) {
+    for (vector<hobject_t>::iterator o = objects.begin();
+	 o != objects.end();
+	 ++o) {
+      bufferptr bp(buffer::create_page_aligned(size));
+      for (unsigned i = 0; i < size; i++)
+	bp[i] = (char)(i * 31 + a * 7 + (o - objects.begin()));
+      bufferlist bl;
+      bl.append(bp);
+
+      StageTimer whole(stages["append"]);
+      if (!hash_infos.count(*o))
+	hash_infos[*o] = ECUtil::HashInfoRef(new ECUtil::HashInfo(chunk_count));
+      ECUtil::HashInfoRef hinfo = hash_infos[*o];
+      uint64_t offset = sinfo->aligned_chunk_offset_to_logical_offset(
+	hinfo->get_total_chunk_size());
+
+      // the two costs generate pays, on their own
+      {
+	bufferlist padded(bl);
+	if (padded.length() % sinfo->get_stripe_width())
+	  padded.append_zero(sinfo->get_stripe_width() -
+			     padded.length() % sinfo->get_stripe_width());
+	map<int, bufferlist> encoded;
+	{
+	  StageTimer t(stages["encode"]);
+	  int r = ECUtil::encode(*sinfo, ec_impl, padded, want, &encoded);
+	  assert(r == 0);
+	}
+	StageTimer t(stages["crc"]);
+	for (map<int, bufferlist>::iterator i = encoded.begin();
+	     i != encoded.end();
+	     ++i)
+	  i->second.crc32c(-1);
+      }
+
+      ECTransaction ect;
+      ect.append(*o, offset, bl.length(), bl, 0);
+      map<shard_id_t, ObjectStore::Transaction> trans;
+      for (unsigned i = 0; i < chunk_count; i++)
+	trans[shard_id_t(i)];
+      set<hobject_t, hobject_t::BitwiseComparator> temp_added, temp_removed;
+      ECTransaction::object_stripes_t written;
+      set<hobject_t, hobject_t::BitwiseComparator> invalidated;
+      {
+	StageTimer t(stages["generate"]);
+	ect.generate_transactions(hash_infos, ec_impl, pgid, *sinfo,
+				  ECTransaction::object_stripes_t(),
+				  &trans, &temp_added, &temp_removed,
+				  &written, &invalidated);
+      }
+
+      // what each replica gets out of its sub write
+      list<ObjectStore::Transaction> received;
+      {
+	StageTimer t(stages["wire"]);
+	for (map<shard_id_t, ObjectStore::Transaction>::iterator i =
+	       trans.begin();
+	     i != trans.end();
+	     ++i) {
+	  bufferlist wire;
+	  ::encode(i->second, wire);
+	  bufferlist::iterator p = wire.begin();
+	  received.push_back(ObjectStore::Transaction());
+	  ::decode(received.back(), p);
+	}
+      }
+      {
+	StageTimer t(stages["store"]);
+	for (list<ObjectStore::Transaction>::iterator i = received.begin();
+	     i != received.end();
+	     ++i)
+	  store->apply_transaction(&osr, *i);
+      }
+      contents[*o].append(bl);
+      bytes += bl.length();
+    }
+  }
+  report("append", order, stages, bytes);
+  return 0;
+}
+
+bool ECBackendBench::read_shards(const hobject_t &hoid, const set<int> &shards,
+				 map<int, bufferlist> *out, stages_t &stages)
+{
+  ECUtil::HashInfoRef hinfo = hash_infos[hoid];
+  uint64_t len = hinfo->get_total_chunk_size();
+  {
+    StageTimer t(stages["store_read"]);
+    for (set<int>::const_iterator i = shards.begin(); i != shards.end(); ++i) {
+      int r = store->read(coll(*i), ghobj(hoid, *i), 0, len, (*out)[*i]);
+      if (r != (int)len) {
+	cerr << "read " << hoid << " shard " << *i << " returned " << r
+	     << std::endl;
+	return false;
+      }
+    }
+  }
+  StageTimer t(stages["crc"]);
+  for (set<int>::const_iterator i = shards.begin(); i != shards.end(); ++i) {
+    bufferlist attr;
+    store->getattr(coll(*i), ghobj(hoid, *i), ECUtil::get_hinfo_key().c_str(),
+		   attr);
+    ECUtil::HashInfo on_disk;
+    bufferlist::iterator p = attr.begin();
+    ::decode(on_disk, p);
+    if ((*out)[*i].crc32c(-1) != on_disk.get_chunk_hash(*i)) {
+      cerr << hoid << " shard " << *i << " crc mismatch" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int ECBackendBench::read(bool degraded)
+{
+  string workload = degraded ? "degraded_read" : "read";
+  stages_t stages;
+  vector<string> order;
+  order.push_back(workload);
+  order.push_back("store_read");
+  order.push_back("crc");
+  order.push_back("decode");
+
+  set<int> want, have;
+  const vector<int> &mapping = ec_impl->get_chunk_mapping();
+  for (unsigned i = 0; i < ec_impl->get_data_chunk_count(); i++)
+    want.insert(mapping.size() > i ? mapping[i] : i);
+  for (unsigned i = 0; i < chunk_count; i++)
+    have.insert(i);
+  if (degraded)
+    for (unsigned i = 0; i < erased.size(); i++)
+      have.erase(erased[i]);
+  uint64_t bytes = 0;
+  for (vector<hobject_t>::iterator o = objects.begin();
+       o != objects.end();
+       ++o) {
+    StageTimer whole(stages[workload]);
+    set<int> need;
+    int r = ec_impl->minimum_to_decode(want, have, &need);
+    if (r) {
+      cerr << "minimum_to_decode " << want << " from " << have << ": "
+	   << cpp_strerror(r) << std::endl;
+      return r;
+    }
+    map<int, bufferlist> chunks;
+    if (!read_shards(*o, need, &chunks, stages))
+      return -EIO;
+    bufferlist out;
+    {
+      StageTimer t(stages["decode"]);
+      r = ECUtil::decode(*sinfo, ec_impl, chunks, &out);
+      assert(r == 0);
+    }
+    bufferlist &expected = contents[*o];
+    if (out.length() < expected.length() ||
+	memcmp(out.c_str(), expected.c_str(), expected.length())) {
+      cerr << workload << " " << *o << " does not match what was written"
+	   << std::endl;
+      return -EIO;
+    }
+    bytes += expected.length();
+  }
+  report(workload, order, stages, bytes);
+  return 0;
+}
+
+int ECBackendBench::recovery()
+{
+  stages_t stages;
+  vector<string> order;
+  order.push_back("recovery");
+  order.push_back("store_read");
+  order.push_back("crc");
+  order.push_back("decode");
+  order.push_back("store");
+
+  set<int> want(erased.begin(), erased.end()), have;
+  for (unsigned i = 0; i < chunk_count; i++)
+    if (!want.count(i))
+      have.insert(i);
+  uint64_t bytes = 0;
+  for (vector<hobject_t>::iterator o = objects.begin();
+       o != objects.end();
+       ++o) {
+    StageTimer whole(stages["recovery"]);
+    set<int> need;
+    int r = ec_impl->minimum_to_decode(want, have, &need);
+    if (r) {
+      cerr << "minimum_to_decode " << want << " from " << have << ": "
+	   << cpp_strerror(r) << std::endl;
+      return r;
+    }
+    map<int, bufferlist> chunks;
+    if (!read_shards(*o, need, &chunks, stages))
+      return -EIO;
+    map<int, bufferlist> rebuilt;
+    map<int, bufferlist*> out;
+    for (set<int>::iterator i = want.begin(); i != want.end(); ++i)
+      out[*i] = &rebuilt[*i];
+    {
+      StageTimer t(stages["decode"]);
+      r = ECUtil::decode(*sinfo, ec_impl, chunks, out);
+      assert(r == 0);
+    }
+    ECUtil::HashInfoRef hinfo = hash_infos[*o];
+    for (map<int, bufferlist>::iterator i = rebuilt.begin();
+	 i != rebuilt.end();
+	 ++i) {
+      if (i->second.crc32c(-1) != hinfo->get_chunk_hash(i->first)) {
+	cerr << "recovered " << *o << " shard " << i->first
+	     << " crc mismatch" << std::endl;
+	return -EIO;
+      }
+    }
+    // push: the shard is rewritten whole, with its hinfo
+    {
+      StageTimer t(stages["store"]);
+      bufferlist hbuf;
+      ::encode(*hinfo, hbuf);
+      for (map<int, bufferlist>::iterator i = rebuilt.begin();
+	   i != rebuilt.end();
+	   ++i) {
+	ObjectStore::Transaction t;
+	t.remove(coll(i->first), ghobj(*o, i->first));
+	t.write(coll(i->first), ghobj(*o, i->first), 0, i->second.length(),
+		i->second);
+	t.setattr(coll(i->first), ghobj(*o, i->first),
+		  ECUtil::get_hinfo_key(), hbuf);
+	store->apply_transaction(&osr, t);
+	bytes += i->second.length();
+      }
+    }
+  }
+  report("recovery", order, stages, bytes);
+  return 0;
+}
+
+/// one profile of each plugin, for --all-profiles
+static void default_profiles(vector<pair<string, ErasureCodeProfile> > *out)
+{
+  ErasureCodeProfile p;
+  p["technique"] = "reed_sol_van";
+  p["k"] = "4";
+  p["m"] = "2";
+  out->push_back(make_pair("jerasure", p));
+  p.clear();
+  p["technique"] = "cauchy_good";
+  p["k"] = "4";
+  p["m"] = "2";
+  p["packetsize"] = "2048";
+  out->push_back(make_pair("jerasure", p));
+  p.clear();
+  p["k"] = "4";
+  p["m"] = "2";
+  out->push_back(make_pair("isa", p));
+  p.clear();
+  p["k"] = "4";
+  p["m"] = "2";
+  p["l"] = "3";
+  out->push_back(make_pair("lrc", p));
+  p.clear();
+  p["k"] = "4";
+  p["m"] = "3";
+  p["c"] = "2";
+  out->push_back(make_pair("shec", p));
+}
+
+int main(int argc, char **argv)
+{
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "produce help message")
+    ("plugin,p", po::value<string>()->default_value("jerasure"),
+     "erasure code plugin name")
+    ("parameter,P", po::value<vector<string> >(),
+     "add a parameter to the erasure code profile")
+    ("all-profiles,a",
+     "ignore --plugin and --parameter and run a jerasure, isa, lrc and shec "
+     "profile one after the other (plugins that cannot be loaded are "
+     "skipped)")
+    ("workload,w", po::value<vector<string> >(),
+     "append, read, degraded_read or recovery (repeat for more than one, "
+     "default all; append always runs first)")
+    ("objects,o", po::value<unsigned>()->default_value(64),
+     "number of objects")
+    ("size,s", po::value<unsigned>()->default_value(4 * 1024 * 1024),
+     "bytes per append")
+    ("appends,n", po::value<unsigned>()->default_value(1),
+     "appends per object")
+    ("erased,e", po::value<vector<int> >(),
+     "chunk lost for degraded_read and recovery (repeat for more, "
+     "default chunk 0)")
+    ("path", po::value<string>()->default_value("ec_backend_bench.tmp"),
+     "MemStore directory")
+    ;
+
+  po::variables_map vm;
+  po::parsed_options parsed =
+    po::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+  try {
+    po::store(parsed, vm);
+    po::notify(vm);
+  } catch(po::error &e) {
+    cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  vector<const char *> ceph_options, def_args;
+  vector<string> ceph_option_strings = po::collect_unrecognized(
+    parsed.options, po::include_positional);
+  for (vector<string>::iterator i = ceph_option_strings.begin();
+       i != ceph_option_strings.end();
+       ++i)
+    ceph_options.push_back(i->c_str());
+  global_init(&def_args, ceph_options, CEPH_ENTITY_TYPE_CLIENT,
+	      CODE_ENVIRONMENT_UTILITY, CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  if (vm.count("help")) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  vector<pair<string, ErasureCodeProfile> > profiles;
+  if (vm.count("all-profiles")) {
+    default_profiles(&profiles);
+  } else {
+    ErasureCodeProfile profile;
+    if (vm.count("parameter")) {
+      const vector<string> &p = vm["parameter"].as< vector<string> >();
+      for (vector<string>::const_iterator i = p.begin(); i != p.end(); ++i) {
+	vector<string> strs;
+	boost::split(strs, *i, boost::is_any_of("="));
+	if (strs.size() != 2)
+	  cerr << "--parameter " << *i << " ignored because it does not "
+	       << "contain exactly one =" << std::endl;
+	else
+	  profile[strs[0]] = strs[1];
+      }
+    }
+    profiles.push_back(make_pair(vm["plugin"].as<string>(), profile));
+  }
+  set<string> workloads;
+  if (vm.count("workload")) {
+    const vector<string> &w = vm["workload"].as< vector<string> >();
+    workloads.insert(w.begin(), w.end());
+  } else {
+    workloads.insert("read");
+    workloads.insert("degraded_read");
+    workloads.insert("recovery");
+  }
+
+  ECBackendBench bench;
+  bench.num_objects = vm["objects"].as<unsigned>();
+  bench.size = vm["size"].as<unsigned>();
+  bench.appends = vm["appends"].as<unsigned>();
+  bench.path = vm["path"].as<string>();
+  if (vm.count("erased"))
+    bench.erased = vm["erased"].as<vector<int> >();
+  else
+    bench.erased.push_back(0);
+
+  cout << "# workload\tstage\tops\tseconds\tcpu\tmean_us\tp99_us\tMB/s"
+       << std::endl;
+  int ret = 0;
+  for (unsigned i = 0; i < profiles.size(); i++) {
+    bench.plugin = profiles[i].first;
+    bench.profile = profiles[i].second;
+    int r = bench.setup(cerr);
+    if (r) {
+      bench.teardown();
+      if (profiles.size() > 1)
+	continue;
+      return 1;
+    }
+    r = bench.append();
+    if (r == 0 && workloads.count("read"))
+      r = bench.read(false);
+    if (r == 0 && workloads.count("degraded_read"))
+      r = bench.read(true);
+    if (r == 0 && workloads.count("recovery"))
+      r = bench.recovery();
+    bench.teardown();
+    if (r)
+      ret = 1;
+  }
+  return ret;
+}
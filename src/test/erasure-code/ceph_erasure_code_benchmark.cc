@@ -30,6 +30,7 @@
 #include "common/config.h"
 #include "common/Clock.h"
 #include "include/utime.h"
+#include "include/stringify.h"
 #include "erasure-code/ErasureCodePlugin.h"
 #include "erasure-code/ErasureCode.h"
 #include "ceph_erasure_code_benchmark.h"
@@ -61,6 +62,13 @@ int ErasureCodeBench::setup(int argc, char** argv) {
      " the first chunk, then the second etc.)")
     ("parameter,P", po::value<vector<string> >(),
      "add a parameter to the erasure code profile")
+    ("stripe-width,S", po::value<vector<int> >(),
+     "encode or decode --size bytes as stripes of this width in one call "
+     "(repeat to compare widths); prints one line per width and thread "
+     "count: width, threads, seconds, KB, GB/s")
+    ("threads,t", po::value<vector<int> >(),
+     "erasure_code_decode_threads for --stripe-width runs "
+     "(repeat to compare)")
     ;
 
   po::variables_map vm;
@@ -121,6 +129,12 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     exhaustive_erasures = false;
   if (vm.count("erased") > 0)
     erased = vm["erased"].as<vector<int> >();
+  if (vm.count("stripe-width") > 0)
+    stripe_widths = vm["stripe-width"].as<vector<int> >();
+  if (vm.count("threads") > 0)
+    threads = vm["threads"].as<vector<int> >();
+  if (threads.empty())
+    threads.push_back(1);
 
   k = atoi(profile["k"].c_str());
   m = atoi(profile["m"].c_str());
@@ -170,6 +184,9 @@ int ErasureCodeBench::encode()
     return -EINVAL;
   }
 
+  if (!stripe_widths.empty())
+    return stripes(erasure_code);
+
   bufferlist in;
   in.append(string(in_size, 'X'));
   in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
@@ -272,6 +289,9 @@ int ErasureCodeBench::decode()
       << erasure_code->get_chunk_count() - erasure_code->get_data_chunk_count() << endl;
     return -EINVAL;
   }
+  if (!stripe_widths.empty())
+    return stripes(erasure_code);
+
   bufferlist in;
   in.append(string(in_size, 'X'));
   in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
@@ -327,6 +347,74 @@ int ErasureCodeBench::decode()
   return 0;
 }
 
+int ErasureCodeBench::stripes(ErasureCodeInterfaceRef erasure_code)
+{
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++)
+    want_to_encode.insert(i);
+
+  for (vector<int>::iterator w = stripe_widths.begin();
+       w != stripe_widths.end();
+       ++w) {
+    unsigned int stripe_width = *w;
+    if (stripe_width == 0) {
+      cerr << "--stripe-width must be > 0" << endl;
+      return -EINVAL;
+    }
+    unsigned int count = MAX(1u, (unsigned)in_size / stripe_width);
+    bufferlist in;
+    in.append(string(count * stripe_width, 'X'));
+    in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+    map<int,bufferlist> encoded;
+    int code = erasure_code->encode_stripes(want_to_encode, in, stripe_width,
+					    &encoded, NULL);
+    if (code)
+      return code;
+    unsigned int chunk_size = erasure_code->get_chunk_size(stripe_width);
+
+    for (vector<int>::iterator t = threads.begin(); t != threads.end(); ++t) {
+      g_conf->set_val("erasure_code_decode_threads", stringify(*t));
+      g_conf->apply_changes(NULL);
+      utime_t begin_time = ceph_clock_now(g_ceph_context);
+      for (int i = 0; i < max_iterations; i++) {
+	if (workload == "encode") {
+	  map<int,bufferlist> out;
+	  code = erasure_code->encode_stripes(want_to_encode, in, stripe_width,
+					      &out, NULL);
+	} else {
+	  map<int,bufferlist> chunks = encoded;
+	  if (erased.size() > 0) {
+	    for (vector<int>::const_iterator e = erased.begin();
+		 e != erased.end();
+		 ++e)
+	      chunks.erase(*e);
+	  } else {
+	    for (int j = 0; j < erasures; j++) {
+	      int erasure;
+	      do {
+		erasure = rand() % (k + m);
+	      } while (chunks.count(erasure) == 0);
+	      chunks.erase(erasure);
+	    }
+	  }
+	  map<int,bufferlist> decoded;
+	  code = erasure_code->decode_stripes(want_to_encode, chunks,
+					      chunk_size, &decoded);
+	}
+	if (code)
+	  return code;
+      }
+      utime_t end_time = ceph_clock_now(g_ceph_context);
+      double seconds = end_time - begin_time;
+      uint64_t bytes = (uint64_t)max_iterations * in.length();
+      cout << stripe_width << "\t" << *t << "\t" << seconds << "\t"
+	   << (bytes / 1024) << "\t"
+	   << (seconds > 0 ? bytes / seconds / 1e9 : 0) << endl;
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char** argv) {
   ErasureCodeBench ecbench;
   try {
@@ -37,6 +37,9 @@ class ErasureCodeBench {
 
   ErasureCodeProfile profile;
 
+  vector<int> stripe_widths;
+  vector<int> threads;
+
   bool verbose;
 public:
   int setup(int argc, char** argv);
@@ -48,6 +51,7 @@ public:
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
   int encode();
+  int stripes(ErasureCodeInterfaceRef erasure_code);
 };
 
 #endif
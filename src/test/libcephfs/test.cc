@@ -22,6 +22,7 @@
 #include <dirent.h>
 #include <sys/xattr.h>
 #include <sys/uio.h>
+#include <pthread.h>
 
 #ifdef __linux__
 #include <limits.h>
@@ -1285,3 +1286,76 @@ TEST(LibCephFS, GetOsdAddr) {
 
   ceph_shutdown(cmount);
 }
+
+struct async_results {
+  pthread_mutex_t lock;
+  int done, failed;
+};
+
+static void async_cb(struct ceph_mount_info *cmount, int r, void *arg)
+{
+  struct async_results *res = (struct async_results *)arg;
+  pthread_mutex_lock(&res->lock);
+  res->done++;
+  if (r < 0)
+    res->failed++;
+  pthread_mutex_unlock(&res->lock);
+}
+
+TEST(LibCephFS, AsyncCreateUnlink) {
+  struct ceph_mount_info *cmount;
+  ASSERT_EQ(ceph_create(&cmount, NULL), 0);
+  ASSERT_EQ(ceph_conf_read_file(cmount, NULL), 0);
+  ASSERT_EQ(0, ceph_conf_parse_env(cmount, NULL));
+
+  EXPECT_EQ(-ENOTCONN, ceph_unlink_async(cmount, "foo", async_cb, NULL));
+
+  ASSERT_EQ(ceph_mount(cmount, NULL), 0);
+
+  char dir[256];
+  sprintf(dir, "async_test_%d", getpid());
+  ASSERT_EQ(0, ceph_mkdir(cmount, dir, 0777));
+
+  const int num = 200;
+  struct async_results res;
+  pthread_mutex_init(&res.lock, NULL);
+  res.done = res.failed = 0;
+  char path[512];
+  for (int i = 0; i < num; i++) {
+    sprintf(path, "%s/file_%d", dir, i);
+    ASSERT_EQ(0, ceph_create_async(cmount, path, O_WRONLY|O_EXCL, 0644,
+				   async_cb, &res));
+  }
+  struct stat st;
+  memset(&st, 0, sizeof(st));
+  st.st_mode = 0600;
+  sprintf(path, "%s/file_0", dir);
+
+  // unmount waits for what is queued
+  ASSERT_EQ(0, ceph_unmount(cmount));
+  ASSERT_EQ(num, res.done);
+  ASSERT_EQ(0, res.failed);
+
+  ASSERT_EQ(ceph_mount(cmount, NULL), 0);
+  ASSERT_EQ(0, ceph_setattr_async(cmount, path, &st, CEPH_SETATTR_MODE,
+				  async_cb, &res));
+  ASSERT_EQ(0, ceph_unmount(cmount));
+  ASSERT_EQ(num + 1, res.done);
+  ASSERT_EQ(0, res.failed);
+
+  ASSERT_EQ(ceph_mount(cmount, NULL), 0);
+  ASSERT_EQ(0, ceph_stat(cmount, path, &st));
+  ASSERT_EQ(0600, (int)(st.st_mode & 0777));
+  for (int i = 0; i < num; i++) {
+    sprintf(path, "%s/file_%d", dir, i);
+    ASSERT_EQ(0, ceph_unlink_async(cmount, path, async_cb, &res));
+  }
+  ASSERT_EQ(0, ceph_unmount(cmount));
+  ASSERT_EQ(2 * num + 1, res.done);
+  ASSERT_EQ(0, res.failed);
+
+  ASSERT_EQ(ceph_mount(cmount, NULL), 0);
+  ASSERT_EQ(0, ceph_rmdir(cmount, dir));
+  ceph_shutdown(cmount);
+  pthread_mutex_destroy(&res.lock);
+}
@@ -300,6 +300,33 @@ TEST_F(LibRadosListPP, ListObjectsManyPP) {
     ASSERT_TRUE(saw_pg.count(i));
 }
 
+TEST_F(LibRadosListPP, ListObjectsSlicePP) {
+  char buf[128];
+  memset(buf, 0xcc, sizeof(buf));
+  bufferlist bl;
+  bl.append(buf, sizeof(buf));
+
+  for (int i=0; i<256; ++i) {
+    ASSERT_EQ(0, ioctx.write(stringify(i), bl, bl.length(), 0));
+  }
+
+  // every object in exactly one slice, however many slices there are
+  unsigned counts[] = { 1, 3, 8, 1000 };
+  for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    unsigned n = counts[c];
+    std::set<std::string> saw_obj;
+    for (unsigned m = 0; m < n; ++m) {
+      for (NObjectIterator it = ioctx.nobjects_begin_slice(n, m);
+	   it != ioctx.nobjects_end(); ++it) {
+	ASSERT_TRUE(saw_obj.insert(it->get_oid()).second);
+      }
+    }
+    ASSERT_EQ(256u, saw_obj.size());
+  }
+
+  ASSERT_THROW(ioctx.nobjects_begin_slice(2, 2), std::runtime_error);
+}
+
 TEST_F(LibRadosList, ListObjectsStart) {
   char buf[128];
   memset(buf, 0xcc, sizeof(buf));
@@ -529,6 +529,117 @@ TEST_F(LibRadosMiscPP, AssertExistsPP) {
   ASSERT_EQ(-EEXIST, ioctx.create("asdffoo", true));
 }
 
+TEST_F(LibRadosMiscPP, OpBatchingPP) {
+  ioctx.set_op_batching(true);
+
+  const int n = 40;
+  list<AioCompletion*> completions;
+  for (int i = 0; i < n; ++i) {
+    bufferlist bl;
+    bl.append(stringify(i));
+    map<string, bufferlist> vals;
+    vals["key"] = bl;
+    ObjectWriteOperation op;
+    op.write_full(bl);
+    op.omap_set(vals);
+    AioCompletion *c = cluster.aio_create_completion();
+    ASSERT_EQ(0, ioctx.aio_operate("batch" + stringify(i), c, &op));
+    completions.push_back(c);
+  }
+  for (list<AioCompletion*>::iterator p = completions.begin();
+       p != completions.end();
+       ++p) {
+    (*p)->wait_for_safe();
+    ASSERT_EQ(0, (*p)->get_return_value());
+    (*p)->release();
+  }
+
+  // reads go in batches too, and each still gets its own result
+  vector<map<string, bufferlist> > out(n);
+  vector<int> rvals(n);
+  vector<AioCompletion*> reads(n);
+  for (int i = 0; i < n; ++i) {
+    ObjectReadOperation op;
+    set<string> keys;
+    keys.insert("key");
+    op.omap_get_vals_by_keys(keys, &out[i], &rvals[i]);
+    reads[i] = cluster.aio_create_completion();
+    ASSERT_EQ(0, ioctx.aio_operate("batch" + stringify(i), reads[i], &op, 0));
+  }
+  for (int i = 0; i < n; ++i) {
+    reads[i]->wait_for_complete();
+    ASSERT_EQ(0, reads[i]->get_return_value());
+    reads[i]->release();
+    ASSERT_EQ(0, rvals[i]);
+    ASSERT_EQ(1u, out[i].count("key"));
+    ASSERT_EQ(stringify(i), string(out[i]["key"].c_str(),
+				   out[i]["key"].length()));
+  }
+
+  ObjectReadOperation missing;
+  missing.stat(NULL, NULL, NULL);
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, ioctx.operate("batchnosuchobject", &missing, &bl));
+  ioctx.set_op_batching(false);
+}
+
+TEST_F(LibRadosMiscPP, AioOperateManyPP) {
+  const int n = 100;
+  vector<string> oids;
+  vector<ObjectWriteOperation*> ops;
+  for (int i = 0; i < n; ++i) {
+    bufferlist bl;
+    bl.append(stringify(i));
+    ObjectWriteOperation *op = new ObjectWriteOperation;
+    op->write_full(bl);
+    oids.push_back("many" + stringify(i));
+    ops.push_back(op);
+  }
+  vector<int> rvals;
+  AioCompletion *c = cluster.aio_create_completion();
+  ASSERT_EQ(0, ioctx.aio_operate_many(oids, ops, c, 0, &rvals));
+  c->wait_for_safe();
+  ASSERT_EQ(0, c->get_return_value());
+  c->release();
+  ASSERT_EQ((size_t)n, rvals.size());
+  for (int i = 0; i < n; ++i) {
+    ASSERT_EQ(0, rvals[i]);
+    bufferlist bl;
+    ASSERT_EQ((int)stringify(i).length(), ioctx.read(oids[i], bl, 0, 0));
+    ASSERT_EQ(stringify(i), string(bl.c_str(), bl.length()));
+    delete ops[i];
+  }
+
+  // one failure fails the whole batch, the others still happen
+  ObjectWriteOperation exclusive, plain;
+  exclusive.create(true);
+  plain.create(false);
+  oids.resize(2);
+  oids[1] = "manynew";
+  ops.resize(2);
+  ops[0] = &exclusive;
+  ops[1] = &plain;
+  c = cluster.aio_create_completion();
+  ASSERT_EQ(0, ioctx.aio_operate_many(oids, ops, c, 0, &rvals));
+  c->wait_for_safe();
+  ASSERT_EQ(-EEXIST, c->get_return_value());
+  c->release();
+  ASSERT_EQ(-EEXIST, rvals[0]);
+  ASSERT_EQ(0, rvals[1]);
+  uint64_t size;
+  time_t mtime;
+  ASSERT_EQ(0, ioctx.stat("manynew", &size, &mtime));
+
+  // nothing to do completes at once
+  oids.clear();
+  ops.clear();
+  c = cluster.aio_create_completion();
+  ASSERT_EQ(0, ioctx.aio_operate_many(oids, ops, c, 0, NULL));
+  c->wait_for_safe();
+  ASSERT_EQ(0, c->get_return_value());
+  c->release();
+}
+
 TEST_F(LibRadosMiscPP, AssertVersionPP) {
   char buf[64];
   memset(buf, 0xcc, sizeof(buf));
@@ -1009,6 +1009,31 @@ int cls_cxx_map_get_vals(cls_method_context_t hctx, const string &start_obj,
       max_to_get, vals);
 }
 
+int cls_cxx_map_get_vals_by_keys(cls_method_context_t hctx,
+                                 const std::set<string> &keys,
+                                 std::map<string, bufferlist> *vals) {
+  vals->clear();
+  for (std::set<string>::const_iterator it = keys.begin(); it != keys.end();
+       ++it) {
+    bufferlist bl;
+    int r = cls_cxx_map_get_val(hctx, *it, &bl);
+    if (r == -ENOENT) {
+      continue;
+    } else if (r < 0) {
+      return r;
+    }
+    (*vals)[*it] = bl;
+  }
+  return 0;
+}
+
+int cls_cxx_map_remove_keys(cls_method_context_t hctx,
+                            const std::set<string> &keys) {
+  librados::TestClassHandler::MethodContext *ctx =
+    reinterpret_cast<librados::TestClassHandler::MethodContext*>(hctx);
+  return ctx->io_ctx_impl->omap_rm_keys(ctx->oid, keys);
+}
+
 int cls_cxx_map_remove_key(cls_method_context_t hctx, const string &key) {
   std::set<std::string> keys;
   keys.insert(key);
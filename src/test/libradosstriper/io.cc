@@ -86,6 +86,30 @@ TEST_F(StriperTestPP, RoundTripPP) {
   ASSERT_EQ(0, memcmp(buf, cl.c_str(), sizeof(buf)));
 }
 
+TEST_F(StriperTestPP, LeasedReadPP) {
+  char buf[128];
+  memset(buf, 0xcc, sizeof(buf));
+  bufferlist bl;
+  bl.append(buf, sizeof(buf));
+  ASSERT_EQ(0, striper.write("LeasedReadPP", bl, sizeof(buf), 0));
+  ASSERT_EQ(0, cluster.conf_set("rados_striper_lock_lease", "60"));
+  // later reads reuse the shared lock the first one left
+  for (int i = 0; i < 3; i++) {
+    bufferlist cl;
+    ASSERT_EQ((int)sizeof(buf), striper.read("LeasedReadPP", &cl, sizeof(buf), 0));
+    ASSERT_EQ(0, memcmp(buf, cl.c_str(), sizeof(buf)));
+  }
+  int exclusive;
+  std::string tag;
+  std::list<librados::locker_t> lockers;
+  ASSERT_EQ(1, ioctx.list_lockers("LeasedReadPP.0000000000000000", "striper.lock",
+				  &exclusive, &tag, &lockers));
+  ASSERT_EQ(0, exclusive);
+  // our own lease does not get in the way of removal
+  ASSERT_EQ(0, striper.remove("LeasedReadPP"));
+  ASSERT_EQ(0, cluster.conf_set("rados_striper_lock_lease", "0"));
+}
+
 TEST_F(StriperTest, OverlappingWriteRoundTrip) {
   char buf[128];
   char buf2[64];
@@ -117,6 +141,35 @@ TEST_F(StriperTestPP, OverlappingWriteRoundTripPP) {
   ASSERT_EQ(0, memcmp(bl3.c_str() + sizeof(buf2), buf, sizeof(buf) - sizeof(buf2)));
 }
 
+TEST_F(StriperTestPP, WriteSmallStripeUnitPP) {
+  // an object striped in 64k units...
+  ASSERT_EQ(0, striper.set_object_layout_stripe_unit(65536));
+  ASSERT_EQ(0, striper.set_object_layout_object_size(65536));
+  bufferlist bl1;
+  bl1.append(string(128, 'a'));
+  ASSERT_EQ(0, striper.write("WriteSmallStripeUnitPP", bl1, bl1.length(), 0));
+  // ...written by a striper whose own stripe unit would hold all of it
+  // in the first object
+  RadosStriper other;
+  ASSERT_EQ(0, RadosStriper::striper_create(ioctx, &other));
+  bufferlist bl2;
+  bl2.append(string(100000, 'b'));
+  ASSERT_EQ(0, other.write("WriteSmallStripeUnitPP", bl2, bl2.length(), 0));
+  uint64_t size;
+  time_t mtime;
+  ASSERT_EQ(0, striper.stat("WriteSmallStripeUnitPP", &size, &mtime));
+  ASSERT_EQ(100000u, size);
+  ASSERT_EQ(0, ioctx.stat("WriteSmallStripeUnitPP.0000000000000001", &size, &mtime));
+  ASSERT_EQ(100000u - 65536u, size);
+  bufferlist bl3;
+  ASSERT_EQ(100000, other.read("WriteSmallStripeUnitPP", &bl3, 100000, 0));
+  ASSERT_TRUE(bl2.contents_equal(bl3));
+  // and a small overwrite leaves the size alone
+  ASSERT_EQ(0, other.write("WriteSmallStripeUnitPP", bl1, bl1.length(), 128));
+  ASSERT_EQ(0, striper.stat("WriteSmallStripeUnitPP", &size, &mtime));
+  ASSERT_EQ(100000u, size);
+}
+
 TEST_F(StriperTest, SparseWriteRoundTrip) {
   char buf[128];
   char buf2[2*sizeof(buf)];
@@ -0,0 +1,177 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#include "librbd/ParentCache.h"
+#include "common/ceph_context.h"
+#include "common/config.h"
+#include "global/global_context.h"
+#include "include/stringify.h"
+#include "gtest/gtest.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string>
+
+void register_test_parent_cache() {
+}
+
+class TestParentCache : public ::testing::Test {
+public:
+  static const std::string FSID;
+
+  std::string m_dir;
+  std::string m_orig_path;
+  std::string m_orig_size;
+
+  virtual void SetUp() {
+    char tmpl[] = "/tmp/test_parent_cache.XXXXXX";
+    ASSERT_TRUE(mkdtemp(tmpl) != NULL);
+    m_dir = tmpl;
+
+    md_config_t *conf = g_ceph_context->_conf;
+    m_orig_path = conf->rbd_parent_cache_path;
+    m_orig_size = stringify(conf->rbd_parent_cache_size);
+    conf->set_val("rbd_parent_cache_path", m_dir.c_str());
+  }
+
+  virtual void TearDown() {
+    md_config_t *conf = g_ceph_context->_conf;
+    conf->set_val("rbd_parent_cache_path", m_orig_path.c_str());
+    conf->set_val("rbd_parent_cache_size", m_orig_size.c_str());
+    std::string cmd = "rm -rf " + m_dir;
+    ASSERT_EQ(0, system(cmd.c_str()));
+  }
+
+  std::string file_path(uint64_t object_no) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "1.image.2.%016llx",
+	     (unsigned long long)object_no);
+    return m_dir + "/" + FSID + "/" + buf;
+  }
+
+  static bufferlist object(char c, size_t len) {
+    bufferlist bl;
+    bl.append(std::string(len, c));
+    return bl;
+  }
+};
+
+const std::string TestParentCache::FSID =
+  "c0ffee00-0000-4000-8000-000000000001";
+
+TEST_F(TestParentCache, Disabled) {
+  g_ceph_context->_conf->set_val("rbd_parent_cache_path", "");
+  librbd::ParentCache cache(g_ceph_context);
+  ASSERT_EQ(-EINVAL, cache.init(FSID));
+  ASSERT_FALSE(cache.enabled());
+}
+
+TEST_F(TestParentCache, InitPerCluster) {
+  librbd::ParentCache cache(g_ceph_context);
+  ASSERT_EQ(0, cache.init(FSID));
+  ASSERT_TRUE(cache.enabled());
+  ASSERT_EQ(0, cache.init(FSID));
+  ASSERT_EQ(-EINVAL, cache.init("some-other-fsid"));
+
+  struct stat st;
+  ASSERT_EQ(0, ::stat((m_dir + "/" + FSID).c_str(), &st));
+  ASSERT_TRUE(S_ISDIR(st.st_mode));
+  ASSERT_EQ(0700, st.st_mode & 0777);
+}
+
+TEST_F(TestParentCache, MissFillHit) {
+  librbd::ParentCache cache(g_ceph_context);
+  ASSERT_EQ(0, cache.init(FSID));
+
+  bufferlist bl;
+  ASSERT_FALSE(cache.read(1, "image", 2, 3, 0, 4096, &bl));
+  ASSERT_EQ(0u, bl.length());
+
+  cache.write(1, "image", 2, 3, object('a', 4096));
+  cache.flush();
+
+  ASSERT_TRUE(cache.read(1, "image", 2, 3, 100, 200, &bl));
+  ASSERT_TRUE(object('a', 200).contents_equal(bl));
+
+  // reads past the end of the object are clipped
+  bl.clear();
+  ASSERT_TRUE(cache.read(1, "image", 2, 3, 4000, 200, &bl));
+  ASSERT_EQ(96u, bl.length());
+
+  // other snapshots and objects are not affected
+  bl.clear();
+  ASSERT_FALSE(cache.read(1, "image", 4, 3, 0, 4096, &bl));
+  ASSERT_FALSE(cache.read(1, "image", 2, 4, 0, 4096, &bl));
+
+  // a second instance sharing the directory sees the object
+  librbd::ParentCache other(g_ceph_context);
+  ASSERT_EQ(0, other.init(FSID));
+  ASSERT_TRUE(other.read(1, "image", 2, 3, 0, 4096, &bl));
+  ASSERT_TRUE(object('a', 4096).contents_equal(bl));
+}
+
+TEST_F(TestParentCache, FilePermissions) {
+  librbd::ParentCache cache(g_ceph_context);
+  ASSERT_EQ(0, cache.init(FSID));
+  cache.write(1, "image", 2, 3, object('a', 4096));
+  cache.flush();
+
+  struct stat st;
+  ASSERT_EQ(0, ::stat(file_path(3).c_str(), &st));
+  ASSERT_EQ(0600, st.st_mode & 0777);
+  ASSERT_EQ(4096, st.st_size - 16);
+}
+
+TEST_F(TestParentCache, TruncatedFileIsEvicted) {
+  librbd::ParentCache cache(g_ceph_context);
+  ASSERT_EQ(0, cache.init(FSID));
+  cache.write(1, "image", 2, 3, object('a', 4096));
+  cache.flush();
+
+  ASSERT_EQ(0, ::truncate(file_path(3).c_str(), 1000));
+
+  bufferlist bl;
+  ASSERT_FALSE(cache.read(1, "image", 2, 3, 0, 4096, &bl));
+  ASSERT_EQ(0u, bl.length());
+
+  // it was dropped, so it can be stored again
+  cache.write(1, "image", 2, 3, object('b', 4096));
+  cache.flush();
+  ASSERT_TRUE(cache.read(1, "image", 2, 3, 0, 4096, &bl));
+  ASSERT_TRUE(object('b', 4096).contents_equal(bl));
+}
+
+TEST_F(TestParentCache, Eviction) {
+  // room for two objects and their headers, but not three
+  g_ceph_context->_conf->set_val("rbd_parent_cache_size", "10000");
+  librbd::ParentCache cache(g_ceph_context);
+  ASSERT_EQ(0, cache.init(FSID));
+
+  bufferlist bl;
+  cache.write(1, "image", 2, 0, object('a', 4096));
+  cache.write(1, "image", 2, 1, object('b', 4096));
+  cache.flush();
+
+  // eviction rescans the directory and goes by mtime, which has only
+  // second granularity: age the files so that the order is known
+  struct timeval tv[2] = { { 1000, 0 }, { 1000, 0 } };
+  ASSERT_EQ(0, ::utimes(file_path(0).c_str(), tv));
+  tv[0].tv_sec = tv[1].tv_sec = 2000;
+  ASSERT_EQ(0, ::utimes(file_path(1).c_str(), tv));
+
+  // reading object 0 makes object 1 the least recently used
+  ASSERT_TRUE(cache.read(1, "image", 2, 0, 0, 4096, &bl));
+
+  cache.write(1, "image", 2, 2, object('c', 4096));
+  cache.flush();
+
+  bl.clear();
+  ASSERT_TRUE(cache.read(1, "image", 2, 0, 0, 4096, &bl));
+  ASSERT_TRUE(object('a', 4096).contents_equal(bl));
+  bl.clear();
+  ASSERT_FALSE(cache.read(1, "image", 2, 1, 0, 4096, &bl));
+  ASSERT_TRUE(cache.read(1, "image", 2, 2, 0, 4096, &bl));
+  ASSERT_TRUE(object('c', 4096).contents_equal(bl));
+}
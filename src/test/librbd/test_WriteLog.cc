@@ -0,0 +1,189 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#include "test/librbd/test_fixture.h"
+#include "test/librbd/test_support.h"
+#include "common/Cond.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/ImageWatcher.h"
+#include "librbd/internal.h"
+#include "librbd/WriteLog.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+void register_test_write_log() {
+}
+
+class TestWriteLog : public TestFixture {
+public:
+  static const uint64_t LOG_SIZE = 4 << 20;
+
+  std::string m_dir;
+  std::string m_path;
+
+  virtual void SetUp() {
+    TestFixture::SetUp();
+    char tmpl[] = "/tmp/test_write_log.XXXXXX";
+    ASSERT_TRUE(mkdtemp(tmpl) != NULL);
+    m_dir = tmpl;
+    m_path = m_dir + "/log";
+  }
+
+  virtual void TearDown() {
+    ::unlink(m_path.c_str());
+    ::rmdir(m_dir.c_str());
+    TestFixture::TearDown();
+  }
+
+  int append_write(librbd::WriteLog &log, uint64_t off, char c, size_t len) {
+    std::string data(len, c);
+    C_SaferCond ctx;
+    log.append_write(off, data.c_str(), len, 0, &ctx);
+    return ctx.wait();
+  }
+
+  int lock(librbd::ImageCtx *ictx) {
+    RWLock::WLocker owner_locker(ictx->owner_lock);
+    return ictx->image_watcher->try_lock();
+  }
+
+  int claim(librbd::ImageCtx *ictx, const std::string &uuid) {
+    bufferlist bl;
+    bl.append(uuid);
+    return ictx->md_ctx.setxattr(ictx->header_oid, librbd::WriteLog::XATTR,
+				 bl);
+  }
+
+  std::string read(librbd::ImageCtx *ictx, uint64_t off, size_t len) {
+    std::string data(len, '\0');
+    if (librbd::read(ictx, off, len, &data[0], 0) != (ssize_t)len) {
+      return "";
+    }
+    return data;
+  }
+};
+
+TEST_F(TestWriteLog, DestageError) {
+  REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  // without the exclusive lock nothing can be destaged
+  librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+  ASSERT_EQ(0, log.init());
+  ASSERT_EQ(0, append_write(log, 0, 'a', 4096));
+  ASSERT_EQ(-ESHUTDOWN, log.flush());
+
+  // the record is kept, and reads that overlap it are failed
+  std::vector<std::pair<uint64_t,uint64_t> > extents;
+  extents.push_back(std::make_pair(0, 512));
+  ASSERT_TRUE(log.is_dirty(extents));
+  C_SaferCond read_ctx;
+  ASSERT_TRUE(log.wait_for_overlap(extents, &read_ctx));
+  ASSERT_EQ(-ESHUTDOWN, read_ctx.wait());
+
+  // once the lock is back, flush retries it
+  ASSERT_EQ(0, lock(ictx));
+  ASSERT_EQ(0, log.flush());
+  ASSERT_FALSE(log.is_dirty(extents));
+  log.shut_down();
+
+  ASSERT_EQ(std::string(4096, 'a'), read(ictx, 0, 4096));
+}
+
+TEST_F(TestWriteLog, Replay) {
+  REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  std::string uuid;
+  {
+    librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+    ASSERT_EQ(0, log.init());
+    uuid = log.get_uuid();
+    ASSERT_EQ(0, append_write(log, 0, 'a', 4096));
+    ASSERT_EQ(0, append_write(log, 8192, 'b', 4096));
+    // left in the log, as if the client had crashed
+    log.shut_down();
+  }
+  ASSERT_EQ(std::string(4096, '\0'), read(ictx, 0, 4096));
+
+  ASSERT_EQ(0, lock(ictx));
+  ASSERT_EQ(0, claim(ictx, uuid));
+
+  librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+  ASSERT_EQ(0, log.init());
+  ASSERT_NE(uuid, log.get_uuid());
+  log.shut_down();
+
+  ASSERT_EQ(std::string(4096, 'a'), read(ictx, 0, 4096));
+  ASSERT_EQ(std::string(4096, 'b'), read(ictx, 8192, 4096));
+}
+
+TEST_F(TestWriteLog, DiscardWhenLockedByOthers) {
+  REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  {
+    librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+    ASSERT_EQ(0, log.init());
+    ASSERT_EQ(0, append_write(log, 0, 'a', 4096));
+    log.shut_down();
+  }
+
+  // another client's log claimed the image, and taking the lock
+  // without a log drops that claim ...
+  ASSERT_EQ(0, claim(ictx, "some-other-log"));
+  ASSERT_EQ(0, lock(ictx));
+  bufferlist bl;
+  ASSERT_EQ(-ENODATA, ictx->md_ctx.getxattr(ictx->header_oid,
+					    librbd::WriteLog::XATTR, bl));
+
+  // ... and this log, which nobody claimed, is thrown away
+  librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+  ASSERT_EQ(0, log.init());
+  log.shut_down();
+  ASSERT_EQ(std::string(4096, '\0'), read(ictx, 0, 4096));
+}
+
+TEST_F(TestWriteLog, ReplayAfterDiscardIgnoresStaleRecords) {
+  REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  {
+    librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+    ASSERT_EQ(0, log.init());
+    ASSERT_EQ(0, append_write(log, 0, 'a', 4096));
+    ASSERT_EQ(0, append_write(log, 8192, 'b', 4096));
+    log.shut_down();
+  }
+
+  // discarded: the new log overwrites the first stale record exactly
+  // and stops in front of the second one
+  std::string uuid;
+  {
+    librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+    ASSERT_EQ(0, log.init());
+    uuid = log.get_uuid();
+    ASSERT_EQ(0, append_write(log, 0, 'c', 4096));
+    log.shut_down();
+  }
+
+  ASSERT_EQ(0, lock(ictx));
+  ASSERT_EQ(0, claim(ictx, uuid));
+
+  librbd::WriteLog log(*ictx, m_path, LOG_SIZE, 1);
+  ASSERT_EQ(0, log.init());
+  log.shut_down();
+
+  ASSERT_EQ(std::string(4096, 'c'), read(ictx, 0, 4096));
+  ASSERT_EQ(std::string(4096, '\0'), read(ictx, 8192, 4096));
+}
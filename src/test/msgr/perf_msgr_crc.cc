@@ -0,0 +1,155 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Measure the cost of messenger framing crcs: the sender encoding a
+ * MOSDOp, and the receiver verifying it either by walking the segments
+ * after they have all been read (the old way), or by crc'ing each chunk
+ * as it is read off the wire and handing the result to decode_message().
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+#include "common/ceph_argparse.h"
+#include "common/debug.h"
+#include "common/Cycles.h"
+#include "include/crc32c.h"
+#include "common/sctp_crc32.h"
+#include "global/global_init.h"
+#include "msg/Message.h"
+#include "messages/MOSDOp.h"
+
+static void report(const char *what, uint64_t cycles, int iterations,
+		   uint64_t bytes)
+{
+  double us = Cycles::to_microseconds(cycles);
+  cerr << "  " << what << ": " << (us * 1000 / iterations) << " ns/msg, "
+       << (bytes * iterations / us) << " MB/s" << std::endl;
+}
+
+/// copy a segment "off the wire" into chunk sized buffers
+static void receive(const bufferlist& wire, unsigned chunk, bufferlist& out,
+		    __u32 *crc)
+{
+  bufferptr bp(wire.length());
+  unsigned off = 0;
+  while (off < wire.length()) {
+    unsigned len = MIN(chunk, wire.length() - off);
+    wire.copy(off, len, bp.c_str() + off);
+    if (crc)
+      *crc = ceph_crc32c(*crc, (unsigned char*)bp.c_str() + off, len);
+    off += len;
+  }
+  out.push_back(bp);
+}
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [data length] [iterations] [chunk]" << std::endl;
+  cerr << "       [data length]: MOSDOp write payload bytes" << std::endl;
+  cerr << "       [iterations]: messages encoded and decoded per test" << std::endl;
+  cerr << "       [chunk]: bytes per simulated socket read" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  if (args.size() < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  unsigned len = atoi(args[0]);
+  int iterations = atoi(args[1]);
+  unsigned chunk = atoi(args[2]);
+  if (!len || iterations <= 0 || !chunk) {
+    usage(argv[0]);
+    return 1;
+  }
+  cerr << " crc32c implementation "
+       << (ceph_crc32c_func == ceph_crc32c_sctp ? "sctp" : "accelerated")
+       << std::endl;
+  cerr << " data length " << len << " iterations " << iterations
+       << " chunk " << chunk << std::endl;
+
+  object_t oid("object-name");
+  object_locator_t oloc(1, 1);
+  pg_t pgid;
+  bufferptr bp(len);
+  memset(bp.c_str(), 0x5a, len);
+  bufferlist data;
+  data.append(bp);
+  uint64_t features = CEPH_FEATURES_ALL;
+
+  // sender: encode and crc all segments
+  MOSDOp *m = NULL;
+  uint64_t start = Cycles::rdtsc();
+  for (int i = 0; i < iterations; ++i) {
+    if (m)
+      m->put();
+    m = new MOSDOp(0, i, oid, oloc, pgid, 0, 0, features);
+    m->write(0, len, data);
+    data.invalidate_crc();
+    m->encode(features, MSG_CRC_ALL);
+  }
+  report("tx encode", Cycles::rdtsc() - start, iterations, len);
+
+  ceph_msg_header header = m->get_header();
+  ceph_msg_footer footer = m->get_footer();
+  bufferlist front = m->get_payload();
+  bufferlist middle = m->get_middle();
+  bufferlist wire_data = m->get_data();
+  m->put();
+
+  // receiver: read everything, then walk all segments to verify
+  start = Cycles::rdtsc();
+  for (int i = 0; i < iterations; ++i) {
+    bufferlist f, mi, d;
+    receive(front, chunk, f, NULL);
+    receive(middle, chunk, mi, NULL);
+    receive(wire_data, chunk, d, NULL);
+    Message *r = decode_message(g_ceph_context, MSG_CRC_ALL, header, footer,
+				f, mi, d);
+    assert(r);
+    r->put();
+  }
+  report("rx read then walk", Cycles::rdtsc() - start, iterations, len);
+
+  // receiver: crc each chunk as it arrives
+  start = Cycles::rdtsc();
+  for (int i = 0; i < iterations; ++i) {
+    bufferlist f, mi, d;
+    msg_rx_crcs_t crcs;
+    crcs.have_front = crcs.have_data = true;
+    receive(front, chunk, f, &crcs.front_crc);
+    receive(middle, chunk, mi, &crcs.middle_crc);
+    receive(wire_data, chunk, d, &crcs.data_crc);
+    Message *r = decode_message(g_ceph_context, MSG_CRC_ALL, header, footer,
+				f, mi, d, &crcs);
+    assert(r);
+    r->put();
+  }
+  report("rx crc while reading", Cycles::rdtsc() - start, iterations, len);
+
+  return 0;
+}
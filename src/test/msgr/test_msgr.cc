@@ -1037,6 +1037,50 @@ bool SyntheticDispatcher::ms_handle_reset(Connection *con) {
   return true;
 }
 
+TEST_P(MessengerTest, PeerLatencyTest) {
+  g_ceph_context->_conf->set_val("ms_track_peer_latency", "true");
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("127.0.0.1");
+  Messenger::Policy p = Messenger::Policy::stateful_server(0, 0);
+  server_msgr->set_policy(entity_name_t::TYPE_CLIENT, p);
+  p = Messenger::Policy::lossless_client(0, 0);
+  client_msgr->set_policy(entity_name_t::TYPE_OSD, p);
+
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->get_connection(server_msgr->get_myinst());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(conn->send_message(new MPing()), 0);
+    Mutex::Locker l(cli_dispatcher.lock);
+    while (!cli_dispatcher.got_new)
+      cli_dispatcher.cond.Wait(cli_dispatcher.lock);
+    cli_dispatcher.got_new = false;
+  }
+  uint64_t count = 0;
+  conn->get_latency_at_micro(Connection::LAT_SEND_QUEUE, 990000, &count);
+  ASSERT_EQ(10u, count);
+  // every reply was dispatched to us
+  ASSERT_LE(0, conn->get_latency_at_micro(Connection::LAT_DISPATCH, 990000,
+					  &count));
+  ASSERT_EQ(10u, count);
+  // acks may trail the replies
+  CHECK_AND_WAIT_TRUE(
+    conn->get_latency_at_micro(Connection::LAT_WIRE, 990000, &count) >= 0 &&
+    count == 10);
+  ASSERT_EQ(10u, count);
+
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+  g_ceph_context->_conf->set_val("ms_track_peer_latency", "false");
+}
+
 TEST_P(MessengerTest, SyntheticStressTest) {
   SyntheticWorkload test_msg(8, 32, GetParam(), 100,
                              Messenger::Policy::stateful_server(0, 0),
@@ -1095,6 +1139,37 @@ TEST_P(MessengerTest, SyntheticStressTest1) {
   test_msg.wait_for_done();
 }
 
+TEST_P(MessengerTest, SyntheticCompressTest) {
+  g_ceph_context->_conf->set_val("ms_async_compress_min_size", "4096");
+  SyntheticWorkload test_msg(8, 32, GetParam(), 100,
+                             Messenger::Policy::stateful_server(0, 0),
+                             Messenger::Policy::lossless_client(0, 0));
+  for (int i = 0; i < 100; ++i) {
+    if (!(i % 10)) cerr << "seeding connection " << i << std::endl;
+    test_msg.generate_connection();
+  }
+  gen_type rng(time(NULL));
+  for (int i = 0; i < 1000; ++i) {
+    if (!(i % 10)) {
+      cerr << "Op " << i << ": ";
+      test_msg.print_internal_state();
+    }
+    boost::uniform_int<> true_false(0, 99);
+    int val = true_false(rng);
+    if (val > 90) {
+      test_msg.generate_connection();
+    } else if (val > 80) {
+      test_msg.drop_connection();
+    } else if (val > 10) {
+      test_msg.send_message();
+    } else {
+      usleep(rand() % 1000 + 500);
+    }
+  }
+  test_msg.wait_for_done();
+  g_ceph_context->_conf->set_val("ms_async_compress_min_size", "0");
+}
+
 
 TEST_P(MessengerTest, SyntheticInjectTest) {
   g_ceph_context->_conf->set_val("ms_inject_socket_failures", "30");
@@ -42,7 +42,21 @@ class Transaction {
     }
   };
   static Tick write_ticks, setattr_ticks, omap_setkeys_ticks, omap_rmkeys_ticks;
-  static Tick encode_ticks, decode_ticks, iterate_ticks;
+  static Tick encode_ticks, decode_ticks, iterate_ticks, append_ticks;
+  static bool use_tbl;
+
+  Transaction() {
+    t.set_use_tbl(use_tbl);
+  }
+
+  void reserve_ops(unsigned n) {
+    t.reserve_ops(n);
+  }
+  void append(Transaction &other) {
+    uint64_t start_time = Cycles::rdtsc();
+    t.append(other.t);
+    append_ticks.add(Cycles::rdtsc() - start_time);
+  }
 
   void write(coll_t cid, const ghobject_t& oid, uint64_t off, uint64_t len,
              const bufferlist& data) {
@@ -138,6 +152,7 @@ class Transaction {
     cerr << " encode op: " << Cycles::to_microseconds(Transaction::encode_ticks.ticks) << "us count: " << Transaction::encode_ticks.count << std::endl;
     cerr << " decode op: " << Cycles::to_microseconds(Transaction::decode_ticks.ticks) << "us count: " << Transaction::decode_ticks.count << std::endl;
     cerr << " iterate op: " << Cycles::to_microseconds(Transaction::iterate_ticks.ticks) << "us count: " << Transaction::iterate_ticks.count << std::endl;
+    cerr << " append op: " << Cycles::to_microseconds(Transaction::append_ticks.ticks) << "us count: " << Transaction::append_ticks.count << std::endl;
   }
 };
 
@@ -227,6 +242,34 @@ class PerfCase {
     }
     return ticks;
   }
+
+  // what a replicated write does: the object update and the pg log /
+  // info update are built separately, then merged into one transaction
+  uint64_t replicated_write_4k(int times) {
+    uint64_t ticks = 0;
+    uint64_t len = Kib *4;
+    for (int i = 0; i < times; i++) {
+      Transaction op_t, log_t;
+      ghobject_t oid = create_object();
+      map<string, bufferlist> pglog_attrset;
+      map<string, bufferlist> info_attrset;
+      pglog_attrset[pglog_attr] = data[pglog_attr];
+      info_attrset[info_epoch_attr] = data[info_epoch_attr];
+      info_attrset[info_info_attr] = data[info_info_attr];
+      uint64_t start_time = Cycles::rdtsc();
+      op_t.reserve_ops(5);
+      op_t.write(cid, oid, 0, len, data["4k"]);
+      op_t.setattr(cid, oid, attr, data[attr]);
+      op_t.setattr(cid, oid, snapset_attr, data[snapset_attr]);
+      log_t.omap_setkeys(meta_cid, pglog_oid, pglog_attrset);
+      log_t.omap_setkeys(meta_cid, info_oid, info_attrset);
+      op_t.append(log_t);
+      op_t.apply_encode_decode();
+      op_t.apply_iterate();
+      ticks += Cycles::rdtsc() - start_time;
+    }
+    return ticks;
+  }
 };
 const string PerfCase::info_epoch_attr("11.40_epoch");
 const string PerfCase::info_info_attr("11.40_info");
@@ -238,10 +281,12 @@ const coll_t PerfCase::cid;
 const ghobject_t PerfCase::pglog_oid(hobject_t(sobject_t(object_t("cid_pglog"), 0)));
 const ghobject_t PerfCase::info_oid(hobject_t(sobject_t(object_t("infos"), 0)));
 Transaction::Tick Transaction::write_ticks, Transaction::setattr_ticks, Transaction::omap_setkeys_ticks, Transaction::omap_rmkeys_ticks;
-Transaction::Tick Transaction::encode_ticks, Transaction::decode_ticks, Transaction::iterate_ticks;
+Transaction::Tick Transaction::encode_ticks, Transaction::decode_ticks, Transaction::iterate_ticks, Transaction::append_ticks;
+bool Transaction::use_tbl = false;
 
 void usage(const string &name) {
-  cerr << "Usage: " << name << " [times] "
+  cerr << "Usage: " << name << " [times] [tbl]\n"
+       << "  tbl: use the old single buffer layout, for comparison"
        << std::endl;
 }
 
@@ -261,10 +306,15 @@ int main(int argc, char **argv)
   }
 
   uint64_t times = atoi(args[0]);
+  if (args.size() > 1 && string(args[1]) == "tbl")
+    Transaction::use_tbl = true;
   PerfCase c;
   uint64_t ticks = c.rados_write_4k(times);
   Transaction::dump_stat();
   cerr << " Total rados op " << times << " run time " << Cycles::to_microseconds(ticks) << "us." << std::endl;
+  ticks = c.replicated_write_4k(times);
+  Transaction::dump_stat();
+  cerr << " Total replicated op " << times << " run time " << Cycles::to_microseconds(ticks) << "us." << std::endl;
 
   return 0;
 }
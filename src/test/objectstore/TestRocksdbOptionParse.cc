@@ -74,6 +74,66 @@ TEST(RocksDBOption, interpret) {
   ASSERT_EQ(5, num_high_pri_threads);
 }
 
+TEST(RocksDBOption, column_families) {
+  RocksDBStore *db = new RocksDBStore(g_ceph_context, dir);
+  ASSERT_EQ(0, db->set_column_families(""));
+  ASSERT_EQ(0, db->set_column_families(
+	      "L:compaction_style=kCompactionStyleUniversal "
+	      "O:write_buffer_size=1048576;max_write_buffer_number=2 M"));
+  // names must not nest, repeat, or be the default family
+  ASSERT_EQ(-EINVAL, db->set_column_families("O OM"));
+  ASSERT_EQ(-EINVAL, db->set_column_families("O O"));
+  ASSERT_EQ(-EINVAL, db->set_column_families("default"));
+  ASSERT_EQ(-EINVAL, db->set_column_families("O:no_such_option=1"));
+  delete db;
+}
+
+TEST(RocksDBOption, column_families_rw) {
+  string cfdir = dir + ".cf";
+  ::system(("rm -rf " + cfdir).c_str());
+  for (int round = 0; round < 2; ++round) {
+    RocksDBStore *db = new RocksDBStore(g_ceph_context, cfdir);
+    ASSERT_EQ(0, db->init(""));
+    ASSERT_EQ(0, db->set_column_families("O L:write_buffer_size=1048576"));
+    ASSERT_EQ(0, db->create_and_open(cerr));
+    if (round == 0) {
+      KeyValueDB::Transaction t = db->get_transaction();
+      bufferlist bl;
+      bl.append("v");
+      t->set("A", "a", bl);
+      t->set("L", "l", bl);
+      t->set("OMAP", "o", bl);
+      t->set("Z", "z", bl);
+      ASSERT_EQ(0, db->submit_transaction_sync(t));
+    }
+    bufferlist out;
+    ASSERT_EQ(0, db->get("OMAP", "o", &out));
+    ASSERT_EQ(0, db->get("L", "l", &out));
+    ASSERT_EQ(-ENOENT, db->get("L", "x", &out));
+
+    // the whole keyspace comes back in order across families
+    KeyValueDB::WholeSpaceIterator it = db->get_iterator();
+    vector<string> prefixes;
+    for (it->seek_to_first(); it->valid(); it->next())
+      prefixes.push_back(it->raw_key().first);
+    ASSERT_EQ(4u, prefixes.size());
+    ASSERT_EQ("A", prefixes[0]);
+    ASSERT_EQ("L", prefixes[1]);
+    ASSERT_EQ("OMAP", prefixes[2]);
+    ASSERT_EQ("Z", prefixes[3]);
+    it->seek_to_last();
+    ASSERT_EQ("Z", it->raw_key().first);
+    it->prev();
+    ASSERT_EQ("OMAP", it->raw_key().first);
+    it->prev();
+    ASSERT_EQ("L", it->raw_key().first);
+    it->next();
+    ASSERT_EQ("OMAP", it->raw_key().first);
+    delete db;
+  }
+  ::system(("rm -rf " + cfdir).c_str());
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -417,6 +417,25 @@ TEST_P(StoreTest, SimpleObjectTest) {
     ASSERT_EQ((int)bl.length(), r);
     in.hexdump(cout);
     ASSERT_TRUE(in.contents_equal(bl));
+
+    cerr << "read_into" << std::endl;
+    bufferptr bp(20);
+    r = store->read_into(cid, hoid, 5, 20, bp);
+    ASSERT_EQ(20, r);
+    ASSERT_EQ(0, memcmp(bp.c_str(), bl.c_str() + 5, 20));
+
+    // short read past the end of the object
+    bufferptr big(1000);
+    r = store->read_into(cid, hoid, 0, 1000, big);
+    ASSERT_EQ((int)bl.length(), r);
+    ASSERT_EQ(0, memcmp(big.c_str(), bl.c_str(), r));
+
+    cerr << "read_async" << std::endl;
+    bufferlist abl;
+    C_SaferCond c;
+    store->read_async(cid, hoid, 5, 20, &abl, 0, &c);
+    ASSERT_EQ(20, c.wait());
+    ASSERT_EQ(0, memcmp(abl.c_str(), bl.c_str() + 5, 20));
   }
   {
     ObjectStore::Transaction t;
@@ -468,6 +487,89 @@ TEST_P(StoreTest, ManySmallWrite) {
   }
 }
 
+TEST_P(StoreTest, SmallSequentialWrite) {
+  ObjectStore::Sequencer osr("test");
+  int r;
+  coll_t cid;
+  ghobject_t a(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    cerr << "Creating collection " << cid << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  // many small appends, each landing in a strip written just before
+  bufferlist expected;
+  for (int i=0; i<64; ++i) {
+    bufferlist bl;
+    bl.append(string(100, 'a' + i % 26));
+    ObjectStore::Transaction t;
+    t.write(cid, a, expected.length(), bl.length(), bl, 0);
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+    expected.append(bl);
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, a, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_TRUE(in.contents_equal(expected));
+  }
+  // overlapping writes within one transaction
+  {
+    bufferlist x, y;
+    x.append(string(300, 'x'));
+    y.append(string(50, 'y'));
+    ObjectStore::Transaction t;
+    t.write(cid, a, 1000, x.length(), x, 0);
+    t.write(cid, a, 1100, y.length(), y, 0);
+    t.zero(cid, a, 1200, 10);
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+
+    bufferlist e;
+    expected.copy(0, 1000, e);
+    e.append(string(100, 'x'));
+    e.append(string(50, 'y'));
+    e.append(string(50, 'x'));
+    e.append_zero(10);
+    e.append(string(90, 'x'));
+    expected.copy(1300, expected.length() - 1300, e);
+    expected.swap(e);
+
+    bufferlist in;
+    r = store->read(cid, a, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_TRUE(in.contents_equal(expected));
+  }
+  // a recreated object must not see the old data
+  {
+    bufferlist bl;
+    bl.append("new");
+    ObjectStore::Transaction t;
+    t.remove(cid, a);
+    t.write(cid, a, 4000, bl.length(), bl, 0);
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+
+    bufferlist in, e;
+    e.append_zero(4000);
+    e.append(bl);
+    r = store->read(cid, a, 0, 4003, in);
+    ASSERT_EQ(4003, r);
+    ASSERT_TRUE(in.contents_equal(e));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, a);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, SimpleAttrTest) {
   ObjectStore::Sequencer osr("test");
   int r;
@@ -878,6 +980,218 @@ TEST_P(StoreTest, SimpleCloneRangeTest) {
 }
 
 
+TEST_P(StoreTest, SparseReadTest) {
+  ObjectStore::Sequencer osr("test");
+  int r;
+  coll_t cid;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    cerr << "Creating collection " << cid << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  hoid.hobj.pool = -1;
+  bufferlist a, b;
+  a.append(string(4096, 'a'));
+  b.append(string(8192, 'b'));
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, a.length(), a);
+    t.write(cid, hoid, 4 << 20, b.length(), b);
+    cerr << "Writing two extents with a hole between" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  {
+    // the extents, laid back over zeros, must give what a plain read does
+    uint64_t size = (4 << 20) + b.length();
+    map<uint64_t, uint64_t> m;
+    bufferlist data;
+    r = store->sparse_read(cid, hoid, 0, 8 << 20, m, data);
+    ASSERT_GT(r, 0);
+    ASSERT_EQ((unsigned)r, data.length());
+    bufferlist expected;
+    r = store->read(cid, hoid, 0, size, expected);
+    ASSERT_EQ((int)size, r);
+
+    string rebuilt(size, '\0');
+    uint64_t pos = 0, end = 0;
+    for (map<uint64_t, uint64_t>::iterator p = m.begin(); p != m.end(); ++p) {
+      ASSERT_LE(end, p->first);
+      ASSERT_LE(p->first + p->second, size);
+      data.copy(pos, p->second, &rebuilt[p->first]);
+      pos += p->second;
+      end = p->first + p->second;
+    }
+    ASSERT_EQ(pos, data.length());
+    ASSERT_EQ(size, end);
+    ASSERT_EQ(0, memcmp(rebuilt.data(), expected.c_str(), size));
+
+    // nothing past the end
+    m.clear();
+    data.clear();
+    r = store->sparse_read(cid, hoid, size, 4096, m, data);
+    ASSERT_EQ(0, r);
+    ASSERT_TRUE(m.empty());
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTest, SmallObjectGrowTest) {
+  ObjectStore::Sequencer osr("test");
+  int r;
+  coll_t cid;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    cerr << "Creating collection " << cid << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  hoid.hobj.pool = -1;
+  string expected(300, 'a');
+  {
+    // small enough to be kept inline by stores that do that
+    bufferlist a, b;
+    a.append(string(300, 'a'));
+    b.append(string(50, 'b'));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, a.length(), a);
+    t.write(cid, hoid, 100, b.length(), b);
+    t.zero(cid, hoid, 120, 10);
+    t.truncate(cid, hoid, 200);
+    t.truncate(cid, hoid, 250);
+    cerr << "Writing, zeroing and truncating a small object" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+    expected.replace(100, 50, string(50, 'b'));
+    expected.replace(120, 10, string(10, '\0'));
+    expected.resize(200);
+    expected.resize(250, '\0');
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, hoid, 0, 1000, in);
+    ASSERT_EQ(250, r);
+    ASSERT_EQ(expected, string(in.c_str(), in.length()));
+  }
+  {
+    // grow it well past any inline limit
+    bufferlist c;
+    c.append(string(100000, 'c'));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 1000, c.length(), c);
+    cerr << "Growing it" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+    expected.resize(1000, '\0');
+    expected.append(string(100000, 'c'));
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, hoid, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_EQ(expected, string(in.c_str(), in.length()));
+    struct stat st;
+    ASSERT_EQ(0, store->stat(cid, hoid, &st));
+    ASSERT_EQ((off_t)expected.length(), st.st_size);
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTest, CompressibleObjectTest) {
+  if (GetParam() == string("newstore")) {
+    g_ceph_context->_conf->set_val("newstore_compression", "snappy");
+    g_ceph_context->_conf->apply_changes(NULL);
+    store->umount();
+    ASSERT_EQ(0, store->mount());
+  }
+  ObjectStore::Sequencer osr("test");
+  int r;
+  coll_t cid;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+  string expected;
+  for (int i = 0; expected.length() < 200000; ++i)
+    expected += stringify(i) + " ";
+  {
+    bufferlist bl;
+    bl.append(expected);
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    cerr << "Writing a compressible object" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, hoid, 1000, 5000, in);
+    ASSERT_EQ(5000, r);
+    ASSERT_EQ(expected.substr(1000, 5000), string(in.c_str(), in.length()));
+    struct stat st;
+    ASSERT_EQ(0, store->stat(cid, hoid, &st));
+    ASSERT_EQ((off_t)expected.length(), st.st_size);
+  }
+  {
+    bufferlist b;
+    b.append(string(100, 'b'));
+    ObjectStore::Transaction t;
+    t.clone(cid, hoid, hoid2);
+    t.write(cid, hoid, 500, b.length(), b);
+    t.truncate(cid, hoid2, 150000);
+    cerr << "Cloning, overwriting part of it and truncating" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, hoid2, 0, expected.length(), in);
+    ASSERT_EQ(150000, r);
+    ASSERT_EQ(expected.substr(0, 150000), string(in.c_str(), in.length()));
+    expected.replace(500, 100, string(100, 'b'));
+    in.clear();
+    r = store->read(cid, hoid, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_EQ(expected, string(in.c_str(), in.length()));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = store->apply_transaction(&osr, t);
+    ASSERT_EQ(r, 0);
+  }
+  if (GetParam() == string("newstore")) {
+    g_ceph_context->_conf->set_val("newstore_compression", "");
+    g_ceph_context->_conf->apply_changes(NULL);
+  }
+}
+
 TEST_P(StoreTest, SimpleObjectLongnameTest) {
   ObjectStore::Sequencer osr("test");
   int r;
@@ -2571,6 +2885,65 @@ TEST(DummyTest, ValueParameterizedTestsAreNotSupportedOnThisPlatform) {}
 #endif
 
 
+TEST(FileStoreTest, SyncDirtyOnlyClone) {
+  // with filestore_sync_dirty_only, a clone into an existing object must
+  // be fsynced by the next commit like any other write to it
+  g_ceph_context->_conf->set_val("filestore_sync_dirty_only", "true");
+  // keep the periodic commit from racing with the checks
+  g_ceph_context->_conf->set_val("filestore_max_sync_interval", "1000");
+  g_ceph_context->_conf->apply_changes(NULL);
+  const string dir("store_test_temp_dir");
+  int r = ::mkdir(dir.c_str(), 0777);
+  ASSERT_TRUE(r == 0 || errno == EEXIST);
+  {
+    FileStore store(dir, "store_test_temp_journal");
+    ASSERT_EQ(0, store.mkfs());
+    ASSERT_EQ(0, store.mount());
+    ObjectStore::Sequencer osr("test");
+    coll_t cid;
+    ghobject_t a(hobject_t(sobject_t("a", CEPH_NOSNAP)));
+    ghobject_t b(hobject_t(sobject_t("b", CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append("abcdefgh");
+    {
+      ObjectStore::Transaction t;
+      t.create_collection(cid, 0);
+      t.write(cid, a, 0, bl.length(), bl);
+      t.write(cid, b, 0, bl.length(), bl);
+      ASSERT_EQ(0, store.apply_transaction(&osr, t));
+    }
+    store.sync_and_flush();
+    ASSERT_FALSE(store._is_dirty(b));
+    {
+      ObjectStore::Transaction t;
+      t.clone(cid, a, b);
+      ASSERT_EQ(0, store.apply_transaction(&osr, t));
+    }
+    ASSERT_TRUE(store._is_dirty(b));
+    store.sync_and_flush();
+    ASSERT_FALSE(store._is_dirty(b));
+    {
+      ObjectStore::Transaction t;
+      t.clone_range(cid, a, b, 0, 4, 4);
+      ASSERT_EQ(0, store.apply_transaction(&osr, t));
+    }
+    ASSERT_TRUE(store._is_dirty(b));
+    store.sync_and_flush();
+    ASSERT_FALSE(store._is_dirty(b));
+    {
+      ObjectStore::Transaction t;
+      t.remove(cid, a);
+      t.remove(cid, b);
+      t.remove_collection(cid);
+      ASSERT_EQ(0, store.apply_transaction(&osr, t));
+    }
+    store.umount();
+  }
+  g_ceph_context->_conf->set_val("filestore_sync_dirty_only", "false");
+  g_ceph_context->_conf->set_val("filestore_max_sync_interval", "5");
+  g_ceph_context->_conf->apply_changes(NULL);
+}
+
 //
 // support tests for qa/workunits/filestore/filestore.sh
 //
@@ -18,6 +18,7 @@
 #include <time.h>
 #include <sys/mount.h>
 #include "os/KeyValueDB.h"
+#include "os/KVCompactionTracker.h"
 #include "include/Context.h"
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
@@ -164,6 +165,56 @@ TEST(DummyTest, ValueParameterizedTestsAreNotSupportedOnThisPlatform) {}
 
 #endif
 
+TEST(KVCompactionTracker, Pick) {
+  KVCompactionTracker t;
+  string prefix;
+  ASSERT_FALSE(t.pick(1, &prefix));
+
+  map<string, uint64_t> d;
+  d["a"] = 10;
+  d["b"] = 30;
+  t.add(d);
+  t.add(d);
+  ASSERT_EQ(80u, t.get_total());
+  ASSERT_FALSE(t.pick(100, &prefix));
+  ASSERT_TRUE(t.pick(60, &prefix));
+  ASSERT_EQ("b", prefix);
+
+  t.clear("b");
+  ASSERT_EQ(20u, t.get_total());
+  ASSERT_TRUE(t.pick(1, &prefix));
+  ASSERT_EQ("a", prefix);
+}
+
+TEST(KVCompactionTracker, Trim) {
+  KVCompactionTracker t;
+  map<string, uint64_t> d;
+  for (unsigned i = 0; i < KVCompactionTracker::MAX_PREFIXES; ++i)
+    d["p" + stringify(i)] = 1;
+  t.add(d);
+  ASSERT_EQ((uint64_t)KVCompactionTracker::MAX_PREFIXES, t.get_total());
+
+  // going over the limit forgets the prefix with the fewest deletions
+  d.clear();
+  d["busy"] = 1000;
+  t.add(d);
+  ASSERT_EQ((size_t)KVCompactionTracker::MAX_PREFIXES, t.size());
+  ASSERT_EQ(KVCompactionTracker::MAX_PREFIXES - 1 + 1000u, t.get_total());
+  string prefix;
+  ASSERT_TRUE(t.pick(1, &prefix));
+  ASSERT_EQ("busy", prefix);
+
+  // equal counts only lose as many as the limit needs
+  KVCompactionTracker e;
+  d.clear();
+  for (unsigned i = 0; i < KVCompactionTracker::MAX_PREFIXES + 10; ++i)
+    d["p" + stringify(i)] = 5;
+  e.add(d);
+  ASSERT_EQ((size_t)KVCompactionTracker::MAX_PREFIXES, e.size());
+  ASSERT_EQ(KVCompactionTracker::MAX_PREFIXES * 5u, e.get_total());
+  ASSERT_TRUE(e.pick(5, &prefix));
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
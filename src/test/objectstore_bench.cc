@@ -1,11 +1,14 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <algorithm>
 #include <chrono>
 #include <cassert>
 #include <condition_variable>
+#include <fstream>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <thread>
 
 #include "os/ObjectStore.h"
@@ -29,7 +32,17 @@ static void usage()
       "	 --threads\n"
       "	       number of threads to carry out this workload\n"
       "	 --multi-object\n"
-      "	       have each thread write to a separate object\n" << dendl;
+      "	       have each thread write to a separate object\n"
+      "	 --workload <write|randwrite|omap|xattr|clone|create>\n"
+      "	       what each op does with a block (default write):\n"
+      "	       write it sequentially or at a random offset, set it as\n"
+      "	       an omap value or an xattr, clone the object and then\n"
+      "	       write it, or create a new object of one block\n"
+      "	 --queue-depth\n"
+      "	       transactions each thread keeps in flight (default 0,\n"
+      "	       a whole write cycle at once)\n"
+      "	 --seed\n"
+      "	       seed for randwrite offsets\n" << dendl;
   generic_server_usage();
 }
 
@@ -66,18 +79,61 @@ std::ostream& operator<<(std::ostream &out, const byte_units &amount)
   return out << v << ' ' << units[unit];
 }
 
+enum Workload {
+  WL_WRITE,
+  WL_RANDWRITE,
+  WL_OMAP,
+  WL_XATTR,
+  WL_CLONE,
+  WL_CREATE,
+};
+
+static const char *workload_names[] = {
+  "write", "randwrite", "omap", "xattr", "clone", "create"
+};
+
 struct Config {
   byte_units size;
   byte_units block_size;
   int repeats;
   int threads;
   bool multi_object;
+  Workload workload;
+  int queue_depth;
+  unsigned seed;
   Config()
     : size(1048576), block_size(4096),
       repeats(1), threads(1),
-      multi_object(false) {}
+      multi_object(false), workload(WL_WRITE),
+      queue_depth(0), seed(0) {}
+};
+
+// what a worker saw: the commit latency of each transaction, in us
+struct Results {
+  // names what the worker creates apart from the other workers'
+  std::string prefix;
+  std::vector<double> latencies;
+  // objects the workload created, to remove afterwards
+  std::vector<ghobject_t> created;
 };
 
+// bytes this process had the kernel write to storage so far, from
+// /proc/self/io: the store's own threads included, so data, journal,
+// metadata and whatever a kv backend compacts
+static bool get_write_bytes(uint64_t *bytes)
+{
+  std::ifstream f("/proc/self/io");
+  std::string key;
+  uint64_t val;
+  while (f >> key >> val) {
+    if (key == "write_bytes:") {
+      *bytes = val;
+      return true;
+    }
+  }
+  return false;
+}
+
 class C_NotifyCond : public Context {
   std::mutex *mutex;
   std::condition_variable *cond;
@@ -92,9 +148,82 @@ public:
   }
 };
 
+// a transaction is done when it commits; count it then
+class C_Committed : public Context {
+  std::mutex *mutex;
+  std::condition_variable *cond;
+  int *in_flight;
+  Results *results;
+  std::chrono::high_resolution_clock::time_point start;
+public:
+  C_Committed(std::mutex *mutex, std::condition_variable *cond,
+              int *in_flight, Results *results)
+    : mutex(mutex), cond(cond), in_flight(in_flight), results(results),
+      start(std::chrono::high_resolution_clock::now()) {}
+  void finish(int r) {
+    using namespace std::chrono;
+    auto lat = duration_cast<microseconds>(high_resolution_clock::now() - start);
+    std::lock_guard<std::mutex> lock(*mutex);
+    results->latencies.push_back(lat.count());
+    --*in_flight;
+    cond->notify_one();
+  }
+};
+
+// one op of the workload: block number n of the cycle, at offset
+static void build_op(const Config &cfg, ObjectStore::Transaction *t,
+                     const coll_t &cid, const ghobject_t &oid,
+                     uint64_t n, uint64_t offset, bufferlist &data,
+                     Results *results)
+{
+  std::ostringstream name;
+  switch (cfg.workload) {
+  case WL_WRITE:
+  case WL_RANDWRITE:
+    t->write(cid, oid, offset, data.length(), data);
+    break;
+  case WL_OMAP:
+    {
+      name << "key." << offset;
+      map<string, bufferlist> kv;
+      kv[name.str()] = data;
+      t->omap_setkeys(cid, oid, kv);
+    }
+    break;
+  case WL_XATTR:
+    // a few names, overwritten over and over, like OSD attrs
+    name << "attr." << n % 16;
+    t->setattr(cid, oid, name.str().c_str(), data);
+    break;
+  case WL_CLONE:
+    {
+      // snapshot, then overwrite: the copy-on-write path
+      name << oid.hobj.oid.name << "." << results->prefix << ".clone."
+           << results->created.size();
+      ghobject_t clone(hobject_t(object_t(name.str()), "", CEPH_NOSNAP,
+                                 oid.hobj.get_hash(), oid.hobj.pool, ""));
+      t->clone(cid, oid, clone);
+      t->write(cid, oid, offset, data.length(), data);
+      results->created.push_back(clone);
+    }
+    break;
+  case WL_CREATE:
+    {
+      name << oid.hobj.oid.name << "." << results->prefix << ".obj."
+           << results->created.size();
+      ghobject_t obj(hobject_t(object_t(name.str()), "", CEPH_NOSNAP,
+                               results->created.size(), oid.hobj.pool, ""));
+      t->write(cid, obj, 0, data.length(), data);
+      results->created.push_back(obj);
+    }
+    break;
+  }
+}
+
 void osbench_worker(ObjectStore *os, const Config &cfg,
                     const coll_t cid, const ghobject_t oid,
-                    uint64_t starting_offset)
+                    uint64_t starting_offset, unsigned seed,
+                    Results *results)
 {
   bufferlist data;
   data.append(buffer::create(cfg.block_size));
@@ -106,20 +235,42 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
   assert(starting_offset % cfg.block_size == 0);
 
   ObjectStore::Sequencer sequencer("osbench");
+  std::mt19937 rng(seed);
+  uint64_t blocks = cfg.size / cfg.block_size;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  int in_flight = 0;
 
   for (int i = 0; i < cfg.repeats; ++i) {
     uint64_t offset = starting_offset;
     size_t len = cfg.size;
-
-    list<ObjectStore::Transaction*> tls;
+    uint64_t n = 0;
 
     std::cout << "Write cycle " << i << std::endl;
     while (len) {
       size_t count = len < cfg.block_size ? len : (size_t)cfg.block_size;
+      uint64_t op_offset = offset;
+      if (cfg.workload == WL_RANDWRITE && blocks > 0)
+        op_offset = (rng() % blocks) * cfg.block_size;
+
+      if (cfg.queue_depth > 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&](){ return in_flight < cfg.queue_depth; });
+      }
 
       auto t = new ObjectStore::Transaction;
-      t->write(cid, oid, offset, count, data);
-      tls.push_back(t);
+      bufferlist op_data;
+      op_data.substr_of(data, 0, count);
+      build_op(cfg, t, cid, oid, n++, op_offset, op_data, results);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++in_flight;
+      }
+      os->queue_transaction(&sequencer, t,
+                            new ObjectStore::C_DeleteTransaction(t),
+                            new C_Committed(&mutex, &cond, &in_flight,
+                                            results));
 
       offset += count;
       if (offset > cfg.size)
@@ -127,24 +278,19 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
       len -= count;
     }
 
-    // set up the finisher
-    std::mutex mutex;
-    std::condition_variable cond;
-    bool done = false;
-
-    os->queue_transactions(&sequencer, tls, nullptr,
-                           new C_NotifyCond(&mutex, &cond, &done));
-
+    // the cycle is done once all of it is committed
     std::unique_lock<std::mutex> lock(mutex);
-    cond.wait(lock, [&done](){ return done; });
-    lock.unlock();
-
-    while (!tls.empty()) {
-      auto t = tls.front();
-      tls.pop_front();
-      delete t;
-    }
+    cond.wait(lock, [&](){ return in_flight == 0; });
   }
+  sequencer.flush();
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  size_t i = p / 100 * sorted.size();
+  return sorted[std::min(i, sorted.size() - 1)];
 }
 
 int main(int argc, const char *argv[])
@@ -182,6 +328,19 @@ int main(int argc, const char *argv[])
       cfg.threads = atoi(val.c_str());
     } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
       cfg.multi_object = true;
+    } else if (ceph_argparse_witharg(args, i, &val, "--workload", (char*)nullptr)) {
+      auto end = workload_names + sizeof(workload_names)/sizeof(*workload_names);
+      auto w = std::find(workload_names, end, val);
+      if (w == end) {
+        derr << "unknown workload " << val << dendl;
+        usage();
+        return 1;
+      }
+      cfg.workload = static_cast<Workload>(w - workload_names);
+    } else if (ceph_argparse_witharg(args, i, &val, "--queue-depth", (char*)nullptr)) {
+      cfg.queue_depth = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--seed", (char*)nullptr)) {
+      cfg.seed = atoi(val.c_str());
     } else {
       derr << "Error: can't understand argument: " << *i << "\n" << dendl;
       usage();
@@ -198,6 +357,8 @@ int main(int argc, const char *argv[])
   dout(0) << "block-size " << cfg.block_size << dendl;
   dout(0) << "repeats " << cfg.repeats << dendl;
   dout(0) << "threads " << cfg.threads << dendl;
+  dout(0) << "workload " << workload_names[cfg.workload] << dendl;
+  dout(0) << "queue-depth " << cfg.queue_depth << dendl;
 
   auto os = std::unique_ptr<ObjectStore>(
       ObjectStore::create(g_ceph_context,
@@ -257,18 +418,26 @@ int main(int argc, const char *argv[])
   // run the worker threads
   std::vector<std::thread> workers;
   workers.reserve(cfg.threads);
+  std::vector<Results> results(cfg.threads);
+  for (int i = 0; i < cfg.threads; i++)
+    results[i].prefix = "t" + std::to_string(i);
+
+  uint64_t write_bytes_before = 0, write_bytes_after = 0;
+  bool have_write_bytes = get_write_bytes(&write_bytes_before);
 
   using namespace std::chrono;
   auto t1 = high_resolution_clock::now();
   for (int i = 0; i < cfg.threads; i++) {
     const auto &oid = cfg.multi_object ? oids[i] : oids[0];
     workers.emplace_back(osbench_worker, os.get(), std::ref(cfg),
-                         cid, oid, i * cfg.size / cfg.threads);
+                         cid, oid, i * cfg.size / cfg.threads,
+                         cfg.seed + i, &results[i]);
   }
   for (auto &worker : workers)
     worker.join();
   auto t2 = high_resolution_clock::now();
   workers.clear();
+  have_write_bytes = have_write_bytes && get_write_bytes(&write_bytes_after);
 
   auto duration = duration_cast<microseconds>(t2 - t1);
   byte_units total = cfg.size * cfg.repeats * cfg.threads;
@@ -278,11 +447,49 @@ int main(int argc, const char *argv[])
       << duration.count() << "us, at a rate of " << rate << "/s and "
       << iops << " iops" << dendl;
 
+  std::vector<double> latencies;
+  for (const auto &r : results)
+    latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+  std::sort(latencies.begin(), latencies.end());
+  dout(0) << "Commit latency (us): p50 " << percentile(latencies, 50)
+      << " p90 " << percentile(latencies, 90)
+      << " p99 " << percentile(latencies, 99)
+      << " p99.9 " << percentile(latencies, 99.9)
+      << " max " << (latencies.empty() ? 0 : latencies.back()) << dendl;
+
+  if (have_write_bytes) {
+    // not exact for a store that writes back lazily, but what it
+    // journals and syncs within the run is counted
+    byte_units device = write_bytes_after - write_bytes_before;
+    dout(0) << "Storage writes " << device << ", amplification "
+        << (double)device / total << dendl;
+  }
+
+  if (cfg.workload == WL_CREATE) {
+    // list what we created, the way scrub and backfill do
+    auto l1 = high_resolution_clock::now();
+    ghobject_t next;
+    size_t listed = 0;
+    while (!next.is_max()) {
+      vector<ghobject_t> ls;
+      int r = os->collection_list(cid, next, ghobject_t::get_max(), true, 1024,
+                                  &ls, &next);
+      assert(r == 0);
+      listed += ls.size();
+    }
+    auto l2 = high_resolution_clock::now();
+    dout(0) << "Listed " << listed << " objects in "
+        << duration_cast<microseconds>(l2 - l1).count() << "us" << dendl;
+  }
+
   // remove the objects
   ObjectStore::Sequencer osr(__func__);
   ObjectStore::Transaction t;
   for (const auto &oid : oids)
     t.remove(cid, oid);
+  for (const auto &r : results)
+    for (const auto &oid : r.created)
+      t.remove(cid, oid);
   os->apply_transaction(&osr,t);
 
   os->umount();
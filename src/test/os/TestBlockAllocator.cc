@@ -0,0 +1,92 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <errno.h>
+#include "gtest/gtest.h"
+#include "os/newstore/BlockAllocator.h"
+
+TEST(BlockAllocator, init) {
+  BlockAllocator a;
+  a.init(1000000, 4096, 8192);
+  // size is rounded down to a block; the reserved area is not free
+  EXPECT_EQ(999424u, a.get_size());
+  EXPECT_EQ(999424u - 8192, a.get_free());
+  EXPECT_EQ(1u, a.get_num_free_extents());
+
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(1, 0, &off, &len));
+  EXPECT_EQ(8192u, off);
+  EXPECT_EQ(4096u, len);
+}
+
+TEST(BlockAllocator, hint) {
+  BlockAllocator a;
+  a.init(1 << 20, 4096, 0);
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(8192, 0, &off, &len));
+  EXPECT_EQ(0u, off);
+  ASSERT_EQ(0, a.allocate(4096, 65536, &off, &len));
+  EXPECT_EQ(65536u, off);
+  // continue where the last one ended
+  ASSERT_EQ(0, a.allocate(4096, off + len, &off, &len));
+  EXPECT_EQ(69632u, off);
+  // a hint in allocated space moves to the next free extent
+  ASSERT_EQ(0, a.allocate(4096, 4096, &off, &len));
+  EXPECT_EQ(8192u, off);
+  EXPECT_EQ(2u, a.get_num_free_extents());
+}
+
+TEST(BlockAllocator, release_merges) {
+  BlockAllocator a;
+  a.init(16 * 4096, 4096, 0);
+  uint64_t off[4], len;
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(0, a.allocate(4096, 0, &off[i], &len));
+    EXPECT_EQ(i * 4096u, off[i]);
+  }
+  EXPECT_EQ(12 * 4096u, a.get_free());
+  a.release(off[1], 4096);
+  EXPECT_EQ(2u, a.get_num_free_extents());
+  a.release(off[3], 4096);
+  EXPECT_EQ(2u, a.get_num_free_extents());
+  a.release(off[2], 4096);
+  EXPECT_EQ(1u, a.get_num_free_extents());
+  EXPECT_EQ(15 * 4096u, a.get_free());
+  a.release(off[0], 4096);
+  EXPECT_EQ(1u, a.get_num_free_extents());
+  EXPECT_EQ(16 * 4096u, a.get_free());
+}
+
+TEST(BlockAllocator, fragmented) {
+  BlockAllocator a;
+  a.init(8 * 4096, 4096, 0);
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(8 * 4096, 0, &off, &len));
+  EXPECT_EQ(8 * 4096u, len);
+  a.release(4096, 4096);
+  a.release(4 * 4096, 2 * 4096);
+  // nothing big enough: hand out the largest piece
+  ASSERT_EQ(0, a.allocate(4 * 4096, 0, &off, &len));
+  EXPECT_EQ(4 * 4096u, off);
+  EXPECT_EQ(2 * 4096u, len);
+  ASSERT_EQ(0, a.allocate(4 * 4096, 0, &off, &len));
+  EXPECT_EQ(4096u, off);
+  EXPECT_EQ(4096u, len);
+  EXPECT_EQ(-ENOSPC, a.allocate(4096, 0, &off, &len));
+}
+
+TEST(BlockAllocator, mark_allocated) {
+  BlockAllocator a;
+  a.init(16 * 4096, 4096, 0);
+  ASSERT_EQ(0, a.mark_allocated(4 * 4096, 4 * 4096));
+  EXPECT_EQ(12 * 4096u, a.get_free());
+  EXPECT_EQ(2u, a.get_num_free_extents());
+  // already in use, or past the end
+  EXPECT_EQ(-ERANGE, a.mark_allocated(6 * 4096, 4096));
+  EXPECT_EQ(-ERANGE, a.mark_allocated(15 * 4096, 2 * 4096));
+  ASSERT_EQ(0, a.mark_allocated(0, 4 * 4096));
+  EXPECT_EQ(1u, a.get_num_free_extents());
+  uint64_t off, len;
+  ASSERT_EQ(0, a.allocate(4096, 0, &off, &len));
+  EXPECT_EQ(8 * 4096u, off);
+}
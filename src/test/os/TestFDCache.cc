@@ -0,0 +1,108 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include "gtest/gtest.h"
+#include "os/FDCache.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "common/ceph_argparse.h"
+#include "common/config.h"
+
+static ghobject_t make_oid(int i)
+{
+  char name[16];
+  snprintf(name, sizeof(name), "obj%d", i);
+  return ghobject_t(hobject_t(sobject_t(name, CEPH_NOSNAP)));
+}
+
+static int open_fd()
+{
+  int fd = ::open("/dev/null", O_RDONLY);
+  assert(fd >= 0);
+  return fd;
+}
+
+class FDCacheTest : public ::testing::Test {
+public:
+  virtual void SetUp() {
+    g_ceph_context->_conf->set_val("filestore_fd_cache_shards", "1");
+    g_ceph_context->_conf->set_val("filestore_fd_cache_size", "4");
+    g_ceph_context->_conf->apply_changes(NULL);
+  }
+};
+
+TEST_F(FDCacheTest, add_lookup_clear) {
+  FDCache cache(g_ceph_context);
+  ghobject_t oid = make_oid(0);
+  ASSERT_FALSE(cache.lookup(oid));
+
+  bool existed;
+  FDRef fd = cache.add(oid, open_fd(), &existed);
+  ASSERT_FALSE(existed);
+  ASSERT_EQ(fd, cache.lookup(oid));
+
+  int dup = open_fd();
+  FDRef fd2 = cache.add(oid, dup, &existed);
+  ASSERT_TRUE(existed);
+  ASSERT_EQ(fd, fd2);
+  ::close(dup);
+
+  cache.clear(oid);
+  ASSERT_FALSE(cache.lookup(oid));
+  ASSERT_EQ(0u, cache.size());
+  // the clear doesn't close an fd that is still referenced
+  ASSERT_EQ(0, ::fcntl(**fd, F_GETFD));
+}
+
+TEST_F(FDCacheTest, evict) {
+  FDCache cache(g_ceph_context);
+  bool existed;
+  for (int i = 0; i < 4; ++i)
+    cache.add(make_oid(i), open_fd(), &existed);
+  ASSERT_EQ(4u, cache.size());
+
+  // keep obj0 hot
+  for (unsigned i = 0; i < FDCache::MAX_USAGE; ++i)
+    ASSERT_TRUE(cache.lookup(make_oid(0)));
+
+  for (int i = 4; i < 8; ++i) {
+    cache.add(make_oid(i), open_fd(), &existed);
+    ASSERT_EQ(4u, cache.size());
+    ASSERT_TRUE(cache.lookup(make_oid(0)));
+  }
+}
+
+TEST_F(FDCacheTest, pinned) {
+  FDCache cache(g_ceph_context);
+  bool existed;
+  vector<FDRef> refs;
+  for (int i = 0; i < 4; ++i)
+    refs.push_back(cache.add(make_oid(i), open_fd(), &existed));
+
+  // everything is in use: go over size rather than close them
+  cache.add(make_oid(4), open_fd(), &existed);
+  ASSERT_EQ(5u, cache.size());
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(cache.lookup(make_oid(i)));
+
+  // once released they can go
+  refs.clear();
+  cache.add(make_oid(5), open_fd(), &existed);
+  ASSERT_EQ(4u, cache.size());
+}
+
+int main(int argc, char **argv) {
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+// Local Variables:
+// compile-command: "cd ../.. ; make unittest_fdcache && ./unittest_fdcache"
+// End:
@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "os/JournalGroupCommit.h"
+
+TEST(JournalGroupCommit, disabled) {
+  JournalGroupCommit gc;
+  gc.note_write(4096, .001);
+  gc.note_arrival(1.0);
+  gc.note_arrival(1.0001);
+  EXPECT_FALSE(gc.enabled());
+  EXPECT_EQ(0, gc.get_hold(0, 4096));
+  EXPECT_EQ(10u << 20, gc.get_max_bytes(10 << 20));
+  EXPECT_FALSE(gc.note_commit(100));
+}
+
+TEST(JournalGroupCommit, hold) {
+  JournalGroupCommit gc;
+  gc.set_target(.010, .002);
+  // no latency samples yet: write right away
+  EXPECT_EQ(0, gc.get_hold(0, 4096));
+
+  for (int i = 0; i < 20; ++i)
+    gc.note_write(4096, .001);
+  EXPECT_NEAR(.001, gc.predict(4096), .0001);
+
+  // no arrivals seen: nothing to wait for
+  EXPECT_EQ(0, gc.get_hold(0, 4096));
+
+  // an entry every 100us; plenty of budget, so hold the max delay
+  for (int i = 0; i < 20; ++i)
+    gc.note_arrival(1.0 + i * .0001);
+  EXPECT_DOUBLE_EQ(.002, gc.get_hold(0, 4096));
+
+  // the oldest entry has nearly used up the target
+  EXPECT_EQ(0, gc.get_hold(.0095, 4096));
+  double h = gc.get_hold(.0075, 4096);
+  EXPECT_GT(h, 0);
+  EXPECT_LT(h, .002);
+
+  // arrivals slower than the budget: don't wait for them
+  for (int i = 0; i < 20; ++i)
+    gc.note_arrival(2.0 + i * .05);
+  EXPECT_EQ(0, gc.get_hold(0, 4096));
+}
+
+TEST(JournalGroupCommit, max_bytes) {
+  JournalGroupCommit gc;
+  gc.set_target(.010, .002);
+  for (int i = 0; i < 20; ++i)
+    gc.note_write(4096, .001);
+  // 1ms + 1ms per MB
+  for (int i = 0; i < 50; ++i)
+    gc.note_write(8 << 20, .001 + 8 * .001);
+  EXPECT_NEAR(.009, gc.predict(8 << 20), .0005);
+  // half the target is 5ms: ~4MB
+  uint64_t m = gc.get_max_bytes(100 << 20);
+  EXPECT_GT(m, 3u << 20);
+  EXPECT_LT(m, 5u << 20);
+  // the configured cap still wins when smaller
+  EXPECT_EQ(1u << 20, gc.get_max_bytes(1 << 20));
+}
+
+TEST(JournalGroupCommit, p99_feedback) {
+  JournalGroupCommit gc;
+  gc.set_target(.010, .002);
+  EXPECT_EQ(1.0, gc.get_factor());
+  // 5% of a window over target: back off
+  for (unsigned i = 0; i < JournalGroupCommit::WINDOW; ++i)
+    gc.note_commit(i % 20 ? .005 : .020);
+  EXPECT_EQ(.5, gc.get_factor());
+  // one miss per window is within the 1%: no change
+  for (unsigned i = 0; i < JournalGroupCommit::WINDOW; ++i)
+    gc.note_commit(i ? .005 : .020);
+  EXPECT_EQ(.5, gc.get_factor());
+  // clean windows recover
+  for (unsigned i = 0; i < 10 * JournalGroupCommit::WINDOW; ++i)
+    EXPECT_FALSE(gc.note_commit(.005));
+  EXPECT_EQ(1.0, gc.get_factor());
+}
@@ -73,7 +73,11 @@ protected:
 		      vector<string> *path,
 		      string *mangled_name,
 		      int *exists		 
-		      ) { return 0; }
+		      ) {
+    // everything lives at the top
+    path->clear();
+    return lfn_get_name(*path, hoid, mangled_name, 0, exists);
+  }
 
   virtual int _collection_list_partial(
 				       const ghobject_t &start,
@@ -439,6 +443,66 @@ TEST_F(TestLFNIndex, get_mangled_name) {
   }
 }
 
+TEST_F(TestLFNIndex, path_cache) {
+  const vector<string> path;
+  ghobject_t hoid(hobject_t(sobject_t("A", CEPH_NOSNAP)));
+  IndexedPath p;
+  int exists;
+
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(0, exists);
+  // absent, but the path is right
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(0, exists);
+  EXPECT_EQ(0, ::close(::creat(p->path(), 0600)));
+  EXPECT_EQ(0, created(hoid, p->path()));
+  string created_path(p->path());
+
+  // served from the cache, no stat
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(1, exists);
+  EXPECT_EQ(created_path, p->path());
+
+  EXPECT_EQ(0, remove_object(path, hoid));
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(0, exists);
+
+  clear_path_cache();
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(0, exists);
+
+  JSONFormatter f;
+  dump_stats(&f);
+  stringstream ss;
+  f.flush(ss);
+  EXPECT_NE(string::npos, ss.str().find("\"hits\":2"));
+  EXPECT_NE(string::npos, ss.str().find("\"misses\":3"));
+  EXPECT_NE(string::npos, ss.str().find("\"resets\":1"));
+}
+
+TEST_F(TestLFNIndex, path_cache_long_name) {
+  const vector<string> path;
+  const std::string object_name(1024, 'A');
+  ghobject_t hoid(hobject_t(sobject_t(object_name, CEPH_NOSNAP)));
+  IndexedPath p;
+  int exists;
+
+  // absent objects with hashed names aren't cached
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(0, exists);
+  EXPECT_EQ(0, ::close(::creat(p->path(), 0600)));
+  EXPECT_EQ(0, created(hoid, p->path()));
+  EXPECT_EQ(0, lookup(hoid, &p, &exists));
+  EXPECT_EQ(1, exists);
+
+  JSONFormatter f;
+  dump_stats(&f);
+  stringstream ss;
+  f.flush(ss);
+  EXPECT_NE(string::npos, ss.str().find("\"hits\":1"));
+  EXPECT_NE(string::npos, ss.str().find("\"misses\":1"));
+}
+
 int main(int argc, char **argv) {
   int fd = ::creat("detect", 0600);
   int ret = chain_fsetxattr(fd, "user.test", "A", 1);
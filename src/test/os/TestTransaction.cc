@@ -0,0 +1,98 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "os/ObjectStore.h"
+#include "include/stringify.h"
+
+static ghobject_t make_oid(const char *name)
+{
+  return ghobject_t(hobject_t(sobject_t(object_t(name), CEPH_NOSNAP)));
+}
+
+static void write_op(ObjectStore::Transaction &t, const coll_t &cid,
+		     const ghobject_t &oid, const char *s)
+{
+  bufferlist bl;
+  bl.append(s);
+  t.write(cid, oid, 0, bl.length(), bl);
+}
+
+// ops as "cid/oid:data" strings, in order
+static vector<string> dump_writes(ObjectStore::Transaction &t)
+{
+  vector<string> out;
+  ObjectStore::Transaction::iterator i = t.begin();
+  while (i.have_op()) {
+    ObjectStore::Transaction::Op *op = i.decode_op();
+    EXPECT_EQ((int)ObjectStore::Transaction::OP_WRITE, (int)op->op);
+    bufferlist bl;
+    i.decode_bl(bl);
+    out.push_back(stringify(i.get_cid(op->cid)) + "/" +
+		  i.get_oid(op->oid).hobj.oid.name + ":" +
+		  string(bl.c_str(), bl.length()));
+  }
+  return out;
+}
+
+TEST(Transaction, append_to_empty) {
+  coll_t cid(spg_t(pg_t(1, 2), shard_id_t::NO_SHARD));
+  ObjectStore::Transaction a, b;
+  write_op(a, cid, make_oid("foo"), "1");
+  write_op(a, cid, make_oid("bar"), "2");
+  b.append(a);
+  vector<string> w = dump_writes(b);
+  ASSERT_EQ(2u, w.size());
+  EXPECT_EQ("1.2_head/foo:1", w[0]);
+  EXPECT_EQ("1.2_head/bar:2", w[1]);
+  // the source keeps working after its ops were shared
+  write_op(a, cid, make_oid("foo"), "3");
+  EXPECT_EQ(3u, dump_writes(a).size());
+  EXPECT_EQ(2u, dump_writes(b).size());
+}
+
+TEST(Transaction, append_remaps_ids) {
+  coll_t c1(spg_t(pg_t(1, 2), shard_id_t::NO_SHARD));
+  coll_t c2(spg_t(pg_t(3, 2), shard_id_t::NO_SHARD));
+  ObjectStore::Transaction a, b;
+  write_op(a, c1, make_oid("foo"), "1");
+  write_op(b, c2, make_oid("bar"), "2");
+  write_op(b, c1, make_oid("foo"), "3");
+  a.append(b);
+  vector<string> w = dump_writes(a);
+  ASSERT_EQ(3u, w.size());
+  EXPECT_EQ("1.2_head/foo:1", w[0]);
+  EXPECT_EQ("3.2_head/bar:2", w[1]);
+  EXPECT_EQ("1.2_head/foo:3", w[2]);
+  EXPECT_EQ(2u, dump_writes(b).size());
+}
+
+TEST(Transaction, reserve_ops) {
+  coll_t cid;
+  ObjectStore::Transaction t;
+  t.reserve_ops(100);
+  for (int i = 0; i < 100; ++i)
+    t.touch(cid, make_oid("foo"));
+  ObjectStore::Transaction::iterator i = t.begin();
+  int n = 0;
+  while (i.have_op()) {
+    ObjectStore::Transaction::Op *op = i.decode_op();
+    EXPECT_EQ((int)ObjectStore::Transaction::OP_TOUCH, (int)op->op);
+    EXPECT_EQ(0u, (unsigned)op->oid);
+    ++n;
+  }
+  EXPECT_EQ(100, n);
+}
+
+TEST(Transaction, encoded_bytes) {
+  coll_t cid;
+  ObjectStore::Transaction t;
+  write_op(t, cid, make_oid("foo"), "abc");
+  uint64_t a = t.get_encoded_bytes();
+  write_op(t, cid, make_oid("foo"), "abc");
+  uint64_t b = t.get_encoded_bytes();
+  write_op(t, cid, make_oid("a much longer object name"), "abc");
+  uint64_t c = t.get_encoded_bytes();
+  EXPECT_LT(a, b);
+  EXPECT_LT(b - a, c - b);  // a new object adds its name to the index
+}
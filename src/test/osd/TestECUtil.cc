@@ -0,0 +1,48 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "gtest/gtest.h"
+#include "osd/ECUtil.h"
+
+static bufferlist pattern(unsigned len, char seed) {
+  bufferlist bl;
+  bufferptr bp(len);
+  for (unsigned i = 0; i < len; ++i)
+    bp.c_str()[i] = seed + i * 7;
+  bl.append(bp);
+  return bl;
+}
+
+TEST(HashInfo, Overwrite) {
+  const unsigned chunks = 3, stripes = 4, len = 64;
+  // shard contents before and after overwriting the second chunk
+  map<int, bufferlist> before, after;
+  ECUtil::HashInfo hinfo(chunks), expected(chunks);
+  for (unsigned s = 0; s < stripes; ++s) {
+    map<int, bufferlist> a, b;
+    for (unsigned c = 0; c < chunks; ++c) {
+      a[c] = pattern(len, s * chunks + c);
+      b[c] = s == 1 ? pattern(len, 100 + c) : a[c];
+    }
+    hinfo.append(s * len, a);
+    expected.append(s * len, b);
+    if (s == 1) {
+      before = a;
+      after = b;
+    }
+  }
+  ASSERT_NE(expected.get_chunk_hash(0), hinfo.get_chunk_hash(0));
+  hinfo.overwrite(len, before, after);
+  ASSERT_EQ(expected.get_total_chunk_size(), hinfo.get_total_chunk_size());
+  for (unsigned c = 0; c < chunks; ++c)
+    ASSERT_EQ(expected.get_chunk_hash(c), hinfo.get_chunk_hash(c));
+}
@@ -97,6 +97,31 @@ TEST_F(OSDMapTest, Create) {
   ASSERT_EQ(get_num_osds(), osdmap.get_num_in_osds());
 }
 
+TEST_F(OSDMapTest, MapGossipTree) {
+  set_up_map();
+  int root = osdmap.get_map_gossip_root();
+  ASSERT_TRUE(osdmap.is_up(root));
+
+  for (unsigned fanout = 1; fanout <= get_num_osds(); ++fanout) {
+    // walking down from the root reaches every up osd exactly once
+    set<int> reached;
+    list<int> q;
+    q.push_back(root);
+    reached.insert(root);
+    while (!q.empty()) {
+      vector<int> peers;
+      osdmap.get_map_gossip_peers(q.front(), fanout, &peers);
+      q.pop_front();
+      ASSERT_LE(peers.size(), fanout);
+      for (unsigned i = 0; i < peers.size(); ++i) {
+	ASSERT_TRUE(reached.insert(peers[i]).second);
+	q.push_back(peers[i]);
+      }
+    }
+    ASSERT_EQ(osdmap.get_num_up_osds(), reached.size());
+  }
+}
+
 TEST_F(OSDMapTest, Features) {
   // with EC pool
   set_up_map();
@@ -228,6 +253,164 @@ TEST_F(OSDMapTest, PGTempRespected) {
   EXPECT_EQ(new_acting_osds, acting_osds);
 }
 
+TEST_F(OSDMapTest, CopyOnWrite) {
+  set_up_map();
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, 0, -1));
+  vector<int> up_osds, acting_osds;
+  int up_primary, acting_primary;
+  osdmap.pg_to_up_acting_osds(pgid, &up_osds, &up_primary,
+                              &acting_osds, &acting_primary);
+  vector<int> new_acting_osds(acting_osds.rbegin(), acting_osds.rend());
+
+  OSDMap next;
+  next.cow_copy_from(osdmap);
+  OSDMap::Incremental inc(next.get_epoch() + 1);
+  inc.fsid = next.get_fsid();
+  inc.new_pg_temp[pgid] = new_acting_osds;
+  inc.new_primary_affinity[new_acting_osds[0]] = 0;
+  ASSERT_EQ(0, next.apply_incremental(inc));
+
+  // the new epoch sees the change...
+  vector<int> next_acting;
+  int next_primary;
+  next.pg_to_acting_osds(pgid, &next_acting, &next_primary);
+  EXPECT_EQ(new_acting_osds, next_acting);
+  EXPECT_EQ(0u, next.get_primary_affinity(new_acting_osds[0]));
+
+  // ...the old one is untouched, and what did not change is shared
+  vector<int> old_acting;
+  int old_primary;
+  osdmap.pg_to_acting_osds(pgid, &old_acting, &old_primary);
+  EXPECT_EQ(acting_osds, old_acting);
+  EXPECT_EQ(acting_primary, old_primary);
+  EXPECT_EQ((unsigned)CEPH_OSD_DEFAULT_PRIMARY_AFFINITY,
+            osdmap.get_primary_affinity(new_acting_osds[0]));
+  EXPECT_EQ(osdmap.crush.get(), next.crush.get());
+}
+
+TEST_F(OSDMapTest, MappingTable) {
+  set_up_map();
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, 0, -1));
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  vector<int> temp;
+  temp.push_back(0);
+  temp.push_back(1);
+  temp.push_back(2);
+  temp.push_back(3);  // longer than the pool's size
+  inc.new_pg_temp[pgid] = temp;
+  osdmap.apply_incremental(inc);
+
+  // what the map computes on demand...
+  map<pg_t, vector<int> > want;
+  const map<int64_t,pg_pool_t>& pools = osdmap.get_pools();
+  for (map<int64_t,pg_pool_t>::const_iterator p = pools.begin();
+       p != pools.end();
+       ++p) {
+    for (unsigned ps = 0; ps < p->second.get_pg_num(); ++ps) {
+      pg_t pg(ps, p->first, -1);
+      vector<int> up, acting;
+      int up_primary, acting_primary;
+      osdmap.pg_to_up_acting_osds(pg, &up, &up_primary,
+				  &acting, &acting_primary);
+      up.push_back(up_primary);
+      up.insert(up.end(), acting.begin(), acting.end());
+      up.push_back(acting_primary);
+      want[pg] = up;
+    }
+  }
+
+  // ...is what the table built by a few threads holds
+  osdmap.build_mapping(3);
+  ASSERT_TRUE(osdmap.get_mapping());
+  ASSERT_EQ(want.size(), osdmap.get_mapping()->get_num_pgs());
+  for (map<pg_t, vector<int> >::iterator p = want.begin();
+       p != want.end();
+       ++p) {
+    vector<int> up, acting;
+    int up_primary, acting_primary;
+    ASSERT_TRUE(osdmap.get_mapping()->get(p->first, &up, &up_primary,
+					   &acting, &acting_primary));
+    up.push_back(up_primary);
+    up.insert(up.end(), acting.begin(), acting.end());
+    up.push_back(acting_primary);
+    ASSERT_EQ(p->second, up);
+  }
+
+  // dropping the pg_temp changes exactly that pg
+  OSDMap next;
+  next.cow_copy_from(osdmap);
+  OSDMap::Incremental inc2(next.get_epoch() + 1);
+  inc2.fsid = next.get_fsid();
+  inc2.new_pg_temp[pgid] = vector<int>();
+  next.apply_incremental(inc2);
+  ASSERT_FALSE(next.get_mapping());
+  next.build_mapping(1);
+  set<pg_t> changed;
+  next.get_mapping()->get_changed(*osdmap.get_mapping(), &changed);
+  ASSERT_EQ(1u, changed.size());
+  ASSERT_EQ(pgid, *changed.begin());
+}
+
+TEST_F(OSDMapTest, MappingCounts) {
+  set_up_map();
+  osdmap.build_mapping(2);
+
+  // the counts from the table match mapping each pg
+  int64_t pool = 0;
+  int pg_num = osdmap.get_pg_pool(pool)->get_pg_num();
+  vector<int> any(get_num_osds()), first(get_num_osds()),
+    primary(get_num_osds());
+  test_mappings(pool, pg_num, &any, &first, &primary);
+  vector<unsigned> count, tfirst, tprimary;
+  osdmap.get_mapping()->count_pgs(pool, osdmap.get_max_osd(),
+				  &count, &tfirst, &tprimary);
+  ASSERT_EQ((unsigned)osdmap.get_max_osd(), count.size());
+  for (unsigned i = 0; i < get_num_osds(); ++i) {
+    ASSERT_EQ((unsigned)any[i], count[i]);
+    ASSERT_EQ((unsigned)first[i], tfirst[i]);
+    ASSERT_EQ((unsigned)primary[i], tprimary[i]);
+  }
+
+  // nothing moves between a map and itself
+  uint64_t moved_pgs, moved_copies;
+  osdmap.get_mapping()->count_moved(*osdmap.get_mapping(), -1,
+				    &moved_pgs, &moved_copies);
+  ASSERT_EQ(0u, moved_pgs);
+  ASSERT_EQ(0u, moved_copies);
+
+  // a pg_temp onto other osds moves that pg's new copies only
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, pool, -1));
+  vector<int> acting;
+  int acting_primary;
+  osdmap.pg_to_acting_osds(pgid, &acting, &acting_primary);
+  vector<int> temp;
+  for (int i = 0; i < (int)get_num_osds() && temp.size() < acting.size(); ++i)
+    if (i != acting[0])
+      temp.push_back(i);
+  uint64_t want_copies = 0;
+  for (unsigned i = 0; i < temp.size(); ++i)
+    if (std::find(acting.begin(), acting.end(), temp[i]) == acting.end())
+      ++want_copies;
+
+  OSDMap next;
+  next.cow_copy_from(osdmap);
+  OSDMap::Incremental inc(next.get_epoch() + 1);
+  inc.fsid = next.get_fsid();
+  inc.new_pg_temp[pgid] = temp;
+  next.apply_incremental(inc);
+  next.build_mapping(1);
+  next.get_mapping()->count_moved(*osdmap.get_mapping(), pool,
+				  &moved_pgs, &moved_copies);
+  ASSERT_EQ(1u, moved_pgs);
+  ASSERT_EQ(want_copies, moved_copies);
+  next.get_mapping()->count_moved(*osdmap.get_mapping(), pool + 1,
+				  &moved_pgs, &moved_copies);
+  ASSERT_EQ(0u, moved_pgs);
+}
+
 TEST_F(OSDMapTest, PrimaryTempRespected) {
   set_up_map();
 
@@ -400,3 +583,41 @@ TEST_F(OSDMapTest, PrimaryAffinity) {
     osdmap.set_primary_affinity(1, 0x10000);
   }
 }
+
+TEST_F(OSDMapTest, BalanceReweights) {
+  set_up_map();
+
+  // a badly reweighted osd is the largest source of spread
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  inc.new_weight[0] = 0x4000;
+  osdmap.apply_incremental(inc);
+
+  set<int64_t> pools;
+  map<int,__u32> new_weights;
+  double before, after;
+  osdmap.calc_balance_reweights(pools, NULL, .5, 10, &new_weights,
+				&before, &after);
+  ASSERT_LT(0, before);
+  ASSERT_LT(after, before);
+  ASSERT_TRUE(new_weights.count(0));
+  ASSERT_LT(0x4000u, new_weights[0]);
+  for (map<int,__u32>::iterator p = new_weights.begin();
+       p != new_weights.end();
+       ++p) {
+    ASSERT_LT(0u, p->second);
+    ASSERT_GE((__u32)CEPH_OSD_IN, p->second);
+  }
+
+  // applying the result leaves less to do
+  OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+  inc2.fsid = osdmap.get_fsid();
+  inc2.new_weight = new_weights;
+  osdmap.apply_incremental(inc2);
+  map<int,__u32> again;
+  double before2, after2;
+  osdmap.calc_balance_reweights(pools, NULL, .5, 10, &again,
+				&before2, &after2);
+  ASSERT_NEAR(after, before2, 1e-9);
+  ASSERT_GE(before2, after2);
+}
@@ -0,0 +1,84 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "gtest/gtest.h"
+#include "osd/ObjectContextCache.h"
+
+TEST(ObjectContextCache, Disabled) {
+  ObjectContextCache cache(1, 0);
+  ASSERT_FALSE(cache.enabled());
+  ObjectContextRef obc(new ObjectContext);
+  ceph::weak_ptr<ObjectContext> w(obc);
+  cache.touch(this, obc, 100);
+  obc.reset();
+  ASSERT_TRUE(w.expired());
+}
+
+TEST(ObjectContextCache, Budget) {
+  ObjectContextCache cache(1, 1000);
+  vector<ceph::weak_ptr<ObjectContext> > w;
+  for (unsigned i = 0; i < 20; ++i) {
+    ObjectContextRef obc(new ObjectContext);
+    w.push_back(obc);
+    cache.touch(&cache, obc, 100);
+  }
+  ASSERT_GE(1000u, cache.get_bytes());
+  unsigned alive = 0;
+  for (unsigned i = 0; i < w.size(); ++i)
+    if (!w[i].expired())
+      ++alive;
+  ASSERT_EQ(10u, alive);
+  // the newest ones survived
+  ASSERT_FALSE(w.back().expired());
+  ASSERT_TRUE(w.front().expired());
+}
+
+TEST(ObjectContextCache, Referenced) {
+  ObjectContextCache cache(1, 300);
+  ObjectContextRef hot(new ObjectContext);
+  ceph::weak_ptr<ObjectContext> whot(hot);
+  cache.touch(&cache, hot, 100);
+  cache.touch(&cache, hot, 100);  // hit
+  hot.reset();
+  for (unsigned i = 0; i < 3; ++i) {
+    ObjectContextRef obc(new ObjectContext);
+    cache.touch(&cache, obc, 100);
+  }
+  // the cold entry added after it went first
+  ASSERT_FALSE(whot.expired());
+  ASSERT_GE(300u, cache.get_bytes());
+}
+
+TEST(ObjectContextCache, ClearOwner) {
+  ObjectContextCache cache(4, 1 << 20);
+  int a, b;
+  vector<ceph::weak_ptr<ObjectContext> > wa, wb;
+  for (unsigned i = 0; i < 16; ++i) {
+    ObjectContextRef oa(new ObjectContext), ob(new ObjectContext);
+    wa.push_back(oa);
+    wb.push_back(ob);
+    cache.touch(&a, oa, 10);
+    cache.touch(&b, ob, 10);
+  }
+  ASSERT_EQ(320u, cache.get_bytes());
+  cache.clear(&a);
+  ASSERT_EQ(160u, cache.get_bytes());
+  for (unsigned i = 0; i < 16; ++i) {
+    ASSERT_TRUE(wa[i].expired());
+    ASSERT_FALSE(wb[i].expired());
+  }
+  cache.set_max_bytes(0);
+  ASSERT_FALSE(cache.enabled());
+  ASSERT_EQ(0u, cache.get_bytes());
+  for (unsigned i = 0; i < 16; ++i)
+    ASSERT_TRUE(wb[i].expired());
+}
@@ -2007,6 +2007,104 @@ TEST_F(PGLogTest, filter_log_1) {
   }
 }
 
+TEST_F(PGLogTest, append_only_log) {
+  string dir = "test_pglog_append_only";
+  ::system(("rm -rf " + dir).c_str());
+  ::mkdir(dir.c_str(), 0777);
+  ObjectStore *store = ObjectStore::create(g_ceph_context, "memstore", dir, "");
+  ASSERT_TRUE(store);
+  ASSERT_EQ(0, store->mkfs());
+  ASSERT_EQ(0, store->mount());
+  ObjectStore::Sequencer osr("test");
+
+  spg_t pgid(pg_t(1, 1), shard_id_t::NO_SHARD);
+  coll_t coll(pgid);
+  ghobject_t log_oid = pgid.make_pgmeta_oid();
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(coll, 0);
+    ASSERT_EQ(0, store->apply_transaction(&osr, t));
+  }
+
+  LogExtents ext;
+  pg_log_t wlog;
+  map<eversion_t, hobject_t> priors;
+  for (unsigned i = 1; i <= 10; ++i)
+    wlog.log.push_back(mk_ple_mod(mk_obj(i), mk_evt(1, i), mk_evt(1, i - 1)));
+
+  // write with the given dirty state and read the result back
+  pg_info_t info;
+  info.pgid = pgid;
+  IndexedLog rlog;
+  auto write_and_read = [&](eversion_t dirty_from, eversion_t writeout_from,
+			    const set<eversion_t> &trimmed) {
+    ObjectStore::Transaction t;
+    map<string, bufferlist> km;
+    _write_log(t, &km, wlog, coll, log_oid, priors, eversion_t(),
+	       dirty_from, writeout_from, trimmed, false,
+	       !ext.in_data, 0, &ext);
+    t.omap_setkeys(coll, log_oid, km);
+    ASSERT_EQ(0, store->apply_transaction(&osr, t));
+
+    info.last_update = info.last_complete = wlog.log.back().version;
+    info.log_tail = wlog.log.front().version;
+    rlog = IndexedLog();
+    pg_missing_t missing;
+    ostringstream oss;
+    LogExtents rext;
+    read_log(store, coll, coll, log_oid, info, priors, rlog, missing, oss,
+	     0, &rext);
+    ASSERT_TRUE(rext.in_data);
+    ASSERT_EQ(ext.start, rext.start);
+    ASSERT_EQ(ext.end, rext.end);
+    ASSERT_EQ(ext.offsets, rext.offsets);
+    ASSERT_EQ(wlog.log.size(), rlog.log.size());
+    list<pg_log_entry_t>::iterator r = rlog.log.begin();
+    for (list<pg_log_entry_t>::iterator w = wlog.log.begin();
+	 w != wlog.log.end(); ++w, ++r)
+      ASSERT_EQ(w->version, r->version);
+  };
+
+  // first write lays out everything
+  write_and_read(eversion_t::max(), eversion_t(), set<eversion_t>());
+  ASSERT_EQ(0u, ext.start);
+  uint64_t first_end = ext.end;
+
+  // trim 1..3 and append 11, 12: only the new entries are written
+  set<eversion_t> trimmed;
+  for (unsigned i = 1; i <= 3; ++i) {
+    trimmed.insert(wlog.log.front().version);
+    wlog.log.pop_front();
+  }
+  for (unsigned i = 11; i <= 12; ++i)
+    wlog.log.push_back(mk_ple_mod(mk_obj(i), mk_evt(1, i), mk_evt(1, i - 1)));
+  write_and_read(eversion_t::max(), mk_evt(1, 11), trimmed);
+  ASSERT_EQ(ext.offsets[mk_evt(1, 4)], ext.start);
+  ASSERT_EQ(first_end, ext.offsets[mk_evt(1, 11)]);
+
+  // rewind 11, 12 and replace them with 2'11
+  wlog.log.pop_back();
+  wlog.log.pop_back();
+  wlog.log.push_back(mk_ple_mod(mk_obj(11), mk_evt(2, 11), mk_evt(1, 10)));
+  write_and_read(mk_evt(1, 11), mk_evt(2, 11), set<eversion_t>());
+  ASSERT_EQ(first_end, ext.offsets[mk_evt(2, 11)]);
+
+  // once most of it is trimmed the log starts over at 0
+  ext.compact_bytes = 0;
+  trimmed.clear();
+  while (wlog.log.size() > 2) {
+    trimmed.insert(wlog.log.front().version);
+    wlog.log.pop_front();
+  }
+  write_and_read(eversion_t::max(), eversion_t::max(), trimmed);
+  ASSERT_EQ(0u, ext.start);
+  ASSERT_EQ(2u, ext.offsets.size());
+
+  store->umount();
+  delete store;
+  ::system(("rm -rf " + dir).c_str());
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -0,0 +1,52 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "gtest/gtest.h"
+#include "osd/PhiAccrual.h"
+
+TEST(PhiAccrual, NeedsSamples) {
+  PhiAccrualDetector d;
+  for (unsigned i = 0; i < PhiAccrualDetector::MIN_SAMPLES; ++i) {
+    d.add(utime_t(i + 1, 0));
+    ASSERT_EQ(0, d.phi(utime_t(1000, 0)));
+  }
+  d.add(utime_t(PhiAccrualDetector::MIN_SAMPLES + 1, 0));
+  ASSERT_LT(0, d.phi(utime_t(1000, 0)));
+}
+
+TEST(PhiAccrual, Grows) {
+  PhiAccrualDetector d;
+  // a reply every second, give or take 100ms
+  utime_t t;
+  for (unsigned i = 0; i < 100; ++i) {
+    t += (i % 2) ? utime_t(0, 900000000) : utime_t(1, 100000000);
+    d.add(t);
+  }
+  ASSERT_NEAR(1.0, d.get_mean(), .01);
+  ASSERT_EQ((unsigned)PhiAccrualDetector::WINDOW, d.get_num_samples());
+  double on_time = d.phi(t + utime_t(1, 0));
+  double late = d.phi(t + utime_t(1, 500000000));
+  double gone = d.phi(t + utime_t(3, 0));
+  ASSERT_GT(1, on_time);
+  ASSERT_LT(on_time, late);
+  ASSERT_LT(late, gone);
+  ASSERT_LT(8, gone);
+}
+
+TEST(PhiAccrual, Regular) {
+  PhiAccrualDetector d;
+  // no jitter at all: the deviation floor keeps a small delay harmless
+  for (unsigned i = 1; i <= 20; ++i)
+    d.add(utime_t(i, 0));
+  ASSERT_GT(1, d.phi(utime_t(21, 50000000)));
+  ASSERT_LT(8, d.phi(utime_t(22, 0)));
+}
@@ -0,0 +1,49 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "gtest/gtest.h"
+#include "osd/RecoveryThrottle.h"
+
+TEST(RecoveryThrottle, NoTarget) {
+  RecoveryThrottle t(3);
+  ASSERT_FALSE(t.adjust(utime_t(10, 0), 1, 0, 1, 5, 10));
+  ASSERT_EQ(5, t.get_limit());
+}
+
+TEST(RecoveryThrottle, Adjust) {
+  RecoveryThrottle t(4);
+  // idle: grows to max
+  ASSERT_TRUE(t.adjust(utime_t(1, 0), 1, .01, 1, 6, 10));
+  ASSERT_EQ(5, t.get_limit());
+  ASSERT_FALSE(t.adjust(utime_t(1, 500000000), 1, .01, 1, 6, 10));
+  ASSERT_TRUE(t.adjust(utime_t(2, 0), 1, .01, 1, 6, 10));
+  ASSERT_EQ(6, t.get_limit());
+
+  // slow clients: halves, down to min
+  for (unsigned i = 0; i < 100; ++i)
+    t.record_client_latency(.05);
+  ASSERT_TRUE(t.adjust(utime_t(3, 0), 1, .01, 1, 6, 10));
+  ASSERT_LT(.01, t.get_last_p99());
+  ASSERT_EQ(3, t.get_limit());
+  for (unsigned i = 0; i < 100; ++i)
+    t.record_client_latency(.05);
+  ASSERT_TRUE(t.adjust(utime_t(4, 0), 1, .01, 1, 6, 10));
+  ASSERT_EQ(1, t.get_limit());
+
+  // one slow op in a hundred fast ones is not the p99
+  for (unsigned i = 0; i < 200; ++i)
+    t.record_client_latency(.001);
+  t.record_client_latency(1);
+  ASSERT_TRUE(t.adjust(utime_t(5, 0), 1, .01, 1, 6, 10));
+  ASSERT_GT(.01, t.get_last_p99());
+  ASSERT_EQ(2, t.get_limit());
+}
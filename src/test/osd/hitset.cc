@@ -195,3 +195,91 @@ TEST_F(ExplicitObjectHitSetTest, RejectsNoMatch) {
   }
   EXPECT_EQ(matches, 0);
 }
+
+class CuckooHitSetTest : public testing::Test, public HitSetTestStrap {
+public:
+
+  CuckooHitSetTest() : HitSetTestStrap(new HitSet(new CuckooHitSet)) {}
+
+  void rebuild(double fp, uint64_t target, uint64_t seed) {
+    CuckooHitSet::Params *cparams = new CuckooHitSet::Params(fp, target, seed);
+    HitSet::Params param(cparams);
+    HitSet new_set(param);
+    *hitset = new_set;
+  }
+};
+
+TEST_F(CuckooHitSetTest, Construct) {
+  ASSERT_EQ(hitset->impl->get_type(), HitSet::TYPE_CUCKOO);
+  rebuild(0.01, 100, 1);
+  ASSERT_EQ(hitset->impl->get_type(), HitSet::TYPE_CUCKOO);
+}
+
+TEST_F(CuckooHitSetTest, InsertsMatch) {
+  rebuild(0.01, 100, 1);
+  fill(50);
+  verify_fill(50);
+  EXPECT_EQ((unsigned)50, hitset->approx_unique_insert_count());
+  EXPECT_FALSE(hitset->is_full());
+  fill(50);
+  EXPECT_EQ((unsigned)50, hitset->approx_unique_insert_count());
+}
+
+TEST_F(CuckooHitSetTest, FillsUp) {
+  rebuild(0.01, 20, 1);
+  fill(20);
+  verify_fill(20);
+  EXPECT_TRUE(hitset->is_full());
+}
+
+TEST_F(CuckooHitSetTest, RejectsNoMatch) {
+  rebuild(0.001, 100, 1);
+  fill(100);
+  verify_fill(100);
+
+  char buf[50];
+  int matches = 0;
+  for (int i = 100; i < 200; ++i) {
+    sprintf(buf, "hitsettest_%d", i);
+    hobject_t obj(object_t(buf), "", 0, i, 0, "");
+    if (hitset->contains(obj))
+      ++matches;
+  }
+  EXPECT_LT(matches, 2);
+}
+
+TEST_F(CuckooHitSetTest, CountAndRemove) {
+  rebuild(0.001, 100, 1);
+  hobject_t a(object_t("a"), "", 0, 1, 0, "");
+  hobject_t b(object_t("b"), "", 0, 2, 0, "");
+  for (unsigned i = 0; i < 3; ++i)
+    hitset->insert(a);
+  hitset->insert(b);
+  EXPECT_EQ(3u, hitset->get_count(a));
+  EXPECT_EQ(1u, hitset->get_count(b));
+  EXPECT_TRUE(hitset->remove(a));
+  EXPECT_FALSE(hitset->contains(a));
+  EXPECT_FALSE(hitset->remove(a));
+  EXPECT_TRUE(hitset->contains(b));
+  EXPECT_EQ(1u, hitset->approx_unique_insert_count());
+
+  // counts survive an encode/decode round trip
+  hitset->insert(b);
+  bufferlist bl;
+  ::encode(*hitset, bl);
+  HitSet copy;
+  bufferlist::iterator p = bl.begin();
+  ::decode(copy, p);
+  EXPECT_EQ(HitSet::TYPE_CUCKOO, copy.impl->get_type());
+  EXPECT_EQ(2u, copy.get_count(b));
+  EXPECT_FALSE(copy.contains(a));
+}
+
+TEST_F(CuckooHitSetTest, OtherTypesDoNotCount) {
+  HitSet explicit_set(new ExplicitObjectHitSet);
+  hobject_t a(object_t("a"), "", 0, 1, 0, "");
+  explicit_set.insert(a);
+  explicit_set.insert(a);
+  EXPECT_EQ(1u, explicit_set.get_count(a));
+  EXPECT_FALSE(explicit_set.remove(a));
+}
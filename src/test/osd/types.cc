@@ -1297,6 +1297,31 @@ TEST(pg_pool_t_test, get_random_pg_position) {
   }
 }
 
+TEST(pg_pool_t_test, encode_cuckoo_hit_set) {
+  pg_pool_t p;
+  p.hit_set_params = HitSet::Params(new CuckooHitSet::Params(.001, 300, 99));
+
+  bufferlist bl;
+  p.encode(bl, CEPH_FEATURES_ALL);
+  bufferlist::iterator bi = bl.begin();
+  pg_pool_t q;
+  q.decode(bi);
+  ASSERT_EQ(HitSet::TYPE_CUCKOO, q.hit_set_params.get_type());
+
+  // peers that cannot decode the cuckoo type get an equivalent bloom
+  bl.clear();
+  p.encode(bl, CEPH_FEATURES_ALL & ~CEPH_FEATURE_OSD_HITSET_CUCKOO);
+  bi = bl.begin();
+  q.decode(bi);
+  ASSERT_EQ(HitSet::TYPE_BLOOM, q.hit_set_params.get_type());
+  BloomHitSet::Params *bp =
+    static_cast<BloomHitSet::Params*>(q.hit_set_params.impl.get());
+  ASSERT_EQ(1000u, bp->fpp_micro);
+  ASSERT_EQ(300u, bp->target_size);
+  ASSERT_EQ(99u, bp->seed);
+  ASSERT_EQ(HitSet::TYPE_CUCKOO, p.hit_set_params.get_type());
+}
+
 TEST(shard_id_t, iostream) {
     set<shard_id_t> shards;
     shards.insert(shard_id_t(0));
@@ -0,0 +1,115 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Times Striper::file_to_extents over a few layouts and io sizes, the
+ * way librbd, the fs client and Filer call it for every io.
+ *
+ *   ceph_bench_striper [--iterations N] [--seed S]
+ */
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <sstream>
+
+#include "common/ceph_argparse.h"
+#include "common/Clock.h"
+#include "common/config.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "osdc/Striper.h"
+
+struct Case {
+  const char *name;
+  __u32 object_size, stripe_unit, stripe_count;
+  uint64_t io_len;
+};
+
+static const Case cases[] = {
+  { "rbd 4k",         4 << 20, 4 << 20, 1, 4096 },
+  { "rbd 64k",        4 << 20, 4 << 20, 1, 64 << 10 },
+  { "rbd 4m",         4 << 20, 4 << 20, 1, 4 << 20 },
+  { "rbd 16m",        4 << 20, 4 << 20, 1, 16 << 20 },
+  { "striped 4k",     4 << 20, 64 << 10, 8, 4096 },
+  { "striped 1m",     4 << 20, 64 << 10, 8, 1 << 20 },
+  { "striped 16m",    4 << 20, 64 << 10, 8, 16 << 20 },
+};
+
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+    ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  long long iterations = 100000;
+  long long seed = 1;
+  std::ostringstream err;
+  for (vector<const char*>::iterator i = args.begin(); i != args.end();) {
+    if (ceph_argparse_witharg(args, i, &iterations, err, "--iterations", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &seed, err, "--seed", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const uint64_t image_size = 10ull << 30;
+  cout << "case\tcall\tns/call\textents/call" << std::endl;
+  for (unsigned c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+    ceph_file_layout l;
+    memset(&l, 0, sizeof(l));
+    l.fl_object_size = cases[c].object_size;
+    l.fl_stripe_unit = cases[c].stripe_unit;
+    l.fl_stripe_count = cases[c].stripe_count;
+    l.fl_pg_pool = 1;
+
+    for (int api = 0; api < 2; ++api) {
+      srand(seed);
+      uint64_t extents = 0;
+      double start = cpu_seconds();
+      for (long long n = 0; n < iterations; ++n) {
+	uint64_t off = ((uint64_t)rand() * 4096) % (image_size - cases[c].io_len);
+	if (api == 0) {
+	  vector<ObjectExtent> ex;
+	  Striper::file_to_extents(g_ceph_context, "rbd_data.1234.%016llx", &l,
+				   off, cases[c].io_len, 0, ex);
+	  extents += ex.size();
+	} else {
+	  map<object_t, vector<ObjectExtent> > ex;
+	  Striper::file_to_extents(g_ceph_context, "rbd_data.1234.%016llx", &l,
+				   off, cases[c].io_len, 0, ex);
+	  extents += ex.size();
+	}
+      }
+      double cpu = cpu_seconds() - start;
+      cout << cases[c].name << "\t" << (api == 0 ? "vector" : "map") << "\t"
+	   << (uint64_t)(cpu * 1000000000.0 / iterations) << "\t"
+	   << (double)extents / iterations << std::endl;
+    }
+  }
+  return 0;
+}
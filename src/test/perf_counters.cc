@@ -22,6 +22,8 @@
 #include "common/config.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
+#include "common/Thread.h"
+#include "common/Formatter.h"
 
 #include "common/code_environment.h"
 #include "global/global_context.h"
@@ -123,6 +125,51 @@ TEST(PerfCounters, SinglePerfCounters) {
 
 }
 
+TEST(PerfCounters, DumpChanged) {
+  PerfCountersCollection coll(g_ceph_context);
+  PerfCounters* fake_pf = setup_test_perfcounters1(g_ceph_context);
+  coll.add(fake_pf);
+
+  std::stringstream ss;
+  {
+    JSONFormatter f;
+    coll.dump_changed(&f, "a");
+    f.flush(ss);
+  }
+  ASSERT_EQ(sd("{\"test_perfcounter_1\":{\"element1\":0,"
+	    "\"element2\":0.000000000,\"element3\":{\"avgcount\":0,\"sum\":0.000000000}}}"), ss.str());
+
+  ss.str("");
+  {
+    JSONFormatter f;
+    coll.dump_changed(&f, "a");
+    f.flush(ss);
+  }
+  ASSERT_EQ(sd("{}"), ss.str());
+
+  fake_pf->inc(TEST_PERFCOUNTERS1_ELEMENT_1);
+  ss.str("");
+  {
+    JSONFormatter f;
+    coll.dump_changed(&f, "a");
+    f.flush(ss);
+  }
+  ASSERT_EQ(sd("{\"test_perfcounter_1\":{\"element1\":1}}"), ss.str());
+
+  // each id has its own idea of what changed
+  ss.str("");
+  {
+    JSONFormatter f;
+    coll.dump_changed(&f, "b");
+    f.flush(ss);
+  }
+  ASSERT_EQ(sd("{\"test_perfcounter_1\":{\"element1\":1,"
+	    "\"element2\":0.000000000,\"element3\":{\"avgcount\":0,\"sum\":0.000000000}}}"), ss.str());
+
+  coll.remove(fake_pf);
+  delete fake_pf;
+}
+
 enum {
   TEST_PERFCOUNTERS2_ELEMENT_FIRST = 400,
   TEST_PERFCOUNTERS2_ELEMENT_FOO,
@@ -200,3 +247,74 @@ TEST(PerfCounters, CephContextPerfCounters) {
   // Restore to avoid impact to other test cases
   g_ceph_context->disable_perf_counter();
 }
+
+enum {
+  TEST_PERFCOUNTERS3_ELEMENT_FIRST = 600,
+  TEST_PERFCOUNTERS3_ELEMENT_CTR,
+  TEST_PERFCOUNTERS3_ELEMENT_AVG,
+  TEST_PERFCOUNTERS3_ELEMENT_HIST,
+  TEST_PERFCOUNTERS3_ELEMENT_VAL,
+  TEST_PERFCOUNTERS3_ELEMENT_LAST,
+};
+
+static PerfCounters* setup_test_perfcounters3(CephContext *cct)
+{
+  PerfCountersBuilder bld(cct, "test_perfcounter_3",
+	  TEST_PERFCOUNTERS3_ELEMENT_FIRST, TEST_PERFCOUNTERS3_ELEMENT_LAST);
+  bld.add_u64_counter(TEST_PERFCOUNTERS3_ELEMENT_CTR, "ctr");
+  bld.add_time_avg(TEST_PERFCOUNTERS3_ELEMENT_AVG, "avg");
+  bld.add_time_hist(TEST_PERFCOUNTERS3_ELEMENT_HIST, "hist");
+  bld.add_u64(TEST_PERFCOUNTERS3_ELEMENT_VAL, "val");
+  return bld.create_perf_counters();
+}
+
+class PerfCountersIncThread : public Thread {
+public:
+  PerfCounters *pc;
+  PerfCountersIncThread(PerfCounters *pc) : pc(pc) {}
+  void *entry() {
+    for (int i = 0; i < 1000; ++i) {
+      pc->inc(TEST_PERFCOUNTERS3_ELEMENT_CTR);
+      pc->tinc(TEST_PERFCOUNTERS3_ELEMENT_AVG, utime_t(0, 1000));
+      pc->tinc(TEST_PERFCOUNTERS3_ELEMENT_HIST, utime_t(0, 3000));  // 3 usec
+    }
+    return NULL;
+  }
+};
+
+TEST(PerfCounters, Sharded) {
+  g_ceph_context->_conf->set_val("perf_counter_shards", "4");
+  PerfCounters *pc = setup_test_perfcounters3(g_ceph_context);
+  g_ceph_context->_conf->set_val("perf_counter_shards", "0");
+
+  std::vector<PerfCountersIncThread*> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.push_back(new PerfCountersIncThread(pc));
+    threads.back()->create();
+  }
+  for (int i = 0; i < 8; ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  pc->set(TEST_PERFCOUNTERS3_ELEMENT_VAL, 7);
+
+  ASSERT_EQ(8000u, pc->get(TEST_PERFCOUNTERS3_ELEMENT_CTR));
+  ASSERT_EQ(7u, pc->get(TEST_PERFCOUNTERS3_ELEMENT_VAL));
+  ASSERT_EQ(utime_t(0, 8000000), pc->tget(TEST_PERFCOUNTERS3_ELEMENT_AVG));
+  ASSERT_EQ(8000u, pc->get_tavg_ms(TEST_PERFCOUNTERS3_ELEMENT_HIST).first);
+
+  JSONFormatter f;
+  pc->dump_formatted(&f, false, "hist");
+  std::stringstream ss;
+  f.flush(ss);
+  // 3 usec lands in the [2, 4) usec bucket
+  ASSERT_EQ(sd("{\"test_perfcounter_3\":{\"hist\":{\"avgcount\":8000,"
+	       "\"sum\":0.024000000,\"histogram\":[0,0,8000"
+	       ",0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]}}}"), ss.str());
+
+  pc->reset();
+  ASSERT_EQ(0u, pc->get(TEST_PERFCOUNTERS3_ELEMENT_CTR));
+  ASSERT_EQ(7u, pc->get(TEST_PERFCOUNTERS3_ELEMENT_VAL));
+  ASSERT_EQ(0u, pc->get_tavg_ms(TEST_PERFCOUNTERS3_ELEMENT_HIST).first);
+  delete pc;
+}
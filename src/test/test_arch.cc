@@ -79,6 +79,12 @@ TEST(Arch, all)
   expected = strstr(flags, " sse2 ") ? 1 : 0;
   EXPECT_EQ(expected, ceph_arch_intel_sse2);
 
+  expected = strstr(flags, " avx2 ") ? 1 : 0;
+  EXPECT_EQ(expected, ceph_arch_intel_avx2);
+
+  expected = (strstr(flags, " avx512f ") && strstr(flags, " avx512bw ")) ? 1 : 0;
+  EXPECT_EQ(expected, ceph_arch_intel_avx512);
+
 #endif
 
 #endif
@@ -9,6 +9,7 @@
 #include "common/config.h"
 #include "common/Finisher.h"
 #include "os/FileJournal.h"
+#include "os/PMemJournal.h"
 #include "include/Context.h"
 #include "common/Mutex.h"
 #include "common/safe_io.h"
@@ -248,6 +249,53 @@ TEST(TestFileJournal, WriteManyVecs) {
   }
 }
 
+TEST(TestFileJournal, WriteStriped) {
+  g_ceph_context->_conf->set_val("journal_ignore_corruption", "false");
+  g_ceph_context->_conf->set_val("journal_write_header_frequency", "0");
+  g_ceph_context->_conf->set_val("journal_aio_queues", "4");
+  g_ceph_context->_conf->set_val("journal_aio_stripe_size", "16384");
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  // only the aio subtest uses the submit queues
+  SCOPED_TRACE(subtests[2].description);
+  fsid.generate_random();
+  FileJournal j(fsid, finisher, &sync_cond, path, subtests[2].directio,
+		subtests[2].aio, subtests[2].faio);
+  ASSERT_EQ(0, j.create());
+  j.make_writeable();
+
+  C_GatherBuilder gb(g_ceph_context, new C_SafeCond(&wait_lock, &cond, &done));
+
+  vector<bufferlist> written;
+  for (int i = 0; i < 20; i++) {
+    bufferlist bl;
+    bufferptr bp = buffer::create_page_aligned(4096 * (i + 1));
+    memset(bp.c_str(), (char)i, bp.length());
+    bl.append(bp);
+    written.push_back(bl);
+    j.submit_entry(i + 1, bl, 0, gb.new_sub());
+  }
+  gb.activate();
+  wait();
+
+  j.close();
+
+  j.open(0);
+  for (int i = 0; i < 20; i++) {
+    bufferlist inbl;
+    uint64_t seq = 0;
+    ASSERT_EQ(true, j.read_entry(inbl, seq));
+    ASSERT_EQ((uint64_t)i + 1, seq);
+    ASSERT_TRUE(inbl.contents_equal(written[i]));
+  }
+  j.make_writeable();
+  j.close();
+
+  g_ceph_context->_conf->set_val("journal_aio_queues", "1");
+  g_ceph_context->_conf->set_val("journal_aio_stripe_size", "0");
+  g_ceph_context->_conf->apply_changes(NULL);
+}
+
 TEST(TestFileJournal, ReplaySmall) {
   g_ceph_context->_conf->set_val("journal_ignore_corruption", "false");
   g_ceph_context->_conf->set_val("journal_write_header_frequency", "0");
@@ -634,3 +682,125 @@ TEST(TestFileJournal, ReplayDetectCorruptHeader) {
     ::close(fd);
   }
 }
+
+TEST(TestPMemJournal, Replay) {
+  g_ceph_context->_conf->set_val("journal_pmem_msync", "true");
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  fsid.generate_random();
+  PMemJournal j(fsid, finisher, &sync_cond, path);
+  ASSERT_EQ(0, j.create());
+  ASSERT_EQ(0, j.check());
+  ASSERT_EQ(0, j.open(0));
+  j.make_writeable();
+
+  done = false;
+  C_GatherBuilder gb(g_ceph_context, new C_SafeCond(&wait_lock, &cond, &done));
+  for (uint64_t seq = 1; seq <= 3; ++seq) {
+    bufferlist bl;
+    bl.append(string(seq * 1000, 'a' + seq));
+    j.submit_entry(seq, bl, 0, gb.new_sub());
+  }
+  gb.activate();
+  wait();
+  j.close();
+
+  uuid_d peeked;
+  ASSERT_EQ(0, j.peek_fsid(peeked));
+  ASSERT_EQ(fsid, peeked);
+
+  ASSERT_EQ(0, j.open(1));
+  bufferlist inbl;
+  uint64_t seq = 0;
+  for (uint64_t expect = 1; expect <= 3; ++expect) {
+    ASSERT_TRUE(j.read_entry(inbl, seq));
+    ASSERT_EQ(expect, seq);
+    ASSERT_EQ(string(seq * 1000, 'a' + seq), string(inbl.c_str(), inbl.length()));
+  }
+  ASSERT_FALSE(j.read_entry(inbl, seq));
+  j.make_writeable();
+  j.close();
+}
+
+TEST(TestPMemJournal, TrimAndWrap) {
+  g_ceph_context->_conf->set_val("journal_pmem_msync", "true");
+  g_ceph_context->_conf->set_val("osd_journal_size", "2");
+  g_ceph_context->_conf->apply_changes(NULL);
+  unlink(path);
+
+  fsid.generate_random();
+  PMemJournal j(fsid, finisher, &sync_cond, path);
+  ASSERT_EQ(0, j.create());
+  ASSERT_EQ(0, j.open(0));
+  j.make_writeable();
+
+  // ~300KB entries in a 2MB journal: trimming as we go, this wraps
+  // several times
+  uint64_t seq;
+  for (seq = 1; seq <= 20; ++seq) {
+    bufferlist bl;
+    bl.append(string(300000 + seq, 'a' + seq));
+    done = false;
+    j.submit_entry(seq, bl, 0, new C_SafeCond(&wait_lock, &cond, &done));
+    wait();
+    if (seq > 2)
+      j.committed_thru(seq - 2);
+  }
+  j.close();
+
+  // seqs 19 and 20 are still live
+  ASSERT_EQ(0, j.open(18));
+  bufferlist inbl;
+  ASSERT_TRUE(j.read_entry(inbl, seq));
+  ASSERT_EQ(19u, seq);
+  ASSERT_EQ(string(300000 + seq, 'a' + seq), string(inbl.c_str(), inbl.length()));
+  ASSERT_TRUE(j.read_entry(inbl, seq));
+  ASSERT_EQ(20u, seq);
+  ASSERT_FALSE(j.read_entry(inbl, seq));
+  j.make_writeable();
+  j.close();
+
+  char mb[10];
+  sprintf(mb, "%u", size_mb);
+  g_ceph_context->_conf->set_val("osd_journal_size", mb);
+  g_ceph_context->_conf->apply_changes(NULL);
+  unlink(path);
+}
+
+TEST(TestPMemJournal, ReplayDetectCorruptPayload) {
+  g_ceph_context->_conf->set_val("journal_pmem_msync", "true");
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  fsid.generate_random();
+  PMemJournal j(fsid, finisher, &sync_cond, path);
+  ASSERT_EQ(0, j.create());
+  ASSERT_EQ(0, j.open(0));
+  j.make_writeable();
+
+  done = false;
+  C_GatherBuilder gb(g_ceph_context, new C_SafeCond(&wait_lock, &cond, &done));
+  bufferlist bl;
+  bl.append(string(100, 'x'));
+  j.submit_entry(1, bl, 0, gb.new_sub());
+  bl.append(string(100, 'y'));
+  j.submit_entry(2, bl, 0, gb.new_sub());
+  gb.activate();
+  wait();
+  j.close();
+
+  // flip a payload byte of the second entry: header (4096), then the
+  // first entry (64 byte entry header + 100 bytes, rounded to 192)
+  int fd = ::open(path, O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(1, pwrite(fd, "z", 1, 4096 + 192 + 64 + 10));
+  ::close(fd);
+
+  ASSERT_EQ(0, j.open(0));
+  bufferlist inbl;
+  uint64_t seq = 0;
+  ASSERT_TRUE(j.read_entry(inbl, seq));
+  ASSERT_EQ(1u, seq);
+  ASSERT_FALSE(j.read_entry(inbl, seq));
+  j.make_writeable();
+  j.close();
+}
@@ -269,3 +269,32 @@ TEST(PageSet, FreeHoles)
   pages.get_range(0, 8, range);
   ASSERT_EQ(0u, range.size());
 }
+
+TEST(PageSet, Arena)
+{
+  PageArena arena(4096, false);
+  {
+    PageSet pages(4096, &arena);
+    PageSet::page_vector range;
+    pages.alloc_range(0, 4 * 4096, range);
+    ASSERT_EQ(4u, range.size());
+    ASSERT_EQ(4u * 4096, arena.get_used());
+    ASSERT_LE(arena.get_used(), arena.get_mapped());
+    range.clear();
+
+    // freed pages go back to the arena and are reused
+    uint64_t mapped = arena.get_mapped();
+    pages.free_pages_after(4096);
+    ASSERT_EQ(2u * 4096, arena.get_used());
+    pages.alloc_range(2 * 4096, 2 * 4096, range);
+    ASSERT_EQ(4u * 4096, arena.get_used());
+    ASSERT_EQ(mapped, arena.get_mapped());
+  }
+  ASSERT_EQ(0u, arena.get_used());
+
+  // pages of another size don't come from the arena
+  PageSet other(1, &arena);
+  PageSet::page_vector range;
+  other.alloc_range(0, 4, range);
+  ASSERT_EQ(0u, arena.get_used());
+}
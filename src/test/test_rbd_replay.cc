@@ -17,7 +17,9 @@
 #include <stdint.h>
 #include <boost/foreach.hpp>
 #include <cstdarg>
+#include "rbd_replay/BufferReader.h"
 #include "rbd_replay/ImageNameMap.hpp"
+#include "rbd_replay/LatencyStats.hpp"
 #include "rbd_replay/ios.hpp"
 #include "rbd_replay/rbd_loc.hpp"
 
@@ -132,3 +134,62 @@ TEST(RBDReplay, rbd_loc_parse) {
   EXPECT_FALSE(m.parse("a@b/c"));
 }
 
+TEST(RBDReplay, LatencyStats) {
+  LatencyStats stats;
+  EXPECT_EQ(0U, stats.percentile(50));
+
+  // 90 ios at 3us, 9 at 100us, one at 5ms
+  for (int i = 0; i < 90; i++) {
+    stats.add(4096, 3000);
+  }
+  for (int i = 0; i < 9; i++) {
+    stats.add(4096, 100000);
+  }
+  stats.add(1 << 20, 5000000);
+
+  EXPECT_EQ(100U, stats.ops());
+  EXPECT_EQ(99U * 4096 + (1 << 20), stats.bytes());
+  // buckets are powers of two microseconds
+  EXPECT_EQ(4000U, stats.percentile(50));
+  EXPECT_EQ(128000U, stats.percentile(95));
+  EXPECT_EQ(5000000U, stats.percentile(99.5));
+  EXPECT_EQ(5000000U, stats.percentile(100));
+}
+
+TEST(RBDReplay, BufferReaderCompressed) {
+  char path[] = "/tmp/test_rbd_replay_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_LE(0, fd);
+  unlink(path);
+
+  bufferlist out;
+  out.append("banner");
+  bufferlist block;
+  for (uint32_t i = 0; i < 100000; i++) {
+    ::encode(i, block);
+    if (block.length() >= 4096) {
+      ASSERT_EQ(0, encode_compressed_block(block, &out));
+      block.clear();
+    }
+  }
+  ASSERT_EQ(0, encode_compressed_block(block, &out));
+  ASSERT_EQ(0, out.write_fd(fd));
+  ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+
+  BufferReader reader(fd, 1024, 8192);
+  bufferlist::iterator *it;
+  ASSERT_EQ(0, reader.fetch(&it));
+  std::string banner;
+  it->copy(6, banner);
+  ASSERT_EQ("banner", banner);
+  reader.set_compressed();
+  for (uint32_t i = 0; i < 100000; i++) {
+    ASSERT_EQ(0, reader.fetch(&it));
+    uint32_t v;
+    ::decode(v, *it);
+    ASSERT_EQ(i, v);
+  }
+  ASSERT_EQ(0, reader.fetch(&it));
+  ASSERT_EQ(0U, it->get_remaining());
+  close(fd);
+}
@@ -512,6 +512,16 @@ public:
       rand_choose(snap_to_hobject);
     set<hobject_t, hobject_t::BitwiseComparator> hobjects = snap->second;
 
+    // a batch big enough for the whole snap returns each object once
+    vector<hobject_t> batch;
+    int r = mapper->get_next_objects_to_trim(
+      snap->first, hobjects.size() + 1, &batch);
+    assert(r == (hobjects.empty() ? -ENOENT : 0));
+    assert(batch.size() == hobjects.size());
+    set<hobject_t, hobject_t::BitwiseComparator> in_batch(
+      batch.begin(), batch.end());
+    assert(in_batch == hobjects);
+
     hobject_t hoid;
     while (mapper->get_next_object_to_trim(snap->first, &hoid) == 0) {
       assert(!hoid.is_max());
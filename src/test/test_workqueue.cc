@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 
 #include "common/WorkQueue.h"
+#include "common/Finisher.h"
+#include "common/MPSCQueue.h"
 #include "global/global_context.h"
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
@@ -57,6 +59,116 @@ TEST(WorkQueue, Resize)
   tp.stop();
 }
 
+TEST(MPSCQueue, PopAllIsFIFO)
+{
+  MPSCQueue<int> q;
+  ASSERT_TRUE(q.empty());
+  ASSERT_TRUE(q.push(1));
+  ASSERT_FALSE(q.push(2));
+  ASSERT_FALSE(q.push(3));
+  vector<int> out;
+  ASSERT_EQ(3u, q.pop_all(out));
+  ASSERT_TRUE(q.empty());
+  ASSERT_EQ(1, out[0]);
+  ASSERT_EQ(2, out[1]);
+  ASSERT_EQ(3, out[2]);
+  ASSERT_EQ(0u, q.pop_all(out));
+  ASSERT_TRUE(q.push(4));
+}
+
+struct C_Record : public Context {
+  Mutex *lock;
+  vector<pair<int,int> > *done;
+  int id;
+  C_Record(Mutex *l, vector<pair<int,int> > *d, int i)
+    : lock(l), done(d), id(i) {}
+  void finish(int r) {
+    Mutex::Locker l(*lock);
+    done->push_back(make_pair(id, r));
+  }
+};
+
+TEST(Finisher, Lockless)
+{
+  g_conf->set_val("finisher_lockless_queue", "true");
+  g_conf->apply_changes(NULL);
+  Finisher f(g_ceph_context);
+  g_conf->set_val("finisher_lockless_queue", "false");
+  g_conf->apply_changes(NULL);
+
+  Mutex lock("Finisher::Lockless::lock");
+  vector<pair<int,int> > done;
+  f.start();
+  for (int i = 0; i < 1000; ++i)
+    f.queue(new C_Record(&lock, &done, i), i % 3 ? 0 : -i);
+  list<Context*> ls;
+  for (int i = 1000; i < 1010; ++i)
+    ls.push_back(new C_Record(&lock, &done, i));
+  f.queue(ls);
+  ASSERT_TRUE(ls.empty());
+  f.wait_for_empty();
+  {
+    Mutex::Locker l(lock);
+    ASSERT_EQ(1010u, done.size());
+    for (int i = 0; i < 1010; ++i) {
+      ASSERT_EQ(i, done[i].first);
+      ASSERT_EQ(i < 1000 && i % 3 == 0 ? -i : 0, done[i].second);
+    }
+  }
+
+  // the worker parks once idle, and must still be woken
+  sleep(1);
+  f.queue(new C_Record(&lock, &done, 1010));
+  f.wait_for_empty();
+  {
+    Mutex::Locker l(lock);
+    ASSERT_EQ(1011u, done.size());
+  }
+  f.stop();
+}
+
+struct CountBatchWQ : public ThreadPool::BatchWorkQueue<int> {
+  list<int*> q;
+  atomic_t processed;
+  CountBatchWQ(ThreadPool *tp)
+    : ThreadPool::BatchWorkQueue<int>("CountBatchWQ", 100, 100, tp) {}
+  bool _enqueue(int *item) {
+    q.push_back(item);
+    return true;
+  }
+  void _dequeue(int *item) {
+    q.remove(item);
+  }
+  void _dequeue(list<int*> *out) {
+    out->swap(q);
+  }
+  using ThreadPool::BatchWorkQueue<int>::_process;
+  void _process(const list<int*> &items) {
+    processed.add(items.size());
+  }
+  void _clear() { q.clear(); }
+  bool _empty() { return q.empty(); }
+};
+
+TEST(WorkQueue, BatchLockless)
+{
+  ThreadPool tp(g_ceph_context, "batch", 4, "");
+  CountBatchWQ wq(&tp);
+  int items[100];
+  tp.start();
+  for (int i = 0; i < 100; ++i)
+    wq.queue_lockless(&items[i]);
+  // dequeue sees items still sitting in the inbox
+  tp.pause();
+  int extra;
+  wq.queue_lockless(&extra);
+  wq.dequeue(&extra);
+  tp.unpause();
+  wq.drain();
+  ASSERT_EQ(100u, wq.processed.read());
+  tp.stop();
+}
+
 
 int main(int argc, char **argv)
 {
@@ -373,12 +373,10 @@ class RadosDump
         footer ft;
         ft.encode(blftr);
 
-        int ret = blhdr.write_fd(fd);
-        if (ret) return ret;
-        ret = bl.write_fd(fd);
-        if (ret) return ret;
-        ret = blftr.write_fd(fd);
-        return ret;
+        // one write for the whole section
+        blhdr.claim_append(bl);
+        blhdr.claim_append(blftr);
+        return blhdr.write_fd(fd);
       }
 
     int write_simple(sectiontype_t type, int fd)
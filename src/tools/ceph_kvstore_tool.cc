@@ -203,6 +203,13 @@ class StoreTool
 
     return 0;
   }
+
+  void compact(const string &prefix, const string &start, const string &end) {
+    utime_t started_at = ceph_clock_now(g_ceph_context);
+    db->compact_keys(prefix, start, end);
+    utime_t time_taken = ceph_clock_now(g_ceph_context) - started_at;
+    std::cout << "compacted in " << time_taken << " seconds" << std::endl;
+  }
 };
 
 void usage(const char *pname)
@@ -219,6 +226,9 @@ void usage(const char *pname)
     << "  set <prefix> <key> [ver <N>|in <file>]\n"
     << "  store-copy <path> [num-keys-per-tx]\n"
     << "  store-crc <path>\n"
+    << "  compact\n"
+    << "  compact-prefix <prefix>\n"
+    << "  compact-range <prefix> <start> <end>\n"
     << std::endl;
 }
 
@@ -415,6 +425,20 @@ int main(int argc, const char *argv[])
     uint32_t crc = st.traverse(string(), true, NULL);
     std::cout << "store at '" << path << "' crc " << crc << std::endl;
 
+  } else if (cmd == "compact") {
+    st.compact(string(), string(), string());
+  } else if (cmd == "compact-prefix") {
+    if (argc < 5) {
+      usage(argv[0]);
+      return 1;
+    }
+    st.compact(argv[4], string(), string());
+  } else if (cmd == "compact-range") {
+    if (argc < 7) {
+      usage(argv[0]);
+      return 1;
+    }
+    st.compact(argv[4], argv[5], argv[6]);
   } else {
     std::cerr << "Unrecognized command: " << cmd << std::endl;
     return 1;
@@ -569,7 +569,10 @@ int write_pg(ObjectStore::Transaction &t, epoch_t epoch, pg_info_t &info,
   return 0;
 }
 
-const int OMAP_BATCH_SIZE = 25;
+const int OMAP_BATCH_SIZE = 1000;
+// import applies objects together until their transaction gets this big
+const int IMPORT_BATCH_OPS = 1000;
+const uint64_t IMPORT_BATCH_BYTES = 64 << 20;
 void get_omap_batch(ObjectMap::ObjectMapIterator &iter, map<string, bufferlist> &oset)
 {
   oset.clear();
@@ -952,10 +955,8 @@ int get_omap(ObjectStore *store, coll_t coll, ghobject_t hoid,
 int ObjectStoreTool::get_object(ObjectStore *store, coll_t coll,
 				bufferlist &bl, OSDMap &curmap,
 				bool *skipped_objects,
-				ObjectStore::Sequencer &osr)
+				ObjectStore::Transaction *t)
 {
-  ObjectStore::Transaction tran;
-  ObjectStore::Transaction *t = &tran;
   bufferlist::iterator ebliter = bl.begin();
   object_begin ob;
   ob.decode(ebliter);
@@ -1045,8 +1046,6 @@ int ObjectStoreTool::get_object(ObjectStore *store, coll_t coll,
       return -EFAULT;
     }
   }
-  if (!dry_run)
-    store->apply_transaction(&osr, *t);
   return 0;
 }
 
@@ -1369,6 +1368,10 @@ int ObjectStoreTool::do_import(ObjectStore *store, OSDSuperblock& sb,
   }
   cout << std::endl;
 
+  // Objects go to the store a batch at a time rather than one by one.
+  // A batch cut short by a crash is no worse than a single object:
+  // the collection stays marked for removal until the end.
+  ObjectStore::Transaction batch;
   bool done = false;
   bool found_metadata = false;
   metadata_section ms;
@@ -1384,8 +1387,14 @@ int ObjectStoreTool::do_import(ObjectStore *store, OSDSuperblock& sb,
     }
     switch(type) {
     case TYPE_OBJECT_BEGIN:
-      ret = get_object(store, coll, ebl, curmap, &skipped_objects, osr);
+      ret = get_object(store, coll, ebl, curmap, &skipped_objects, &batch);
       if (ret) return ret;
+      if (batch.get_num_ops() >= IMPORT_BATCH_OPS ||
+	  batch.get_num_bytes() >= IMPORT_BATCH_BYTES) {
+	store->apply_transaction(&osr, batch);
+	ObjectStore::Transaction next;
+	batch.swap(next);
+      }
       break;
     case TYPE_PG_METADATA:
       ret = get_pg_metadata(store, ebl, ms, sb, curmap, pgid);
@@ -1400,6 +1409,8 @@ int ObjectStoreTool::do_import(ObjectStore *store, OSDSuperblock& sb,
       return -EFAULT;
     }
   }
+  if (!batch.empty())
+    store->apply_transaction(&osr, batch);
 
   if (!found_metadata) {
     cerr << "Missing metadata section" << std::endl;
@@ -33,7 +33,7 @@ class ObjectStoreTool : public RadosDump
           map<epoch_t,pg_interval_t> &past_intervals);
     int get_object(ObjectStore *store, coll_t coll,
 		   bufferlist &bl, OSDMap &curmap, bool *skipped_objects,
-		   ObjectStore::Sequencer &osr);
+		   ObjectStore::Transaction *t);
     int export_file(
         ObjectStore *store, coll_t cid, ghobject_t &obj);
     int export_files(ObjectStore *store, coll_t coll);
@@ -31,8 +31,13 @@ void DataScan::usage()
 {
   std::cout << "Usage: \n"
     << "  cephfs-data-scan init [--force-init]\n"
-    << "  cephfs-data-scan scan_extents [--force-pool] <data pool name>\n"
-    << "  cephfs-data-scan scan_inodes [--force-pool] [--force-corrupt] <data pool name>\n"
+    << "  cephfs-data-scan scan_extents [--force-pool] [<scan options>] <data pool name>\n"
+    << "  cephfs-data-scan scan_inodes [--force-pool] [--force-corrupt] [<scan options>] <data pool name>\n"
+    << "\n"
+    << "    scan options:\n"
+    << "      -n <worker number> -m <worker count>: scan slice n (0 to m-1) of m\n"
+    << "      --window <n>: objects to have in flight at once (default 32)\n"
+    << "      --checkpoint <file>: record progress in file, and resume from it\n"
     << "\n"
     << "    --force-corrupt: overrite apparently corrupt structures\n"
     << "    --force-init: write root inodes even if they exist\n"
@@ -71,6 +76,18 @@ bool DataScan::parse_kwarg(
       return false;
     }
     return true;
+  } else if (arg == std::string("--window")) {
+    std::string err;
+    window = strict_strtoll(val.c_str(), 10, &err);
+    if (!err.empty() || window == 0) {
+      std::cerr << "Invalid window '" << val << "'" << std::endl;
+      *r = -EINVAL;
+      return false;
+    }
+    return true;
+  } else if (arg == std::string("--checkpoint")) {
+    checkpoint_path = val;
+    return true;
   } else if (arg == std::string("-m")) {
     std::string err;
     m = strict_strtoll(val.c_str(), 10, &err);
@@ -151,6 +168,11 @@ int DataScan::main(const std::vector<const char*> &args)
     return -EINVAL;
   }
 
+  if (m == 0 || n >= m) {
+    std::cerr << "Invalid worker number " << n << " of " << m << std::endl;
+    return -EINVAL;
+  }
+
   // Default to output to metadata pool
   if (driver == NULL) {
     driver = new MetadataDriver();
@@ -372,85 +394,189 @@ int parse_oid(const std::string &oid, uint64_t *inode_no, uint64_t *obj_id)
   return 0;
 }
 
-// Pending sharded pgls & add in progress mechanism for that
-#undef SHARDEDPGLS
+/// wait for a window of aio, putting the result of each in rvals
+static void wait_window(std::vector<librados::AioCompletion*> &comps,
+                        std::vector<int> *rvals)
+{
+  for (size_t j = 0; j < comps.size(); ++j) {
+    if (comps[j] == NULL) {
+      // never sent: rvals already has the error
+      continue;
+    }
+    comps[j]->wait_for_complete();
+    (*rvals)[j] = comps[j]->get_return_value();
+    comps[j]->release();
+    comps[j] = NULL;
+  }
+}
 
-int DataScan::scan_extents()
+uint64_t DataScan::load_checkpoint(const std::string &command)
+{
+  if (checkpoint_path.empty()) {
+    return 0;
+  }
+
+  std::ifstream f(checkpoint_path.c_str());
+  if (!f.is_open()) {
+    return 0;
+  }
+  std::string cp_command;
+  uint32_t cp_n, cp_m;
+  uint64_t done;
+  if (!(f >> cp_command >> cp_n >> cp_m >> done)) {
+    std::cerr << "Ignoring unreadable checkpoint '" << checkpoint_path << "'"
+      << std::endl;
+    return 0;
+  }
+  if (cp_command != command || cp_n != n || cp_m != m) {
+    std::cerr << "Ignoring checkpoint '" << checkpoint_path << "' of "
+      << cp_command << " worker " << cp_n << "/" << cp_m << std::endl;
+    return 0;
+  }
+  return done;
+}
+
+int DataScan::save_checkpoint(const std::string &command, uint64_t done)
+{
+  if (checkpoint_path.empty()) {
+    return 0;
+  }
+
+  // Write it aside and rename it into place, so that an interruption
+  // leaves either the old checkpoint or the new one
+  std::string tmp_path = checkpoint_path + ".tmp";
+  {
+    std::ofstream f(tmp_path.c_str(), std::ios::trunc);
+    f << command << " " << n << " " << m << " " << done << std::endl;
+    if (!f.good()) {
+      derr << "Failed to write checkpoint '" << tmp_path << "'" << dendl;
+      return -EIO;
+    }
+  }
+  if (::rename(tmp_path.c_str(), checkpoint_path.c_str()) < 0) {
+    int r = -errno;
+    derr << "Failed to write checkpoint '" << checkpoint_path << "': "
+      << cpp_strerror(r) << dendl;
+    return r;
+  }
+  dout(4) << command << ": " << done << " objects done" << dendl;
+  return 0;
+}
+
+librados::NObjectIterator DataScan::list_begin(
+    const std::string &command, uint64_t *done)
 {
-#ifdef SHARDED_PGLS
-  float progress = 0.0;
-  librados::NObjectIterator i = data_io.nobjects_begin(n, m);
-#else
-  librados::NObjectIterator i = data_io.nobjects_begin();
-#endif
+  // Each worker lists its own slice of the PGs
+  librados::NObjectIterator i = m > 1 ?
+    data_io.nobjects_begin_slice(m, n) : data_io.nobjects_begin();
+
+  // A slice cannot be seeked into, but listing is cheap next to what
+  // we do for each object.  The pool is not supposed to change during
+  // a scan, so the first *done objects are the ones the interrupted
+  // run got through.
+  *done = load_checkpoint(command);
+  if (*done > 0) {
+    std::cerr << "Resuming " << command << " after " << *done << " objects"
+      << std::endl;
+  }
+  for (uint64_t k = 0; k < *done && i != data_io.nobjects_end(); ++k) {
+    ++i;
+  }
+  return i;
+}
 
+int DataScan::scan_extents()
+{
+  uint64_t done = 0;
+  librados::NObjectIterator i = list_begin("scan_extents", &done);
   librados::NObjectIterator i_end = data_io.nobjects_end();
-  int r = 0;
 
-  for (; i != i_end; ++i) {
-    const std::string oid = i->get_oid();
-#ifdef SHARDED_PGLS
-    if (i.get_progress() != progress) {
-      if (int(i.get_progress() * 100) / 5 != int(progress * 100) / 5) {
-        std::cerr << percentify(i.get_progress()) << "%" << std::endl;
+  while (i != i_end) {
+    // Stat a window of objects at once, then accumulate what that
+    // found into their 0th objects at once
+    std::vector<std::string> oids;
+    for (; i != i_end && oids.size() < window; ++i) {
+      oids.push_back(i->get_oid());
+    }
+
+    std::vector<uint64_t> sizes(oids.size());
+    std::vector<time_t> mtimes(oids.size());
+    std::vector<int> rvals(oids.size());
+    std::vector<librados::AioCompletion*> comps(oids.size());
+    for (size_t j = 0; j < oids.size(); ++j) {
+      comps[j] = librados::Rados::aio_create_completion();
+      rvals[j] = data_io.aio_stat(oids[j], comps[j], &sizes[j], &mtimes[j]);
+      if (rvals[j] < 0) {
+        comps[j]->release();
+        comps[j] = NULL;
       }
-      progress = i.get_progress();
     }
-#endif
+    wait_window(comps, &rvals);
+
+    for (size_t j = 0; j < oids.size(); ++j) {
+      const std::string &oid = oids[j];
+      if (rvals[j] != 0) {
+        dout(4) << "Cannot stat '" << oid << "': skipping" << dendl;
+        rvals[j] = 0;
+        continue;
+      }
 
-    // Read size
-    uint64_t size;
-    time_t mtime;
-    r = data_io.stat(oid, &size, &mtime);
-    if (r != 0) {
-      dout(4) << "Cannot stat '" << oid << "': skipping" << dendl;
-      continue;
+      // I need to keep track of
+      //  * The highest object ID seen
+      //  * The size of the highest object ID seen
+      //  * The largest object seen
+      //
+      //  Given those things, I can later infer the object chunking
+      //  size, the offset of the last object (chunk size * highest ID seen)
+      //  and the actual size (offset of last object + size of highest ID seen)
+      //
+      //  This logic doesn't take account of striping.
+      uint64_t inode_no = 0;
+      uint64_t obj_id = 0;
+      int r = parse_oid(oid, &inode_no, &obj_id);
+      if (r != 0) {
+        dout(4) << "Bad object name '" << oid << "' skipping" << dendl;
+        rvals[j] = 0;
+        continue;
+      }
+
+      comps[j] = librados::Rados::aio_create_completion();
+      rvals[j] = ClsCephFSClient::aio_accumulate_inode_metadata(
+          data_io,
+          comps[j],
+          inode_no,
+          obj_id,
+          sizes[j],
+          mtimes[j]);
+      if (rvals[j] < 0) {
+        comps[j]->release();
+        comps[j] = NULL;
+      }
     }
+    wait_window(comps, &rvals);
 
-    // I need to keep track of
-    //  * The highest object ID seen
-    //  * The size of the highest object ID seen
-    //  * The largest object seen
-    //
-    //  Given those things, I can later infer the object chunking
-    //  size, the offset of the last object (chunk size * highest ID seen)
-    //  and the actual size (offset of last object + size of highest ID seen)
-    //
-    //  This logic doesn't take account of striping.
-    uint64_t inode_no = 0;
-    uint64_t obj_id = 0;
-    r = parse_oid(oid, &inode_no, &obj_id);
-    if (r != 0) {
-      dout(4) << "Bad object name '" << oid << "' skipping" << dendl;
-      continue;
+    for (size_t j = 0; j < oids.size(); ++j) {
+      if (rvals[j] < 0) {
+        derr << "Failed to accumulate metadata data from '"
+          << oids[j] << "': " << cpp_strerror(rvals[j]) << dendl;
+      }
     }
 
-    int r = ClsCephFSClient::accumulate_inode_metadata(
-        data_io,
-        inode_no,
-        obj_id,
-        size,
-        mtime);
+    done += oids.size();
+    int r = save_checkpoint("scan_extents", done);
     if (r < 0) {
-      derr << "Failed to accumulate metadata data from '"
-        << oid << "': " << cpp_strerror(r) << dendl;
-      continue;
+      return r;
     }
   }
 
+  if (!checkpoint_path.empty()) {
+    ::unlink(checkpoint_path.c_str());
+  }
   return 0;
 }
 
 int DataScan::scan_inodes()
 {
-#ifdef SHARDED_PGLS
-  float progress = 0.0;
-  librados::NObjectIterator i = data_io.nobjects_begin(n, m);
-#else
-  librados::NObjectIterator i = data_io.nobjects_begin();
-#endif
-  librados::NObjectIterator i_end = data_io.nobjects_end();
-
   bool roots_present;
   int r = driver->check_roots(&roots_present);
   if (r != 0) {
@@ -465,131 +591,180 @@ int DataScan::scan_inodes()
     return -EIO;
   }
 
-  for (; i != i_end; ++i) {
-    const std::string oid = i->get_oid();
-#ifdef SHARDED_PGLS
-    if (i.get_progress() != progress) {
-      if (int(i.get_progress() * 100) / 5 != int(progress * 100) / 5) {
-        std::cerr << percentify(i.get_progress()) << "%" << std::endl;
+  uint64_t done = 0;
+  librados::NObjectIterator i = list_begin("scan_inodes", &done);
+  librados::NObjectIterator i_end = data_io.nobjects_end();
+
+  while (i != i_end) {
+    // Read the xattrs of a window of 0th objects at once
+    std::vector<std::string> oids;
+    std::vector<uint64_t> inos;
+    uint64_t listed = 0;
+    for (; i != i_end && oids.size() < window; ++i) {
+      ++listed;
+      const std::string oid = i->get_oid();
+
+      uint64_t obj_name_ino = 0;
+      uint64_t obj_name_offset = 0;
+      r = parse_oid(oid, &obj_name_ino, &obj_name_offset);
+      if (r != 0) {
+        dout(4) << "Bad object name '" << oid << "', skipping" << dendl;
+        continue;
+      }
+
+      // We are only interested in 0th objects during this phase: we touched
+      // the other objects during scan_extents
+      if (obj_name_offset != 0) {
+        continue;
       }
-      progress = i.get_progress();
+
+      oids.push_back(oid);
+      inos.push_back(obj_name_ino);
     }
-#endif
 
-    uint64_t obj_name_ino = 0;
-    uint64_t obj_name_offset = 0;
-    r = parse_oid(oid, &obj_name_ino, &obj_name_offset);
-    if (r != 0) {
-      dout(4) << "Bad object name '" << oid << "', skipping" << dendl;
-      continue;
+    std::vector<std::map<std::string, bufferlist> > attrs(oids.size());
+    std::vector<int> rvals(oids.size());
+    std::vector<librados::AioCompletion*> comps(oids.size());
+    for (size_t j = 0; j < oids.size(); ++j) {
+      librados::ObjectReadOperation op;
+      op.getxattrs(&attrs[j], NULL);
+      comps[j] = librados::Rados::aio_create_completion();
+      rvals[j] = data_io.aio_operate(oids[j], comps[j], &op, NULL);
+      if (rvals[j] < 0) {
+        comps[j]->release();
+        comps[j] = NULL;
+      }
     }
+    wait_window(comps, &rvals);
+
+    // Injection is done one inode at a time, in listing order
+    for (size_t j = 0; j < oids.size(); ++j) {
+      AccumulateResult accum_res;
+      inode_backtrace_t backtrace;
+      ceph_file_layout loaded_layout = g_default_file_layout;
+      r = rvals[j];
+      if (r == 0) {
+        r = ClsCephFSClient::decode_inode_accumulate_result(
+            attrs[j], &backtrace, &loaded_layout, &accum_res);
+      }
 
-    // We are only interested in 0th objects during this phase: we touched
-    // the other objects during scan_extents
-    if (obj_name_offset != 0) {
-      continue;
+      if (r < 0) {
+        dout(4) << "Unexpected error loading accumulated metadata from '"
+                << oids[j] << "': " << cpp_strerror(r) << dendl;
+        // FIXME: this creates situation where if a client has a corrupt
+        // backtrace/layout, we will fail to inject it.  We should (optionally)
+        // proceed if the backtrace/layout is corrupt but we have valid
+        // accumulated metadata.
+        continue;
+      }
+
+      inject_inode(inos[j], accum_res, backtrace, loaded_layout);
     }
 
-    AccumulateResult accum_res;
-    inode_backtrace_t backtrace;
-    ceph_file_layout loaded_layout = g_default_file_layout;
-    int r = ClsCephFSClient::fetch_inode_accumulate_result(
-        data_io, oid, &backtrace, &loaded_layout, &accum_res);
-    
+    done += listed;
+    r = save_checkpoint("scan_inodes", done);
     if (r < 0) {
-      dout(4) << "Unexpected error loading accumulated metadata from '"
-              << oid << "': " << cpp_strerror(r) << dendl;
-      // FIXME: this creates situation where if a client has a corrupt
-      // backtrace/layout, we will fail to inject it.  We should (optionally)
-      // proceed if the backtrace/layout is corrupt but we have valid
-      // accumulated metadata.
-      continue;
+      return r;
     }
+  }
 
-    const time_t file_mtime = accum_res.max_mtime;
-    uint64_t file_size = 0;
-    uint32_t chunk_size = g_default_file_layout.fl_object_size;
-    bool have_backtrace = !(backtrace.ancestors.empty());
-
-    // This is the layout we will use for injection, populated either
-    // from loaded_layout or from best guesses
-    ceph_file_layout guessed_layout;
-    guessed_layout.fl_pg_pool = data_pool_id;
-
-    // Calculate file_size, guess chunk_size
-    if (accum_res.ceiling_obj_index > 0) {
-      // When there are multiple objects, the largest object probably
-      // indicates the chunk size.  But not necessarily, because files
-      // can be sparse.  Only make this assumption if size seen
-      // is a power of two, as chunk sizes typically are.
-      if ((accum_res.max_obj_size & (accum_res.max_obj_size - 1)) == 0) {
-        chunk_size = accum_res.max_obj_size;
-      }
+  if (!checkpoint_path.empty()) {
+    ::unlink(checkpoint_path.c_str());
+  }
+  return 0;
+}
 
-      if (loaded_layout.fl_pg_pool == uint32_t(-1)) {
-        // If no stashed layout was found, guess it
-        guessed_layout.fl_object_size = chunk_size;
-        guessed_layout.fl_stripe_unit = chunk_size;
-        guessed_layout.fl_stripe_count = 1;
-      } else if (loaded_layout.fl_object_size < accum_res.max_obj_size) {
-        // If the max size seen exceeds what the stashed layout claims, then
-        // disbelieve it.  Guess instead.
-        dout(4) << "bogus xattr layout on 0x" << std::hex << obj_name_ino
-                << std::dec << ", ignoring in favour of best guess" << dendl;
-        guessed_layout.fl_object_size = chunk_size;
-        guessed_layout.fl_stripe_unit = chunk_size;
-        guessed_layout.fl_stripe_count = 1;
-      } else {
-        // We have a stashed layout that we can't disprove, so apply it
-        guessed_layout = loaded_layout;
-        dout(20) << "loaded layout from xattr:"
-          << " os: " << guessed_layout.fl_object_size
-          << " sc: " << guessed_layout.fl_stripe_count
-          << " su: " << guessed_layout.fl_stripe_unit
-          << dendl;
-        // User might have transplanted files from a pool with a different
-        // ID, so whatever the loaded_layout says, we'll force the injected
-        // layout to point to the pool we really read from
-        guessed_layout.fl_pg_pool = data_pool_id;
-      }
+void DataScan::inject_inode(
+    uint64_t obj_name_ino,
+    const AccumulateResult &accum_res,
+    const inode_backtrace_t &backtrace,
+    const ceph_file_layout &loaded_layout)
+{
+  int r = 0;
+  const time_t file_mtime = accum_res.max_mtime;
+  uint64_t file_size = 0;
+  uint32_t chunk_size = g_default_file_layout.fl_object_size;
+  bool have_backtrace = !(backtrace.ancestors.empty());
+
+  // This is the layout we will use for injection, populated either
+  // from loaded_layout or from best guesses
+  ceph_file_layout guessed_layout;
+  guessed_layout.fl_pg_pool = data_pool_id;
+
+  // Calculate file_size, guess chunk_size
+  if (accum_res.ceiling_obj_index > 0) {
+    // When there are multiple objects, the largest object probably
+    // indicates the chunk size.  But not necessarily, because files
+    // can be sparse.  Only make this assumption if size seen
+    // is a power of two, as chunk sizes typically are.
+    if ((accum_res.max_obj_size & (accum_res.max_obj_size - 1)) == 0) {
+      chunk_size = accum_res.max_obj_size;
+    }
 
-      if (guessed_layout.fl_stripe_count == 1) {
-        // Unstriped file: simple chunking
-        file_size = guessed_layout.fl_object_size * accum_res.ceiling_obj_index
-                    + accum_res.ceiling_obj_size;
-      } else {
-        // Striped file: need to examine the last fl_stripe_count objects
-        // in the file to determine the size.
+    if (loaded_layout.fl_pg_pool == uint32_t(-1)) {
+      // If no stashed layout was found, guess it
+      guessed_layout.fl_object_size = chunk_size;
+      guessed_layout.fl_stripe_unit = chunk_size;
+      guessed_layout.fl_stripe_count = 1;
+    } else if (loaded_layout.fl_object_size < accum_res.max_obj_size) {
+      // If the max size seen exceeds what the stashed layout claims, then
+      // disbelieve it.  Guess instead.
+      dout(4) << "bogus xattr layout on 0x" << std::hex << obj_name_ino
+              << std::dec << ", ignoring in favour of best guess" << dendl;
+      guessed_layout.fl_object_size = chunk_size;
+      guessed_layout.fl_stripe_unit = chunk_size;
+      guessed_layout.fl_stripe_count = 1;
+    } else {
+      // We have a stashed layout that we can't disprove, so apply it
+      guessed_layout = loaded_layout;
+      dout(20) << "loaded layout from xattr:"
+        << " os: " << guessed_layout.fl_object_size
+        << " sc: " << guessed_layout.fl_stripe_count
+        << " su: " << guessed_layout.fl_stripe_unit
+        << dendl;
+      // User might have transplanted files from a pool with a different
+      // ID, so whatever the loaded_layout says, we'll force the injected
+      // layout to point to the pool we really read from
+      guessed_layout.fl_pg_pool = data_pool_id;
+    }
 
-        // How many complete (i.e. not last stripe) objects?
-        uint64_t complete_objs = 0;
-        if (accum_res.ceiling_obj_index > guessed_layout.fl_stripe_count - 1) {
-          complete_objs = (accum_res.ceiling_obj_index / guessed_layout.fl_stripe_count) * guessed_layout.fl_stripe_count;
-        } else {
-          complete_objs = 0;
-        }
+    if (guessed_layout.fl_stripe_count == 1) {
+      // Unstriped file: simple chunking
+      file_size = guessed_layout.fl_object_size * accum_res.ceiling_obj_index
+                  + accum_res.ceiling_obj_size;
+    } else {
+      // Striped file: need to examine the last fl_stripe_count objects
+      // in the file to determine the size.
+
+      // How many complete (i.e. not last stripe) objects?
+      uint64_t complete_objs = 0;
+      if (accum_res.ceiling_obj_index > guessed_layout.fl_stripe_count - 1) {
+        complete_objs = (accum_res.ceiling_obj_index / guessed_layout.fl_stripe_count) * guessed_layout.fl_stripe_count;
+      } else {
+        complete_objs = 0;
+      }
 
-        // How many potentially-short objects (i.e. last stripe set) objects?
-        uint64_t partial_objs = accum_res.ceiling_obj_index + 1 - complete_objs;
+      // How many potentially-short objects (i.e. last stripe set) objects?
+      uint64_t partial_objs = accum_res.ceiling_obj_index + 1 - complete_objs;
 
-        dout(10) << "calculating striped size from complete objs: "
-                 << complete_objs << ", partial objs: " << partial_objs
-                 << dendl;
+      dout(10) << "calculating striped size from complete objs: "
+               << complete_objs << ", partial objs: " << partial_objs
+               << dendl;
 
-        // Maximum amount of data that may be in the incomplete objects
-        uint64_t incomplete_size = 0;
+      // Maximum amount of data that may be in the incomplete objects
+      uint64_t incomplete_size = 0;
 
-        // For each short object, calculate the max file size within it
-        // and accumulate the maximum
-        for (uint64_t i = complete_objs; i < complete_objs + partial_objs; ++i) {
-          char buf[60];
-          snprintf(buf, sizeof(buf), "%llx.%08llx",
-              (long long unsigned)obj_name_ino, (long long unsigned)i);
+      // For each short object, calculate the max file size within it
+      // and accumulate the maximum
+      for (uint64_t i = complete_objs; i < complete_objs + partial_objs; ++i) {
+        char buf[60];
+        snprintf(buf, sizeof(buf), "%llx.%08llx",
+            (long long unsigned)obj_name_ino, (long long unsigned)i);
 
-          uint64_t osize(0);
-          time_t omtime(0);
-          r = data_io.stat(std::string(buf), &osize, &omtime);
-          if (r == 0) {
+        uint64_t osize(0);
+        time_t omtime(0);
+        r = data_io.stat(std::string(buf), &osize, &omtime);
+        if (r == 0) {
 	    if (osize > 0) {
 	      // Upper bound within this object
 	      uint64_t upper_size = (osize - 1) / guessed_layout.fl_stripe_unit
@@ -599,79 +774,76 @@ int DataScan::scan_inodes()
 		% guessed_layout.fl_stripe_unit + 1;
 	      incomplete_size = MAX(incomplete_size, upper_size);
 	    }
-          } else if (r == -ENOENT) {
-            // Absent object, treat as size 0 and ignore.
-          } else {
-            // Unexpected error, carry r to outer scope for handling.
-            break;
-          }
-        }
-        if (r != 0 && r != -ENOENT) {
-          derr << "Unexpected error checking size of ino 0x" << std::hex
-               << obj_name_ino << std::dec << ": " << cpp_strerror(r) << dendl;
-          continue;
+        } else if (r == -ENOENT) {
+          // Absent object, treat as size 0 and ignore.
+        } else {
+          // Unexpected error, carry r to outer scope for handling.
+          break;
         }
-        file_size = complete_objs * guessed_layout.fl_object_size
-                    + incomplete_size;
       }
-    } else {
-      file_size = accum_res.ceiling_obj_size;
+      if (r != 0 && r != -ENOENT) {
+        derr << "Unexpected error checking size of ino 0x" << std::hex
+             << obj_name_ino << std::dec << ": " << cpp_strerror(r) << dendl;
+        return;
+      }
+      file_size = complete_objs * guessed_layout.fl_object_size
+                  + incomplete_size;
     }
+  } else {
+    file_size = accum_res.ceiling_obj_size;
+  }
 
-    // Santity checking backtrace ino against object name
-    if (have_backtrace && backtrace.ino != obj_name_ino) {
-      dout(4) << "Backtrace ino 0x" << std::hex << backtrace.ino
-        << " doesn't match object name ino 0x" << obj_name_ino
-        << std::dec << dendl;
-      have_backtrace = false;
-    }
+  // Santity checking backtrace ino against object name
+  if (have_backtrace && backtrace.ino != obj_name_ino) {
+    dout(4) << "Backtrace ino 0x" << std::hex << backtrace.ino
+      << " doesn't match object name ino 0x" << obj_name_ino
+      << std::dec << dendl;
+    have_backtrace = false;
+  }
 
-    // Inject inode to the metadata pool
-    if (have_backtrace) {
-      inode_backpointer_t root_bp = *(backtrace.ancestors.rbegin());
-      if (MDS_INO_IS_MDSDIR(root_bp.dirino)) {
-        /* Special case for strays: even if we have a good backtrace,
-         * don't put it in the stray dir, because while that would technically
-         * give it linkage it would still be invisible to the user */
-        r = driver->inject_lost_and_found(
-            obj_name_ino, file_size, file_mtime, guessed_layout);
-        if (r < 0) {
-          dout(4) << "Error injecting 0x" << std::hex << backtrace.ino
-            << std::dec << " into lost+found: " << cpp_strerror(r) << dendl;
-          if (r == -EINVAL) {
-            dout(4) << "Use --force-corrupt to overwrite structures that "
-                       "appear to be corrupt" << dendl;
-          }
-        }
-      } else {
-        /* Happy case: we will inject a named dentry for this inode */
-        r = driver->inject_with_backtrace(
-            backtrace, file_size, file_mtime, guessed_layout);
-        if (r < 0) {
-          dout(4) << "Error injecting 0x" << std::hex << backtrace.ino
-            << std::dec << " with backtrace: " << cpp_strerror(r) << dendl;
-          if (r == -EINVAL) {
-            dout(4) << "Use --force-corrupt to overwrite structures that "
-                       "appear to be corrupt" << dendl;
-          }
-        }
-      }
-    } else {
-      /* Backtrace-less case: we will inject a lost+found dentry */
+  // Inject inode to the metadata pool
+  if (have_backtrace) {
+    inode_backpointer_t root_bp = *(backtrace.ancestors.rbegin());
+    if (MDS_INO_IS_MDSDIR(root_bp.dirino)) {
+      /* Special case for strays: even if we have a good backtrace,
+       * don't put it in the stray dir, because while that would technically
+       * give it linkage it would still be invisible to the user */
       r = driver->inject_lost_and_found(
           obj_name_ino, file_size, file_mtime, guessed_layout);
       if (r < 0) {
-        dout(4) << "Error injecting 0x" << std::hex << obj_name_ino
+        dout(4) << "Error injecting 0x" << std::hex << backtrace.ino
           << std::dec << " into lost+found: " << cpp_strerror(r) << dendl;
         if (r == -EINVAL) {
           dout(4) << "Use --force-corrupt to overwrite structures that "
                      "appear to be corrupt" << dendl;
         }
       }
+    } else {
+      /* Happy case: we will inject a named dentry for this inode */
+      r = driver->inject_with_backtrace(
+          backtrace, file_size, file_mtime, guessed_layout);
+      if (r < 0) {
+        dout(4) << "Error injecting 0x" << std::hex << backtrace.ino
+          << std::dec << " with backtrace: " << cpp_strerror(r) << dendl;
+        if (r == -EINVAL) {
+          dout(4) << "Use --force-corrupt to overwrite structures that "
+                     "appear to be corrupt" << dendl;
+        }
+      }
+    }
+  } else {
+    /* Backtrace-less case: we will inject a lost+found dentry */
+    r = driver->inject_lost_and_found(
+        obj_name_ino, file_size, file_mtime, guessed_layout);
+    if (r < 0) {
+      dout(4) << "Error injecting 0x" << std::hex << obj_name_ino
+        << std::dec << " into lost+found: " << cpp_strerror(r) << dendl;
+      if (r == -EINVAL) {
+        dout(4) << "Use --force-corrupt to overwrite structures that "
+                   "appear to be corrupt" << dendl;
+      }
     }
   }
-
-  return 0;
 }
 
 int MetadataDriver::read_fnode(
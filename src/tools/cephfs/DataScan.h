@@ -17,6 +17,7 @@
 #include "include/rados/librados.hpp"
 
 class InodeStore;
+class AccumulateResult;
 
 class RecoveryDriver {
   protected:
@@ -218,8 +219,13 @@ class DataScan : public MDSUtility
     // Remember the data pool ID for use in layouts
     int64_t data_pool_id;
 
+    // This worker scans slice n of m of the data pool
     uint32_t n;
     uint32_t m;
+    // How many objects to have ios in flight for at once
+    uint32_t window;
+    // Where to record progress, if anywhere
+    std::string checkpoint_path;
 
     /**
      * Scan data pool for backtraces, and inject inodes to metadata pool
@@ -231,6 +237,29 @@ class DataScan : public MDSUtility
      */
     int scan_extents();
 
+    /**
+     * Inject the inode whose 0th object gave us accum_res,
+     * backtrace and loaded_layout
+     */
+    void inject_inode(
+        uint64_t obj_name_ino,
+        const AccumulateResult &accum_res,
+        const inode_backtrace_t &backtrace,
+        const ceph_file_layout &loaded_layout);
+
+    /**
+     * Start listing this worker's slice of the data pool, past the
+     * objects a checkpoint of the same command says are done
+     *
+     * @param done set to the number of objects skipped
+     */
+    librados::NObjectIterator list_begin(
+        const std::string &command, uint64_t *done);
+
+    /// @return objects done according to the checkpoint, if any
+    uint64_t load_checkpoint(const std::string &command);
+    int save_checkpoint(const std::string &command, uint64_t done);
+
     // Accept pools which are not in the MDSMap
     bool force_pool;
     // Respond to decode errors by overwriting
@@ -259,7 +288,7 @@ class DataScan : public MDSUtility
     int main(const std::vector<const char *> &args);
 
     DataScan()
-      : driver(NULL), data_pool_id(-1), n(0), m(1),
+      : driver(NULL), data_pool_id(-1), n(0), m(1), window(32),
         force_pool(false)
     {
     }
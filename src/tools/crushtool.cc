@@ -21,6 +21,7 @@
 #include <errno.h>
 
 #include <fstream>
+#include <boost/scoped_ptr.hpp>
 
 #include "common/debug.h"
 #include "common/errno.h"
@@ -28,6 +29,7 @@
 
 #include "common/ceph_argparse.h"
 #include "include/stringify.h"
+#include "common/Formatter.h"
 #include "global/global_context.h"
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
@@ -185,6 +187,14 @@ void usage()
   cout << "   --show-mappings       show mappings\n";
   cout << "   --show-bad-mappings   show bad mappings\n";
   cout << "   --show-choose-tries   show choose tries histogram\n";
+  cout << "   -i mapfn --compare mapfn2\n";
+  cout << "                         map the same inputs with both maps and report\n";
+  cout << "                         what moves (takes the --test range options)\n";
+  cout << "      [--compare-domain type]\n";
+  cout << "                         total moves per bucket of type (default host)\n";
+  cout << "      [--format json|json-pretty]\n";
+  cout << "                         dump moves per device and bucket\n";
+  cout << "   --threads n           map with n threads (--test, --compare)\n";
   cout << "   --output-name name\n";
   cout << "                         prepend the data file(s) generated during the\n";
   cout << "                         testing routine with name\n";
@@ -230,6 +240,8 @@ int main(int argc, const char **argv)
   bool check = false;
   int max_id = -1;
   bool test = false;
+  std::string compare_fn, compare_domain = "host", format;
+  int threads = 1;
   bool display = false;
   bool tree = false;
   int full_location = -1;
@@ -319,6 +331,18 @@ int main(int argc, const char **argv)
     } else if (ceph_argparse_flag(args, i, "-t", "--test", (char*)NULL)) {
       test = true;
     } else if (ceph_argparse_witharg(args, i, &full_location, err, "--show-location", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &val, "--compare", (char*)NULL)) {
+      compare_fn = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--compare-domain", (char*)NULL)) {
+      compare_domain = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--format", (char*)NULL)) {
+      format = val;
+    } else if (ceph_argparse_witharg(args, i, &threads, err, "--threads", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << err.str() << std::endl;
+	exit(EXIT_FAILURE);
+      }
+      tester.set_threads(threads);
     } else if (ceph_argparse_flag(args, i, "-s", "--simulate", (char*)NULL)) {
       tester.set_random_placement();
     } else if (ceph_argparse_flag(args, i, "--enable-unsafe-tunables", (char*)NULL)) {
@@ -517,6 +541,7 @@ int main(int argc, const char **argv)
     exit(EXIT_FAILURE);
   }
   if (!check && !compile && !decompile && !build && !test && !reweight && !adjust && !tree &&
+      compare_fn.empty() &&
       add_item < 0 && full_location < 0 &&
       remove_name.empty() && reweight_name.empty()) {
     cerr << "no action specified; -h for help" << std::endl;
@@ -850,6 +875,22 @@ int main(int argc, const char **argv)
       exit(1);
   }
 
+  if (!compare_fn.empty()) {
+    CrushWrapper other;
+    int r = other.read_from_file(compare_fn.c_str());
+    if (r < 0) {
+      cerr << me << ": error reading '" << compare_fn << "': "
+	   << cpp_strerror(r) << std::endl;
+      exit(1);
+    }
+    boost::scoped_ptr<Formatter> f;
+    if (!format.empty())
+      f.reset(Formatter::create(format, "json-pretty", "json-pretty"));
+    r = tester.compare(other, compare_domain, f.get(), cout);
+    if (r < 0)
+      exit(1);
+  }
+
   // output ---
   if (modified) {
     crush.finalize();
@@ -20,9 +20,144 @@
 
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 using namespace std;
 
+/**
+ * pg copies per osd in one pool or all pools, against the share of
+ * them an osd's weight (crush weight times reweight) entitles it to
+ */
+struct pg_distribution_t {
+  vector<unsigned> count, first, primary;
+  vector<double> expected;  ///< 0 for osds that take no data
+  uint64_t total;
+  int in;
+  double stddev;            ///< of count - expected
+  double util_stddev;       ///< of count / expected
+  int min_osd, max_osd;     ///< by count / expected
+
+  pg_distribution_t()
+    : total(0), in(0), stddev(0), util_stddev(0), min_osd(-1), max_osd(-1) {}
+
+  double util(int o) const {
+    return expected[o] > 0 ? (double)count[o] / expected[o] : 0;
+  }
+
+  void calc(const OSDMap &m, int64_t pool) {
+    int n = m.get_max_osd();
+    m.get_mapping()->count_pgs(pool, n, &count, &first, &primary);
+    expected.assign(n, 0);
+    double wsum = 0;
+    for (int i = 0; i < n; i++) {
+      if (!m.is_in(i) || m.crush->get_item_weightf(i) <= 0)
+	continue;
+      expected[i] = m.crush->get_item_weightf(i) * m.get_weightf(i);
+      wsum += expected[i];
+      total += count[i];
+      in++;
+    }
+    if (!in || wsum <= 0)
+      return;
+    for (int i = 0; i < n; i++) {
+      if (expected[i] <= 0)
+	continue;
+      expected[i] *= (double)total / wsum;
+      double d = count[i] - expected[i];
+      stddev += d * d;
+      d = util(i) - 1.0;
+      util_stddev += d * d;
+      if (min_osd < 0 || util(i) < util(min_osd))
+	min_osd = i;
+      if (max_osd < 0 || util(i) > util(max_osd))
+	max_osd = i;
+    }
+    stddev = sqrt(stddev / in);
+    util_stddev = sqrt(util_stddev / in);
+  }
+
+  void dump(Formatter *f) const {
+    f->dump_int("in", in);
+    f->dump_unsigned("pg_copies", total);
+    f->dump_float("stddev", stddev);
+    f->dump_float("utilization_stddev", util_stddev);
+    if (min_osd >= 0) {
+      f->dump_int("min_osd", min_osd);
+      f->dump_float("min_utilization", util(min_osd));
+      f->dump_int("max_osd", max_osd);
+      f->dump_float("max_utilization", util(max_osd));
+    }
+  }
+};
+
+static void dump_pg_distribution(OSDMap &osdmap, int64_t pool, Formatter *f)
+{
+  pg_distribution_t all;
+  all.calc(osdmap, pool);
+
+  f->open_object_section("pg_distribution");
+  f->dump_unsigned("epoch", osdmap.get_epoch());
+  map<string, pair<uint64_t, double> > hosts;
+  f->open_array_section("osds");
+  for (int i = 0; i < osdmap.get_max_osd(); i++) {
+    if (!osdmap.exists(i))
+      continue;
+    string host = osdmap.crush->get_immediate_parent(i).second;
+    f->open_object_section("osd");
+    f->dump_int("osd", i);
+    f->dump_string("host", host);
+    f->dump_unsigned("count", all.count[i]);
+    f->dump_unsigned("first", all.first[i]);
+    f->dump_unsigned("primary", all.primary[i]);
+    f->dump_float("crush_weight", osdmap.crush->get_item_weightf(i));
+    f->dump_float("reweight", osdmap.get_weightf(i));
+    f->dump_float("expected", all.expected[i]);
+    f->dump_float("utilization", all.util(i));
+    f->close_section();
+    hosts[host].first += all.count[i];
+    hosts[host].second += all.expected[i];
+  }
+  f->close_section();
+
+  // the bucket right above each osd, whatever its type is called
+  f->open_array_section("hosts");
+  for (map<string, pair<uint64_t, double> >::iterator p = hosts.begin();
+       p != hosts.end();
+       ++p) {
+    f->open_object_section("host");
+    f->dump_string("host", p->first);
+    f->dump_unsigned("count", p->second.first);
+    f->dump_float("expected", p->second.second);
+    f->dump_float("utilization", p->second.second > 0 ?
+		  p->second.first / p->second.second : 0);
+    f->close_section();
+  }
+  f->close_section();
+
+  f->open_array_section("pools");
+  const map<int64_t,pg_pool_t>& pools = osdmap.get_pools();
+  for (map<int64_t,pg_pool_t>::const_iterator p = pools.begin();
+       p != pools.end(); ++p) {
+    if (pool != -1 && p->first != pool)
+      continue;
+    pg_distribution_t d;
+    d.calc(osdmap, p->first);
+    f->open_object_section("pool");
+    f->dump_int("pool", p->first);
+    f->dump_string("name", osdmap.get_pool_name(p->first));
+    f->dump_unsigned("pg_num", p->second.get_pg_num());
+    f->dump_unsigned("size", p->second.get_size());
+    d.dump(f);
+    f->close_section();
+  }
+  f->close_section();
+
+  f->open_object_section("summary");
+  all.dump(f);
+  f->close_section();
+  f->close_section();
+}
+
 void usage()
 {
   cout << " usage: [--print] [--createsimple <numosd> [--clobber] [--pg_bits <bitsperosd>]] <mapfilename>" << std::endl;
@@ -30,12 +165,21 @@ void usage()
   cout << "   --import-crush <file>   replace osdmap's crush map with <file>" << std::endl;
   cout << "   --test-map-pgs [--pool <poolid>] map all pgs" << std::endl;
   cout << "   --test-map-pgs-dump [--pool <poolid>] map all pgs" << std::endl;
+  cout << "   --mapping-threads <n>   precompute all pg mappings with n threads first" << std::endl;
+  cout << "   --test-map-pgs-diff <file> list pgs whose mapping differs in osdmap <file>" << std::endl;
+  cout << "   --test-map-pgs-inc <file> [--pool <poolid>] count the pgs that incremental" << std::endl;
+  cout << "                           <file> would move" << std::endl;
+  cout << "   --format <json|json-pretty|xml> report --test-map-pgs* as per osd, per host" << std::endl;
+  cout << "                           and per pool distributions" << std::endl;
   cout << "   --mark-up-in            mark osds up and in (but do not persist)" << std::endl;
   cout << "   --clear-temp            clear pg_temp and primary_temp" << std::endl;
   cout << "   --test-random           do random placements" << std::endl;
   cout << "   --test-map-pg <pgid>    map a pgid to osds" << std::endl;
   cout << "   --test-map-object <objectname> [--pool <poolid>] map an object to osds"
        << std::endl;
+  cout << "   --balance <file> [--pool <poolid>] [--balance-max-change <f>] [--balance-rounds <n>]" << std::endl;
+  cout << "                           even out pgs per osd with reweights, write" << std::endl;
+  cout << "                           them to <file> as an incremental" << std::endl;
   exit(1);
 }
 
@@ -73,6 +217,13 @@ int main(int argc, const char **argv)
   bool test_map_pgs = false;
   bool test_map_pgs_dump = false;
   bool test_random = false;
+  int mapping_threads = 0;
+  std::string test_map_pgs_diff;
+  std::string test_map_pgs_inc;
+  boost::scoped_ptr<Formatter> report_formatter;
+  std::string balance;
+  float balance_max_change = g_conf->mon_reweight_balance_max_change;
+  int balance_rounds = g_conf->mon_reweight_balance_rounds;
 
   std::string val;
   std::ostringstream err;
@@ -109,6 +260,29 @@ int main(int argc, const char **argv)
       test_map_pgs = true;
     } else if (ceph_argparse_flag(args, i, "--test-map-pgs-dump", (char*)NULL)) {
       test_map_pgs_dump = true;
+    } else if (ceph_argparse_witharg(args, i, &mapping_threads, err, "--mapping-threads", (char*)NULL)) {
+      if (!err.str().empty()) {
+        cerr << err.str() << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    } else if (ceph_argparse_witharg(args, i, &val, "--test-map-pgs-diff", (char*)NULL)) {
+      test_map_pgs_diff = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--test-map-pgs-inc", (char*)NULL)) {
+      test_map_pgs_inc = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--format", (char*)NULL)) {
+      report_formatter.reset(Formatter::create(val, "json-pretty", "json-pretty"));
+    } else if (ceph_argparse_witharg(args, i, &val, "--balance", (char*)NULL)) {
+      balance = val;
+    } else if (ceph_argparse_witharg(args, i, &balance_max_change, err, "--balance-max-change", (char*)NULL)) {
+      if (!err.str().empty()) {
+        cerr << err.str() << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    } else if (ceph_argparse_witharg(args, i, &balance_rounds, err, "--balance-rounds", (char*)NULL)) {
+      if (!err.str().empty()) {
+        cerr << err.str() << std::endl;
+        exit(EXIT_FAILURE);
+      }
     } else if (ceph_argparse_flag(args, i, "--test-random", (char*)NULL)) {
       test_random = true;
     } else if (ceph_argparse_flag(args, i, "--clobber", (char*)NULL)) {
@@ -318,7 +492,157 @@ int main(int argc, const char **argv)
          << ") acting (" << acting << ", p" << acting_primary << ")"
          << std::endl;
   }
-  if (test_map_pgs || test_map_pgs_dump) {
+  if (mapping_threads > 0 || !test_map_pgs_diff.empty() ||
+      !test_map_pgs_inc.empty() ||
+      (report_formatter && (test_map_pgs || test_map_pgs_dump))) {
+    utime_t start = ceph_clock_now(g_ceph_context);
+    osdmap.build_mapping(MAX(mapping_threads, 1));
+    // keep stdout parseable when it carries a --format report
+    ostream& out = report_formatter ? cerr : cout;
+    out << "mapped " << osdmap.get_mapping()->get_num_pgs() << " pgs in "
+	 << (ceph_clock_now(g_ceph_context) - start) << " s" << std::endl;
+  }
+  if (!test_map_pgs_diff.empty()) {
+    bufferlist obl;
+    std::string error;
+    r = obl.read_file(test_map_pgs_diff.c_str(), &error);
+    if (r < 0) {
+      cerr << me << ": couldn't open " << test_map_pgs_diff << ": " << error
+	   << std::endl;
+      exit(1);
+    }
+    OSDMap other;
+    try {
+      other.decode(obl);
+    } catch (const buffer::error &e) {
+      cerr << me << ": error decoding osdmap '" << test_map_pgs_diff << "'"
+	   << std::endl;
+      exit(1);
+    }
+    other.build_mapping(MAX(mapping_threads, 1));
+    set<pg_t> changed;
+    osdmap.get_mapping()->get_changed(*other.get_mapping(), &changed);
+    for (set<pg_t>::iterator p = changed.begin(); p != changed.end(); ++p) {
+      if (pool != -1 && (int64_t)p->pool() != pool)
+	continue;
+      vector<int> up, acting, oup, oacting;
+      int up_primary, acting_primary, oup_primary, oacting_primary;
+      osdmap.pg_to_up_acting_osds(*p, &up, &up_primary,
+				  &acting, &acting_primary);
+      other.pg_to_up_acting_osds(*p, &oup, &oup_primary,
+				 &oacting, &oacting_primary);
+      cout << *p << "\tup " << oup << " -> " << up
+	   << "\tacting " << oacting << " -> " << acting << std::endl;
+    }
+    cout << changed.size() << " pgs changed between e" << other.get_epoch()
+	 << " and e" << osdmap.get_epoch() << std::endl;
+  }
+  if (!test_map_pgs_inc.empty()) {
+    if (pool != -1 && !osdmap.have_pg_pool(pool)) {
+      cerr << "There is no pool " << pool << std::endl;
+      exit(1);
+    }
+    bufferlist ibl;
+    std::string error;
+    r = ibl.read_file(test_map_pgs_inc.c_str(), &error);
+    if (r < 0) {
+      cerr << me << ": couldn't open " << test_map_pgs_inc << ": " << error
+	   << std::endl;
+      exit(1);
+    }
+    OSDMap::Incremental inc;
+    try {
+      bufferlist::iterator p = ibl.begin();
+      inc.decode(p);
+    } catch (const buffer::error &e) {
+      cerr << me << ": error decoding incremental '" << test_map_pgs_inc
+	   << "'" << std::endl;
+      exit(1);
+    }
+    if (inc.epoch != osdmap.get_epoch() + 1) {
+      cerr << me << ": incremental is for epoch " << inc.epoch
+	   << ", osdmap is at " << osdmap.get_epoch() << std::endl;
+      exit(1);
+    }
+    OSDMap next;
+    next.cow_copy_from(osdmap);
+    r = next.apply_incremental(inc);
+    if (r < 0) {
+      cerr << me << ": error applying incremental: " << cpp_strerror(r)
+	   << std::endl;
+      exit(1);
+    }
+    utime_t start = ceph_clock_now(g_ceph_context);
+    next.build_mapping(MAX(mapping_threads, 1));
+    ostream& out = report_formatter ? cerr : cout;
+    out << "mapped " << next.get_mapping()->get_num_pgs() << " pgs of e"
+	 << next.get_epoch() << " in "
+	 << (ceph_clock_now(g_ceph_context) - start) << " s" << std::endl;
+
+    pg_distribution_t before, after;
+    before.calc(osdmap, pool);
+    after.calc(next, pool);
+    Formatter *f = report_formatter.get();
+    if (f) {
+      f->open_object_section("pg_movement");
+      f->dump_unsigned("from_epoch", osdmap.get_epoch());
+      f->dump_unsigned("to_epoch", next.get_epoch());
+      f->open_array_section("pools");
+    }
+    uint64_t total_pgs = 0, total_copies = 0;
+    const map<int64_t,pg_pool_t>& pools = next.get_pools();
+    for (map<int64_t,pg_pool_t>::const_iterator p = pools.begin();
+	 p != pools.end(); ++p) {
+      if (pool != -1 && p->first != pool)
+	continue;
+      uint64_t pgs, copies;
+      next.get_mapping()->count_moved(*osdmap.get_mapping(), p->first,
+				      &pgs, &copies);
+      total_pgs += pgs;
+      total_copies += copies;
+      if (f) {
+	f->open_object_section("pool");
+	f->dump_int("pool", p->first);
+	f->dump_unsigned("pg_num", p->second.get_pg_num());
+	f->dump_unsigned("moved_pgs", pgs);
+	f->dump_unsigned("moved_copies", copies);
+	f->close_section();
+      } else {
+	cout << "pool " << p->first << "\t" << pgs << " of "
+	     << p->second.get_pg_num() << " pgs move, " << copies
+	     << " pg copies" << std::endl;
+      }
+    }
+    if (f) {
+      f->close_section();
+      f->dump_unsigned("moved_pgs", total_pgs);
+      f->dump_unsigned("moved_copies", total_copies);
+      f->open_object_section("before");
+      before.dump(f);
+      f->close_section();
+      f->open_object_section("after");
+      after.dump(f);
+      f->close_section();
+      f->close_section();
+      f->flush(cout);
+      cout << std::endl;
+    } else {
+      cout << total_pgs << " pgs move, " << total_copies << " pg copies"
+	   << std::endl;
+      cout << "pg copies per osd vs weight: stddev " << before.stddev
+	   << " -> " << after.stddev << ", utilization stddev "
+	   << before.util_stddev << " -> " << after.util_stddev << std::endl;
+    }
+  }
+  if ((test_map_pgs || test_map_pgs_dump) && report_formatter) {
+    if (pool != -1 && !osdmap.have_pg_pool(pool)) {
+      cerr << "There is no pool " << pool << std::endl;
+      exit(1);
+    }
+    dump_pg_distribution(osdmap, pool, report_formatter.get());
+    report_formatter->flush(cout);
+    cout << std::endl;
+  } else if (test_map_pgs || test_map_pgs_dump) {
     if (pool != -1 && !osdmap.have_pg_pool(pool)) {
       cerr << "There is no pool " << pool << std::endl;
       exit(1);
@@ -426,6 +750,47 @@ int main(int argc, const char **argv)
       cout << "size " << i << "\t" << size[i] << std::endl;
     }
   }
+  if (!balance.empty()) {
+    if (pool != -1 && !osdmap.have_pg_pool(pool)) {
+      cerr << "There is no pool " << pool << std::endl;
+      exit(1);
+    }
+    if (balance_max_change <= 0 || balance_max_change > 1 ||
+	balance_rounds < 1) {
+      cerr << me << ": --balance-max-change must be in (0, 1] and"
+	   << " --balance-rounds at least 1" << std::endl;
+      exit(1);
+    }
+    set<int64_t> pools;
+    if (pool != -1)
+      pools.insert(pool);
+    map<int,__u32> new_weights;
+    double before, after;
+    osdmap.calc_balance_reweights(pools, NULL, balance_max_change,
+				  balance_rounds, &new_weights,
+				  &before, &after);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    for (map<int,__u32>::iterator p = new_weights.begin();
+	 p != new_weights.end();
+	 ++p) {
+      cout << "osd." << p->first << "\t" << osdmap.get_weightf(p->first)
+	   << " -> " << (float)p->second / (float)CEPH_OSD_IN << std::endl;
+      inc.new_weight[p->first] = p->second;
+    }
+    cout << "pgs per osd vs crush weight: stddev " << before << " -> "
+	 << after << ", " << new_weights.size() << " reweights" << std::endl;
+    bufferlist ibl;
+    inc.encode(ibl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    r = ibl.write_file(balance.c_str());
+    if (r < 0) {
+      cerr << me << ": error writing incremental to " << balance << ": "
+	   << cpp_strerror(r) << std::endl;
+      exit(1);
+    }
+    cout << me << ": wrote incremental for epoch " << inc.epoch << " to "
+	 << balance << std::endl;
+  }
   if (test_crush) {
     int pass = 0;
     while (1) {
@@ -460,7 +825,8 @@ int main(int argc, const char **argv)
   if (!print && !tree && !modified &&
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
-      !test_map_pgs && !test_map_pgs_dump) {
+      !test_map_pgs && !test_map_pgs_dump && test_map_pgs_diff.empty() &&
+      test_map_pgs_inc.empty() && balance.empty()) {
     cerr << me << ": no action specified?" << std::endl;
     usage();
   }
@@ -191,6 +191,9 @@ void usage(ostream& out)
 "        prefix output with date/time\n"
 "   --no-verify\n"
 "        do not verify contents of read objects\n"
+"   --op-rate N\n"
+"        start N ops per second at most (open loop); latencies are\n"
+"        counted from when each op was due\n"
 "   --write-object\n"
 "        write contents to the objects\n"
 "   --write-omap\n"
@@ -1233,6 +1236,7 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   int64_t read_percent = -1;
   uint64_t num_objs = 0;
   int run_length = 0;
+  uint64_t op_rate = 0;
 
   bool show_time = false;
   bool wildcard = false;
@@ -1278,6 +1282,12 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
       return -EINVAL;
     }
   }
+  i = opts.find("op-rate");
+  if (i != opts.end()) {
+    if (rados_sistrtoll(i, &op_rate)) {
+      return -EINVAL;
+    }
+  }
   i = opts.find("run-name");
   if (i != opts.end()) {
     run_name = i->second;
@@ -2477,6 +2487,7 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
     }
     RadosBencher bencher(g_ceph_context, rados, io_ctx);
     bencher.set_show_time(show_time);
+    bencher.set_op_rate(op_rate);
     bencher.set_write_destination(static_cast<OpWriteDest>(bench_write_dest));
 
     ostream *outstream = NULL;
@@ -2960,6 +2971,8 @@ int main(int argc, const char **argv)
       opts["striper"] = "true";
     } else if (ceph_argparse_witharg(args, i, &val, "-t", "--concurrent-ios", (char*)NULL)) {
       opts["concurrent-ios"] = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--op-rate", (char*)NULL)) {
+      opts["op-rate"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--block-size", (char*)NULL)) {
       opts["block-size"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "-b", (char*)NULL)) {